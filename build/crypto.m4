@@ -126,6 +126,21 @@ AC_DEFUN([TS_CHECK_CRYPTO_NEXTPROTONEG], [
   AC_SUBST(use_tls_npn)
 ])
 
+AC_DEFUN([TS_CHECK_CRYPTO_ALPN], [
+  enable_tls_alpn=yes
+  _alpn_saved_LIBS=$LIBS
+  TS_ADDTO(LIBS, [$LIBSSL])
+  AC_CHECK_FUNCS(SSL_CTX_set_alpn_select_cb SSL_get0_alpn_selected SSL_select_next_proto,
+    [], [enable_tls_alpn=no]
+  )
+  LIBS=$_alpn_saved_LIBS
+
+  AC_MSG_CHECKING(whether to enable Application-Layer Protocol Negotiation TLS extension support)
+  AC_MSG_RESULT([$enable_tls_alpn])
+  TS_ARG_ENABLE_VAR([use], [tls-alpn])
+  AC_SUBST(use_tls_alpn)
+])
+
 AC_DEFUN([TS_CHECK_CRYPTO_SNI], [
   _sni_saved_LIBS=$LIBS
   enable_tls_sni=yes
@@ -164,3 +179,78 @@ AC_DEFUN([TS_CHECK_CRYPTO_SNI], [
   TS_ARG_ENABLE_VAR([use], [tls-sni])
   AC_SUBST(use_tls_sni)
 ])
+
+AC_DEFUN([TS_CHECK_CRYPTO_TICKETS], [
+  _tickets_saved_LIBS=$LIBS
+  enable_tls_tickets=yes
+
+  TS_ADDTO(LIBS, [$LIBSSL])
+  AC_CHECK_HEADERS(openssl/tls1.h openssl/ssl.h openssl/hmac.h openssl/evp.h)
+  # SSL_CTX_set_tlsext_ticket_key_cb is a macro too.
+  AC_MSG_CHECKING([for SSL_CTX_set_tlsext_ticket_key_cb])
+  AC_COMPILE_IFELSE(
+  [
+    AC_LANG_PROGRAM([[
+#if HAVE_OPENSSL_SSL_H
+#include <openssl/ssl.h>
+#endif
+#if HAVE_OPENSSL_TLS1_H
+#include <openssl/tls1.h>
+#endif
+      ]],
+      [[SSL_CTX_set_tlsext_ticket_key_cb(NULL, NULL);]])
+  ],
+  [
+    AC_MSG_RESULT([yes])
+  ],
+  [
+    AC_MSG_RESULT([no])
+    enable_tls_tickets=no
+  ])
+
+  LIBS=$_tickets_saved_LIBS
+
+  AC_MSG_CHECKING(whether to enable TLS session ticket support)
+  AC_MSG_RESULT([$enable_tls_tickets])
+  TS_ARG_ENABLE_VAR([use], [tls-tickets])
+  AC_SUBST(use_tls_tickets)
+])
+
+AC_DEFUN([TS_CHECK_CRYPTO_KTLS], [
+  _ktls_saved_LIBS=$LIBS
+  enable_tls_ktls=yes
+
+  TS_ADDTO(LIBS, [$LIBSSL])
+  AC_CHECK_HEADERS(openssl/ssl.h openssl/bio.h)
+  # OpenSSL built without kTLS still declares SSL_sendfile, so check the feature macro as well.
+  AC_MSG_CHECKING([for kernel TLS support in OpenSSL])
+  AC_LINK_IFELSE(
+  [
+    AC_LANG_PROGRAM([[
+#if HAVE_OPENSSL_SSL_H
+#include <openssl/ssl.h>
+#endif
+#if HAVE_OPENSSL_BIO_H
+#include <openssl/bio.h>
+#endif
+#if defined(OPENSSL_NO_KTLS) || !defined(SSL_OP_ENABLE_KTLS)
+#error no kernel TLS
+#endif
+      ]],
+      [[SSL_sendfile(NULL, 0, 0, 0, 0); return BIO_get_ktls_send(NULL);]])
+  ],
+  [
+    AC_MSG_RESULT([yes])
+  ],
+  [
+    AC_MSG_RESULT([no])
+    enable_tls_ktls=no
+  ])
+
+  LIBS=$_ktls_saved_LIBS
+
+  AC_MSG_CHECKING(whether to enable kernel TLS support)
+  AC_MSG_RESULT([$enable_tls_ktls])
+  TS_ARG_ENABLE_VAR([use], [tls-ktls])
+  AC_SUBST(use_tls_ktls)
+])
@@ -71,9 +71,11 @@ static char config_file[PATH_NAME_MAX];
 static char cop_lockfile[PATH_NAME_MAX];
 static char manager_lockfile[PATH_NAME_MAX];
 static char server_lockfile[PATH_NAME_MAX];
+static char server_heartbeat_file[PATH_NAME_MAX];
 
 static int check_memory_min_swapfree_kb = 0;
 static int check_memory_min_memfree_kb = 0;
+static int thread_heartbeat = 1;
 
 static int syslog_facility = LOG_DAEMON;
 static char syslog_fac_str[PATH_NAME_MAX] = "LOG_DAEMON";
@@ -616,6 +618,7 @@ config_reload_records()
 
   config_read_int("proxy.config.cop.linux_min_swapfree_kb", &check_memory_min_swapfree_kb, true);
   config_read_int("proxy.config.cop.linux_min_memfree_kb", &check_memory_min_memfree_kb, true);
+  config_read_int("proxy.config.cop.thread_heartbeat", &thread_heartbeat, true);
 
   cop_log_trace("Leaving %s()\n", __func__);
 }
@@ -1226,6 +1229,52 @@ test_server_http_port()
   return test_http_port(http_backdoor_port, request, server_timeout * 1000, localhost, localhost);
 }
 
+// Checks the event thread counters traffic_server keeps in the heartbeat
+// file. Returns 0 if they all moved within server_timeout, -1 if one did
+// not, and 1 if there is no heartbeat file for this server process, in
+// which case the caller falls back to a request through the proxy.
+static int
+test_server_thread_heartbeat(pid_t pid)
+{
+  static HeartbeatSegment seg;
+  static uint64_t last_beats[HEARTBEAT_MAX_THREADS];
+  static ink_hrtime last_change[HEARTBEAT_MAX_THREADS];
+  static pid_t last_pid = -1;
+  ink_hrtime now = milliseconds();
+  int fd;
+  ssize_t n;
+
+  if (!thread_heartbeat || pid <= 0)
+    return 1;
+  if ((fd = open(server_heartbeat_file, O_RDONLY)) < 0)
+    return 1;
+  n = read(fd, &seg, sizeof(seg));
+  close(fd);
+  if (n != (ssize_t) sizeof(seg) || seg.magic != HEARTBEAT_MAGIC || seg.pid != pid ||
+      seg.nthreads <= 0 || seg.nthreads > HEARTBEAT_MAX_THREADS)
+    return 1;
+
+  if (pid != last_pid) {
+    for (int i = 0; i < seg.nthreads; i++) {
+      last_beats[i] = seg.beats[i];
+      last_change[i] = now;
+    }
+    last_pid = pid;
+    return 0;
+  }
+  for (int i = 0; i < seg.nthreads; i++) {
+    if (seg.beats[i] != last_beats[i]) {
+      last_beats[i] = seg.beats[i];
+      last_change[i] = now;
+    } else if (now - last_change[i] > server_timeout * 1000) {
+      cop_log(COP_WARNING, "(thread heartbeat) event thread %d has not run for %d seconds\n",
+              i, (int) ((now - last_change[i]) / 1000));
+      return -1;
+    }
+  }
+  return 0;
+}
+
 static int
 heartbeat_manager()
 {
@@ -1256,12 +1305,16 @@ heartbeat_manager()
 }
 
 static int
-heartbeat_server()
+heartbeat_server(pid_t pid)
 {
   int err;
 
   cop_log_trace("Entering heartbeat_server()\n");
-  err = test_server_http_port();
+  // Watching the event threads adds no load to a busy server, the request
+  // through the proxy is only for servers without a heartbeat file.
+  err = test_server_thread_heartbeat(pid);
+  if (err > 0)
+    err = test_server_http_port();
 
   if (err < 0) {
     // If the test failed, increment the count of the number of
@@ -1458,7 +1511,7 @@ check_programs()
       }
     } else {
       alarm(2 * server_timeout);
-      heartbeat_server();
+      heartbeat_server(holding_pid);
       alarm(0);
     }
   }
@@ -1731,6 +1784,7 @@ init_lockfiles()
   Layout::relative_to(cop_lockfile, sizeof(cop_lockfile), Layout::get()->runtimedir, COP_LOCK);
   Layout::relative_to(manager_lockfile, sizeof(manager_lockfile), Layout::get()->runtimedir, MANAGER_LOCK);
   Layout::relative_to(server_lockfile, sizeof(server_lockfile), Layout::get()->runtimedir, SERVER_LOCK);
+  Layout::relative_to(server_heartbeat_file, sizeof(server_heartbeat_file), Layout::get()->runtimedir, SERVER_HEARTBEAT);
 
   cop_log_trace("Leaving init_lockfiles()\n");
 }
@@ -47,9 +47,12 @@
 #define AIO_MODE_SYNC            1
 #define AIO_MODE_THREAD          2
 #define AIO_MODE_NATIVE          3
+#define AIO_MODE_IO_URING        4
 
 #if TS_USE_LINUX_NATIVE_AIO
 #define AIO_MODE                 AIO_MODE_NATIVE
+#elif TS_USE_LINUX_IO_URING
+#define AIO_MODE                 AIO_MODE_IO_URING
 #else
 #define AIO_MODE                 AIO_MODE_THREAD
 #endif
@@ -71,6 +74,16 @@ typedef struct io_event ink_io_event_t;
 #define aio_offset  u.c.offset
 #define aio_buf     u.c.buf
 
+#elif AIO_MODE == AIO_MODE_IO_URING
+
+#include <liburing.h>
+
+#define MAX_AIO_EVENTS 1024
+
+#endif
+
+#if AIO_MODE == AIO_MODE_NATIVE || AIO_MODE == AIO_MODE_IO_URING
+
 struct AIOVec: public Continuation
 {
   Action action;
@@ -86,7 +99,9 @@ struct AIOVec: public Continuation
   int mainEvent(int event, Event *e);
 };
 
-#else
+#endif
+
+#if AIO_MODE != AIO_MODE_NATIVE
 
 typedef struct ink_aiocb
 {
@@ -101,7 +116,9 @@ typedef struct ink_aiocb
   int aio__pad[1];              /* extension padding */
 } ink_aiocb_t;
 
+#if AIO_MODE != AIO_MODE_IO_URING
 bool ink_aio_thread_num_set(int thread_num);
+#endif
 
 #endif
 
@@ -112,6 +129,18 @@ bool ink_aio_thread_num_set(int thread_num);
 #define AIO_LOWEST_PRIORITY      0
 #define AIO_DEFAULT_PRIORITY     AIO_LOWEST_PRIORITY
 
+// AIOCallback::io_class, how the AIO threads of a disk order requests of
+// the default priority
+enum AIOClass
+{
+  AIO_CLASS_USER_READ = 0,      // reads serving clients
+  AIO_CLASS_AGG_WRITE,          // aggregation (document) writes
+  AIO_CLASS_EVACUATE,           // evacuation reads
+  AIO_CLASS_DIR_SYNC,           // directory writes
+  AIO_CLASS_SCAN,               // cache scans
+  AIO_CLASS_COUNT
+};
+
 struct AIOCallback: public Continuation
 {
   // set before calling aio_read/aio_write
@@ -121,9 +150,11 @@ struct AIOCallback: public Continuation
   AIOCallback *then;
   // set on return from aio_read/aio_write
   int64_t aio_result;
+  int io_class;
+  ink_hrtime aio_start;         // when the request went to the disk
 
   int ok();
-  AIOCallback() : thread(AIO_CALLBACK_THREAD_ANY), then(0) {
+  AIOCallback() : thread(AIO_CALLBACK_THREAD_ANY), then(0), io_class(AIO_CLASS_USER_READ), aio_start(0) {
     aiocb.aio_reqprio = AIO_DEFAULT_PRIORITY;
   }
 };
@@ -147,11 +178,35 @@ struct DiskHandler: public Continuation
     }
   }
 };
+#elif AIO_MODE == AIO_MODE_IO_URING
+struct DiskHandler: public Continuation
+{
+  Event *trigger_event;
+  Event *submit_event;          // pending immediate submit, if any
+  struct io_uring ring;
+  int inflight;                 // SQEs submitted and not yet reaped
+  Que(AIOCallback, link) ready_list;
+  Que(AIOCallback, link) complete_list;
+  int startAIOEvent(int event, Event *e);
+  int mainAIOEvent(int event, Event *e);
+  void queue(AIOCallback *op);
+  DiskHandler() : trigger_event(NULL), submit_event(NULL), inflight(0) {
+    SET_HANDLER(&DiskHandler::startAIOEvent);
+    memset(&ring, 0, sizeof(ring));
+    int ret = io_uring_queue_init(MAX_AIO_EVENTS, &ring, 0);
+    if (ret < 0) {
+      Fatal("io_uring_queue_init error: %s", strerror(-ret));
+    }
+  }
+};
 #endif
 
 void ink_aio_init(ModuleVersion version);
 int ink_aio_start();
 void ink_aio_set_callback(Continuation * error_callback);
+// fd is opened for direct I/O, its buffers, offsets and lengths are multiples
+// of alignment; 0 for buffered I/O. Requests are timed by which it is.
+void ink_aio_set_direct(int fd, int alignment);
 
 int ink_aio_read(AIOCallback *op, int fromAPI = 0);   // fromAPI is a boolean to indicate if this is from a API call such as upload proxy feature
 int ink_aio_write(AIOCallback *op, int fromAPI = 0);
@@ -48,7 +48,7 @@ AIOCallback::ok()
   return (off_t) aiocb.aio_nbytes == (off_t) aio_result;
 }
 
-#if AIO_MODE == AIO_MODE_NATIVE
+#if AIO_MODE == AIO_MODE_NATIVE || AIO_MODE == AIO_MODE_IO_URING
 
 extern Continuation *aio_err_callbck;
 
@@ -93,7 +93,7 @@ AIOVec::mainEvent(int /* event */, Event *) {
   return EVENT_ERROR;
 }
 
-#else /* AIO_MODE != AIO_MODE_NATIVE */
+#else /* AIO_MODE != AIO_MODE_NATIVE && AIO_MODE != AIO_MODE_IO_URING */
 
 struct AIO_Reqs;
 
@@ -102,6 +102,7 @@ struct AIOCallbackInternal: public AIOCallback
   AIOCallback *first;
   AIO_Reqs *aio_req;
   ink_hrtime sleep_time;
+  ink_hrtime queued_at;
   int io_complete(int event, void *data);
   AIOCallbackInternal()
   {
@@ -127,7 +128,8 @@ AIOCallbackInternal::io_complete(int event, void *data)
 struct AIO_Reqs
 {
   Que(AIOCallback, link) aio_todo;       /* queue for holding non-http requests */
-  Que(AIOCallback, link) http_aio_todo;  /* queue for http requests */
+  Que(AIOCallback, link) class_todo[AIO_CLASS_COUNT];  /* default priority requests, by io_class */
+  int class_credit[AIO_CLASS_COUNT];     /* requests each class may still take this round */
   /* Atomic list to temporarily hold the request if the
      lock for a particular queue cannot be acquired */
   InkAtomicList aio_temp_list;
@@ -138,9 +140,26 @@ struct AIO_Reqs
   volatile int queued;          /* total number of aio_todo and http_todo requests */
   volatile int filedes;         /* the file descriptor for the requests */
   volatile int requests_queued;
+  RecRawStatBlock *rsb;         /* stats of this disk, see aio_disk_stat_enum */
+  bool service_histogram;       /* AIO_DISK_STAT_SERVICE_HISTOGRAM is registered */
 };
 
-#endif // AIO_MODE == AIO_MODE_NATIVE
+/* The stats of each AIO_Reqs are proxy.process.cache.aio.disk.<index>.*,
+   split between requests of aio_todo (priority) and the class queues
+   (default). Times are in seconds, the histogram in microseconds. */
+enum aio_disk_stat_enum
+{
+  AIO_DISK_STAT_QUEUED,
+  AIO_DISK_STAT_IN_SERVICE,
+  AIO_DISK_STAT_PRIORITY_WAIT_TIME,
+  AIO_DISK_STAT_DEFAULT_WAIT_TIME,
+  AIO_DISK_STAT_PRIORITY_SERVICE_TIME,
+  AIO_DISK_STAT_DEFAULT_SERVICE_TIME,
+  AIO_DISK_STAT_SERVICE_HISTOGRAM,
+  AIO_DISK_STAT_COUNT
+};
+
+#endif // AIO_MODE == AIO_MODE_NATIVE || AIO_MODE == AIO_MODE_IO_URING
 #ifdef AIO_STATS
 class AIOTestData:public Continuation
 {
@@ -166,6 +185,12 @@ enum aio_stat_enum
   AIO_STAT_KB_READ_PER_SEC,
   AIO_STAT_WRITE_PER_SEC,
   AIO_STAT_KB_WRITE_PER_SEC,
+  AIO_STAT_CLASS_QUEUED,
+  AIO_STAT_CLASS_WAIT_TIME = AIO_STAT_CLASS_QUEUED + AIO_CLASS_COUNT,
+  AIO_STAT_DIRECT_READ_TIME = AIO_STAT_CLASS_WAIT_TIME + AIO_CLASS_COUNT,
+  AIO_STAT_DIRECT_WRITE_TIME,
+  AIO_STAT_BUFFERED_READ_TIME,
+  AIO_STAT_BUFFERED_WRITE_TIME,
   AIO_STAT_COUNT
 };
 extern RecRawStatBlock *aio_rsb;
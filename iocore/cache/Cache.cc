@@ -32,6 +32,8 @@
 
 #include "I_Layout.h"
 
+#include <math.h>
+
 #ifdef HTTP_CACHE
 #include "HttpTransactCache.h"
 #include "HttpSM.h"
@@ -60,8 +62,11 @@ int cache_config_ram_cache_algorithm = 0;
 int cache_config_ram_cache_compress = 0;
 int cache_config_ram_cache_compress_percent = 90;
 int cache_config_ram_cache_use_seen_filter = 0;
+int cache_config_ram_cache_snapshot = 0;
+int cache_config_ram_cache_warm_rate = 100;
 int cache_config_http_max_alts = 3;
 int cache_config_dir_sync_frequency = 60;
+int64_t cache_config_dir_sync_max_rate = 0;
 int cache_config_permit_pinning = 0;
 int cache_config_vary_on_user_agent = 0;
 int cache_config_select_alternate = 1;
@@ -76,11 +81,26 @@ int cache_config_hit_evacuate_size_limit = 0;
 int cache_config_force_sector_size = 0;
 int cache_config_target_fragment_size = DEFAULT_TARGET_FRAGMENT_SIZE;
 int cache_config_agg_write_backlog = AGG_SIZE * 2;
+int cache_config_agg_write_size = AGG_SIZE;
+int cache_config_agg_write_buffers = 1;
 int cache_config_enable_checksum = 0;
+int cache_config_sendfile = 0;
+int cache_config_direct_io = 1;
+int cache_config_compress_headers = 0;
 int cache_config_alt_rewrite_max_size = 4096;
 int cache_config_read_while_writer = 0;
+int64_t cache_config_read_while_writer_stream_max_size = 0;
 char cache_system_config_directory[PATH_NAME_MAX + 1];
 int cache_config_mutex_retry_delay = 2;
+int cache_config_read_ahead = 0;
+int cache_config_scan_parallel = 0;
+int cache_config_vol_hash_algorithm = 0;
+int cache_config_evacuate_min_frequency = 0;
+int cache_config_evacuate_pin_margin = 0;
+int cache_config_dedup_entries = 0;
+int cache_config_wait_for_all_volumes = 1;
+int cache_config_admission_policy = 0;
+int cache_config_admission_threshold = 2;
 #ifdef HTTP_CACHE
 static int enable_cache_empty_http_doc = 0;
 #endif
@@ -110,6 +130,13 @@ int CacheProcessor::auto_clear_flag = 0;
 CacheProcessor cacheProcessor;
 Vol **gvol = NULL;
 volatile int gnvol = 0;
+// serializes volumes coming online, gvol and gnvol are published under it
+static ink_mutex vol_online_lock = INK_MUTEX_INIT;
+static ink_hrtime cache_start_time = 0;
+// the RAM cache sizes from proxy.config.cache.ram_cache.size, for volumes
+// which come online after the cache
+static int64_t http_ram_cache_size = 0;
+static int64_t stream_ram_cache_size = 0;
 #if TS_USE_INTERIM_CACHE == 1
 CacheDisk **g_interim_disks = NULL;
 int gn_interim_disks = 0;
@@ -118,6 +145,7 @@ uint64_t total_cache_size = 0;
 #endif
 ClassAllocator<CacheVC> cacheVConnectionAllocator("cacheVConnection");
 ClassAllocator<EvacuationBlock> evacuationBlockAllocator("evacuationBlock");
+ClassAllocator<CacheReadAhead> cacheReadAheadAllocator("cacheReadAhead");
 ClassAllocator<CacheRemoveCont> cacheRemoveContAllocator("cacheRemoveCont");
 ClassAllocator<EvacuationKey> evacuationKeyAllocator("evacuationKey");
 int CacheVC::size_to_init = -1;
@@ -163,7 +191,8 @@ struct VolInitInfo
   }
 };
 
-#if AIO_MODE == AIO_MODE_NATIVE
+// Vol::init() and CacheDisk::open() are run from the event threads, so
+// the disks and volumes allocate and clear their directories in parallel.
 struct VolInit : public Continuation
 {
   Vol *vol;
@@ -197,6 +226,7 @@ struct DiskInit : public Continuation
 
   int mainEvent(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */) {
     disk->open(s, blocks, askip, ahw_sector_size, fildes, clear);
+    ats_free(s);
     mutex.clear();
     delete this;
     return EVENT_DONE;
@@ -207,7 +237,7 @@ struct DiskInit : public Continuation
     SET_HANDLER(&DiskInit::mainEvent);
   }
 };
-#endif
+
 void cplist_init();
 static void cplist_update();
 int cplist_reconfigure();
@@ -441,8 +471,19 @@ CacheVC::get_object_size()
   return ((CacheVC *) this)->doc_len;
 }
 
-bool CacheVC::set_data(int /* i ATS_UNUSED */ , void * /* data */ )
+bool
+CacheVC::set_data(int i, void *data)
 {
+  switch (i) {
+  case CACHE_DATA_SENDFILE:
+    // the user promises to write the body straight to a socket
+    if (vio.op != VIO::READ || !cache_config_sendfile)
+      return false;
+    f.sendfile = *((int *) data) ? 1 : 0;
+    return true;
+  default:
+    break;
+  }
   ink_assert(!"CacheVC::set_data should not be called!");
   return true;
 }
@@ -524,6 +565,12 @@ Vol::begin_read(CacheVC *cont)
   ink_assert(!cont->stat_link.next && !cont->stat_link.prev);
   stat_cache_vcs.enqueue(cont, cont->stat_link);
 #endif
+  if (cache_config_evacuate_min_frequency > 0
+#if TS_USE_INTERIM_CACHE == 1
+      && !dir_ininterim(&cont->first_dir)
+#endif
+    )
+    access.increment(dir_offset(&cont->first_dir));
   // no need for evacuation as the entire document is already in memory
   if (cont->f.single_fragment)
     return 0;
@@ -598,7 +645,7 @@ CacheProcessor::start_internal(int flags)
   verify_cache_api();
 #endif
 
-#if AIO_MODE == AIO_MODE_NATIVE
+#if AIO_MODE == AIO_MODE_NATIVE || AIO_MODE == AIO_MODE_IO_URING
   int etype = ET_NET;
   int n_netthreads = eventProcessor.n_threads_for_type[etype];
   EThread **netthreads = eventProcessor.eventthread[etype];
@@ -612,6 +659,7 @@ CacheProcessor::start_internal(int flags)
   clear = !!(flags & PROCESSOR_RECONFIGURE) || auto_clear_flag;
   fix = !!(flags & PROCESSOR_FIX);
   start_done = 0;
+  cache_start_time = ink_get_hrtime();
   int diskok = 1;
   Span *sd;
 #if TS_USE_INTERIM_CACHE == 1
@@ -694,6 +742,7 @@ CacheProcessor::start_internal(int flags)
   gdisks = (CacheDisk **)ats_malloc(gndisks * sizeof(CacheDisk *));
 
   gndisks = 0;
+  DiskInit **disk_init = (DiskInit **)ats_malloc(theCacheStore.n_disks * sizeof(DiskInit *));
   ink_aio_set_callback(new AIO_Callback_handler());
 
   config_volumes.read_config_file();
@@ -706,6 +755,7 @@ CacheProcessor::start_internal(int flags)
     sd = theCacheStore.disk[i];
     char path[PATH_NAME_MAX];
     int opts = DEFAULT_CACHE_OPTIONS;
+    bool direct = false;
 
     ink_strlcpy(path, sd->pathname, sizeof(path));
     if (!sd->file_pathname) {
@@ -716,20 +766,40 @@ CacheProcessor::start_internal(int flags)
       opts |= O_CREAT;
     }
 
+    // Every buffer, offset and length the cache uses is a multiple of
+    // CACHE_BLOCK_SIZE, and the agg and read buffers are at most page
+    // aligned, so a disk that needs more cannot take direct I/O.
+    int dio_alignment = sd->dio_alignment > CACHE_BLOCK_SIZE ? sd->dio_alignment : CACHE_BLOCK_SIZE;
 #ifdef O_DIRECT
-    opts |= O_DIRECT;
+    if (cache_config_direct_io && dio_alignment <= (int) ats_pagesize()) {
+      opts |= O_DIRECT;
+      direct = true;
+    } else if (cache_config_direct_io) {
+      Warning("cache disk '%s' needs direct I/O aligned to %d bytes, more than a page", path, dio_alignment);
+    }
 #endif
 #ifdef O_DSYNC
-    opts |= O_DSYNC;
+    if (cache_config_direct_io)
+      opts |= O_DSYNC;
 #endif
 
-    int fd = open(path, opts, 0644);
+    int fd = -1;
+    if (direct || cache_config_direct_io != 2)
+      fd = open(path, opts, 0644);
+    else
+      errno = EINVAL;           // direct I/O is required and not possible
     int blocks = sd->blocks;
 
-    if (fd < 0 && (opts & O_CREAT))  // Try without O_DIRECT if this is a file on filesystem, e.g. tmpfs.
-      fd = open(path, DEFAULT_CACHE_OPTIONS | O_CREAT, 0644);
+    // Unless direct I/O is required, try without O_DIRECT where the file system does not support it, e.g. tmpfs.
+    if (fd < 0 && direct && cache_config_direct_io == 1 && (errno == EINVAL || (opts & O_CREAT))) {
+      Note("cache disk '%s' does not support direct I/O, using buffered I/O", path);
+      fd = open(path, DEFAULT_CACHE_OPTIONS | (opts & O_CREAT), 0644);
+      direct = false;
+    }
 
     if (fd > 0) {
+      ink_aio_set_direct(fd, direct ? dio_alignment : 0);
+      Debug("cache_init", "cache disk '%s' uses %s I/O", path, direct ? "direct" : "buffered");
       if (!sd->file_pathname) {
         if (ftruncate(fd, ((uint64_t) blocks) * STORE_BLOCK_SIZE) < 0) {
           Warning("unable to truncate cache file '%s' to %d blocks", path, blocks);
@@ -739,6 +809,12 @@ CacheProcessor::start_internal(int flags)
       if (diskok) {
         gdisks[gndisks] = NEW(new CacheDisk());
         gdisks[gndisks]->forced_volume_num = sd->vol_num;
+        if (cache_config_sendfile) {
+          // sendfile() needs the page cache, so it gets its own fd without O_DIRECT
+          gdisks[gndisks]->sendfile_fd = open(path, O_RDONLY);
+          if (gdisks[gndisks]->sendfile_fd < 0)
+            Warning("unable to open '%s' for sendfile, disabled for this disk: %s", path, strerror(errno));
+        }
         Debug("cache_hosting", "Disk: %d, blocks: %d", gndisks, blocks);
         int sector_size = sd->hw_sector_size;
 
@@ -750,11 +826,8 @@ CacheProcessor::start_internal(int flags)
         }
         off_t skip = ROUND_TO_STORE_BLOCK((sd->offset < START_POS ? START_POS + sd->alignment : sd->offset));
         blocks = blocks - (skip >> STORE_BLOCK_SHIFT);
-#if AIO_MODE == AIO_MODE_NATIVE
-        eventProcessor.schedule_imm(NEW(new DiskInit(gdisks[gndisks], path, blocks, skip, sector_size, fd, clear)));
-#else
-        gdisks[gndisks]->open(path, blocks, skip, sector_size, fd, clear);
-#endif
+        // opened once gndisks is final, diskInitialized() counts against it
+        disk_init[gndisks] = NEW(new DiskInit(gdisks[gndisks], ats_strdup(path), blocks, skip, sector_size, fd, clear));
         gndisks++;
       }
     } else {
@@ -767,9 +840,13 @@ CacheProcessor::start_internal(int flags)
 
   if (gndisks == 0) {
     Warning("unable to open cache disk(s): Cache Disabled\n");
+    ats_free(disk_init);
     return -1;
   }
   start_done = 1;
+  for (int i = 0; i < gndisks; i++)
+    eventProcessor.schedule_imm(disk_init[i]);
+  ats_free(disk_init);
 
   return 0;
 }
@@ -879,6 +956,68 @@ CacheProcessor::diskInitialized()
   }
 }
 
+// Give a volume its RAM cache and count it in the stats of its cache
+// volume, returning the RAM cache bytes it is counted for.
+static int64_t
+vol_init_ram_cache(Vol *vol, uint64_t *cache_bytes, uint64_t *direntries, uint64_t *used_direntries)
+{
+  ProxyMutex *mutex = this_ethread()->mutex;
+  int64_t ram_cache_bytes;
+
+  // new ram_caches, with algorithm from the config
+  switch (cache_config_ram_cache_algorithm) {
+    default:
+    case RAM_CACHE_ALGORITHM_CLFUS:
+      vol->ram_cache = new_RamCacheCLFUS();
+      break;
+    case RAM_CACHE_ALGORITHM_LRU:
+      vol->ram_cache = new_RamCacheLRU();
+      break;
+    case RAM_CACHE_ALGORITHM_SHARDED:
+      vol->ram_cache = new_RamCacheSharded();
+      break;
+  }
+  if (cache_config_ram_cache_size == AUTO_SIZE_RAM_CACHE) {
+    vol->ram_cache->init(vol_dirlen(vol) * DEFAULT_RAM_CACHE_MULTIPLIER, vol);
+    ram_cache_bytes = vol_dirlen(vol);
+  } else {
+    double factor;
+    if (vol->cache == theCache) {
+      factor = (double) (int64_t) (vol->len >> STORE_BLOCK_SHIFT) / (int64_t) theCache->cache_size;
+      ram_cache_bytes = (int64_t) (http_ram_cache_size * factor);
+    } else {
+      factor = (double) (int64_t) (vol->len >> STORE_BLOCK_SHIFT) / (int64_t) theStreamCache->cache_size;
+      ram_cache_bytes = (int64_t) (stream_ram_cache_size * factor);
+    }
+    Debug("cache_init", "CacheProcessor::cacheInitialized - factor = %f", factor);
+    vol->ram_cache->init(ram_cache_bytes, vol);
+  }
+  // sized for the heads of the documents, one per directory bucket
+  if (cache_config_evacuate_min_frequency > 0)
+    vol->access.init(vol_direntries(vol) / DIR_DEPTH);
+#if TS_USE_INTERIM_CACHE == 1
+  // TinyLFU sizes the sketch to the number of objects the cache holds
+  int64_t interim_bytes = 0;
+  for (int i = 0; i < vol->num_interim_vols; i++)
+    interim_bytes += vol->interim_vols[i].len;
+  vol->history.init(interim_bytes / cache_config_min_average_object_size + 1);
+#endif
+  CACHE_VOL_SUM_DYN_STAT(cache_ram_cache_bytes_total_stat, ram_cache_bytes);
+
+  uint64_t vol_total_cache_bytes = vol->len - vol_dirlen(vol);
+  *cache_bytes += vol_total_cache_bytes;
+  CACHE_VOL_SUM_DYN_STAT(cache_bytes_total_stat, vol_total_cache_bytes);
+
+  uint64_t vol_total_direntries = vol->buckets * vol->segments * DIR_DEPTH;
+  *direntries += vol_total_direntries;
+  CACHE_VOL_SUM_DYN_STAT(cache_direntries_total_stat, vol_total_direntries);
+
+  uint64_t vol_used_direntries = dir_entries_used(vol);
+  *used_direntries += vol_used_direntries;
+  CACHE_VOL_SUM_DYN_STAT(cache_direntries_used_stat, vol_used_direntries);
+  return ram_cache_bytes;
+}
+
 void
 CacheProcessor::cacheInitialized()
 {
@@ -895,12 +1034,6 @@ CacheProcessor::cacheInitialized()
   uint64_t total_cache_bytes = 0;       // bytes that can used in total_size
   uint64_t total_direntries = 0;        // all the direntries in the cache
   uint64_t used_direntries = 0;         //   and used
-  uint64_t vol_total_cache_bytes = 0;
-  uint64_t vol_total_direntries = 0;
-  uint64_t vol_used_direntries = 0;
-  Vol *vol;
-
-  ProxyMutex *mutex = this_ethread()->mutex;
 
   if (theCache) {
     total_size += theCache->cache_size;
@@ -942,105 +1075,32 @@ CacheProcessor::cacheInitialized()
     int64_t ram_cache_bytes = 0;
 
     if (gnvol) {
-      // new ram_caches, with algorithm from the config
-      for (i = 0; i < gnvol; i++) {
-        switch (cache_config_ram_cache_algorithm) {
-          default:
-          case RAM_CACHE_ALGORITHM_CLFUS:
-            gvol[i]->ram_cache = new_RamCacheCLFUS();
-            break;
-          case RAM_CACHE_ALGORITHM_LRU:
-            gvol[i]->ram_cache = new_RamCacheLRU();
-            break;
-        }
-      }
-      // let us calculate the Size
-      if (cache_config_ram_cache_size == AUTO_SIZE_RAM_CACHE) {
-        Debug("cache_init", "CacheProcessor::cacheInitialized - cache_config_ram_cache_size == AUTO_SIZE_RAM_CACHE");
-        for (i = 0; i < gnvol; i++) {
-          vol = gvol[i];
-          gvol[i]->ram_cache->init(vol_dirlen(vol) * DEFAULT_RAM_CACHE_MULTIPLIER, vol);
-#if TS_USE_INTERIM_CACHE == 1
-          gvol[i]->history.init(1<<20, 2097143);
-#endif
-          ram_cache_bytes += vol_dirlen(gvol[i]);
-          Debug("cache_init", "CacheProcessor::cacheInitialized - ram_cache_bytes = %" PRId64 " = %" PRId64 "Mb",
-                ram_cache_bytes, ram_cache_bytes / (1024 * 1024));
-          CACHE_VOL_SUM_DYN_STAT(cache_ram_cache_bytes_total_stat, (int64_t) vol_dirlen(gvol[i]));
-
-          vol_total_cache_bytes = gvol[i]->len - vol_dirlen(gvol[i]);
-          total_cache_bytes += vol_total_cache_bytes;
-          Debug("cache_init", "CacheProcessor::cacheInitialized - total_cache_bytes = %" PRId64 " = %" PRId64 "Mb",
-                total_cache_bytes, total_cache_bytes / (1024 * 1024));
-
-          CACHE_VOL_SUM_DYN_STAT(cache_bytes_total_stat, vol_total_cache_bytes);
-
-
-          vol_total_direntries = gvol[i]->buckets * gvol[i]->segments * DIR_DEPTH;
-          total_direntries += vol_total_direntries;
-          CACHE_VOL_SUM_DYN_STAT(cache_direntries_total_stat, vol_total_direntries);
-
-
-          vol_used_direntries = dir_entries_used(gvol[i]);
-          CACHE_VOL_SUM_DYN_STAT(cache_direntries_used_stat, vol_used_direntries);
-          used_direntries += vol_used_direntries;
-        }
-
-      } else {
+      if (cache_config_ram_cache_size != AUTO_SIZE_RAM_CACHE) {
         // we got configured memory size
         // TODO, should we check the available system memories, or you will
         //   OOM or swapout, that is not a good situation for the server
         Debug("cache_init", "CacheProcessor::cacheInitialized - %" PRId64 " != AUTO_SIZE_RAM_CACHE",
               cache_config_ram_cache_size);
-        int64_t http_ram_cache_size =
+        http_ram_cache_size =
           (theCache) ? (int64_t) (((double) theCache->cache_size / total_size) * cache_config_ram_cache_size) : 0;
         Debug("cache_init", "CacheProcessor::cacheInitialized - http_ram_cache_size = %" PRId64 " = %" PRId64 "Mb",
               http_ram_cache_size, http_ram_cache_size / (1024 * 1024));
-        int64_t stream_ram_cache_size = cache_config_ram_cache_size - http_ram_cache_size;
+        stream_ram_cache_size = cache_config_ram_cache_size - http_ram_cache_size;
         Debug("cache_init", "CacheProcessor::cacheInitialized - stream_ram_cache_size = %" PRId64 " = %" PRId64 "Mb",
               stream_ram_cache_size, stream_ram_cache_size / (1024 * 1024));
 
         // Dump some ram_cache size information in debug mode.
         Debug("ram_cache", "config: size = %" PRId64 ", cutoff = %" PRId64 "",
               cache_config_ram_cache_size, cache_config_ram_cache_cutoff);
+      } else
+        Debug("cache_init", "CacheProcessor::cacheInitialized - cache_config_ram_cache_size == AUTO_SIZE_RAM_CACHE");
 
-        for (i = 0; i < gnvol; i++) {
-          vol = gvol[i];
-          double factor;
-          if (gvol[i]->cache == theCache) {
-            factor = (double) (int64_t) (gvol[i]->len >> STORE_BLOCK_SHIFT) / (int64_t) theCache->cache_size;
-            Debug("cache_init", "CacheProcessor::cacheInitialized - factor = %f", factor);
-            gvol[i]->ram_cache->init((int64_t) (http_ram_cache_size * factor), vol);
-            ram_cache_bytes += (int64_t) (http_ram_cache_size * factor);
-            CACHE_VOL_SUM_DYN_STAT(cache_ram_cache_bytes_total_stat, (int64_t) (http_ram_cache_size * factor));
-          } else {
-            factor = (double) (int64_t) (gvol[i]->len >> STORE_BLOCK_SHIFT) / (int64_t) theStreamCache->cache_size;
-            Debug("cache_init", "CacheProcessor::cacheInitialized - factor = %f", factor);
-            gvol[i]->ram_cache->init((int64_t) (stream_ram_cache_size * factor), vol);
-            ram_cache_bytes += (int64_t) (stream_ram_cache_size * factor);
-            CACHE_VOL_SUM_DYN_STAT(cache_ram_cache_bytes_total_stat, (int64_t) (stream_ram_cache_size * factor));
-          }
-          Debug("cache_init", "CacheProcessor::cacheInitialized[%d] - ram_cache_bytes = %" PRId64 " = %" PRId64 "Mb",
-                i, ram_cache_bytes, ram_cache_bytes / (1024 * 1024));
-#if TS_USE_INTERIM_CACHE == 1
-          gvol[i]->history.init(1<<20, 2097143);
-#endif
-          vol_total_cache_bytes = gvol[i]->len - vol_dirlen(gvol[i]);
-          total_cache_bytes += vol_total_cache_bytes;
-          CACHE_VOL_SUM_DYN_STAT(cache_bytes_total_stat, vol_total_cache_bytes);
-          Debug("cache_init", "CacheProcessor::cacheInitialized - total_cache_bytes = %" PRId64 " = %" PRId64 "Mb",
-                total_cache_bytes, total_cache_bytes / (1024 * 1024));
-
-          vol_total_direntries = gvol[i]->buckets * gvol[i]->segments * DIR_DEPTH;
-          total_direntries += vol_total_direntries;
-          CACHE_VOL_SUM_DYN_STAT(cache_direntries_total_stat, vol_total_direntries);
-
-
-          vol_used_direntries = dir_entries_used(gvol[i]);
-          CACHE_VOL_SUM_DYN_STAT(cache_direntries_used_stat, vol_used_direntries);
-          used_direntries += vol_used_direntries;
-
-        }
+      for (i = 0; i < gnvol; i++) {
+        ram_cache_bytes += vol_init_ram_cache(gvol[i], &total_cache_bytes, &total_direntries, &used_direntries);
+        Debug("cache_init", "CacheProcessor::cacheInitialized[%d] - ram_cache_bytes = %" PRId64 " = %" PRId64 "Mb",
+              i, ram_cache_bytes, ram_cache_bytes / (1024 * 1024));
+        Debug("cache_init", "CacheProcessor::cacheInitialized - total_cache_bytes = %" PRId64 " = %" PRId64 "Mb",
+              total_cache_bytes, total_cache_bytes / (1024 * 1024));
       }
       switch (cache_config_ram_cache_compress) {
         default:
@@ -1074,6 +1134,8 @@ CacheProcessor::cacheInitialized()
     CacheProcessor::initialized = CACHE_INITIALIZED;
     CacheProcessor::cache_ready = caches_ready;
     Note("cache enabled");
+    if (cache_config_ram_cache_snapshot)
+      ram_cache_snapshot_load();
 #ifdef CLUSTER_CACHE
     if (!(start_internal_flags & PROCESSOR_RECONFIGURE)) {
       CacheContinuation::init();
@@ -1160,6 +1222,14 @@ vol_init_dir(Vol *d)
       }
     }
   }
+  vol_reset_tag_summary(d);
+}
+
+// until a bucket is probed its summary admits every tag
+void
+vol_reset_tag_summary(Vol *d)
+{
+  memset(d->tag_summary, 0xff, d->segments * d->buckets * sizeof(uint16_t));
 }
 
 void
@@ -1178,6 +1248,7 @@ vol_clear_init(Vol *d)
   d->header->create_time = time(NULL);
   d->header->dirty = 0;
   d->sector_size = d->header->sector_size = d->disk->hw_sector_size;
+  d->header->key_hash = ink_code_key_hash;
   *d->footer = *d->header;
 }
 
@@ -1245,10 +1316,33 @@ Vol::init(char *s, off_t blocks, off_t dir_skip, bool clear)
 
   Debug("cache_init", "allocating %zu directory bytes for a %lld byte volume (%lf%%)",
     vol_dirlen(this), (long long)this->len, (double)vol_dirlen(this) / (double)this->len * 100.0);
-  raw_dir = (char *)ats_memalign(ats_pagesize(), vol_dirlen(this));
+  // the directory is probed at random, huge pages save most of the TLB misses
+  raw_dir = NULL;
+  if (ats_hugepage_enabled())
+    raw_dir = (char *)ats_alloc_hugepage(vol_dirlen(this));
+  if (!raw_dir)
+    raw_dir = (char *)ats_memalign(ats_pagesize(), vol_dirlen(this));
+  // on the node of the disk's AIO threads, spreading the directories over the nodes
+  if (eventProcessor.numa_nodes > 1 && fd >= 0 &&
+      !ink_numa_bind_area(raw_dir, vol_dirlen(this), fd % eventProcessor.numa_nodes))
+    Warning("unable to bind the directory of '%s' to NUMA node %d", hash_id, fd % eventProcessor.numa_nodes);
   dir = (Dir *) (raw_dir + vol_headerlen(this));
   header = (VolHeaderFooter *) raw_dir;
   footer = (VolHeaderFooter *) (raw_dir + vol_dirlen(this) - ROUND_TO_STORE_BLOCK(sizeof(VolHeaderFooter)));
+  tag_summary = (uint16_t *)ats_malloc(segments * buckets * sizeof(uint16_t));
+  vol_reset_tag_summary(this);
+  segment_dirty = (uint8_t *)ats_malloc(segments);
+  memset(segment_dirty, DIR_SYNC_STALE_ALL, segments);
+  segment_seq = (volatile int32_t *)ats_malloc(segments * sizeof(int32_t));
+  memset((void *)segment_seq, 0, segments * sizeof(int32_t));
+  if (cache_config_admission_policy == 1 && !admission) {
+    admission = new_CacheAdmissionSketch();
+    admission->init(vol_direntries(this), this);
+  }
+  if (cache_config_dedup_entries > 0 && !dedup) {
+    dedup_entries = cache_config_dedup_entries;
+    dedup = (CacheDedupEntry *)ats_calloc(dedup_entries, sizeof(CacheDedupEntry));
+  }
 
   if (clear) {
     Note("clearing cache directory '%s'", hash_id);
@@ -1291,7 +1385,7 @@ Vol::init(char *s, off_t blocks, off_t dir_skip, bool clear)
     aio->thread = AIO_CALLBACK_THREAD_ANY;
     aio->then = (i < 3) ? &(init_info->vol_aio[i + 1]) : 0;
   }
-#if AIO_MODE == AIO_MODE_NATIVE
+#if AIO_MODE == AIO_MODE_NATIVE || AIO_MODE == AIO_MODE_IO_URING
   ink_assert(ink_aio_readv(init_info->vol_aio));
 #else
   ink_assert(ink_aio_read(init_info->vol_aio));
@@ -1347,7 +1441,17 @@ Vol::handle_dir_read(int event, void *data)
     clear_dir();
     return EVENT_DONE;
   }
+  if (header->key_hash != (uint32_t) ink_code_key_hash) {
+    Warning("cache directory for '%s' was built with key hash %u, not %d, clearing", hash_id, header->key_hash,
+            ink_code_key_hash);
+    Note("clearing cache directory '%s'", hash_id);
+    clear_dir();
+    return EVENT_DONE;
+  }
   CHECK_DIR(this);
+  vol_reset_tag_summary(this);
+  // at most one copy on disk matches what was read
+  memset(segment_dirty, DIR_SYNC_STALE_ALL, segments);
 #if TS_USE_INTERIM_CACHE == 1
   if (gn_interim_disks > 0)
     clear_interim_dir(this);
@@ -1431,7 +1535,7 @@ Vol::handle_recover_from_data(int event, void * /* data ATS_UNUSED */ )
          that all documents have write_serial <= header->write_serial.
        */
       uint32_t to_check = header->write_pos - header->last_write_pos;
-      ink_assert(to_check && to_check < (uint32_t)io.aiocb.aio_nbytes);
+      ink_assert(to_check);
       uint32_t done = 0;
       s = (char *) io.aiocb.aio_buf;
       while (done < to_check) {
@@ -1446,10 +1550,21 @@ Vol::handle_recover_from_data(int event, void * /* data ATS_UNUSED */ )
       }
       ink_assert(done == to_check);
 
-      got_len = io.aiocb.aio_nbytes - done;
-      recover_pos += io.aiocb.aio_nbytes;
-      s = (char *) io.aiocb.aio_buf + done;
-      e = s + got_len;
+      if (done >= (uint32_t)io.aiocb.aio_nbytes) {
+        // the last write was one fragment larger than the read
+        got_len = 0;
+        recover_pos += done;
+        if (recover_pos >= skip + len)
+          recover_pos = start;
+        io.aiocb.aio_nbytes = RECOVERY_SIZE;
+        if ((off_t)(recover_pos + io.aiocb.aio_nbytes) > (off_t)(skip + len))
+          io.aiocb.aio_nbytes = (skip + len) - recover_pos;
+      } else {
+        got_len = io.aiocb.aio_nbytes - done;
+        recover_pos += io.aiocb.aio_nbytes;
+        s = (char *) io.aiocb.aio_buf + done;
+        e = s + got_len;
+      }
     } else {
       got_len = io.aiocb.aio_nbytes;
       recover_pos += io.aiocb.aio_nbytes;
@@ -1550,8 +1665,8 @@ Vol::handle_recover_from_data(int event, void * /* data ATS_UNUSED */ )
        read more data off disk and continue recovering */
     if (s >= e) {
       /* In the last iteration, we increment s by doc->len...need to undo
-         that change */
-      if (s > e)
+         that change, unless the fragment is larger than the whole read */
+      if (s > e && (char *) doc != (char *) io.aiocb.aio_buf)
         s -= round_to_approx_size(doc->len);
       recover_pos -= e - s;
       if (recover_pos >= skip + len)
@@ -1628,7 +1743,7 @@ Ldone:{
     init_info->vol_aio[2].aiocb.aio_offset = ss + dirlen - footerlen;
 
     SET_HANDLER(&Vol::handle_recover_write_dir);
-#if AIO_MODE == AIO_MODE_NATIVE
+#if AIO_MODE == AIO_MODE_NATIVE || AIO_MODE == AIO_MODE_IO_URING
     ink_assert(ink_aio_writev(init_info->vol_aio));
 #else
     ink_assert(ink_aio_write(init_info->vol_aio));
@@ -1719,9 +1834,25 @@ Vol::dir_init_done(int /* event ATS_UNUSED */, void * /* data ATS_UNUSED */ )
     eventProcessor.schedule_in(this, HRTIME_MSECONDS(5), ET_CALL);
     return EVENT_CONT;
   } else {
-    int vol_no = ink_atomic_increment(&gnvol, 1);
-    ink_assert(!gvol[vol_no]);
-    gvol[vol_no] = this;
+    ink_scoped_mutex lock(vol_online_lock);
+    int64_t msec = (ink_get_hrtime() - cache_start_time) / HRTIME_MSECOND;
+    Debug("cache_init", "directory of '%s' ready after %" PRId64 " ms", hash_id, msec);
+    RecSetGlobalRawStatSum(cache_rsb, cache_startup_msec_stat, msec);
+    RecSetGlobalRawStatSum(cache_vol->vol_rsb, cache_startup_msec_stat, msec);
+    online = true;
+    // the cache is already serving, this volume joins it
+    if (CacheProcessor::IsCacheEnabled() == CACHE_INITIALIZED) {
+      uint64_t cache_bytes = 0, direntries = 0, used_direntries = 0;
+      int64_t ram_cache_bytes = vol_init_ram_cache(this, &cache_bytes, &direntries, &used_direntries);
+      GLOBAL_CACHE_SUM_GLOBAL_DYN_STAT(cache_ram_cache_bytes_total_stat, ram_cache_bytes);
+      GLOBAL_CACHE_SUM_GLOBAL_DYN_STAT(cache_bytes_total_stat, cache_bytes);
+      GLOBAL_CACHE_SUM_GLOBAL_DYN_STAT(cache_direntries_total_stat, direntries);
+      GLOBAL_CACHE_SUM_GLOBAL_DYN_STAT(cache_direntries_used_stat, used_direntries);
+    }
+    // the slot is filled before it is counted, readers of gvol do not lock
+    ink_assert(!gvol[gnvol]);
+    gvol[gnvol] = this;
+    ink_atomic_increment(&gnvol, 1);
     SET_HANDLER(&Vol::aggWrite);
     if (fd == -1)
       cache->vol_initialized(0);
@@ -1748,6 +1879,51 @@ cmprtable(const void *aa, const void *bb) {
   return 0;
 }
 
+static inline uint64_t
+rendezvous_mix(uint64_t x)
+{
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return x;
+}
+
+// Weighted rendezvous hashing: each bucket goes to the volume scoring
+// highest on weight / -ln(u), u being a hash of the bucket and the volume's
+// hash id.  A volume going offline only gives up its own buckets and one
+// coming back only takes those back, so ~1/N of the keys move, and each
+// volume wins buckets in proportion to its size.
+static void
+build_vol_rendezvous_table(unsigned short *ttable, unsigned int *gotvol, Vol **p, unsigned int *mapping, int num_vols)
+{
+  uint64_t *seed = (uint64_t *)ats_malloc(sizeof(uint64_t) * num_vols);
+  double *weight = (double *)ats_malloc(sizeof(double) * num_vols);
+
+  for (int i = 0; i < num_vols; i++) {
+    seed[i] = p[i]->hash_id_md5.fold();
+    weight[i] = (double)(p[i]->len >> STORE_BLOCK_SHIFT);
+  }
+  for (int j = 0; j < VOL_HASH_TABLE_SIZE; j++) {
+    double best = -1.0;
+    int winner = 0;
+    for (int i = 0; i < num_vols; i++) {
+      uint64_t h = rendezvous_mix(seed[i] ^ rendezvous_mix((uint64_t)j + 1));
+      double u = ((double)(h >> 11) + 0.5) / (double)(1ULL << 53);  // in (0, 1)
+      double score = weight[i] / -log(u);
+      if (score > best) {
+        best = score;
+        winner = i;
+      }
+    }
+    ttable[j] = mapping[winner];
+    gotvol[winner]++;
+  }
+  ats_free(seed);
+  ats_free(weight);
+}
+
 void
 build_vol_hash_table(CacheHostRecord *cp)
 {
@@ -1763,7 +1939,7 @@ build_vol_hash_table(CacheHostRecord *cp)
   uint64_t used = 0;
   // initialize number of elements per vol
   for (int i = 0; i < num_vols; i++) {
-    if (DISK_BAD(cp->vols[i]->disk)) {
+    if (DISK_BAD(cp->vols[i]->disk) || !cp->vols[i]->online) {
       bad_vols++;
       continue;
     }
@@ -1804,35 +1980,40 @@ build_vol_hash_table(CacheHostRecord *cp)
   int extra = VOL_HASH_TABLE_SIZE - used;
   for (int i = 0; i < extra; i++)
     forvol[i % num_vols]++;
-  // seed random number generator
-  for (int i = 0; i < num_vols; i++) {
-    uint64_t x = p[i]->hash_id_md5.fold();
-    rnd[i] = (unsigned int) x;
-  }
-  // initialize table to "empty"
-  for (int i = 0; i < VOL_HASH_TABLE_SIZE; i++)
-    ttable[i] = VOL_HASH_EMPTY;
-  // generate random numbers proportaion to allocation
-  rtable_pair *rtable = (rtable_pair *)ats_malloc(sizeof(rtable_pair) * rtable_size);
-  int rindex = 0;
-  for (int i = 0; i < num_vols; i++)
-    for (int j = 0; j < (int)rtable_entries[i]; j++) {
-      rtable[rindex].rval = next_rand(&rnd[i]);
-      rtable[rindex].vol = i;
-      rindex++;
-    }
-  ink_assert(rindex == (int)rtable_size);
-  // sort (rand #, vol $ pairs)
-  qsort(rtable, rtable_size, sizeof(rtable_pair), cmprtable);
-  unsigned int width = (1LL << 32) / VOL_HASH_TABLE_SIZE;
-  unsigned int pos = width / 2;  // target position to allocate
-  // select vol with closest random number for each bucket
-  int i = 0;  // index moving through the random numbers
-  for (int j = 0; j < VOL_HASH_TABLE_SIZE; j++) {
-    pos = width / 2 + j * width;  // position to select closest to
-    while (pos > rtable[i].rval && i < (int)rtable_size - 1) i++;
-    ttable[j] = rtable[i].vol;
-    gotvol[ttable[j]]++;
+  if (cache_config_vol_hash_algorithm == 1) {
+    build_vol_rendezvous_table(ttable, gotvol, p, mapping, num_vols);
+  } else {
+    // seed random number generator
+    for (int i = 0; i < num_vols; i++) {
+      uint64_t x = p[i]->hash_id_md5.fold();
+      rnd[i] = (unsigned int) x;
+    }
+    // initialize table to "empty"
+    for (int i = 0; i < VOL_HASH_TABLE_SIZE; i++)
+      ttable[i] = VOL_HASH_EMPTY;
+    // generate random numbers proportaion to allocation
+    rtable_pair *rtable = (rtable_pair *)ats_malloc(sizeof(rtable_pair) * rtable_size);
+    int rindex = 0;
+    for (int i = 0; i < num_vols; i++)
+      for (int j = 0; j < (int)rtable_entries[i]; j++) {
+        rtable[rindex].rval = next_rand(&rnd[i]);
+        rtable[rindex].vol = i;
+        rindex++;
+      }
+    ink_assert(rindex == (int)rtable_size);
+    // sort (rand #, vol $ pairs)
+    qsort(rtable, rtable_size, sizeof(rtable_pair), cmprtable);
+    unsigned int width = (1LL << 32) / VOL_HASH_TABLE_SIZE;
+    unsigned int pos = width / 2;  // target position to allocate
+    // select vol with closest random number for each bucket
+    int i = 0;  // index moving through the random numbers
+    for (int j = 0; j < VOL_HASH_TABLE_SIZE; j++) {
+      pos = width / 2 + j * width;  // position to select closest to
+      while (pos > rtable[i].rval && i < (int)rtable_size - 1) i++;
+      ttable[j] = mapping[rtable[i].vol];
+      gotvol[rtable[i].vol]++;
+    }
+    ats_free(rtable);
   }
   for (int i = 0; i < num_vols; i++) {
     Debug("cache_init", "build_vol_hash_table %d request %d got %d", i, forvol[i], gotvol[i]);
@@ -1846,16 +2027,25 @@ build_vol_hash_table(CacheHostRecord *cp)
   ats_free(gotvol);
   ats_free(rnd);
   ats_free(rtable_entries);
-  ats_free(rtable);
   cp->vol_hash_table = ttable;
 }
 
+// Called under vol_online_lock as each volume finishes reading its
+// directory.  Unless proxy.config.cache.wait_for_all_volumes is set the
+// cache opens with the first good volume, and the others are added to
+// the volume hash tables as they come.
 void
 Cache::vol_initialized(bool result) {
   if (result)
     ink_atomic_increment(&total_good_nvol, 1);
-  if (total_nvol == ink_atomic_increment(&total_initialized_vol, 1) + 1)
-    open_done();
+  bool last = total_nvol == ink_atomic_increment(&total_initialized_vol, 1) + 1;
+  if (ready == CACHE_INITIALIZING) {
+    if (last || (result && !cache_config_wait_for_all_volumes))
+      open_done();
+  } else if (result && hosttable)
+    rebuild_host_table(this);
+  if (last && !cache_config_wait_for_all_volumes)
+    Note("%d of %d cache volumes online", total_good_nvol, total_nvol);
 }
 
 int
@@ -2020,11 +2210,7 @@ Cache::open(bool clear, bool /* fix ATS_UNUSED */) {
             blocks = q->b->len;
 
             bool vol_clear = clear || d->cleared || q->new_block;
-#if AIO_MODE == AIO_MODE_NATIVE
             eventProcessor.schedule_imm(NEW(new VolInit(cp->vols[vol_no], d->path, blocks, q->b->offset, vol_clear)));
-#else
-            cp->vols[vol_no]->init(d->path, blocks, q->b->offset, vol_clear);
-#endif
             vol_no++;
             cache_size += blocks;
           }
@@ -2059,7 +2245,7 @@ CacheVC::is_pread_capable()
 #define STORE_COLLISION 1
 
 #ifdef HTTP_CACHE
-static void unmarshal_helper(Doc *doc, Ptr<IOBufferData> &buf, int &okay) {
+void unmarshal_helper(Doc *doc, Ptr<IOBufferData> &buf, int &okay) {
   char *tmp = doc->hdr();
   int len = doc->hlen;
   while (len > 0) {
@@ -2116,6 +2302,15 @@ CacheVC::handleReadDone(int event, Event *e)
 #endif
     doc = (Doc *) buf->data();
 
+    if (f.sendfile_frag && doc->prefix_len() > (uint32_t) io.aio_result) {
+      // the header did not fit in the block we read, get the whole fragment
+      f.sendfile = 0;
+      io.aiocb.aio_nbytes = dir_approx_size(&dir);
+      if (handleRead(event, e) == EVENT_RETURN)
+        return handleEvent(AIO_EVENT_DONE, 0);
+      return EVENT_CONT;
+    }
+
     if (is_debug_tag_set("cache_read")) {
       char xt[33];
       Debug("cache_read",
@@ -2129,7 +2324,7 @@ CacheVC::handleReadDone(int event, Event *e)
       int okay = 1;
       if (!f.doc_from_ram_cache)
         f.not_from_ram_cache = 1;
-      if (cache_config_enable_checksum && doc->checksum != DOC_NO_CHECKSUM) {
+      if (cache_config_enable_checksum && doc->checksum != DOC_NO_CHECKSUM && !f.sendfile_frag) {
         // verify that the checksum matches
         uint32_t checksum = 0;
         for (char *b = doc->hdr(); b < (char *) doc + doc->len; b++)
@@ -2185,6 +2380,36 @@ CacheVC::handleReadDone(int event, Event *e)
 #else
     (void)e; // Avoid compiler warnings
 #endif
+#ifdef HTTP_CACHE
+      // deflated headers are inflated into a copy of the document, which
+      // is what the RAM cache and the readers get
+      if (okay && doc->hdr_deflated && !f.sendfile_frag) {
+        IOBufferData *plain = inflate_doc_hdr(doc);
+        if (plain) {
+          buf = plain;
+          doc = (Doc *) buf->data();
+        } else {
+          Note("cache: headers do not inflate for [%" PRIu64 " %" PRIu64 "] hlen %d, disk %s, offset %" PRIu64,
+               doc->first_key.b[0], doc->first_key.b[1], doc->hlen, vol->path, (uint64_t)io.aiocb.aio_offset);
+          doc->magic = DOC_CORRUPT;
+          okay = 0;
+        }
+      }
+#endif
+      // A small document comes in a buffer rounded up to the approximate
+      // size in the directory and to the sector size. Copy it down to its
+      // own size before it goes into the RAM cache, which charges the whole
+      // buffer, so that as many small documents fit as their bytes allow.
+      if (vio.op == VIO::READ && okay && !f.doc_from_ram_cache && !f.sendfile_frag) {
+        int64_t doc_index = iobuffer_size_to_index(doc->len, MAX_BUFFER_SIZE_INDEX);
+        if (BUFFER_SIZE_INDEX_IS_FAST_ALLOCATED(buf->_size_index) && BUFFER_SIZE_INDEX_IS_FAST_ALLOCATED(doc_index) &&
+            doc_index < buf->_size_index) {
+          IOBufferData *small_buf = new_IOBufferData(doc_index, MEMALIGNED);
+          memcpy(small_buf->data(), doc, doc->len);
+          buf = small_buf;
+          doc = (Doc *) buf->data();
+        }
+      }
       bool http_copy_hdr = false;
 #ifdef HTTP_CACHE
       http_copy_hdr = cache_config_ram_cache_compress && !f.doc_from_ram_cache &&
@@ -2195,7 +2420,7 @@ CacheVC::handleReadDone(int event, Event *e)
         unmarshal_helper(doc, buf, okay);
 #endif
       // Put the request in the ram cache only if its a open_read or lookup
-      if (vio.op == VIO::READ && okay) {
+      if (vio.op == VIO::READ && okay && !f.sendfile_frag) {
         bool cutoff_check;
         // cutoff_check :
         // doc_len == 0 for the first fragment (it is set from the vector)
@@ -2264,6 +2489,7 @@ CacheVC::handleRead(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
   cancel_trigger();
 
   f.doc_from_ram_cache = false;
+  f.sendfile_frag = false;
 
   // check ram cache
   ink_assert(vol->mutex->thread_holding == this_ethread());
@@ -2309,6 +2535,7 @@ LinterimRead:
     io.aiocb.aio_buf = buf->data();
     io.action = this;
     io.thread = mutex->thread_holding->tt == DEDICATED ? AIO_CALLBACK_THREAD_ANY : mutex->thread_holding;
+    io.io_class = AIO_CLASS_USER_READ;
 
     SET_HANDLER(&CacheVC::handleReadDone);
     ink_assert(ink_aio_read(&io) >= 0);
@@ -2318,11 +2545,11 @@ LinterimRead:
 #endif
   // see if its in the aggregation buffer
   if (dir_agg_buf_valid(vol, &dir)) {
-    int agg_offset = vol_offset(vol, &dir) - vol->header->write_pos;
+    off_t agg_offset = vol_offset(vol, &dir);
     buf = new_IOBufferData(iobuffer_size_to_index(io.aiocb.aio_nbytes, MAX_BUFFER_SIZE_INDEX), MEMALIGNED);
-    ink_assert((agg_offset + io.aiocb.aio_nbytes) <= (unsigned) vol->agg_buf_pos);
+    ink_assert((off_t)(agg_offset + io.aiocb.aio_nbytes) <= vol->agg_write_end());
     char *doc = buf->data();
-    char *agg = vol->agg_buffer + agg_offset;
+    char *agg = vol->agg_buf_data(agg_offset);
     memcpy(doc, agg, io.aiocb.aio_nbytes);
     io.aio_result = io.aiocb.aio_nbytes;
     SET_HANDLER(&CacheVC::handleReadDone);
@@ -2331,12 +2558,29 @@ LinterimRead:
 
   io.aiocb.aio_fildes = vol->fd;
   io.aiocb.aio_offset = vol_offset(vol, &dir);
+  // the target of a link is not read ahead, the fragments after the link are
+  if (read_ahead_queue.head && !f.read_link) {
+    int ret = adopt_read_ahead();
+    if (ret != EVENT_NONE)
+      return ret;
+  }
+  // for the later fragments of a document going to a socket only the
+  // header is read, the data is sent from the disk by the net layer
+  if (f.sendfile && doc_len && vol->disk->sendfile_fd >= 0 && vol_sendfile_valid(vol, &dir)
+#if TS_USE_INTERIM_CACHE == 1
+      && !mts
+#endif
+    ) {
+    f.sendfile_frag = true;
+    io.aiocb.aio_nbytes = ROUND_TO_SECTOR(vol, sizeofDoc);
+  }
   if ((off_t)(io.aiocb.aio_offset + io.aiocb.aio_nbytes) > (off_t)(vol->skip + vol->len))
     io.aiocb.aio_nbytes = vol->skip + vol->len - io.aiocb.aio_offset;
   buf = new_IOBufferData(iobuffer_size_to_index(io.aiocb.aio_nbytes, MAX_BUFFER_SIZE_INDEX), MEMALIGNED);
   io.aiocb.aio_buf = buf->data();
   io.action = this;
   io.thread = mutex->thread_holding->tt == DEDICATED ? AIO_CALLBACK_THREAD_ANY : mutex->thread_holding;
+  io.io_class = AIO_CLASS_USER_READ;
   SET_HANDLER(&CacheVC::handleReadDone);
   ink_assert(ink_aio_read(&io) >= 0);
   CACHE_DEBUG_INCREMENT_DYN_STAT(cache_pread_count_stat);
@@ -2872,6 +3116,10 @@ cplist_reconfigure()
       }
       gnvol += cp->num_vols;
     }
+
+    for (config_vol = config_volumes.cp_queue.head; config_vol; config_vol = config_vol->link.next)
+      if (config_vol->cachep)
+        config_vol->cachep->fragment_size = config_vol->fragment_size;
   }
   return 0;
 }
@@ -3017,14 +3265,17 @@ register_cache_stats(RecRawStatBlock *rsb, const char *prefix)
   REG_INT("read.active", cache_read_active_stat);
   REG_INT("read.success", cache_read_success_stat);
   REG_INT("read.failure", cache_read_failure_stat);
-#if TS_USE_INTERIM_CACHE == 1
-  REG_INT("interim.read.success", cache_interim_read_success_stat);
   REG_INT("disk.read.success", cache_disk_read_success_stat);
   REG_INT("ram.read.success", cache_ram_read_success_stat);
+#if TS_USE_INTERIM_CACHE == 1
+  REG_INT("interim.read.success", cache_interim_read_success_stat);
+  REG_INT("interim.migrate", cache_interim_migrate_stat);
+  REG_INT("interim.evict", cache_interim_evict_stat);
 #endif
   REG_INT("write.active", cache_write_active_stat);
   REG_INT("write.success", cache_write_success_stat);
   REG_INT("write.failure", cache_write_failure_stat);
+  REG_INT("write.not_admitted", cache_write_not_admitted_stat);
   REG_INT("write.backlog.failure", cache_write_backlog_failure_stat);
   REG_INT("update.active", cache_update_active_stat);
   REG_INT("update.success", cache_update_success_stat);
@@ -3035,6 +3286,10 @@ register_cache_stats(RecRawStatBlock *rsb, const char *prefix)
   REG_INT("evacuate.active", cache_evacuate_active_stat);
   REG_INT("evacuate.success", cache_evacuate_success_stat);
   REG_INT("evacuate.failure", cache_evacuate_failure_stat);
+  REG_INT("evacuate.bytes", cache_evacuate_bytes_stat);
+  REG_INT("evacuate.skipped_bytes", cache_evacuate_skipped_bytes_stat);
+  REG_INT("dedup.fragments", cache_dedup_fragments_stat);
+  REG_INT("dedup.bytes", cache_dedup_bytes_stat);
   REG_INT("scan.active", cache_scan_active_stat);
   REG_INT("scan.success", cache_scan_success_stat);
   REG_INT("scan.failure", cache_scan_failure_stat);
@@ -3045,13 +3300,23 @@ register_cache_stats(RecRawStatBlock *rsb, const char *prefix)
   REG_INT("frags_per_doc.2", cache_two_fragment_document_count_stat);
   REG_INT("frags_per_doc.3+", cache_three_plus_plus_fragment_document_count_stat);
   REG_INT("read_busy.success", cache_read_busy_success_stat);
+  REG_INT("read_busy.streaming", cache_read_busy_streaming_stat);
   REG_INT("read_busy.failure", cache_read_busy_failure_stat);
+  REG_INT("read_ahead.hits", cache_read_ahead_hit_stat);
+  REG_INT("read_ahead.wasted", cache_read_ahead_wasted_stat);
+  REG_INT("read.lock_retries", cache_read_lock_retry_stat);
+  REG_INT("read.nolock_misses", cache_read_nolock_miss_stat);
   REG_INT("write_bytes_stat", cache_write_bytes_stat);
   REG_INT("vector_marshals", cache_hdr_vector_marshal_stat);
   REG_INT("hdr_marshals", cache_hdr_marshal_stat);
   REG_INT("hdr_marshal_bytes", cache_hdr_marshal_bytes_stat);
+  REG_INT("hdr_deflated_bytes_saved", cache_hdr_deflated_bytes_saved_stat);
   REG_INT("gc_bytes_evacuated", cache_gc_bytes_evacuated_stat);
   REG_INT("gc_frags_evacuated", cache_gc_frags_evacuated_stat);
+  REG_INT("dir_sync.bytes", cache_dir_sync_bytes_stat);
+  REG_INT("dir_sync.segments", cache_dir_sync_segments_stat);
+  REG_INT("dir_sync.last_pass_bytes", cache_dir_sync_last_pass_bytes_stat);
+  REG_INT("startup_msec", cache_startup_msec_stat);
 }
 
 
@@ -3070,6 +3335,8 @@ ink_cache_init(ModuleVersion v)
   REC_EstablishStaticConfigInt32(cache_config_ram_cache_compress, "proxy.config.cache.ram_cache.compress");
   REC_EstablishStaticConfigInt32(cache_config_ram_cache_compress_percent, "proxy.config.cache.ram_cache.compress_percent");
   REC_EstablishStaticConfigInt32(cache_config_ram_cache_use_seen_filter, "proxy.config.cache.ram_cache.use_seen_filter");
+  REC_EstablishStaticConfigInt32(cache_config_ram_cache_snapshot, "proxy.config.cache.ram_cache.snapshot");
+  REC_EstablishStaticConfigInt32(cache_config_ram_cache_warm_rate, "proxy.config.cache.ram_cache.warm_rate");
 
   REC_EstablishStaticConfigInt32(cache_config_http_max_alts, "proxy.config.cache.limits.http.max_alts");
   Debug("cache_init", "proxy.config.cache.limits.http.max_alts = %d", cache_config_http_max_alts);
@@ -3083,6 +3350,8 @@ ink_cache_init(ModuleVersion v)
 
   REC_EstablishStaticConfigInt32(cache_config_dir_sync_frequency, "proxy.config.cache.dir.sync_frequency");
   Debug("cache_init", "proxy.config.cache.dir.sync_frequency = %d", cache_config_dir_sync_frequency);
+  REC_EstablishStaticConfigInteger(cache_config_dir_sync_max_rate, "proxy.config.cache.dir.sync_max_rate");
+  Debug("cache_init", "proxy.config.cache.dir.sync_max_rate = %" PRId64, cache_config_dir_sync_max_rate);
 
   REC_EstablishStaticConfigInt32(cache_config_vary_on_user_agent, "proxy.config.cache.vary_on_user_agent");
   Debug("cache_init", "proxy.config.cache.vary_on_user_agent = %d", cache_config_vary_on_user_agent);
@@ -3096,6 +3365,12 @@ ink_cache_init(ModuleVersion v)
 
   REC_EstablishStaticConfigInt32(cache_config_mutex_retry_delay, "proxy.config.cache.mutex_retry_delay");
   Debug("cache_init", "proxy.config.cache.mutex_retry_delay = %dms", cache_config_mutex_retry_delay);
+  REC_EstablishStaticConfigInt32(cache_config_wait_for_all_volumes, "proxy.config.cache.wait_for_all_volumes");
+  Debug("cache_init", "proxy.config.cache.wait_for_all_volumes = %d", cache_config_wait_for_all_volumes);
+  REC_EstablishStaticConfigInt32(cache_config_admission_policy, "proxy.config.cache.admission.policy");
+  Debug("cache_init", "proxy.config.cache.admission.policy = %d", cache_config_admission_policy);
+  REC_EstablishStaticConfigInt32(cache_config_admission_threshold, "proxy.config.cache.admission.threshold");
+  Debug("cache_init", "proxy.config.cache.admission.threshold = %d", cache_config_admission_threshold);
 
   // This is just here to make sure IOCORE "standalone" works, it's usually configured in RecordsConfig.cc
   RecRegisterConfigString(RECT_CONFIG, "proxy.config.config_dir", TS_BUILD_SYSCONFDIR, RECU_DYNAMIC, RECC_NULL, NULL);
@@ -3146,9 +3421,54 @@ ink_cache_init(ModuleVersion v)
   REC_EstablishStaticConfigInt32(cache_config_agg_write_backlog, "proxy.config.cache.agg_write_backlog");
   Debug("cache_init", "proxy.config.cache.agg_write_backlog = %d", cache_config_agg_write_backlog);
 
+  REC_ReadConfigInt32(cache_config_agg_write_size, "proxy.config.cache.agg_write_size");
+  if (cache_config_agg_write_size < AGG_SIZE / 4)
+    cache_config_agg_write_size = AGG_SIZE / 4;
+  if (cache_config_agg_write_size > AGG_SIZE)
+    cache_config_agg_write_size = AGG_SIZE;
+  cache_config_agg_write_size = INK_ALIGN(cache_config_agg_write_size, ats_pagesize());
+  Debug("cache_init", "proxy.config.cache.agg_write_size = %d", cache_config_agg_write_size);
+
+  // recovery only clears EVACUATION_SIZE past the last document found,
+  // which bounds the data that can be in flight out of order
+  REC_ReadConfigInt32(cache_config_agg_write_buffers, "proxy.config.cache.agg_write_buffers");
+  if (cache_config_agg_write_buffers < 1)
+    cache_config_agg_write_buffers = 1;
+  if (cache_config_agg_write_buffers > EVACUATION_SIZE / cache_config_agg_write_size)
+    cache_config_agg_write_buffers = EVACUATION_SIZE / cache_config_agg_write_size;
+  Debug("cache_init", "proxy.config.cache.agg_write_buffers = %d", cache_config_agg_write_buffers);
+
   REC_EstablishStaticConfigInt32(cache_config_enable_checksum, "proxy.config.cache.enable_checksum");
   Debug("cache_init", "proxy.config.cache.enable_checksum = %d", cache_config_enable_checksum);
 
+  REC_ReadConfigInt32(cache_config_sendfile, "proxy.config.cache.sendfile");
+  Debug("cache_init", "proxy.config.cache.sendfile = %d", cache_config_sendfile);
+
+  REC_ReadConfigInt32(cache_config_direct_io, "proxy.config.cache.direct_io");
+  Debug("cache_init", "proxy.config.cache.direct_io = %d", cache_config_direct_io);
+  REC_EstablishStaticConfigInt32(cache_config_compress_headers, "proxy.config.cache.compress_headers");
+
+  REC_ReadConfigInt32(cache_config_evacuate_min_frequency, "proxy.config.cache.evacuate.min_frequency");
+  Debug("cache_init", "proxy.config.cache.evacuate.min_frequency = %d", cache_config_evacuate_min_frequency);
+  REC_EstablishStaticConfigInt32(cache_config_evacuate_pin_margin, "proxy.config.cache.evacuate.pin_margin");
+  Debug("cache_init", "proxy.config.cache.evacuate.pin_margin = %d", cache_config_evacuate_pin_margin);
+  REC_ReadConfigInt32(cache_config_dedup_entries, "proxy.config.cache.dedup.entries");
+  Debug("cache_init", "proxy.config.cache.dedup.entries = %d", cache_config_dedup_entries);
+
+  REC_EstablishStaticConfigInt32(cache_config_read_ahead, "proxy.config.cache.read_ahead");
+  Debug("cache_init", "proxy.config.cache.read_ahead = %d", cache_config_read_ahead);
+
+  REC_EstablishStaticConfigInt32(cache_config_scan_parallel, "proxy.config.cache.scan.parallel");
+  Debug("cache_init", "proxy.config.cache.scan.parallel = %d", cache_config_scan_parallel);
+
+  REC_ReadConfigInt32(cache_config_vol_hash_algorithm, "proxy.config.cache.vol_hash_algorithm");
+  Debug("cache_init", "proxy.config.cache.vol_hash_algorithm = %d", cache_config_vol_hash_algorithm);
+
+  REC_ReadConfigInt32(ink_code_key_hash, "proxy.config.cache.key_hash");
+  if (ink_code_key_hash != INK_KEY_HASH_MD5 && ink_code_key_hash != INK_KEY_HASH_MMH3)
+    ink_code_key_hash = INK_KEY_HASH_MD5;
+  Debug("cache_init", "proxy.config.cache.key_hash = %d", ink_code_key_hash);
+
   REC_EstablishStaticConfigInt32(cache_config_alt_rewrite_max_size, "proxy.config.cache.alt_rewrite_max_size");
   Debug("cache_init", "proxy.config.cache.alt_rewrite_max_size = %d", cache_config_alt_rewrite_max_size);
 
@@ -3157,6 +3477,11 @@ ink_cache_init(ModuleVersion v)
   REC_RegisterConfigUpdateFunc("proxy.config.cache.enable_read_while_writer", update_cache_config, NULL);
   Debug("cache_init", "proxy.config.cache.enable_read_while_writer = %d", cache_config_read_while_writer);
 
+  REC_EstablishStaticConfigInteger(cache_config_read_while_writer_stream_max_size,
+                                   "proxy.config.cache.read_while_writer.stream_max_size");
+  Debug("cache_init", "proxy.config.cache.read_while_writer.stream_max_size = %" PRId64,
+        cache_config_read_while_writer_stream_max_size);
+
   register_cache_stats(cache_rsb, "proxy.process.cache");
 
   const char *err = NULL;
@@ -3212,7 +3537,7 @@ CacheProcessor::open_write(Continuation *cont, int expected_size, URL *url, bool
     Cache::generate_key(&url_md5, url, request);
     ClusterMachine *m = cluster_machine_at_depth(cache_hash(url_md5));
 
-    if (m) {
+    if (m && !cluster_near_cache_local(&url_md5)) {
       // Do remote open_write()
       INK_MD5 url_only_md5;
       Cache::generate_key(&url_only_md5, url, 0);
@@ -0,0 +1,60 @@
+/** @file
+
+  Admit documents to the disk cache on their second request.
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+// Most objects are requested once.  Writing them costs disk bandwidth and
+// pushes older, popular documents off the end of the cyclic volume.  This
+// policy counts write attempts in a frequency sketch and lets a document
+// through only once it has been missed proxy.config.cache.admission.threshold
+// times while the sketch remembers it.
+
+#include "P_Cache.h"
+#include "FrequencySketch.h"
+
+struct CacheAdmissionSketch: public CacheAdmission {
+  bool admit(INK_MD5 *key);
+  void init(int64_t objects, Vol *vol);
+
+  ink_mutex lock;
+  FrequencySketch sketch;
+
+  CacheAdmissionSketch() { ink_mutex_init(&lock, "CacheAdmissionSketch"); }
+  ~CacheAdmissionSketch() { ink_mutex_destroy(&lock); }
+};
+
+void
+CacheAdmissionSketch::init(int64_t objects, Vol *) {
+  // a word per four objects, the sketch ages after 2.5 volumes of misses
+  sketch.init(objects / 4);
+}
+
+bool
+CacheAdmissionSketch::admit(INK_MD5 *key) {
+  uint64_t k = key->fold();
+  ink_scoped_mutex l(lock);
+  sketch.increment(k);
+  return sketch.estimate(k) >= cache_config_admission_threshold;
+}
+
+CacheAdmission *new_CacheAdmissionSketch() {
+  return new CacheAdmissionSketch;
+}
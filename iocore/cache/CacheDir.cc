@@ -203,6 +203,7 @@ dir_bucket_loop_check(Dir *start_dir, Dir *seg)
 void
 dir_init_segment(int s, Vol *d)
 {
+  vol_dir_segment_begin(d, s);
   d->header->freelist[s] = 0;
   Dir *seg = dir_segment(s, d);
   int l, b;
@@ -213,6 +214,7 @@ dir_init_segment(int s, Vol *d)
       dir_free_entry(dir_bucket_row(bucket, l), s, d);
     }
   }
+  vol_dir_segment_end(d, s);
 }
 
 
@@ -300,6 +302,8 @@ dir_delete_entry(Dir *e, Dir *p, int s, Vol *d)
   Dir *seg = dir_segment(s, d);
   int no = dir_next(e);
   d->header->dirty = 1;
+  vol_dir_segment_dirty(d, s);
+  vol_dir_segment_begin(d, s);
   if (p) {
     unsigned int fo = d->header->freelist[s];
     unsigned int eo = dir_to_offset(e, seg);
@@ -314,12 +318,15 @@ dir_delete_entry(Dir *e, Dir *p, int s, Vol *d)
     if (n) {
       dir_assign(e, n);
       dir_delete_entry(n, e, s, d);
+      vol_dir_segment_end(d, s);
       return e;
     } else {
       dir_clear(e);
+      vol_dir_segment_end(d, s);
       return NULL;
     }
   }
+  vol_dir_segment_end(d, s);
   return dir_from_offset(no, seg);
 }
 
@@ -418,8 +425,14 @@ dir_clean_bucket(Dir *b, int s, InterimCacheVol *d)
       if (is_debug_tag_set("dir_clean"))
         Debug("dir_clean", "cleaning %p tag %X boffset %" PRId64 " b %p p %p l %d",
               e, dir_tag(e), dir_offset(e), b, p, dir_bucket_length(b, s, vol));
-      if (dir_offset(e))
+      if (dir_offset(e)) {
         CACHE_DEC_DIR_USED(vol->mutex);
+        // the main volume copy, if it is still there, serves the object again
+        if (dir_ininterim(e)) {
+          ProxyMutex *mutex = vol->mutex;
+          CACHE_INCREMENT_DYN_STAT(cache_interim_evict_stat);
+        }
+      }
       e = dir_delete_entry(e, p, s, vol);
       continue;
     }
@@ -477,6 +490,7 @@ freelist_clean(int s, Vol *vol)
   dir_clean_segment(s, vol);
   if (vol->header->freelist[s])
     return;
+  vol_dir_segment_begin(vol, s);
   Warning("cache directory overflow on '%s' segment %d, purging...", vol->path, s);
   int n = 0;
   Dir *seg = dir_segment(s, vol);
@@ -491,6 +505,7 @@ freelist_clean(int s, Vol *vol)
     }
   }
   dir_clean_segment(s, vol);
+  vol_dir_segment_end(vol, s);
 }
 
 inline Dir *
@@ -568,6 +583,17 @@ dir_free_entry(Dir *e, int s, Vol *d)
   if (fo)
     dir_set_prev(dir_from_offset(fo, seg), eo);
   d->header->freelist[s] = eo;
+  vol_dir_segment_dirty(d, s);
+}
+
+static inline uint16_t
+dir_bucket_tag_summary(Dir *b, Dir *seg)
+{
+  uint16_t summary = 0;
+  if (dir_offset(b))
+    for (Dir *e = b; e; e = next_dir(e, seg))
+      summary |= DIR_TAG_SUMMARY_BIT(dir_tag(e));
+  return summary;
 }
 
 int
@@ -584,6 +610,11 @@ dir_probe(CacheKey *key, Vol *d, Dir *result, Dir ** last_collision)
   if (dir_bucket_loop_fix(dir_bucket(b, seg), s, d))
     return 0;
 #endif
+  uint16_t *summary = &d->tag_summary[s * d->buckets + b];
+  if (!collision && !(*summary & DIR_TAG_SUMMARY_BIT(key->word(2)))) {
+    DDebug("dir_probe_miss", "missed %X %X on vol %d bucket %d at %p by summary", key->word(0), key->word(1), d->fd, b, seg);
+    return 0;
+  }
 Lagain:
   e = dir_bucket(b, seg);
   if (dir_offset(e))
@@ -631,18 +662,57 @@ Lagain:
     collision = NULL;
     goto Lagain;
   }
+  // the summary let this miss through, make it exact again
+  *summary = dir_bucket_tag_summary(dir_bucket(b, seg), seg);
   DDebug("dir_probe_miss", "missed %X %X on vol %d bucket %d at %p", key->word(0), key->word(1), d->fd, b, seg);
   CHECK_DIR(d);
   return 0;
 }
 
+// Probe for the first entry of 'key' without the volume lock.  Nothing is
+// changed: invalid entries are skipped rather than deleted.  Returns -1 if
+// the segment changed during the probe, in which case only dir_probe() with
+// the lock can tell, otherwise 1 for a hit and 0 for a miss.
+int
+dir_probe_nolock(CacheKey *key, Vol *d, Dir *result)
+{
+  int s = key->word(0) % d->segments;
+  int b = key->word(1) % d->buckets;
+  Dir *seg = dir_segment(s, d);
+  int32_t seq = d->segment_seq[s];
+  int found = 0;
+
+  if (seq & 1)
+    return -1;
+  __sync_synchronize();
+  if (d->tag_summary[s * d->buckets + b] & DIR_TAG_SUMMARY_BIT(key->word(2))) {
+    Dir *e = dir_bucket(b, seg);
+    // the links stay within the segment, but a chain read in the middle
+    // of a change may loop
+    int n = d->buckets * DIR_DEPTH;
+    if (dir_offset(e))
+      do {
+        if (dir_compare_tag(e, key) && dir_valid(d, e)) {
+          dir_assign(result, e);
+          found = 1;
+          break;
+        }
+        e = next_dir(e, seg);
+      } while (e && --n);
+  }
+  __sync_synchronize();
+  if (d->segment_seq[s] != seq)
+    return -1;
+  return found;
+}
+
 int
 dir_insert(CacheKey *key, Vol *d, Dir *to_part)
 {
   ink_assert(d->mutex->thread_holding == this_ethread());
   int s = key->word(0) % d->segments, l;
   int bi = key->word(1) % d->buckets;
-  ink_assert(dir_approx_size(to_part) <= MAX_FRAG_SIZE + sizeofDoc);
+  ink_assert(dir_approx_size(to_part) <= LARGE_FRAG_SIZE);
   Dir *seg = dir_segment(s, d);
   Dir *e = NULL;
   Dir *b = dir_bucket(bi, seg);
@@ -656,6 +726,7 @@ dir_insert(CacheKey *key, Vol *d, Dir *to_part)
   }
 #endif
   CHECK_DIR(d);
+  vol_dir_segment_begin(d, s);
 
 Lagain:
   // get from this row first
@@ -689,11 +760,14 @@ Lfill:
   dir_set_tag(e, key->word(2));
   ink_assert(vol_offset(d, e) < (d->skip + d->len));
 #endif
+  d->tag_summary[s * d->buckets + bi] |= DIR_TAG_SUMMARY_BIT(key->word(2));
   DDebug("dir_insert",
         "insert %p %X into vol %d bucket %d at %p tag %X %X boffset %" PRId64 "",
          e, key->word(0), d->fd, bi, e, key->word(1), dir_tag(e), dir_offset(e));
   CHECK_DIR(d);
+  vol_dir_segment_end(d, s);
   d->header->dirty = 1;
+  vol_dir_segment_dirty(d, s);
   CACHE_INC_DIR_USED(d->mutex);
   return 1;
 }
@@ -716,7 +790,8 @@ dir_overwrite(CacheKey *key, Vol *d, Dir *dir, Dir *overwrite, bool must_overwri
   Vol *vol = d;
   CHECK_DIR(d);
 
-  ink_assert((unsigned int) dir_approx_size(dir) <= (unsigned int) (MAX_FRAG_SIZE + sizeofDoc));        // XXX - size should be unsigned
+  ink_assert((unsigned int) dir_approx_size(dir) <= (unsigned int) LARGE_FRAG_SIZE);        // XXX - size should be unsigned
+  vol_dir_segment_begin(d, s);
 Lagain:
   // find entry to overwrite
   e = b;
@@ -739,8 +814,10 @@ Lagain:
         goto Lfill;
       e = next_dir(e, seg);
     } while (e);
-  if (must_overwrite)
+  if (must_overwrite) {
+    vol_dir_segment_end(d, s);
     return 0;
+  }
   res = 0;
   // get from this row first
   e = b;
@@ -766,12 +843,15 @@ Llink:
 Lfill:
   dir_assign_data(e, dir);
   dir_set_tag(e, t);
+  d->tag_summary[s * d->buckets + bi] |= DIR_TAG_SUMMARY_BIT(t);
   ink_assert(vol_offset(d, e) < d->skip + d->len);
   DDebug("dir_overwrite",
         "overwrite %p %X into vol %d bucket %d at %p tag %X %X boffset %" PRId64 "",
          e, key->word(0), d->fd, bi, e, t, dir_tag(e), dir_offset(e));
   CHECK_DIR(d);
+  vol_dir_segment_end(d, s);
   d->header->dirty = 1;
+  vol_dir_segment_dirty(d, s);
   return res;
 }
 
@@ -947,9 +1027,78 @@ CacheSync::aio_write(int fd, char *b, int n, off_t o)
   io.aiocb.aio_buf = b;
   io.action = this;
   io.thread = AIO_CALLBACK_THREAD_ANY;
+  io.io_class = AIO_CLASS_DIR_SYNC;
+  write_start = ink_get_hrtime();
   ink_assert(ink_aio_write(&io) >= 0);
 }
 
+// how long to wait after the last write to stay under
+// proxy.config.cache.dir.sync_max_rate
+ink_hrtime
+CacheSync::write_delay()
+{
+  if (cache_config_dir_sync_max_rate <= 0)
+    return SYNC_DELAY;
+  ink_hrtime delay = write_start + HRTIME_SECOND * (int64_t)io.aiocb.aio_nbytes / cache_config_dir_sync_max_rate -
+    ink_get_hrtime();
+  return delay > 0 ? delay : 0;
+}
+
+// Find the next run of segments which are part of the copy being written,
+// starting at byte 'pos' of the directory.  The run is rounded out to
+// whole store blocks, and returned as bytes [*start, *end).
+static bool
+dir_sync_next_run(Vol *d, off_t pos, off_t *start, off_t *end)
+{
+  off_t headerlen = vol_headerlen(d);
+  off_t bodyend = vol_dirlen(d) - ROUND_TO_STORE_BLOCK(sizeof(VolHeaderFooter));
+  off_t segbytes = d->buckets * DIR_DEPTH * SIZEOF_DIR;
+  int s = (int)((pos - headerlen) / segbytes);
+  while (s < d->segments && !(d->segment_dirty[s] & DIR_SYNC_WRITING))
+    s++;
+  if (s >= d->segments)
+    return false;
+  int e = s;
+  while (e < d->segments && (d->segment_dirty[e] & DIR_SYNC_WRITING))
+    e++;
+  *start = (headerlen + s * segbytes) & ~(off_t)(STORE_BLOCK_SIZE - 1);
+  if (*start < pos)
+    *start = pos;
+  *end = ROUND_TO_STORE_BLOCK(headerlen + e * segbytes);
+  if (*end > bodyend)
+    *end = bodyend;
+  return true;
+}
+
+// Take the segments which differ from the copy about to be written and
+// copy them, with the header and the footer, into the sync buffer.
+static int
+dir_sync_capture(Vol *d, char *buf)
+{
+  int copy = d->header->sync_serial & 1;
+  int n = 0;
+  for (int s = 0; s < d->segments; s++) {
+    uint8_t f = d->segment_dirty[s];
+    // a sync which failed leaves its segments behind, trust neither copy
+    if (f & DIR_SYNC_WRITING)
+      f |= DIR_SYNC_STALE_ALL;
+    if (f & DIR_SYNC_STALE(copy)) {
+      f = (f & ~DIR_SYNC_STALE(copy)) | DIR_SYNC_WRITING;
+      n++;
+    }
+    d->segment_dirty[s] = f;
+  }
+  off_t headerlen = vol_headerlen(d);
+  off_t footerlen = ROUND_TO_STORE_BLOCK(sizeof(VolHeaderFooter));
+  off_t dirlen = vol_dirlen(d);
+  memcpy(buf, d->raw_dir, headerlen);
+  off_t start, end;
+  for (off_t pos = headerlen; dir_sync_next_run(d, pos, &start, &end); pos = end)
+    memcpy(buf + start, d->raw_dir + start, end - start);
+  memcpy(buf + dirlen - footerlen, d->raw_dir + dirlen - footerlen, footerlen);
+  return n;
+}
+
 uint64_t
 dir_entries_used(Vol *d)
 {
@@ -976,6 +1125,78 @@ dir_entries_used(Vol *d)
   return full;
 }
 
+// Only one segment is copied at a time, so that looking at the whole
+// directory of a large volume never holds its lock for long.
+void
+dir_segment_snapshot(Vol *d, int s, DirSegmentSnapshot *snap)
+{
+  int n = d->buckets * DIR_DEPTH;
+  if (snap->size < n) {
+    snap->seg = (Dir *)ats_realloc(snap->seg, n * SIZEOF_DIR);
+    snap->size = n;
+  }
+  memcpy(snap->seg, dir_segment(s, d), n * SIZEOF_DIR);
+  snap->buckets = d->buckets;
+  snap->phase = d->header->phase;
+  snap->start = d->start;
+  snap->end = d->skip + d->len;
+  snap->write_pos = d->header->write_pos;
+  snap->agg_pos = d->header->agg_pos;
+  snap->valid_end = d->agg_write_end();
+}
+
+// The same tests as dir_valid(), on the state kept in the snapshot.
+void
+dir_segment_snapshot_account(DirSegmentSnapshot *snap, DirSnapshotStats *stats)
+{
+  Dir *seg = snap->seg;
+  off_t data_len = snap->end - snap->start;
+
+  stats->entries += snap->buckets * DIR_DEPTH;
+  stats->data_bytes = data_len;
+  for (int b = 0; b < snap->buckets; b++) {
+    Dir *e = dir_bucket(b, seg);
+    int chain = 0;
+    if (!dir_bucket_loop_check(e, seg))
+      continue;
+    for (; e; e = next_dir(e, seg)) {
+      if (!dir_offset(e))
+        continue;
+      chain++;
+      stats->used++;
+#if TS_USE_INTERIM_CACHE == 1
+      if (dir_ininterim(e)) {
+        stats->valid++;
+        continue;
+      }
+#endif
+      int64_t block = dir_offset(e) - 1;
+      off_t pos = snap->start + block * CACHE_BLOCK_SIZE;
+      off_t age;
+      if ((int)dir_phase(e) == snap->phase) {
+        if (block >= (snap->valid_end - snap->start) / CACHE_BLOCK_SIZE) {
+          stats->stale++;
+          continue;
+        }
+        age = pos < snap->write_pos ? snap->write_pos - pos : 0;
+      } else {
+        if (block < (snap->agg_pos - snap->start) / CACHE_BLOCK_SIZE) {
+          stats->stale++;
+          continue;
+        }
+        age = (snap->write_pos - snap->start) + (snap->end - pos);
+      }
+      stats->valid++;
+      if (dir_head(e))
+        stats->heads++;
+      stats->valid_bytes += dir_approx_size(e);
+      int i = data_len > 0 ? (int)(age * DIR_SNAPSHOT_AGES / data_len) : 0;
+      stats->age[i < DIR_SNAPSHOT_AGES ? i : DIR_SNAPSHOT_AGES - 1]++;
+    }
+    stats->chain[chain < DIR_SNAPSHOT_CHAINS ? chain : DIR_SNAPSHOT_CHAINS - 1]++;
+  }
+}
+
 /*
  * this function flushes the cache meta data to disk when
  * the cache is shutdown. Must *NOT* be used during regular
@@ -1015,6 +1236,24 @@ sync_cache_dir_on_shutdown(void)
     // check if we have data in the agg buffer
     // dont worry about the cachevc s in the agg queue
     // directories have not been inserted for these writes
+    // the writes still in flight go down first, in order
+    for (; d->agg_inflight; d->agg_inflight--) {
+      AggBuffer *b = &d->agg_bufs[d->agg_head];
+      int n = b->io.aiocb.aio_nbytes;
+      Debug("cache_dir_sync", "Dir %s: flushing agg buffer in flight", d->hash_id);
+      if (pwrite(d->fd, (char *) b->io.aiocb.aio_buf, n, d->header->write_pos) != n) {
+        ink_assert(!"flusing agg buffer failed");
+        break;
+      }
+      b->in_flight = false;
+      d->agg_inflight_bytes -= n;
+      d->agg_head = (d->agg_head + 1) % d->agg_nbufs;
+      d->header->last_write_pos = d->header->write_pos;
+      d->header->write_pos += n;
+      d->header->write_serial++;
+    }
+    if (d->agg_inflight)
+      continue;
     if (d->agg_buf_pos) {
       Debug("cache_dir_sync", "Dir %s: flushing agg buffer first", d->hash_id);
 
@@ -1079,6 +1318,9 @@ sync_cache_dir_on_shutdown(void)
   Debug("cache_dir_sync", "sync done");
   if (buf)
     ats_memalign_free(buf);
+  // the volume locks are still held
+  if (cache_config_ram_cache_snapshot)
+    ram_cache_snapshot_save();
 }
 
 
@@ -1099,7 +1341,9 @@ Lrestart:
       buf = 0;
       buflen = 0;
     }
-    Debug("cache_dir_sync", "sync done");
+    RecSetGlobalRawStatSum(cache_rsb, cache_dir_sync_last_pass_bytes_stat, pass_bytes);
+    Debug("cache_dir_sync", "sync done, %" PRId64 " bytes", pass_bytes);
+    pass_bytes = 0;
     if (event == EVENT_INTERVAL)
       trigger = e->ethread->schedule_in(this, HRTIME_SECONDS(cache_config_dir_sync_frequency));
     else
@@ -1113,7 +1357,10 @@ Lrestart:
       event = EVENT_NONE;
       goto Ldone;
     }
-    trigger = eventProcessor.schedule_in(this, SYNC_DELAY);
+    vol_bytes += io.aiocb.aio_nbytes;
+    RecIncrGlobalRawStatSum(cache_rsb, cache_dir_sync_bytes_stat, io.aiocb.aio_nbytes);
+    RecIncrGlobalRawStatSum(gvol[vol]->cache_vol->vol_rsb, cache_dir_sync_bytes_stat, io.aiocb.aio_nbytes);
+    trigger = eventProcessor.schedule_in(this, write_delay());
     return EVENT_CONT;
   }
   {
@@ -1132,7 +1379,8 @@ Lrestart:
     if (DISK_BAD(d->disk))
       goto Ldone;
 
-    int headerlen = ROUND_TO_STORE_BLOCK(sizeof(VolHeaderFooter));
+    off_t headerlen = vol_headerlen(d);
+    off_t footerlen = ROUND_TO_STORE_BLOCK(sizeof(VolHeaderFooter));
     size_t dirlen = vol_dirlen(d);
     if (!writepos) {
       // start
@@ -1147,11 +1395,10 @@ Lrestart:
         Debug("cache_dir_sync", "Dir %s not dirty", d->hash_id);
         goto Ldone;
       }
-      if (d->is_io_in_progress() || d->agg_buf_pos) {
+      if (d->is_io_in_progress() || d->agg_inflight || d->agg_buf_pos) {
         Debug("cache_dir_sync", "Dir %s: waiting for agg buffer", d->hash_id);
         d->dir_sync_waiting = 1;
-        if (!d->is_io_in_progress())
-          d->aggWrite(EVENT_IMMEDIATE, 0);
+        d->aggWrite(EVENT_IMMEDIATE, 0);
 #if TS_USE_INTERIM_CACHE == 1
         for (int i = 0; i < d->num_interim_vols; i++) {
           if (!d->interim_vols[i].is_io_in_progress()) {
@@ -1173,29 +1420,37 @@ Lrestart:
       d->header->sync_serial++;
       d->footer->sync_serial = d->header->sync_serial;
       CHECK_DIR(d);
-      memcpy(buf, d->raw_dir, dirlen);
+      // only the segments changed since this copy was last written
+      int n = dir_sync_capture(d, buf);
+      Debug("cache_dir_sync", "Dir %s: %d of %d segments changed", d->hash_id, n, d->segments);
+      RecIncrGlobalRawStatSum(cache_rsb, cache_dir_sync_segments_stat, n);
+      RecIncrGlobalRawStatSum(d->cache_vol->vol_rsb, cache_dir_sync_segments_stat, n);
       d->dir_sync_in_progress = 1;
     }
     size_t B = d->header->sync_serial & 1;
     off_t start = d->skip + (B ? dirlen : 0);
+    off_t run_start, run_end;
 
     if (!writepos) {
       // write header
       aio_write(d->fd, buf + writepos, headerlen, start + writepos);
       writepos += headerlen;
-    } else if (writepos < (off_t)dirlen - headerlen) {
-      // write part of body
+    } else if (writepos < (off_t)dirlen - footerlen && dir_sync_next_run(d, writepos, &run_start, &run_end)) {
+      // write part of the changed segments
       int l = SYNC_MAX_WRITE;
-      if (writepos + l > (off_t)dirlen - headerlen)
-        l = dirlen - headerlen - writepos;
-      aio_write(d->fd, buf + writepos, l, start + writepos);
-      writepos += l;
+      if (run_start + l > run_end)
+        l = run_end - run_start;
+      aio_write(d->fd, buf + run_start, l, start + run_start);
+      writepos = run_start + l;
     } else if (writepos < (off_t)dirlen) {
-      ink_assert(writepos == (off_t)dirlen - headerlen);
       // write footer
-      aio_write(d->fd, buf + writepos, headerlen, start + writepos);
-      writepos += headerlen;
+      writepos = dirlen - footerlen;
+      aio_write(d->fd, buf + writepos, footerlen, start + writepos);
+      writepos += footerlen;
     } else {
+      // this copy is complete
+      for (int s = 0; s < d->segments; s++)
+        d->segment_dirty[s] &= ~DIR_SYNC_WRITING;
       d->dir_sync_in_progress = 0;
       goto Ldone;
     }
@@ -1203,6 +1458,9 @@ Lrestart:
   }
 Ldone:
   // done
+  RecSetGlobalRawStatSum(gvol[vol]->cache_vol->vol_rsb, cache_dir_sync_last_pass_bytes_stat, vol_bytes);
+  pass_bytes += vol_bytes;
+  vol_bytes = 0;
   writepos = 0;
   vol++;
   goto Lrestart;
@@ -1424,6 +1682,9 @@ EXCLUSIVE_REGRESSION_TEST(Cache_dir) (RegressionTest *t, int /* atype ATS_UNUSED
   int s = key.word(0) % d->segments, i, j;
   Dir *seg = dir_segment(s, d);
 
+  // only the changed segment is left to sync
+  memset(d->segment_dirty, 0, d->segments);
+
   // test insert
   rprintf(t, "insert test\n", free);
   int inserted = 0;
@@ -1439,6 +1700,12 @@ EXCLUSIVE_REGRESSION_TEST(Cache_dir) (RegressionTest *t, int /* atype ATS_UNUSED
   if ((unsigned int) (inserted - free) > 1)
     ret = REGRESSION_TEST_FAILED;
 
+  rprintf(t, "dirty segment test\n");
+  for (i = 0; i < d->segments; i++)
+    if (d->segment_dirty[i] != (i == s ? DIR_SYNC_STALE_ALL : 0))
+      ret = REGRESSION_TEST_FAILED;
+  memset(d->segment_dirty, DIR_SYNC_STALE_ALL, d->segments);
+
   // test delete
   rprintf(t, "delete test\n");
   for (i = 0; i < d->buckets; i++)
@@ -1566,3 +1833,50 @@ EXCLUSIVE_REGRESSION_TEST(Cache_dir) (RegressionTest *t, int /* atype ATS_UNUSED
   vol_dir_clear(d);
   *status = ret;
 }
+
+EXCLUSIVE_REGRESSION_TEST(Bench_dir_probe) (RegressionTest *t, int atype, int *status) {
+  if (atype < REGRESSION_TEST_EXTENDED) {
+    *status = REGRESSION_TEST_NOT_RUN;
+    return;
+  }
+  if ((CacheProcessor::IsCacheEnabled() != CACHE_INITIALIZED) || gnvol < 1) {
+    rprintf(t, "cache not ready/configured");
+    *status = REGRESSION_TEST_FAILED;
+    return;
+  }
+  Vol *d = gvol[0];
+  EThread *thread = this_ethread();
+  MUTEX_TRY_LOCK(lock, d->mutex, thread);
+  ink_release_assert(lock);
+  vol_dir_clear(d);
+
+  Dir dir;
+  dir_clear(&dir);
+  dir_set_head(&dir, true);
+  dir_set_offset(&dir, 1);
+
+  // half full, which is about where a busy cache runs
+  CacheKey key;
+  int n = vol_direntries(d) / 2, found = 0;
+  regress_rand_init(17);
+  for (int i = 0; i < n; i++) {
+    regress_rand_CacheKey(&key);
+    dir_insert(&key, d, &dir);
+  }
+
+  for (int miss = 0; miss <= 1; miss++) {
+    // the same sequence finds the keys inserted, the one after it misses
+    if (!miss)
+      regress_rand_init(17);
+    ink_hrtime start = ink_get_hrtime_internal();
+    for (int i = 0; i < n; i++) {
+      Dir *last_collision = 0;
+      regress_rand_CacheKey(&key);
+      found += dir_probe(&key, d, &dir, &last_collision);
+    }
+    rbench(t, miss ? "miss" : "hit", 1, n, ink_get_hrtime_internal() - start);
+  }
+  rprintf(t, "%d of %d found\n", found, n);
+  vol_dir_clear(d);
+  *status = REGRESSION_TEST_PASSED;
+}
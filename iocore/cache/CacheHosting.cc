@@ -684,6 +684,7 @@ ConfigVolumes::BuildListFromString(char *config_file_path, char *file_buf)
   CacheType scheme = CACHE_NONE_TYPE;
   int size = 0;
   int in_percent = 0;
+  int fragment_size = 0;
   const char *matcher_name = "[CacheVolition]";
 
   memset(volume_seen, 0, sizeof(volume_seen));
@@ -700,6 +701,7 @@ ConfigVolumes::BuildListFromString(char *config_file_path, char *file_buf)
   tmp = bufTok.iterFirst(&i_state);
   while (tmp != NULL) {
     state = PAIR_ZERO;
+    fragment_size = 0;
     line_num++;
 
     // skip all blank spaces at beginning of line
@@ -721,6 +723,7 @@ ConfigVolumes::BuildListFromString(char *config_file_path, char *file_buf)
         }
         configp->scheme = scheme;
         configp->size = size;
+        configp->fragment_size = fragment_size;
         configp->cachep = NULL;
         cp_queue.enqueue(configp);
         num_volumes++;
@@ -729,7 +732,8 @@ ConfigVolumes::BuildListFromString(char *config_file_path, char *file_buf)
         else
           num_stream_volumes++;
         Debug("cache_hosting",
-              "added volume=%d, scheme=%d, size=%d percent=%d\n", volume_number, scheme, size, in_percent);
+              "added volume=%d, scheme=%d, size=%d percent=%d fragment_size=%d\n",
+              volume_number, scheme, size, in_percent, fragment_size);
         break;
       }
 
@@ -848,6 +852,26 @@ ConfigVolumes::BuildListFromString(char *config_file_path, char *file_buf)
         state = DONE;
         break;
 
+      case DONE:
+        // optional, the largest fragment written to the volume
+        if (strcasecmp(tmp, "fragment_size")) {
+          state = INK_ERROR;
+          break;
+        }
+        tmp += 14;
+        fragment_size = atoi(tmp);
+        while (ParseRules::is_digit(*tmp))
+          tmp++;
+        if (*tmp == 'K' || *tmp == 'k') {
+          fragment_size *= 1024;
+          tmp++;
+        } else if (*tmp == 'M' || *tmp == 'm') {
+          fragment_size *= 1024 * 1024;
+          tmp++;
+        }
+        if (fragment_size < 1024 * 1024 || fragment_size > LARGE_FRAG_SIZE)
+          state = INK_ERROR;
+        break;
       }
 
       if (state == INK_ERROR || *tmp) {
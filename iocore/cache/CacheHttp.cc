@@ -24,6 +24,9 @@
 #include "ink_config.h"
 #include <string.h>
 #include "P_Cache.h"
+#if TS_HAS_LIBZ
+#include <zlib.h>
+#endif
 
 
 /*-------------------------------------------------------------------------
@@ -256,6 +259,124 @@ CacheHTTPInfoVector::get_handles(const char *buf, int length, RefCountObj * bloc
   return ((caddr_t) buf - (caddr_t) start);
 }
 
+/*-------------------------------------------------------------------------
+  Deflated headers of a Doc (Doc::hdr_deflated) are the length of the
+  marshalled vector, a uint32_t, followed by the vector deflated with
+  hdr_dictionary as the preset dictionary. Well known field names are
+  marshalled as indexes, the dictionary is mostly values and the names
+  which are not well known, the most common last.
+  -------------------------------------------------------------------------*/
+
+#if TS_HAS_LIBZ
+static const char hdr_dictionary[] =
+  "Timing-Allow-OriginX-Content-Type-Options: nosniffX-Frame-Options: SAMEORIGINX-XSS-Protection: 1; mode=block"
+  "Strict-Transport-Security: max-age=31536000; includeSubDomainsContent-Security-PolicyAccess-Control-Allow-Origin"
+  "Access-Control-Allow-CredentialsAccess-Control-Allow-HeadersAccess-Control-Expose-HeadersX-Forwarded-Proto"
+  "X-Forwarded-ForX-Real-IPX-Requested-With: XMLHttpRequestX-CacheX-Cache-HitsX-Served-ByX-Powered-By"
+  "Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/ Safari/537.36"
+  "Mozilla/5.0 (Macintosh; Intel Mac OS X 10_15_7) AppleWebKit/605.1.15 (KHTML, like Gecko) Version/ Mobile/"
+  "Mozilla/5.0 (iPhone; CPU iPhone OS  like Mac OS X) Firefox/Gecko/20100101 Edg/"
+  "text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8"
+  "en-US,en;q=0.9en-GB,en;q=0.5image/jpegimage/pngimage/gifimage/svg+xmlimage/x-icon"
+  "application/javascriptapplication/jsonapplication/octet-streamtext/javascripttext/css; charset=utf-8"
+  "font/woff2video/mp4audio/mpegtext/plaingzip, deflate, br, zstdbytesAccept-Encoding, Origin"
+  "; Path=/; Domain=.; Expires=; Max-Age=; HttpOnly; Secure; SameSite=Lax; SameSite=None"
+  "Mon, Tue, Wed, Thu, Fri, Sat, Sun,  Jan  Feb  Mar  Apr  May  Jun  Jul  Aug  Sep  Oct  Nov  Dec  GMT"
+  "no-store, no-cache, must-revalidateprivate, max-age=0public, max-age=s-maxage=immutable"
+  "W/\"keep-alivecloseAccept-Encodinghttp://https://www..com/.net/.org/index.html"
+  "text/html; charset=UTF-8text/html; charset=utf-8";
+
+static const int hdr_window_bits = 13;  // 8KB, the vectors are a few KB
+static const int hdr_mem_level = 5;
+
+/* Deflates the marshalled vector in from into to, returns the length
+   written or 0 if it does not fit. */
+int
+deflate_doc_hdr(char *to, int to_len, const char *from, int from_len)
+{
+  z_stream zs;
+  uint32_t raw_len = from_len;
+  int r;
+
+  if (to_len <= (int) sizeof(raw_len))
+    return 0;
+  memset(&zs, 0, sizeof(zs));
+  if (deflateInit2(&zs, Z_BEST_SPEED, Z_DEFLATED, hdr_window_bits, hdr_mem_level, Z_DEFAULT_STRATEGY) != Z_OK)
+    return 0;
+  deflateSetDictionary(&zs, (const Bytef *) hdr_dictionary, sizeof(hdr_dictionary) - 1);
+  memcpy(to, &raw_len, sizeof(raw_len));
+  zs.next_in = (Bytef *) from;
+  zs.avail_in = from_len;
+  zs.next_out = (Bytef *) to + sizeof(raw_len);
+  zs.avail_out = to_len - sizeof(raw_len);
+  r = deflate(&zs, Z_FINISH);
+  int len = sizeof(raw_len) + zs.total_out;
+  deflateEnd(&zs);
+  return r == Z_STREAM_END ? len : 0;
+}
+
+/* A copy of doc, whose headers are deflated, with them inflated and ready
+   to unmarshal. NULL if they do not inflate. */
+IOBufferData *
+inflate_doc_hdr(Doc *doc)
+{
+  z_stream zs;
+  uint32_t raw_len;
+  int r;
+
+  ink_assert(doc->hdr_deflated);
+  if (doc->hlen <= sizeof(raw_len))
+    return NULL;
+  memcpy(&raw_len, doc->hdr(), sizeof(raw_len));
+  if (!raw_len || raw_len > MAX_FRAG_SIZE)
+    return NULL;
+
+  uint32_t data_len = doc->data_len();
+  uint32_t len = sizeofDoc + raw_len + data_len;
+  Ptr<IOBufferData> d(new_IOBufferData(iobuffer_size_to_index(len, MAX_BUFFER_SIZE_INDEX), MEMALIGNED));
+  Doc *plain = (Doc *) d->data();
+
+  memset(&zs, 0, sizeof(zs));
+  if (inflateInit2(&zs, hdr_window_bits) != Z_OK)
+    return NULL;
+  zs.next_in = (Bytef *) doc->hdr() + sizeof(raw_len);
+  zs.avail_in = doc->hlen - sizeof(raw_len);
+  zs.next_out = (Bytef *) d->data() + sizeofDoc;
+  zs.avail_out = raw_len;
+  r = inflate(&zs, Z_FINISH);
+  if (r == Z_NEED_DICT && inflateSetDictionary(&zs, (const Bytef *) hdr_dictionary, sizeof(hdr_dictionary) - 1) == Z_OK)
+    r = inflate(&zs, Z_FINISH);
+  bool ok = r == Z_STREAM_END && zs.total_out == raw_len;
+  inflateEnd(&zs);
+  if (!ok)
+    return NULL;
+
+  memcpy(plain, doc, sizeofDoc);
+  plain->len = len;
+  plain->hlen = raw_len;
+  plain->hdr_deflated = 0;
+  plain->checksum = DOC_NO_CHECKSUM;
+  memcpy(plain->data(), doc->data(), data_len);
+  return d.to_ptr();
+}
+
+#else
+
+int
+deflate_doc_hdr(char * /* to ATS_UNUSED */, int /* to_len ATS_UNUSED */, const char * /* from ATS_UNUSED */,
+                int /* from_len ATS_UNUSED */)
+{
+  return 0;
+}
+
+IOBufferData *
+inflate_doc_hdr(Doc * /* doc ATS_UNUSED */)
+{
+  return NULL;
+}
+
+#endif // TS_HAS_LIBZ
+
 #else //HTTP_CACHE
 
 CacheHTTPInfoVector::CacheHTTPInfoVector()
@@ -33,6 +33,8 @@ struct ShowCacheInternal: public ShowCont
   int seg_index;
   CacheKey show_cache_key;
   CacheVC *cache_vc;
+  DirSegmentSnapshot snap;
+  DirSnapshotStats dir_stats;
 
 
   int showMain(int event, Event * e);
@@ -42,6 +44,8 @@ struct ShowCacheInternal: public ShowCont
   int showVolVolumes(int event, Event * e);
   int showSegments(int event, Event * e);
   int showSegSegment(int event, Event * e);
+  int showDirectory(int event, Event * e);
+  int showVolDirectory(int event, Event * e);
 #ifdef CACHE_STAT_PAGES
   int showConnections(int event, Event * e);
   int showVolConnections(int event, Event * e);
@@ -95,6 +99,8 @@ register_ShowCacheInternal(Continuation * c, HTTPHdr * h)
     SET_CONTINUATION_HANDLER(theshowcacheInternal, &ShowCacheInternal::showEvacuations);
   } else if (STREQ_PREFIX(path, "volumes")) {
     SET_CONTINUATION_HANDLER(theshowcacheInternal, &ShowCacheInternal::showVolumes);
+  } else if (STREQ_PREFIX(path, "directory")) {
+    SET_CONTINUATION_HANDLER(theshowcacheInternal, &ShowCacheInternal::showDirectory);
   }
 
   if (theshowcacheInternal->mutex->thread_holding)
@@ -112,10 +118,12 @@ ShowCacheInternal::showMain(int event, Event * e)
 #ifdef CACHE_STAT_PAGES
   CHECK_SHOW(show("<H3>Show <A HREF=\"./connections\">Connections</A></H3>\n"
                   "<H3>Show <A HREF=\"./evacuations\">Evacuations</A></H3>\n"
-                  "<H3>Show <A HREF=\"./volumes\">Volumes</A></H3>\n"));
+                  "<H3>Show <A HREF=\"./volumes\">Volumes</A></H3>\n"
+                  "<H3>Show <A HREF=\"./directory\">Directory</A></H3>\n"));
 #else
   CHECK_SHOW(show("<H3>Show <A HREF=\"./evacuations\">Evacuations</A></H3>\n"
-                  "<H3>Show <A HREF=\"./volumes\">Volumes</A></H3>\n"));
+                  "<H3>Show <A HREF=\"./volumes\">Volumes</A></H3>\n"
+                  "<H3>Show <A HREF=\"./directory\">Directory</A></H3>\n"));
 #endif
   return complete(event, e);
 }
@@ -340,5 +348,75 @@ ShowCacheInternal::showSegSegment(int event, Event * e)
 }
 
 
+// The directory of each volume is copied one segment per lock, and
+// looked at without it, so that the page does not stall the volumes.
+int
+ShowCacheInternal::showDirectory(int event, Event * e)
+{
+  CHECK_SHOW(begin("Cache Directory"));
+  CHECK_SHOW(show("<H3>Cache Directory</H3>\n"
+                  "<p>Age is how far behind the write position the data is, in tenths of the volume.\n"
+                  "Chains are the buckets by the number of entries they hold.</p>\n"
+                  "<table border=1><tr>"
+                  "<th>ID</th>"
+                  "<th>Entries</th>"
+                  "<th>Used</th>"
+                  "<th>Valid</th>" "<th>Stale</th>" "<th>Objects</th>" "<th>Fragments</th>" "<th>Fill %%</th>"));
+  for (int i = 0; i < DIR_SNAPSHOT_AGES; i++)
+    CHECK_SHOW(show("<th>Age %d</th>", i));
+  for (int i = 0; i < DIR_SNAPSHOT_CHAINS; i++)
+    CHECK_SHOW(show("<th>Chains %d%s</th>", i, i == DIR_SNAPSHOT_CHAINS - 1 ? "+" : ""));
+  CHECK_SHOW(show("</tr>\n"));
+
+  memset(&dir_stats, 0, sizeof(dir_stats));
+  seg_index = 0;
+  SET_HANDLER(&ShowCacheInternal::showVolDirectory);
+  CONT_SCHED_LOCK_RETRY_RET(this);
+}
+
+int
+ShowCacheInternal::showVolDirectory(int event, Event * e)
+{
+  Vol *p = gvol[vol_index];
+  {
+    CACHE_TRY_LOCK(lock, p->mutex, mutex->thread_holding);
+    if (!lock)
+      CONT_SCHED_LOCK_RETRY_RET(this);
+    dir_segment_snapshot(p, seg_index, &snap);
+  }
+  dir_segment_snapshot_account(&snap, &dir_stats);
+  if (++seg_index < p->segments) {
+    mutex->thread_holding->schedule_imm_local(this);
+    return EVENT_CONT;
+  }
+
+  DirSnapshotStats *s = &dir_stats;
+  CHECK_SHOW(show("<tr>" "<td>%s</td>"  // ID
+                  "<td>%" PRId64 "</td>" // entries
+                  "<td>%" PRId64 "</td>" // used
+                  "<td>%" PRId64 "</td>" // valid
+                  "<td>%" PRId64 "</td>" // stale
+                  "<td>%" PRId64 "</td>" // objects
+                  "<td>%" PRId64 "</td>" // fragments
+                  "<td>%.1f</td>",        // fill
+                  p->hash_id, s->entries, s->used, s->valid, s->stale, s->heads, s->valid - s->heads,
+                  s->data_bytes ? 100.0 * s->valid_bytes / s->data_bytes : 0.0));
+  for (int i = 0; i < DIR_SNAPSHOT_AGES; i++)
+    CHECK_SHOW(show("<td>%" PRId64 "</td>", s->age[i]));
+  for (int i = 0; i < DIR_SNAPSHOT_CHAINS; i++)
+    CHECK_SHOW(show("<td>%" PRId64 "</td>", s->chain[i]));
+  CHECK_SHOW(show("</tr>\n"));
+
+  memset(&dir_stats, 0, sizeof(dir_stats));
+  seg_index = 0;
+  vol_index++;
+  if (vol_index < gnvol)
+    CONT_SCHED_LOCK_RETRY(this);
+  else {
+    CHECK_SHOW(show("</table>\n"));
+    return complete(event, e);
+  }
+  return EVENT_CONT;
+}
 
 #endif // NON_MODULAR
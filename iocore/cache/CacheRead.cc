@@ -29,6 +29,21 @@
 
 #define READ_WHILE_WRITER 1
 
+// Called when the volume lock could not be taken for an open_read.  A key
+// which is not in the directory can be turned away without the lock, unless
+// a reader might follow a writer of the key, which needs the open directory.
+static inline bool
+vol_miss_nolock(Vol *vol, CacheKey *key)
+{
+  ProxyMutex *mutex = vol->mutex;
+  Dir result;
+
+  if (cache_config_read_while_writer || dir_probe_nolock(key, vol, &result) != 0)
+    return false;
+  CACHE_INCREMENT_DYN_STAT(cache_read_nolock_miss_stat);
+  return true;
+}
+
 Action *
 Cache::open_read(Continuation * cont, CacheKey * key, CacheFragType type, char *hostname, int host_len)
 {
@@ -45,6 +60,11 @@ Cache::open_read(Continuation * cont, CacheKey * key, CacheFragType type, char *
   CacheVC *c = NULL;
   {
     CACHE_TRY_LOCK(lock, vol->mutex, mutex->thread_holding);
+    if (!lock) {
+      CACHE_INCREMENT_DYN_STAT(cache_read_lock_retry_stat);
+      if (vol_miss_nolock(vol, key))
+        goto Lmiss;
+    }
     if (!lock || (od = vol->open_read(key)) || dir_probe(key, vol, &result, &last_collision)) {
       c = new_CacheVC(cont);
       SET_CONTINUATION_HANDLER(c, &CacheVC::openReadStartHead);
@@ -107,6 +127,11 @@ Cache::open_read(Continuation * cont, CacheKey * key, CacheHTTPHdr * request,
 
   {
     CACHE_TRY_LOCK(lock, vol->mutex, mutex->thread_holding);
+    if (!lock) {
+      CACHE_INCREMENT_DYN_STAT(cache_read_lock_retry_stat);
+      if (vol_miss_nolock(vol, key))
+        goto Lmiss;
+    }
     if (!lock || (od = vol->open_read(key)) || dir_probe(key, vol, &result, &last_collision)) {
       c = new_CacheVC(cont);
       c->first_key = c->key = c->earliest_key = *key;
@@ -356,7 +381,8 @@ CacheVC::openReadFromWriter(int event, Event * e)
     DDebug("cache_read_agg",
           "%p: key: %X writer: closed:%d, fragment:%d, retry: %d",
           this, first_key.word(1), write_vc->closed, write_vc->fragment, writer_lock_retry);
-    VC_SCHED_WRITER_RETRY();
+    if (cache_config_read_while_writer != 2)
+      VC_SCHED_WRITER_RETRY();
   }
 
   CACHE_TRY_LOCK(writer_lock, write_vc->mutex, mutex->thread_holding);
@@ -368,6 +394,15 @@ CacheVC::openReadFromWriter(int event, Event * e)
 
   if (!write_vc->io.ok())
     return openReadFromWriterFailure(CACHE_EVENT_OPEN_READ_FAILED, (Event *) - err);
+  // streaming needs the whole document so far still in memory, in the
+  // writer's buffer or, once fragments are on disk, held by its stream
+  bool stream_head = !write_vc->closed && write_vc->stream && write_vc->stream->head &&
+    cache_config_read_while_writer == 2 && frag_type == CACHE_FRAG_TYPE_HTTP;
+  bool streaming = stream_head || (!write_vc->closed && !write_vc->fragment);
+  if (streaming && !stream_head && (!write_vc->blocks || write_vc->total_len != write_vc->length || write_vc->f.update)) {
+    MUTEX_RELEASE(writer_lock);
+    VC_SCHED_WRITER_RETRY();
+  }
 #ifdef HTTP_CACHE
   if (frag_type == CACHE_FRAG_TYPE_HTTP) {
     DDebug("cache_read_agg",
@@ -424,6 +459,34 @@ CacheVC::openReadFromWriter(int event, Event * e)
 #ifdef HTTP_CACHE
   }
 #endif
+  if (streaming) {
+    if (!write_vc->stream)
+      write_vc->stream = new CacheWriterStream;
+    stream = write_vc->stream;
+    ink_atomic_swap(&stream->avail, (int64_t)write_vc->total_len);
+    if (stream_head) {
+      // shared with every other late reader of this document
+      writer_buf = stream->head;
+      writer_offset = stream->head_offset;
+    } else {
+      writer_buf = write_vc->blocks;
+      writer_offset = write_vc->offset;
+    }
+    writer_pos = 0;
+    doc_pos = 0;
+    doc_len = write_vc->vio.nbytes;
+    earliest_key = write_vc->earliest_key;
+    dir_clean(&first_dir);
+    dir_clean(&earliest_dir);
+    DDebug("cache_read_agg", "%p: key: %X %X: streaming from writer%s", this, first_key.word(1), key.word(0),
+           stream_head ? " from the start of the document" : "");
+    MUTEX_RELEASE(writer_lock);
+    write_vc = NULL;
+    SET_HANDLER(&CacheVC::openReadFromWriterStream);
+    CACHE_INCREMENT_DYN_STAT(cache_read_busy_success_stat);
+    CACHE_INCREMENT_DYN_STAT(cache_read_busy_streaming_stat);
+    return callcont(CACHE_EVENT_OPEN_READ);
+  }
   if (write_vc->fragment) {
     doc_len = write_vc->vio.nbytes;
     last_collision = NULL;
@@ -498,6 +561,61 @@ CacheVC::openReadFromWriterMain(int /* event ATS_UNUSED */, Event * /* e ATS_UNU
     return calluser(VC_EVENT_READ_READY);
 }
 
+/*
+  Follow a writer that has not written its first fragment yet.  The
+  writer's buffer blocks are shared, not copied: the writer publishes how
+  far into them it has read in stream->avail, and whether it closed or
+  aborted in stream->closed.  The reader polls for more rather than being
+  called back by the writer.
+*/
+int
+CacheVC::openReadFromWriterStream(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
+{
+  cancel_trigger();
+  if (seek_to) {
+    vio.ndone = seek_to;
+    seek_to = 0;
+  }
+  int64_t ntodo = vio.ntodo();
+  if (ntodo <= 0)
+    return EVENT_CONT;
+  // read closed first, the writer publishes avail before closing
+  int32_t wclosed = ink_atomic_increment(&stream->closed, 0);
+  int64_t wavail = ink_atomic_increment(&stream->avail, (int64_t)0);
+  // skip to the user's position, the writer only ever extends the chain
+  while (writer_buf && writer_pos < vio.ndone && writer_pos < wavail) {
+    int64_t in_block = writer_buf->read_avail() - writer_offset;
+    int64_t skip = MIN(MIN(in_block, vio.ndone - writer_pos), wavail - writer_pos);
+    writer_offset += skip;
+    writer_pos += skip;
+    if (writer_offset >= writer_buf->read_avail()) {
+      if (!writer_buf->next)
+        break;
+      writer_buf = writer_buf->next;
+      writer_offset = 0;
+    }
+  }
+  int64_t bytes = wavail - vio.ndone;
+  if (bytes > ntodo)
+    bytes = ntodo;
+  if (writer_pos == vio.ndone && bytes > 0) {
+    IOBufferBlock *b = iobufferblock_clone(writer_buf, writer_offset, bytes);
+    vio.buffer.writer()->append_block(b);
+    vio.ndone += bytes;
+    if (vio.ntodo() <= 0)
+      return calluser(VC_EVENT_READ_COMPLETE);
+    else
+      return calluser(VC_EVENT_READ_READY);
+  }
+  if (wclosed > 0 && vio.ndone >= wavail)
+    return calluser(VC_EVENT_EOS);
+  if (wclosed < 0) {
+    Warning("Document %X truncated at %d, writer aborted while streaming", first_key.word(1), (int)vio.ndone);
+    return calluser(VC_EVENT_ERROR);
+  }
+  VC_SCHED_LOCK_RETRY();
+}
+
 int
 CacheVC::openReadClose(int event, Event * /* e ATS_UNUSED */)
 {
@@ -559,8 +677,14 @@ CacheVC::openReadReadDone(int event, Event * e)
 #endif
         goto Lerror;
       }
-      if (doc->key == key)
-        goto LreadMain;
+      if (doc->key == (f.read_link ? link_key : key)) {
+        if (!doc->link || f.read_link)
+          goto LreadMain;
+        // the fragment has the same data as the one it links to
+        link_key = *(CacheKey *) doc->data();
+        f.read_link = 1;
+        last_collision = NULL;
+      }
 #if TS_USE_INTERIM_CACHE == 1
       else if (dir_ininterim(&dir)) {
           dir_delete(&key, vol, &dir);
@@ -576,12 +700,12 @@ Lread:
     if (last_collision && dir_offset(&dir) != dir_offset(last_collision))
       last_collision = 0;       // object has been/is being overwritten
 #endif
-    if (dir_probe(&key, vol, &dir, &last_collision)) {
-      int ret = do_read_call(&key);
+    if (dir_probe(f.read_link ? &link_key : &key, vol, &dir, &last_collision)) {
+      int ret = do_read_call(f.read_link ? &link_key : &key);
       if (ret == EVENT_RETURN)
         goto Lcallreturn;
       return EVENT_CONT;
-    } else if (write_vc) {
+    } else if (write_vc && !f.read_link) {
       if (writer_done()) {
         last_collision = NULL;
         while (dir_probe(&earliest_key, vol, &dir, &last_collision)) {
@@ -614,6 +738,7 @@ Ldone:
 Lcallreturn:
   return handleEvent(AIO_EVENT_DONE, 0);
 LreadMain:
+  f.read_link = 0;
   fragment++;
   doc_pos = doc->prefix_len();
   next_CacheKey(&key, &key);
@@ -710,7 +835,10 @@ CacheVC::openReadMain(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
     goto Lread;
   if (bytes > vio.ntodo())
     bytes = vio.ntodo();
-  b = new_IOBufferBlock(buf, bytes, doc_pos);
+  if (f.sendfile_frag)
+    b = new_IOBufferBlock(new_file_IOBufferData(vol->disk->sendfile_fd, io.aiocb.aio_offset + doc_pos, bytes), bytes, 0);
+  else
+    b = new_IOBufferBlock(buf, bytes, doc_pos);
   b->_buf_end = b->_end;
   vio.buffer.writer()->append_block(b);
   vio.ndone += bytes;
@@ -745,6 +873,7 @@ Lread: {
     if (dir_probe(&key, vol, &dir, &last_collision)) {
       SET_HANDLER(&CacheVC::openReadReadDone);
       int ret = do_read_call(&key);
+      read_ahead();
       if (ret == EVENT_RETURN)
         goto Lcallreturn;
       return EVENT_CONT;
@@ -781,6 +910,141 @@ Lcallreturn:
   return handleEvent(AIO_EVENT_DONE, 0);
 }
 
+static void
+free_CacheReadAhead(CacheReadAhead *ra)
+{
+  ra->io.action.continuation = NULL;
+  ra->io.action.mutex = NULL;
+  ra->io.mutex.clear();
+  ra->buf.clear();
+  ra->mutex.clear();
+  cacheReadAheadAllocator.free(ra);
+}
+
+int
+CacheReadAhead::readDone(int /* event ATS_UNUSED */, void * /* data ATS_UNUSED */)
+{
+  done = true;
+  if (!vc) {
+    free_CacheReadAhead(this);
+    return EVENT_DONE;
+  }
+  if (wanted) {
+    // hand the fragment to the reader waiting in handleReadDone
+    CacheVC *c = vc;
+    c->read_ahead_queue.remove(this);
+    c->buf = buf;
+    c->io.aiocb.aio_nbytes = io.aiocb.aio_nbytes;
+    c->io.aio_result = io.aio_result;
+    free_CacheReadAhead(this);
+    return c->handleEvent(AIO_EVENT_DONE, 0);
+  }
+  return EVENT_DONE;
+}
+
+// Keep up to read_ahead_window of the fragments following 'key' in flight.
+// Called with the volume lock held after the read of 'key' has been started.
+void
+CacheVC::read_ahead()
+{
+  if (cache_config_read_ahead <= 0 || f.sendfile || write_vc || !doc_len)
+    return;
+  if (read_ahead_window < 1)
+    read_ahead_window = 1;
+  if (read_ahead_window > cache_config_read_ahead)
+    read_ahead_window = cache_config_read_ahead;
+
+  // stop once the reads cover the rest of the document
+  int n = 0;
+  int64_t ahead = dir_approx_size(&dir);
+  CacheKey next_key = key;
+  for (CacheReadAhead *ra = read_ahead_queue.head; ra; ra = ra->link.next) {
+    n++;
+    ahead += dir_approx_size(&ra->dir);
+    next_key = ra->key;
+  }
+  while (n < read_ahead_window && ahead < (int64_t)doc_len - vio.ndone) {
+    Dir next_dir;
+    Dir *next_collision = NULL;
+    next_CacheKey(&next_key, &next_key);
+    if (!dir_probe(&next_key, vol, &next_dir, &next_collision))
+      break;
+    // only fragments already on the disk
+    if (dir_agg_buf_valid(vol, &next_dir)
+#if TS_USE_INTERIM_CACHE == 1
+        || dir_ininterim(&next_dir)
+#endif
+      )
+      break;
+    CacheReadAhead *ra = cacheReadAheadAllocator.alloc();
+    ra->vc = this;
+    ra->mutex = mutex;
+    ra->key = next_key;
+    ra->dir = next_dir;
+    ra->io.aiocb.aio_fildes = vol->fd;
+    ra->io.aiocb.aio_offset = vol_offset(vol, &next_dir);
+    ra->io.aiocb.aio_nbytes = dir_approx_size(&next_dir);
+    ra->io.aiocb.aio_reqprio = io.aiocb.aio_reqprio;
+    if ((off_t)(ra->io.aiocb.aio_offset + ra->io.aiocb.aio_nbytes) > (off_t)(vol->skip + vol->len))
+      ra->io.aiocb.aio_nbytes = vol->skip + vol->len - ra->io.aiocb.aio_offset;
+    ra->buf = new_IOBufferData(iobuffer_size_to_index(ra->io.aiocb.aio_nbytes, MAX_BUFFER_SIZE_INDEX), MEMALIGNED);
+    ra->io.aiocb.aio_buf = ra->buf->data();
+    ra->io.action = ra;
+    ra->io.thread = mutex->thread_holding->tt == DEDICATED ? AIO_CALLBACK_THREAD_ANY : mutex->thread_holding;
+    read_ahead_queue.enqueue(ra);
+    ink_assert(ink_aio_read(&ra->io) >= 0);
+    CACHE_DEBUG_INCREMENT_DYN_STAT(cache_pread_count_stat);
+    n++;
+    ahead += dir_approx_size(&next_dir);
+  }
+}
+
+// Called from handleRead for a fragment which is not in memory.  If the
+// next read ahead is for this fragment it takes its place: EVENT_RETURN if
+// the data is already here, EVENT_CONT if the reader has to wait for it.
+int
+CacheVC::adopt_read_ahead()
+{
+  CacheReadAhead *ra = read_ahead_queue.head;
+  if (!(ra->key == *read_key) || dir_offset(&ra->dir) != dir_offset(&dir)) {
+    // the reader seeked or the fragment changed under us
+    drop_read_ahead();
+    return EVENT_NONE;
+  }
+  CACHE_INCREMENT_DYN_STAT(cache_read_ahead_hit_stat);
+  SET_HANDLER(&CacheVC::handleReadDone);
+  if (!ra->done) {
+    // the reader caught up with the disk, read further ahead
+    if (read_ahead_window < cache_config_read_ahead)
+      read_ahead_window++;
+    ra->wanted = true;
+    return EVENT_CONT;
+  }
+  read_ahead_queue.pop();
+  // the disk is ahead of the reader, read less far ahead
+  if (read_ahead_window > 1 && (!read_ahead_queue.tail || read_ahead_queue.tail->done))
+    read_ahead_window--;
+  buf = ra->buf;
+  io.aiocb.aio_nbytes = ra->io.aiocb.aio_nbytes;
+  io.aio_result = ra->io.aio_result;
+  free_CacheReadAhead(ra);
+  return EVENT_RETURN;
+}
+
+void
+CacheVC::drop_read_ahead()
+{
+  CacheReadAhead *ra;
+  while ((ra = read_ahead_queue.pop())) {
+    ink_assert(!ra->wanted);
+    CACHE_INCREMENT_DYN_STAT(cache_read_ahead_wasted_stat);
+    if (ra->done)
+      free_CacheReadAhead(ra);
+    else
+      ra->vc = NULL;
+  }
+}
+
 /*
   This code follows CacheVC::openReadStartHead closely,
   if you change this you might have to change that.
@@ -1012,8 +1276,13 @@ CacheVC::openReadStartHead(int event, Event * e)
     return free_CacheVC(this);
   {
     CACHE_TRY_LOCK(lock, vol->mutex, mutex->thread_holding);
-    if (!lock)
+    if (!lock) {
+      CACHE_INCREMENT_DYN_STAT(cache_read_lock_retry_stat);
+      // before the first probe a miss can be told without the lock
+      if (!buf && !last_collision && !od && vol_miss_nolock(vol, &key))
+        goto Ldone;
       VC_SCHED_LOCK_RETRY();
+    }
     if (!buf)
       goto Lread;
     if (!io.ok())
@@ -26,6 +26,7 @@
 #include "P_Cache.h"
 
 #define SCAN_BUF_SIZE      RECOVERY_SIZE
+#define SCAN_HEAD_SIZE     (16 * 1024)
 #define SCAN_WRITER_LOCK_MAX_RETRY 5
 
 Action *
@@ -43,21 +44,22 @@ Cache::scan(Continuation * cont, char *hostname, int host_len, int KB_per_second
   c->hostname = hostname;
   c->host_len = host_len;
   c->base_stat = cache_scan_active_stat;
-  c->buf = new_IOBufferData(BUFFER_SIZE_FOR_XMALLOC(SCAN_BUF_SIZE), MEMALIGNED);
   c->scan_msec_delay = (SCAN_BUF_SIZE / KB_per_second);
   c->offset = 0;
-  SET_CONTINUATION_HANDLER(c, &CacheVC::scanVol);
+  if (cache_config_scan_parallel > 0) {
+    SET_CONTINUATION_HANDLER(c, &CacheVC::scanVolumes);
+  } else {
+    c->buf = new_IOBufferData(BUFFER_SIZE_FOR_XMALLOC(SCAN_BUF_SIZE), MEMALIGNED);
+    SET_CONTINUATION_HANDLER(c, &CacheVC::scanVol);
+  }
   eventProcessor.schedule_in(c, HRTIME_MSECONDS(c->scan_msec_delay));
   cont->handleEvent(CACHE_EVENT_SCAN, c);
   return &c->_action;
 }
 
-int
-CacheVC::scanVol(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
+static CacheHostRecord *
+scan_host_record(char *hostname, int host_len)
 {
-  Debug("cache_scan_truss", "inside %p:scanVol", this);
-  if (_action.cancelled)
-    return free_CacheVC(this);
   CacheHostRecord *rec = &theCache->hosttable->gen_host_rec;
   if (host_len) {
     CacheHostResult res;
@@ -65,6 +67,77 @@ CacheVC::scanVol(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
     if (res.record)
       rec = res.record;
   }
+  return rec;
+}
+
+/* Directory-first scan: the CacheVC returned by Cache::scan starts a
+   CacheVC per volume, up to proxy.config.cache.scan.parallel at a time.
+   Each reads just the head fragment of the documents in its volume's
+   directory, in disk order, and calls back the user as scanObject does.
+   All of them share the user's mutex. */
+int
+CacheVC::scanVolumes(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
+{
+  Debug("cache_scan_truss", "inside %p:scanVolumes", this);
+  CacheHostRecord *rec = scan_host_record(hostname, host_len);
+
+  while (!_action.cancelled && !f.scan_stop && scan_next_vol < rec->num_vols &&
+         scan_workers < cache_config_scan_parallel) {
+    CacheVC *c = new_CacheVC(_action.continuation);
+    c->vol = rec->vols[scan_next_vol++];
+    c->scan_parent = this;
+    c->base_stat = cache_scan_active_stat;
+    c->buf = new_IOBufferData(BUFFER_SIZE_FOR_XMALLOC(SCAN_BUF_SIZE), MEMALIGNED);
+    c->scan_msec_delay = scan_msec_delay;
+    SET_CONTINUATION_HANDLER(c, &CacheVC::scanObject);
+    scan_workers++;
+    eventProcessor.schedule_imm(c, ET_CALL);
+  }
+  if (scan_workers)
+    return EVENT_CONT;
+  if (!_action.cancelled && !f.scan_stop)
+    _action.continuation->handleEvent(CACHE_EVENT_SCAN_DONE, NULL);
+  return free_CacheVC(this);
+}
+
+int
+CacheVC::scanVolumeDone()
+{
+  CacheVC *parent = scan_parent;
+  free_CacheVC(this);
+  parent->scan_workers--;
+  return parent->handleEvent(EVENT_IMMEDIATE, 0);
+}
+
+int
+CacheVC::scanHead(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
+{
+  Debug("cache_scan_truss", "inside %p:scanHead", this);
+  if (scan_parent->_action.cancelled || scan_parent->f.scan_stop || scan_dir_index >= scan_ndirs) {
+    scanVolumeDone();
+    return EVENT_DONE;
+  }
+  Dir *d = &scan_dirs[scan_dir_index++];
+  io.aiocb.aio_fildes = vol->fd;
+  io.aiocb.aio_offset = vol_offset(vol, d);
+  io.aiocb.aio_nbytes = dir_approx_size(d) < SCAN_HEAD_SIZE ? dir_approx_size(d) : SCAN_HEAD_SIZE;
+  if ((off_t)(io.aiocb.aio_offset + io.aiocb.aio_nbytes) > (off_t)(vol->skip + vol->len))
+    io.aiocb.aio_nbytes = vol->skip + vol->len - io.aiocb.aio_offset;
+  io.aiocb.aio_buf = buf->data();
+  io.io_class = AIO_CLASS_SCAN;
+  offset = 0;
+  SET_HANDLER(&CacheVC::scanObject);
+  ink_assert(ink_aio_read(&io) >= 0);
+  return EVENT_CONT;
+}
+
+int
+CacheVC::scanVol(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
+{
+  Debug("cache_scan_truss", "inside %p:scanVol", this);
+  if (_action.cancelled)
+    return free_CacheVC(this);
+  CacheHostRecord *rec = scan_host_record(hostname, host_len);
   if (!vol) {
     if (!rec->num_vols)
       goto Ldone;
@@ -111,10 +184,10 @@ dir_bucket_loop_fix(Dir *start_dir, int s, Vol *d);
 // TODO: If we used a bit vector, we could make a smaller map structure.
 // TODO: If we saved a high water mark we could have a smaller buf, and avoid searching it
 // when we are asked about the highest interesting offset.
-/* Make map of what blocks in partition are used.
+/* Make an empty map of what blocks in partition are used.
  *
  * d - Vol to make a map of. */
-static char *make_vol_map(Vol *d)
+static char *new_vol_map(Vol *d)
 {
   // Map will be one byte for each SCAN_BUF_SIZE bytes.
   off_t start_offset = vol_offset_to_offset(d, 0);
@@ -123,28 +196,68 @@ static char *make_vol_map(Vol *d)
   char *vol_map = (char *)ats_malloc(map_len);
 
   memset(vol_map, 0, map_len);
+  return vol_map;
+}
+
+/* Add the blocks used by a directory segment to the map.
+ *
+ * d - Vol to make a map of, locked
+ * s - segment */
+static void add_vol_map_segment(Vol *d, int s, char *vol_map)
+{
+  off_t start_offset = vol_offset_to_offset(d, 0);
+  off_t vol_len = vol_relative_length(d, start_offset);
 
-  // Scan directories.
   // Copied from dir_entries_used() and modified to fill in the map instead.
-  for (int s = 0; s < d->segments; s++) {
-    Dir *seg = dir_segment(s, d);
-    for (int b = 0; b < d->buckets; b++) {
-      Dir *e = dir_bucket(b, seg);
-      if (dir_bucket_loop_fix(e, s, d)) {
-        break;
+  Dir *seg = dir_segment(s, d);
+  for (int b = 0; b < d->buckets; b++) {
+    Dir *e = dir_bucket(b, seg);
+    if (dir_bucket_loop_fix(e, s, d)) {
+      break;
+    }
+    while (e) {
+      if (dir_offset(e)) {
+          off_t offset = vol_offset(d, e) - start_offset;
+          if (offset <= vol_len) vol_map[offset / SCAN_BUF_SIZE] = 1;
       }
-      while (e) {
-        if (dir_offset(e)) {
-            off_t offset = vol_offset(d, e) - start_offset;
-            if (offset <= vol_len) vol_map[offset / SCAN_BUF_SIZE] = 1;
-        }
-        e = next_dir(e, seg);
-        if (!e)
-          break;
+      e = next_dir(e, seg);
+      if (!e)
+        break;
+    }
+  }
+}
+
+static int
+cmp_scan_dir(const void *aa, const void *bb)
+{
+  int64_t a = dir_offset((Dir *) aa), b = dir_offset((Dir *) bb);
+  return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+/* Append the head entries of a directory segment to the heads of the
+ * scan, sorted by offset once all the segments are in.
+ *
+ * d - Vol to copy from, locked
+ * s - segment */
+void
+CacheVC::scanAddHeads(Vol *d, int s)
+{
+  Dir *seg = dir_segment(s, d);
+  for (int b = 0; b < d->buckets; b++) {
+    Dir *e = dir_bucket(b, seg);
+    if (dir_bucket_loop_fix(e, s, d))
+      break;
+    for (; e; e = next_dir(e, seg)) {
+      if (!dir_offset(e) || !dir_head(e))
+        continue;
+      if (scan_ndirs >= scan_dirs_size) {
+        scan_dirs_size = scan_dirs_size ? scan_dirs_size * 2 : 1024;
+        scan_dirs = (Dir *)ats_realloc(scan_dirs, scan_dirs_size * sizeof(Dir));
       }
+      dir_assign_data(&scan_dirs[scan_ndirs], e);
+      scan_ndirs++;
     }
   }
-  return vol_map;
 }
 
 int
@@ -175,8 +288,33 @@ CacheVC::scanObject(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
   }
 
   if (!fragment) {               // initialize for first read
+    // The directory is gone through one segment per lock, a large
+    // volume would otherwise be held for the whole of it.
+    if (!scan_seg) {
+      if (scan_parent) {
+        scan_ndirs = 0;
+      } else {
+        ats_free(scan_vol_map);
+        scan_vol_map = new_vol_map(vol);
+      }
+    }
+    if (scan_parent)
+      scanAddHeads(vol, scan_seg);
+    else
+      add_vol_map_segment(vol, scan_seg, scan_vol_map);
+    if (++scan_seg < vol->segments) {
+      mutex->thread_holding->schedule_imm_local(this);
+      return EVENT_CONT;
+    }
+    scan_seg = 0;
     fragment = 1;
-    scan_vol_map = make_vol_map(vol);
+    if (scan_parent) {
+      if (scan_ndirs)
+        qsort(scan_dirs, scan_ndirs, sizeof(Dir), cmp_scan_dir);
+      io.action = this;
+      io.thread = AIO_CALLBACK_THREAD_ANY;
+      return scanHead(EVENT_IMMEDIATE, 0);
+    }
     io.aiocb.aio_offset = next_in_map(vol, scan_vol_map, vol_offset_to_offset(vol, 0));
     if (io.aiocb.aio_offset >= (off_t)(vol->skip + vol->len))
       goto Ldone;
@@ -189,6 +327,8 @@ CacheVC::scanObject(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
   }
 
   if ((size_t)io.aio_result != (size_t) io.aiocb.aio_nbytes) {
+    if (scan_parent)
+      goto Lnext_head;
     result = (void *) -ECACHE_READ_FAIL;
     goto Ldone;
   }
@@ -206,10 +346,13 @@ CacheVC::scanObject(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
   while ((off_t)((char *) doc - buf->data()) + next_object_len < (off_t)io.aiocb.aio_nbytes) {
     might_need_overlap_read = false;
     doc = (Doc *) ((char *) doc + next_object_len);
+    if (scan_parent && (char *) doc != buf->data())
+      break;                    // a head read holds one document
     next_object_len = vol->round_to_approx_size(doc->len);
 #ifdef HTTP_CACHE
     int i;
     bool changed;
+    Doc *hdoc;                  // doc, or a copy with its headers inflated
 
     if (doc->magic != DOC_MAGIC) {
       next_object_len = CACHE_BLOCK_SIZE;
@@ -233,11 +376,20 @@ CacheVC::scanObject(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
       might_need_overlap_read = true;
       goto Lskip;
     }
+    hdoc = doc;
+    first_buf = NULL;
+    if (doc->hdr_deflated) {
+      // the vector is used from the copy until it is written back
+      first_buf = inflate_doc_hdr(doc);
+      if (!first_buf)
+        goto Lskip;
+      hdoc = (Doc *) first_buf->data();
+    }
     {
-      char *tmp = doc->hdr();
-      int len = doc->hlen;
+      char *tmp = hdoc->hdr();
+      int len = hdoc->hlen;
       while (len > 0) {
-        int r = HTTPInfo::unmarshal(tmp, len, buf._ptr());
+        int r = HTTPInfo::unmarshal(tmp, len, first_buf ? first_buf._ptr() : buf._ptr());
         if (r < 0) {
           ink_assert(!"CacheVC::scanObject unmarshal failed");
           goto Lskip;
@@ -246,7 +398,7 @@ CacheVC::scanObject(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
         tmp += r;
       }
     }
-    if (vector.get_handles(doc->hdr(), doc->hlen) != doc->hlen)
+    if (vector.get_handles(hdoc->hdr(), hdoc->hlen) != hdoc->hlen)
       goto Lskip;
     changed = false;
     hostinfo_copied = 0;
@@ -290,6 +442,10 @@ CacheVC::scanObject(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
         changed = true;
         continue;
       case EVENT_DONE:
+        if (scan_parent) {
+          scan_parent->f.scan_stop = 1;
+          return scanVolumeDone();
+        }
         goto Lcancel;
       default:
         ink_assert(!"unexpected CACHE_SCAN_RESULT");
@@ -324,6 +480,17 @@ CacheVC::scanObject(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
 #ifdef HTTP_CACHE
   vector.clear();
 #endif
+  if (scan_parent) {
+    // read the head again if its header did not fit
+    if (might_need_overlap_read) {
+      size_t hlen = ROUND_TO_SECTOR(vol, doc->data() - (char *) doc);
+      if (hlen > io.aiocb.aio_nbytes && hlen <= SCAN_BUF_SIZE) {
+        io.aiocb.aio_nbytes = hlen;
+        goto Lread;
+      }
+    }
+    goto Lnext_head;
+  }
     // If we had an object that went past the end of the buffer, and it is small enough to fix,
     // fix it.
   if (might_need_overlap_read &&
@@ -357,13 +524,28 @@ Lread:
   if ((off_t)(io.aiocb.aio_offset + io.aiocb.aio_nbytes) > (off_t)(vol->skip + vol->len))
     io.aiocb.aio_nbytes = vol->skip + vol->len - io.aiocb.aio_offset;
   offset = 0;
+  io.io_class = AIO_CLASS_SCAN;
   ink_assert(ink_aio_read(&io) >= 0);
   Debug("cache_scan_truss", "read %p:scanObject %" PRId64 " %zu", this,
         (int64_t)io.aiocb.aio_offset, (size_t)io.aiocb.aio_nbytes);
   return EVENT_CONT;
 
+Lnext_head:
+  {
+    // the scan rate is shared by the volumes being scanned
+    ink_hrtime delay = HRTIME_MSECONDS(scan_msec_delay) * cache_config_scan_parallel *
+      (ink_hrtime) io.aiocb.aio_nbytes / SCAN_BUF_SIZE;
+    SET_HANDLER(&CacheVC::scanHead);
+    if (!delay)
+      return scanHead(EVENT_IMMEDIATE, 0);
+    mutex->thread_holding->schedule_in_local(this, delay);
+    return EVENT_CONT;
+  }
+
 Ldone:
    Debug("cache_scan_truss", "done %p:scanObject", this);
+  if (scan_parent)
+    return scanVolumeDone();
   _action.continuation->handleEvent(CACHE_EVENT_SCAN_DONE, result);
 #ifdef HTTP_CACHE
 Lcancel:
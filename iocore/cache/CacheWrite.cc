@@ -140,6 +140,53 @@ CacheVC::updateVector(int /* event ATS_UNUSED */, Event */* e ATS_UNUSED */)
   return ret;
 }
 #endif
+#ifdef HTTP_CACHE
+// the object size of the alternate written, before the vector is marshalled
+static void
+vector_object_size_set(CacheVC *vc)
+{
+  ink_assert(vc->write_vector->count() > 0);
+  if (!vc->f.update && !vc->f.evac_vector) {
+    ink_assert(!(vc->first_key == zero_key));
+    CacheHTTPInfo *http_info = vc->write_vector->get(vc->alternate_index);
+    http_info->object_size_set(vc->total_len);
+  }
+  // update + data_written =>  Update case (b)
+  // need to change the old alternate's object length
+  if (vc->f.update && vc->total_len) {
+    CacheHTTPInfo *http_info = vc->write_vector->get(vc->alternate_index);
+    http_info->object_size_set(vc->total_len);
+  }
+}
+
+// With proxy.config.cache.compress_headers, deflates the vector into
+// vc->hdr_buf if that makes it smaller, header_len is then its deflated
+// length. The document is sized from header_len, so this is done before.
+static void
+vector_deflate(CacheVC *vc)
+{
+  Vol *vol = vc->vol;
+
+  vc->hdr_buf = NULL;
+  if (!cache_config_compress_headers || vc->f.evacuator || vc->frag_type != CACHE_FRAG_TYPE_HTTP || !vc->header_len)
+    return;
+
+  vector_object_size_set(vc);
+  char *raw = (char *) ats_malloc(vc->header_len);
+  int raw_len = vc->write_vector->marshal(raw, vc->header_len);
+  ink_assert(raw_len == vc->header_len);
+  Ptr<IOBufferData> d(new_IOBufferData(iobuffer_size_to_index(raw_len, MAX_BUFFER_SIZE_INDEX), MEMALIGNED));
+  // deflating to the marshalled length or more saves nothing
+  int len = deflate_doc_hdr(d->data(), raw_len - 1, raw, raw_len);
+  ats_free(raw);
+  if (len) {
+    CACHE_SUM_DYN_STAT_THREAD(cache_hdr_deflated_bytes_saved_stat, raw_len - len);
+    vc->hdr_buf = d;
+    vc->header_len = len;
+  }
+}
+#endif
+
 /*
    The following fields of the CacheVC are used when writing down a fragment.
    Make sure that each of the fields is set to a valid value before calling
@@ -184,11 +231,22 @@ CacheVC::handleWrite(int event, Event */* e ATS_UNUSED */)
 
   set_agg_write_in_progress();
   POP_HANDLER;
-  agg_len = vol->round_to_approx_size(write_len + header_len + frag_len + sizeofDoc);
+  // a fragment with the same data as one still on the volume is written
+  // as a link to it
+  f.dedup_link = f.dedup_hashed && !f.use_first_key && vol->dedup && vol->dedup_link(&data_hash, write_len, &link_key);
+  if (f.dedup_link) {
+    CACHE_INCREMENT_DYN_STAT(cache_dedup_fragments_stat);
+    CACHE_SUM_DYN_STAT(cache_dedup_bytes_stat, write_len);
+  }
+#ifdef HTTP_CACHE
+  vector_deflate(this);
+#endif
+  agg_len = vol->round_to_approx_size((f.dedup_link ? sizeof(CacheKey) : write_len) + header_len + frag_len + sizeofDoc);
   vol->agg_todo_size += agg_len;
+  int agg_slack = agg_len > AGG_SIZE ? agg_len : AGG_SIZE;
   bool agg_error =
-    (agg_len > AGG_SIZE || header_len + sizeofDoc > MAX_FRAG_SIZE ||
-     (!f.readers && (vol->agg_todo_size > cache_config_agg_write_backlog + AGG_SIZE) && write_len));
+    (agg_len > LARGE_FRAG_SIZE || header_len + sizeofDoc > MAX_FRAG_SIZE ||
+     (!f.readers && (vol->agg_todo_size > cache_config_agg_write_backlog + agg_slack) && write_len));
 #ifdef CACHE_AGG_FAIL_RATE
   agg_error = agg_error || ((uint32_t) mutex->thread_holding->generator.random() <
                             (uint32_t) (UINT_MAX * CACHE_AGG_FAIL_RATE));
@@ -206,7 +264,7 @@ CacheVC::handleWrite(int event, Event */* e ATS_UNUSED */)
       return EVENT_RETURN;
     return handleEvent(AIO_EVENT_DONE, 0);
   }
-  ink_assert(agg_len <= AGG_SIZE);
+  ink_assert(agg_len <= LARGE_FRAG_SIZE);
   if (f.evac_vector)
     vol->agg.push(this);
   else
@@ -266,13 +324,104 @@ Vol::force_evacuate_head(Dir *evac_dir, int pinned)
   return b;
 }
 
+/*
+  Deduplication of fragments.
+
+  The data fragments after the earliest one are hashed before they are
+  written. If the volume remembers a fragment with the same hash and
+  length which is still where it was written, the new fragment is
+  written as a link, a Doc whose data is the key of that fragment, and
+  readers follow the link.
+
+  A link only works while its target is on the volume. Since the volume
+  is a circular log, the target is in danger only if a link was written
+  after it: the write position reaches the target before the link. So
+  every link makes sure the target is evacuated, and once it has been,
+  it is ahead of all the links to it. Only the earliest fragments, which
+  readers open a document with, are never links or targets.
+*/
+void
+CacheVC::dedup_hash()
+{
+  f.dedup_hashed = 0;
+  if (!vol->dedup || !fragment || write_len < DEDUP_MIN_FRAGMENT_SIZE)
+    return;
+
+  INK_DIGEST_CTX ctx;
+  int len = write_len;
+  int64_t off = offset;
+
+  ink_code_incr_md5_init(&ctx);
+  for (IOBufferBlock *b = blocks; b && len > 0; b = b->next) {
+    int64_t bytes = (b->_end - b->_start) - off;
+    if (bytes <= 0) {
+      off = -bytes;
+      continue;
+    }
+    if (bytes > len)
+      bytes = len;
+    ink_code_incr_md5_update(&ctx, b->_start + off, bytes);
+    len -= bytes;
+    off = 0;
+  }
+  ink_code_incr_md5_final((char *) &data_hash, &ctx);
+  f.dedup_hashed = 1;
+}
+
+bool
+Vol::dedup_link(INK_MD5 *hash, uint32_t len, CacheKey *target)
+{
+  CacheDedupEntry *e = &dedup[hash->word(0) % dedup_entries];
+  Dir d, *last_collision = NULL;
+  bool found = false;
+
+  if (!(e->hash == *hash) || e->len != len)
+    return false;
+  while (!found && dir_probe(&e->key, this, &d, &last_collision))
+    found = dir_offset(&d) == dir_offset(&e->dir) && dir_phase(&d) == dir_phase(&e->dir);
+  if (!found || !dir_valid(this, &d))
+    return false;
+  // the evacuation may already be past a target about to be overwritten
+  if (dir_phase(&d) != header->phase && vol_offset(this, &d) < header->agg_pos + agg_buf_pos + EVACUATION_SIZE)
+    return false;
+
+  EvacuationBlock *b = evacuation_block_exists(&d, this);
+  if (b) {
+    // being copied now, the copy could land behind the link
+    if (b->f.done)
+      return false;
+    // already evacuated with its document
+    b->readers = 0;
+  } else {
+    b = new_EvacuationBlock(mutex->thread_holding);
+    b->dir = d;
+    b->f.link_target = 1;
+    b->evac_frags.key = e->key;
+    b->evac_frags.earliest_key.set(0, 0);
+    evacuate[dir_evac_bucket(&d)].push(b);
+  }
+  *target = e->key;
+  return true;
+}
+
+void
+Vol::dedup_insert(INK_MD5 *hash, uint32_t len, CacheKey *key, Dir *d)
+{
+  CacheDedupEntry *e = &dedup[hash->word(0) % dedup_entries];
+
+  e->hash = *hash;
+  e->key = *key;
+  e->dir = *d;
+  e->len = len;
+}
+
 void
 Vol::scan_for_pinned_documents()
 {
   if (cache_config_permit_pinning) {
     // we can't evacuate anything between header->write_pos and
-    // header->write_pos + AGG_SIZE.
-    int ps = offset_to_vol_offset(this, header->write_pos + AGG_SIZE);
+    // header->agg_pos + AGG_SIZE.
+    int ps = offset_to_vol_offset(this, header->agg_pos + AGG_SIZE);
     int pe = offset_to_vol_offset(this, header->write_pos + 2 * EVACUATION_SIZE + (len / PIN_SCAN_EVERY));
     int vol_end_offset = offset_to_vol_offset(this, len + skip);
     int before_end_of_vol = pe < vol_end_offset;
@@ -297,13 +446,21 @@ Vol::scan_for_pinned_documents()
   }
 }
 
+int
+AggBuffer::writeDone(int event, void */* data ATS_UNUSED */)
+{
+  if (event == AIO_EVENT_DONE)
+    done = true;
+  return vol->aggWriteDone(event, this);
+}
+
 /* NOTE:: This state can be called by an AIO thread, so DON'T DON'T
    DON'T schedule any events on this thread using VC_SCHED_XXX or
    mutex->thread_holding->schedule_xxx_local(). ALWAYS use
    eventProcessor.schedule_xxx().
    */
 int
-Vol::aggWriteDone(int event, Event *e)
+Vol::aggWriteDone(int event, AggBuffer *b)
 {
   cancel_trigger();
 
@@ -311,40 +468,60 @@ Vol::aggWriteDone(int event, Event *e)
   // retaking the current mutex recursively is a NOOP
   CACHE_TRY_LOCK(lock, dir_sync_waiting ? cacheDirSync->mutex : mutex, mutex->thread_holding);
   if (!lock) {
-    eventProcessor.schedule_in(this, HRTIME_MSECONDS(cache_config_mutex_retry_delay));
+    eventProcessor.schedule_in(b, HRTIME_MSECONDS(cache_config_mutex_retry_delay));
     return EVENT_CONT;
   }
-  if (io.ok()) {
-    header->last_write_pos = header->write_pos;
-    header->write_pos += io.aiocb.aio_nbytes;
-    ink_assert(header->write_pos >= start);
-    DDebug("cache_agg", "Dir %s, Write: %" PRIu64 ", last Write: %" PRIu64 "\n",
-          hash_id, header->write_pos, header->last_write_pos);
-    ink_assert(header->write_pos == header->agg_pos);
-    if (header->write_pos + EVACUATION_SIZE > scan_pos)
-      periodic_scan();
-    agg_buf_pos = 0;
-    header->write_serial++;
-  } else {
-    // delete all the directory entries that we inserted
-    // for fragments is this aggregation buffer
-    Debug("cache_disk_error", "Write error on disk %s\n \
+  // retire the writes in the order they were issued, write_pos only
+  // moves over data which is on the disk
+  while (agg_inflight && agg_bufs[agg_head].done) {
+    AggBuffer *h = &agg_bufs[agg_head];
+    int nbytes = h->io.aiocb.aio_nbytes;
+    ink_assert(h->io.aiocb.aio_offset == header->write_pos);
+    if (h->io.ok()) {
+      header->last_write_pos = header->write_pos;
+      header->write_pos += nbytes;
+      ink_assert(header->write_pos >= start);
+      DDebug("cache_agg", "Dir %s, Write: %" PRIu64 ", last Write: %" PRIu64 "\n",
+            hash_id, header->write_pos, header->last_write_pos);
+      if (header->write_pos + EVACUATION_SIZE > scan_pos)
+        periodic_scan();
+      header->write_serial++;
+    } else {
+      // delete all the directory entries that we inserted
+      // for fragments is this aggregation buffer
+      Debug("cache_disk_error", "Write error on disk %s\n \
               write range : [%" PRIu64 " - %" PRIu64 " bytes]  [%" PRIu64 " - %" PRIu64 " blocks] \n",
-          hash_id, (uint64_t)io.aiocb.aio_offset,
-          (uint64_t)io.aiocb.aio_offset + io.aiocb.aio_nbytes,
-          (uint64_t)io.aiocb.aio_offset / CACHE_BLOCK_SIZE,
-          (uint64_t)(io.aiocb.aio_offset + io.aiocb.aio_nbytes) / CACHE_BLOCK_SIZE);
-    Dir del_dir;
-    dir_clear(&del_dir);
-    for (int done = 0; done < agg_buf_pos;) {
-      Doc *doc = (Doc *) (agg_buffer + done);
-      dir_set_offset(&del_dir, header->write_pos + done);
-      dir_delete(&doc->key, this, &del_dir);
-      done += round_to_approx_size(doc->len);
+            hash_id, (uint64_t)h->io.aiocb.aio_offset,
+            (uint64_t)h->io.aiocb.aio_offset + h->io.aiocb.aio_nbytes,
+            (uint64_t)h->io.aiocb.aio_offset / CACHE_BLOCK_SIZE,
+            (uint64_t)(h->io.aiocb.aio_offset + h->io.aiocb.aio_nbytes) / CACHE_BLOCK_SIZE);
+      Dir del_dir;
+      dir_clear(&del_dir);
+      for (int done = 0; done < nbytes;) {
+        Doc *doc = (Doc *) ((char *) h->io.aiocb.aio_buf + done);
+        dir_set_offset(&del_dir, header->write_pos + done);
+        dir_delete(&doc->key, this, &del_dir);
+        done += round_to_approx_size(doc->len);
+      }
+      // reuse the space unless later writes already follow it
+      if (agg_inflight > 1 || agg_buf_pos) {
+        header->last_write_pos = header->write_pos;
+        header->write_pos += nbytes;
+        header->write_serial++;
+      } else
+        header->agg_pos = header->write_pos;
     }
-    agg_buf_pos = 0;
+    if (h->large) {
+      ats_memalign_free(h->large);
+      h->large = NULL;
+    }
+    h->in_flight = false;
+    h->done = false;
+    agg_inflight--;
+    agg_inflight_bytes -= nbytes;
+    agg_head = (agg_head + 1) % agg_nbufs;
   }
-  set_io_not_in_progress();
+  ink_assert(agg_inflight || header->write_pos == header->agg_pos);
   // callback ready sync CacheVCs
   CacheVC *c = 0;
   while ((c = sync.dequeue())) {
@@ -355,12 +532,12 @@ Vol::aggWriteDone(int event, Event *e)
       break;
     }
   }
-  if (dir_sync_waiting) {
+  if (dir_sync_waiting && !agg_inflight) {
     dir_sync_waiting = 0;
     cacheDirSync->handleEvent(EVENT_IMMEDIATE, 0);
   }
-  if (agg.head || sync.head)
-    return aggWrite(event, e);
+  if (agg.head || sync.head || agg_buf_pos)
+    return aggWrite(event, NULL);
   return EVENT_CONT;
 }
 
@@ -583,14 +760,16 @@ Vol::evacuateWrite(CacheVC *evacuator, int event, Event *e)
 {
   // push to front of aggregation write list, so it is written first
 
+  Vol *vol = this;
   evacuator->agg_len = round_to_approx_size(((Doc *)evacuator->buf->data())->len);
   agg_todo_size += evacuator->agg_len;
+  CACHE_SUM_DYN_STAT(cache_evacuate_bytes_stat, evacuator->agg_len);
   /* insert the evacuator after all the other evacuators */
   CacheVC *cur = (CacheVC *) agg.head;
   CacheVC *after = NULL;
   for (; cur && cur->f.evacuator; cur = (CacheVC *) cur->link.next)
     after = cur;
-  ink_assert(evacuator->agg_len <= AGG_SIZE);
+  ink_assert(evacuator->agg_len <= LARGE_FRAG_SIZE);
   agg.insert(evacuator, after);
   return aggWrite(event, e);
 }
@@ -624,8 +803,13 @@ Vol::evacuateDocReadDone(int event, Event *e)
   }
   if (!b)
     goto Ldone;
-  if ((b->f.pinned && !b->readers) && doc->pinned < (uint32_t) (ink_get_based_hrtime() / HRTIME_SECOND))
+  // a pinned document nobody is reading is not kept past its pin time
+  if ((b->f.pinned && !b->readers) &&
+      doc->pinned < (uint32_t) (ink_get_based_hrtime() / HRTIME_SECOND) + cache_config_evacuate_pin_margin) {
+    Vol *vol = this;
+    CACHE_SUM_DYN_STAT(cache_evacuate_skipped_bytes_stat, doc->len);
     goto Ldone;
+  }
 
   if (dir_head(&b->dir) && b->f.evacuate_head) {
     ink_assert(!b->evac_frags.key.fold());
@@ -670,7 +854,7 @@ Vol::evacuateDocReadDone(int event, Event *e)
   // document, then it has to be the earliest fragment. We gaurantee that
   // the first_key and the earliest_key will never collide (see
   // Cache::open_write).
-  if (!dir_head(&b->dir) || !dir_compare_tag(&b->dir, &doc->first_key)) {
+  if (!b->f.link_target && (!dir_head(&b->dir) || !dir_compare_tag(&b->dir, &doc->first_key))) {
     next_CacheKey(&next_key, &doc->key);
     evacuate_fragments(&next_key, &doc_evacuator->earliest_key, !b->readers, this);
   }
@@ -704,6 +888,16 @@ Vol::evac_range(off_t low, off_t high, int evac_phase)
     }
     if (first) {
       first->f.done = 1;
+      // a pinned document which has not been read lately is let go
+      // without reading it, documents being read are always kept
+      if (first->f.pinned && !first->readers && cache_config_evacuate_min_frequency > 0 &&
+          access.estimate(dir_offset(&first->dir)) < cache_config_evacuate_min_frequency) {
+        Vol *vol = this;
+        DDebug("cache_evac", "evac_range skipping cold %X %d", (int)dir_tag(&first->dir), (int)dir_offset(&first->dir));
+        CACHE_SUM_DYN_STAT(cache_evacuate_skipped_bytes_stat, dir_approx_size(&first->dir));
+        i--;
+        continue;
+      }
       io.aiocb.aio_fildes = fd;
       io.aiocb.aio_nbytes = dir_approx_size(&first->dir);
       io.aiocb.aio_offset = vol_offset(this, &first->dir);
@@ -715,6 +909,7 @@ Vol::evac_range(off_t low, off_t high, int evac_phase)
       io.aiocb.aio_buf = doc_evacuator->buf->data();
       io.action = this;
       io.thread = AIO_CALLBACK_THREAD_ANY;
+      io.io_class = AIO_CLASS_EVACUATE;
       DDebug("cache_evac", "evac_range evacuating %X %d", (int)dir_tag(&first->dir), (int)dir_offset(&first->dir));
       SET_HANDLER(&Vol::evacuateDocReadDone);
       ink_assert(ink_aio_read(&io) >= 0);
@@ -729,13 +924,13 @@ static int
 agg_copy(char *p, CacheVC *vc)
 {
   Vol *vol = vc->vol;
-  off_t o = vol->header->write_pos + vol->agg_buf_pos;
+  off_t o = vol->header->agg_pos + vol->agg_buf_pos;
 
   if (!vc->f.evacuator) {
     Doc *doc = (Doc *) p;
     IOBufferBlock *res_alt_blk = 0;
 
-    uint32_t len = vc->write_len + vc->header_len + vc->frag_len + sizeofDoc;
+    uint32_t len = (vc->f.dedup_link ? sizeof(CacheKey) : vc->write_len) + vc->header_len + vc->frag_len + sizeofDoc;
     ink_assert(vc->frag_type != CACHE_FRAG_TYPE_HTTP || len != sizeofDoc);
     ink_assert(vol->round_to_approx_size(len) == vc->agg_len);
     // update copy of directory entry for this document
@@ -752,11 +947,14 @@ agg_copy(char *p, CacheVC *vc)
     doc->len = len;
     doc->hlen = vc->header_len;
     doc->ftype = vc->frag_type;
+    doc->link = vc->f.dedup_link;
+    doc->hdr_deflated = 0;
     doc->_flen = 0;
     doc->total_len = vc->total_len;
     doc->first_key = vc->first_key;
     doc->sync_serial = vol->header->sync_serial;
-    vc->write_serial = doc->write_serial = vol->header->write_serial;
+    // the serial write_serial will have when the writes ahead retire
+    vc->write_serial = doc->write_serial = vol->header->write_serial + vol->agg_inflight;
     doc->checksum = DOC_NO_CHECKSUM;
     if (vc->pin_in_cache) {
       dir_set_pinned(&vc->dir, 1);
@@ -795,20 +993,15 @@ agg_copy(char *p, CacheVC *vc)
       ink_assert(vc->f.use_first_key);
 #ifdef HTTP_CACHE
       if (vc->frag_type == CACHE_FRAG_TYPE_HTTP) {
-        ink_assert(vc->write_vector->count() > 0);
-        if (!vc->f.update && !vc->f.evac_vector) {
-          ink_assert(!(vc->first_key == zero_key));
-          CacheHTTPInfo *http_info = vc->write_vector->get(vc->alternate_index);
-          http_info->object_size_set(vc->total_len);
-        }
-        // update + data_written =>  Update case (b)
-        // need to change the old alternate's object length
-        if (vc->f.update && vc->total_len) {
-          CacheHTTPInfo *http_info = vc->write_vector->get(vc->alternate_index);
-          http_info->object_size_set(vc->total_len);
+        if (vc->hdr_buf) {
+          // deflated by handleWrite, the sizes are already set
+          memcpy(doc->hdr(), vc->hdr_buf->data(), vc->header_len);
+          doc->hdr_deflated = 1;
+        } else {
+          vector_object_size_set(vc);
+          ink_assert(!(((uintptr_t) &doc->hdr()[0]) & HDR_PTR_ALIGNMENT_MASK));
+          ink_assert(vc->header_len == vc->write_vector->marshal(doc->hdr(), vc->header_len));
         }
-        ink_assert(!(((uintptr_t) &doc->hdr()[0]) & HDR_PTR_ALIGNMENT_MASK));
-        ink_assert(vc->header_len == vc->write_vector->marshal(doc->hdr(), vc->header_len));
       } else
 #endif
         memcpy(doc->hdr(), vc->header_to_write, vc->header_len);
@@ -823,6 +1016,9 @@ agg_copy(char *p, CacheVC *vc)
         ink_assert(mutex->thread_holding == this_ethread());
         CACHE_DEBUG_SUM_DYN_STAT(cache_write_bytes_stat, vc->write_len);
       }
+      if (vc->f.dedup_link)
+        memcpy(doc->data(), &vc->link_key, sizeof(CacheKey));
+      else
 #ifdef HTTP_CACHE
       if (vc->f.rewrite_resident_alt)
         iobufferblock_memcpy(doc->data(), vc->write_len, res_alt_blk, 0);
@@ -866,7 +1062,7 @@ agg_copy(char *p, CacheVC *vc)
     }
 
     doc->sync_serial = vc->vol->header->sync_serial;
-    doc->write_serial = vc->vol->header->write_serial;
+    doc->write_serial = vc->vol->header->write_serial + vc->vol->agg_inflight;
 
     memcpy(p, doc, doc->len);
 
@@ -937,6 +1133,18 @@ Vol::periodic_scan()
   scan_pos += len / PIN_SCAN_EVERY;
 }
 
+// Memory holding the data for disk offset o in [write_pos, agg_write_end()).
+char *
+Vol::agg_buf_data(off_t o)
+{
+  for (int i = 0, j = agg_head; i < agg_inflight; i++, j = (j + 1) % agg_nbufs) {
+    AIOCallbackInternal *b = &agg_bufs[j].io;
+    if (o < (off_t)(b->aiocb.aio_offset + b->aiocb.aio_nbytes))
+      return (char *) b->aiocb.aio_buf + (o - b->aiocb.aio_offset);
+  }
+  return agg_buffer + (o - header->agg_pos);
+}
+
 void
 Vol::agg_wrap()
 {
@@ -960,24 +1168,34 @@ Vol::agg_wrap()
 int
 Vol::aggWrite(int event, void */* e ATS_UNUSED */)
 {
-  ink_assert(!is_io_in_progress());
-
   Que(CacheVC, link) tocall;
   CacheVC *c;
+  off_t end;
 
   cancel_trigger();
 
+  // an evacuation read calls back here when it is done, and so does
+  // the oldest write when every buffer of the ring is in flight
+  if (is_io_in_progress() || agg_bufs[agg_fill].in_flight)
+    return EVENT_CONT;
+
 Lagain:
   // calculate length of aggregated write
   for (c = (CacheVC *) agg.head; c;) {
     int writelen = c->agg_len;
     // [amc] this is checked multiple places, on here was it strictly less.
-    ink_assert(writelen <= AGG_SIZE);
-    if (agg_buf_pos + writelen > AGG_SIZE ||
-        header->write_pos + agg_buf_pos + writelen > (skip + len))
+    ink_assert(writelen <= LARGE_FRAG_SIZE);
+    // a document larger than agg_write_size (evacuated, a big vector
+    // or a large fragment) goes down in a write of its own
+    if ((agg_buf_pos && agg_buf_pos + writelen > cache_config_agg_write_size) ||
+        header->agg_pos + agg_buf_pos + writelen > (skip + len))
       break;
+    if (writelen > AGG_SIZE) {
+      agg_bufs[agg_fill].large = (char *)ats_memalign(ats_pagesize(), writelen);
+      agg_buffer = agg_bufs[agg_fill].large;
+    }
     DDebug("agg_read", "copying: %d, %" PRIu64 ", key: %d",
-          agg_buf_pos, header->write_pos + agg_buf_pos, c->first_key.word(0));
+          agg_buf_pos, header->agg_pos + agg_buf_pos, c->first_key.word(0));
     int wrotelen = agg_copy(agg_buffer + agg_buf_pos, c);
     ink_assert(writelen == wrotelen);
     agg_todo_size -= writelen;
@@ -1000,6 +1218,9 @@ Lagain:
   if (!agg_buf_pos) {
     if (!agg.head && !sync.head) // nothing to get
       return EVENT_CONT;
+    // wrap or write the sync marker once the writes in flight are done
+    if (agg_inflight)
+      goto Lwait;
     if (header->write_pos == start) {
       // write aggregation too long, bad bad, punt on everything.
       Note("write aggregation exceeds vol size");
@@ -1022,8 +1243,8 @@ Lagain:
   }
 
   // evacuate space
-  off_t end = header->write_pos + agg_buf_pos + EVACUATION_SIZE;
-  if (evac_range(header->write_pos, end, !header->phase) < 0)
+  end = header->agg_pos + agg_buf_pos + EVACUATION_SIZE;
+  if (evac_range(header->agg_pos, end, !header->phase) < 0)
     goto Lwait;
   if (end > skip + len)
     if (evac_range(start, start + (end - (skip + len)), header->phase) < 0)
@@ -1047,22 +1268,38 @@ Lagain:
     d->write_serial = header->write_serial;
   }
 
-  // set write limit
-  header->agg_pos = header->write_pos + agg_buf_pos;
+  // writes can complete out of order, recovery only clears
+  // EVACUATION_SIZE past the last document it finds
+  if (agg_inflight && agg_inflight_bytes + agg_buf_pos > agg_nbufs * cache_config_agg_write_size)
+    goto Lwait;
 
-  io.aiocb.aio_fildes = fd;
-  io.aiocb.aio_offset = header->write_pos;
-  io.aiocb.aio_buf = agg_buffer;
-  io.aiocb.aio_nbytes = agg_buf_pos;
-  io.action = this;
-  /*
-    Callback on AIO thread so that we can issue a new write ASAP
-    as all writes are serialized in the volume.  This is not necessary
-    for reads proceed independently.
-   */
-  io.thread = AIO_CALLBACK_THREAD_AIO;
-  SET_HANDLER(&Vol::aggWriteDone);
-  ink_aio_write(&io);
+  {
+    AggBuffer *b = &agg_bufs[agg_fill];
+    b->in_flight = true;
+    b->io.aiocb.aio_fildes = fd;
+    b->io.aiocb.aio_offset = header->agg_pos;
+    b->io.aiocb.aio_buf = agg_buffer;
+    b->io.aiocb.aio_nbytes = agg_buf_pos;
+    b->io.action = b;
+    /*
+      Callback on AIO thread so that we can issue a new write ASAP
+      as all writes are serialized in the volume.  This is not necessary
+      for reads proceed independently.
+     */
+    b->io.thread = AIO_CALLBACK_THREAD_AIO;
+    b->io.io_class = AIO_CLASS_AGG_WRITE;
+    agg_inflight++;
+    agg_inflight_bytes += agg_buf_pos;
+    // set write limit
+    header->agg_pos += agg_buf_pos;
+    agg_buf_pos = 0;
+    agg_fill = (agg_fill + 1) % agg_nbufs;
+    agg_buffer = agg_bufs[agg_fill].buf;
+    ink_aio_write(&b->io);
+  }
+  // keep filling while the ring has a free buffer
+  if (agg.head && !agg_bufs[agg_fill].in_flight)
+    goto Lagain;
 
 Lwait:
   int ret = EVENT_CONT;
@@ -1207,8 +1444,6 @@ CacheVC::openWriteCloseHead(int event, Event *e)
 int
 CacheVC::openWriteCloseDataDone(int event, Event *e)
 {
-  int ret = 0;
-
   if (event == AIO_EVENT_DONE)
     set_io_not_in_progress();
   else if (is_io_in_progress())
@@ -1231,21 +1466,22 @@ CacheVC::openWriteCloseDataDone(int event, Event *e)
     fragment++;
     write_pos += write_len;
     dir_insert(&key, vol, &dir);
+    if (f.dedup_hashed && !f.dedup_link)
+      vol->dedup_insert(&data_hash, write_len, &key, &dir);
+    f.dedup_hashed = f.dedup_link = 0;
     blocks = iobufferblock_skip(blocks, &offset, &length, write_len);
     next_CacheKey(&key, &key);
-    if (length) {
-      write_len = length;
-      if (write_len > MAX_FRAG_SIZE)
-        write_len = MAX_FRAG_SIZE;
-      if ((ret = do_write_call()) == EVENT_RETURN)
-        goto Lcallreturn;
-      return ret;
+    if (!length) {
+      f.data_done = 1;
+      return openWriteCloseHead(event, e); // must be called under vol lock from here
     }
-    f.data_done = 1;
-    return openWriteCloseHead(event, e); // must be called under vol lock from here
+    write_len = length;
+    if (write_len > vol->max_fragment_size())
+      write_len = vol->max_fragment_size();
   }
-Lcallreturn:
-  return handleEvent(AIO_EVENT_DONE, 0);
+  // hash the next fragment without holding the volume
+  dedup_hash();
+  return do_write_lock_call();
 }
 
 int
@@ -1278,11 +1514,12 @@ CacheVC::openWriteClose(int event, Event *e)
       return openWriteCloseDir(event, e);
 #endif
     }
-    if (length && (fragment || length > MAX_FRAG_SIZE)) {
+    if (length && (fragment || length > vol->max_fragment_size())) {
       SET_HANDLER(&CacheVC::openWriteCloseDataDone);
       write_len = length;
-      if (write_len > MAX_FRAG_SIZE)
-        write_len = MAX_FRAG_SIZE;
+      if (write_len > vol->max_fragment_size())
+        write_len = vol->max_fragment_size();
+      dedup_hash();
       return do_write_lock_call();
     } else
       return openWriteCloseHead(event, e);
@@ -1326,6 +1563,9 @@ CacheVC::openWriteWriteDone(int event, Event *e)
     ++fragment;
     write_pos += write_len;
     dir_insert(&key, vol, &dir);
+    if (f.dedup_hashed && !f.dedup_link)
+      vol->dedup_insert(&data_hash, write_len, &key, &dir);
+    f.dedup_hashed = f.dedup_link = 0;
     DDebug("cache_insert", "WriteDone: %X, %X, %d", key.word(0), first_key.word(0), write_len);
     blocks = iobufferblock_skip(blocks, &offset, &length, write_len);
     next_CacheKey(&key, &key);
@@ -1336,10 +1576,6 @@ CacheVC::openWriteWriteDone(int event, Event *e)
   return openWriteMain(event, e);
 }
 
-static inline int target_fragment_size() {
-  return cache_config_target_fragment_size - sizeofDoc;
-}
-
 int
 CacheVC::openWriteMain(int /* event ATS_UNUSED */, Event */* e ATS_UNUSED */)
 {
@@ -1369,26 +1605,40 @@ Lagain:
     avail -= (towrite - ntodo);
     towrite = ntodo;
   }
-  if (towrite > MAX_FRAG_SIZE) {
-    avail -= (towrite - MAX_FRAG_SIZE);
-    towrite = MAX_FRAG_SIZE;
+  if (towrite > vol->max_fragment_size()) {
+    avail -= (towrite - vol->max_fragment_size());
+    towrite = vol->max_fragment_size();
   }
   if (!blocks && towrite) {
     blocks = vio.buffer.reader()->block;
     offset = vio.buffer.reader()->start_offset;
+    // hold on to the start of the document for streaming readers
+    if (!total_len && !fragment && !f.update && frag_type == CACHE_FRAG_TYPE_HTTP &&
+        cache_config_read_while_writer == 2 && cache_config_read_while_writer_stream_max_size > 0) {
+      if (!stream)
+        stream = new CacheWriterStream;
+      stream->head = blocks;
+      stream->head_offset = offset;
+    }
   }
   if (avail > 0) {
     vio.buffer.reader()->consume(avail);
     vio.ndone += avail;
     total_len += avail;
+    if (stream) {
+      ink_atomic_swap(&stream->avail, (int64_t)total_len);
+      // too big to keep, later readers go to the fragments on disk
+      if (stream->head && (int64_t)total_len > cache_config_read_while_writer_stream_max_size)
+        stream->head.clear();
+    }
   }
   length = (uint64_t)towrite;
-  if (length > target_fragment_size() && 
-      (length < target_fragment_size() + target_fragment_size() / 4))
-    write_len = target_fragment_size();
+  if (length > vol->target_fragment_size() &&
+      (length < vol->target_fragment_size() + vol->target_fragment_size() / 4))
+    write_len = vol->target_fragment_size();
   else
     write_len = length;
-  bool not_writing = towrite != ntodo && towrite < target_fragment_size();
+  bool not_writing = towrite != ntodo && towrite < vol->target_fragment_size();
   if (!called_user) {
     if (not_writing) {
       called_user = 1;
@@ -1406,6 +1656,7 @@ Lagain:
     return openWriteClose(EVENT_NONE, NULL);
   }
   SET_HANDLER(&CacheVC::openWriteWriteDone);
+  dedup_hash();
   return do_write_lock_call();
 }
 
@@ -1688,8 +1939,15 @@ Cache::open_write(Continuation *cont, CacheKey *key, CacheHTTPInfo *info, time_t
   ink_assert(caches[type] == this);
   intptr_t err = 0;
   int if_writers = (uintptr_t) info == CACHE_ALLOW_MULTIPLE_WRITES;
-  CacheVC *c = new_CacheVC(cont);
   ProxyMutex *mutex = cont->mutex;
+  Vol *vol = key_to_vol(key, hostname, host_len);
+  // updates of cached documents are always written, new ones may be turned away
+  if ((!info || if_writers) && vol->admission && !vol->admission->admit(key)) {
+    CACHE_INCREMENT_DYN_STAT(cache_write_not_admitted_stat);
+    cont->handleEvent(CACHE_EVENT_OPEN_WRITE_FAILED, (void *) -ECACHE_NOT_ADMITTED);
+    return ACTION_RESULT_DONE;
+  }
+  CacheVC *c = new_CacheVC(cont);
   c->vio.op = VIO::WRITE;
   c->first_key = *key;
   /*
@@ -1705,8 +1963,7 @@ Cache::open_write(Continuation *cont, CacheKey *key, CacheHTTPInfo *info, time_t
   while (DIR_MASK_TAG(c->key.word(2)) == DIR_MASK_TAG(c->first_key.word(2)));
   c->earliest_key = c->key;
   c->frag_type = CACHE_FRAG_TYPE_HTTP;
-  c->vol = key_to_vol(key, hostname, host_len);
-  Vol *vol = c->vol;
+  c->vol = vol;
   c->info = info;
   if (c->info && (uintptr_t) info != CACHE_ALLOW_MULTIPLE_WRITES) {
     /*
@@ -1861,6 +2118,7 @@ Lagain:
         mts->vc->dir_off = new_off;
       }
       vol->set_migrate_done(mts);
+      CACHE_INCREMENT_DYN_STAT(cache_interim_migrate_stat);
     } else
       vol->set_migrate_failed(mts);
 
@@ -1908,6 +2166,7 @@ Lagain:
     for reads proceed independently.
    */
   io.thread = AIO_CALLBACK_THREAD_AIO;
+  io.io_class = AIO_CLASS_AGG_WRITE;
   SET_HANDLER(&InterimCacheVol::aggWriteDone);
   ink_aio_write(&io);
   return EVENT_CONT;
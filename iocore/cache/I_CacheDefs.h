@@ -109,7 +109,8 @@ enum CacheDataType
 {
   CACHE_DATA_HTTP_INFO = VCONNECTION_CACHE_DATA_BASE,
   CACHE_DATA_KEY,
-  CACHE_DATA_RAM_CACHE_HIT_FLAG
+  CACHE_DATA_RAM_CACHE_HIT_FLAG,
+  CACHE_DATA_SENDFILE
 };
 
 enum CacheFragType
@@ -50,6 +50,7 @@ struct Span
   bool isRaw;
   int64_t offset;                 // used only if (file == true)
   int alignment;
+  int dio_alignment;            // what direct I/O must be aligned to, 0 if unknown
   int disk_id;
   int vol_num;
   LINK(Span, link);
@@ -96,7 +97,7 @@ public:
 
   Span()
     : pathname(NULL), blocks(0), hw_sector_size(DEFAULT_HW_SECTOR_SIZE), file_pathname(false),
-      isRaw(true), offset(0), alignment(0), disk_id(0), is_mmapable_internal(false)
+      isRaw(true), offset(0), alignment(0), dio_alignment(0), disk_id(0), is_mmapable_internal(false)
   { }
   ~Span();
 };
@@ -172,6 +173,7 @@ struct Store
   int n_interim_disks;
   Span **interim_disk;
   const char *read_interim_config();
+  void add_interim(Span *s);
 #endif
   //
   // returns NULL on success
@@ -183,6 +185,9 @@ struct Store
 private:
   char const * const vol_str;
   int getVolume(char* line);
+#if TS_USE_INTERIM_CACHE == 1
+  bool getInterim(char* line);
+#endif
 };
 
 extern Store theStore;
@@ -0,0 +1,42 @@
+/** @file
+
+  Disk cache write admission
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#ifndef _P_CACHE_ADMISSION_H__
+#define _P_CACHE_ADMISSION_H__
+
+#include "I_Cache.h"
+
+// Generic disk cache admission interface, consulted for documents which
+// are not in the cache yet.  Implementations do their own locking.
+
+struct CacheAdmission {
+  // returns true if a new document with this key should be written
+  virtual bool admit(INK_MD5 *key) = 0;
+
+  virtual void init(int64_t objects, Vol *vol) = 0;
+  virtual ~CacheAdmission() {};
+};
+
+CacheAdmission *new_CacheAdmissionSketch();
+
+#endif /* _P_CACHE_ADMISSION_H__ */
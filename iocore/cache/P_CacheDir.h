@@ -43,6 +43,10 @@ struct CacheVC;
 
 #define MAX_DIR_SEGMENTS                (32 * (1<<16))
 #define DIR_DEPTH                       4
+// Every bucket has a 16 bit summary of the tags on its chain, one bit for
+// each value of their low 4 bits, which lets dir_probe() turn away most
+// misses without reading the bucket.  The summaries are kept in memory only.
+#define DIR_TAG_SUMMARY_BIT(_t)         ((uint16_t)(1 << ((_t) & 15)))
 #define DIR_SIZE_WIDTH                  6
 #define DIR_BLOCK_SIZES                 4
 #define DIR_BLOCK_SHIFT(_i)             (3*(_i))
@@ -53,6 +57,12 @@ struct CacheVC;
 
 #define SYNC_MAX_WRITE                  (2 * 1024 * 1024)
 #define SYNC_DELAY                      HRTIME_MSECONDS(500)
+
+// Vol::segment_dirty, which on disk copies of the directory a segment
+// differs from and whether it is part of the copy being written
+#define DIR_SYNC_STALE(_copy)           (1 << (_copy))
+#define DIR_SYNC_STALE_ALL              (DIR_SYNC_STALE(0) | DIR_SYNC_STALE(1))
+#define DIR_SYNC_WRITING                4
 #define DO_NOT_REMOVE_THIS              0
 
 // Debugging Options
@@ -298,12 +308,17 @@ struct CacheSync: public Continuation
   char *buf;
   size_t buflen;
   off_t writepos;
+  int64_t vol_bytes;            // written for this volume by this pass
+  int64_t pass_bytes;           // written for all the volumes by this pass
+  ink_hrtime write_start;
   AIOCallbackInternal io;
   Event *trigger;
   int mainEvent(int event, Event *e);
   void aio_write(int fd, char *b, int n, off_t o);
+  ink_hrtime write_delay();
 
-  CacheSync():Continuation(new_ProxyMutex()), vol(0), buf(0), buflen(0), writepos(0), trigger(0)
+  CacheSync():Continuation(new_ProxyMutex()), vol(0), buf(0), buflen(0), writepos(0), vol_bytes(0), pass_bytes(0),
+              write_start(0), trigger(0)
   {
     SET_HANDLER(&CacheSync::mainEvent);
   }
@@ -312,8 +327,10 @@ struct CacheSync: public Continuation
 // Global Functions
 
 void vol_init_dir(Vol *d);
+void vol_reset_tag_summary(Vol *d);
 int dir_token_probe(CacheKey *, Vol *, Dir *);
 int dir_probe(CacheKey *, Vol *, Dir *, Dir **);
+int dir_probe_nolock(CacheKey *, Vol *, Dir *);
 int dir_insert(CacheKey *key, Vol *d, Dir *to_part);
 int dir_overwrite(CacheKey *key, Vol *d, Dir *to_part, Dir *overwrite, bool must_overwrite = true);
 int dir_delete(CacheKey *key, Vol *d, Dir *del);
@@ -333,6 +350,49 @@ int dir_segment_accounted(int s, Vol *d, int offby = 0,
 uint64_t dir_entries_used(Vol *d);
 void sync_cache_dir_on_shutdown();
 
+// A copy of one directory segment, with the volume state needed to tell
+// the validity and the age of its entries. Taken with the volume locked,
+// looked at without the lock.
+struct DirSegmentSnapshot
+{
+  Dir *seg;
+  int size;                     // entries seg has room for
+  int buckets;
+  int phase;
+  off_t start;                  // of the data
+  off_t end;
+  off_t write_pos;
+  off_t agg_pos;
+  off_t valid_end;              // end of the data in the aggregation buffer
+
+  DirSegmentSnapshot():seg(0), size(0), buckets(0), phase(0), start(0), end(0), write_pos(0), agg_pos(0), valid_end(0) { }
+  ~DirSegmentSnapshot() { ats_free(seg); }
+};
+
+#define DIR_SNAPSHOT_AGES               10
+#define DIR_SNAPSHOT_CHAINS             5
+
+// What the snapshots of a volume's segments add up to.
+struct DirSnapshotStats
+{
+  int64_t entries;
+  int64_t used;
+  int64_t valid;
+  int64_t stale;                // used, but the data was overwritten
+  int64_t heads;                // first fragments, one per object
+  int64_t valid_bytes;
+  int64_t data_bytes;           // of the volume
+  // valid entries by how far behind the write position their data
+  // is, in tenths of the volume
+  int64_t age[DIR_SNAPSHOT_AGES];
+  // buckets by the number of entries in their chain, the last one for
+  // that many or more
+  int64_t chain[DIR_SNAPSHOT_CHAINS];
+};
+
+void dir_segment_snapshot(Vol *d, int s, DirSegmentSnapshot *snap);
+void dir_segment_snapshot_account(DirSegmentSnapshot *snap, DirSnapshotStats *stats);
+
 // Global Data
 
 extern Dir empty_dir;
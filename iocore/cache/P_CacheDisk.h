@@ -97,6 +97,7 @@ struct CacheDisk: public Continuation
   off_t num_usable_blocks;
   int hw_sector_size;
   int fd;
+  int sendfile_fd;              // buffered, read only fd for proxy.config.cache.sendfile
   off_t free_space;
   off_t wasted_space;
   DiskVol **disk_vols;
@@ -108,7 +109,7 @@ struct CacheDisk: public Continuation
   CacheDisk()
     : Continuation(new_ProxyMutex()), header(NULL),
       path(NULL), header_len(0), len(0), start(0), skip(0),
-      num_usable_blocks(0), fd(-1), free_space(0), wasted_space(0),
+      num_usable_blocks(0), fd(-1), sendfile_fd(-1), free_space(0), wasted_space(0),
       disk_vols(NULL), free_blocks(NULL), num_errors(0), cleared(0),
       forced_volume_num(0)
   { }
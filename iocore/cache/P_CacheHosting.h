@@ -163,6 +163,7 @@ struct ConfigVol
   off_t size;
   bool in_percent;
   int percent;
+  int fragment_size;            // 0 for proxy.config.cache.target_fragment_size
   CacheVol *cachep;
   LINK(ConfigVol, link);
 };
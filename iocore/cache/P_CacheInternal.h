@@ -130,14 +130,17 @@ enum
   cache_read_active_stat,
   cache_read_success_stat,
   cache_read_failure_stat,
-#if TS_USE_INTERIM_CACHE == 1
-  cache_interim_read_success_stat,
   cache_disk_read_success_stat,
   cache_ram_read_success_stat,
+#if TS_USE_INTERIM_CACHE == 1
+  cache_interim_read_success_stat,
+  cache_interim_migrate_stat,
+  cache_interim_evict_stat,
 #endif
   cache_write_active_stat,
   cache_write_success_stat,
   cache_write_failure_stat,
+  cache_write_not_admitted_stat,
   cache_write_backlog_failure_stat,
   cache_update_active_stat,
   cache_update_success_stat,
@@ -148,6 +151,10 @@ enum
   cache_evacuate_active_stat,
   cache_evacuate_success_stat,
   cache_evacuate_failure_stat,
+  cache_evacuate_bytes_stat,
+  cache_evacuate_skipped_bytes_stat,
+  cache_dedup_fragments_stat,
+  cache_dedup_bytes_stat,
   cache_scan_active_stat,
   cache_scan_success_stat,
   cache_scan_failure_stat,
@@ -156,13 +163,23 @@ enum
   cache_two_fragment_document_count_stat,
   cache_three_plus_plus_fragment_document_count_stat,
   cache_read_busy_success_stat,
+  cache_read_busy_streaming_stat,
   cache_read_busy_failure_stat,
+  cache_read_ahead_hit_stat,
+  cache_read_ahead_wasted_stat,
+  cache_read_lock_retry_stat,
+  cache_read_nolock_miss_stat,
   cache_gc_bytes_evacuated_stat,
   cache_gc_frags_evacuated_stat,
   cache_write_bytes_stat,
   cache_hdr_vector_marshal_stat,
   cache_hdr_marshal_stat,
   cache_hdr_marshal_bytes_stat,
+  cache_hdr_deflated_bytes_saved_stat,
+  cache_dir_sync_bytes_stat,
+  cache_dir_sync_segments_stat,
+  cache_dir_sync_last_pass_bytes_stat,
+  cache_startup_msec_stat,
   cache_stat_count
 };
 
@@ -212,6 +229,11 @@ do { \
 
 // Configuration
 extern int cache_config_dir_sync_frequency;
+extern int cache_config_wait_for_all_volumes;
+extern int cache_config_admission_policy;
+extern int cache_config_admission_threshold;
+extern int64_t cache_config_dir_sync_max_rate;
+extern int64_t cache_config_ram_cache_cutoff;
 extern int cache_config_http_max_alts;
 extern int cache_config_permit_pinning;
 extern int cache_config_select_alternate;
@@ -220,14 +242,20 @@ extern int cache_config_max_doc_size;
 extern int cache_config_min_average_object_size;
 extern int cache_config_agg_write_backlog;
 extern int cache_config_enable_checksum;
+extern int cache_config_sendfile;
+extern int cache_config_direct_io;
+extern int cache_config_compress_headers;
 extern int cache_config_alt_rewrite_max_size;
 extern int cache_config_read_while_writer;
+extern int64_t cache_config_read_while_writer_stream_max_size;
 extern char cache_system_config_directory[PATH_NAME_MAX + 1];
 extern int cache_clustering_enabled;
 extern int cache_config_agg_write_backlog;
 extern int cache_config_ram_cache_compress;
 extern int cache_config_ram_cache_compress_percent;
 extern int cache_config_ram_cache_use_seen_filter;
+extern int cache_config_ram_cache_snapshot;
+extern int cache_config_ram_cache_warm_rate;
 #ifdef HIT_EVACUATE
 extern int cache_config_hit_evacuate_percent;
 extern int cache_config_hit_evacuate_size_limit;
@@ -235,9 +263,60 @@ extern int cache_config_hit_evacuate_size_limit;
 extern int cache_config_force_sector_size;
 extern int cache_config_target_fragment_size;
 extern int cache_config_mutex_retry_delay;
+extern int cache_config_read_ahead;
+extern int cache_config_scan_parallel;
+extern int cache_config_vol_hash_algorithm;
+extern int cache_config_evacuate_min_frequency;
+extern int cache_config_evacuate_pin_margin;
+extern int cache_config_dedup_entries;
 #if TS_USE_INTERIM_CACHE == 1
 extern int good_interim_disks;
 #endif
+
+// Shared by a writer and the readers streaming its document from memory
+// before the first fragment is on disk (read_while_writer 2).  The writer
+// publishes how much of the document it has taken in, and how it closed
+// once it is gone; the readers follow the writer's buffer blocks.
+//
+// While the document is no bigger than read_while_writer.stream_max_size
+// the stream also holds the block chain from the start of the document,
+// so that readers arriving after fragments are on disk share the same
+// blocks rather than each reading the fragments back.  'head' is only
+// touched with the writer's mutex held.
+struct CacheWriterStream: public RefCountObj
+{
+  volatile int64_t avail;
+  volatile int32_t closed;
+  Ptr<IOBufferBlock> head;
+  int64_t head_offset;
+
+  CacheWriterStream():avail(0), closed(0), head_offset(0) {}
+};
+
+// A read of a fragment the reader has not asked for yet.  It belongs to
+// the CacheVC which issued it until the reader adopts or drops it; a
+// dropped read still in flight frees itself when it completes.
+struct CacheReadAhead: public Continuation
+{
+  CacheVC *vc;                  // NULL once dropped
+  CacheKey key;
+  Dir dir;
+  Ptr<IOBufferData> buf;
+  AIOCallbackInternal io;
+  bool done;
+  bool wanted;                  // the reader is waiting on this read
+  LINK(CacheReadAhead, link);
+
+  int readDone(int event, void *data);
+
+  CacheReadAhead():Continuation(NULL), vc(NULL), done(false), wanted(false)
+  {
+    SET_HANDLER(&CacheReadAhead::readDone);
+  }
+};
+
+extern ClassAllocator<CacheReadAhead> cacheReadAheadAllocator;
+
 // CacheVC
 struct CacheVC: public CacheVConnection
 {
@@ -312,6 +391,7 @@ struct CacheVC: public CacheVConnection
   int openReadStartHead(int event, Event *e);
   int openReadFromWriter(int event, Event *e);
   int openReadFromWriterMain(int event, Event *e);
+  int openReadFromWriterStream(int event, Event *e);
   int openReadFromWriterFailure(int event, Event *);
   int openReadChooseWriter(int event, Event *e);
 
@@ -337,6 +417,10 @@ struct CacheVC: public CacheVConnection
   int derefRead(int event, Event *e);
 
   int scanVol(int event, Event *e);
+  int scanVolumes(int event, Event *e);
+  int scanVolumeDone();
+  int scanHead(int event, Event *e);
+  void scanAddHeads(Vol *d, int s);
   int scanObject(int event, Event *e);
   int scanUpdateDone(int event, Event *e);
   int scanOpenWrite(int event, Event *e);
@@ -357,6 +441,11 @@ struct CacheVC: public CacheVConnection
   int evacuateDocDone(int event, Event *e);
   int evacuateReadHead(int event, Event *e);
 
+  void read_ahead();
+  int adopt_read_ahead();
+  void drop_read_ahead();
+  void dedup_hash();
+
   void cancel_trigger();
   virtual int64_t get_object_size();
 #ifdef HTTP_CACHE
@@ -392,6 +481,8 @@ struct CacheVC: public CacheVConnection
   // before being used by the CacheVC
   CacheKey key, first_key, earliest_key, update_key;
   Dir dir, earliest_dir, overwrite_dir, first_dir;
+  CacheKey link_key;            // the fragment a deduplicated fragment links to
+  INK_MD5 data_hash;            // of the fragment being written, if f.dedup_hashed
   // end Region A
 
   // Start Region B
@@ -406,8 +497,10 @@ struct CacheVC: public CacheVConnection
   CacheHTTPInfo alternate;
   Ptr<IOBufferData> buf;
   Ptr<IOBufferData> first_buf;
+  Ptr<IOBufferData> hdr_buf;    // the vector deflated for agg_copy
   Ptr<IOBufferBlock> blocks; // data available to write
   Ptr<IOBufferBlock> writer_buf;
+  Ptr<CacheWriterStream> stream;
 
   OpenDirEntry *od;
   AIOCallbackInternal io;
@@ -451,6 +544,7 @@ struct CacheVC: public CacheVConnection
   uint64_t seek_to;               // pread offset
   int64_t offset;                 // offset into 'blocks' of data to write
   int64_t writer_offset;          // offset of the writer for reading from a writer
+  int64_t writer_pos;             // document offset of writer_buf when streaming
   int64_t length;                 // length of data available to write
   int64_t doc_pos;                // read position in 'buf'
   uint64_t write_pos;             // length written
@@ -465,6 +559,8 @@ struct CacheVC: public CacheVConnection
   int header_to_write_len;
   void *header_to_write;
   short writer_lock_retry;
+  int read_ahead_window;          // fragments to keep in flight ahead of the reader
+  Queue<CacheReadAhead> read_ahead_queue;
 #if TS_USE_INTERIM_CACHE == 1
   InterimCacheVol *interim_vol;
   MigrateToInterimCache *mts;
@@ -493,6 +589,12 @@ struct CacheVC: public CacheVConnection
       unsigned int rewrite_resident_alt:1;
       unsigned int readers:1;
       unsigned int doc_from_ram_cache:1;
+      unsigned int sendfile:1;      // user can take file backed blocks
+      unsigned int sendfile_frag:1; // buf holds only the Doc header of the fragment
+      unsigned int scan_stop:1;     // the user ended a directory-first scan
+      unsigned int dedup_hashed:1;  // data_hash is set for the fragment being written
+      unsigned int dedup_link:1;    // the fragment is written as a link to link_key
+      unsigned int read_link:1;     // reading link_key for the fragment at key
 #ifdef HIT_EVACUATE
       unsigned int hit_evacuate:1;
 #endif
@@ -513,6 +615,15 @@ struct CacheVC: public CacheVConnection
   // BTF fix to handle objects that overlapped over two different reads,
   // this is how much we need to back up the buffer to get the start of the overlapping object.
   off_t scan_fix_buffer_offset;
+  // directory-first scans, see CacheVC::scanVolumes
+  CacheVC *scan_parent;           // the scan a volume scan belongs to
+  Dir *scan_dirs;                 // head entries of the volume, by offset
+  int scan_ndirs;
+  int scan_dirs_size;
+  int scan_dir_index;
+  int scan_seg;                   // next directory segment to go through
+  int scan_workers;               // volume scans running
+  int scan_next_vol;              // next volume to scan
   //end region C
 };
 
@@ -547,6 +658,9 @@ extern CacheSync *cacheDirSync;
 #ifdef HTTP_CACHE
 int cache_write(CacheVC *, CacheHTTPInfoVector *);
 int get_alternate_index(CacheHTTPInfoVector *cache_vector, CacheKey key);
+void unmarshal_helper(Doc *doc, Ptr<IOBufferData> &buf, int &okay);
+int deflate_doc_hdr(char *to, int to_len, const char *from, int from_len);
+IOBufferData *inflate_doc_hdr(Doc *doc);
 #endif
 CacheVC *new_DocEvacuator(int nbytes, Vol *d);
 
@@ -584,17 +698,17 @@ free_CacheVC(CacheVC *cont)
     CACHE_DECREMENT_DYN_STAT(cont->base_stat + CACHE_STAT_ACTIVE);
     if (cont->closed > 0) {
       CACHE_INCREMENT_DYN_STAT(cont->base_stat + CACHE_STAT_SUCCESS);
-#if TS_USE_INTERIM_CACHE == 1
       if (cont->vio.op == VIO::READ) {
         if (cont->f.doc_from_ram_cache) {
           CACHE_INCREMENT_DYN_STAT(cache_ram_read_success_stat);
+#if TS_USE_INTERIM_CACHE == 1
         } else if (cont->f.read_from_interim) {
           CACHE_INCREMENT_DYN_STAT(cache_interim_read_success_stat);
+#endif
         } else {
           CACHE_INCREMENT_DYN_STAT(cache_disk_read_success_stat);
         }
       }
-#endif
     }                             // else abort,cancel
   }
   ink_assert(mutex->thread_holding == this_ethread());
@@ -602,6 +716,14 @@ free_CacheVC(CacheVC *cont)
     cont->trigger->cancel();
   ink_assert(!cont->is_io_in_progress());
   ink_assert(!cont->od);
+  if (cont->read_ahead_queue.head)
+    cont->drop_read_ahead();
+  if (cont->stream && cont->vio.op == VIO::WRITE) {
+    ink_atomic_swap(&cont->stream->avail, (int64_t)cont->total_len);
+    ink_atomic_swap(&cont->stream->closed, (int32_t)(cont->closed > 0 ? 1 : -1));
+    // readers still streaming hold their own place in the chain
+    cont->stream->head.clear();
+  }
   /* calling cont->io.action = NULL causes compile problem on 2.6 solaris
      release build....wierd??? For now, null out continuation and mutex
      of the action separately */
@@ -611,6 +733,7 @@ free_CacheVC(CacheVC *cont)
   cont->io.aio_result = 0;
   cont->io.aiocb.aio_nbytes = 0;
   cont->io.aiocb.aio_reqprio = AIO_DEFAULT_PRIORITY;
+  cont->io.io_class = AIO_CLASS_USER_READ;
 #ifdef HTTP_CACHE
   cont->request.reset();
   cont->vector.clear();
@@ -628,11 +751,15 @@ free_CacheVC(CacheVC *cont)
   cont->mutex.clear();
   cont->buf.clear();
   cont->first_buf.clear();
+  cont->hdr_buf.clear();
   cont->blocks.clear();
   cont->writer_buf.clear();
+  cont->stream.clear();
   cont->alternate_index = CACHE_ALT_INDEX_DEFAULT;
   if (cont->scan_vol_map)
     ats_free(cont->scan_vol_map);
+  if (cont->scan_dirs)
+    ats_free(cont->scan_dirs);
   memset((char *) &cont->vio, 0, cont->size_to_init);
 #ifdef CACHE_STAT_PAGES
   ink_assert(!cont->stat_link.next && !cont->stat_link.prev);
@@ -687,9 +814,11 @@ CacheVC::do_read_call(CacheKey *akey)
   f.transistor = 0;
   f.read_from_interim = dir_ininterim(&dir);
 
+  // admission is by recent frequency (TinyLFU): a key read migrate_threshold
+  // times since the sketch last aged is copied to the interim cache
   if (!f.read_from_interim && vio.op == VIO::READ && good_interim_disks > 0){
-    vol->history.put_key(read_key);
-    if (vol->history.is_hot(read_key) && !vol->migrate_probe(read_key, NULL) && !od) {
+    vol->history.increment(read_key->fold());
+    if (vol->history.estimate(read_key->fold()) >= migrate_threshold && !vol->migrate_probe(read_key, NULL) && !od) {
       f.write_into_interim = 1;
     }
   }
@@ -1119,12 +1248,12 @@ Cache::generate_key(INK_MD5 *md5, URL *url, CacheHTTPHdr */* request ATS_UNUSED
       const char *value = request->value_get(MIME_FIELD_USER_AGENT,
                                              MIME_LEN_USER_AGENT, &ua_len);
       if (value) {
-        INK_DIGEST_CTX context;
+        INK_KEY_CTX context;
         // Mix the user-agent and URL INK_MD5's
-        ink_code_incr_md5_init(&context);
-        ink_code_incr_md5_update(&context, value, ua_len);
-        ink_code_incr_md5_update(&context, (char *) md5, sizeof(INK_MD5));
-        ink_code_incr_md5_final((char *) md5, &context);
+        ink_code_incr_key_init(&context);
+        ink_code_incr_key_update(&context, value, ua_len);
+        ink_code_incr_key_update(&context, (char *) md5, sizeof(INK_MD5));
+        ink_code_incr_key_final((char *) md5, &context);
       }
       return;
     }
@@ -1172,7 +1301,7 @@ CacheProcessor::lookup(Continuation *cont, CacheKey *key, bool cluster_cache_loc
 {
 #ifdef CLUSTER_CACHE
   // Try to send remote, if not possible, handle locally
-  if ((cache_clustering_enabled > 0) && !cluster_cache_local && !local_only) {
+  if ((cache_clustering_enabled > 0) && !cluster_cache_local && !local_only && !cluster_near_cache_local(key)) {
     Action *a = Cluster_lookup(cont, key, frag_type, hostname, host_len);
     if (a) {
       return a;
@@ -1219,7 +1348,7 @@ CacheProcessor::open_write(Continuation *cont, CacheKey *key, bool cluster_cache
 #ifdef CLUSTER_CACHE
   if (cache_clustering_enabled > 0 && !cluster_cache_local) {
     ClusterMachine *m = cluster_machine_at_depth(cache_hash(*key));
-    if (m)
+    if (m && !cluster_near_cache_local(key))
       return Cluster_write(cont, expected_size, (MIOBuffer *) 0, m,
                          key, frag_type, options, pin_in_cache,
                          CACHE_OPEN_WRITE, key, (CacheURL *) 0,
@@ -1255,6 +1384,7 @@ CacheProcessor::remove(Continuation *cont, CacheKey *key, bool cluster_cache_loc
   if (cache_clustering_enabled > 0 && !cluster_cache_local) {
     ClusterMachine *m = cluster_machine_at_depth(cache_hash(*key));
 
+    cluster_near_cache_forget(key);
     if (m) {
       return Cluster_remove(m, cont, key, rm_user_agents, rm_link, frag_type, hostname, host_len);
     }
@@ -1332,8 +1462,15 @@ CacheProcessor::open_read_internal(int opcode,
     url_md5 = *key;
   }
   ClusterMachine *m = cluster_machine_at_depth(cache_hash(url_md5));
+  ClusterMachine *pm;
+  bool near_local = m && cluster_near_cache_local(&url_md5);
 
-  if (m) {
+  if (!near_local && (opcode == CACHE_OPEN_READ || opcode == CACHE_OPEN_READ_LONG)
+      && cluster_previous_owner(cache_hash(url_md5), &pm) && pm != m) {
+    return Cluster_read_fallback(m, pm, opcode, cont, url, request, params, &url_md5,
+                                 pin_in_cache, frag_type, hostname, host_len);
+  }
+  if (m && !near_local) {
     return Cluster_read(m, opcode, cont, buf, url,
                         request, params, key, pin_in_cache, frag_type, hostname, host_len);
   } else {
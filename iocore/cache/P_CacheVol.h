@@ -36,13 +36,15 @@
 #define VOL_MAGIC                      0xF1D0F00D
 #define START_BLOCKS                    16      // 8k, STORE_BLOCK_SIZE
 #define START_POS                       ((off_t)START_BLOCKS * CACHE_BLOCK_SIZE)
-#define AGG_SIZE                        (4 * 1024 * 1024) // 4MB
-#define AGG_HIGH_WATER                  (AGG_SIZE / 2) // 2MB
+#define AGG_SIZE                        (4 * 1024 * 1024) // 4MB, largest aggregation write
+#define AGG_HIGH_WATER                  (cache_config_agg_write_size / 2)
 #define EVACUATION_SIZE                 (2 * AGG_SIZE)  // 8MB
 #define MAX_VOL_SIZE                   ((off_t)512 * 1024 * 1024 * 1024 * 1024)
 #define STORE_BLOCKS_PER_CACHE_BLOCK    (STORE_BLOCK_SIZE / CACHE_BLOCK_SIZE)
 #define MAX_VOL_BLOCKS                 (MAX_VOL_SIZE / CACHE_BLOCK_SIZE)
 #define MAX_FRAG_SIZE                   (AGG_SIZE - sizeofDoc) // true max
+#define AGG_MAX_FRAG_SIZE               (cache_config_agg_write_size - sizeofDoc) // max for new fragments
+#define LARGE_FRAG_SIZE                 DIR_SIZE_WITH_BLOCK(DIR_BLOCK_SIZES - 1) // 16MB, largest a Dir can describe
 #define LEAVE_FREE                      DEFAULT_MAX_BUFFER_SIZE
 #define PIN_SCAN_EVERY                  16      // scan every 1/16 of disk
 #define VOL_HASH_TABLE_SIZE             32707
@@ -55,6 +57,7 @@
 #define AIO_AGG_WRITE_IN_PROGRESS       -1
 #define AUTO_SIZE_RAM_CACHE             -1      // 1-1 with directory size
 #define DEFAULT_TARGET_FRAGMENT_SIZE    (1048576 - sizeofDoc) // 1MB
+#define DEDUP_MIN_FRAGMENT_SIZE         (64 * 1024) // smaller fragments are not worth a link
 
 
 #define dir_offset_evac_bucket(_o) \
@@ -93,7 +96,7 @@ struct VolHeaderFooter
   uint32_t write_serial;
   uint32_t dirty;
   uint32_t sector_size;
-  uint32_t unused;                // pad out to 8 byte boundary
+  uint32_t key_hash;              // INK_KEY_HASH_*, 0 (MD5) in older caches
   uint16_t freelist[1];
 };
 
@@ -115,7 +118,8 @@ struct EvacuationBlock
       unsigned int done:1;              // has been evacuated
       unsigned int pinned:1;            // check pinning timeout
       unsigned int evacuate_head:1;     // check pinning timeout
-      unsigned int unused:29;
+      unsigned int link_target:1;       // just this fragment, fragments link to it
+      unsigned int unused:28;
     } f;
   };
 
@@ -128,170 +132,24 @@ struct EvacuationBlock
   LINK(EvacuationBlock, link);
 };
 
-#if TS_USE_INTERIM_CACHE == 1
-#define MIGRATE_BUCKETS                 1021
-extern int migrate_threshold;
-extern int good_interim_disks;
-
-union AccessEntry {
-  uintptr_t v[2];
-  struct {
-    uint32_t  next;
-    uint32_t  prev;
-    uint32_t  index;
-    uint16_t  tag;
-    int16_t  count;
-  } item;
+// A fragment written to the volume, by the MD5 of its data, for
+// deduplicated fragments to link to. The entry only holds while the
+// fragment is where it was written.
+struct CacheDedupEntry
+{
+  INK_MD5 hash;
+  CacheKey key;
+  Dir dir;
+  uint32_t len;
 };
 
-struct AccessHistory {
-  AccessEntry *base;
-  int size; // 1M
-
-  uint32_t *hash;
-  int hash_size; // 2097143
-
-  AccessEntry *freelist;
-
-  void freeEntry(AccessEntry *entry) {
-    entry->v[0] = (uintptr_t) freelist;
-    entry->v[1] = 0xABCD1234U;
-    freelist = entry;
-  }
-
-  void init(int size, int hash_size) {
-    this->size = size;
-    this->hash_size = hash_size;
-    freelist = NULL;
-
-    base = (AccessEntry *) malloc(sizeof(AccessEntry) * size);
-    hash = (uint32_t *) malloc (sizeof(uint32_t) * hash_size);
-
-    memset(hash, 0, sizeof(uint32_t) * hash_size);
-
-    base[0].item.next = base[0].item.prev = 0;
-    base[0].v[1] = 0xABCD1234UL;
-    for (int i = size; --i > 0;)
-     freeEntry(&base[i]);
-
-    return;
-  }
-
-  void remove(AccessEntry *entry) {
-    if (entry == &(base[base[0].item.prev])) { // head
-      base[0].item.prev = entry->item.next;
-    } else {
-      base[entry->item.prev].item.next = entry->item.next;
-    }
-    if (entry == &(base[base[0].item.next])) { // tail
-      base[0].item.next = entry->item.prev;
-    } else {
-      base[entry->item.next].item.prev = entry->item.prev;
-    }
-    uint32_t hash_index = (uint32_t) (entry->item.index % hash_size);
-    hash[hash_index] = 0;
-  }
-
-  void enqueue(AccessEntry *entry) {
-    uint32_t hash_index = (uint32_t) (entry->item.index % hash_size);
-    hash[hash_index] = entry - base;
+#include "FrequencySketch.h"
 
-    entry->item.prev = 0;
-    entry->item.next = base[0].item.prev;
-    base[base[0].item.prev].item.prev = entry - base;
-    base[0].item.prev = entry - base;
-    if (base[0].item.next == 0)
-      base[0].item.next = entry - base;
-  }
-
-  AccessEntry* dequeue() {
-    AccessEntry *tail = &base[base[0].item.next];
-    if (tail != base)
-      remove(tail);
-
-    return tail;
-  }
-
-  void set_in_progress(INK_MD5 *key) {
-    uint32_t key_index = key->word(3);
-    uint16_t tag = (uint16_t) key->word(1);
-    unsigned int hash_index = (uint32_t) (key_index % hash_size);
-
-    uint32_t index = hash[hash_index];
-    AccessEntry *entry = &base[index];
-    if (index != 0 && entry->item.tag == tag && entry->item.index == key_index) {
-      entry->item.count |= 0x8000;
-    }
-  }
-
-  void set_not_in_progress(INK_MD5 *key) {
-    uint32_t key_index = key->word(3);
-    uint16_t tag = (uint16_t) key->word(1);
-    unsigned int hash_index = (uint32_t) (key_index % hash_size);
-
-    uint32_t index = hash[hash_index];
-    AccessEntry *entry = &base[index];
-    if (index != 0 && entry->item.tag == tag && entry->item.index == key_index) {
-      entry->item.count &= 0x7FFF;
-    }
-  }
-
-  void put_key(INK_MD5 *key) {
-    uint32_t key_index = key->word(3);
-    uint16_t tag = (uint16_t) key->word(1);
-    unsigned int hash_index = (uint32_t) (key_index % hash_size);
-
-    uint32_t index = hash[hash_index];
-    AccessEntry *entry = &base[index];
-    if (index != 0 && entry->item.tag == tag && entry->item.index == key_index) { // seen before
-      remove(entry);
-      enqueue(entry);
-      ++entry->item.count;
-    } else {
-      if (index == 0) { // not seen before
-        if (!freelist) {
-          entry = dequeue();
-          if (entry == base) {
-            return;
-          }
-        } else {
-          entry = freelist;
-          freelist = (AccessEntry *) entry->v[0];
-        }
-      } else { // collation
-        remove(entry);
-      }
-      entry->item.index = key_index;
-      entry->item.tag = tag;
-      entry->item.count = 1;
-      enqueue(entry);
-    }
-  }
-
-  bool remove_key(INK_MD5 *key) {
-    unsigned int hash_index = (uint32_t) (key->word(3) % hash_size);
-    uint32_t index = hash[hash_index];
-    AccessEntry *entry = &base[index];
-    if (index != 0 && entry->item.tag == (uint16_t)key->word(1) && entry->item.index == key->word(3)) {
-      remove(entry);
-      freeEntry(entry);
-      return true;
-    }
-    return false;
-  }
-
-  bool is_hot(INK_MD5 *key) {
-    uint32_t key_index = key->word(3);
-    uint16_t tag = (uint16_t) key->word(1);
-    unsigned int hash_index = (uint32_t) (key_index % hash_size);
-
-    uint32_t index = hash[hash_index];
-    AccessEntry *entry = &base[index];
+#if TS_USE_INTERIM_CACHE == 1
 
-    return (index != 0 && entry->item.tag == tag && entry->item.index == key_index
-        && entry->item.count >= migrate_threshold);
-  }
-};
+#define MIGRATE_BUCKETS                 1021
+extern int migrate_threshold;
+extern int good_interim_disks;
 
 struct InterimCacheVol;
 
@@ -339,6 +197,11 @@ struct InterimCacheVol: public Continuation
     io.aiocb.aio_fildes = AIO_NOT_IN_PROGRESS;
   }
 
+  // end of the data held in memory, the agg buffer sits at write_pos
+  off_t agg_write_end() {
+    return header->write_pos + agg_buf_pos;
+  }
+
   int aggWrite(int event, void *e);
   int aggWriteDone(int event, void *e);
   uint32_t round_to_approx_size (uint32_t l) {
@@ -383,6 +246,30 @@ void clean_interimvol(InterimCacheVol *d);
 
 #endif
 
+extern int cache_config_agg_write_size;
+extern int cache_config_agg_write_buffers;
+extern int cache_config_target_fragment_size;
+
+// One buffer of a volume's aggregation write ring. Once issued it owns
+// the disk range of its write and keeps serving reads for it until
+// Vol::aggWriteDone retires it, which happens in issue order.
+struct AggBuffer: public Continuation
+{
+  Vol *vol;
+  char *buf;
+  char *large;                  // replaces buf for a fragment larger than AGG_SIZE
+  bool in_flight;
+  bool done;                    // the write completed but is not yet retired
+  AIOCallbackInternal io;
+
+  int writeDone(int event, void *data);
+
+  AggBuffer()
+    : Continuation(NULL), vol(NULL), buf(NULL), large(NULL), in_flight(false), done(false) {
+    SET_HANDLER(&AggBuffer::writeDone);
+  }
+};
+
 struct Vol: public Continuation
 {
   char *path;
@@ -396,6 +283,10 @@ struct Vol: public Continuation
   VolHeaderFooter *footer;
   int segments;
   off_t buckets;
+  uint16_t *tag_summary;    // DIR_TAG_SUMMARY_BIT of each bucket, by segment
+  uint8_t *segment_dirty;   // DIR_SYNC_* of each segment
+  volatile int32_t *segment_seq; // odd while a segment is being changed, see dir_probe_nolock()
+  int segment_writing;      // depth of the change in progress
   off_t recover_pos;
   off_t prev_recover_pos;
   off_t scan_pos;
@@ -409,18 +300,28 @@ struct Vol: public Continuation
   Queue<CacheVC, Continuation::Link_link> agg;
   Queue<CacheVC, Continuation::Link_link> stat_cache_vcs;
   Queue<CacheVC, Continuation::Link_link> sync;
-  char *agg_buffer;
+  char *agg_buffer;             // the buffer being filled, written at header->agg_pos
   int agg_todo_size;
   int agg_buf_pos;
+  AggBuffer *agg_bufs;          // write ring, writes are issued from agg_fill
+  int agg_nbufs;
+  int agg_fill;
+  int agg_head;                 // oldest write in flight
+  int agg_inflight;
+  int agg_inflight_bytes;
 
   Event *trigger;
 
   OpenDir open_dir;
   RamCache *ram_cache;
+  CacheAdmission *admission;    // NULL admits every write
   int evacuate_size;
   DLL<EvacuationBlock> *evacuate;
   DLL<EvacuationBlock> lookaside[LOOKASIDE_SIZE];
   CacheVC *doc_evacuator;
+  FrequencySketch access;       // reads of documents by head offset, for evacuation
+  CacheDedupEntry *dedup;       // by content hash, NULL if not deduplicating
+  int dedup_entries;
 
   VolInitInfo *init_info;
 
@@ -434,6 +335,7 @@ struct Vol: public Continuation
   bool dir_sync_waiting;
   bool dir_sync_in_progress;
   bool writing_end_marker;
+  bool online;                  // the directory is read, keys may hash here
 
   CacheKey first_fragment_key;
   int64_t first_fragment_offset;
@@ -442,7 +344,7 @@ struct Vol: public Continuation
 #if TS_USE_INTERIM_CACHE == 1
   int num_interim_vols;
   InterimCacheVol interim_vols[8];
-  AccessHistory history;
+  FrequencySketch history;      // reads of keys not in the interim cache
   uint32_t interim_index;
   Queue<MigrateToInterimCache, MigrateToInterimCache::Link_hash_link> mig_hash[MIGRATE_BUCKETS];
 
@@ -471,7 +373,6 @@ struct Vol: public Continuation
   void set_migrate_done(MigrateToInterimCache *m) {
     uint32_t indx = m->key.word(3) % MIGRATE_BUCKETS;
     mig_hash[indx].remove(m);
-    history.remove_key(&m->key);
   }
 #endif
 
@@ -509,6 +410,11 @@ struct Vol: public Continuation
   {
     return io.aiocb.aio_fildes != AIO_NOT_IN_PROGRESS;
   }
+  // end of the data held in memory, [write_pos, agg_pos) is in flight
+  off_t agg_write_end()
+  {
+    return header->agg_pos + agg_buf_pos;
+  }
   int increment_generation()
   {
     // this is stored in the offset field of the directory (!=0)
@@ -523,9 +429,10 @@ struct Vol: public Continuation
     io.aiocb.aio_fildes = AIO_NOT_IN_PROGRESS;
   }
   
-  int aggWriteDone(int event, Event *e);
+  int aggWriteDone(int event, AggBuffer *b);
   int aggWrite(int event, void *e);
   void agg_wrap();
+  char *agg_buf_data(off_t o);
 
   int evacuateWrite(CacheVC *evacuator, int event, Event *e);
   int evacuateDocReadDone(int event, Event *e);
@@ -537,23 +444,46 @@ struct Vol: public Continuation
   void evacuate_cleanup_blocks(int i);
   void evacuate_cleanup();
   EvacuationBlock *force_evacuate_head(Dir *dir, int pinned);
+  bool dedup_link(INK_MD5 *hash, uint32_t len, CacheKey *target);
+  void dedup_insert(INK_MD5 *hash, uint32_t len, CacheKey *key, Dir *dir);
   int within_hit_evacuate_window(Dir *dir);
   uint32_t round_to_approx_size(uint32_t l);
+  int target_fragment_size();
+  uint32_t max_fragment_size();
 
   Vol()
     : Continuation(new_ProxyMutex()), path(NULL), fd(-1),
-      dir(0), buckets(0), recover_pos(0), prev_recover_pos(0), scan_pos(0), skip(0), start(0),
-      len(0), data_blocks(0), hit_evacuate_window(0), agg_todo_size(0), agg_buf_pos(0), trigger(0),
-      evacuate_size(0), disk(NULL), last_sync_serial(0), last_write_serial(0), recover_wrapped(false),
-      dir_sync_waiting(0), dir_sync_in_progress(0), writing_end_marker(0) {
+      dir(0), buckets(0), tag_summary(NULL), segment_dirty(NULL), segment_seq(NULL), segment_writing(0), recover_pos(0), prev_recover_pos(0), scan_pos(0), skip(0), start(0),
+      len(0), data_blocks(0), hit_evacuate_window(0), agg_todo_size(0), agg_buf_pos(0),
+      agg_fill(0), agg_head(0), agg_inflight(0), agg_inflight_bytes(0), trigger(0),
+      admission(NULL), evacuate_size(0), dedup(NULL), dedup_entries(0), disk(NULL), last_sync_serial(0), last_write_serial(0), recover_wrapped(false),
+      dir_sync_waiting(0), dir_sync_in_progress(0), writing_end_marker(0), online(false) {
     open_dir.mutex = mutex;
-    agg_buffer = (char *)ats_memalign(ats_pagesize(), AGG_SIZE);
-    memset(agg_buffer, 0, AGG_SIZE);
+    // buffers are AGG_SIZE so documents written under a larger
+    // agg_write_size can still be evacuated
+    agg_nbufs = cache_config_agg_write_buffers;
+    agg_bufs = new AggBuffer[agg_nbufs];
+    for (int i = 0; i < agg_nbufs; i++) {
+      agg_bufs[i].vol = this;
+      agg_bufs[i].mutex = mutex;
+      agg_bufs[i].buf = (char *)ats_memalign(ats_pagesize(), AGG_SIZE);
+      memset(agg_bufs[i].buf, 0, AGG_SIZE);
+    }
+    agg_buffer = agg_bufs[0].buf;
     SET_HANDLER(&Vol::aggWrite);
   }
 
   ~Vol() {
-    ats_memalign_free(agg_buffer);
+    for (int i = 0; i < agg_nbufs; i++) {
+      ats_memalign_free(agg_bufs[i].buf);
+      ats_memalign_free(agg_bufs[i].large);
+    }
+    delete[] agg_bufs;
+    ats_free(tag_summary);
+    ats_free(segment_dirty);
+    ats_free((void *)segment_seq);
+    delete admission;
+    ats_free(dedup);
   }
 };
 
@@ -574,12 +504,13 @@ struct CacheVol
   int num_vols;
   Vol **vols;
   DiskVol **disk_vols;
+  int fragment_size;            // from volume.config, 0 for the global target
   LINK(CacheVol, link);
   // per volume stats
   RecRawStatBlock *vol_rsb;
 
   CacheVol()
-    : vol_number(-1), scheme(0), size(0), num_vols(0), vols(NULL), disk_vols(0), vol_rsb(0)
+    : vol_number(-1), scheme(0), size(0), num_vols(0), vols(NULL), disk_vols(0), fragment_size(0), vol_rsb(0)
   { }
 };
 
@@ -594,7 +525,9 @@ struct Doc
   INK_MD5 key;
   uint32_t hlen;          // header length
   uint32_t ftype:8;       // fragment type CACHE_FRAG_TYPE_XX
-  uint32_t _flen:24;       // fragment table length [amc] NOT USED
+  uint32_t link:1;        // the data is the key of a fragment with the same data
+  uint32_t hdr_deflated:1; // the HTTP headers are deflated, see deflate_doc_hdr()
+  uint32_t _flen:22;       // fragment table length [amc] NOT USED
   uint32_t sync_serial;
   uint32_t write_serial;
   uint32_t pinned;        // pinned until
@@ -638,6 +571,30 @@ vol_direntries(Vol *d)
   return d->buckets * DIR_DEPTH * d->segments;
 }
 
+// the segment must be written to both copies of the directory again
+TS_INLINE void
+vol_dir_segment_dirty(Vol *d, int s)
+{
+  d->segment_dirty[s] |= DIR_SYNC_STALE_ALL;
+}
+
+// Changes to the chains of a segment are bracketed by these so that
+// dir_probe_nolock() can tell that it raced with one.  Nested changes
+// share the bracket of the outermost, they are always to the same segment.
+TS_INLINE void
+vol_dir_segment_begin(Vol *d, int s)
+{
+  if (!d->segment_writing++)
+    ink_atomic_increment(&d->segment_seq[s], 1);
+}
+
+TS_INLINE void
+vol_dir_segment_end(Vol *d, int s)
+{
+  if (!--d->segment_writing)
+    ink_atomic_increment(&d->segment_seq[s], 1);
+}
+
 #if TS_USE_INTERIM_CACHE == 1
 #define vol_out_of_phase_valid(d, e)            \
     (dir_offset(e) - 1 >= ((d->header->agg_pos - d->start) / CACHE_BLOCK_SIZE))
@@ -649,7 +606,7 @@ vol_direntries(Vol *d)
     (dir_offset(e) - 1 >= ((d->header->agg_pos - d->start + AGG_SIZE) / CACHE_BLOCK_SIZE))
 
 #define vol_in_phase_valid(d, e)                \
-    (dir_offset(e) - 1 < ((d->header->write_pos + d->agg_buf_pos - d->start) / CACHE_BLOCK_SIZE))
+    (dir_offset(e) - 1 < ((d->agg_write_end() - d->start) / CACHE_BLOCK_SIZE))
 
 #define vol_offset_to_offset(d, pos)            \
     (d->start + pos * CACHE_BLOCK_SIZE - CACHE_BLOCK_SIZE)
@@ -664,7 +621,7 @@ vol_direntries(Vol *d)
     ((d)->start + (off_t) ((off_t)dir_offset(e) * CACHE_BLOCK_SIZE) - CACHE_BLOCK_SIZE)
 
 #define vol_in_phase_agg_buf_valid(d, e)        \
-    ((vol_offset(d, e) >= d->header->write_pos) && vol_offset(d, e) < (d->header->write_pos + d->agg_buf_pos))
+    ((vol_offset(d, e) >= d->header->write_pos) && vol_offset(d, e) < d->agg_write_end())
 
 #define vol_transistor_range_valid(d, e)    \
   ((d->header->agg_pos + d->transistor_range_threshold < d->start + d->len) ? \
@@ -696,7 +653,7 @@ vol_out_of_phase_write_valid(Vol *d, Dir *e)
 TS_INLINE int
 vol_in_phase_valid(Vol *d, Dir *e)
 {
-  return (dir_offset(e) - 1 < ((d->header->write_pos + d->agg_buf_pos - d->start) / CACHE_BLOCK_SIZE));
+  return (dir_offset(e) - 1 < ((d->agg_write_end() - d->start) / CACHE_BLOCK_SIZE));
 }
 
 TS_INLINE off_t
@@ -726,7 +683,7 @@ vol_dir_segment(Vol *d, int s)
 TS_INLINE int
 vol_in_phase_agg_buf_valid(Vol *d, Dir *e)
 {
-  return (vol_offset(d, e) >= d->header->write_pos && vol_offset(d, e) < (d->header->write_pos + d->agg_buf_pos));
+  return (vol_offset(d, e) >= d->header->write_pos && vol_offset(d, e) < d->agg_write_end());
 }
 #endif
 // length of the partition not including the offset of location 0.
@@ -736,6 +693,19 @@ vol_relative_length(Vol *v, off_t start_offset)
    return (v->len + v->skip) - start_offset;
 }
 
+// Fragments sent with sendfile() are read from the disk after the
+// volume lock has been dropped, so only use it for those far enough
+// ahead of the write cursor that it will not reach them in the meantime.
+TS_INLINE int
+vol_sendfile_valid(Vol *d, Dir *e)
+{
+  off_t o = vol_offset(d, e);
+  off_t ahead = o - d->header->agg_pos;
+  if (ahead < 0)
+    ahead += d->skip + d->len - d->start;
+  return ahead > d->len / 8 && ahead > EVACUATION_SIZE;
+}
+
 TS_INLINE uint32_t
 Doc::prefix_len()
 {
@@ -837,6 +807,24 @@ Vol::round_to_approx_size(uint32_t l) {
   return ROUND_TO_SECTOR(this, ll);
 }
 
+// data bytes the writer aims to put in each fragment
+TS_INLINE int
+Vol::target_fragment_size()
+{
+  if (cache_vol && cache_vol->fragment_size)
+    return cache_vol->fragment_size - sizeofDoc;
+  return cache_config_target_fragment_size - sizeofDoc;
+}
+
+// fragments larger than agg_write_size are written on their own
+TS_INLINE uint32_t
+Vol::max_fragment_size()
+{
+  if (cache_vol && cache_vol->fragment_size > cache_config_agg_write_size)
+    return cache_vol->fragment_size - sizeofDoc;
+  return AGG_MAX_FRAG_SIZE;
+}
+
 #if TS_USE_INTERIM_CACHE == 1
 inline bool
 dir_valid(Vol *_d, Dir *_e) {
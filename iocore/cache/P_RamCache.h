@@ -26,6 +26,16 @@
 
 #include "I_Cache.h"
 
+// One key of a RAM cache, as saved across restarts by ram_cache_snapshot_save().
+struct RamCacheSnapshotEntry {
+  INK_MD5 key;
+  uint32_t auxkey1;
+  uint32_t auxkey2;
+  uint32_t hits;
+  uint32_t size;
+  uint32_t resident; // 1 if the data was in memory, 0 for history only
+};
+
 // Generic Ram Cache interface
 
 struct RamCache {
@@ -35,10 +45,20 @@ struct RamCache {
   virtual int fixup(INK_MD5 *key, uint32_t old_auxkey1, uint32_t old_auxkey2, uint32_t new_auxkey1, uint32_t new_auxkey2) = 0;
 
   virtual void init(int64_t max_bytes, Vol *vol) = 0;
+
+  // Fill in up to max entries describing the cache, most valuable first, returning the number filled.
+  // With no entries, returns the number there are.
+  virtual int snapshot(RamCacheSnapshotEntry * /* entries ATS_UNUSED */, int /* max ATS_UNUSED */) { return 0; }
+  // Seed the replacement history from a snapshot, the data is put() separately.
+  virtual void restore(RamCacheSnapshotEntry * /* entries ATS_UNUSED */, int /* n ATS_UNUSED */) { }
   virtual ~RamCache() {};
 };
 
 RamCache *new_RamCacheLRU();
 RamCache *new_RamCacheCLFUS();
+RamCache *new_RamCacheSharded();
+
+void ram_cache_snapshot_save();
+void ram_cache_snapshot_load();
 
 #endif /* _P_RAM_CACHE_H__ */
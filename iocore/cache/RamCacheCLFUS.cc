@@ -77,6 +77,8 @@ struct RamCacheCLFUS : public RamCache {
   int fixup(INK_MD5 *key, uint32_t old_auxkey1, uint32_t old_auxkey2, uint32_t new_auxkey1, uint32_t new_auxkey2);
 
   void init(int64_t max_bytes, Vol *vol);
+  int snapshot(RamCacheSnapshotEntry *entries, int max);
+  void restore(RamCacheSnapshotEntry *entries, int n);
 
   // private
   Vol *vol; // for stats
@@ -673,9 +675,139 @@ RamCacheCLFUS::fixup(INK_MD5 * key, uint32_t old_auxkey1, uint32_t old_auxkey2,
   return 0;
 }
 
+// Resident entries most recently used first, then the history from the
+// front of the CLOCK.
+int
+RamCacheCLFUS::snapshot(RamCacheSnapshotEntry *entries, int max)
+{
+  int n = 0;
+  if (!max_bytes)
+    return 0;
+  if (!entries)
+    return (int) (objects + history);
+  for (RamCacheCLFUSEntry *e = lru[0].tail; e && n < max; e = e->lru_link.prev, n++) {
+    entries[n].key = e->key;
+    entries[n].auxkey1 = e->auxkey1;
+    entries[n].auxkey2 = e->auxkey2;
+    entries[n].hits = (uint32_t) e->hits;
+    entries[n].size = e->size;
+    entries[n].resident = 1;
+  }
+  for (RamCacheCLFUSEntry *e = lru[1].head; e && n < max; e = e->lru_link.next, n++) {
+    entries[n].key = e->key;
+    entries[n].auxkey1 = e->auxkey1;
+    entries[n].auxkey2 = e->auxkey2;
+    entries[n].hits = (uint32_t) e->hits;
+    entries[n].size = e->size;
+    entries[n].resident = 0;
+  }
+  return n;
+}
+
+// Every entry goes into the history with its saved hits, so that when the
+// warmer (or a client) puts the data it competes as it did before the restart.
+void
+RamCacheCLFUS::restore(RamCacheSnapshotEntry *entries, int n)
+{
+  if (!max_bytes)
+    return;
+  for (int j = 0; j < n; j++) {
+    RamCacheSnapshotEntry *s = &entries[j];
+    uint32_t i = s->key.word(3) % nbuckets;
+    RamCacheCLFUSEntry *e = bucket[i].head;
+    while (e && !(e->key == s->key))
+      e = e->hash_link.next;
+    if (e)
+      continue;
+    e = THREAD_ALLOC(ramCacheCLFUSEntryAllocator, this_ethread());
+    e->key = s->key;
+    e->auxkey1 = s->auxkey1;
+    e->auxkey2 = s->auxkey2;
+    e->hits = s->hits;
+    e->size = s->size;
+    e->len = 0;
+    e->compressed_len = 0;
+    e->flags = 0;
+    e->flag_bits.lru = 1;
+    bucket[i].push(e);
+    lru[1].enqueue(e);
+    history++;
+    if (history > nbuckets) {
+      ++ibuckets;
+      resize_hashtable();
+    }
+  }
+  DDebug("ram_cache", "restored %d entries, history %" PRId64, n, history);
+}
+
 RamCache *
 new_RamCacheCLFUS()
 {
   RamCacheCLFUS *r = new RamCacheCLFUS;
   return r;
 }
+
+#if TS_HAS_TESTS
+#define BENCH_RAM_CACHE_BYTES   (32 * 1024 * 1024)
+#define BENCH_RAM_CACHE_OBJECTS 16384
+
+EXCLUSIVE_REGRESSION_TEST(Bench_RamCacheCLFUS) (RegressionTest *t, int atype, int *status) {
+  if (atype < REGRESSION_TEST_EXTENDED) {
+    *status = REGRESSION_TEST_NOT_RUN;
+    return;
+  }
+  if ((CacheProcessor::IsCacheEnabled() != CACHE_INITIALIZED) || gnvol < 1) {
+    rprintf(t, "cache not ready/configured");
+    *status = REGRESSION_TEST_FAILED;
+    return;
+  }
+  // The compressor keeps a pointer to the cache, so one is made and
+  // kept for all runs. It is charged to the stats of volume 0.
+  static RamCache *rc = NULL;
+  Vol *vol = gvol[0];
+  EThread *thread = this_ethread();
+  MUTEX_TRY_LOCK(lock, vol->mutex, thread);
+  ink_release_assert(lock);
+  if (!rc) {
+    rc = new_RamCacheCLFUS();
+    rc->init(BENCH_RAM_CACHE_BYTES, vol);
+  }
+
+  // 8K objects, a quarter of them fill the cache
+  INK_MD5 *keys = (INK_MD5 *) ats_malloc(sizeof(INK_MD5) * BENCH_RAM_CACHE_OBJECTS);
+  for (int i = 0; i < BENCH_RAM_CACHE_OBJECTS; i++)
+    keys[i].set((uint64_t) i * 0x9E3779B97F4A7C15ULL, ((uint64_t) i + 1) * 0xC2B2AE3D27D4EB4FULL);
+  Ptr<IOBufferData> data, ret;
+  int hot = BENCH_RAM_CACHE_OBJECTS / 8, hits = 0;
+  int64_t ops = BENCH_RAM_CACHE_OBJECTS * 8;
+  ink_hrtime start;
+
+  data = new_IOBufferData(BUFFER_SIZE_INDEX_8K);
+  // entries are only admitted when seen again, so the hot set goes in
+  // on its second pass
+  start = ink_get_hrtime_internal();
+  for (int64_t i = 0; i < ops; i++)
+    rc->put(&keys[i % hot], data, 8192);
+  rbench(t, "put_hot", 1, ops, ink_get_hrtime_internal() - start);
+
+  start = ink_get_hrtime_internal();
+  for (int64_t i = 0; i < ops; i++)
+    hits += rc->get(&keys[i % hot], &ret);
+  rbench(t, "get_hot", 1, ops, ink_get_hrtime_internal() - start);
+
+  // all of the objects, four times the size of the cache
+  start = ink_get_hrtime_internal();
+  for (int64_t i = 0; i < ops; i++) {
+    int k = (int) ((i * 7919) % BENCH_RAM_CACHE_OBJECTS);
+    if (!rc->get(&keys[k], &ret))
+      rc->put(&keys[k], data, 8192);
+  }
+  rbench(t, "get_put_churn", 1, ops, ink_get_hrtime_internal() - start);
+
+  rprintf(t, "%d of %d hot gets hit\n", hits, (int) ops);
+  data = NULL;
+  ret = NULL;
+  ats_free(keys);
+  *status = REGRESSION_TEST_PASSED;
+}
+#endif
@@ -0,0 +1,249 @@
+/** @file
+
+  A RAM cache split into independently locked LRU shards.
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+// The other RAM caches rely on the Vol mutex for their consistency.  This
+// one does not: the objects are spread over RAM_CACHE_SHARDS LRUs by their
+// INK_MD5 and each LRU has its own small lock, held only for the hash
+// probe and the LRU update.  Callers on different threads touching
+// different objects no longer serialize on the cache, and get() is safe
+// without the Vol mutex.
+
+#include "P_Cache.h"
+
+#define RAM_CACHE_SHARDS 64
+
+struct RamCacheShardedEntry {
+  INK_MD5 key;
+  uint32_t auxkey1;
+  uint32_t auxkey2;
+  LINK(RamCacheShardedEntry, lru_link);
+  LINK(RamCacheShardedEntry, hash_link);
+  Ptr<IOBufferData> data;
+};
+
+struct RamCacheShard {
+  ink_mutex lock;
+  int64_t max_bytes;
+  int64_t bytes;
+  int64_t objects;
+  uint16_t *seen;
+  Que(RamCacheShardedEntry, lru_link) lru;
+  DList(RamCacheShardedEntry, hash_link) *bucket;
+  int nbuckets;
+  int ibuckets;
+
+  RamCacheShard():max_bytes(0), bytes(0), objects(0), seen(0), bucket(0), nbuckets(0), ibuckets(0) {
+    ink_mutex_init(&lock, "RamCacheShard");
+  }
+};
+
+struct RamCacheSharded: public RamCache {
+  int64_t max_bytes;
+
+  // returns 1 on found/stored, 0 on not found/stored, if provided auxkey1 and auxkey2 must match
+  int get(INK_MD5 *key, Ptr<IOBufferData> *ret_data, uint32_t auxkey1 = 0, uint32_t auxkey2 = 0);
+  int put(INK_MD5 *key, IOBufferData *data, uint32_t len, bool copy = false, uint32_t auxkey1 = 0, uint32_t auxkey2 = 0);
+  int fixup(INK_MD5 *key, uint32_t old_auxkey1, uint32_t old_auxkey2, uint32_t new_auxkey1, uint32_t new_auxkey2);
+
+  void init(int64_t max_bytes, Vol *vol);
+
+  // private
+  RamCacheShard shard[RAM_CACHE_SHARDS];
+  Vol *vol;
+
+  // word(3) picks the bucket within the shard
+  RamCacheShard *shard_for(INK_MD5 *key) { return &shard[key->word(2) % RAM_CACHE_SHARDS]; }
+  void resize_hashtable(RamCacheShard *s);
+  RamCacheShardedEntry *remove(RamCacheShard *s, RamCacheShardedEntry *e);
+
+  RamCacheSharded():max_bytes(0), vol(NULL) {}
+};
+
+ClassAllocator<RamCacheShardedEntry> ramCacheShardedEntryAllocator("RamCacheShardedEntry");
+
+static const int bucket_sizes[] = {
+  127, 251, 509, 1021, 2039, 4093, 8191, 16381, 32749, 65521, 131071, 262139,
+  524287, 1048573, 2097143, 4194301, 8388593, 16777213, 33554393, 67108859,
+  134217689, 268435399, 536870909
+};
+
+void RamCacheSharded::resize_hashtable(RamCacheShard *s) {
+  int anbuckets = bucket_sizes[s->ibuckets];
+  DDebug("ram_cache", "resize hashtable %d", anbuckets);
+  int64_t size = anbuckets * sizeof(DList(RamCacheShardedEntry, hash_link));
+  DList(RamCacheShardedEntry, hash_link) *new_bucket = (DList(RamCacheShardedEntry, hash_link) *)ats_malloc(size);
+  memset(new_bucket, 0, size);
+  if (s->bucket) {
+    for (int64_t i = 0; i < s->nbuckets; i++) {
+      RamCacheShardedEntry *e = 0;
+      while ((e = s->bucket[i].pop()))
+        new_bucket[e->key.word(3) % anbuckets].push(e);
+    }
+    ats_free(s->bucket);
+  }
+  s->bucket = new_bucket;
+  s->nbuckets = anbuckets;
+  ats_free(s->seen);
+  s->seen = NULL;
+  if (cache_config_ram_cache_use_seen_filter) {
+    int seen_size = anbuckets * sizeof(uint16_t);
+    s->seen = (uint16_t*)ats_malloc(seen_size);
+    memset(s->seen, 0, seen_size);
+  }
+}
+
+void
+RamCacheSharded::init(int64_t abytes, Vol *avol) {
+  vol = avol;
+  max_bytes = abytes;
+  DDebug("ram_cache", "initializing ram_cache %" PRId64 " bytes in %d shards", abytes, RAM_CACHE_SHARDS);
+  if (!max_bytes)
+    return;
+  for (int i = 0; i < RAM_CACHE_SHARDS; i++) {
+    shard[i].max_bytes = max_bytes / RAM_CACHE_SHARDS;
+    resize_hashtable(&shard[i]);
+  }
+}
+
+int
+RamCacheSharded::get(INK_MD5 * key, Ptr<IOBufferData> *ret_data, uint32_t auxkey1, uint32_t auxkey2) {
+  if (!max_bytes)
+    return 0;
+  RamCacheShard *s = shard_for(key);
+  bool found = false;
+  {
+    ink_scoped_mutex lock(s->lock);
+    uint32_t i = key->word(3) % s->nbuckets;
+    RamCacheShardedEntry *e = s->bucket[i].head;
+    while (e) {
+      if (e->key == *key && e->auxkey1 == auxkey1 && e->auxkey2 == auxkey2) {
+        s->lru.remove(e);
+        s->lru.enqueue(e);
+        (*ret_data) = e->data;
+        found = true;
+        break;
+      }
+      e = e->hash_link.next;
+    }
+  }
+  if (found) {
+    DDebug("ram_cache", "get %X %d %d HIT", key->word(3), auxkey1, auxkey2);
+    CACHE_SUM_DYN_STAT_THREAD(cache_ram_cache_hits_stat, 1);
+    return 1;
+  }
+  DDebug("ram_cache", "get %X %d %d MISS", key->word(3), auxkey1, auxkey2);
+  CACHE_SUM_DYN_STAT_THREAD(cache_ram_cache_misses_stat, 1);
+  return 0;
+}
+
+// the shard lock must be held
+RamCacheShardedEntry * RamCacheSharded::remove(RamCacheShard *s, RamCacheShardedEntry *e) {
+  RamCacheShardedEntry *ret = e->hash_link.next;
+  uint32_t b = e->key.word(3) % s->nbuckets;
+  s->bucket[b].remove(e);
+  s->lru.remove(e);
+  s->bytes -= e->data->block_size();
+  CACHE_SUM_DYN_STAT_THREAD(cache_ram_cache_bytes_stat, -e->data->block_size());
+  DDebug("ram_cache", "put %X %d %d FREED", e->key.word(3), e->auxkey1, e->auxkey2);
+  e->data = NULL;
+  THREAD_FREE(e, ramCacheShardedEntryAllocator, this_ethread());
+  s->objects--;
+  return ret;
+}
+
+// ignore 'copy' since we don't touch the data
+int RamCacheSharded::put(INK_MD5 *key, IOBufferData *data, uint32_t len, bool, uint32_t auxkey1, uint32_t auxkey2) {
+  if (!max_bytes)
+    return 0;
+  RamCacheShard *s = shard_for(key);
+  ink_scoped_mutex lock(s->lock);
+  uint32_t i = key->word(3) % s->nbuckets;
+  if (cache_config_ram_cache_use_seen_filter) {
+    uint16_t k = key->word(3) >> 16;
+    uint16_t kk = s->seen[i];
+    s->seen[i] = k;
+    if ((kk != (uint16_t)k)) {
+      DDebug("ram_cache", "put %X %d %d len %d UNSEEN", key->word(3), auxkey1, auxkey2, len);
+      return 0;
+    }
+  }
+  RamCacheShardedEntry *e = s->bucket[i].head;
+  while (e) {
+    if (e->key == *key) {
+      if (e->auxkey1 == auxkey1 && e->auxkey2 == auxkey2) {
+        s->lru.remove(e);
+        s->lru.enqueue(e);
+        return 1;
+      } else { // discard when aux keys conflict
+        e = remove(s, e);
+        continue;
+      }
+    }
+    e = e->hash_link.next;
+  }
+  e = THREAD_ALLOC(ramCacheShardedEntryAllocator, this_ethread());
+  e->key = *key;
+  e->auxkey1 = auxkey1;
+  e->auxkey2 = auxkey2;
+  e->data = data;
+  s->bucket[i].push(e);
+  s->lru.enqueue(e);
+  s->bytes += data->block_size();
+  s->objects++;
+  CACHE_SUM_DYN_STAT_THREAD(cache_ram_cache_bytes_stat, data->block_size());
+  while (s->bytes > s->max_bytes) {
+    RamCacheShardedEntry *ee = s->lru.dequeue();
+    if (ee)
+      remove(s, ee);
+    else
+      break;
+  }
+  DDebug("ram_cache", "put %X %d %d INSERTED", key->word(3), auxkey1, auxkey2);
+  if (s->objects > s->nbuckets) {
+    ++s->ibuckets;
+    resize_hashtable(s);
+  }
+  return 1;
+}
+
+int RamCacheSharded::fixup(INK_MD5 * key, uint32_t old_auxkey1, uint32_t old_auxkey2, uint32_t new_auxkey1, uint32_t new_auxkey2) {
+  if (!max_bytes)
+    return 0;
+  RamCacheShard *s = shard_for(key);
+  ink_scoped_mutex lock(s->lock);
+  uint32_t i = key->word(3) % s->nbuckets;
+  RamCacheShardedEntry *e = s->bucket[i].head;
+  while (e) {
+    if (e->key == *key && e->auxkey1 == old_auxkey1 && e->auxkey2 == old_auxkey2) {
+      e->auxkey1 = new_auxkey1;
+      e->auxkey2 = new_auxkey2;
+      return 1;
+    }
+    e = e->hash_link.next;
+  }
+  return 0;
+}
+
+RamCache *new_RamCacheSharded() {
+  return new RamCacheSharded;
+}
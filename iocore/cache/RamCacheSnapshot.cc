@@ -0,0 +1,291 @@
+/** @file
+
+  Saving the RAM cache keys at shutdown and warming the RAM cache from them at startup.
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+// Only the keys (and the replacement history) are saved, not the data. At
+// startup the history is restored and the resident objects are read back
+// from disk at proxy.config.cache.ram_cache.warm_rate reads per second, at
+// the scan AIO priority so that client reads go first.
+//
+// File layout, in host byte order:
+//   magic, version, number of volumes
+//   per volume: hash_id length, hash_id, number of entries, entries
+
+#include "P_Cache.h"
+#include "I_Layout.h"
+
+#define RAM_CACHE_SNAPSHOT_FILE    "ram_cache.snapshot"
+#define RAM_CACHE_SNAPSHOT_MAGIC   0x52414D53 // "RAMS"
+#define RAM_CACHE_SNAPSHOT_VERSION 1
+
+static void
+ram_cache_snapshot_path(char *path, char *tmp_path)
+{
+  Layout::relative_to(path, PATH_NAME_MAX, Layout::get()->cachedir, RAM_CACHE_SNAPSHOT_FILE);
+  snprintf(tmp_path, PATH_NAME_MAX, "%s.tmp", path);
+}
+
+static bool
+snapshot_write(int fd, const void *data, size_t len)
+{
+  return ::write(fd, data, len) == (ssize_t) len;
+}
+
+static bool
+snapshot_read(int fd, void *data, size_t len)
+{
+  return ::read(fd, data, len) == (ssize_t) len;
+}
+
+// Called from sync_cache_dir_on_shutdown() with all the volume locks held.
+void
+ram_cache_snapshot_save()
+{
+  char path[PATH_NAME_MAX + 1], tmp_path[PATH_NAME_MAX + 1];
+  ram_cache_snapshot_path(path, tmp_path);
+
+  int fd = ::open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    Warning("unable to save RAM cache snapshot '%s': %s", tmp_path, strerror(errno));
+    return;
+  }
+
+  uint32_t hdr[3] = { RAM_CACHE_SNAPSHOT_MAGIC, RAM_CACHE_SNAPSHOT_VERSION, (uint32_t) gnvol };
+  bool ok = snapshot_write(fd, hdr, sizeof(hdr));
+  int64_t total = 0;
+  for (int i = 0; ok && i < gnvol; i++) {
+    Vol *vol = gvol[i];
+    uint32_t idlen = strlen(vol->hash_id);
+    int max = vol->ram_cache ? vol->ram_cache->snapshot(NULL, 0) : 0;
+    RamCacheSnapshotEntry *entries = NULL;
+    uint32_t n = 0;
+
+    if (max > 0) {
+      entries = (RamCacheSnapshotEntry *) ats_malloc(max * sizeof(RamCacheSnapshotEntry));
+      n = vol->ram_cache->snapshot(entries, max);
+    }
+    ok = snapshot_write(fd, &idlen, sizeof(idlen)) && snapshot_write(fd, vol->hash_id, idlen) &&
+      snapshot_write(fd, &n, sizeof(n)) && (!n || snapshot_write(fd, entries, n * sizeof(RamCacheSnapshotEntry)));
+    total += n;
+    ats_free(entries);
+  }
+  ::close(fd);
+
+  if (!ok || ::rename(tmp_path, path) < 0) {
+    Warning("unable to save RAM cache snapshot '%s': %s", path, strerror(errno));
+    ::unlink(tmp_path);
+    return;
+  }
+  Debug("ram_cache", "saved %" PRId64 " RAM cache keys to '%s'", total, path);
+}
+
+// Restores the history of one volume's RAM cache, then reads its resident
+// objects back in, one at a time.
+struct RamCacheWarmer: public Continuation
+{
+  Vol *vol;
+  RamCacheSnapshotEntry *entries;
+  int nentries;
+  int next;
+  int warmed;
+  INK_MD5 key;
+  Dir dir;
+  Ptr<IOBufferData> buf;
+  AIOCallbackInternal io;
+
+  int startEvent(int event, Event *e);
+  int warmEvent(int event, Event *e);
+  int readDone(int event, Event *e);
+  void schedule_next();
+  int done();
+
+  RamCacheWarmer(Vol *avol, RamCacheSnapshotEntry *aentries, int an)
+    : Continuation(avol->mutex), vol(avol), entries(aentries), nentries(an), next(0), warmed(0)
+  {
+    SET_HANDLER(&RamCacheWarmer::startEvent);
+  }
+
+  ~RamCacheWarmer()
+  {
+    ats_free(entries);
+  }
+};
+
+int
+RamCacheWarmer::startEvent(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
+{
+  vol->ram_cache->restore(entries, nentries);
+  SET_HANDLER(&RamCacheWarmer::warmEvent);
+  return warmEvent(EVENT_IMMEDIATE, NULL);
+}
+
+int
+RamCacheWarmer::warmEvent(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
+{
+  while (next < nentries) {
+    RamCacheSnapshotEntry *s = &entries[next++];
+    Dir *last_collision = NULL;
+
+    if (!s->resident)
+      continue;
+    key = s->key;
+    if (!dir_probe(&key, vol, &dir, &last_collision))
+      continue;
+#if TS_USE_INTERIM_CACHE == 1
+    if (dir_ininterim(&dir))
+      continue;
+#endif
+    // recently written, a client read will find it in memory anyway
+    if (dir_agg_buf_valid(vol, &dir))
+      continue;
+
+    io.aiocb.aio_fildes = vol->fd;
+    io.aiocb.aio_offset = vol_offset(vol, &dir);
+    io.aiocb.aio_nbytes = dir_approx_size(&dir);
+    if ((off_t)(io.aiocb.aio_offset + io.aiocb.aio_nbytes) > (off_t)(vol->skip + vol->len))
+      io.aiocb.aio_nbytes = vol->skip + vol->len - io.aiocb.aio_offset;
+    buf = new_IOBufferData(iobuffer_size_to_index(io.aiocb.aio_nbytes, MAX_BUFFER_SIZE_INDEX), MEMALIGNED);
+    io.aiocb.aio_buf = buf->data();
+    io.action = this;
+    io.thread = AIO_CALLBACK_THREAD_ANY;
+    io.io_class = AIO_CLASS_SCAN;
+    SET_HANDLER(&RamCacheWarmer::readDone);
+    ink_assert(ink_aio_read(&io) >= 0);
+    return EVENT_CONT;
+  }
+  return done();
+}
+
+int
+RamCacheWarmer::readDone(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
+{
+  Doc *doc = (Doc *) buf->data();
+  bool stored = true;
+
+  // the same checks as CacheVC::handleReadDone(), the directory may have
+  // changed while the read was in flight
+  if (io.ok() && dir_valid(vol, &dir) && doc->magic == DOC_MAGIC &&
+      (doc->key == key || doc->first_key == key) &&
+      (!cache_config_ram_cache_cutoff || (int64_t) doc->total_len < cache_config_ram_cache_cutoff)) {
+    int okay = 1;
+    bool http_copy_hdr = false;
+#ifdef HTTP_CACHE
+    if (doc->hdr_deflated) {
+      buf = inflate_doc_hdr(doc);
+      if (!buf)
+        okay = 0;
+      else
+        doc = (Doc *) buf->data();
+    }
+    http_copy_hdr = cache_config_ram_cache_compress && doc->ftype == CACHE_FRAG_TYPE_HTTP && doc->hlen;
+    if (okay && !http_copy_hdr && doc->ftype == CACHE_FRAG_TYPE_HTTP && doc->hlen)
+      unmarshal_helper(doc, buf, okay);
+#endif
+    if (okay) {
+      uint64_t o = dir_offset(&dir);
+      stored = vol->ram_cache->put(&key, buf, doc->len, http_copy_hdr, (uint32_t)(o >> 32), (uint32_t) o);
+      if (stored)
+        warmed++;
+    }
+  }
+  buf = NULL;
+
+  // the entries are in order of value, once the cache turns one away the
+  // rest would only displace better ones
+  if (!stored)
+    next = nentries;
+  // not done() here, io is still in use by the AIO callback
+  schedule_next();
+  return EVENT_DONE;
+}
+
+void
+RamCacheWarmer::schedule_next()
+{
+  SET_HANDLER(&RamCacheWarmer::warmEvent);
+  if (cache_config_ram_cache_warm_rate > 0)
+    eventProcessor.schedule_in(this, HRTIME_SECOND / cache_config_ram_cache_warm_rate, ET_CALL);
+  else
+    eventProcessor.schedule_imm(this, ET_CALL);
+}
+
+int
+RamCacheWarmer::done()
+{
+  Note("RAM cache for %s warmed with %d of %d saved objects", vol->hash_id, warmed, nentries);
+  delete this;
+  return EVENT_DONE;
+}
+
+// Called once the cache is initialized.
+void
+ram_cache_snapshot_load()
+{
+  char path[PATH_NAME_MAX + 1], tmp_path[PATH_NAME_MAX + 1];
+  ram_cache_snapshot_path(path, tmp_path);
+
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0) {
+    Debug("ram_cache", "no RAM cache snapshot '%s'", path);
+    return;
+  }
+
+  uint32_t hdr[3];
+  if (!snapshot_read(fd, hdr, sizeof(hdr)) || hdr[0] != RAM_CACHE_SNAPSHOT_MAGIC ||
+      hdr[1] != RAM_CACHE_SNAPSHOT_VERSION) {
+    Warning("ignoring RAM cache snapshot '%s', bad header", path);
+    ::close(fd);
+    return;
+  }
+
+  for (uint32_t v = 0; v < hdr[2]; v++) {
+    uint32_t idlen = 0, n = 0;
+    char hash_id[PATH_NAME_MAX * 2 + 1];
+    RamCacheSnapshotEntry *entries = NULL;
+
+    if (!snapshot_read(fd, &idlen, sizeof(idlen)) || idlen >= sizeof(hash_id) ||
+        !snapshot_read(fd, hash_id, idlen) || !snapshot_read(fd, &n, sizeof(n)))
+      break;
+    hash_id[idlen] = '\0';
+    if (n) {
+      entries = (RamCacheSnapshotEntry *) ats_malloc(n * sizeof(RamCacheSnapshotEntry));
+      if (!snapshot_read(fd, entries, n * sizeof(RamCacheSnapshotEntry))) {
+        ats_free(entries);
+        break;
+      }
+    }
+
+    // the volumes may have been reconfigured since the snapshot was taken
+    Vol *vol = NULL;
+    for (int i = 0; i < gnvol && !vol; i++) {
+      if (!strcmp(gvol[i]->hash_id, hash_id) && gvol[i]->ram_cache && !DISK_BAD(gvol[i]->disk))
+        vol = gvol[i];
+    }
+    if (!vol || !n) {
+      ats_free(entries);
+      continue;
+    }
+    Debug("ram_cache", "warming RAM cache for %s from %u saved keys", hash_id, n);
+    eventProcessor.schedule_imm(NEW(new RamCacheWarmer(vol, entries, n)), ET_CALL);
+  }
+  ::close(fd);
+}
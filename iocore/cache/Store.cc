@@ -52,6 +52,22 @@ int Store::getVolume(char* line) {
   return v;
 }
 
+#if TS_USE_INTERIM_CACHE == 1
+// storage.config lines may mark a span "interim", strip the word
+bool Store::getInterim(char* line) {
+  char *e = strpbrk(line, " \t");
+  while (e) {
+    e += strspn(e, " \t");
+    if (!strncmp(e, "interim", 7) && (!e[7] || strchr(" \t\n", e[7]))) {
+      memmove(e, e + 7, strlen(e + 7) + 1);
+      return true;
+    }
+    e = strpbrk(e, " \t");
+  }
+  return false;
+}
+#endif
+
 
 //
 // Store
@@ -219,6 +235,13 @@ Store::delete_all()
   n_disks = 0;
   ats_free(disk);
   disk = NULL;
+#if TS_USE_INTERIM_CACHE == 1
+  for (int i = 0; i < n_interim_disks; i++)
+    delete interim_disk[i];
+  n_interim_disks = 0;
+  ats_free(interim_disk);
+  interim_disk = NULL;
+#endif
 }
 
 Store::~Store()
@@ -320,6 +343,9 @@ Store::read_config(int fd)
       continue;
 
    int volume_id = getVolume(n);
+#if TS_USE_INTERIM_CACHE == 1
+    bool interim = getInterim(n);
+#endif
 
     // parse
     Debug("cache_init", "Store::read_config: \"%s\"", n);
@@ -353,6 +379,12 @@ Store::read_config(int fd)
       continue;
     }
     ats_free(pp);
+#if TS_USE_INTERIM_CACHE == 1
+    if (interim) {
+      add_interim(ns);
+      continue;
+    }
+#endif
     n_dsstore++;
 
     // new Span
@@ -392,9 +424,7 @@ Lfail:;
 const char *
 Store::read_interim_config() {
   char p[PATH_NAME_MAX + 1];
-  Span *sd = NULL;
   Span *ns;
-  int interim_store = 0;
   REC_ReadConfigString(p, "proxy.config.cache.interim.storage", PATH_NAME_MAX);
 
   char *n = p;
@@ -415,24 +445,18 @@ Store::read_interim_config() {
       delete ns;
       continue;
     }
-    ns->link.next = sd;
-    sd = ns;
-    interim_store++;
-  }
-
-  n_interim_disks = interim_store;
-  interim_disk = (Span **) ats_malloc(interim_store * sizeof(Span *));
-  {
-    int i = 0;
-    while (sd) {
-      ns = sd;
-      sd = sd->link.next;
-      ns->link.next = NULL;
-      interim_disk[i++] = ns;
-    }
+    add_interim(ns);
   }
   return NULL;
 }
+
+// the spans from proxy.config.cache.interim.storage follow those marked
+// "interim" in storage.config
+void
+Store::add_interim(Span *ns) {
+  interim_disk = (Span **) ats_realloc(interim_disk, (n_interim_disks + 1) * sizeof(Span *));
+  interim_disk[n_interim_disks++] = ns;
+}
 #endif
 
 int
@@ -745,6 +769,15 @@ Span::init(char *filename, int64_t size)
           filename, hw_sector_size, is_disk, adjusted_sec);
   }
 
+  // O_DIRECT needs the logical block size, which may be smaller than the physical one
+  dio_alignment = 0;
+#ifdef BLKSSZGET
+  if (is_disk && ioctl(fd, BLKSSZGET, &arg) == 0) {
+    dio_alignment = arg;
+    Debug("cache_init", "Span::init - %s dio_alignment = %d", filename, dio_alignment);
+  }
+#endif
+
   alignment = 0;
 #ifdef BLKALIGNOFF
   if (ioctl(fd, BLKALIGNOFF, &arg) == 0) {
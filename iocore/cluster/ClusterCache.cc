@@ -351,6 +351,293 @@ ClusterVConnectionCacheEvent::eventHandler(int /* event ATS_UNUSED */, Event * e
 
 ///////////////////////////////////////////////////////////////////////
 
+///////////////////////////////////////////////////////////////////////
+// Near cache
+//   Objects this node keeps reading from their owner.  Once a key has
+//   been read remotely near_cache_hits times within near_cache_ttl, its
+//   reads and writes go to the local cache until the entry expires, so a
+//   locally hot object costs one fill instead of a cluster round trip
+//   per request.  The table is advisory: a lock miss is treated as a
+//   miss, which routes the request to the owner as before.
+///////////////////////////////////////////////////////////////////////
+int cluster_near_cache_hits = 2;
+int cluster_near_cache_ttl = 30;
+
+struct ClusterNearCache
+{
+  enum
+  {
+    WAYS = 4,
+    LOCKS = 64
+  };
+  struct Entry
+  {
+    INK_MD5 key;
+    ink_hrtime expire;          // zero for a free slot
+    int hits;
+  };
+
+  Entry *table;
+  int n_buckets;                // a power of 2
+  Ptr<ProxyMutex> lock[LOCKS];
+
+  Entry *bucket(INK_MD5 * key, int *l)
+  {
+    uint64_t h = key->fold();
+    int b = (int) ((h ^ (h >> 32)) & (n_buckets - 1));
+    *l = b & (LOCKS - 1);
+    return &table[b * WAYS];
+  }
+  bool is_local(INK_MD5 * key);
+  void note_remote_read(INK_MD5 * key);
+  void forget(INK_MD5 * key);
+  void init(int entries);
+};
+
+static ClusterNearCache *near_cache = NULL;
+
+void
+ClusterNearCache::init(int entries)
+{
+  n_buckets = 1;
+  while (n_buckets * WAYS < entries)
+    n_buckets <<= 1;
+  table = (Entry *) ats_malloc(n_buckets * WAYS * sizeof(Entry));
+  memset(table, 0, n_buckets * WAYS * sizeof(Entry));
+  for (int i = 0; i < LOCKS; i++)
+    lock[i] = new_ProxyMutex();
+}
+
+bool
+ClusterNearCache::is_local(INK_MD5 * key)
+{
+  int l;
+  Entry *b = bucket(key, &l);
+  EThread *thread = this_ethread();
+  bool local = false;
+
+  MUTEX_TRY_LOCK(lk, lock[l], thread);
+  if (!lk)
+    return false;
+  ink_hrtime now = ink_get_hrtime();
+  for (int i = 0; i < WAYS; i++) {
+    if (b[i].expire && b[i].key == *key) {
+      if (b[i].expire > now) {
+        local = (b[i].hits >= cluster_near_cache_hits);
+        break;
+      }
+      b[i].expire = 0;
+    }
+  }
+  return local;
+}
+
+void
+ClusterNearCache::note_remote_read(INK_MD5 * key)
+{
+  int l;
+  Entry *b = bucket(key, &l);
+  EThread *thread = this_ethread();
+
+  MUTEX_TRY_LOCK(lk, lock[l], thread);
+  if (!lk)
+    return;
+  ink_hrtime now = ink_get_hrtime();
+  Entry *victim = &b[0];
+  for (int i = 0; i < WAYS; i++) {
+    if (b[i].expire > now && b[i].key == *key) {
+      b[i].hits++;
+      return;
+    }
+    if (b[i].expire < victim->expire)
+      victim = &b[i];
+  }
+  // the TTL runs from the first remote read, it bounds how long a
+  // local copy is used without going back to the owner
+  victim->key = *key;
+  victim->expire = now + HRTIME_SECONDS(cluster_near_cache_ttl);
+  victim->hits = 1;
+}
+
+void
+ClusterNearCache::forget(INK_MD5 * key)
+{
+  int l;
+  Entry *b = bucket(key, &l);
+  EThread *thread = this_ethread();
+
+  MUTEX_TRY_LOCK(lk, lock[l], thread);
+  if (!lk)
+    return;
+  for (int i = 0; i < WAYS; i++)
+    if (b[i].key == *key)
+      b[i].expire = 0;
+}
+
+bool
+cluster_near_cache_local(INK_MD5 * key)
+{
+  if (!near_cache || !cluster_near_cache_hits || !near_cache->is_local(key))
+    return false;
+  RecIncrRawStat(cluster_rsb, this_ethread(), (int) CLUSTER_NEAR_CACHE_LOCAL_STAT, 1);
+  return true;
+}
+
+void
+cluster_near_cache_note_remote_read(INK_MD5 * key)
+{
+  if (near_cache && cluster_near_cache_hits)
+    near_cache->note_remote_read(key);
+}
+
+void
+cluster_near_cache_forget(INK_MD5 * key)
+{
+  if (near_cache)
+    near_cache->forget(key);
+}
+
+///////////////////////////////////////////////////////////////////////
+// ClusterReadFallback
+//   An open_read against the current owner of a key which, if that
+//   misses, is retried against the owner before the last membership
+//   change.  Either may be this machine.  The retry is made from a new
+//   event, so the result of the first read is never delivered from
+//   inside the second.
+///////////////////////////////////////////////////////////////////////
+struct ClusterReadFallback;
+typedef int (ClusterReadFallback::*ClusterReadFallbackHandler) (int, void *);
+
+struct ClusterReadFallback: public Continuation
+{
+  Action action;
+  Action *pending;
+  ClusterMachine *target[2];    // NULL for this machine
+  int attempt;
+  bool starting;
+  bool finished;
+
+  int opcode;
+  CacheURL *url;
+  CacheHTTPHdr *request;
+  CacheLookupHttpConfig *params;
+  INK_MD5 md5;
+  time_t pin_in_cache;
+  CacheFragType frag_type;
+  char *hostname;
+  int host_len;
+
+  Action *start_read();
+  void free();
+  int startEvent(int event, Event * e);
+  int resultEvent(int event, void *data);
+  ClusterReadFallback():Continuation(NULL) { }
+};
+
+static ClassAllocator<ClusterReadFallback> clusterReadFallbackAllocator("clusterReadFallbackAllocator");
+
+Action *
+ClusterReadFallback::start_read()
+{
+  ClusterMachine *m = target[attempt];
+  bool read_long = (opcode == CACHE_OPEN_READ_LONG);
+
+  if (m)
+    return Cluster_read(m, opcode, this, NULL, url, request, params, read_long ? NULL : &md5,
+                        pin_in_cache, frag_type, hostname, host_len);
+  if (read_long)
+    return caches[frag_type]->open_read(this, &md5, request, params, frag_type, hostname, host_len);
+  return caches[frag_type]->open_read(this, &md5, frag_type, hostname, host_len);
+}
+
+void
+ClusterReadFallback::free()
+{
+  ats_free(hostname);
+  action.mutex = NULL;
+  mutex = NULL;
+  clusterReadFallbackAllocator.free(this);
+}
+
+int
+ClusterReadFallback::startEvent(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
+{
+  if (action.cancelled) {
+    free();
+    return EVENT_DONE;
+  }
+  SET_HANDLER((ClusterReadFallbackHandler) & ClusterReadFallback::resultEvent);
+  starting = true;
+  Action *a = start_read();
+  starting = false;
+  if (finished)
+    free();
+  else if (a != ACTION_RESULT_DONE)
+    pending = a;
+  return EVENT_DONE;
+}
+
+int
+ClusterReadFallback::resultEvent(int event, void *data)
+{
+  pending = NULL;
+  if (event == CACHE_EVENT_OPEN_READ_FAILED && !attempt && !action.cancelled
+      && (intptr_t) data != -ECACHE_DOC_BUSY) {
+    attempt = 1;
+    CLUSTER_INCREMENT_DYN_STAT(CLUSTER_PREVIOUS_OWNER_READS_STAT);
+    SET_HANDLER((ClusterReadFallbackHandler) & ClusterReadFallback::startEvent);
+    eventProcessor.schedule_imm(this, ET_CACHE_CONT_SM);
+    return EVENT_DONE;
+  }
+  if (!action.cancelled)
+    action.continuation->handleEvent(event, data);
+  else if (event == CACHE_EVENT_OPEN_READ)
+    ((VConnection *) data)->do_io_close();
+  if (starting)
+    finished = true;
+  else
+    free();
+  return EVENT_DONE;
+}
+
+Action *
+Cluster_read_fallback(ClusterMachine * owner, ClusterMachine * previous_owner, int opcode,
+                      Continuation * cont, CacheURL * url, CacheHTTPHdr * request,
+                      CacheLookupHttpConfig * params, INK_MD5 * md5,
+                      time_t pin_in_cache, CacheFragType frag_type, char *hostname, int host_len)
+{
+  ClusterReadFallback *c = clusterReadFallbackAllocator.alloc();
+
+  c->mutex = cont->mutex;
+  c->action = cont;
+  c->pending = NULL;
+  c->target[0] = owner;
+  c->target[1] = previous_owner;
+  c->attempt = 0;
+  c->starting = true;
+  c->finished = false;
+  c->opcode = opcode;
+  c->url = url;
+  c->request = request;
+  c->params = params;
+  c->md5 = *md5;
+  c->pin_in_cache = pin_in_cache;
+  c->frag_type = frag_type;
+  c->hostname = (hostname && host_len) ? ats_strndup(hostname, host_len) : NULL;
+  c->host_len = c->hostname ? host_len : 0;
+  SET_CONTINUATION_HANDLER(c, (ClusterReadFallbackHandler) & ClusterReadFallback::resultEvent);
+
+  Action *a = c->start_read();
+  c->starting = false;
+  if (c->finished) {
+    c->free();
+    return ACTION_RESULT_DONE;
+  }
+  if (a != ACTION_RESULT_DONE)
+    c->pending = a;
+  return &c->action;
+}
+
 ////////////////////////////////////////////////////
 // init()
 //   Global initializations for CacheContinuation
@@ -364,6 +651,15 @@ CacheContinuation::init()
 
   GlobalOpenWriteVCcache = new ClusterVConnectionCache;
   GlobalOpenWriteVCcache->init();
+
+  int near_cache_size = 0;
+  REC_ReadConfigInteger(near_cache_size, "proxy.config.cluster.near_cache.size");
+  REC_EstablishStaticConfigInt32(cluster_near_cache_hits, "proxy.config.cluster.near_cache.hits");
+  REC_EstablishStaticConfigInt32(cluster_near_cache_ttl, "proxy.config.cluster.near_cache.ttl");
+  if (near_cache_size > 0) {
+    near_cache = new ClusterNearCache;
+    near_cache->init(near_cache_size);
+  }
   return 0;
 }
 
@@ -1626,6 +1922,19 @@ CacheContinuation::setupReadWriteVC(int event, VConnection * vc)
       break;
     }
   case CACHE_EVENT_OPEN_WRITE_FAILED:
+    {
+      if (vc == (VConnection *) - ECACHE_DOC_BUSY) {
+        // Another node's miss is already filling this document here.
+        // Tell the requester the document is busy rather than missing,
+        // so it retries the read and follows the fill instead of going
+        // to the origin itself.
+        CLUSTER_INCREMENT_DYN_STAT(CLUSTER_CACHE_FILL_BUSY_STAT);
+        Debug("cache_proto", "open_read miss with fill in flight, seqno=%d", seq_number);
+        SET_HANDLER((CacheContHandler) & CacheContinuation::replyOpEvent);
+        return handleEvent(CACHE_EVENT_OPEN_READ_FAILED, (VConnection *) - ECACHE_DOC_BUSY);
+      }
+    }
+    // fall through
   default:
     {
       SET_HANDLER((CacheContHandler) & CacheContinuation::replyOpEvent);
@@ -2027,10 +2336,10 @@ cache_op_result_ClusterFunction(ClusterHandler *ch, void *d, int l)
       {
         // Unmarshal the error code
         ink_assert(((len - flen) == sizeof(int32_t)));
+        // the code is sent negative, as the cache reports it
         op_result_error = msg->moi.u32;
         if (mh->NeedByteSwap())
           ats_swap32((uint32_t *) & op_result_error);
-        op_result_error = -op_result_error;
         break;
       }
     default:
@@ -2340,6 +2649,7 @@ retry:
           read_cluster_vc->alternate = this->ic_new_info;
           this->ic_new_info.clear();
           ink_release_assert(read_cluster_vc->alternate.object_size_get());
+          cluster_near_cache_note_remote_read(&url_md5);
 
           if (!action.cancelled) {
             ClusterVConnection *target_vc = read_cluster_vc;
@@ -30,6 +30,7 @@
 #include "P_Cluster.h"
 // updated from the cluster port configuration variable
 int cluster_port = DEFAULT_CLUSTER_PORT_NUMBER;
+int cluster_ownership_window = 60;
 
 ClusterAccept::ClusterAccept(int *port, int send_bufsize, int recv_bufsize)
   : Continuation(0),
@@ -440,6 +441,31 @@ cluster_machine_at_depth(unsigned int hash, int *pprobe_depth, ClusterMachine **
   return NULL;
 }
 
+//
+// cluster_previous_owner()
+//   For cluster_ownership_window seconds after a membership change,
+//   reads of a hash whose owner moved are tried on the previous owner
+//   when the new one misses, while the objects migrate.  Returns true
+//   with the previous owner in *pm (NULL for this machine) if that
+//   applies to the hash.
+//
+bool
+cluster_previous_owner(unsigned int hash, ClusterMachine ** pm)
+{
+  ClusterConfiguration *cc = this_cluster()->current_configuration();
+  ClusterConfiguration *prev = cc ? cc->link.next : NULL;
+
+  if (!prev || !cluster_ownership_window
+      || ink_get_hrtime() - cc->changed > HRTIME_SECONDS(cluster_ownership_window))
+    return false;
+  ClusterMachine *m = cc->machine_hash(hash);
+  ClusterMachine *p = prev->machine_hash(hash);
+  if (m == p || p->dead)
+    return false;
+  *pm = (p != this_cluster_machine()) ? p : NULL;
+  return true;
+}
+
 //
 // initialize_thread_for_cluster()
 //   This is not required since we have a separate handler
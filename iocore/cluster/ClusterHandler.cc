@@ -154,6 +154,7 @@ ClusterHandler::ClusterHandler()
     needByteSwap(false),
     configLookupFails(0),
     cluster_periodic_event(0),
+    flush_pending(0),
     read(this, true),
     write(this, false),
     current_time(0),
@@ -2280,12 +2281,30 @@ ClusterHandler::vcs_push(ClusterVConnection * vc, int type)
   while ((vc->type > VC_CLUSTER) && !vc->in_vcs && ink_atomic_cas(pvint32(&vc->in_vcs), 0, 1)) {
     if (vc->type == VC_CLUSTER_READ)
       ink_atomiclist_push(&vc->ch->read_vcs_ready, (void *)vc);
-    else
+    else {
       ink_atomiclist_push(&vc->ch->write_vcs_ready, (void *)vc);
+      vc->ch->schedule_flush();
+    }
     return;
   }
 }
 
+void
+ClusterHandler::schedule_flush()
+{
+  //
+  // Data queued for write would otherwise wait for the periodic event,
+  // up to CLUSTER_PERIOD away.  Wake the handler after a short coalescing
+  // delay instead, so the pushes arriving within it go out in one write.
+  //
+  Event *pe = cluster_periodic_event;
+
+  if (!cluster_write_coalesce_usec || dead || !pe || flush_pending)
+    return;
+  if (ink_atomic_cas(&flush_pending, 0, 1))
+    pe->ethread->schedule_in(this, HRTIME_USECONDS(cluster_write_coalesce_usec), CLUSTER_EVENT_FLUSH);
+}
+
 int
 ClusterHandler::remote_close(ClusterVConnection * vc, ClusterVConnState * ns)
 {
@@ -2445,6 +2464,9 @@ ClusterHandler::mainClusterEvent(int event, Event * e)
     }
   }
 
+  if (event == CLUSTER_EVENT_FLUSH)
+    flush_pending = 0;
+
   on_stolen_thread = (event == CLUSTER_EVENT_STEAL_THREAD);
   bool io_callback = (event == EVENT_IMMEDIATE);
 
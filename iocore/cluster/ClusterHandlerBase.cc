@@ -1111,6 +1111,15 @@ ClusterHandler::startClusterEvent(int event, Event * e)
           ClusterMachine *m = c->find(ip, port);
           
           if (!m) { // this first connection
+            if (id >= machine->num_connections) {
+              // the peer runs more connections than we do, see
+              // proxy.config.cluster.connections_per_thread
+              Warning("cluster connection %d from %u.%u.%u.%u exceeds the %d configured",
+                      id, DOT_SEPARATED(ip), machine->num_connections);
+              failed = -2;
+              MUTEX_UNTAKE_LOCK(the_cluster_config_mutex, this_ethread());
+              goto failed;
+            }
             ClusterConfiguration *cconf = configuration_add_machine(c, machine);
             CLUSTER_INCREMENT_DYN_STAT(CLUSTER_NODES_STAT);
             this_cluster()->configurations.push(cconf);
@@ -1243,14 +1252,15 @@ ClusterHandler::zombieClusterEvent(int event, Event * e)
   // by short running tasks (one scheduling quanta).  The object is delayed
   // after some unreasonably long (in comparison) time.
   //
-  (void) event;
   (void) e;
+  if (event == CLUSTER_EVENT_FLUSH)
+    return EVENT_DONE;
   delete this;                  // I am out of here
   return EVENT_DONE;
 }
 
 int
-ClusterHandler::protoZombieEvent(int /* event ATS_UNUSED */, Event * e)
+ClusterHandler::protoZombieEvent(int event, Event * e)
 {
   //
   // Node associated with *this is declared down.
@@ -1262,6 +1272,10 @@ ClusterHandler::protoZombieEvent(int /* event ATS_UNUSED */, Event * e)
   EThread *t = e ? e->ethread : this_ethread();
   head_p item;
 
+  // a write flush scheduled before the node went down
+  if (event == CLUSTER_EVENT_FLUSH)
+    return EVENT_DONE;
+
   /////////////////////////////////////////////////////////////////
   // Complete pending i/o operations
   /////////////////////////////////////////////////////////////////
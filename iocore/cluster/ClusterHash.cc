@@ -46,6 +46,11 @@ bool machineClusterHash = true;
 bool boundClusterHash = false;
 bool randClusterHash = false;
 
+// ringClusterHash     - place the machines on a consistent hash ring
+//                       instead, proxy.config.cluster.consistent_hash
+//
+bool ringClusterHash = false;
+
 // This produces better speed for large numbers of machines > 18
 //
 // bool machineClusterHash = false;
@@ -165,10 +170,74 @@ build_hash_table_bucket(ClusterConfiguration * c)
   }
 }
 
+//
+// Consistent hash ring
+// Each machine owns CLUSTER_RING_POINTS points on a 32 bit ring, placed
+// by its ip alone, and a bucket belongs to the machine owning the next
+// point at or after it.  Adding or removing a machine only moves the
+// buckets between its points and their predecessors, about 1/n of the
+// table, where the tables above reshuffle far more on every change.
+//
+#define CLUSTER_RING_POINTS 160
+
+struct ClusterRingPoint
+{
+  uint32_t pos;
+  uint32_t ip;                  // ties are broken by ip, so order does not matter
+  unsigned char m;
+};
+
+static int
+ring_point_cmp(const void *a, const void *b)
+{
+  const ClusterRingPoint *x = (const ClusterRingPoint *) a, *y = (const ClusterRingPoint *) b;
+  if (x->pos != y->pos)
+    return x->pos < y->pos ? -1 : 1;
+  return x->ip < y->ip ? -1 : (x->ip > y->ip ? 1 : 0);
+}
+
+static inline uint32_t
+ring_point_hash(uint32_t ip, uint32_t k)
+{
+  uint64_t h = ((uint64_t) ip << 32 | k) * 0x9E3779B97F4A7C15ULL;
+  h ^= h >> 29;
+  h *= 0xBF58476D1CE4E5B9ULL;
+  h ^= h >> 32;
+  return (uint32_t) h;
+}
+
+static void
+build_hash_table_ring(ClusterConfiguration * c)
+{
+  int n = c->n_machines * CLUSTER_RING_POINTS;
+  ClusterRingPoint *ring = (ClusterRingPoint *) ats_malloc(n * sizeof(ClusterRingPoint));
+  int i, p = 0;
+
+  for (int m = 0; m < c->n_machines; m++)
+    for (int k = 0; k < CLUSTER_RING_POINTS; k++, p++) {
+      ring[p].ip = c->machines[m]->ip;
+      ring[p].pos = ring_point_hash(ring[p].ip, k);
+      ring[p].m = m;
+    }
+  qsort(ring, n, sizeof(ClusterRingPoint), ring_point_cmp);
+
+  // buckets past the last point wrap around to the first
+  p = 0;
+  for (i = 0; i < CLUSTER_HASH_TABLE_SIZE; i++) {
+    uint32_t pos = (uint32_t) (((uint64_t) i << 32) / CLUSTER_HASH_TABLE_SIZE);
+    while (p < n && ring[p].pos < pos)
+      p++;
+    c->hash_table[i] = ring[p < n ? p : 0].m;
+  }
+  ats_free(ring);
+}
+
 void
 build_cluster_hash_table(ClusterConfiguration * c)
 {
-  if (machineClusterHash)
+  if (ringClusterHash)
+    build_hash_table_ring(c);
+  else if (machineClusterHash)
     build_hash_table_machine(c);
   else
     build_hash_table_bucket(c);
@@ -31,6 +31,7 @@
 #include "P_Cluster.h"
 extern char cache_system_config_directory[PATH_NAME_MAX + 1];
 extern int num_of_cluster_threads;
+extern int num_of_cluster_connections_per_thread;
 
 MachineList *machines_config = NULL;
 MachineList *cluster_config = NULL;
@@ -143,7 +144,9 @@ ClusterMachine::ClusterMachine(char *ahostname, unsigned int aip, int aport)
   else
     hostname_len = 0;
 
-  num_connections = num_of_cluster_threads;
+  // Connection id i is served by cluster thread i % num_of_cluster_threads,
+  // so channels spread over several streams on each thread
+  num_connections = num_of_cluster_threads * num_of_cluster_connections_per_thread;
   clusterHandlers = (ClusterHandler **)ats_calloc(num_connections, sizeof(ClusterHandler *));
 }
 
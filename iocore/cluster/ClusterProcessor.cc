@@ -34,6 +34,8 @@
 int cluster_port_number = DEFAULT_CLUSTER_PORT_NUMBER;
 int cache_clustering_enabled = 0;
 int num_of_cluster_threads = DEFAULT_NUMBER_OF_CLUSTER_THREADS;
+int num_of_cluster_connections_per_thread = 1;
+int cluster_write_coalesce_usec = 200;
 
 ClusterProcessor clusterProcessor;
 RecRawStatBlock *cluster_rsb = NULL;
@@ -509,6 +511,18 @@ ClusterProcessor::init()
                      "proxy.process.cluster.chan_inuse",
                      RECD_INT, RECP_NON_PERSISTENT, (int) CLUSTER_CHAN_INUSE_STAT, RecRawStatSyncSum);
   CLUSTER_CLEAR_DYN_STAT(CLUSTER_CHAN_INUSE_STAT);
+  RecRegisterRawStat(cluster_rsb, RECT_PROCESS,
+                     "proxy.process.cluster.cache_fill_busy",
+                     RECD_INT, RECP_NON_PERSISTENT, (int) CLUSTER_CACHE_FILL_BUSY_STAT, RecRawStatSyncSum);
+  CLUSTER_CLEAR_DYN_STAT(CLUSTER_CACHE_FILL_BUSY_STAT);
+  RecRegisterRawStat(cluster_rsb, RECT_PROCESS,
+                     "proxy.process.cluster.near_cache_local",
+                     RECD_INT, RECP_NON_PERSISTENT, (int) CLUSTER_NEAR_CACHE_LOCAL_STAT, RecRawStatSyncCount);
+  CLUSTER_CLEAR_DYN_STAT(CLUSTER_NEAR_CACHE_LOCAL_STAT);
+  RecRegisterRawStat(cluster_rsb, RECT_PROCESS,
+                     "proxy.process.cluster.previous_owner_reads",
+                     RECD_INT, RECP_NON_PERSISTENT, (int) CLUSTER_PREVIOUS_OWNER_READS_STAT, RecRawStatSyncCount);
+  CLUSTER_CLEAR_DYN_STAT(CLUSTER_PREVIOUS_OWNER_READS_STAT);
   RecRegisterRawStat(cluster_rsb, RECT_PROCESS,
                      "proxy.process.cluster.open_delays",
                      RECD_INT, RECP_NON_PERSISTENT, (int) CLUSTER_OPEN_DELAY_TIME_STAT, RecRawStatSyncSum);
@@ -685,7 +699,15 @@ ClusterProcessor::init()
   }
   if (num_of_cluster_threads == DEFAULT_NUMBER_OF_CLUSTER_THREADS)
     REC_ReadConfigInteger(num_of_cluster_threads, "proxy.config.cluster.threads");
-
+  REC_ReadConfigInteger(num_of_cluster_connections_per_thread, "proxy.config.cluster.connections_per_thread");
+  if (num_of_cluster_connections_per_thread < 1)
+    num_of_cluster_connections_per_thread = 1;
+  int consistent_hash = 0;
+  REC_ReadConfigInteger(consistent_hash, "proxy.config.cluster.consistent_hash");
+  ringClusterHash = consistent_hash != 0;
+  REC_EstablishStaticConfigInt32(cluster_ownership_window, "proxy.config.cluster.ownership_window");
+
+  REC_EstablishStaticConfigInt32(cluster_write_coalesce_usec, "proxy.config.cluster.write_coalesce_usec");
   REC_EstablishStaticConfigInt32(CacheClusterMonitorEnabled, "proxy.config.cluster.enable_monitor");
   REC_EstablishStaticConfigInt32(CacheClusterMonitorIntervalSecs, "proxy.config.cluster.monitor_interval_secs");
   REC_ReadConfigInteger(cluster_receive_buffer_size, "proxy.config.cluster.receive_buffer_size");
@@ -120,6 +120,9 @@ enum
   CLUSTER_SETDATA_NO_CLUSTER_STAT,
   CLUSTER_VC_READ_LIST_LEN_STAT,
   CLUSTER_VC_WRITE_LIST_LEN_STAT,
+  CLUSTER_CACHE_FILL_BUSY_STAT,
+  CLUSTER_NEAR_CACHE_LOCAL_STAT,
+  CLUSTER_PREVIOUS_OWNER_READS_STAT,
   cluster_stat_count
 };
 
@@ -102,6 +102,7 @@
 
 // internal event code
 #define CLUSTER_EVENT_STEAL_THREAD      (CLUSTER_EVENT_EVENTS_START+50)
+#define CLUSTER_EVENT_FLUSH             (CLUSTER_EVENT_EVENTS_START+51)
 
 //////////////////////////////////////////////////////////////
 // Miscellaneous byte swap routines
@@ -197,6 +198,13 @@ machine_in_vector(ClusterMachine * m, ClusterMachine ** mm, int len)
 inkcoreapi ClusterMachine *cluster_machine_at_depth(unsigned int hash, int *probe_depth = NULL,
                                                     ClusterMachine ** past_probes = NULL);
 
+//
+// Shortly after a membership change, the owner of the hash before it,
+// if that is another machine which is still up (NULL for this machine).
+//
+extern int cluster_ownership_window;
+bool cluster_previous_owner(unsigned int hash, ClusterMachine ** pm);
+
 //
 // Cluster
 //   A cluster of machines which act as a single cache.
@@ -1131,6 +1139,7 @@ ClusterConfiguration *configuration_remove_machine(ClusterConfiguration * c, Clu
 extern bool machineClusterHash;
 extern bool boundClusterHash;
 extern bool randClusterHash;
+extern bool ringClusterHash;
 
 void build_cluster_hash_table(ClusterConfiguration *);
 
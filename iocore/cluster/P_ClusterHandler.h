@@ -478,6 +478,7 @@ struct ClusterHandler:public ClusterHandlerBase
   ClusterCalloutContinuation * callout_cont[MAX_COMPLETION_CALLBACK_EVENTS];
   Event *callout_events[MAX_COMPLETION_CALLBACK_EVENTS];
   Event *cluster_periodic_event;
+  volatile int flush_pending;   // a CLUSTER_EVENT_FLUSH is scheduled
   Queue<OutgoingControl> outgoing_control[CLUSTER_CMSG_QUEUES];
   Queue<IncomingControl> incoming_control;
   InkAtomicList read_vcs_ready;
@@ -646,6 +647,7 @@ struct ClusterHandler:public ClusterHandlerBase
   int protoZombieEvent(int event, Event * e);
 
   void vcs_push(ClusterVConnection * vc, int type);
+  void schedule_flush();
   bool vc_ok_read(ClusterVConnection *);
   bool vc_ok_write(ClusterVConnection *);
   int do_open_local_requests();
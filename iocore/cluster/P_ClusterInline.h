@@ -32,6 +32,12 @@
 #include "P_CacheInternal.h"
 #include "P_ClusterHandler.h"
 
+// open_read on the owner, then on the previous owner if that misses
+Action *Cluster_read_fallback(ClusterMachine * owner, ClusterMachine * previous_owner, int opcode,
+                              Continuation * cont, CacheURL * url, CacheHTTPHdr * request,
+                              CacheLookupHttpConfig * params, INK_MD5 * md5,
+                              time_t pin_in_cache, CacheFragType frag_type, char *hostname, int host_len);
+
 inline Action *
 Cluster_lookup(Continuation * cont, CacheKey * key, CacheFragType frag_type, char *hostname, int host_len)
 {
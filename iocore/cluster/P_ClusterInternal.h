@@ -510,6 +510,12 @@ extern ClassAllocator<ByteBankDescriptor> byteBankAllocator;
 
 // Cluster configuration declarations
 extern int cluster_port;
+extern int cluster_write_coalesce_usec;
+
+// Near cache of objects recently read from their owner (ClusterCache.cc)
+extern bool cluster_near_cache_local(INK_MD5 *);
+extern void cluster_near_cache_note_remote_read(INK_MD5 *);
+extern void cluster_near_cache_forget(INK_MD5 *);
 // extern void * machine_config_change(void *, void *);
 int machine_config_change(const char *, RecDataT, RecData, void *);
 extern void do_machine_config_change(void *, const char *);
@@ -55,6 +55,7 @@ char *dns_resolv_conf = NULL;
 char *dns_local_ipv6 = NULL;
 char *dns_local_ipv4 = NULL;
 int dns_thread = 0;
+int dns_per_thread = 0;
 int dns_prefer_ipv6 = 0;
 namespace {
   // Currently only used for A and AAAA.
@@ -181,7 +182,12 @@ DNSProcessor::start(int, size_t stacksize) {
   REC_ReadConfigStringAlloc(dns_local_ipv6, "proxy.config.dns.local_ipv6");
   REC_ReadConfigStringAlloc(dns_resolv_conf, "proxy.config.dns.resolv_conf");
   REC_EstablishStaticConfigInt32(dns_thread, "proxy.config.dns.dedicated_thread");
+  REC_EstablishStaticConfigInt32(dns_per_thread, "proxy.config.dns.per_thread_resolvers");
 
+  if (dns_per_thread && dns_thread > 0) {
+    Warning("proxy.config.dns.per_thread_resolvers is ignored with proxy.config.dns.dedicated_thread");
+    dns_per_thread = 0;
+  }
   if (dns_thread > 0) {
     // TODO: Hmmm, should we just get a single thread some other way?
     ET_DNS = eventProcessor.spawn_event_threads(1, "ET_DNS", stacksize);
@@ -202,6 +208,8 @@ DNSProcessor::start(int, size_t stacksize) {
   // Setup the default DNSHandler, it's used both by normal DNS, and SplitDNS (for PTR lookups etc.)
   dns_init();
   open();
+  if (dns_per_thread)
+    open_thread_handlers();
 
   return 0;
 }
@@ -229,6 +237,58 @@ DNSProcessor::open(sockaddr const* target, int aoptions)
   thread->schedule_imm(h);
 }
 
+static char *
+register_in_flight_stat(int i)
+{
+  char name[64];
+  snprintf(name, sizeof(name), "proxy.process.dns.thread.%d.in_flight", i);
+  RecRegisterStatInt(RECT_PROCESS, name, 0, RECP_NON_PERSISTENT);
+  return ats_strdup(name);
+}
+
+/**
+  Give every ET_NET thread its own resolver: its own sockets, which have
+  their own random source ports, and its own table of outstanding
+  queries, so that lookups are sent and answered on the thread that
+  asked for them. The first thread keeps the shared handler, which
+  also serves every other thread type.
+
+*/
+void
+DNSProcessor::open_thread_handlers()
+{
+  n_thread_handlers = eventProcessor.n_threads_for_type[ET_CALL];
+  thread_handlers = (DNSHandler **)ats_malloc(n_thread_handlers * sizeof(DNSHandler *));
+  thread_handlers[0] = handler;
+  handler->in_flight_stat = register_in_flight_stat(0);
+  for (int i = 1; i < n_thread_handlers; i++) {
+    EThread *t = eventProcessor.eventthread[ET_CALL][i];
+    DNSHandler *h = NEW(new DNSHandler);
+
+    h->options = _res.options;
+    h->mutex = t->mutex;
+    h->thread = t;
+    h->m_res = &l_res;
+    ats_ip_copy(&h->local_ipv4.sa, &local_ipv4.sa);
+    ats_ip_copy(&h->local_ipv6.sa, &local_ipv6.sa);
+    ats_ip_invalidate(&h->ip);
+    h->in_flight_stat = register_in_flight_stat(i);
+    thread_handlers[i] = h;
+
+    SET_CONTINUATION_HANDLER(h, &DNSHandler::startEvent_thread);
+    t->schedule_imm(h);
+  }
+  Debug("dns", "opened %d per thread resolvers", n_thread_handlers);
+}
+
+DNSHandler *
+DNSProcessor::thread_handler(EThread *t)
+{
+  if (thread_handlers && t && t->tt == REGULAR && t->id < n_thread_handlers)
+    return thread_handlers[t->id];
+  return handler;
+}
+
 //
 // Initialization
 //
@@ -339,7 +399,7 @@ ink_dn_expand(const u_char *msg, const u_char *eom, const u_char *comp_dn, u_cha
 }
 
 DNSProcessor::DNSProcessor()
-  : thread(NULL), handler(NULL)
+  : thread(NULL), handler(NULL), thread_handlers(NULL), n_thread_handlers(0)
 {
   ink_zero(l_res);
   ink_zero(local_ipv6);
@@ -368,13 +428,13 @@ DNSEntry::init(const char *x, int len, int qtype_arg, Continuation* acont,
 
 #ifdef SPLIT_DNS
   if (SplitDNSConfig::gsplit_dns_enabled) {
-    dnsH = opt.handler ? opt.handler : dnsProcessor.handler;
+    dnsH = opt.handler ? opt.handler : dnsProcessor.thread_handler(submit_thread);
   } else {
-    dnsH = dnsProcessor.handler;
+    dnsH = dnsProcessor.thread_handler(submit_thread);
   }
 #else
   INK_NOWARN(adnsH);
-  dnsH = dnsProcessor.handler;
+  dnsH = dnsProcessor.thread_handler(submit_thread);
 #endif // SPLIT_DNS
 
   dnsH->txn_lookup_timeout = opt.timeout;
@@ -413,7 +473,7 @@ void
 DNSHandler::open_con(sockaddr const* target, bool failed, int icon)
 {
   ip_port_text_buffer ip_text;
-  PollDescriptor *pd = get_PollDescriptor(dnsProcessor.thread);
+  PollDescriptor *pd = get_PollDescriptor(thread ? thread : dnsProcessor.thread);
 
   if (!icon && target) {
     ats_ip_copy(&ip, target);
@@ -488,28 +548,9 @@ DNSHandler::startEvent(int /* event ATS_UNUSED */, Event *e)
     //
     dns_handler_initialized = 1;
     SET_HANDLER(&DNSHandler::mainEvent);
-    if (dns_ns_rr) {
-      int max_nscount = m_res->nscount;
-      if (max_nscount > MAX_NAMED)
-        max_nscount = MAX_NAMED;
-      n_con = 0;
-      for (int i = 0; i < max_nscount; i++) {
-        ip_port_text_buffer buff;
-        sockaddr *sa = &m_res->nsaddr_list[i].sa;
-        if (ats_is_ip(sa)) {
-          open_con(sa, false, n_con);
-          ++n_con;
-          Debug("dns_pas", "opened connection to %s, n_con = %d",
-            ats_ip_nptop(sa, buff, sizeof(buff)),
-            n_con
-          );
-        }
-      }
+    open_cons();
+    if (dns_ns_rr)
       dns_ns_rr_init_down = 0;
-    } else {
-      open_con(0); // use current target address.
-      n_con = 1;
-    }
     e->ethread->schedule_every(this, DNS_PERIOD);
 
     return EVENT_CONT;
@@ -519,6 +560,49 @@ DNSHandler::startEvent(int /* event ATS_UNUSED */, Event *e)
   }
 }
 
+/**
+  Initial state of a per thread DNSHandler, run on its own thread.
+*/
+int
+DNSHandler::startEvent_thread(int /* event ATS_UNUSED */, Event *e)
+{
+  Debug("dns", "DNSHandler::startEvent_thread: on thread %d\n", e->ethread->id);
+  ink_assert(e->ethread == thread);
+  this->validate_ip();
+
+  SET_HANDLER(&DNSHandler::mainEvent);
+  open_cons();
+  e->ethread->schedule_every(this, DNS_PERIOD);
+  return EVENT_CONT;
+}
+
+/** Open the connections to the configured name servers. */
+void
+DNSHandler::open_cons()
+{
+  if (dns_ns_rr) {
+    int max_nscount = m_res->nscount;
+    if (max_nscount > MAX_NAMED)
+      max_nscount = MAX_NAMED;
+    n_con = 0;
+    for (int i = 0; i < max_nscount; i++) {
+      ip_port_text_buffer buff;
+      sockaddr *sa = &m_res->nsaddr_list[i].sa;
+      if (ats_is_ip(sa)) {
+        open_con(sa, false, n_con);
+        ++n_con;
+        Debug("dns_pas", "opened connection to %s, n_con = %d",
+          ats_ip_nptop(sa, buff, sizeof(buff)),
+          n_con
+        );
+      }
+    }
+  } else {
+    open_con(0); // use current target address.
+    n_con = 1;
+  }
+}
+
 /**
   Initial state of the DSNHandler. Can reinitialize the running DNS
   hander to a new nameserver.
@@ -840,6 +924,14 @@ DNSHandler::mainEvent(int event, Event *e)
   if (entries.head)
     write_dns(this);
 
+  if (in_flight_stat) {
+    ink_hrtime t = ink_get_hrtime();
+    if (t - in_flight_stat_time > HRTIME_SECONDS(1)) {
+      in_flight_stat_time = t;
+      RecSetRecordInt(in_flight_stat, in_flight);
+    }
+  }
+
   return EVENT_CONT;
 }
 
@@ -1093,8 +1185,12 @@ DNSProcessor::getby(const char *x, int len, int type, Continuation *cont, Option
   e->retries = dns_retries;
   e->init(x, len, type, cont, opt);
   MUTEX_TRY_LOCK(lock, e->mutex, this_ethread());
-  if (!lock)
-    thread->schedule_imm(e);
+  if (!lock) {
+    if (e->dnsH && e->dnsH->thread)
+      e->dnsH->thread->schedule_imm(e);
+    else
+      thread->schedule_imm(e);
+  }
   else
     e->handleEvent(EVENT_IMMEDIATE, 0);
   return &e->action;
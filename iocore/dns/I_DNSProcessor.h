@@ -124,12 +124,21 @@ struct DNSProcessor: public Processor
   //
   void open(sockaddr const* ns = 0, int options = _res.options);
 
+  // Start a resolver on each ET_NET thread (proxy.config.dns.per_thread_resolvers)
+  //
+  void open_thread_handlers();
+
+  /// The handler for queries submitted on @a t.
+  DNSHandler *thread_handler(EThread *t);
+
   DNSProcessor();
 
   // private:
   //
   EThread *thread;
   DNSHandler *handler;
+  DNSHandler **thread_handlers; ///< Indexed by ET_NET thread, NULL unless per thread.
+  int n_thread_handlers;
   ts_imp_res_state l_res;
   IpEndpoint local_ipv6;
   IpEndpoint local_ipv4;
@@ -57,6 +57,7 @@ extern int dns_failover_number;
 extern int dns_failover_period;
 extern int dns_failover_try_period;
 extern int dns_max_dns_in_flight;
+extern int dns_per_thread;
 extern unsigned int dns_sequence_number;
 
 //
@@ -225,6 +226,12 @@ struct DNSHandler: public Continuation
   ink_res_state m_res;
   int txn_lookup_timeout;
 
+  /// Thread a per thread resolver runs on, NULL for the shared handlers.
+  EThread *thread;
+  /// Name of the stat this handler reports in_flight to, if any.
+  char *in_flight_stat;
+  ink_hrtime in_flight_stat_time;
+
   InkRand generator;
   // bitmap of query ids in use
   uint64_t qid_in_flight[(USHRT_MAX+1)/64];
@@ -262,9 +269,11 @@ struct DNSHandler: public Continuation
   void recv_dns(int event, Event *e);
   int startEvent(int event, Event *e);
   int startEvent_sdns(int event, Event *e);
+  int startEvent_thread(int event, Event *e);
   int mainEvent(int event, Event *e);
 
   void open_con(sockaddr const* addr, bool failed = false, int icon = 0);
+  void open_cons();
   void failover();
   void rr_failure(int ndx);
   void recover();
@@ -296,7 +305,8 @@ private:
 TS_INLINE DNSHandler::DNSHandler()
  : Continuation(NULL), n_con(0), options(0), in_flight(0), name_server(0), in_write_dns(0),
   hostent_cache(0), last_primary_retry(0), last_primary_reopen(0),
-  m_res(0), txn_lookup_timeout(0), generator((uint32_t)((uintptr_t)time(NULL) ^ (uintptr_t)this))
+  m_res(0), txn_lookup_timeout(0), thread(NULL), in_flight_stat(NULL), in_flight_stat_time(0),
+  generator((uint32_t)((uintptr_t)time(NULL) ^ (uintptr_t)this))
 {
   ats_ip_invalidate(&ip);
   for (int i = 0; i < MAX_NAMED; i++) {
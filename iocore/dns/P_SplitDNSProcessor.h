@@ -88,6 +88,22 @@ struct SplitDNSResult
 };
 
 
+/* --------------------------------------------------------------
+   **                struct SplitDNSCacheEntry
+
+   The record last selected for a host name. check is the hash of
+   the name xor rec, so that an entry torn by concurrent writers
+   does not match.
+   -------------------------------------------------------------- */
+#define SPLITDNS_CACHE_SIZE 4096
+
+struct SplitDNSCacheEntry
+{
+  volatile uint64_t check;
+  volatile uint64_t rec;        // SplitDNSRecord *, 0 if no rule matched
+};
+
+
 /* --------------------------------------------------------------
    **                struct SplitDNS
    -------------------------------------------------------------- */
@@ -111,6 +127,12 @@ struct SplitDNS:public ConfigInfo
   bool m_bEnableFastPath;
   void *m_pxLeafArray;
   int m_numEle;
+
+  /* ----------------------------
+     selections by host name, for
+     this configuration only
+     ---------------------------- */
+  SplitDNSCacheEntry *m_cache;
 };
 
 
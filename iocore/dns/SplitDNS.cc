@@ -96,7 +96,7 @@ inline SplitDNSResult::SplitDNSResult()
    -------------------------------------------------------------- */
 SplitDNS::SplitDNS()
 : m_DNSSrvrTable(NULL), m_SplitDNSlEnable(0),
-  m_bEnableFastPath(false), m_pxLeafArray(NULL), m_numEle(0)
+  m_bEnableFastPath(false), m_pxLeafArray(NULL), m_numEle(0), m_cache(NULL)
 {
 }
 
@@ -106,6 +106,7 @@ SplitDNS::~SplitDNS()
   if (m_DNSSrvrTable) {
     delete m_DNSSrvrTable;
   }
+  ats_free(m_cache);
 }
 
 
@@ -175,6 +176,8 @@ SplitDNSConfig::reconfigure()
     params->m_bEnableFastPath = true;
   }
 
+  params->m_cache = (SplitDNSCacheEntry *) ats_calloc(SPLITDNS_CACHE_SIZE, sizeof(SplitDNSCacheEntry));
+
   m_id = configProcessor.set(m_id, params);
 
   if (is_debug_tag_set("splitdns_config")) {
@@ -199,6 +202,23 @@ SplitDNSConfig::print()
 }
 
 
+/* --------------------------------------------------------------
+   host_name_hash()
+   FNV-1a, never 0 so that empty cache entries do not match
+   -------------------------------------------------------------- */
+static inline uint64_t
+host_name_hash(const char *hostname)
+{
+  uint64_t h = 14695981039346656037ULL;
+
+  for (const unsigned char *p = (const unsigned char *) hostname; *p; p++) {
+    h ^= *p;
+    h *= 1099511628211ULL;
+  }
+  return h | 1;
+}
+
+
 /* --------------------------------------------------------------
    SplitDNS::getDNSRecord()
    -------------------------------------------------------------- */
@@ -207,16 +227,36 @@ SplitDNS::getDNSRecord(const char *hostname)
 {
   Debug("splitdns", "Called SplitDNS::getDNSRecord(%s)", hostname);
 
-  DNSRequestData *pRD = DNSReqAllocator.alloc();
-  pRD->m_pHost = hostname;
+  /* -------------------------------------------
+     HostDB asks for every lookup, hits as well,
+     as the server is part of its key. The rules
+     only look at the name, so the selection is
+     remembered by name.
+     ------------------------------------------- */
+  uint64_t h = host_name_hash(hostname);
+  SplitDNSCacheEntry *e = &m_cache[h % SPLITDNS_CACHE_SIZE];
+  uint64_t rec = e->rec;
+  SplitDNSRecord *pRec;
+
+  if ((e->check ^ rec) == h) {
+    pRec = (SplitDNSRecord *) (uintptr_t) rec;
+  } else {
+    DNSRequestData *pRD = DNSReqAllocator.alloc();
+    pRD->m_pHost = hostname;
+
+    SplitDNSResult res;
+    findServer(pRD, &res);
 
-  SplitDNSResult res;
-  findServer(pRD, &res);
+    DNSReqAllocator.free(pRD);
 
-  DNSReqAllocator.free(pRD);
+    pRec = DNS_SRVR_SPECIFIED == res.r ? res.m_rec : NULL;
+    rec = (uint64_t) (uintptr_t) pRec;
+    e->rec = rec;
+    e->check = h ^ rec;
+  }
 
-  if (DNS_SRVR_SPECIFIED == res.r) {
-    return (void *) &(res.m_rec->m_servers);
+  if (pRec) {
+    return (void *) &(pRec->m_servers);
   }
 
   Debug("splitdns", "Fail to match a valid splitdns rule, fallback to default dns resolver");
@@ -0,0 +1,103 @@
+/** @file
+
+  Sampling profiler for continuation handlers
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+ */
+
+#include "P_EventSystem.h"
+
+int event_profile_sample = 0;
+int event_profile_slow_msec = 50;
+int64_t event_profile_cycles_per_usec = 1000;
+
+void
+event_profile_init()
+{
+  REC_EstablishStaticConfigInt32(event_profile_sample, "proxy.config.exec_thread.profile.sample");
+  REC_EstablishStaticConfigInt32(event_profile_slow_msec, "proxy.config.exec_thread.profile.slow_threshold");
+
+  // the counter rate, over a millisecond
+  ink_hrtime t0 = ink_get_hrtime_internal(), t1;
+  int64_t c0 = event_profile_cycles();
+  while ((t1 = ink_get_hrtime_internal()) - t0 < HRTIME_MSECOND)
+    ;
+  event_profile_cycles_per_usec = (event_profile_cycles() - c0) / ((t1 - t0) / HRTIME_USECOND);
+  if (event_profile_cycles_per_usec <= 0)
+    event_profile_cycles_per_usec = 1;
+  Debug("event_profile", "%" PRId64 " cycles per usec", event_profile_cycles_per_usec);
+}
+
+void
+event_profile_record(EThread *t, const std::type_info *type, void *handler, const char *name, int64_t cycles)
+{
+  EventProfile *p = t->profile;
+
+  if (unlikely(!p)) {
+    p = t->profile = (EventProfile *)ats_malloc(sizeof(EventProfile));
+    memset(p, 0, sizeof(EventProfile));
+  }
+  if (cycles < 0)
+    cycles = 0;
+
+  uint64_t h = ((uintptr_t) type ^ ((uintptr_t) handler << 7)) * 0x9E3779B97F4A7C15ULL;
+  EventProfileEntry *e = NULL;
+  for (int i = 0; i < EVENT_PROFILE_PROBES; i++) {
+    EventProfileEntry *x = &p->entries[((h >> 32) + i) & (EVENT_PROFILE_ENTRIES - 1)];
+    if (!x->type) {
+      x->type = type;
+      x->handler = handler;
+      x->name = name;
+    }
+    if (x->type == type && x->handler == handler) {
+      e = x;
+      break;
+    }
+  }
+  if (!e) {
+    p->dropped++;
+    return;
+  }
+
+  e->calls++;
+  e->cycles += cycles;
+  if (cycles > e->max_cycles)
+    e->max_cycles = cycles;
+  if (event_profile_slow_msec && cycles / event_profile_cycles_per_usec >= event_profile_slow_msec * 1000) {
+    p->slow++;
+    // warn once for each handler, the profile has the count after that
+    if (!e->slow++)
+      Warning("slow event handler %s %s on thread %d took %" PRId64 " msec", type->name(), name ? name : "",
+              t->id, cycles / event_profile_cycles_per_usec / 1000);
+    Debug("event_profile", "slow handler %s %s %p took %" PRId64 " usec", type->name(), name ? name : "", handler,
+          cycles / event_profile_cycles_per_usec);
+  }
+}
+
+int64_t
+event_profile_slow_total()
+{
+  int64_t slow = 0;
+
+  for (int i = 0; i < eventProcessor.n_ethreads; i++)
+    if (eventProcessor.all_ethreads[i]->profile)
+      slow += eventProcessor.all_ethreads[i]->profile->slow;
+  return slow;
+}
@@ -29,20 +29,159 @@
 ****************************************************************************/
 
 #include "P_EventSystem.h"
+#include "ink_queue_ext.h"
+
+enum
+{
+  HUGEPAGE_STAT_ALLOCATED_BYTES,
+  HUGEPAGE_STAT_FALLBACK_BYTES,
+  RECLAIM_STAT_RECLAIMED_BYTES,
+  RECLAIM_STAT_RECLAIMED_BYTES_TOTAL,
+  ALLOCATOR_STAT_COUNT
+};
+
+static int
+allocator_stats_cb(const char * /* name ATS_UNUSED */, RecDataT /* data_type ATS_UNUSED */, RecData *data,
+                  RecRawStatBlock * /* rsb ATS_UNUSED */, int id)
+{
+  switch (id) {
+  case HUGEPAGE_STAT_ALLOCATED_BYTES:
+    data->rec_int = ats_hugepage_allocated;
+    break;
+  case HUGEPAGE_STAT_FALLBACK_BYTES:
+    data->rec_int = ats_hugepage_fallback;
+    break;
+  case RECLAIM_STAT_RECLAIMED_BYTES:
+    data->rec_int = freelist_reclaimed_mem;
+    break;
+  default:
+    data->rec_int = freelist_reclaimed_mem_total;
+    break;
+  }
+  return 0;
+}
+
+// per allocator memory stats, freelists with the same stat name are summed
+static int memory_stat_nfreelists = 0;
+static InkFreeList **memory_stat_freelists = NULL;
+static int *memory_stat_first = NULL;
+static int *memory_stat_next = NULL;
+
+static int
+memory_stats_cb(const char * /* name ATS_UNUSED */, RecDataT /* data_type ATS_UNUSED */, RecData *data,
+                RecRawStatBlock * /* rsb ATS_UNUSED */, int id)
+{
+  int64_t bytes = 0;
+
+  for (int i = memory_stat_first[id / 2]; i >= 0; i = memory_stat_next[i]) {
+    InkFreeList *f = memory_stat_freelists[i];
+    bytes += (int64_t)(id & 1 ? f->count : f->allocated) * f->type_size;
+  }
+  data->rec_int = bytes;
+  return 0;
+}
+
+static void
+register_memory_stats()
+{
+  ink_freelist_list *fll;
+  char (*names)[64];
+  int nstats = 0;
+
+  for (fll = freelists; fll; fll = fll->next)
+    memory_stat_nfreelists++;
+  memory_stat_freelists = (InkFreeList **)ats_malloc(memory_stat_nfreelists * sizeof(InkFreeList *));
+  memory_stat_first = (int *)ats_malloc(memory_stat_nfreelists * sizeof(int));
+  memory_stat_next = (int *)ats_malloc(memory_stat_nfreelists * sizeof(int));
+  names = (char (*)[64])ats_malloc(memory_stat_nfreelists * sizeof(*names));
+
+  // "ioBufAllocator[3] node 1" becomes "ioBufAllocator_3_node_1"
+  int i = 0;
+  for (fll = freelists; fll; fll = fll->next, i++) {
+    const char *p = fll->fl->name ? fll->fl->name : "unknown";
+    char name[64];
+    int len = 0, s;
+
+    for (; *p && len < (int)sizeof(name) - 1; p++) {
+      if (ParseRules::is_alnum(*p))
+        name[len++] = *p;
+      else if (len && name[len - 1] != '_')
+        name[len++] = '_';
+    }
+    while (len && name[len - 1] == '_')
+      len--;
+    name[len] = 0;
+
+    memory_stat_freelists[i] = fll->fl;
+    memory_stat_next[i] = -1;
+    for (s = 0; s < nstats; s++)
+      if (!strcmp(names[s], name))
+        break;
+    if (s < nstats) {
+      memory_stat_next[i] = memory_stat_first[s];
+      memory_stat_first[s] = i;
+    } else {
+      ink_strlcpy(names[nstats], name, sizeof(names[nstats]));
+      memory_stat_first[nstats++] = i;
+    }
+  }
+
+  RecRawStatBlock *memory_rsb = RecAllocateRawStatBlock(nstats * 2);
+  for (int s = 0; s < nstats; s++) {
+    char stat_name[128];
+    snprintf(stat_name, sizeof(stat_name), "proxy.process.memory.%s.allocated_bytes", names[s]);
+    RecRegisterRawStat(memory_rsb, RECT_PROCESS, stat_name, RECD_INT, RECP_NON_PERSISTENT, s * 2, memory_stats_cb);
+    snprintf(stat_name, sizeof(stat_name), "proxy.process.memory.%s.in_use_bytes", names[s]);
+    RecRegisterRawStat(memory_rsb, RECT_PROCESS, stat_name, RECD_INT, RECP_NON_PERSISTENT, s * 2 + 1, memory_stats_cb);
+  }
+  ats_free(names);
+}
 
 void
 ink_event_system_init(ModuleVersion v)
 {
   ink_release_assert(!checkModuleVersion(v, EVENT_SYSTEM_MODULE_VERSION));
   int config_max_iobuffer_size = DEFAULT_MAX_BUFFER_SIZE;
+  int affinity = 0;
+  int hugepages = 0;
 
   REC_EstablishStaticConfigInt32(thread_freelist_size, "proxy.config.allocator.thread_freelist_size");
   REC_ReadConfigInteger(config_max_iobuffer_size, "proxy.config.io.max_buffer_size");
+  // before the threads start
+  REC_ReadConfigInteger(ink_freelist_magazine_size, "proxy.config.allocator.magazine_size");
+
+  // before any pool or cache directory is allocated
+  REC_ReadConfigInteger(hugepages, "proxy.config.allocator.hugepages");
+  ats_hugepage_init(hugepages);
+  if (hugepages && !ats_hugepage_enabled())
+    Warning("proxy.config.allocator.hugepages is set but the system has no huge pages");
+  RecRawStatBlock *allocator_rsb = RecAllocateRawStatBlock((int) ALLOCATOR_STAT_COUNT);
+  RecRegisterRawStat(allocator_rsb, RECT_PROCESS, "proxy.process.allocator.hugepages.allocated_bytes",
+                     RECD_INT, RECP_NULL, (int) HUGEPAGE_STAT_ALLOCATED_BYTES, allocator_stats_cb);
+  RecRegisterRawStat(allocator_rsb, RECT_PROCESS, "proxy.process.allocator.hugepages.fallback_bytes",
+                     RECD_INT, RECP_NULL, (int) HUGEPAGE_STAT_FALLBACK_BYTES, allocator_stats_cb);
+  RecRegisterRawStat(allocator_rsb, RECT_PROCESS, "proxy.process.allocator.reclaimed_bytes",
+                     RECD_INT, RECP_NULL, (int) RECLAIM_STAT_RECLAIMED_BYTES, allocator_stats_cb);
+  RecRegisterRawStat(allocator_rsb, RECT_PROCESS, "proxy.process.allocator.reclaimed_bytes_total",
+                     RECD_INT, RECP_NULL, (int) RECLAIM_STAT_RECLAIMED_BYTES_TOTAL, allocator_stats_cb);
 
   max_iobuffer_size = buffer_size_to_index(config_max_iobuffer_size, DEFAULT_BUFFER_SIZES - 1);
   if (default_small_iobuffer_size > max_iobuffer_size)
     default_small_iobuffer_size = max_iobuffer_size;
   if (default_large_iobuffer_size > max_iobuffer_size)
     default_large_iobuffer_size = max_iobuffer_size;
-  init_buffer_allocators();
+
+  // the buffer pools are per node, so the node count has to be known before the threads are
+  REC_ReadConfigInteger(affinity, "proxy.config.exec_thread.affinity");
+  if (affinity == 4) {
+    eventProcessor.numa_nodes = ink_numa_nodes();
+    if (eventProcessor.numa_nodes > MAX_NUMA_NODES)
+      eventProcessor.numa_nodes = MAX_NUMA_NODES;
+  }
+  init_buffer_allocators(eventProcessor.numa_nodes);
+
+  // after the buffer allocators, the class allocators are static
+  register_memory_stats();
+
+  event_profile_init();
 }
@@ -31,6 +31,8 @@
 // General Buffer Allocator
 //
 inkcoreapi Allocator ioBufAllocator[DEFAULT_BUFFER_SIZES];
+Allocator *ioBufNodeAllocator[MAX_NUMA_NODES] = { ioBufAllocator };
+int iobuffer_numa_nodes = 1;
 inkcoreapi ClassAllocator<MIOBuffer> ioAllocator("ioAllocator", DEFAULT_BUFFER_NUMBER);
 inkcoreapi ClassAllocator<IOBufferData> ioDataAllocator("ioDataAllocator", DEFAULT_BUFFER_NUMBER);
 inkcoreapi ClassAllocator<IOBufferBlock> ioBlockAllocator("ioBlockAllocator", DEFAULT_BUFFER_NUMBER);
@@ -42,20 +44,30 @@ int64_t max_iobuffer_size = DEFAULT_BUFFER_SIZES - 1;
 // Initialization
 //
 void
-init_buffer_allocators()
+init_buffer_allocators(int numa_nodes)
 {
   char *name;
 
-  for (int i = 0; i < DEFAULT_BUFFER_SIZES; i++) {
-    int64_t s = DEFAULT_BUFFER_BASE_SIZE * (((int64_t)1) << i);
-    int64_t a = DEFAULT_BUFFER_ALIGNMENT;
-    int n = i <= default_large_iobuffer_size ? DEFAULT_BUFFER_NUMBER : DEFAULT_HUGE_BUFFER_NUMBER;
-    if (s < a)
-      a = s;
+  ink_release_assert(numa_nodes >= 1 && numa_nodes <= MAX_NUMA_NODES);
+  for (int node = 1; node < numa_nodes; node++)
+    ioBufNodeAllocator[node] = NEW(new Allocator[DEFAULT_BUFFER_SIZES]);
+  iobuffer_numa_nodes = numa_nodes;
 
-    name = NEW(new char[64]);
-    snprintf(name, 64, "ioBufAllocator[%d]", i);
-    ioBufAllocator[i].re_init(name, s, n, a);
+  for (int node = 0; node < numa_nodes; node++) {
+    for (int i = 0; i < DEFAULT_BUFFER_SIZES; i++) {
+      int64_t s = DEFAULT_BUFFER_BASE_SIZE * (((int64_t)1) << i);
+      int64_t a = DEFAULT_BUFFER_ALIGNMENT;
+      int n = i <= default_large_iobuffer_size ? DEFAULT_BUFFER_NUMBER : DEFAULT_HUGE_BUFFER_NUMBER;
+      if (s < a)
+        a = s;
+
+      name = NEW(new char[64]);
+      if (node)
+        snprintf(name, 64, "ioBufAllocator[%d] node %d", i, node);
+      else
+        snprintf(name, 64, "ioBufAllocator[%d]", i);
+      ioBufNodeAllocator[node][i].re_init(name, s, n, a, i > default_large_iobuffer_size);
+    }
   }
 }
 
@@ -267,3 +279,40 @@ IOBufferReader::memcpy(const void *ap, int64_t len, int64_t offset)
 
   return p;
 }
+
+#if TS_HAS_TESTS
+REGRESSION_TEST(Bench_IOBuffer) (RegressionTest * t, int atype, int *pstatus) {
+  if (atype < REGRESSION_TEST_EXTENDED) {
+    *pstatus = REGRESSION_TEST_NOT_RUN;
+    return;
+  }
+
+  static const int sizes[] = { 64, 1460, 16384 };
+  char data[16384], out[16384];
+
+  memset(data, 'x', sizeof(data));
+  for (unsigned i = 0; i < countof(sizes); i++) {
+    MIOBuffer *buf = new_MIOBuffer(BUFFER_SIZE_INDEX_32K);
+    IOBufferReader *reader = buf->alloc_reader();
+    int64_t ops = ((int64_t) 1 << 28) / sizes[i], total = 0;
+    char tag[32];
+    ink_hrtime start = ink_get_hrtime_internal();
+
+    // each op writes a chunk and reads it back, allocating and freeing
+    // blocks as the buffer fills and drains
+    for (int64_t j = 0; j < ops; j++) {
+      buf->write(data, sizes[i]);
+      total += reader->read(out, sizes[i]);
+    }
+    snprintf(tag, sizeof(tag), "write_read_%d", sizes[i]);
+    rbench(t, tag, 1, ops, ink_get_hrtime_internal() - start);
+    free_MIOBuffer(buf);
+    if (total != ops * sizes[i]) {
+      rprintf(t, "read %d bytes less than written\n", (int) (ops * sizes[i] - total));
+      *pstatus = REGRESSION_TEST_FAILED;
+      return;
+    }
+  }
+  *pstatus = REGRESSION_TEST_PASSED;
+}
+#endif
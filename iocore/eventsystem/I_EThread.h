@@ -46,6 +46,7 @@ struct DiskHandler;
 struct EventIO;
 
 class SessionBucket;
+struct EventProfile;
 class Event;
 class Continuation;
 
@@ -275,6 +276,7 @@ public:
   ProxyAllocator openDirEntryAllocator;
   ProxyAllocator ramCacheCLFUSEntryAllocator;
   ProxyAllocator ramCacheLRUEntryAllocator;
+  ProxyAllocator ramCacheShardedEntryAllocator;
   ProxyAllocator evacuationBlockAllocator;
   ProxyAllocator ioDataAllocator;
   ProxyAllocator ioAllocator;
@@ -319,6 +321,19 @@ public:
 
   int id;
   unsigned int event_types;
+  /// The NUMA node this thread runs on and allocates from, -1 if it is not bound.
+  int numa_node;
+  /// Time spent blocked waiting for work, added to by whoever sleeps on behalf of the thread.
+  ink_hrtime idle_time;
+  /// Busy share of the last load interval in per mille, read by EventProcessor::assign_thread.
+  volatile int load;
+  /// Events this thread has handled.
+  int64_t load_events;
+  /// Handler times sampled on this thread, allocated by the first sample.
+  EventProfile *profile;
+  int profile_countdown;
+  /// Bumped every time around the event loop, for traffic_cop. NULL if there is no heartbeat file.
+  volatile uint64_t *heartbeat;
   bool is_event_type(EventType et);
   void set_event_type(EventType et);
 
@@ -326,6 +341,7 @@ public:
 
   void execute();
   void process_event(Event *e, int calling_code);
+  void update_load(ink_hrtime now);
   void free_event(Event *e);
   void (*signal_hook)(EThread *);
 
@@ -341,6 +357,9 @@ public:
   ink_sem *eventsem;            // For dedicated event thread
 
   SessionBucket* l1_hash;
+
+  ink_hrtime load_start;        // start of the current load interval
+  ink_hrtime load_idle;         // idle_time at load_start
 };
 
 /**
@@ -211,7 +211,7 @@ public:
   unsigned int in_the_priority_queue:1;
   unsigned int immediate:1;
   unsigned int globally_allocated:1;
-  unsigned int in_heap:4;
+  unsigned int in_heap:10;      // priority list, or timer wheel slot
   int callback_event;
 
   ink_hrtime timeout_at;
@@ -300,6 +300,27 @@ public:
   */
   int n_thread_groups;
 
+  /**
+    Number of NUMA nodes the event threads are spread over. More than
+    one only when proxy.config.exec_thread.affinity binds the threads
+    to nodes, each thread then has its numa_node set and allocates its
+    IOBuffer memory from pools local to that node.
+
+  */
+  int numa_nodes;
+
+  /**
+    How much busier, in per mille of the load interval, the round robin
+    choice of thread has to be than the alternative before assign_thread
+    hands the work to the alternative instead. Zero assigns strictly round
+    robin. Set from proxy.config.exec_thread.load_balance_threshold.
+
+  */
+  int load_balance_threshold;
+
+  /** Number of assignments moved off the round robin choice to a less loaded thread. */
+  volatile int64_t n_rebalanced;
+
 private:
   // prevent unauthorized copies (Not implemented)
     EventProcessor(const EventProcessor &);
@@ -0,0 +1,123 @@
+/** @file
+
+  Sampling profiler for continuation handlers
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+ */
+
+#if !defined (I_EventProfile_h)
+#define I_EventProfile_h
+
+#include <typeinfo>
+#include "I_Continuation.h"
+#include "I_EThread.h"
+
+#define EVENT_PROFILE_ENTRIES 512     // handlers tracked per thread, a power of 2
+#define EVENT_PROFILE_PROBES  8
+
+/// Time spent in one handler of one continuation type on one thread.
+struct EventProfileEntry
+{
+  const std::type_info *type;   // the continuation's class, NULL for a free slot
+  void *handler;                // the first word of the handler member pointer
+  const char *name;             // handler_name in DEBUG builds
+  int64_t calls;                // sampled calls
+  int64_t cycles;               // total of the sampled calls, less the time spent asleep
+  int64_t max_cycles;
+  int64_t slow;                 // sampled calls over the slow threshold
+};
+
+struct EventProfile
+{
+  EventProfileEntry entries[EVENT_PROFILE_ENTRIES];
+  int64_t dropped;              // samples which found no free slot
+  int64_t slow;
+};
+
+/// Profile one in this many handler calls, 0 turns the profiler off.
+extern int event_profile_sample;
+/// Sampled calls taking longer than this many milliseconds are flagged.
+extern int event_profile_slow_msec;
+/// Time stamp counter ticks per microsecond, measured at startup.
+extern int64_t event_profile_cycles_per_usec;
+
+void event_profile_init();
+void event_profile_record(EThread *t, const std::type_info *type, void *handler, const char *name, int64_t cycles);
+int64_t event_profile_slow_total();
+
+static inline int64_t
+event_profile_cycles()
+{
+#if defined(__i386__) || defined(__x86_64__)
+  uint32_t lo, hi;
+  __asm__ __volatile__("rdtsc":"=a"(lo), "=d"(hi));
+  return ((int64_t) hi << 32) | lo;
+#else
+  return ink_get_hrtime_internal();
+#endif
+}
+
+/**
+  Times the handler call made while it is in scope, for one in every
+  event_profile_sample calls on a thread. The continuation may be gone
+  once the handler returns, so what identifies it is taken up front.
+  Time the thread spends asleep inside the call, as the net poll does,
+  is not counted.
+
+*/
+struct EventProfileScope
+{
+  EThread *thread;
+  int64_t start;
+  ink_hrtime idle;
+  const std::type_info *type;
+  void *handler;
+  const char *name;
+
+  EventProfileScope(EThread *t, Continuation *c)
+    : thread(t), start(0)
+  {
+    if (unlikely(event_profile_sample) && --t->profile_countdown <= 0) {
+      t->profile_countdown = event_profile_sample;
+      type = &typeid(*c);
+      memcpy(&handler, &c->handler, sizeof(handler));
+#ifdef DEBUG
+      name = c->handler_name;
+#else
+      name = NULL;
+#endif
+      idle = t->idle_time;
+      start = event_profile_cycles();
+    }
+  }
+
+  ~EventProfileScope()
+  {
+    if (unlikely(start)) {
+      int64_t cycles = event_profile_cycles() - start;
+      ink_hrtime slept = thread->idle_time - idle;
+      if (slept)
+        cycles -= slept / HRTIME_USECOND * event_profile_cycles_per_usec;
+      event_profile_record(thread, type, handler, name, cycles);
+    }
+  }
+};
+
+#endif
@@ -33,6 +33,7 @@
 #include "I_EThread.h"
 #include "I_Event.h"
 #include "I_EventProcessor.h"
+#include "I_EventProfile.h"
 
 #include "I_Lock.h"
 #include "I_PriorityEventQueue.h"
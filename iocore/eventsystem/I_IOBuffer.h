@@ -65,7 +65,8 @@ enum AllocType
   XMALLOCED,
   MEMALIGNED,
   DEFAULT_ALLOC,
-  CONSTANT
+  CONSTANT,
+  FILE_BACKED
 };
 
 #if TS_USE_RECLAIMABLE_FREELIST
@@ -75,6 +76,7 @@ enum AllocType
 #endif
 #define DEFAULT_HUGE_BUFFER_NUMBER   32
 #define MAX_MIOBUFFER_READERS        5
+#define MIOBUFFER_GROW_BLOCKS        4
 #define DEFAULT_BUFFER_ALIGNMENT     8192       // should be disk/page size
 #define DEFAULT_BUFFER_BASE_SIZE     128
 
@@ -128,9 +130,14 @@ enum AllocType
 #define BUFFER_SIZE_FOR_CONSTANT(_size) (_size - DEFAULT_BUFFER_SIZES)
 #define BUFFER_SIZE_INDEX_FOR_CONSTANT_SIZE(_size) (_size+DEFAULT_BUFFER_SIZES)
 
+#define MAX_NUMA_NODES               8
+
 inkcoreapi extern Allocator ioBufAllocator[DEFAULT_BUFFER_SIZES];
+// The buffer pools of each NUMA node, ioBufAllocator is that of node 0.
+extern Allocator *ioBufNodeAllocator[MAX_NUMA_NODES];
+extern int iobuffer_numa_nodes;
 
-void init_buffer_allocators();
+void init_buffer_allocators(int numa_nodes = 1);
 
 /**
   A reference counted wrapper around fast allocated or malloced memory.
@@ -231,6 +238,16 @@ public:
     return _data;
   }
 
+  /**
+    Returns true if the bytes of this IOBufferData live in a file
+    rather than in memory. See '_fd' below.
+
+  */
+  bool is_file_backed() const
+  {
+    return _mem_type == FILE_BACKED;
+  }
+
   /**
     Frees the IOBufferData object and its underlying memory. Deallocates
     the memory managed by this IOBufferData and then frees itself. You
@@ -250,6 +267,14 @@ public:
   */
   AllocType _mem_type;
 
+  /**
+    NUMA node of the pool a fast allocated '_data' came from, set by
+    alloc from the node of the allocating thread so that dealloc can
+    give the memory back to the same pool.
+
+  */
+  int _numa_node;
+
   /**
     Points to the allocated memory. This member stores the address of
     the allocated memory. You should not modify its value directly,
@@ -258,6 +283,17 @@ public:
   */
   char *_data;
 
+  /**
+    File holding the bytes of a FILE_BACKED IOBufferData. Such data
+    has no memory behind it: '_data' is NULL and the block pointers are
+    offsets from '_fd_offset' in '_fd'. These blocks may only be handed
+    to a consumer which sends straight from the file, see
+    NetVConnection::sendfile_capable().
+
+  */
+  int _fd;
+  off_t _fd_offset;
+
 #ifdef TRACK_BUFFER_USER
   const char *_location;
 #endif
@@ -268,7 +304,7 @@ public:
 
   */
   IOBufferData()
-:  _size_index(BUFFER_SIZE_NOT_ALLOCATED), _mem_type(NO_ALLOC), _data(NULL)
+:  _size_index(BUFFER_SIZE_NOT_ALLOCATED), _mem_type(NO_ALLOC), _numa_node(0), _data(NULL), _fd(-1), _fd_offset(0)
 #ifdef TRACK_BUFFER_USER
     , _location(NULL)
 #endif
@@ -836,11 +872,30 @@ public:
 
   /**
     Adds new block to the end of block list using the block size for
-    the buffer specified when the buffer was allocated.
+    the buffer specified when the buffer was allocated. With a grow
+    size index set, every MIOBUFFER_GROW_BLOCKS blocks added double
+    the block size, up to that index.
 
   */
   void add_block();
 
+  /**
+    Lets the block size grow up to asize_index while the buffer keeps
+    filling its blocks, so a stream which turns out to be bulk moves
+    to larger blocks. BUFFER_SIZE_NOT_ALLOCATED turns this off.
+
+  */
+  void set_grow_size_index(int64_t asize_index);
+
+  /**
+    Frees the blocks of a buffer whose readers are all empty, the next
+    write allocates a block of asize_index. Used to hold no memory for
+    idle connections. Returns the size of the blocks dropped, or -1,
+    changing nothing, if any reader still has data.
+
+  */
+  int64_t shrink(int64_t asize_index);
+
   /**
     Adds by reference len bytes of data pointed to by b to the end
     of the buffer.  b MUST be a pointer to the beginning of  block
@@ -1106,6 +1161,8 @@ public:
     dealloc();
     size_index = BUFFER_SIZE_NOT_ALLOCATED;
     water_mark = 0;
+    grow_size_index = BUFFER_SIZE_NOT_ALLOCATED;
+    grow_blocks = 0;
   }
 
   void realloc(int64_t i)
@@ -1137,6 +1194,9 @@ public:
   */
   int64_t water_mark;
 
+  int64_t grow_size_index;
+  int grow_blocks;
+
   Ptr<IOBufferBlock> _writer;
   IOBufferReader readers[MAX_MIOBUFFER_READERS];
 
@@ -1317,6 +1377,12 @@ extern IOBufferData *new_constant_IOBufferData_internal(
 #endif
   void *b, int64_t size);
 
+extern IOBufferData *new_file_IOBufferData_internal(
+#ifdef TRACK_BUFFER_USER
+  const char *location,
+#endif
+  int fd, off_t offset, int64_t size);
+
 #ifdef TRACK_BUFFER_USER
 class IOBufferData_tracker
 {
@@ -1341,10 +1407,14 @@ new_xmalloc_IOBufferData_internal(RES_PATH("memory/IOBuffer/"), \
 #define  new_constant_IOBufferData(b, size)                      \
 new_constant_IOBufferData_internal(RES_PATH("memory/IOBuffer/"), \
 				  (b), (size))
+#define  new_file_IOBufferData(fd, offset, size)                 \
+new_file_IOBufferData_internal(RES_PATH("memory/IOBuffer/"),     \
+				  (fd), (offset), (size))
 #else
 #define new_IOBufferData new_IOBufferData_internal
 #define  new_xmalloc_IOBufferData new_xmalloc_IOBufferData_internal
 #define  new_constant_IOBufferData new_constant_IOBufferData_internal
+#define  new_file_IOBufferData new_file_IOBufferData_internal
 #endif
 
 extern int64_t iobuffer_size_to_index(int64_t size, int64_t max = max_iobuffer_size);
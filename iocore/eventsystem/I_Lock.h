@@ -38,6 +38,25 @@ inkcoreapi extern void lock_waiting(const char *file, int line, const char *hand
 inkcoreapi extern void lock_holding(const char *file, int line, const char *handler);
 extern void lock_taken(const char *file, int line, const char *handler);
 
+class ProxyMutex;
+struct LockProfileSite;
+
+/// Set from proxy.config.lock_profile.enabled, counts contention per mutex creation site.
+inkcoreapi extern int lock_profile_enabled;
+inkcoreapi extern LockProfileSite *lock_profile_site(const char *file, int line);
+inkcoreapi extern void lock_profile_contended(ProxyMutex *m, ink_hrtime wait);
+inkcoreapi extern void lock_profile_held(ProxyMutex *m);
+void lock_profile_start();
+
+#define LOCK_PROFILE_TAKEN(_m) do { \
+  if (unlikely(lock_profile_enabled) && (_m)->profile_site) \
+    (_m)->profile_taken = ink_get_hrtime_internal(); \
+} while (0)
+#define LOCK_PROFILE_FAILED(_m) do { \
+  if (unlikely(lock_profile_enabled) && (_m)->profile_site) \
+    lock_profile_contended(_m, 0); \
+} while (0)
+
 /**
   Lock object used in continuations and threads.
 
@@ -88,6 +107,11 @@ public:
   
   int nthread_holding;
 
+  /// Where the mutex was created, NULL if it is not profiled.
+  LockProfileSite *profile_site;
+  /// When the profiled lock was taken, while it is held.
+  ink_hrtime profile_taken;
+
 #ifdef DEBUG
   ink_hrtime hold_time;
   const char *file;
@@ -120,6 +144,8 @@ public:
   {
     thread_holding = NULL;
     nthread_holding = 0;
+    profile_site = NULL;
+    profile_taken = 0;
 #ifdef DEBUG
     hold_time = 0;
     file = NULL;
@@ -169,6 +195,7 @@ Mutex_trylock(
   ink_assert(t == (EThread*)this_thread());
   if (m->thread_holding != t) {
     if (!ink_mutex_try_acquire(&m->the_mutex)) {
+      LOCK_PROFILE_FAILED(m);
 #ifdef DEBUG
       lock_waiting(m->file, m->line, m->handler);
 #ifdef LOCK_CONTENTION_PROFILING
@@ -181,6 +208,7 @@ Mutex_trylock(
       return false;
     }
     ink_assert(m->thread_holding = t);
+    LOCK_PROFILE_TAKEN(m);
 #ifdef DEBUG
     m->file = afile;
     m->line = aline;
@@ -219,6 +247,7 @@ Mutex_trylock_spin(
         break;
     } while (--spincnt);
     if (!locked) {
+      LOCK_PROFILE_FAILED(m);
 #ifdef DEBUG
       lock_waiting(m->file, m->line, m->handler);
 #ifdef LOCK_CONTENTION_PROFILING
@@ -232,6 +261,7 @@ Mutex_trylock_spin(
     }
     m->thread_holding = t;
     ink_assert(m->thread_holding);
+    LOCK_PROFILE_TAKEN(m);
 #ifdef DEBUG
     m->file = afile;
     m->line = aline;
@@ -264,9 +294,17 @@ Mutex_lock(
 
   ink_assert(t != 0);
   if (m->thread_holding != t) {
-    ink_mutex_acquire(&m->the_mutex);
+    if (unlikely(lock_profile_enabled) && m->profile_site) {
+      if (!ink_mutex_try_acquire(&m->the_mutex)) {
+        ink_hrtime start = ink_get_hrtime_internal();
+        ink_mutex_acquire(&m->the_mutex);
+        lock_profile_contended(m, ink_get_hrtime_internal() - start);
+      }
+    } else
+      ink_mutex_acquire(&m->the_mutex);
     m->thread_holding = t;
     ink_assert(m->thread_holding);
+    LOCK_PROFILE_TAKEN(m);
 #ifdef DEBUG
     m->file = afile;
     m->line = aline;
@@ -306,6 +344,8 @@ Mutex_unlock(ProxyMutex * m, EThread * t)
       m->line = 0;
       m->handler = NULL;
 #endif //DEBUG
+      if (m->profile_taken)
+        lock_profile_held(m);
       ink_assert(m->thread_holding);
       m->thread_holding = 0;
       ink_mutex_release(&m->the_mutex);
@@ -446,12 +486,14 @@ ProxyMutex::free()
 
 */
 inline ProxyMutex *
-new_ProxyMutex()
+new_ProxyMutex_at(const char *file, int line)
 {
   ProxyMutex *m = mutexAllocator.alloc();
   m->init();
+  m->profile_site = lock_profile_site(file, line);
   return m;
 }
+#define new_ProxyMutex() new_ProxyMutex_at(__FILE__, __LINE__)
 
 /*------------------------------------------------------*\
 |  Macros                                                |
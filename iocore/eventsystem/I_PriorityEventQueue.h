@@ -26,6 +26,9 @@
 
 #include "libts.h"
 #include "I_Event.h"
+#if TS_USE_TIMER_WHEEL
+#include "TimerWheel.h"
+#endif
 
 
 // <5ms, 10, 20, 40, 80, 160, 320, 640, 1280, 2560, 5120
@@ -34,6 +37,69 @@
 
 class EThread;
 
+#if TS_USE_TIMER_WHEEL
+
+// The events are kept on a timer wheel of PQ_BUCKET_TIME(0) ticks, so
+// neither enqueue(), remove() nor check_ready() depend on how many there
+// are.  Like the lists below, an event may run up to a tick early.
+struct EventWheelLink : public Event::Link_link
+{
+  static ink_hrtime at(Event * e) { return e->timeout_at; }
+  static int slot(Event * e) { return e->in_heap; }
+  static void set_slot(Event * e, int s) { e->in_heap = s; }
+};
+
+struct PriorityEventQueue
+{
+  TimerWheel<Event, EventWheelLink> wheel;
+  Queue<Event, EventWheelLink> ready;
+  ink_hrtime last_check_time;
+
+  void enqueue(Event * e, ink_hrtime now)
+  {
+    e->in_the_priority_queue = 1;
+    if (e->timeout_at <= now)
+      ready.enqueue(e);
+    else
+      wheel.insert(e);
+  }
+
+  void remove(Event * e)
+  {
+    ink_assert(e->in_the_priority_queue);
+    e->in_the_priority_queue = 0;
+    if (e->in_heap == TIMER_WHEEL_NO_SLOT)
+      ready.remove(e);
+    else
+      wheel.remove(e);
+  }
+
+  Event *dequeue_ready(ink_hrtime t)
+  {
+    (void) t;
+    Event *e = ready.dequeue();
+    if (e) {
+      ink_assert(e->in_the_priority_queue);
+      e->in_the_priority_queue = 0;
+    }
+    return e;
+  }
+
+  void check_ready(ink_hrtime now, EThread * t);
+
+  ink_hrtime earliest_timeout()
+  {
+    if (ready.head)
+      return last_check_time;
+    ink_hrtime t = wheel.earliest();
+    return t ? t : last_check_time + HRTIME_FOREVER;
+  }
+
+  PriorityEventQueue();
+};
+
+#else
+
 struct PriorityEventQueue
 {
 
@@ -123,3 +189,5 @@ struct PriorityEventQueue
 };
 
 #endif
+
+#endif
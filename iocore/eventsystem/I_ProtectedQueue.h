@@ -46,11 +46,20 @@ struct ProtectedQueue
   void remove(Event * e);
   Event *dequeue_local();
   void dequeue_timed(ink_hrtime cur_time, ink_hrtime timeout, bool sleep);
+  bool prepare_to_sleep();      // Owner thread only, don't block if false
+  void done_sleeping();
 
   InkAtomicList al;
   ink_mutex lock;
   ink_cond might_have_data;
   Que(Event, link) localQueue;
+  // Set while the owner thread is blocked (or about to block) waiting for
+  // new events.  Inserters only wake the thread when it is set, so signals
+  // to a thread which is already awake are coalesced away.
+  volatile int sleeping;
+  // The owner thread's eventfd, written to wake it and waited on by
+  // dequeue_timed(), or -1 to use might_have_data instead.
+  int wakeup_fd;
 
   ProtectedQueue();
 };
@@ -70,6 +70,7 @@ struct SocketManager
   int64_t writev(int fd, struct iovec *vector, size_t count);
   int64_t write_vector(int fd, struct iovec *vector, size_t count, void *pOLP = 0);
   int64_t pwrite(int fd, void *buf, int len, off_t offset, char *tag = NULL);
+  int64_t sendfile(int out_fd, int in_fd, off_t *offset, int64_t count);
 
   int send(int fd, void *buf, int len, int flags);
   int sendto(int fd, void *buf, int len, int flags, struct sockaddr const* to, int tolen);
@@ -106,6 +107,10 @@ struct SocketManager
 
   // result is the fd or -errno
   int accept(int s, struct sockaddr *addr, socklen_t *addrlen);
+#if HAVE_ACCEPT4
+  // @a flags is applied to the new socket, e.g. SOCK_NONBLOCK | SOCK_CLOEXEC
+  int accept4(int s, struct sockaddr *addr, socklen_t *addrlen, int flags);
+#endif
 
   // manipulate socket buffers
   int get_sndbuf_size(int s);
@@ -137,8 +137,19 @@ public:
   {  }
 };
 
-extern ink_hrtime ink_get_hrtime();
-extern ink_hrtime ink_get_based_hrtime();
+/** Time of the calling thread's current event loop iteration.
+    0 on threads without an event loop.
+*/
+extern __thread ink_hrtime thread_loop_time;
+
+/** The current time.
+    By default this is the time the calling thread's event loop last read
+    the clock, which costs nothing. Threads without an event loop get the
+    time shared by all the loops, which is at most a millisecond behind.
+    With @a precise the clock is read.
+*/
+extern ink_hrtime ink_get_hrtime(bool precise = false);
+extern ink_hrtime ink_get_based_hrtime(bool precise = false);
 extern Thread *this_thread();
 
 #endif /*_I_Thread_h*/
@@ -110,3 +110,172 @@ ProxyMutex::print_lock_stats(int flag)
   }
 }
 #endif //LOCK_CONTENTION_PROFILING
+
+//
+// Lock profiling. Every new_ProxyMutex() call site gets a slot the first
+// time it runs, the counters are only updated while profiling is on.
+//
+#define LOCK_PROFILE_SITES 256  // a power of 2
+#define LOCK_PROFILE_TOP   10
+#define LOCK_PROFILE_STATS 4
+
+struct LockProfileSite
+{
+  const char *file;
+  int line;
+  volatile int64_t acquires;
+  volatile int64_t contended;   // failed try locks and blocking locks which had to wait
+  volatile int64_t wait_time;
+  volatile int64_t hold_time;
+  bool registered;
+};
+
+int lock_profile_enabled = 0;
+static LockProfileSite lock_profile_sites[LOCK_PROFILE_SITES];
+static ink_mutex lock_profile_mutex = PTHREAD_MUTEX_INITIALIZER;
+static RecRawStatBlock *lock_profile_rsb = NULL;
+
+LockProfileSite *
+lock_profile_site(const char *file, int line)
+{
+  // a file name from a header is a different string in each file it is included in
+  unsigned h = line;
+  for (const char *p = file; *p; p++)
+    h = h * 31 + *p;
+
+  for (int i = 0; i < LOCK_PROFILE_SITES; i++) {
+    LockProfileSite *s = &lock_profile_sites[(h + i) & (LOCK_PROFILE_SITES - 1)];
+    if (!s->file) {
+      ink_mutex_acquire(&lock_profile_mutex);
+      if (!s->file) {
+        s->line = line;
+        ink_atomic_swap(&s->file, file);
+      }
+      ink_mutex_release(&lock_profile_mutex);
+    }
+    // the file is published after the line
+    const char *f = s->file;
+    if (f && s->line == line && (f == file || !strcmp(f, file)))
+      return s;
+  }
+  return NULL;
+}
+
+void
+lock_profile_contended(ProxyMutex *m, ink_hrtime wait)
+{
+  ink_atomic_increment(&m->profile_site->contended, 1);
+  if (wait)
+    ink_atomic_increment(&m->profile_site->wait_time, wait);
+}
+
+void
+lock_profile_held(ProxyMutex *m)
+{
+  ink_atomic_increment(&m->profile_site->acquires, 1);
+  ink_atomic_increment(&m->profile_site->hold_time, ink_get_hrtime_internal() - m->profile_taken);
+  m->profile_taken = 0;
+}
+
+static int
+lock_profile_stats_cb(const char * /* name ATS_UNUSED */, RecDataT /* data_type ATS_UNUSED */, RecData *data,
+                      RecRawStatBlock * /* rsb ATS_UNUSED */, int id)
+{
+  LockProfileSite *s = &lock_profile_sites[id / LOCK_PROFILE_STATS];
+
+  switch (id % LOCK_PROFILE_STATS) {
+  case 0:
+    data->rec_int = s->acquires;
+    break;
+  case 1:
+    data->rec_int = s->contended;
+    break;
+  case 2:
+    data->rec_int = s->wait_time / HRTIME_USECOND;
+    break;
+  default:
+    data->rec_int = s->hold_time / HRTIME_USECOND;
+    break;
+  }
+  return 0;
+}
+
+// "../../iocore/cache/Cache.cc" line 12 becomes "Cache_cc_12"
+static void
+lock_profile_site_name(LockProfileSite *s, char *buf, int size)
+{
+  const char *p = strrchr(s->file, '/');
+  int len = 0;
+
+  for (p = p ? p + 1 : s->file; *p && len < size - 1; p++)
+    buf[len++] = ParseRules::is_alnum(*p) ? *p : '_';
+  snprintf(buf + len, size - len, "_%d", s->line);
+}
+
+static int
+lock_profile_site_cmp(const void *a, const void *b)
+{
+  int64_t x = (*(LockProfileSite * const *)a)->contended, y = (*(LockProfileSite * const *)b)->contended;
+  return x < y ? 1 : x > y ? -1 : 0;
+}
+
+struct LockProfileCont: public Continuation
+{
+  int mainEvent(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
+  {
+    static const char *suffix[LOCK_PROFILE_STATS] = { "acquires", "contended", "wait_usec", "hold_usec" };
+    LockProfileSite *sites[LOCK_PROFILE_SITES];
+    int n = 0;
+
+    if (!lock_profile_enabled)
+      return EVENT_CONT;
+
+    for (int i = 0; i < LOCK_PROFILE_SITES; i++) {
+      LockProfileSite *s = &lock_profile_sites[i];
+      if (!s->file)
+        continue;
+      if (!s->registered) {
+        char name[64], stat_name[128];
+        lock_profile_site_name(s, name, sizeof(name));
+        for (int j = 0; j < LOCK_PROFILE_STATS; j++) {
+          snprintf(stat_name, sizeof(stat_name), "proxy.process.lock.%s.%s", name, suffix[j]);
+          RecRegisterRawStat(lock_profile_rsb, RECT_PROCESS, stat_name, RECD_INT, RECP_NON_PERSISTENT,
+                             i * LOCK_PROFILE_STATS + j, lock_profile_stats_cb);
+        }
+        s->registered = true;
+      }
+      if (s->contended)
+        sites[n++] = s;
+    }
+
+    // the most contended sites, for traffic_line -r proxy.process.lock.top
+    char top[LOCK_PROFILE_TOP * 128];
+    int len = 0;
+    top[0] = '\0';
+    qsort(sites, n, sizeof(sites[0]), lock_profile_site_cmp);
+    for (int i = 0; i < n && i < LOCK_PROFILE_TOP; i++) {
+      const char *file = strrchr(sites[i]->file, '/');
+      len += snprintf(top + len, sizeof(top) - len, "%s%s:%d contended %" PRId64 " wait %" PRId64 "ms hold %" PRId64 "ms",
+                      i ? "; " : "", file ? file + 1 : sites[i]->file, sites[i]->line, sites[i]->contended,
+                      (int64_t) (sites[i]->wait_time / HRTIME_MSECOND), (int64_t) (sites[i]->hold_time / HRTIME_MSECOND));
+      if (len >= (int)sizeof(top))
+        break;
+    }
+    RecSetRecordString("proxy.process.lock.top", top);
+    return EVENT_CONT;
+  }
+
+  LockProfileCont(): Continuation(new_ProxyMutex())
+  {
+    SET_HANDLER(&LockProfileCont::mainEvent);
+  }
+};
+
+void
+lock_profile_start()
+{
+  REC_EstablishStaticConfigInt32(lock_profile_enabled, "proxy.config.lock_profile.enabled");
+  lock_profile_rsb = RecAllocateRawStatBlock(LOCK_PROFILE_SITES * LOCK_PROFILE_STATS);
+  RecRegisterStatString(RECT_PROCESS, "proxy.process.lock.top", (RecString) "", RECP_NON_PERSISTENT);
+  eventProcessor.schedule_every(NEW(new LockProfileCont), HRTIME_SECONDS(10), ET_CALL);
+}
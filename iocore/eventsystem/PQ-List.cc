@@ -23,6 +23,24 @@
 
 #include "P_EventSystem.h"
 
+#if TS_USE_TIMER_WHEEL
+
+PriorityEventQueue::PriorityEventQueue()
+{
+  last_check_time = ink_get_based_hrtime_internal();
+  wheel.init(PQ_BUCKET_TIME(0), last_check_time);
+}
+
+void
+PriorityEventQueue::check_ready(ink_hrtime now, EThread * t)
+{
+  (void) t;
+  last_check_time = now;
+  wheel.expire(now, ready);
+}
+
+#else
+
 PriorityEventQueue::PriorityEventQueue()
 {
   last_check_time = ink_get_based_hrtime_internal();
@@ -61,3 +79,5 @@ PriorityEventQueue::check_ready(ink_hrtime now, EThread * t)
     }
   }
 }
+
+#endif
@@ -228,6 +228,24 @@ new_constant_IOBufferData_internal(
                                     b, size, BUFFER_SIZE_INDEX_FOR_CONSTANT_SIZE(size));
 }
 
+TS_INLINE IOBufferData *
+new_file_IOBufferData_internal(
+#ifdef TRACK_BUFFER_USER
+                               const char *location,
+#endif
+                               int fd, off_t offset, int64_t size)
+{
+  IOBufferData *d = new_IOBufferData_internal(
+#ifdef TRACK_BUFFER_USER
+                                               location,
+#endif
+                                               NULL, size, BUFFER_SIZE_INDEX_FOR_CONSTANT_SIZE(size));
+  d->_mem_type = FILE_BACKED;
+  d->_fd = fd;
+  d->_fd_offset = offset;
+  return d;
+}
+
 TS_INLINE IOBufferData *
 new_xmalloc_IOBufferData_internal(
 #ifdef TRACK_BUFFER_USER
@@ -282,13 +300,19 @@ IOBufferData::alloc(int64_t size_index, AllocType type)
     dealloc();
   _size_index = size_index;
   _mem_type = type;
+  _numa_node = 0;
+  if (iobuffer_numa_nodes > 1) {
+    EThread *t = this_ethread();
+    if (t && t->numa_node > 0)
+      _numa_node = t->numa_node;
+  }
 #ifdef TRACK_BUFFER_USER
   iobuffer_mem_inc(_location, size_index);
 #endif
   switch (type) {
   case MEMALIGNED:
     if (BUFFER_SIZE_INDEX_IS_FAST_ALLOCATED(size_index))
-      _data = (char *) ioBufAllocator[size_index].alloc_void();
+      _data = (char *) ioBufNodeAllocator[_numa_node][size_index].alloc_void();
     // coverity[dead_error_condition]
     else if (BUFFER_SIZE_INDEX_IS_XMALLOCED(size_index))
       _data = (char *)ats_memalign(ats_pagesize(), index_to_buffer_size(size_index));
@@ -296,7 +320,7 @@ IOBufferData::alloc(int64_t size_index, AllocType type)
   default:
   case DEFAULT_ALLOC:
     if (BUFFER_SIZE_INDEX_IS_FAST_ALLOCATED(size_index))
-      _data = (char *) ioBufAllocator[size_index].alloc_void();
+      _data = (char *) ioBufNodeAllocator[_numa_node][size_index].alloc_void();
     else if (BUFFER_SIZE_INDEX_IS_XMALLOCED(size_index))
       _data = (char *)ats_malloc(BUFFER_SIZE_FOR_XMALLOC(size_index));
     break;
@@ -315,14 +339,14 @@ IOBufferData::dealloc()
   switch (_mem_type) {
   case MEMALIGNED:
     if (BUFFER_SIZE_INDEX_IS_FAST_ALLOCATED(_size_index))
-      ioBufAllocator[_size_index].free_void(_data);
+      ioBufNodeAllocator[_numa_node][_size_index].free_void(_data);
     else if (BUFFER_SIZE_INDEX_IS_XMALLOCED(_size_index))
       ::free((void *) _data);
     break;
   default:
   case DEFAULT_ALLOC:
     if (BUFFER_SIZE_INDEX_IS_FAST_ALLOCATED(_size_index))
-      ioBufAllocator[_size_index].free_void(_data);
+      ioBufNodeAllocator[_numa_node][_size_index].free_void(_data);
     else if (BUFFER_SIZE_INDEX_IS_XMALLOCED(_size_index))
       ats_free(_data);
     break;
@@ -330,6 +354,7 @@ IOBufferData::dealloc()
   _data = 0;
   _size_index = BUFFER_SIZE_NOT_ALLOCATED;
   _mem_type = NO_ALLOC;
+  _numa_node = 0;
 }
 
 TS_INLINE void
@@ -736,6 +761,8 @@ MIOBuffer::MIOBuffer(void *b, int64_t bufsize, int64_t aWater_mark)
   set(b, bufsize);
   water_mark = aWater_mark;
   size_index = BUFFER_SIZE_NOT_ALLOCATED;
+  grow_size_index = BUFFER_SIZE_NOT_ALLOCATED;
+  grow_blocks = 0;
 #ifdef TRACK_BUFFER_USER
   _location = NULL;
 #endif
@@ -955,9 +982,48 @@ MIOBuffer::append_block(int64_t asize_index)
 TS_INLINE void
 MIOBuffer::add_block()
 {
+  if (_writer && size_index < grow_size_index && BUFFER_SIZE_INDEX_IS_FAST_ALLOCATED(size_index) &&
+      ++grow_blocks >= MIOBUFFER_GROW_BLOCKS) {
+    size_index++;
+    grow_blocks = 0;
+  }
   append_block(size_index);
 }
 
+TS_INLINE void
+MIOBuffer::set_grow_size_index(int64_t asize_index)
+{
+  grow_size_index = asize_index;
+  grow_blocks = 0;
+}
+
+TS_INLINE int64_t
+MIOBuffer::shrink(int64_t asize_index)
+{
+  IOBufferBlock *b = _writer;
+  int64_t bytes = 0;
+
+  for (int j = 0; j < MAX_MIOBUFFER_READERS; j++)
+    if (readers[j].allocated()) {
+      if (readers[j].read_avail())
+        return -1;
+      // an empty reader is at or before the writer
+      if (readers[j].block)
+        b = readers[j].block;
+    }
+  for (; b; b = b->next)
+    bytes += b->block_size();
+  _writer = NULL;
+  for (int j = 0; j < MAX_MIOBUFFER_READERS; j++)
+    if (readers[j].allocated()) {
+      readers[j].block = NULL;
+      readers[j].start_offset = 0;
+    }
+  size_index = asize_index;
+  grow_blocks = 0;
+  return bytes;
+}
+
 TS_INLINE void
 MIOBuffer::check_add_block()
 {
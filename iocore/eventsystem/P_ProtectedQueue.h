@@ -34,7 +34,7 @@
 
 
 TS_INLINE
-ProtectedQueue::ProtectedQueue()
+ProtectedQueue::ProtectedQueue():sleeping(0), wakeup_fd(-1)
 {
   Event e;
   ink_mutex_init(&lock, "ProtectedQueue");
@@ -45,6 +45,13 @@ ProtectedQueue::ProtectedQueue()
 TS_INLINE void
 ProtectedQueue::signal()
 {
+#if HAVE_EVENTFD
+  if (wakeup_fd >= 0) {
+    uint64_t counter = 1;
+    ATS_UNUSED_RETURN(write(wakeup_fd, &counter, sizeof(uint64_t)));
+    return;
+  }
+#endif
   // Need to get the lock before you can signal the thread
   ink_mutex_acquire(&lock);
   ink_cond_signal(&might_have_data);
@@ -54,6 +61,10 @@ ProtectedQueue::signal()
 TS_INLINE int
 ProtectedQueue::try_signal()
 {
+  if (wakeup_fd >= 0) {
+    signal();
+    return 1;
+  }
   // Need to get the lock before you can signal the thread
   if (ink_mutex_try_acquire(&lock)) {
     ink_cond_signal(&might_have_data);
@@ -64,6 +75,25 @@ ProtectedQueue::try_signal()
   }
 }
 
+// The swap is a full barrier, as is the push in enqueue(): either the
+// inserter sees sleeping set and wakes us, or we see its event here.
+TS_INLINE bool
+ProtectedQueue::prepare_to_sleep()
+{
+  ink_atomic_swap(&sleeping, 1);
+  if (!INK_ATOMICLIST_EMPTY(al)) {
+    sleeping = 0;
+    return false;
+  }
+  return true;
+}
+
+TS_INLINE void
+ProtectedQueue::done_sleeping()
+{
+  sleeping = 0;
+}
+
 // Called from the same thread (don't need to signal)
 TS_INLINE void
 ProtectedQueue::enqueue_local(Event * e)
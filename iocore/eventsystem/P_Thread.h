@@ -55,15 +55,30 @@ this_thread()
 }
 
 TS_INLINE ink_hrtime
-ink_get_hrtime()
+ink_get_hrtime(bool precise)
 {
-  return Thread::cur_time;
+  if (precise)
+    return ink_get_based_hrtime_internal();
+  return thread_loop_time ? thread_loop_time : Thread::cur_time;
 }
 
 TS_INLINE ink_hrtime
-ink_get_based_hrtime()
+ink_get_based_hrtime(bool precise)
 {
-  return Thread::cur_time;
+  return ink_get_hrtime(precise);
+}
+
+/** Set the time of the calling thread's event loop iteration.
+    The time shared with threads without an event loop is written at
+    most once a millisecond, rather than by every loop on every
+    iteration.
+*/
+TS_INLINE void
+thread_loop_time_set(ink_hrtime now)
+{
+  thread_loop_time = now;
+  if (now - Thread::cur_time >= HRTIME_MSECOND)
+    Thread::cur_time = now;
 }
 
 #endif //_P_Thread_h_
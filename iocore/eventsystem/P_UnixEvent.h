@@ -49,7 +49,11 @@ Event::Event():
   in_the_priority_queue(false),
   immediate(false),
   globally_allocated(true),
+#if TS_USE_TIMER_WHEEL
+  in_heap(TIMER_WHEEL_NO_SLOT),
+#else
   in_heap(false),
+#endif
   timeout_at(0),
   period(0)
 {
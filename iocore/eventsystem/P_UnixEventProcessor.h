@@ -32,6 +32,9 @@ TS_INLINE
 EventProcessor::EventProcessor():
 n_ethreads(0),
 n_thread_groups(0),
+numa_nodes(1),
+load_balance_threshold(0),
+n_rebalanced(0),
 n_dthreads(0),
 thread_data_used(0)
 {
@@ -64,9 +67,19 @@ EventProcessor::assign_thread(EventType etype)
   int next;
 
   ink_assert(etype < MAX_EVENT_TYPES);
-  if (n_threads_for_type[etype] > 1)
-    next = next_thread_for_type[etype]++ % n_threads_for_type[etype];
-  else
+  if (n_threads_for_type[etype] > 1) {
+    int n = n_threads_for_type[etype];
+    next = next_thread_for_type[etype]++ % n;
+    // look at the thread half way round as well, and take it if the
+    // round robin one is far busier
+    if (load_balance_threshold) {
+      int other = (next + n / 2) % n;
+      if (eventthread[etype][next]->load - eventthread[etype][other]->load > load_balance_threshold) {
+        next = other;
+        ink_atomic_increment(&n_rebalanced, 1);
+      }
+    }
+  } else
     next = 0;
   return (eventthread[etype][next]);
 }
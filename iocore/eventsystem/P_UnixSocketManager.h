@@ -73,6 +73,22 @@ SocketManager::accept(int s, struct sockaddr *addr, socklen_t *addrlen)
   return r;
 }
 
+#if HAVE_ACCEPT4
+TS_INLINE int
+SocketManager::accept4(int s, struct sockaddr *addr, socklen_t *addrlen, int flags)
+{
+  int r;
+  do {
+    r =::accept4(s, addr, addrlen, flags);
+    if (likely(r >= 0))
+      break;
+    r = -errno;
+  } while (transient_error());
+
+  return r;
+}
+#endif
+
 TS_INLINE int
 SocketManager::open(const char *path, int oflag, mode_t mode)
 {
@@ -230,6 +246,26 @@ SocketManager::writev(int fd, struct iovec *vector, size_t count)
   return r;
 }
 
+TS_INLINE int64_t
+SocketManager::sendfile(int out_fd, int in_fd, off_t *offset, int64_t count)
+{
+#ifdef HAVE_SYS_SENDFILE_H
+  int64_t r;
+  do {
+    if (likely((r =::sendfile(out_fd, in_fd, offset, count)) >= 0))
+      break;
+    r = -errno;
+  } while (r == -EINTR);
+  return r;
+#else
+  (void) out_fd;
+  (void) in_fd;
+  (void) offset;
+  (void) count;
+  return -ENOTSUP;
+#endif
+}
+
 TS_INLINE int64_t
 SocketManager::write_vector(int fd, struct iovec *vector, size_t count, void *pOLP)
 {
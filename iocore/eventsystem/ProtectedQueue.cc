@@ -44,6 +44,27 @@
 
 extern ClassAllocator<Event> eventAllocator;
 
+// Wake a thread which is asleep waiting for events. With an eventfd,
+// which every thread blocks on, in its net poll or in dequeue_timed(),
+// only the first inserter to find the thread asleep writes to it and
+// the rest see that a wakeup is on its way. Otherwise the condition
+// variable wakes a thread in dequeue_timed() and the signal hook one
+// in its net poll.
+static inline void
+wake_thread(EThread *t, bool hook)
+{
+  ProtectedQueue &q = t->EventQueueExternal;
+
+  if (q.wakeup_fd >= 0) {
+    if (ink_atomic_cas(&q.sleeping, 1, 0))
+      q.signal();
+    return;
+  }
+  q.signal();
+  if (hook && t->signal_hook)
+    t->signal_hook(t);
+}
+
 void
 ProtectedQueue::enqueue(Event *e , bool fast_signal)
 {
@@ -52,17 +73,15 @@ ProtectedQueue::enqueue(Event *e , bool fast_signal)
   e->in_the_prot_queue = 1;
   bool was_empty = (ink_atomiclist_push(&al, e) == NULL);
 
-  if (was_empty) {
+  // A thread which is not sleeping will find the event before it next
+  // blocks, see prepare_to_sleep(), so only a sleeping one needs a signal.
+  if (was_empty && sleeping) {
     EThread *inserting_thread = this_ethread();
     // queue e->ethread in the list of threads to be signalled
     // inserting_thread == 0 means it is not a regular EThread
     if (inserting_thread != e_ethread) {
       if (!inserting_thread || !inserting_thread->ethreads_to_be_signalled) {
-        signal();
-        if (fast_signal) {
-          if (e_ethread->signal_hook)
-            e_ethread->signal_hook(e_ethread);
-        }
+        wake_thread(e_ethread, fast_signal);
       } else {
 #ifdef EAGER_SIGNALLING
         // Try to signal now and avoid deferred posting.
@@ -70,6 +89,10 @@ ProtectedQueue::enqueue(Event *e , bool fast_signal)
           return;
 #endif
         if (fast_signal) {
+          if (wakeup_fd >= 0) {
+            wake_thread(e_ethread, true);
+            return;
+          }
           if (e_ethread->signal_hook)
             e_ethread->signal_hook(e_ethread);
         }
@@ -120,17 +143,18 @@ flush_signals(EThread * thr)
 #ifdef EAGER_SIGNALLING
   for (i = 0; i < n; i++) {
     // Try to signal as many threads as possible without blocking.
-    if (thr->ethreads_to_be_signalled[i]) {
+    if (thr->ethreads_to_be_signalled[i] && thr->ethreads_to_be_signalled[i]->EventQueueExternal.sleeping) {
       if (thr->ethreads_to_be_signalled[i]->EventQueueExternal.try_signal())
         thr->ethreads_to_be_signalled[i] = 0;
     }
   }
 #endif
   for (i = 0; i < n; i++) {
-    if (thr->ethreads_to_be_signalled[i]) {
-      thr->ethreads_to_be_signalled[i]->EventQueueExternal.signal();
-      if (thr->ethreads_to_be_signalled[i]->signal_hook)
-        thr->ethreads_to_be_signalled[i]->signal_hook(thr->ethreads_to_be_signalled[i]);
+    EThread *t = thr->ethreads_to_be_signalled[i];
+    if (t) {
+      // it may have drained its queue since we deferred the signal
+      if (t->EventQueueExternal.sleeping)
+        wake_thread(t, true);
       thr->ethreads_to_be_signalled[i] = 0;
     }
   }
@@ -143,12 +167,31 @@ ProtectedQueue::dequeue_timed(ink_hrtime cur_time, ink_hrtime timeout, bool slee
   (void) cur_time;
   Event *e;
   if (sleep) {
-    ink_mutex_acquire(&lock);
-    if (INK_ATOMICLIST_EMPTY(al)) {
-      timespec ts = ink_based_hrtime_to_timespec(timeout);
-      ink_cond_timedwait(&might_have_data, &lock, &ts);
+#if HAVE_EVENTFD
+    if (wakeup_fd >= 0) {
+      if (prepare_to_sleep()) {
+        ink_hrtime left = timeout - ink_get_based_hrtime_internal();
+        struct pollfd pfd;
+        pfd.fd = wakeup_fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, left > 0 ? (int) ((left + HRTIME_MSECOND - 1) / HRTIME_MSECOND) : 0) > 0) {
+          uint64_t counter;
+          ATS_UNUSED_RETURN(read(wakeup_fd, &counter, sizeof(uint64_t)));
+        }
+        done_sleeping();
+      }
+    } else
+#endif
+    {
+      ink_mutex_acquire(&lock);
+      if (prepare_to_sleep()) {
+        timespec ts = ink_based_hrtime_to_timespec(timeout);
+        ink_cond_timedwait(&might_have_data, &lock, &ts);
+        done_sleeping();
+      }
+      ink_mutex_release(&lock);
     }
-    ink_mutex_release(&lock);
   }
 
   e = (Event *) ink_atomiclist_popall(&al);
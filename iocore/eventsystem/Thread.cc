@@ -39,6 +39,7 @@ static ink_thread_key init_thread_key();
 ProxyMutex *global_mutex = NULL;
 ink_hrtime
   Thread::cur_time = 0;
+__thread ink_hrtime thread_loop_time = 0;
 inkcoreapi ink_thread_key
   Thread::thread_data_key = init_thread_key();
 
@@ -44,9 +44,11 @@ EThread::EThread()
    ethreads_to_be_signalled(NULL),
    n_ethreads_to_be_signalled(0),
    main_accept_index(-1),
-   id(NO_ETHREAD_ID), event_types(0),
+   id(NO_ETHREAD_ID), event_types(0), numa_node(-1),
+   idle_time(0), load(0), load_events(0), profile(NULL), profile_countdown(0), heartbeat(NULL),
    signal_hook(0),
-   tt(REGULAR), eventsem(NULL)
+   tt(REGULAR), eventsem(NULL),
+   load_start(0), load_idle(0)
 {
   memset(thread_private, 0, PER_THREAD_DATA);
 }
@@ -58,10 +60,19 @@ EThread::EThread(ThreadType att, int anid)
     main_accept_index(-1),
     id(anid),
     event_types(0),
+    numa_node(-1),
+    idle_time(0),
+    load(0),
+    load_events(0),
+    profile(NULL),
+    profile_countdown(0),
+    heartbeat(NULL),
     signal_hook(0),
     tt(att),
     eventsem(NULL),
-    l1_hash(NULL)
+    l1_hash(NULL),
+    load_start(0),
+    load_idle(0)
 {
   ethreads_to_be_signalled = (EThread **)ats_malloc(MAX_EVENT_THREADS * sizeof(EThread *));
   memset((char *) ethreads_to_be_signalled, 0, MAX_EVENT_THREADS * sizeof(EThread *));
@@ -78,6 +89,7 @@ EThread::EThread(ThreadType att, int anid)
   }
   fcntl(evfd, F_SETFD, FD_CLOEXEC);
   fcntl(evfd, F_SETFL, O_NONBLOCK);
+  EventQueueExternal.wakeup_fd = evfd;
 #else
   ink_release_assert(pipe(evpipe) >= 0);
   fcntl(evpipe[0], F_SETFD, FD_CLOEXEC);
@@ -92,9 +104,11 @@ EThread::EThread(ThreadType att, Event * e, ink_sem * sem)
    ethreads_to_be_signalled(NULL),
    n_ethreads_to_be_signalled(0),
    main_accept_index(-1),
-   id(NO_ETHREAD_ID), event_types(0),
+   id(NO_ETHREAD_ID), event_types(0), numa_node(-1),
+   idle_time(0), load(0), load_events(0), profile(NULL), profile_countdown(0), heartbeat(NULL),
    signal_hook(0),
-   tt(att), oneevent(e), eventsem(sem)
+   tt(att), oneevent(e), eventsem(sem),
+   load_start(0), load_idle(0)
 {
   ink_assert(att == DEDICATED);
   memset(thread_private, 0, PER_THREAD_DATA);
@@ -138,7 +152,11 @@ EThread::process_event(Event * e, int calling_code)
       return;
     }
     Continuation *c_temp = e->continuation;
-    e->continuation->handleEvent(calling_code, e);
+    load_events++;
+    {
+      EventProfileScope profile_scope(this, e->continuation);
+      e->continuation->handleEvent(calling_code, e);
+    }
     ink_assert(!e->in_the_priority_queue);
     ink_assert(c_temp == e->continuation);
     MUTEX_RELEASE(lock);
@@ -147,10 +165,10 @@ EThread::process_event(Event * e, int calling_code)
         if (e->period < 0)
           e->timeout_at = e->period;
         else {
-          cur_time = ink_get_based_hrtime();
-          e->timeout_at = cur_time + e->period;
-          if (e->timeout_at < cur_time)
-            e->timeout_at = cur_time;
+          ink_hrtime now = ink_get_based_hrtime();
+          e->timeout_at = now + e->period;
+          if (e->timeout_at < now)
+            e->timeout_at = now;
         }
         EventQueueExternal.enqueue_local(e);
       }
@@ -159,6 +177,23 @@ EThread::process_event(Event * e, int calling_code)
   }
 }
 
+//
+// Work out the busy share of the load interval which just ended from
+// the time the thread spent asleep in it.
+//
+void
+EThread::update_load(ink_hrtime now)
+{
+  ink_hrtime elapsed = now - load_start;
+  ink_hrtime idle = idle_time - load_idle;
+
+  if (idle > elapsed)
+    idle = elapsed;
+  load = (int) ((elapsed - idle) * 1000 / elapsed);
+  load_start = now;
+  load_idle = idle_time;
+}
+
 //
 // void  EThread::execute()
 //
@@ -172,18 +207,30 @@ EThread::process_event(Event * e, int calling_code)
 
 void
 EThread::execute() {
+  if (numa_node >= 0 && !ink_numa_bind_this_thread(numa_node))
+    Warning("unable to bind event thread %d to NUMA node %d", id, numa_node);
+
   switch (tt) {
 
     case REGULAR: {
       Event *e;
       Que(Event, link) NegativeQueue;
       ink_hrtime next_time = 0;
+      ink_hrtime now = 0;
 
+      load_start = ink_get_based_hrtime_internal();
       // give priority to immediate events
       for (;;) {
+        if (heartbeat)
+          ++*heartbeat;
         // execute all the available external events that have
         // already been dequeued
-        cur_time = ink_get_based_hrtime_internal();
+        // the time just after a sleep is still good
+        if (!now)
+          now = ink_get_based_hrtime_internal();
+        thread_loop_time_set(now);
+        if (now - load_start >= HRTIME_SECONDS(LOAD_BALANCE_INTERVAL))
+          update_load(now);
         while ((e = EventQueueExternal.dequeue_local())) {
           if (e->cancelled)
              free_event(e);
@@ -191,7 +238,7 @@ EThread::execute() {
             ink_assert(e->period == 0);
             process_event(e, e->callback_event);
           } else if (e->timeout_at > 0) // INTERVAL
-            EventQueue.enqueue(e, cur_time);
+            EventQueue.enqueue(e, now);
           else { // NEGATIVE
             Event *p = NULL;
             Event *a = NegativeQueue.head;
@@ -209,8 +256,8 @@ EThread::execute() {
         do {
           done_one = false;
           // execute all the eligible internal events
-          EventQueue.check_ready(cur_time, this);
-          while ((e = EventQueue.dequeue_ready(cur_time))) {
+          EventQueue.check_ready(now, this);
+          while ((e = EventQueue.dequeue_ready(now))) {
             ink_assert(e);
             ink_assert(e->timeout_at > 0);
             if (e->cancelled)
@@ -229,7 +276,7 @@ EThread::execute() {
           // queue. If there are no external events available, don't
           // do a cond_timedwait.
           if (!INK_ATOMICLIST_EMPTY(EventQueueExternal.al))
-            EventQueueExternal.dequeue_timed(cur_time, next_time, false);
+            EventQueueExternal.dequeue_timed(now, next_time, false);
           while ((e = EventQueueExternal.dequeue_local())) {
             if (!e->timeout_at)
               process_event(e, e->callback_event);
@@ -256,7 +303,7 @@ EThread::execute() {
                   else
                     NegativeQueue.insert(e, p);
                 } else
-                  EventQueue.enqueue(e, cur_time);
+                  EventQueue.enqueue(e, now);
               }
             }
           }
@@ -264,12 +311,13 @@ EThread::execute() {
           while ((e = NegativeQueue.dequeue()))
             process_event(e, EVENT_POLL);
           if (!INK_ATOMICLIST_EMPTY(EventQueueExternal.al))
-            EventQueueExternal.dequeue_timed(cur_time, next_time, false);
+            EventQueueExternal.dequeue_timed(now, next_time, false);
+          now = 0;
         } else {                // Means there are no negative events
           next_time = EventQueue.earliest_timeout();
-          ink_hrtime sleep_time = next_time - cur_time;
+          ink_hrtime sleep_time = next_time - now;
           if (sleep_time > THREAD_MAX_HEARTBEAT_MSECONDS * HRTIME_MSECOND) {
-            next_time = cur_time + THREAD_MAX_HEARTBEAT_MSECONDS * HRTIME_MSECOND;
+            next_time = now + THREAD_MAX_HEARTBEAT_MSECONDS * HRTIME_MSECOND;
             sleep_time = THREAD_MAX_HEARTBEAT_MSECONDS * HRTIME_MSECOND;
           }
           // dequeue all the external events and put them in a local
@@ -277,7 +325,10 @@ EThread::execute() {
           // cond_timedwait.
           if (n_ethreads_to_be_signalled)
             flush_signals(this);
-          EventQueueExternal.dequeue_timed(cur_time, next_time, true);
+          ink_hrtime sleep_start = ink_get_based_hrtime_internal();
+          EventQueueExternal.dequeue_timed(now, next_time, true);
+          now = ink_get_based_hrtime_internal();
+          idle_time += now - sleep_start;
         }
       }
     }
@@ -113,6 +113,8 @@ EventProcessor::spawn_event_threads(int n_threads, const char* et_name, size_t s
   n_threads_for_type[new_thread_group_id] = n_threads;
   for (i = 0; i < n_threads; i++) {
     snprintf(thr_name, MAX_THREAD_NAME_LENGTH, "[%s %d]", et_name, i);
+    if (numa_nodes > 1)
+      eventthread[new_thread_group_id][i]->numa_node = i % numa_nodes;
     eventthread[new_thread_group_id][i]->start(thr_name, stacksize);
   }
 
@@ -126,6 +128,40 @@ EventProcessor::spawn_event_threads(int n_threads, const char* et_name, size_t s
 
 class EventProcessor eventProcessor;
 
+// two per event thread, then the rebalance and slow event counts
+static int
+thread_load_stats_cb(const char * /* name ATS_UNUSED */, RecDataT /* data_type ATS_UNUSED */, RecData *data,
+                     RecRawStatBlock * /* rsb ATS_UNUSED */, int id)
+{
+  if (id == eventProcessor.n_threads_for_type[ET_CALL] * 2)
+    data->rec_int = eventProcessor.n_rebalanced;
+  else if (id == eventProcessor.n_threads_for_type[ET_CALL] * 2 + 1)
+    data->rec_int = event_profile_slow_total();
+  else if (id & 1)
+    data->rec_int = eventProcessor.eventthread[ET_CALL][id / 2]->load_events;
+  else
+    data->rec_int = eventProcessor.eventthread[ET_CALL][id / 2]->load;
+  return 0;
+}
+
+static void
+register_thread_load_stats(int n_threads)
+{
+  RecRawStatBlock *load_rsb = RecAllocateRawStatBlock(n_threads * 2 + 2);
+  char stat_name[128];
+
+  for (int i = 0; i < n_threads; i++) {
+    snprintf(stat_name, sizeof(stat_name), "proxy.process.exec_thread.%d.load", i);
+    RecRegisterRawStat(load_rsb, RECT_PROCESS, stat_name, RECD_INT, RECP_NON_PERSISTENT, i * 2, thread_load_stats_cb);
+    snprintf(stat_name, sizeof(stat_name), "proxy.process.exec_thread.%d.events", i);
+    RecRegisterRawStat(load_rsb, RECT_PROCESS, stat_name, RECD_INT, RECP_NON_PERSISTENT, i * 2 + 1, thread_load_stats_cb);
+  }
+  RecRegisterRawStat(load_rsb, RECT_PROCESS, "proxy.process.exec_thread.rebalanced",
+                     RECD_INT, RECP_NON_PERSISTENT, n_threads * 2, thread_load_stats_cb);
+  RecRegisterRawStat(load_rsb, RECT_PROCESS, "proxy.process.exec_thread.slow_events",
+                     RECD_INT, RECP_NON_PERSISTENT, n_threads * 2 + 1, thread_load_stats_cb);
+}
+
 int
 EventProcessor::start(int n_event_threads, size_t stacksize)
 {
@@ -156,6 +192,8 @@ EventProcessor::start(int n_event_threads, size_t stacksize)
     t->set_event_type((EventType) ET_CALL);
   }
   n_threads_for_type[ET_CALL] = n_event_threads;
+  REC_EstablishStaticConfigInt32(load_balance_threshold, "proxy.config.exec_thread.load_balance_threshold");
+  register_thread_load_stats(n_event_threads);
 
 #if TS_USE_HWLOC
   int affinity = 0;
@@ -170,16 +208,22 @@ EventProcessor::start(int n_event_threads, size_t stacksize)
   pu = hwloc_get_nbobjs_by_type(ink_get_topology(), HWLOC_OBJ_PU);
 #endif
 
-  Debug("iocore_thread", "socket: %d core: %d logical processor: %d affinity: %d", socket, cu, pu, affinity);
+  Debug("iocore_thread", "socket: %d core: %d logical processor: %d numa node: %d affinity: %d",
+        socket, cu, pu, numa_nodes, affinity);
 #endif
 
   for (i = first_thread; i < n_ethreads; i++) {
     snprintf(thr_name, MAX_THREAD_NAME_LENGTH, "[ET_NET %d]", i);
+    // a thread bound to a node binds itself when it starts
+    if (numa_nodes > 1) {
+      all_ethreads[i]->numa_node = (i - 1) % numa_nodes;
+      Debug("iocore_thread", "net thread: %d numa node: %d", i, all_ethreads[i]->numa_node);
+    }
     ink_thread tid = all_ethreads[i]->start(thr_name, stacksize);
     (void)tid;
 
 #if TS_USE_HWLOC
-    if (affinity != 0) {
+    if (affinity != 0 && affinity != 4) {
       int logical_ratio;
       switch(affinity) {
       case 3:           // assign threads to logical cores
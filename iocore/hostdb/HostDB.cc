@@ -38,10 +38,12 @@
 //#define Note
 
 #include "ink_apidefs.h"
+#include "ts/TestBox.h"
 
 HostDBProcessor hostDBProcessor;
 int HostDBProcessor::hostdb_strict_round_robin = 0;
 int HostDBProcessor::hostdb_timed_round_robin = 0;
+int HostDBProcessor::hostdb_rtt_round_robin = 0;
 HostDBProcessor::Options const HostDBProcessor::DEFAULT_OPTIONS;
 HostDBContinuation::Options const HostDBContinuation::DEFAULT_OPTIONS;
 int hostdb_enable = true;
@@ -57,11 +59,14 @@ unsigned int hostdb_ip_stale_interval = HOST_DB_IP_STALE;
 unsigned int hostdb_ip_timeout_interval = HOST_DB_IP_TIMEOUT;
 unsigned int hostdb_ip_fail_timeout_interval = HOST_DB_IP_FAIL_TIMEOUT;
 unsigned int hostdb_serve_stale_but_revalidate = 0;
+unsigned int hostdb_ip_refresh_percent = 0;
 char hostdb_filename[PATH_NAME_MAX + 1] = DEFAULT_HOST_DB_FILENAME;
 int hostdb_size = DEFAULT_HOST_DB_SIZE;
 int hostdb_sync_frequency = 120;
 int hostdb_srv_enabled = 0;
 int hostdb_disable_reverse_lookup = 0;
+int hostdb_hit_table_size = 8192;
+HostDBHitTable *volatile hostdb_hit_table = NULL;
 
 ClassAllocator<HostDBContinuation> hostDBContAllocator("hostDBContAllocator");
 
@@ -203,6 +208,134 @@ HostDBCache::HostDBCache()
 }
 
 
+HostDBHitTable::HostDBHitTable(int entries)
+{
+  int64_t n = HOSTDB_HIT_TABLE_PROBE;
+  while (n < entries)
+    n <<= 1;
+  slots = (HostDBHitSlot *) ats_memalign(sizeof(HostDBHitSlot), n * sizeof(HostDBHitSlot));
+  memset(slots, 0, n * sizeof(HostDBHitSlot));
+  mask = n - 1;
+}
+
+
+HostDBHitTable::~HostDBHitTable()
+{
+  ats_memalign_free(slots);
+}
+
+
+bool
+HostDBHitTable::get(INK_MD5 const& md5, HostDBInfo *info)
+{
+  for (int i = 0; i < HOSTDB_HIT_TABLE_PROBE; i++) {
+    HostDBHitSlot *s = &slots[(md5[0] + i) & mask];
+    uint32_t seq = s->seq;
+    if (seq & 1)
+      continue;
+    __sync_synchronize();
+    if (s->md5[0] != md5[0] || s->md5[1] != md5[1])
+      continue;
+    *info = s->info;
+    __sync_synchronize();
+    // a writer got in while we were copying, let the caller take the lock
+    return s->seq == seq;
+  }
+  return false;
+}
+
+
+// Called with the bucket lock of md5 held, so there is one writer per key.
+void
+HostDBHitTable::put(INK_MD5 const& md5, HostDBInfo const* info)
+{
+  HostDBHitSlot *s = NULL;
+  for (int i = 0; i < HOSTDB_HIT_TABLE_PROBE; i++) {
+    HostDBHitSlot *x = &slots[(md5[0] + i) & mask];
+    if (x->md5[0] == md5[0] && x->md5[1] == md5[1]) {
+      s = x;
+      break;
+    }
+    if (!s && !x->md5[0] && !x->md5[1])
+      s = x;
+  }
+  if (!s)
+    s = &slots[(md5[0] + (md5[1] & (HOSTDB_HIT_TABLE_PROBE - 1))) & mask];
+  uint32_t seq = s->seq;
+  // someone else is writing this slot, skip it rather than wait
+  if ((seq & 1) || !ink_atomic_cas(&s->seq, seq, seq + 1))
+    return;
+  s->md5[0] = md5[0];
+  s->md5[1] = md5[1];
+  s->info = *info;
+  __sync_synchronize();
+  s->seq = seq + 2;
+}
+
+
+void
+HostDBHitTable::remove(INK_MD5 const& md5)
+{
+  for (int i = 0; i < HOSTDB_HIT_TABLE_PROBE; i++) {
+    HostDBHitSlot *s = &slots[(md5[0] + i) & mask];
+    uint32_t seq = s->seq;
+    // an odd slot is being overwritten with another key
+    if (s->md5[0] != md5[0] || s->md5[1] != md5[1] || (seq & 1) || !ink_atomic_cas(&s->seq, seq, seq + 1))
+      continue;
+    s->md5[0] = 0;
+    s->md5[1] = 0;
+    __sync_synchronize();
+    s->seq = seq + 2;
+  }
+}
+
+
+// Lookups hold the table for the few instructions it takes to copy a
+// slot, so a replaced table is freed well after no one can see it.
+//
+#define HOSTDB_HIT_TABLE_FREE_DELAY HRTIME_SECONDS(60)
+
+struct HostDBHitTableFree: public Continuation
+{
+  HostDBHitTable *table;
+
+  int
+  dieEvent(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
+  {
+    delete table;
+    delete this;
+    return EVENT_DONE;
+  }
+
+  HostDBHitTableFree(HostDBHitTable *t): Continuation(NULL), table(t)
+  {
+    SET_HANDLER(&HostDBHitTableFree::dieEvent);
+  }
+};
+
+
+static void
+hostdb_hit_table_resize(int entries)
+{
+  HostDBHitTable *t = entries > 0 ? NEW(new HostDBHitTable(entries)) : NULL;
+  HostDBHitTable *old = ink_atomic_swap(&hostdb_hit_table, t);
+
+  Debug("hostdb", "hit table resized to %d entries", entries);
+  if (old)
+    eventProcessor.schedule_in(NEW(new HostDBHitTableFree(old)), HOSTDB_HIT_TABLE_FREE_DELAY, ET_CALL);
+}
+
+
+static int
+hostdb_hit_table_size_update(const char * /* name ATS_UNUSED */, RecDataT /* data_type ATS_UNUSED */, RecData data,
+                             void * /* cookie ATS_UNUSED */)
+{
+  hostdb_hit_table_size = (int) data.rec_int;
+  hostdb_hit_table_resize(hostdb_hit_table_size);
+  return 0;
+}
+
+
 int
 HostDBCache::rebuild_callout(HostDBInfo * e, RebuildMC & r)
 {
@@ -471,6 +604,7 @@ HostDBProcessor::start(int, size_t)
   REC_EstablishStaticConfigInt32(hostdb_migrate_on_demand, "proxy.config.hostdb.migrate_on_demand");
   REC_EstablishStaticConfigInt32(hostdb_strict_round_robin, "proxy.config.hostdb.strict_round_robin");
   REC_EstablishStaticConfigInt32(hostdb_timed_round_robin, "proxy.config.hostdb.timed_round_robin");
+  REC_EstablishStaticConfigInt32(hostdb_rtt_round_robin, "proxy.config.hostdb.rtt_round_robin");
   REC_EstablishStaticConfigInt32(hostdb_cluster, "proxy.config.hostdb.cluster");
   REC_EstablishStaticConfigInt32(hostdb_cluster_round_robin, "proxy.config.hostdb.cluster.round_robin");
   REC_EstablishStaticConfigInt32(hostdb_lookup_timeout, "proxy.config.hostdb.lookup_timeout");
@@ -478,7 +612,11 @@ HostDBProcessor::start(int, size_t)
   REC_EstablishStaticConfigInt32U(hostdb_ip_stale_interval, "proxy.config.hostdb.verify_after");
   REC_EstablishStaticConfigInt32U(hostdb_ip_fail_timeout_interval, "proxy.config.hostdb.fail.timeout");
   REC_EstablishStaticConfigInt32U(hostdb_serve_stale_but_revalidate, "proxy.config.hostdb.serve_stale_for");
+  REC_EstablishStaticConfigInt32U(hostdb_ip_refresh_percent, "proxy.config.hostdb.refresh_percent");
   REC_EstablishStaticConfigInt32(hostdb_sync_frequency, "proxy.config.cache.hostdb.sync_frequency");
+  REC_ReadConfigInteger(hostdb_hit_table_size, "proxy.config.hostdb.hit_table.size");
+  REC_RegisterConfigUpdateFunc("proxy.config.hostdb.hit_table.size", hostdb_hit_table_size_update, NULL);
+  hostdb_hit_table_resize(hostdb_hit_table_size);
 
   //
   // Set up hostdb_current_interval
@@ -540,17 +678,17 @@ HostDBContinuation::refresh_MD5() {
 void
 make_md5(INK_MD5 & md5, const char *hostname, int len, int port, char const* pDNSServers, HostDBMark mark)
 {
-  INK_DIGEST_CTX ctx;
-  ink_code_incr_md5_init(&ctx);
-  ink_code_incr_md5_update(&ctx, hostname, len);
+  INK_KEY_CTX ctx;
+  ink_code_incr_key_init(&ctx);
+  ink_code_incr_key_update(&ctx, hostname, len);
   unsigned short p = port;
   p = htons(p);
-  ink_code_incr_md5_update(&ctx, (char *) &p, 2);
+  ink_code_incr_key_update(&ctx, (char *) &p, 2);
   uint8_t m = static_cast<uint8_t>(mark);
-  ink_code_incr_md5_update(&ctx, (char *) &m, sizeof(m));     /* FIXME: check this */
+  ink_code_incr_key_update(&ctx, (char *) &m, sizeof(m));     /* FIXME: check this */
   if (pDNSServers)
-    ink_code_incr_md5_update(&ctx, pDNSServers, strlen(pDNSServers));
-  ink_code_incr_md5_final((char *) &md5, &ctx);
+    ink_code_incr_key_update(&ctx, pDNSServers, strlen(pDNSServers));
+  ink_code_incr_key_final((char *) &md5, &ctx);
 }
 
 static bool
@@ -676,6 +814,7 @@ probe(ProxyMutex *mutex, HostDBMD5 const& md5, bool ignore_timeout)
               r->ip_timestamp, r->ip_timeout_interval);
         r->refresh_ip();
         if (!is_dotted_form_hostname(md5.host_name)) {
+          HOSTDB_INCREMENT_DYN_STAT(hostdb_refresh_stat);
           HostDBContinuation *c = hostDBContAllocator.alloc();
           HostDBContinuation::Options copt;
           copt.host_res_style = host_res_style_for(r->ip());
@@ -705,6 +844,7 @@ HostDBContinuation::insert(unsigned int attl)
   int bucket = folded_md5 % hostDB.buckets;
 
   ink_assert(this_ethread() == hostDB.lock_for_bucket(bucket)->thread_holding);
+  hostdb_hit_table_remove(md5.hash);
   // remove the old one to prevent buildup
   HostDBInfo *old_r = hostDB.lookup_block(folded_md5, 3);
   if (old_r)
@@ -970,6 +1110,16 @@ HostDBProcessor::getbyname_imm(Continuation * cont, process_hostdb_info_pfn proc
 
   // Attempt to find the result in-line, for level 1 hits
   if (!force_dns) {
+    HostDBHitTable *table = hostdb_hit_table;
+    HostDBInfo hit;
+    if (table && table->get(md5.hash, &hit) && !hit.is_ip_timeout() && !hit.is_ip_stale()) {
+      Debug("hostdb", "immediate answer for %.*s from the hit table", md5.host_len, md5.host_name);
+      HOSTDB_INCREMENT_DYN_STAT(hostdb_total_hits_stat);
+      HOSTDB_INCREMENT_DYN_STAT(hostdb_hit_table_hits_stat);
+      (cont->*process_hostdb_info) (&hit);
+      return ACTION_RESULT_DONE;
+    }
+
     bool loop;
     do {
       loop = false; // loop only on explicit set for retry
@@ -987,6 +1137,11 @@ HostDBProcessor::getbyname_imm(Continuation * cont, process_hostdb_info_pfn proc
             // No retry -> final result. Return it.
             Debug("hostdb", "immediate answer for %.*s", md5.host_len, md5.host_name);
             HOSTDB_INCREMENT_DYN_STAT(hostdb_total_hits_stat);
+            // only plain addresses are copied, the others point into the MultiCache heap
+            table = hostdb_hit_table;
+            if (table && !r->failed() && !r->round_robin && !r->reverse_dns && !r->is_srv &&
+                !r->is_ip_timeout() && !r->is_ip_stale())
+              table->put(md5.hash, r);
             (cont->*process_hostdb_info) (r);
             return ACTION_RESULT_DONE;
           }
@@ -1074,8 +1229,10 @@ HostDBProcessor::setby(const char *hostname, int len, sockaddr const* ip, HostDB
 
   if (lock) {
     HostDBInfo *r = probe(mutex, md5, false);
-    if (r)
+    if (r) {
+      hostdb_hit_table_remove(md5.hash);
       do_setby(r, app, hostname, md5.ip);
+    }
     return;
   }
   // Create a continuation to do a deaper probe in the background
@@ -1117,8 +1274,10 @@ HostDBContinuation::setbyEvent(int /* event ATS_UNUSED */, Event * /* e ATS_UNUS
 {
   HostDBInfo *r = probe(mutex, md5, false);
 
-  if (r)
+  if (r) {
+    hostdb_hit_table_remove(md5.hash);
     do_setby(r, &app, md5.host_name, md5.ip, is_srv());
+  }
 
   hostdb_cont_free(this);
   return EVENT_DONE;
@@ -2509,8 +2668,52 @@ ink_hostdb_init(ModuleVersion v)
                      "proxy.process.hostdb.re_dns_on_reload",
                      RECD_INT, RECP_NULL, (int) hostdb_re_dns_on_reload_stat, RecRawStatSyncSum);
 
+  RecRegisterRawStat(hostdb_rsb, RECT_PROCESS,
+                     "proxy.process.hostdb.refreshes",
+                     RECD_INT, RECP_NULL, (int) hostdb_refresh_stat, RecRawStatSyncSum);
+
+  RecRegisterRawStat(hostdb_rsb, RECT_PROCESS,
+                     "proxy.process.hostdb.hit_table_hits",
+                     RECD_INT, RECP_NULL, (int) hostdb_hit_table_hits_stat, RecRawStatSyncSum);
+
   RecRegisterRawStat(hostdb_rsb, RECT_PROCESS,
                      "proxy.process.hostdb.bytes", RECD_INT, RECP_NULL, (int) hostdb_bytes_stat, RecRawStatSyncCount);
 
   ts_host_res_global_init();
 }
+
+#if TS_HAS_TESTS
+
+REGRESSION_TEST(HostDBHitTable)(RegressionTest * t, int /* atype ATS_UNUSED */, int * pstatus)
+{
+  TestBox box(t, pstatus);
+  HostDBHitTable table(16);
+  HostDBInfo a, b;
+
+  box = REGRESSION_TEST_PASSED;
+
+  memset(&a, 0, sizeof(a));
+  ats_ip4_set(a.ip(), htonl(0x0a000001));
+  a.ip_timeout_interval = 300;
+
+  INK_MD5 k1(1, 100), k2(1, 200);
+  box.check(!table.get(k1, &b), "empty table hit");
+  table.put(k1, &a);
+  box.check(table.get(k1, &b) && b.ip_timeout_interval == 300, "put record not found");
+  box.check(!table.get(k2, &b), "hit on a different key");
+
+  // records sharing a home slot spill over the probe window
+  for (uint64_t i = 0; i < HOSTDB_HIT_TABLE_PROBE; i++) {
+    INK_MD5 k(1, 300 + i);
+    a.ip_timeout_interval = 400 + i;
+    table.put(k, &a);
+  }
+  INK_MD5 last(1, 300 + HOSTDB_HIT_TABLE_PROBE - 1);
+  box.check(table.get(last, &b) && b.ip_timeout_interval == 400 + HOSTDB_HIT_TABLE_PROBE - 1, "newest record evicted");
+
+  table.remove(last);
+  box.check(!table.get(last, &b), "removed record found");
+  box.check(table.slots[0].seq % 2 == 0 && table.slots[1].seq % 2 == 0, "slot left locked");
+}
+
+#endif // TS_HAS_TESTS
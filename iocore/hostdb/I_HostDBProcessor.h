@@ -58,6 +58,7 @@ extern unsigned int hostdb_ip_stale_interval;
 extern unsigned int hostdb_ip_timeout_interval;
 extern unsigned int hostdb_ip_fail_timeout_interval;
 extern unsigned int hostdb_serve_stale_but_revalidate;
+extern unsigned int hostdb_ip_refresh_percent;
 
 
 static inline unsigned int
@@ -110,6 +111,10 @@ union HostDBApplicationInfo
   //                      we tried the server & failed    //
   // fail_count         - Number of times we tried and    //
   //                       and failed to contact the host //
+  // connect_rtt        - smoothed time from connecting   //
+  //                      to the first response byte, see //
+  //                      hostdb_connect_rtt_update()     //
+  //                      0 - not measured yet            //
   //////////////////////////////////////////////////////////
   struct http_server_attr
   {
@@ -117,7 +122,7 @@ union HostDBApplicationInfo
     unsigned int pipeline_max:7;
     unsigned int keepalive_timeout:6;
     unsigned int fail_count:8;
-    unsigned int unused1:8;
+    unsigned int connect_rtt:8;
     unsigned int last_failure:32;
   } http_data;
 
@@ -135,6 +140,43 @@ union HostDBApplicationInfo
   } rr;
 };
 
+/** Encodes a connect time for http_data.connect_rtt, 12 steps per
+    doubling from 1us (code 1) up to about 2 seconds (code 255). */
+inline unsigned int
+hostdb_connect_rtt_encode(ink_hrtime t)
+{
+  // 1024 * 2^(k/12)
+  static const unsigned int steps[12] = { 1024, 1085, 1149, 1218, 1290, 1367, 1448, 1534, 1625, 1722, 1825, 1933 };
+  uint64_t usec = t / HRTIME_USECOND;
+  int e = 0;
+  int k = 0;
+
+  if (usec <= 1)
+    return 1;
+  while ((usec >> e) > 1)
+    e++;
+
+  // usec is 2^e * m / 1024
+  uint64_t m = e >= 10 ? usec >> (e - 10) : usec << (10 - e);
+
+  while (k < 11 && m >= steps[k + 1])
+    k++;
+  return 1 + 12 * e + k > 255 ? 255 : 1 + 12 * e + k;
+}
+
+/** Moves a connect_rtt a quarter of the way to @a sample, which being in
+    the log domain keeps an odd slow connect from swinging it much. */
+inline unsigned int
+hostdb_connect_rtt_update(unsigned int rtt, ink_hrtime sample)
+{
+  int code = hostdb_connect_rtt_encode(sample);
+  int diff = code - (int) rtt;
+
+  if (rtt == 0)
+    return code;
+  return rtt + (diff + (diff > 0 ? 2 : -2)) / 4;
+}
+
 struct HostDBRoundRobin;
 
 struct SRVInfo
@@ -180,6 +222,10 @@ struct HostDBInfo
   }
 
   bool is_ip_stale() {
+    // refresh a hit entry once less than refresh_percent of its TTL is left
+    if (hostdb_ip_refresh_percent && ip_timeout_interval > 1 &&
+        (uint64_t) ip_interval() * 100 >= (uint64_t) ip_timeout_interval * (100 - hostdb_ip_refresh_percent))
+      return true;
     if (ip_timeout_interval >= 2 * hostdb_ip_stale_interval)
       return ip_interval() >= hostdb_ip_stale_interval;
     else
@@ -454,6 +500,7 @@ struct HostDBProcessor: public Processor
   /** Configuration. */
   static int hostdb_strict_round_robin;
   static int hostdb_timed_round_robin;
+  static int hostdb_rtt_round_robin;
 
   // Processor Interface
   /* hostdb does not use any dedicated event threads
@@ -48,6 +48,7 @@ MultiCacheBase::MultiCacheBase()
   filename[0] = 0;
   memset(hit_stat, 0, sizeof(hit_stat));
   memset(unsunk, 0, sizeof(unsunk));
+  memset(unverified, 0, sizeof(unverified));
   for (int i = 0; i < MULTI_CACHE_PARTITIONS; i++)
     unsunk[i].mc = this;
 }
@@ -74,6 +75,7 @@ MultiCacheHeader::MultiCacheHeader()
   memset(level_offset, 0, sizeof(level_offset));
   memset(bucketsize, 0, sizeof(bucketsize));
   memset(elements, 0, sizeof(elements));
+  memset(partition_checksum, 0, sizeof(partition_checksum));
   heap_used[0] = 8;
   heap_used[1] = 8;
   version.ink_major = MULTI_CACHE_MAJOR_VERSION;
@@ -674,9 +676,14 @@ MultiCacheBase::open(Store *s, const char *config_filename, char *db_filename, i
         *(MultiCacheHeader *) this = *mapped_header;
         ink_assert(store_verify(store));
 
-        if (fix)
+        if (fix) {
           if (check(config_filename, true) < 0)
             goto LfailFix;
+        } else {
+          // checked as they are first used rather than all now
+          for (int p = 0; p < MULTI_CACHE_PARTITIONS; p++)
+            unverified[p] = true;
+        }
       }
     }
   }
@@ -948,12 +955,32 @@ MultiCacheBase::sync_heap(int part)
 // and insert into the lower levels,
 // start with the higher levels to reduce the risk of duplicates.
 //
+uint64_t
+MultiCacheBase::checksum_partition(int partition)
+{
+  int b = first_bucket_of_partition(partition);
+  int n = buckets_of_partition(partition);
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (int l = 0; l < levels; l++) {
+    char *p = data + level_offset[l] + b * bucketsize[l];
+    char *e = p + n * bucketsize[l];
+    for (; p + sizeof(uint64_t) <= e; p += sizeof(uint64_t))
+      h = (h ^ *(uint64_t *) p) * 0x100000001b3ULL;
+    for (; p < e; p++)
+      h = (h ^ (unsigned char) *p) * 0x100000001b3ULL;
+  }
+  return h;
+}
+
 int
 MultiCacheBase::sync_partition(int partition)
 {
   int res = 0;
   int b = first_bucket_of_partition(partition);
   int n = buckets_of_partition(partition);
+
+  verify(partition);
+  uint64_t checksum = checksum_partition(partition);
   // L3
   if (levels > 2) {
     if (ats_msync(data + level_offset[2] + b * bucketsize[2], n * bucketsize[2], data + totalsize, MS_SYNC) < 0)
@@ -967,6 +994,13 @@ MultiCacheBase::sync_partition(int partition)
   // L1
   if (ats_msync(data + b * bucketsize[0], n * bucketsize[0], data + totalsize, MS_SYNC) < 0)
     res = -1;
+  // only claim what is on disk
+  if (!res) {
+    partition_checksum[partition] = checksum;
+    mapped_header->partition_checksum[partition] = checksum;
+    if (ats_msync((char *) mapped_header, STORE_BLOCK_SIZE, (char *) mapped_header + STORE_BLOCK_SIZE, MS_SYNC) < 0)
+      res = -1;
+  }
   return res;
 }
 
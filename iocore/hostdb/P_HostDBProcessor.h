@@ -111,8 +111,8 @@ inline unsigned int HOSTDB_CLIENT_IP_HASH(
 
 // Bump this any time hostdb format is changed
 #define HOST_DB_CACHE_MAJOR_VERSION         3
-#define HOST_DB_CACHE_MINOR_VERSION         0
-// 2.2: IP family split 2.1 : IPv6
+#define HOST_DB_CACHE_MINOR_VERSION         1
+// 3.1: per partition checksums 2.2: IP family split 2.1 : IPv6
 
 #define DEFAULT_HOST_DB_FILENAME             "host.db"
 #define DEFAULT_HOST_DB_SIZE                 (1<<14)
@@ -157,6 +157,8 @@ enum HostDB_Stats
   hostdb_ttl_stat,              // D average TTL
   hostdb_ttl_expires_stat,      // D == TTL Expires
   hostdb_re_dns_on_reload_stat,
+  hostdb_refresh_stat,          // background re-resolutions of hit entries
+  hostdb_hit_table_hits_stat,   // hits answered without a bucket lock
   hostdb_bytes_stat,
   HostDB_Stat_Count
 };
@@ -215,6 +217,49 @@ struct HostDBCache: public MultiCache<HostDBInfo>
   HostDBCache();
 };
 
+//
+// HostDBHitTable (Private)
+//
+// Copies of recently hit single address records, kept in front of the
+// MultiCache so that immediate lookups do not take a bucket lock.  A
+// reader takes no lock at all: each slot has a sequence number which is
+// odd while the slot is being written, and the reader discards its copy
+// if the number changed while it was reading.  Writers hold the bucket
+// lock of the record, and claim a slot by moving its number from even
+// to odd.  Anything the table misses goes to the MultiCache as before.
+//
+#define HOSTDB_HIT_TABLE_PROBE  4
+
+struct HostDBHitSlot
+{
+  volatile uint32_t seq;
+  uint64_t md5[2];
+  HostDBInfo info;
+} __attribute__ ((aligned(64)));
+
+struct HostDBHitTable
+{
+  HostDBHitSlot *slots;
+  uint64_t mask;
+
+  bool get(INK_MD5 const& md5, HostDBInfo *info);
+  void put(INK_MD5 const& md5, HostDBInfo const* info);
+  void remove(INK_MD5 const& md5);
+
+  HostDBHitTable(int entries);
+  ~HostDBHitTable();
+};
+
+extern HostDBHitTable *volatile hostdb_hit_table;
+
+inline void
+hostdb_hit_table_remove(INK_MD5 const& md5)
+{
+  HostDBHitTable *t = hostdb_hit_table;
+  if (t)
+    t->remove(md5);
+}
+
 inline int
 HostDBRoundRobin::index_of(sockaddr const* ip) {
   bool bad = (rrcount <= 0 || rrcount > HOST_DB_MAX_ROUND_ROBIN_INFO || good <= 0 || good > HOST_DB_MAX_ROUND_ROBIN_INFO);
@@ -292,6 +337,43 @@ HostDBRoundRobin::select_best_http(sockaddr const* client_ip, ink_time_t now, in
     }
     best_up = current % good;
     Debug("hostdb", "Using %d for best_up", best_up);
+  } else if (HostDBProcessor::hostdb_rtt_round_robin > 0) {
+    // Pick by connect_rtt among the entries marked up. Entries not
+    //  measured yet have a connect_rtt of 0, so they get tried first.
+    int up[HOST_DB_MAX_ROUND_ROBIN_INFO];
+    int n_up = 0;
+
+    for (int i = 0; i < good; i++) {
+      if (info[i].app.http_data.last_failure == 0 ||
+          (unsigned int) (now - fail_window) > info[i].app.http_data.last_failure) {
+        up[n_up++] = i;
+      }
+    }
+    best_any = current % good;
+    if (n_up == 1) {
+      best_up = up[0];
+    } else if (n_up > 1 && HostDBProcessor::hostdb_rtt_round_robin == 1) {
+      Debug("hostdb", "Using lowest connect RTT round-robin for HTTP");
+      // Start from a rotating position, so ties are shared out
+      int start = current++ % n_up;
+
+      for (int k = 0; k < n_up; k++) {
+        int i = up[(start + k) % n_up];
+
+        if (best_up < 0 || info[i].app.http_data.connect_rtt < info[best_up].app.http_data.connect_rtt)
+          best_up = i;
+      }
+    } else if (n_up > 1) {
+      Debug("hostdb", "Using power of two choices connect RTT round-robin for HTTP");
+      // The better of two random entries, which leans towards the nearer
+      //  addresses without sending everything to the nearest one
+      InkRand &generator = this_ethread()->generator;
+      int a = generator.random() % n_up;
+      int b = (a + 1 + generator.random() % (n_up - 1)) % n_up;
+
+      best_up = info[up[a]].app.http_data.connect_rtt <= info[up[b]].app.http_data.connect_rtt ? up[a] : up[b];
+    }
+    Debug("hostdb", "Using %d for best_up", best_up);
   } else {
     Debug("hostdb", "Using default round robin");
     unsigned int best_hash_any = 0;
@@ -55,8 +55,9 @@
 // Update these if there is a change to MultiCacheBase
 // There is a separate HOST_DB_CACHE_[MAJOR|MINOR]_VERSION
 #define MULTI_CACHE_MAJOR_VERSION    2
-#define MULTI_CACHE_MINOR_VERSION    1
+#define MULTI_CACHE_MINOR_VERSION    2
 // 2.1 - IPv6 compatible
+// 2.2 - per partition checksums
 
 #define MULTI_CACHE_HEAP_HIGH_WATER  0.8
 
@@ -142,6 +143,9 @@ struct MultiCacheHeader
   volatile int heap_halfspace;
   volatile int heap_used[2];
 
+  // of each partition's elements when it was last synced
+  uint64_t partition_checksum[MULTI_CACHE_PARTITIONS];
+
     MultiCacheHeader();
 };
 
@@ -343,6 +347,24 @@ struct MultiCacheBase: public MultiCacheHeader
   int sync_partition(int partition);
   void sync_partitions(Continuation * cont);
 
+  //
+  // A database mapped at startup is trusted a partition at a time.
+  // The first user of a partition (under its lock) compares it with
+  // the checksum taken at its last sync, and only if it changed since
+  // checks its elements with rebuild_callout, emptying corrupt ones.
+  //
+  bool unverified[MULTI_CACHE_PARTITIONS];
+  uint64_t checksum_partition(int partition);
+  void verify(int partition)
+  {
+    if (unverified[partition])
+      verify_partition(partition);
+  }
+  virtual void verify_partition(int partition)
+  {
+    unverified[partition] = false;
+  }
+
   MultiCacheBase();
   virtual ~ MultiCacheBase() {
     reset();
@@ -444,6 +466,7 @@ template<class C> struct MultiCache: public MultiCacheBase
   void delete_block(C * block);
   C *lookup_block(uint64_t folded_md5, int level);
   void copy_heap(int paritition, MultiCacheHeapGC *);
+  void verify_partition(int partition);
 };
 
 inline uint64_t
@@ -479,6 +502,8 @@ template<class C> inline C * MultiCache<C>::insert_block(uint64_t folded_md5, C
   int bucket = (int) (folded_md5 % buckets);
   int hits = 0;
 
+  verify(partition_of_bucket(bucket));
+
   // Find the entry
   //
   uint64_t tag = make_tag(folded_md5);
@@ -595,6 +620,7 @@ template<class C> inline C * MultiCache<C>::lookup_block(uint64_t folded_md5, in
   C *b = cache_bucket(folded_md5, 0);
   uint64_t tag = make_tag(folded_md5);
   int i = 0;
+  verify(partition_of_bucket((int) (folded_md5 % buckets)));
   // Level 0
   for (i = 0; i < elements[0]; i++)
     if (tag == b[i].tag())
@@ -645,6 +671,7 @@ template<class C> inline void MultiCache<C>::copy_heap(int partition, MultiCache
 {
   int b = first_bucket_of_partition(partition);
   int n = buckets_of_partition(partition);
+  verify(partition);
   for (int level = 0; level < levels; level++) {
     int e = n * elements[level];
     char *d = data + level_offset[level] + b * bucketsize[level];
@@ -669,6 +696,34 @@ template<class C> inline void MultiCache<C>::copy_heap(int partition, MultiCache
   }
 }
 
+template<class C> inline void MultiCache<C>::verify_partition(int partition)
+{
+  unverified[partition] = false;
+  if (checksum_partition(partition) == partition_checksum[partition])
+    return;
+
+  RebuildMC r;
+  memset(&r, 0, sizeof(r));
+  r.check = true;
+  r.data = data;
+  r.partition = partition;
+  int b = first_bucket_of_partition(partition);
+  int n = buckets_of_partition(partition);
+  for (int level = 0; level < levels; level++) {
+    C *x = (C *) (data + level_offset[level] + b * bucketsize[level]);
+    for (int i = 0; i < n * elements[level]; i++) {
+      if (x[i].is_empty())
+        continue;
+      r.total++;
+      if (rebuild_callout(&x[i], r) < 0) {
+        x[i].set_empty();
+        r.corrupt++;
+      }
+    }
+  }
+  Debug("multicache", "partition %d changed since its last sync, %d of %d elements corrupt", partition, r.corrupt, r.total);
+}
+
 // store either free or in the cache, can be stolen for reconfiguration
 void stealStore(Store & s, int blocks);
 #endif /* _MultiCache_h_ */
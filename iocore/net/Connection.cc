@@ -88,7 +88,15 @@ Server::accept(Connection * c)
   int res = 0;
   socklen_t sz = sizeof(c->addr);
 
+#if HAVE_ACCEPT4
+  int flags = SOCK_NONBLOCK;
+#ifdef SET_CLOSE_ON_EXEC
+  flags |= SOCK_CLOEXEC;
+#endif
+  res = socketManager.accept4(fd, &c->addr.sa, &sz, flags);
+#else
   res = socketManager.accept(fd, &c->addr.sa, &sz);
+#endif
   if (res < 0)
     return res;
   c->fd = res;
@@ -100,12 +108,14 @@ Server::accept(Connection * c)
       );
   }
 
+#if !HAVE_ACCEPT4
 #ifdef SET_CLOSE_ON_EXEC
   if ((res = safe_fcntl(fd, F_SETFD, FD_CLOEXEC)) < 0)
     goto Lerror;
 #endif
   if ((res = safe_nonblocking(c->fd)) < 0)
     goto Lerror;
+#endif
 #ifdef SEND_BUF_SIZE
   socketManager.set_sndbuf_size(c->fd, SEND_BUF_SIZE);
 #endif
@@ -235,6 +245,12 @@ Server::setup_fd_for_listen(
     goto Lerror;
   }
 
+#ifdef SO_REUSEPORT
+  if (f_reuse_port && (res = safe_setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, SOCKOPT_ON, sizeof(int))) < 0) {
+    goto Lerror;
+  }
+#endif
+
 #ifdef SET_TCP_NO_DELAY
   if ((res = safe_setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, SOCKOPT_ON, sizeof(int))) < 0) {
     goto Lerror;
@@ -71,6 +71,7 @@ static unsigned int const DEFAULT_POLL_TIMEOUT =
   ;
 
 extern int net_config_poll_timeout;
+extern int net_config_adaptive_poll_timeout;
 
 #define NET_EVENT_OPEN                    (NET_EVENT_EVENTS_START)
 #define NET_EVENT_OPEN_FAILED             (NET_EVENT_EVENTS_START+1)
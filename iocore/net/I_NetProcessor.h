@@ -95,6 +95,12 @@ public:
     */
     bool f_inbound_transparent;
 
+    /// Enable TCP Fast Open on the listen socket.
+    bool f_tcp_fastopen;
+    /// Seconds for TCP_DEFER_ACCEPT on the listen socket.
+    /// -1 => use @c proxy.config.net.defer_accept.
+    int defer_accept;
+
     /// Default constructor.
     /// Instance is constructed with default values.
     AcceptOptions() { this->reset(); }
@@ -158,6 +164,19 @@ public:
     AcceptOptions const& opt = DEFAULT_ACCEPT_OPTIONS
   );
 
+  /**
+    Stops accepting connections for an accept, leaving the connections
+    already accepted to run to completion. Unlike cancelling the accept,
+    a listen socket inherited from traffic_manager is not closed, as the
+    manager and a new traffic_server share it. A listen socket this
+    process opened is shut down, so that another process can bind the
+    port.
+
+    @param action Action returned by accept() or main_accept().
+
+  */
+  void stop_accept(Action * action);
+
   /**
     Open a NetVConnection for connection oriented I/O. Connects
     through sockserver if netprocessor is configured to use socks
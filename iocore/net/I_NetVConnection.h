@@ -157,6 +157,10 @@ struct NetVCOptions {
   static uint32_t const SOCK_OPT_NO_DELAY = 1;
   /// Value for keep alive for @c sockopt_flags.
   static uint32_t const SOCK_OPT_KEEP_ALIVE = 2;
+  /// Value for TCP Fast Open (send the request with the SYN) for @c sockopt_flags.
+  static uint32_t const SOCK_OPT_TCP_FAST_OPEN = 4;
+  /// Value for deferring the handshake ACK until there is data to send, for @c sockopt_flags.
+  static uint32_t const SOCK_OPT_DEFER_ACCEPT = 8;
 
   uint32_t packet_mark;
   uint32_t packet_tos;
@@ -470,6 +474,10 @@ public:
   /** Set remote sock addr struct. */
   virtual void set_remote_addr() = 0;
 
+  /** Returns true if this VC can write FILE_BACKED buffer blocks,
+      sending them from the file without copying them into memory. */
+  virtual bool sendfile_capable() { return false; }
+
   // for InkAPI
   bool get_is_internal_request() const {
     return is_internal_request;
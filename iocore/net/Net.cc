@@ -33,12 +33,14 @@
 
 RecRawStatBlock *net_rsb = NULL;
 int net_config_poll_timeout = DEFAULT_POLL_TIMEOUT;
+int net_config_adaptive_poll_timeout = 0;
 
 static inline void
 configure_net(void)
 {
   REC_RegisterConfigUpdateFunc("proxy.config.net.connections_throttle", change_net_connections_throttle, NULL);
   REC_ReadConfigInteger(fds_throttle, "proxy.config.net.connections_throttle");
+  REC_ReadConfigInteger(net_config_adaptive_poll_timeout, "proxy.config.net.adaptive_poll_timeout");
 }
 
 
@@ -94,6 +96,14 @@ register_net_stats()
                      RECD_INT, RECP_NULL, (int) net_calls_to_write_stat, RecRawStatSyncSum);
   NET_CLEAR_DYN_STAT(net_calls_to_write_stat);
 
+  RecRegisterRawStat(net_rsb, RECT_PROCESS, "proxy.process.net.write_bytes_per_call",
+                     RECD_FLOAT, RECP_NULL, (int) net_write_bytes_per_call_stat, RecRawStatSyncAvg);
+  NET_CLEAR_DYN_STAT(net_write_bytes_per_call_stat);
+
+  RecRegisterRawStat(net_rsb, RECT_PROCESS, "proxy.process.net.write_coalesced_blocks",
+                     RECD_INT, RECP_NULL, (int) net_write_coalesced_blocks_stat, RecRawStatSyncSum);
+  NET_CLEAR_DYN_STAT(net_write_coalesced_blocks_stat);
+
   RecRegisterRawStat(net_rsb, RECT_PROCESS, "proxy.process.net.calls_to_write_nodata",
                      RECD_INT, RECP_NULL, (int) net_calls_to_write_nodata_stat, RecRawStatSyncSum);
   NET_CLEAR_DYN_STAT(net_calls_to_write_nodata_stat);
@@ -111,6 +121,55 @@ register_net_stats()
   RecRegisterRawStat(net_rsb, RECT_PROCESS, "proxy.process.net.inactivity_cop_lock_acquire_failure",
                      RECD_INT, RECP_NULL, (int) inactivity_cop_lock_acquire_failure_stat,
                      RecRawStatSyncSum);
+
+  // divided by net_handler_run, the number of events each poll returned
+  RecRegisterRawStat(net_rsb, RECT_PROCESS, "proxy.process.net.poll_events",
+                     RECD_INT, RECP_NULL, (int) net_poll_events_stat, RecRawStatSyncSum);
+  NET_CLEAR_DYN_STAT(net_poll_events_stat);
+
+  RecRegisterRawStat(net_rsb, RECT_PROCESS, "proxy.process.ssl.ssl_session_cache_hit",
+                     RECD_INT, RECP_NULL, (int) ssl_session_cache_hit_stat, RecRawStatSyncSum);
+  RecRegisterRawStat(net_rsb, RECT_PROCESS, "proxy.process.ssl.ssl_session_cache_miss",
+                     RECD_INT, RECP_NULL, (int) ssl_session_cache_miss_stat, RecRawStatSyncSum);
+  RecRegisterRawStat(net_rsb, RECT_PROCESS, "proxy.process.ssl.ssl_session_cache_eviction",
+                     RECD_INT, RECP_NULL, (int) ssl_session_cache_eviction_stat, RecRawStatSyncSum);
+  RecRegisterRawStat(net_rsb, RECT_PROCESS, "proxy.process.ssl.ssl_session_cache_lock_contention",
+                     RECD_INT, RECP_NULL, (int) ssl_session_cache_lock_contention_stat, RecRawStatSyncSum);
+  RecRegisterRawStat(net_rsb, RECT_PROCESS, "proxy.process.ssl.ssl_session_cache_new_session",
+                     RECD_INT, RECP_NULL, (int) ssl_session_cache_new_session_stat, RecRawStatSyncSum);
+
+  RecRegisterRawStat(net_rsb, RECT_PROCESS, "proxy.process.ssl.total_tickets_created",
+                     RECD_INT, RECP_NULL, (int) ssl_total_tickets_created_stat, RecRawStatSyncSum);
+  RecRegisterRawStat(net_rsb, RECT_PROCESS, "proxy.process.ssl.total_tickets_verified",
+                     RECD_INT, RECP_NULL, (int) ssl_total_tickets_verified_stat, RecRawStatSyncSum);
+  RecRegisterRawStat(net_rsb, RECT_PROCESS, "proxy.process.ssl.total_tickets_not_found",
+                     RECD_INT, RECP_NULL, (int) ssl_total_tickets_not_found_stat, RecRawStatSyncSum);
+  // tickets made with an older key and reissued with the current one
+  RecRegisterRawStat(net_rsb, RECT_PROCESS, "proxy.process.ssl.total_tickets_renewed",
+                     RECD_INT, RECP_NULL, (int) ssl_total_tickets_renewed_stat, RecRawStatSyncSum);
+
+  RecRegisterRawStat(net_rsb, RECT_PROCESS, "proxy.process.ssl.handshakes_offloaded",
+                     RECD_INT, RECP_NULL, (int) ssl_handshakes_offloaded_stat, RecRawStatSyncSum);
+
+  // connections whose transmit side is encrypted by the kernel
+  RecRegisterRawStat(net_rsb, RECT_PROCESS, "proxy.process.ssl.total_ktls_send",
+                     RECD_INT, RECP_NULL, (int) ssl_ktls_send_stat, RecRawStatSyncSum);
+
+  // TCP Fast Open: client SYN data accepted on listen ports, and our SYN data accepted by origins
+  RecRegisterRawStat(net_rsb, RECT_PROCESS, "proxy.process.net.tcp_fastopen_accepted",
+                     RECD_INT, RECP_NULL, (int) net_tcp_fastopen_accepted_stat, RecRawStatSyncSum);
+  RecRegisterRawStat(net_rsb, RECT_PROCESS, "proxy.process.net.tcp_fastopen_used",
+                     RECD_INT, RECP_NULL, (int) net_tcp_fastopen_used_stat, RecRawStatSyncSum);
+
+  // packets per UDP system call, on each side
+  RecRegisterRawStat(net_rsb, RECT_PROCESS, "proxy.process.net.udp_send_calls",
+                     RECD_INT, RECP_NULL, (int) net_udp_send_calls_stat, RecRawStatSyncSum);
+  RecRegisterRawStat(net_rsb, RECT_PROCESS, "proxy.process.net.udp_packets_sent",
+                     RECD_INT, RECP_NULL, (int) net_udp_packets_sent_stat, RecRawStatSyncSum);
+  RecRegisterRawStat(net_rsb, RECT_PROCESS, "proxy.process.net.udp_recv_calls",
+                     RECD_INT, RECP_NULL, (int) net_udp_recv_calls_stat, RecRawStatSyncSum);
+  RecRegisterRawStat(net_rsb, RECT_PROCESS, "proxy.process.net.udp_packets_received",
+                     RECD_INT, RECP_NULL, (int) net_udp_packets_received_stat, RecRawStatSyncSum);
 }
 
 void
@@ -137,6 +137,9 @@ struct Connection
 
   void apply_options(NetVCOptions const& opt);
 
+  /// True if data carried on the SYN of this connection was acknowledged (TCP Fast Open).
+  bool syn_data_acked() const;
+
   virtual ~ Connection();
   Connection();
 
@@ -163,6 +166,10 @@ struct Server: public Connection
   /// If set, a kernel HTTP accept filter
   bool http_accept_filter;
 
+  /// If set, the listen socket is bound with @c SO_REUSEPORT so that
+  /// several sockets can share the same address.
+  bool f_reuse_port;
+
   //
   // Use this call for the main proxy accept
   //
@@ -187,6 +194,8 @@ struct Server: public Connection
   Server()
     : Connection()
     , f_inbound_transparent(false)
+    , http_accept_filter(false)
+    , f_reuse_port(false)
   {
     ink_zero(accept_addr);
   }
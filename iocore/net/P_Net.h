@@ -47,10 +47,30 @@ enum Net_Stats
   net_calls_to_writetonet_afterpoll_stat,
   net_calls_to_write_stat,
   net_calls_to_write_nodata_stat,
+  net_write_bytes_per_call_stat,
+  net_write_coalesced_blocks_stat,
   socks_connections_successful_stat,
   socks_connections_unsuccessful_stat,
   socks_connections_currently_open_stat,
   inactivity_cop_lock_acquire_failure_stat,
+  net_poll_events_stat,
+  ssl_session_cache_hit_stat,
+  ssl_session_cache_miss_stat,
+  ssl_session_cache_eviction_stat,
+  ssl_session_cache_lock_contention_stat,
+  ssl_session_cache_new_session_stat,
+  ssl_total_tickets_created_stat,
+  ssl_total_tickets_verified_stat,
+  ssl_total_tickets_not_found_stat,
+  ssl_total_tickets_renewed_stat,
+  ssl_handshakes_offloaded_stat,
+  ssl_ktls_send_stat,
+  net_tcp_fastopen_accepted_stat,
+  net_tcp_fastopen_used_stat,
+  net_udp_send_calls_stat,
+  net_udp_packets_sent_stat,
+  net_udp_recv_calls_stat,
+  net_udp_packets_received_stat,
   Net_Stat_Count
 };
 
@@ -60,6 +80,8 @@ extern RecRawStatBlock *net_rsb;
 #define SSL_HANDSHAKE_WANT_WRITE  7
 #define SSL_HANDSHAKE_WANT_ACCEPT 8
 #define SSL_HANDSHAKE_WANT_CONNECT 9
+// The handshake is running elsewhere; wait for the connection to be rescheduled.
+#define SSL_HANDSHAKE_OFFLOADED   11
 
 #define NET_DEBUG_COUNT_DYN_STAT(_x, _y) \
 RecIncrRawStatCount(net_rsb, mutex->thread_holding, (int)_x, _y)
@@ -67,6 +89,13 @@ RecIncrRawStatCount(net_rsb, mutex->thread_holding, (int)_x, _y)
 #define NET_INCREMENT_DYN_STAT(_x)  \
 RecIncrRawStatSum(net_rsb, mutex->thread_holding, (int)_x, 1)
 
+// For callbacks which run without a continuation mutex, e.g. from inside OpenSSL
+#define NET_INCREMENT_THREAD_DYN_STAT(_x, _t)  \
+RecIncrRawStatSum(net_rsb, (_t), (int)_x, 1)
+
+#define NET_SUM_THREAD_DYN_STAT(_x, _t, _r)  \
+RecIncrRawStatSum(net_rsb, (_t), (int)_x, _r)
+
 #define NET_DECREMENT_DYN_STAT(_x) \
 RecIncrRawStatSum(net_rsb, mutex->thread_holding, (int)_x, -1)
 
@@ -60,6 +60,14 @@ class UnixNetVConnection;
 struct NetAcceptAction:public Action, public RefCountObj
 {
   Server *server;
+  /// Set by NetProcessor::stop_accept(), the NetAccepts exit on their next event.
+  volatile bool stopped;
+  /// The listen socket was bound by this process, not inherited.
+  bool own_socket;
+
+  NetAcceptAction()
+    : server(NULL), stopped(false), own_socket(false)
+  { }
 
   void cancel(Continuation * cont = NULL) {
     Action::cancel(cont);
@@ -96,6 +104,9 @@ struct NetAccept:public Continuation
   uint32_t sockopt_flags;
   uint32_t packet_mark;
   uint32_t packet_tos;
+  int defer_accept;
+  bool tcp_fastopen;
+  int accept_batch_size; ///< Most connections taken per accept event, 0 for no limit.
   EventType etype;
   UnixNetVConnection *epoll_vc; // only storage for epoll events
   EventIO ep;
@@ -113,11 +124,15 @@ struct NetAccept:public Continuation
   virtual void init_accept_per_thread();
   // 0 == success
   int do_listen(bool non_blocking, bool transparent = false);
+  int do_listen_reuse_port();
+  void set_listen_sockopts();
+  void set_inherited_sockopts();
 
   int do_blocking_accept(EThread * t);
   virtual int acceptEvent(int event, void *e);
   virtual int acceptFastEvent(int event, void *e);
   int acceptLoopEvent(int event, Event * e);
+  int stop_accept(Event * e);
   void cancel();
 
   NetAccept();
@@ -49,7 +49,8 @@ struct SSLConfigParams : public ConfigInfo
   enum SSL_SESSION_CACHE_MODE
   {
     SSL_SESSION_CACHE_MODE_OFF = 0,
-    SSL_SESSION_CACHE_MODE_SERVER = 1
+    SSL_SESSION_CACHE_MODE_SERVER = 1,
+    SSL_SESSION_CACHE_MODE_SERVER_ATS_IMPL = 2
   };
 
   SSLConfigParams();
@@ -60,12 +61,15 @@ struct SSLConfigParams : public ConfigInfo
   char *  serverKeyPathOnly;
   char *  serverCACertFilename;
   char *  serverCACertPath;
+  char *  ticketKeyFilename;
   char *  configFilePath;
   char *  cipherSuite;
   int     clientCertLevel;
   int     verify_depth;
   int     ssl_session_cache; // SSL_SESSION_CACHE_MODE
   int     ssl_session_cache_size;
+  int     ssl_session_cache_num_buckets;
+  int     ssl_ktls_enabled;
 
   char *  clientCertPath;
   char *  clientKeyPath;
@@ -75,6 +79,10 @@ struct SSLConfigParams : public ConfigInfo
   int     client_verify_depth;
   long    ssl_ctx_options;
 
+  // Largest TLS record we write. 0 writes each buffer block as its own record and -1 sizes
+  // records dynamically. Read once at startup and used on every write, so it is static.
+  static int ssl_maxrecord;
+
   void initialize();
   void cleanup();
 };
@@ -60,7 +60,14 @@ public:
 
   SSL_CTX *client_ctx;
 
+  // If set, start() leaves loading the server certificates to the caller, which must call
+  // SSLCertificateConfig::startup() before SSL connections are accepted.
+  bool defer_certificates;
+
   static EventType ET_SSL;
+  // Threads that run server handshakes for ET_SSL, if proxy.config.ssl.handshake.threads is set.
+  static EventType ET_SSL_HANDSHAKE;
+  static bool handshake_offload;
 
   //
   // Private
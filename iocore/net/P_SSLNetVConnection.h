@@ -52,6 +52,15 @@
 #endif
 
 class SSLNextProtocolSet;
+struct SSLHandShakeJob;
+
+// TLS record sizing for proxy.config.ssl.max_record_size -1. A new or idle connection sends
+// records that fit in one TCP segment, so the client can decrypt each packet as it arrives,
+// then switches to full size records once the congestion window has opened up.
+#define SSL_DEF_TLS_RECORD_SIZE           1300  // 1500 - 40 (IP) - 32 (TCP) - 128 (TLS overhead)
+#define SSL_MAX_TLS_RECORD_SIZE          16383  // 2^14 - 1
+#define SSL_DEF_TLS_RECORD_BYTE_THRESHOLD 1000000
+#define SSL_DEF_TLS_RECORD_MSEC_THRESHOLD 1000
 
 //////////////////////////////////////////////////////////////////
 //
@@ -72,12 +81,17 @@ public:
   };
   virtual bool getSSLHandShakeComplete()
   {
-    return sslHandShakeComplete;
+    // An offloaded handshake is only complete once its result is picked up on this thread.
+    return sslHandShakeJob == NULL && !sslHandShakeResultReady && sslHandShakeComplete;
   };
   void setSSLHandShakeComplete(bool state)
   {
     sslHandShakeComplete = state;
   };
+  virtual bool getSSLHandShakeOffloaded()
+  {
+    return sslHandShakeJob != NULL;
+  };
   virtual bool getSSLClientConnection()
   {
     return sslClientConnection;
@@ -90,6 +104,10 @@ public:
   int sslClientHandShakeEvent(int &err);
   virtual void net_read_io(NetHandler * nh, EThread * lthread);
   virtual int64_t load_buffer_and_write(int64_t towrite, int64_t &wattempted, int64_t &total_wrote, MIOBufferAccessor & buf);
+  // The bytes have to go through SSL_write().
+  // With kernel TLS the socket encrypts what we send, so file backed blocks can go straight
+  // from the disk with SSL_sendfile().
+  virtual bool sendfile_capable() { return sslKTLSSend; }
 
   void registerNextProtocolSet(const SSLNextProtocolSet *);
 
@@ -106,6 +124,8 @@ public:
   X509 *server_cert;
 
   static int advertise_next_protocol(SSL *ssl, const unsigned char **out, unsigned int *outlen, void *arg);
+  static int select_next_protocol(SSL *ssl, const unsigned char **out, unsigned char *outlen,
+                                  const unsigned char *in, unsigned inlen, void *arg);
 
   Continuation * endpoint() const {
     return npnEndpoint;
@@ -119,6 +139,23 @@ private:
   bool sslClientConnection;
   const SSLNextProtocolSet * npnSet;
   Continuation * npnEndpoint;
+
+  // While sslHandShakeJob is set, SSL_accept() is running on an ET_SSL_HANDSHAKE thread
+  // and the net thread must leave the SSL object and the socket alone.
+  int sslOffloadHandShake(int &err);
+  SSLHandShakeJob * sslHandShakeJob;
+  bool sslHandShakeResultReady;
+  int sslHandShakeResult;
+  int sslHandShakeErr;
+
+  int64_t sslRecordSize();
+  int64_t sslTotalBytesSent;
+  ink_hrtime sslLastWriteTime;
+  int64_t sslCurrentRecordSize;
+  bool sslWriteBlocked;
+  bool sslKTLSSend;
+
+  friend struct SSLHandShakeJob;
 };
 
 typedef int (SSLNetVConnection::*SSLNetVConnHandler) (int, void *);
@@ -0,0 +1,135 @@
+/** @file
+
+  A shared, sharded SSL session cache.
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#ifndef __P_SSLSESSIONCACHE_H__
+#define __P_SSLSESSIONCACHE_H__
+
+#include "libts.h"
+#include "P_EventSystem.h"
+#include "P_SSLUtils.h"
+
+// Largest DER encoded session we keep. Sessions carrying a large peer certificate
+// chain are not cached rather than growing every slot to fit them.
+#define SSL_SESSION_MAX_DER 1024
+
+struct SSLSessionID
+{
+  unsigned char bytes[SSL_MAX_SSL_SESSION_ID_LENGTH];
+  unsigned      len;
+
+  SSLSessionID() : len(0) { }
+  SSLSessionID(const unsigned char * id, unsigned idlen) : len(idlen) {
+    if (len > sizeof(bytes)) {
+      len = sizeof(bytes);
+    }
+    memcpy(bytes, id, len);
+  }
+
+  bool operator==(const SSLSessionID& other) const {
+    return len == other.len && memcmp(bytes, other.bytes, len) == 0;
+  }
+
+  // Session IDs are random, so folding the bytes is a good enough hash.
+  uint64_t hash() const {
+    uint64_t h = 0;
+    for (unsigned i = 0; i < len; ++i) {
+      h = (h << 5) + h + bytes[i];
+    }
+    return h;
+  }
+};
+
+// A fixed size cache slot. The session is stored in its DER encoding so that the
+// cache never holds a reference to a live SSL_SESSION.
+struct SSLSession
+{
+  SSLSessionID    session_id;
+  uint64_t        hash;
+  unsigned        der_len;
+  unsigned char   der[SSL_SESSION_MAX_DER];
+
+  LINK(SSLSession, link);
+
+  SSLSession() : hash(0), der_len(0) { }
+};
+
+// One shard of the cache. Each bucket owns a fixed array of slots carved out at
+// startup, kept in LRU order; a full bucket recycles its least recently used slot.
+struct SSLSessionBucket
+{
+  SSLSessionBucket();
+  ~SSLSessionBucket();
+
+  void init(unsigned nslots);
+
+  // All of these take the bucket lock with a try lock. A lookup that loses the race
+  // is reported as a miss and an insert is dropped; neither is worth stalling a net
+  // thread for.
+  bool get(const SSLSessionID& id, uint64_t hash, SSL_SESSION ** sess, EThread * t);
+  bool insert(const SSLSessionID& id, uint64_t hash, SSL_SESSION * sess, EThread * t);
+  void remove(const SSLSessionID& id, uint64_t hash, EThread * t);
+
+  Ptr<ProxyMutex>   mutex;
+  Que(SSLSession, link) lru;      // head is the most recently used
+  Que(SSLSession, link) free;
+  SSLSession *      slots;
+  unsigned          nslots;
+
+private:
+  SSLSession * find(const SSLSessionID& id, uint64_t hash);
+};
+
+class SSLSessionCache
+{
+public:
+  SSLSessionCache(unsigned nsessions, unsigned nbuckets);
+  ~SSLSessionCache();
+
+  // Return a new SSL_SESSION decoded from the cache, or NULL.
+  SSL_SESSION * get(const SSLSessionID& id);
+  void insert(const SSLSessionID& id, SSL_SESSION * sess);
+  void remove(const SSLSessionID& id);
+
+  unsigned bucket_count() const { return nbuckets; }
+
+private:
+  SSLSessionBucket * bucket(uint64_t hash) const { return &buckets[hash % nbuckets]; }
+
+  SSLSessionBucket *  buckets;
+  unsigned            nbuckets;
+
+  SSLSessionCache(const SSLSessionCache&);
+  SSLSessionCache& operator=(const SSLSessionCache&);
+};
+
+// The process wide session cache, shared by every SSL_CTX loaded from ssl_multicert.config.
+// NULL unless proxy.config.ssl.session_cache is SSL_SESSION_CACHE_MODE_SERVER_ATS_IMPL.
+extern SSLSessionCache * ssl_session_cache;
+
+// Create the process wide session cache if the configuration asks for it.
+void SSLInitSessionCache(const SSLConfigParams * params);
+
+// Point the session callbacks of ctx at the process wide session cache.
+void SSLSessionCacheAttach(SSL_CTX * ctx);
+
+#endif /* __P_SSLSESSIONCACHE_H__ */
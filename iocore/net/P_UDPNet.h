@@ -63,6 +63,11 @@ extern UDPNetProcessorInternal udpNetInternal;
 #define SLOT_TIME HRTIME_MSECONDS(SLOT_TIME_MSEC)
 #define N_SLOTS 2048
 
+#define UDP_SEND_BATCH 32       // packets per sendmmsg()
+#define UDP_RECV_BATCH 8        // datagrams per recvmmsg()
+#define UDP_MAX_DATAGRAM 65536
+#define UDP_MAX_IOV 32          // buffer blocks in one packet
+
 class PacketQueue
 {
  public:
@@ -289,6 +294,8 @@ public:
 
   void SendPackets();
   void SendUDPPacket(UDPPacketInternal * p, int32_t pktLen);
+  // Sends packets which all go out on the same connection
+  void SendUDPPackets(UDPPacketInternal ** p, int n);
 
   // Interface exported to the outside world
   void send(UDPPacket * p);
@@ -318,6 +325,8 @@ public:
   Event *trigger_event;
   ink_hrtime nextCheck;
   ink_hrtime lastCheck;
+  // receive buffers for a batch of datagrams, allocated on first read
+  char *read_buffers;
 
   int startNetEvent(int event, Event * data);
   int mainNetEvent(int event, Event * data);
@@ -25,6 +25,9 @@
 #define __P_UNIXNET_H__
 
 #include "libts.h"
+#if TS_USE_TIMER_WHEEL
+#include "TimerWheel.h"
+#endif
 
 #define USE_EDGE_TRIGGER_EPOLL  1
 #define USE_EDGE_TRIGGER_KQUEUE 1
@@ -133,6 +136,8 @@ extern int http_accept_port_number;
 
 
 //#define INACTIVITY_TIMEOUT
+// the InactivityCop period, and its timer wheel tick
+#define INACTIVITY_COP_PERIOD HRTIME_SECONDS(1)
 //
 // Configuration Parameter had to move here to share
 // between UnixNet and UnixUDPNet or SSLNet modules.
@@ -156,6 +161,15 @@ extern int http_accept_port_number;
 #define ACCEPT_PERIOD                             -HRTIME_MSECONDS(4)
 #define NET_THROTTLE_DELAY                        50    /* mseconds */
 
+// Sockets returned by accept(2) on Linux carry the buffer sizes, TCP_NODELAY,
+// SO_KEEPALIVE, SO_MARK and IP_TOS of the listen socket, so these are set once
+// on the listen socket instead of on every accepted connection.
+#if defined(linux)
+#define ACCEPT_INHERITS_SOCKOPTS                  1
+#else
+#define ACCEPT_INHERITS_SOCKOPTS                  0
+#endif
+
 #define PRINT_IP(x) ((uint8_t*)&(x))[0],((uint8_t*)&(x))[1], ((uint8_t*)&(x))[2],((uint8_t*)&(x))[3]
 
 
@@ -192,6 +206,10 @@ public:
   DList(UnixNetVConnection, cop_link) cop_list;
   ASLLM(UnixNetVConnection, NetState, read, enable_link) read_enable_list;
   ASLLM(UnixNetVConnection, NetState, write, enable_link) write_enable_list;
+#if !defined(INACTIVITY_TIMEOUT) && TS_USE_TIMER_WHEEL
+  TimerWheel<UnixNetVConnection, UnixNetVConnection::Link_inactivity_wheel> inactivity_wheel;
+  ASLL(UnixNetVConnection, requeue_link) inactivity_requeue_list;
+#endif
 
   time_t sec;
   int cycles;
@@ -492,6 +510,8 @@ TS_INLINE int EventIO::modify(int e) {
     new_events &= ~(-e);
   else
     new_events |= e;
+  if (new_events == old_events) // nothing changes, save the syscall
+    return 0;
   events = new_events;
   ev.events = new_events;
   ev.data.ptr = this;
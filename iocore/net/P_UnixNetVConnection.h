@@ -173,6 +173,10 @@ public:
   virtual bool getSSLHandShakeComplete() {
     return (true);
   }
+  // True while another thread is running the SSL handshake for this connection.
+  virtual bool getSSLHandShakeOffloaded() {
+    return (false);
+  }
   virtual bool getSSLClientConnection()
   {
     return (false);
@@ -208,6 +212,22 @@ public:
   Event *inactivity_timeout;
 #else
   ink_hrtime next_inactivity_timeout_at;
+#if TS_USE_TIMER_WHEEL
+  // When NetHandler::inactivity_wheel next looks at this connection, no
+  // later than next_inactivity_timeout_at.  Other threads can't touch the
+  // wheel, they queue the connection on NetHandler::inactivity_requeue_list.
+  LINK(UnixNetVConnection, wheel_link);
+  struct Link_inactivity_wheel : public Link_wheel_link {
+    static ink_hrtime at(UnixNetVConnection *vc) { return vc->wheel_at; }
+    static int slot(UnixNetVConnection *vc) { return vc->wheel_slot; }
+    static void set_slot(UnixNetVConnection *vc, int s) { vc->wheel_slot = s; }
+  };
+  SLINK(UnixNetVConnection, requeue_link);
+  ink_hrtime wheel_at;
+  int wheel_slot;
+  volatile int in_requeue_list;
+  void update_inactivity_wheel();
+#endif
 #endif
   Event *active_timeout;
   EventIO ep;
@@ -231,6 +251,9 @@ public:
   Connection con;
   int recursion;
   ink_hrtime submit_time;
+  // write syscalls on this connection and the bytes they sent
+  int64_t write_calls;
+  int64_t write_call_bytes;
   OOB_callback *oob_ptr;
   bool from_accept_thread;
 
@@ -246,6 +269,7 @@ public:
   virtual void set_local_addr();
   virtual void set_remote_addr();
   virtual int set_tcp_init_cwnd(int init_cwnd);
+  virtual bool sendfile_capable();
   virtual void apply_options();
 };
 
@@ -286,6 +310,9 @@ UnixNetVConnection::set_inactivity_timeout(ink_hrtime timeout)
   inactivity_timeout_in = timeout;
 #ifndef INACTIVITY_TIMEOUT
   next_inactivity_timeout_at = ink_get_hrtime() + timeout;
+#if TS_USE_TIMER_WHEEL
+  update_inactivity_wheel();
+#endif
 #else
   if (inactivity_timeout)
     inactivity_timeout->cancel_action(this);
@@ -377,6 +404,16 @@ UnixNetVConnection::set_tcp_init_cwnd(int init_cwnd)
 #endif
 }
 
+TS_INLINE bool
+UnixNetVConnection::sendfile_capable()
+{
+#ifdef HAVE_SYS_SENDFILE_H
+  return true;
+#else
+  return false;
+#endif
+}
+
 TS_INLINE UnixNetVConnection::~UnixNetVConnection() { }
 
 TS_INLINE SOCKET
@@ -29,7 +29,6 @@
 #include "I_EventSystem.h"
 #include "I_Layout.h"
 #include "Regex.h"
-#include "Trie.h"
 #include "ts/TestBox.h"
 
 struct SSLAddressLookupKey
@@ -68,6 +67,25 @@ private:
   unsigned char sep; // offset of address/port separator
 };
 
+struct ats_wildcard_matcher
+{
+  ats_wildcard_matcher() {
+    if (regex.compile("^\\*\\.[^\\*.]+") != 0) {
+      Fatal("failed to compile TLS wildcard matching regex");
+    }
+  }
+
+  ~ats_wildcard_matcher() {
+  }
+
+  bool match(const char * hostname) const {
+    return regex.match(hostname) != -1;
+  }
+
+private:
+  DFA regex;
+};
+
 struct SSLContextStorage
 {
   SSLContextStorage();
@@ -77,19 +95,15 @@ struct SSLContextStorage
   SSL_CTX * lookup(const char * name) const;
 
 private:
-  struct SSLEntry
-  {
-    explicit SSLEntry(SSL_CTX * c) : ctx(c) {}
-
-    void Print() const { Debug("ssl", "SSLEntry=%p SSL_CTX=%p", this, ctx); }
-
-    SSL_CTX * ctx;
-    LINK(SSLEntry, link);
-  };
-
-  Trie<SSLEntry>  wildcards;
+  // A wildcard covers exactly one leading label, so "*.foo.com" is indexed under "foo.com" and a
+  // lookup only needs to strip the first label of the name. Both lookups are O(name length) no
+  // matter how many certificates are loaded.
+  InkHashTable *  wildcards;
   InkHashTable *  hostnames;
+
+  // Every SSL_CTX we index. This is a Vec set, so adding a context does not scan the whole list.
   Vec<SSL_CTX *>  references;
+  ats_wildcard_matcher wildcard;
 };
 
 SSLCertLookup::SSLCertLookup()
@@ -141,102 +155,39 @@ SSLCertLookup::insert(SSL_CTX * ctx, const IpEndpoint& address)
   return this->ssl_storage->insert(ctx, key.get());
 }
 
-struct ats_wildcard_matcher
-{
-  ats_wildcard_matcher() {
-    if (regex.compile("^\\*\\.[^\\*.]+") != 0) {
-      Fatal("failed to compile TLS wildcard matching regex");
-    }
-  }
-
-  ~ats_wildcard_matcher() {
-  }
-
-  bool match(const char * hostname) const {
-    return regex.match(hostname) != -1;
-  }
-
-private:
-  DFA regex;
-};
-
-static char *
-reverse_dns_name(const char * hostname, char (&reversed)[TS_MAX_HOST_NAME_LEN+1])
-{
-  char * ptr = reversed + sizeof(reversed);
-  const char * part = hostname;
-
-  *(--ptr) = '\0'; // NUL-terminate
-
-  while (*part) {
-    ssize_t len = strcspn(part, ".");
-    ssize_t remain = ptr - reversed;
-
-    // We are going to put the '.' separator back for all components except the first.
-    if (*ptr == '\0') {
-      if (remain < len) {
-        return NULL;
-      }
-    } else {
-      if (remain < (len + 1)) {
-        return NULL;
-      }
-      *(--ptr) = '.';
-    }
-
-    ptr -= len;
-    memcpy(ptr, part, len);
-
-    // Skip to the next domain component. This will take us to either a '.' or a NUL.
-    // If it's a '.' we need to skip over it.
-    part += len;
-    if (*part == '.') {
-      ++part;
-    }
-  }
-
-  return ptr;
-}
 
 SSLContextStorage::SSLContextStorage()
-  :wildcards(), hostnames(ink_hash_table_create(InkHashTableKeyType_String))
+  : wildcards(ink_hash_table_create(InkHashTableKeyType_String)),
+    hostnames(ink_hash_table_create(InkHashTableKeyType_String))
 {
 }
 
 SSLContextStorage::~SSLContextStorage()
 {
-  for (unsigned i = 0; i < this->references.count(); ++i) {
-    SSL_CTX_free(this->references[i]);
+  for (int i = 0; i < this->references.length(); ++i) {
+    if (this->references[i]) {
+      SSL_CTX_free(this->references[i]);
+    }
   }
 
+  ink_hash_table_destroy(this->wildcards);
   ink_hash_table_destroy(this->hostnames);
 }
 
 bool
 SSLContextStorage::insert(SSL_CTX * ctx, const char * name)
 {
-  ats_wildcard_matcher wildcard;
-  bool inserted = true;
-
-  if (wildcard.match(name)) {
-    // We turn wildcards into the reverse DNS form, then insert them into the trie
-    // so that we can do a longest match lookup.
-    char namebuf[TS_MAX_HOST_NAME_LEN + 1];
-    char * reversed;
-    xptr<SSLEntry> entry;
-
-    reversed = reverse_dns_name(name + 2, namebuf);
-    if (!reversed) {
-      Error("wildcard name '%s' is too long", name);
+  if (this->wildcard.match(name)) {
+    InkHashTableValue value;
+
+    // Index "*.foo.com" as "foo.com". As before, the first certificate to claim a wildcard keeps it.
+    if (ink_hash_table_lookup(this->wildcards, name + 2, &value)) {
+      Debug("ssl", "wildcard '%s' is already indexed with SSL_CTX %p", name, value);
       return false;
     }
 
-    Debug("ssl", "indexed wildcard certificate for '%s' as '%s' with SSL_CTX %p", name, reversed, ctx);
-    entry = new SSLEntry(ctx);
-    inserted = this->wildcards.Insert(reversed, entry, 0 /* rank */, -1 /* keylen */);
-    if (inserted) {
-      entry.release();
-    }
+    Debug("ssl", "indexed wildcard certificate for '%s' with SSL_CTX %p", name, ctx);
+    ink_hash_table_insert(this->wildcards, name + 2, (void *)ctx);
   } else {
     Debug("ssl", "indexed '%s' with SSL_CTX %p", name, ctx);
     ink_hash_table_insert(this->hostnames, name, (void *)ctx);
@@ -245,13 +196,8 @@ SSLContextStorage::insert(SSL_CTX * ctx, const char * name)
   // Keep a unique reference to the SSL_CTX, so that we can free it later. Since we index by name, multiple
   // certificates can be indexed for the same name. If this happens, we will overwrite the previous pointer
   // and leak a context. So if we insert a certificate, keep an ownership reference to it.
-  if (inserted) {
-    if (this->references.in(ctx) == NULL) {
-      this->references.push_back(ctx);
-    }
-  }
-
-  return inserted;
+  this->references.set_add(ctx);
+  return true;
 }
 
 SSL_CTX *
@@ -263,21 +209,11 @@ SSLContextStorage::lookup(const char * name) const
     return (SSL_CTX *)value;
   }
 
-  if (!this->wildcards.Empty()) {
-    char namebuf[TS_MAX_HOST_NAME_LEN + 1];
-    char * reversed;
-    SSLEntry * entry;
-
-    reversed = reverse_dns_name(name, namebuf);
-    if (!reversed) {
-      Error("failed to reverse hostname name '%s' is too long", name);
-      return NULL;
-    }
-
-    Debug("ssl", "attempting wildcard match for %s", reversed);
-    entry = this->wildcards.Search(reversed);
-    if (entry) {
-      return entry->ctx;
+  const char * parent = strchr(name, '.');
+  if (parent && parent != name && parent[1] != '\0') {
+    Debug("ssl", "attempting wildcard match for %s", name);
+    if (ink_hash_table_lookup(const_cast<InkHashTable *>(this->wildcards), parent + 1, &value)) {
+      return (SSL_CTX *)value;
     }
   }
 
@@ -300,21 +236,25 @@ REGRESSION_TEST(SSLWildcardMatch)(RegressionTest * t, int /* atype ATS_UNUSED */
   box.check(wildcard.match("") == false, "'' is not a wildcard");
 }
 
-REGRESSION_TEST(SSLReverseHostname)(RegressionTest * t, int /* atype ATS_UNUSED */, int * pstatus)
+REGRESSION_TEST(SSLWildcardLookup)(RegressionTest * t, int /* atype ATS_UNUSED */, int * pstatus)
 {
   TestBox box(t, pstatus);
-
-  char reversed[TS_MAX_HOST_NAME_LEN + 1];
-
-#define _R(name) reverse_dns_name(name, reversed)
+  SSLContextStorage storage;
+  SSL_CTX * wild = SSL_CTX_new(SSLv23_server_method());
+  SSL_CTX * exact = SSL_CTX_new(SSLv23_server_method());
 
   box = REGRESSION_TEST_PASSED;
 
-  box.check(strcmp(_R("foo.com"), "com.foo") == 0, "reversed foo.com");
-  box.check(strcmp(_R("bar.foo.com"), "com.foo.bar") == 0, "reversed bar.foo.com");
-  box.check(strcmp(_R("foo"), "foo") == 0, "reversed foo");
+  box.check(storage.insert(wild, "*.foo.com"), "failed to insert *.foo.com");
+  box.check(storage.insert(exact, "www.foo.com"), "failed to insert www.foo.com");
+  box.check(!storage.insert(exact, "*.foo.com"), "inserted *.foo.com twice");
 
-#undef _R
+  box.check(storage.lookup("www.foo.com") == exact, "www.foo.com should prefer the exact match");
+  box.check(storage.lookup("bar.foo.com") == wild, "bar.foo.com should match *.foo.com");
+  box.check(storage.lookup("a.bar.foo.com") == NULL, "a.bar.foo.com should not match *.foo.com");
+  box.check(storage.lookup("foo.com") == NULL, "foo.com should not match *.foo.com");
+  box.check(storage.lookup("barfoo.com") == NULL, "barfoo.com should not match *.foo.com");
+  box.check(storage.lookup(".foo.com") == NULL, ".foo.com should not match *.foo.com");
 }
 
 #endif // TS_HAS_TESTS
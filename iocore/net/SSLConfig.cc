@@ -37,10 +37,12 @@
 #include "P_SSLConfig.h"
 #include "P_SSLUtils.h"
 #include "P_SSLCertLookup.h"
+#include "P_SSLSessionCache.h"
 #include <records/I_RecHttp.h>
 
 int SSLConfig::configid = 0;
 int SSLCertificateConfig::configid = 0;
+int SSLConfigParams::ssl_maxrecord = 0;
 
 static ConfigUpdateHandler<SSLCertificateConfig> * sslCertUpdate;
 
@@ -51,6 +53,7 @@ SSLConfigParams::SSLConfigParams()
     configFilePath =
     serverCACertFilename =
     serverCACertPath =
+    ticketKeyFilename =
     clientCertPath =
     clientKeyPath =
     clientCACertFilename =
@@ -63,6 +66,8 @@ SSLConfigParams::SSLConfigParams()
   ssl_ctx_options = 0;
   ssl_session_cache = SSL_SESSION_CACHE_MODE_SERVER;
   ssl_session_cache_size = 1024*20;
+  ssl_session_cache_num_buckets = 256;
+  ssl_ktls_enabled = 0;
 }
 
 SSLConfigParams::~SSLConfigParams()
@@ -76,6 +81,7 @@ SSLConfigParams::cleanup()
   ats_free_null(serverCertChainFilename);
   ats_free_null(serverCACertFilename);
   ats_free_null(serverCACertPath);
+  ats_free_null(ticketKeyFilename);
   ats_free_null(clientCertPath);
   ats_free_null(clientKeyPath);
   ats_free_null(clientCACertFilename);
@@ -127,6 +133,7 @@ SSLConfigParams::initialize()
   char *ssl_client_private_key_path = NULL;
   char *clientCACertRelativePath = NULL;
   char *multicert_config_file = NULL;
+  char *ssl_ticket_key_filename = NULL;
 
   cleanup();
 
@@ -162,6 +169,15 @@ SSLConfigParams::initialize()
 #endif
   }
 
+  REC_ReadConfigInteger(options, "proxy.config.ssl.ktls.enabled");
+  if (options) {
+#if TS_USE_TLS_KTLS
+    ssl_ktls_enabled = 1;
+#else
+    Warning("ignoring proxy.config.ssl.ktls.enabled, this OpenSSL does not support kernel TLS");
+#endif
+  }
+
   REC_ReadConfigStringAlloc(serverCertChainFilename, "proxy.config.ssl.server.cert_chain.filename");
   REC_ReadConfigStringAlloc(serverCertRelativePath, "proxy.config.ssl.server.cert.path");
   set_paths_helper(serverCertRelativePath, NULL, &serverCertPathOnly, NULL);
@@ -183,6 +199,18 @@ SSLConfigParams::initialize()
   // SSL session cache configurations
   REC_ReadConfigInteger(ssl_session_cache, "proxy.config.ssl.session_cache");
   REC_ReadConfigInteger(ssl_session_cache_size, "proxy.config.ssl.session_cache.size");
+  REC_ReadConfigInteger(ssl_session_cache_num_buckets, "proxy.config.ssl.session_cache.num_buckets");
+
+  REC_ReadConfigInt32(ssl_maxrecord, "proxy.config.ssl.max_record_size");
+  if (ssl_maxrecord > SSL_MAX_TLS_RECORD_SIZE) {
+    ssl_maxrecord = SSL_MAX_TLS_RECORD_SIZE;
+  }
+
+  REC_ReadConfigStringAlloc(ssl_ticket_key_filename, "proxy.config.ssl.server.ticket_key.filename");
+  if (ssl_ticket_key_filename != NULL) {
+    ticketKeyFilename = Layout::relative_to(serverCertPathOnly, ssl_ticket_key_filename);
+    ats_free(ssl_ticket_key_filename);
+  }
 
   // ++++++++++++++++++++++++ Client part ++++++++++++++++++++
   client_verify_depth = 7;
@@ -213,6 +241,10 @@ void
 SSLConfig::startup()
 {
   reconfigure();
+
+  // The session cache is sized once at startup and shared by every certificate context.
+  SSLConfig::scoped_config params;
+  SSLInitSessionCache(params);
 }
 
 void
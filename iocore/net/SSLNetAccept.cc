@@ -73,12 +73,14 @@ SSLNetAccept::init_accept_per_thread()
     if (i < n - 1) {
       a = NEW(new SSLNetAccept);
       *a = *this;
+      if (server.f_reuse_port)
+        a->do_listen_reuse_port();
     } else
       a = this;
     EThread *t = eventProcessor.eventthread[SSLNetProcessor::ET_SSL][i];
 
     PollDescriptor *pd = get_PollDescriptor(t);
-    if (ep.start(pd, this, EVENTIO_READ) < 0)
+    if (a->ep.start(pd, a, EVENTIO_READ) < 0)
       Debug("iocore_net", "error starting EventIO");
     a->mutex = get_NetHandler(t)->mutex;
     t->schedule_every(a, period, etype);
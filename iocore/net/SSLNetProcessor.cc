@@ -33,6 +33,8 @@
 SSLNetProcessor   ssl_NetProcessor;
 NetProcessor&     sslNetProcessor = ssl_NetProcessor;
 EventType         SSLNetProcessor::ET_SSL;
+EventType         SSLNetProcessor::ET_SSL_HANDSHAKE;
+bool              SSLNetProcessor::handshake_offload = false;
 
 void
 SSLNetProcessor::cleanup(void)
@@ -50,7 +52,7 @@ SSLNetProcessor::start(int number_of_ssl_threads, size_t stacksize)
   SSLInitializeLibrary();
   SSLConfig::startup();
 
-  if (HttpProxyPort::hasSSL()) {
+  if (HttpProxyPort::hasSSL() && !defer_certificates) {
     SSLCertificateConfig::startup();
   }
 
@@ -70,6 +72,13 @@ SSLNetProcessor::start(int number_of_ssl_threads, size_t stacksize)
   }
 
   SSLNetProcessor::ET_SSL = eventProcessor.spawn_event_threads(number_of_ssl_threads, "ET_SSL", stacksize);
+
+  int number_of_handshake_threads = 0;
+  REC_ReadConfigInteger(number_of_handshake_threads, "proxy.config.ssl.handshake.threads");
+  if (number_of_handshake_threads > 0) {
+    SSLNetProcessor::ET_SSL_HANDSHAKE = eventProcessor.spawn_event_threads(number_of_handshake_threads, "ET_SSL_HANDSHAKE", stacksize);
+    SSLNetProcessor::handshake_offload = true;
+  }
   return UnixNetProcessor::start(0, stacksize);
 }
 
@@ -108,7 +117,7 @@ SSLNetProcessor::freeThread(UnixNetVConnection *vc, EThread *t)
 }
 
 SSLNetProcessor::SSLNetProcessor()
-  : client_ctx(NULL)
+  : client_ctx(NULL), defer_certificates(false)
 {
 }
 
@@ -39,10 +39,82 @@
 
 ClassAllocator<SSLNetVConnection> sslNetVCAllocator("sslNetVCAllocator");
 
+// Runs SSL_accept() for a connection on an ET_SSL_HANDSHAKE thread, so that the private key
+// operations of a handshake storm do not hold up established connections on the net threads.
+// When SSL_accept() returns, the job moves to the connection's own thread, takes the
+// NetHandler lock and puts the connection back on the ready lists to pick up the result.
+struct SSLHandShakeJob : public Continuation
+{
+  SSLNetVConnection * vc;
+  NetHandler * nh;
+
+  SSLHandShakeJob(SSLNetVConnection * _vc)
+    : Continuation(new_ProxyMutex()), vc(_vc), nh(_vc->nh)
+  {
+    SET_HANDLER(&SSLHandShakeJob::handShakeEvent);
+  }
+
+  int handShakeEvent(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
+  {
+    int err = 0;
+
+    vc->sslHandShakeResult = vc->sslServerHandShakeEvent(err);
+    vc->sslHandShakeErr = err;
+
+    mutex = nh->mutex;
+    SET_HANDLER(&SSLHandShakeJob::doneEvent);
+    vc->thread->schedule_imm(this);
+    return EVENT_DONE;
+  }
+
+  int doneEvent(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
+  {
+    vc->sslHandShakeResultReady = true;
+    vc->sslHandShakeJob = NULL;
+
+    // A connection closed meanwhile is freed from the ready list.
+    if (vc->write.enabled && !vc->read.enabled) {
+      vc->write.triggered = 1;
+      nh->write_ready_list.in_or_enqueue(vc);
+    } else {
+      vc->read.triggered = 1;
+      nh->read_ready_list.in_or_enqueue(vc);
+    }
+
+    delete this;
+    return EVENT_DONE;
+  }
+};
+
 //
 // Private
 //
 
+// Whether a handshake that stopped with ret can make progress right away. With edge
+// triggering, readiness that arrived while a job had the socket is not reported again.
+static bool
+ssl_handshake_can_continue(int fd, int ret)
+{
+  struct pollfd pfd;
+
+  switch (ret) {
+  case SSL_HANDSHAKE_WANT_READ:
+    pfd.events = POLLIN;
+    break;
+  case SSL_HANDSHAKE_WANT_WRITE:
+    pfd.events = POLLOUT;
+    break;
+  case EVENT_CONT:
+    return true;
+  default:
+    return false;
+  }
+
+  pfd.fd = fd;
+  pfd.revents = 0;
+  return socketManager.poll(&pfd, 1, 0) > 0;
+}
+
 static SSL *
 make_ssl_connection(SSL_CTX * ctx, SSLNetVConnection * netvc)
 {
@@ -51,6 +123,8 @@ make_ssl_connection(SSL_CTX * ctx, SSLNetVConnection * netvc)
   if (likely(ssl = SSL_new(ctx))) {
     SSL_set_fd(ssl, netvc->get_socket());
     SSL_set_app_data(ssl, netvc);
+    // A retried SSL_write() may come from the record gathering buffer on a different stack frame.
+    SSL_set_mode(ssl, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
   }
 
   return ssl;
@@ -220,6 +294,8 @@ SSLNetVConnection::net_read_io(NetHandler *nh, EThread *lthread)
     if (ret == EVENT_ERROR) {
       this->read.triggered = 0;
       readSignalError(nh, err);
+    } else if (ret == SSL_HANDSHAKE_OFFLOADED) {
+      // SSLHandShakeJob requeues us.
     } else if (ret == SSL_HANDSHAKE_WANT_READ || ret == SSL_HANDSHAKE_WANT_ACCEPT) {
       read.triggered = 0;
       nh->read_ready_list.remove(this);
@@ -325,12 +401,35 @@ SSLNetVConnection::net_read_io(NetHandler *nh, EThread *lthread)
 }
 
 
+// Return the size of the next TLS record, or 0 to write each buffer block as it is.
+int64_t
+SSLNetVConnection::sslRecordSize()
+{
+  if (SSLConfigParams::ssl_maxrecord >= 0) {
+    return SSLConfigParams::ssl_maxrecord;
+  }
+
+  // OpenSSL requires a blocked write to be retried with at least as many bytes, so hold the
+  // record size until it goes through.
+  if (!sslWriteBlocked) {
+    // TCP falls back to slow start after an idle period, so start with small records again.
+    if (sslLastWriteTime && ink_get_hrtime() - sslLastWriteTime > HRTIME_MSECONDS(SSL_DEF_TLS_RECORD_MSEC_THRESHOLD)) {
+      sslTotalBytesSent = 0;
+    }
+    sslCurrentRecordSize = sslTotalBytesSent < SSL_DEF_TLS_RECORD_BYTE_THRESHOLD ? SSL_DEF_TLS_RECORD_SIZE : SSL_MAX_TLS_RECORD_SIZE;
+  }
+
+  return sslCurrentRecordSize;
+}
+
 int64_t
 SSLNetVConnection::load_buffer_and_write(int64_t towrite, int64_t &wattempted, int64_t &total_wrote, MIOBufferAccessor & buf)
 {
   ProxyMutex *mutex = this_ethread()->mutex;
   int64_t r = 0;
   int64_t l = 0;
+  int64_t record_size = sslRecordSize();
+  char gather[SSL_MAX_TLS_RECORD_SIZE];
 
   // XXX Rather than dealing with the block directly, we should use the IOBufferReader API.
   int64_t offset = buf.reader()->start_offset;
@@ -352,20 +451,71 @@ SSLNetVConnection::load_buffer_and_write(int64_t towrite, int64_t &wattempted, i
       l = wavail;
     if (!l)
       break;
+
+    char * data = b->start() + offset;
+    int fd = NO_FD;
+    off_t foffset = 0;
+
+    if (b->data->is_file_backed()) {
+      // Only handed to us when sendfile_capable(). The kernel splits it into records.
+      ink_release_assert(sslKTLSSend);
+      fd = b->data->_fd;
+      foffset = b->data->_fd_offset + (b->start() - b->buf()) + offset;
+      offset = 0;
+      b = b->next;
+    } else if (record_size && l >= record_size) {
+      // Split a large block into records, staying on this block for the next one.
+      l = record_size;
+      offset += l;
+    } else if (record_size && l < wavail && b->next) {
+      // Gather the following blocks into this record rather than sending a short one for each.
+      memcpy(gather, data, l);
+      data = gather;
+      offset = 0;
+      b = b->next;
+      while (b && l < record_size && l < wavail) {
+        int64_t avail = b->read_avail();
+        int64_t n = MIN(avail, MIN(record_size, wavail) - l);
+
+        memcpy(gather + l, b->start(), n);
+        l += n;
+        if (n < avail) {
+          offset = n;
+          break;
+        }
+        b = b->next;
+      }
+    } else {
+      // on to the next block
+      offset = 0;
+      b = b->next;
+    }
+
     wattempted = l;
     total_wrote += l;
     Debug("ssl", "SSLNetVConnection::loadBufferAndCallWrite, before do_SSL_write, l=%" PRId64", towrite=%" PRId64", b=%p",
           l, towrite, b);
-    r = do_SSL_write(ssl, b->start() + offset, (int)l);
+#if TS_USE_TLS_KTLS
+    if (fd != NO_FD)
+      r = SSL_sendfile(ssl, fd, foffset, (size_t)l, 0);
+    else
+#endif
+      r = do_SSL_write(ssl, data, (int)l);
     if (r == l) {
       wattempted = total_wrote;
+      sslTotalBytesSent += r;
     }
-    // on to the next block
-    offset = 0;
-    b = b->next;
     Debug("ssl", "SSLNetVConnection::loadBufferAndCallWrite,Number of bytes written=%" PRId64" , total=%" PRId64"", r, total_wrote);
     NET_DEBUG_COUNT_DYN_STAT(net_calls_to_write_stat, 1);
   } while (r == l && total_wrote < towrite && b);
+
+  // Without SSL_MODE_ENABLE_PARTIAL_WRITE, SSL_write() either takes the whole record or fails.
+  // SSL_sendfile() may send part of a file block, but that leaves nothing pending to retry.
+  sslWriteBlocked = (r <= 0);
+  if (!sslWriteBlocked) {
+    sslLastWriteTime = ink_get_hrtime();
+  }
+
   if (r > 0) {
     if (total_wrote != wattempted) {
       Debug("ssl", "SSLNetVConnection::loadBufferAndCallWrite, wrote some bytes, but not all requested.");
@@ -411,7 +561,16 @@ SSLNetVConnection::SSLNetVConnection():
   sslHandShakeComplete(false),
   sslClientConnection(false),
   npnSet(NULL),
-  npnEndpoint(NULL)
+  npnEndpoint(NULL),
+  sslHandShakeJob(NULL),
+  sslHandShakeResultReady(false),
+  sslHandShakeResult(0),
+  sslHandShakeErr(0),
+  sslTotalBytesSent(0),
+  sslLastWriteTime(0),
+  sslCurrentRecordSize(0),
+  sslWriteBlocked(false),
+  sslKTLSSend(false)
 {
   ssl = NULL;
 }
@@ -433,14 +592,23 @@ SSLNetVConnection::free(EThread * t) {
   closed = 0;
   ink_assert(con.fd == NO_FD);
   if (ssl != NULL) {
-    /*if (sslHandShakeComplete)
-       SSL_set_shutdown(ssl, SSL_SENT_SHUTDOWN|SSL_RECEIVED_SHUTDOWN); */
+    // Without a recorded shutdown, SSL_free() treats the session as bad and evicts it
+    // from the session cache, so no client could ever resume.
+    if (sslHandShakeComplete)
+      SSL_set_shutdown(ssl, SSL_SENT_SHUTDOWN|SSL_RECEIVED_SHUTDOWN);
     SSL_free(ssl);
     ssl = NULL;
   }
   sslHandShakeComplete = false;
   sslClientConnection = false;
   npnSet = NULL;
+  ink_assert(sslHandShakeJob == NULL);
+  sslHandShakeResultReady = false;
+  sslTotalBytesSent = 0;
+  sslLastWriteTime = 0;
+  sslCurrentRecordSize = 0;
+  sslWriteBlocked = false;
+  sslKTLSSend = false;
 
   if (from_accept_thread) {
     sslNetVCAllocator.free(this);  
@@ -467,6 +635,10 @@ SSLNetVConnection::sslStartHandShake(int event, int &err)
       }
     }
 
+    if (SSLNetProcessor::handshake_offload) {
+      return sslOffloadHandShake(err);
+    }
+
     return sslServerHandShakeEvent(err);
   } else {
     ink_assert(event == SSL_EVENT_CLIENT);
@@ -479,6 +651,33 @@ SSLNetVConnection::sslStartHandShake(int event, int &err)
 
 }
 
+int
+SSLNetVConnection::sslOffloadHandShake(int &err)
+{
+  if (sslHandShakeJob) {
+    return SSL_HANDSHAKE_OFFLOADED;
+  }
+
+  if (sslHandShakeResultReady) {
+    sslHandShakeResultReady = false;
+
+    if (!ssl_handshake_can_continue(get_socket(), sslHandShakeResult)) {
+      err = sslHandShakeErr;
+      return sslHandShakeResult;
+    }
+  }
+
+  // The job reads until the socket would block, which consumes any pending read readiness. Write
+  // readiness is left alone; the socket usually stays writable and the edge will not fire again.
+  read.triggered = 0;
+  sslHandShakeJob = NEW(new SSLHandShakeJob(this));
+
+  ProxyMutex *mutex = this_ethread()->mutex;
+  NET_INCREMENT_DYN_STAT(ssl_handshakes_offloaded_stat);
+  eventProcessor.schedule_imm(sslHandShakeJob, SSLNetProcessor::ET_SSL_HANDSHAKE);
+  return SSL_HANDSHAKE_OFFLOADED;
+}
+
 int
 SSLNetVConnection::sslServerHandShakeEvent(int &err)
 {
@@ -512,12 +711,29 @@ SSLNetVConnection::sslServerHandShakeEvent(int &err)
     }
     sslHandShakeComplete = 1;
 
-#if TS_USE_TLS_NPN
+#if TS_USE_TLS_KTLS
+    sslKTLSSend = BIO_get_ktls_send(SSL_get_wbio(ssl));
+    if (sslKTLSSend) {
+      Debug("ssl", "kernel TLS transmit offload is enabled");
+      NET_INCREMENT_THREAD_DYN_STAT(ssl_ktls_send_stat, this_ethread());
+    }
+#endif
+
+#if TS_USE_TLS_NPN || TS_USE_TLS_ALPN
     {
       const unsigned char * proto = NULL;
       unsigned len = 0;
 
-      SSL_get0_next_proto_negotiated(ssl, &proto, &len);
+      // A client that offered ALPN never gets to NPN, so whichever of the two produced a
+      // protocol is the one that applies.
+#if TS_USE_TLS_ALPN
+      SSL_get0_alpn_selected(ssl, &proto, &len);
+#endif
+#if TS_USE_TLS_NPN
+      if (len == 0) {
+        SSL_get0_next_proto_negotiated(ssl, &proto, &len);
+      }
+#endif
       if (len) {
         if (this->npnSet) {
           this->npnEndpoint = this->npnSet->findEndpoint(proto, len);
@@ -528,7 +744,7 @@ SSLNetVConnection::sslServerHandShakeEvent(int &err)
         Debug("ssl", "client did not select a next protocol");
       }
     }
-#endif /* TS_USE_TLS_NPN */
+#endif /* TS_USE_TLS_NPN || TS_USE_TLS_ALPN */
 
     return EVENT_DONE;
 
@@ -643,3 +859,25 @@ SSLNetVConnection::advertise_next_protocol(SSL *ssl, const unsigned char **out,
 
   return SSL_TLSEXT_ERR_NOACK;
 }
+
+int
+SSLNetVConnection::select_next_protocol(SSL *ssl, const unsigned char **out, unsigned char *outlen,
+                                        const unsigned char *in, unsigned inlen, void * /*arg ATS_UNUSED */)
+{
+  SSLNetVConnection * netvc = (SSLNetVConnection *)SSL_get_app_data(ssl);
+  const unsigned char * npn = NULL;
+  unsigned npnsz = 0;
+
+  ink_release_assert(netvc != NULL);
+
+  // Our list is in order of preference, so we pick from it rather than from the client's.
+  if (netvc->npnSet && netvc->npnSet->advertiseProtocols(&npn, &npnsz)) {
+    if (SSL_select_next_proto((unsigned char **)out, outlen, npn, npnsz, in, inlen) == OPENSSL_NPN_NEGOTIATED) {
+      return SSL_TLSEXT_ERR_OK;
+    }
+  }
+
+  *out = NULL;
+  *outlen = 0;
+  return SSL_TLSEXT_ERR_NOACK;
+}
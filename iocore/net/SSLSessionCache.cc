@@ -0,0 +1,308 @@
+/** @file
+
+  A shared, sharded SSL session cache.
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#include "P_Net.h"
+#include "P_SSLConfig.h"
+#include "P_SSLSessionCache.h"
+
+#if (OPENSSL_VERSION_NUMBER >= 0x10100000L) // openssl passes a const session ID to the get callback
+typedef const unsigned char * ink_ssl_session_id_t;
+#else
+typedef unsigned char * ink_ssl_session_id_t;
+#endif
+
+SSLSessionCache * ssl_session_cache = NULL;
+
+SSLSessionBucket::SSLSessionBucket()
+  : mutex(new_ProxyMutex()), slots(NULL), nslots(0)
+{
+}
+
+SSLSessionBucket::~SSLSessionBucket()
+{
+  delete [] slots;
+}
+
+void
+SSLSessionBucket::init(unsigned n)
+{
+  nslots = n;
+  slots = new SSLSession[nslots];
+  for (unsigned i = 0; i < nslots; ++i) {
+    free.enqueue(&slots[i]);
+  }
+}
+
+SSLSession *
+SSLSessionBucket::find(const SSLSessionID& id, uint64_t h)
+{
+  for (SSLSession * s = lru.head; s; s = s->link.next) {
+    if (s->hash == h && s->session_id == id) {
+      return s;
+    }
+  }
+
+  return NULL;
+}
+
+bool
+SSLSessionBucket::get(const SSLSessionID& id, uint64_t h, SSL_SESSION ** sess, EThread * t)
+{
+  MUTEX_TRY_LOCK(lock, mutex, t);
+  if (!lock) {
+    NET_INCREMENT_THREAD_DYN_STAT(ssl_session_cache_lock_contention_stat, t);
+    return false;
+  }
+
+  SSLSession * s = find(id, h);
+  if (!s) {
+    return false;
+  }
+
+  const unsigned char * p = s->der;
+  *sess = d2i_SSL_SESSION(NULL, &p, s->der_len);
+  if (*sess == NULL) {
+    Debug("ssl.session_cache", "failed to decode a %u byte session", s->der_len);
+    lru.remove(s);
+    free.push(s);
+    return false;
+  }
+
+  if (lru.head != s) {
+    lru.remove(s);
+    lru.push(s);
+  }
+
+  return true;
+}
+
+bool
+SSLSessionBucket::insert(const SSLSessionID& id, uint64_t h, SSL_SESSION * sess, EThread * t)
+{
+  int len = i2d_SSL_SESSION(sess, NULL);
+  if (len <= 0 || len > SSL_SESSION_MAX_DER) {
+    Debug("ssl.session_cache", "not caching a %d byte session", len);
+    return false;
+  }
+
+  MUTEX_TRY_LOCK(lock, mutex, t);
+  if (!lock) {
+    NET_INCREMENT_THREAD_DYN_STAT(ssl_session_cache_lock_contention_stat, t);
+    return false;
+  }
+
+  SSLSession * s = find(id, h);
+  if (s) {
+    lru.remove(s);
+  } else if ((s = free.pop()) == NULL) {
+    s = lru.tail;
+    lru.remove(s);
+    NET_INCREMENT_THREAD_DYN_STAT(ssl_session_cache_eviction_stat, t);
+  }
+
+  unsigned char * p = s->der;
+  s->session_id = id;
+  s->hash = h;
+  s->der_len = i2d_SSL_SESSION(sess, &p);
+  lru.push(s);
+
+  return true;
+}
+
+void
+SSLSessionBucket::remove(const SSLSessionID& id, uint64_t h, EThread * t)
+{
+  // If we lose the race, OpenSSL rejects the stale entry again on its next lookup.
+  MUTEX_TRY_LOCK(lock, mutex, t);
+  if (!lock) {
+    NET_INCREMENT_THREAD_DYN_STAT(ssl_session_cache_lock_contention_stat, t);
+    return;
+  }
+
+  SSLSession * s = find(id, h);
+  if (s) {
+    lru.remove(s);
+    free.push(s);
+  }
+}
+
+SSLSessionCache::SSLSessionCache(unsigned nsessions, unsigned n)
+  : buckets(NULL), nbuckets(n ? n : 1)
+{
+  unsigned per_bucket = (nsessions + nbuckets - 1) / nbuckets;
+
+  buckets = new SSLSessionBucket[nbuckets];
+  for (unsigned i = 0; i < nbuckets; ++i) {
+    buckets[i].init(per_bucket ? per_bucket : 1);
+  }
+
+  Debug("ssl.session_cache", "created %u buckets of %u sessions", nbuckets, per_bucket);
+}
+
+SSLSessionCache::~SSLSessionCache()
+{
+  delete [] buckets;
+}
+
+SSL_SESSION *
+SSLSessionCache::get(const SSLSessionID& id)
+{
+  EThread * t = this_ethread();
+  SSL_SESSION * sess = NULL;
+  uint64_t h = id.hash();
+
+  if (bucket(h)->get(id, h, &sess, t)) {
+    Debug("ssl.session_cache", "hit in bucket %u", (unsigned)(h % nbuckets));
+    NET_INCREMENT_THREAD_DYN_STAT(ssl_session_cache_hit_stat, t);
+    return sess;
+  }
+
+  Debug("ssl.session_cache", "miss in bucket %u", (unsigned)(h % nbuckets));
+  NET_INCREMENT_THREAD_DYN_STAT(ssl_session_cache_miss_stat, t);
+  return NULL;
+}
+
+void
+SSLSessionCache::insert(const SSLSessionID& id, SSL_SESSION * sess)
+{
+  EThread * t = this_ethread();
+  uint64_t h = id.hash();
+
+  if (bucket(h)->insert(id, h, sess, t)) {
+    Debug("ssl.session_cache", "inserted into bucket %u", (unsigned)(h % nbuckets));
+    NET_INCREMENT_THREAD_DYN_STAT(ssl_session_cache_new_session_stat, t);
+  }
+}
+
+void
+SSLSessionCache::remove(const SSLSessionID& id)
+{
+  uint64_t h = id.hash();
+  bucket(h)->remove(id, h, this_ethread());
+}
+
+static int
+ssl_new_cached_session(SSL * /* ssl ATS_UNUSED */, SSL_SESSION * sess)
+{
+  unsigned int len = 0;
+  const unsigned char * id = SSL_SESSION_get_id(sess, &len);
+
+  ssl_session_cache->insert(SSLSessionID(id, len), sess);
+
+  // We stored an encoded copy, so OpenSSL keeps its reference.
+  return 0;
+}
+
+static SSL_SESSION *
+ssl_get_cached_session(SSL * /* ssl ATS_UNUSED */, ink_ssl_session_id_t id, int len, int * copy)
+{
+  // The session we return is freshly decoded and OpenSSL now owns its only reference.
+  *copy = 0;
+  return ssl_session_cache->get(SSLSessionID(id, len));
+}
+
+static void
+ssl_rm_cached_session(SSL_CTX * /* ctx ATS_UNUSED */, SSL_SESSION * sess)
+{
+  unsigned int len = 0;
+  const unsigned char * id = SSL_SESSION_get_id(sess, &len);
+
+  ssl_session_cache->remove(SSLSessionID(id, len));
+}
+
+void
+SSLInitSessionCache(const SSLConfigParams * params)
+{
+  if (params->ssl_session_cache != SSLConfigParams::SSL_SESSION_CACHE_MODE_SERVER_ATS_IMPL || ssl_session_cache) {
+    return;
+  }
+
+  ssl_session_cache = NEW(new SSLSessionCache(params->ssl_session_cache_size, params->ssl_session_cache_num_buckets));
+}
+
+void
+SSLSessionCacheAttach(SSL_CTX * ctx)
+{
+  ink_release_assert(ssl_session_cache != NULL);
+
+  SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER | SSL_SESS_CACHE_NO_INTERNAL);
+  SSL_CTX_sess_set_new_cb(ctx, ssl_new_cached_session);
+  SSL_CTX_sess_set_get_cb(ctx, ssl_get_cached_session);
+  SSL_CTX_sess_set_remove_cb(ctx, ssl_rm_cached_session);
+}
+
+#if TS_HAS_TESTS && (OPENSSL_VERSION_NUMBER >= 0x10101000L) // for SSL_SESSION_set1_id and SSL_SESSION_set_cipher
+#include "ts/TestBox.h"
+
+REGRESSION_TEST(SSLSessionCache)(RegressionTest * t, int /* atype ATS_UNUSED */, int * pstatus)
+{
+  TestBox box(t, pstatus);
+  SSLSessionCache cache(4, 2); // two buckets of two slots
+  unsigned char ids[5][SSL_MAX_SSL_SESSION_ID_LENGTH];
+
+  box = REGRESSION_TEST_PASSED;
+
+  SSLInitializeLibrary();
+
+  // OpenSSL will not encode a session without a protocol version and a cipher, so borrow one
+  // from a default context.
+  SSL_CTX * ctx = SSLDefaultServerContext();
+  SSL * ssl = SSL_new(ctx);
+  const SSL_CIPHER * cipher = sk_SSL_CIPHER_value(SSL_get_ciphers(ssl), 0);
+
+  for (unsigned i = 0; i < countof(ids); ++i) {
+    memset(ids[i], 0, sizeof(ids[i]));
+    ids[i][0] = i * 2; // an even first byte and a zero tail always hashes to bucket 0
+  }
+
+  for (unsigned i = 0; i < countof(ids); ++i) {
+    SSL_SESSION * sess = SSL_SESSION_new();
+    SSL_SESSION_set1_id(sess, ids[i], sizeof(ids[i]));
+    SSL_SESSION_set_protocol_version(sess, TLS1_2_VERSION);
+    SSL_SESSION_set_cipher(sess, cipher);
+    cache.insert(SSLSessionID(ids[i], sizeof(ids[i])), sess);
+    SSL_SESSION_free(sess);
+  }
+
+  // Every id lands in the same bucket, so only the two most recent survive.
+  for (unsigned i = 0; i < countof(ids); ++i) {
+    SSL_SESSION * sess = cache.get(SSLSessionID(ids[i], sizeof(ids[i])));
+    bool expected = (i >= countof(ids) - 2);
+
+    box.check((sess != NULL) == expected, "session %u: expected %s", i, expected ? "a hit" : "a miss");
+    if (sess) {
+      unsigned int len = 0;
+      const unsigned char * id = SSL_SESSION_get_id(sess, &len);
+      box.check(len == sizeof(ids[i]) && memcmp(id, ids[i], len) == 0, "session %u: decoded the wrong session", i);
+      SSL_SESSION_free(sess);
+    }
+  }
+
+  cache.remove(SSLSessionID(ids[4], sizeof(ids[4])));
+  box.check(cache.get(SSLSessionID(ids[4], sizeof(ids[4]))) == NULL, "removed session is still cached");
+
+  SSL_free(ssl);
+  SSL_CTX_free(ctx);
+}
+
+#endif
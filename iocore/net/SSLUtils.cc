@@ -23,12 +23,16 @@
 #include "libts.h"
 #include "I_Layout.h"
 #include "P_Net.h"
+#include "P_SSLSessionCache.h"
 
 #include <openssl/err.h>
 #include <openssl/bio.h>
 #include <openssl/pem.h>
 #include <openssl/x509.h>
 #include <openssl/asn1.h>
+#include <openssl/rand.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
 
 #if HAVE_OPENSSL_TS_H
 #include <openssl/ts.h>
@@ -46,9 +50,30 @@ typedef const SSL_METHOD * ink_ssl_method_t;
 typedef SSL_METHOD * ink_ssl_method_t;
 #endif
 
+// One key from the session ticket key file: a 16 byte key name, a 16 byte HMAC secret and a
+// 16 byte AES key, in that order. "openssl rand 48" makes a suitable key.
+struct ssl_ticket_key_t
+{
+  unsigned char key_name[16];
+  unsigned char hmac_secret[16];
+  unsigned char aes_key[16];
+};
+
+// The keys from the session ticket key file. The first key encrypts new tickets, and every key
+// decrypts, so rotating means prepending a new key and keeping the old ones for a while.
+struct ssl_ticket_key_block
+{
+  unsigned          num_keys;
+  ssl_ticket_key_t  keys[1];
+};
+
 static ProxyMutex ** sslMutexArray;
 static bool open_ssl_initialized = false;
 
+#if TS_USE_TLS_TICKETS
+static int ssl_session_ticket_index = -1;
+#endif
+
 struct ats_file_bio
 {
     ats_file_bio(const char * path, const char * mode)
@@ -185,6 +210,125 @@ ssl_context_enable_sni(SSL_CTX * ctx, SSLCertLookup * lookup)
   return ctx;
 }
 
+#if TS_USE_TLS_TICKETS
+
+static size_t
+ssl_ticket_keyblock_size(unsigned num_keys)
+{
+  return sizeof(ssl_ticket_key_block) + (num_keys - 1) * sizeof(ssl_ticket_key_t);
+}
+
+static ssl_ticket_key_block *
+ssl_create_ticket_keyblock(const char * ticket_key_path)
+{
+  ssl_ticket_key_block * keyblock;
+  xptr<char> ticket_key_data;
+  int ticket_key_len = 0;
+  unsigned num_keys;
+
+  ticket_key_data = readIntoBuffer(ticket_key_path, __func__, &ticket_key_len);
+  if (!ticket_key_data) {
+    Error("failed to read SSL session ticket key from %s", ticket_key_path);
+    return NULL;
+  }
+
+  num_keys = ticket_key_len / sizeof(ssl_ticket_key_t);
+  if (num_keys == 0 || ticket_key_len % sizeof(ssl_ticket_key_t) != 0) {
+    Error("SSL session ticket key file %s must hold a multiple of %u bytes, not %d",
+        ticket_key_path, (unsigned)sizeof(ssl_ticket_key_t), ticket_key_len);
+    return NULL;
+  }
+
+  keyblock = (ssl_ticket_key_block *)ats_malloc(ssl_ticket_keyblock_size(num_keys));
+  keyblock->num_keys = num_keys;
+  memcpy(keyblock->keys, (const char *)ticket_key_data, num_keys * sizeof(ssl_ticket_key_t));
+
+  Debug("ssl", "loaded %u session ticket keys from %s", num_keys, ticket_key_path);
+  return keyblock;
+}
+
+static void
+ssl_free_ticket_keyblock(void * /* parent ATS_UNUSED */, void * ptr, CRYPTO_EX_DATA * /* ad ATS_UNUSED */,
+    int /* idx ATS_UNUSED */, long /* argl ATS_UNUSED */, void * /* argp ATS_UNUSED */)
+{
+  ats_free(ptr);
+}
+
+// RFC 5077 ticket callback. enc is 1 when we issue a ticket and 0 when a client presents one. For a
+// decryption, return 2 when the ticket was made with an older key so that OpenSSL reissues it with
+// the current key, and 0 when we don't have the key at all, which falls back to a full handshake.
+static int
+ssl_callback_session_ticket(SSL * ssl, unsigned char * keyname, unsigned char * iv, EVP_CIPHER_CTX * cipher_ctx,
+    HMAC_CTX * hctx, int enc)
+{
+  // Every context from the same configuration carries the same keys, so it does not matter
+  // whether SNI has switched the context yet.
+  ssl_ticket_key_block * keyblock = (ssl_ticket_key_block *)SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), ssl_session_ticket_index);
+  EThread * t = this_ethread();
+
+  if (keyblock == NULL) {
+    return 0;
+  }
+
+  if (enc == 1) {
+    const ssl_ticket_key_t& key = keyblock->keys[0];
+
+    if (RAND_bytes(iv, EVP_MAX_IV_LENGTH) <= 0) {
+      return -1;
+    }
+
+    memcpy(keyname, key.key_name, sizeof(key.key_name));
+    EVP_EncryptInit_ex(cipher_ctx, EVP_aes_128_cbc(), NULL, key.aes_key, iv);
+    HMAC_Init_ex(hctx, key.hmac_secret, sizeof(key.hmac_secret), EVP_sha256(), NULL);
+
+    NET_INCREMENT_THREAD_DYN_STAT(ssl_total_tickets_created_stat, t);
+    return 1;
+  }
+
+  for (unsigned i = 0; i < keyblock->num_keys; ++i) {
+    const ssl_ticket_key_t& key = keyblock->keys[i];
+
+    if (memcmp(keyname, key.key_name, sizeof(key.key_name)) == 0) {
+      EVP_DecryptInit_ex(cipher_ctx, EVP_aes_128_cbc(), NULL, key.aes_key, iv);
+      HMAC_Init_ex(hctx, key.hmac_secret, sizeof(key.hmac_secret), EVP_sha256(), NULL);
+
+      if (i == 0) {
+        NET_INCREMENT_THREAD_DYN_STAT(ssl_total_tickets_verified_stat, t);
+        return 1;
+      }
+
+      NET_INCREMENT_THREAD_DYN_STAT(ssl_total_tickets_renewed_stat, t);
+      return 2;
+    }
+  }
+
+  NET_INCREMENT_THREAD_DYN_STAT(ssl_total_tickets_not_found_stat, t);
+  return 0;
+}
+
+#endif /* TS_USE_TLS_TICKETS */
+
+// Give ctx its own copy of the session ticket keys, since the context can outlive the
+// configuration that loaded it. Without keys, OpenSSL makes up random keys for each context.
+static SSL_CTX *
+ssl_context_enable_tickets(SSL_CTX * ctx, const ssl_ticket_key_block * keyblock)
+{
+#if TS_USE_TLS_TICKETS
+  if (ctx && keyblock) {
+    size_t len = ssl_ticket_keyblock_size(keyblock->num_keys);
+    ssl_ticket_key_block * copy = (ssl_ticket_key_block *)ats_malloc(len);
+
+    memcpy(copy, keyblock, len);
+    SSL_CTX_set_ex_data(ctx, ssl_session_ticket_index, copy);
+    SSL_CTX_set_tlsext_ticket_key_cb(ctx, ssl_callback_session_ticket);
+  }
+#else
+  (void)keyblock;
+#endif /* TS_USE_TLS_TICKETS */
+
+  return ctx;
+}
+
 void
 SSLInitializeLibrary()
 {
@@ -202,6 +346,10 @@ SSLInitializeLibrary()
 
     CRYPTO_set_locking_callback(SSL_locking_callback);
     CRYPTO_set_id_callback(SSL_pthreads_thread_id);
+
+#if TS_USE_TLS_TICKETS
+    ssl_session_ticket_index = SSL_CTX_get_ex_new_index(0, NULL, NULL, NULL, ssl_free_ticket_keyblock);
+#endif
   }
 
   open_ssl_initialized = true;
@@ -303,6 +451,14 @@ SSLInitServerContext(
   // disable selected protocols
   SSL_CTX_set_options(ctx, params->ssl_ctx_options);
 
+#if TS_USE_TLS_KTLS
+  // OpenSSL hands the keys to the kernel after the handshake if the kernel supports the
+  // negotiated cipher, and otherwise keeps encrypting in user space.
+  if (params->ssl_ktls_enabled) {
+    SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+  }
+#endif
+
   switch (params->ssl_session_cache) {
   case SSLConfigParams::SSL_SESSION_CACHE_MODE_OFF:
     SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF|SSL_SESS_CACHE_NO_INTERNAL);
@@ -311,6 +467,9 @@ SSLInitServerContext(
     SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
     SSL_CTX_sess_set_cache_size(ctx, params->ssl_session_cache_size);
     break;
+  case SSLConfigParams::SSL_SESSION_CACHE_MODE_SERVER_ATS_IMPL:
+    SSLSessionCacheAttach(ctx);
+    break;
   }
 
   SSL_CTX_set_quiet_shutdown(ctx, 1);
@@ -548,12 +707,14 @@ ssl_store_ssl_context(
     xptr<char>& addr,
     xptr<char>& cert,
     xptr<char>& ca,
-    xptr<char>& key)
+    xptr<char>& key,
+    const ssl_ticket_key_block * keyblock)
 {
   SSL_CTX *   ctx;
   xptr<char>  certpath;
 
   ctx = ssl_context_enable_sni(SSLInitServerContext(params, cert, ca, key), lookup);
+  ctx = ssl_context_enable_tickets(ctx, keyblock);
   if (!ctx) {
     return false;
   }
@@ -562,6 +723,10 @@ ssl_store_ssl_context(
   SSL_CTX_set_next_protos_advertised_cb(ctx, SSLNetVConnection::advertise_next_protocol, NULL);
 #endif /* TS_USE_TLS_NPN */
 
+#if TS_USE_TLS_ALPN
+  SSL_CTX_set_alpn_select_cb(ctx, SSLNetVConnection::select_next_protocol, NULL);
+#endif /* TS_USE_TLS_ALPN */
+
   certpath = Layout::relative_to(params->serverCertPathOnly, cert);
 
   // Index this certificate by the specified IP(v6) address. If the address is "*", make it the default context.
@@ -645,6 +810,7 @@ SSLParseCertificateConfiguration(
 
   bool alarmAlready = false;
   char errBuf[1024];
+  ssl_ticket_key_block * keyblock = NULL;
 
   const matcher_tags sslCertTags = {
     NULL, NULL, NULL, NULL, NULL, NULL, false
@@ -661,6 +827,16 @@ SSLParseCertificateConfiguration(
     return false;
   }
 
+  // The ticket keys are reread along with the certificates, so a new key takes effect when
+  // ssl_multicert.config is reloaded.
+  if (params->ticketKeyFilename) {
+#if TS_USE_TLS_TICKETS
+    keyblock = ssl_create_ticket_keyblock(params->ticketKeyFilename);
+#else
+    Warning("ignoring %s, this OpenSSL does not support session ticket keys", params->ticketKeyFilename);
+#endif
+  }
+
   line = tokLine(file_buf, &tok_state);
   while (line != NULL) {
 
@@ -686,7 +862,7 @@ SSLParseCertificateConfiguration(
         REC_SignalError(errBuf, alarmAlready);
       } else {
         if (ssl_extract_certificate(&line_info, addr, cert, ca, key)) {
-          if (!ssl_store_ssl_context(params, lookup, addr, cert, ca, key)) {
+          if (!ssl_store_ssl_context(params, lookup, addr, cert, ca, key, keyblock)) {
             Error("failed to load SSL certificate specification from %s line %u",
                 params->configFilePath, line_num);
           }
@@ -706,9 +882,10 @@ SSLParseCertificateConfiguration(
   // bootstrap the SSL handshake so that we can subsequently do the SNI lookup to switch to the real
   // context.
   if (lookup->ssl_default == NULL) {
-    lookup->ssl_default = ssl_context_enable_sni(SSLDefaultServerContext(), lookup);
+    lookup->ssl_default = ssl_context_enable_tickets(ssl_context_enable_sni(SSLDefaultServerContext(), lookup), keyblock);
     lookup->insert(lookup->ssl_default, "*");
   }
 
+  ats_free(keyblock);
   return true;
 }
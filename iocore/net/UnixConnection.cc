@@ -298,6 +298,22 @@ Connection::open(NetVCOptions const& opt)
   // apply dynamic options
   apply_options(opt);
 
+  // These only take effect if set before the connect.
+  if (SOCK_STREAM == sock_type) {
+#ifdef TCP_FASTOPEN_CONNECT
+    if (opt.sockopt_flags & NetVCOptions::SOCK_OPT_TCP_FAST_OPEN) {
+      safe_setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, SOCKOPT_ON, sizeof(int));
+      Debug("socket", "::open: setsockopt() TCP_FASTOPEN_CONNECT on socket");
+    }
+#endif
+#ifdef TCP_DEFER_ACCEPT
+    if (opt.sockopt_flags & NetVCOptions::SOCK_OPT_DEFER_ACCEPT) {
+      safe_setsockopt(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, SOCKOPT_ON, sizeof(int));
+      Debug("socket", "::open: setsockopt() TCP_DEFER_ACCEPT on socket");
+    }
+#endif
+  }
+
   if(local_addr.port() || !is_any_address) {
     if (-1 == socketManager.ink_bind(fd, &local_addr.sa, ats_ip_size(&local_addr.sa)))
       return -errno;
@@ -375,3 +391,15 @@ Connection::apply_options(NetVCOptions const& opt)
 #endif
 
 }
+
+bool
+Connection::syn_data_acked() const
+{
+#if defined(TCP_INFO) && defined(TCPI_OPT_SYN_DATA)
+  struct tcp_info info;
+  socklen_t len = sizeof(info);
+  if (fd != NO_FD && 0 == getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &len))
+    return info.tcpi_options & TCPI_OPT_SYN_DATA;
+#endif
+  return false;
+}
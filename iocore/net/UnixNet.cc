@@ -35,9 +35,23 @@ extern "C" void fd_reify(struct ev_loop *);
 
 
 #ifndef INACTIVITY_TIMEOUT
+#if TS_USE_TIMER_WHEEL
+// Have the inactivity wheel come back to vc on its next tick whatever
+// happens to it now.
+static inline void
+inactivity_wheel_retry(NetHandler *nh, UnixNetVConnection *vc, ink_hrtime now)
+{
+  if (vc->wheel_slot == TIMER_WHEEL_NO_SLOT) {
+    vc->wheel_at = now + INACTIVITY_COP_PERIOD;
+    nh->inactivity_wheel.insert(vc);
+  }
+}
+#endif
+
 // INKqa10496
 // One Inactivity cop runs on each thread once every second and
 // loops through the list of NetVCs and calls the timeouts
+// With timer wheels it only looks at the NetVCs whose timeouts are due.
 struct InactivityCop : public Continuation {
   InactivityCop(ProxyMutex *m):Continuation(m) {
     SET_HANDLER(&InactivityCop::check_inactivity);
@@ -46,16 +60,32 @@ struct InactivityCop : public Continuation {
     (void) event;
     ink_hrtime now = ink_get_hrtime();
     NetHandler *nh = get_NetHandler(this_ethread());
+#if TS_USE_TIMER_WHEEL
+    Queue<UnixNetVConnection, UnixNetVConnection::Link_inactivity_wheel> expired;
+    nh->inactivity_wheel.expire(now, expired);
+    while (UnixNetVConnection *vc = expired.dequeue())
+      nh->cop_list.push(vc);
+    SList(UnixNetVConnection, requeue_link) rq(nh->inactivity_requeue_list.popall());
+    while (UnixNetVConnection *vc = rq.pop()) {
+      vc->in_requeue_list = 0;
+      if (!nh->cop_list.in(vc))
+        nh->cop_list.push(vc);
+    }
+#else
     // Copy the list and use pop() to catch any closes caused by callbacks.
     forl_LL(UnixNetVConnection, vc, nh->open_list) {
       if (vc->thread == this_ethread())
         nh->cop_list.push(vc);
     }
+#endif
     while (UnixNetVConnection *vc = nh->cop_list.pop()) {
       // If we cannot ge tthe lock don't stop just keep cleaning
       MUTEX_TRY_LOCK(lock, vc->mutex, this_ethread());
       if (!lock.lock_acquired) {
        NET_INCREMENT_DYN_STAT(inactivity_cop_lock_acquire_failure_stat);
+#if TS_USE_TIMER_WHEEL
+       inactivity_wheel_retry(nh, vc, now);
+#endif
        continue;
       }
 
@@ -63,6 +93,16 @@ struct InactivityCop : public Continuation {
         close_UnixNetVConnection(vc, e->ethread);
         continue;
       } 
+#if TS_USE_TIMER_WHEEL
+      if (vc->next_inactivity_timeout_at >= now) {
+        vc->update_inactivity_wheel();
+        continue;
+      }
+      // in case the timeout can't be delivered now, the callback can
+      // still close or reschedule it
+      if (vc->next_inactivity_timeout_at)
+        inactivity_wheel_retry(nh, vc, now);
+#endif
       if (vc->next_inactivity_timeout_at && vc->next_inactivity_timeout_at < now)
         vc->handleEvent(EVENT_IMMEDIATE, e);
     }
@@ -197,7 +237,7 @@ initialize_thread_for_net(EThread *thread)
 
 #ifndef INACTIVITY_TIMEOUT
   InactivityCop *inactivityCop = NEW(new InactivityCop(get_NetHandler(thread)->mutex));
-  thread->schedule_every(inactivityCop, HRTIME_SECONDS(1));
+  thread->schedule_every(inactivityCop, INACTIVITY_COP_PERIOD);
 #endif
 
   thread->signal_hook = net_signal_hook_function;
@@ -215,6 +255,9 @@ initialize_thread_for_net(EThread *thread)
 NetHandler::NetHandler():Continuation(NULL), trigger_event(0)
 {
   SET_HANDLER((NetContHandler) & NetHandler::startNetEvent);
+#if !defined(INACTIVITY_TIMEOUT) && TS_USE_TIMER_WHEEL
+  inactivity_wheel.init(INACTIVITY_COP_PERIOD, ink_get_hrtime());
+#endif
 }
 
 //
@@ -278,11 +321,27 @@ NetHandler::mainNetEvent(int event, Event *e)
   process_enabled_list(this);
   if (likely(!read_ready_list.empty() || !write_ready_list.empty() || !read_enable_list.empty() || !write_enable_list.empty()))
     poll_timeout = 0; // poll immediately returns -- we have triggered stuff to process right now
-  else
+  else {
     poll_timeout = net_config_poll_timeout;
+    if (net_config_adaptive_poll_timeout) {
+      // don't sleep past the next timed event on this thread, it would be
+      // late by up to a whole poll timeout otherwise
+      ink_hrtime next = trigger_event->ethread->EventQueue.earliest_timeout() - ink_get_based_hrtime_internal();
+      if (next < poll_timeout * HRTIME_MSECOND)
+        poll_timeout = next > 0 ? (int) (next / HRTIME_MSECOND) : 0;
+    }
+  }
+
+  // let other threads know they have to wake us for new events, or find
+  // that one came in while we were busy and don't block at all
+  ProtectedQueue &external = trigger_event->ethread->EventQueueExternal;
+  if (poll_timeout && !external.prepare_to_sleep())
+    poll_timeout = 0;
 
   PollDescriptor *pd = get_PollDescriptor(trigger_event->ethread);
   UnixNetVConnection *vc = NULL;
+  // the poll is where a net thread sleeps, count it as idle for the thread load
+  ink_hrtime poll_start = poll_timeout ? ink_get_hrtime_internal() : 0;
 #if TS_USE_EPOLL
   pd->result = epoll_wait(pd->epoll_fd, pd->ePoll_Triggered_Events, POLL_DESCRIPTOR_SIZE, poll_timeout);
   NetDebug("iocore_net_main_poll", "[NetHandler::mainNetEvent] epoll_wait(%d,%d), result=%d", pd->epoll_fd,poll_timeout,pd->result);
@@ -323,6 +382,12 @@ NetHandler::mainNetEvent(int event, Event *e)
 #else
 #error port me
 #endif
+  external.done_sleeping();
+  if (poll_timeout)
+    trigger_event->ethread->idle_time += ink_get_hrtime_internal() - poll_start;
+
+  if (pd->result > 0)
+    NET_SUM_DYN_STAT(net_poll_events_stat, pd->result);
 
   vc = NULL;
   for (int x = 0; x < pd->result; x++) {
@@ -103,7 +103,7 @@ net_accept(NetAccept * na, void *ep, bool blockable)
     if ((res = na->server.accept(&vc->con)) < 0) {
       if (res == -EAGAIN || res == -ECONNABORTED || res == -EPIPE)
         goto Ldone;
-      if (na->server.fd != NO_FD && !na->action_->cancelled) {
+      if (na->server.fd != NO_FD && !na->action_->cancelled && !na->action_->stopped) {
         if (!blockable)
           na->action_->continuation->handleEvent(EVENT_ERROR, (void *)(intptr_t)res);
         else {
@@ -116,6 +116,8 @@ net_accept(NetAccept * na, void *ep, bool blockable)
     }
     count++;
     na->alloc_cache = NULL;
+    if (na->tcp_fastopen && vc->con.syn_data_acked())
+      NET_INCREMENT_THREAD_DYN_STAT(net_tcp_fastopen_accepted_stat, e->ethread);
 
     vc->submit_time = ink_get_hrtime();
     ats_ip_copy(&vc->server_addr, &vc->con.addr);
@@ -129,7 +131,7 @@ net_accept(NetAccept * na, void *ep, bool blockable)
       vc->handleEvent(EVENT_NONE, e);
     else
       eventProcessor.schedule_imm(vc, na->etype);
-  } while (loop);
+  } while (loop && (na->accept_batch_size <= 0 || count < na->accept_batch_size));
 
 Ldone:
   if (!blockable)
@@ -226,6 +228,8 @@ NetAccept::init_accept_per_thread()
     if (i < n - 1) {
       a = NEW(new NetAccept);
       *a = *this;
+      if (server.f_reuse_port)
+        a->do_listen_reuse_port();
     } else
       a = this;
     EThread *t = eventProcessor.eventthread[ET_NET][i];
@@ -253,7 +257,11 @@ NetAccept::do_listen(bool non_blocking, bool transparent)
   Lretry:
     if ((res = server.listen(non_blocking, recv_bufsize, send_bufsize, transparent)))
       Warning("unable to listen on port %d: %d %d, %s", ntohs(server.accept_addr.port()), res, errno, strerror(errno));
+    else
+      action_->own_socket = true;
   }
+  if (!res)
+    set_inherited_sockopts();
   if (callback_on_open && !action_->cancelled) {
     if (res)
       action_->continuation->handleEvent(NET_EVENT_ACCEPT_FAILED, this);
@@ -265,6 +273,101 @@ NetAccept::do_listen(bool non_blocking, bool transparent)
 }
 
 
+//
+// Give this (copied) NetAccept its own listen socket bound to the same
+// address with SO_REUSEPORT, so that the kernel balances new connections
+// across the per thread sockets instead of every thread waking up on a
+// shared one. If the socket can't be bound (e.g. the shared socket was not
+// created with SO_REUSEPORT) we keep using the shared socket.
+//
+int
+NetAccept::do_listen_reuse_port()
+{
+  int shared_fd = server.fd;
+  int res;
+
+  server.fd = NO_FD;
+  if ((res = server.listen(NON_BLOCKING, recv_bufsize, send_bufsize, server.f_inbound_transparent))) {
+    Warning("unable to listen with SO_REUSEPORT on port %d: %d, sharing the listen socket",
+            ntohs(server.accept_addr.port()), res);
+    server.fd = shared_fd;
+    server.f_reuse_port = false;
+    return res;
+  }
+  Debug("iocore_net_accept", "listening with SO_REUSEPORT on fd %d for port %d", server.fd,
+        ntohs(server.accept_addr.port()));
+  set_inherited_sockopts();
+  set_listen_sockopts();
+  return 0;
+}
+
+
+//
+// Per connection options that accepted sockets pick up from the listen
+// socket (see ACCEPT_INHERITS_SOCKOPTS). The buffer sizes are already set
+// by Server::setup_fd_for_listen().
+//
+void
+NetAccept::set_inherited_sockopts()
+{
+#if ACCEPT_INHERITS_SOCKOPTS
+  if (sockopt_flags & 1) {
+    safe_setsockopt(server.fd, IPPROTO_TCP, TCP_NODELAY, SOCKOPT_ON, sizeof(int));
+    Debug("socket", "::set_inherited_sockopts: setsockopt() TCP_NODELAY on listen socket");
+  }
+  if (sockopt_flags & 2) {
+    safe_setsockopt(server.fd, SOL_SOCKET, SO_KEEPALIVE, SOCKOPT_ON, sizeof(int));
+    Debug("socket", "::set_inherited_sockopts: setsockopt() SO_KEEPALIVE on listen socket");
+  }
+#if TS_HAS_SO_MARK
+  if (packet_mark != 0) {
+    safe_setsockopt(server.fd, SOL_SOCKET, SO_MARK, reinterpret_cast<char *>(&packet_mark), sizeof(uint32_t));
+  }
+#endif
+#if TS_HAS_IP_TOS
+  if (packet_tos != 0) {
+    safe_setsockopt(server.fd, IPPROTO_IP, IP_TOS, reinterpret_cast<char *>(&packet_tos), sizeof(uint32_t));
+  }
+#endif
+#endif
+}
+
+
+//
+// Socket options for a listen socket which has been bound and is listening.
+//
+void
+NetAccept::set_listen_sockopts()
+{
+#ifdef TCP_DEFER_ACCEPT
+  // set tcp defer accept timeout if it is configured, this will not trigger an accept until there is
+  // data on the socket ready to be read
+  if (defer_accept > 0) {
+    setsockopt(server.fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &defer_accept, sizeof(int));
+  }
+#endif
+#ifdef TCP_FASTOPEN
+  if (tcp_fastopen) {
+    int qlen = 0;
+    REC_ReadConfigInteger(qlen, "proxy.config.net.tcp_fastopen_queue_size");
+    if (qlen > 0 && setsockopt(server.fd, IPPROTO_TCP, TCP_FASTOPEN, &qlen, sizeof(int)) != 0) {
+      Error("Cannot enable TCP Fast Open on port %d: %s", ntohs(server.accept_addr.port()), strerror(errno));
+    }
+  }
+#endif
+#ifdef TCP_INIT_CWND
+ int tcp_init_cwnd = 0;
+ REC_ReadConfigInteger(tcp_init_cwnd, "proxy.config.http.server_tcp_init_cwnd");
+ if(tcp_init_cwnd > 0) {
+    Debug("net", "Setting initial congestion window to %d", tcp_init_cwnd);
+    if(setsockopt(server.fd, IPPROTO_TCP, TCP_INIT_CWND, &tcp_init_cwnd, sizeof(int)) != 0) {
+      Error("Cannot set initial congestion window to %d", tcp_init_cwnd);
+    }
+ }
+#endif
+}
+
+
 int
 NetAccept::do_blocking_accept(EThread * t)
 {
@@ -299,6 +402,8 @@ NetAccept::do_blocking_accept(EThread * t)
 
     if ((res = server.accept(&vc->con)) < 0) {
     Lerror:
+      if (action_->stopped)     // shut down by NetProcessor::stop_accept()
+        return -1;
       int seriousness = accept_error_seriousness(res);
       if (seriousness >= 0) {   // not so bad
         if (!seriousness)       // bad enough to warn about
@@ -316,6 +421,8 @@ NetAccept::do_blocking_accept(EThread * t)
     }
     check_emergency_throttle(vc->con);
     alloc_cache = NULL;
+    if (tcp_fastopen && vc->con.syn_data_acked())
+      NET_SUM_GLOBAL_DYN_STAT(net_tcp_fastopen_accepted_stat, 1);
 
     NET_SUM_GLOBAL_DYN_STAT(net_connections_currently_open_stat, 1);
     vc->submit_time = now;
@@ -352,6 +459,8 @@ NetAccept::acceptEvent(int event, void *ep)
       delete this;
       return EVENT_DONE;
     }
+    if (action_->stopped)
+      return stop_accept(e);
 
     //ink_assert(ifd < 0 || event == EVENT_INTERVAL || (pd->nfds > ifd && pd->pfd[ifd].fd == server.fd));
     //if (ifd < 0 || event == EVENT_INTERVAL || (pd->pfd[ifd].revents & (POLLIN | POLLERR | POLLHUP | POLLNVAL))) {
@@ -382,11 +491,24 @@ NetAccept::acceptFastEvent(int event, void *ep)
   Event *e = (Event *) ep;
   (void) event;
   (void) e;
-  int bufsz, res;
+  int res;
 
   PollDescriptor *pd = get_PollDescriptor(e->ethread);
   UnixNetVConnection *vc = NULL;
   int loop = accept_till_done;
+  int count = 0;
+
+  if (action_->stopped)
+    return stop_accept(e);
+
+  // A private SO_REUSEPORT socket is not closed by NetAcceptAction::cancel().
+  if (server.f_reuse_port && action_->cancelled && &server != action_->server) {
+    server.close();
+    e->cancel();
+    NET_DECREMENT_DYN_STAT(net_accepts_currently_open_stat);
+    delete this;
+    return EVENT_DONE;
+  }
 
   do {
     if (!backdoor && check_net_throttle(ACCEPT, ink_get_hrtime())) {
@@ -396,10 +518,16 @@ NetAccept::acceptFastEvent(int event, void *ep)
     vc = allocateThread(e->ethread);
 
     socklen_t sz = sizeof(vc->con.addr);
+#if HAVE_ACCEPT4
+    int fd = socketManager.accept4(server.fd, &vc->con.addr.sa, &sz, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
     int fd = socketManager.accept(server.fd, &vc->con.addr.sa, &sz);
+#endif
 
     if (likely(fd >= 0)) {
       Debug("iocore_net", "accepted a new socket: %d", fd);
+#if !ACCEPT_INHERITS_SOCKOPTS
+      int bufsz;
       if (send_bufsize > 0) {
         if (unlikely(socketManager.set_sndbuf_size(fd, send_bufsize))) {
           bufsz = ROUNDUP(send_bufsize, 1024);
@@ -439,9 +567,14 @@ NetAccept::acceptFastEvent(int event, void *ep)
         safe_setsockopt(fd, IPPROTO_IP, IP_TOS, reinterpret_cast<char *>(&packet_tos), sizeof(uint32_t));
       }
 #endif
+#endif
+#if HAVE_ACCEPT4
+      res = fd;
+#else
       do {
         res = safe_nonblocking(fd);
       } while (res < 0 && (errno == EAGAIN || errno == EINTR));
+#endif
     } else {
       res = fd;
     }
@@ -461,11 +594,17 @@ NetAccept::acceptFastEvent(int event, void *ep)
         freeThread(vc, e->ethread);
         goto Ldone;
       }
+      if (action_->stopped) {
+        freeThread(vc, e->ethread);
+        return stop_accept(e);
+      }
       if (!action_->cancelled)
         action_->continuation->handleEvent(EVENT_ERROR, (void *)(intptr_t)res);
       goto Lerror;
     }
     vc->con.fd = fd;
+    if (tcp_fastopen && vc->con.syn_data_acked())
+      NET_INCREMENT_THREAD_DYN_STAT(net_tcp_fastopen_accepted_stat, e->ethread);
 
     NET_SUM_GLOBAL_DYN_STAT(net_connections_currently_open_stat, 1);
     vc->id = net_next_connection_number();
@@ -499,7 +638,8 @@ NetAccept::acceptFastEvent(int event, void *ep)
       action_->continuation->handleEvent(NET_EVENT_ACCEPT, vc);
     else
       close_UnixNetVConnection(vc, e->ethread);
-  } while (loop);
+    // Anything left in the queue is picked up on the next periodic event.
+  } while (loop && (accept_batch_size <= 0 || ++count < accept_batch_size));
 
 Ldone:
   return EVENT_CONT;
@@ -521,10 +661,29 @@ NetAccept::acceptLoopEvent(int event, Event * e)
   (void) e;
   EThread *t = this_ethread();
 
-  while (1)
+  while (!action_->stopped)
     do_blocking_accept(t);
 
-  // Don't think this ever happens ...
+  // Only after NetProcessor::stop_accept().
+  NET_DECREMENT_DYN_STAT(net_accepts_currently_open_stat);
+  delete this;
+  return EVENT_DONE;
+}
+
+
+//
+// Exit after NetProcessor::stop_accept(). Connections already accepted
+// are left alone. Only a private SO_REUSEPORT socket is closed here, a
+// shared one is still polled by the other NetAccepts or is inherited by
+// another traffic_server.
+//
+int
+NetAccept::stop_accept(Event * e)
+{
+  ep.stop();
+  if (server.f_reuse_port && &server != action_->server)
+    server.close();
+  e->cancel();
   NET_DECREMENT_DYN_STAT(net_accepts_currently_open_stat);
   delete this;
   return EVENT_DONE;
@@ -548,6 +707,9 @@ NetAccept::NetAccept()
     sockopt_flags(0),
     packet_mark(0),
     packet_tos(0),
+    defer_accept(0),
+    tcp_fastopen(false),
+    accept_batch_size(0),
     etype(0)
 { }
 
@@ -48,6 +48,8 @@ NetProcessor::AcceptOptions::reset()
   packet_mark = 0;
   packet_tos = 0;
   f_inbound_transparent = false;
+  f_tcp_fastopen = false;
+  defer_accept = -1;
   return *this;
 }
 
@@ -83,6 +85,17 @@ NetProcessor::main_accept(Continuation *cont, SOCKET fd, AcceptOptions const& op
   return this_unp->accept_internal(cont, fd, opt);
 }
 
+void
+NetProcessor::stop_accept(Action *action)
+{
+  NetAcceptAction *a = static_cast<NetAcceptAction *>(action);
+
+  a->stopped = true;
+  // Wakes an accept thread blocked on the socket, and releases the port.
+  if (a->own_socket && a->server->fd != NO_FD)
+    ::shutdown(a->server->fd, SHUT_RDWR);
+}
+
 Action *
 UnixNetProcessor::accept_internal(Continuation *cont, int fd, AcceptOptions const& opt)
 {
@@ -126,8 +139,21 @@ UnixNetProcessor::accept_internal(Continuation *cont, int fd, AcceptOptions cons
   int should_filter_int = 0;
   na->server.http_accept_filter = false;
   REC_ReadConfigInteger(should_filter_int, "proxy.config.net.defer_accept");
+  if (opt.defer_accept >= 0) // per port override
+    should_filter_int = opt.defer_accept;
   if (should_filter_int > 0 && opt.etype == ET_NET)
     na->server.http_accept_filter = true;
+  na->defer_accept = should_filter_int;
+
+  // Per thread listen sockets only make sense when accepting on the net threads.
+  int listen_per_thread = 0;
+  REC_ReadConfigInteger(listen_per_thread, "proxy.config.exec_thread.listen");
+#ifdef SO_REUSEPORT
+  na->server.f_reuse_port = listen_per_thread > 0 && opt.frequent_accept && accept_threads == 0;
+#else
+  if (listen_per_thread > 0)
+    Warning("proxy.config.exec_thread.listen is set but SO_REUSEPORT is not supported");
+#endif
 
   na->action_ = NEW(new NetAcceptAction());
   *na->action_ = cont;
@@ -138,6 +164,8 @@ UnixNetProcessor::accept_internal(Continuation *cont, int fd, AcceptOptions cons
   na->sockopt_flags = opt.sockopt_flags;
   na->packet_mark = opt.packet_mark;
   na->packet_tos = opt.packet_tos;
+  na->tcp_fastopen = opt.f_tcp_fastopen;
+  REC_ReadConfigInteger(na->accept_batch_size, "proxy.config.net.accept_batch_size");
   na->etype = opt.etype;
   na->backdoor = opt.backdoor;
   if (na->callback_on_open)
@@ -163,23 +191,7 @@ UnixNetProcessor::accept_internal(Continuation *cont, int fd, AcceptOptions cons
   } else
     na->init_accept();
 
-#ifdef TCP_DEFER_ACCEPT
-  // set tcp defer accept timeout if it is configured, this will not trigger an accept until there is
-  // data on the socket ready to be read
-  if (should_filter_int > 0) {
-    setsockopt(na->server.fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &should_filter_int, sizeof(int));
-  }
-#endif
-#ifdef TCP_INIT_CWND
- int tcp_init_cwnd = 0;
- REC_ReadConfigInteger(tcp_init_cwnd, "proxy.config.http.server_tcp_init_cwnd");
- if(tcp_init_cwnd > 0) {
-    Debug("net", "Setting initial congestion window to %d", tcp_init_cwnd);
-    if(setsockopt(na->server.fd, IPPROTO_TCP, TCP_INIT_CWND, &tcp_init_cwnd, sizeof(int)) != 0) {
-      Error("Cannot set initial congestion window to %d", tcp_init_cwnd);
-    }
- }
-#endif
+  na->set_listen_sockopts();
   return na->action_;
 }
 
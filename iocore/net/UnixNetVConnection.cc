@@ -32,12 +32,19 @@
 #define enable_write(_vc) (_vc)->write.enabled = 1
 
 typedef struct iovec IOVec;
-#ifndef UIO_MAXIOV
-#define NET_MAX_IOV 16          // UIO_MAXIOV shall be at least 16 1003.1g (5.4.1.1)
-#else
+#if defined(UIO_MAXIOV)
 #define NET_MAX_IOV UIO_MAXIOV
+#elif defined(IOV_MAX)
+#define NET_MAX_IOV IOV_MAX
+#else
+#define NET_MAX_IOV 16          // UIO_MAXIOV shall be at least 16 1003.1g (5.4.1.1)
 #endif
 
+// Runs of blocks up to NET_COALESCE_BLOCK bytes, e.g. chunk headers, are
+// copied into one iovec of at most NET_COALESCE_SIZE bytes.
+#define NET_COALESCE_BLOCK 512
+#define NET_COALESCE_SIZE  4096
+
 // Global
 ClassAllocator<UnixNetVConnection> netVCAllocator("netVCAllocator");
 
@@ -81,9 +88,12 @@ net_activity(UnixNetVConnection *vc, EThread *thread)
       vc->inactivity_timeout = 0;
   }
 #else
-  if (vc->inactivity_timeout_in)
+  if (vc->inactivity_timeout_in) {
     vc->next_inactivity_timeout_at = ink_get_hrtime() + vc->inactivity_timeout_in;
-  else
+#if TS_USE_TIMER_WHEEL
+    vc->update_inactivity_wheel();
+#endif
+  } else
     vc->next_inactivity_timeout_at = 0;
 #endif
 
@@ -96,8 +106,21 @@ void
 close_UnixNetVConnection(UnixNetVConnection *vc, EThread *t)
 {
   NetHandler *nh = vc->nh;
+
+  // An offloaded SSL handshake is still using the socket. Its job puts the connection
+  // back on a ready list when it is done, and the closed flag brings us back here.
+  if (vc->getSSLHandShakeOffloaded()) {
+    vc->closed = 1;
+    return;
+  }
+
+  if (vc->write_calls)
+    Debug("iocore_net", "vc %p: %" PRId64 " write calls, %" PRId64 " bytes per call", vc, vc->write_calls,
+          vc->write_call_bytes / vc->write_calls);
   vc->cancel_OOB();
   vc->ep.stop();
+  if ((vc->options.sockopt_flags & NetVCOptions::SOCK_OPT_TCP_FAST_OPEN) && vc->con.syn_data_acked())
+    NET_INCREMENT_THREAD_DYN_STAT(net_tcp_fastopen_used_stat, t);
   vc->con.close();
 #ifdef INACTIVITY_TIMEOUT
   if (vc->inactivity_timeout) {
@@ -106,6 +129,14 @@ close_UnixNetVConnection(UnixNetVConnection *vc, EThread *t)
   }
 #else
   vc->next_inactivity_timeout_at = 0;
+#if TS_USE_TIMER_WHEEL
+  if (vc->wheel_slot != TIMER_WHEEL_NO_SLOT)
+    nh->inactivity_wheel.remove(vc);
+  if (vc->in_requeue_list) {
+    nh->inactivity_requeue_list.remove(vc);
+    vc->in_requeue_list = 0;
+  }
+#endif
 #endif
   vc->inactivity_timeout_in = 0;
   if (vc->active_timeout) {
@@ -135,7 +166,10 @@ static inline int
 read_signal_and_update(int event, UnixNetVConnection *vc)
 {
   vc->recursion++;
-  vc->read.vio._cont->handleEvent(event, &vc->read.vio);
+  {
+    EventProfileScope profile_scope(vc->thread, vc->read.vio._cont);
+    vc->read.vio._cont->handleEvent(event, &vc->read.vio);
+  }
   if (!--vc->recursion && vc->closed) {
     /* BZ  31932 */
     ink_assert(vc->thread == this_ethread());
@@ -150,7 +184,10 @@ static inline int
 write_signal_and_update(int event, UnixNetVConnection *vc)
 {
   vc->recursion++;
-  vc->write.vio._cont->handleEvent(event, &vc->write.vio);
+  {
+    EventProfileScope profile_scope(vc->thread, vc->write.vio._cont);
+    vc->write.vio._cont->handleEvent(event, &vc->write.vio);
+  }
   if (!--vc->recursion && vc->closed) {
     /* BZ  31932 */
     ink_assert(vc->thread == this_ethread());
@@ -231,6 +268,9 @@ read_from_net(NetHandler *nh, UnixNetVConnection *vc, EThread *thread)
     read_disable(nh, vc);
     return;
   }
+  // an idle buffer holds no block, write_avail() allocates one only now
+  // that the socket is readable
+  bool lazy = !buf.writer()->_writer;
   int64_t toread = buf.writer()->write_avail();
   if (toread > ntodo)
     toread = ntodo;
@@ -282,6 +322,9 @@ read_from_net(NetHandler *nh, UnixNetVConnection *vc, EThread *thread)
         NET_DEBUG_COUNT_DYN_STAT(net_calls_to_read_nodata_stat, 1);
         vc->read.triggered = 0;
         nh->read_ready_list.remove(vc);
+        // spurious wakeup, give the block back until data arrives
+        if (lazy)
+          buf.writer()->shrink(buf.writer()->size_index);
         return;
       }
 
@@ -378,6 +421,8 @@ write_to_net_io(NetHandler *nh, UnixNetVConnection *vc, EThread *thread)
     if (ret == EVENT_ERROR) {
       vc->write.triggered = 0;
       write_signal_error(nh, vc, err);
+    } else if (ret == SSL_HANDSHAKE_OFFLOADED) {
+      // SSLHandShakeJob requeues us.
     } else if (ret == SSL_HANDSHAKE_WANT_READ || ret == SSL_HANDSHAKE_WANT_ACCEPT || ret == SSL_HANDSHAKE_WANT_CONNECT
                || ret == SSL_HANDSHAKE_WANT_WRITE) {
       vc->read.triggered = 0;
@@ -587,6 +632,10 @@ UnixNetVConnection::do_io_close(int alerrno /* = -1 */ )
 
   if (close_inline)
     close_UnixNetVConnection(this, t);
+#if TS_USE_TIMER_WHEEL
+  else
+    update_inactivity_wheel();     // the inactivity cop frees it
+#endif
 }
 
 void
@@ -781,9 +830,12 @@ UnixNetVConnection::UnixNetVConnection()
     inactivity_timeout(NULL),
 #else
     next_inactivity_timeout_at(0),
+#if TS_USE_TIMER_WHEEL
+    wheel_at(0), wheel_slot(TIMER_WHEEL_NO_SLOT), in_requeue_list(0),
+#endif
 #endif
     active_timeout(NULL), nh(NULL),
-    id(0), flags(0), recursion(0), submit_time(0), oob_ptr(0),
+    id(0), flags(0), recursion(0), submit_time(0), write_calls(0), write_call_bytes(0), oob_ptr(0),
     from_accept_thread(false)
 {
   memset(&local_addr, 0, sizeof local_addr);
@@ -807,11 +859,40 @@ UnixNetVConnection::set_enabled(VIO *vio)
       inactivity_timeout = thread->schedule_in(this, inactivity_timeout_in);
   }
 #else
-  if (!next_inactivity_timeout_at && inactivity_timeout_in)
+  if (!next_inactivity_timeout_at && inactivity_timeout_in) {
     next_inactivity_timeout_at = ink_get_hrtime() + inactivity_timeout_in;
+#if TS_USE_TIMER_WHEEL
+    update_inactivity_wheel();
+#endif
+  }
 #endif
 }
 
+#if TS_USE_TIMER_WHEEL
+// Make sure the inactivity wheel of our NetHandler looks at us by
+// next_inactivity_timeout_at, or right away once we are closed.  A later
+// timeout needs nothing, the InactivityCop finds out when the wheel gets
+// to us.  The wheel belongs to the NetHandler mutex, without it we can
+// only queue ourselves up for the cop.
+void
+UnixNetVConnection::update_inactivity_wheel()
+{
+  if (!nh || (!next_inactivity_timeout_at && !closed))
+    return;
+  if (nh->mutex->thread_holding == this_ethread()) {
+    ink_hrtime at = closed ? ink_get_hrtime() : next_inactivity_timeout_at;
+    if (wheel_slot != TIMER_WHEEL_NO_SLOT) {
+      if (wheel_at <= at)
+        return;
+      nh->inactivity_wheel.remove(this);
+    }
+    wheel_at = at;
+    nh->inactivity_wheel.insert(this);
+  } else if (!ink_atomic_swap(&in_requeue_list, 1))
+    nh->inactivity_requeue_list.push(this);
+}
+#endif
+
 void
 UnixNetVConnection::net_read_io(NetHandler *nh, EThread *lthread)
 {
@@ -830,10 +911,15 @@ UnixNetVConnection::load_buffer_and_write(int64_t towrite, int64_t &wattempted,
   // XXX Rather than dealing with the block directly, we should use the IOBufferReader API.
   int64_t offset = buf.reader()->start_offset;
   IOBufferBlock *b = buf.reader()->block;
+  ProxyMutex *mutex = thread->mutex;
 
   do {
     IOVec tiovec[NET_MAX_IOV];
+    char coalesce_buf[NET_COALESCE_SIZE];
+    int64_t coalesced = 0;
     int niov = 0;
+    IOBufferBlock *fb = NULL;
+    off_t foffset = 0;
     int64_t total_wrote_last = total_wrote;
     while (b && niov < NET_MAX_IOV) {
       // check if we have done this block
@@ -850,7 +936,35 @@ UnixNetVConnection::load_buffer_and_write(int64_t towrite, int64_t &wattempted,
         l = wavail;
       if (!l)
         break;
+      // a file backed block is sent by itself, after any memory blocks before it
+      if (b->data->is_file_backed()) {
+        if (niov)
+          break;
+        total_wrote += l;
+        fb = b;
+        foffset = b->data->_fd_offset + (b->start() - b->buf()) + offset;
+        offset = 0;
+        b = b->next;
+        break;
+      }
       total_wrote += l;
+      if (l <= NET_COALESCE_BLOCK && coalesced + l <= NET_COALESCE_SIZE) {
+        char *dst = coalesce_buf + coalesced;
+        memcpy(dst, b->start() + offset, l);
+        coalesced += l;
+        // extend the previous entry if it ends in the copy buffer
+        if (niov && (char *)tiovec[niov - 1].iov_base + tiovec[niov - 1].iov_len == dst) {
+          tiovec[niov - 1].iov_len += l;
+          NET_INCREMENT_DYN_STAT(net_write_coalesced_blocks_stat);
+        } else {
+          tiovec[niov].iov_len = l;
+          tiovec[niov].iov_base = dst;
+          niov++;
+        }
+        offset = 0;
+        b = b->next;
+        continue;
+      }
       // build an iov entry
       tiovec[niov].iov_len = l;
       tiovec[niov].iov_base = b->start() + offset;
@@ -860,12 +974,18 @@ UnixNetVConnection::load_buffer_and_write(int64_t towrite, int64_t &wattempted,
       b = b->next;
     }
     wattempted = total_wrote - total_wrote_last;
-    if (niov == 1)
+    if (fb)
+      r = socketManager.sendfile(con.fd, fb->data->_fd, &foffset, wattempted);
+    else if (niov == 1)
       r = socketManager.write(con.fd, tiovec[0].iov_base, tiovec[0].iov_len);
     else
       r = socketManager.writev(con.fd, &tiovec[0], niov);
-    ProxyMutex *mutex = thread->mutex;
-    NET_DEBUG_COUNT_DYN_STAT(net_calls_to_write_stat, 1);
+    NET_INCREMENT_DYN_STAT(net_calls_to_write_stat);
+    if (r > 0) {
+      RecIncrRawStat(net_rsb, mutex->thread_holding, (int) net_write_bytes_per_call_stat, r);
+      write_call_bytes += r;
+    }
+    write_calls++;
   } while (r == wattempted && total_wrote < towrite);
 
   return (r);
@@ -1136,6 +1256,8 @@ UnixNetVConnection::free(EThread *t)
   read.vio.mutex.clear();
   write.vio.mutex.clear();
   flags = 0;
+  write_calls = 0;
+  write_call_bytes = 0;
   SET_CONTINUATION_HANDLER(this, (NetVConnHandler) & UnixNetVConnection::startEvent);
   nh = NULL;
   read.triggered = 0;
@@ -1148,6 +1270,9 @@ UnixNetVConnection::free(EThread *t)
   ink_assert(!write.enable_link.next);
   ink_assert(!link.next && !link.prev);
   ink_assert(!active_timeout);
+#if !defined(INACTIVITY_TIMEOUT) && TS_USE_TIMER_WHEEL
+  ink_assert(wheel_slot == TIMER_WHEEL_NO_SLOT && !in_requeue_list);
+#endif
   ink_assert(con.fd == NO_FD);
   ink_assert(t == this_ethread());
 
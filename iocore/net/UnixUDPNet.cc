@@ -113,6 +113,42 @@ UDPNetProcessorInternal::udp_read_from_net(UDPNetHandler * nh, UDPConnection * x
   // don't call back connection at this time.
   int r;
   int iters = 0;
+  int calls = 0;
+#if HAVE_RECVMMSG
+  // XXX: want to be 0 copy.
+  if (nh->read_buffers == NULL) {
+    nh->read_buffers = (char *)ats_malloc(UDP_RECV_BATCH * UDP_MAX_DATAGRAM);
+  }
+  do {
+    struct mmsghdr msgs[UDP_RECV_BATCH];
+    struct iovec iov[UDP_RECV_BATCH];
+    sockaddr_in6 fromaddr[UDP_RECV_BATCH];
+
+    for (int i = 0; i < UDP_RECV_BATCH; i++) {
+      iov[i].iov_base = nh->read_buffers + i * UDP_MAX_DATAGRAM;
+      iov[i].iov_len = UDP_MAX_DATAGRAM;
+      memset(&msgs[i].msg_hdr, 0, sizeof(msgs[i].msg_hdr));
+      msgs[i].msg_hdr.msg_name = &fromaddr[i];
+      msgs[i].msg_hdr.msg_namelen = sizeof(fromaddr[i]);
+      msgs[i].msg_hdr.msg_iov = &iov[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    r = ::recvmmsg(uc->getFd(), msgs, UDP_RECV_BATCH, 0, NULL);
+    calls++;
+    if (r <= 0) {
+      // error
+      break;
+    }
+    for (int i = 0; i < r; i++) {
+      // create packet
+      UDPPacket *p = new_incoming_UDPPacket(ats_ip_sa_cast(&fromaddr[i]), (char *)iov[i].iov_base, msgs[i].msg_len);
+      p->setConnection(uc);
+      // queue onto the UDPConnection
+      ink_atomiclist_push(&uc->inQueue, p);
+      iters++;
+    }
+  } while (r > 0);
+#else
   do {
     sockaddr_in6 fromaddr;
     socklen_t fromlen = sizeof(fromaddr);
@@ -122,6 +158,7 @@ UDPNetProcessorInternal::udp_read_from_net(UDPNetHandler * nh, UDPConnection * x
     char buf[65536];
     int buflen = sizeof(buf);
     r = socketManager.recvfrom(uc->getFd(), buf, buflen, 0, (struct sockaddr *) &fromaddr, &fromlen);
+    calls++;
     if (r <= 0) {
       // error
       break;
@@ -133,6 +170,9 @@ UDPNetProcessorInternal::udp_read_from_net(UDPNetHandler * nh, UDPConnection * x
     ink_atomiclist_push(&uc->inQueue, p);
     iters++;
   } while (r > 0);
+#endif
+  NET_SUM_THREAD_DYN_STAT(net_udp_recv_calls_stat, this_ethread(), calls);
+  NET_SUM_THREAD_DYN_STAT(net_udp_packets_received_stat, this_ethread(), iters);
   if (iters >= 1) {
     Debug("udp-read", "read %d at a time", iters);
   }
@@ -692,6 +732,8 @@ UDPQueue::SendPackets()
   int32_t bytesThisSlot = INT_MAX, bytesUsed = 0;
   int32_t bytesThisPipe, sentOne;
   int64_t pktLen;
+  UDPPacketInternal *batch[UDP_SEND_BATCH];
+  int nbatch = 0;
 
   bytesThisSlot = INT_MAX;
 
@@ -709,9 +751,18 @@ sendPackets:
     if (p->conn->GetSendGenerationNumber() != p->reqGenerationNum)
       goto next_pkt;
 
-    SendUDPPacket(p, pktLen);
+    // packets for the same connection go out together, freed once sent
+    if (nbatch && (nbatch == UDP_SEND_BATCH || batch[0]->conn != p->conn)) {
+      SendUDPPackets(batch, nbatch);
+      nbatch = 0;
+    }
+    batch[nbatch++] = p;
     bytesUsed += pktLen;
     bytesThisPipe -= pktLen;
+    sentOne = true;
+    if (bytesThisPipe < 0)
+      break;
+    continue;
   next_pkt:
     sentOne = true;
     p->free();
@@ -719,6 +770,10 @@ sendPackets:
     if (bytesThisPipe < 0)
       break;
   }
+  if (nbatch) {
+    SendUDPPackets(batch, nbatch);
+    nbatch = 0;
+  }
 
   bytesThisSlot -= bytesUsed;
 
@@ -737,40 +792,51 @@ sendPackets:
   }
 }
 
-void
-UDPQueue::SendUDPPacket(UDPPacketInternal *p, int32_t /* pktLen ATS_UNUSED */)
+// Fills msg and iov, which has room for UDP_MAX_IOV blocks, for p
+static int
+udp_fill_msghdr(UDPPacketInternal *p, struct msghdr *msg, struct iovec *iov)
 {
   IOBufferBlock *b;
-  struct msghdr msg;
-  struct iovec iov[32];
   int real_len = 0;
-  int n, count, iov_len = 0;
+  int iov_len = 0;
 
   p->conn->lastSentPktStartTime = p->delivery_time;
   Debug("udp-send", "Sending %p", p);
 
 #if !defined(solaris)
-  msg.msg_control = 0;
-  msg.msg_controllen = 0;
-  msg.msg_flags = 0;
+  msg->msg_control = 0;
+  msg->msg_controllen = 0;
+  msg->msg_flags = 0;
 #endif
-  msg.msg_name = (caddr_t) & p->to;
-  msg.msg_namelen = sizeof(p->to);
-  iov_len = 0;
+  msg->msg_name = (caddr_t) & p->to;
+  msg->msg_namelen = sizeof(p->to);
 
-  for (b = p->chain; b != NULL; b = b->next) {
+  for (b = p->chain; b != NULL && iov_len < UDP_MAX_IOV; b = b->next) {
     iov[iov_len].iov_base = (caddr_t) b->start();
     iov[iov_len].iov_len = b->size();
     real_len += iov[iov_len].iov_len;
     iov_len++;
   }
-  msg.msg_iov = iov;
-  msg.msg_iovlen = iov_len;
+  ink_assert(b == NULL);
+  msg->msg_iov = iov;
+  msg->msg_iovlen = iov_len;
+  return real_len;
+}
+
+void
+UDPQueue::SendUDPPacket(UDPPacketInternal *p, int32_t /* pktLen ATS_UNUSED */)
+{
+  struct msghdr msg;
+  struct iovec iov[UDP_MAX_IOV];
+  int n, count, calls = 0;
+
+  udp_fill_msghdr(p, &msg, iov);
 
   count = 0;
   while (1) {
     // stupid Linux problem: sendmsg can return EAGAIN
     n =::sendmsg(p->conn->getFd(), &msg, 0);
+    calls++;
     if ((n >= 0) || ((n < 0) && (errno != EAGAIN)))
       // send succeeded or some random error happened.
       break;
@@ -783,6 +849,54 @@ UDPQueue::SendUDPPacket(UDPPacketInternal *p, int32_t /* pktLen ATS_UNUSED */)
       }
     }
   }
+  NET_SUM_THREAD_DYN_STAT(net_udp_send_calls_stat, this_ethread(), calls);
+  NET_INCREMENT_THREAD_DYN_STAT(net_udp_packets_sent_stat, this_ethread());
+}
+
+void
+UDPQueue::SendUDPPackets(UDPPacketInternal **p, int n)
+{
+#if HAVE_SENDMMSG
+  struct mmsghdr msgs[UDP_SEND_BATCH];
+  struct iovec iov[UDP_SEND_BATCH][UDP_MAX_IOV];
+  int fd = p[0]->conn->getFd();
+  int sent = 0, count = 0, calls = 0;
+
+  ink_assert(n <= UDP_SEND_BATCH);
+  for (int i = 0; i < n; i++) {
+    udp_fill_msghdr(p[i], &msgs[i].msg_hdr, iov[i]);
+  }
+
+  while (sent < n) {
+    int r = ::sendmmsg(fd, msgs + sent, n - sent, 0);
+    calls++;
+    if (r > 0) {
+      sent += r;
+      count = 0;
+    } else if (r < 0 && errno == EAGAIN) {
+      // stupid Linux problem: sendmsg can return EAGAIN
+      if ((g_udp_numSendRetries > 0) && (++count >= g_udp_numSendRetries)) {
+        // tried too many times; give up on this one
+        Debug("udpnet", "Send failed: too many retries");
+        sent++;
+        count = 0;
+      }
+    } else {
+      // some random error happened on the first packet, skip it
+      sent++;
+      count = 0;
+    }
+  }
+  NET_SUM_THREAD_DYN_STAT(net_udp_send_calls_stat, this_ethread(), calls);
+  NET_SUM_THREAD_DYN_STAT(net_udp_packets_sent_stat, this_ethread(), n);
+#else
+  for (int i = 0; i < n; i++) {
+    SendUDPPacket(p[i], p[i]->getPktLength());
+  }
+#endif
+  for (int i = 0; i < n; i++) {
+    p[i]->free();
+  }
 }
 
 
@@ -802,6 +916,7 @@ UDPNetHandler::UDPNetHandler()
   ink_atomiclist_init(&udpNewConnections, "UDP Connection queue", offsetof(UnixUDPConnection, newconn_alink.next));
   nextCheck = ink_get_hrtime_internal() + HRTIME_MSECONDS(1000);
   lastCheck = 0;
+  read_buffers = NULL;
   SET_HANDLER((UDPNetContHandler) & UDPNetHandler::startNetEvent);
 }
 
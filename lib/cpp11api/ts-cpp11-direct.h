@@ -0,0 +1,319 @@
+/** @file
+ @section license License
+
+ Licensed to the Apache Software Foundation (ASF) under one
+ or more contributor license agreements.  See the NOTICE file
+ distributed with this work for additional information
+ regarding copyright ownership.  The ASF licenses this file
+ to you under the Apache License, Version 2.0 (the
+ "License"); you may not use this file except in compliance
+ with the License.  You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef TS_CPP11_DIRECT_H_
+#define TS_CPP11_DIRECT_H_
+
+#ifndef __GXX_EXPERIMENTAL_CXX0X__
+#error The C++ Apache Traffic Server API wrapper requires C++11 support.
+#endif
+
+/*
+ * A header only layer over the C API which does not allocate: strings are
+ * references into the marshal buffers, handles release their TSMLoc when
+ * they go out of scope, and hooks are bound at compile time to a plain
+ * function instead of a std::function on the heap.
+ *
+ * A StringRef is valid until the header it came from is changed or its
+ * transaction ends, copy it with str() to keep it longer.
+ */
+
+#include <ts.h>
+#include <string.h>
+#include <strings.h>
+#include <string>
+#include <utility>
+#include "ts-cpp11.h"
+
+namespace ats {
+namespace api {
+namespace direct {
+
+class StringRef {
+private:
+  const char *ptr_;
+  size_t len_;
+public:
+  constexpr StringRef() :
+      ptr_(nullptr), len_(0) {
+  }
+  constexpr StringRef(const char *ptr, size_t len) :
+      ptr_(ptr), len_(len) {
+  }
+  template<size_t N> constexpr StringRef(const char (&literal)[N]) :
+      ptr_(literal), len_(N - 1) {
+  }
+  StringRef(const std::string &s) :
+      ptr_(s.data()), len_(s.length()) {
+  }
+
+  constexpr const char *data() const {
+    return ptr_;
+  }
+  constexpr size_t size() const {
+    return len_;
+  }
+  constexpr bool empty() const {
+    return len_ == 0;
+  }
+  constexpr char operator[](size_t i) const {
+    return ptr_[i];
+  }
+  const char *begin() const {
+    return ptr_;
+  }
+  const char *end() const {
+    return ptr_ + len_;
+  }
+
+  bool operator==(const StringRef &that) const {
+    return len_ == that.len_ && (len_ == 0 || memcmp(ptr_, that.ptr_, len_) == 0);
+  }
+  bool operator!=(const StringRef &that) const {
+    return !(*this == that);
+  }
+  // header names and most values compare without case
+  bool caseEquals(const StringRef &that) const {
+    return len_ == that.len_ && (len_ == 0 || strncasecmp(ptr_, that.ptr_, len_) == 0);
+  }
+
+  std::string str() const {
+    return std::string(ptr_, len_);
+  }
+};
+
+/*
+ * Owns a TSMLoc and releases it with its parent. Moving hands the TSMLoc
+ * over, a handle is never copied.
+ */
+class MLocHandle {
+protected:
+  TSMBuffer bufp_;
+  TSMLoc parent_;
+  TSMLoc loc_;
+public:
+  MLocHandle() :
+      bufp_(nullptr), parent_(TS_NULL_MLOC), loc_(TS_NULL_MLOC) {
+  }
+  MLocHandle(TSMBuffer bufp, TSMLoc parent, TSMLoc loc) :
+      bufp_(bufp), parent_(parent), loc_(loc) {
+  }
+  MLocHandle(MLocHandle &&that) :
+      bufp_(that.bufp_), parent_(that.parent_), loc_(that.loc_) {
+    that.loc_ = TS_NULL_MLOC;
+  }
+  MLocHandle &operator=(MLocHandle &&that) {
+    if (this != &that) {
+      reset();
+      bufp_ = that.bufp_;
+      parent_ = that.parent_;
+      loc_ = that.loc_;
+      that.loc_ = TS_NULL_MLOC;
+    }
+    return *this;
+  }
+  MLocHandle(const MLocHandle &) = delete;
+  MLocHandle &operator=(const MLocHandle &) = delete;
+  ~MLocHandle() {
+    reset();
+  }
+
+  void reset() {
+    if (loc_ != TS_NULL_MLOC) {
+      TSHandleMLocRelease(bufp_, parent_, loc_);
+      loc_ = TS_NULL_MLOC;
+    }
+  }
+
+  bool valid() const {
+    return loc_ != TS_NULL_MLOC;
+  }
+  explicit operator bool() const {
+    return valid();
+  }
+  TSMBuffer buffer() const {
+    return bufp_;
+  }
+  TSMLoc loc() const {
+    return loc_;
+  }
+};
+
+class Field: public MLocHandle {
+public:
+  Field() {
+  }
+  Field(TSMBuffer bufp, TSMLoc hdr_loc, TSMLoc field_loc) :
+      MLocHandle(bufp, hdr_loc, field_loc) {
+  }
+
+  StringRef name() const {
+    int len = 0;
+    const char *name = TSMimeHdrFieldNameGet(bufp_, parent_, loc_, &len);
+    return StringRef(name, len);
+  }
+
+  int valueCount() const {
+    return TSMimeHdrFieldValuesCount(bufp_, parent_, loc_);
+  }
+
+  // one of the comma separated values
+  StringRef value(int idx) const {
+    int len = 0;
+    const char *value = TSMimeHdrFieldValueStringGet(bufp_, parent_, loc_, idx, &len);
+    return StringRef(value, len);
+  }
+
+  // all the values as they are in the field
+  StringRef values() const {
+    return value(-1);
+  }
+
+  // the next field with the same name, invalid after the last one
+  Field nextDup() const {
+    return Field(bufp_, parent_, TSMimeHdrFieldNextDup(bufp_, parent_, loc_));
+  }
+};
+
+class Headers: public MLocHandle {
+public:
+  Headers() {
+  }
+  Headers(TSMBuffer bufp, TSMLoc hdr_loc) :
+      MLocHandle(bufp, TS_NULL_MLOC, hdr_loc) {
+  }
+
+  Field find(const StringRef &name) const {
+    return Field(bufp_, loc_, TSMimeHdrFieldFind(bufp_, loc_, name.data(), name.size()));
+  }
+
+  // the first value of the first field called name, empty if there is none
+  StringRef value(const StringRef &name) const {
+    Field field = find(name);
+    return field ? field.value(0) : StringRef();
+  }
+
+  int fieldCount() const {
+    return TSMimeHdrFieldsCount(bufp_, loc_);
+  }
+
+  Field field(int idx) const {
+    return Field(bufp_, loc_, TSMimeHdrFieldGet(bufp_, loc_, idx));
+  }
+
+  StringRef method() const {
+    int len = 0;
+    const char *method = TSHttpHdrMethodGet(bufp_, loc_, &len);
+    return StringRef(method, len);
+  }
+
+  int status() const {
+    return TSHttpHdrStatusGet(bufp_, loc_);
+  }
+};
+
+/*
+ * The transaction a hook was called for, passed by value.
+ */
+class Txn {
+private:
+  TSHttpTxn txnp_;
+
+  typedef TSReturnCode (*HdrGet)(TSHttpTxn, TSMBuffer *, TSMLoc *);
+  Headers headers(HdrGet get) const {
+    TSMBuffer bufp;
+    TSMLoc hdr_loc;
+    if (get(txnp_, &bufp, &hdr_loc) != TS_SUCCESS)
+      return Headers();
+    return Headers(bufp, hdr_loc);
+  }
+public:
+  explicit Txn(TSHttpTxn txnp) :
+      txnp_(txnp) {
+  }
+
+  TSHttpTxn get() const {
+    return txnp_;
+  }
+
+  Headers clientRequest() const {
+    return headers(TSHttpTxnClientReqGet);
+  }
+  Headers clientResponse() const {
+    return headers(TSHttpTxnClientRespGet);
+  }
+  Headers serverRequest() const {
+    return headers(TSHttpTxnServerReqGet);
+  }
+  Headers serverResponse() const {
+    return headers(TSHttpTxnServerRespGet);
+  }
+
+  void reenable(NextState ns) const {
+    switch (ns) {
+    case NextState::HTTP_DONT_CONTINUE:
+      break;
+    case NextState::HTTP_ERROR:
+      TSHttpTxnReenable(txnp_, TS_EVENT_HTTP_ERROR);
+      break;
+    case NextState::HTTP_CONTINUE:
+    default:
+      TSHttpTxnReenable(txnp_, TS_EVENT_HTTP_CONTINUE);
+      break;
+    }
+  }
+};
+
+typedef NextState (*HookFunction)(Txn);
+
+/*
+ * Hook<TS_HTTP_READ_REQUEST_HDR_HOOK, callback>::add() registers callback
+ * on a global hook, add(txn) on the hook of one transaction. The callback
+ * is a template argument, so each hook gets its own handler and nothing
+ * is kept in the continuation.
+ */
+template<TSHttpHookID ID, HookFunction F>
+class Hook {
+private:
+  static int handler(TSCont /* contp ATS_UNUSED */, TSEvent /* event ATS_UNUSED */, void *edata) {
+    Txn txn(static_cast<TSHttpTxn>(edata));
+    txn.reenable(F(txn));
+    return 0;
+  }
+
+  static TSCont cont() {
+    // one continuation for every transaction, it has no data
+    static TSCont contp = TSContCreate(handler, nullptr);
+    return contp;
+  }
+public:
+  static void add() {
+    TSHttpHookAdd(ID, cont());
+  }
+  static void add(Txn txn) {
+    TSHttpTxnHookAdd(txn.get(), ID, cont());
+  }
+};
+
+} /* direct */
+} /* api */
+} /* ats */
+
+#endif /* TS_CPP11_DIRECT_H_ */
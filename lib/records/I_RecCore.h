@@ -119,6 +119,12 @@ int RecGetRecordCounter(const char *name, RecCounter * rec_counter, bool lock =
 // Convenience to allow us to treat the RecInt as a single byte internally
 int RecGetRecordByte(const char *name, RecByte * rec_byte, bool lock = true);
 
+// Records are never freed or moved, so a name can be resolved to its
+// record once and read through the handle from then on, without the hash
+// table lookup or g_records_rwlock. Returns NULL if there is no such record.
+RecRecord *RecGetRecordHandle(const char *name, bool lock = true);
+int RecGetRecordByHandle(RecRecord * r, RecDataT data_type, RecData * data);
+
 //------------------------------------------------------------------------
 // Record Attributes Reading
 //------------------------------------------------------------------------
@@ -140,14 +140,39 @@ struct RecRawStat
 {
   int64_t sum;
   int64_t count;
-  // XXX - these will waist some space because they are only needed for the globals
-  // this is a fix for bug TS-162, so I am trying to do as few code changes as
-  // possible, this should be revisted -bcall
   int64_t last_sum; // value from the last global sync
   int64_t last_count; // value from the last global sync
   uint32_t version;
 };
 
+// Thread local part of a raw stat. Only the owning thread writes it, with
+// plain adds, and the sync thread sums the slots of all threads. Keeping it
+// to the two counters puts four stats in a cache line instead of one and a half.
+struct RecRawStatSlot
+{
+  int64_t sum;
+  int64_t count;
+};
+
+
+// Log-linear histogram buckets. Values below 2^REC_HISTOGRAM_SUB_BITS
+// each have a bucket, every larger power of two is split into
+// 2^REC_HISTOGRAM_SUB_BITS buckets (so a bucket is within 1/16 of its
+// values), and values from 2^REC_HISTOGRAM_MAX_BITS up share the last one.
+#define REC_HISTOGRAM_SUB_BITS    4
+#define REC_HISTOGRAM_MAX_BITS    36
+#define REC_HISTOGRAM_BUCKETS     ((REC_HISTOGRAM_MAX_BITS - REC_HISTOGRAM_SUB_BITS + 1) << REC_HISTOGRAM_SUB_BITS)
+#define REC_HISTOGRAM_PERCENTILES 3   // p50, p99, p999
+
+struct RecRecord;
+
+struct RecRawHistogram
+{
+  off_t ethr_offset;                       // thread local buckets
+  int64_t merged[REC_HISTOGRAM_BUCKETS];   // totals as of the last sync, used only by the sync thread
+  RecRecord *percentiles[REC_HISTOGRAM_PERCENTILES];
+};
+
 
 // WARNING!  It's advised that developers do not modify the contents of
 // the RecRawStatBlock.  ^_^
@@ -158,6 +183,7 @@ struct RecRawStatBlock
   int num_stats;            // number of stats in this block
   int max_stats;            // maximum number of stats for this block
   ink_mutex mutex;
+  RecRawHistogram **histograms; // histogram stats by id, NULL until one is registered
 };
 
 
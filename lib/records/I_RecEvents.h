@@ -35,5 +35,7 @@
 #define REC_EVENT_HTTP_CLUSTER_DELTA    10007
 #define REC_EVENT_ROLL_LOG_FILES        10008
 #define REC_EVENT_LIBRECORDS            10009
+#define REC_EVENT_HANDOFF               10010
+#define REC_EVENT_DRAIN                 10011
 
 #endif
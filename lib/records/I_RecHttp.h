@@ -107,6 +107,10 @@ public:
   bool m_outbound_transparent_p;
   // True if transparent pass-through is enabled on this port.
   bool m_transparent_passthrough;
+  /// True if TCP Fast Open is enabled on the listen socket.
+  bool m_tcp_fastopen;
+  /// Seconds for TCP_DEFER_ACCEPT on the listen socket, -1 to use the global value.
+  int m_defer_accept;
   /// Local address for inbound connections (listen address).
   IpAddr m_inbound_ip;
   /// Local address for outbound connections (to origin server).
@@ -261,6 +265,8 @@ public:
   static char const* const OPT_BLIND_TUNNEL; ///< Blind tunnel.
   static char const* const OPT_COMPRESSED; ///< Compressed.
   static char const* const OPT_HOST_RES_PREFIX; ///< Set DNS family preference.
+  static char const* const OPT_TCP_FASTOPEN; ///< TCP Fast Open.
+  static char const* const OPT_DEFER_ACCEPT_PREFIX; ///< Prefix for deferred accept timeout.
 
   static Vec<self>& m_global; ///< Global ("default") data.
 
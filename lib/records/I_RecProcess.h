@@ -48,6 +48,11 @@ void RecProcess_set_remote_sync_interval_ms(int ms);
 RecRawStatBlock *RecAllocateRawStatBlock(int num_stats);
 int RecRegisterRawStat(RecRawStatBlock * rsb, RecT rec_type, const char *name, RecDataT data_type, RecPersistT persist_type, int id, RecRawStatSyncCb sync_cb);
 
+// A histogram stat. The record @a name is the number of samples, and
+// "<name>.p50", "<name>.p99" and "<name>.p999" are the percentiles, in
+// the units of the values passed to RecIncrRawHistogram().
+int RecRegisterRawHistogramStat(RecRawStatBlock * rsb, RecT rec_type, const char *name, RecPersistT persist_type, int id);
+
 
 // RecRawStatRange* RecAllocateRawStatRange (int num_buckets);
 
@@ -70,6 +75,7 @@ int RecRawStatSyncHrTimeAvg(const char *name, RecDataT data_type, RecData * data
 int RecRawStatSyncIntMsecsToFloatSeconds(const char *name, RecDataT data_type,
                                          RecData * data, RecRawStatBlock * rsb, int id);
 int RecRawStatSyncMHrTimeAvg(const char *name, RecDataT data_type, RecData * data, RecRawStatBlock * rsb, int id);
+int RecRawStatSyncHistogram(const char *name, RecDataT data_type, RecData * data, RecRawStatBlock * rsb, int id);
 
 
 //-------------------------------------------------------------------------
@@ -83,6 +89,7 @@ inline int RecIncrRawStat(RecRawStatBlock * rsb, EThread * ethread, int id, int6
 inline int RecIncrRawStatSum(RecRawStatBlock * rsb, EThread * ethread, int id, int64_t incr = 1);
 inline int RecIncrRawStatCount(RecRawStatBlock * rsb, EThread * ethread, int id, int64_t incr = 1);
 int RecIncrRawStatBlock(RecRawStatBlock * rsb, EThread * ethread, RecRawStat * stat_array);
+inline int RecIncrRawHistogram(RecRawStatBlock * rsb, EThread * ethread, int id, int64_t value);
 
 int RecSetRawStatSum(RecRawStatBlock * rsb, int id, int64_t data);
 int RecSetRawStatCount(RecRawStatBlock * rsb, int id, int64_t data);
@@ -110,25 +117,95 @@ int64_t *RecGetGlobalRawStatSumPtr(RecRawStatBlock * rsb, int id);
 int64_t *RecGetGlobalRawStatCountPtr(RecRawStatBlock * rsb, int id);
 
 
+//-------------------------------------------------------------------------
+// Keyed Stats
+//-------------------------------------------------------------------------
+// Counters per key, for keys only known at run time (host names, say).
+// Each thread counts into its own blocks without locks or atomics, and
+// every raw stat sync merges the blocks, so reads see the totals as of the
+// last sync. A table holds at most @a max_keys keys, which are never
+// removed, and gives each one a dense index from 0 to RecKeyedStatCount().
+struct RecKeyedStatTable;
+
+RecKeyedStatTable *RecAllocateKeyedStatTable(const char *name, int num_counters, int max_keys);
+
+// Returns the index of @a key, adding it if @a create is set, or -1 if it is
+// not there or the table is full.
+int RecKeyedStatIndex(RecKeyedStatTable * kst, const char *key, int key_len, bool create);
+void RecIncrKeyedStat(RecKeyedStatTable * kst, int index, int counter, int64_t incr = 1);
+int64_t RecGetKeyedStat(RecKeyedStatTable * kst, int index, int counter);
+int RecKeyedStatCount(RecKeyedStatTable * kst);
+const char *RecKeyedStatKey(RecKeyedStatTable * kst, int index, int *key_len);
+
+
+//-------------------------------------------------------------------------
+// Stat Snapshots
+//-------------------------------------------------------------------------
+// Once enabled, every raw stat sync copies the value of each stat into a
+// read only, versioned snapshot, so exporters never walk or lock the
+// records themselves. Versions start at the wall clock time in msecs and
+// go up by one per snapshot, so they also keep growing across restarts.
+enum RecStatExportFormat
+{
+  REC_STAT_EXPORT_BINARY,
+  REC_STAT_EXPORT_PROMETHEUS,
+  REC_STAT_EXPORT_FORMATS
+};
+
+struct RecStatSnapshotEntry
+{
+  const char *name;             // records are never freed, so neither are their names
+  int name_len;
+  int id;                       // the record's index, fixed for the life of the process
+  RecDataT data_type;
+  RecData data;
+  int64_t changed;              // version the value last changed in
+  int64_t added;                // version the stat first showed up in
+};
+
+struct RecStatSnapshot: public RefCountObj
+{
+  RecStatSnapshot();
+  ~RecStatSnapshot();
+
+  int64_t version;
+  int num_entries;
+  RecStatSnapshotEntry *entries;
+
+  // Full exports are formatted once per snapshot, however many collectors ask.
+  ink_mutex lock;
+  char *full[REC_STAT_EXPORT_FORMATS];
+  int full_length[REC_STAT_EXPORT_FORMATS];
+};
+
+void RecStatSnapshotEnable();
+Ptr<RecStatSnapshot> RecStatSnapshotGet();
+
+// Formats the stats that changed after version @a since (all of them when
+// @a since is 0 or newer than @a snap) into a buffer that the caller
+// must ats_free().
+char *RecStatSnapshotExport(RecStatSnapshot * snap, RecStatExportFormat format, int64_t since, int *length);
+
+
 //-------------------------------------------------------------------------
 // RecIncrRawStatXXX
 //-------------------------------------------------------------------------
 // inlined functions that are used very frequently.
 // FIXME: move it to Inline.cc
-inline RecRawStat *
+inline RecRawStatSlot *
 raw_stat_get_tlp(RecRawStatBlock * rsb, int id, EThread * ethread)
 {
   ink_assert((id >= 0) && (id < rsb->max_stats));
   if (ethread == NULL) {
     ethread = this_ethread();
   }
-  return (((RecRawStat *) ((char *) (ethread) + rsb->ethr_stat_offset)) + id);
+  return (((RecRawStatSlot *) ((char *) (ethread) + rsb->ethr_stat_offset)) + id);
 }
 
 inline int
 RecIncrRawStat(RecRawStatBlock * rsb, EThread * ethread, int id, int64_t incr)
 {
-  RecRawStat *tlp = raw_stat_get_tlp(rsb, id, ethread);
+  RecRawStatSlot *tlp = raw_stat_get_tlp(rsb, id, ethread);
   tlp->sum += incr;
   tlp->count += 1;
   return REC_ERR_OKAY;
@@ -137,7 +214,7 @@ RecIncrRawStat(RecRawStatBlock * rsb, EThread * ethread, int id, int64_t incr)
 inline int
 RecDecrRawStat(RecRawStatBlock * rsb, EThread * ethread, int id, int64_t decr)
 {
-  RecRawStat *tlp = raw_stat_get_tlp(rsb, id, ethread);
+  RecRawStatSlot *tlp = raw_stat_get_tlp(rsb, id, ethread);
   tlp->sum -= decr;
   tlp->count += 1;
   return REC_ERR_OKAY;
@@ -146,7 +223,7 @@ RecDecrRawStat(RecRawStatBlock * rsb, EThread * ethread, int id, int64_t decr)
 inline int
 RecIncrRawStatSum(RecRawStatBlock * rsb, EThread * ethread, int id, int64_t incr)
 {
-  RecRawStat *tlp = raw_stat_get_tlp(rsb, id, ethread);
+  RecRawStatSlot *tlp = raw_stat_get_tlp(rsb, id, ethread);
   tlp->sum += incr;
   return REC_ERR_OKAY;
 }
@@ -154,9 +231,42 @@ RecIncrRawStatSum(RecRawStatBlock * rsb, EThread * ethread, int id, int64_t incr
 inline int
 RecIncrRawStatCount(RecRawStatBlock * rsb, EThread * ethread, int id, int64_t incr)
 {
-  RecRawStat *tlp = raw_stat_get_tlp(rsb, id, ethread);
+  RecRawStatSlot *tlp = raw_stat_get_tlp(rsb, id, ethread);
   tlp->count += incr;
   return REC_ERR_OKAY;
 }
 
+inline int
+rec_histogram_bucket(int64_t value)
+{
+  if (value < (1 << REC_HISTOGRAM_SUB_BITS))
+    return value < 0 ? 0 : (int) value;
+  if (value >= ((int64_t) 1 << REC_HISTOGRAM_MAX_BITS))
+    return REC_HISTOGRAM_BUCKETS - 1;
+#if defined(__GNUC__)
+  int msb = 63 - __builtin_clzll((unsigned long long) value);
+#else
+  int msb = REC_HISTOGRAM_SUB_BITS;
+  while ((value >> (msb + 1)) != 0)
+    ++msb;
+#endif
+  int shift = msb - REC_HISTOGRAM_SUB_BITS;
+  return ((shift + 1) << REC_HISTOGRAM_SUB_BITS) | (int) ((value >> shift) & ((1 << REC_HISTOGRAM_SUB_BITS) - 1));
+}
+
+inline int
+RecIncrRawHistogram(RecRawStatBlock * rsb, EThread * ethread, int id, int64_t value)
+{
+  RecRawStatSlot *tlp = raw_stat_get_tlp(rsb, id, ethread);
+  RecRawHistogram *h = rsb->histograms[id];
+  if (ethread == NULL) {
+    ethread = this_ethread();
+  }
+  int64_t *buckets = (int64_t *) ((char *) (ethread) + h->ethr_offset);
+  buckets[rec_histogram_bucket(value)] += 1;
+  tlp->sum += value;
+  tlp->count += 1;
+  return REC_ERR_OKAY;
+}
+
 #endif /* !_I_REC_PROCESS_H_ */
@@ -44,5 +44,7 @@
 #define REC_SIGNAL_LIBRECORDS                   16
 #define REC_SIGNAL_HTTP_CONGESTED_SERVER        20
 #define REC_SIGNAL_HTTP_ALLEVIATED_SERVER       21
+#define REC_SIGNAL_PROXY_HANDED_OFF             22
+#define REC_SIGNAL_PROXY_PORTS_READY            23
 
 #endif
@@ -27,6 +27,7 @@
 #include "ink_string.h"
 
 #include "P_RecFile.h"
+#include "P_RecShm.h"
 #include "P_RecUtils.h"
 #include "P_RecMessage.h"
 #include "P_RecCore.h"
@@ -111,9 +112,11 @@ send_push_message()
     rec_mutex_acquire(&(r->lock));
     if (i_am_the_record_owner(r->rec_type)) {
       if (r->sync_required & REC_PEER_SYNC_REQUIRED) {
-        m = RecMessageMarshal_Realloc(m, r);
+        if (!RecShmPublish(i, r)) {
+          m = RecMessageMarshal_Realloc(m, r);
+          send_msg = true;
+        }
         r->sync_required = r->sync_required & ~REC_PEER_SYNC_REQUIRED;
-        send_msg = true;
       }
     }
     rec_mutex_release(&(r->lock));
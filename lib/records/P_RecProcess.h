@@ -41,4 +41,8 @@ int RecRegisterRawStatSyncCb(const char *name, RecRawStatSyncCb sync_cb, RecRawS
 
 int RecExecRawStatSyncCbs();
 
+void RecStatSnapshotBuild();
+
+void RecKeyedStatSync();
+
 #endif
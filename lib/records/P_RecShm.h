@@ -0,0 +1,69 @@
+/** @file
+
+  Shared memory transport for process statistics
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#ifndef _P_REC_SHM_H_
+#define _P_REC_SHM_H_
+
+#include "P_RecDefs.h"
+
+//-------------------------------------------------------------------------
+// types/defines
+//-------------------------------------------------------------------------
+
+// traffic_server maps this file in the runtime directory read/write and
+// traffic_manager maps it read only. Each of the process' numeric stats
+// gets the entry at its record index, so after a stat has been announced
+// with a RECG_PUSH message, its value travels through here instead.
+#define REC_SHM_FILE        "records.shm"
+#define REC_SHM_MAGIC       0x52454353  // "RECS"
+#define REC_SHM_NAME_LEN    128
+
+struct RecShmEntry
+{
+  volatile uint32_t seq;        // odd while the entry is being written
+  volatile RecDataT data_type;  // RECD_NULL until the entry is in use
+  RecData data;
+  RecRawStat data_raw;
+  char name[REC_SHM_NAME_LEN];
+};
+
+struct RecShmHeader
+{
+  uint32_t magic;
+  uint32_t entry_size;
+  int32_t max_entries;
+  volatile int32_t num_entries; // entries past this are all unused
+};
+
+//-------------------------------------------------------------------------
+// RecShm
+//-------------------------------------------------------------------------
+
+// traffic_server side
+int RecShmCreate();
+bool RecShmPublish(int idx, RecRecord * r);
+
+// traffic_manager side
+void RecShmRead();
+
+#endif
@@ -782,6 +782,65 @@ RecGetRecord_Xmalloc(const char *name, RecDataT data_type, RecData *data, bool l
 }
 
 
+//-------------------------------------------------------------------------
+// RecGetRecordHandle
+//-------------------------------------------------------------------------
+RecRecord *
+RecGetRecordHandle(const char *name, bool lock)
+{
+  RecRecord *r;
+
+  if (lock) {
+    ink_rwlock_rdlock(&g_records_rwlock);
+  }
+
+  if (!ink_hash_table_lookup(g_records_ht, name, (void **) &r)) {
+    r = NULL;
+  }
+
+  if (lock) {
+    ink_rwlock_unlock(&g_records_rwlock);
+  }
+
+  return r;
+}
+
+
+//-------------------------------------------------------------------------
+// RecGetRecordByHandle
+//-------------------------------------------------------------------------
+int
+RecGetRecordByHandle(RecRecord *r, RecDataT data_type, RecData *data)
+{
+  if (r == NULL || !r->registered || (r->data_type != data_type)) {
+    return REC_ERR_FAIL;
+  }
+
+  memset(data, 0, sizeof(RecData));
+  switch (data_type) {
+#if SIZEOF_VOIDP == 8
+  // Writers store these with a single word sized store, so on 64 bit
+  // hosts a plain load can never see half of an update.
+  case RECD_INT:
+  case RECD_COUNTER:
+    data->rec_int = *(volatile RecInt *) &(r->data.rec_int);
+    break;
+  case RECD_FLOAT:
+    data->rec_float = *(volatile RecFloat *) &(r->data.rec_float);
+    break;
+#endif
+  default:
+    // Strings can be freed by a concurrent set, so copy them under the lock.
+    rec_mutex_acquire(&(r->lock));
+    RecDataSet(data_type, data, &(r->data));
+    rec_mutex_release(&(r->lock));
+    break;
+  }
+
+  return REC_ERR_OKAY;
+}
+
+
 //-------------------------------------------------------------------------
 // RecForceInsert
 //-------------------------------------------------------------------------
@@ -69,6 +69,7 @@ char const* const HttpProxyPort::OPT_FD_PREFIX = "fd";
 char const* const HttpProxyPort::OPT_OUTBOUND_IP_PREFIX = "ip-out";
 char const* const HttpProxyPort::OPT_INBOUND_IP_PREFIX = "ip-in";
 char const* const HttpProxyPort::OPT_HOST_RES_PREFIX = "ip-resolve";
+char const* const HttpProxyPort::OPT_DEFER_ACCEPT_PREFIX = "defer";
 
 char const* const HttpProxyPort::OPT_IPV6 = "ipv6";
 char const* const HttpProxyPort::OPT_IPV4 = "ipv4";
@@ -79,6 +80,7 @@ char const* const HttpProxyPort::OPT_TRANSPARENT_PASSTHROUGH = "tr-pass";
 char const* const HttpProxyPort::OPT_SSL = "ssl";
 char const* const HttpProxyPort::OPT_BLIND_TUNNEL = "blind";
 char const* const HttpProxyPort::OPT_COMPRESSED = "compressed";
+char const* const HttpProxyPort::OPT_TCP_FASTOPEN = "tfo";
 
 // File local constants.
 namespace {
@@ -87,6 +89,7 @@ namespace {
   size_t const OPT_OUTBOUND_IP_PREFIX_LEN = strlen(HttpProxyPort::OPT_OUTBOUND_IP_PREFIX);
   size_t const OPT_INBOUND_IP_PREFIX_LEN = strlen(HttpProxyPort::OPT_INBOUND_IP_PREFIX);
   size_t const OPT_HOST_RES_PREFIX_LEN = strlen(HttpProxyPort::OPT_HOST_RES_PREFIX);
+  size_t const OPT_DEFER_ACCEPT_PREFIX_LEN = strlen(HttpProxyPort::OPT_DEFER_ACCEPT_PREFIX);
 }
 
 namespace {
@@ -107,6 +110,8 @@ HttpProxyPort::HttpProxyPort()
   , m_inbound_transparent_p(false)
   , m_outbound_transparent_p(false)
   , m_transparent_passthrough(false)
+  , m_tcp_fastopen(false)
+  , m_defer_accept(-1)
 {
   memcpy(m_host_res_preference, host_res_default_preference_order, sizeof(m_host_res_preference));
 }
@@ -251,6 +256,22 @@ HttpProxyPort::processOptions(char const* opts) {
         Warning("Invalid IP address value '%s' in port descriptor '%s'",
           item, opts
         );
+    } else if (0 == strncasecmp(OPT_DEFER_ACCEPT_PREFIX, item, OPT_DEFER_ACCEPT_PREFIX_LEN)) {
+      char* ptr; // tmp for syntax check.
+      item += OPT_DEFER_ACCEPT_PREFIX_LEN; // skip prefix
+      if ('-' == *item || '=' == *item) ++item; // permit optional '-' or '='
+      int defer = strtoul(item, &ptr, 10);
+      if (ptr == item) {
+        Warning("Mangled deferred accept value '%s' in port descriptor '%s'", item, opts);
+      } else {
+        m_defer_accept = defer;
+      }
+    } else if (0 == strcasecmp(OPT_TCP_FASTOPEN, item)) {
+# if defined(TCP_FASTOPEN)
+      m_tcp_fastopen = true;
+# else
+      Warning("TCP Fast Open requested [%s] in port descriptor '%s' but it is not supported on this platform.", item, opts);
+# endif
     } else if (0 == strcasecmp(OPT_COMPRESSED, item)) {
       m_type = TRANSPORT_COMPRESSED;
     } else if (0 == strcasecmp(OPT_BLIND_TUNNEL, item)) {
@@ -412,6 +433,13 @@ HttpProxyPort::print(char* out, size_t n) {
 
   if (m_transparent_passthrough)
     zret += snprintf(out+zret, n-zret, ":%s", OPT_TRANSPARENT_PASSTHROUGH);
+  if (zret >= n) return n;
+
+  if (m_tcp_fastopen)
+    zret += snprintf(out+zret, n-zret, ":%s", OPT_TCP_FASTOPEN);
+  if (m_defer_accept >= 0)
+    zret += snprintf(out+zret, n-zret, ":%s=%d", OPT_DEFER_ACCEPT_PREFIX, m_defer_accept);
+  if (zret >= n) return n;
 
   /* Don't print the IP resolution preferences if the port is outbound
    * transparent (which means the preference order is forced) or if
@@ -0,0 +1,271 @@
+/** @file
+
+  Keyed stats, counters per run time key merged across threads
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#include "libts.h"
+
+#include "P_EventSystem.h"
+#include "P_RecCore.h"
+#include "P_RecProcess.h"
+
+// Keys live in an open addressed hash table with at least twice as many
+// slots as keys, so a probe always ends at an empty slot. Keys are only
+// added, under the table lock, and a slot is published by setting its key
+// last, so lookups take no lock. Each key also gets a dense index, which
+// is what the counters are addressed by.
+//
+// Each thread counts into its own blocks of KEYED_STAT_CHUNK_KEYS keys,
+// allocated the first time the thread counts a key in the block. The raw
+// stat sync adds up the blocks of all the threads into the merged blocks
+// that readers see.
+#define KEYED_STAT_CHUNK_KEYS 256
+
+struct RecKeyedStatSlot
+{
+  const char *volatile key;
+  int key_len;
+  uint32_t hash;
+  int index;
+};
+
+struct RecKeyedStatThread
+{
+  int64_t *volatile *chunks;
+  RecKeyedStatThread *next;
+};
+
+struct RecKeyedStatTable
+{
+  char *name;
+  int num_counters;
+  int max_keys;
+  int num_chunks;
+  uint32_t slot_mask;
+  RecKeyedStatSlot *slots;
+  RecKeyedStatSlot **by_index;
+  volatile int num_keys;
+
+  ink_mutex lock;               // adding keys and threads
+  ink_thread_key thread_key;
+  RecKeyedStatThread *threads;
+
+  // Only the raw stat sync writes these.
+  int64_t *volatile *merged;
+  int64_t *scratch;
+
+  RecKeyedStatTable *next;
+};
+
+static RecKeyedStatTable *volatile g_keyed_stats = NULL;
+
+static inline uint32_t
+keyed_stat_hash(const char *key, int key_len)
+{
+  uint32_t hash = 2166136261U;  // FNV-1a
+
+  for (int i = 0; i < key_len; i++) {
+    hash ^= (unsigned char) key[i];
+    hash *= 16777619U;
+  }
+  return hash;
+}
+
+static int
+keyed_stat_find(RecKeyedStatTable *kst, const char *key, int key_len, uint32_t hash, RecKeyedStatSlot **empty)
+{
+  for (uint32_t i = hash & kst->slot_mask;; i = (i + 1) & kst->slot_mask) {
+    RecKeyedStatSlot *slot = &kst->slots[i];
+    const char *k = slot->key;
+
+    if (k == NULL) {
+      if (empty)
+        *empty = slot;
+      return -1;
+    }
+    if (slot->hash == hash && slot->key_len == key_len && !memcmp(k, key, key_len))
+      return slot->index;
+  }
+}
+
+static RecKeyedStatThread *
+keyed_stat_thread(RecKeyedStatTable *kst)
+{
+  RecKeyedStatThread *t = (RecKeyedStatThread *) ink_thread_getspecific(kst->thread_key);
+
+  if (t == NULL) {
+    // Never freed, what a thread counted stays in the totals.
+    t = (RecKeyedStatThread *) ats_malloc(sizeof(RecKeyedStatThread));
+    t->chunks = (int64_t * volatile *) ats_calloc(kst->num_chunks, sizeof(int64_t *));
+    ink_mutex_acquire(&kst->lock);
+    t->next = kst->threads;
+    kst->threads = t;
+    ink_mutex_release(&kst->lock);
+    ink_thread_setspecific(kst->thread_key, t);
+  }
+  return t;
+}
+
+RecKeyedStatTable *
+RecAllocateKeyedStatTable(const char *name, int num_counters, int max_keys)
+{
+  if (num_counters <= 0 || max_keys <= 0)
+    return NULL;
+
+  RecKeyedStatTable *kst = (RecKeyedStatTable *) ats_calloc(1, sizeof(RecKeyedStatTable));
+  uint32_t num_slots = 2;
+
+  while (num_slots < (uint32_t) max_keys * 2)
+    num_slots <<= 1;
+
+  kst->name = ats_strdup(name);
+  kst->num_counters = num_counters;
+  kst->max_keys = max_keys;
+  kst->num_chunks = (max_keys + KEYED_STAT_CHUNK_KEYS - 1) / KEYED_STAT_CHUNK_KEYS;
+  kst->slot_mask = num_slots - 1;
+  kst->slots = (RecKeyedStatSlot *) ats_calloc(num_slots, sizeof(RecKeyedStatSlot));
+  kst->by_index = (RecKeyedStatSlot **) ats_calloc(max_keys, sizeof(RecKeyedStatSlot *));
+  kst->merged = (int64_t * volatile *) ats_calloc(kst->num_chunks, sizeof(int64_t *));
+  kst->scratch = (int64_t *) ats_malloc(KEYED_STAT_CHUNK_KEYS * num_counters * sizeof(int64_t));
+  ink_mutex_init(&kst->lock, "RecKeyedStatTable");
+  ink_thread_key_create(&kst->thread_key, NULL);
+
+  do {
+    kst->next = g_keyed_stats;
+  } while (!ink_atomic_cas(&g_keyed_stats, kst->next, kst));
+
+  Debug("stats", "keyed stat %s: %d counters, %d keys", kst->name, num_counters, max_keys);
+  return kst;
+}
+
+int
+RecKeyedStatIndex(RecKeyedStatTable *kst, const char *key, int key_len, bool create)
+{
+  uint32_t hash = keyed_stat_hash(key, key_len);
+  RecKeyedStatSlot *slot = NULL;
+  int index = keyed_stat_find(kst, key, key_len, hash, NULL);
+
+  if (index >= 0 || !create)
+    return index;
+
+  ink_mutex_acquire(&kst->lock);
+  // another thread may have added it since
+  index = keyed_stat_find(kst, key, key_len, hash, &slot);
+  if (index < 0 && kst->num_keys < kst->max_keys) {
+    char *k = (char *) ats_malloc(key_len + 1);
+
+    memcpy(k, key, key_len);
+    k[key_len] = '\0';
+    index = kst->num_keys;
+    slot->key_len = key_len;
+    slot->hash = hash;
+    slot->index = index;
+    kst->by_index[index] = slot;
+    ink_atomic_cas(&slot->key, (const char *) NULL, (const char *) k);
+    ink_atomic_increment(&kst->num_keys, 1);
+  }
+  ink_mutex_release(&kst->lock);
+  return index;
+}
+
+void
+RecIncrKeyedStat(RecKeyedStatTable *kst, int index, int counter, int64_t incr)
+{
+  ink_assert(index >= 0 && index < kst->num_keys);
+  ink_assert(counter >= 0 && counter < kst->num_counters);
+
+  RecKeyedStatThread *t = keyed_stat_thread(kst);
+  int c = index / KEYED_STAT_CHUNK_KEYS;
+  int64_t *chunk = t->chunks[c];
+
+  if (chunk == NULL) {
+    chunk = (int64_t *) ats_calloc(KEYED_STAT_CHUNK_KEYS * kst->num_counters, sizeof(int64_t));
+    t->chunks[c] = chunk;
+  }
+  chunk[(index % KEYED_STAT_CHUNK_KEYS) * kst->num_counters + counter] += incr;
+}
+
+int64_t
+RecGetKeyedStat(RecKeyedStatTable *kst, int index, int counter)
+{
+  ink_assert(counter >= 0 && counter < kst->num_counters);
+
+  if (index < 0 || index >= kst->num_keys)
+    return 0;
+
+  int64_t *chunk = kst->merged[index / KEYED_STAT_CHUNK_KEYS];
+
+  return chunk ? chunk[(index % KEYED_STAT_CHUNK_KEYS) * kst->num_counters + counter] : 0;
+}
+
+int
+RecKeyedStatCount(RecKeyedStatTable *kst)
+{
+  return kst->num_keys;
+}
+
+const char *
+RecKeyedStatKey(RecKeyedStatTable *kst, int index, int *key_len)
+{
+  if (index < 0 || index >= kst->num_keys)
+    return NULL;
+
+  RecKeyedStatSlot *slot = kst->by_index[index];
+
+  if (key_len)
+    *key_len = slot->key_len;
+  return slot->key;
+}
+
+//-------------------------------------------------------------------------
+// RecKeyedStatSync
+//-------------------------------------------------------------------------
+void
+RecKeyedStatSync()
+{
+  for (RecKeyedStatTable *kst = g_keyed_stats; kst; kst = kst->next) {
+    int num_keys = kst->num_keys;
+    int chunk_size = KEYED_STAT_CHUNK_KEYS * kst->num_counters;
+
+    ink_mutex_acquire(&kst->lock);
+    for (int c = 0; c * KEYED_STAT_CHUNK_KEYS < num_keys; c++) {
+      int64_t *merged = kst->merged[c];
+
+      memset(kst->scratch, 0, chunk_size * sizeof(int64_t));
+      for (RecKeyedStatThread *t = kst->threads; t; t = t->next) {
+        int64_t *chunk = t->chunks[c];
+
+        if (chunk) {
+          for (int i = 0; i < chunk_size; i++)
+            kst->scratch[i] += chunk[i];
+        }
+      }
+      if (merged == NULL) {
+        merged = (int64_t *) ats_calloc(chunk_size, sizeof(int64_t));
+        kst->merged[c] = merged;
+      }
+      // element by element, so that readers never see a torn value
+      for (int i = 0; i < chunk_size; i++)
+        merged[i] = kst->scratch[i];
+    }
+    ink_mutex_release(&kst->lock);
+  }
+}
@@ -28,6 +28,7 @@
 #include "P_RecMessage.h"
 #include "P_RecUtils.h"
 #include "P_RecFile.h"
+#include "P_RecShm.h"
 
 static bool g_initialized = false;
 static bool g_message_initialized = false;
@@ -104,6 +105,7 @@ sync_thr(void *data)
   Rollback *rb;
 
   while (1) {
+    RecShmRead();
     send_push_message();
     RecSyncStatsFile();
     if (RecSyncConfigToTB(tb) == REC_ERR_OKAY) {
@@ -29,6 +29,7 @@
 #include "P_RecMessage.h"
 #include "P_RecUtils.h"
 #include "P_RecFile.h"
+#include "P_RecShm.h"
 
 #include "mgmtapi.h"
 
@@ -102,7 +103,7 @@ static int
 raw_stat_get_total(RecRawStatBlock *rsb, int id, RecRawStat *total)
 {
   int i;
-  RecRawStat *tlp;
+  RecRawStatSlot *tlp;
 
   total->sum = 0;
   total->count = 0;
@@ -113,13 +114,13 @@ raw_stat_get_total(RecRawStatBlock *rsb, int id, RecRawStat *total)
 
   // get thread local values
   for (i = 0; i < eventProcessor.n_ethreads; i++) {
-    tlp = ((RecRawStat *) ((char *) (eventProcessor.all_ethreads[i]) + rsb->ethr_stat_offset)) + id;
+    tlp = ((RecRawStatSlot *) ((char *) (eventProcessor.all_ethreads[i]) + rsb->ethr_stat_offset)) + id;
     total->sum += tlp->sum;
     total->count += tlp->count;
   }
 
   for (i = 0; i < eventProcessor.n_dthreads; i++) {
-    tlp = ((RecRawStat *) ((char *) (eventProcessor.all_dthreads[i]) + rsb->ethr_stat_offset)) + id;
+    tlp = ((RecRawStatSlot *) ((char *) (eventProcessor.all_dthreads[i]) + rsb->ethr_stat_offset)) + id;
     total->sum += tlp->sum;
     total->count += tlp->count;
   }
@@ -139,7 +140,7 @@ static int
 raw_stat_sync_to_global(RecRawStatBlock *rsb, int id)
 {
   int i;
-  RecRawStat *tlp;
+  RecRawStatSlot *tlp;
   RecRawStat total;
 
   total.sum = 0;
@@ -147,13 +148,13 @@ raw_stat_sync_to_global(RecRawStatBlock *rsb, int id)
 
   // sum the thread local values
   for (i = 0; i < eventProcessor.n_ethreads; i++) {
-    tlp = ((RecRawStat *) ((char *) (eventProcessor.all_ethreads[i]) + rsb->ethr_stat_offset)) + id;
+    tlp = ((RecRawStatSlot *) ((char *) (eventProcessor.all_ethreads[i]) + rsb->ethr_stat_offset)) + id;
     total.sum += tlp->sum;
     total.count += tlp->count;
   }
 
   for (i = 0; i < eventProcessor.n_dthreads; i++) {
-    tlp = ((RecRawStat *) ((char *) (eventProcessor.all_dthreads[i]) + rsb->ethr_stat_offset)) + id;
+    tlp = ((RecRawStatSlot *) ((char *) (eventProcessor.all_dthreads[i]) + rsb->ethr_stat_offset)) + id;
     total.sum += tlp->sum;
     total.count += tlp->count;
   }
@@ -188,6 +189,92 @@ raw_stat_sync_to_global(RecRawStatBlock *rsb, int id)
 }
 
 
+//-------------------------------------------------------------------------
+// raw_histogram_clear / raw_histogram_merge
+//-------------------------------------------------------------------------
+static void
+raw_histogram_clear(RecRawHistogram *h)
+{
+  int64_t *buckets;
+
+  for (int i = 0; i < eventProcessor.n_ethreads; i++) {
+    buckets = (int64_t *) ((char *) (eventProcessor.all_ethreads[i]) + h->ethr_offset);
+    memset(buckets, 0, REC_HISTOGRAM_BUCKETS * sizeof(int64_t));
+  }
+
+  for (int i = 0; i < eventProcessor.n_dthreads; i++) {
+    buckets = (int64_t *) ((char *) (eventProcessor.all_dthreads[i]) + h->ethr_offset);
+    memset(buckets, 0, REC_HISTOGRAM_BUCKETS * sizeof(int64_t));
+  }
+}
+
+// Each thread only adds to its own buckets, so the totals are rebuilt on
+// every sync from plain reads. A bucket read while it is being bumped is
+// at most one sample behind.
+static int64_t
+raw_histogram_merge(RecRawHistogram *h)
+{
+  int64_t *buckets;
+  int64_t total = 0;
+
+  memset(h->merged, 0, sizeof(h->merged));
+  for (int i = 0; i < eventProcessor.n_ethreads; i++) {
+    buckets = (int64_t *) ((char *) (eventProcessor.all_ethreads[i]) + h->ethr_offset);
+    for (int b = 0; b < REC_HISTOGRAM_BUCKETS; b++)
+      h->merged[b] += buckets[b];
+  }
+
+  for (int i = 0; i < eventProcessor.n_dthreads; i++) {
+    buckets = (int64_t *) ((char *) (eventProcessor.all_dthreads[i]) + h->ethr_offset);
+    for (int b = 0; b < REC_HISTOGRAM_BUCKETS; b++)
+      h->merged[b] += buckets[b];
+  }
+
+  for (int b = 0; b < REC_HISTOGRAM_BUCKETS; b++)
+    total += h->merged[b];
+
+  return total;
+}
+
+// The largest value counted in bucket @a b.
+static int64_t
+raw_histogram_bucket_value(int b)
+{
+  if (b < (1 << REC_HISTOGRAM_SUB_BITS))
+    return b;
+
+  int shift = (b >> REC_HISTOGRAM_SUB_BITS) - 1;
+  int64_t low = ((int64_t) ((1 << REC_HISTOGRAM_SUB_BITS) | (b & ((1 << REC_HISTOGRAM_SUB_BITS) - 1)))) << shift;
+  return low + ((int64_t) 1 << shift) - 1;
+}
+
+static int64_t
+raw_histogram_percentile(RecRawHistogram *h, int64_t total, double q)
+{
+  int64_t rank = (int64_t) ceil(q * (double) total);
+  int64_t seen = 0;
+
+  if (rank < 1)
+    rank = 1;
+  for (int b = 0; b < REC_HISTOGRAM_BUCKETS; b++) {
+    seen += h->merged[b];
+    if (seen >= rank)
+      return raw_histogram_bucket_value(b);
+  }
+  return 0;
+}
+
+static const struct
+{
+  const char *suffix;
+  double q;
+} raw_histogram_percentiles[REC_HISTOGRAM_PERCENTILES] = {
+  { ".p50", 0.5 },
+  { ".p99", 0.99 },
+  { ".p999", 0.999 }
+};
+
+
 //-------------------------------------------------------------------------
 // raw_stat_clear
 //-------------------------------------------------------------------------
@@ -206,19 +293,23 @@ raw_stat_clear(RecRawStatBlock *rsb, int id)
   ink_mutex_release(&(rsb->mutex));
 
   // reset the local stats
-  RecRawStat *tlp;
+  RecRawStatSlot *tlp;
   for (int i = 0; i < eventProcessor.n_ethreads; i++) {
-    tlp = ((RecRawStat *) ((char *) (eventProcessor.all_ethreads[i]) + rsb->ethr_stat_offset)) + id;
+    tlp = ((RecRawStatSlot *) ((char *) (eventProcessor.all_ethreads[i]) + rsb->ethr_stat_offset)) + id;
     ink_atomic_swap(&(tlp->sum), (int64_t)0);
     ink_atomic_swap(&(tlp->count), (int64_t)0);
   }
 
   for (int i = 0; i < eventProcessor.n_dthreads; i++) {
-    tlp = ((RecRawStat *) ((char *) (eventProcessor.all_dthreads[i]) + rsb->ethr_stat_offset)) + id;
+    tlp = ((RecRawStatSlot *) ((char *) (eventProcessor.all_dthreads[i]) + rsb->ethr_stat_offset)) + id;
     ink_atomic_swap(&(tlp->sum), (int64_t)0);
     ink_atomic_swap(&(tlp->count), (int64_t)0);
   }
 
+  if (rsb->histograms && rsb->histograms[id]) {
+    raw_histogram_clear(rsb->histograms[id]);
+  }
+
   return REC_ERR_OKAY;
 }
 
@@ -239,14 +330,14 @@ raw_stat_clear_sum(RecRawStatBlock *rsb, int id)
   ink_mutex_release(&(rsb->mutex));
 
   // reset the local stats
-  RecRawStat *tlp;
+  RecRawStatSlot *tlp;
   for (int i = 0; i < eventProcessor.n_ethreads; i++) {
-    tlp = ((RecRawStat *) ((char *) (eventProcessor.all_ethreads[i]) + rsb->ethr_stat_offset)) + id;
+    tlp = ((RecRawStatSlot *) ((char *) (eventProcessor.all_ethreads[i]) + rsb->ethr_stat_offset)) + id;
     ink_atomic_swap(&(tlp->sum), (int64_t)0);
   }
 
   for (int i = 0; i < eventProcessor.n_dthreads; i++) {
-    tlp = ((RecRawStat *) ((char *) (eventProcessor.all_dthreads[i]) + rsb->ethr_stat_offset)) + id;
+    tlp = ((RecRawStatSlot *) ((char *) (eventProcessor.all_dthreads[i]) + rsb->ethr_stat_offset)) + id;
     ink_atomic_swap(&(tlp->sum), (int64_t)0);
   }
 
@@ -270,14 +361,14 @@ raw_stat_clear_count(RecRawStatBlock *rsb, int id)
   ink_mutex_release(&(rsb->mutex));
 
   // reset the local stats
-  RecRawStat *tlp;
+  RecRawStatSlot *tlp;
   for (int i = 0; i < eventProcessor.n_ethreads; i++) {
-    tlp = ((RecRawStat *) ((char *) (eventProcessor.all_ethreads[i]) + rsb->ethr_stat_offset)) + id;
+    tlp = ((RecRawStatSlot *) ((char *) (eventProcessor.all_ethreads[i]) + rsb->ethr_stat_offset)) + id;
     ink_atomic_swap(&(tlp->count), (int64_t)0);
   }
 
   for (int i = 0; i < eventProcessor.n_dthreads; i++) {
-    tlp = ((RecRawStat *) ((char *) (eventProcessor.all_dthreads[i]) + rsb->ethr_stat_offset)) + id;
+    tlp = ((RecRawStatSlot *) ((char *) (eventProcessor.all_dthreads[i]) + rsb->ethr_stat_offset)) + id;
     ink_atomic_swap(&(tlp->count), (int64_t)0);
   }
 
@@ -319,6 +410,8 @@ struct raw_stat_sync_cont: public Continuation
   {
     while (true) {
       RecExecRawStatSyncCbs();
+      RecKeyedStatSync();
+      RecStatSnapshotBuild();
       Debug("statsproc", "raw_stat_sync_cont() processed");
       usleep(g_rec_raw_stat_sync_interval_ms * 1000);
     }
@@ -452,6 +545,9 @@ RecProcessInitMessage(RecModeT mode_type)
   }
 
   if (mode_type == RECM_CLIENT) {
+    // Stats go to traffic_manager through shared memory where we can; if
+    // not, they all keep going in messages.
+    RecShmCreate();
     send_pull_message(RECG_PULL_REQ);
     g_force_req_notify.lock();
     g_force_req_notify.wait();
@@ -503,7 +599,7 @@ RecAllocateRawStatBlock(int num_stats)
   RecRawStatBlock *rsb;
 
   // allocate thread-local raw-stat memory
-  if ((ethr_stat_offset = eventProcessor.allocate(num_stats * sizeof(RecRawStat))) == -1) {
+  if ((ethr_stat_offset = eventProcessor.allocate(num_stats * sizeof(RecRawStatSlot))) == -1) {
     return NULL;
   }
   // create the raw-stat-block structure
@@ -562,6 +658,57 @@ Ldone:
 }
 
 
+//-------------------------------------------------------------------------
+// RecRegisterRawHistogramStat
+//-------------------------------------------------------------------------
+int
+RecRegisterRawHistogramStat(RecRawStatBlock *rsb, RecT rec_type, const char *name, RecPersistT persist_type, int id)
+{
+  Debug("stats", "RecRegisterRawHistogramStat(%s): rsb pointer:%p id:%d\n", name, rsb, id);
+
+  ink_assert(id < rsb->max_stats);
+
+  off_t ethr_offset;
+  RecRawHistogram *h;
+  RecData data_default;
+  memset(&data_default, 0, sizeof(RecData));
+
+  // allocate thread-local bucket memory
+  if ((ethr_offset = eventProcessor.allocate(REC_HISTOGRAM_BUCKETS * sizeof(int64_t))) == -1) {
+    return REC_ERR_FAIL;
+  }
+
+  h = (RecRawHistogram *)ats_malloc(sizeof(RecRawHistogram));
+  memset(h, 0, sizeof(RecRawHistogram));
+  h->ethr_offset = ethr_offset;
+
+  for (int i = 0; i < REC_HISTOGRAM_PERCENTILES; i++) {
+    char pname[1024];
+    RecRecord *r;
+
+    snprintf(pname, sizeof(pname), "%s%s", name, raw_histogram_percentiles[i].suffix);
+    if ((r = RecRegisterStat(rec_type, pname, RECD_INT, data_default, persist_type)) == NULL) {
+      ats_free(h);
+      return REC_ERR_FAIL;
+    }
+    if (i_am_the_record_owner(r->rec_type)) {
+      r->sync_required = r->sync_required | REC_PEER_SYNC_REQUIRED;
+    } else {
+      send_register_message(r);
+    }
+    h->percentiles[i] = r;
+  }
+
+  if (rsb->histograms == NULL) {
+    rsb->histograms = (RecRawHistogram **)ats_malloc(rsb->max_stats * sizeof(RecRawHistogram *));
+    memset(rsb->histograms, 0, rsb->max_stats * sizeof(RecRawHistogram *));
+  }
+  rsb->histograms[id] = h;
+
+  return RecRegisterRawStat(rsb, rec_type, name, RECD_INT, persist_type, id, RecRawStatSyncHistogram);
+}
+
+
 //-------------------------------------------------------------------------
 // RecRawStatSync...
 //-------------------------------------------------------------------------
@@ -672,6 +819,31 @@ RecRawStatSyncMHrTimeAvg(const char *name, RecDataT data_type, RecData *data, Re
 }
 
 
+int
+RecRawStatSyncHistogram(const char *name, RecDataT data_type, RecData *data, RecRawStatBlock *rsb, int id)
+{
+  RecRawHistogram *h = rsb->histograms[id];
+  int64_t total;
+
+  Debug("stats", "raw sync:histogram for %s", name);
+  raw_stat_sync_to_global(rsb, id);
+  total = raw_histogram_merge(h);
+
+  for (int i = 0; i < REC_HISTOGRAM_PERCENTILES; i++) {
+    RecRecord *r = h->percentiles[i];
+    int64_t value = total ? raw_histogram_percentile(h, total, raw_histogram_percentiles[i].q) : 0;
+
+    rec_mutex_acquire(&(r->lock));
+    r->data.rec_int = value;
+    r->sync_required = REC_SYNC_REQUIRED;
+    rec_mutex_release(&(r->lock));
+  }
+
+  RecDataSetFromInk64(data_type, data, rsb->global[id]->count);
+  return REC_ERR_OKAY;
+}
+
+
 //-------------------------------------------------------------------------
 // RecIncrRawStatXXX
 //-------------------------------------------------------------------------
@@ -878,3 +1050,37 @@ RecExecRawStatSyncCbs()
 
   return REC_ERR_OKAY;
 }
+
+
+#if TS_HAS_TESTS
+#include "ts/TestBox.h"
+
+REGRESSION_TEST(RecHistogram)(RegressionTest * t, int /* atype ATS_UNUSED */, int * pstatus)
+{
+  TestBox box(t, pstatus);
+  RecRawHistogram h;
+
+  box = REGRESSION_TEST_PASSED;
+
+  // every value lands in a bucket whose largest value is no more than 1/16 above it
+  for (int64_t v = 0; v < ((int64_t) 1 << REC_HISTOGRAM_MAX_BITS); v = v * 3 / 2 + 1) {
+    int b = rec_histogram_bucket(v);
+    int64_t top = raw_histogram_bucket_value(b);
+    box.check(b >= 0 && b < REC_HISTOGRAM_BUCKETS, "value %" PRId64 " has bucket %d", v, b);
+    box.check(top >= v && top - v <= v / (1 << REC_HISTOGRAM_SUB_BITS), "value %" PRId64 " reads back as %" PRId64, v, top);
+    box.check(b == 0 || raw_histogram_bucket_value(b - 1) < v, "value %" PRId64 " is not in the lowest bucket", v);
+  }
+  box.check(rec_histogram_bucket(-1) == 0, "negative values are counted as 0");
+  box.check(rec_histogram_bucket((int64_t) 1 << 40) == REC_HISTOGRAM_BUCKETS - 1, "large values go in the last bucket");
+
+  // 1000 samples: 1 .. 989 once each and 11 of 5000
+  memset(h.merged, 0, sizeof(h.merged));
+  for (int64_t v = 1; v < 990; v++)
+    h.merged[rec_histogram_bucket(v)]++;
+  h.merged[rec_histogram_bucket(5000)] += 11;
+
+  box.check(raw_histogram_percentile(&h, 1000, 0.5) == raw_histogram_bucket_value(rec_histogram_bucket(500)), "p50");
+  box.check(raw_histogram_percentile(&h, 1000, 0.99) == raw_histogram_bucket_value(rec_histogram_bucket(5000)), "p99");
+  box.check(raw_histogram_percentile(&h, 1000, 0.999) == raw_histogram_bucket_value(rec_histogram_bucket(5000)), "p999");
+}
+#endif
@@ -0,0 +1,241 @@
+/** @file
+
+  Shared memory transport for process statistics
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#include "libts.h"
+
+#include <sys/mman.h>
+
+#include "P_RecCore.h"
+#include "P_RecShm.h"
+#include "P_RecUtils.h"
+#include "I_Layout.h"
+
+static RecShmHeader *g_shm = NULL;
+static RecShmEntry *g_shm_entries = NULL;
+static bool g_shm_writer = false;
+
+// traffic_manager only: the mapped file, and the local record behind
+// each entry once it has been looked up.
+static dev_t g_shm_dev;
+static ino_t g_shm_ino;
+static size_t g_shm_size = 0;
+static RecRecord **g_shm_records = NULL;
+
+static size_t
+shm_size()
+{
+  return sizeof(RecShmHeader) + REC_MAX_RECORDS * sizeof(RecShmEntry);
+}
+
+static bool
+shm_is_numeric_stat(RecRecord * r)
+{
+  if (!REC_TYPE_IS_STAT(r->rec_type) || !r->registered)
+    return false;
+  return r->data_type == RECD_INT || r->data_type == RECD_FLOAT || r->data_type == RECD_COUNTER;
+}
+
+//-------------------------------------------------------------------------
+// RecShmCreate
+//-------------------------------------------------------------------------
+int
+RecShmCreate()
+{
+  char *path = Layout::relative_to(Layout::get()->runtimedir, REC_SHM_FILE);
+  size_t size = shm_size();
+  int fd;
+  void *p;
+
+  // A traffic_manager may still have the last traffic_server's file
+  // mapped, so never truncate it; start a new one.
+  unlink(path);
+  if ((fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0644)) < 0) {
+    RecLog(DL_Warning, "unable to create '%s': %s", path, strerror(errno));
+    ats_free(path);
+    return REC_ERR_FAIL;
+  }
+  if (ftruncate(fd, size) < 0 || (p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+    RecLog(DL_Warning, "unable to map '%s': %s", path, strerror(errno));
+    close(fd);
+    unlink(path);
+    ats_free(path);
+    return REC_ERR_FAIL;
+  }
+  close(fd);
+  ats_free(path);
+
+  g_shm = (RecShmHeader *) p;
+  g_shm_entries = (RecShmEntry *) (g_shm + 1);
+  g_shm_writer = true;
+  g_shm->entry_size = sizeof(RecShmEntry);
+  g_shm->max_entries = REC_MAX_RECORDS;
+  g_shm->num_entries = 0;
+  __sync_synchronize();
+  g_shm->magic = REC_SHM_MAGIC;
+
+  return REC_ERR_OKAY;
+}
+
+//-------------------------------------------------------------------------
+// RecShmPublish
+//-------------------------------------------------------------------------
+// Called with the record locked by send_push_message(), the only writer.
+// Returns true if the value went out through the shared memory, false if
+// it still has to be pushed in a message.
+bool
+RecShmPublish(int idx, RecRecord * r)
+{
+  if (!g_shm_writer || idx >= REC_MAX_RECORDS || !shm_is_numeric_stat(r))
+    return false;
+
+  RecShmEntry *e = &(g_shm_entries[idx]);
+
+  if (e->data_type == RECD_NULL) {
+    // The first push announces the record to traffic_manager, which
+    // looks it up by the name here from then on.
+    if ((int) strlen(r->name) >= REC_SHM_NAME_LEN)
+      return false;
+    ink_strlcpy(e->name, r->name, REC_SHM_NAME_LEN);
+    e->data = r->data;
+    e->data_raw = r->stat_meta.data_raw;
+    __sync_synchronize();
+    e->data_type = r->data_type;
+    if (idx >= g_shm->num_entries)
+      g_shm->num_entries = idx + 1;
+    return false;
+  }
+
+  e->seq = e->seq + 1;
+  __sync_synchronize();
+  e->data = r->data;
+  e->data_raw = r->stat_meta.data_raw;
+  __sync_synchronize();
+  e->seq = e->seq + 1;
+
+  return true;
+}
+
+//-------------------------------------------------------------------------
+// RecShmRead
+//-------------------------------------------------------------------------
+static bool
+shm_map()
+{
+  char *path = Layout::relative_to(Layout::get()->runtimedir, REC_SHM_FILE);
+  struct stat st;
+  int fd;
+
+  if (stat(path, &st) < 0) {
+    ats_free(path);
+    return g_shm != NULL;
+  }
+  if (g_shm && st.st_dev == g_shm_dev && st.st_ino == g_shm_ino) {
+    ats_free(path);
+    return true;
+  }
+
+  // traffic_server restarted (or started), so the records behind the old
+  // entries are stale.
+  if (g_shm) {
+    munmap(g_shm, g_shm_size);
+    g_shm = NULL;
+    g_shm_entries = NULL;
+  }
+  if (g_shm_records == NULL)
+    g_shm_records = (RecRecord **) ats_calloc(REC_MAX_RECORDS, sizeof(RecRecord *));
+  memset(g_shm_records, 0, REC_MAX_RECORDS * sizeof(RecRecord *));
+
+  fd = open(path, O_RDONLY);
+  ats_free(path);
+  if (fd < 0)
+    return false;
+  if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(RecShmHeader)) {
+    close(fd);
+    return false;
+  }
+
+  void *p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+    return false;
+
+  RecShmHeader *h = (RecShmHeader *) p;
+  if (h->magic != REC_SHM_MAGIC || h->entry_size != sizeof(RecShmEntry) || h->max_entries > REC_MAX_RECORDS ||
+      (size_t) st.st_size < sizeof(RecShmHeader) + h->max_entries * sizeof(RecShmEntry)) {
+    munmap(p, st.st_size);
+    return false;
+  }
+
+  g_shm = h;
+  g_shm_entries = (RecShmEntry *) (h + 1);
+  g_shm_size = st.st_size;
+  g_shm_dev = st.st_dev;
+  g_shm_ino = st.st_ino;
+  return true;
+}
+
+void
+RecShmRead()
+{
+  if (!shm_map())
+    return;
+
+  int num_entries = g_shm->num_entries;
+
+  for (int i = 0; i < num_entries && i < g_shm->max_entries; i++) {
+    RecShmEntry *e = &(g_shm_entries[i]);
+    RecDataT data_type = e->data_type;
+    RecData data;
+    RecRawStat data_raw;
+    uint32_t seq;
+
+    if (data_type == RECD_NULL)
+      continue;
+    __sync_synchronize();
+
+    RecRecord *r = g_shm_records[i];
+    if (r == NULL) {
+      char name[REC_SHM_NAME_LEN];
+
+      ink_strlcpy(name, e->name, sizeof(name));
+      if ((r = RecGetRecordHandle(name)) == NULL)
+        continue;               // the RECG_PUSH announcing it has not arrived yet
+      g_shm_records[i] = r;
+    }
+
+    do {
+      seq = e->seq;
+      __sync_synchronize();
+      data = e->data;
+      data_raw = e->data_raw;
+      __sync_synchronize();
+    } while ((seq & 1) || seq != e->seq);
+
+    rec_mutex_acquire(&(r->lock));
+    if (r->data_type == data_type) {
+      r->data = data;
+      r->stat_meta.data_raw = data_raw;
+    }
+    rec_mutex_release(&(r->lock));
+  }
+}
@@ -0,0 +1,384 @@
+/** @file
+
+  Versioned stat snapshots and their export formats
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#include "libts.h"
+
+#include "P_EventSystem.h"
+#include "P_RecCore.h"
+#include "P_RecProcess.h"
+#include "P_RecUtils.h"
+#include "TextBuffer.h"
+
+// The binary export, all fields in network byte order:
+//
+//   header:  "TSS1", uint32 entry count, uint64 version, uint64 since
+//   entry:   uint32 id, uint8 type, [uint16 name length, name], 8 byte value
+//
+// 'since' is 0 when the export holds every stat. The low bits of 'type'
+// are REC_STAT_BINARY_INT, _FLOAT or _COUNTER, and REC_STAT_BINARY_NAMED
+// is set when the name follows, which is only when the stat is new to
+// the reader. Float values are sent as the bits of an IEEE double.
+#define REC_STAT_BINARY_MAGIC     "TSS1"
+#define REC_STAT_BINARY_INT       1
+#define REC_STAT_BINARY_FLOAT     2
+#define REC_STAT_BINARY_COUNTER   3
+#define REC_STAT_BINARY_NAMED     0x80
+
+static bool g_snapshot_enabled = false;
+static ink_mutex g_snapshot_lock;
+static Ptr<RecStatSnapshot> g_snapshot;
+
+// Only the raw stat sync thread builds snapshots, so these need no lock.
+static int64_t g_snapshot_version = 0;
+static RecData *g_snapshot_last = NULL;
+static int64_t *g_snapshot_changed = NULL;
+static int64_t *g_snapshot_added = NULL;
+
+RecStatSnapshot::RecStatSnapshot()
+  : version(0), num_entries(0), entries(NULL)
+{
+  ink_mutex_init(&lock, "RecStatSnapshot");
+  for (int i = 0; i < REC_STAT_EXPORT_FORMATS; i++) {
+    full[i] = NULL;
+    full_length[i] = 0;
+  }
+}
+
+RecStatSnapshot::~RecStatSnapshot()
+{
+  for (int i = 0; i < REC_STAT_EXPORT_FORMATS; i++)
+    ats_free(full[i]);
+  ats_free(entries);
+  ink_mutex_destroy(&lock);
+}
+
+void
+RecStatSnapshotEnable()
+{
+  if (!g_snapshot_enabled) {
+    ink_mutex_init(&g_snapshot_lock, "RecStatSnapshot global");
+    g_snapshot_enabled = true;
+  }
+}
+
+Ptr<RecStatSnapshot>
+RecStatSnapshotGet()
+{
+  Ptr<RecStatSnapshot> snap;
+
+  if (g_snapshot_enabled) {
+    ink_mutex_acquire(&g_snapshot_lock);
+    snap = g_snapshot;
+    ink_mutex_release(&g_snapshot_lock);
+  }
+  return snap;
+}
+
+//-------------------------------------------------------------------------
+// RecStatSnapshotBuild
+//-------------------------------------------------------------------------
+void
+RecStatSnapshotBuild()
+{
+  if (!g_snapshot_enabled)
+    return;
+
+  if (g_snapshot_last == NULL) {
+    g_snapshot_last = (RecData *) ats_calloc(REC_MAX_RECORDS, sizeof(RecData));
+    g_snapshot_changed = (int64_t *) ats_calloc(REC_MAX_RECORDS, sizeof(int64_t));
+    g_snapshot_added = (int64_t *) ats_calloc(REC_MAX_RECORDS, sizeof(int64_t));
+  }
+
+  if (g_snapshot_version)
+    ++g_snapshot_version;
+  else
+    g_snapshot_version = ink_hrtime_to_msec(ink_get_hrtime_internal());
+
+  int num_records = g_num_records;
+  RecStatSnapshot *snap = NEW(new RecStatSnapshot);
+
+  snap->version = g_snapshot_version;
+  snap->entries = (RecStatSnapshotEntry *) ats_malloc(num_records * sizeof(RecStatSnapshotEntry));
+
+  for (int i = 0; i < num_records; i++) {
+    RecRecord *r = &(g_records[i]);
+
+    if (!REC_TYPE_IS_STAT(r->rec_type) || !r->registered)
+      continue;
+    if (r->data_type != RECD_INT && r->data_type != RECD_FLOAT && r->data_type != RECD_COUNTER)
+      continue;
+
+    RecStatSnapshotEntry *e = &(snap->entries[snap->num_entries++]);
+
+    rec_mutex_acquire(&(r->lock));
+    e->data = r->data;
+    rec_mutex_release(&(r->lock));
+
+    if (g_snapshot_added[i] == 0) {
+      g_snapshot_added[i] = g_snapshot_changed[i] = snap->version;
+    } else if (RecDataCmp(r->data_type, e->data, g_snapshot_last[i]) != 0) {
+      g_snapshot_changed[i] = snap->version;
+    }
+    g_snapshot_last[i] = e->data;
+
+    e->name = r->name;
+    e->name_len = strlen(r->name);
+    e->id = i;
+    e->data_type = r->data_type;
+    e->changed = g_snapshot_changed[i];
+    e->added = g_snapshot_added[i];
+  }
+
+  ink_mutex_acquire(&g_snapshot_lock);
+  g_snapshot = snap;
+  ink_mutex_release(&g_snapshot_lock);
+}
+
+//-------------------------------------------------------------------------
+// Formatting
+//-------------------------------------------------------------------------
+static void
+export_put_be(textBuffer & buf, uint64_t v, int nbytes)
+{
+  unsigned char b[8];
+
+  for (int i = nbytes - 1; i >= 0; i--) {
+    b[i] = (unsigned char) (v & 0xff);
+    v >>= 8;
+  }
+  buf.copyFrom(b, nbytes);
+}
+
+static void
+export_binary(textBuffer & buf, RecStatSnapshot * snap, int64_t since)
+{
+  int count = 0;
+
+  for (int i = 0; i < snap->num_entries; i++) {
+    if (snap->entries[i].changed > since)
+      ++count;
+  }
+
+  buf.copyFrom(REC_STAT_BINARY_MAGIC, 4);
+  export_put_be(buf, count, 4);
+  export_put_be(buf, snap->version, 8);
+  export_put_be(buf, since, 8);
+
+  for (int i = 0; i < snap->num_entries; i++) {
+    RecStatSnapshotEntry *e = &(snap->entries[i]);
+    uint64_t value;
+    int type;
+
+    if (e->changed <= since)
+      continue;
+
+    switch (e->data_type) {
+    case RECD_FLOAT:
+      {
+        double d = e->data.rec_float;
+        memcpy(&value, &d, sizeof(value));
+        type = REC_STAT_BINARY_FLOAT;
+      }
+      break;
+    case RECD_COUNTER:
+      value = (uint64_t) e->data.rec_counter;
+      type = REC_STAT_BINARY_COUNTER;
+      break;
+    default:
+      value = (uint64_t) e->data.rec_int;
+      type = REC_STAT_BINARY_INT;
+      break;
+    }
+
+    bool named = e->added > since && e->name_len <= 0xffff;
+
+    export_put_be(buf, e->id, 4);
+    export_put_be(buf, type | (named ? REC_STAT_BINARY_NAMED : 0), 1);
+    if (named) {
+      export_put_be(buf, e->name_len, 2);
+      buf.copyFrom(e->name, e->name_len);
+    }
+    export_put_be(buf, value, 8);
+  }
+}
+
+static void
+export_prometheus(textBuffer & buf, RecStatSnapshot * snap, int64_t since)
+{
+  char line[512];
+  char name[256];
+  int len;
+
+  len = snprintf(line, sizeof(line), "# version %" PRId64 "\n", snap->version);
+  buf.copyFrom(line, len);
+
+  for (int i = 0; i < snap->num_entries; i++) {
+    RecStatSnapshotEntry *e = &(snap->entries[i]);
+
+    if (e->changed <= since)
+      continue;
+
+    // Metric names are limited to [a-zA-Z0-9_:].
+    int n = e->name_len < (int) sizeof(name) - 1 ? e->name_len : (int) sizeof(name) - 1;
+    for (int j = 0; j < n; j++)
+      name[j] = (ParseRules::is_alnum(e->name[j]) || e->name[j] == ':') ? e->name[j] : '_';
+    name[n] = '\0';
+
+    switch (e->data_type) {
+    case RECD_FLOAT:
+      len = snprintf(line, sizeof(line), "# TYPE %s gauge\n%s %g\n", name, name, (double) e->data.rec_float);
+      break;
+    case RECD_COUNTER:
+      len = snprintf(line, sizeof(line), "# TYPE %s counter\n%s %" PRId64 "\n", name, name, e->data.rec_counter);
+      break;
+    default:
+      len = snprintf(line, sizeof(line), "# TYPE %s gauge\n%s %" PRId64 "\n", name, name, e->data.rec_int);
+      break;
+    }
+    buf.copyFrom(line, len);
+  }
+}
+
+static char *
+export_format(RecStatSnapshot * snap, RecStatExportFormat format, int64_t since, int *length)
+{
+  textBuffer buf(snap->num_entries * 64 + 64);
+
+  if (format == REC_STAT_EXPORT_PROMETHEUS)
+    export_prometheus(buf, snap, since);
+  else
+    export_binary(buf, snap, since);
+
+  *length = buf.spaceUsed();
+  char *result = (char *) ats_malloc(*length + 1);
+  memcpy(result, buf.bufPtr(), *length);
+  result[*length] = '\0';
+  return result;
+}
+
+//-------------------------------------------------------------------------
+// RecStatSnapshotExport
+//-------------------------------------------------------------------------
+char *
+RecStatSnapshotExport(RecStatSnapshot * snap, RecStatExportFormat format, int64_t since, int *length)
+{
+  ink_assert(format >= 0 && format < REC_STAT_EXPORT_FORMATS);
+
+  if (since > 0 && since <= snap->version)
+    return export_format(snap, format, since, length);
+
+  ink_mutex_acquire(&snap->lock);
+  if (snap->full[format] == NULL)
+    snap->full[format] = export_format(snap, format, 0, &snap->full_length[format]);
+  ink_mutex_release(&snap->lock);
+
+  *length = snap->full_length[format];
+  char *result = (char *) ats_malloc(*length + 1);
+  memcpy(result, snap->full[format], *length + 1);
+  return result;
+}
+
+
+#if TS_HAS_TESTS
+#include "ts/TestBox.h"
+
+static uint64_t
+export_get_be(const unsigned char *p, int nbytes)
+{
+  uint64_t v = 0;
+
+  for (int i = 0; i < nbytes; i++)
+    v = (v << 8) | p[i];
+  return v;
+}
+
+REGRESSION_TEST(RecStatSnapshot)(RegressionTest * t, int /* atype ATS_UNUSED */, int * pstatus)
+{
+  TestBox box(t, pstatus);
+  Ptr<RecStatSnapshot> snap = make_ptr(NEW(new RecStatSnapshot));
+  RecStatSnapshotEntry entries[2];
+  char *out;
+  int len;
+
+  box = REGRESSION_TEST_PASSED;
+
+  entries[0].name = "proxy.process.test.a";
+  entries[0].name_len = strlen(entries[0].name);
+  entries[0].id = 7;
+  entries[0].data_type = RECD_INT;
+  entries[0].data.rec_int = 42;
+  entries[0].added = 100;
+  entries[0].changed = 100;
+
+  entries[1].name = "proxy.process.test.b";
+  entries[1].name_len = strlen(entries[1].name);
+  entries[1].id = 9;
+  entries[1].data_type = RECD_COUNTER;
+  entries[1].data.rec_counter = 5;
+  entries[1].added = 100;
+  entries[1].changed = 102;
+
+  snap->version = 103;
+  snap->num_entries = 2;
+  snap->entries = (RecStatSnapshotEntry *) ats_malloc(sizeof(entries));
+  memcpy(snap->entries, entries, sizeof(entries));
+
+  // a full binary export names every stat
+  out = RecStatSnapshotExport(snap, REC_STAT_EXPORT_BINARY, 0, &len);
+  const unsigned char *p = (const unsigned char *) out;
+  box.check(len == 24 + 2 * (4 + 1 + 2 + 20 + 8), "full binary export is %d bytes", len);
+  box.check(memcmp(p, REC_STAT_BINARY_MAGIC, 4) == 0, "bad magic");
+  box.check(export_get_be(p + 4, 4) == 2, "full export has %d entries", (int) export_get_be(p + 4, 4));
+  box.check(export_get_be(p + 8, 8) == 103, "wrong version");
+  box.check(export_get_be(p + 16, 8) == 0, "full export has a since");
+  box.check(export_get_be(p + 24, 4) == 7 && p[28] == (REC_STAT_BINARY_INT | REC_STAT_BINARY_NAMED), "bad first entry");
+  box.check(export_get_be(p + 24 + 35 - 8, 8) == 42, "bad first value");
+  ats_free(out);
+
+  // a delta only has what changed, without the names the reader already has
+  out = RecStatSnapshotExport(snap, REC_STAT_EXPORT_BINARY, 101, &len);
+  p = (const unsigned char *) out;
+  box.check(len == 24 + 4 + 1 + 8, "delta binary export is %d bytes", len);
+  box.check(export_get_be(p + 4, 4) == 1 && export_get_be(p + 16, 8) == 101, "bad delta header");
+  box.check(export_get_be(p + 24, 4) == 9 && p[28] == REC_STAT_BINARY_COUNTER, "bad delta entry");
+  box.check(export_get_be(p + 29, 8) == 5, "bad delta value");
+  ats_free(out);
+
+  // nothing changed since the current version
+  out = RecStatSnapshotExport(snap, REC_STAT_EXPORT_BINARY, 103, &len);
+  box.check(len == 24, "empty delta is %d bytes", len);
+  ats_free(out);
+
+  out = RecStatSnapshotExport(snap, REC_STAT_EXPORT_PROMETHEUS, 0, &len);
+  box.check(strstr(out, "# TYPE proxy_process_test_a gauge\nproxy_process_test_a 42\n") != NULL, "bad gauge: %s", out);
+  box.check(strstr(out, "# TYPE proxy_process_test_b counter\nproxy_process_test_b 5\n") != NULL, "bad counter: %s", out);
+  box.check((int) strlen(out) == len, "prometheus length is wrong");
+  ats_free(out);
+
+  out = RecStatSnapshotExport(snap, REC_STAT_EXPORT_PROMETHEUS, 101, &len);
+  box.check(strstr(out, "proxy_process_test_a") == NULL, "delta has an unchanged stat: %s", out);
+  box.check(strstr(out, "proxy_process_test_b 5") != NULL, "delta is missing a changed stat: %s", out);
+  ats_free(out);
+}
+
+#endif
@@ -84,15 +84,15 @@ public:
   Allocator(const char *name, unsigned int element_size,
             unsigned int chunk_size = 128, unsigned int alignment = 8)
   {
-    ink_freelist_init(&fl, name, element_size, chunk_size, alignment);
+    ink_freelist_init(&fl, name, element_size, chunk_size, alignment, 0);
   }
 
   /** Re-initialize the parameters of the allocator. */
   void
   re_init(const char *name, unsigned int element_size,
-          unsigned int chunk_size, unsigned int alignment)
+          unsigned int chunk_size, unsigned int alignment, bool use_hugepages = false)
   {
-    ink_freelist_init(&this->fl, name, element_size, chunk_size, alignment);
+    ink_freelist_init(&this->fl, name, element_size, chunk_size, alignment, use_hugepages);
   }
 
 protected:
@@ -163,7 +163,7 @@ public:
   ClassAllocator(const char *name, unsigned int chunk_size = 128,
                  unsigned int alignment = 16)
   {
-    ink_freelist_init(&this->fl, name, RND16(sizeof(C)), chunk_size, RND16(alignment));
+    ink_freelist_init(&this->fl, name, RND16(sizeof(C)), chunk_size, RND16(alignment), 0);
   }
 
   struct
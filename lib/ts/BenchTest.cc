@@ -0,0 +1,139 @@
+/** @file
+
+    Benchmarks of the core data structures in libts
+
+    @section license License
+
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "libts.h"
+#include <ts/IpMap.h>
+
+#define BENCH_FREELIST_OPS    (1 << 22)
+#define BENCH_FREELIST_BATCH  64
+#define BENCH_LOOKUP_OPS      (1 << 22)
+
+struct BenchFreelist
+{
+  InkFreeList *fl;
+  int64_t ops;
+};
+
+static void *
+bench_freelist_thread(void *data)
+{
+  BenchFreelist *b = (BenchFreelist *) data;
+  void *items[BENCH_FREELIST_BATCH];
+
+  // batches, so that the list is not just handing one item back and forth
+  for (int64_t i = 0; i < b->ops; i += BENCH_FREELIST_BATCH) {
+    for (int j = 0; j < BENCH_FREELIST_BATCH; j++)
+      items[j] = ink_freelist_new(b->fl);
+    for (int j = 0; j < BENCH_FREELIST_BATCH; j++)
+      ink_freelist_free(b->fl, items[j]);
+  }
+  return NULL;
+}
+
+REGRESSION_TEST(Bench_freelist) (RegressionTest * t, int atype, int *pstatus) {
+  if (atype < REGRESSION_TEST_EXTENDED) {
+    *pstatus = REGRESSION_TEST_NOT_RUN;
+    return;
+  }
+
+  ink_thread threads[8];
+
+  for (int n = 1; n <= 8; n *= 2) {
+    char tag[32];
+    // a new list for each round, the reclaimable freelist keeps the
+    // caches of threads which have exited
+    BenchFreelist b = { ink_freelist_create("bench", 128, 256, 8), BENCH_FREELIST_OPS };
+    ink_hrtime start = ink_get_hrtime_internal();
+
+    for (int i = 0; i < n; i++)
+      threads[i] = ink_thread_create(bench_freelist_thread, &b);
+    for (int i = 0; i < n; i++)
+      ink_thread_join(threads[i]);
+    snprintf(tag, sizeof(tag), "alloc_free_x%d", n);
+    // each op is one alloc and one free
+    rbench(t, tag, n, b.ops * n, ink_get_hrtime_internal() - start);
+  }
+  *pstatus = REGRESSION_TEST_PASSED;
+}
+
+REGRESSION_TEST(Bench_IpMap) (RegressionTest * t, int atype, int *pstatus) {
+  if (atype < REGRESSION_TEST_EXTENDED) {
+    *pstatus = REGRESSION_TEST_NOT_RUN;
+    return;
+  }
+
+  IpMap map;
+  void *const mark = reinterpret_cast<void *>(1);
+  int64_t found = 0;
+
+  // 4096 disjoint /24s spread over the address space
+  for (uint32_t i = 0; i < 4096; i++) {
+    in_addr_t lo = htonl((i << 20) | (1 << 8)), hi = htonl((i << 20) | (1 << 8) | 0xFF);
+    map.mark(lo, hi, mark);
+  }
+
+  for (int frozen = 0; frozen <= 1; frozen++) {
+    uint32_t x = 1;
+    ink_hrtime start = ink_get_hrtime_internal();
+
+    if (frozen)
+      map.freeze();
+    for (int i = 0; i < BENCH_LOOKUP_OPS; i++) {
+      x = x * 1103515245 + 12345;
+      found += map.contains(htonl(x));
+    }
+    rbench(t, frozen ? "contains_frozen" : "contains", 1, BENCH_LOOKUP_OPS, ink_get_hrtime_internal() - start);
+  }
+  rprintf(t, "%d hits\n", (int) found);
+  *pstatus = REGRESSION_TEST_PASSED;
+}
+
+REGRESSION_TEST(Bench_HostLookup) (RegressionTest * t, int atype, int *pstatus) {
+  if (atype < REGRESSION_TEST_EXTENDED) {
+    *pstatus = REGRESSION_TEST_NOT_RUN;
+    return;
+  }
+
+  HostLookup lookup("bench");
+  HostLookupState s;
+  char host[64];
+  void *opaque;
+  int64_t found = 0;
+  int n = 1024;
+
+  lookup.AllocateSpace(n);
+  for (int i = 0; i < n; i++) {
+    snprintf(host, sizeof(host), "d%d.example.com", i);
+    lookup.NewEntry(host, true, (void *) (intptr_t) (i + 1));
+  }
+
+  ink_hrtime start = ink_get_hrtime_internal();
+  for (int i = 0; i < BENCH_LOOKUP_OPS / 16; i++) {
+    // half of the names are under a domain in the table
+    snprintf(host, sizeof(host), "www.d%d.example.com", i % (2 * n));
+    found += lookup.MatchFirst(host, &s, &opaque);
+  }
+  rbench(t, "match", 1, BENCH_LOOKUP_OPS / 16, ink_get_hrtime_internal() - start);
+  rprintf(t, "%d hits\n", (int) found);
+  *pstatus = REGRESSION_TEST_PASSED;
+}
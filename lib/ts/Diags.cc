@@ -141,6 +141,7 @@ Diags::Diags(const char *bdt, const char *bat, FILE * _diags_log_fp)
 
   activated_tags[DiagsTagType_Debug] = NULL;
   activated_tags[DiagsTagType_Action] = NULL;
+  tag_generation = 1;
   prefix_str = "";
 
 }
@@ -418,6 +419,7 @@ Diags::activate_taglist(const char *taglist, DiagsTagType mode)
     }
     activated_tags[mode] = NEW(new DFA);
     activated_tags[mode]->compile(taglist);
+    tag_generation_bump();
     unlock();
   }
 }
@@ -441,6 +443,7 @@ Diags::deactivate_all(DiagsTagType mode)
     delete activated_tags[mode];
     activated_tags[mode] = NULL;
   }
+  tag_generation_bump();
   unlock();
 }
 
@@ -36,6 +36,7 @@
 #define __DIAGS_H___
 
 #include <stdarg.h>
+#include <limits.h>
 #include "ink_error.h"
 #include "ink_mutex.h"
 #include "Regex.h"
@@ -161,6 +162,23 @@ public:
     return (config.enabled[mode] && tag_activated(tag, mode));
   }
 
+  // As above, keeping the answer in *site, the state of one call site,
+  // until the activated tags change. Saves the tag table lookup on
+  // every call once any debug tags are set.
+  bool on(const char *tag, DiagsTagType mode, volatile int *site) const {
+    if (!config.enabled[mode])
+      return false;
+
+    int generation = tag_generation;
+    int state = *site;
+    if (likely((state >> 1) == generation))
+      return (state & 1);
+
+    bool activated = tag_activated(tag, mode);
+    *site = (generation << 1) | activated;
+    return activated;
+  }
+
   /////////////////////////////////////
   // low-level tag inquiry functions //
   /////////////////////////////////////
@@ -238,6 +256,7 @@ public:
 private:
   mutable ink_mutex tag_table_lock;   // prevents reconfig/read races
   DFA *activated_tags[2];             // 1 table for debug, 1 for action
+  volatile int tag_generation;        // changes with the tag tables, never 0
 
   void lock() const
   {
@@ -247,6 +266,11 @@ private:
   {
     ink_mutex_release(&tag_table_lock);
   }
+  void tag_generation_bump()
+  {
+    // call sites keep it shifted up a bit, 0 is for those not yet checked
+    tag_generation = tag_generation % (INT_MAX >> 1) + 1;
+  }
 };
 
 //////////////////////////////////////////////////////////////////////////
@@ -296,15 +320,23 @@ dummy_debug(const char *tag, const char *fmt, ...)
 #define EmergencyV(fmt, ap) diags->error_va(DTA(DL_Emergency), fmt, ap)
 
 #ifdef TS_USE_DIAGS
-#define Diag(tag, ...)      if (unlikely(diags->on())) diags->log(tag, DTA(DL_Diag), __VA_ARGS__)
-#define Debug(tag, ...)     if (unlikely(diags->on())) diags->log(tag, DTA(DL_Debug), __VA_ARGS__)
-#define DiagSpecific(flag, tag, ...)  if (unlikely(diags->on())) flag ? diags->print(tag, DTA(DL_Diag), __VA_ARGS__) : \
-                                                                   diags->log(tag, DTA(DL_Diag), __VA_ARGS__)
-#define DebugSpecific(flag, tag, ...)  if (unlikely(diags->on())) flag ? diags->print(tag, DTA(DL_Debug), __VA_ARGS__) : \
-                                                                    diags->log(tag, DTA(DL_Debug), __VA_ARGS__)
-
-#define is_debug_tag_set(_t)     unlikely(diags->on(_t,DiagsTagType_Debug))
-#define is_action_tag_set(_t)    unlikely(diags->on(_t,DiagsTagType_Action))
+// Call sites with a literal tag cache whether it is set, see Diags::on()
+#if defined(__GNUC__)
+#define diags_tag_on(_t, _m)     __extension__ ({ static volatile int _diags_site = 0; \
+                                   __builtin_constant_p(_t) ? diags->on(_t, _m, &_diags_site) : diags->on(_t, _m); })
+#else
+#define diags_tag_on(_t, _m)     diags->on(_t, _m)
+#endif
+
+#define Diag(tag, ...)      if (unlikely(diags_tag_on(tag, DiagsTagType_Debug))) diags->print(tag, DTA(DL_Diag), __VA_ARGS__)
+#define Debug(tag, ...)     if (unlikely(diags_tag_on(tag, DiagsTagType_Debug))) diags->print(tag, DTA(DL_Debug), __VA_ARGS__)
+#define DiagSpecific(flag, tag, ...)  if (unlikely(diags->on()) && ((flag) || diags_tag_on(tag, DiagsTagType_Debug))) \
+                                        diags->print(tag, DTA(DL_Diag), __VA_ARGS__)
+#define DebugSpecific(flag, tag, ...)  if (unlikely(diags->on()) && ((flag) || diags_tag_on(tag, DiagsTagType_Debug))) \
+                                         diags->print(tag, DTA(DL_Debug), __VA_ARGS__)
+
+#define is_debug_tag_set(_t)     unlikely(diags_tag_on(_t,DiagsTagType_Debug))
+#define is_action_tag_set(_t)    unlikely(diags_tag_on(_t,DiagsTagType_Action))
 #define debug_tag_assert(_t,_a)  (is_debug_tag_set(_t) ? (ink_release_assert(_a), 0) : 0)
 #define action_tag_assert(_t,_a) (is_action_tag_set(_t) ? (ink_release_assert(_a), 0) : 0)
 #define is_diags_on(_t)          unlikely(diags->on(_t))
@@ -0,0 +1,131 @@
+/** @file
+
+  A count-min sketch of access frequency, as used by TinyLFU admission.
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+/****************************************************************************
+
+  FrequencySketch.h
+
+  Counters are 4 bits, 16 to a word.  A key is counted in
+  FREQUENCY_SKETCH_DEPTH words and its estimate is the smallest of those
+  counters, so collisions can only overstate it.  After 10 additions per
+  entry the sketch is aged: every counter is halved, so the estimate
+  follows recent popularity rather than all time.
+
+  The sketch costs a word per entry and is not thread safe.
+
+ ****************************************************************************/
+
+#ifndef _FrequencySketch_h_
+#define _FrequencySketch_h_
+
+#include "ink_platform.h"
+#include "ink_defs.h"
+#include "ink_memory.h"
+
+#define FREQUENCY_SKETCH_DEPTH  4
+#define FREQUENCY_SKETCH_MAX    15
+
+struct FrequencySketch
+{
+  uint64_t *table;
+  uint64_t mask;                // words - 1
+  int64_t additions;
+  int64_t sample_size;          // additions before the counters are halved
+
+  // size for about 'entries' distinct keys
+  void init(int64_t entries);
+  void increment(uint64_t key);
+  int estimate(uint64_t key) const;
+  void reset();
+
+  FrequencySketch():table(NULL), mask(0), additions(0), sample_size(0) {}
+  ~FrequencySketch() { ats_free(table); }
+
+private:
+  static uint64_t index(uint64_t key, int i) {
+    static const uint64_t seed[FREQUENCY_SKETCH_DEPTH] = {
+      0xc3a5c85c97cb3127ULL, 0xb492b66fbe98f273ULL, 0x9ae16a3b2f90404fULL, 0xcbf29ce484222325ULL
+    };
+    uint64_t h = (key + seed[i]) * seed[i];
+    return h ^ (h >> 32);
+  }
+};
+
+inline void
+FrequencySketch::init(int64_t entries)
+{
+  int64_t words = 16;
+  while (words < entries)
+    words <<= 1;
+  ats_free(table);
+  table = (uint64_t *)ats_malloc(words * sizeof(uint64_t));
+  memset(table, 0, words * sizeof(uint64_t));
+  mask = words - 1;
+  additions = 0;
+  sample_size = entries < 1 ? 10 : entries * 10;
+}
+
+inline void
+FrequencySketch::increment(uint64_t key)
+{
+  if (!table)
+    return;
+  // the DEPTH counters of a key are in different quarters of their words
+  int start = (int)(key & 3) << 2;
+  bool added = false;
+  for (int i = 0; i < FREQUENCY_SKETCH_DEPTH; i++) {
+    uint64_t &w = table[index(key, i) & mask];
+    int shift = (start + i) << 2;
+    if (((w >> shift) & 0xF) < FREQUENCY_SKETCH_MAX) {
+      w += (uint64_t)1 << shift;
+      added = true;
+    }
+  }
+  if (added && ++additions >= sample_size)
+    reset();
+}
+
+inline int
+FrequencySketch::estimate(uint64_t key) const
+{
+  if (!table)
+    return 0;
+  int start = (int)(key & 3) << 2;
+  int f = FREQUENCY_SKETCH_MAX;
+  for (int i = 0; i < FREQUENCY_SKETCH_DEPTH; i++) {
+    int c = (int)((table[index(key, i) & mask] >> ((start + i) << 2)) & 0xF);
+    if (c < f)
+      f = c;
+  }
+  return f;
+}
+
+inline void
+FrequencySketch::reset()
+{
+  for (uint64_t i = 0; i <= mask; i++)
+    table[i] = (table[i] >> 1) & 0x7777777777777777ULL;
+  additions /= 2;
+}
+
+#endif /* _FrequencySketch_h_ */
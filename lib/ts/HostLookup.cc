@@ -207,176 +207,210 @@ static const unsigned char asciiToTable[256] = {
 // Number of legal characters in the acssiToTable array
 static const int numLegalChars = 38;
 
-// struct charIndex_el
+// Number of children a hostTrie node keeps in a sorted list
+//   before it gets an index of them
+static const int hostTrieListMax = 4;
+
+// struct hostTrieNode
 //
-//   Used by class charIndex.  Forms a single level
-//    in charIndex tree
+//   Used by class hostTrie.  One character of a key.  The
+//    children of a node are a list of siblings sorted by
+//    character or, for nodes with many of them, a table
+//    indexed like charIndex by asciiToTable[]
 //
-struct charIndex_el
+struct hostTrieNode
 {
-  charIndex_el();
-  ~charIndex_el();
-  HostBranch *branch_array[numLegalChars];
-  charIndex_el *next_level[numLegalChars];
+  int branch;                   // binding for the key ending here, 0 for none
+  int child;                    // first child or index table, 0 for none
+  int sibling;                  // next sibling, 0 for none
+  unsigned char c;
+  unsigned char num_children;
+  bool indexed;                 // child is an offset into the tables
 };
 
-charIndex_el::charIndex_el()
+// Since the only iter state is an index into the
+//   bindings typedef it
+typedef int hostTrieIterState;
+
+// class hostTrie - A compact string matcher for the
+//    partitions of a DNS level
+//
+//    Keys are stored one node per character, sharing common
+//      prefixes.  The nodes of a trie are kept in one array and
+//      linked by index, so a trie costs 16 bytes per character
+//      of the keys not shared with another key and a lookup walks
+//      one small block of memory
+//
+//    Most nodes have a few children, kept in a sorted list.  The
+//      root and any node with more than hostTrieListMax children
+//      instead map the next character through asciiToTable[] to a
+//      slot in a table of numLegalChars + 1 lists, so wide fan outs
+//      are looked up in constant time.  Characters which are not
+//      legal in hostnames share the last slot
+//
+//    Example: com, co and net
+//
+//      root table
+//      --------
+//       .   |
+//      13 c |-->  c  -->  o [co]  -->  m [com]
+//       .   |
+//      24 n |-->  n  -->  e  -->  t [net]
+//       .   |
+//      --------
+//
+class hostTrie
 {
-  memset(branch_array, 0, sizeof(branch_array));
-  memset(next_level, 0, sizeof(next_level));
-}
+public:
+  hostTrie();
+  ~hostTrie();
+  void Insert(const char *match_data, HostBranch * toInsert);
+  HostBranch *Lookup(const char *match_data);
+  HostBranch *iter_first(hostTrieIterState * s);
+  HostBranch *iter_next(hostTrieIterState * s);
+private:
+  static int Slot(unsigned char c)
+  {
+    return asciiToTable[c] == 255 ? numLegalChars : asciiToTable[c];
+  }
+  int FirstChild(int node, unsigned char c) const
+  {
+    return nodes[node].indexed ? tables[nodes[node].child + Slot(c)] : nodes[node].child;
+  }
+  void SetFirstChild(int node, unsigned char c, int child);
+  void AddChild(int node, int child);
+  int NewNode(unsigned char c);
+  int NewTable();
+  void IndexChildren(int node);
+
+  hostTrieNode *nodes;          // node 0 is the root
+  int num_nodes;
+  int max_nodes;
+  int *tables;                  // index tables of numLegalChars + 1 slots
+  int num_tables;
+  int max_tables;
+  HostBranch **branches;        // bindings, in insertion order
+  int num_branches;
+  int max_branches;
+};
 
-charIndex_el::~charIndex_el()
+hostTrie::hostTrie()
+  : nodes(NULL), num_nodes(0), max_nodes(0), tables(NULL), num_tables(0), max_tables(0),
+    branches(NULL), num_branches(0), max_branches(0)
 {
-  int i;
+  NewNode(0);
+  nodes[0].child = NewTable();
+  nodes[0].indexed = true;
+}
 
-  // Recursively delete all the lower levels of the
-  //   data structure
-  for (i = 0; i < numLegalChars; i++) {
-    if (next_level[i] != NULL) {
-      delete next_level[i];
-    }
-  }
+hostTrie::~hostTrie()
+{
+  ats_free(nodes);
+  ats_free(tables);
+  ats_free(branches);
 }
 
-// struct charIndexIterInternal
+// int hostTrie::NewNode(unsigned char c)
 //
-//  An internal struct to charIndexIterState
-//    Stores the location of an element in
-//    class charIndex
+//   Adds a node for c and returns its index.  Indexes
+//     stay valid as the pool grows, pointers do not
 //
-struct charIndexIterInternal
+int
+hostTrie::NewNode(unsigned char c)
 {
-  charIndex_el *ptr;
-  int index;
-};
+  if (num_nodes >= max_nodes) {
+    max_nodes = max_nodes ? max_nodes * 2 : 16;
+    nodes = (hostTrieNode *) ats_realloc(nodes, max_nodes * sizeof(hostTrieNode));
+  }
 
-// Used as a default return element for DynArray in
-//   struct charIndexIterState
-static charIndexIterInternal default_iter = { NULL, -1 };
+  hostTrieNode *n = &nodes[num_nodes];
+  n->branch = 0;
+  n->child = 0;
+  n->sibling = 0;
+  n->c = c;
+  n->num_children = 0;
+  n->indexed = false;
+  return num_nodes++;
+}
 
-// struct charIndexIterState
+// int hostTrie::NewTable()
 //
-//    struct for the callee to keep interation state
-//      for class charIndex
+//   Adds an empty index table and returns its offset
 //
-struct charIndexIterState
+int
+hostTrie::NewTable()
 {
-  charIndexIterState();
-
-  // Where that level we are in interation
-  int cur_level;
-
-  // Where we got the last element from
-  int cur_index;
-  charIndex_el *cur_el;
+  const int slots = numLegalChars + 1;
 
-  //  Queue of the above levels
-    DynArray<charIndexIterInternal> q;
-};
+  if (num_tables >= max_tables) {
+    max_tables = max_tables ? max_tables * 2 : 1;
+    tables = (int *) ats_realloc(tables, max_tables * slots * sizeof(int));
+  }
+  memset(&tables[num_tables * slots], 0, slots * sizeof(int));
+  return (num_tables++) * slots;
+}
 
-charIndexIterState::charIndexIterState():cur_level(-1), cur_index(-1), cur_el(NULL), q(&default_iter, 6)
+void
+hostTrie::SetFirstChild(int node, unsigned char c, int child)
 {
+  if (nodes[node].indexed) {
+    tables[nodes[node].child + Slot(c)] = child;
+  } else {
+    nodes[node].child = child;
+  }
 }
 
-
-// class charIndex - A constant time string matcher intended for
-//    short strings in a sparsely populated DNS paritition
-//
-//    Creates a look up table for character in data string
-//
-//    Mapping from character to table index is done by
-//      asciiToTable[]
-//
-//    The illegalKey hash table is side structure for any
-//     entries that contain illegal hostname characters that
-//     we can not index into the normal table
-//
-//    Example: com
-//      c maps to 13, o maps to 25, m maps to 23
-//
-//                             charIndex_el         charIndex_el
-//                             -----------         ------------
-//                           0 |    |    |         |    |     |
-//                           . |    |    |         |    |     |
-//    charIndex_el           . |    |    |         |    |     |
-//    ----------             . |    |    |         |    |     |
-//  0 |   |    |             . |    |    |   |-->23| ptr|  0  |  (ptr is to the
-//  . |   |    |   |-------->25| 0  |   -----|     |    |     |   hostBranch for
-//  . |   |    |   |         . |    |    |         |    |     |   domain com)
-// 13 | 0 |  --|---|         . |    |    |         |    |     |
-//  . |   |    |             . |    |    |         |    |     |
-//  . |   |    |               |    |    |         |    |     |
-//  . |   |    |               |    |    |         |    |     |
-//    |   |    |               -----------         -----------|
-//    |   |    |
-//    |   |    |
-//    |   |    |
-//    |--------|
-//
+// void hostTrie::AddChild(int node, int child)
 //
+//   Splices child into the sorted list of node's children
+//     for its character
 //
-class
-  charIndex
+void
+hostTrie::AddChild(int node, int child)
 {
-public:
-  charIndex();
-  ~
-  charIndex();
-  void
-  Insert(const char *match_data, HostBranch * toInsert);
-  HostBranch *
-  Lookup(const char *match_data);
-  HostBranch *
-  iter_first(charIndexIterState * s);
-  HostBranch *
-  iter_next(charIndexIterState * s);
-private:
-  charIndex_el *
-    root;
-  InkHashTable *
-    illegalKey;
-};
+  unsigned char c = nodes[child].c;
+  int prev = 0;
+  int cur = FirstChild(node, c);
 
-charIndex::charIndex():illegalKey(NULL)
-{
-  root = NEW(new charIndex_el);
+  while (cur != 0 && nodes[cur].c < c) {
+    prev = cur;
+    cur = nodes[cur].sibling;
+  }
+  nodes[child].sibling = cur;
+  if (prev != 0) {
+    nodes[prev].sibling = child;
+  } else {
+    SetFirstChild(node, c, child);
+  }
 }
 
-charIndex::~charIndex()
+// void hostTrie::IndexChildren(int node)
+//
+//   Moves the list of node's children into an index table
+//
+void
+hostTrie::IndexChildren(int node)
 {
-  InkHashTableIteratorState ht_iter;
-  InkHashTableEntry *ht_entry = NULL;
-  HostBranch *tmp;
-
-  delete root;
-
-  // Destroy the illegalKey hashtable if there is one and free
-  //   up all of its values
-  if (illegalKey != NULL) {
-    ht_entry = ink_hash_table_iterator_first(illegalKey, &ht_iter);
-
-    while (ht_entry != NULL) {
-      tmp = (HostBranch *) ink_hash_table_entry_value(illegalKey, ht_entry);
-      ink_assert(tmp != NULL);
-      delete tmp;
-      ht_entry = ink_hash_table_iterator_next(illegalKey, &ht_iter);
-    }
-    ink_hash_table_destroy(illegalKey);
+  int cur = nodes[node].child;
+  int table = NewTable();
+
+  nodes[node].child = table;
+  nodes[node].indexed = true;
+  while (cur != 0) {
+    int next = nodes[cur].sibling;
+    AddChild(node, cur);
+    cur = next;
   }
 }
 
-// void charIndex::Insert(const char* match_data, HostBranch* toInsert)
+// void hostTrie::Insert(const char* match_data, HostBranch* toInsert)
 //
-//   Places a binding for match_data to toInsert into the index
+//   Places a binding for match_data to toInsert into the trie
 //
 void
-charIndex::Insert(const char *match_data, HostBranch * toInsert)
+hostTrie::Insert(const char *match_data, HostBranch * toInsert)
 {
-  unsigned char index;
-  const char *match_start = match_data;
-  charIndex_el *cur = root;
-  charIndex_el *next;
+  int parent = 0;
 
   if (*match_data == '\0') {
     // Should not happen
@@ -384,187 +418,89 @@ charIndex::Insert(const char *match_data, HostBranch * toInsert)
     return;
   }
 
-  while (1) {
-    index = asciiToTable[(unsigned char) (*match_data)];
+  for (const unsigned char *p = (const unsigned char *) match_data; *p != '\0'; p++) {
+    int cur = FirstChild(parent, *p);
 
-    // Check to see if our index into table is for an
-    //  'illegal' DNS character
-    if (index == 255) {
-      // Insert into illgals hash table
-      if (illegalKey == NULL) {
-        illegalKey = ink_hash_table_create(InkHashTableKeyType_String);
-      }
-      ink_hash_table_insert(illegalKey, (char *) match_start, toInsert);
-      break;
+    while (cur != 0 && nodes[cur].c < *p) {
+      cur = nodes[cur].sibling;
     }
 
-    // Check to see if are at the level we supposed be at
-    if (*(match_data + 1) == '\0') {
-      // The slot should always be emtpy, no duplicate
-      //   keys are allowed
-      ink_assert(cur->branch_array[index] == NULL);
-      cur->branch_array[index] = toInsert;
-      break;
-    } else {
-      // We need to find the next level in the table
-
-      next = cur->next_level[index];
-
-      // Check to see if we need to expand the table
-      if (next == NULL) {
-        next = NEW(new charIndex_el);
-        cur->next_level[index] = next;
+    if (cur == 0 || nodes[cur].c != *p) {
+      cur = NewNode(*p);
+      AddChild(parent, cur);
+      if (!nodes[parent].indexed && ++nodes[parent].num_children > hostTrieListMax) {
+        IndexChildren(parent);
       }
-      cur = next;
     }
-    match_data++;
+    parent = cur;
   }
-}
 
+  // The slot should always be emtpy, no duplicate
+  //   keys are allowed
+  ink_assert(nodes[parent].branch == 0);
+  if (num_branches >= max_branches) {
+    max_branches = max_branches ? max_branches * 2 : 8;
+    branches = (HostBranch **) ats_realloc(branches, max_branches * sizeof(HostBranch *));
+  }
+  branches[num_branches++] = toInsert;
+  nodes[parent].branch = num_branches;
+}
 
-// HostBranch* charIndex::Lookup(const char* match_data)
+// HostBranch* hostTrie::Lookup(const char* match_data)
 //
-//  Searches the charIndex on key match_data
+//  Searches the trie on key match_data
 //    If there is a binding for match_data, returns a pointer to it
 //    otherwise a NULL pointer is returned
 //
 HostBranch *
-charIndex::Lookup(const char *match_data)
+hostTrie::Lookup(const char *match_data)
 {
-  unsigned char index;
-  charIndex_el *cur = root;
-  void *hash_lookup;
-  const char *match_start = match_data;
+  int cur = 0;
 
-  if (root == NULL || *match_data == '\0') {
+  if (*match_data == '\0') {
     return NULL;
   }
 
-  while (1) {
+  for (const unsigned char *p = (const unsigned char *) match_data; *p != '\0'; p++) {
+    cur = FirstChild(cur, *p);
 
-    index = asciiToTable[(unsigned char) (*match_data)];
-
-    // Check to see if our index into table is for an
-    //  'illegal' DNS character
-    if (index == 255) {
-      if (illegalKey == NULL) {
-        return NULL;
-      } else {
-        if (ink_hash_table_lookup(illegalKey, (char *) match_start, &hash_lookup)) {
-          return (HostBranch *) hash_lookup;
-        } else {
-          return NULL;
-        }
-      }
+    // Siblings are sorted, stop at the first one past us
+    while (cur != 0 && nodes[cur].c < *p) {
+      cur = nodes[cur].sibling;
     }
-    // Check to see if we are looking for the next level or
-    //    a HostBranch
-    if (*(match_data + 1) == '\0') {
-      return cur->branch_array[index];
-    } else {
-      cur = cur->next_level[index];
-
-      if (cur == NULL) {
-        return NULL;
-      }
+    if (cur == 0 || nodes[cur].c != *p) {
+      return NULL;
     }
-
-    match_data++;
   }
+  return nodes[cur].branch ? branches[nodes[cur].branch - 1] : NULL;
 }
 
-//
-// HostBranch* charIndex::iter_next(charIndexIterState* s)
+// HostBranch* hostTrie::iter_first(hostTrieIterState* s)
 //
 //    Initialize iterator state and returns the first element
-//     found in the charTable.  If none is found, NULL
+//     found in the trie.  If none is found, NULL
 //     is returned
 //
 HostBranch *
-charIndex::iter_first(charIndexIterState * s)
+hostTrie::iter_first(hostTrieIterState * s)
 {
-  s->cur_level = 0;
-  s->cur_index = -1;
-  s->cur_el = root;
-
+  *s = 0;
   return iter_next(s);
 }
 
+// HostBranch* hostTrie::iter_next(hostTrieIterState* s)
 //
-// HostBranch* charIndex::iter_next(charIndexIterState* s)
-//
-//    Finds the next element in the char index and returns
+//    Finds the next element in the trie and returns
 //      a pointer to it.  If there are no more elements, NULL
-//      is returned
+//      is returned.  The elements come in insertion order
 //
 HostBranch *
-charIndex::iter_next(charIndexIterState * s)
+hostTrie::iter_next(hostTrieIterState * s)
 {
-  int index;
-  charIndex_el *current_el = s->cur_el;
-  intptr_t level = s->cur_level;
-  charIndexIterInternal stored_state;
-  HostBranch *r = NULL;
-  bool first_element;
-
-  // bool first_element is used to tell if first elemente
-  //  pointed to by s has already been returned to caller
-  //  it has unless we are being called from iter_first
-  if (s->cur_index < 0) {
-    first_element = false;
-    index = s->cur_index + 1;
-  } else {
-    first_element = true;
-    index = s->cur_index;
+  if (*s < num_branches) {
+    return branches[(*s)++];
   }
-
-  while (1) {
-
-    // Check to see if we need to go back up a level
-    if (index >= numLegalChars) {
-      if (level <= 0) {
-        // No more levels so bail out
-        break;
-      } else {
-        // Go back up to a stored level
-        stored_state = s->q[level - 1];
-        ink_assert(stored_state.ptr != NULL);
-        ink_assert(stored_state.index >= 0);
-        level--;
-        current_el = stored_state.ptr;
-        index = stored_state.index + 1;
-      }
-    } else {
-      // Check to see if there is something to return
-      //
-      //  Note: we check for something to return before a descending
-      //    a level so that when we come back up we will
-      //    be done with this index
-      //
-      if (current_el->branch_array[index] != NULL && first_element == false) {
-        r = current_el->branch_array[index];
-        s->cur_level = level;
-        s->cur_index = index;
-        s->cur_el = current_el;
-        break;
-      } else if (current_el->next_level[index] != NULL) {
-        // There is a lower level to iterate over, store our
-        //   current state and descend
-        stored_state.ptr = current_el;
-        stored_state.index = index;
-        s->q(level) = stored_state;
-        current_el = current_el->next_level[index];
-        index = 0;
-        level++;
-      } else {
-        // Nothing here so advance to next index
-        index++;
-      }
-    }
-    first_element = false;
-  }
-
-  return r;
+  return NULL;
 }
 
 // class hostArray
@@ -716,14 +652,9 @@ HostBranch::HostBranch():level(0), type(HOST_TERMINAL), next_level(NULL), leaf_i
 HostBranch::~HostBranch()
 {
 
-  // Hash Iteration
-  InkHashTable *ht;
-  InkHashTableIteratorState ht_iter;
-  InkHashTableEntry *ht_entry = NULL;
-
-  // charIndex Iteration
-  charIndexIterState ci_iter;
-  charIndex *ci;
+  // hostTrie Iteration
+  hostTrieIterState ht_iter;
+  hostTrie *ht;
 
   // hostArray Iteration
   hostArray *ha;
@@ -735,27 +666,15 @@ HostBranch::~HostBranch()
   case HOST_TERMINAL:
     ink_assert(next_level == NULL);
     break;
-  case HOST_HASH:
-    ink_assert(next_level != NULL);
-    ht = (InkHashTable *) next_level;
-    ht_entry = ink_hash_table_iterator_first(ht, &ht_iter);
-
-    while (ht_entry != NULL) {
-      lower_branch = (HostBranch *) ink_hash_table_entry_value(ht, ht_entry);
-      delete lower_branch;
-      ht_entry = ink_hash_table_iterator_next(ht, &ht_iter);
-    }
-    ink_hash_table_destroy(ht);
-    break;
-  case HOST_INDEX:
+  case HOST_TRIE:
     ink_assert(next_level != NULL);
-    ci = (charIndex *) next_level;
-    lower_branch = ci->iter_first(&ci_iter);
+    ht = (hostTrie *) next_level;
+    lower_branch = ht->iter_first(&ht_iter);
     while (lower_branch != NULL) {
       delete lower_branch;
-      lower_branch = ci->iter_next(&ci_iter);
+      lower_branch = ht->iter_next(&ht_iter);
     }
-    delete ci;
+    delete ht;
     break;
   case HOST_ARRAY:
     ink_assert(next_level != NULL);
@@ -824,14 +743,9 @@ void
 HostLookup::PrintHostBranch(HostBranch * hb, HostLookupPrintFunc f)
 {
 
-  // Hash iteration
-  InkHashTable *ht;
-  InkHashTableIteratorState ht_iter;
-  InkHashTableEntry *ht_entry = NULL;
-
-  // charIndex Iteration
-  charIndexIterState ci_iter;
-  charIndex *ci;
+  // hostTrie Iteration
+  hostTrieIterState ht_iter;
+  hostTrie *ht;
 
   // hostArray Iteration
   hostArray *h_array;
@@ -851,24 +765,13 @@ HostLookup::PrintHostBranch(HostBranch * hb, HostLookupPrintFunc f)
   case HOST_TERMINAL:
     ink_assert(hb->next_level == NULL);
     break;
-  case HOST_HASH:
+  case HOST_TRIE:
     ink_assert(hb->next_level != NULL);
-    ht = (InkHashTable *) hb->next_level;
-    ht_entry = ink_hash_table_iterator_first(ht, &ht_iter);
-
-    while (ht_entry != NULL) {
-      lower_branch = (HostBranch *) ink_hash_table_entry_value(ht, ht_entry);
-      PrintHostBranch(lower_branch, f);
-      ht_entry = ink_hash_table_iterator_next(ht, &ht_iter);
-    }
-    break;
-  case HOST_INDEX:
-    ink_assert(hb->next_level != NULL);
-    ci = (charIndex *) hb->next_level;
-    lower_branch = ci->iter_first(&ci_iter);
+    ht = (hostTrie *) hb->next_level;
+    lower_branch = ht->iter_first(&ht_iter);
     while (lower_branch != NULL) {
       PrintHostBranch(lower_branch, f);
-      lower_branch = ci->iter_next(&ci_iter);
+      lower_branch = ht->iter_next(&ht_iter);
     }
     break;
   case HOST_ARRAY:
@@ -895,16 +798,16 @@ HostBranch *
 HostLookup::TableNewLevel(HostBranch * from, const char *level_data)
 {
   hostArray *new_ha_table;
-  charIndex *new_ci_table;
+  hostTrie *new_ht_table;
 
   ink_assert(from->type == HOST_TERMINAL);
 
-  // Use the charIndex for high speed matching at the first level of
+  // Use the hostTrie for high speed matching at the first level of
   //   the table.  The first level is short strings, ie: com, edu, jp, fr
   if (from->level == 0) {
-    new_ci_table = NEW(new charIndex);
-    from->type = HOST_INDEX;
-    from->next_level = new_ci_table;
+    new_ht_table = NEW(new hostTrie);
+    from->type = HOST_TRIE;
+    from->next_level = new_ht_table;
   } else {
     new_ha_table = NEW(new hostArray);
     from->type = HOST_ARRAY;
@@ -927,14 +830,14 @@ HostBranch *
 HostLookup::InsertBranch(HostBranch * insert_in, const char *level_data)
 {
 
-  // Variables for moving an array into a hash table after it
+  // Variables for moving an array into a trie after it
   //   gets too big
   //
   hostArray *ha;
   hostArrayIterState ha_iter;
   HostBranch *tmp;
   char *key = NULL;
-  InkHashTable *new_ht;
+  hostTrie *new_ht;
 
 
   HostBranch *new_branch = NEW(new HostBranch);
@@ -948,34 +851,31 @@ HostLookup::InsertBranch(HostBranch * insert_in, const char *level_data)
     ink_assert(0);
     delete new_branch;
     break;
-  case HOST_HASH:
-    ink_hash_table_insert((InkHashTable *) insert_in->next_level, (char *) level_data, new_branch);
-    break;
-  case HOST_INDEX:
-    ((charIndex *) insert_in->next_level)->Insert(level_data, new_branch);
+  case HOST_TRIE:
+    ((hostTrie *) insert_in->next_level)->Insert(level_data, new_branch);
     break;
   case HOST_ARRAY:
     if (((hostArray *) insert_in->next_level)->Insert(level_data, new_branch) == false) {
 
-      // The array is out of space, time to move to a hash table
+      // The array is out of space, time to move to a trie
       ha = (hostArray *) insert_in->next_level;
-      new_ht = ink_hash_table_create(InkHashTableKeyType_String);
-      ink_hash_table_insert(new_ht, (char *) level_data, new_branch);
+      new_ht = NEW(new hostTrie);
 
       // Iterate through the existing elements in the array and
-      //  stuff them into the hash table
+      //  stuff them into the trie
       tmp = ha->iter_first(&ha_iter, &key);
       ink_assert(tmp != NULL);
       while (tmp != NULL) {
         ink_assert(key != NULL);
-        ink_hash_table_insert(new_ht, key, tmp);
+        new_ht->Insert(key, tmp);
         tmp = ha->iter_next(&ha_iter, &key);
       }
+      new_ht->Insert(level_data, new_branch);
 
       // Ring out the old, ring in the new
       delete ha;
       insert_in->next_level = new_ht;
-      insert_in->type = HOST_HASH;
+      insert_in->type = HOST_TRIE;
     }
     break;
 
@@ -997,29 +897,18 @@ HostLookup::FindNextLevel(HostBranch * from, const char *level_data, bool bNotPr
 {
 
   HostBranch *r = NULL;
-  InkHashTable *hash;
-  charIndex *ci_table;
+  hostTrie *ht_table;
   hostArray *ha_table;
-  void *lookup;
 
   switch (from->type) {
   case HOST_TERMINAL:
     // Should not happen
     ink_assert(0);
     return NULL;
-  case HOST_HASH:
-    hash = (InkHashTable *) from->next_level;
-    ink_assert(hash != NULL);
-    if (ink_hash_table_lookup(hash, (char *) level_data, &lookup)) {
-      r = (HostBranch *) lookup;
-    } else {
-      r = NULL;
-    }
-    break;
-  case HOST_INDEX:
-    ci_table = (charIndex *) from->next_level;
-    ink_assert(ci_table != NULL);
-    r = ci_table->Lookup(level_data);
+  case HOST_TRIE:
+    ht_table = (hostTrie *) from->next_level;
+    ink_assert(ht_table != NULL);
+    r = ht_table->Lookup(level_data);
     break;
   case HOST_ARRAY:
     ha_table = (hostArray *) from->next_level;
@@ -38,7 +38,7 @@ const int HOST_ARRAY_MAX = 8;   // Sets the fixed array size
 //  Begin Host Lookup Helper types
 //
 enum HostNodeType
-{ HOST_TERMINAL, HOST_HASH, HOST_INDEX, HOST_ARRAY };
+{ HOST_TERMINAL, HOST_TRIE, HOST_ARRAY };
 enum LeafType
 { LEAF_INVALID, HOST_PARTIAL, HOST_COMPLETE,
   DOMAIN_COMPLETE, DOMAIN_PARTIAL
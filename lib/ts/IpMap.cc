@@ -430,9 +430,12 @@ template <
   typedef typename N::ArgType ArgType; ///< Import type.
   typedef typename N::Metric Metric;   ///< Import type.g482
 
-  IpMapBase() : _root(0) {}
+  IpMapBase() : _root(0), _fmin(0), _fmax(0), _fdata(0), _findex(0), _fbits(0), _fcount(0) {}
   ~IpMapBase() { this->clear(); }
 
+  /// Maps with fewer ranges than this are not worth freezing.
+  static size_t const FREEZE_MIN = 16;
+
   /** Mark a range.
       All addresses in the range [ @a min , @a max ] are marked with @a data.
       @return This object.
@@ -490,6 +493,20 @@ template <
   */
   self& clear();
 
+  /** Build the lookup arrays.
+
+      The ranges are copied to sorted arrays indexed by the leading
+      bits of the address, so that a lookup is an index load and a
+      short binary search in contiguous memory instead of a walk down
+      the tree. Any change to the map discards the arrays.
+
+      @return This object.
+  */
+  self& freeze();
+
+  /// Discard the lookup arrays.
+  void thaw();
+
   /** Lower bound for @a target.  @return The node whose minimum value
       is the largest that is not greater than @a target, or @c NULL if
       all minimum values are larger than @a target.
@@ -554,6 +571,18 @@ template <
   /// This keeps track of all allocated nodes in order.
   /// Iteration depends on this list being maintained.
   NodeList _list;
+
+  /// @name Lookup arrays
+  /// Built by @c freeze, the ranges in order.
+  //@{
+  Metric* _fmin; ///< Minimum value of each range.
+  Metric* _fmax; ///< Maximum value of each range.
+  void** _fdata; ///< Client data of each range.
+  /// Index of the first range whose maximum is in or after each bucket.
+  uint32_t* _findex;
+  int _fbits; ///< Leading address bits used to pick the bucket.
+  size_t _fcount; ///< Number of ranges in the arrays.
+  //@}
 };
 
 template < typename N > N*
@@ -573,6 +602,7 @@ IpMapBase<N>::lowerBound(ArgType target) {
 
 template < typename N > IpMapBase<N>&
 IpMapBase<N>::clear() {
+  this->thaw();
   // Delete everything.
   N* n = static_cast<N*>(_list.getHead());
   while (n) {
@@ -585,8 +615,56 @@ IpMapBase<N>::clear() {
   return *this;
 }
 
+template < typename N > IpMapBase<N>&
+IpMapBase<N>::freeze() {
+  size_t n = _list.getCount();
+
+  this->thaw();
+  if (n < FREEZE_MIN) return *this; // the tree is just as fast.
+
+  // About one bucket per range, the index stays small next to the ranges.
+  for ( _fbits = 4 ; _fbits < 16 && (static_cast<size_t>(1) << _fbits) < n ; ++_fbits )
+    ;
+  uint32_t nbuckets = 1 << _fbits;
+  int shift = 32 - _fbits;
+
+  _fmin = new Metric[n];
+  _fmax = new Metric[n];
+  _fdata = new void*[n];
+  _findex = new uint32_t[nbuckets + 1];
+
+  uint32_t b = 0; // first bucket without an index.
+  uint32_t i = 0;
+  for ( N* x = this->getHead() ; x ; x = next(x), ++i ) {
+    _fmin[i] = x->_min;
+    _fmax[i] = x->_max;
+    _fdata[i] = x->_data;
+    // Earlier ranges end before the bucket holding this maximum.
+    for ( uint32_t last = N::prefixOf(x->_max) >> shift ; b <= last ; ++b )
+      _findex[b] = i;
+  }
+  while (b <= nbuckets) _findex[b++] = n;
+  _fcount = n;
+  return *this;
+}
+
+template < typename N > void
+IpMapBase<N>::thaw() {
+  if (_findex) {
+    delete [] _fmin;
+    delete [] _fmax;
+    delete [] _fdata;
+    delete [] _findex;
+    _fmin = _fmax = 0;
+    _fdata = 0;
+    _findex = 0;
+    _fcount = 0;
+  }
+}
+
 template < typename N > IpMapBase<N>&
 IpMapBase<N>::fill(ArgType rmin, ArgType rmax, void* payload) {
+  this->thaw();
   // Rightmost node of interest with n->_min <= min.
   N* n = this->lowerBound(rmin);
   N* x = 0; // New node (if any).
@@ -705,6 +783,7 @@ IpMapBase<N>::fill(ArgType rmin, ArgType rmax, void* payload) {
 
 template < typename N > IpMapBase<N>&
 IpMapBase<N>::mark(ArgType min, ArgType max, void* payload) {
+  this->thaw();
   N* n = this->lowerBound(min); // current node.
   N* x = 0; // New node, gets set if we re-use an existing one.
   N* y = 0; // Temporary for removing and advancing.
@@ -828,6 +907,7 @@ IpMapBase<N>::mark(ArgType min, ArgType max, void* payload) {
 
 template <typename N> IpMapBase<N>&
 IpMapBase<N>::unmark(ArgType min, ArgType max) {
+  this->thaw();
   N* n = this->lowerBound(min);
   N* x; // temp for deletes.
 
@@ -907,6 +987,26 @@ IpMapBase<N>::remove(N* n) {
 template <typename N> bool
 IpMapBase<N>::contains(ArgType x, void** ptr) const {
   bool zret = false;
+
+  if (_findex) {
+    uint32_t b = N::prefixOf(N::deref(x)) >> (32 - _fbits);
+    size_t first = _findex[b];
+    // Only the range holding the start of the next bucket can also reach into this one.
+    size_t lo = first, hi = _findex[b + 1] + 1;
+    if (hi > _fcount) hi = _fcount;
+    // Find the first range whose minimum is larger than @a x.
+    while (lo < hi) {
+      size_t mid = (lo + hi) / 2;
+      if (x < _fmin[mid]) hi = mid;
+      else lo = mid + 1;
+    }
+    if (lo > first && !(_fmax[lo - 1] < x)) {
+      if (ptr) *ptr = _fdata[lo - 1];
+      zret = true;
+    }
+    return zret;
+  }
+
   N* n = _root; // current node to test.
   while (n) {
     if (x < n->_min) n = left(n);
@@ -1070,6 +1170,13 @@ protected:
   ) {
     return metric;
   }
+
+  /// @return The leading 32 bits of @a metric, host order.
+  static uint32_t prefixOf(
+    Metric const& metric
+  ) {
+    return metric;
+  }
   
   struct {
     sockaddr_in _min;
@@ -1227,6 +1334,14 @@ protected:
   ) {
     return &metric;
   }
+
+  /// @return The leading 32 bits of @a metric, host order.
+  static uint32_t prefixOf(
+    Metric const& metric
+  ) {
+    uint8_t const* a = metric.sin6_addr.s6_addr;
+    return (static_cast<uint32_t>(a[0]) << 24) | (a[1] << 16) | (a[2] << 8) | a[3];
+  }
   
 };
 
@@ -1354,6 +1469,13 @@ IpMap::getCount() const {
   return zret;
 }
 
+IpMap&
+IpMap::freeze() {
+  if (_m4) _m4->freeze();
+  if (_m6) _m6->freeze();
+  return *this;
+}
+
 IpMap&
 IpMap::clear() {
   if (_m4) _m4->clear();
@@ -251,6 +251,9 @@ namespace ts { namespace detail {
     may require memory allocation / deallocation although this is
     minimized.
 
+    A map that is loaded once and then only searched should be frozen
+    with @c freeze after loading.
+
 */
 
 class IpMap {
@@ -468,6 +471,19 @@ public:
   */
   self& clear();
 
+  /** Prepare the map for lookups.
+
+      Call this when the map is loaded. Lookups then search sorted
+      arrays indexed by the leading address bits instead of the tree,
+      which is much faster for large maps. Any @c mark, @c unmark,
+      @c fill or @c clear discards the arrays and lookups go back to
+      the tree. Client data must be final, data set on a node through
+      an iterator afterwards is not seen by @c contains.
+
+      @return This object.
+  */
+  self& freeze();
+
   /// Iterator for first element.
   iterator begin();
   /// Iterator past last element.
@@ -173,5 +173,6 @@ Load_IpMap_From_File(IpMap* map, FILE* f, const char *key_str)
       }
     }
   }
+  map->freeze();
   return 0;
 }
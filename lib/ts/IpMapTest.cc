@@ -293,3 +293,67 @@ REGRESSION_TEST(IpMap_Fill)(RegressionTest* t, int /* atype ATS_UNUSED */, int*
            "IpMap Fill[v6-2]: ::1 has bad mark.");
  
 }
+
+REGRESSION_TEST(IpMap_Freeze)(RegressionTest* t, int /* atype ATS_UNUSED */, int* pstatus) {
+  TestBox tb(t, pstatus);
+  IpMap map, tree;
+  void* mark1;
+  void* mark2;
+  bool found1, found2;
+  int mismatch = 0;
+
+  *pstatus = REGRESSION_TEST_PASSED;
+
+  // Ranges of varying width, some spanning many buckets.
+  uint32_t x = 0x01000000;
+  for ( int i = 1 ; i < 5000 ; ++i ) {
+    uint32_t w = (i % 7 == 0) ? 0x00fffff : (i % 3) * 13;
+    map.mark(htonl(x), htonl(x + w), reinterpret_cast<void*>(i));
+    tree.mark(htonl(x), htonl(x + w), reinterpret_cast<void*>(i));
+    x += w + 1 + (i % 5) * 1021;
+  }
+  IpEndpoint a6_min, a6_max;
+  ats_ip_pton("2001:db8::", &a6_min);
+  ats_ip_pton("2001:db8::ffff", &a6_max);
+  for ( int i = 0 ; i < 40 ; ++i ) {
+    a6_min.sin6.sin6_addr.s6_addr[4] = a6_max.sin6.sin6_addr.s6_addr[4] = i * 3;
+    map.mark(&a6_min, &a6_max, reinterpret_cast<void*>(i + 1));
+    tree.mark(&a6_min, &a6_max, reinterpret_cast<void*>(i + 1));
+  }
+  map.freeze();
+
+  for ( uint32_t y = 0 ; y < x + 0x100000 ; y += 257 ) {
+    found1 = map.contains(htonl(y), &mark1);
+    found2 = tree.contains(htonl(y), &mark2);
+    if (found1 != found2 || (found1 && mark1 != mark2)) ++mismatch;
+  }
+  for ( IpMap::iterator spot(tree.begin()), limit(tree.end()) ; spot != limit ; ++spot) {
+    if (AF_INET != spot->min()->sa_family) continue;
+    in_addr_t edges[4] = {
+      htonl(ntohl(ats_ip4_addr_cast(spot->min())) - 1), ats_ip4_addr_cast(spot->min()),
+      ats_ip4_addr_cast(spot->max()), htonl(ntohl(ats_ip4_addr_cast(spot->max())) + 1)
+    };
+    for ( int i = 0 ; i < 4 ; ++i ) {
+      found1 = map.contains(edges[i], &mark1);
+      found2 = tree.contains(edges[i], &mark2);
+      if (found1 != found2 || (found1 && mark1 != mark2)) ++mismatch;
+    }
+  }
+  tb.check(mismatch == 0, "IpMap Freeze: %d IPv4 lookups differ from the tree.", mismatch);
+  tb.check(map.contains(~static_cast<in_addr_t>(0)) == tree.contains(~static_cast<in_addr_t>(0)),
+           "IpMap Freeze: Max address differs from the tree.");
+
+  mismatch = 0;
+  for ( int i = 0 ; i < 256 ; ++i ) {
+    a6_min.sin6.sin6_addr.s6_addr[4] = i;
+    a6_min.sin6.sin6_addr.s6_addr[15] = i;
+    found1 = map.contains(&a6_min, &mark1);
+    found2 = tree.contains(&a6_min, &mark2);
+    if (found1 != found2 || (found1 && mark1 != mark2)) ++mismatch;
+  }
+  tb.check(mismatch == 0, "IpMap Freeze: %d IPv6 lookups differ from the tree.", mismatch);
+
+  // A change goes back to the tree.
+  map.unmark(htonl(0x01000000), htonl(0x01000000));
+  tb.check(!map.contains(htonl(0x01000000)), "IpMap Freeze: Unmark after freeze not seen.");
+}
@@ -24,6 +24,952 @@
 #include "libts.h"
 #include "Regex.h"
 
+// The patterns of a DFA are parsed into one Thompson NFA, each pattern
+// hanging off the start state.  A DFA state is the set of NFA nodes the
+// input so far can be in; states and their transitions are made the first
+// time a match needs them, under the lock, and published with an atomic
+// store so matching takes no lock.  Input bytes are mapped to classes of
+// bytes that no pattern tells apart, to keep the transition tables small.
+//
+// A pattern matches once its MATCH node is reached, or, past a "$", at the
+// end of the string or before a newline ending it.  The automaton does the
+// pcre syntax for which that holds: literals, escapes, ".", classes, groups,
+// alternation and greedy or lazy quantifiers.  Anything else stays with
+// pcre_exec().
+//
+// Past DFA_MAX_STATES states a transition is marked full, and matches that
+// take it fall back to pcre_exec() too.
+
+#define DFA_MAX_STATES     4096
+#define DFA_STATE_CHUNK    256
+#define DFA_MAX_NODES      32768
+#define DFA_MAX_REPEAT     256
+#define DFA_BUCKETS        1024
+
+#define DFA_TRANS_UNKNOWN  -1
+#define DFA_TRANS_DEAD     -2
+#define DFA_TRANS_FULL     -3
+
+enum DFANodeType
+{
+  DFA_NODE_CHARS,               // a byte in set, then out1
+  DFA_NODE_SPLIT,               // out1 and out2
+  DFA_NODE_EMPTY,               // out1
+  DFA_NODE_END,                 // "$", then out1
+  DFA_NODE_MATCH                // pattern idx matched
+};
+
+struct DFANode
+{
+  int type;
+  int out1;
+  int out2;
+  int set;
+  int idx;
+};
+
+struct DFACharSet
+{
+  uint32_t bits[8];
+
+  bool has(int c) const { return (bits[c >> 5] >> (c & 31)) & 1; }
+  void add(int c) { bits[c >> 5] |= 1U << (c & 31); }
+};
+
+struct DFAState
+{
+  int *nodes;                   // CHARS, END and MATCH nodes, sorted
+  int n_nodes;
+  uint32_t hash;
+  int hash_next;
+  int *accepts;                 // patterns matched here, ascending
+  int n_accepts;
+  int *end_accepts;             // patterns matched here at the end of the string
+  int n_end_accepts;
+  int live_min;                 // lowest pattern which may match further on, or -1
+  volatile int *trans;          // next state for each byte class
+};
+
+struct DFAAutomaton
+{
+  DFANode *nodes;
+  int n_nodes;
+  int max_nodes;
+  DFACharSet *sets;
+  int n_sets;
+  int max_sets;
+
+  int *roots;                   // starts of the patterns, or of their branches
+  int n_roots;
+  int *restarts;                // unanchored starts, taken again at every byte
+  int n_restarts;
+  int restart_min;              // lowest unanchored pattern, or -1
+
+  unsigned char cls[256];
+  unsigned char cls_byte[256];  // a byte of each class
+  int n_cls;
+
+  DFAState **chunks[DFA_MAX_STATES / DFA_STATE_CHUNK];
+  int n_states;
+  int buckets[DFA_BUCKETS];
+  ink_mutex lock;
+
+  // scratch space for making states, used under the lock
+  int *mark;
+  int generation;
+  int *stack;
+  int *set;
+  int *end_set;
+};
+
+struct DFAFrag
+{
+  int start;
+  int end;                      // node whose out1 is still to be set
+};
+
+struct DFAParser
+{
+  DFAAutomaton *a;
+  const char *p;
+  int pos;
+  int len;
+  int idx;
+  bool caseless;
+  bool ok;
+};
+
+static int
+dfa_int_cmp(const void *a, const void *b)
+{
+  return *(const int *) a - *(const int *) b;
+}
+
+static inline DFAState *
+dfa_get(const DFAAutomaton *a, int id)
+{
+  return a->chunks[id / DFA_STATE_CHUNK][id % DFA_STATE_CHUNK];
+}
+
+//-------------------------------------------------------------------------
+// Parsing patterns into the NFA
+//-------------------------------------------------------------------------
+
+static int
+dfa_node(DFAParser *ps, int type, int set)
+{
+  DFAAutomaton *a = ps->a;
+
+  if (a->n_nodes >= a->max_nodes) {
+    if (a->max_nodes >= DFA_MAX_NODES) {
+      ps->ok = false;
+      return 0;
+    }
+    a->max_nodes = a->max_nodes ? a->max_nodes * 2 : 256;
+    a->nodes = (DFANode *) ats_realloc(a->nodes, a->max_nodes * sizeof(DFANode));
+  }
+
+  DFANode *n = &a->nodes[a->n_nodes];
+
+  n->type = type;
+  n->out1 = -1;
+  n->out2 = -1;
+  n->set = set;
+  n->idx = ps->idx;
+  return a->n_nodes++;
+}
+
+static void
+dfa_fold(DFACharSet *s)
+{
+  for (int c = 'a'; c <= 'z'; c++) {
+    if (s->has(c) || s->has(c - 'a' + 'A')) {
+      s->add(c);
+      s->add(c - 'a' + 'A');
+    }
+  }
+}
+
+static DFAFrag
+dfa_frag(int start, int end)
+{
+  DFAFrag f;
+
+  f.start = start;
+  f.end = end;
+  return f;
+}
+
+static DFAFrag
+dfa_chars(DFAParser *ps, DFACharSet *s)
+{
+  DFAAutomaton *a = ps->a;
+
+  if (ps->caseless)
+    dfa_fold(s);
+  if (a->n_sets >= a->max_sets) {
+    a->max_sets = a->max_sets ? a->max_sets * 2 : 64;
+    a->sets = (DFACharSet *) ats_realloc(a->sets, a->max_sets * sizeof(DFACharSet));
+  }
+  a->sets[a->n_sets] = *s;
+
+  int n = dfa_node(ps, DFA_NODE_CHARS, a->n_sets++);
+
+  return dfa_frag(n, n);
+}
+
+static DFAFrag
+dfa_empty(DFAParser *ps)
+{
+  int n = dfa_node(ps, DFA_NODE_EMPTY, -1);
+
+  return dfa_frag(n, n);
+}
+
+static DFAFrag
+dfa_concat(DFAParser *ps, DFAFrag f, DFAFrag g)
+{
+  if (f.start < 0 || !ps->ok)
+    return ps->ok ? g : f;
+  ps->a->nodes[f.end].out1 = g.start;
+  return dfa_frag(f.start, g.end);
+}
+
+static DFAFrag
+dfa_either(DFAParser *ps, DFAFrag f, DFAFrag g)
+{
+  int split = dfa_node(ps, DFA_NODE_SPLIT, -1);
+  int end = dfa_node(ps, DFA_NODE_EMPTY, -1);
+
+  if (!ps->ok)
+    return f;
+  ps->a->nodes[split].out1 = f.start;
+  ps->a->nodes[split].out2 = g.start;
+  ps->a->nodes[f.end].out1 = end;
+  ps->a->nodes[g.end].out1 = end;
+  return dfa_frag(split, end);
+}
+
+// f*, f+ or f?, for min 0 or 1 and max 1 or unbounded (-1)
+static DFAFrag
+dfa_repeat(DFAParser *ps, DFAFrag f, int min, int max)
+{
+  int split = dfa_node(ps, DFA_NODE_SPLIT, -1);
+  int end = dfa_node(ps, DFA_NODE_EMPTY, -1);
+
+  if (!ps->ok)
+    return f;
+  ps->a->nodes[split].out1 = f.start;
+  ps->a->nodes[split].out2 = end;
+  ps->a->nodes[f.end].out1 = max < 0 ? split : end;
+  return dfa_frag(min ? f.start : split, end);
+}
+
+// Parses the escape at ps->pos into s, and returns the byte it stands for,
+// or -1 for a class like \d
+static int
+dfa_parse_escape(DFAParser *ps, DFACharSet *s)
+{
+  if (++ps->pos >= ps->len) {
+    ps->ok = false;
+    return -1;
+  }
+
+  int c = (unsigned char) ps->p[ps->pos++];
+
+  switch (c) {
+  case 't':
+    c = '\t';
+    break;
+  case 'n':
+    c = '\n';
+    break;
+  case 'r':
+    c = '\r';
+    break;
+  case 'f':
+    c = '\f';
+    break;
+  case 'e':
+    c = '\033';
+    break;
+  case 'a':
+    c = '\007';
+    break;
+  case 'x':
+    c = 0;
+    for (int i = 0; i < 2 && ps->pos < ps->len && ParseRules::is_hex(ps->p[ps->pos]); i++)
+      c = c * 16 + ink_get_hex(ps->p[ps->pos++]);
+    if (ps->pos < ps->len && ps->p[ps->pos] == '{')
+      ps->ok = false;
+    break;
+  case 'd': case 'D': case 'w': case 'W': case 's': case 'S':
+    for (int b = 0; b < 256; b++) {
+      bool in;
+
+      switch (c | 0x20) {
+      case 'd':
+        in = b >= '0' && b <= '9';
+        break;
+      case 'w':
+        in = (b >= '0' && b <= '9') || (b >= 'a' && b <= 'z') || (b >= 'A' && b <= 'Z') || b == '_';
+        break;
+      default:
+        in = b == ' ' || b == '\t' || b == '\n' || b == '\f' || b == '\r';
+        break;
+      }
+      if (in != (c < 'a'))
+        s->add(b);
+    }
+    return -1;
+  default:
+    // back references, \b, \A, \Q and the like are left to pcre
+    if (ParseRules::is_alnum(c))
+      ps->ok = false;
+    break;
+  }
+  s->add(c);
+  return c;
+}
+
+static DFAFrag
+dfa_parse_class(DFAParser *ps)
+{
+  DFACharSet s;
+  bool negate = false;
+  bool first = true;
+
+  memset(&s, 0, sizeof(s));
+  if (++ps->pos < ps->len && ps->p[ps->pos] == '^') {
+    negate = true;
+    ps->pos++;
+  }
+  while (ps->ok) {
+    if (ps->pos >= ps->len) {
+      ps->ok = false;
+      break;
+    }
+
+    int c = (unsigned char) ps->p[ps->pos];
+
+    if (c == ']' && !first) {
+      ps->pos++;
+      break;
+    }
+    first = false;
+    if (c == '[' && ps->pos + 1 < ps->len && strchr(":.=", ps->p[ps->pos + 1])) {
+      ps->ok = false;           // POSIX classes
+      break;
+    }
+    if (c == '\\') {
+      if (ps->pos + 1 < ps->len && ps->p[ps->pos + 1] == 'b') {
+        ps->ok = false;         // a backspace in here
+        break;
+      }
+      c = dfa_parse_escape(ps, &s);
+      if (c < 0)
+        continue;
+    } else {
+      ps->pos++;
+    }
+    if (ps->pos + 1 < ps->len && ps->p[ps->pos] == '-' && ps->p[ps->pos + 1] != ']') {
+      int hi = (unsigned char) ps->p[++ps->pos];
+
+      if (hi == '\\') {
+        hi = dfa_parse_escape(ps, &s);
+      } else {
+        ps->pos++;
+      }
+      if (hi < c) {
+        ps->ok = false;
+        break;
+      }
+      for (; c <= hi; c++)
+        s.add(c);
+    } else {
+      s.add(c);
+    }
+  }
+  if (!ps->ok)
+    return dfa_frag(-1, -1);
+  // pcre folds the case of a negated class before negating it
+  if (ps->caseless)
+    dfa_fold(&s);
+  if (negate) {
+    for (int i = 0; i < 8; i++)
+      s.bits[i] = ~s.bits[i];
+  }
+  return dfa_chars(ps, &s);
+}
+
+static DFAFrag dfa_parse_alt(DFAParser *ps);
+
+static DFAFrag
+dfa_parse_atom(DFAParser *ps)
+{
+  DFACharSet s;
+  int c = (unsigned char) ps->p[ps->pos];
+
+  memset(&s, 0, sizeof(s));
+  switch (c) {
+  case '(':
+    {
+      if (++ps->pos < ps->len && ps->p[ps->pos] == '?') {
+        if (ps->pos + 1 < ps->len && ps->p[ps->pos + 1] == ':') {
+          ps->pos += 2;
+        } else {
+          ps->ok = false;       // look arounds, inline options, ...
+          return dfa_frag(-1, -1);
+        }
+      }
+
+      DFAFrag f = dfa_parse_alt(ps);
+
+      if (ps->ok && (ps->pos >= ps->len || ps->p[ps->pos] != ')'))
+        ps->ok = false;
+      ps->pos++;
+      return f;
+    }
+  case '[':
+    return dfa_parse_class(ps);
+  case '.':
+    for (int b = 0; b < 256; b++) {
+      if (b != '\n')
+        s.add(b);
+    }
+    ps->pos++;
+    return dfa_chars(ps, &s);
+  case '\\':
+    dfa_parse_escape(ps, &s);
+    return dfa_chars(ps, &s);
+  case '$':
+    {
+      int n = dfa_node(ps, DFA_NODE_END, -1);
+
+      // "$\n" and the like can match before a final newline
+      if (++ps->pos < ps->len && !strchr("|)", ps->p[ps->pos]))
+        ps->ok = false;
+      return dfa_frag(n, n);
+    }
+  case '^':
+  case '*':
+  case '+':
+  case '?':
+    // "^" is only done at the start of a pattern, the others are errors
+    ps->ok = false;
+    return dfa_frag(-1, -1);
+  default:
+    s.add(c);
+    ps->pos++;
+    return dfa_chars(ps, &s);
+  }
+}
+
+// Parses "{min}", "{min,}" or "{min,max}" at ps->pos; anything else is a
+// literal "{" to pcre
+static bool
+dfa_parse_bounds(DFAParser *ps, int *min, int *max)
+{
+  int pos = ps->pos + 1;
+  int n = 0;
+  int digits = 0;
+
+  while (pos < ps->len && ParseRules::is_digit(ps->p[pos]) && n <= DFA_MAX_REPEAT) {
+    n = n * 10 + ps->p[pos++] - '0';
+    digits++;
+  }
+  if (!digits || pos >= ps->len)
+    return false;
+  *min = *max = n;
+  if (ps->p[pos] == ',') {
+    pos++;
+    *max = -1;
+    if (pos < ps->len && ParseRules::is_digit(ps->p[pos])) {
+      for (n = 0; pos < ps->len && ParseRules::is_digit(ps->p[pos]) && n <= DFA_MAX_REPEAT;)
+        n = n * 10 + ps->p[pos++] - '0';
+      *max = n;
+    }
+  }
+  if (pos >= ps->len || ps->p[pos] != '}')
+    return false;
+  ps->pos = pos + 1;
+  return true;
+}
+
+static DFAFrag
+dfa_parse_repeat(DFAParser *ps)
+{
+  int begin = ps->pos;
+  DFAFrag f = dfa_parse_atom(ps);
+  int end = ps->pos;
+  int min, max;
+
+  if (!ps->ok || ps->pos >= ps->len)
+    return f;
+  switch (ps->p[ps->pos]) {
+  case '*':
+    min = 0, max = -1;
+    ps->pos++;
+    break;
+  case '+':
+    min = 1, max = -1;
+    ps->pos++;
+    break;
+  case '?':
+    min = 0, max = 1;
+    ps->pos++;
+    break;
+  case '{':
+    if (!dfa_parse_bounds(ps, &min, &max))
+      return f;
+    break;
+  default:
+    return f;
+  }
+  if (ps->pos < ps->len && ps->p[ps->pos] == '+') {
+    ps->ok = false;             // possessive
+    return f;
+  }
+  // lazy quantifiers match the same strings
+  if (ps->pos < ps->len && ps->p[ps->pos] == '?')
+    ps->pos++;
+  if (min > DFA_MAX_REPEAT || max > DFA_MAX_REPEAT || (max >= 0 && max < min)) {
+    ps->ok = false;
+    return f;
+  }
+
+  // x{2,4} is xxx?x? and x{2,} is xxx*, with the atom parsed again for
+  // each copy
+  int after = ps->pos;
+  DFAFrag r = dfa_frag(-1, -1);
+  bool used = false;
+
+  for (int i = 0; ps->ok && (i < min || i < max || (max < 0 && i == min)); i++) {
+    DFAFrag copy = f;
+
+    if (used) {
+      ps->pos = begin;
+      copy = dfa_parse_atom(ps);
+      ps->pos = end;
+    }
+    used = true;
+    if (i < min) {
+      r = dfa_concat(ps, r, copy);
+    } else if (max < 0) {
+      r = dfa_concat(ps, r, dfa_repeat(ps, copy, 0, -1));
+    } else {
+      r = dfa_concat(ps, r, dfa_repeat(ps, copy, 0, 1));
+    }
+  }
+  ps->pos = after;
+  if (r.start < 0)
+    return dfa_empty(ps);
+  return r;
+}
+
+static DFAFrag
+dfa_parse_seq(DFAParser *ps)
+{
+  DFAFrag f = dfa_frag(-1, -1);
+
+  while (ps->ok && ps->pos < ps->len && ps->p[ps->pos] != '|' && ps->p[ps->pos] != ')')
+    f = dfa_concat(ps, f, dfa_parse_repeat(ps));
+  if (f.start < 0)
+    return dfa_empty(ps);
+  return f;
+}
+
+static DFAFrag
+dfa_parse_alt(DFAParser *ps)
+{
+  DFAFrag f = dfa_parse_seq(ps);
+
+  while (ps->ok && ps->pos < ps->len && ps->p[ps->pos] == '|') {
+    ps->pos++;
+
+    DFAFrag g = dfa_parse_seq(ps);
+
+    if (ps->ok)
+      f = dfa_either(ps, f, g);
+  }
+  return f;
+}
+
+static void
+dfa_add_start(int **starts, int *n, int node)
+{
+  *starts = (int *) ats_realloc(*starts, (*n + 1) * sizeof(int));
+  (*starts)[(*n)++] = node;
+}
+
+// Adds pattern idx to the NFA, returns false, leaving the NFA as it was,
+// if it uses syntax the automaton does not do
+static bool
+dfa_add_pattern(DFAAutomaton *a, const char *pattern, int idx, REFlags flags)
+{
+  DFAParser ps;
+  int n_nodes = a->n_nodes;
+  int n_sets = a->n_sets;
+  int n_roots = a->n_roots;
+  int n_restarts = a->n_restarts;
+
+  ps.a = a;
+  ps.p = pattern;
+  ps.pos = 0;
+  ps.len = strlen(pattern);
+  ps.idx = idx;
+  ps.caseless = (flags & RE_CASE_INSENSITIVE) != 0;
+  ps.ok = true;
+
+  int match = dfa_node(&ps, DFA_NODE_MATCH, -1);
+
+  // Top level branches are added one by one, so that unanchored ones
+  // starting with "^" can start only at the start of the string
+  while (ps.ok) {
+    bool anchored = !(flags & RE_UNANCHORED);
+
+    if (ps.pos < ps.len && ps.p[ps.pos] == '^') {
+      anchored = true;
+      ps.pos++;
+    }
+
+    DFAFrag f = dfa_parse_seq(&ps);
+
+    if (!ps.ok)
+      break;
+    a->nodes[f.end].out1 = match;
+    if (anchored) {
+      dfa_add_start(&a->roots, &a->n_roots, f.start);
+    } else {
+      dfa_add_start(&a->restarts, &a->n_restarts, f.start);
+    }
+    if (ps.pos >= ps.len)
+      break;
+    if (ps.p[ps.pos] != '|')
+      ps.ok = false;
+    ps.pos++;
+  }
+
+  if (!ps.ok) {
+    a->n_nodes = n_nodes;
+    a->n_sets = n_sets;
+    a->n_roots = n_roots;
+    a->n_restarts = n_restarts;
+    return false;
+  }
+  if (a->n_restarts > n_restarts && a->restart_min < 0)
+    a->restart_min = idx;
+  return true;
+}
+
+//-------------------------------------------------------------------------
+// Making DFA states
+//-------------------------------------------------------------------------
+
+// Adds the CHARS, END and MATCH nodes reachable from node to set,
+// following "$" as well if through_end
+static void
+dfa_closure(DFAAutomaton *a, int node, bool through_end, int *set, int *n_set)
+{
+  int n_stack = 0;
+
+  if (node < 0 || a->mark[node] == a->generation)
+    return;
+  a->mark[node] = a->generation;
+  a->stack[n_stack++] = node;
+  while (n_stack) {
+    DFANode *n = &a->nodes[a->stack[--n_stack]];
+    int next[2] = { -1, -1 };
+
+    switch (n->type) {
+    case DFA_NODE_SPLIT:
+      next[1] = n->out2;
+      // fall through
+    case DFA_NODE_EMPTY:
+      next[0] = n->out1;
+      break;
+    case DFA_NODE_END:
+      if (through_end) {
+        next[0] = n->out1;
+        break;
+      }
+      // fall through
+    default:
+      set[(*n_set)++] = n - a->nodes;
+      break;
+    }
+    for (int i = 0; i < 2; i++) {
+      if (next[i] >= 0 && a->mark[next[i]] != a->generation) {
+        a->mark[next[i]] = a->generation;
+        a->stack[n_stack++] = next[i];
+      }
+    }
+  }
+}
+
+// Sorted, unique pattern indexes of the MATCH nodes in set
+static int *
+dfa_accepts(DFAAutomaton *a, int *set, int n_set, int *n_accepts)
+{
+  int *accepts = NULL;
+  int n = 0;
+
+  for (int i = 0; i < n_set; i++) {
+    if (a->nodes[set[i]].type == DFA_NODE_MATCH) {
+      accepts = (int *) ats_realloc(accepts, (n + 1) * sizeof(int));
+      accepts[n++] = a->nodes[set[i]].idx;
+    }
+  }
+  if (n > 1) {
+    int u = 1;
+
+    qsort(accepts, n, sizeof(int), dfa_int_cmp);
+    for (int i = 1; i < n; i++) {
+      if (accepts[i] != accepts[u - 1])
+        accepts[u++] = accepts[i];
+    }
+    n = u;
+  }
+  *n_accepts = n;
+  return accepts;
+}
+
+// Finds or makes the state for the n_set nodes in a->set
+static int
+dfa_state(DFAAutomaton *a, int n_set)
+{
+  uint32_t hash = 2166136261U;  // FNV-1a
+
+  qsort(a->set, n_set, sizeof(int), dfa_int_cmp);
+  for (int i = 0; i < n_set; i++) {
+    hash ^= (uint32_t) a->set[i];
+    hash *= 16777619U;
+  }
+  for (int id = a->buckets[hash % DFA_BUCKETS]; id >= 0; id = dfa_get(a, id)->hash_next) {
+    DFAState *s = dfa_get(a, id);
+
+    if (s->hash == hash && s->n_nodes == n_set && !memcmp(s->nodes, a->set, n_set * sizeof(int)))
+      return id;
+  }
+  if (a->n_states >= DFA_MAX_STATES)
+    return DFA_TRANS_FULL;
+
+  DFAState *s = (DFAState *) ats_malloc(sizeof(DFAState));
+  int n_end = 0;
+
+  s->nodes = (int *) ats_malloc(n_set * sizeof(int));
+  memcpy(s->nodes, a->set, n_set * sizeof(int));
+  s->n_nodes = n_set;
+  s->hash = hash;
+  s->accepts = dfa_accepts(a, s->nodes, n_set, &s->n_accepts);
+  s->live_min = a->restart_min;
+  a->generation++;
+  for (int i = 0; i < n_set; i++) {
+    DFANode *n = &a->nodes[s->nodes[i]];
+
+    if (n->type == DFA_NODE_END)
+      dfa_closure(a, n->out1, true, a->end_set, &n_end);
+    if (n->type != DFA_NODE_MATCH && (s->live_min < 0 || n->idx < s->live_min))
+      s->live_min = n->idx;
+  }
+  s->end_accepts = dfa_accepts(a, a->end_set, n_end, &s->n_end_accepts);
+  s->trans = (volatile int *) ats_malloc(a->n_cls * sizeof(int));
+  for (int i = 0; i < a->n_cls; i++)
+    s->trans[i] = DFA_TRANS_UNKNOWN;
+
+  int id = a->n_states++;
+  DFAState **chunk = a->chunks[id / DFA_STATE_CHUNK];
+
+  if (chunk == NULL) {
+    chunk = (DFAState **) ats_malloc(DFA_STATE_CHUNK * sizeof(DFAState *));
+    a->chunks[id / DFA_STATE_CHUNK] = chunk;
+  }
+  chunk[id % DFA_STATE_CHUNK] = s;
+  s->hash_next = a->buckets[hash % DFA_BUCKETS];
+  a->buckets[hash % DFA_BUCKETS] = id;
+  return id;
+}
+
+// Makes the transition of state id on byte class cls
+static int
+dfa_transition(DFAAutomaton *a, int id, int cls)
+{
+  DFAState *s = dfa_get(a, id);
+  int n_set = 0;
+  int next;
+
+  ink_mutex_acquire(&a->lock);
+  next = s->trans[cls];
+  if (next == DFA_TRANS_UNKNOWN) {
+    int b = a->cls_byte[cls];
+
+    a->generation++;
+    for (int i = 0; i < s->n_nodes; i++) {
+      DFANode *n = &a->nodes[s->nodes[i]];
+
+      if (n->type == DFA_NODE_CHARS && a->sets[n->set].has(b))
+        dfa_closure(a, n->out1, false, a->set, &n_set);
+    }
+    for (int i = 0; i < a->n_restarts; i++)
+      dfa_closure(a, a->restarts[i], false, a->set, &n_set);
+    next = n_set ? dfa_state(a, n_set) : DFA_TRANS_DEAD;
+    // the state is complete before anyone can get to it
+    ink_atomic_swap(&s->trans[cls], next);
+  }
+  ink_mutex_release(&a->lock);
+  return next;
+}
+
+static inline int
+dfa_next(DFAAutomaton *a, int id, const DFAState *s, unsigned char c)
+{
+  int cls = a->cls[c];
+  int next = s->trans[cls];
+
+  if (next == DFA_TRANS_UNKNOWN)
+    next = dfa_transition(a, id, cls);
+  return next;
+}
+
+static DFAAutomaton *
+dfa_automaton_create()
+{
+  DFAAutomaton *a = (DFAAutomaton *) ats_calloc(1, sizeof(DFAAutomaton));
+
+  a->restart_min = -1;
+  for (int i = 0; i < DFA_BUCKETS; i++)
+    a->buckets[i] = -1;
+  ink_mutex_init(&a->lock, "DFA");
+  return a;
+}
+
+// Once all the patterns are in: works out the byte classes and makes the
+// start state
+static void
+dfa_automaton_finish(DFAAutomaton *a)
+{
+  int cls[256];
+  int remap[512];
+
+  // split the bytes by whether each set has them
+  memset(cls, 0, sizeof(cls));
+  a->n_cls = 1;
+  for (int i = 0; i < a->n_sets; i++) {
+    int n = 0;
+
+    for (int k = 0; k < a->n_cls * 2; k++)
+      remap[k] = -1;
+    for (int b = 0; b < 256; b++) {
+      int k = cls[b] * 2 + a->sets[i].has(b);
+
+      if (remap[k] < 0)
+        remap[k] = n++;
+      cls[b] = remap[k];
+    }
+    a->n_cls = n;
+  }
+  for (int b = 255; b >= 0; b--) {
+    a->cls[b] = cls[b];
+    a->cls_byte[cls[b]] = b;
+  }
+
+  a->mark = (int *) ats_malloc(a->n_nodes * sizeof(int));
+  for (int i = 0; i < a->n_nodes; i++)
+    a->mark[i] = -1;
+  a->stack = (int *) ats_malloc(a->n_nodes * sizeof(int));
+  a->set = (int *) ats_malloc(a->n_nodes * sizeof(int));
+  a->end_set = (int *) ats_malloc(a->n_nodes * sizeof(int));
+
+  int n_set = 0;
+
+  for (int i = 0; i < a->n_roots; i++)
+    dfa_closure(a, a->roots[i], false, a->set, &n_set);
+  for (int i = 0; i < a->n_restarts; i++)
+    dfa_closure(a, a->restarts[i], false, a->set, &n_set);
+  dfa_state(a, n_set);
+}
+
+static void
+dfa_automaton_destroy(DFAAutomaton *a)
+{
+  for (int id = 0; id < a->n_states; id++) {
+    DFAState *s = dfa_get(a, id);
+
+    ats_free(s->nodes);
+    ats_free(s->accepts);
+    ats_free(s->end_accepts);
+    ats_free((void *) s->trans);
+    ats_free(s);
+  }
+  for (int i = 0; i < DFA_MAX_STATES / DFA_STATE_CHUNK; i++)
+    ats_free(a->chunks[i]);
+  ats_free(a->nodes);
+  ats_free(a->sets);
+  ats_free(a->roots);
+  ats_free(a->restarts);
+  ats_free(a->mark);
+  ats_free(a->stack);
+  ats_free(a->set);
+  ats_free(a->end_set);
+  ink_mutex_destroy(&a->lock);
+  ats_free(a);
+}
+
+// The first pattern matching, -1 for none, or DFA_TRANS_FULL if the
+// automaton ran out of states
+static int
+dfa_match_first(DFAAutomaton *a, const char *str, int length)
+{
+  int id = 0;
+  const DFAState *s = dfa_get(a, id);
+  int best = -1;
+
+  for (int i = 0;; i++) {
+    if (s->n_accepts && (best < 0 || s->accepts[0] < best))
+      best = s->accepts[0];
+    if (s->n_end_accepts && (i == length || (i == length - 1 && str[i] == '\n')) &&
+        (best < 0 || s->end_accepts[0] < best))
+      best = s->end_accepts[0];
+    // done once no pattern before the best match can still match
+    if (i == length || (best >= 0 && (s->live_min < 0 || s->live_min >= best)))
+      break;
+    id = dfa_next(a, id, s, str[i]);
+    if (id < 0)
+      return id == DFA_TRANS_FULL ? DFA_TRANS_FULL : best;
+    s = dfa_get(a, id);
+  }
+  return best;
+}
+
+// Sets matched[] for every pattern matching, returns false if the
+// automaton ran out of states
+static bool
+dfa_match_all(DFAAutomaton *a, const char *str, int length, char *matched)
+{
+  int id = 0;
+  const DFAState *s = dfa_get(a, id);
+
+  for (int i = 0;; i++) {
+    for (int k = 0; k < s->n_accepts; k++)
+      matched[s->accepts[k]] = 1;
+    if (i == length || (i == length - 1 && str[i] == '\n')) {
+      for (int k = 0; k < s->n_end_accepts; k++)
+        matched[s->end_accepts[k]] = 1;
+    }
+    if (i == length)
+      break;
+    id = dfa_next(a, id, s, str[i]);
+    if (id < 0)
+      return id != DFA_TRANS_FULL;
+    s = dfa_get(a, id);
+  }
+  return true;
+}
+
+//-------------------------------------------------------------------------
+// DFA
+//-------------------------------------------------------------------------
+
 DFA::~DFA()
 {
   dfa_pattern * p = _my_patterns;
@@ -40,6 +986,8 @@ DFA::~DFA()
     ats_free(p);
     p = t;
   } 
+  if (_automaton)
+    dfa_automaton_destroy(_automaton);
 }
 
 dfa_pattern *
@@ -47,15 +995,16 @@ DFA::build(const char *pattern, REFlags flags)
 {
   const char *error;
   int erroffset;
+  int options = (flags & RE_UNANCHORED) ? 0 : PCRE_ANCHORED;
   dfa_pattern* ret;
   
   ret = (dfa_pattern*)ats_malloc(sizeof(dfa_pattern));
   ret->_p = NULL;
   
   if (flags & RE_CASE_INSENSITIVE)
-    ret->_re = pcre_compile(pattern, PCRE_CASELESS|PCRE_ANCHORED, &error, &erroffset, NULL);
+    ret->_re = pcre_compile(pattern, PCRE_CASELESS|options, &error, &erroffset, NULL);
   else 
-    ret->_re = pcre_compile(pattern, PCRE_ANCHORED, &error, &erroffset, NULL);
+    ret->_re = pcre_compile(pattern, options, &error, &erroffset, NULL);
   
   if (error) {
     ats_free(ret);
@@ -71,17 +1020,13 @@ DFA::build(const char *pattern, REFlags flags)
   
   ret->_idx = 0;
   ret->_p = ats_strndup(pattern, strlen(pattern));
+  ret->_in_automaton = false;
   ret->_next = NULL;
   return ret;
 }
 
 int DFA::compile(const char *pattern, REFlags flags) {
-  ink_assert(_my_patterns == NULL);
-  _my_patterns = build(pattern,flags);
-  if (_my_patterns) 
-    return 0;
-  else 
-    return -1;
+  return compile(&pattern, 1, flags) == 0 && _my_patterns ? 0 : -1;
 }
 
 int
@@ -93,6 +1038,7 @@ DFA::compile(const char **patterns, int npatterns, REFlags flags)
   int i;
   //char buf[128];
   
+  ink_assert(_my_patterns == NULL);
   for (i = 0; i < npatterns; i++) {
     pattern = patterns[i];
     //snprintf(buf,128,"%s",pattern);
@@ -107,19 +1053,45 @@ DFA::compile(const char **patterns, int npatterns, REFlags flags)
       _my_patterns->_idx = i;
     }
     else { 
-      end = _my_patterns;
-      while( end->_next ) {
-        end = end->_next;
-      }
       end->_next = ret; //add to end
       ret->_idx = i;
     }
-    
+    end = ret;
+  }
+  _npatterns = npatterns;
+
+  // Everything pcre took that the automaton can do goes in the automaton
+  DFAAutomaton *a = dfa_automaton_create();
+  bool any = false;
+
+  for (dfa_pattern *p = _my_patterns; p; p = p->_next) {
+    p->_in_automaton = dfa_add_pattern(a, p->_p, p->_idx, flags);
+    any = any || p->_in_automaton;
+  }
+  if (any) {
+    dfa_automaton_finish(a);
+    _automaton = a;
+  } else {
+    dfa_automaton_destroy(a);
   }
   
   return 0;
 }
 
+// The first pattern matching with pcre_exec() which is before below (when
+// it is not -1), skipping those in the automaton unless automaton_too
+int
+DFA::match_pcre(const char *str, int length, int below, bool automaton_too) const
+{
+  for (dfa_pattern *p = _my_patterns; p && (below < 0 || p->_idx < below); p = p->_next) {
+    if (p->_in_automaton && !automaton_too)
+      continue;
+    if (pcre_exec(p->_re, p->_pe, str, length, 0, 0, NULL, 0) >= 0)
+      return p->_idx;
+  }
+  return -1;
+}
+
 int
 DFA::match(const char *str) const
 {
@@ -129,19 +1101,38 @@ DFA::match(const char *str) const
 int
 DFA::match(const char *str, int length) const
 {
-  int rc;
-  int ovector[30];
-  //int wspace[20];
-  dfa_pattern * p = _my_patterns;
-  
-  while(p) {
-    rc = pcre_exec(p->_re, p->_pe, str, length , 0, 0, ovector, 30/*,wspace,20*/);
-    if (rc > 0) {
-      return p->_idx;
-    }
-    p = p->_next;
+  int best = -1;
+
+  if (_automaton) {
+    best = dfa_match_first(_automaton, str, length);
+    if (best == DFA_TRANS_FULL)
+      return match_pcre(str, length, -1, true);
   }
 
-  return -1;
+  // patterns left to pcre which come before the automaton's match
+  int rc = match_pcre(str, length, best, false);
+
+  return rc >= 0 ? rc : best;
 }
 
+int
+DFA::match_all(const char *str, int length, char *matched) const
+{
+  bool full = false;
+  int n = 0;
+
+  memset(matched, 0, _npatterns);
+  if (_automaton && !dfa_match_all(_automaton, str, length, matched)) {
+    memset(matched, 0, _npatterns);
+    full = true;
+  }
+  for (dfa_pattern *p = _my_patterns; p; p = p->_next) {
+    if (p->_in_automaton && !full)
+      continue;
+    if (pcre_exec(p->_re, p->_pe, str, length, 0, 0, NULL, 0) >= 0)
+      matched[p->_idx] = 1;
+  }
+  for (int i = 0; i < _npatterns; i++)
+    n += matched[i];
+  return n;
+}
@@ -33,7 +33,8 @@
 
 enum REFlags
 {
-  RE_CASE_INSENSITIVE = 1
+  RE_CASE_INSENSITIVE = 1,
+  RE_UNANCHORED = 2             // match anywhere in the string, like pcre_compile() without PCRE_ANCHORED
 };
 
 typedef struct __pat {
@@ -41,13 +42,28 @@ typedef struct __pat {
   pcre *_re;
   pcre_extra *_pe;
   char *_p;
+  bool _in_automaton;           // matched by the automaton rather than pcre_exec()
   __pat * _next;
 } dfa_pattern;
 
+struct DFAAutomaton;
+
+/**
+  A set of regular expressions matched in one pass.
+
+  The patterns are compiled together into a single automaton whose states
+  are built lazily, on the first match that needs them, so a match costs one
+  table lookup per byte no matter how many patterns there are.  Patterns
+  using pcre features the automaton does not do (back references, look
+  arounds, \b and the like) are still run with pcre_exec().
+
+  match() returns the index of the first pattern in compile order that
+  matches, as the pcre loop it replaces did, or -1.
+*/
 class DFA
 {
 public:
-  DFA():_my_patterns(0) {
+  DFA():_my_patterns(0), _automaton(0), _npatterns(0) {
   }
   
   ~DFA();
@@ -59,8 +75,16 @@ public:
   int match(const char *str) const;
   int match(const char *str, int length) const;
 
+  // Sets matched[i] for every pattern i that matches and returns how many
+  //  did. matched has room for one entry per pattern given to compile().
+  int match_all(const char *str, int length, char *matched) const;
+
 private:
+  int match_pcre(const char *str, int length, int below, bool automaton_too) const;
+
   dfa_pattern * _my_patterns;
+  DFAAutomaton * _automaton;
+  int _npatterns;
 };
 
 
@@ -199,6 +199,18 @@ rperf(RegressionTest *t, const char *tag, double val)
   return (l);
 }
 
+int
+rbench(RegressionTest *t, const char *tag, int threads, int64_t ops, ink_hrtime elapsed)
+{
+  double ns = (double) elapsed / HRTIME_NSECOND;
+  // time per operation on one thread, and the rate of all threads together
+  int l = printf("{\"bench\": \"%s\", \"case\": \"%s\", \"threads\": %d, \"ops\": %" PRId64 ", "
+                 "\"ns_per_op\": %.1f, \"ops_per_sec\": %.0f}\n",
+                 t->name, tag, threads, ops, ops ? ns * threads / ops : 0.0, ns > 0 ? ops * 1e9 / ns : 0.0);
+  fflush(stdout);
+  return (l);
+}
+
 REGRESSION_TEST(Regression) (RegressionTest * t, int atype, int *status) {
   (void) t;
   (void) atype;
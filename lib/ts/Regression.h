@@ -42,6 +42,12 @@
 //     } else
 //       *pstatus = REGRESSION_TEST_PASSED;
 //   }
+//
+//   Benchmarks are regression tests named Bench_<subject> which only run
+//   at REGRESSION_TEST_EXTENDED, "make bench" runs all of them. Each
+//   result is reported with rbench() as one JSON object on a line of
+//   stdout, with the keys always in the same order, so that runs can be
+//   compared by a script.
 
 
 // status values
@@ -97,6 +103,7 @@ void RegressionTest_##_f
 
 int rprintf(RegressionTest * t, const char *format, ...);
 int rperf(RegressionTest *t, const char *tag, double val);
+int rbench(RegressionTest *t, const char *tag, int threads, int64_t ops, ink_hrtime elapsed);
 char *regression_status_string(int status);
 
 extern int regression_level;
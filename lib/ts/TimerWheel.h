@@ -0,0 +1,192 @@
+/** @file
+
+  A hierarchical timer wheel.
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+/****************************************************************************
+
+  TimerWheel.h
+
+  Elements are kept on a list per tick, TIMER_WHEEL_LEVELS levels of
+  TIMER_WHEEL_SLOTS ticks each, every level TIMER_WHEEL_SLOTS times coarser
+  than the one below it.  Insert and remove are O(1); an element is moved
+  down a level at most TIMER_WHEEL_LEVELS - 1 times before it expires.
+  Elements further out than the wheel reaches wait on the last slot of the
+  top level and are placed again when it comes around.
+
+  L is a link class as for DLL which in addition provides
+
+    static ink_hrtime at(C *)           when the element expires
+    static int slot(C *)               the wheel's bookkeeping, which must be
+    static void set_slot(C *, int)     TIMER_WHEEL_NO_SLOT outside the wheel
+
+  The wheel is not thread safe.
+
+ ****************************************************************************/
+
+#ifndef _TimerWheel_h_
+#define _TimerWheel_h_
+
+#include "List.h"
+#include "ink_hrtime.h"
+
+#define TIMER_WHEEL_BITS        6       // the slot bitmaps are 64 bits
+#define TIMER_WHEEL_SLOTS       (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK        (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_LEVELS      4
+#define TIMER_WHEEL_NO_SLOT     (TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS)
+
+template <class C, class L> struct TimerWheel
+{
+  ink_hrtime tick;
+  int64_t next;                 // the next tick to expire
+  int count;
+  uint64_t used[TIMER_WHEEL_LEVELS];    // which slots have elements
+  DLL<C, L> slots[TIMER_WHEEL_NO_SLOT];
+
+  void init(ink_hrtime atick, ink_hrtime now);
+  void insert(C *c);
+  void remove(C *c);
+  // move everything which is due at 'now' onto 'expired'
+  void expire(ink_hrtime now, Queue<C, L> &expired);
+  // no element expires before this, 0 if the wheel is empty
+  ink_hrtime earliest();
+  bool empty() const { return !count; }
+
+  TimerWheel():tick(1), next(0), count(0) { memset(used, 0, sizeof(used)); }
+
+private:
+  void place(C *c);
+  void cascade(int level, int index);
+};
+
+template <class C, class L> inline void
+TimerWheel<C, L>::init(ink_hrtime atick, ink_hrtime now)
+{
+  ink_assert(!count);
+  tick = atick;
+  next = now / tick;
+}
+
+template <class C, class L> inline void
+TimerWheel<C, L>::place(C *c)
+{
+  const int64_t reach = (int64_t)1 << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS);
+  int64_t t = L::at(c) / tick;
+  if (t < next)
+    t = next;
+  else if (t - next >= reach)
+    t = next + reach - 1;
+  int level = 0;
+  while (level < TIMER_WHEEL_LEVELS - 1 && t - next >= ((int64_t)1 << (TIMER_WHEEL_BITS * (level + 1))))
+    level++;
+  int index = (int)(t >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+  int s = level * TIMER_WHEEL_SLOTS + index;
+  slots[s].push(c);
+  used[level] |= (uint64_t)1 << index;
+  L::set_slot(c, s);
+}
+
+template <class C, class L> inline void
+TimerWheel<C, L>::insert(C *c)
+{
+  ink_assert(L::slot(c) == TIMER_WHEEL_NO_SLOT);
+  place(c);
+  count++;
+}
+
+template <class C, class L> inline void
+TimerWheel<C, L>::remove(C *c)
+{
+  int s = L::slot(c);
+  ink_assert(s != TIMER_WHEEL_NO_SLOT);
+  slots[s].remove(c);
+  if (slots[s].empty())
+    used[s / TIMER_WHEEL_SLOTS] &= ~((uint64_t)1 << (s & TIMER_WHEEL_MASK));
+  L::set_slot(c, TIMER_WHEEL_NO_SLOT);
+  count--;
+}
+
+template <class C, class L> inline void
+TimerWheel<C, L>::cascade(int level, int index)
+{
+  DLL<C, L> l = slots[level * TIMER_WHEEL_SLOTS + index];
+  slots[level * TIMER_WHEEL_SLOTS + index].clear();
+  used[level] &= ~((uint64_t)1 << index);
+  while (C *c = l.pop())
+    place(c);
+}
+
+template <class C, class L> void
+TimerWheel<C, L>::expire(ink_hrtime now, Queue<C, L> &expired)
+{
+  int64_t target = now / tick;
+  while (next <= target) {
+    if (!count) {
+      next = target + 1;
+      break;
+    }
+    int index = (int)(next & TIMER_WHEEL_MASK);
+    if (!index) {
+      // the finest level wrapped, pull down the next slot of the coarser ones
+      for (int level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+        int i = (int)(next >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+        cascade(level, i);
+        if (i)
+          break;
+      }
+    } else if (!used[0]) {
+      // nothing until the next cascade, skip ahead
+      int64_t skip = (next | TIMER_WHEEL_MASK) + 1;
+      next = skip < target + 1 ? skip : target + 1;
+      continue;
+    }
+    DLL<C, L> &l = slots[index];
+    while (C *c = l.pop()) {
+      L::set_slot(c, TIMER_WHEEL_NO_SLOT);
+      count--;
+      expired.enqueue(c);
+    }
+    used[0] &= ~((uint64_t)1 << index);
+    next++;
+  }
+}
+
+template <class C, class L> ink_hrtime
+TimerWheel<C, L>::earliest()
+{
+  if (!count)
+    return 0;
+  // anything on the coarser levels comes down at the next cascade at the
+  // earliest, the finest level holds exactly the next TIMER_WHEEL_SLOTS ticks
+  int64_t t = (next + TIMER_WHEEL_MASK) & ~(int64_t)TIMER_WHEEL_MASK;
+  if (used[0]) {
+    int index = (int)(next & TIMER_WHEEL_MASK);
+    uint64_t r = used[0] >> index;
+    if (index)
+      r |= used[0] << (TIMER_WHEEL_SLOTS - index);
+    if (next + __builtin_ctzll(r) < t)
+      t = next + __builtin_ctzll(r);
+  }
+  return t * tick;
+}
+
+#endif /* _TimerWheel_h_ */
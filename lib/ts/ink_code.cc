@@ -51,6 +51,170 @@ ink_code_incr_md5_final(char *sixteen_byte_hash_pointer, INK_DIGEST_CTX * contex
   return MD5_Final((unsigned char*)sixteen_byte_hash_pointer, context);
 }
 
+/*
+  MurmurHash3 x64 128 by Austin Appleby, public domain. Blocks are
+  read little endian so that keys are the same on every host.
+*/
+#define MMH3_C1 0x87c37b91114253d5ULL
+#define MMH3_C2 0x4cf5ad432745937fULL
+
+static inline uint64_t
+mmh3_rotl64(uint64_t x, int r)
+{
+  return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t
+mmh3_fmix64(uint64_t k)
+{
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdULL;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53ULL;
+  k ^= k >> 33;
+  return k;
+}
+
+static inline uint64_t
+mmh3_load64(const unsigned char *p)
+{
+  uint64_t x;
+  memcpy(&x, p, sizeof(x));
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+  x = __builtin_bswap64(x);
+#endif
+  return x;
+}
+
+static inline void
+mmh3_block(INK_MMH3_CTX * context, const unsigned char *block)
+{
+  uint64_t k1 = mmh3_load64(block);
+  uint64_t k2 = mmh3_load64(block + 8);
+
+  k1 *= MMH3_C1;
+  k1 = mmh3_rotl64(k1, 31);
+  k1 *= MMH3_C2;
+  context->h1 ^= k1;
+  context->h1 = mmh3_rotl64(context->h1, 27);
+  context->h1 += context->h2;
+  context->h1 = context->h1 * 5 + 0x52dce729;
+
+  k2 *= MMH3_C2;
+  k2 = mmh3_rotl64(k2, 33);
+  k2 *= MMH3_C1;
+  context->h2 ^= k2;
+  context->h2 = mmh3_rotl64(context->h2, 31);
+  context->h2 += context->h1;
+  context->h2 = context->h2 * 5 + 0x38495ab5;
+}
+
+/**
+  @brief Start an incremental MurmurHash3 x64 128, seed 0
+*/
+int
+ink_code_incr_mmh3_init(INK_MMH3_CTX * context) {
+  context->h1 = context->h2 = 0;
+  context->length = 0;
+  context->tail_length = 0;
+  return 1;
+}
+
+int
+ink_code_incr_mmh3_update(INK_MMH3_CTX * context, const char *input, int input_length) {
+  const unsigned char *p = (const unsigned char *) input;
+  const unsigned char *e = p + input_length;
+
+  context->length += input_length;
+  if (context->tail_length) {
+    int n = 16 - context->tail_length;
+    if (n > input_length)
+      n = input_length;
+    memcpy(context->tail + context->tail_length, p, n);
+    context->tail_length += n;
+    p += n;
+    if (context->tail_length < 16)
+      return 1;
+    mmh3_block(context, context->tail);
+    context->tail_length = 0;
+  }
+  for (; e - p >= 16; p += 16)
+    mmh3_block(context, p);
+  if (p < e) {
+    memcpy(context->tail, p, e - p);
+    context->tail_length = e - p;
+  }
+  return 1;
+}
+
+int
+ink_code_incr_mmh3_final(char *sixteen_byte_hash_pointer, INK_MMH3_CTX * context) {
+  uint64_t h1 = context->h1, h2 = context->h2;
+  uint64_t k1 = 0, k2 = 0;
+  const unsigned char *tail = context->tail;
+  unsigned char *out = (unsigned char *) sixteen_byte_hash_pointer;
+  int i;
+
+  for (i = context->tail_length - 1; i >= 8; i--)
+    k2 = (k2 << 8) | tail[i];
+  if (context->tail_length > 8) {
+    k2 *= MMH3_C2;
+    k2 = mmh3_rotl64(k2, 33);
+    k2 *= MMH3_C1;
+    h2 ^= k2;
+  }
+  for (i = (context->tail_length < 8 ? context->tail_length : 8) - 1; i >= 0; i--)
+    k1 = (k1 << 8) | tail[i];
+  if (context->tail_length > 0) {
+    k1 *= MMH3_C1;
+    k1 = mmh3_rotl64(k1, 31);
+    k1 *= MMH3_C2;
+    h1 ^= k1;
+  }
+
+  h1 ^= context->length;
+  h2 ^= context->length;
+  h1 += h2;
+  h2 += h1;
+  h1 = mmh3_fmix64(h1);
+  h2 = mmh3_fmix64(h2);
+  h1 += h2;
+  h2 += h1;
+
+  for (i = 0; i < 8; i++) {
+    out[i] = (unsigned char) (h1 >> (i * 8));
+    out[i + 8] = (unsigned char) (h2 >> (i * 8));
+  }
+  return 1;
+}
+
+int ink_code_key_hash = INK_KEY_HASH_MD5;
+
+/**
+  @brief Start a key hash with the method selected by ink_code_key_hash
+*/
+int
+ink_code_incr_key_init(INK_KEY_CTX * context) {
+  context->method = ink_code_key_hash;
+  if (context->method == INK_KEY_HASH_MMH3)
+    return ink_code_incr_mmh3_init(&context->u.mmh3);
+  return ink_code_incr_md5_init(&context->u.md5);
+}
+
+int
+ink_code_incr_key_update(INK_KEY_CTX * context, const char *input, int input_length) {
+  if (context->method == INK_KEY_HASH_MMH3)
+    return ink_code_incr_mmh3_update(&context->u.mmh3, input, input_length);
+  return ink_code_incr_md5_update(&context->u.md5, input, input_length);
+}
+
+int
+ink_code_incr_key_final(char *sixteen_byte_hash_pointer, INK_KEY_CTX * context) {
+  if (context->method == INK_KEY_HASH_MMH3)
+    return ink_code_incr_mmh3_final(sixteen_byte_hash_pointer, &context->u.mmh3);
+  return ink_code_incr_md5_final(sixteen_byte_hash_pointer, &context->u.md5);
+}
+
 /**
   @brief Helper that will init, update, and create a final MD5
 
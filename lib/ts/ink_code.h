@@ -25,11 +25,42 @@
 #define	_ink_code_h_
 
 #include "ink_apidefs.h"
+#include <stdint.h>
 #include <openssl/md5.h>
 
 /* INK_MD5 context. */
 typedef MD5_CTX INK_DIGEST_CTX;
 
+/* MurmurHash3 x64 128 bit context. */
+typedef struct
+{
+  uint64_t h1, h2;
+  uint64_t length;
+  unsigned char tail[16];
+  int tail_length;
+} INK_MMH3_CTX;
+
+/*
+  Hash for cache and HostDB keys. MD5 is the default, MurmurHash3 is
+  much faster but changes every key, so it is fixed at startup and
+  recorded in the cache directory.
+*/
+#define INK_KEY_HASH_MD5  0
+#define INK_KEY_HASH_MMH3 1
+
+extern inkcoreapi int ink_code_key_hash;
+
+/* Context for the key hash selected by ink_code_key_hash. */
+typedef struct
+{
+  int method;
+  union
+  {
+    INK_DIGEST_CTX md5;
+    INK_MMH3_CTX mmh3;
+  } u;
+} INK_KEY_CTX;
+
 /*
   Wrappers around the MD5 functions, all of this should be depericated and just use the functions directly
 */
@@ -41,4 +72,12 @@ inkcoreapi char *ink_code_md5_stringify_fast(char *dest33, const char *md5);
 inkcoreapi int ink_code_incr_md5_init(INK_DIGEST_CTX * context);
 inkcoreapi int ink_code_incr_md5_update(INK_DIGEST_CTX * context, const char *input, int input_length);
 inkcoreapi int ink_code_incr_md5_final(char *sixteen_byte_hash_pointer, INK_DIGEST_CTX * context);
+
+inkcoreapi int ink_code_incr_mmh3_init(INK_MMH3_CTX * context);
+inkcoreapi int ink_code_incr_mmh3_update(INK_MMH3_CTX * context, const char *input, int input_length);
+inkcoreapi int ink_code_incr_mmh3_final(char *sixteen_byte_hash_pointer, INK_MMH3_CTX * context);
+
+inkcoreapi int ink_code_incr_key_init(INK_KEY_CTX * context);
+inkcoreapi int ink_code_incr_key_update(INK_KEY_CTX * context, const char *input, int input_length);
+inkcoreapi int ink_code_incr_key_final(char *sixteen_byte_hash_pointer, INK_KEY_CTX * context);
 #endif
@@ -148,3 +148,49 @@ ink_number_of_processors()
 
 #endif
 }
+
+int
+ink_numa_nodes()
+{
+#if TS_USE_HWLOC
+  int n = hwloc_get_nbobjs_by_type(ink_get_topology(), HWLOC_OBJ_NODE);
+  return n > 0 ? n : 1;
+#else
+  return 1;
+#endif
+}
+
+// Run the calling thread on the processors of a node and take its new
+// pages from the node's memory, both as far as the OS lets us.
+int
+ink_numa_bind_this_thread(int node)
+{
+#if TS_USE_HWLOC
+  hwloc_obj_t obj = hwloc_get_obj_by_type(ink_get_topology(), HWLOC_OBJ_NODE, node);
+  if (!obj)
+    return 0;
+  if (hwloc_set_cpubind(ink_get_topology(), obj->cpuset, HWLOC_CPUBIND_THREAD) != 0)
+    return 0;
+  return hwloc_set_membind(ink_get_topology(), obj->cpuset, HWLOC_MEMBIND_BIND, HWLOC_MEMBIND_THREAD) == 0;
+#else
+  (void)node;
+  return 0;
+#endif
+}
+
+// Place [addr, addr + len) in the memory of a node, moving what is already resident.
+int
+ink_numa_bind_area(const void *addr, size_t len, int node)
+{
+#if TS_USE_HWLOC
+  hwloc_obj_t obj = hwloc_get_obj_by_type(ink_get_topology(), HWLOC_OBJ_NODE, node);
+  if (!obj)
+    return 0;
+  return hwloc_set_area_membind(ink_get_topology(), addr, len, obj->cpuset, HWLOC_MEMBIND_BIND, HWLOC_MEMBIND_MIGRATE) == 0;
+#else
+  (void)addr;
+  (void)len;
+  (void)node;
+  return 0;
+#endif
+}
@@ -176,6 +176,12 @@ int ink_number_of_processors();
 hwloc_topology_t ink_get_topology();
 #endif
 
+// NUMA nodes as hwloc sees them. Without hwloc there is a single node and
+// the binding calls, which return non zero on success, always fail.
+int ink_numa_nodes();
+int ink_numa_bind_this_thread(int node);
+int ink_numa_bind_area(const void *addr, size_t len, int node);
+
 /** Constants.
  */
 #ifdef __cplusplus
@@ -0,0 +1,46 @@
+/** @file
+
+  Layout of the event thread heartbeat file shared by traffic_server and traffic_cop.
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#ifndef __INK_HEARTBEAT_H__
+#define __INK_HEARTBEAT_H__
+
+#include "ink_defs.h"
+
+// traffic_server maps this file from the runtime directory and every
+// event thread bumps its counter each time around its event loop, which
+// is at least every 60ms even when idle. traffic_cop reads the counters
+// to tell a hung thread from a busy one without sending it requests.
+#define SERVER_HEARTBEAT          "server.heartbeat"
+#define HEARTBEAT_MAGIC           0x48425431 // "HBT1"
+#define HEARTBEAT_MAX_THREADS     4096
+
+struct HeartbeatSegment
+{
+  uint32_t magic;               // set last, once the rest is filled in
+  int32_t pid;                  // of the traffic_server bumping the counters
+  int32_t nthreads;
+  int32_t reserved;
+  volatile uint64_t beats[HEARTBEAT_MAX_THREADS];
+};
+
+#endif /* __INK_HEARTBEAT_H__ */
@@ -219,3 +219,77 @@ ats_mlock(caddr_t addr, size_t len)
   int res = mlock(a, l);
   return res;
 }
+
+static size_t hugepage_size = 0; // 0 while huge pages are off
+
+volatile int64_t ats_hugepage_allocated = 0;
+volatile int64_t ats_hugepage_fallback = 0;
+
+void
+ats_hugepage_init(int enabled)
+{
+#if defined(MAP_HUGETLB)
+  char line[256];
+  FILE *fp;
+
+  hugepage_size = 0;
+  if (!enabled || !(fp = fopen("/proc/meminfo", "r")))
+    return;
+  // MAP_HUGETLB maps pages of the default size, which is the one reported here
+  while (fgets(line, sizeof(line), fp)) {
+    unsigned long kb;
+    if (sscanf(line, "Hugepagesize: %lu kB", &kb) == 1) {
+      hugepage_size = (size_t)kb * 1024;
+      break;
+    }
+  }
+  fclose(fp);
+#else
+  (void) enabled;
+#endif
+}
+
+int
+ats_hugepage_enabled(void)
+{
+  return hugepage_size != 0;
+}
+
+size_t
+ats_hugepage_size(void)
+{
+  return hugepage_size;
+}
+
+void *
+ats_alloc_hugepage(size_t size)
+{
+#if defined(MAP_HUGETLB)
+  if (!hugepage_size)
+    return NULL;
+  size_t len = INK_ALIGN(size, hugepage_size);
+  void *ptr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (ptr == MAP_FAILED) {
+    ink_atomic_increment(&ats_hugepage_fallback, (int64_t)size);
+    return NULL;
+  }
+  ink_atomic_increment(&ats_hugepage_allocated, (int64_t)len);
+  return ptr;
+#else
+  (void) size;
+  return NULL;
+#endif
+}
+
+void
+ats_free_hugepage(void *ptr, size_t size)
+{
+#if defined(MAP_HUGETLB)
+  size_t len = INK_ALIGN(size, hugepage_size);
+  if (munmap(ptr, len) == 0)
+    ink_atomic_increment(&ats_hugepage_allocated, -(int64_t)len);
+#else
+  (void) ptr;
+  (void) size;
+#endif
+}
@@ -88,6 +88,19 @@ extern "C" {
   int     ats_madvise(caddr_t addr, size_t len, int flags);
   int     ats_mlock(caddr_t addr, size_t len);
 
+  /* Explicit huge pages of the kernel's default huge page size, off until
+     ats_hugepage_init(1). ats_alloc_hugepage() rounds the size up to whole
+     huge pages and returns NULL when huge pages are off or the kernel has
+     none left, the caller then falls back to ordinary memory. */
+  void    ats_hugepage_init(int enabled);
+  int     ats_hugepage_enabled(void);
+  size_t  ats_hugepage_size(void);
+  void *  ats_alloc_hugepage(size_t size);
+  void    ats_free_hugepage(void *ptr, size_t size);
+
+  extern volatile int64_t ats_hugepage_allocated;  /* bytes on huge pages */
+  extern volatile int64_t ats_hugepage_fallback;   /* bytes requested but not obtained */
+
   static inline size_t __attribute__((const)) ats_pagesize(void)
   {
     static size_t page_size;
@@ -106,6 +106,9 @@
 #ifdef HAVE_WAIT_H
 # include <wait.h>
 #endif
+#ifdef HAVE_SYS_SENDFILE_H
+# include <sys/sendfile.h>
+#endif
 
 #include <syslog.h>
 #include <pwd.h>
@@ -46,6 +46,7 @@
 #include "ink_atomic.h"
 #include "ink_queue.h"
 #include "ink_memory.h"
+#include "ink_align.h"
 #include "ink_error.h"
 #include "ink_assert.h"
 #include "ink_resource.h"
@@ -77,15 +78,54 @@ static const int page_size = ats_pagesize();
 ink_freelist_list *freelists = NULL;
 
 inkcoreapi volatile int64_t freelist_allocated_mem = 0;
+inkcoreapi volatile int64_t freelist_reclaimed_mem = 0;
+inkcoreapi volatile int64_t freelist_reclaimed_mem_total = 0;
 
 #define fl_memadd(_x_) \
    ink_atomic_increment(&freelist_allocated_mem, (int64_t) (_x_));
 
+int ink_freelist_magazine_size = 0;
+
+#if TS_USE_FREELIST && !TS_USE_RECLAIMABLE_FREELIST
+/*
+ * A magazine holds up to INK_FREELIST_MAGAZINE_MAX free items of one
+ * freelist. Each thread keeps a loaded and a previous magazine per
+ * freelist (Bonwick's magazine layer), only when both are exhausted
+ * does it exchange a whole magazine with the freelist's depot.
+ * Magazines are never freed, which keeps the versioned depot stacks
+ * safe in the same way as the freelist itself.
+ */
+#define MAX_NUM_MAGAZINE_FREELIST  1024
+// bound the memory a thread caches for the large types
+#define MAGAZINE_BYTE_SIZE         (256 * 1024)
+
+typedef struct _InkFreeListMagazine
+{
+  struct _InkFreeListMagazine *next;
+  uint32_t rounds;
+  void *round[INK_FREELIST_MAGAZINE_MAX];
+} InkFreeListMagazine;
+
+typedef struct
+{
+  InkFreeListMagazine *loaded;
+  InkFreeListMagazine *previous;
+  uint32_t size;
+} InkThreadMagazines;
+
+static __thread InkThreadMagazines *ThreadMagazines[MAX_NUM_MAGAZINE_FREELIST];
+#endif
+
+#if !TS_USE_RECLAIMABLE_FREELIST
+static int nr_magazine_freelist = 0;
+#endif
+
 void
 ink_freelist_init(InkFreeList **fl, const char *name, uint32_t type_size,
-                  uint32_t chunk_size, uint32_t alignment)
+                  uint32_t chunk_size, uint32_t alignment, int use_hugepages)
 {
 #if TS_USE_RECLAIMABLE_FREELIST
+  (void) use_hugepages;
   return reclaimable_freelist_init(fl, name, type_size, chunk_size, alignment);
 #else
   InkFreeList *f;
@@ -105,7 +145,19 @@ ink_freelist_init(InkFreeList **fl, const char *name, uint32_t type_size,
   f->alignment = alignment;
   f->chunk_size = chunk_size;
   f->type_size = type_size;
+  // a chunk smaller than a huge page would waste most of it, a larger one
+  // is grown to fill its last huge page
+  f->use_hugepages = use_hugepages && ats_hugepage_enabled() &&
+    (size_t)chunk_size * type_size >= ats_hugepage_size();
+  if (f->use_hugepages)
+    f->chunk_size = INK_ALIGN((size_t)chunk_size * type_size, ats_hugepage_size()) / type_size;
   SET_FREELIST_POINTER_VERSION(f->head, FROM_PTR(0), 0);
+  SET_FREELIST_POINTER_VERSION(f->magazine_full, FROM_PTR(0), 0);
+  SET_FREELIST_POINTER_VERSION(f->magazine_empty, FROM_PTR(0), 0);
+  SET_FREELIST_POINTER_VERSION(f->reclaimed, FROM_PTR(0), 0);
+  f->reclaimed_count = 0;
+  f->reclaim_hwm = 0;
+  f->magazine_idx = ink_atomic_increment(&nr_magazine_freelist, 1);
 
   f->count = 0;
   f->allocated = 0;
@@ -121,7 +173,7 @@ ink_freelist_create(const char *name, uint32_t type_size, uint32_t chunk_size,
 {
   InkFreeList *f;
 
-  ink_freelist_init(&f, name, type_size, chunk_size, alignment);
+  ink_freelist_init(&f, name, type_size, chunk_size, alignment, 0);
   return f;
 }
 
@@ -132,13 +184,16 @@ int fake_global_for_ink_queue = 0;
 #endif
 
 int fastmemtotal = 0;
-void *
-ink_freelist_new(InkFreeList * f)
+typedef volatile void *volatile_void_p;
+
+#if TS_USE_FREELIST && !TS_USE_RECLAIMABLE_FREELIST
+static void freelist_free(InkFreeList * f, void *item);
+static void *stack_pop(volatile head_p * list);
+static void reclaim_range(InkFreeList * f, void *item, char **start, char **end);
+
+static void *
+freelist_new(InkFreeList * f)
 {
-#if TS_USE_FREELIST
-#if TS_USE_RECLAIMABLE_FREELIST
-  return reclaimable_freelist_new(f);
-#else
   head_p item;
   head_p next;
   int result = 0;
@@ -149,6 +204,21 @@ ink_freelist_new(InkFreeList * f)
       uint32_t type_size = f->type_size;
       uint32_t i;
 
+      // reuse the items given back to the OS before growing
+      if (f->reclaimed_count) {
+        void *r = stack_pop(&f->reclaimed);
+        if (r) {
+          char *start, *end;
+
+          reclaim_range(f, r, &start, &end);
+          ink_atomic_increment((int *) &f->reclaimed_count, -1);
+          ink_atomic_increment(&freelist_reclaimed_mem, -(int64_t) (end - start));
+          ink_atomic_increment((int *) &f->count, 1);
+          ink_atomic_increment(&fastalloc_mem_in_use, (int64_t) f->type_size);
+          return r;
+        }
+      }
+
 #ifdef MEMPROTECT
       if (type_size >= MEMPROTECT_SIZE) {
         if (f->alignment < page_size)
@@ -161,10 +231,14 @@ ink_freelist_new(InkFreeList * f)
 #ifdef DEBUG
       char *oldsbrk = (char *) sbrk(0), *newsbrk = NULL;
 #endif
-      if (f->alignment)
-        newp = ats_memalign(f->alignment, f->chunk_size * type_size);
-      else
-        newp = ats_malloc(f->chunk_size * type_size);
+      if (f->use_hugepages)
+        newp = ats_alloc_hugepage(f->chunk_size * type_size);
+      if (!newp) {
+        if (f->alignment)
+          newp = ats_memalign(f->alignment, f->chunk_size * type_size);
+        else
+          newp = ats_malloc(f->chunk_size * type_size);
+      }
       fl_memadd(f->chunk_size * type_size);
 #ifdef DEBUG
       newsbrk = (char *) sbrk(0);
@@ -185,7 +259,7 @@ ink_freelist_new(InkFreeList * f)
         for (int j = 0; j < (int)type_size; j++)
           a[j] = str[j % 4];
 #endif
-        ink_freelist_free(f, a);
+        freelist_free(f, a);
 #ifdef MEMPROTECT
         if (f->type_size >= MEMPROTECT_SIZE) {
           a += type_size - page_size;
@@ -227,26 +301,11 @@ ink_freelist_new(InkFreeList * f)
   ink_atomic_increment(&fastalloc_mem_in_use, (int64_t) f->type_size);
 
   return TO_PTR(FREELIST_POINTER(item));
-#endif /* TS_USE_RECLAIMABLE_FREELIST */
-#else // ! TS_USE_FREELIST
-  void *newp = NULL;
-
-  if (f->alignment)
-    newp = ats_memalign(f->alignment, f->chunk_size * f->type_size);
-  else
-    newp = ats_malloc(f->chunk_size * f->type_size);
-  return newp;
-#endif
 }
-typedef volatile void *volatile_void_p;
 
-void
-ink_freelist_free(InkFreeList * f, void *item)
+static void
+freelist_free(InkFreeList * f, void *item)
 {
-#if TS_USE_FREELIST
-#if TS_USE_RECLAIMABLE_FREELIST
-  return reclaimable_freelist_free(f, item);
-#else
   volatile_void_p *adr_of_next = (volatile_void_p *) ADDRESS_OF_NEXT(item, 0);
   head_p h;
   head_p item_pair;
@@ -289,6 +348,176 @@ ink_freelist_free(InkFreeList * f, void *item)
 
   ink_atomic_increment((int *) &f->count, -1);
   ink_atomic_increment(&fastalloc_mem_in_use, -(int64_t) f->type_size);
+}
+
+// versioned stack of objects linked through their first word
+static void
+stack_push(volatile head_p * list, void *item)
+{
+  head_p h;
+  head_p item_pair;
+  int result;
+
+  do {
+    INK_QUEUE_LD(h, *list);
+    *(volatile_void_p *) item = FREELIST_POINTER(h);
+    SET_FREELIST_POINTER_VERSION(item_pair, FROM_PTR(item), FREELIST_VERSION(h));
+    INK_MEMORY_BARRIER;
+#if TS_HAS_128BIT_CAS
+    result = ink_atomic_cas((__int128_t*) & list->data, h.data, item_pair.data);
+#else
+    result = ink_atomic_cas((int64_t *) & list->data, h.data, item_pair.data);
+#endif
+  } while (result == 0);
+}
+
+static void *
+stack_pop(volatile head_p * list)
+{
+  head_p item;
+  head_p next;
+  int result;
+
+  do {
+    INK_QUEUE_LD(item, *list);
+    if (TO_PTR(FREELIST_POINTER(item)) == NULL)
+      return NULL;
+    SET_FREELIST_POINTER_VERSION(next, *ADDRESS_OF_NEXT(TO_PTR(FREELIST_POINTER(item)), 0),
+                                 FREELIST_VERSION(item) + 1);
+#if TS_HAS_128BIT_CAS
+    result = ink_atomic_cas((__int128_t*) & list->data, item.data, next.data);
+#else
+    result = ink_atomic_cas((int64_t *) & list->data, item.data, next.data);
+#endif
+  } while (result == 0);
+  return TO_PTR(FREELIST_POINTER(item));
+}
+
+static InkFreeListMagazine *
+magazine_get_empty(InkFreeList * f)
+{
+  InkFreeListMagazine *m = (InkFreeListMagazine *) stack_pop(&f->magazine_empty);
+
+  if (m == NULL)
+    m = (InkFreeListMagazine *) ats_malloc(sizeof(InkFreeListMagazine));
+  m->rounds = 0;
+  return m;
+}
+
+static inline InkThreadMagazines *
+freelist_magazines(InkFreeList * f)
+{
+  InkThreadMagazines *tm;
+  uint32_t size;
+
+  if (unlikely(f->magazine_idx >= MAX_NUM_MAGAZINE_FREELIST))
+    return NULL;
+  if (likely((tm = ThreadMagazines[f->magazine_idx]) != NULL))
+    return tm;
+
+  size = MAGAZINE_BYTE_SIZE / f->type_size;
+  if (size > (uint32_t) ink_freelist_magazine_size)
+    size = ink_freelist_magazine_size;
+  if (size > INK_FREELIST_MAGAZINE_MAX)
+    size = INK_FREELIST_MAGAZINE_MAX;
+  if (size < 2)
+    return NULL;
+
+  tm = (InkThreadMagazines *) ats_malloc(sizeof(InkThreadMagazines));
+  tm->loaded = magazine_get_empty(f);
+  tm->previous = magazine_get_empty(f);
+  tm->size = size;
+  ThreadMagazines[f->magazine_idx] = tm;
+  return tm;
+}
+
+// Items in the depot are free, those in a thread's magazines count as in use.
+static void *
+magazine_alloc(InkFreeList * f, InkThreadMagazines * tm)
+{
+  InkFreeListMagazine *m = tm->loaded;
+
+  if (m->rounds == 0) {
+    if (tm->previous->rounds != 0) {
+      tm->loaded = tm->previous;
+      tm->previous = m;
+    } else if ((m = (InkFreeListMagazine *) stack_pop(&f->magazine_full)) != NULL) {
+      stack_push(&f->magazine_empty, tm->previous);
+      tm->previous = tm->loaded;
+      tm->loaded = m;
+      ink_atomic_increment((int *) &f->count, (int) m->rounds);
+      ink_atomic_increment(&fastalloc_mem_in_use, (int64_t) m->rounds * f->type_size);
+    } else
+      return NULL;
+    m = tm->loaded;
+  }
+  return m->round[--m->rounds];
+}
+
+static void
+magazine_free(InkFreeList * f, InkThreadMagazines * tm, void *item)
+{
+  InkFreeListMagazine *m = tm->loaded;
+
+  if (m->rounds >= tm->size) {
+    if (tm->previous->rounds == 0) {
+      tm->loaded = tm->previous;
+      tm->previous = m;
+    } else {
+      InkFreeListMagazine *full = tm->previous;
+
+      ink_atomic_increment((int *) &f->count, -(int) full->rounds);
+      ink_atomic_increment(&fastalloc_mem_in_use, -(int64_t) full->rounds * f->type_size);
+      stack_push(&f->magazine_full, full);
+      tm->previous = m;
+      tm->loaded = magazine_get_empty(f);
+    }
+    m = tm->loaded;
+  }
+  m->round[m->rounds++] = item;
+}
+#endif /* TS_USE_FREELIST && !TS_USE_RECLAIMABLE_FREELIST */
+
+void *
+ink_freelist_new(InkFreeList * f)
+{
+#if TS_USE_FREELIST
+#if TS_USE_RECLAIMABLE_FREELIST
+  return reclaimable_freelist_new(f);
+#else
+  InkThreadMagazines *tm = freelist_magazines(f);
+
+  if (tm) {
+    void *item = magazine_alloc(f, tm);
+    if (item)
+      return item;
+  }
+  return freelist_new(f);
+#endif /* TS_USE_RECLAIMABLE_FREELIST */
+#else // ! TS_USE_FREELIST
+  void *newp = NULL;
+
+  if (f->alignment)
+    newp = ats_memalign(f->alignment, f->chunk_size * f->type_size);
+  else
+    newp = ats_malloc(f->chunk_size * f->type_size);
+  return newp;
+#endif
+}
+
+void
+ink_freelist_free(InkFreeList * f, void *item)
+{
+#if TS_USE_FREELIST
+#if TS_USE_RECLAIMABLE_FREELIST
+  return reclaimable_freelist_free(f, item);
+#else
+  InkThreadMagazines *tm = freelist_magazines(f);
+
+  if (tm)
+    magazine_free(f, tm, item);
+  else
+    freelist_free(f, item);
 #endif /* TS_USE_RECLAIMABLE_FREELIST */
 #else
   if (f->alignment)
@@ -298,6 +527,65 @@ ink_freelist_free(InkFreeList * f, void *item)
 #endif
 }
 
+#if TS_USE_FREELIST && !TS_USE_RECLAIMABLE_FREELIST
+// the whole pages of an item, past the link in its first word
+static void
+reclaim_range(InkFreeList * f, void *item, char **start, char **end)
+{
+  uintptr_t page_size = ats_pagesize();
+
+  *start = (char *) INK_ALIGN((uintptr_t) item + sizeof(void *), page_size);
+  *end = (char *) (((uintptr_t) item + f->type_size) & ~(page_size - 1));
+  if (*end < *start)
+    *end = *start;
+}
+#endif
+
+void
+ink_freelists_reclaim(void)
+{
+#if TS_USE_FREELIST && !TS_USE_RECLAIMABLE_FREELIST
+  ink_freelist_list *fll;
+
+  for (fll = freelists; fll; fll = fll->next) {
+    InkFreeList *f = fll->fl;
+    uint32_t in_use, nfree, keep;
+
+    // huge pages can only be released whole
+    if (f->type_size < 2 * ats_pagesize() || f->use_hugepages)
+      continue;
+
+    in_use = f->count;
+    if (f->allocated < in_use + f->reclaimed_count)
+      continue;
+    if (in_use >= f->reclaim_hwm)
+      f->reclaim_hwm = in_use;
+    else
+      f->reclaim_hwm -= (f->reclaim_hwm - in_use) / 2;
+    keep = f->reclaim_hwm - in_use;
+    nfree = f->allocated - in_use - f->reclaimed_count;
+
+    // the counters are read without a lock, stop at the first empty pop
+    while (nfree-- > keep) {
+      void *item = stack_pop(&f->head);
+      char *start, *end;
+
+      if (!item)
+        break;
+      reclaim_range(f, item, &start, &end);
+      if (end > start && madvise(start, end - start, MADV_DONTNEED) < 0) {
+        stack_push(&f->head, item);
+        break;
+      }
+      ink_atomic_increment(&freelist_reclaimed_mem, (int64_t) (end - start));
+      ink_atomic_increment(&freelist_reclaimed_mem_total, (int64_t) (end - start));
+      ink_atomic_increment((int *) &f->reclaimed_count, 1);
+      stack_push(&f->reclaimed, item);
+    }
+  }
+#endif
+}
+
 void
 ink_freelists_snap_baseline()
 {
@@ -158,14 +158,33 @@ extern "C"
     const char *name;
     uint32_t type_size, chunk_size, count, allocated, alignment;
     uint32_t allocated_base, count_base;
+    uint32_t use_hugepages;
+    /* per-thread magazines, see ink_freelist_magazine_size */
+    volatile head_p magazine_full, magazine_empty;
+    uint32_t magazine_idx;
+    /* free items whose pages were returned, see ink_freelists_reclaim() */
+    volatile head_p reclaimed;
+    uint32_t reclaimed_count, reclaim_hwm;
   };
 
   inkcoreapi extern volatile int64_t fastalloc_mem_in_use;
   inkcoreapi extern volatile int64_t fastalloc_mem_total;
   inkcoreapi extern volatile int64_t freelist_allocated_mem;
 #endif
+  inkcoreapi extern volatile int64_t freelist_reclaimed_mem;       /* bytes returned right now */
+  inkcoreapi extern volatile int64_t freelist_reclaimed_mem_total; /* bytes ever returned */
 
   typedef struct _InkFreeList InkFreeList, *PInkFreeList;
+
+  /*
+   * Number of items in each of the two magazines a thread keeps in front
+   * of every freelist, 0 or 1 disables them. Full and empty magazines are
+   * exchanged with a per-freelist depot, so the steady state allocates
+   * and frees without atomic operations. Items held in a thread's
+   * magazines are counted as in use. Set before the threads start.
+   */
+  inkcoreapi extern int ink_freelist_magazine_size;
+#define INK_FREELIST_MAGAZINE_MAX 64
   typedef struct _ink_freelist_list
   {
     InkFreeList *fl;
@@ -175,16 +194,28 @@ extern "C"
 
   /*
    * alignment must be a power of 2
+   *
+   * with use_hugepages, chunks which fill at least one huge page are
+   * taken from huge pages when there are any, see ats_alloc_hugepage()
    */
   InkFreeList *ink_freelist_create(const char *name, uint32_t type_size,
                                    uint32_t chunk_size, uint32_t alignment);
 
   inkcoreapi void ink_freelist_init(InkFreeList **fl, const char *name,
                                     uint32_t type_size, uint32_t chunk_size,
-                                    uint32_t alignment);
+                                    uint32_t alignment, int use_hugepages);
   inkcoreapi void *ink_freelist_new(InkFreeList * f);
   inkcoreapi void ink_freelist_free(InkFreeList * f, void *item);
   void ink_freelists_dump(FILE * f);
+  /*
+   * Return the pages of idle free items to the OS, called periodically.
+   * Each freelist keeps as many free items as its in-use count dropped
+   * below a high-water mark, which decays by half every call, and
+   * releases the whole pages inside the rest with madvise(MADV_DONTNEED).
+   * Only types of at least two pages qualify. The released items are
+   * reused, faulting their pages back in, before a new chunk is taken.
+   */
+  void ink_freelists_reclaim(void);
   void ink_freelists_dump_baselinerel(FILE * f);
   void ink_freelists_snap_baseline();
 
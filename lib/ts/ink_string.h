@@ -41,6 +41,10 @@
 #include "ParseRules.h"
 #include "ink_apidefs.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 
 /*===========================================================================*
 
@@ -179,6 +183,66 @@ ptr_len_str(const char *p1, int l1, const char *str)
   return NULL;
 }
 
+// inline const char* ink_memchr2(const char* s, char c1, char c2, size_t n)
+//
+//   memchr() for two characters at once: returns the first byte
+//     in [s, s + n) that is either c1 or c2, or NULL.  Looks at 16
+//     bytes per step where SSE2 is available.
+//
+inline const char *
+ink_memchr2(const char *s, char c1, char c2, size_t n)
+{
+#if defined(__SSE2__)
+  __m128i v1 = _mm_set1_epi8(c1);
+  __m128i v2 = _mm_set1_epi8(c2);
+
+  while (n >= 16) {
+    __m128i x = _mm_loadu_si128((const __m128i *) s);
+    int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(x, v1), _mm_cmpeq_epi8(x, v2)));
+
+    if (mask)
+      return s + __builtin_ctz(mask);
+    s += 16;
+    n -= 16;
+  }
+#endif
+  for (; n > 0; ++s, --n) {
+    if (*s == c1 || *s == c2)
+      return s;
+  }
+  return NULL;
+}
+
+// inline const char* ink_memchr3(const char* s, char c1, char c2, char c3, size_t n)
+//
+//   ink_memchr2() for three characters.
+//
+inline const char *
+ink_memchr3(const char *s, char c1, char c2, char c3, size_t n)
+{
+#if defined(__SSE2__)
+  __m128i v1 = _mm_set1_epi8(c1);
+  __m128i v2 = _mm_set1_epi8(c2);
+  __m128i v3 = _mm_set1_epi8(c3);
+
+  while (n >= 16) {
+    __m128i x = _mm_loadu_si128((const __m128i *) s);
+    int mask = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, v1), _mm_cmpeq_epi8(x, v2)),
+                                              _mm_cmpeq_epi8(x, v3)));
+
+    if (mask)
+      return s + __builtin_ctz(mask);
+    s += 16;
+    n -= 16;
+  }
+#endif
+  for (; n > 0; ++s, --n) {
+    if (*s == c1 || *s == c2 || *s == c3)
+      return s;
+  }
+  return NULL;
+}
+
 // int ptr_len_ncmp(const char* p1, int l1, const char* str, int n) {
 //
 //    strncmp like functionality for comparing a ptr,len pair with
@@ -55,6 +55,7 @@
 #include "ink_exception.h"
 #include "ink_file.h"
 #include "ink_hash_table.h"
+#include "ink_heartbeat.h"
 #include "ink_hrtime.h"
 #include "ink_inout.h"
 #include "ink_llqueue.h"
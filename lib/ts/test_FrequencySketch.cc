@@ -0,0 +1,86 @@
+/** @file
+
+  Test the count-min frequency sketch
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "FrequencySketch.h"
+
+#define N_KEYS 1000
+
+static int failures = 0;
+
+static void
+check(bool ok, const char *what, int64_t v)
+{
+  if (!ok) {
+    printf("test_FrequencySketch: %s (%" PRId64 ")\n", what, v);
+    failures++;
+  }
+}
+
+static uint64_t
+key(int i)
+{
+  return (uint64_t)i * 0x9E3779B97F4A7C15ULL + 1;
+}
+
+int main() {
+  FrequencySketch s;
+  check(s.estimate(key(1)) == 0, "estimate before init", 0);
+  s.init(N_KEYS);
+
+  // never understated, counters saturate
+  for (int i = 0; i < N_KEYS; i++)
+    for (int n = 0; n < i % 8; n++)
+      s.increment(key(i));
+  int over = 0;
+  for (int i = 0; i < N_KEYS; i++) {
+    check(s.estimate(key(i)) >= i % 8, "understated", i);
+    if (s.estimate(key(i)) > i % 8)
+      over++;
+  }
+  check(over < N_KEYS / 10, "too many collisions", over);
+  for (int n = 0; n < 20; n++)
+    s.increment(key(7));
+  check(s.estimate(key(7)) == FREQUENCY_SKETCH_MAX, "saturate", s.estimate(key(7)));
+
+  // aging halves everything
+  int before = s.estimate(key(5));
+  s.reset();
+  check(s.estimate(key(5)) == before / 2, "reset", s.estimate(key(5)));
+
+  // a burst of one-hit keys ages out an old favourite
+  for (int n = 0; n < 20; n++)
+    s.increment(key(3));
+  for (int i = N_KEYS; i < N_KEYS * 12; i++)
+    s.increment(key(i));
+  check(s.estimate(key(3)) <= FREQUENCY_SKETCH_MAX / 2, "aging", s.estimate(key(3)));
+
+  if (failures) {
+    printf("test_FrequencySketch FAILED\n");
+    exit(1);
+  } else {
+    printf("test_FrequencySketch PASSED\n");
+    exit(0);
+  }
+}
@@ -0,0 +1,120 @@
+/** @file
+
+  Test the combined automaton of DFA against pcre
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "libts.h"
+
+static int failures = 0;
+
+static void
+check(bool ok, const char *what, const char *str)
+{
+  if (!ok) {
+    printf("test_Regex: %s (\"%s\")\n", what, str);
+    failures++;
+  }
+}
+
+static const char *patterns[] = {
+  "foo", "fo+", "f.o$", "bar|baz", "(ab)*c", "[a-c]{2,3}x", "\\d+\\.\\d*", "[^a-z]+$",
+  "(?:cache|hostdb)_.*", "x[\\w-]+y", "^www\\.", "\\.com|\\.net", "(a|b)+c", "a{2,}b?",
+  "(x)\\1", "b(?=c)"            // left to pcre
+};
+#define N_PATTERNS ((int) (sizeof(patterns) / sizeof(patterns[0])))
+
+static const char *strings[] = {
+  "", "foo", "fooo", "fxo", "fxo\n", "bar", "baz", "ababc", "abx", "aacx", "12.5x", "ABC!",
+  "cache_x", "hostdb_", "x-_y", "www.example.com", "example.net", "ababbc", "aab", "xx", "abc",
+  "\n", "FOO", "Bar"
+};
+#define N_STRINGS ((int) (sizeof(strings) / sizeof(strings[0])))
+
+// Every pattern in turn with pcre, as DFA used to match
+static void
+check_flags(REFlags flags)
+{
+  DFA dfa;
+  pcre *re[N_PATTERNS];
+  char matched[N_PATTERNS];
+  int options = (flags & RE_UNANCHORED) ? 0 : PCRE_ANCHORED;
+  const char *error;
+  int erroffset;
+
+  if (flags & RE_CASE_INSENSITIVE)
+    options |= PCRE_CASELESS;
+  dfa.compile(patterns, N_PATTERNS, flags);
+  for (int i = 0; i < N_PATTERNS; i++)
+    re[i] = pcre_compile(patterns[i], options, &error, &erroffset, NULL);
+
+  for (int s = 0; s < N_STRINGS; s++) {
+    const char *str = strings[s];
+    int len = strlen(str);
+    int first = -1;
+    int n = 0;
+
+    dfa.match_all(str, len, matched);
+    for (int i = 0; i < N_PATTERNS; i++) {
+      bool m = pcre_exec(re[i], NULL, str, len, 0, 0, NULL, 0) >= 0;
+
+      if (m && first < 0)
+        first = i;
+      n += m;
+      check(matched[i] == m, "match_all", str);
+    }
+    check(dfa.match(str, len) == first, "match", str);
+    check(dfa.match_all(str, len, matched) == n, "match_all count", str);
+  }
+  for (int i = 0; i < N_PATTERNS; i++)
+    pcre_free(re[i]);
+}
+
+int
+main()
+{
+  check_flags((REFlags) 0);
+  check_flags(RE_CASE_INSENSITIVE);
+  check_flags(RE_UNANCHORED);
+  check_flags((REFlags) (RE_CASE_INSENSITIVE | RE_UNANCHORED));
+
+  // more states than the automaton keeps
+  DFA big;
+  char str[201];
+
+  big.compile("a.{13}b$", RE_UNANCHORED);
+  srand(1);
+  for (int i = 0; i < 100; i++) {
+    for (int j = 0; j < 200; j++)
+      str[j] = rand() % 2 ? 'a' : 'b';
+    str[200] = '\0';
+    check(big.match(str) == (str[185] == 'a' && str[199] == 'b' ? 0 : -1), "fallback", str);
+  }
+
+  if (failures) {
+    printf("test_Regex FAILED\n");
+    exit(1);
+  } else {
+    printf("test_Regex PASSED\n");
+    exit(0);
+  }
+}
@@ -0,0 +1,106 @@
+/** @file
+
+  Test the hierarchical timer wheel
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "TimerWheel.h"
+
+#define N_TIMERS 2000
+#define TICK 10
+
+struct Timer {
+  ink_hrtime at;
+  int slot;
+  bool expired;
+  LINK(Timer, link);
+  struct Link_wheel : public Link_link {
+    static ink_hrtime at(Timer *t) { return t->at; }
+    static int slot(Timer *t) { return t->slot; }
+    static void set_slot(Timer *t, int s) { t->slot = s; }
+  };
+  Timer():at(0), slot(TIMER_WHEEL_NO_SLOT), expired(false) {}
+};
+
+static int failures = 0;
+
+static void
+check(bool ok, const char *what, ink_hrtime now)
+{
+  if (!ok) {
+    printf("test_TimerWheel: %s at %" PRId64 "\n", what, now);
+    failures++;
+  }
+}
+
+int main() {
+  TimerWheel<Timer, Timer::Link_wheel> w;
+  Queue<Timer, Timer::Link_wheel> expired;
+  Timer *timers = new Timer[N_TIMERS];
+  ink_hrtime now = 1000;
+  w.init(TICK, now);
+
+  srandom(17);
+  for (int i = 0; i < N_TIMERS; i++) {
+    // mostly near, some beyond the reach of the wheel
+    int64_t range = (i % 10) ? (int64_t)TICK << (6 * (1 + i % 4)) : (int64_t)TICK << 26;
+    timers[i].at = now + (ink_hrtime)(random() % range);
+    w.insert(&timers[i]);
+  }
+  // cancel every third
+  for (int i = 0; i < N_TIMERS; i += 3)
+    w.remove(&timers[i]);
+
+  int n = 0;
+  ink_hrtime end = now + ((ink_hrtime)TICK << 27);
+  for (;;) {
+    w.expire(now, expired);
+    while (Timer *t = expired.dequeue()) {
+      check(t->at / TICK == now / TICK, "expired at the wrong time", now);
+      check(!t->expired, "expired twice", now);
+      t->expired = true;
+      n++;
+    }
+    if (w.empty() || now > end)
+      break;
+    // the wheel may wake us early but never late
+    ink_hrtime e = w.earliest();
+    ink_hrtime min = 0;
+    for (int i = 0; i < N_TIMERS; i++)
+      if (timers[i].slot != TIMER_WHEEL_NO_SLOT && (!min || timers[i].at < min))
+        min = timers[i].at;
+    check(e > now, "earliest() in the past", now);
+    check(e <= min, "earliest() after an element", now);
+    now = e;
+  }
+  for (int i = 0; i < N_TIMERS; i++)
+    check(timers[i].expired == !!(i % 3), "cancel", i);
+  check(n == N_TIMERS - (N_TIMERS + 2) / 3, "count", n);
+
+  if (failures) {
+    printf("test_TimerWheel FAILED\n");
+    exit(1);
+  } else {
+    printf("test_TimerWheel PASSED\n");
+    exit(0);
+  }
+}
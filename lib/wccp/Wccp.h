@@ -379,6 +379,14 @@ public:
   self& setCacheAssignment(
     CacheAssignmentStyle style ///< Style to use.
   );
+  /** Set the assignment weight of this cache.
+      Buckets are divided between the caches of the group in proportion
+      to their weights. This can be lowered while the cache is loaded
+      to move traffic to the other caches.
+  */
+  self& setWeight(
+    uint16_t weight ///< Relative weight.
+  );
   
   
 private:
@@ -67,6 +67,7 @@ static char const * const SVC_PROP_ROUTERS = "routers";
 static char const * const SVC_PROP_FORWARD = "forward";
 static char const * const SVC_PROP_RETURN = "return";
 static char const * const SVC_PROP_ASSIGN = "assignment";
+static char const * const SVC_PROP_WEIGHT = "weight";
 
 static char const * const SECURITY_PROP_OPTION = "option";
 static char const * const SECURITY_PROP_KEY = "key";
@@ -789,6 +790,19 @@ CacheImpl::loadServicesFromFile(char const* path) {
         zret.push(List_Valid_Opts(prop.getName(), src_line, ASSIGN_OPTS, N_OPTS(ASSIGN_OPTS)).set(status));
       }
     }
+
+    svc.m_weight = 0; // default, all caches equal.
+    if ((prop = svc_cfg[SVC_PROP_WEIGHT]).hasValue()) {
+      if (ts::config::IntegerValue == prop.getType()) {
+        x = atoi(prop.getText()._ptr);
+        if (0 <= x && x <= 65535)
+          svc.m_weight = x;
+        else
+          zret.push(Svc_Prop_Out_Of_Range(SVC_PROP_WEIGHT, prop, x, 0, 65535));
+      } else {
+        zret.push(Prop_Invalid_Type(prop, ts::config::IntegerValue));
+      }
+    }
   }
   return zret;
 }
@@ -254,8 +254,18 @@ Impl::handleRemovalQuery(IpHeader const&, ts::Buffer const& /* data ATS_UNUSED *
   return log(LVL_INFO, "Unanticipated WCCP2_REMOVAL_QUERY message ignored.");
 }
 // ------------------------------------------------------
+CacheImpl::GroupStats::GroupStats()
+  : m_here_i_am(0)
+  , m_i_see_you(0)
+  , m_redirect_assign(0)
+  , m_send_errors(0)
+  , m_assignments(0)
+  , m_local_share(0) {
+}
+
 CacheImpl::GroupData::GroupData()
-  : m_assignment_pending(false) {
+  : m_weight(0)
+  , m_assignment_pending(false) {
 }
 
 CacheImpl::GroupData&
@@ -462,6 +472,16 @@ Cache::Service::setSecurity(SecurityOption opt) {
   return *this;
 }
 
+Cache::Service&
+Cache::Service::setWeight(uint16_t weight) {
+  if (weight != m_group->m_weight) {
+    m_group->m_weight = weight;
+    // Get the new weight to the routers promptly.
+    ts::for_each(m_group->m_routers, ts::assign_member(&CacheImpl::RouterData::m_rapid, 2));
+  }
+  return *this;
+}
+
 CacheImpl&
 CacheImpl::seedRouter(uint8_t id, uint32_t addr) {
   GroupMap::iterator spot = m_groups.find(id);
@@ -502,6 +522,7 @@ CacheImpl::generateHereIAm(
   GroupData& group
 ) {
   msg.fill(group, group.m_id, this->setSecurity(msg, group));
+  msg.m_cache_id.setWeight(group.m_weight);
   msg.finalize();
 }
 
@@ -514,6 +535,7 @@ CacheImpl::generateHereIAm(
   SecurityOption sec_opt = this->setSecurity(msg, group);
 
   msg.fill(group, group.m_id, sec_opt);
+  msg.m_cache_id.setWeight(group.m_weight);
   if (router.m_local_cache_id.getSize())
     msg.m_cache_id.setUnassigned(false);
 
@@ -625,7 +647,9 @@ CacheImpl::housekeeping() {
             group.m_generation, now
           );
           if (rspot->m_rapid) --(rspot->m_rapid);
+          ++group.m_stats.m_here_i_am;
         } else {
+          ++group.m_stats.m_send_errors;
           logf_errno(LVL_WARN, "Failed to send to router " ATS_IP_PRINTF_CODE " - ", ATS_IP_OCTETS(rspot->m_addr));
         }
       } else if (rspot->m_assign) {
@@ -633,7 +657,12 @@ CacheImpl::housekeeping() {
         redirect_assign.setBuffer(msg_buffer);
         this->generateRedirectAssign(redirect_assign, group);
         zret = sendto(m_fd, msg_data, redirect_assign.getCount(), 0, addr_ptr, sizeof(dst_addr));
-        if (0 <= zret) rspot->m_assign = false;
+        if (0 <= zret) {
+          rspot->m_assign = false;
+          ++group.m_stats.m_redirect_assign;
+        } else {
+          ++group.m_stats.m_send_errors;
+        }
       }
     }
 
@@ -662,14 +691,18 @@ CacheImpl::housekeeping() {
         );
         sspot->m_xmit = now;
         sspot->m_count += 1;
+        ++group.m_stats.m_here_i_am;
+      }
+      else {
+        ++group.m_stats.m_send_errors;
+        logf(LVL_DEBUG,
+          "Error [%d:%s] sending HERE_I_AM for SG %d to seed router %s [#%d,%lu].",
+          zret, strerror(errno),
+          group.m_svc.getSvcId(),
+          ip_addr_to_str(sspot->m_addr),
+          group.m_generation, now
+        );
       }
-      else logf(LVL_DEBUG,
-        "Error [%d:%s] sending HERE_I_AM for SG %d to seed router %s [#%d,%lu].",
-        zret, strerror(errno),
-        group.m_svc.getSvcId(),
-        ip_addr_to_str(sspot->m_addr),
-        group.m_generation, now
-      );
     }
   }
   return zret;
@@ -705,6 +738,7 @@ CacheImpl::handleISeeYou(IpHeader const& /* ip_hdr ATS_UNUSED */, ts::Buffer con
     return logf(LVL_INFO, "WCCP2_I_SEE_YOU ignored -- cache not in from list.\n");
 
   logf(LVL_DEBUG, "Received WCCP2_I_SEE_YOU for group %d.", group.m_svc.getSvcId());
+  ++group.m_stats.m_i_see_you;
 
   // Prefered address for router.
   uint32_t router_addr = msg.m_router_id.idElt().getAddr();
@@ -734,20 +768,22 @@ CacheImpl::handleISeeYou(IpHeader const& /* ip_hdr ATS_UNUSED */, ts::Buffer con
     char const* caps_tag = caps.isEmpty() ? "default" : "router";
 
     // No caps -> use GRE forwarding.
+    // Prefer L2 if both sides allow it, it leaves no GRE header to strip
+    // from each redirected packet.
     ps = caps.isEmpty() ? ServiceGroup::GRE : caps.getPacketForwardStyle();
-    if (ServiceGroup::GRE & ps & group.m_packet_forward)
-      r.m_packet_forward = ServiceGroup::GRE;
-    else if (ServiceGroup::L2 & ps & group.m_packet_forward)
+    if (ServiceGroup::L2 & ps & group.m_packet_forward)
       r.m_packet_forward = ServiceGroup::L2;
+    else if (ServiceGroup::GRE & ps & group.m_packet_forward)
+      r.m_packet_forward = ServiceGroup::GRE;
     else
       logf(zret, LVL_WARN, "Packet forwarding (config=%d, %s=%d) did not match.", group.m_packet_forward, caps_tag, ps);
 
     // No caps -> use GRE return.
     ps = caps.isEmpty() ? ServiceGroup::GRE : caps.getPacketReturnStyle();
-    if (ServiceGroup::GRE & ps & group.m_packet_return)
-      r.m_packet_return = ServiceGroup::GRE;
-    else if (ServiceGroup::L2 & ps & group.m_packet_return)
+    if (ServiceGroup::L2 & ps & group.m_packet_return)
       r.m_packet_return = ServiceGroup::L2;
+    else if (ServiceGroup::GRE & ps & group.m_packet_return)
+      r.m_packet_return = ServiceGroup::GRE;
     else
       logf(zret, LVL_WARN, "Packet return (local=%d, %s=%d) did not match.", group.m_packet_return, caps_tag, ps);
 
@@ -821,6 +857,11 @@ CacheImpl::handleISeeYou(IpHeader const& /* ip_hdr ATS_UNUSED */, ts::Buffer con
       // this time. In that case we need to bump the view to trigger
       // assignment generation.
       if (ac_spot->m_src[router_idx].m_time != then) view_changed = true;
+      // A new weight needs a new assignment to take effect.
+      if (ac_spot->m_id.getWeight() != cache.getWeight()) {
+        logf(LVL_INFO, "Cache %s weight changed to %d in view %d", ip_addr_to_str(cache.getAddr()), cache.getWeight(), group.m_svc.getSvcId());
+        view_changed = true;
+      }
     }
     ac_spot->m_id.fill(cache);
     // If cache is this cache, update data in router record.
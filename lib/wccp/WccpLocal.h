@@ -45,6 +45,9 @@ namespace detail {
 static unsigned int const DEFAULT_PORT = 2048;
 /// Number of buckets in WCCP hash allocation.
 static unsigned int const N_BUCKETS = 256;
+/// Number of values in a generated mask assignment.
+/// Routers limit the mask to a few bits, this uses six.
+static unsigned int const MASK_VALUES = 64;
 /// Unassigned bucket value (defined by protocol).
 static uint8_t const UNASSIGNED_BUCKET = 0xFF;
 /// Size of group password in octets.
@@ -564,6 +567,17 @@ public:
   */
   self& round_robin_assign();
 
+  /** Do a weighted assignment.
+      Each cache gets a share of the buckets in proportion to its
+      entry in @a weights, spread across the bucket range rather than
+      in a single run. If all of the weights are zero the caches are
+      treated as equal.
+      @return @c this.
+  */
+  self& weighted_assign(
+    uint32_t const* weights ///< Weight for each cache, by index.
+  );
+
   /// Get size in bytes of this structure.
   size_t getSize() const;
   /// Calculate size in bytes for @a n caches.
@@ -817,6 +831,9 @@ public:
   );
 
   self& clearReserved(); ///< Set reserved bits to zero.
+  /// Get weight field (zero if the element is not set up).
+  uint16_t getWeight() const;
+  self& setWeight(uint16_t w); ///< Set weight field to @a w.
   //@}
   /// Initialize to unassigned hash.
   /// The cache address is set to @a addr.
@@ -2445,6 +2462,20 @@ namespace detail {
     /// Storage type for known routers.
     typedef std::vector<RouterData> RouterBag;
 
+    /// Per service group counters.
+    struct GroupStats {
+      GroupStats(); ///< Default constructor, zero initialized.
+
+      uint64_t m_here_i_am; ///< HERE_I_AM messages sent.
+      uint64_t m_i_see_you; ///< I_SEE_YOU messages accepted.
+      uint64_t m_redirect_assign; ///< REDIRECT_ASSIGN messages sent.
+      uint64_t m_send_errors; ///< Messages that could not be sent.
+      uint64_t m_assignments; ///< Assignments generated by this cache.
+      /// Buckets or mask values given to this cache by the last
+      /// assignment it generated.
+      uint32_t m_local_share;
+    };
+
     /** Cache's view of a service group.
         This stores the internal accounting information, it is not the
         serialized form.
@@ -2463,11 +2494,21 @@ namespace detail {
       /// Cache assignment methods supported.
       ServiceGroup::CacheAssignmentStyle m_cache_assign;
 
+      /** Assignment weight of this cache.
+          This is advertised to the routers and used by the designated
+          cache to divide the buckets (or mask values) between the caches.
+          Lower it to move load off of this cache.
+      */
+      uint16_t m_weight;
+
       /// Known caches.
       CacheBag m_caches;
       /// Known routers.
       RouterBag m_routers;
 
+      /// Message and assignment counters for this group.
+      GroupStats m_stats;
+
       /// Set if there an assignment should be computed and sent.
       /// This is before checking for being a designated cache
       /// (that check is part of the assignment generation).
@@ -2545,6 +2586,7 @@ public:
   typedef detail::cache::CacheData CacheData;
   typedef detail::cache::RouterData RouterData;
   typedef detail::cache::GroupData GroupData;
+  typedef detail::cache::GroupStats GroupStats;
   typedef detail::cache::CacheBag CacheBag;
   typedef detail::cache::RouterBag RouterBag;
 
@@ -2982,6 +3024,17 @@ CacheIdBox::setUnassigned(bool state) {
   return *this;
 }
 
+inline uint16_t
+CacheIdBox::getWeight() const {
+  return m_tail ? ntohs(m_tail->m_weight) : 0;
+}
+
+inline CacheIdBox&
+CacheIdBox::setWeight(uint16_t w) {
+  if (m_tail) m_tail->m_weight = htons(w);
+  return *this;
+}
+
 inline AssignmentKeyElt::AssignmentKeyElt(
   uint32_t addr,
   uint32_t n
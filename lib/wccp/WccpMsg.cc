@@ -182,7 +182,7 @@ CacheIdBox::parse(MsgBuffer base) {
       logf(LVL_DEBUG, "I_SEE_YOU Cache Hash ID too small: %lu < %lu", n, sizeof(CacheHashIdElt));
     } else {
       m_size = sizeof(CacheHashIdElt);
-      m_tail = static_cast<CacheHashIdElt*>(m_base)->getTailPtr();
+      m_tail = static_cast<CacheHashIdElt*>(ptr)->getTailPtr();
     }
   }
   if (PARSE_SUCCESS == zret) m_base = ptr;
@@ -324,6 +324,47 @@ HashAssignElt::round_robin_assign() {
   return *this;
 }
 
+/* Fill @a slots with cache indices so that each cache gets a count in
+   proportion to its weight. Every slot goes to the cache with the most
+   accumulated credit, which interleaves the caches instead of giving
+   each one a contiguous run.
+*/
+static void
+weighted_spread(uint32_t const* weights, size_t n, uint8_t* slots, size_t n_slots) {
+  int64_t credit[MAX_CACHES];
+  uint32_t w[MAX_CACHES];
+  int64_t total = 0;
+  size_t idx;
+
+  for ( idx = 0 ; idx < n ; ++idx ) total += w[idx] = weights[idx];
+  if (0 == total) { // no weights, everyone equal.
+    for ( idx = 0 ; idx < n ; ++idx ) w[idx] = 1;
+    total = n;
+  }
+  memset(credit, 0, sizeof(credit));
+  for ( size_t slot = 0 ; slot < n_slots ; ++slot ) {
+    size_t best = 0;
+    for ( idx = 0 ; idx < n ; ++idx ) {
+      credit[idx] += w[idx];
+      if (credit[idx] > credit[best]) best = idx;
+    }
+    credit[best] -= total;
+    slots[slot] = best;
+  }
+}
+
+HashAssignElt&
+HashAssignElt::weighted_assign(uint32_t const* weights) {
+  uint8_t slots[N_BUCKETS];
+  Bucket* buckets = this->getBucketBase();
+  weighted_spread(weights, this->getCount(), slots, N_BUCKETS);
+  for ( size_t idx = 0 ; idx < N_BUCKETS ; ++idx ) {
+    buckets[idx].m_idx = slots[idx];
+    buckets[idx].m_alt = 0;
+  }
+  return *this;
+}
+
 RouterAssignListElt&
 RouterAssignListElt::updateRouterId(uint32_t addr, uint32_t rcvid, uint32_t cno) {
   uint32_t n = this->getCount();
@@ -1577,9 +1618,11 @@ detail::Assignment::fill(cache::GroupData& group, uint32_t addr) {
   // last packet, so it should be discarded. A cache is valid if
   // nr is n_routers, indicating that every router mentioned it.
   int v_caches = 0; // valid caches
+  uint32_t weights[MAX_CACHES]; // weights of valid caches.
   for ( cdx = 0, cspot = cbegin ; cspot != cend ; ++cspot, ++cdx )
-    if (nr[cdx] == n_routers) {
-      m_hash_assign->setAddr(cdx, cspot->idAddr());
+    if (nr[cdx] == n_routers && v_caches < static_cast<int>(MAX_CACHES)) {
+      m_hash_assign->setAddr(v_caches, cspot->idAddr());
+      weights[v_caches] = cspot->m_id.getWeight();
       ++v_caches;
     }
 
@@ -1589,18 +1632,47 @@ detail::Assignment::fill(cache::GroupData& group, uint32_t addr) {
   }
   // Just sets the cache count.
   new (m_hash_assign) HashAssignElt(v_caches);
-  m_hash_assign->round_robin_assign();
+  m_hash_assign->weighted_assign(weights);
   m_buffer.use(m_hash_assign->getSize());
 
   m_mask_assign = reinterpret_cast<MaskAssignElt*>(m_buffer.getTail());
   new (m_mask_assign) MaskAssignElt;
 
-  // For now, hardwire everything to first cache.
-  // We have plenty of space, but will need to check if we do something
-  // more complex here.
-  m_mask_assign->init(0,0,0,0)->addValue(m_hash_assign->getAddr(0),0,0,0,0);
+  int local_idx = -1; // index of this cache among the valid caches.
+  for ( int idx = 0 ; idx < v_caches ; ++idx )
+    if (m_hash_assign->getAddr(idx) == addr) local_idx = idx;
+  uint32_t local_share = 0;
 
-  logf(LVL_INFO, "Generated assignment for group %d with %d routers, %d valid caches.", group.m_svc.getSvcId(), n_routers, v_caches);
+  if (1 == v_caches) {
+    // A single set with one value matching everything is known to work.
+    m_mask_assign->init(0,0,0,0)->addValue(m_hash_assign->getAddr(0),0,0,0,0);
+    if (0 == local_idx) local_share = 1;
+  } else {
+    // Split on the low bits of the destination address, which keeps
+    // each origin server on one cache. The values are spread by weight
+    // in the same way as the hash buckets. The buffer slack above
+    // covers this set.
+    uint8_t slots[MASK_VALUES];
+    MaskValueSetElt* set = m_mask_assign->init(0, MASK_VALUES - 1, 0, 0).m_set;
+    weighted_spread(weights, v_caches, slots, MASK_VALUES);
+    for ( uint32_t value = 0 ; value < MASK_VALUES ; ++value ) {
+      set->addValue(m_hash_assign->getAddr(slots[value]), 0, htonl(value), 0, 0);
+      if (slots[value] == local_idx) ++local_share;
+    }
+  }
+
+  if (0 <= local_idx && ServiceGroup::MASK_ONLY != group.m_cache_assign) {
+    local_share = 0;
+    for ( size_t idx = 0 ; idx < N_BUCKETS ; ++idx )
+      if ((*m_hash_assign)[idx].m_idx == local_idx) ++local_share;
+  }
+  group.m_stats.m_assignments += 1;
+  group.m_stats.m_local_share = local_share;
+
+  logf(LVL_INFO, "Generated assignment for group %d with %d routers, %d valid caches, %u %s to this cache.",
+    group.m_svc.getSvcId(), n_routers, v_caches, local_share,
+    ServiceGroup::MASK_ONLY == group.m_cache_assign ? "mask values" : "buckets"
+  );
 
   return true;
 }
@@ -63,6 +63,8 @@
 #define MGMT_EVENT_HTTP_CLUSTER_DELTA    10007
 #define MGMT_EVENT_ROLL_LOG_FILES        10008
 #define MGMT_EVENT_LIBRECORDS            10009
+#define MGMT_EVENT_HANDOFF               10010  /* Hot upgrade, give up the cache to a new process */
+#define MGMT_EVENT_DRAIN                 10011  /* Hot upgrade, stop accepting and exit when idle */
 
 /***********************************************************************
  *
@@ -92,6 +94,8 @@
 #define MGMT_SIGNAL_LIBRECORDS            16
 #define MGMT_SIGNAL_HTTP_CONGESTED_SERVER   20  /* Congestion control -- congested server */
 #define MGMT_SIGNAL_HTTP_ALLEVIATED_SERVER  21  /* Congestion control -- alleviated server */
+#define MGMT_SIGNAL_PROXY_HANDED_OFF        22  /* Hot upgrade -- done with MGMT_EVENT_HANDOFF */
+#define MGMT_SIGNAL_PROXY_PORTS_READY       23  /* Accepting on the proxy ports */
 
 #define INK_MGMT_SIGNAL_SAC_SERVER_DOWN			400
 
@@ -32,6 +32,14 @@
 #include "ExpandingArray.h"
 #include "MgmtSocket.h"
 
+#if HAVE_INOTIFY_INIT
+#include <sys/inotify.h>
+#endif
+
+// How long writes to the configuration directory have to settle before
+//   the files are checked, so that an editor saving a file or a tool
+//   copying in several of them cause a single reload
+#define WATCH_SETTLE_MSECS 100
 
 
 static const char snapDir[] = "snapshots";
@@ -60,6 +68,8 @@ FileManager::FileManager()
   int pathLen;
 
   bindings = ink_hash_table_create(InkHashTableKeyType_String);
+  watchFd = -1;
+  watchDeadline = 0;
 
   ink_assert(bindings != NULL);
 
@@ -138,6 +148,9 @@ FileManager::~FileManager()
 
   ink_hash_table_destroy(bindings);
 
+  if (watchFd >= 0) {
+    close(watchFd);
+  }
 
   ink_mutex_destroy(&accessLock);
   ink_mutex_destroy(&cbListLock);
@@ -182,6 +195,7 @@ FileManager::addFile(const char *baseFileName, bool root_access_needed)
   fileBinding *newBind = new fileBinding;
 
   newBind->rb = new Rollback(baseFileName, root_access_needed);
+  newBind->changed = false;
 
   ink_mutex_acquire(&accessLock);
   ink_hash_table_insert(bindings, baseFileName, newBind);
@@ -771,6 +785,114 @@ FileManager::rereadConfig()
   }
 }
 
+// void FileManager::watchFiles()
+//
+//   Asks the kernel to tell us about files written or moved into
+//     the configuration directory, so that changes to managed files
+//     are picked up as they happen rather than when a reread is
+//     requested
+//
+void
+FileManager::watchFiles()
+{
+#if HAVE_INOTIFY_INIT
+  bool found;
+  int enabled = (int) REC_readInteger("proxy.config.admin.watch_config_files", &found);
+
+  if (!found || !enabled || watchFd >= 0) {
+    return;
+  }
+
+  if ((watchFd = inotify_init()) < 0) {
+    mgmt_elog(stderr, "[FileManager::watchFiles] inotify_init failed: %s\n", strerror(errno));
+    return;
+  }
+  fcntl(watchFd, F_SETFL, O_NONBLOCK);
+  fcntl(watchFd, F_SETFD, FD_CLOEXEC);
+
+  if (inotify_add_watch(watchFd, system_config_directory, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+    mgmt_elog(stderr, "[FileManager::watchFiles] Unable to watch %s: %s\n", system_config_directory, strerror(errno));
+    close(watchFd);
+    watchFd = -1;
+    return;
+  }
+  mgmt_log("[FileManager::watchFiles] Watching %s for configuration changes\n", system_config_directory);
+#else
+  mgmt_log("[FileManager::watchFiles] Watching configuration files is not supported on this platform\n");
+#endif
+}
+
+// void FileManager::readWatchEvents()
+//
+//   Marks the managed files named in the pending events as changed,
+//     and (re)starts the wait for writes to settle
+//
+void
+FileManager::readWatchEvents()
+{
+#if HAVE_INOTIFY_INIT
+  char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+  struct inotify_event *event;
+  InkHashTableValue lookup;
+  ssize_t len;
+
+  while ((len = read(watchFd, buf, sizeof(buf))) > 0) {
+    for (char *ptr = buf; ptr < buf + len; ptr += sizeof(struct inotify_event) + event->len) {
+      event = (struct inotify_event *) ptr;
+      if (event->len == 0) {
+        continue;
+      }
+
+      ink_mutex_acquire(&accessLock);
+      if (ink_hash_table_lookup(bindings, event->name, &lookup)) {
+        ((fileBinding *) lookup)->changed = true;
+        watchDeadline = ink_get_hrtime_internal() + HRTIME_MSECONDS(WATCH_SETTLE_MSECS);
+      }
+      ink_mutex_release(&accessLock);
+    }
+  }
+#endif
+}
+
+// int FileManager::checkWatchedFiles()
+//
+//   Calls Rollback::checkForUserUpdate on the managed files written
+//     since the last check, once no write has been seen for
+//     WATCH_SETTLE_MSECS.  A file that did change is rolled, which
+//     signals the change of that file alone
+//
+int
+FileManager::checkWatchedFiles()
+{
+  fileBinding *bind;
+  InkHashTableEntry *entry;
+  InkHashTableIteratorState iterator_state;
+
+  if (watchDeadline == 0) {
+    return -1;
+  }
+
+  ink_hrtime now = ink_get_hrtime_internal();
+  if (now < watchDeadline) {
+    return (int) ink_hrtime_to_msec(watchDeadline - now) + 1;
+  }
+  watchDeadline = 0;
+
+  ink_mutex_acquire(&accessLock);
+  for (entry = ink_hash_table_iterator_first(bindings, &iterator_state);
+       entry != NULL; entry = ink_hash_table_iterator_next(bindings, &iterator_state)) {
+
+    bind = (fileBinding *) ink_hash_table_entry_value(bindings, entry);
+    if (bind->changed) {
+      bind->changed = false;
+      bind->rb->checkForUserUpdate();
+    }
+  }
+  ink_mutex_release(&accessLock);
+
+  return -1;
+}
+
 // void FileManager::displaySnapPage(textBuffer* output, httpResponse& answerHdr)
 //
 //  Generates an HTML page with the add form and the list
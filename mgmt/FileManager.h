@@ -34,6 +34,7 @@
 #include <stdio.h>
 
 #include "ink_hash_table.h"
+#include "ink_hrtime.h"
 #include "List.h"
 #include "WebGlobals.h"
 #include "MultiFile.h"
@@ -53,6 +54,7 @@ public:
 struct fileBinding
 {
   Rollback *rb;
+  bool changed;                 // written since the last check, see checkWatchedFiles()
 };
 
 // MUST match the ordering MFresult so that we can cast
@@ -107,6 +109,19 @@ class ExpandingArray;
 //  rereadConfig() - Checks all managed files to see if they have been
 //       updated
 //
+//  watchFiles() - if proxy.config.admin.watch_config_files is set, starts
+//       watching the configuration directory for written files
+//
+//  getWatchFd() - returns the descriptor that becomes readable when
+//       watched files are written, or -1
+//
+//  readWatchEvents() - notes the managed files that were written
+//
+//  checkWatchedFiles() - once writes have settled, checks the managed
+//       files that were written to see if they have been updated.
+//       Returns the number of milliseconds until it should be called
+//       again, or -1 if no writes are pending
+//
 class FileManager:public MultiFile
 {
 public:
@@ -118,6 +133,10 @@ public:
   void fileChanged(const char *baseFileName);
   textBuffer *filesManaged();
   void rereadConfig();
+  void watchFiles();
+  int getWatchFd() const { return watchFd; }
+  void readWatchEvents();
+  int checkWatchedFiles();
   //SnapResult takeSnap(const char* snapName);
   SnapResult takeSnap(const char *snapName, const char *snapDir);
   //SnapResult restoreSnap(const char* snapName);
@@ -133,6 +152,8 @@ private:
   ink_mutex cbListLock;         // Protects the CallBack List
     DLL<callbackListable> cblist;
   InkHashTable *bindings;
+  int watchFd;                  // inotify descriptor, or -1
+  ink_hrtime watchDeadline;     // when pending writes are checked, 0 if none are
   //InkHashTable* g_snapshot_directory_ht;
   char *snapshotDir;
   SnapResult copyFile(Rollback * rb, const char *snapPath);
@@ -112,6 +112,21 @@ LocalManager::processBounce()
   return;
 }
 
+/*
+ * processUpgrade()
+ *   Start a new traffic_server, from the binary now installed, without
+ * dropping connections. The running process hands off the cache to it
+ * and keeps serving until the new one accepts on the listen sockets,
+ * which are shared, then it drains its connections and exits.
+ */
+void
+LocalManager::processUpgrade()
+{
+  mgmt_log("[LocalManager::processUpgrade] Executing process hot upgrade request.\n");
+  signalEvent(MGMT_EVENT_HANDOFF, "processUpgrade");
+  return;
+}
+
 void
 LocalManager::rollLogFiles()
 {
@@ -307,6 +322,9 @@ LocalManager::LocalManager(char * /* mpath ATS_UNUSED */, bool proxy_on)
   watched_process_fd = -1;
   proxy_launch_pid = -1;
 
+  draining_process_fd = -1;
+  draining_process_pid = -1;
+
   return;
 }
 
@@ -443,6 +461,20 @@ LocalManager::pollMgmtProcessServer()
   int wccp_fd = wccp_cache.getSocket();
 #endif
 
+  // Reap the old process of a hot upgrade once it has drained
+  if (draining_process_pid != -1) {
+    int estatus;
+
+    if (waitpid(draining_process_pid, &estatus, WNOHANG) == draining_process_pid) {
+      mgmt_log("[LocalManager::pollMgmtProcessServer] Drained server process %d exited\n", draining_process_pid);
+      if (draining_process_fd != -1) {
+        close_socket(draining_process_fd);
+        draining_process_fd = -1;
+      }
+      draining_process_pid = -1;
+    }
+  }
+
   while (1) {
     // poll only
     timeout.tv_sec = process_server_timeout_secs;
@@ -451,6 +483,17 @@ LocalManager::pollMgmtProcessServer()
     FD_SET(process_server_sockfd, &fdlist);
     if (watched_process_fd != -1) FD_SET(watched_process_fd, &fdlist);
 
+    // Wake up for written configuration files, and when they have settled
+    int config_watch_fd = configFiles->getWatchFd();
+    if (config_watch_fd != -1) {
+      int settle_msecs = configFiles->checkWatchedFiles();
+      FD_SET(config_watch_fd, &fdlist);
+      if (settle_msecs >= 0 && settle_msecs < timeout.tv_sec * 1000 + timeout.tv_usec / 1000) {
+        timeout.tv_sec = settle_msecs / 1000;
+        timeout.tv_usec = (settle_msecs % 1000) * 1000;
+      }
+    }
+
 #if TS_HAS_WCCP
     // Only run WCCP housekeeping while we have a server process.
     // Note: The WCCP socket is opened iff WCCP is configured.
@@ -472,6 +515,10 @@ LocalManager::pollMgmtProcessServer()
         --num;
       }
 #endif
+      if (config_watch_fd != -1 && FD_ISSET(config_watch_fd, &fdlist)) {
+        configFiles->readWatchEvents();
+        --num;
+      }
       if (FD_ISSET(process_server_sockfd, &fdlist)) {   /* New connection */
         int clientLen = sizeof(clientAddr);
         int new_sockfd = mgmt_accept(process_server_sockfd,
@@ -701,6 +748,33 @@ LocalManager::handleMgmtMsgFromProcesses(MgmtMessageHdr * mh)
     alarm_keeper->signalAlarm(MGMT_ALARM_SAC_SERVER_DOWN, data_raw);
     break;
 
+    // Hot upgrade: the old process has given up the cache and keeps serving
+    // on its own, so the main loop starts the new one.
+  case MGMT_SIGNAL_PROXY_HANDED_OFF:
+    mgmt_log("[LocalManager::handleMgmtMsgFromProcesses] Server process %d handed off\n", watched_process_pid);
+    draining_process_fd = watched_process_fd;
+    draining_process_pid = watched_process_pid;
+    fcntl(draining_process_fd, F_SETFD, FD_CLOEXEC);    /* Not for the new process */
+    watched_process_fd = watched_process_pid = -1;
+    proxy_running--;
+    proxy_started_at = -1;
+    RecSetRecordInt("proxy.node.proxy_running", 0);
+    break;
+  case MGMT_SIGNAL_PROXY_PORTS_READY:
+    if (draining_process_fd != -1) {
+      MgmtMessageHdr mh_drain;
+
+      mgmt_log("[LocalManager::handleMgmtMsgFromProcesses] Draining server process %d\n", draining_process_pid);
+      mh_drain.msg_id = MGMT_EVENT_DRAIN;
+      mh_drain.data_len = 0;
+      if (mgmt_write_pipe(draining_process_fd, (char *) &mh_drain, sizeof(MgmtMessageHdr)) <= 0) {
+        mgmt_elog(stderr, "[LocalManager::handleMgmtMsgFromProcesses] Error writing drain message\n");
+      }
+      close_socket(draining_process_fd);
+      draining_process_fd = -1;
+    }
+    break;
+
   default:
     break;
   }
@@ -748,6 +822,13 @@ LocalManager::sendMgmtMsgToProcesses(MgmtMessageHdr * mh)
   case MGMT_EVENT_BOUNCE:      /* Just bouncing the cluster, have it exit well restart */
     mh->msg_id = MGMT_EVENT_SHUTDOWN;
     break;
+  case MGMT_EVENT_HANDOFF:
+    if (draining_process_pid != -1) {
+      mgmt_elog(stderr, "[LocalManager::sendMgmtMsgToProcesses] Upgrade ignored, process %d is still draining\n",
+                draining_process_pid);
+      return;
+    }
+    break;
   case MGMT_EVENT_ROLL_LOG_FILES:
     mgmt_log("[LocalManager::SendMgmtMsgsToProcesses]Event is being constructed .\n");
     break;
@@ -1201,6 +1282,18 @@ LocalManager::bindProxyPort(HttpProxyPort& port)
     _exit(1);
   }
 
+#ifdef SO_REUSEPORT
+  {
+    bool found;
+    // traffic_server binds a socket per event thread to this address.
+    if (REC_readInteger("proxy.config.exec_thread.listen", &found) > 0 && found) {
+      if (setsockopt(port.m_fd, SOL_SOCKET, SO_REUSEPORT, (char *) &one, sizeof(int)) < 0) {
+        mgmt_elog(stderr, "[bindProxyPort] Unable to set SO_REUSEPORT: %d : %s\n", port.m_port, strerror(errno));
+      }
+    }
+  }
+#endif
+
   if (port.m_inbound_transparent_p) {
 #if TS_USE_TPROXY
     Debug("http_tproxy", "Listen port %d inbound transparency enabled.\n", port.m_port);
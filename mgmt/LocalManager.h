@@ -91,6 +91,7 @@ public:
   void processShutdown(bool mainThread = false);
   void processRestart();
   void processBounce();
+  void processUpgrade();
   void rollLogFiles();
   void clearStats(const char *name = NULL);
 
@@ -147,6 +148,10 @@ public:
   volatile int internal_ticker;
   volatile pid_t watched_process_pid;
 
+  // During a hot upgrade, the old process that is finishing its connections
+  volatile int draining_process_fd;
+  volatile pid_t draining_process_pid;
+
 #ifdef MGMT_USE_SYSLOG
   int syslog_facility;
 #endif
@@ -105,6 +105,7 @@ static void SignalAlrmHandler(int sig);
 #endif
 
 static volatile int sigHupNotifier = 0;
+static volatile int sigUsr1Notifier = 0;
 static volatile int sigUsr2Notifier = 0;
 static void SigChldHandler(int sig);
 
@@ -194,6 +195,7 @@ initSignalHandlers()
   //  to check errno for EINTR
   sigHandler.sa_flags = SA_RESTART;
   sigaction(SIGHUP, &sigHandler, NULL);
+  sigaction(SIGUSR1, &sigHandler, NULL);
   sigaction(SIGUSR2, &sigHandler, NULL);
 
   // Don't block the signal on entry to the signal
@@ -234,6 +236,7 @@ initSignalHandlers()
   //
   sigfillset(&sigsToBlock);
   sigdelset(&sigsToBlock, SIGHUP);
+  sigdelset(&sigsToBlock, SIGUSR1);
   sigdelset(&sigsToBlock, SIGUSR2);
   sigdelset(&sigsToBlock, SIGINT);
   sigdelset(&sigsToBlock, SIGQUIT);
@@ -662,6 +665,7 @@ main(int argc, char **argv)
   configFiles = new FileManager();
   initializeRegistry();
   configFiles->registerCallback(fileUpdated);
+  configFiles->watchFiles();
 
   // RecLocal's 'sync_thr' depends on 'configFiles', so we can't
   // stat the 'sync_thr' until 'configFiles' has been initialized.
@@ -751,6 +755,12 @@ main(int argc, char **argv)
       sigHupNotifier = 0;
       mgmt_log(stderr, "[main] Reading Configuration Files Reread\n");
     }
+    // Check for SIGUSR1, a hot upgrade of traffic_server
+    if (sigUsr1Notifier != 0) {
+      mgmt_log(stderr, "[main] Upgrading the server process due to SIGUSR1\n");
+      lmgmt->processUpgrade();
+      sigUsr1Notifier = 0;
+    }
     // Check for SIGUSR2
     if (sigUsr2Notifier != 0) {
       ink_stack_trace_dump();
@@ -891,6 +901,11 @@ SignalHandler(int sig)
     return;
   }
 
+  if (sig == SIGUSR1) {
+    sigUsr1Notifier = 1;
+    return;
+  }
+
   if (sig == SIGUSR2) {
     sigUsr2Notifier = 1;
     return;
@@ -907,6 +922,12 @@ SignalHandler(int sig)
         waitpid(lmgmt->watched_process_pid, &status, 0);
       }
     }
+    if (lmgmt->draining_process_pid != -1) {
+      if (sig == SIGTERM || sig == SIGINT) {
+        kill(lmgmt->draining_process_pid, sig);
+        waitpid(lmgmt->draining_process_pid, &status, 0);
+      }
+    }
     lmgmt->mgmtCleanup();
   }
 
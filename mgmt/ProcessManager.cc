@@ -67,7 +67,7 @@ startProcessManager(void *arg)
 }                               /* End startProcessManager */
 
 ProcessManager::ProcessManager(bool rlm, char * /* mpath ATS_UNUSED */):
-BaseManager(), require_lm(rlm), mgmt_sync_key(0), local_manager_sockfd(0), cbtable(NULL)
+BaseManager(), require_lm(rlm), mgmt_sync_key(0), local_manager_sockfd(0), detached(false), cbtable(NULL)
 {
   ink_strlcpy(pserver_path, Layout::get()->runtimedir, sizeof(pserver_path));
   mgmt_signal_queue = create_queue();
@@ -148,12 +148,21 @@ ProcessManager::processSignalQueue()
   while (!queue_is_empty(mgmt_signal_queue)) {
     MgmtMessageHdr *mh = (MgmtMessageHdr *) dequeue(mgmt_signal_queue);
 
+    if (detached) {             /* The manager has moved on to the new process */
+      ats_free(mh);
+      continue;
+    }
+
     Debug("pmgmt", "[ProcessManager] ==> Signalling local manager '%d'\n", mh->msg_id);
 
     if (require_lm && mgmt_write_pipe(local_manager_sockfd, (char *) mh, sizeof(MgmtMessageHdr) + mh->data_len) <= 0) {
       mgmt_fatal(stderr, "[ProcessManager::processSignalQueue] Error writing message!");
       //ink_assert(enqueue(mgmt_signal_queue, mh));
     } else {
+      if (mh->msg_id == MGMT_SIGNAL_PROXY_HANDED_OFF) {
+        mgmt_log(stderr, "[ProcessManager::processSignalQueue] Handed off to a new process\n");
+        detached = true;
+      }
       ats_free(mh);
       ret = true;
     }
@@ -274,6 +283,10 @@ ProcessManager::pollLMConnection()
       // handle EOF
       if (res == 0) {
         close_socket(local_manager_sockfd);
+        if (detached) {         /* Expected once the drain is under way */
+          require_lm = false;
+          return;
+        }
         mgmt_fatal(stderr, "[ProcessManager::pollLMConnection] Lost Manager EOF!");
       }
 
@@ -330,6 +343,12 @@ ProcessManager::handleMgmtMsgFromLM(MgmtMessageHdr * mh)
   case MGMT_EVENT_LIBRECORDS:
     signalMgmtEntity(MGMT_EVENT_LIBRECORDS, data_raw, mh->data_len);
     break;
+  case MGMT_EVENT_HANDOFF:
+    signalMgmtEntity(MGMT_EVENT_HANDOFF);
+    break;
+  case MGMT_EVENT_DRAIN:
+    signalMgmtEntity(MGMT_EVENT_DRAIN);
+    break;
   default:
     mgmt_elog(stderr, "[ProcessManager::pollLMConnection] unknown type %d\n", mh->msg_id);
     break;
@@ -97,6 +97,10 @@ public:
 
   int local_manager_sockfd;
 
+  // After a hot upgrade hand off, the manager watches the new process
+  // and this one no longer reports to it.
+  volatile bool detached;
+
 private:
   ConfigUpdateCbTable * cbtable;
 };                              /* End class ProcessManager */
@@ -27,6 +27,41 @@
 
 ConfigProcessor configProcessor;
 
+enum
+{
+  config_reloads_stat,
+  config_reload_time_stat,
+  config_stat_count
+};
+
+static RecRawStatBlock *config_rsb = NULL;
+
+void
+ConfigReloadTimer::init()
+{
+  config_rsb = RecAllocateRawStatBlock((int) config_stat_count);
+  RecRegisterRawStat(config_rsb, RECT_PROCESS, "proxy.process.config.reloads",
+                     RECD_COUNTER, RECP_NON_PERSISTENT, (int) config_reloads_stat, RecRawStatSyncCount);
+  RecRegisterRawStat(config_rsb, RECT_PROCESS, "proxy.process.config.reload_time",
+                     RECD_FLOAT, RECP_NON_PERSISTENT, (int) config_reload_time_stat, RecRawStatSyncHrTimeAvg);
+}
+
+ConfigReloadTimer::ConfigReloadTimer(const char * aname)
+  : name(aname), start(ink_get_hrtime())
+{
+}
+
+ConfigReloadTimer::~ConfigReloadTimer()
+{
+  ink_hrtime elapsed = ink_get_hrtime() - start;
+
+  Debug("config", "reload %s took %" PRId64 " msec", name, (int64_t) ink_hrtime_to_msec(elapsed));
+  if (config_rsb) {
+    RecIncrGlobalRawStat(config_rsb, (int) config_reloads_stat, 1);
+    RecIncrGlobalRawStat(config_rsb, (int) config_reload_time_stat, elapsed);
+  }
+}
+
 
 void *
 config_int_cb(void *data, void *value)
@@ -149,8 +184,10 @@ ConfigProcessor::set(unsigned int id, ConfigInfo * info)
     old_info = (ConfigInfo *) infos[idx];
   } while (!ink_atomic_cas( & infos[idx], old_info, info));
 
+  // Readers acquire without a lock, so the old config is only dropped
+  // after a grace period, and deleted by the last of its readers.
   if (old_info) {
-    eventProcessor.schedule_in(NEW(new ConfigInfoReleaser(id, old_info)), HRTIME_SECONDS(60));
+    eventProcessor.schedule_in(NEW(new ConfigInfoReleaser(id, old_info)), CONFIG_RELEASE_DELAY, ET_TASK);
   }
 
   return id;
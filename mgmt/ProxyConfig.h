@@ -34,6 +34,7 @@
 #include "libts.h"
 #include "ProcessManager.h"
 #include "I_EventSystem.h"
+#include "I_Tasks.h"
 
 class ProxyMutex;
 
@@ -54,6 +55,10 @@ pmgmt->registerMgmtCallback(_signal,_fn,_data)
 
 #define MAX_CONFIGS  100
 
+// How long a replaced config stays alive for the readers that acquired it
+// before the swap.
+#define CONFIG_RELEASE_DELAY HRTIME_SECONDS(60)
+
 struct ConfigInfo
 {
   volatile int m_refcount;
@@ -91,13 +96,29 @@ public:
   int ninfos;
 };
 
+// Times a config reload, from construction to destruction, into the
+// proxy.process.config.reloads and proxy.process.config.reload_time stats.
+struct ConfigReloadTimer
+{
+  explicit ConfigReloadTimer(const char * name);
+  ~ConfigReloadTimer();
+
+  static void init();
+
+  const char * name;
+  ink_hrtime start;
+};
+
 // A Continuation wrapper that calls the static reconfigure() method of the given class.
 template <typename UpdateClass>
 struct ConfigUpdateContinuation : public Continuation
 {
 
   int update(int /* etype */, void * /* data */) {
-    UpdateClass::reconfigure();
+    {
+      ConfigReloadTimer timer(__PRETTY_FUNCTION__);
+      UpdateClass::reconfigure();
+    }
     delete this;
     return EVENT_DONE;
   }
@@ -108,9 +129,12 @@ struct ConfigUpdateContinuation : public Continuation
 
 };
 
+// Configs are rebuilt on the task threads, so that a large one does not hold
+// up the net threads. Readers keep the old config until the swap, see
+// ConfigProcessor::set().
 template <typename UpdateClass> int
 ConfigScheduleUpdate(ProxyMutex * mutex) {
-  eventProcessor.schedule_imm(NEW(new ConfigUpdateContinuation<UpdateClass>(mutex)), ET_CALL);
+  eventProcessor.schedule_imm(NEW(new ConfigUpdateContinuation<UpdateClass>(mutex)), ET_TASK);
   return 0;
 }
 
@@ -40,6 +40,9 @@
 #define TOKENCOUNT 10
 #define OVECOUNT 30
 #define PATTERNCOUNT 30
+#define URLBUFSIZE 2048
+#define KEYPARAMCOUNT 16
+#define KEYHEADERCOUNT 8
 #define PLUGIN_NAME "cacheurl"
 
 typedef struct {
@@ -51,15 +54,48 @@ typedef struct {
     int *tokenoffset; /* Array of $x token offsets */
 } regex_info;
 
+typedef struct {
+    const char *name;
+    int len;
+} key_name;
+
+enum {
+    KEY_QUERY_ALL,   /* Keep the whole query string */
+    KEY_QUERY_NONE,  /* Drop the query string */
+    KEY_QUERY_ALLOW, /* Keep only the listed parameters */
+    KEY_QUERY_DENY   /* Keep all but the listed parameters */
+};
+
+/* A declarative rule, which builds the cache key straight from the
+ * components of the request URL. All the strings point in to line. */
+typedef struct {
+    char *line;         /* Copy of the rule's config line */
+    const char *match_host; /* Host to match, NULL for any */
+    int match_host_len;
+    const char *match_path; /* Path prefix to match (no leading /), NULL for any */
+    int match_path_len;
+    const char *host;   /* Host to put in the key, NULL for the request's */
+    int host_len;
+    int query;          /* KEY_QUERY_* */
+    key_name params[KEYPARAMCOUNT]; /* Query parameters allowed or denied */
+    int paramcount;
+    key_name headers[KEYHEADERCOUNT]; /* Request headers added to the key */
+    int headercount;
+} key_rule;
+
 typedef struct {
     regex_info *pr[PATTERNCOUNT]; /* Pattern/replacement list */
+    key_rule *kr[PATTERNCOUNT]; /* Key rules, set where pr is not */
     int patterncount; /* Number of patterns */
     //pr_list *next; /* Link to next set of patterns, if any */
 } pr_list;
 
 static TSTextLogObject log = NULL;
 
-static int regex_substitute(char **buf, char *str, regex_info *info) {
+/* Writes the substitution in to *buf, which is used as is if it has room
+ * for bufsize bytes and is replaced by a TSmalloc()'ed string otherwise. */
+static int regex_substitute(char **buf, int bufsize, const char *str, int len,
+        regex_info *info) {
     int matchcount;
     int ovector[OVECOUNT]; /* Locations of matches in regex */
 
@@ -69,7 +105,7 @@ static int regex_substitute(char **buf, char *str, regex_info *info) {
     int prev;
 
     /* Perform the regex matching */
-    matchcount = pcre_exec(info->re, NULL, str, strlen(str), 0, 0, ovector,
+    matchcount = pcre_exec(info->re, NULL, str, len, 0, 0, ovector,
             OVECOUNT);
     if (matchcount < 0) {
         switch (matchcount) {
@@ -90,7 +126,7 @@ static int regex_substitute(char **buf, char *str, regex_info *info) {
         }
     }
 
-    /* malloc the replacement string */
+    /* Size the replacement string */
     replacelen = strlen(info->replacement);
     replacelen -= info->tokcount * 2; /* Subtract $1, $2 etc... */
     for (i=0; i<info->tokcount; i++) {
@@ -98,7 +134,9 @@ static int regex_substitute(char **buf, char *str, regex_info *info) {
                 ovector[info->tokens[i]*2]);
     }
     replacelen++; /* Null terminator */
-    *buf = TSmalloc(replacelen);
+    if (replacelen > bufsize) {
+        *buf = TSmalloc(replacelen);
+    }
 
     /* perform string replacement */
     offset = 0; /* Where we are adding new data in the string */
@@ -194,6 +232,232 @@ static int regex_compile(regex_info **buf, char *pattern, char *replacement) {
     return status;
 }
 
+/* Splits a comma separated list in place in to names. */
+static int key_names_compile(key_name *names, int maxcount, char *list) {
+    char *saveptr = NULL;
+    char *name;
+    int count = 0;
+
+    for (name = strtok_r(list, ",", &saveptr); name;
+            name = strtok_r(NULL, ",", &saveptr)) {
+        if (count >= maxcount) {
+            TSError("[%s] Error: too many names in list (max: %d)\n",
+                    PLUGIN_NAME, maxcount);
+            return -1;
+        }
+        names[count].name = name;
+        names[count].len = strlen(name);
+        count++;
+    }
+    return count;
+}
+
+/* Compiles the arguments of a "key" line:
+ *   key <host|*> <path prefix|*> [host=<host>] [no-query]
+ *       [query-allow=<a,b,..>] [query-deny=<a,b,..>] [header=<name>]... */
+static int key_compile(key_rule **buf, const char *args) {
+    char *saveptr = NULL;
+    char *tok;
+    int status = 1;
+    key_rule *rule = TSmalloc(sizeof(key_rule));
+
+    memset(rule, 0, sizeof(key_rule));
+    rule->line = TSstrdup(args);
+    rule->query = KEY_QUERY_ALL;
+
+    tok = strtok_r(rule->line, " \t", &saveptr);
+    if (tok && strcmp(tok, "*")) {
+        rule->match_host = tok;
+        rule->match_host_len = strlen(tok);
+    }
+    tok = tok ? strtok_r(NULL, " \t", &saveptr) : NULL;
+    if (!tok) {
+        TSError("[%s] Error: key rule needs a host and a path prefix\n",
+                PLUGIN_NAME);
+        status = 0;
+    } else if (strcmp(tok, "*")) {
+        if (*tok == '/') {
+            tok++;
+        }
+        rule->match_path = tok;
+        rule->match_path_len = strlen(tok);
+    }
+
+    while (status && (tok = strtok_r(NULL, " \t", &saveptr))) {
+        if (!strncmp(tok, "host=", 5)) {
+            rule->host = tok + 5;
+            rule->host_len = strlen(rule->host);
+        } else if (!strcmp(tok, "no-query")) {
+            rule->query = KEY_QUERY_NONE;
+        } else if (!strncmp(tok, "query-allow=", 12) ||
+                !strncmp(tok, "query-deny=", 11)) {
+            rule->query = (tok[6] == 'a') ? KEY_QUERY_ALLOW : KEY_QUERY_DENY;
+            rule->paramcount = key_names_compile(rule->params, KEYPARAMCOUNT,
+                    strchr(tok, '=') + 1);
+            if (rule->paramcount < 0) {
+                status = 0;
+            }
+        } else if (!strncmp(tok, "header=", 7)) {
+            if (rule->headercount >= KEYHEADERCOUNT) {
+                TSError("[%s] Error: too many headers in key rule (max: %d)\n",
+                        PLUGIN_NAME, KEYHEADERCOUNT);
+                status = 0;
+            } else {
+                rule->headers[rule->headercount].name = tok + 7;
+                rule->headers[rule->headercount].len = strlen(tok + 7);
+                rule->headercount++;
+            }
+        } else {
+            TSError("[%s] Error: unknown key rule option '%s'\n",
+                    PLUGIN_NAME, tok);
+            status = 0;
+        }
+    }
+
+    if (status) {
+        *buf = rule;
+    } else {
+        TSfree(rule->line);
+        TSfree(rule);
+    }
+    return status;
+}
+
+static int key_rule_match(const key_rule *rule, const char *host, int host_len,
+        const TSUrlView *view) {
+    if (rule->match_host && (host_len != rule->match_host_len ||
+                strncasecmp(host, rule->match_host, host_len))) {
+        return 0;
+    }
+    if (rule->match_path && (view->path_len < rule->match_path_len ||
+                memcmp(view->path, rule->match_path, rule->match_path_len))) {
+        return 0;
+    }
+    return 1;
+}
+
+static int key_name_listed(const key_rule *rule, const char *name, int len) {
+    int i;
+    for (i=0; i<rule->paramcount; i++) {
+        if (rule->params[i].len == len &&
+                !memcmp(rule->params[i].name, name, len)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int key_append(char *key, int *key_len, const char *str, int len) {
+    if (*key_len + len >= URLBUFSIZE) {
+        return 0;
+    }
+    memcpy(key + *key_len, str, len);
+    *key_len += len;
+    return 1;
+}
+
+/* Appends a header value, escaping what would end or split the query. */
+static int key_append_escaped(char *key, int *key_len, const char *str,
+        int len) {
+    static const char hex[] = "0123456789ABCDEF";
+    int i;
+
+    for (i=0; i<len; i++) {
+        unsigned char c = str[i];
+        if (c <= ' ' || c >= 0x7f || c == '%' || c == '&' || c == '#') {
+            if (*key_len + 3 >= URLBUFSIZE) {
+                return 0;
+            }
+            key[(*key_len)++] = '%';
+            key[(*key_len)++] = hex[c >> 4];
+            key[(*key_len)++] = hex[c & 0xf];
+        } else if (!key_append(key, key_len, str + i, 1)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Builds the key of a matching rule in to key, which holds URLBUFSIZE
+ * bytes. Returns 0 if it does not fit. */
+static int key_build(const key_rule *rule, const TSUrlView *view,
+        const char *host, int host_len, TSMBuffer bufp, TSMLoc hdr_loc,
+        char *key, int *key_len) {
+    const char *scheme = view->scheme ? view->scheme : "http";
+    int scheme_len = view->scheme ? view->scheme_len : 4;
+    int default_port = (scheme_len == 5 && !strncasecmp(scheme, "https", 5)) ?
+        443 : 80;
+    char sep = '?';
+    int ok;
+    int i;
+
+    *key_len = 0;
+    ok = key_append(key, key_len, scheme, scheme_len) &&
+        key_append(key, key_len, "://", 3) &&
+        (rule->host ? key_append(key, key_len, rule->host, rule->host_len) :
+         key_append(key, key_len, host, host_len));
+    if (ok && view->port && view->port != default_port) {
+        char port[16];
+        ok = key_append(key, key_len, port,
+                snprintf(port, sizeof(port), ":%d", view->port));
+    }
+    ok = ok && key_append(key, key_len, "/", 1) &&
+        key_append(key, key_len, view->path, view->path_len);
+
+    if (ok && view->query_len > 0) {
+        if (rule->query == KEY_QUERY_ALL) {
+            ok = key_append(key, key_len, "?", 1) &&
+                key_append(key, key_len, view->query, view->query_len);
+            sep = '&';
+        } else if (rule->query != KEY_QUERY_NONE) {
+            const char *param = view->query;
+            const char *end = view->query + view->query_len;
+
+            while (ok && param < end) {
+                const char *param_end = memchr(param, '&', end - param);
+                const char *name_end;
+                int listed;
+
+                if (!param_end) {
+                    param_end = end;
+                }
+                name_end = memchr(param, '=', param_end - param);
+                if (!name_end) {
+                    name_end = param_end;
+                }
+                listed = key_name_listed(rule, param, name_end - param);
+                if (param_end > param &&
+                        (rule->query == KEY_QUERY_ALLOW) == listed) {
+                    ok = key_append(key, key_len, &sep, 1) &&
+                        key_append(key, key_len, param, param_end - param);
+                    sep = '&';
+                }
+                param = param_end + 1;
+            }
+        }
+    }
+
+    for (i=0; ok && i<rule->headercount; i++) {
+        TSMLoc field_loc = TSMimeHdrFieldFind(bufp, hdr_loc,
+                rule->headers[i].name, rule->headers[i].len);
+        if (field_loc) {
+            int value_len = 0;
+            const char *value = TSMimeHdrFieldValueStringGet(bufp, hdr_loc,
+                    field_loc, -1, &value_len);
+            ok = key_append(key, key_len, &sep, 1) &&
+                key_append(key, key_len, rule->headers[i].name,
+                        rule->headers[i].len) &&
+                key_append(key, key_len, "=", 1) &&
+                key_append_escaped(key, key_len, value, value_len);
+            sep = '&';
+            TSHandleMLocRelease(bufp, hdr_loc, field_loc);
+        }
+    }
+
+    key[*key_len] = 0;
+    return ok;
+}
+
 static pr_list* load_config_file(const char *config_file) {
     char buffer[1024];
     char default_config_file[1024];
@@ -206,6 +470,7 @@ static pr_list* load_config_file(const char *config_file) {
     int lineno = 0;
     int retval;
     regex_info *info = 0;
+    key_rule *rule = 0;
 
     if (!config_file) {
         /* Default config file of plugins/cacheurl.config */
@@ -234,6 +499,24 @@ static pr_list* load_config_file(const char *config_file) {
             /* Malformed line - skip */
             continue;
         }
+        if (!strncmp(buffer, "key", 3) && (buffer[3] == ' ' || buffer[3] == '\t')) {
+            /* Declarative key rule */
+            if (prl->patterncount >= PATTERNCOUNT) {
+                TSError("[%s] Warning, too many patterns - skipping the rest"
+                        "(max: %d)\n", PLUGIN_NAME, PATTERNCOUNT);
+                break;
+            }
+            TSDebug(PLUGIN_NAME, "Adding key rule: '%s'\n", buffer + 4);
+            if (!key_compile(&rule, buffer + 4)) {
+                TSError("[%s] Error compiling key rule on line %d. Skipping.\n",
+                        PLUGIN_NAME, lineno);
+                continue;
+            }
+            prl->pr[prl->patterncount] = NULL;
+            prl->kr[prl->patterncount] = rule;
+            prl->patterncount++;
+            continue;
+        }
         /* Split line into two parts based on whitespace */
         /* Find first whitespace */
         spstart = strstr(buffer, " ");
@@ -272,6 +555,7 @@ static pr_list* load_config_file(const char *config_file) {
         if (!retval) {
             TSError("[%s] Error precompiling regex/replacement. Skipping.\n",
                     PLUGIN_NAME);
+            continue;
         }
         // TODO - remove patterncount and make pr_list infinite (linked list)
         if (prl->patterncount >= PATTERNCOUNT) {
@@ -281,62 +565,113 @@ static pr_list* load_config_file(const char *config_file) {
             break;
         }
         prl->pr[prl->patterncount] = info;
+        prl->kr[prl->patterncount] = NULL;
         prl->patterncount++;
     }
     TSfclose(fh);
-    // Make sure the last element is null
-    if (prl->patterncount < PATTERNCOUNT) {
-        prl->pr[prl->patterncount] = NULL;
-    }
     return prl;
 }
 
-static int rewrite_cacheurl(pr_list *prl, TSHttpTxn txnp) {
+static int rewrite_cacheurl(pr_list *prl, TSHttpTxn txnp, TSMBuffer bufp,
+        TSMLoc hdr_loc, TSMLoc url_loc) {
     int ok = 1;
+    char newurlbuf[URLBUFSIZE];
     char *newurl = 0;
+    int newurl_length = 0;
     int retval;
 
-    char *url;
+    /* The URL is only printed for regex patterns, in to a local buffer,
+     * falling back to an allocated copy if it doesn't fit. */
+    char urlbuf[URLBUFSIZE];
+    char *url = 0;
     int url_length;
+
+    /* Key rules read the URL components in place */
+    TSUrlView view;
+    const char *host = 0;
+    int host_len = 0;
+    int have_view = 0;
     int i;
-    if (ok) {
-        url = TSHttpTxnEffectiveUrlStringGet(txnp, &url_length);
-        if (!url) {
-            TSError("[%s] couldn't retrieve request url\n",
-                    PLUGIN_NAME);
-            ok = 0;
-        }
-    }
 
-    if (ok) {
-        i=0;
-        while (i < prl->patterncount && prl->pr[i]) {
-            retval = regex_substitute(&newurl, url, prl->pr[i]);
-            if (retval) {
-                /* Successful match/substitution */
+    for (i=0; ok && i < prl->patterncount; i++) {
+        if (prl->kr[i]) {
+            if (!have_view) {
+                if (TSUrlViewGet(bufp, url_loc, &view) != TS_SUCCESS) {
+                    TSError("[%s] couldn't retrieve request url\n",
+                            PLUGIN_NAME);
+                    ok = 0;
+                    break;
+                }
+                host = view.host;
+                host_len = view.host_len;
+                if (!host_len) {
+                    TSMLoc field_loc = TSMimeHdrFieldFind(bufp, hdr_loc,
+                            TS_MIME_FIELD_HOST, TS_MIME_LEN_HOST);
+                    if (field_loc) {
+                        host = TSMimeHdrFieldValueStringGet(bufp, hdr_loc,
+                                field_loc, -1, &host_len);
+                        TSHandleMLocRelease(bufp, hdr_loc, field_loc);
+                    }
+                }
+                have_view = 1;
+            }
+            if (!key_rule_match(prl->kr[i], host, host_len, &view)) {
+                continue;
+            }
+            if (!key_build(prl->kr[i], &view, host, host_len, bufp, hdr_loc,
+                        newurlbuf, &newurl_length)) {
+                TSError("[%s] Cache key longer than %d bytes, not rewriting\n",
+                        PLUGIN_NAME, URLBUFSIZE - 1);
                 break;
             }
-            i++;
+            newurl = newurlbuf;
+            break;
         }
-        if (newurl) {
-            if (log) {
-                TSTextLogObjectWrite(log,
-                        "Rewriting cache URL for %s to %s", url,
-                        newurl);
+
+        if (!url) {
+            if (TSHttpTxnEffectiveUrlStringPrint(txnp, urlbuf, URLBUFSIZE - 1,
+                        &url_length) == TS_SUCCESS) {
+                urlbuf[url_length] = 0;
+                url = urlbuf;
+            } else {
+                url = TSHttpTxnEffectiveUrlStringGet(txnp, &url_length);
             }
-            TSDebug(PLUGIN_NAME, "Rewriting cache URL for %s to %s\n",
-                    url, newurl);
-            if (TSCacheUrlSet(txnp, newurl, strlen(newurl))
-                    != TS_SUCCESS) {
-                TSError("[%s] Unable to modify cache url from "
-                        "%s to %s\n", PLUGIN_NAME, url, newurl);
+            if (!url) {
+                TSError("[%s] couldn't retrieve request url\n",
+                        PLUGIN_NAME);
                 ok = 0;
+                break;
             }
         }
+        newurl = newurlbuf;
+        retval = regex_substitute(&newurl, URLBUFSIZE, url, url_length,
+                prl->pr[i]);
+        if (retval) {
+            /* Successful match/substitution */
+            newurl_length = strlen(newurl);
+            break;
+        }
+        newurl = 0;
+    }
+
+    if (newurl) {
+        if (log) {
+            TSTextLogObjectWrite(log,
+                    "Rewriting cache URL for %s to %s", url ? url : "key rule",
+                    newurl);
+        }
+        TSDebug(PLUGIN_NAME, "Rewriting cache URL for %s to %s\n",
+                url ? url : "key rule", newurl);
+        if (TSCacheUrlSet(txnp, newurl, newurl_length)
+                != TS_SUCCESS) {
+            TSError("[%s] Unable to modify cache url to %s\n", PLUGIN_NAME,
+                    newurl);
+            ok = 0;
+        }
     }
     /* Clean up */
-    if (url) TSfree(url);
-    if (newurl) TSfree(newurl);
+    if (url && url != urlbuf) TSfree(url);
+    if (newurl && newurl != newurlbuf) TSfree(newurl);
     return ok;
 }
 
@@ -349,7 +684,26 @@ static int handle_hook(TSCont contp, TSEvent event, void *edata) {
 
     switch (event) {
         case TS_EVENT_HTTP_READ_REQUEST_HDR:
-            ok = rewrite_cacheurl(prl, txnp);
+            {
+                TSMBuffer bufp;
+                TSMLoc hdr_loc, url_loc;
+
+                if (TSHttpTxnClientReqGet(txnp, &bufp, &hdr_loc) != TS_SUCCESS) {
+                    TSError("[%s] couldn't retrieve client request\n",
+                            PLUGIN_NAME);
+                    ok = 0;
+                } else {
+                    if (TSHttpHdrUrlGet(bufp, hdr_loc, &url_loc) != TS_SUCCESS) {
+                        TSError("[%s] couldn't retrieve request url\n",
+                                PLUGIN_NAME);
+                        ok = 0;
+                    } else {
+                        ok = rewrite_cacheurl(prl, txnp, bufp, hdr_loc, url_loc);
+                        TSHandleMLocRelease(bufp, hdr_loc, url_loc);
+                    }
+                    TSHandleMLocRelease(bufp, TS_NULL_MLOC, hdr_loc);
+                }
+            }
             TSHttpTxnReenable(txnp, TS_EVENT_HTTP_CONTINUE);
             break;
         default:
@@ -417,20 +771,25 @@ void TSRemapDeleteInstance(void *ih) {
     // Clean up
     TSDebug(PLUGIN_NAME, "Deleting remap instance");
     pr_list *prl = (pr_list *)ih;
-    int i=0;
-    while (prl->pr[i]) {
+    int i;
+    for (i=0; i<prl->patterncount; i++) {
+        if (prl->kr[i]) {
+            TSfree(prl->kr[i]->line);
+            TSfree(prl->kr[i]);
+            continue;
+        }
         if (prl->pr[i]->tokens) TSfree(prl->pr[i]->tokens);
         if (prl->pr[i]->tokenoffset) TSfree(prl->pr[i]->tokenoffset);
         if (prl->pr[i]->re) pcre_free(prl->pr[i]->re);
         TSfree(prl->pr[i]);
-        i++;
     }
     TSfree(prl);
 }
 
-TSRemapStatus TSRemapDoRemap(void* ih, TSHttpTxn rh, TSRemapRequestInfo *rri ATS_UNUSED) {
+TSRemapStatus TSRemapDoRemap(void* ih, TSHttpTxn rh, TSRemapRequestInfo *rri) {
     int ok;
-    ok = rewrite_cacheurl((pr_list *)ih, rh);
+    ok = rewrite_cacheurl((pr_list *)ih, rh, rri->requestBufp, rri->requestHdrp,
+            rri->requestUrl);
     if (ok) {
         return TSREMAP_NO_REMAP;
     } else {
@@ -42,15 +42,17 @@ struct RemapConfigs
   };
 
   RemapConfigs()
-    : _current(0)
+    : _current(0), _overlay(NULL)
   {
     memset(_items, 0, sizeof(_items));
   };
 
   bool parse_file(const char *fn);
+  bool build_overlay();
 
   Item _items[MAX_OVERRIDABLE_CONFIGS];
   int _current;
+  TSHttpConfigOverlay _overlay; // Shared by all transactions through this rule
 };
 
 // Helper functionfor the parser
@@ -173,6 +175,37 @@ RemapConfigs::parse_file(const char* fn)
   return (_current > 0);
 }
 
+// Turn the parsed configurations into an overlay, so that transactions
+// share one copy of them rather than each doing its own.
+bool
+RemapConfigs::build_overlay()
+{
+  _overlay = TSHttpConfigOverlayCreate();
+
+  for (int ix=0; ix < _current; ++ix) {
+    TSReturnCode ret = TS_ERROR;
+
+    switch (_items[ix]._type) {
+    case TS_RECORDDATATYPE_INT:
+      ret = TSHttpConfigOverlayIntSet(_overlay, _items[ix]._name, _items[ix]._data.rec_int);
+      TSDebug(PLUGIN_NAME, "Setting config id %d to %" PRId64"", _items[ix]._name, _items[ix]._data.rec_int);
+      break;
+    case TS_RECORDDATATYPE_STRING:
+      ret = TSHttpConfigOverlayStringSet(_overlay, _items[ix]._name, _items[ix]._data.rec_string, _items[ix]._data_len);
+      TSDebug(PLUGIN_NAME, "Setting config id %d to %s", _items[ix]._name, _items[ix]._data.rec_string);
+      break;
+    default:
+      break;
+    }
+    if (ret != TS_SUCCESS) {
+      TSError("conf_remap: unable to set config id %d", _items[ix]._name);
+      return false;
+    }
+  }
+
+  return true;
+}
+
 
 ///////////////////////////////////////////////////////////////////////////////
 // Initialize the plugin as a remap plugin.
@@ -204,10 +237,12 @@ TSRemapNewInstance(int argc, char* argv[], void** ih, char* /* errbuf ATS_UNUSED
   } else {
     RemapConfigs* conf = new(RemapConfigs);
 
-    if (conf->parse_file(argv[2])) {
+    if (conf->parse_file(argv[2]) && conf->build_overlay()) {
       *ih = static_cast<void*>(conf);
     } else {
       *ih = NULL;
+      if (conf->_overlay)
+        TSHttpConfigOverlayDestroy(conf->_overlay);
       delete conf;
     }
   }
@@ -224,6 +259,8 @@ TSRemapDeleteInstance(void* ih)
     if (TS_RECORDDATATYPE_STRING == conf->_items[ix]._type)
       TSfree(conf->_items[ix]._data.rec_string);
   }
+  if (conf->_overlay)
+    TSHttpConfigOverlayDestroy(conf->_overlay);
 
   delete conf;
 }
@@ -239,20 +276,7 @@ TSRemapDoRemap(void* ih, TSHttpTxn rh, TSRemapRequestInfo * /* rri ATS_UNUSED */
     RemapConfigs* conf = static_cast<RemapConfigs*>(ih);
     TSHttpTxn txnp = static_cast<TSHttpTxn>(rh);
 
-    for (int ix=0; ix < conf->_current; ++ix) {
-      switch (conf->_items[ix]._type) {
-      case TS_RECORDDATATYPE_INT:
-        TSHttpTxnConfigIntSet(txnp, conf->_items[ix]._name, conf->_items[ix]._data.rec_int);
-        TSDebug(PLUGIN_NAME, "Setting config id %d to %" PRId64"", conf->_items[ix]._name, conf->_items[ix]._data.rec_int);
-        break;
-      case TS_RECORDDATATYPE_STRING:
-        TSHttpTxnConfigStringSet(txnp, conf->_items[ix]._name, conf->_items[ix]._data.rec_string, conf->_items[ix]._data_len);
-        TSDebug(PLUGIN_NAME, "Setting config id %d to %s", conf->_items[ix]._name, conf->_items[ix]._data.rec_string);
-        break;
-      default:
-        break; // Error ?
-      }
-    }
+    TSHttpTxnConfigOverlaySet(txnp, conf->_overlay);
   }
 
   return TSREMAP_NO_REMAP; // This plugin never rewrites anything.
@@ -27,15 +27,19 @@
 
 #include "utils.h"
 #include <string>
+#include <map>
 #include <memory> // placement new
 #include <limits>
+#include <algorithm>
 #include <cstring>
 #include <cstdlib>
 #include <cstdio>
 
 #include <getopt.h>
+#include <pthread.h>
 #include <arpa/inet.h>
 #include <sys/param.h>
+#include <openssl/sha.h>
 #include <ts/remap.h>
 #include <ink_config.h>
 
@@ -53,18 +57,102 @@ static int          AuthTaggedRequestArg = -1;
 
 static TSCont       AuthOsDnsContinuation;
 
+// Request attributes that make up the authorization cache key.
+enum {
+    AUTH_KEY_AUTHORIZATION  = 1 << 0,
+    AUTH_KEY_COOKIE         = 1 << 1,
+    AUTH_KEY_HOST           = 1 << 2,
+    AUTH_KEY_PATH_PREFIX    = 1 << 3,
+};
+
+// The most decisions we keep for one set of options.
+#define AUTH_CACHE_MAX  16384
+
+// Marks an auth proxy request whose response Traffic Server may cache. We
+// remove it before the request goes out.
+#define AUTH_CACHEABLE_HEADER "X-AuthProxy-Cacheable"
+
+// Cache of positive authorization decisions. The key is a SHA-256 digest of
+// the request attributes, so we don't keep credentials around, and the value
+// is the time the decision expires.
+struct AuthDecisionCache
+{
+    pthread_mutex_t mutex;
+    std::map<std::string, time_t> entries;
+
+    AuthDecisionCache() {
+        pthread_mutex_init(&this->mutex, NULL);
+    }
+
+    ~AuthDecisionCache() {
+        pthread_mutex_destroy(&this->mutex);
+    }
+
+    bool lookup(const std::string& key, time_t now) {
+        std::map<std::string, time_t>::iterator e;
+        bool found = false;
+
+        pthread_mutex_lock(&this->mutex);
+        e = this->entries.find(key);
+        if (e != this->entries.end()) {
+            if (e->second > now) {
+                found = true;
+            } else {
+                this->entries.erase(e);
+            }
+        }
+        pthread_mutex_unlock(&this->mutex);
+        return found;
+    }
+
+    void insert(const std::string& key, time_t expires, time_t now) {
+        pthread_mutex_lock(&this->mutex);
+        if (this->entries.size() >= AUTH_CACHE_MAX) {
+            // Sweep out the expired decisions, and if that didn't help start
+            // over rather than growing without bound.
+            std::map<std::string, time_t>::iterator e = this->entries.begin();
+            while (e != this->entries.end()) {
+                if (e->second <= now) {
+                    this->entries.erase(e++);
+                } else {
+                    ++e;
+                }
+            }
+
+            if (this->entries.size() >= AUTH_CACHE_MAX) {
+                this->entries.clear();
+            }
+        }
+
+        this->entries[key] = expires;
+        pthread_mutex_unlock(&this->mutex);
+    }
+
+private:
+    AuthDecisionCache(const AuthDecisionCache&); // delete
+    AuthDecisionCache& operator=(const AuthDecisionCache&); // delete
+};
+
 struct AuthOptions
 {
     char *  hostname;
     int     hostport;
     bool    force;
     AuthRequestTransform transform;
+    unsigned cache_key;     // AUTH_KEY_* attributes, 0 to not cache decisions.
+    int     cache_ttl;      // Longest time we keep a decision, in seconds.
+    bool    cache_http;     // Let Traffic Server cache the auth proxy responses.
+    AuthDecisionCache * cache;
 
-    AuthOptions() : hostname(NULL), hostport(8080), force(false), transform(NULL) {
+    AuthOptions() : hostname(NULL), hostport(8080), force(false), transform(NULL),
+            cache_key(0), cache_ttl(300), cache_http(false), cache(NULL) {
     }
 
     ~AuthOptions() {
         TSfree(hostname);
+        if (cache) {
+            AuthDelete(cache);
+        }
     }
 };
 
@@ -154,6 +242,16 @@ static const StateTransition StateTableInit[] =
     { TS_EVENT_NONE, NULL, NULL }
 };
 
+// Return the options that apply to the given transaction.
+static const AuthOptions *
+AuthRequestOptions(TSHttpTxn txn)
+{
+    AuthOptions * opt;
+
+    opt = (AuthOptions *)TSHttpTxnArgGet(txn, AuthTaggedRequestArg);
+    return opt ? opt : AuthGlobalOptions;
+}
+
 struct AuthRequestContext
 {
     TSHttpTxn       txn;    // Original client transaction we are authorizing.
@@ -165,11 +263,14 @@ struct AuthRequestContext
     bool            is_head;// This is a HEAD request
     bool            read_body;
 
+    std::string     cache_key; // Authorization cache key, empty if not caching.
+
     const StateTransition * state;
 
     AuthRequestContext()
             : txn(NULL), cont(NULL), vconn(NULL), hparser(TSHttpParserCreate()),
-                rheader(), iobuf(TS_IOBUFFER_SIZE_INDEX_4K), is_head(false), read_body(true), state(NULL) {
+                rheader(), iobuf(TS_IOBUFFER_SIZE_INDEX_4K), is_head(false), read_body(true),
+                cache_key(), state(NULL) {
         this->cont = TSContCreate(dispatch, TSMutexCreate());
         TSContDataSet(this->cont, this);
     }
@@ -184,10 +285,7 @@ struct AuthRequestContext
     }
 
     const AuthOptions * options() const {
-        AuthOptions * opt;
-
-        opt = (AuthOptions *)TSHttpTxnArgGet(this->txn, AuthTaggedRequestArg);
-        return opt ? opt : AuthGlobalOptions;
+        return AuthRequestOptions(this->txn);
     }
 
     static AuthRequestContext * allocate();
@@ -272,6 +370,160 @@ AuthRequestIsHead(TSHttpTxn txn)
     return is_head;
 }
 
+// Add one request attribute to the authorization cache key. Absent attributes
+// hash differently from empty ones.
+static void
+AuthCacheKeyUpdate(SHA256_CTX * ctx, char tag, const char * value, int len)
+{
+    uint32_t n = value ? (uint32_t)len : UINT32_MAX;
+
+    SHA256_Update(ctx, &tag, sizeof(tag));
+    SHA256_Update(ctx, &n, sizeof(n));
+    if (value) {
+        SHA256_Update(ctx, value, len);
+    }
+}
+
+// Add all the values of a request header to the authorization cache key.
+static void
+AuthCacheKeyField(SHA256_CTX * ctx, char tag, TSMBuffer mbuf, TSMLoc mhdr, const char * name)
+{
+    TSMLoc      field;
+    const char * value;
+    int         len;
+
+    field = TSMimeHdrFieldFind(mbuf, mhdr, name, -1);
+    if (field == TS_NULL_MLOC) {
+        AuthCacheKeyUpdate(ctx, tag, NULL, 0);
+        return;
+    }
+
+    while (field != TS_NULL_MLOC) {
+        TSMLoc next = TSMimeHdrFieldNextDup(mbuf, mhdr, field);
+
+        value = TSMimeHdrFieldValueStringGet(mbuf, mhdr, field, -1, &len);
+        AuthCacheKeyUpdate(ctx, tag, value ? value : "", value ? len : 0);
+        TSHandleMLocRelease(mbuf, mhdr, field);
+        field = next;
+    }
+}
+
+// Compute the authorization cache key of the client request from the
+// attributes selected by the options.
+static std::string
+AuthCacheKey(TSHttpTxn txn, const AuthOptions * options)
+{
+    SHA256_CTX  ctx;
+    TSMBuffer   mbuf;
+    TSMLoc      mhdr;
+    TSMLoc      murl;
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+
+    TSReleaseAssert(
+        TSHttpTxnClientReqGet(txn, &mbuf, &mhdr) == TS_SUCCESS
+    );
+
+    SHA256_Init(&ctx);
+
+    if (options->cache_key & AUTH_KEY_AUTHORIZATION) {
+        AuthCacheKeyField(&ctx, 'a', mbuf, mhdr, TS_MIME_FIELD_AUTHORIZATION);
+    }
+
+    if (options->cache_key & AUTH_KEY_COOKIE) {
+        AuthCacheKeyField(&ctx, 'c', mbuf, mhdr, TS_MIME_FIELD_COOKIE);
+    }
+
+    if (options->cache_key & AUTH_KEY_HOST) {
+        char hostname[TS_MAX_HOST_NAME_LEN * 2];
+
+        if (HttpGetOriginHost(mbuf, mhdr, hostname, sizeof(hostname))) {
+            AuthCacheKeyUpdate(&ctx, 'h', hostname, strlen(hostname));
+        } else {
+            AuthCacheKeyUpdate(&ctx, 'h', NULL, 0);
+        }
+    }
+
+    if (options->cache_key & AUTH_KEY_PATH_PREFIX) {
+        const char * path = NULL;
+        int len = 0;
+
+        // The prefix is the path up to the last '/', so that the decision
+        // covers the documents in the same directory.
+        if (TSHttpHdrUrlGet(mbuf, mhdr, &murl) == TS_SUCCESS) {
+            path = TSUrlPathGet(mbuf, murl, &len);
+            TSHandleMLocRelease(mbuf, mhdr, murl);
+        }
+
+        while (len > 0 && path[len - 1] != '/') {
+            --len;
+        }
+
+        AuthCacheKeyUpdate(&ctx, 'p', path ? path : "", len);
+    }
+
+    SHA256_Final(digest, &ctx);
+    TSHandleMLocRelease(mbuf, TS_NULL_MLOC, mhdr);
+
+    return std::string((const char *)digest, sizeof(digest));
+}
+
+// Return how long we may cache the authorization proxy's decision, from the
+// Cache-Control of its response. We prefer s-maxage, since we are a shared
+// cache, and don't cache at all without an explicit lifetime.
+static int
+AuthCacheTtl(TSMBuffer mbuf, TSMLoc mhdr, const AuthOptions * options)
+{
+    TSMLoc      field;
+    int         ttl = -1;
+    int         smaxage = -1;
+    bool        uncacheable = false;
+    bool        credentials = options->cache_key & (AUTH_KEY_AUTHORIZATION | AUTH_KEY_COOKIE);
+
+    field = TSMimeHdrFieldFind(mbuf, mhdr, TS_MIME_FIELD_CACHE_CONTROL, -1);
+    while (field != TS_NULL_MLOC) {
+        TSMLoc next = TSMimeHdrFieldNextDup(mbuf, mhdr, field);
+        int count = TSMimeHdrFieldValuesCount(mbuf, mhdr, field);
+
+        for (int i = 0; i < count; ++i) {
+            const char * value;
+            int len;
+
+            value = TSMimeHdrFieldValueStringGet(mbuf, mhdr, field, i, &len);
+            if (value == NULL) {
+                continue;
+            }
+
+            std::string directive(value, len);
+
+            if (strncasecmp(directive.c_str(), "no-store", 8) == 0 ||
+                strncasecmp(directive.c_str(), "no-cache", 8) == 0) {
+                uncacheable = true;
+            } else if (strncasecmp(directive.c_str(), "private", 7) == 0) {
+                // A private decision is only safe to keep if the key tells
+                // the users apart.
+                uncacheable = uncacheable || !credentials;
+            } else if (strncasecmp(directive.c_str(), "s-maxage=", 9) == 0) {
+                smaxage = std::atoi(directive.c_str() + 9);
+            } else if (strncasecmp(directive.c_str(), "max-age=", 8) == 0) {
+                ttl = std::atoi(directive.c_str() + 8);
+            }
+        }
+
+        TSHandleMLocRelease(mbuf, mhdr, field);
+        field = next;
+    }
+
+    if (uncacheable) {
+        return 0;
+    }
+
+    if (smaxage >= 0) {
+        ttl = smaxage;
+    }
+
+    return std::max(0, std::min(ttl, options->cache_ttl));
+}
+
 // Chain the response header hook to send the proxy's authorization response.
 static void
 AuthChainAuthorizationResponse(AuthRequestContext * auth)
@@ -371,7 +623,15 @@ AuthWriteRedirectedRequest(AuthRequestContext * auth, const sockaddr * saddr)
 
     HttpSetMimeHeader(rq.buffer, rq.header, TS_MIME_FIELD_HOST, hostbuf);
     HttpSetMimeHeader(rq.buffer, rq.header, TS_MIME_FIELD_CONTENT_LENGTH, 0u);
-    HttpSetMimeHeader(rq.buffer, rq.header, TS_MIME_FIELD_CACHE_CONTROL, "no-cache");
+
+    // If we were asked to, let the HTTP cache keep the auth proxy response.
+    // It is then up to the auth proxy to say for how long with Cache-Control,
+    // and which credentials the response depends on with Vary.
+    if (auth->options()->cache_http) {
+        HttpSetMimeHeader(rq.buffer, rq.header, AUTH_CACHEABLE_HEADER, "1");
+    } else {
+        HttpSetMimeHeader(rq.buffer, rq.header, TS_MIME_FIELD_CACHE_CONTROL, "no-cache");
+    }
 
     HttpDebugHeader(rq.buffer, rq.header);
 
@@ -488,6 +748,18 @@ StateAuthProxyCompleteHeaders(AuthRequestContext * auth, void * /* edata ATS_UNU
 
     // Authorize the original request on a 2xx response.
     if (status >= 200 && status < 300) {
+        if (!auth->cache_key.empty()) {
+            const AuthOptions * options = auth->options();
+            int ttl = AuthCacheTtl(auth->rheader.buffer, auth->rheader.header, options);
+
+            if (ttl > 0) {
+                time_t now = time(NULL);
+
+                AuthLogDebug("caching authorization for %d seconds", ttl);
+                options->cache->insert(auth->cache_key, now + ttl, now);
+            }
+        }
+
         return TS_EVENT_IMMEDIATE;
     }
 
@@ -670,21 +942,26 @@ StateUnauthorized(AuthRequestContext * auth, void *)
     return TS_EVENT_CONTINUE;
 }
 
-// Terminal state. Allow the original request to proceed.
-static TSEvent
-StateAuthorized(AuthRequestContext * auth, void *)
+// Allow the original request to proceed.
+static void
+AuthRequestAuthorized(TSHttpTxn txn, const AuthOptions * options)
 {
-    const AuthOptions * options = auth->options();
-
-    AuthLogDebug("request authorized");
-
     // Since the original request might have authentication headers, we may
     // need to force ATS to ignore those in order to make it cacheable.
     if (options->force) {
-        TSHttpTxnConfigIntSet(auth->txn, TS_CONFIG_HTTP_CACHE_IGNORE_AUTHENTICATION, 1);
+        TSHttpTxnConfigIntSet(txn, TS_CONFIG_HTTP_CACHE_IGNORE_AUTHENTICATION, 1);
     }
 
-    TSHttpTxnReenable(auth->txn, TS_EVENT_HTTP_CONTINUE);
+    TSHttpTxnReenable(txn, TS_EVENT_HTTP_CONTINUE);
+}
+
+// Terminal state. Allow the original request to proceed.
+static TSEvent
+StateAuthorized(AuthRequestContext * auth, void *)
+{
+    AuthLogDebug("request authorized");
+
+    AuthRequestAuthorized(auth->txn, auth->options());
     return TS_EVENT_CONTINUE;
 }
 
@@ -697,6 +974,31 @@ AuthRequestIsTagged(TSHttpTxn txn)
         TSHttpTxnArgGet(txn, AuthTaggedRequestArg) != NULL;
 }
 
+// Return true if the given internal request may be cached, removing the mark
+// that says so.
+static bool
+AuthRequestIsCacheable(TSHttpTxn txn)
+{
+    TSMBuffer   mbuf;
+    TSMLoc      mhdr;
+    TSMLoc      field;
+    bool        cacheable = false;
+
+    if (TSHttpTxnClientReqGet(txn, &mbuf, &mhdr) != TS_SUCCESS) {
+        return false;
+    }
+
+    field = TSMimeHdrFieldFind(mbuf, mhdr, AUTH_CACHEABLE_HEADER, -1);
+    if (field != TS_NULL_MLOC) {
+        TSMimeHdrFieldDestroy(mbuf, mhdr, field);
+        TSHandleMLocRelease(mbuf, mhdr, field);
+        cacheable = true;
+    }
+
+    TSHandleMLocRelease(mbuf, TS_NULL_MLOC, mhdr);
+    return cacheable;
+}
+
 static int
 AuthProxyGlobalHook(TSCont /* cont ATS_UNUSED */, TSEvent event, void * edata)
 {
@@ -714,10 +1016,13 @@ AuthProxyGlobalHook(TSCont /* cont ATS_UNUSED */, TSEvent event, void * edata)
     case TS_EVENT_HTTP_OS_DNS:
         // Ignore internal requests since we generated them.
         if (TSHttpIsInternalRequest(ptr.txn) == TS_SUCCESS) {
-            // All our internal requests *must* hit the origin since it is the
+            // Our internal requests *must* hit the origin since it is the
             // agent that needs to make the authorization decision. We can't
-            // allow that to be cached.
-            TSHttpTxnReqCacheableSet(ptr.txn, 0);
+            // allow that to be cached, unless the options said the auth
+            // proxy response may be.
+            if (!AuthRequestIsCacheable(ptr.txn)) {
+                TSHttpTxnReqCacheableSet(ptr.txn, 0);
+            }
 
             AuthLogDebug("re-enabling internal transaction");
             TSHttpTxnReenable(ptr.txn, TS_EVENT_HTTP_CONTINUE);
@@ -727,9 +1032,24 @@ AuthProxyGlobalHook(TSCont /* cont ATS_UNUSED */, TSEvent event, void * edata)
         // Hook this request if we are in global authorization mode or if a
         // remap rule tagged it.
         if (AuthGlobalOptions != NULL || AuthRequestIsTagged(ptr.txn)) {
+            const AuthOptions * options = AuthRequestOptions(ptr.txn);
+            std::string key;
+
+            // If we have a recent decision for the same credentials, we don't
+            // need to ask the auth proxy again.
+            if (options->cache) {
+                key = AuthCacheKey(ptr.txn, options);
+                if (options->cache->lookup(key, time(NULL))) {
+                    AuthLogDebug("request authorized from the authorization cache");
+                    AuthRequestAuthorized(ptr.txn, options);
+                    return TS_EVENT_NONE;
+                }
+            }
+
             auth = AuthRequestContext::allocate();
             auth->state = StateTableInit;
             auth->txn = ptr.txn;
+            auth->cache_key.swap(key);
             return AuthRequestContext::dispatch(auth->cont, event, edata);
         }
 
@@ -741,6 +1061,40 @@ AuthProxyGlobalHook(TSCont /* cont ATS_UNUSED */, TSEvent event, void * edata)
 
 }
 
+// Parse a comma separated list of request attributes for the authorization
+// cache key.
+static unsigned
+AuthParseCacheKey(const char * arg)
+{
+    unsigned    key = 0;
+    std::string list(arg);
+    size_t      pos = 0;
+
+    while (pos <= list.size()) {
+        size_t end = list.find(',', pos);
+        std::string name = list.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+
+        if (strcasecmp(name.c_str(), "authorization") == 0) {
+            key |= AUTH_KEY_AUTHORIZATION;
+        } else if (strcasecmp(name.c_str(), "cookie") == 0) {
+            key |= AUTH_KEY_COOKIE;
+        } else if (strcasecmp(name.c_str(), "host") == 0) {
+            key |= AUTH_KEY_HOST;
+        } else if (strcasecmp(name.c_str(), "path-prefix") == 0) {
+            key |= AUTH_KEY_PATH_PREFIX;
+        } else if (!name.empty()) {
+            AuthLogError("invalid authorization cache key attribute '%s'", name.c_str());
+        }
+
+        if (end == std::string::npos) {
+            break;
+        }
+        pos = end + 1;
+    }
+
+    return key;
+}
+
 static AuthOptions *
 AuthParseOptions(int argc, const char ** argv)
 {
@@ -753,6 +1107,9 @@ AuthParseOptions(int argc, const char ** argv)
         { const_cast<char *>("auth-port"), required_argument, 0, 'p' },
         { const_cast<char *>("auth-transform"), required_argument, 0, 't' },
         { const_cast<char *>("force-cacheability"), no_argument, 0, 'c' },
+        { const_cast<char *>("cache-key"), required_argument, 0, 'k' },
+        { const_cast<char *>("cache-ttl"), required_argument, 0, 'l' },
+        { const_cast<char *>("cache-http"), no_argument, 0, 'H' },
         {0, 0, 0, 0 }
     };
 
@@ -781,6 +1138,15 @@ AuthParseOptions(int argc, const char ** argv)
         case 'c':
             options->force = true;
             break;
+        case 'k':
+            options->cache_key = AuthParseCacheKey(optarg);
+            break;
+        case 'l':
+            options->cache_ttl = std::atoi(optarg);
+            break;
+        case 'H':
+            options->cache_http = true;
+            break;
         case 't':
             if (strcasecmp(optarg, "redirect") == 0) {
                 options->transform = AuthWriteRedirectedRequest;
@@ -799,6 +1165,17 @@ AuthParseOptions(int argc, const char ** argv)
         }
     }
 
+    if (options->cache_key && options->cache_ttl > 0) {
+        options->cache = AuthNew<AuthDecisionCache>();
+    }
+
+    // A cached response to the HEAD of the original document would authorize
+    // anyone, so only the auth proxy responses can go in the HTTP cache.
+    if (options->cache_http && options->transform != AuthWriteRedirectedRequest) {
+        AuthLogError("--cache-http requires the redirect authorization transform");
+        options->cache_http = false;
+    }
+
     return options;
 }
 #undef LONGOPT_OPTION_CAST
@@ -0,0 +1,200 @@
+/** @file
+
+  A brief file description
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+//
+// A consistent hash ring over a static list of backends, with passive health
+// checking. The ring is built the same way as the parent.config consistent_hash
+// ring: 160 points per backend, from the MD5 of "host:port-n". A backend that is
+// added or removed only moves its own share of the keys, and the same list of
+// hosts is laid out the same way for parent selection and for the balancer.
+//
+#ifndef __BACKENDS_H__
+#define __BACKENDS_H__ 1
+
+
+#include <time.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <openssl/md5.h>
+
+#include <ts/ts.h>
+
+
+static const int RING_POINTS_PER_BACKEND = 160;
+
+
+///////////////////////////////////////////////////////////////////////////////
+// One backend. The failure state is only written by the transactions that
+// used it; a lost update just delays marking it up or down by a request.
+//
+struct Backend
+{
+  Backend(const std::string& h, int p) :
+    host(h), port(p), fail_count(0), failed_at(0)
+  { }
+
+  bool
+  is_up(time_t now, int threshold, int retry_time) const {
+    return (fail_count < threshold) || (failed_at + retry_time <= now);
+  }
+
+  void
+  mark_failed(time_t now) {
+    ++fail_count;
+    failed_at = now;
+  }
+
+  void
+  mark_ok() {
+    if (fail_count) {
+      TSDebug("balancer", "Marking backend %s:%d up", host.c_str(), port);
+      fail_count = 0;
+    }
+  }
+
+  std::string host;
+  int port;
+  volatile int fail_count;
+  volatile time_t failed_at;
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+// The ring itself.
+//
+class BackendRing
+{
+public:
+  BackendRing() :
+    _fail_threshold(3), _retry_time(30)
+  { }
+
+  ~BackendRing() {
+    for (std::vector<Backend*>::iterator it = _backends.begin(); it != _backends.end(); ++it)
+      delete *it;
+  }
+
+  bool empty() const { return _backends.empty(); }
+  int size() const { return _backends.size(); }
+
+  void set_fail_threshold(const std::string& val) { _fail_threshold = std::max(1, atoi(val.c_str())); }
+  void set_retry_time(const std::string& val) { _retry_time = std::max(0, atoi(val.c_str())); }
+
+  // Parse a "host[:port]" backend, and add it to the ring.
+  void
+  add(const std::string& spec) {
+    std::string::size_type sep = spec.find_last_of(":");
+    int port = 80;
+    std::string host = spec;
+
+    // An IPv6 address has to be in brackets to take a port
+    if (sep != std::string::npos && (spec[0] != '[' || spec.find_last_of("]") < sep)) {
+      host = spec.substr(0, sep);
+      port = atoi(spec.substr(sep + 1).c_str());
+    }
+
+    if (host.empty() || port <= 0 || port > 65535) {
+      TSError("Malformed balancer backend: %s", spec.c_str());
+      return;
+    }
+
+    Backend* b = new Backend(host, port);
+    int ix = _backends.size();
+    char buf[host.size() + 32];
+
+    _backends.push_back(b);
+    for (int j = 0; j < RING_POINTS_PER_BACKEND / 4; ++j) {
+      unsigned char md5[MD5_DIGEST_LENGTH];
+      int len = snprintf(buf, sizeof(buf), "%s:%d-%d", host.c_str(), port, j);
+
+      MD5((const unsigned char*)buf, len, md5);
+      for (int k = 0; k < 4; ++k) {
+        Point pt;
+
+        memcpy(&pt.hash, md5 + k * sizeof(uint32_t), sizeof(uint32_t));
+        pt.backend = ix;
+        _ring.push_back(pt);
+      }
+    }
+    std::sort(_ring.begin(), _ring.end());
+  }
+
+  // Find the backends for a key (an MD5 digest): walking clockwise from the
+  // key, the first "width" distinct backends that are up. If too few are up,
+  // the bucket is filled with the down ones, in ring order, rather than
+  // failing the request. Returns the number of backends found.
+  int
+  lookup(const char* id, int width, time_t now, Backend** bucket) const {
+    uint32_t key;
+    int found = 0;
+
+    if (_ring.empty())
+      return 0;
+
+    width = std::min(std::max(width, 1), (int)_backends.size());
+    memcpy(&key, id + sizeof(uint32_t), sizeof(uint32_t));
+
+    Point pt;
+    pt.hash = key;
+    pt.backend = 0;
+    size_t start = std::lower_bound(_ring.begin(), _ring.end(), pt) - _ring.begin();
+
+    for (int pass = 0; pass < 2 && found < width; ++pass) {
+      for (size_t n = 0; n < _ring.size() && found < width; ++n) {
+        Backend* b = _backends[_ring[(start + n) % _ring.size()].backend];
+        bool up = b->is_up(now, _fail_threshold, _retry_time);
+
+        // First pass takes the healthy backends, the second the rest
+        if (up != (pass == 0) || std::find(bucket, bucket + found, b) != bucket + found)
+          continue;
+        bucket[found++] = b;
+      }
+    }
+
+    return found;
+  }
+
+private:
+  struct Point
+  {
+    uint32_t hash;
+    int backend;
+
+    bool operator<(const Point& rhs) const { return hash < rhs.hash; }
+  };
+
+  std::vector<Backend*> _backends;
+  std::vector<Point> _ring;
+  int _fail_threshold;
+  int _retry_time;
+};
+
+
+#endif // __BACKENDS_H__
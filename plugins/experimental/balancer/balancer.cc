@@ -46,10 +46,14 @@
 
 #include "resources.h"
 #include "hashkey.h"
+#include "backends.h"
 
 
 static int MAX_HASH_KEY_VALUES = 16;
-static int MD5_DIGEST_LENGTH = 16;
+
+// The backend a transaction was sent to, for the passive health checks.
+static int txn_backend_arg = -1;
+static TSCont txn_close_cont = NULL;
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -95,6 +99,9 @@ public:
     _rotation = TSstrdup(rot.c_str());
   }
 
+  BackendRing& ring() { return _ring; };
+  const BackendRing& ring() const { return _ring; };
+
   int bucket_hosts() const { return _bucket_hosts; };
   void set_bucket_hosts(const std::string& width) {
     _bucket_hosts = atoi(width.c_str());
@@ -155,12 +162,12 @@ public:
       } else {
         if (secondary) {
           // Secondary ID defaults to IP (if none of the specified hashes computes)
-          char buf[4];
+          char buf[sizeof(resr.getRRI()->client_ip)];
 
-          *buf = resr.getRRI()->client_ip; // ToDo: this only works for IPv4
+          memcpy(buf, &resr.getRRI()->client_ip, sizeof(buf)); // ToDo: this only works for IPv4
 
-          TSDebug("balancer", "Making secondary hash ID's using IP (default) = %s", buf);
-          ycrMD5_r(buf, key_len, id);
+          TSDebug("balancer", "Making secondary hash ID's using IP (default)");
+          ycrMD5_r(buf, sizeof(buf), id);
         } else {
           // Primary ID defaults to URL (if none of the specified hashes computes)
           char buf[resr.getRRI()->orig_url_size + 1];
@@ -168,7 +175,7 @@ public:
           memcpy(buf, resr.getRRI()->orig_url, resr.getRRI()->orig_url_size);
           buf[resr.getRRI()->orig_url_size] = '\0';
           TSDebug("balancer", "Making primary hash ID's using URL (default) = %s", buf);
-          ycrMD5_r(buf, key_len, id);
+          ycrMD5_r(buf, resr.getRRI()->orig_url_size, id);
         }
       }
     } else {
@@ -183,9 +190,47 @@ private:
   int _bucket_hosts;
   char* _rotation;
   bool _host_ip;
+  BackendRing _ring;
 };
 
 
+///////////////////////////////////////////////////////////////////////////////
+// Passive health checks: when a transaction we sent to one of the backends
+// ends, record whether we could talk to it. These are the same connect
+// failures HostDB counts when marking a round robin host down, which the
+// plugin API has no access to.
+//
+static int
+balancer_txn_close(TSCont contp, TSEvent event, void *edata)
+{
+  TSHttpTxn txnp = static_cast<TSHttpTxn>(edata);
+  Backend* backend = static_cast<Backend*>(TSHttpTxnArgGet(txnp, txn_backend_arg));
+
+  if (backend) {
+    switch (TSHttpTxnServerStateGet(txnp)) {
+    case TS_SRVSTATE_CONNECTION_ERROR:
+    case TS_SRVSTATE_OPEN_RAW_ERROR:
+    case TS_SRVSTATE_INACTIVE_TIMEOUT:
+    case TS_SRVSTATE_ACTIVE_TIMEOUT:
+      TSDebug("balancer", "Failed to reach backend %s:%d", backend->host.c_str(), backend->port);
+      backend->mark_failed(time(NULL));
+      break;
+    case TS_SRVSTATE_CONNECTION_ALIVE:
+    case TS_SRVSTATE_CONNECTION_CLOSED:
+    case TS_SRVSTATE_TRANSACTION_COMPLETE:
+      backend->mark_ok();
+      break;
+    default:
+      // Served from cache, or the failure was not the backend's
+      break;
+    }
+  }
+
+  TSHttpTxnReenable(txnp, TS_EVENT_HTTP_CONTINUE);
+  return 0;
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // Initialize the plugin.
 //
@@ -208,6 +253,12 @@ tsremap_init(TSREMAP_INTERFACE *api_info, char *errbuf, int errbuf_size)
     return -3;
   }
 
+  if (TSHttpArgIndexReserve("balancer", "balancer backend", &txn_backend_arg) != TS_SUCCESS) {
+    strncpy(errbuf, "[tsremap_init] - Failed to reserve a transaction argument", errbuf_size - 1);
+    return -4;
+  }
+  txn_close_cont = TSContCreate(balancer_txn_close, NULL);
+
   TSDebug("balancer", "plugin is successfully initialized");
   return 0;
 }
@@ -244,6 +295,12 @@ tsremap_new_instance(int argc, char *argv[], ihandle *ih, char *errbuf, int errb
 
         if (arg.compare(0, 8, "rotation") == 0) {
           ri->set_rotation(arg_val);
+        } else if (arg.compare(0, 7, "backend") == 0) {
+          ri->ring().add(arg_val);
+        } else if (arg.compare(0, 14, "fail_threshold") == 0) {
+          ri->ring().set_fail_threshold(arg_val);
+        } else if (arg.compare(0, 10, "retry_time") == 0) {
+          ri->ring().set_retry_time(arg_val);
         } else if (arg.compare(0, 7, "bucketw") == 0) {
           ri->set_bucket_hosts(arg_val);
         } else if (arg.compare(0, 4, "hash") == 0) {
@@ -310,6 +367,11 @@ tsremap_new_instance(int argc, char *argv[], ihandle *ih, char *errbuf, int errb
     }
   }
 
+  // The ring needs a key for every request, which defaults to the URL
+  if (!ri->ring().empty() && !ri->has_primary_hash()) {
+    ri->append_hash(new URLHashKey());
+  }
+
   return 0;
 }
 
@@ -322,6 +384,54 @@ tsremap_delete_instance(ihandle ih)
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+// Pick a backend from the consistent hash ring. The primary hash chooses a
+// bucket of "bucketw" backends clockwise from its point on the ring, skipping
+// those that are down, and the secondary hash picks one within the bucket.
+//
+static int
+remap_ring(BalancerInstance* balancer, rhandle rh, REMAP_REQUEST_INFO *rri)
+{
+  const BackendRing& ring = balancer->ring();
+  Backend* bucket[ring.size()];
+  char id1[MD5_DIGEST_LENGTH+1];
+  Resources resr((TSHttpTxn)rh, rri);
+  Backend* backend;
+  int found;
+
+  balancer->make_hash_key(id1, false, resr);
+  found = ring.lookup(id1, balancer->bucket_hosts(), time(NULL), bucket);
+  if (found == 0) {
+    TSDebug("balancer", "No backend found, using To-URL");
+    return 0;
+  }
+
+  backend = bucket[0];
+  if (found > 1 && balancer->has_secondary_hash()) {
+    char id2[MD5_DIGEST_LENGTH+1];
+    uint32_t ix;
+
+    balancer->make_hash_key(id2, true, resr);
+    memcpy(&ix, id2, sizeof(ix));
+    backend = bucket[ix % found];
+  }
+
+  // Watch how the transaction goes, to mark the backend down or up
+  TSHttpTxnArgSet((TSHttpTxn)rh, txn_backend_arg, backend);
+  TSHttpTxnHookAdd((TSHttpTxn)rh, TS_HTTP_TXN_CLOSE_HOOK, txn_close_cont);
+
+  TSDebug("balancer", "Setting real-host to backend %s:%d", backend->host.c_str(), backend->port);
+  rri->new_host_size = backend->host.size();
+  if (rri->new_host_size > TSREMAP_RRI_MAX_HOST_SIZE)
+    rri->new_host_size = TSREMAP_RRI_MAX_HOST_SIZE;
+  memcpy(rri->new_host, backend->host.data(), rri->new_host_size);
+  if (backend->port != rri->remap_to_port)
+    rri->new_port = backend->port;
+
+  return 1;
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // This is the main "entry" point for the plugin, called for every request.
 //
@@ -342,6 +452,10 @@ tsremap_remap(ihandle ih, rhandle rh, REMAP_REQUEST_INFO *rri)
   }
   balancer = static_cast<BalancerInstance*>(ih);
 
+  // With a list of backends, pick from the consistent hash ring instead.
+  if (!balancer->ring().empty())
+    return remap_ring(balancer, rh, rri);
+
   // Get the rotation name to use.
 
   if (balancer->rotation()) {
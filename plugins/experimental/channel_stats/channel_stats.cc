@@ -23,7 +23,6 @@
 #include <cstring>
 #include <cctype>
 #include <string>
-#include <map> // may optimize by using hash_map, but mind compiler portability
 #include <vector>
 #include <algorithm>
 #include <sstream>
@@ -55,41 +54,33 @@ static std::string api_path("_cstats");
 static uint64_t global_response_count_2xx_get = 0;  // 2XX GET response count
 static uint64_t global_response_bytes_content = 0;  // transferred bytes
 
-// channel stats
-struct channel_stat {
-  channel_stat()
-      : response_bytes_content(0),
-        response_count_2xx(0),
-        response_count_5xx(0),
-        speed_ua_bytes_per_sec_64k(0) {
-  }
-
-  inline void increment(uint64_t rbc, uint64_t rc2,
-                        uint64_t rc5, uint64_t sbps6) {
-    if (rbc) __sync_fetch_and_add(&response_bytes_content, rbc);
-    if (rc2) __sync_fetch_and_add(&response_count_2xx, rc2);
-    if (rc5) __sync_fetch_and_add(&response_count_5xx, rc5);
-    if (sbps6) __sync_fetch_and_add(&speed_ua_bytes_per_sec_64k, sbps6);
-  }
-
-  inline void debug_channel() {
-    debug("response.bytes.content: %" PRIu64 "", response_bytes_content);
-    debug("response.count.2xx: %" PRIu64 "", response_count_2xx);
-    debug("response.count.5xx: %" PRIu64 "", response_count_5xx);
-    debug("speed.ua.bytes_per_sec_64k: %" PRIu64 "", speed_ua_bytes_per_sec_64k);
-  }
-
-  uint64_t response_bytes_content;
-  uint64_t response_count_2xx;
-  uint64_t response_count_5xx;
-  uint64_t speed_ua_bytes_per_sec_64k;
+// channel stats, kept by the core per channel (host) and per thread, so
+// that transactions on different threads never contend for them
+enum channel_stat_counter {
+  CHANNEL_RESPONSE_BYTES_CONTENT,
+  CHANNEL_RESPONSE_COUNT_2XX,
+  CHANNEL_RESPONSE_COUNT_5XX,
+  CHANNEL_SPEED_UA_BYTES_PER_SEC_64K,
+  CHANNEL_STAT_COUNTERS
 };
 
-typedef std::map<std::string, channel_stat *> stats_map_t;
-typedef stats_map_t::iterator smap_iterator;
+static TSKeyedStat channel_stats;
+
+static inline void
+increment_channel_stat(int channel, uint64_t rbc, uint64_t rc2,
+                       uint64_t rc5, uint64_t sbps6)
+{
+  if (rbc) TSKeyedStatIncrement(channel_stats, channel, CHANNEL_RESPONSE_BYTES_CONTENT, rbc);
+  if (rc2) TSKeyedStatIncrement(channel_stats, channel, CHANNEL_RESPONSE_COUNT_2XX, rc2);
+  if (rc5) TSKeyedStatIncrement(channel_stats, channel, CHANNEL_RESPONSE_COUNT_5XX, rc5);
+  if (sbps6) TSKeyedStatIncrement(channel_stats, channel, CHANNEL_SPEED_UA_BYTES_PER_SEC_64K, sbps6);
+}
 
-static stats_map_t channel_stats;
-static TSMutex stats_map_mutex;
+static inline uint64_t
+get_channel_counter(int channel, channel_stat_counter counter)
+{
+  return TSKeyedStatGet(channel_stats, channel, counter);
+}
 
 // api Intercept Data
 typedef struct intercept_state_t
@@ -385,40 +376,20 @@ get_pristine_host(TSHttpTxn txnp, TSMBuffer bufp, std::string &host)
 
 static bool
 get_channel_stat(const std::string &host,
-                 channel_stat *    &stat,
+                 int    &channel,
                  int    status_code_type)
 {
-  smap_iterator stat_it;
-
-  stat_it = channel_stats.find(host);
+  // if request's host isn't in your remap.config, response code will be 404
+  // we should not count that channel in this situation
+  channel = TSKeyedStatIndexGet(channel_stats, host.data(), host.size(), status_code_type == 2);
 
-  if (stat_it != channel_stats.end()) {
-    stat = stat_it->second;
-  } else {
+  if (channel < 0) {
     if (status_code_type != 2) {
-      // if request's host isn't in your remap.config, response code will be 404
-      // we should not count that channel in this situation
       debug("not 2xx response, do not create stat for this channel now");
-      return false;
-    }
-    if (channel_stats.size() >= MAX_MAP_SIZE) {
-      warning("channel_stats map exceeds max size");
-      return false;
-    }
-
-    stat = new channel_stat();
-    std::pair<smap_iterator, bool> insert_ret;
-    TSMutexLock(stats_map_mutex);
-    insert_ret = channel_stats.insert(std::make_pair(host, stat));
-    TSMutexUnlock(stats_map_mutex);
-    if (insert_ret.second == true) {
-      // insert successfully
-      debug("******** new channel(#%zu) ********", channel_stats.size());
     } else {
-      warning("stat of this channel already existed");
-      delete stat;
-      stat = insert_ret.first->second;
+      warning("channel_stats map exceeds max size");
     }
+    return false;
   }
 
   return true;
@@ -470,7 +441,7 @@ handle_txn_close(TSCont /* contp ATS_UNUSED */, TSHttpTxn txnp)
   int status_code_type;
   uint64_t user_speed;
   uint64_t body_bytes;
-  channel_stat *stat;
+  int channel;
   std::string host;
 
   if (TSHttpTxnClientRespGet(txnp, &bufp, &hdr_loc) != TS_SUCCESS) {
@@ -493,16 +464,16 @@ handle_txn_close(TSCont /* contp ATS_UNUSED */, TSHttpTxn txnp)
     goto cleanup;
 
   // get or create the stat
-  if (!get_channel_stat(host, stat, status_code_type))
+  if (!get_channel_stat(host, channel, status_code_type))
     goto cleanup;
 
   user_speed = get_txn_user_speed(txnp, body_bytes);
 
-  stat->increment(body_bytes,
-                  status_code_type == 2 ? 1 : 0,
-                  status_code_type == 5 ? 1 : 0,
-                  (user_speed < 64000 && user_speed > 0) ? 1 : 0);
-  stat->debug_channel();
+  increment_channel_stat(channel,
+                         body_bytes,
+                         status_code_type == 2 ? 1 : 0,
+                         status_code_type == 5 ? 1 : 0,
+                         (user_speed < 64000 && user_speed > 0) ? 1 : 0);
 
 cleanup:
   TSHandleMLocRelease(bufp, TS_NULL_MLOC, hdr_loc);
@@ -638,25 +609,29 @@ json_out_stat(TSRecordType /* rec_type ATS_UNUSED */, void *edata, int /* regist
   }
 }
 
-template<class T>
-struct compare
-: std::binary_function<T,T,bool>
+typedef std::pair<std::string, int> data_pair; // channel name and index
+typedef std::vector<data_pair> stats_vec_t;
+
+struct compare_2xx
+: std::binary_function<data_pair,data_pair,bool>
 {
-   inline bool operator()(const T& lhs, const T& rhs) {
-      return lhs.second->response_count_2xx > rhs.second->response_count_2xx;
+   inline bool operator()(const data_pair& lhs, const data_pair& rhs) {
+      return get_channel_counter(lhs.second, CHANNEL_RESPONSE_COUNT_2XX) >
+        get_channel_counter(rhs.second, CHANNEL_RESPONSE_COUNT_2XX);
    }
 };
 
 static void
 append_channel_stat(intercept_state * api_state,
-                    const std::string channel, channel_stat * cs,
+                    const std::string channel, int index,
                     int is_last)
 {
   APPEND_DICT_NAME(channel.c_str());
-  APPEND_STAT("response.bytes.content", "%" PRIu64, cs->response_bytes_content);
-  APPEND_STAT("response.count.2xx.get", "%" PRIu64, cs->response_count_2xx);
-  APPEND_STAT("response.count.5xx.get", "%" PRIu64, cs->response_count_5xx);
-  APPEND_END_STAT("speed.ua.bytes_per_sec_64k", "%" PRIu64, cs->speed_ua_bytes_per_sec_64k);
+  APPEND_STAT("response.bytes.content", "%" PRIu64, get_channel_counter(index, CHANNEL_RESPONSE_BYTES_CONTENT));
+  APPEND_STAT("response.count.2xx.get", "%" PRIu64, get_channel_counter(index, CHANNEL_RESPONSE_COUNT_2XX));
+  APPEND_STAT("response.count.5xx.get", "%" PRIu64, get_channel_counter(index, CHANNEL_RESPONSE_COUNT_5XX));
+  APPEND_END_STAT("speed.ua.bytes_per_sec_64k", "%" PRIu64,
+                  get_channel_counter(index, CHANNEL_SPEED_UA_BYTES_PER_SEC_64K));
   if (is_last)
     APPEND("}\n");
   else
@@ -665,64 +640,47 @@ append_channel_stat(intercept_state * api_state,
 
 static void
 json_out_channel_stats(intercept_state * api_state) {
-  if (channel_stats.empty())
+  // channels are only ever added, a channel added from here on is left out
+  int count = TSKeyedStatCount(channel_stats);
+  if (count == 0)
     return;
 
-  typedef std::pair<std::string, channel_stat *> data_pair;
-  typedef std::vector<data_pair> stats_vec_t;
-  smap_iterator it;
-
   debug("appending channel stats");
 
-  if (api_state->topn > -1 ||
-      (api_state->channel && strlen(api_state->channel) > 0)) {
-    // will use vector to output
-
-    if (api_state->topn == 0)
-      return;
-
-    stats_vec_t stats_vec; // a tmp vector to sort or filter
-    if (strlen(api_state->channel) > 0) {
-      // filter by channel
-      size_t found;
-      for (it=channel_stats.begin(); it != channel_stats.end(); it++) {
-        found = it->first.find(api_state->channel);
-        if (found != std::string::npos)
-          stats_vec.push_back(*it);
-      }
-    } else {
-      for (it=channel_stats.begin(); it != channel_stats.end(); it++)
-        stats_vec.push_back(*it);
-      /* stats_vec.assign is not safe when map is being inserted concurrently */
-    }
+  if (api_state->topn == 0)
+    return;
 
-    if (stats_vec.empty())
-      return;
+  stats_vec_t stats_vec; // a tmp vector to sort or filter
+  bool filter = api_state->channel && strlen(api_state->channel) > 0;
+  for (int i = 0; i < count; i++) {
+    int len;
+    const char *name = TSKeyedStatKeyGet(channel_stats, i, &len);
+    std::string channel(name, len);
+    // filter by channel
+    if (!filter || channel.find(api_state->channel) != std::string::npos)
+      stats_vec.push_back(data_pair(channel, i));
+  }
 
-    stats_vec_t::size_type out_st = stats_vec.size();
-    if (api_state->topn > 0) { // need sort and limit output size
-      if ((unsigned)api_state->topn < stats_vec.size())
-        out_st = (unsigned)api_state->topn;
-      else
-        api_state->topn = stats_vec.size();
-      std::partial_sort(stats_vec.begin(), stats_vec.begin() + api_state->topn,
-                        stats_vec.end(), compare<data_pair>());
-    } // else will output whole vector without sort
-
-    stats_vec_t::size_type i;
-    for (i = 0; i < out_st - 1; i++) {
-      append_channel_stat(api_state, stats_vec[i].first, stats_vec[i].second, 0);
-    }
-    append_channel_stat(api_state, stats_vec[i].first, stats_vec[i].second, 1);
+  if (stats_vec.empty())
+    return;
 
-  } else {
-    smap_iterator last_it = channel_stats.end();
-    last_it--;
-    for (it = channel_stats.begin(); it != last_it; it++) {
-      append_channel_stat(api_state, it->first, it->second, 0);
-    }
-    append_channel_stat(api_state, it->first, it->second, 1);
+  stats_vec_t::size_type out_st = stats_vec.size();
+  if (api_state->topn > 0) { // need sort and limit output size
+    if ((unsigned)api_state->topn < stats_vec.size())
+      out_st = (unsigned)api_state->topn;
+    else
+      api_state->topn = stats_vec.size();
+    std::partial_sort(stats_vec.begin(), stats_vec.begin() + api_state->topn,
+                      stats_vec.end(), compare_2xx());
+  } else { // whole vector, in channel name order
+    std::sort(stats_vec.begin(), stats_vec.end());
+  }
+
+  stats_vec_t::size_type i;
+  for (i = 0; i < out_st - 1; i++) {
+    append_channel_stat(api_state, stats_vec[i].first, stats_vec[i].second, 0);
   }
+  append_channel_stat(api_state, stats_vec[i].first, stats_vec[i].second, 1);
 }
 
 static void
@@ -737,7 +695,7 @@ json_out_stats(intercept_state * api_state)
   APPEND(" \"global\": {\n");
   APPEND_STAT("response.count.2xx.get", "%" PRIu64, global_response_count_2xx_get);
   APPEND_STAT("response.bytes.content", "%" PRIu64, global_response_bytes_content);
-  APPEND_STAT("channel.count", "%zu", channel_stats.size());
+  APPEND_STAT("channel.count", "%d", TSKeyedStatCount(channel_stats));
 
   if (api_state->show_global)
     TSRecordDump(TS_RECORDTYPE_PROCESS, json_out_stat, api_state); // internal stats
@@ -816,7 +774,10 @@ TSPluginInit(int argc, const char *argv[])
 
   info("%s(%s) plugin starting...", PLUGIN_NAME, PLUGIN_VERSION);
 
-  stats_map_mutex = TSMutexCreate();
+  channel_stats = TSKeyedStatCreate(PLUGIN_NAME, CHANNEL_STAT_COUNTERS, MAX_MAP_SIZE);
+  if (!channel_stats) {
+    fatal("failed to create the channel stats");
+  }
 
   TSCont cont = TSContCreate(handle_event, NULL);
   TSHttpHookAdd(TS_HTTP_READ_REQUEST_HDR_HOOK, cont);
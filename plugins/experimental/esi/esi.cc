@@ -47,6 +47,7 @@
 #include "Stats.h"
 #include "HttpDataFetcherImpl.h"
 #include "FailureInfo.h"
+#include "ParseCache.h"
 using std::string;
 using std::list;
 using namespace EsiLib;
@@ -58,6 +59,10 @@ struct OptionInfo
   bool private_response;
   bool disable_gzip_output;
   bool first_byte_flush;
+  bool task_threads;
+  ParseCache *parse_cache;
+  int max_concurrent_fetches;
+  bool coalesce_fetches;
 };
 
 static HandlerManager *gHandlerManager = NULL;
@@ -69,6 +74,7 @@ static HandlerManager *gHandlerManager = NULL;
 #define FETCHER_DEBUG_TAG "plugin_esi_fetcher"
 #define VARS_DEBUG_TAG "plugin_esi_vars"
 #define HANDLER_MGR_DEBUG_TAG "plugin_esi_handler_mgr"
+#define PARSE_CACHE_DEBUG_TAG "plugin_esi_parse_cache"
 #define EXPR_DEBUG_TAG VARS_DEBUG_TAG
 
 #define MIME_FIELD_XESI "X-Esi"
@@ -119,6 +125,11 @@ struct ContData
   bool os_response_cacheable;
   list<string> post_headers;
 
+  // parse cache state; the key is empty if the document can't be cached
+  string parse_cache_key;
+  bool parse_cache_hit;
+  string raw_doc;
+
   ContData(TSCont contptr, TSHttpTxn tx)
     : curr_state(READING_ESI_DOC), input_vio(NULL), output_vio(NULL),
       output_buffer(NULL), output_reader(NULL),
@@ -128,7 +139,7 @@ struct ContData
       gzipped_data(""), gzip_output(false),
       initialized(false), xform_closed(false),
       intercept_header(false), cache_txn(false), head_only(false)
-      , os_response_cacheable(true)
+      , os_response_cacheable(true), parse_cache_key(""), parse_cache_hit(false), raw_doc("")
   {
     client_addr = TSHttpTxnClientAddrGet(txnp);
     *debug_tag = '\0';
@@ -140,8 +151,12 @@ struct ContData
 
   void getServerState();
 
+  void getParseCacheState(TSMBuffer bufp, TSMLoc hdr_loc);
+
   void checkXformStatus();
 
+  HttpDataFetcherImpl *createDataFetcher();
+
   bool init();
 
   ~ContData();
@@ -191,6 +206,16 @@ ContData::checkXformStatus() {
   }
 }
 
+HttpDataFetcherImpl *
+ContData::createDataFetcher() {
+  string fetcher_tag;
+  HttpDataFetcherImpl *fetcher = new HttpDataFetcherImpl(contp, client_addr,
+                                                         createDebugTag(FETCHER_DEBUG_TAG, contp, fetcher_tag));
+  fetcher->setMaxConcurrentRequests(option_info->max_concurrent_fetches);
+  fetcher->setCoalesceRequests(option_info->coalesce_fetches);
+  return fetcher;
+}
+
 bool
 ContData::init()
 {
@@ -231,8 +256,7 @@ ContData::init()
 
     string fetcher_tag, vars_tag, expr_tag, proc_tag, gzip_tag;
     if (!data_fetcher) {
-      data_fetcher = new HttpDataFetcherImpl(contp, client_addr,
-                                             createDebugTag(FETCHER_DEBUG_TAG, contp, fetcher_tag));
+      data_fetcher = createDataFetcher();
     }
     if (!esi_vars) {
       esi_vars = new Variables(createDebugTag(VARS_DEBUG_TAG, contp, vars_tag), &TSDebug, &TSError);
@@ -245,6 +269,19 @@ ContData::init()
     
     esi_gzip = new EsiGzip(createDebugTag(GZIP_DEBUG_TAG, contp, gzip_tag), &TSDebug, &TSError);
 
+    if (parse_cache_hit) {
+      // use the cached parse tree right away, so that includes get fetched
+      // while we drain the (unneeded) document from upstream
+      if (esi_proc->usePackedNodeList(packed_node_list) != EsiProcessor::PROCESS_SUCCESS) {
+        TSError("[%s] Could not use cached parse tree; will parse document", __FUNCTION__);
+        esi_proc->stop();
+        parse_cache_hit = false;
+      } else {
+        TSDebug(debug_tag, "[%s] Using cached parse tree of size %d", __FUNCTION__,
+                 (int) packed_node_list.size());
+      }
+    }
+
     TSDebug(debug_tag, "[%s] Set input data type to [%s]", __FUNCTION__,
              DATA_TYPE_NAMES_[input_type]);
 
@@ -273,9 +310,7 @@ ContData::getClientState() {
     esi_vars = new Variables(createDebugTag(VARS_DEBUG_TAG, contp, vars_tag), &TSDebug, &TSError);
   }
   if (!data_fetcher) {
-    string fetcher_tag;
-    data_fetcher = new HttpDataFetcherImpl(contp, client_addr,
-                                           createDebugTag(FETCHER_DEBUG_TAG, contp, fetcher_tag));
+    data_fetcher = createDataFetcher();
   }
   if (req_bufp && req_hdr_loc) {
     TSMBuffer bufp;
@@ -464,9 +499,41 @@ ContData::getServerState() {
     fillPostHeader(bufp, hdr_loc);
   }
 
+  if (option_info->parse_cache && !head_only) {
+    getParseCacheState(bufp, hdr_loc);
+  }
+
   TSHandleMLocRelease(bufp, TS_NULL_MLOC, hdr_loc);
 }
 
+void
+ContData::getParseCacheState(TSMBuffer bufp, TSMLoc hdr_loc) {
+  if (!request_url) {
+    return;
+  }
+
+  // The document is identified by its URL and validator; without a
+  // validator we can't tell whether a cached parse tree is current
+  TSMLoc field_loc = TSMimeHdrFieldFind(bufp, hdr_loc, TS_MIME_FIELD_ETAG, TS_MIME_LEN_ETAG);
+  if (!field_loc) {
+    field_loc = TSMimeHdrFieldFind(bufp, hdr_loc, TS_MIME_FIELD_LAST_MODIFIED, TS_MIME_LEN_LAST_MODIFIED);
+  }
+  if (!field_loc) {
+    TSDebug(DEBUG_TAG, "[%s] No validator in response; not using parse cache", __FUNCTION__);
+    return;
+  }
+
+  int value_len;
+  const char *value = TSMimeHdrFieldValueStringGet(bufp, hdr_loc, field_loc, -1, &value_len);
+  if (value && value_len) {
+    parse_cache_key.assign(request_url);
+    parse_cache_key.append(" ");
+    parse_cache_key.append(value, value_len);
+    parse_cache_hit = option_info->parse_cache->get(parse_cache_key, packed_node_list);
+  }
+  TSHandleMLocRelease(bufp, hdr_loc, field_loc);
+}
+
 ContData::~ContData()
 {
   TSDebug(debug_tag, "[%s] Destroying continuation data", __FUNCTION__);
@@ -604,6 +671,73 @@ cacheNodeList(ContData *cont_data) {
                   cont_data->contp, NO_CALLBACK, event_ids);
 }
 
+// Adds the parse tree of the document to the in-process parse cache. The
+// processor's own node list has been preprocessed for this request (e.g.,
+// esi:choose has already been decided), so we cache a fresh parse of the
+// document; this only happens once per version of a document.
+static void
+cacheParseTree(ContData *cont_data) {
+  EsiParser parser(DEBUG_TAG, &TSDebug, &TSError);
+  DocNodeList node_list;
+
+  if (parser.parse(node_list, cont_data->raw_doc)) {
+    cont_data->option_info->parse_cache->put(cont_data->parse_cache_key, node_list.pack());
+  }
+  cont_data->raw_doc.clear();
+}
+
+// Writes a chunk of first-byte-flush output to the downstream VC, compressing it
+// first if we are gzipping the output.
+static bool
+writeFlushedData(ContData *cont_data, const string &out_data)
+{
+  const char *data = out_data.data();
+  int data_len = out_data.size();
+  string cdata;
+
+  if (cont_data->gzip_output) {
+    if (!cont_data->esi_gzip->stream_encode(out_data, cdata)) {
+      TSError("[%s] Error while gzipping content", __FUNCTION__);
+    } else {
+      TSDebug(cont_data->debug_tag, "[%s] Compressed document from size %d to %d bytes",
+                 __FUNCTION__, (int) out_data.size(), (int) cdata.size());
+    }
+    data = cdata.data();
+    data_len = cdata.size();
+  }
+
+  if (TSIOBufferWrite(TSVIOBufferGet(cont_data->output_vio), data, data_len) == TS_ERROR) {
+    TSError("[%s] Error while writing bytes to downstream VC", __FUNCTION__);
+    return false;
+  }
+  return true;
+}
+
+// With first-byte-flush, sends out whatever the part of the document parsed so far
+// allows while the rest of it is still being read; i.e., everything up to the first
+// include that hasn't been fetched yet.
+static void
+flushParsedData(ContData *cont_data)
+{
+  string out_data;
+  int overall_len;
+
+  if (cont_data->xform_closed) {
+    return;
+  }
+  // any error will resurface (and be handled) when the document is complete
+  if (cont_data->esi_proc->flush(out_data, overall_len) != EsiProcessor::SUCCESS) {
+    return;
+  }
+  if (out_data.size() > 0) {
+    TSDebug(cont_data->debug_tag, "[%s] flushing %d bytes of partially read document",
+             __FUNCTION__, (int) out_data.size());
+    if (writeFlushedData(cont_data, out_data)) {
+      TSVIOReenable(cont_data->output_vio);
+    }
+  }
+}
+
 static int
 transformData(TSCont contp)
 {
@@ -661,8 +795,13 @@ transformData(TSCont contp)
         // Now start extraction
         while (block != NULL) {
           data = TSIOBufferBlockReadStart(block, cont_data->input_reader, &data_len);
-          if (cont_data->input_type == DATA_TYPE_RAW_ESI) {
+          if (cont_data->parse_cache_hit) {
+            // already have the parse tree; the document itself isn't needed
+          } else if (cont_data->input_type == DATA_TYPE_RAW_ESI) {
             cont_data->esi_proc->addParseData(data, data_len);
+            if (!cont_data->parse_cache_key.empty()) {
+              cont_data->raw_doc.append(data, data_len);
+            }
           } else if (cont_data->input_type == DATA_TYPE_GZIPPED_ESI) {
             cont_data->gzipped_data.append(data, data_len);
           } else {
@@ -679,6 +818,11 @@ transformData(TSCont contp)
       TSDebug(cont_data->debug_tag, "[%s] Consumed %" PRId64" bytes from upstream VC",
                __FUNCTION__, consumed);
 
+      if ((consumed > 0) && cont_data->option_info->first_byte_flush &&
+          (cont_data->parse_cache_hit || (cont_data->input_type == DATA_TYPE_RAW_ESI))) {
+        flushParsedData(cont_data);
+      }
+
       TSIOBufferReaderConsume(cont_data->input_reader, consumed);
 
       // Modify the input VIO to reflect how much data we've completed.
@@ -710,17 +854,27 @@ transformData(TSCont contp)
     }
 
     if (cont_data->input_type != DATA_TYPE_PACKED_ESI) {
-      if (cont_data->input_type == DATA_TYPE_GZIPPED_ESI) {
-        BufferList buf_list;
-        if (gunzip(cont_data->gzipped_data.data(), cont_data->gzipped_data.size(), buf_list)) {
-          for (BufferList::iterator iter = buf_list.begin(); iter != buf_list.end(); ++iter) {
-            cont_data->esi_proc->addParseData(iter->data(), iter->size());
+      bool parsed = cont_data->parse_cache_hit;
+      if (!parsed) {
+        if (cont_data->input_type == DATA_TYPE_GZIPPED_ESI) {
+          BufferList buf_list;
+          if (gunzip(cont_data->gzipped_data.data(), cont_data->gzipped_data.size(), buf_list)) {
+            for (BufferList::iterator iter = buf_list.begin(); iter != buf_list.end(); ++iter) {
+              cont_data->esi_proc->addParseData(iter->data(), iter->size());
+              if (!cont_data->parse_cache_key.empty()) {
+                cont_data->raw_doc.append(iter->data(), iter->size());
+              }
+            }
+          } else {
+            TSError("[%s] Error while gunzipping data", __FUNCTION__);
           }
-        } else {
-          TSError("[%s] Error while gunzipping data", __FUNCTION__);
+        }
+        parsed = cont_data->esi_proc->completeParse();
+        if (parsed && !cont_data->parse_cache_key.empty()) {
+          cacheParseTree(cont_data);
         }
       }
-      if (cont_data->esi_proc->completeParse()) {
+      if (parsed) {
         if (cont_data->option_info->packed_node_support && cont_data->os_response_cacheable
             && !cont_data->cache_txn && !cont_data->head_only)
         {
@@ -807,7 +961,6 @@ transformData(TSCont contp)
       (cont_data->option_info->first_byte_flush)) { // retest as state may have changed in previous block
     TSDebug(cont_data->debug_tag, "[%s] trying to process doc", __FUNCTION__);
     string out_data;
-    string cdata;
     int overall_len;
     EsiProcessor::ReturnCode retval = cont_data->esi_proc->flush(out_data, overall_len);
 
@@ -832,25 +985,8 @@ transformData(TSCont contp)
 
     // make sure transformation has not been prematurely terminated
     if (!cont_data->xform_closed && out_data.size() > 0) {
-      if (cont_data->gzip_output) {
-        if (!cont_data->esi_gzip->stream_encode(out_data, cdata)) {
-          TSError("[%s] Error while gzipping content", __FUNCTION__);
-        } else {
-          TSDebug(cont_data->debug_tag, "[%s] Compressed document from size %d to %d bytes",
-                     __FUNCTION__, (int) out_data.size(), (int) cdata.size());
-        }
-      }
-
-      if (cont_data->gzip_output) {
-        if (TSIOBufferWrite(TSVIOBufferGet(cont_data->output_vio), cdata.data(), cdata.size()) == TS_ERROR) {
-          TSError("[%s] Error while writing bytes to downstream VC", __FUNCTION__);
-          return 0;
-        }
-      } else {
-        if (TSIOBufferWrite(TSVIOBufferGet(cont_data->output_vio), out_data.data(), out_data.size()) == TS_ERROR) {
-          TSError("[%s] Error while writing bytes to downstream VC", __FUNCTION__);
-          return 0;
-        }
+      if (!writeFlushedData(cont_data, out_data)) {
+        return 0;
       }
     }
     if(!cont_data->xform_closed) {     
@@ -985,7 +1121,11 @@ transformHandler(TSCont contp, TSEvent event, void *edata)
       if (is_fetch_event) {
         TSDebug(cont_debug_tag, "[%s] Handling fetch event %d...", __FUNCTION__, event);
         if (cont_data->data_fetcher->handleFetchEvent(event, edata)) {
-          if (cont_data->curr_state == ContData::FETCHING_DATA) {
+          if ((cont_data->curr_state == ContData::READING_ESI_DOC) && cont_data->option_info->first_byte_flush &&
+              (cont_data->parse_cache_hit || (cont_data->input_type == DATA_TYPE_RAW_ESI))) {
+            // an include of the partially read document may have been fetched
+            flushParsedData(cont_data);
+          } else if (cont_data->curr_state == ContData::FETCHING_DATA) {
             // there's a small chance that fetcher is ready even before
             // parsing is complete; hence we need to check the state too
             if(cont_data->option_info->first_byte_flush ||
@@ -1474,6 +1614,10 @@ addTransform(TSHttpTxn txnp, const bool processing_os_response,
     goto lFail;
   }
 
+  if (pOptionInfo->task_threads) {
+    TSTransformThreadPoolSet(contp, TS_THREAD_POOL_TASK);
+  }
+
   cont_data = new ContData(contp, txnp);
   TSContDataSet(contp, cont_data);
 
@@ -1631,13 +1775,17 @@ static int esiPluginInit(int argc, const char *argv[], struct OptionInfo *pOptio
       { const_cast<char *>("disable-gzip-output"), no_argument, NULL, 'z' },
       { const_cast<char *>("first-byte-flush"), no_argument, NULL, 'b' },
       { const_cast<char *>("handler-filename"), required_argument, NULL, 'f' },
+      { const_cast<char *>("task-threads"), no_argument, NULL, 't' },
+      { const_cast<char *>("parse-cache-size"), required_argument, NULL, 'c' },
+      { const_cast<char *>("max-concurrent-fetches"), required_argument, NULL, 'm' },
+      { const_cast<char *>("coalesce-fetches"), no_argument, NULL, 'o' },
       { NULL, 0, NULL, 0 }
     };
 
     optarg = NULL;
     optind = opterr = optopt = 0;
     int longindex = 0;
-    while ((c = getopt_long(argc, (char * const*) argv, "npzbf:", longopts, &longindex)) != -1) {
+    while ((c = getopt_long(argc, (char * const*) argv, "npzbf:tc:m:o", longopts, &longindex)) != -1) {
       switch (c) {
         case 'n':
           pOptionInfo->packed_node_support = true;
@@ -1651,6 +1799,23 @@ static int esiPluginInit(int argc, const char *argv[], struct OptionInfo *pOptio
         case 'b':
           pOptionInfo->first_byte_flush = true;
           break;
+        case 't':
+          pOptionInfo->task_threads = true;
+          break;
+        case 'c':
+          {
+            int max_entries = atoi(optarg);
+            if (max_entries > 0) {
+              pOptionInfo->parse_cache = new ParseCache(PARSE_CACHE_DEBUG_TAG, &TSDebug, &TSError, max_entries);
+            }
+            break;
+          }
+        case 'm':
+          pOptionInfo->max_concurrent_fetches = atoi(optarg);
+          break;
+        case 'o':
+          pOptionInfo->coalesce_fetches = true;
+          break;
         case 'f':
           {
             Utils::KeyValueMap handler_conf;
@@ -1680,9 +1845,12 @@ static int esiPluginInit(int argc, const char *argv[], struct OptionInfo *pOptio
   if (result == 0) {
     TSDebug(DEBUG_TAG, "[%s] Plugin started%s, " \
         "packed-node-support: %d, private-response: %d, " \
-        "disable-gzip-output: %d, first-byte-flush: %d ", __FUNCTION__, bKeySet ? " and key is set" : "",
+        "disable-gzip-output: %d, first-byte-flush: %d, task-threads: %d, parse-cache: %d, " \
+        "max-concurrent-fetches: %d, coalesce-fetches: %d ", __FUNCTION__,
+        bKeySet ? " and key is set" : "",
         pOptionInfo->packed_node_support, pOptionInfo->private_response,
-        pOptionInfo->disable_gzip_output, pOptionInfo->first_byte_flush);
+        pOptionInfo->disable_gzip_output, pOptionInfo->first_byte_flush, pOptionInfo->task_threads,
+        pOptionInfo->parse_cache != NULL, pOptionInfo->max_concurrent_fetches, pOptionInfo->coalesce_fetches);
   }
 
   return result;
@@ -26,12 +26,116 @@
 #include "lib/gzip.h"
 
 #include <arpa/inet.h>
+#include <pthread.h>
 
 using std::string;
 using namespace EsiLib;
 
 const int HttpDataFetcherImpl::FETCH_EVENT_ID_BASE = 10000;
 
+namespace {
+
+// A fetch shared by the fetchers that asked for the same request while it
+// was outstanding
+struct CoalescedFetch {
+  struct Waiter {
+    TSCont contp;
+    int event_id_base;
+    Waiter(TSCont c, int e) : contp(c), event_id_base(e) { }
+  };
+
+  string request;
+  std::vector<Waiter> waiters;
+  string response;
+};
+
+typedef __gnu_cxx::hash_map<string, CoalescedFetch *, StringHasher> CoalescedFetchMap;
+
+static CoalescedFetchMap *coalesced_fetches = 0;
+static TSMutex coalesced_fetches_mutex = 0;
+static pthread_once_t coalesced_fetches_once = PTHREAD_ONCE_INIT;
+
+static const int COALESCED_EVENT_ID_BASE = 10000;
+
+static void
+initCoalescedFetches()
+{
+  coalesced_fetches = new CoalescedFetchMap();
+  coalesced_fetches_mutex = TSMutexCreate();
+}
+
+static int
+coalescedFetchHandler(TSCont contp, TSEvent event, void *edata)
+{
+  CoalescedFetch *fetch = static_cast<CoalescedFetch *>(TSContDataGet(contp));
+
+  if (event == TS_EVENT_IMMEDIATE) {
+    // the fetch API has let go of our lock by now
+    delete fetch;
+    TSContDestroy(contp);
+    return 0;
+  }
+
+  int event_id = static_cast<int>(event) - COALESCED_EVENT_ID_BASE;
+  if (event_id == 0) {
+    int page_data_len;
+    const char *page_data = TSFetchRespGet(static_cast<TSHttpTxn>(edata), &page_data_len);
+    fetch->response.assign(page_data, page_data_len);
+  }
+
+  // later requests start a fetch of their own
+  std::vector<CoalescedFetch::Waiter> waiters;
+  TSMutexLock(coalesced_fetches_mutex);
+  coalesced_fetches->erase(fetch->request);
+  waiters.swap(fetch->waiters);
+  TSMutexUnlock(coalesced_fetches_mutex);
+
+  // as the fetch API does, call back each waiter under its own lock
+  for (std::vector<CoalescedFetch::Waiter>::iterator iter = waiters.begin(); iter != waiters.end(); ++iter) {
+    TSMutex waiter_mutex = TSContMutexGet(iter->contp);
+    TSMutexLock(waiter_mutex);
+    TSContCall(iter->contp, static_cast<TSEvent>(iter->event_id_base + event_id), &fetch->response);
+    TSMutexUnlock(waiter_mutex);
+  }
+
+  TSContSchedule(contp, 0, TS_THREAD_POOL_DEFAULT);
+  return 0;
+}
+
+static void
+coalescedFetch(const string &request, sockaddr const* client_addr, TSCont waiter_contp, int event_id_base,
+               const char *debug_tag)
+{
+  pthread_once(&coalesced_fetches_once, initCoalescedFetches);
+
+  TSMutexLock(coalesced_fetches_mutex);
+  CoalescedFetchMap::iterator iter = coalesced_fetches->find(request);
+  if (iter != coalesced_fetches->end()) {
+    iter->second->waiters.push_back(CoalescedFetch::Waiter(waiter_contp, event_id_base));
+    TSMutexUnlock(coalesced_fetches_mutex);
+    TSDebug(debug_tag, "[%s] Joined outstanding fetch", __FUNCTION__);
+    return;
+  }
+
+  CoalescedFetch *fetch = new CoalescedFetch();
+  fetch->request = request;
+  fetch->waiters.push_back(CoalescedFetch::Waiter(waiter_contp, event_id_base));
+  (*coalesced_fetches)[request] = fetch;
+  TSMutexUnlock(coalesced_fetches_mutex);
+
+  TSCont contp = TSContCreate(coalescedFetchHandler, TSMutexCreate());
+  TSContDataSet(contp, fetch);
+
+  TSFetchEvent event_ids;
+  event_ids.success_event_id = COALESCED_EVENT_ID_BASE;
+  event_ids.failure_event_id = COALESCED_EVENT_ID_BASE + 1;
+  event_ids.timeout_event_id = COALESCED_EVENT_ID_BASE + 2;
+
+  TSFetchUrl(request.data(), request.size(), client_addr, contp, AFTER_BODY, event_ids);
+}
+
+}
+
 inline void HttpDataFetcherImpl::_release(RequestData &req_data)
 {
   if (req_data.bufp) {
@@ -47,6 +151,7 @@ inline void HttpDataFetcherImpl::_release(RequestData &req_data)
 HttpDataFetcherImpl::HttpDataFetcherImpl(TSCont contp,sockaddr const* client_addr,
                                          const char *debug_tag)
   : _contp(contp), _n_pending_requests(0), _curr_event_id_base(FETCH_EVENT_ID_BASE),
+    _max_concurrent(0), _n_issued_requests(0), _coalesce(false),
     _headers_str(""),_client_addr(client_addr)
 {
   _http_parser = TSHttpParserCreate();
@@ -74,40 +179,52 @@ HttpDataFetcherImpl::addFetchRequest(const string &url, FetchedDataProcessor *ca
     return true;
   }
 
-  char buff[1024]; 
-  char *http_req;
-  int length;
-
-  length = sizeof("GET ") - 1 + url.length() + sizeof(" HTTP/1.0\r\n") - 1 + _headers_str.length() + sizeof("\r\n") - 1;
-  if (length < (int)sizeof(buff)) {
-    http_req = buff;
-  }else {
-    http_req = (char *)malloc(length + 1);
-    if (http_req == NULL) {
-      TSError("[%s] malloc %d bytes fail", __FUNCTION__, length + 1);
-      return false;
-    }
-  }
-
-  sprintf(http_req, "GET %s HTTP/1.0\r\n%s\r\n", url.c_str(), _headers_str.c_str());
-
-  TSFetchEvent event_ids;
-  event_ids.success_event_id = _curr_event_id_base;
-  event_ids.failure_event_id = _curr_event_id_base + 1;
-  event_ids.timeout_event_id = _curr_event_id_base + 2;
+  int base_event_id = _page_entry_lookup.size();
   _curr_event_id_base += 3;
+  _page_entry_lookup.push_back(insert_result.first);
+  ++_n_pending_requests;
 
-  TSFetchUrl(http_req, length, _client_addr, _contp, AFTER_BODY, event_ids);
-  if (http_req != buff) {
-    free(http_req);
+  if ((_max_concurrent > 0) && (_n_issued_requests >= _max_concurrent)) {
+    TSDebug(_debug_tag, "[%s] Queued fetch request for URL [%s]; %d requests outstanding", __FUNCTION__,
+             url.data(), _n_issued_requests);
+    _queued_requests.push_back(base_event_id);
+    return true;
   }
-  
+
+  _issueRequest(base_event_id);
   TSDebug(_debug_tag, "[%s] Successfully added fetch request for URL [%s]", __FUNCTION__, url.data());
-  _page_entry_lookup.push_back(insert_result.first);
-  ++_n_pending_requests;
   return true;
 }
 
+void
+HttpDataFetcherImpl::_issueRequest(int base_event_id)
+{
+  const string &url = _page_entry_lookup[base_event_id]->first;
+  int event_id_base = FETCH_EVENT_ID_BASE + (base_event_id * 3);
+  string http_req;
+
+  http_req.reserve(sizeof("GET ") - 1 + url.length() + sizeof(" HTTP/1.0\r\n") - 1 + _headers_str.length() +
+                   sizeof("\r\n") - 1);
+  http_req.append("GET ");
+  http_req.append(url);
+  http_req.append(" HTTP/1.0\r\n");
+  http_req.append(_headers_str);
+  http_req.append("\r\n");
+
+  ++_n_issued_requests;
+  if (_coalesce) {
+    coalescedFetch(http_req, _client_addr, _contp, event_id_base, _debug_tag);
+    return;
+  }
+
+  TSFetchEvent event_ids;
+  event_ids.success_event_id = event_id_base;
+  event_ids.failure_event_id = event_id_base + 1;
+  event_ids.timeout_event_id = event_id_base + 2;
+
+  TSFetchUrl(http_req.data(), http_req.size(), _client_addr, _contp, AFTER_BODY, event_ids);
+}
+
 bool
 HttpDataFetcherImpl::_isFetchEvent(TSEvent event, int &base_event_id) const
 {
@@ -143,15 +260,28 @@ HttpDataFetcherImpl::handleFetchEvent(TSEvent event, void *edata)
   --_n_pending_requests;
   req_data.complete = true;
 
+  // make room for a request that waited
+  --_n_issued_requests;
+  if (!_queued_requests.empty()) {
+    int next_base_event_id = _queued_requests.front();
+    _queued_requests.pop_front();
+    _issueRequest(next_base_event_id);
+  }
+
   int event_id = (static_cast<int>(event) - FETCH_EVENT_ID_BASE) % 3;
   if (event_id != 0) { // failure or timeout
     TSError("[%s] Received failure/timeout event id %d for request [%s]", __FUNCTION__, event_id, req_str.data());
     return true;
   }
 
-  int page_data_len;
-  const char *page_data = TSFetchRespGet(static_cast<TSHttpTxn>(edata), &page_data_len);
-  req_data.response.assign(page_data, page_data_len);
+  if (_coalesce) {
+    req_data.response = *static_cast<const string *>(edata);
+  } else {
+    int page_data_len;
+    const char *page_data = TSFetchRespGet(static_cast<TSHttpTxn>(edata), &page_data_len);
+    req_data.response.assign(page_data, page_data_len);
+  }
+  int page_data_len = req_data.response.size();
   bool valid_data_received = false;
   const char *startptr = req_data.response.data(), *endptr = startptr + page_data_len;
 
@@ -286,6 +416,8 @@ HttpDataFetcherImpl::clear()
     _release(iter->second);
   }
   _n_pending_requests = 0;
+  _n_issued_requests = 0;
+  _queued_requests.clear();
   _pages.clear();
   _page_entry_lookup.clear();
   _headers_str.clear();
@@ -44,6 +44,16 @@ public:
   
   void useHeaders(const EsiLib::HttpHeaderList &headers);
 
+  // Requests added while this many are outstanding wait for one of them to
+  // complete before they are sent; 0 (the default) sends them right away
+  void setMaxConcurrentRequests(int max_concurrent) { _max_concurrent = max_concurrent; }
+
+  // Shares one fetch among identical requests (same URL and headers) of
+  // all the fetchers in the process that coalesce. The fetch is done by a
+  // continuation of its own, which calls back each fetcher's continuation
+  // under that continuation's lock, with the raw response as event data
+  void setCoalesceRequests(bool coalesce) { _coalesce = coalesce; }
+
   bool addFetchRequest(const std::string &url, FetchedDataProcessor *callback_obj = 0);
   
   bool handleFetchEvent(TSEvent event, void *edata);
@@ -119,6 +129,13 @@ private:
   int _curr_event_id_base;
   TSHttpParser _http_parser;
 
+  int _max_concurrent;
+  int _n_issued_requests;
+  bool _coalesce;
+  std::list<int> _queued_requests; // base event ids of requests not yet sent
+
+  void _issueRequest(int base_event_id);
+
   static const int FETCH_EVENT_ID_BASE;
 
   int _getBaseEventId(TSEvent event) const {
@@ -387,10 +387,15 @@ EsiProcessor::flush(string &data, int &overall_len) {
     data.assign("");
     return SUCCESS;
   }
-  if (_curr_state != WAITING_TO_PROCESS) {
-    _errorLog("[%s] Processor has to finish parsing via completeParse() before process() call", __FUNCTION__);
+  if ((_curr_state != WAITING_TO_PROCESS) && (_curr_state != PARSING)) {
+    _errorLog("[%s] Processor has to be parsing or done parsing before flush() call", __FUNCTION__);
     return FAILURE;
   }
+  // While still parsing, we can only flush the nodes parsed so far, and we leave the
+  // try blocks alone: splicing their nodes into the list would shift the nodes that
+  // _preprocess() has yet to see. Output stops at the first try block until the
+  // document is complete.
+  bool parsing = (_curr_state == PARSING);
   DocNodeList::iterator node_iter,iter;
   bool attempt_succeeded;
   bool attempt_pending;
@@ -399,7 +404,7 @@ EsiProcessor::flush(string &data, int &overall_len) {
   _output_data.clear();
   TryBlockList::iterator try_iter = _try_blocks.begin();
   for (int i = 0; i < _n_try_blocks_processed; ++i, ++try_iter);
-  for (; _n_try_blocks_processed < static_cast<int>(_try_blocks.size()); ++try_iter) {
+  for (; !parsing && (_n_try_blocks_processed < static_cast<int>(_try_blocks.size())); ++try_iter) {
     attempt_pending=false;
     for(node_iter=try_iter->attempt_nodes.begin(); node_iter!=try_iter->attempt_nodes.end(); ++node_iter) {
       if((node_iter->type == DocNode::TYPE_INCLUDE) ||
@@ -497,6 +502,12 @@ EsiProcessor::flush(string &data, int &overall_len) {
               __FUNCTION__, DocNode::type_names_[doc_node.type], doc_node.data_len,
               (doc_node.data_len ? doc_node.data : "(null)"));
 
+    // Special include handlers only see the complete document in _handleParseComplete()
+    if (parsing && (doc_node.type == DocNode::TYPE_SPECIAL_INCLUDE)) {
+      node_pending = true;
+      break;
+    }
+
     if(_getIncludeStatus(doc_node) == STATUS_DATA_PENDING) {
       node_pending = true;
       break;
@@ -526,7 +537,7 @@ EsiProcessor::flush(string &data, int &overall_len) {
     }
   }
 
-  if(!node_pending) {
+  if(!node_pending && !parsing) {
     _curr_state = PROCESSED;
     _addFooterData();
   }
@@ -82,7 +82,8 @@ public:
 
   /** Process the ESI document and flush processed data as much as 
    * possible. Can be called when fetcher hasn't finished pulling 
-   * in all data. */
+   * in all data, and while the document is still being parsed, in
+   * which case only the nodes parsed so far are flushed. */
   ReturnCode flush(std:: string &data, int &overall_len);
  
   /** returns packed version of document currently being processed */
@@ -0,0 +1,78 @@
+/** @file
+
+  A brief file description
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#include "ParseCache.h"
+
+using std::string;
+using namespace EsiLib;
+
+ParseCache::ParseCache(const char *debug_tag, Debug debug_func, Error error_func, int max_entries)
+  : ComponentBase(debug_tag, debug_func, error_func), _max_entries(max_entries) {
+  pthread_mutex_init(&_mutex, NULL);
+}
+
+bool
+ParseCache::get(const string &key, string &packed_node_list) {
+  bool retval = false;
+  pthread_mutex_lock(&_mutex);
+  EntryMap::iterator map_iter = _entry_map.find(key);
+  if (map_iter != _entry_map.end()) {
+    // move to the front of the list to mark as most recently used
+    _entries.splice(_entries.begin(), _entries, map_iter->second);
+    packed_node_list.assign(map_iter->second->second);
+    retval = true;
+  }
+  pthread_mutex_unlock(&_mutex);
+  _debugLog(_debug_tag, "[%s] %s for key [%.*s]", __FUNCTION__, retval ? "Hit" : "Miss",
+            static_cast<int>(key.size()), key.data());
+  return retval;
+}
+
+void
+ParseCache::put(const string &key, const string &packed_node_list) {
+  if (_max_entries <= 0) {
+    return;
+  }
+  pthread_mutex_lock(&_mutex);
+  EntryMap::iterator map_iter = _entry_map.find(key);
+  if (map_iter != _entry_map.end()) {
+    map_iter->second->second.assign(packed_node_list);
+    _entries.splice(_entries.begin(), _entries, map_iter->second);
+  } else {
+    if (static_cast<int>(_entry_map.size()) >= _max_entries) {
+      _debugLog(_debug_tag, "[%s] Evicting key [%.*s]", __FUNCTION__,
+                static_cast<int>(_entries.back().first.size()), _entries.back().first.data());
+      _entry_map.erase(_entries.back().first);
+      _entries.pop_back();
+    }
+    _entries.push_front(Entry(key, packed_node_list));
+    _entry_map[key] = _entries.begin();
+  }
+  pthread_mutex_unlock(&_mutex);
+  _debugLog(_debug_tag, "[%s] Cached packed node list of size %d for key [%.*s]", __FUNCTION__,
+            static_cast<int>(packed_node_list.size()), static_cast<int>(key.size()), key.data());
+}
+
+ParseCache::~ParseCache() {
+  pthread_mutex_destroy(&_mutex);
+}
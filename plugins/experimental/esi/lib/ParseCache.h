@@ -0,0 +1,71 @@
+/** @file
+
+  A brief file description
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#ifndef _ESI_PARSE_CACHE_H
+
+#define _ESI_PARSE_CACHE_H
+
+#include <string>
+#include <list>
+#include <pthread.h>
+
+#include "ComponentBase.h"
+#include "StringHash.h"
+
+namespace EsiLib {
+
+/** In-process LRU cache of parsed ESI documents, shared by all
+ * transactions. Documents are kept as packed node lists (see
+ * DocNodeList::pack()), keyed by the caller; the key has to identify
+ * the exact version of the document, e.g. URL plus validator. */
+class ParseCache : protected ComponentBase {
+
+public:
+
+  ParseCache(const char *debug_tag, Debug debug_func, Error error_func, int max_entries);
+
+  /** copies the packed node list cached for given key into the
+   * supplied buffer; returns false if there is none */
+  bool get(const std::string &key, std::string &packed_node_list);
+
+  /** adds (or replaces) the packed node list for given key, evicting
+   * the least recently used document if the cache is full */
+  void put(const std::string &key, const std::string &packed_node_list);
+
+  ~ParseCache();
+
+private:
+
+  typedef std::pair<std::string, std::string> Entry;
+  typedef std::list<Entry> EntryList; // most recently used first
+  typedef StringKeyHash<EntryList::iterator> EntryMap;
+
+  EntryList _entries;
+  EntryMap _entry_map;
+  int _max_entries;
+  pthread_mutex_t _mutex;
+};
+
+};
+
+#endif // _ESI_PARSE_CACHE_H
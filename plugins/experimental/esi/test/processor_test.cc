@@ -1129,6 +1129,32 @@ int main()
     assert(esi_proc.usePackedNodeList(packedNodeList.data(), 0) == EsiProcessor::UNPACK_FAILURE);
   }
 
+  {
+    cout << endl << "===================== Test 49) flushing while parsing" << endl;
+    TestHttpDataFetcher data_fetcher;
+    EsiProcessor esi_proc("processor", "parser", "expression", &Debug, &Error, data_fetcher, esi_vars,
+                          handler_mgr);
+    string output_data;
+    int overall_len;
+
+    assert(esi_proc.addParseData("foo <esi:include src=url1/>") == true);
+    assert(esi_proc.flush(output_data, overall_len) == EsiProcessor::SUCCESS);
+    assert(output_data == "foo >>>>> Content for URL [url1] <<<<<");
+    assert(overall_len == 38);
+
+    // try blocks are held back until the document is complete
+    assert(esi_proc.addParseData("<esi:try><esi:attempt><esi:include src=url2/></esi:attempt>"
+                                 "<esi:except>except</esi:except></esi:try> bar") == true);
+    assert(esi_proc.flush(output_data, overall_len) == EsiProcessor::SUCCESS);
+    assert(output_data.size() == 0);
+    assert(overall_len == 38);
+
+    assert(esi_proc.completeParse() == true);
+    assert(esi_proc.flush(output_data, overall_len) == EsiProcessor::SUCCESS);
+    assert(output_data == ">>>>> Content for URL [url2] <<<<< bar");
+    assert(overall_len == 76);
+  }
+
   cout << endl << "All tests passed!" << endl;
   return 0;
 }
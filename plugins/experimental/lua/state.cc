@@ -109,8 +109,63 @@ thread_id()
   }
 }
 
+// Slots are handed out to threads in the order they first run Lua code. We store the
+// slot + 1, so that a NULL thread specific value means no slot has been assigned yet.
+static pthread_key_t LuaThreadSlotKey;
+static pthread_once_t LuaThreadSlotOnce = PTHREAD_ONCE_INIT;
+static unsigned LuaThreadSlotNext = 0;
+
+static void
+thread_slot_init()
+{
+  TSReleaseAssert(pthread_key_create(&LuaThreadSlotKey, NULL) == 0);
+}
+
+static unsigned
+thread_slot()
+{
+  uintptr_t slot;
+
+  pthread_once(&LuaThreadSlotOnce, thread_slot_init);
+
+  slot = (uintptr_t)pthread_getspecific(LuaThreadSlotKey);
+  if (slot == 0) {
+    slot = __sync_add_and_fetch(&LuaThreadSlotNext, 1);
+    pthread_setspecific(LuaThreadSlotKey, (void *)slot);
+  }
+
+  return (unsigned)(slot - 1);
+}
+
+// Return the number of threads that might run Lua hooks; that is the event threads
+// plus the task threads.
+static unsigned
+thread_count()
+{
+  TSMgmtInt autoconfig, limit, tasks;
+  TSMgmtFloat scale;
+  unsigned count;
+
+  if (TSMgmtIntGet("proxy.config.exec_thread.autoconfig", &autoconfig) != TS_SUCCESS ||
+      TSMgmtIntGet("proxy.config.exec_thread.limit", &limit) != TS_SUCCESS ||
+      TSMgmtFloatGet("proxy.config.exec_thread.autoconfig.scale", &scale) != TS_SUCCESS ||
+      TSMgmtIntGet("proxy.config.task_threads", &tasks) != TS_SUCCESS) {
+    return nproc() * 2;
+  }
+
+  count = autoconfig ? (unsigned)(nproc() * scale) : (unsigned)limit;
+  return std::max(count, 1u) + (unsigned)std::max(tasks, (TSMgmtInt)0);
+}
+
+static int
+LuaChunkWriter(lua_State * /* lua ATS_UNUSED */, const void * ptr, size_t nbytes, void * ud)
+{
+  static_cast<std::string *>(ud)->append(static_cast<const char *>(ptr), nbytes);
+  return 0;
+}
+
 LuaPluginInstance::LuaPluginInstance()
-  : instanceid(INVALID_INSTANCE_ID), paths(), states()
+  : instanceid(INVALID_INSTANCE_ID), paths(), chunks(), states()
 {
 }
 
@@ -128,6 +183,7 @@ LuaPluginInstance::invalidate()
 
   this->states.clear();
   this->paths.clear();
+  this->chunks.clear();
   this->instanceid = INVALID_INSTANCE_ID;
 
   for (unsigned i = 0; i < countof(this->demux.global); ++i) {
@@ -146,9 +202,8 @@ LuaPluginInstance::init(unsigned argc, const char ** argv)
     this->paths.push_back(argv[i]);
   }
 
-  // Make sure we have enough threads to make concurrent access to lua
-  // states unlikely.
-  this->states.resize(nproc() * 2);
+  // One state per thread, so that concurrent hooks don't serialize on the same state.
+  this->states.resize(thread_count());
 
   InitDemuxTable<LuaDemuxGlobalHook>(this->demux.global);
   InitDemuxTable<LuaDemuxSsnHook>(this->demux.ssn);
@@ -162,6 +217,42 @@ LuaPluginInstance::init(unsigned argc, const char ** argv)
 
 }
 
+// Compile the Lua files once, so that each of the states only has to load the bytecode.
+bool
+LuaPluginInstance::compile()
+{
+  lua_State * lua = luaL_newstate();
+
+  if (lua == NULL) {
+    return false;
+  }
+
+  for (pathlist_t::const_iterator p = this->paths.begin(); p < this->paths.end(); ++p) {
+    std::string chunk;
+
+    LuaLogDebug("compiling Lua program from %s", p->c_str());
+    if (access(p->c_str(), F_OK) != 0) {
+      LuaLogError("%s: %s", p->c_str(), strerror(errno));
+      continue;
+    }
+
+    if (luaL_loadfile(lua, p->c_str()) != 0) {
+      // If the load failed, it should have pushed an error message.
+      LuaLogError("failed to load Lua file %s: %s", p->c_str(), lua_tostring(lua, -1));
+      lua_close(lua);
+      return false;
+    }
+
+    lua_dump(lua, LuaChunkWriter, &chunk);
+    lua_pop(lua, 1);
+
+    this->chunks.push_back(std::make_pair(*p, chunk));
+  }
+
+  lua_close(lua);
+  return true;
+}
+
 instanceid_t
 LuaPluginRegister(unsigned argc, const char ** argv)
 {
@@ -193,6 +284,7 @@ LuaPluginRegister(unsigned argc, const char ** argv)
   // instance ID was used.
   TSReleaseAssert(plugin->paths.empty());
   LuaPluginStorage[instanceid]->init(argc, argv);
+  plugin->compile();
 
   // Allocate the Lua states, then separately initialize by evaluating all the Lua files.
   for (unsigned i = 0; i < plugin->states.size(); ++i) {
@@ -260,16 +352,14 @@ LuaThreadState::alloc(LuaPluginInstance * plugin, unsigned threadid)
 bool
 LuaThreadState::init(LuaPluginInstance * plugin)
 {
-  for (LuaPluginInstance::pathlist_t::const_iterator p = plugin->paths.begin(); p < plugin->paths.end(); ++p) {
-    LuaLogDebug("loading Lua program from %s", p->c_str());
-    if (access(p->c_str(), F_OK) != 0) {
-      LuaLogError("%s: %s", p->c_str(), strerror(errno));
-      continue;
-    }
+  for (LuaPluginInstance::chunklist_t::const_iterator c = plugin->chunks.begin(); c < plugin->chunks.end(); ++c) {
+    std::string name("@" + c->first);
 
-    if (luaL_dofile(this->lua, p->c_str()) != 0) {
+    LuaLogDebug("loading Lua program from %s", c->first.c_str());
+    if (luaL_loadbuffer(this->lua, c->second.data(), c->second.size(), name.c_str()) != 0 ||
+        lua_pcall(this->lua, 0, 0, 0) != 0) {
       // If the load failed, it should have pushed an error message.
-      LuaLogError("failed to load Lua file %s: %s", p->c_str(), lua_tostring(lua, -1));
+      LuaLogError("failed to load Lua file %s: %s", c->first.c_str(), lua_tostring(lua, -1));
       return false;
     }
   }
@@ -329,9 +419,9 @@ LuaThreadStateAcquire(instanceid_t instanceid)
 
   instance = LuaPluginStorage[instanceid];
 
-  // Index the set of LuaThreadStates with the thread ID. We might want to do a proper
-  // hash on this to prevent false sharing.
-  which = thread_id() % instance->states.size();
+  // Index the set of LuaThreadStates with the thread's slot. This only wraps (and shares
+  // a state) if more threads run Lua code than we sized the pool for.
+  which = thread_slot() % instance->states.size();
   lthread = instance->states[which];
 
   LuaLogDebug("%u/%p acquired state %u from plugin instance %u on thread %u",
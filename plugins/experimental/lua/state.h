@@ -34,14 +34,19 @@ instances. Each instance is handled by a LuaPluginInstance object.
 Each plugin instance maintains a pool of lua_States which are
 independent Lua interpeters. The LuaThreadState object owns a single
 lua_State, holding additional hook data that is needed to de-multiplex
-events.
+events. The pool is sized to the number of event threads, and the Lua
+files are compiled once when the instance is registered, then loaded as
+bytecode into every lua_State.
 
 There are two basic code paths to obtaining a LuaThreadState. If
 we already have a lua_State, then we can use the __instanceid and
 __threadid global variables to identify the LuaThreadState object.
 If we don't have a lua_State, then we know the instance ID from the
 hook continuation data (attached per LuaPluginInstance), and we
-choose a state by hashing the thread ID.
+choose a state by the calling thread's slot. Each thread is given its
+own slot the first time it runs Lua code, and uses the same slot in
+every instance, so threads only share a lua_State (and contend for its
+mutex) if there are more of them than states in the pool.
 
   Traffic Server +-> LuaPluginInstance[0]
                  |   +-> LuaThreadState[0]
@@ -92,6 +97,7 @@ private:
 struct LuaPluginInstance
 {
   typedef std::vector<std::string> pathlist_t;
+  typedef std::vector<std::pair<std::string, std::string> > chunklist_t; // (path, bytecode)
   typedef TSCont demux_table_t[TS_HTTP_LAST_HOOK];
 
   LuaPluginInstance();
@@ -99,6 +105,7 @@ struct LuaPluginInstance
 
   void invalidate();
   void init(unsigned argc, const char ** argv);
+  bool compile();
 
   struct {
     demux_table_t global;
@@ -108,6 +115,7 @@ struct LuaPluginInstance
 
   instanceid_t  instanceid;
   pathlist_t    paths;
+  chunklist_t   chunks;
   std::vector<LuaThreadState *> states;
 
 private:
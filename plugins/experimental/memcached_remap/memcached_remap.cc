@@ -16,23 +16,116 @@
   limitations under the License.
 */
 
+/*
+  The lookups go to memcached over connections of Traffic Server's own
+  net layer, in the memcached text protocol, and the transaction waits
+  for the answer without holding up its thread. Each connection runs
+  one lookup at a time, idle ones are kept for the next lookups. The
+  mappings looked up, and the keys found missing, are kept for a while
+  so that most requests do not need a lookup at all.
+*/
+
 #include <ts/ts.h>
 #include <ts/remap.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
-
-// change this on your box
-#include <libmemcached/memcached.h>
+#include <time.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <string>
+#include <map>
+#include <list>
 
 // global settings
 static const char *PLUGIN_NAME = "memcached_remap";
 
-// memcached related global variables
-memcached_server_st *servers;
-memcached_st *memc;
+static struct sockaddr_storage server_addr;
+static int mapping_ttl = 60;            // seconds a looked up mapping is kept
+static int lookup_timeout = 1000;       // milliseconds a lookup may take
+static size_t pool_max = 16;            // idle connections kept open
+
+#define MAPPINGS_MAX 100000
+
+// A looked up mapping, an empty target is a key memcached did not have.
+struct Mapping
+{
+    std::string target;
+    time_t expires;
+};
+
+static std::map<std::string, Mapping> mappings;
+static TSMutex mappings_mutex;
+
+// A connection to memcached and the lookup running on it.
+struct McConn
+{
+    TSCont cont;
+    TSVConn vc;
+    TSIOBuffer rbuf, wbuf;
+    TSIOBufferReader rreader, wreader;
+    TSAction timeout;
+    bool dead;                  // closed by the server while idle
+
+    TSHttpTxn txnp;             // NULL while idle
+    std::string key;
+    std::string response;
+};
+
+static std::list<McConn *> pool;
+static TSMutex pool_mutex;
+
+enum McResult
+{
+    MC_INCOMPLETE,
+    MC_FOUND,
+    MC_MISSING,
+    MC_FAILED
+};
+
+static bool mapping_get(const std::string & key, std::string & target)
+{
+    bool found = false;
+
+    TSMutexLock(mappings_mutex);
+    std::map<std::string, Mapping>::iterator it = mappings.find(key);
+    if (it != mappings.end()) {
+        if (it->second.expires > time(NULL)) {
+            target = it->second.target;
+            found = true;
+        } else {
+            mappings.erase(it);
+        }
+    }
+    TSMutexUnlock(mappings_mutex);
+    return found;
+}
+
+static void mapping_put(const std::string & key, const std::string & target)
+{
+    time_t now = time(NULL);
+
+    TSMutexLock(mappings_mutex);
+    if (mappings.size() >= MAPPINGS_MAX) {
+        std::map<std::string, Mapping>::iterator it = mappings.begin();
+        while (it != mappings.end()) {
+            if (it->second.expires <= now)
+                mappings.erase(it++);
+            else
+                ++it;
+        }
+        if (mappings.size() >= MAPPINGS_MAX)
+            mappings.clear();
+    }
+    Mapping & m = mappings[key];
+    m.target = target;
+    m.expires = now + mapping_ttl;
+    TSMutexUnlock(mappings_mutex);
+}
 
-bool do_memcached_remap(TSCont contp, TSHttpTxn txnp)
+// The key of a request is [PROTOCOL]://[HOST]:[PORT]/
+static bool memcached_remap_key(TSHttpTxn txnp, std::string & key)
 {
     TSMBuffer reqp;
     TSMLoc hdr_loc, url_loc, field_loc;
@@ -44,13 +137,8 @@ bool do_memcached_remap(TSCont contp, TSHttpTxn txnp)
     int request_scheme_length = 0;
     int request_port = 80;
     char ikey[1024];
-    char *m_result = NULL;
-    size_t oval_length;
-    uint32_t flags;
-    memcached_return_t lrc;
 
-    if (TSHttpTxnClientReqGet((TSHttpTxn) txnp, &reqp, &hdr_loc) !=
-        TS_SUCCESS) {
+    if (TSHttpTxnClientReqGet(txnp, &reqp, &hdr_loc) != TS_SUCCESS) {
         TSDebug(PLUGIN_NAME, "could not get request data");
         return false;
     }
@@ -60,7 +148,6 @@ bool do_memcached_remap(TSCont contp, TSHttpTxn txnp)
         goto release_hdr;
     }
 
-
     field_loc =
         TSMimeHdrFieldFind(reqp, hdr_loc, TS_MIME_FIELD_HOST,
                            TS_MIME_LEN_HOST);
@@ -73,7 +160,7 @@ bool do_memcached_remap(TSCont contp, TSHttpTxn txnp)
     request_host =
         TSMimeHdrFieldValueStringGet(reqp, hdr_loc, field_loc, 0,
                                      &request_host_length);
-    if (request_host == NULL || strlen(request_host) < 1) {
+    if (request_host == NULL || request_host_length < 1) {
         TSDebug(PLUGIN_NAME, "couldn't find request HOST header");
         goto release_field;
     }
@@ -88,86 +175,315 @@ bool do_memcached_remap(TSCont contp, TSHttpTxn txnp)
             request_scheme_length, request_scheme, request_host_length,
             request_host, request_port);
 
-    snprintf(ikey, 1024, "%.*s://%.*s:%d/", request_scheme_length,
+    snprintf(ikey, sizeof(ikey), "%.*s://%.*s:%d/", request_scheme_length,
              request_scheme, request_host_length, request_host,
              request_port);
 
-    TSDebug(PLUGIN_NAME, "querying for the key %s\n", ikey);
-    m_result =
-        memcached_get(memc, ikey, strlen(ikey), &oval_length, &flags,
-                      &lrc);
+    // memcached keys are at most 250 bytes, without spaces or controls
+    if (strlen(ikey) <= 250 && !strpbrk(ikey, " \t\r\n")) {
+        key = ikey;
+        ret_val = true;
+    }
+
+  release_field:
+    TSHandleMLocRelease(reqp, hdr_loc, field_loc);
+  release_url:
+    TSHandleMLocRelease(reqp, hdr_loc, url_loc);
+  release_hdr:
+    TSHandleMLocRelease(reqp, TS_NULL_MLOC, hdr_loc);
 
+    return ret_val;
+}
+
+// Send the request to target, an empty or invalid target is a 404.
+static bool do_memcached_remap(TSHttpTxn txnp, const std::string & target)
+{
+    TSMBuffer reqp;
+    TSMLoc hdr_loc, url_loc, field_loc;
+    bool ret_val = false;
     char oscheme[1024], ohost[1024];
     int oport;
 
-    if (lrc == MEMCACHED_SUCCESS) {
-        TSDebug(PLUGIN_NAME, "got the response from server : %s\n",
-                m_result);
-        TSDebug(PLUGIN_NAME, "scanf result : %d\n",
-                sscanf(m_result, "%[a-zA-Z]://%[^:]:%d", oscheme, ohost,
-                       &oport));
-        if (sscanf
-            (m_result, "%[a-zA-Z]://%[^:]:%d", oscheme, ohost,
-             &oport) == 3) {
-            if (m_result)
-                free(m_result);
-            TSDebug(PLUGIN_NAME, "\nOUTGOING REQUEST ->\n ::: to_scheme_desc: %s\n ::: to_hostname: %s\n ::: to_port: %d", oscheme, ohost, oport);      //row[0],row[1],row[2]);
-            TSMimeHdrFieldValueStringSet(reqp, hdr_loc, field_loc, 0,
-                                         ohost, -1);
-            TSUrlHostSet(reqp, url_loc, ohost, -1);
-            TSUrlSchemeSet(reqp, url_loc, oscheme, -1);
-            TSUrlPortSet(reqp, url_loc, oport);
-            ret_val = true;
-        } else {
-            if (m_result)
-                free(m_result);
-            goto not_found;
-        }
-    } else {
-        TSDebug(PLUGIN_NAME,
-                "didn't get any response from the server %d, %d, %d\n",
-                lrc, flags, oval_length);
-        goto not_found;
+    if (TSHttpTxnClientReqGet(txnp, &reqp, &hdr_loc) != TS_SUCCESS) {
+        TSDebug(PLUGIN_NAME, "could not get request data");
+        return false;
     }
 
-    goto free_stuff;            // free the result set after processed
+    if (TSHttpHdrUrlGet(reqp, hdr_loc, &url_loc) != TS_SUCCESS) {
+        TSDebug(PLUGIN_NAME, "couldn't retrieve request url");
+        goto release_hdr;
+    }
 
-  not_found:
-    //lets build up a nice 404 message for someone
-    if (!ret_val) {
+    field_loc =
+        TSMimeHdrFieldFind(reqp, hdr_loc, TS_MIME_FIELD_HOST,
+                           TS_MIME_LEN_HOST);
+
+    if (!target.empty()
+        && sscanf(target.c_str(), "%1023[a-zA-Z]://%1023[^:]:%d", oscheme,
+                  ohost, &oport) == 3) {
+        TSDebug(PLUGIN_NAME, "\nOUTGOING REQUEST ->\n ::: to_scheme_desc: %s\n ::: to_hostname: %s\n ::: to_port: %d", oscheme, ohost, oport);
+        if (field_loc)
+            TSMimeHdrFieldValueStringSet(reqp, hdr_loc, field_loc, 0,
+                                         ohost, -1);
+        TSUrlHostSet(reqp, url_loc, ohost, -1);
+        TSUrlSchemeSet(reqp, url_loc, oscheme, -1);
+        TSUrlPortSet(reqp, url_loc, oport);
+        ret_val = true;
+    } else {
+        //lets build up a nice 404 message for someone
         TSHttpHdrStatusSet(reqp, hdr_loc, TS_HTTP_STATUS_NOT_FOUND);
         TSHttpTxnSetHttpRetStatus(txnp, TS_HTTP_STATUS_NOT_FOUND);
     }
-  free_stuff:
-#if (TS_VERSION_NUMBER < 2001005)
-    if (request_host)
-        TSHandleStringRelease(reqp, hdr_loc, request_host);
-    if (request_scheme)
-        TSHandleStringRelease(reqp, hdr_loc, request_scheme);
-#endif
-  release_field:
+
     if (field_loc)
         TSHandleMLocRelease(reqp, hdr_loc, field_loc);
-  release_url:
-    if (url_loc)
-        TSHandleMLocRelease(reqp, hdr_loc, url_loc);
+    TSHandleMLocRelease(reqp, hdr_loc, url_loc);
   release_hdr:
-    if (hdr_loc)
-        TSHandleMLocRelease(reqp, TS_NULL_MLOC, hdr_loc);
+    TSHandleMLocRelease(reqp, TS_NULL_MLOC, hdr_loc);
 
     return ret_val;
 }
 
+// Parse a response to a get of one key:
+// VALUE <key> <flags> <bytes>\r\n<data>\r\nEND\r\n or END\r\n
+static McResult mc_parse(const std::string & response, std::string & value)
+{
+    size_t eol = response.find("\r\n");
+    unsigned flags;
+    long bytes;
+
+    if (eol == std::string::npos)
+        return MC_INCOMPLETE;
+    if (response.compare(0, 5, "END\r\n") == 0)
+        return MC_MISSING;
+    if (response.compare(0, 6, "VALUE ") != 0)
+        return MC_FAILED;
+
+    std::string line = response.substr(0, eol);
+    size_t sp = line.find(' ', 6);
+    if (sp == std::string::npos
+        || sscanf(line.c_str() + sp, " %u %ld", &flags, &bytes) != 2
+        || bytes < 0)
+        return MC_FAILED;
+
+    size_t data = eol + 2;
+    if (response.size() < data + bytes + 7)
+        return MC_INCOMPLETE;
+    if (response.compare(data + bytes, 7, "\r\nEND\r\n") != 0)
+        return MC_FAILED;
+    value = response.substr(data, bytes);
+    return MC_FOUND;
+}
+
+static int mc_handler(TSCont contp, TSEvent event, void *edata);
+
+static McConn *mc_conn_create()
+{
+    McConn *c = new McConn;
+
+    c->cont = TSContCreate(mc_handler, TSMutexCreate());
+    TSContDataSet(c->cont, c);
+    c->vc = NULL;
+    c->rbuf = TSIOBufferCreate();
+    c->rreader = TSIOBufferReaderAlloc(c->rbuf);
+    c->wbuf = TSIOBufferCreate();
+    c->wreader = TSIOBufferReaderAlloc(c->wbuf);
+    c->timeout = NULL;
+    c->dead = false;
+    c->txnp = NULL;
+    return c;
+}
+
+static void mc_conn_destroy(McConn * c)
+{
+    if (c->timeout)
+        TSActionCancel(c->timeout);
+    if (c->vc)
+        TSVConnClose(c->vc);
+    TSIOBufferReaderFree(c->rreader);
+    TSIOBufferDestroy(c->rbuf);
+    TSIOBufferReaderFree(c->wreader);
+    TSIOBufferDestroy(c->wbuf);
+    TSContDestroy(c->cont);
+    delete c;
+}
+
+static void mc_send(McConn * c)
+{
+    std::string req = "get " + c->key + "\r\n";
+
+    TSIOBufferWrite(c->wbuf, req.data(), req.size());
+    TSVConnWrite(c->vc, c->cont, c->wreader, req.size());
+}
+
+// The lookup on c is over, remap the transaction and keep c for the
+// next lookup if it can be reused.
+static void mc_lookup_done(McConn * c, McResult result,
+                           const std::string & value)
+{
+    TSHttpTxn txnp = c->txnp;
+    bool reuse = (result == MC_FOUND || result == MC_MISSING);
+
+    if (c->timeout) {
+        TSActionCancel(c->timeout);
+        c->timeout = NULL;
+    }
+    c->txnp = NULL;
+
+    if (reuse)
+        mapping_put(c->key, result == MC_FOUND ? value : "");
+    else
+        TSDebug(PLUGIN_NAME, "lookup of %s failed", c->key.c_str());
+
+    if (reuse) {
+        TSMutexLock(pool_mutex);
+        if (pool.size() < pool_max) {
+            pool.push_back(c);
+            c = NULL;
+        }
+        TSMutexUnlock(pool_mutex);
+    }
+    if (c)
+        mc_conn_destroy(c);
+
+    TSHttpTxnReenable(txnp,
+                      do_memcached_remap(txnp, result == MC_FOUND ? value : "")
+                      ? TS_EVENT_HTTP_CONTINUE : TS_EVENT_HTTP_ERROR);
+}
+
+static int mc_handler(TSCont contp, TSEvent event, void *edata)
+{
+    McConn *c = (McConn *) TSContDataGet(contp);
+    std::string value;
+    McResult result;
+
+    switch (event) {
+    case TS_EVENT_NET_CONNECT:
+        c->vc = (TSVConn) edata;
+        TSVConnRead(c->vc, c->cont, c->rbuf, INT64_MAX);
+        if (c->txnp)
+            mc_send(c);
+        return 0;
+
+    case TS_EVENT_VCONN_WRITE_READY:
+    case TS_EVENT_VCONN_WRITE_COMPLETE:
+        return 0;
+
+    case TS_EVENT_VCONN_READ_READY:
+        while (TSIOBufferReaderAvail(c->rreader) > 0) {
+            TSIOBufferBlock block = TSIOBufferReaderStart(c->rreader);
+            int64_t avail;
+            const char *data =
+                TSIOBufferBlockReadStart(block, c->rreader, &avail);
+
+            c->response.append(data, avail);
+            TSIOBufferReaderConsume(c->rreader, avail);
+        }
+        if (!c->txnp)
+            break;              // nothing was asked on an idle connection
+        result = mc_parse(c->response, value);
+        if (result == MC_INCOMPLETE)
+            return 0;
+        mc_lookup_done(c, result, value);
+        return 0;
+
+    case TS_EVENT_TIMEOUT:
+        c->timeout = NULL;
+        TSDebug(PLUGIN_NAME, "lookup of %s timed out", c->key.c_str());
+        break;
+
+    default:
+        // the connection failed or the server closed it
+        break;
+    }
+
+    if (c->txnp) {
+        mc_lookup_done(c, MC_FAILED, value);
+        return 0;
+    }
+
+    // An idle connection is done, unless a lookup took it from the
+    // pool and waits for this handler, then that lookup disposes of it.
+    bool pooled = false;
+
+    TSMutexLock(pool_mutex);
+    for (std::list<McConn *>::iterator it = pool.begin(); it != pool.end(); ++it) {
+        if (*it == c) {
+            pool.erase(it);
+            pooled = true;
+            break;
+        }
+    }
+    TSMutexUnlock(pool_mutex);
+    if (pooled)
+        mc_conn_destroy(c);
+    else
+        c->dead = true;
+    return 0;
+}
+
+// Look the key up in memcached, the transaction is reenabled once it
+// has the answer.
+static void mc_lookup(TSHttpTxn txnp, const std::string & key)
+{
+    McConn *c = NULL;
+
+    for (;;) {
+        TSMutexLock(pool_mutex);
+        if (!pool.empty()) {
+            c = pool.front();
+            pool.pop_front();
+        }
+        TSMutexUnlock(pool_mutex);
+        if (!c)
+            break;
+        TSMutexLock(TSContMutexGet(c->cont));
+        if (!c->dead)
+            break;
+        TSMutexUnlock(TSContMutexGet(c->cont));
+        mc_conn_destroy(c);
+        c = NULL;
+    }
+
+    if (!c) {
+        // nothing else knows of a new connection, and the connect may
+        // call back, and even dispose of it, before returning
+        c = mc_conn_create();
+        c->txnp = txnp;
+        c->key = key;
+        c->timeout = TSContSchedule(c->cont, lookup_timeout, TS_THREAD_POOL_DEFAULT);
+        TSNetConnect(c->cont, (struct sockaddr const *) &server_addr);
+        return;
+    }
+
+    c->txnp = txnp;
+    c->key = key;
+    c->response.clear();
+    c->timeout = TSContSchedule(c->cont, lookup_timeout, TS_THREAD_POOL_DEFAULT);
+    mc_send(c);
+    TSMutexUnlock(TSContMutexGet(c->cont));
+}
+
 static int memcached_remap(TSCont contp, TSEvent event, void *edata)
 {
     TSHttpTxn txnp = (TSHttpTxn) edata;
     TSEvent reenable = TS_EVENT_HTTP_CONTINUE;
+    std::string key, target;
 
     if (event == TS_EVENT_HTTP_READ_REQUEST_HDR) {
         TSDebug(PLUGIN_NAME, "Reading Request");
         TSSkipRemappingSet(txnp, 1);
-        if (!do_memcached_remap(contp, txnp)) {
+        if (!memcached_remap_key(txnp, key)) {
+            do_memcached_remap(txnp, "");
             reenable = TS_EVENT_HTTP_ERROR;
+        } else if (mapping_get(key, target)) {
+            TSDebug(PLUGIN_NAME, "found the key %s in the local cache", key.c_str());
+            if (!do_memcached_remap(txnp, target))
+                reenable = TS_EVENT_HTTP_ERROR;
+        } else {
+            TSDebug(PLUGIN_NAME, "querying for the key %s", key.c_str());
+            mc_lookup(txnp, key);
+            return 0;
         }
     }
 
@@ -178,9 +494,10 @@ static int memcached_remap(TSCont contp, TSEvent event, void *edata)
 void TSPluginInit(int argc, const char *argv[])
 {
     TSPluginRegistrationInfo info;
-    memcached_return_t rc;
-    //FILE *fp;
-    //char servers_string[8192];
+    const char *server = "localhost:11211";
+    struct addrinfo hints, *res;
+    char host[256];
+    const char *port;
 
     info.plugin_name = const_cast < char *>(PLUGIN_NAME);
     info.vendor_name = const_cast < char *>("Apache Software Foundation");
@@ -192,49 +509,45 @@ void TSPluginInit(int argc, const char *argv[])
         return;
     }
 
-    // parse the configuration file
-    // TODO: this is still under testing 1.0.2 version should have this feature
-    /*
-    if(argc < 1) {
-        TSError("memcached_remap: you should pass a configuration file as argument to plugin with list of servers.\n");
-        return;
+    // server=host:port ttl=<seconds> timeout=<milliseconds> pool=<connections>
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "server=", 7) == 0)
+            server = argv[i] + 7;
+        else if (strncmp(argv[i], "ttl=", 4) == 0)
+            mapping_ttl = atoi(argv[i] + 4);
+        else if (strncmp(argv[i], "timeout=", 8) == 0)
+            lookup_timeout = atoi(argv[i] + 8);
+        else if (strncmp(argv[i], "pool=", 5) == 0)
+            pool_max = atoi(argv[i] + 5);
+        else
+            TSError("memcached_remap: unknown argument %s\n", argv[i]);
     }
 
-    fp = fopen(argv[0], "r");
-    if(!fp) {
-        TSError("memcached_remap: Failed to open the configuration file %s\n", argv[0]);
+    port = strrchr(server, ':');
+    if (!port || port - server >= (int) sizeof(host)) {
+        TSError("memcached_remap: invalid server %s\n", server);
         return;
     }
-
-    while(!feof(fp)) {
-        fscanf(fp,"servers=%[^\n] ", servers_string);
-    }
-
-    fclose(fp);
-    */
-
-    // initialize the memcache
-    //fp = NULL;
-    //snprintf(servers_string, 1,"%c",'h');
-    memc = memcached_create(NULL);
-
-    //servers = memcached_servers_parse(servers_string);
-
-    servers = memcached_server_list_append(NULL, "localhost", 11211, &rc);
-    if (rc != MEMCACHED_SUCCESS) {
-        TSError
-            ("memcached_remap: plugin registration failed while adding servers.\n");
+    memcpy(host, server, port - server);
+    host[port - server] = '\0';
+    port++;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, port, &hints, &res) != 0) {
+        TSError("memcached_remap: unable to resolve server %s\n", server);
         return;
     }
+    memcpy(&server_addr, res->ai_addr, res->ai_addrlen);
+    freeaddrinfo(res);
 
-    rc = memcached_server_push(memc, servers);
-    if (rc != MEMCACHED_SUCCESS) {
-        TSError
-            ("memcached_remap: plugin registration failed while adding to pool.\n");
-        return;
-    }
+    mappings_mutex = TSMutexCreate();
+    pool_mutex = TSMutexCreate();
 
-    TSCont cont = TSContCreate(memcached_remap, TSMutexCreate());
+    // the transactions only share the mappings and the pool, which
+    // have their own locks
+    TSCont cont = TSContCreate(memcached_remap, NULL);
 
     TSHttpHookAdd(TS_HTTP_READ_REQUEST_HDR_HOOK, cont);
 
@@ -16,66 +16,336 @@
   limitations under the License.
 */
 
+/*
+  Mappings are served from memory. A request for a host not in memory,
+  or whose mapping is older than the TTL, waits for a query run by one
+  of the plugin's own threads, each with its own MySQL connection, and
+  is reenabled from a net thread once the query is done. Requests for
+  the same host meanwhile wait for the same query. A mapping older
+  than the refresh time is still served while a query refreshes it.
+*/
+
 #include <ts/ts.h>
 #include <ts/remap.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <string>
+#include <map>
+#include <list>
+#include <deque>
 
 #include "mysql/mysql.h"
 #include "lib/iniparser.h"
 #include "default.h"
 
-MYSQL mysql;
+// What a database connection needs, copied out of the ini file.
+struct DbConfig {
+  std::string host;
+  int port;
+  std::string username;
+  std::string password;
+  std::string db;
+  bool has_username;
+  bool has_password;
+};
+
+static DbConfig db_config;
+static int mapping_ttl = 300;           // seconds before a mapping must be queried again
+static int mapping_refresh = 240;       // seconds before a mapping is refreshed in the background
+
+#define MAPPINGS_MAX 100000
+
+// A host, scheme and port, and where the requests for them go.
+struct Mapping {
+  bool found;
+  std::string scheme;
+  std::string host;
+  int port;
+  time_t fetched;
+};
+
+// A query for a mapping and the transactions waiting for it.
+struct Query {
+  std::string key;
+  std::string host;
+  int scheme_id;
+  int port;
+  bool ok;                      // the query ran
+  Mapping result;
+  std::list<TSHttpTxn> waiters;
+  TSCont cont;
+};
+
+static std::map<std::string, Mapping> mappings;
+static std::map<std::string, Query *> queries;   // in flight
+static TSMutex mappings_mutex;
+
+static std::deque<Query *> queue;
+static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+
+static bool db_connect(MYSQL *mysql) {
+  my_bool reconnect = 1;
+
+  if (!mysql_init(mysql)) {
+    TSError("Could not initialize MySQL");
+    return false;
+  }
+  mysql_options(mysql, MYSQL_OPT_RECONNECT, &reconnect);
+  if (!mysql_real_connect(mysql, db_config.host.c_str(),
+                          db_config.has_username ? db_config.username.c_str() : NULL,
+                          db_config.has_password ? db_config.password.c_str() : NULL,
+                          db_config.db.c_str(), db_config.port, NULL, 0)) {
+    TSError("Could not connect to mysql");
+    TSDebug(PLUGIN_NAME,"Could not connect to mysql: %s",mysql_error(mysql));
+    mysql_close(mysql);
+    return false;
+  }
+  return true;
+}
+
+static bool db_query(MYSQL *mysql, Query *q) {
+  char query[QSIZE];
+  char host[2 * 256 + 1];
+  MYSQL_RES *res;
+  MYSQL_ROW row;
+
+  if (q->host.size() > 256)
+    return false;
+  mysql_real_escape_string(mysql, host, q->host.data(), q->host.size());
+
+  snprintf(query,QSIZE," \
+    SELECT \
+        t_scheme.scheme_desc, \
+        t_host.hostname, \
+        to_port \
+      FROM map \
+        INNER JOIN scheme as t_scheme ON (map.to_scheme_id = t_scheme.id) \
+        INNER JOIN scheme as f_scheme ON (map.from_scheme_id = f_scheme.id) \
+        INNER JOIN hostname as t_host ON (map.to_hostname_id = t_host.id) \
+        INNER JOIN hostname as f_host ON (map.from_hostname_id = f_host.id) \
+      WHERE \
+        is_enabled=1 \
+        AND f_host.hostname = '%s' \
+        AND f_scheme.id = %d \
+        AND from_port = %d \
+      LIMIT 1", \
+    host, \
+    q->scheme_id, \
+    q->port \
+  );
+
+  if (mysql_real_query(mysql,query,(unsigned int)strlen(query))) {
+    TSDebug(PLUGIN_NAME,"query failed: %s",mysql_error(mysql));
+    return false;
+  }
+  res = mysql_store_result(mysql);
+  if (!res)
+    return false;
+
+  row = mysql_fetch_row(res);
+  q->result.found = (row != NULL);
+  if (row) {
+    q->result.scheme = row[0];
+    q->result.host = row[1];
+    q->result.port = atoi(row[2]);
+  }
+  mysql_free_result(res);
+  return true;
+}
+
+// One of the threads running the queries.
+static void *
+mysql_worker(void * /* data */) {
+  MYSQL mysql;
+  bool connected = false;
+
+  mysql_thread_init();
+  for (;;) {
+    pthread_mutex_lock(&queue_mutex);
+    while (queue.empty())
+      pthread_cond_wait(&queue_cond, &queue_mutex);
+    Query *q = queue.front();
+    queue.pop_front();
+    pthread_mutex_unlock(&queue_mutex);
 
-typedef struct {
-  char * query;
-} my_data;
+    if (!connected)
+      connected = db_connect(&mysql);
+    q->ok = connected && db_query(&mysql, q);
+    q->result.fetched = time(NULL);
+
+    // back to a net thread, to update the mappings and the transactions
+    TSContSchedule(q->cont, 0, TS_THREAD_POOL_NET);
+  }
+  return NULL;
+}
 
-bool do_mysql_remap(TSCont contp,TSHttpTxn txnp) {
+// Send the request where the mapping says, or answer it with a 404.
+bool do_mysql_remap(TSHttpTxn txnp, const Mapping *m) {
   TSMBuffer reqp;
   TSMLoc hdr_loc, url_loc, field_loc;
   bool ret_val = false;
-  
+
+  if (TSHttpTxnClientReqGet(txnp, &reqp, &hdr_loc) != TS_SUCCESS) {
+    TSDebug(PLUGIN_NAME,"could not get request data");
+    return false;
+  }
+
+  TSHttpHdrUrlGet(reqp, hdr_loc,&url_loc);
+
+  if (!url_loc) {
+    TSDebug(PLUGIN_NAME,"couldn't retrieve request url");
+    goto release_hdr;
+  }
+
+  field_loc = TSMimeHdrFieldFind(reqp, hdr_loc, TS_MIME_FIELD_HOST, TS_MIME_LEN_HOST);
+
+  if (m && m->found) {
+    TSDebug(PLUGIN_NAME,"\nOUTGOING REQUEST ->\n ::: to_scheme_desc: %s\n ::: to_hostname: %s\n ::: to_port: %d",
+            m->scheme.c_str(), m->host.c_str(), m->port);
+    if (field_loc)
+      TSMimeHdrFieldValueStringSet(reqp, hdr_loc, field_loc, 0, m->host.data(), m->host.size());
+    TSUrlHostSet(reqp,url_loc,m->host.data(),m->host.size());
+    TSUrlSchemeSet(reqp,url_loc,m->scheme.data(),m->scheme.size());
+    TSUrlPortSet(reqp,url_loc,m->port);
+    ret_val = true;
+  } else {
+    //lets build up a nice 404 message for someone
+    TSHttpHdrStatusSet(reqp,hdr_loc,TS_HTTP_STATUS_NOT_FOUND);
+    TSHttpTxnSetHttpRetStatus(txnp,TS_HTTP_STATUS_NOT_FOUND);
+  }
+
+  if (field_loc)
+    TSHandleMLocRelease(reqp, hdr_loc, field_loc);
+  TSHandleMLocRelease(reqp, hdr_loc, url_loc);
+release_hdr:
+  TSHandleMLocRelease(reqp, TS_NULL_MLOC, hdr_loc);
+
+  return ret_val;
+}
+
+// A query is done, keep its mapping and remap the transactions which waited for it.
+static int
+mysql_query_done(TSCont contp, TSEvent /* event */, void * /* edata */) {
+  Query *q = (Query *) TSContDataGet(contp);
+  Mapping m;
+  bool have = false;
+
+  TSMutexLock(mappings_mutex);
+  if (q->ok) {
+    // any Host gets a mapping, found or not, drop the old ones now and then
+    if (mappings.size() >= MAPPINGS_MAX) {
+      time_t now = time(NULL);
+      for (std::map<std::string, Mapping>::iterator i = mappings.begin(); i != mappings.end();) {
+        if (now - i->second.fetched >= mapping_ttl)
+          mappings.erase(i++);
+        else
+          ++i;
+      }
+      if (mappings.size() >= MAPPINGS_MAX)
+        mappings.clear();
+    }
+    mappings[q->key] = q->result;
+  }
+  // a failed refresh keeps the mapping until the TTL
+  std::map<std::string, Mapping>::iterator it = mappings.find(q->key);
+  if (it != mappings.end()) {
+    m = it->second;
+    have = true;
+  }
+  queries.erase(q->key);
+  TSMutexUnlock(mappings_mutex);
+
+  for (std::list<TSHttpTxn>::iterator t = q->waiters.begin(); t != q->waiters.end(); ++t) {
+    bool remapped = do_mysql_remap(*t, have ? &m : NULL);
+    TSHttpTxnReenable(*t, remapped ? TS_EVENT_HTTP_CONTINUE : TS_EVENT_HTTP_ERROR);
+  }
+
+  TSContDestroy(contp);
+  delete q;
+  return 0;
+}
+
+// Queue a query for key, unless one is in flight, the transaction, if
+// any, waits for it. Called with mappings_mutex held.
+static void
+mysql_query_start(const std::string &key, const std::string &host, int scheme_id, int port, TSHttpTxn txnp) {
+  std::map<std::string, Query *>::iterator it = queries.find(key);
+  Query *q;
+
+  if (it != queries.end()) {
+    q = it->second;
+  } else {
+    q = new Query;
+    q->key = key;
+    q->host = host;
+    q->scheme_id = scheme_id;
+    q->port = port;
+    q->ok = false;
+    q->cont = TSContCreate(mysql_query_done, TSMutexCreate());
+    TSContDataSet(q->cont, q);
+    queries[key] = q;
+
+    pthread_mutex_lock(&queue_mutex);
+    queue.push_back(q);
+    pthread_cond_signal(&queue_cond);
+    pthread_mutex_unlock(&queue_mutex);
+  }
+  if (txnp)
+    q->waiters.push_back(txnp);
+}
+
+// Remap from memory, or have the transaction wait for a query.
+// Returns false if the transaction is waiting.
+static bool
+mysql_remap_lookup(TSHttpTxn txnp, TSEvent *reenable) {
+  TSMBuffer reqp;
+  TSMLoc hdr_loc, url_loc, field_loc;
+  bool have_key = false;
+
   const char * request_host;
   int request_host_length = 0;
   const char * request_scheme;
   int request_scheme_length = 0;
   int request_port = 80;
-  char * query;
-  
-  MYSQL_ROW row;
-  MYSQL_RES *res;
-  
-  my_data * data = (my_data*) TSContDataGet(contp);
-  query = data->query;
-  
+  int scheme_id;
+  char key[512];
+  std::string host;
+  Mapping m;
+  time_t now = time(NULL);
+
+  *reenable = TS_EVENT_HTTP_ERROR;
+
   if (TSHttpTxnClientReqGet(txnp, &reqp, &hdr_loc) != TS_SUCCESS) {
     TSDebug(PLUGIN_NAME,"could not get request data");
-    return false;
+    return true;
   }
-  
+
   TSHttpHdrUrlGet(reqp, hdr_loc,&url_loc);
-  
+
   if (!url_loc) {
     TSDebug(PLUGIN_NAME,"couldn't retrieve request url");
     goto release_hdr;
   }
-  
+
   field_loc = TSMimeHdrFieldFind(reqp, hdr_loc, TS_MIME_FIELD_HOST, TS_MIME_LEN_HOST);
-  
+
   if (!field_loc) {
       TSDebug(PLUGIN_NAME,"couldn't retrieve request HOST header");
       goto release_url;
   }
-  
+
   request_host = TSMimeHdrFieldValueStringGet (reqp, hdr_loc, field_loc, 0, &request_host_length);
-  if (!request_host_length) {
+  if (!request_host_length || request_host_length > 256) {
     TSDebug(PLUGIN_NAME,"couldn't find request HOST header");
     goto release_field;
   }
-  
+
   request_scheme = TSUrlSchemeGet(reqp,url_loc,&request_scheme_length);
   request_port   = TSUrlPortGet(reqp,url_loc);
+  scheme_id = (request_scheme_length == 5 && strncmp(request_scheme, "https", 5) == 0) ? 2 : 1;
 
   TSDebug(PLUGIN_NAME,"      +++++MYSQL REMAP+++++      ");
 
@@ -86,90 +356,59 @@ bool do_mysql_remap(TSCont contp,TSHttpTxn txnp) {
     request_host,\
     request_port
   );
-  
-  snprintf(query,QSIZE," \
-    SELECT \
-        t_scheme.scheme_desc, \
-        t_host.hostname, \
-        to_port \
-      FROM map \
-        INNER JOIN scheme as t_scheme ON (map.to_scheme_id = t_scheme.id) \
-        INNER JOIN scheme as f_scheme ON (map.from_scheme_id = f_scheme.id) \
-        INNER JOIN hostname as t_host ON (map.to_hostname_id = t_host.id) \
-        INNER JOIN hostname as f_host ON (map.from_hostname_id = f_host.id) \
-      WHERE \
-        is_enabled=1 \
-        AND f_host.hostname = '%.*s' \
-        AND f_scheme.id = %d \
-        AND from_port = %d \
-      LIMIT 1", \
-    request_host_length, \
-    request_host, \
-    (strcmp(request_scheme,"https") == 0) ? 2:1, \
-    request_port \
-  );
-  
-  mysql_real_query(&mysql,query,(unsigned int)strlen(query));
-  res = mysql_use_result(&mysql);
-  
-  if (!res) goto not_found; //TODO: define a fallback
-  
-  do { 
-    row = mysql_fetch_row(res);
-    if (!row) goto not_found;
-    TSDebug(PLUGIN_NAME,"\nOUTGOING REQUEST ->\n ::: to_scheme_desc: %s\n ::: to_hostname: %s\n ::: to_port: %s",row[0],row[1],row[2]);
-    TSMimeHdrFieldValueStringSet(reqp, hdr_loc, field_loc, 0,row[1],-1);
-    TSUrlHostSet(reqp,url_loc,row[1],-1);
-    TSUrlSchemeSet(reqp,url_loc,row[0],-1);
-    TSUrlPortSet(reqp,url_loc,atoi(row[2]));
-  } while(0);
-  
-  ret_val = true;
-
-not_found:
-  if (!ret_val) {
-    //lets build up a nice 404 message for someone
-    TSHttpHdrStatusSet(reqp,hdr_loc,TS_HTTP_STATUS_NOT_FOUND);
-    TSHttpTxnSetHttpRetStatus(txnp,TS_HTTP_STATUS_NOT_FOUND);
-  }
-  if (res)
-    mysql_free_result(res);
-#if (TS_VERSION_NUMBER < 2001005)
-  if (request_host)
-    TSHandleStringRelease(reqp, hdr_loc, request_host);
-  if (request_scheme)
-    TSHandleStringRelease(reqp, hdr_loc, request_scheme);
-#endif
+
+  snprintf(key, sizeof(key), "%d:%d:%.*s", scheme_id, request_port, request_host_length, request_host);
+  host.assign(request_host, request_host_length);
+  have_key = true;
+
 release_field:
-  if (field_loc)
-    TSHandleMLocRelease(reqp, hdr_loc, field_loc);
+  TSHandleMLocRelease(reqp, hdr_loc, field_loc);
 release_url:
-  if (url_loc)
-    TSHandleMLocRelease(reqp, hdr_loc, url_loc);
+  TSHandleMLocRelease(reqp, hdr_loc, url_loc);
 release_hdr:
-  if (hdr_loc)
-    TSHandleMLocRelease(reqp, TS_NULL_MLOC, hdr_loc);
-  
-  return ret_val;
+  TSHandleMLocRelease(reqp, TS_NULL_MLOC, hdr_loc);
+
+  if (!have_key) {
+    do_mysql_remap(txnp, NULL);
+    return true;
+  }
+
+  // the query may finish and reenable the transaction as soon as the lock is released
+  TSMutexLock(mappings_mutex);
+  std::map<std::string, Mapping>::iterator it = mappings.find(key);
+  if (it != mappings.end() && now - it->second.fetched < mapping_ttl) {
+    m = it->second;
+    if (now - it->second.fetched >= mapping_refresh)
+      mysql_query_start(key, host, scheme_id, request_port, NULL);
+  } else {
+    mysql_query_start(key, host, scheme_id, request_port, txnp);
+    TSMutexUnlock(mappings_mutex);
+    return false;
+  }
+  TSMutexUnlock(mappings_mutex);
+
+  if (do_mysql_remap(txnp, &m))
+    *reenable = TS_EVENT_HTTP_CONTINUE;
+  return true;
 }
 
 static int
-mysql_remap (TSCont contp, TSEvent event, void *edata) {
+mysql_remap (TSCont /* contp */, TSEvent event, void *edata) {
   TSHttpTxn txnp = (TSHttpTxn) edata;
   TSEvent reenable = TS_EVENT_HTTP_CONTINUE;
-  
+
   switch(event) {
     case TS_EVENT_HTTP_READ_REQUEST_HDR:
       TSDebug(PLUGIN_NAME,"Reading Request");
       TSSkipRemappingSet(txnp,1);
-      if (!do_mysql_remap(contp,txnp)) {
-        reenable = TS_EVENT_HTTP_ERROR;
+      if (!mysql_remap_lookup(txnp, &reenable)) {
+        return 0;               // reenabled once the query is done
       }
       break;
     default:
       break;
   }
-  
+
   TSHttpTxnReenable(txnp, reenable);
   return 1;
 }
@@ -177,72 +416,66 @@ mysql_remap (TSCont contp, TSEvent event, void *edata) {
 void
 TSPluginInit(int argc, const char *argv[]) {
   dictionary * ini;
-  const char * host;
-  int port;
   const char * username;
   const char * password;
-  const char * db;
-  
-  my_data * data = (my_data*) malloc(1*sizeof(my_data));
-  
+  int threads;
+
   TSPluginRegistrationInfo info;
-  my_bool reconnect = 1;
-  
+
   info.plugin_name   = const_cast<char*>(PLUGIN_NAME);
   info.vendor_name   = const_cast<char*>("Apache Software Foundation");
   info.support_email = const_cast<char*>("eric@ericbalsa.com");
 
   if (TSPluginRegister(TS_SDK_VERSION_2_0 , &info) != TS_SUCCESS) {
-    TSError("mysql_remap: plugin registration failed.\n"); 
+    TSError("mysql_remap: plugin registration failed.\n");
   }
 
   if (argc != 2) {
     TSError( "usage: %s /path/to/sample.ini\n", argv[0] );
     return;
   }
-  
+
   ini = iniparser_load(argv[1]);
   if (!ini) {
     TSError("Error with ini file (1)");
     TSDebug(PLUGIN_NAME,"Error parsing ini file(1)");
     return;
   }
-  
-  host     = iniparser_getstring(ini, "mysql_remap:mysql_host", (char*)"localhost");
-  port     =    iniparser_getint(ini,"mysql_remap:mysql_port",3306);
+
+  db_config.host = iniparser_getstring(ini, "mysql_remap:mysql_host", (char*)"localhost");
+  db_config.port = iniparser_getint(ini,"mysql_remap:mysql_port",3306);
   username = iniparser_getstring(ini, "mysql_remap:mysql_username", NULL);
   password = iniparser_getstring(ini, "mysql_remap:mysql_password", NULL);
-  db       = iniparser_getstring(ini, "mysql_remap:mysql_database", (char*)"mysql_remap");
-  
+  db_config.has_username = (username != NULL);
+  db_config.username = username ? username : "";
+  db_config.has_password = (password != NULL);
+  db_config.password = password ? password : "";
+  db_config.db = iniparser_getstring(ini, "mysql_remap:mysql_database", (char*)"mysql_remap");
+  threads = iniparser_getint(ini, "mysql_remap:threads", 4);
+  mapping_ttl = iniparser_getint(ini, "mysql_remap:cache_ttl", 300);
+  mapping_refresh = iniparser_getint(ini, "mysql_remap:cache_refresh", mapping_ttl * 4 / 5);
+
   if (mysql_library_init(0, NULL, NULL)) {
     TSError("Error initializing mysql client library");
     TSDebug(PLUGIN_NAME,"Error initializing mysql client library");
     return;
   }
-  
-  if (!mysql_init(&mysql)) {
-    TSError("Could not initialize MySQL");
-    TSDebug(PLUGIN_NAME,"Could not initialize MySQL");
-    return;
-  }
-  
-  mysql_options(&mysql, MYSQL_OPT_RECONNECT, &reconnect);
-  
-  if (!mysql_real_connect(&mysql,host,username,password,db,port,NULL,0)) {
-    TSError("Could not connect to mysql");
-    TSDebug(PLUGIN_NAME,"Could not connect to mysql: %s",mysql_error(&mysql));
-    return;
+
+  // the queries run on the plugin's threads, each with its connection
+  mappings_mutex = TSMutexCreate();
+  for (int i = 0; i < (threads > 0 ? threads : 1); i++) {
+    if (!TSThreadCreate(mysql_worker, NULL)) {
+      TSError("Could not create a mysql_remap thread");
+      return;
+    }
   }
-  
-  data->query = (char*)TSmalloc(QSIZE * sizeof(char)); //TODO: malloc smarter sizes
-      
-  TSDebug(PLUGIN_NAME, "h: %s; u: %s; p: %s; p:%d; d:%s",host,username,password,port,db);
-  TSCont cont = TSContCreate(mysql_remap, TSMutexCreate());
-  
+
+  TSDebug(PLUGIN_NAME, "h: %s; u: %s; p: %s; p:%d; d:%s; threads:%d", db_config.host.c_str(),
+          db_config.username.c_str(), db_config.password.c_str(), db_config.port, db_config.db.c_str(), threads);
+  TSCont cont = TSContCreate(mysql_remap, NULL);
+
   TSHttpHookAdd(TS_HTTP_READ_REQUEST_HDR_HOOK, cont);
 
-  TSContDataSet (cont, (void *)data);
-  
   TSDebug(PLUGIN_NAME, "plugin is successfully initialized [plugin mode]");
   iniparser_freedict(ini);
   return;
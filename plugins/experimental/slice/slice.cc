@@ -0,0 +1,730 @@
+/** @file
+
+  Serve range requests from fixed size blocks of the object, each cached on
+  its own.
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+// A client range request is intercepted and answered from a series of
+// internal block requests, made through TSHttpConnect() back into the proxy.
+// Each block request asks for one aligned block of the object and comes back
+// through this remap rule, where it gets a cache key of its own and its
+// range is passed to the origin. The 206 response from the origin is stored
+// as a 200 so that the block is cached, and the blocks are stitched back
+// into a single 206 response to the client. A range of an object that was
+// never fully downloaded is served from whichever blocks are cached and only
+// the missing blocks go to the origin.
+
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <climits>
+
+#include <getopt.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <ts/ts.h>
+#include <ts/remap.h>
+
+#define PLUGIN_NAME "slice"
+
+#define SliceLogDebug(fmt, ...)  TSDebug(PLUGIN_NAME, "%s: " fmt, __func__, ##__VA_ARGS__)
+#define SliceLogError(fmt, ...)  TSError(PLUGIN_NAME ": " fmt, ##__VA_ARGS__)
+
+// Carries the byte range of an internal block request, "first-last".
+static const char SLICE_BLOCK_FIELD[] = "X-Slice-Block";
+static const int  SLICE_BLOCK_FIELD_LEN = sizeof(SLICE_BLOCK_FIELD) - 1;
+
+static const int64_t SLICE_DEFAULT_BLOCK_BYTES = 1024 * 1024;
+static const int64_t SLICE_MIN_BLOCK_BYTES = 64 * 1024;
+
+static TSCont SliceBlockContinuation;
+
+struct SliceOptions
+{
+    int64_t blockbytes;
+
+    SliceOptions() : blockbytes(SLICE_DEFAULT_BLOCK_BYTES) {
+    }
+};
+
+static bool
+SliceHeaderGet(TSMBuffer bufp, TSMLoc hdr, const char * name, int namelen, std::string& value)
+{
+    TSMLoc field = TSMimeHdrFieldFind(bufp, hdr, name, namelen);
+    if (field == TS_NULL_MLOC) {
+        return false;
+    }
+
+    int len = 0;
+    const char * str = TSMimeHdrFieldValueStringGet(bufp, hdr, field, -1, &len);
+    value.assign(str ? str : "", str ? len : 0);
+    TSHandleMLocRelease(bufp, hdr, field);
+    return true;
+}
+
+static void
+SliceHeaderRemove(TSMBuffer bufp, TSMLoc hdr, const char * name, int namelen)
+{
+    TSMLoc field = TSMimeHdrFieldFind(bufp, hdr, name, namelen);
+    while (field != TS_NULL_MLOC) {
+        TSMLoc next = TSMimeHdrFieldNextDup(bufp, hdr, field);
+        TSMimeHdrFieldDestroy(bufp, hdr, field);
+        TSHandleMLocRelease(bufp, hdr, field);
+        field = next;
+    }
+}
+
+static void
+SliceHeaderSet(TSMBuffer bufp, TSMLoc hdr, const char * name, int namelen, const char * value, int valuelen)
+{
+    TSMLoc field;
+
+    SliceHeaderRemove(bufp, hdr, name, namelen);
+    if (TSMimeHdrFieldCreateNamed(bufp, hdr, name, namelen, &field) == TS_SUCCESS) {
+        TSMimeHdrFieldValueStringSet(bufp, hdr, field, -1, value, valuelen);
+        TSMimeHdrFieldAppend(bufp, hdr, field);
+        TSHandleMLocRelease(bufp, hdr, field);
+    }
+}
+
+// Parse a single "bytes=first-last" or "bytes=first-" range. Suffix and
+// multiple ranges are left to the proxy.
+static bool
+SliceParseRange(const std::string& range, int64_t& first, int64_t& last)
+{
+    const char * str = range.c_str();
+    char * end;
+
+    if (strncasecmp(str, "bytes=", 6) != 0 || strchr(str, ',') != NULL) {
+        return false;
+    }
+
+    str += 6;
+    if (*str < '0' || *str > '9') {
+        return false;
+    }
+
+    first = strtoll(str, &end, 10);
+    if (*end != '-') {
+        return false;
+    }
+
+    str = end + 1;
+    if (*str == '\0') {
+        last = -1;
+        return true;
+    }
+
+    last = strtoll(str, &end, 10);
+    return *end == '\0' && last >= first;
+}
+
+// Parse "bytes first-last/total" from a Content-Range field.
+static bool
+SliceParseContentRange(const std::string& range, int64_t& first, int64_t& last, int64_t& total)
+{
+    long long f, l, t;
+
+    if (sscanf(range.c_str(), "bytes %lld-%lld/%lld", &f, &l, &t) != 3 || f > l || l >= t) {
+        return false;
+    }
+
+    first = f;
+    last = l;
+    total = t;
+    return true;
+}
+
+// State of one intercepted client range request.
+struct SliceRequest
+{
+    TSCont          cont;
+    int64_t         blockbytes;
+    sockaddr_storage client_addr;
+
+    TSMBuffer       reqbuf;     // Client request without its Range field.
+    TSMLoc          reqhdr;
+
+    int64_t         range_first;
+    int64_t         range_last; // -1 for an open ended range
+    int64_t         total;      // Object length, -1 until the first block arrives.
+    int64_t         pos;        // Next object offset to send to the client.
+    int64_t         send_end;   // Object offset past the last byte to send.
+    bool            passthrough;// The first block was not a range, relay it as is.
+    std::string     etag;
+    std::string     last_modified;
+
+    TSVConn         client_vc;
+    TSIOBuffer      client_in;
+    TSIOBufferReader client_in_reader;
+    TSVIO           client_read_vio;
+    TSIOBuffer      client_out;
+    TSIOBufferReader client_out_reader;
+    TSVIO           client_write_vio;
+    int64_t         client_bytes;
+
+    TSVConn         block_vc;
+    TSIOBuffer      block_in;
+    TSIOBufferReader block_in_reader;
+    TSVIO           block_read_vio;
+    TSIOBuffer      block_out;
+    TSIOBufferReader block_out_reader;
+    TSHttpParser    parser;
+    TSMBuffer       respbuf;
+    TSMLoc          resphdr;
+    bool            block_headers;  // The block response header has been parsed.
+    bool            block_eos;
+    int64_t         block_index;
+    int64_t         block_pos;      // Object offset of the next block body byte.
+    int64_t         block_end;      // Object offset past the end of the block.
+
+    SliceRequest()
+        : cont(NULL), blockbytes(SLICE_DEFAULT_BLOCK_BYTES), reqbuf(NULL), reqhdr(TS_NULL_MLOC),
+          range_first(0), range_last(-1), total(-1), pos(0), send_end(0), passthrough(false),
+          client_vc(NULL), client_in(NULL), client_in_reader(NULL), client_read_vio(NULL),
+          client_out(NULL), client_out_reader(NULL), client_write_vio(NULL), client_bytes(0),
+          block_vc(NULL), block_in(NULL), block_in_reader(NULL), block_read_vio(NULL),
+          block_out(NULL), block_out_reader(NULL), parser(TSHttpParserCreate()),
+          respbuf(TSMBufferCreate()), resphdr(TS_NULL_MLOC), block_headers(false), block_eos(false),
+          block_index(0), block_pos(0), block_end(0) {
+        memset(&client_addr, 0, sizeof(client_addr));
+        resphdr = TSHttpHdrCreate(respbuf);
+    }
+
+    ~SliceRequest() {
+        this->closeBlock();
+        if (this->client_vc) {
+            TSVConnClose(this->client_vc);
+        }
+        if (this->client_in) {
+            TSIOBufferDestroy(this->client_in);
+        }
+        if (this->client_out) {
+            TSIOBufferDestroy(this->client_out);
+        }
+        if (this->reqbuf) {
+            TSHandleMLocRelease(this->reqbuf, TS_NULL_MLOC, this->reqhdr);
+            TSMBufferDestroy(this->reqbuf);
+        }
+        TSHttpHdrDestroy(this->respbuf, this->resphdr);
+        TSHandleMLocRelease(this->respbuf, TS_NULL_MLOC, this->resphdr);
+        TSMBufferDestroy(this->respbuf);
+        TSHttpParserDestroy(this->parser);
+        TSContDestroy(this->cont);
+    }
+
+    void closeBlock() {
+        if (this->block_vc) {
+            TSVConnClose(this->block_vc);
+            this->block_vc = NULL;
+        }
+        if (this->block_in) {
+            TSIOBufferDestroy(this->block_in);
+            TSIOBufferDestroy(this->block_out);
+            this->block_in = this->block_out = NULL;
+        }
+        this->block_read_vio = NULL;
+    }
+
+    bool accept(TSVConn vc);
+    bool fetchBlock();
+    bool readBlock();
+    bool blockHeader();
+    bool writeResponseHeader();
+    void writeString(const char * str, int len);
+
+    static int dispatch(TSCont, TSEvent, void *);
+};
+
+bool
+SliceRequest::accept(TSVConn vc)
+{
+    this->client_vc = vc;
+
+    // The proxy forwards the client request to us, which we already have.
+    this->client_in = TSIOBufferCreate();
+    this->client_in_reader = TSIOBufferReaderAlloc(this->client_in);
+    this->client_read_vio = TSVConnRead(vc, this->cont, this->client_in, INT64_MAX);
+
+    this->client_out = TSIOBufferCreate();
+    this->client_out_reader = TSIOBufferReaderAlloc(this->client_out);
+    this->client_write_vio = TSVConnWrite(vc, this->cont, this->client_out_reader, INT64_MAX);
+
+    this->pos = this->range_first;
+    this->block_index = this->range_first / this->blockbytes;
+    return this->fetchBlock();
+}
+
+// Request the block containing 'pos' through the proxy.
+bool
+SliceRequest::fetchBlock()
+{
+    char range[64];
+    int len;
+
+    this->block_pos = this->block_index * this->blockbytes;
+    this->block_end = this->block_pos + this->blockbytes;
+    len = snprintf(range, sizeof(range), "%lld-%lld", (long long)this->block_pos, (long long)this->block_end - 1);
+    SliceHeaderSet(this->reqbuf, this->reqhdr, SLICE_BLOCK_FIELD, SLICE_BLOCK_FIELD_LEN, range, len);
+
+    this->block_vc = TSHttpConnect((const sockaddr *)&this->client_addr);
+    if (this->block_vc == NULL) {
+        SliceLogError("TSHttpConnect failed");
+        return false;
+    }
+
+    this->block_in = TSIOBufferCreate();
+    this->block_in_reader = TSIOBufferReaderAlloc(this->block_in);
+    this->block_out = TSIOBufferCreate();
+    this->block_out_reader = TSIOBufferReaderAlloc(this->block_out);
+
+    TSHttpHdrPrint(this->reqbuf, this->reqhdr, this->block_out);
+    TSIOBufferWrite(this->block_out, "\r\n", 2);
+
+    TSHttpParserClear(this->parser);
+    TSHttpHdrDestroy(this->respbuf, this->resphdr);
+    TSHandleMLocRelease(this->respbuf, TS_NULL_MLOC, this->resphdr);
+    this->resphdr = TSHttpHdrCreate(this->respbuf);
+    this->block_headers = false;
+    this->block_eos = false;
+
+    SliceLogDebug("fetching block %lld (%s)", (long long)this->block_index, range);
+    TSVConnWrite(this->block_vc, this->cont, this->block_out_reader, TSIOBufferReaderAvail(this->block_out_reader));
+    this->block_read_vio = TSVConnRead(this->block_vc, this->cont, this->block_in, INT64_MAX);
+    return true;
+}
+
+void
+SliceRequest::writeString(const char * str, int len)
+{
+    TSIOBufferWrite(this->client_out, str, len);
+    this->client_bytes += len;
+}
+
+// Check the header of a block response. The first one also determines the
+// response to the client.
+bool
+SliceRequest::blockHeader()
+{
+    TSHttpStatus status = TSHttpHdrStatusGet(this->respbuf, this->resphdr);
+    std::string crange, etag, lastmod;
+    int64_t first, last, total;
+
+    bool ranged = status == TS_HTTP_STATUS_OK &&
+        SliceHeaderGet(this->respbuf, this->resphdr, TS_MIME_FIELD_CONTENT_RANGE, TS_MIME_LEN_CONTENT_RANGE, crange) &&
+        SliceParseContentRange(crange, first, last, total) && first == this->block_pos;
+    SliceHeaderGet(this->respbuf, this->resphdr, TS_MIME_FIELD_ETAG, TS_MIME_LEN_ETAG, etag);
+    SliceHeaderGet(this->respbuf, this->resphdr, TS_MIME_FIELD_LAST_MODIFIED, TS_MIME_LEN_LAST_MODIFIED, lastmod);
+
+    if (this->total < 0) {
+        if (!ranged) {
+            // Not something we can slice, hand it to the client unchanged.
+            SliceLogDebug("block %lld is not a range (status %d), relaying it", (long long)this->block_index, status);
+            this->passthrough = true;
+            TSHttpHdrPrint(this->respbuf, this->resphdr, this->client_out);
+            TSIOBufferWrite(this->client_out, "\r\n", 2);
+            this->client_bytes += TSHttpHdrLengthGet(this->respbuf, this->resphdr) + 2;
+            return true;
+        }
+
+        this->total = total;
+        this->etag = etag;
+        this->last_modified = lastmod;
+        return this->writeResponseHeader();
+    }
+
+    // A later block has to come from the same version of the object.
+    if (!ranged || total != this->total || etag != this->etag || lastmod != this->last_modified) {
+        SliceLogError("block %lld does not match the object being sliced", (long long)this->block_index);
+        return false;
+    }
+
+    this->block_end = last + 1;
+    return true;
+}
+
+bool
+SliceRequest::writeResponseHeader()
+{
+    char buf[128];
+    int len;
+
+    if (this->range_first >= this->total) {
+        len = snprintf(buf, sizeof(buf), "HTTP/1.1 416 %s\r\nContent-Range: bytes */%lld\r\nContent-Length: 0\r\n\r\n",
+                       TSHttpHdrReasonLookup(TS_HTTP_STATUS_REQUESTED_RANGE_NOT_SATISFIABLE), (long long)this->total);
+        this->writeString(buf, len);
+        this->send_end = this->pos;
+        TSVIONBytesSet(this->client_write_vio, this->client_bytes);
+        return true;
+    }
+
+    this->send_end = this->total;
+    if (this->range_last >= 0 && this->range_last + 1 < this->total) {
+        this->send_end = this->range_last + 1;
+    }
+    if (this->block_end > this->total) {
+        this->block_end = this->total;
+    }
+
+    // Keep the entity fields of the block response.
+    TSHttpHdrStatusSet(this->respbuf, this->resphdr, TS_HTTP_STATUS_PARTIAL_CONTENT);
+    TSHttpHdrReasonSet(this->respbuf, this->resphdr, TSHttpHdrReasonLookup(TS_HTTP_STATUS_PARTIAL_CONTENT), -1);
+    SliceHeaderRemove(this->respbuf, this->resphdr, TS_MIME_FIELD_TRANSFER_ENCODING, TS_MIME_LEN_TRANSFER_ENCODING);
+    SliceHeaderRemove(this->respbuf, this->resphdr, TS_MIME_FIELD_CONNECTION, TS_MIME_LEN_CONNECTION);
+
+    len = snprintf(buf, sizeof(buf), "bytes %lld-%lld/%lld",
+                   (long long)this->range_first, (long long)this->send_end - 1, (long long)this->total);
+    SliceHeaderSet(this->respbuf, this->resphdr, TS_MIME_FIELD_CONTENT_RANGE, TS_MIME_LEN_CONTENT_RANGE, buf, len);
+    len = snprintf(buf, sizeof(buf), "%lld", (long long)(this->send_end - this->range_first));
+    SliceHeaderSet(this->respbuf, this->resphdr, TS_MIME_FIELD_CONTENT_LENGTH, TS_MIME_LEN_CONTENT_LENGTH, buf, len);
+
+    TSHttpHdrPrint(this->respbuf, this->resphdr, this->client_out);
+    TSIOBufferWrite(this->client_out, "\r\n", 2);
+    this->client_bytes += TSHttpHdrLengthGet(this->respbuf, this->resphdr) + 2 + (this->send_end - this->range_first);
+    TSVIONBytesSet(this->client_write_vio, this->client_bytes);
+    return true;
+}
+
+// Move what we have of the current block to the client. Returns false if
+// the request has to be abandoned.
+bool
+SliceRequest::readBlock()
+{
+    if (!this->block_headers) {
+        TSIOBufferBlock blk = TSIOBufferReaderStart(this->block_in_reader);
+        TSParseResult result = TS_PARSE_CONT;
+
+        while (blk && result == TS_PARSE_CONT) {
+            int64_t avail;
+            const char * start = TSIOBufferBlockReadStart(blk, this->block_in_reader, &avail);
+            const char * ptr = start;
+
+            result = TSHttpHdrParseResp(this->parser, this->respbuf, this->resphdr, &ptr, start + avail);
+            TSIOBufferReaderConsume(this->block_in_reader, ptr - start);
+            blk = TSIOBufferReaderStart(this->block_in_reader);
+        }
+
+        if (result == TS_PARSE_ERROR || (result == TS_PARSE_CONT && this->block_eos)) {
+            SliceLogError("bad response header for block %lld", (long long)this->block_index);
+            return false;
+        }
+        if (result == TS_PARSE_CONT) {
+            return true;
+        }
+
+        this->block_headers = true;
+        if (!this->blockHeader()) {
+            return false;
+        }
+    }
+
+    int64_t avail = TSIOBufferReaderAvail(this->block_in_reader);
+
+    if (this->passthrough) {
+        TSIOBufferCopy(this->client_out, this->block_in_reader, avail, 0);
+        TSIOBufferReaderConsume(this->block_in_reader, avail);
+        this->client_bytes += avail;
+        if (this->block_eos) {
+            TSVIONBytesSet(this->client_write_vio, this->client_bytes);
+            this->closeBlock();
+        }
+        TSVIOReenable(this->client_write_vio);
+        return true;
+    }
+
+    // Skip the part of the block in front of the range, then copy the rest.
+    if (this->block_pos < this->pos) {
+        int64_t skip = this->pos - this->block_pos;
+        if (skip > avail) {
+            skip = avail;
+        }
+        TSIOBufferReaderConsume(this->block_in_reader, skip);
+        this->block_pos += skip;
+        avail -= skip;
+    }
+
+    int64_t copy = this->send_end - this->pos;
+    if (copy > avail) {
+        copy = avail;
+    }
+    if (copy > 0) {
+        TSIOBufferCopy(this->client_out, this->block_in_reader, copy, 0);
+        TSIOBufferReaderConsume(this->block_in_reader, copy);
+        this->block_pos += copy;
+        this->pos += copy;
+        TSVIOReenable(this->client_write_vio);
+    }
+
+    if (this->pos >= this->send_end) {
+        this->closeBlock();
+        return true;
+    }
+
+    if (this->block_pos >= this->block_end) {
+        this->closeBlock();
+        this->block_index++;
+        return this->fetchBlock();
+    }
+
+    if (this->block_eos) {
+        SliceLogError("block %lld is short", (long long)this->block_index);
+        return false;
+    }
+
+    // Do not run further ahead of the client than a block.
+    if (TSIOBufferReaderAvail(this->client_out_reader) < this->blockbytes) {
+        TSVIOReenable(this->block_read_vio);
+    }
+    return true;
+}
+
+int
+SliceRequest::dispatch(TSCont cont, TSEvent event, void * edata)
+{
+    SliceRequest * req = (SliceRequest *)TSContDataGet(cont);
+
+    switch (event) {
+    case TS_EVENT_NET_ACCEPT:
+        if (!req->accept((TSVConn)edata)) {
+            delete req;
+        }
+        return TS_EVENT_NONE;
+
+    case TS_EVENT_NET_ACCEPT_FAILED:
+        delete req;
+        return TS_EVENT_NONE;
+
+    case TS_EVENT_VCONN_READ_READY:
+    case TS_EVENT_VCONN_READ_COMPLETE:
+    case TS_EVENT_VCONN_EOS:
+        if (edata == req->client_read_vio) {
+            TSIOBufferReaderConsume(req->client_in_reader, TSIOBufferReaderAvail(req->client_in_reader));
+            if (event == TS_EVENT_VCONN_READ_READY) {
+                TSVIOReenable(req->client_read_vio);
+            }
+            return TS_EVENT_NONE;
+        }
+        if (edata == req->block_read_vio) {
+            req->block_eos = event != TS_EVENT_VCONN_READ_READY;
+            if (!req->readBlock()) {
+                delete req;
+            }
+        }
+        return TS_EVENT_NONE;
+
+    case TS_EVENT_VCONN_WRITE_READY:
+        if (edata == req->client_write_vio && req->block_read_vio && req->block_headers) {
+            if (!req->readBlock()) {
+                delete req;
+            }
+        }
+        return TS_EVENT_NONE;
+
+    case TS_EVENT_VCONN_WRITE_COMPLETE:
+        if (edata == req->client_write_vio) {
+            delete req;
+        }
+        return TS_EVENT_NONE;
+
+    case TS_EVENT_ERROR:
+    case TS_EVENT_VCONN_INACTIVITY_TIMEOUT:
+        delete req;
+        return TS_EVENT_NONE;
+
+    default:
+        SliceLogDebug("unexpected event %d", event);
+        return TS_EVENT_NONE;
+    }
+}
+
+// Hooks on the internal block requests.
+static int
+SliceBlockHook(TSCont /* cont ATS_UNUSED */, TSEvent event, void * edata)
+{
+    TSHttpTxn txn = (TSHttpTxn)edata;
+    TSMBuffer bufp;
+    TSMLoc hdr;
+
+    switch (event) {
+    case TS_EVENT_HTTP_SEND_REQUEST_HDR:
+        // Turn the block into a real range request for the origin.
+        if (TSHttpTxnServerReqGet(txn, &bufp, &hdr) == TS_SUCCESS) {
+            std::string block;
+            if (SliceHeaderGet(bufp, hdr, SLICE_BLOCK_FIELD, SLICE_BLOCK_FIELD_LEN, block)) {
+                std::string range("bytes=" + block);
+                SliceHeaderSet(bufp, hdr, TS_MIME_FIELD_RANGE, TS_MIME_LEN_RANGE, range.data(), (int)range.size());
+                SliceHeaderRemove(bufp, hdr, SLICE_BLOCK_FIELD, SLICE_BLOCK_FIELD_LEN);
+            }
+            TSHandleMLocRelease(bufp, TS_NULL_MLOC, hdr);
+        }
+        break;
+
+    case TS_EVENT_HTTP_READ_RESPONSE_HDR:
+        // Store the block as a complete object under its own key. Anything
+        // but a partial response is not the block and must not be stored.
+        if (TSHttpTxnServerRespGet(txn, &bufp, &hdr) == TS_SUCCESS) {
+            if (TSHttpHdrStatusGet(bufp, hdr) == TS_HTTP_STATUS_PARTIAL_CONTENT) {
+                TSHttpHdrStatusSet(bufp, hdr, TS_HTTP_STATUS_OK);
+                TSHttpHdrReasonSet(bufp, hdr, TSHttpHdrReasonLookup(TS_HTTP_STATUS_OK), -1);
+            } else {
+                TSHttpTxnServerRespNoStoreSet(txn, 1);
+            }
+            TSHandleMLocRelease(bufp, TS_NULL_MLOC, hdr);
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    TSHttpTxnReenable(txn, TS_EVENT_HTTP_CONTINUE);
+    return TS_EVENT_NONE;
+}
+
+// Give an internal block request a cache key of its own.
+static TSRemapStatus
+SliceRemapBlock(TSHttpTxn txn, const std::string& block)
+{
+    int len = 0;
+    char * url = TSHttpTxnEffectiveUrlStringGet(txn, &len);
+
+    if (url == NULL) {
+        return TSREMAP_NO_REMAP;
+    }
+
+    std::string key(url, len);
+    TSfree(url);
+    key += key.find('?') == std::string::npos ? "?" : "&";
+    key += "slice-block=" + block;
+
+    if (TSCacheUrlSet(txn, key.data(), (int)key.size()) != TS_SUCCESS) {
+        SliceLogError("failed to set the cache key of block %s", block.c_str());
+    }
+
+    TSHttpTxnHookAdd(txn, TS_HTTP_SEND_REQUEST_HDR_HOOK, SliceBlockContinuation);
+    TSHttpTxnHookAdd(txn, TS_HTTP_READ_RESPONSE_HDR_HOOK, SliceBlockContinuation);
+    return TSREMAP_NO_REMAP;
+}
+
+TSReturnCode
+TSRemapInit(TSRemapInterface * /* api ATS_UNUSED */, char * /* err ATS_UNUSED */, int /* errsz ATS_UNUSED */)
+{
+    SliceBlockContinuation = TSContCreate(SliceBlockHook, NULL);
+    return TS_SUCCESS;
+}
+
+TSReturnCode
+TSRemapNewInstance(int argc, char * argv[], void ** instance, char * /* err ATS_UNUSED */, int /* errsz ATS_UNUSED */)
+{
+    static const struct option longopt[] = {
+        { const_cast<char *>("blockbytes"), required_argument, 0, 'b' },
+        { 0, 0, 0, 0 }
+    };
+
+    SliceOptions * options = new SliceOptions();
+
+    // Skip the "from" and "to" URLs, keeping one to masquerade as argv[0].
+    argc--;
+    argv++;
+    optind = 0;
+
+    for (;;) {
+        int opt = getopt_long(argc, (char * const *)argv, "", longopt, NULL);
+
+        if (opt == -1) {
+            break;
+        }
+
+        if (opt == 'b') {
+            options->blockbytes = strtoll(optarg, NULL, 10);
+            if (options->blockbytes < SLICE_MIN_BLOCK_BYTES) {
+                SliceLogError("block size %s is too small, using %lld", optarg, (long long)SLICE_MIN_BLOCK_BYTES);
+                options->blockbytes = SLICE_MIN_BLOCK_BYTES;
+            }
+        }
+    }
+
+    SliceLogDebug("slicing into blocks of %lld bytes", (long long)options->blockbytes);
+    *instance = options;
+    return TS_SUCCESS;
+}
+
+void
+TSRemapDeleteInstance(void * instance)
+{
+    delete (SliceOptions *)instance;
+}
+
+TSRemapStatus
+TSRemapDoRemap(void * instance, TSHttpTxn txn, TSRemapRequestInfo * rri)
+{
+    SliceOptions * options = (SliceOptions *)instance;
+    TSMBuffer bufp = rri->requestBufp;
+    TSMLoc hdr = rri->requestHdrp;
+    std::string value;
+    int64_t first, last;
+    int len;
+
+    if (SliceHeaderGet(bufp, hdr, SLICE_BLOCK_FIELD, SLICE_BLOCK_FIELD_LEN, value)) {
+        if (TSHttpIsInternalRequest(txn) == TS_SUCCESS) {
+            return SliceRemapBlock(txn, value);
+        }
+        // Only we get to ask for blocks.
+        SliceHeaderRemove(bufp, hdr, SLICE_BLOCK_FIELD, SLICE_BLOCK_FIELD_LEN);
+    }
+
+    const char * method = TSHttpHdrMethodGet(bufp, hdr, &len);
+    if (method != TS_HTTP_METHOD_GET ||
+        !SliceHeaderGet(bufp, hdr, TS_MIME_FIELD_RANGE, TS_MIME_LEN_RANGE, value) ||
+        !SliceParseRange(value, first, last)) {
+        return TSREMAP_NO_REMAP;
+    }
+
+    SliceRequest * req = new SliceRequest();
+    req->blockbytes = options->blockbytes;
+    req->range_first = first;
+    req->range_last = last;
+
+    const sockaddr * addr = TSHttpTxnClientAddrGet(txn);
+    if (addr) {
+        memcpy(&req->client_addr, addr, addr->sa_family == AF_INET6 ? sizeof(sockaddr_in6) : sizeof(sockaddr_in));
+    }
+
+    // The block requests are the client request, minus the range, over HTTP/1.0
+    // so that the body ends with the connection rather than in chunks.
+    req->reqbuf = TSMBufferCreate();
+    req->reqhdr = TSHttpHdrCreate(req->reqbuf);
+    TSHttpHdrCopy(req->reqbuf, req->reqhdr, bufp, hdr);
+    TSHttpHdrVersionSet(req->reqbuf, req->reqhdr, TS_HTTP_VERSION(1, 0));
+    SliceHeaderRemove(req->reqbuf, req->reqhdr, TS_MIME_FIELD_RANGE, TS_MIME_LEN_RANGE);
+    SliceHeaderRemove(req->reqbuf, req->reqhdr, TS_MIME_FIELD_IF_RANGE, TS_MIME_LEN_IF_RANGE);
+    SliceHeaderRemove(req->reqbuf, req->reqhdr, TS_MIME_FIELD_CONNECTION, TS_MIME_LEN_CONNECTION);
+
+    req->cont = TSContCreate(SliceRequest::dispatch, TSMutexCreate());
+    TSContDataSet(req->cont, req);
+
+    SliceLogDebug("slicing range %lld-%lld", (long long)first, (long long)last);
+    TSHttpTxnIntercept(req->cont, txn);
+    return TSREMAP_NO_REMAP;
+}
+
+// vim: set ts=4 sw=4 et :
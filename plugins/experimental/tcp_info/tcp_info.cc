@@ -25,6 +25,8 @@
  */
 
 #include <stdio.h>
+#include <inttypes.h>
+#include <time.h>
 #include <stdlib.h>
 #include <ts/ts.h>
 #include <unistd.h>
@@ -38,24 +40,53 @@
 #include <string.h>
 #include <sys/time.h>
 #include <arpa/inet.h>
+#include <vector>
+
+// RTT histogram bucket i counts RTTs below 2^i ms, the last one the rest.
+// Retransmit histogram buckets are 0, 1, 2-3, 4-7, 8-15 and 16 or more.
+#define RTT_BUCKETS 16
+#define RETRANS_BUCKETS 6
+
+enum {
+  HIST_SAMPLES,
+  HIST_RTT,
+  HIST_RETRANS = HIST_RTT + RTT_BUCKETS,
+  HIST_COUNTERS = HIST_RETRANS + RETRANS_BUCKETS
+};
 
 struct Config {
   int sample;
   const char* log_file;
-  int log_fd;
+  TSTextLogObject log;
   int log_level;
+  int log_binary;
   int hook;
+  int histogram_interval;
+  int histogram_subnets;
+  TSKeyedStat histograms;
+  int ssn_arg;
 };
 static Config config;
 
+// sessions seen so far, for the sampling
+static volatile uint64_t sample_count = 0;
+
+// session arg values, the sampling is decided once per session
+#define SSN_UNDECIDED 0
+#define SSN_SKIPPED   1
+#define SSN_SAMPLED   2
+
 static void
 load_config() {
   char config_file[PATH_MAX];
   config.sample = 1000;
   config.log_level = 1;
-  config.log_file = NULL;
+  config.log_file = "tcp_info";
+  config.log_binary = 0;
   config.hook = 1;
-  
+  config.histogram_interval = 0;
+  config.histogram_subnets = 10000;
+
   // get the install directory
   const char* install_dir = TSInstallDirGet();
 
@@ -91,8 +122,14 @@ load_config() {
         config.log_file = strdup(value);
       } else if (strcmp(line, "log_level") == 0) {
         config.log_level = atoi(value);
+      } else if (strcmp(line, "log_binary") == 0) {
+        config.log_binary = atoi(value);
       } else if (strcmp(line, "hook") == 0) {
         config.hook = atoi(value);
+      } else if (strcmp(line, "histogram_interval") == 0) {
+        config.histogram_interval = atoi(value);
+      } else if (strcmp(line, "histogram_subnets") == 0) {
+        config.histogram_subnets = atoi(value);
       }
     }
   }
@@ -100,10 +137,119 @@ load_config() {
   TSDebug("tcp_info", "sample: %d", config.sample);
   TSDebug("tcp_info", "log filename: %s", config.log_file);
   TSDebug("tcp_info", "log_level: %d", config.log_level);
+  TSDebug("tcp_info", "log_binary: %d", config.log_binary);
   TSDebug("tcp_info", "hook: %d", config.hook);
+  TSDebug("tcp_info", "histogram_interval: %d", config.histogram_interval);
+  TSDebug("tcp_info", "histogram_subnets: %d", config.histogram_subnets);
+  fclose(file);
+
+  // the log goes through the logging system, into the log directory, so
+  // only the file name of an old style full path is used
+  const char *name = strrchr(config.log_file, '/');
+  name = name ? name + 1 : config.log_file;
+  TSReturnCode ret = TSTextLogObjectCreate(name, config.log_binary ? TS_LOG_MODE_BINARY : 0, &config.log);
+  assert(ret == TS_SUCCESS);
+}
+
+static inline uint32_t
+tcp_info_retrans(const struct tcp_info &info) {
+#if !defined(freebsd) || defined(__GLIBC__)
+  return info.tcpi_total_retrans;
+#else
+  return info.__tcpi_retrans;
+#endif
+}
+
+// 1 in 1000 / sample sessions, evenly spread, rather than at random
+static bool
+sample_session() {
+  if (config.sample >= 1000) {
+    return true;
+  }
+  uint64_t n = __sync_fetch_and_add(&sample_count, 1);
+  return (n + 1) * config.sample / 1000 != n * config.sample / 1000;
+}
+
+// the /24 or /64 the client is in
+static bool
+client_subnet(const struct sockaddr *addr, char *buf, int len) {
+  char str[INET6_ADDRSTRLEN];
+
+  if (addr->sa_family == AF_INET) {
+    struct in_addr in = ((const struct sockaddr_in *)addr)->sin_addr;
+    in.s_addr &= htonl(0xffffff00);
+    inet_ntop(AF_INET, &in, str, sizeof(str));
+    return snprintf(buf, len, "%s/24", str) < len;
+  } else if (addr->sa_family == AF_INET6) {
+    struct in6_addr in6 = ((const struct sockaddr_in6 *)addr)->sin6_addr;
+    memset(&in6.s6_addr[8], 0, 8);
+    inet_ntop(AF_INET6, &in6, str, sizeof(str));
+    return snprintf(buf, len, "%s/64", str) < len;
+  }
+  return false;
+}
+
+static void
+add_to_histogram(const struct sockaddr *client_addr, struct tcp_info &info) {
+  char subnet[INET6_ADDRSTRLEN + 4];
+
+  if (!client_subnet(client_addr, subnet, sizeof(subnet))) {
+    return;
+  }
+  int index = TSKeyedStatIndexGet(config.histograms, subnet, strlen(subnet), 1);
+  if (index < 0) {
+    TSDebug("tcp_info", "too many subnets, not counting %s", subnet);
+    return;
+  }
+
+  uint32_t rtt_ms = info.tcpi_rtt / 1000;
+  int rtt = 0;
+  while (rtt < RTT_BUCKETS - 1 && rtt_ms >= (1U << rtt)) {
+    ++rtt;
+  }
+  uint32_t retrans_count = tcp_info_retrans(info);
+  int retrans = 0;
+  while (retrans < RETRANS_BUCKETS - 1 && retrans_count >= (1U << retrans)) {
+    ++retrans;
+  }
 
-  config.log_fd = open(config.log_file, O_APPEND | O_CREAT | O_RDWR, 0666);
-  assert(config.log_fd > 0);
+  TSKeyedStatIncrement(config.histograms, index, HIST_SAMPLES, 1);
+  TSKeyedStatIncrement(config.histograms, index, HIST_RTT + rtt, 1);
+  TSKeyedStatIncrement(config.histograms, index, HIST_RETRANS + retrans, 1);
+}
+
+// Writes a line for each subnet that had samples in the interval:
+//   hist [unix seconds] [subnet] [samples] rtt [buckets] retrans [buckets]
+static int
+histogram_dump(TSCont /* contp ATS_UNUSED */, TSEvent /* event ATS_UNUSED */, void * /* edata ATS_UNUSED */) {
+  // the totals at the last dump, only this continuation touches them
+  static std::vector<TSMgmtInt> last;
+  int count = TSKeyedStatCount(config.histograms);
+  uint32_t now = (uint32_t)time(NULL);
+
+  last.resize(count * HIST_COUNTERS, 0);
+  for (int i = 0; i < count; ++i) {
+    TSMgmtInt delta[HIST_COUNTERS];
+    TSMgmtInt *prev = &last[i * HIST_COUNTERS];
+
+    for (int c = 0; c < HIST_COUNTERS; ++c) {
+      TSMgmtInt total = TSKeyedStatGet(config.histograms, i, c);
+      delta[c] = total - prev[c];
+      prev[c] = total;
+    }
+    if (delta[HIST_SAMPLES] == 0) {
+      continue;
+    }
+
+    char buffer[1024];
+    int len = snprintf(buffer, sizeof(buffer), "hist %u %s %" PRId64 " rtt", now,
+                       TSKeyedStatKeyGet(config.histograms, i, NULL), delta[HIST_SAMPLES]);
+    for (int c = HIST_RTT; c < HIST_COUNTERS && len < (int)sizeof(buffer); ++c) {
+      len += snprintf(buffer + len, sizeof(buffer) - len, c == HIST_RETRANS ? " retrans %" PRId64 : " %" PRId64, delta[c]);
+    }
+    TSTextLogObjectWrite(config.log, "%s", buffer);
+  }
+  return 0;
 }
 
 static void
@@ -167,9 +313,11 @@ log_tcp_info(const char* event_name, const char* client_ip, const char* server_i
     );
   }
 
-  ssize_t wrote = write(config.log_fd, buffer, bytes);
-  assert(wrote == bytes);
-  TSDebug("tcp_info", "wrote: %d bytes to file: %s", bytes, config.log_file);
+  // the log adds the new line
+  if (bytes > 0 && buffer[bytes - 1] == '\n') {
+    buffer[bytes - 1] = '\0';
+  }
+  TSTextLogObjectWrite(config.log, "%s", buffer);
   TSDebug("tcp_info", "logging: %s", buffer);
 }
 
@@ -199,6 +347,7 @@ tcp_info_hook(TSCont /* contp ATS_UNUSED */, TSEvent event, void *edata)
   case TS_EVENT_HTTP_SSN_CLOSE:
     ssnp = (TSHttpSsn)edata;
     event_name = "ssn_close";
+    break;
   default:
     return 0;
   }
@@ -208,6 +357,16 @@ tcp_info_hook(TSCont /* contp ATS_UNUSED */, TSEvent event, void *edata)
   struct tcp_info tcp_info;
   int tcp_info_len = sizeof(tcp_info);
   int fd;
+  intptr_t sampled = (intptr_t)TSHttpSsnArgGet(ssnp, config.ssn_arg);
+
+  // decide before the getsockopt(), which most sessions then never make
+  if (sampled == SSN_UNDECIDED) {
+    sampled = sample_session() ? SSN_SAMPLED : SSN_SKIPPED;
+    TSHttpSsnArgSet(ssnp, config.ssn_arg, (void *)sampled);
+  }
+  if (sampled != SSN_SAMPLED) {
+    goto done;
+  }
 
   if (TSHttpSsnClientFdGet(ssnp, &fd) != TS_SUCCESS) {
     TSDebug("tcp_info", "error getting the client socket fd");
@@ -218,31 +377,34 @@ tcp_info_hook(TSCont /* contp ATS_UNUSED */, TSEvent event, void *edata)
   if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, (void *)&tcp_info, (socklen_t *)&tcp_info_len) == 0) {
     // the structure is the correct size
     if (tcp_info_len == sizeof(tcp_info)) {
-      // no need to run rand if we are always going log (100%)
-      int random = 0;
-      if (config.sample < 1000) {
-        random = rand() % 1000;
-        TSDebug("tcp_info", "random: %d, config.sample: %d", random, config.sample);
-      }
+      TSDebug("tcp_info", "got the tcp_info struture and now logging");
+
+      // get the client address
+      const struct sockaddr *client_addr = TSHttpSsnClientAddrGet(ssnp);
+      const struct sockaddr *server_addr = TSHttpSsnIncomingAddrGet(ssnp);
+      if (client_addr == NULL || server_addr == NULL)
+        goto done;
 
-      if (random < config.sample) {
-        TSDebug("tcp_info", "got the tcp_info struture and now logging");
+      if (config.histograms != NULL) {
+        add_to_histogram(client_addr, tcp_info);
+      }
 
-        // get the client address
-        const struct sockaddr *client_addr = TSHttpSsnClientAddrGet(ssnp); 
-        const struct sockaddr *server_addr = TSHttpSsnIncomingAddrGet(ssnp);
-        if (client_addr == NULL || server_addr == NULL)
-          goto done;
-        struct sockaddr_in *client_in_addr = (struct sockaddr_in *)client_addr;
-        struct sockaddr_in *server_in_addr = (struct sockaddr_in *)server_addr;
-        char client_str[INET_ADDRSTRLEN];
-        char server_str[INET_ADDRSTRLEN];
+      if (config.log_level > 0) {
+        char client_str[INET6_ADDRSTRLEN];
+        char server_str[INET6_ADDRSTRLEN];
 
         // convert ip to string
-        inet_ntop(client_addr->sa_family, &(client_in_addr->sin_addr), client_str, INET_ADDRSTRLEN);
-        inet_ntop(server_addr->sa_family, &(server_in_addr->sin_addr), server_str, INET_ADDRSTRLEN);
-        
-        
+        if (client_addr->sa_family == AF_INET6) {
+          inet_ntop(AF_INET6, &((const struct sockaddr_in6 *)client_addr)->sin6_addr, client_str, sizeof(client_str));
+        } else {
+          inet_ntop(AF_INET, &((const struct sockaddr_in *)client_addr)->sin_addr, client_str, sizeof(client_str));
+        }
+        if (server_addr->sa_family == AF_INET6) {
+          inet_ntop(AF_INET6, &((const struct sockaddr_in6 *)server_addr)->sin6_addr, server_str, sizeof(server_str));
+        } else {
+          inet_ntop(AF_INET, &((const struct sockaddr_in *)server_addr)->sin_addr, server_str, sizeof(server_str));
+        }
+
         log_tcp_info(event_name, client_str, server_str, tcp_info);
       }
     } else {
@@ -276,6 +438,21 @@ TSPluginInit(int, const char *[]) // int argc, const char *argv[]
   // load the configuration file
   load_config();
 
+  if (TSHttpArgIndexReserve("tcp_info", "sampling decision", &config.ssn_arg) != TS_SUCCESS) {
+    TSError("tcp_info: failed to reserve a session arg\n");
+    return;
+  }
+
+  config.histograms = NULL;
+  if (config.histogram_interval > 0) {
+    config.histograms = TSKeyedStatCreate("tcp_info", HIST_COUNTERS, config.histogram_subnets);
+    if (config.histograms != NULL) {
+      TSContScheduleEvery(TSContCreate(histogram_dump, TSMutexCreate()), config.histogram_interval * 1000,
+                          TS_THREAD_POOL_TASK);
+      TSDebug("tcp_info", "dumping histograms every %d seconds", config.histogram_interval);
+    }
+  }
+
   // add a hook to the state machine
   // TODO: need another hook before the socket is closed, keeping it in for now because it will be easier to change if or when another hook is added to ATS
   if ((config.hook & 1) != 0) {
@@ -26,6 +26,7 @@
 #include <algorithm>
 #include <vector>
 #include <fnmatch.h>
+#include <stdlib.h>
 
 namespace Gzip {
   using namespace std;
@@ -84,6 +85,11 @@ namespace Gzip {
     kParseEnable,
     kParseCache,
     kParseDisallow,
+    kParseCacheCompressionLevel,
+    kParseBrotli,
+    kParseTaskThreads,
+    kParseCompressionLevelContentType,
+    kParseCompressionLevel,
   };
 
   void Configuration::AddHostConfiguration(HostConfiguration * hc){
@@ -98,6 +104,10 @@ namespace Gzip {
     compressible_content_types_.push_back(content_type);
   }
 
+  void HostConfiguration::add_compression_level(const std::string & content_type, int level) {
+    compression_levels_.push_back(std::make_pair(content_type, level));
+  }
+
   HostConfiguration * Configuration::Find(const char * host, int host_length) {
     HostConfiguration * host_configuration = host_configurations_[0];
 
@@ -147,6 +157,20 @@ namespace Gzip {
     return is_match;
   }
 
+  int HostConfiguration::ContentTypeCompressionLevel(const char * content_type, int content_type_length) {
+    string scontent_type(content_type, content_type_length);
+    int level = -1;
+
+    //like the compressible content types, the last matching pattern wins
+    for (size_t i = 0; i < compression_levels_.size(); i++) {
+      if ( fnmatch (compression_levels_[i].first.c_str(), scontent_type.c_str(), 0) == 0 ) {
+        level = compression_levels_[i].second;
+      }
+    }
+
+    return level;
+  }
+
   Configuration * Configuration::Parse(const char * path ) {
     string pathstring(path);
 
@@ -182,6 +206,7 @@ namespace Gzip {
     }
 
     enum ParserState state = kParseStart;
+    string level_content_type;
 
     while (!f.eof()) {
       std::string line;
@@ -221,6 +246,14 @@ namespace Gzip {
             state = kParseCache;
           } else if (token == "disallow" ) {
             state = kParseDisallow;
+          } else if (token == "cache-compression-level" ) {
+            state = kParseCacheCompressionLevel;
+          } else if (token == "brotli" ) {
+            state = kParseBrotli;
+          } else if (token == "task-threads" ) {
+            state = kParseTaskThreads;
+          } else if (token == "compression-level" ) {
+            state = kParseCompressionLevelContentType;
           }
           else {
             warning("failed to interpret \"%s\" at line %zu", token.c_str(), lineno);
@@ -246,6 +279,42 @@ namespace Gzip {
           current_host_configuration->add_disallow(token);
           state = kParseStart;
           break;
+        case kParseCacheCompressionLevel:
+          {
+            int level = atoi(token.c_str());
+            if (level >= 1 && level <= kMaxCompressionLevel) {
+              current_host_configuration->set_cache_compression_level(level);
+            } else {
+              warning("invalid cache-compression-level \"%s\" at line %zu, expected 1-%d", token.c_str(), lineno,
+                      kMaxCompressionLevel);
+            }
+          }
+          state = kParseStart;
+          break;
+        case kParseBrotli:
+          current_host_configuration->set_brotli(token == "true");
+          state = kParseStart;
+          break;
+        case kParseTaskThreads:
+          current_host_configuration->set_task_threads(token == "true");
+          state = kParseStart;
+          break;
+        case kParseCompressionLevelContentType:
+          level_content_type = token;
+          state = kParseCompressionLevel;
+          break;
+        case kParseCompressionLevel:
+          {
+            int level = atoi(token.c_str());
+            if (level >= 1 && level <= kMaxCompressionLevel) {
+              current_host_configuration->add_compression_level(level_content_type, level);
+            } else {
+              warning("invalid compression-level \"%s\" at line %zu, expected 1-%d", token.c_str(), lineno,
+                      kMaxCompressionLevel);
+            }
+          }
+          state = kParseStart;
+          break;
         }
       }
     }
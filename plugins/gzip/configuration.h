@@ -27,9 +27,19 @@
 
 #include <string>
 #include <vector>
+#include <utility>
 #include "debug_macros.h"
 
 namespace Gzip  { 
+  // from mod_deflate:
+  // ZLIB's compression algorithm uses a
+  // 0-9 based scale that GZIP does where '1' is 'Best speed'
+  // and '9' is 'Best compression'. Testing has proved level '6'
+  // to be about the best level to use in an HTTP Server.
+  const int kDefaultCompressionLevel = 6;
+  // brotli qualities go up to 11, zlib levels beyond 9 are clamped.
+  const int kMaxCompressionLevel = 11;
+
   class HostConfiguration {
   public: //todo -> only configuration should be able to construct hostconfig
     explicit HostConfiguration(const std::string & host)
@@ -37,6 +47,9 @@ namespace Gzip  {
       , enabled_(true)
       , cache_(true)
       , remove_accept_encoding_(false)
+      , brotli_(false)
+      , task_threads_(false)
+      , cache_compression_level_(kDefaultCompressionLevel)
     {}
 
     inline bool enabled() { return enabled_; }
@@ -45,18 +58,31 @@ namespace Gzip  {
     inline void set_cache(bool x) { cache_ = x; } 
     inline bool remove_accept_encoding() { return remove_accept_encoding_; }
     inline void set_remove_accept_encoding(bool x) { remove_accept_encoding_ = x; } 
+    inline bool brotli() { return brotli_; }
+    inline void set_brotli(bool x) { brotli_ = x; }
+    inline bool task_threads() { return task_threads_; }
+    inline void set_task_threads(bool x) { task_threads_ = x; }
+    inline int cache_compression_level() { return cache_compression_level_; }
+    inline void set_cache_compression_level(int x) { cache_compression_level_ = x; }
     inline std::string host() { return host_; }
     void add_disallow(const std::string & disallow);
     void add_compressible_content_type(const std::string & content_type);
+    void add_compression_level(const std::string & content_type, int level);
     bool IsUrlAllowed(const char * url, int url_len);
     bool ContentTypeIsCompressible(const char * content_type, int content_type_length);
+    //returns the level configured for the content type, or -1 when none matches
+    int ContentTypeCompressionLevel(const char * content_type, int content_type_length);
 
   private:
     std::string host_;
     bool enabled_;
     bool cache_;
     bool remove_accept_encoding_;
+    bool brotli_;
+    bool task_threads_;
+    int cache_compression_level_;
     std::vector<std::string> compressible_content_types_;
+    std::vector<std::pair<std::string, int> > compression_levels_;
     std::vector<std::string> disallows_;
     DISALLOW_COPY_AND_ASSIGN(HostConfiguration);
   };//class HostConfiguration
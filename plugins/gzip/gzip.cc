@@ -41,14 +41,6 @@ using namespace Gzip;
 //FIXME: look into compressing from the task thread pool
 //FIXME: make normalizing accept encoding configurable
 
-// from mod_deflate:
-// ZLIB's compression algorithm uses a
-// 0-9 based scale that GZIP does where '1' is 'Best speed' 
-// and '9' is 'Best compression'. Testing has proved level '6' 
-// to be about the best level to use in an HTTP Server. 
-
-const int ZLIB_COMPRESSION_LEVEL = 6;
-
 int arg_idx_hooked;
 int arg_idx_host_configuration;
 int arg_idx_url_disallowed;
@@ -59,7 +51,7 @@ Configuration* config = NULL;
 const char *dictionary = NULL;
 
 static GzipData *
-gzip_data_alloc(int compression_type)
+gzip_data_alloc(int compression_type, int compression_level)
 {
   GzipData *data;
   int err;
@@ -82,9 +74,29 @@ gzip_data_alloc(int compression_type)
   data->zstrm.opaque = (voidpf) 0;
   data->zstrm.data_type = Z_ASCII;
 
+#if TS_HAS_BROTLI
+  data->bstrm = NULL;
+  data->brotli_total_in = 0;
+
+  if (compression_type == COMPRESSION_TYPE_BROTLI) {
+    data->bstrm = BrotliEncoderCreateInstance(brotli_alloc, brotli_free, NULL);
+    if (!data->bstrm) {
+      fatal("gzip-transform: ERROR: BrotliEncoderCreateInstance failed!");
+    }
+    BrotliEncoderSetParameter(data->bstrm, BROTLI_PARAM_QUALITY, compression_level);
+    BrotliEncoderSetParameter(data->bstrm, BROTLI_PARAM_LGWIN, BROTLI_LGWIN);
+    BrotliEncoderSetParameter(data->bstrm, BROTLI_PARAM_MODE, BROTLI_MODE_TEXT);
+    return data;
+  }
+#endif
+
+  if (compression_level > ZLIB_MAX_COMPRESSION_LEVEL) {
+    compression_level = ZLIB_MAX_COMPRESSION_LEVEL;
+  }
+
   int window_bits = (compression_type == COMPRESSION_TYPE_GZIP) ? WINDOW_BITS_GZIP : WINDOW_BITS_DEFLATE;
 
-  err = deflateInit2(&data->zstrm, ZLIB_COMPRESSION_LEVEL, Z_DEFLATED, window_bits, ZLIB_MEMLEVEL, Z_DEFAULT_STRATEGY);
+  err = deflateInit2(&data->zstrm, compression_level, Z_DEFLATED, window_bits, ZLIB_MEMLEVEL, Z_DEFAULT_STRATEGY);
 
   if (err != Z_OK) {
     fatal("gzip-transform: ERROR: deflateInit (%d)!", err);
@@ -106,9 +118,16 @@ gzip_data_destroy(GzipData * data)
 {
   TSReleaseAssert(data);
 
-  //deflateEnd returnvalue ignore is intentional
-  //it would spew log on every client abort
-  deflateEnd(&data->zstrm);
+#if TS_HAS_BROTLI
+  if (data->bstrm) {
+    BrotliEncoderDestroyInstance(data->bstrm);
+  } else
+#endif
+  {
+    //deflateEnd returnvalue ignore is intentional
+    //it would spew log on every client abort
+    deflateEnd(&data->zstrm);
+  }
 
   if (data->downstream_buffer) {
     TSIOBufferDestroy(data->downstream_buffer);
@@ -130,6 +149,8 @@ gzip_content_encoding_header(TSMBuffer bufp, TSMLoc hdr_loc, const int compressi
       ret = TSMimeHdrFieldValueStringInsert(bufp, hdr_loc, ce_loc, -1, "deflate", sizeof("deflate") - 1);
     } else if (compression_type == COMPRESSION_TYPE_GZIP) {
       ret = TSMimeHdrFieldValueStringInsert(bufp, hdr_loc, ce_loc, -1, "gzip", sizeof("gzip") - 1);
+    } else if (compression_type == COMPRESSION_TYPE_BROTLI) {
+      ret = TSMimeHdrFieldValueStringInsert(bufp, hdr_loc, ce_loc, -1, "br", sizeof("br") - 1);
     }
     if (ret == TS_SUCCESS) {
       ret = TSMimeHdrFieldAppend(bufp, hdr_loc, ce_loc);
@@ -188,7 +209,7 @@ gzip_vary_header(TSMBuffer bufp, TSMLoc hdr_loc)
 //FIXME: the etag alteration isn't proper. it should modify the value inside quotes
 //       specify a very header..
 static TSReturnCode
-gzip_etag_header(TSMBuffer bufp, TSMLoc hdr_loc)
+gzip_etag_header(TSMBuffer bufp, TSMLoc hdr_loc, const int compression_type)
 {
   TSReturnCode ret = TS_SUCCESS;
   TSMLoc ce_loc;
@@ -206,7 +227,12 @@ gzip_etag_header(TSMBuffer bufp, TSMLoc hdr_loc)
         changetag = 0;
       }
       if (changetag) {
-        ret = TSMimeHdrFieldValueAppend(bufp, hdr_loc, ce_loc, 0, "-df", 3);
+        //brotli output differs from the zlib variants, so it gets its own tag
+        if (compression_type == COMPRESSION_TYPE_BROTLI) {
+          ret = TSMimeHdrFieldValueAppend(bufp, hdr_loc, ce_loc, 0, "-br", 3);
+        } else {
+          ret = TSMimeHdrFieldValueAppend(bufp, hdr_loc, ce_loc, 0, "-df", 3);
+        }
       }
     }
     TSHandleMLocRelease(bufp, hdr_loc, ce_loc);
@@ -239,7 +265,7 @@ gzip_transform_init(TSCont contp, GzipData * data)
 
   if (gzip_content_encoding_header(bufp, hdr_loc, data->compression_type) == TS_SUCCESS &&
       gzip_vary_header(bufp, hdr_loc) == TS_SUCCESS &&
-      gzip_etag_header(bufp, hdr_loc) == TS_SUCCESS) {
+      gzip_etag_header(bufp, hdr_loc, data->compression_type) == TS_SUCCESS) {
     downstream_conn = TSTransformOutputVConnGet(contp);
     data->downstream_buffer = TSIOBufferCreate();
     data->downstream_reader = TSIOBufferReaderAlloc(data->downstream_buffer);
@@ -251,6 +277,54 @@ gzip_transform_init(TSCont contp, GzipData * data)
 
 
 
+#if TS_HAS_BROTLI
+//runs the brotli encoder until it consumed the input, or with BROTLI_OPERATION_FINISH
+//until the stream is complete, producing into the downstream buffer
+static void
+brotli_compress(GzipData * data, BrotliEncoderOperation op, const char *upstream_buffer, int64_t upstream_length)
+{
+  TSIOBufferBlock downstream_blkp;
+  char *downstream_buffer;
+  int64_t downstream_length;
+  const uint8_t *next_in = (const uint8_t *) upstream_buffer;
+  size_t avail_in = upstream_length;
+
+  data->brotli_total_in += upstream_length;
+
+  for (;;) {
+    downstream_blkp = TSIOBufferStart(data->downstream_buffer);
+    downstream_buffer = TSIOBufferBlockWriteStart(downstream_blkp, &downstream_length);
+
+    uint8_t *next_out = (uint8_t *) downstream_buffer;
+    size_t avail_out = downstream_length;
+
+    if (!BrotliEncoderCompressStream(data->bstrm, op, &avail_in, &next_in, &avail_out, &next_out, NULL)) {
+      error("gzip-transform: ERROR: BrotliEncoderCompressStream failed");
+      return;
+    }
+
+    if (downstream_length > (int64_t) avail_out) {
+      TSIOBufferProduce(data->downstream_buffer, downstream_length - avail_out);
+      data->downstream_length += (downstream_length - avail_out);
+    }
+
+    if (op == BROTLI_OPERATION_FINISH) {
+      if (BrotliEncoderIsFinished(data->bstrm)) {
+        break;
+      }
+    } else if (avail_in == 0 && !BrotliEncoderHasMoreOutput(data->bstrm)) {
+      break;
+    }
+  }
+}
+
+static void
+brotli_transform_one(GzipData * data, const char *upstream_buffer, int64_t upstream_length)
+{
+  brotli_compress(data, BROTLI_OPERATION_PROCESS, upstream_buffer, upstream_length);
+}
+#endif
+
 static void
 gzip_transform_one(GzipData * data, TSIOBufferReader upstream_reader, int amount)
 {
@@ -277,6 +351,15 @@ gzip_transform_one(GzipData * data, TSIOBufferReader upstream_reader, int amount
       upstream_length = amount;
     }
 
+#if TS_HAS_BROTLI
+    if (data->bstrm) {
+      brotli_transform_one(data, upstream_buffer, upstream_length);
+      TSIOBufferReaderConsume(upstream_reader, upstream_length);
+      amount -= upstream_length;
+      continue;
+    }
+#endif
+
     data->zstrm.next_in = (unsigned char *) upstream_buffer;
     data->zstrm.avail_in = upstream_length;
 
@@ -320,6 +403,14 @@ gzip_transform_finish(GzipData * data)
 
     data->state = transform_state_finished;
 
+#if TS_HAS_BROTLI
+    if (data->bstrm) {
+      brotli_compress(data, BROTLI_OPERATION_FINISH, NULL, 0);
+      gzip_log_ratio(data->brotli_total_in, data->downstream_length);
+      return;
+    }
+#endif
+
     for (;;) {
       downstream_blkp = TSIOBufferStart(data->downstream_buffer);
 
@@ -453,7 +544,8 @@ gzip_transform(TSCont contp, TSEvent event, void * /* edata ATS_UNUSED */)
 
 
 static int
-gzip_transformable(TSHttpTxn txnp, int server, HostConfiguration * host_configuration, int *compress_type)
+gzip_transformable(TSHttpTxn txnp, int server, HostConfiguration * host_configuration, int *compress_type,
+                   int *compression_level)
 {
   /* Server response header */
   TSMBuffer bufp;
@@ -505,6 +597,15 @@ gzip_transformable(TSHttpTxn txnp, int server, HostConfiguration * host_configur
         continue;
       }
 
+#if TS_HAS_BROTLI
+      if (host_configuration->brotli() && len >= (int) (sizeof("br") - 1) &&
+          strncasecmp(value, "br", sizeof("br") - 1) == 0 &&
+          (len == (int) (sizeof("br") - 1) || value[sizeof("br") - 1] == ';')) {
+        compression_acceptable = 1;
+        *compress_type = COMPRESSION_TYPE_BROTLI;
+        break;
+      }
+#endif
       if (strncasecmp(value, "deflate", sizeof("deflate") - 1) == 0) {
         compression_acceptable = 1;
         *compress_type = COMPRESSION_TYPE_DEFLATE;
@@ -560,6 +661,8 @@ gzip_transformable(TSHttpTxn txnp, int server, HostConfiguration * host_configur
   int rv = host_configuration->ContentTypeIsCompressible(value, len);
   if (!rv) { 
     info("content-type [%.*s] not compressible", len, value);
+  } else {
+    *compression_level = host_configuration->ContentTypeCompressionLevel(value, len);
   }
   TSHandleMLocRelease(bufp, hdr_loc, field_loc);
   TSHandleMLocRelease(bufp, TS_NULL_MLOC, hdr_loc);
@@ -568,7 +671,8 @@ gzip_transformable(TSHttpTxn txnp, int server, HostConfiguration * host_configur
 
 
 static void
-gzip_transform_add(TSHttpTxn txnp, int /* server ATS_UNUSED */, HostConfiguration * hc, int compress_type)
+gzip_transform_add(TSHttpTxn txnp, int /* server ATS_UNUSED */, HostConfiguration * hc, int compress_type,
+                   int content_type_level)
 {
   int *tmp = (int *) TSHttpTxnArgGet(txnp, arg_idx_hooked);
   if (tmp) {
@@ -580,19 +684,37 @@ gzip_transform_add(TSHttpTxn txnp, int /* server ATS_UNUSED */, HostConfiguratio
     info("adding compression transform");
   }
 
-  TSHttpTxnUntransformedRespCache(txnp, 1);
+  int compression_level = kDefaultCompressionLevel;
 
   if (!hc->cache()) {
+    TSHttpTxnUntransformedRespCache(txnp, 1);
     TSHttpTxnTransformedRespCache(txnp, 0);
   } else { 
+    //only the compressed variant is stored for clients that accept it. its cached
+    //request carries the normalized accept encoding, while the identity variant is
+    //stored by requests without one, so later lookups select the alternate by
+    //accept encoding and hits are served without compressing again.
+    //this applies to fresh cache hits on the identity variant as well, which
+    //write their compressed output back as a new alternate.
+    TSHttpTxnUntransformedRespCache(txnp, 0);
     TSHttpTxnTransformedRespCache(txnp, 1);
+    compression_level = hc->cache_compression_level();
+  }
+
+  //a level configured for the content type wins over the host wide ones
+  if (content_type_level > 0) {
+    compression_level = content_type_level;
   }
 
   TSVConn connp;
   GzipData *data;
 
   connp = TSTransformCreate(gzip_transform, txnp);
-  data = gzip_data_alloc(compress_type);
+  if (hc->task_threads()) {
+    //compress on the task threads, keeping the net thread free for other connections
+    TSTransformThreadPoolSet(connp, TS_THREAD_POOL_TASK);
+  }
+  data = gzip_data_alloc(compress_type, compression_level);
   data->txn = txnp;
 
   TSContDataSet(connp, data);
@@ -643,6 +765,7 @@ transform_plugin(TSCont /* contp ATS_UNUSED */, TSEvent event, void *edata)
 {
   TSHttpTxn txnp = (TSHttpTxn) edata;
   int compress_type = COMPRESSION_TYPE_DEFLATE;
+  int compression_level = -1;
 
   switch (event) {
     case TS_EVENT_HTTP_READ_REQUEST_HDR:
@@ -661,7 +784,7 @@ transform_plugin(TSCont /* contp ATS_UNUSED */, TSEvent event, void *edata)
             TSHttpTxnArgSet(txnp, arg_idx_url_disallowed, (void *) &GZIP_ONE);
             info("url [%.*s] not allowed", url_len, url);
           } else {
-            normalize_accept_encoding(txnp, req_buf, req_loc);	
+            normalize_accept_encoding(txnp, req_buf, req_loc, hc->brotli());	
           }
           TSfree(url);
           TSHandleMLocRelease(req_buf, TS_NULL_MLOC, req_loc);
@@ -686,8 +809,8 @@ transform_plugin(TSCont /* contp ATS_UNUSED */, TSEvent event, void *edata)
           }
 
           int allowed = !TSHttpTxnArgGet(txnp, arg_idx_url_disallowed);
-          if ( allowed && gzip_transformable(txnp, 1, hc, &compress_type)) {
-            gzip_transform_add(txnp, 1, hc, compress_type);
+          if ( allowed && gzip_transformable(txnp, 1, hc, &compress_type, &compression_level)) {
+            gzip_transform_add(txnp, 1, hc, compress_type, compression_level);
           }
         }
         TSHttpTxnReenable(txnp, TS_EVENT_HTTP_CONTINUE);
@@ -716,8 +839,8 @@ transform_plugin(TSCont /* contp ATS_UNUSED */, TSEvent event, void *edata)
         int allowed = !TSHttpTxnArgGet(txnp, arg_idx_url_disallowed);
         HostConfiguration * hc = (HostConfiguration*)TSHttpTxnArgGet(txnp, arg_idx_host_configuration);
         if ( hc != NULL ) { 
-          if (allowed && cache_transformable(txnp) && gzip_transformable(txnp, 0, hc, &compress_type)) {
-            gzip_transform_add(txnp, 0, hc, compress_type);
+          if (allowed && cache_transformable(txnp) && gzip_transformable(txnp, 0, hc, &compress_type, &compression_level)) {
+            gzip_transform_add(txnp, 0, hc, compress_type, compression_level);
           }
         }
         TSHttpTxnReenable(txnp, TS_EVENT_HTTP_CONTINUE);
@@ -27,6 +27,8 @@
 #include "misc.h"
 #include <string.h>
 #include <inttypes.h>
+#include <strings.h>
+#include <stdlib.h>
 #include "debug_macros.h"
 
 voidpf
@@ -41,33 +43,88 @@ gzip_free(voidpf /* opaque ATS_UNUSED */, voidpf address)
   TSfree(address);
 }
 
+#if TS_HAS_BROTLI
+void *
+brotli_alloc(void * /* opaque ATS_UNUSED */, size_t size)
+{
+  return TSmalloc(size);
+}
+
+void
+brotli_free(void * /* opaque ATS_UNUSED */, void *address)
+{
+  TSfree(address);
+}
+#endif
+
+//returns the q-value an accept encoding value assigns to coding,
+//or -1 when the value names a different coding
+static float
+accept_encoding_quality(const char *val, int val_len, const char *coding, int coding_len)
+{
+  const char *end = val + val_len;
+  const char *p = val;
+
+  while (p < end && (*p == ' ' || *p == '\t'))
+    ++p;
+
+  const char *name = p;
+  while (p < end && *p != ';' && *p != ' ' && *p != '\t')
+    ++p;
+
+  if ((p - name) != coding_len || strncasecmp(name, coding, coding_len) != 0)
+    return -1.0;
+
+  float q = 1.0;
+  while (p < end) {
+    if (*p++ != ';')
+      continue;
+    while (p < end && (*p == ' ' || *p == '\t'))
+      ++p;
+    if ((end - p) > 2 && (p[0] == 'q' || p[0] == 'Q') && p[1] == '=') {
+      char qbuf[8];
+      int qlen = end - (p + 2);
+      if (qlen > (int) sizeof(qbuf) - 1)
+        qlen = sizeof(qbuf) - 1;
+      memcpy(qbuf, p + 2, qlen);
+      qbuf[qlen] = 0;
+      q = strtof(qbuf, NULL);
+    }
+  }
+
+  return q;
+}
+
 void
-normalize_accept_encoding(TSHttpTxn /* txnp ATS_UNUSED */, TSMBuffer reqp, TSMLoc hdr_loc)
+normalize_accept_encoding(TSHttpTxn /* txnp ATS_UNUSED */, TSMBuffer reqp, TSMLoc hdr_loc, bool brotli)
 {
   TSMLoc field = TSMimeHdrFieldFind(reqp, hdr_loc, TS_MIME_FIELD_ACCEPT_ENCODING, TS_MIME_LEN_ACCEPT_ENCODING);
-  int deflate = 0;
-  int gzip = 0;
+  float deflate = -1.0;
+  float gzip = -1.0;
+  float br = -1.0;
 
   //remove the accept encoding field(s), 
-  //while finding out if gzip or deflate is supported.    
+  //while finding out the quality at which br, gzip and deflate are acceptable.
   while (field) {
     TSMLoc tmp;
-
-    if (!deflate && !gzip) {
-      int value_count = TSMimeHdrFieldValuesCount(reqp, hdr_loc, field);
-
-      while (value_count > 0) {
-        int val_len = 0;
-        const char *val;
-
-        --value_count;
-        val = TSMimeHdrFieldValueStringGet(reqp, hdr_loc, field, value_count, &val_len);
-
-        if (val_len == (int) strlen("gzip"))
-          gzip = !strncmp(val, "gzip", val_len);
-        else if (val_len == (int) strlen("deflate"))
-          deflate = !strncmp(val, "deflate", val_len);
-      }
+    int value_count = TSMimeHdrFieldValuesCount(reqp, hdr_loc, field);
+
+    while (value_count > 0) {
+      int val_len = 0;
+      const char *val;
+      float q;
+
+      --value_count;
+      val = TSMimeHdrFieldValueStringGet(reqp, hdr_loc, field, value_count, &val_len);
+      if (!val)
+        continue;
+
+      if ((q = accept_encoding_quality(val, val_len, "gzip", strlen("gzip"))) >= 0)
+        gzip = q;
+      else if ((q = accept_encoding_quality(val, val_len, "deflate", strlen("deflate"))) >= 0)
+        deflate = q;
+      else if ((q = accept_encoding_quality(val, val_len, "br", strlen("br"))) >= 0)
+        br = q;
     }
 
     tmp = TSMimeHdrFieldNextDup(reqp, hdr_loc, field);
@@ -76,18 +133,27 @@ normalize_accept_encoding(TSHttpTxn /* txnp ATS_UNUSED */, TSMBuffer reqp, TSMLo
     field = tmp;
   }
 
+#if !TS_HAS_BROTLI
+  brotli = false;
+#endif
+
+  //pick the most preferred coding, br winning ties over gzip and gzip over deflate.
+  //a q-value of 0 means the coding is not acceptable.
+  const char *coding = NULL;
+  if (brotli && br > 0 && br >= gzip && br >= deflate) {
+    coding = "br";
+  } else if (gzip > 0 && gzip >= deflate) {
+    coding = "gzip";
+  } else if (deflate > 0) {
+    coding = "deflate";
+  }
+
   //append a new accept-encoding field in the header
-  if (deflate || gzip) {
+  if (coding) {
     TSMimeHdrFieldCreate(reqp, hdr_loc, &field);
     TSMimeHdrFieldNameSet(reqp, hdr_loc, field, TS_MIME_FIELD_ACCEPT_ENCODING, TS_MIME_LEN_ACCEPT_ENCODING);
-
-    if (gzip) {
-      TSMimeHdrFieldValueStringInsert(reqp, hdr_loc, field, -1, "gzip", strlen("gzip"));
-      info("normalized accept encoding to gzip");
-    } else if (deflate) {
-      TSMimeHdrFieldValueStringInsert(reqp, hdr_loc, field, -1, "deflate", strlen("deflate"));
-      info("normalized accept encoding to deflate");
-    }
+    TSMimeHdrFieldValueStringInsert(reqp, hdr_loc, field, -1, coding, strlen(coding));
+    info("normalized accept encoding to %s", coding);
 
     TSMimeHdrFieldAppend(reqp, hdr_loc, field);
     TSHandleMLocRelease(reqp, hdr_loc, field);
@@ -24,7 +24,11 @@
 #ifndef _GZIP_MISC_H_
 #define _GZIP_MISC_H_
 
+#include "ink_config.h"
 #include <zlib.h>
+#if TS_HAS_BROTLI
+#include <brotli/encode.h>
+#endif
 #include <ts/ts.h>
 #include <stdlib.h>             //exit()
 #include <stdio.h>
@@ -33,10 +37,17 @@
 static const int ZLIB_MEMLEVEL = 9;     //min=1 (optimize for memory),max=9 (optimized for speed)
 static const int WINDOW_BITS_DEFLATE = -15;
 static const int WINDOW_BITS_GZIP = 31;
+static const int ZLIB_MAX_COMPRESSION_LEVEL = 9;
+
+#if TS_HAS_BROTLI
+//brotli stuff, see [BrotliEncoderSetParameter] in brotli/encode.h
+static const int BROTLI_LGWIN = 22;     //log2 of the sliding window size, brotli's default
+#endif
 
 //misc
 static const int COMPRESSION_TYPE_DEFLATE = 1;
 static const int COMPRESSION_TYPE_GZIP = 2;
+static const int COMPRESSION_TYPE_BROTLI = 3;
 //this one is just for txnargset/get to point to
 static const int GZIP_ONE = 1;
 static const int DICT_PATH_MAX = 512;
@@ -62,6 +73,10 @@ typedef struct
   TSIOBufferReader downstream_reader;
   int downstream_length;
   z_stream zstrm;
+#if TS_HAS_BROTLI
+  BrotliEncoderState *bstrm;
+  int64_t brotli_total_in;
+#endif
   enum transform_state state;
   int compression_type;
 } GzipData;
@@ -69,7 +84,11 @@ typedef struct
 
 voidpf gzip_alloc(voidpf opaque, uInt items, uInt size);
 void gzip_free(voidpf opaque, voidpf address);
-void normalize_accept_encoding(TSHttpTxn txnp, TSMBuffer reqp, TSMLoc hdr_loc);
+#if TS_HAS_BROTLI
+void *brotli_alloc(void *opaque, size_t size);
+void brotli_free(void *opaque, void *address);
+#endif
+void normalize_accept_encoding(TSHttpTxn txnp, TSMBuffer reqp, TSMLoc hdr_loc, bool brotli);
 void hide_accept_encoding(TSHttpTxn txnp, TSMBuffer reqp, TSMLoc hdr_loc, const char * hidden_header_name);
 void restore_accept_encoding(TSHttpTxn txnp, TSMBuffer reqp, TSMLoc hdr_loc, const char * hidden_header_name);
 const char * init_hidden_header_name();
@@ -58,6 +58,26 @@ add_header(TSMBuffer& reqp, TSMLoc& hdr_loc, const char* hdr, int hdr_len, const
   }
 }
 
+// Check if this rule can have any effect on a header with these fields. Only
+// adding or setting a header does anything when the header isn't there.
+bool
+RulesEntry::applies(const TSMimeFieldView* fields, int nfields) const
+{
+  if (_q_type == QUAL_ADD || _q_type == QUAL_SET)
+    return true;
+
+  for (int i = 0; i < nfields; ++i) {
+    if (_wks_idx >= 0) {
+      if (fields[i].wks_idx == _wks_idx)
+        return true;
+    } else if (static_cast<size_t>(fields[i].name_len) == _h_len && !strncasecmp(fields[i].name, _header, _h_len)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
 void
 RulesEntry::execute(TSMBuffer& reqp, TSMLoc& hdr_loc) const
 {
@@ -307,10 +327,19 @@ Rules::execute(TSMBuffer& reqp, TSMLoc& hdr_loc, const TSHttpHookID hook) const
 
   if (_entries[hook]) {
     RulesEntry* n = _entries[hook];
+    TSMimeFieldView fields[MAX_FIELD_VIEWS];
+    int nfields = -1;
 
     TSDebug(PLUGIN_NAME, "Executing rules(s) for hook %d", hook);
     do {
-      n->execute(reqp, hdr_loc);
+      // Look at all the fields in one go, instead of a field lookup per rule. The
+      // views are refreshed after each rule that ran, since it may have changed them.
+      if (nfields < 0)
+        nfields = TSMimeHdrFieldsViewGet(reqp, hdr_loc, fields, MAX_FIELD_VIEWS);
+      if (nfields > MAX_FIELD_VIEWS || n->applies(fields, nfields)) {
+        n->execute(reqp, hdr_loc);
+        nfields = -1;
+      }
     } while (NULL != (n = n->next()));
   }
 }
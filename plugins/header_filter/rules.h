@@ -40,6 +40,10 @@
 
 namespace HeaderFilter {
 
+// Number of field views we look at to skip rules for absent headers. Headers with
+// more fields than this run all the rules.
+static const int MAX_FIELD_VIEWS = 64;
+
 // The delimiters might look arbitrary, but are choosen to make parsing trivial
 enum QualifierTypes {
   QUAL_NONE = 0,
@@ -57,12 +61,13 @@ class RulesEntry
 {
 public:
   RulesEntry(const std::string& s, const std::string& q, QualifierTypes type, bool inverse, int options)
-    : _header(NULL), _h_len(0), _qualifier(NULL), _q_len(0), _q_type(type), _rex(NULL), _extra(NULL),
+    : _header(NULL), _h_len(0), _wks_idx(-1), _qualifier(NULL), _q_len(0), _q_type(type), _rex(NULL), _extra(NULL),
       _inverse(inverse), _options(options), _next(NULL)
   {
     if (s.length() > 0) {
       _header = TSstrdup(s.c_str());
       _h_len = s.length();
+      _wks_idx = TSMimeFieldWksIndexGet(_header, _h_len);
     }
     
     if (q.length() > 0) {
@@ -104,6 +109,7 @@ public:
 
   void append(RulesEntry* entry);
   void execute(TSMBuffer& reqp, TSMLoc& hdr_loc) const; // This is really the meat of the app
+  bool applies(const TSMimeFieldView* fields, int nfields) const;
   RulesEntry* next() const { return _next; }
 
 private:
@@ -111,6 +117,7 @@ private:
 
   char* _header;
   size_t _h_len;
+  int _wks_idx;
   char* _qualifier;
   size_t _q_len;
   QualifierTypes _q_type;
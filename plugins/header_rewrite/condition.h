@@ -55,7 +55,8 @@ public:
     TSDebug(PLUGIN_NAME_DBG, "Calling CTOR for Condition");
   }
 
-  // Inline this, it's critical for speed (and only used twice)
+  // Evaluate this condition alone, with the [NOT] modifier applied. The chaining
+  // of [AND] / [OR] is done by the RuleSet over its flattened condition array.
   bool do_eval(const Resources& res)
   {
     bool rt = eval(res);
@@ -63,21 +64,11 @@ public:
     if (_mods & COND_NOT)
       rt = !rt;
 
-    if (_next) {
-      if (_mods & COND_OR) {
-        return rt || (static_cast<Condition*>(_next)->do_eval(res));
-      } else { // AND is the default
-        // Short circuit if we're an AND and the first condition is FALSE.
-        if (rt)
-          return static_cast<Condition*>(_next)->do_eval(res);
-        else
-          return false;
-      }
-    } else {
-      return rt;
-    }
-
-    return false; // Shouldn't happen.
+    return rt;
+  }
+
+  bool is_or() const {
+    return _mods & COND_OR;
   }
 
   bool last() const {
@@ -160,6 +160,10 @@ ConditionHeader::initialize(Parser& p)
 
   _matcher = match;
 
+  _name = header_name_wks(_qualifier);
+  if (NULL == _name)
+    _name = _qualifier.c_str();
+
   require_resources(RSRC_CLIENT_REQUEST_HEADERS);
   require_resources(RSRC_CLIENT_RESPONSE_HEADERS);
   require_resources(RSRC_SERVER_REQUEST_HEADERS);
@@ -185,7 +189,7 @@ ConditionHeader::append_value(std::string& s, const Resources& res)
   }
 
   if (bufp && hdr_loc) {
-    field_loc = TSMimeHdrFieldFind(bufp, hdr_loc, _qualifier.c_str(), _qualifier.size());
+    field_loc = TSMimeHdrFieldFind(bufp, hdr_loc, _name, _qualifier.size());
     TSDebug(PLUGIN_NAME, "Getting Header: %s, field_loc: %p", _qualifier.c_str(), field_loc);
     if (field_loc != NULL) {
       value = TSMimeHdrFieldValueStringGet(res.bufp, res.hdr_loc, field_loc, 0, &len);
@@ -208,6 +212,44 @@ ConditionHeader::eval(const Resources& res)
   return rval;
 }
 
+// ConditionCookie: a cookie of the client request, parsed once per transaction
+void
+ConditionCookie::initialize(Parser& p)
+{
+  Condition::initialize(p);
+
+  Matchers<std::string>* match = new Matchers<std::string>(_cond_op);
+  match->set(p.get_arg());
+
+  _matcher = match;
+}
+
+
+void
+ConditionCookie::append_value(std::string& s, const Resources& res)
+{
+  const char* value;
+  int len;
+
+  value = TSHttpTxnClientReqCookieGet(res.txnp, _qualifier.c_str(), _qualifier.size(), &len);
+  if (value) {
+    TSDebug(PLUGIN_NAME, "Appending COOKIE(%s) to evaluation value -> %.*s", _qualifier.c_str(), len, value);
+    s.append(value, len);
+  }
+}
+
+
+bool
+ConditionCookie::eval(const Resources& res)
+{
+  std::string s;
+
+  append_value(s, res);
+  bool rval = static_cast<const Matchers<std::string>*>(_matcher)->test(s);
+  TSDebug(PLUGIN_NAME, "Evaluating COOKIE(): %s - rval: %d", s.c_str(), rval);
+  return rval;
+}
+
 // ConditionPath
 void
 ConditionPath::initialize(Parser& p)
@@ -151,7 +151,7 @@ class ConditionHeader : public Condition
 {
 public:
   explicit ConditionHeader(bool client = false)
-    : _client(client)
+    : _client(client), _name(NULL)
   {
     TSDebug(PLUGIN_NAME_DBG, "Calling CTOR for ConditionHeader, client %d", client);
   };
@@ -166,6 +166,26 @@ private:
   DISALLOW_COPY_AND_ASSIGN(ConditionHeader);
 
   bool _client;
+  const char* _name; // Interned header name, points into _qualifier if not well known
+};
+
+// cookie of the client request
+class ConditionCookie : public Condition
+{
+public:
+  explicit ConditionCookie()
+  {
+    TSDebug(PLUGIN_NAME_DBG, "Calling CTOR for ConditionCookie");
+  };
+
+  void initialize(Parser& p);
+  void append_value(std::string& s, const Resources& res);
+
+protected:
+  bool eval(const Resources& res);
+
+private:
+  DISALLOW_COPY_AND_ASSIGN(ConditionCookie);
 };
 
 // path 
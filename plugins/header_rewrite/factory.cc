@@ -89,6 +89,8 @@ condition_factory(const std::string& cond)
       c= new ConditionPath();
   } else if (c_name == "CLIENT-HEADER") {
     c = new ConditionHeader(true);
+  } else if (c_name == "COOKIE") {
+    c = new ConditionCookie();
  } else if (c_name == "QUERY") {
      c = new ConditionQuery();
  } else if (c_name == "URL") { // This condition adapts to the hook
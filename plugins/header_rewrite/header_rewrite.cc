@@ -38,9 +38,8 @@ const char* PLUGIN_NAME_DBG = "header_rewrite_dbg";
 static const char* DEFAULT_CONF_PATH = "/usr/local/etc/header_rewrite/";
 
 
-// Global holding the rulesets and resource IDs
+// Global holding the rulesets
 static RuleSet* all_rules[TS_HTTP_LAST_HOOK+1];
-static ResourceIDs all_resids[TS_HTTP_LAST_HOOK+1];
 
 // Helper function to add a rule to the rulesets
 static bool
@@ -141,11 +140,6 @@ parse_config(const std::string fname, TSHttpHookID default_hook)
   // Add the last rule (possibly the only rule)
   add_rule(rule);
 
-  // Collect all resource IDs that we need
-  for (int i=TS_HTTP_READ_REQUEST_HDR_HOOK; i<TS_HTTP_LAST_HOOK; ++i)
-    if (all_rules[i])
-      all_resids[i] = all_rules[i]->get_all_resource_ids();
-
   return true;
 }
 
@@ -187,12 +181,14 @@ cont_rewrite_headers(TSCont contp, TSEvent event, void *edata)
   }
 
   if (hook != TS_HTTP_LAST_HOOK) {
-    res.gather(all_resids[hook], hook);
     rule = all_rules[hook];
 
-    // Evaluation
+    // Evaluation. Resources are gathered as the rules need them, so operator
+    // resources are only fetched for rules whose conditions matched.
     while (rule) {
+      res.gather(rule->get_cond_resource_ids(), hook);
       if (rule->eval(res)) {
+        res.gather(rule->get_oper_resource_ids(), hook);
         OperModifiers rt = rule->exec(res);
 
         if (rule->last() || (rt & OPER_LAST)) {
@@ -233,7 +229,6 @@ TSPluginInit(int argc, const char *argv[])
   // Initialize the globals
   for (int i=TS_HTTP_READ_REQUEST_HDR_HOOK; i<TS_HTTP_LAST_HOOK; ++i) {
     all_rules[i] = NULL;
-    all_resids[i] = RSRC_NONE;
   }
 
   // Parse the config file
@@ -53,8 +53,6 @@ public:
 
   void do_exec(const Resources& res) const {
     exec(res);
-    if (NULL != _next)
-      static_cast<Operator*>(_next)->do_exec(res);
   }
 
   const OperModifiers get_oper_modifiers() const;
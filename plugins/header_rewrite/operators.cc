@@ -31,6 +31,9 @@ OperatorRMHeader::initialize(Parser& p) {
   Operator::initialize(p);
 
   _header = p.get_arg();
+  _name = header_name_wks(_header);
+  if (NULL == _name)
+    _name = _header.c_str();
 
   require_resources(RSRC_SERVER_RESPONSE_HEADERS);
   require_resources(RSRC_SERVER_REQUEST_HEADERS);
@@ -46,7 +49,7 @@ OperatorRMHeader::exec(const Resources& res) const
 
   if (res.bufp && res.hdr_loc) {
     TSDebug(PLUGIN_NAME, "OperatorRMHeader::exec() invoked on header %s", _header.c_str());
-    field_loc = TSMimeHdrFieldFind(res.bufp, res.hdr_loc, _header.c_str(), _header.size());
+    field_loc = TSMimeHdrFieldFind(res.bufp, res.hdr_loc, _name, _header.size());
     while (field_loc) {
       TSDebug(PLUGIN_NAME, "\tdeleting header %s", _header.c_str());
       tmp = TSMimeHdrFieldNextDup(res.bufp, res.hdr_loc, field_loc);
@@ -133,6 +136,9 @@ OperatorAddHeader::initialize(Parser& p) {
   Operator::initialize(p);
 
   _header = p.get_arg();
+  _name = header_name_wks(_header);
+  if (NULL == _name)
+    _name = _header.c_str();
   _value.set_value(p.get_value());
   
   require_resources(RSRC_SERVER_RESPONSE_HEADERS);
@@ -161,7 +167,7 @@ OperatorAddHeader::exec(const Resources& res) const
     TSDebug(PLUGIN_NAME, "OperatorAddHeader::exec() invoked on header %s: %s", _header.c_str(), value.c_str());
     TSMLoc field_loc;
     
-    if (TS_SUCCESS == TSMimeHdrFieldCreateNamed(res.bufp, res.hdr_loc, _header.c_str(), _header.size(), &field_loc)) {
+    if (TS_SUCCESS == TSMimeHdrFieldCreateNamed(res.bufp, res.hdr_loc, _name, _header.size(), &field_loc)) {
       if (TS_SUCCESS == TSMimeHdrFieldValueStringInsert(res.bufp, res.hdr_loc, field_loc, -1, value.c_str(), value.size())) {
         TSDebug(PLUGIN_NAME, "   adding header %s", _header.c_str());
         //INKHttpHdrPrint(res.bufp, res.hdr_loc, reqBuff);
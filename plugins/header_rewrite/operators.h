@@ -37,7 +37,7 @@ class OperatorRMHeader : public Operator
 {
 public:
   OperatorRMHeader()
-    : _header("")
+    : _header(""), _name(NULL)
   {
     TSDebug(PLUGIN_NAME_DBG, "Calling CTOR for OperatorRMHeader");
   }
@@ -50,6 +50,7 @@ private:
   DISALLOW_COPY_AND_ASSIGN(OperatorRMHeader);
 
   std::string _header;
+  const char* _name; // Interned header name, points into _header if not well known
 };
 
 
@@ -100,7 +101,7 @@ class OperatorAddHeader : public Operator
 {
 public:
   OperatorAddHeader()
-    : _header("")
+    : _header(""), _name(NULL)
   {
     TSDebug(PLUGIN_NAME_DBG, "Calling CTOR for OperatorAddHeader");
   }
@@ -113,6 +114,7 @@ private:
   DISALLOW_COPY_AND_ASSIGN(OperatorAddHeader);
 
   std::string _header;
+  const char* _name; // Interned header name, points into _header if not well known
   Value _value;
 };
 
@@ -27,10 +27,17 @@
 void
 Resources::gather(const ResourceIDs ids, TSHttpHookID hook)
 {
+  // Rules gather lazily, so only fetch what an earlier call for this hook didn't already provide.
+  const ResourceIDs want = static_cast<ResourceIDs>(ids & ~_gathered);
+
+  if (_ready && (RSRC_NONE == want))
+    return;
+
   TSDebug(PLUGIN_NAME, "Building resource structure for hook (%d)", hook);
+  _gathered = static_cast<ResourceIDs>(_gathered | want);
 
   // If we need the client request headers, make sure it's also available in the client vars.
-  if (ids & RSRC_CLIENT_REQUEST_HEADERS) {
+  if (want & RSRC_CLIENT_REQUEST_HEADERS) {
     TSDebug(PLUGIN_NAME, "\tAdding TXN client request header buffers");
     if (TSHttpTxnClientReqGet(txnp, &client_bufp, &client_hdr_loc) != TS_SUCCESS) {
       TSDebug(PLUGIN_NAME, "could not gather bufp/hdr_loc for request");
@@ -41,14 +48,14 @@ Resources::gather(const ResourceIDs ids, TSHttpHookID hook)
   switch (hook) {
   case TS_HTTP_READ_RESPONSE_HDR_HOOK:
     // Read response headers from server
-    if (ids & RSRC_SERVER_RESPONSE_HEADERS) {
+    if (want & RSRC_SERVER_RESPONSE_HEADERS) {
       TSDebug(PLUGIN_NAME, "\tAdding TXN server response header buffers");
       if (TSHttpTxnServerRespGet(txnp, &bufp, &hdr_loc) != TS_SUCCESS) {
         TSDebug(PLUGIN_NAME, "could not gather bufp/hdr_loc for response");
         return;
       }
     }
-    if (ids & RSRC_RESPONSE_STATUS) {
+    if ((want & RSRC_RESPONSE_STATUS) && bufp && hdr_loc) {
       TSDebug(PLUGIN_NAME, "\tAdding TXN server response status resource");
       resp_status = TSHttpHdrStatusGet(bufp, hdr_loc);
     }
@@ -56,7 +63,7 @@ Resources::gather(const ResourceIDs ids, TSHttpHookID hook)
 
   case TS_HTTP_SEND_REQUEST_HDR_HOOK:
     // Read request headers to server
-    if (ids & RSRC_SERVER_REQUEST_HEADERS) {
+    if (want & RSRC_SERVER_REQUEST_HEADERS) {
       TSDebug(PLUGIN_NAME, "\tAdding TXN server request header buffers");
       if (!TSHttpTxnServerReqGet(txnp, &bufp, &hdr_loc)) {
         TSDebug(PLUGIN_NAME, "could not gather bufp/hdr_loc for request");
@@ -68,7 +75,7 @@ Resources::gather(const ResourceIDs ids, TSHttpHookID hook)
   case TS_HTTP_READ_REQUEST_HDR_HOOK:
   case TS_HTTP_READ_REQUEST_PRE_REMAP_HOOK:
     // Read request from client
-    if (ids & RSRC_CLIENT_REQUEST_HEADERS) {
+    if (want & RSRC_CLIENT_REQUEST_HEADERS) {
       bufp = client_bufp;
       hdr_loc = client_hdr_loc;
     }
@@ -76,16 +83,16 @@ Resources::gather(const ResourceIDs ids, TSHttpHookID hook)
 
   case TS_HTTP_SEND_RESPONSE_HDR_HOOK:
     // Send response headers to client
-    if (ids & RSRC_CLIENT_RESPONSE_HEADERS) {
+    if (want & RSRC_CLIENT_RESPONSE_HEADERS) {
       TSDebug(PLUGIN_NAME, "\tAdding TXN client response header buffers");
       if (TSHttpTxnClientRespGet(txnp, &bufp, &hdr_loc) != TS_SUCCESS) {
         TSDebug(PLUGIN_NAME, "could not gather bufp/hdr_loc for request");
         return;
       }
-      if (ids & RSRC_RESPONSE_STATUS) {
-        TSDebug(PLUGIN_NAME, "\tAdding TXN client esponse status resource");
-        resp_status = TSHttpHdrStatusGet(bufp, hdr_loc);
-      }
+    }
+    if ((want & RSRC_RESPONSE_STATUS) && bufp && hdr_loc) {
+      TSDebug(PLUGIN_NAME, "\tAdding TXN client esponse status resource");
+      resp_status = TSHttpHdrStatusGet(bufp, hdr_loc);
     }
     break;
 
@@ -119,5 +126,6 @@ Resources::destroy()
       TSHandleMLocRelease(client_bufp, TS_NULL_MLOC, client_hdr_loc);
   }
 
+  _gathered = RSRC_NONE;
   _ready = false;
 }
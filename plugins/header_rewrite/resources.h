@@ -49,7 +49,7 @@ class Resources
 public:
   explicit Resources(TSHttpTxn txnptr, TSCont contptr)
     : txnp(txnptr), contp(contptr), bufp(NULL), hdr_loc(NULL), client_bufp(NULL), client_hdr_loc(NULL),
-      resp_status(TS_HTTP_STATUS_NONE), _rri(NULL), changed_url(false), _ready(false)
+      resp_status(TS_HTTP_STATUS_NONE), _rri(NULL), changed_url(false), _gathered(RSRC_NONE), _ready(false)
   {
     TSDebug(PLUGIN_NAME_DBG, "Calling CTOR for Resources (InkAPI)");
   }
@@ -57,7 +57,7 @@ public:
   Resources(TSHttpTxn txnptr, TSRemapRequestInfo *rri) :
     txnp(txnptr), contp(NULL),
     bufp(NULL), hdr_loc(NULL), client_bufp(NULL), client_hdr_loc(NULL), resp_status(TS_HTTP_STATUS_NONE),
-    _rri(rri), _ready(false)
+    _rri(rri), changed_url(false), _gathered(RSRC_NONE), _ready(false)
   {
     TSDebug(PLUGIN_NAME_DBG, "Calling CTOR for Resources (RemapAPI)");
     TSDebug(PLUGIN_NAME, "rri: %p", _rri);
@@ -65,6 +65,7 @@ public:
 
   ~Resources() { destroy(); }
 
+  // Can be called repeatedly; only resources not already gathered are fetched.
   void gather(const ResourceIDs ids, TSHttpHookID hook);
   bool ready() const { return _ready; }
 
@@ -82,6 +83,7 @@ private:
   void destroy();
   DISALLOW_COPY_AND_ASSIGN(Resources);
 
+  ResourceIDs _gathered;
   bool _ready;
 };
 
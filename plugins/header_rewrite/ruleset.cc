@@ -51,15 +51,12 @@ RuleSet::add_condition(Parser& p) {
       TSError("header_rewrite: can't use this condition in this hook");
       return;
     }
-    if (NULL == _cond) {
-      _cond = c;
-    } else {
-      _cond->append(c);
-    }
+    _conds.push_back(c);
 
     // Update some ruleset state based on this new condition
     _last |= c->last();
-    _ids = static_cast<ResourceIDs>(_ids | _cond->get_resource_ids());
+    _cond_ids = static_cast<ResourceIDs>(_cond_ids | c->get_resource_ids());
+    _ids = static_cast<ResourceIDs>(_ids | _cond_ids);
   }
 }
 
@@ -76,14 +73,11 @@ RuleSet::add_operator(Parser& p) {
       TSError("header_rewrite: can't use this operator in this hook");
       return;
     }
-    if (NULL == _oper) {
-      _oper = o;
-    } else {
-      _oper->append(o);
-    }
+    _opers.push_back(o);
 
     // Update some ruleset state based on this new operator
-    _opermods = static_cast<OperModifiers>(_opermods | _oper->get_oper_modifiers());
-    _ids = static_cast<ResourceIDs>(_ids | _oper->get_resource_ids());
+    _opermods = static_cast<OperModifiers>(_opermods | o->get_oper_modifiers());
+    _oper_ids = static_cast<ResourceIDs>(_oper_ids | o->get_resource_ids());
+    _ids = static_cast<ResourceIDs>(_ids | _oper_ids);
   }
 }
@@ -23,6 +23,7 @@
 #define __RULESET_H__ 1
 
 #include <string>
+#include <vector>
 
 #include "matcher.h"
 #include "factory.h"
@@ -38,8 +39,8 @@ class RuleSet
 {
 public:
   RuleSet()
-    : next(NULL), _cond(NULL), _oper(NULL), _hook(TS_HTTP_READ_RESPONSE_HDR_HOOK), _ids(RSRC_NONE),
-      _opermods(OPER_NONE), _last(false)
+    : next(NULL), _hook(TS_HTTP_READ_RESPONSE_HDR_HOOK), _ids(RSRC_NONE), _cond_ids(RSRC_NONE),
+      _oper_ids(RSRC_NONE), _opermods(OPER_NONE), _last(false)
   { };
 
   // No reason to inline these
@@ -47,8 +48,8 @@ public:
 
   void add_condition(Parser& p);
   void add_operator(Parser& p);
-  bool has_operator() const { return NULL != _oper; }
-  bool has_condition() const { return NULL != _cond; }
+  bool has_operator() const { return !_opers.empty(); }
+  bool has_condition() const { return !_conds.empty(); }
 
   void set_hook(TSHttpHookID hook) { _hook = hook; }
   const TSHttpHookID get_hook() const { return _hook; }
@@ -58,12 +59,38 @@ public:
     return _ids;
   }
 
+  // Resources needed to evaluate the conditions, and to run the operators
+  // respectively. These are gathered lazily, per rule, as the rules are run.
+  const ResourceIDs get_cond_resource_ids() const {
+    return _cond_ids;
+  }
+
+  const ResourceIDs get_oper_resource_ids() const {
+    return _oper_ids;
+  }
+
+  // The conditions are kept in a flat array, in the order they were parsed, and
+  // evaluated left to right. This is equivalent to the right associative chain
+  // the modifiers describe: an [OR] that is true, or an [AND] that is false,
+  // decides the outcome, otherwise the last condition does.
   bool eval(const Resources& res) const {
-    if (NULL == _cond) {
-      return true;
-    } else {
-      return _cond->do_eval(res);
+    const size_t n = _conds.size();
+
+    for (size_t i = 0; i < n; ++i) {
+      Condition* c = _conds[i];
+      bool rt = c->do_eval(res);
+
+      if (i + 1 == n)
+        return rt;
+      if (c->is_or()) {
+        if (rt)
+          return true;
+      } else if (!rt) { // AND is the default
+        return false;
+      }
     }
+
+    return true; // No conditions
   }
 
   bool last() const {
@@ -71,7 +98,8 @@ public:
   }
 
   OperModifiers exec(const Resources& res) const {
-    _oper->do_exec(res);
+    for (std::vector<Operator*>::const_iterator it = _opers.begin(); it != _opers.end(); ++it)
+      (*it)->do_exec(res);
     return _opermods;
   }
 
@@ -80,12 +108,14 @@ public:
 private:
   DISALLOW_COPY_AND_ASSIGN(RuleSet);
 
-  Condition* _cond; // First pre-condition (linked list)
-  Operator* _oper; // First operator (linked list)
+  std::vector<Condition*> _conds; // Pre-conditions, in evaluation order
+  std::vector<Operator*> _opers; // Operators, in execution order
   TSHttpHookID _hook; // Which hook is this rule for
 
   // State values (updated when conds / operators are added)
   ResourceIDs _ids;
+  ResourceIDs _cond_ids;
+  ResourceIDs _oper_ids;
   OperModifiers _opermods;
   bool _last;
 };
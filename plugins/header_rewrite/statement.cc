@@ -21,6 +21,7 @@
 //
 
 #include <ts/ts.h>
+#include <strings.h>
 
 #include "statement.h"
 
@@ -96,3 +97,43 @@ Statement::parse_url_qualifier(const std::string& q) {
 
   return qual;
 }
+
+
+// The header names the core knows about. These are pointers to the API globals, since
+// their values are not set up until the core initializes the API.
+static const char** const wks_header_names[] = {
+  &TS_MIME_FIELD_ACCEPT, &TS_MIME_FIELD_ACCEPT_CHARSET, &TS_MIME_FIELD_ACCEPT_ENCODING,
+  &TS_MIME_FIELD_ACCEPT_LANGUAGE, &TS_MIME_FIELD_ACCEPT_RANGES, &TS_MIME_FIELD_AGE, &TS_MIME_FIELD_ALLOW,
+  &TS_MIME_FIELD_APPROVED, &TS_MIME_FIELD_AUTHORIZATION, &TS_MIME_FIELD_BYTES, &TS_MIME_FIELD_CACHE_CONTROL,
+  &TS_MIME_FIELD_CLIENT_IP, &TS_MIME_FIELD_CONNECTION, &TS_MIME_FIELD_CONTENT_BASE,
+  &TS_MIME_FIELD_CONTENT_ENCODING, &TS_MIME_FIELD_CONTENT_LANGUAGE, &TS_MIME_FIELD_CONTENT_LENGTH,
+  &TS_MIME_FIELD_CONTENT_LOCATION, &TS_MIME_FIELD_CONTENT_MD5, &TS_MIME_FIELD_CONTENT_RANGE,
+  &TS_MIME_FIELD_CONTENT_TYPE, &TS_MIME_FIELD_CONTROL, &TS_MIME_FIELD_COOKIE, &TS_MIME_FIELD_DATE,
+  &TS_MIME_FIELD_DISTRIBUTION, &TS_MIME_FIELD_ETAG, &TS_MIME_FIELD_EXPECT, &TS_MIME_FIELD_EXPIRES,
+  &TS_MIME_FIELD_FOLLOWUP_TO, &TS_MIME_FIELD_FROM, &TS_MIME_FIELD_HOST, &TS_MIME_FIELD_IF_MATCH,
+  &TS_MIME_FIELD_IF_MODIFIED_SINCE, &TS_MIME_FIELD_IF_NONE_MATCH, &TS_MIME_FIELD_IF_RANGE,
+  &TS_MIME_FIELD_IF_UNMODIFIED_SINCE, &TS_MIME_FIELD_KEEP_ALIVE, &TS_MIME_FIELD_KEYWORDS,
+  &TS_MIME_FIELD_LAST_MODIFIED, &TS_MIME_FIELD_LINES, &TS_MIME_FIELD_LOCATION, &TS_MIME_FIELD_MAX_FORWARDS,
+  &TS_MIME_FIELD_MESSAGE_ID, &TS_MIME_FIELD_NEWSGROUPS, &TS_MIME_FIELD_ORGANIZATION, &TS_MIME_FIELD_PATH,
+  &TS_MIME_FIELD_PRAGMA, &TS_MIME_FIELD_PROXY_AUTHENTICATE, &TS_MIME_FIELD_PROXY_AUTHORIZATION,
+  &TS_MIME_FIELD_PROXY_CONNECTION, &TS_MIME_FIELD_PUBLIC, &TS_MIME_FIELD_RANGE, &TS_MIME_FIELD_REFERENCES,
+  &TS_MIME_FIELD_REFERER, &TS_MIME_FIELD_REPLY_TO, &TS_MIME_FIELD_RETRY_AFTER, &TS_MIME_FIELD_SENDER,
+  &TS_MIME_FIELD_SERVER, &TS_MIME_FIELD_SET_COOKIE, &TS_MIME_FIELD_SUBJECT, &TS_MIME_FIELD_SUMMARY,
+  &TS_MIME_FIELD_TE, &TS_MIME_FIELD_TRANSFER_ENCODING, &TS_MIME_FIELD_UPGRADE, &TS_MIME_FIELD_USER_AGENT,
+  &TS_MIME_FIELD_VARY, &TS_MIME_FIELD_VIA, &TS_MIME_FIELD_WARNING, &TS_MIME_FIELD_WWW_AUTHENTICATE,
+  &TS_MIME_FIELD_XREF, &TS_MIME_FIELD_X_FORWARDED_FOR,
+};
+
+
+const char*
+Statement::header_name_wks(const std::string& name)
+{
+  for (size_t i = 0; i < sizeof(wks_header_names) / sizeof(wks_header_names[0]); ++i) {
+    const char* wks = *wks_header_names[i];
+
+    if (wks && (0 == strcasecmp(wks, name.c_str())))
+      return wks;
+  }
+
+  return NULL;
+}
@@ -87,6 +87,10 @@ class Statement
   virtual void initialize_hooks();
 
   UrlQualifiers parse_url_qualifier(const std::string& q);
+
+  // Map a header name to the core's well known string (TS_MIME_FIELD_*), which lets
+  // the MIME lookups skip tokenizing the name. Returns NULL for any other header.
+  static const char* header_name_wks(const std::string& name);
   void require_resources(const ResourceIDs ids) { _rsrc = static_cast<ResourceIDs>(_rsrc | ids); }
 
   Statement* _next; // Linked list
@@ -27,6 +27,7 @@
 #include <sys/types.h>
 #include <stdio.h>
 #include <time.h>
+#include <inttypes.h>
 #include <string.h>
 
 #ifdef HAVE_PCRE_PCRE_H
@@ -46,12 +47,20 @@
 #include "ink_platform.h"
 #include "ink_atomic.h"
 #include "ink_time.h"
+#include "ink_hrtime.h"
 
 static const char* PLUGIN_NAME = "regex_remap";
 
+#ifdef PCRE_STUDY_JIT_COMPILE
+#define REGEX_STUDY_FLAGS PCRE_STUDY_JIT_COMPILE
+#else
+#define REGEX_STUDY_FLAGS 0
+#endif
+
 // Constants
 static const int OVECCOUNT = 30; // We support $0 - $9 x2 ints, and this needs to be 1.5x that
 static const int MAX_SUBS = 32;   // No more than 32 substitution variables in the subst string
+static const int MAX_PREFIX = 64; // Longest literal prefix used to skip regexes that can not match
 
 // TODO: This should be "autoconf'ed" or something ...
 #define DEFAULT_PATH "/usr/local/etc/regex_remap/"
@@ -118,7 +127,7 @@ class RemapRegex
 {
  public:
   RemapRegex(const std::string& reg, const std::string& sub, const std::string& opt) :
-    _num_subs(-1), _rex(NULL), _extra(NULL), _order(-1), _simple(false),
+    _num_subs(-1), _rex(NULL), _extra(NULL), _prefix_len(0), _order(-1), _simple(false),
     _active_timeout(-1), _no_activity_timeout(-1), _connect_timeout(-1), _dns_timeout(-1)
   {
     TSDebug(PLUGIN_NAME, "Calling constructor");
@@ -143,6 +152,8 @@ class RemapRegex
     }
 
     _hits = 0;
+    _execs = 0;
+    _exec_time = 0;
 
     memset(_sub_pos, 0, sizeof(_sub_pos));
     memset(_sub_ix, 0, sizeof(_sub_ix));
@@ -194,15 +205,21 @@ class RemapRegex
 
     if (_rex)
       pcre_free(_rex);
-    if (_extra)
+    if (_extra) {
+#ifdef PCRE_STUDY_JIT_COMPILE
+      pcre_free_study(_extra);
+#else
       pcre_free(_extra);
+#endif
+    }
   };
 
   // For profiling information
   inline void
   print(int ix, int max, const char* now)
   {
-    fprintf(stderr, "[%s]:\tRegex %d ( %s ): %.2f%%\n", now, ix, _rex_string, 100.0 * _hits / max);
+    fprintf(stderr, "[%s]:\tRegex %d ( %s ): %.2f%%, %" PRId64 " evaluations, %.0f ns/evaluation\n", now, ix, _rex_string,
+            max > 0 ? 100.0 * _hits / max : 0.0, _execs, _execs > 0 ? (double)_exec_time / _execs : 0.0);
   }
 
   inline void
@@ -211,6 +228,22 @@ class RemapRegex
     ink_atomic_increment(&(_hits), 1);
   }
 
+  // Account the time spent in one evaluation of this regex.
+  inline void
+  add_exec_time(ink_hrtime t)
+  {
+    ink_atomic_increment(&(_execs), (int64_t)1);
+    ink_atomic_increment(&(_exec_time), (int64_t)t);
+  }
+
+  // Quick check if the subject can match at all, before running the regex. Only
+  // rules anchored with a literal prefix have one, everything else passes.
+  inline bool
+  can_match(const char* str, int len) const
+  {
+    return (len >= _prefix_len) && (0 == memcmp(str, _prefix, _prefix_len));
+  }
+
   // Compile and study the regular expression.
   int
   compile(const char** error, int* erroffset)
@@ -227,13 +260,15 @@ class RemapRegex
     if (NULL == _rex)
       return -1;
 
-    _extra = pcre_study(_rex, 0, error);
+    _extra = pcre_study(_rex, REGEX_STUDY_FLAGS, error);
     if ((_extra == NULL) && (*error != 0))
       return -1;
 
     if (pcre_fullinfo(_rex, _extra, PCRE_INFO_CAPTURECOUNT, &ccount) != 0)
       return -1;
 
+    set_prefix();
+
     // Get some info for the string substitutions
     str = _subst;
     _num_subs = 0;
@@ -298,6 +333,47 @@ class RemapRegex
     return 0;
   };
 
+  // Extract the literal prefix that any match of an anchored regex must start with, e.g.
+  // "/images/" for "^/images/(.*)". We stop at the first meta character, and drop the last
+  // literal if it is quantified. Alternations could make the prefix optional, so regexes
+  // with a '|' anywhere get no prefix.
+  void
+  set_prefix()
+  {
+    _prefix_len = 0;
+    if (_simple || !_rex_string || _rex_string[0] != '^' || strchr(_rex_string, '|'))
+      return;
+
+    const char* p = _rex_string + 1;
+
+    while (*p && _prefix_len < MAX_PREFIX) {
+      char c = *p;
+      int len = 1;
+
+      if ('\\' == c) {
+        // Only escaped punctuation is a literal, \d, \w etc. are classes
+        if (!*(p + 1) || isalnum(*(p + 1)))
+          break;
+        c = *(p + 1);
+        len = 2;
+      } else if (strchr(".[]()?*+{}^$", c)) {
+        break;
+      }
+
+      const char next = *(p + len);
+      if ('?' == next || '*' == next || '+' == next || '{' == next) {
+        // The last literal might not be there, or be repeated.
+        break;
+      }
+
+      _prefix[_prefix_len++] = c;
+      p += len;
+    }
+
+    if (_prefix_len > 0)
+      TSDebug(PLUGIN_NAME, "Regex %s requires the prefix `%.*s'", _rex_string, _prefix_len, _prefix);
+  }
+
   // Perform the regular expression matching against a string.
   int
   match(const char* str, int len, int ovector[])
@@ -479,9 +555,13 @@ class RemapRegex
   int _subst_len;
   int _num_subs;
   int _hits;
+  volatile int64_t _execs;
+  volatile int64_t _exec_time;
 
   pcre* _rex;
   pcre_extra* _extra;
+  char _prefix[MAX_PREFIX];
+  int _prefix_len;
   int _sub_pos[MAX_SUBS];
   int _sub_ix[MAX_SUBS];
   RemapRegex* _next;
@@ -713,7 +793,7 @@ TSRemapDeleteInstance(void* ih)
     fprintf(stderr, "[%s]:\tTotal hits (matches): %d\n", now, ri->hits);
     fprintf(stderr, "[%s]:\tTotal missed (no regex matches): %d\n", now, ri->misses);
 
-    if (ri->hits > 0) { // Avoid divide by zeros...
+    if ((ri->hits > 0) || (ri->misses > 0)) { // Print the evaluation times even if nothing matched
       int ix = 1;
 
       re = ri->first;
@@ -800,8 +880,23 @@ TSRemapDoRemap(void* ih, TSHttpTxn txnp, TSRemapRequestInfo *rri)
 
   // Apply the regular expressions, in order. First one wins.
   while (re) {
+    bool matched;
+
     // Since we check substitutions on parse time, we don't need to reset ovector
-    if (re->is_simple() || (re->match(match_buf, match_len, ovector) != -1)) {
+    if (re->is_simple()) {
+      matched = true;
+    } else if (!re->can_match(match_buf, match_len)) {
+      matched = false;
+    } else if (ri->profile) {
+      ink_hrtime start = ink_get_hrtime_internal();
+
+      matched = (re->match(match_buf, match_len, ovector) != -1);
+      re->add_exec_time(ink_get_hrtime_internal() - start);
+    } else {
+      matched = (re->match(match_buf, match_len, ovector) != -1);
+    }
+
+    if (matched) {
       int new_len = re->get_lengths(ovector, lengths, rri, &req_url);
 
       // Set timeouts
@@ -73,6 +73,36 @@ typedef ControlMatcher<CacheControlRecord, CacheControlResult> CC_table;
 static Ptr<ProxyMutex> reconfig_mutex;
 CC_table *CacheControlTable = NULL;
 
+// Bumped after each new table is in place
+static volatile int CacheControlGeneration = 0;
+static int cc_result_cache_enabled = 1;
+
+// struct CC_ResultCache
+//
+//   Results of recent lookups, per thread, keyed by the request's host
+//     and URL.  Only used while the result can depend on nothing else,
+//     i.e. the table has no IP rules and no modifiers
+//
+#define CC_RESULT_CACHE_SIZE 256      // a power of 2
+#define CC_RESULT_KEY_MAX    240
+
+struct CC_ResultCacheEntry
+{
+  int key_len;                  // -1 for an empty entry
+  char key[CC_RESULT_KEY_MAX];
+  CacheControlResult result;
+};
+
+struct CC_ResultCache
+{
+  int generation;               // of the table the entries came from
+  bool usable;
+  bool use_url;                 // the table has url or regex rules
+  CC_ResultCacheEntry entries[CC_RESULT_CACHE_SIZE];
+};
+
+static __thread CC_ResultCache *cc_result_cache = NULL;
+
 void
 CC_delete_table()
 {
@@ -151,6 +181,7 @@ initCacheControl()
   reconfig_mutex = new_ProxyMutex();
   CacheControlTable = NEW(new CC_table("proxy.config.cache.control.filename", modulePrefix, &http_dest_tags));
   REC_RegisterConfigUpdateFunc("proxy.config.cache.control.filename", cacheControlFile_CB, NULL);
+  REC_EstablishStaticConfigInt32(cc_result_cache_enabled, "proxy.config.cache.control.result_cache");
 }
 
 // void reloadCacheControl()
@@ -168,13 +199,115 @@ reloadCacheControl()
   eventProcessor.schedule_in(NEW(new CC_FreerContinuation(CacheControlTable)), CACHE_CONTROL_TIMEOUT, ET_CACHE);
   newTable = NEW(new CC_table("proxy.config.cache.control.filename", modulePrefix, &http_dest_tags));
   ink_atomic_swap(&CacheControlTable, newTable);
+  ink_atomic_increment(&CacheControlGeneration, 1);
+}
+
+template<class M> static bool
+CC_matcher_has_modifiers(M *m)
+{
+  if (m == NULL) {
+    return false;
+  }
+
+  CacheControlRecord *d = m->getDataArray();
+  for (int i = 0; i < m->getNumElements(); i++) {
+    if (d[i].hasModifiers()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// The result of a lookup that has not matched anything yet
+static bool
+CC_result_is_unset(const CacheControlResult *r)
+{
+  return r->revalidate_after == CC_UNSET_TIME && r->pin_in_cache_for == CC_UNSET_TIME &&
+    r->ttl_in_cache == CC_UNSET_TIME && !r->never_cache && !r->cluster_cache_local &&
+    !r->ignore_client_no_cache && !r->ignore_server_no_cache && r->ignore_client_cc_max_age &&
+    r->cache_responses_to_cookies == -1 && r->reval_line == -1 && r->never_line == -1 &&
+    r->pin_line == -1 && r->ttl_line == -1 && r->cluster_cache_local_line == -1 &&
+    r->ignore_client_line == -1 && r->ignore_server_line == -1;
+}
+
+// Matches the request against the table, through this thread's
+//   result cache when the table allows it
+static void
+CC_match(CacheControlResult *result, HttpRequestData *rdata)
+{
+  // Read the generation before the table, so a table newer than the
+  //  generation can only flush the cache needlessly
+  int generation = CacheControlGeneration;
+  CC_table *table = CacheControlTable;
+  CC_ResultCache *c = cc_result_cache;
+
+  if (!cc_result_cache_enabled || !CC_result_is_unset(result)) {
+    table->Match(rdata, result);
+    return;
+  }
+
+  if (unlikely(c == NULL)) {
+    c = cc_result_cache = (CC_ResultCache *)ats_malloc(sizeof(CC_ResultCache));
+    c->generation = generation - 1;
+  }
+  if (c->generation != generation) {
+    c->generation = generation;
+    c->usable = table->ipMatch == NULL && !CC_matcher_has_modifiers(table->hostMatch) &&
+      !CC_matcher_has_modifiers(table->reMatch) && !CC_matcher_has_modifiers(table->urlMatch) &&
+      !CC_matcher_has_modifiers(table->hrMatch);
+    c->use_url = table->reMatch != NULL || table->urlMatch != NULL;
+    for (int i = 0; i < CC_RESULT_CACHE_SIZE; i++) {
+      c->entries[i].key_len = -1;
+    }
+    Debug("cache_control", "result cache %s for table generation %d", c->usable ? "enabled" : "disabled", generation);
+  }
+  if (!c->usable) {
+    table->Match(rdata, result);
+    return;
+  }
+
+  // The key is the host, then the URL if the table has rules on it
+  char key[CC_RESULT_KEY_MAX];
+  char *to_free = NULL;
+  const char *host = rdata->get_host();
+  const char *url = c->use_url ? rdata->get_string_ref(&to_free) : NULL;
+  int host_len = host ? strlen(host) : 0;
+  int url_len = url ? strlen(url) : 0;
+  int key_len = host_len + 1 + url_len;
+
+  if (key_len > CC_RESULT_KEY_MAX) {
+    ats_free(to_free);
+    table->Match(rdata, result);
+    return;
+  }
+  if (host_len)
+    memcpy(key, host, host_len);
+  key[host_len] = '\n';
+  if (url_len)
+    memcpy(key + host_len + 1, url, url_len);
+  ats_free(to_free);
+
+  uint32_t h = 2166136261U;
+  for (int i = 0; i < key_len; i++) {
+    h = (h ^ (unsigned char)key[i]) * 16777619U;
+  }
+
+  CC_ResultCacheEntry *e = &c->entries[h & (CC_RESULT_CACHE_SIZE - 1)];
+  if (e->key_len == key_len && memcmp(e->key, key, key_len) == 0) {
+    *result = e->result;
+  } else {
+    table->Match(rdata, result);
+    e->key_len = key_len;
+    memcpy(e->key, key, key_len);
+    e->result = *result;
+  }
 }
 
 void
 getCacheControl(CacheControlResult *result, HttpRequestData *rdata, OverridableHttpConfigParams *h_txn_conf, char *tag)
 {
   rdata->tag = tag;
-  CacheControlTable->Match(rdata, result);
+  CC_match(result, rdata);
 
   if (h_txn_conf->cache_cluster_cache_local) {
     result->cluster_cache_local = true;
@@ -80,6 +80,8 @@ public:
   void Print();
   int line_num;
   Modifier* findModOfType(Modifier::Type t) const;
+  /// @return @c true if the line has any modifier.
+  bool hasModifiers() const { return _mods.length() > 0; }
 protected:
   /// Get the text for the Scheme modifier, if any.
   /// @return The text if present, 0 otherwise.
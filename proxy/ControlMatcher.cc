@@ -63,6 +63,30 @@ HttpRequestData::get_string()
   return str;
 }
 
+const char *
+HttpRequestData::get_string_ref(char **to_free)
+{
+  if (!arena)
+    return *to_free = get_string();
+
+  // The header keeps its printed URL until the URL changes, so an
+  //  unchanged reference means the unescaped copy is still good
+  int len = 0;
+  const char *ref = hdr->url_string_get_ref(&len);
+
+  *to_free = NULL;
+  if (ref != url_ref || len != url_ref_len) {
+    url_ref = ref;
+    url_ref_len = len;
+    url_match = NULL;
+    if (ref) {
+      url_match = arena->str_store(ref, len);
+      unescapifyStr(url_match);
+    }
+  }
+  return url_match;
+}
+
 const char *
 HttpRequestData::get_host()
 {
@@ -81,6 +105,326 @@ HttpRequestData::get_client_ip()
   return &src_ip.sa;
 }
 
+//
+// RegexPrefilter
+//
+RegexPrefilter::RegexPrefilter()
+  : n_regex(0), always(NULL), lits(NULL), lit_regex(NULL), n_lits(0), n_cls(0),
+    delta(NULL), out_head(NULL), out_link(NULL), out_regex(NULL), out_next(NULL)
+{
+  memset(cls, 0, sizeof(cls));
+}
+
+RegexPrefilter::~RegexPrefilter()
+{
+  for (int i = 0; i < n_lits; i++) {
+    ats_free(lits[i]);
+  }
+  ats_free(lits);
+  ats_free(lit_regex);
+  ats_free(always);
+  ats_free(delta);
+  ats_free(out_head);
+  ats_free(out_link);
+  ats_free(out_regex);
+  ats_free(out_next);
+}
+
+// Skips the character class opening at p, returns what follows it or NULL
+static const char *
+skip_regex_class(const char *p)
+{
+  p++;
+  if (*p == '^')
+    p++;
+  if (*p == ']')
+    p++;
+  for (; *p; p++) {
+    if (*p == ']') {
+      return p + 1;
+    } else if (*p == '\\' && p[1]) {
+      p++;
+    } else if (*p == '[' && p[1] == ':') {
+      const char *e = strstr(p + 2, ":]");
+      if (!e)
+        return NULL;
+      p = e + 1;
+    }
+  }
+  return NULL;
+}
+
+// The length of the counted quantifier {n}, {n,} or {n,m} at p, else 0
+static int
+regex_counted_quantifier(const char *p)
+{
+  const char *q = p + 1;
+
+  if (!ParseRules::is_digit(*q))
+    return 0;
+  while (ParseRules::is_digit(*q))
+    q++;
+  if (*q == ',') {
+    q++;
+    while (ParseRules::is_digit(*q))
+      q++;
+  }
+  return *q == '}' ? q - p + 1 : 0;
+}
+
+int
+RegexPrefilter::required_literal(const char *pattern, char *lit)
+{
+  char *run = (char *)ats_malloc(strlen(pattern) + 1);
+  int n = 0, best = 0, q;
+  const char *p = pattern;
+
+#define KEEP_RUN()                              \
+  do {                                          \
+    if (n > best) {                             \
+      memcpy(lit, run, n);                      \
+      best = n;                                 \
+    }                                           \
+    n = 0;                                      \
+  } while (0)
+
+  while (*p) {
+    switch (*p) {
+    case '|':
+      // at the top level, any one side of it may match
+      best = n = 0;
+      goto Ldone;
+    case '(':
+      {
+        // a group is a single atom; inline options and assertions
+        //  may change what the rest of the pattern means
+        int depth = 0;
+
+        if (p[1] == '?' && p[2] != ':') {
+          best = n = 0;
+          goto Ldone;
+        }
+        KEEP_RUN();
+        do {
+          if (*p == '(') {
+            depth++;
+          } else if (*p == ')') {
+            depth--;
+          } else if (*p == '\\' && p[1]) {
+            p++;
+          } else if (*p == '[') {
+            if (!(p = skip_regex_class(p))) {
+              best = n = 0;
+              goto Ldone;
+            }
+            continue;
+          }
+          p++;
+        } while (depth && *p);
+        if (depth) {
+          best = n = 0;
+          goto Ldone;
+        }
+      }
+      continue;
+    case '[':
+      KEEP_RUN();
+      if (!(p = skip_regex_class(p))) {
+        best = n = 0;
+        goto Ldone;
+      }
+      continue;
+    case '\\':
+      if (!p[1]) {
+        best = n = 0;
+        goto Ldone;
+      }
+      if (ParseRules::is_alnum(p[1])) {
+        // character types and assertions end a run, anything else
+        //  (\x41, \Q...\E, back references) is not worth following
+        if (!strchr("dDwWsShHvVRNbBAzZG", p[1])) {
+          best = n = 0;
+          goto Ldone;
+        }
+        KEEP_RUN();
+      } else {
+        run[n++] = p[1];
+      }
+      p += 2;
+      continue;
+    case '.':
+    case '^':
+    case '$':
+    case ')':
+      KEEP_RUN();
+      break;
+    case '+':
+      // the atom before it is still required once
+      KEEP_RUN();
+      break;
+    case '{':
+      if (!(q = regex_counted_quantifier(p))) {
+        run[n++] = *p;
+        break;
+      }
+      if (n)
+        n--;
+      KEEP_RUN();
+      p += q;
+      continue;
+    case '?':
+    case '*':
+      // the atom before it is optional
+      if (n)
+        n--;
+      KEEP_RUN();
+      break;
+    default:
+      run[n++] = *p;
+      break;
+    }
+    p++;
+  }
+  KEEP_RUN();
+
+#undef KEEP_RUN
+
+Ldone:
+  ats_free(run);
+  return best;
+}
+
+void
+RegexPrefilter::add(int idx, const char *pattern)
+{
+  int len = strlen(pattern);
+  char *lit = (char *)ats_malloc(len + 1);
+
+  ink_assert(idx == n_regex);
+  n_regex = idx + 1;
+  always = (char *)ats_realloc(always, n_regex);
+
+  len = required_literal(pattern, lit);
+  if (len > 0) {
+    lit[len] = '\0';
+    always[idx] = 0;
+    lits = (char **)ats_realloc(lits, sizeof(char *) * (n_lits + 1));
+    lit_regex = (int *)ats_realloc(lit_regex, sizeof(int) * (n_lits + 1));
+    lits[n_lits] = lit;
+    lit_regex[n_lits] = idx;
+    n_lits++;
+  } else {
+    always[idx] = 1;
+    ats_free(lit);
+  }
+}
+
+void
+RegexPrefilter::compile()
+{
+  int max_states = 1, n_states = 1, n_out = 0;
+  int i, c;
+
+  if (!n_lits)
+    return;
+
+  // Only bytes that appear in some literal get their own input class
+  n_cls = 1;
+  for (i = 0; i < n_lits; i++) {
+    for (unsigned char *p = (unsigned char *)lits[i]; *p; p++) {
+      if (!cls[*p])
+        cls[*p] = n_cls++;
+    }
+    max_states += strlen(lits[i]);
+  }
+
+  delta = (int *)ats_malloc(sizeof(int) * max_states * n_cls);
+  memset(delta, -1, sizeof(int) * max_states * n_cls);
+  out_head = (int *)ats_malloc(sizeof(int) * max_states);
+  memset(out_head, -1, sizeof(int) * max_states);
+  out_link = (int *)ats_malloc(sizeof(int) * max_states);
+  out_regex = (int *)ats_malloc(sizeof(int) * n_lits);
+  out_next = (int *)ats_malloc(sizeof(int) * n_lits);
+
+  // The trie of the literals
+  for (i = 0; i < n_lits; i++) {
+    int s = 0;
+
+    for (unsigned char *p = (unsigned char *)lits[i]; *p; p++) {
+      int *t = &delta[s * n_cls + cls[*p]];
+      if (*t < 0)
+        *t = n_states++;
+      s = *t;
+    }
+    out_regex[n_out] = lit_regex[i];
+    out_next[n_out] = out_head[s];
+    out_head[s] = n_out++;
+  }
+
+  // Breadth first, fill in the failure transitions so every state has
+  //  one for each class, and link each state to the next one along its
+  //  failure chain with output
+  int *fail = (int *)ats_malloc(sizeof(int) * n_states);
+  int *queue = (int *)ats_malloc(sizeof(int) * n_states);
+  int head = 0, tail = 0;
+
+  fail[0] = 0;
+  out_link[0] = -1;
+  for (c = 0; c < n_cls; c++) {
+    int u = delta[c];
+    if (u < 0) {
+      delta[c] = 0;
+    } else {
+      fail[u] = 0;
+      out_link[u] = -1;
+      queue[tail++] = u;
+    }
+  }
+  while (head < tail) {
+    int r = queue[head++];
+
+    for (c = 0; c < n_cls; c++) {
+      int u = delta[r * n_cls + c];
+      int f = delta[fail[r] * n_cls + c];
+
+      if (u < 0) {
+        delta[r * n_cls + c] = f;
+      } else {
+        fail[u] = f;
+        out_link[u] = out_head[f] >= 0 ? f : out_link[f];
+        queue[tail++] = u;
+      }
+    }
+  }
+  ats_free(queue);
+  ats_free(fail);
+
+  Debug("matcher", "regex prefilter: %d of %d regexes with a literal, %d states, %d classes",
+        n_lits, n_regex, n_states, n_cls);
+}
+
+bool
+RegexPrefilter::scan(const char *str, int len, char *candidates) const
+{
+  if (!delta) {
+    memset(candidates, 1, n_regex);
+    return false;
+  }
+
+  int s = 0;
+
+  memcpy(candidates, always, n_regex);
+  for (int i = 0; i < len; i++) {
+    s = delta[s * n_cls + cls[(unsigned char)str[i]]];
+    for (int t = out_head[s] >= 0 ? s : out_link[s]; t >= 0; t = out_link[t]) {
+      for (int o = out_head[t]; o >= 0; o = out_next[o]) {
+        candidates[out_regex[o]] = 1;
+      }
+    }
+  }
+  return true;
+}
+
 /*************************************************************
  *   Begin class HostMatcher
  *************************************************************/
@@ -337,7 +681,8 @@ template<class Data, class Result> char *UrlMatcher<Data, Result>::NewEntry(matc
 //
 template<class Data, class Result> void UrlMatcher<Data, Result>::Match(RequestData * rdata, Result * result)
 {
-  char *url_str;
+  const char *url_str;
+  char *to_free;
   int *value;
   
   // Check to see there is any work to before we copy the
@@ -346,12 +691,12 @@ template<class Data, class Result> void UrlMatcher<Data, Result>::Match(RequestD
     return;
   }
 
-  url_str = rdata->get_string();
+  url_str = rdata->get_string_ref(&to_free);
 
   // Can't do a regex match with a NULL string so
   //  use an empty one instead
   if (url_str == NULL) {
-    url_str = ats_strdup("");
+    url_str = "";
   }
 
   if (ink_hash_table_lookup(url_ht, url_str, (void **)&value)) { 
@@ -359,14 +704,15 @@ template<class Data, class Result> void UrlMatcher<Data, Result>::Match(RequestD
     data_array[*value].UpdateMatch(result, rdata);
   }
 
-  ats_free(url_str);
+  ats_free(to_free);
 }
 
 //
 // RegexMatcher<Data,Result>::RegexMatcher()
 //
 template<class Data, class Result> RegexMatcher<Data, Result>::RegexMatcher(const char *name, const char *filename)
-  : re_array(NULL),
+  : dfa(NULL),
+    re_array(NULL),
     re_str(NULL),
     data_array(NULL),
     array_len(-1),
@@ -388,6 +734,20 @@ template<class Data, class Result> RegexMatcher<Data, Result>::~RegexMatcher()
   delete[]re_str;
   ats_free(re_array);
   delete[]data_array;
+  delete dfa;
+}
+
+//
+// void RegexMatcher<Data,Result>::Compile()
+//
+//   Called once all the entries are in
+//
+template<class Data, class Result> void RegexMatcher<Data, Result>::Compile()
+{
+  prefilter.compile();
+  if (dfa && num_el > 0) {
+    dfa->compile((const char **) re_str, num_el, RE_UNANCHORED);
+  }
 }
 
 //
@@ -468,6 +828,7 @@ template<class Data, class Result> char *RegexMatcher<Data, Result>::NewEntry(ma
   errBuf = cur_d->Init(line_info);
 
   if (errBuf == NULL) {
+    prefilter.add(num_el, re_str[num_el]);
     num_el++;
   } else {
     // There was a problem so undo the effects this function
@@ -483,13 +844,13 @@ template<class Data, class Result> char *RegexMatcher<Data, Result>::NewEntry(ma
 //
 // void RegexMatcher<Data,Result>::Match(RequestData* rdata, Result* result)
 //
-//   Coduncts a linear search through the regex array and
-//     updates arg result for each regex that matches arg URL
+//   Runs each regex the prefilter finds may match arg URL, in
+//     table order, and updates arg result for each one that does
 //
 template<class Data, class Result> void RegexMatcher<Data, Result>::Match(RequestData * rdata, Result * result)
 {
-  char *url_str;
-  int r;
+  const char *url_str;
+  char *to_free;
 
   // Check to see there is any work to before we copy the
   //   URL
@@ -497,23 +858,47 @@ template<class Data, class Result> void RegexMatcher<Data, Result>::Match(Reques
     return;
   }
 
-  url_str = rdata->get_string();
+  url_str = rdata->get_string_ref(&to_free);
 
   // Can't do a regex match with a NULL string so
   //  use an empty one instead
   if (url_str == NULL) {
-    url_str = ats_strdup("");
+    url_str = "";
   }
   // INKqa12980
   // The function unescapifyStr() is already called in
   // HttpRequestData::get_string(); therefore, no need to call again here.
   // unescapifyStr(url_str);
 
+  MatchString(url_str, rdata, result);
+  ats_free(to_free);
+}
+
+//
+// void RegexMatcher<Data,Result>::MatchString(const char* str, RequestData* rdata, Result* result)
+//
+template<class Data, class Result>
+void RegexMatcher<Data, Result>::MatchString(const char *str, RequestData * rdata, Result * result)
+{
+  int len = strlen(str);
+  char *candidates = (char *)alloca(num_el);
+  int r;
+
+  if (dfa) {
+    // The automaton finds exactly the lines that match, in one pass
+    dfa->match_all(str, len, candidates);
+  } else {
+    prefilter.scan(str, len, candidates);
+  }
+
   for (int i = 0; i < num_el; i++) {
+    if (!candidates[i]) {
+      continue;
+    }
 
-    r = pcre_exec(re_array[i], NULL, url_str, strlen(url_str), 0, 0, NULL, 0);
+    r = dfa ? 0 : pcre_exec(re_array[i], NULL, str, len, 0, 0, NULL, 0);
     if (r > -1) {
-      Debug("matcher", "%s Matched %s with regex at line %d", matcher_name, url_str, data_array[i].line_num);
+      Debug("matcher", "%s Matched %s with regex at line %d", matcher_name, str, data_array[i].line_num);
       data_array[i].UpdateMatch(result, rdata);
     } else if (r < -1) {
       // An error has occured
@@ -521,7 +906,6 @@ template<class Data, class Result> void RegexMatcher<Data, Result>::Match(Reques
     } // else it's -1 which means no match was found.
 
   }
-  ats_free(url_str);
 }
 
 //
@@ -531,18 +915,20 @@ template<class Data, class Result>
 HostRegexMatcher<Data, Result>::HostRegexMatcher(const char *name, const char *filename)
     : RegexMatcher <Data, Result>(name, filename)
 {
+  // Host names are short and the tables are matched for every request, so
+  //  all the regexes go through one automaton
+  this->dfa = NEW(new DFA);
 }
 
 //
 // void HostRegexMatcher<Data,Result>::Match(RequestData* rdata, Result* result)
 //
-//   Conducts a linear search through the regex array and
-//     updates arg result for each regex that matches arg host_regex
+//   Same as RegexMatcher<Data,Result>::Match(), against
+//     the host name
 //
 template<class Data, class Result> void HostRegexMatcher<Data, Result>::Match(RequestData * rdata, Result * result)
 {
   const char *url_str;
-  int r;
 
   // Check to see there is any work to before we copy the
   //   URL
@@ -557,17 +943,7 @@ template<class Data, class Result> void HostRegexMatcher<Data, Result>::Match(Re
   if (url_str == NULL) {
     url_str = "";
   }
-  for (int i = 0; i < this->num_el; i++) {
-    r = pcre_exec(this->re_array[i], NULL, url_str, strlen(url_str), 0, 0, NULL, 0);
-    if (r != -1) {
-      Debug("matcher", "%s Matched %s with regex at line %d",
-            const_cast<char*>(this->matcher_name), url_str, this->data_array[i].line_num);
-      this->data_array[i].UpdateMatch(result, rdata);
-    } else {
-      // An error has occured
-      Warning("error matching regex at line %d", this->data_array[i].line_num);
-    }
-  }
+  this->MatchString(url_str, rdata, result);
 }
 
 //
@@ -953,6 +1329,16 @@ template<class Data, class Result> int ControlMatcher<Data, Result>::BuildTableF
 
   ink_assert(second_pass == numEntries);
 
+  if (reMatch != NULL) {
+    reMatch->Compile();
+  }
+  if (hrMatch != NULL) {
+    hrMatch->Compile();
+  }
+  if (ipMatch != NULL) {
+    ipMatch->Compile();
+  }
+
   if (is_debug_tag_set("matcher")) {
     Print();
   }
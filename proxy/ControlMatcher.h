@@ -55,16 +55,18 @@
  *  -------------------------
  *
  *   regex table - implemented as a linear list of regular expressions to
- *       match against
+ *       match against.  A literal prefilter (class RegexPrefilter) picks
+ *       the regular expressions worth running for a given string in one
+ *       pass over it
  *
  *   host/domain table - The host domain table is logically implemented as
- *       tree, broken up at each partition in a hostname.  Three mechanism
- *       are used to move from one level to the next: a hash table, a fixed
- *       sized array and a constant time index (class charIndex).  The constant
- *       time index is only used to from the root domain to the first
- *       level partition (ie: .com). The fixed array is used for subsequent
- *       paritions until the fan out exceeds the arrays fixed size at which
- *       time, the fixed array is converted to a hash table
+ *       tree, broken up at each partition in a hostname.  Two mechanism
+ *       are used to move from one level to the next: a fixed sized array
+ *       and a compact character trie (class hostTrie).  The trie is used
+ *       from the root domain to the first level partition (ie: .com).
+ *       The fixed array is used for subsequent paritions until the fan
+ *       out exceeds the arrays fixed size at which time, the fixed array
+ *       is converted to a trie
  *
  *   ip table - supports ip ranges.  A single ip address is treated as
  *       a range with the same beginning and end address.  The table is
@@ -120,6 +122,12 @@ public:
   {
   }
   virtual char *get_string() = 0;
+  // The string from get_string(), which the caller must not modify.
+  //  If it has to be freed, *to_free is set to it, else to NULL
+  virtual const char *get_string_ref(char **to_free)
+  {
+    return *to_free = get_string();
+  }
   virtual const char *get_host() = 0;
   virtual sockaddr const* get_ip() = 0;
 
@@ -139,17 +147,29 @@ class HttpRequestData:public RequestData
 {
 public:
   inkcoreapi char *get_string();
+  inkcoreapi const char *get_string_ref(char **to_free);
   inkcoreapi const char *get_host();
   inkcoreapi sockaddr const* get_ip();
   inkcoreapi sockaddr const* get_client_ip();
 
   HttpRequestData()
-    : hdr(NULL), hostname_str(NULL), api_info(NULL), xact_start(0), incoming_port(0), tag(NULL)
+    : hdr(NULL), hostname_str(NULL), api_info(NULL), xact_start(0), incoming_port(0), tag(NULL),
+      arena(NULL), url_ref(NULL), url_ref_len(0), url_match(NULL)
   { 
     ink_zero(src_ip);
     ink_zero(dest_ip);
   }
 
+  // Sets the request, forgetting the URL string kept for the last one
+  void set_hdr(HTTPHdr *h, Arena *a)
+  {
+    hdr = h;
+    arena = a;
+    url_ref = NULL;
+    url_ref_len = 0;
+    url_match = NULL;
+  }
+
   HTTPHdr *hdr;
   char *hostname_str;
   _HttpApiInfo *api_info;
@@ -158,6 +178,57 @@ public:
   IpEndpoint dest_ip;
   uint16_t incoming_port;
   char *tag;
+
+  // With an arena, the unescaped URL is kept there and shared by every
+  //  table matched during the transaction, for as long as the URL string
+  //  in the header (url_ref) stays the same
+  Arena *arena;
+  const char *url_ref;
+  int url_ref_len;
+  char *url_match;
+};
+
+/**
+  Literal prefilter for a table of regular expressions.
+
+  Most regex lines carry a fixed string that anything they match has to
+  contain, such as "\.example\.com/" or "/images/".  Those strings are
+  compiled into one Aho-Corasick automaton, so that a single pass over the
+  URL finds every line worth running pcre_exec() for.  Lines without such a
+  string (alternations, inline options) are always run.
+*/
+class RegexPrefilter
+{
+public:
+  RegexPrefilter();
+  ~RegexPrefilter();
+
+  // Notes the literal of regex number idx; regexes are added in order
+  void add(int idx, const char *pattern);
+  // Builds the automaton once every regex is added
+  void compile();
+  // Sets candidates[i] for each regex i which may match str, returns
+  //  whether the prefilter ruled any out
+  bool scan(const char *str, int len, char *candidates) const;
+
+  // Copies the longest string any match of pattern must contain to lit,
+  //  which has room for the pattern, and returns its length
+  static int required_literal(const char *pattern, char *lit);
+
+private:
+  int n_regex;
+  char *always;                 // regexes without a literal
+  char **lits;                  // literal of each of lit_regex
+  int *lit_regex;
+  int n_lits;
+
+  unsigned char cls[256];       // byte to input class, 0 for bytes in no literal
+  int n_cls;
+  int *delta;                   // transitions, n_cls per state
+  int *out_head;                // first output of each state, or -1
+  int *out_link;                // next state along the failure chain with output
+  int *out_regex;               // output list entries
+  int *out_next;
 };
 
 
@@ -192,12 +263,17 @@ public:
   void Match(RequestData * rdata, Result * result);
   void AllocateSpace(int num_entries);
   char *NewEntry(matcher_line * line_info);
+  void Compile();
   void Print();
 
   int getNumElements() { return num_el; }
   Data *getDataArray() { return data_array; }
 
 protected:
+  void MatchString(const char *str, RequestData * rdata, Result * result);
+
+  RegexPrefilter prefilter;
+  DFA *dfa;                     // every regex in one automaton, if set matches instead of re_array
   pcre** re_array;              // array of compiled regexs
   char **re_str;                // array of uncompiled regex strings
   Data *data_array;             // data array.  Corresponds to re_array
@@ -243,6 +319,7 @@ public:
   void Match(sockaddr const* ip_addr, RequestData * rdata, Result * result);
   void AllocateSpace(int num_entries);
   char *NewEntry(matcher_line * line_info);
+  void Compile() { ip_map.freeze(); }
   void Print();
 
   int getNumElements() { return num_el; }
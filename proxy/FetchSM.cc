@@ -26,9 +26,12 @@
 #include <stdio.h>
 #include "HTTP.h"
 #include "PluginVC.h"
+#include "HttpAccept.h"
 
 #define DEBUG_TAG "FetchSM"
 
+extern HttpAccept *plugin_http_accept;
+
 ClassAllocator < FetchSM > FetchSMAllocator("FetchSMAllocator");
 void
 FetchSM::cleanUp()
@@ -54,9 +57,17 @@ FetchSM::httpConnect()
   Debug(DEBUG_TAG, "[%s] calling httpconnect write", __FUNCTION__);
   sockaddr_in addr;
   ats_ip4_set(&addr, _ip, _port);
-  http_vc = TSHttpConnect(ats_ip_sa_cast(&addr));
 
-  PluginVC *vc = (PluginVC *) http_vc;
+  // A direct core under our own lock: the request and response are
+  //   handed to and from the HttpSM without intermediate copies, and
+  //   neither side ever has to retry for the other's lock
+  PluginVCCore *pvc = PluginVCCore::alloc(true, mutex);
+  pvc->set_active_addr(ats_ip_sa_cast(&addr));
+  pvc->set_accept_cont(plugin_http_accept);
+
+  PluginVC *vc = pvc->connect();
+  vc->get_other_side()->set_is_internal_request(true);
+  http_vc = reinterpret_cast<TSVConn>(vc);
 
   read_vio = vc->do_io_read(this, INT64_MAX, resp_buffer);
   write_vio = vc->do_io_write(this, getReqLen(), req_reader);
@@ -766,6 +766,23 @@ ICPPeerReadCont::PeerReadStateMachine(PeerReadData * s, Event * e)
           break;                // move to next_state
         }
         //
+        // A cache digest chunk, keep it with the sending peer.
+        // There is no reply.
+        //
+        if (s->_rICPmsg->h.opcode == ICP_OP_DIGEST) {
+          Peer *p = _ICPpr->FindPeer(s->_sender);
+          if (p && p->RecvDigest(s->_rICPmsg)) {
+            ICP_INCREMENT_DYN_STAT(icp_digests_received_stat);
+            Debug("icp", "Received digest %u from [%s]",
+              s->_rICPmsg->h.requestno, ats_ip_nptop(&s->_sender, ipb, sizeof(ipb)));
+          }
+          s->_rICPmsg = NULL;
+          s->_buf = NULL;
+          s->_next_state = READ_NOT_ACTIVE;
+          RECORD_ICP_STATE_CHANGE(s, 0, READ_NOT_ACTIVE);
+          break;                // move to next_state
+        }
+        //
         // If this is a query message, redirect to
         // the query specific handlers.
         //
@@ -1293,6 +1310,11 @@ ICPRequestCont::ICPStateMachine(int event, void *d)
         // Generate ICP requests to peers
         int bias = _ICPpr->GetStartingSendPeerBias();
         int SendPeers = _ICPpr->GetSendPeers();
+        INK_MD5 md5;
+        bool use_digest = icp_digest_enabled && _url->valid();
+        if (use_digest) {
+          _url->MD5_get(&md5);
+        }
         npending_actions = 0;
         while (SendPeers > 0) {
           Peer *P = _ICPpr->GetNthSendPeer(SendPeers, bias);
@@ -1301,6 +1323,14 @@ ICPRequestCont::ICPStateMachine(int event, void *d)
             continue;
           }
           //
+          // Skip Peers whose cache digest says they do not have it
+          //
+          if (use_digest && !P->DigestMayContain(md5)) {
+            ICP_INCREMENT_DYN_STAT(icp_digest_skipped_queries_stat);
+            SendPeers--;
+            continue;
+          }
+          //
           // Send query request to Peers
           //
 
@@ -1650,6 +1680,17 @@ ICPRequestCont::NetToHostICPMsg(ICPMsg_t * in, ICPMsg_t * out)
       out->un.miss.URL = (char *)((char *) (&in->h.shostid) + sizeof(in->h.shostid));
       break;
     }
+  case ICP_OP_DIGEST:
+    {
+      char *chunk = (char *) (&in->h.shostid) + sizeof(in->h.shostid);
+      memcpy((char *) &out->un.digest.chunk, chunk, sizeof(out->un.digest.chunk));
+      out->un.digest.chunk.nbits = ntohl(out->un.digest.chunk.nbits);
+      out->un.digest.chunk.offset = ntohl(out->un.digest.chunk.offset);
+      out->un.digest.chunk.length = ntohl(out->un.digest.chunk.length);
+      out->un.digest.data = chunk + sizeof(out->un.digest.chunk);
+      out->un.digest.datalen = (int) out->h.msglen - (int) (sizeof(ICPMsgHdr_t) + sizeof(ICPDigestChunk_t));
+      break;
+    }
   case ICP_OP_HIT_OBJ:
     {
       out->un.hitobj.URL = (char *)((char *) (&in->h.shostid) + sizeof(in->h.shostid));
@@ -1715,6 +1756,21 @@ ICPRequestCont::BuildICPMsg(ICPopcode_t op, unsigned int seqno,
     iov[1].iov_len = datalen;
     icpmsg->h.msglen = htons(iov[0].iov_len + iov[1].iov_len);
 
+  } else if (op == ICP_OP_DIGEST) {
+    // data is the chunk header, in network byte order, and chunk data
+    icpmsg->un.digest.data = (char *) data;
+    icpmsg->un.digest.datalen = datalen;
+
+    mhdr->msg_iov = iov;
+    mhdr->msg_iovlen = 2;
+
+    iov[0].iov_base = (caddr_t) icpmsg;
+    iov[0].iov_len = sizeof(ICPMsgHdr_t);
+
+    iov[1].iov_base = (caddr_t) data;
+    iov[1].iov_len = datalen;
+    icpmsg->h.msglen = htons(iov[0].iov_len + iov[1].iov_len);
+
   } else {
     ink_release_assert(0);
     return 1;                   // failed
@@ -1840,7 +1896,7 @@ ICPProcessorExt icpProcessor(&icpProcessorInternal);
 ICPProcessor::ICPProcessor()
  : _l(0), _Initialized(0), _AllowIcpQueries(0),
    _PendingIcpQueries(0), _ICPConfig(0), _ICPPeriodic(0), _ICPHandler(0),
-   _mcastCB_handler(NULL), _PeriodicEvent(0), _ICPHandlerEvent(0),
+   _mcastCB_handler(NULL), _PeriodicEvent(0), _ICPHandlerEvent(0), _ICPDigest(0), _DigestEvent(0), _LocalDigestGen(0),
    _nPeerList(-1), _LocalPeer(0),
    _curSendPeer(0), _nSendPeerList(-1),
    _curRecvPeer(0), _nRecvPeerList(-1), _curParentPeer(0), _nParentPeerList(-1), _ValidPollData(0), _last_recv_peer_bias(0)
@@ -1850,6 +1906,7 @@ ICPProcessor::ICPProcessor()
   memset((void *)_RecvPeerList, 0, sizeof(_RecvPeerList[RECV_PEER_LIST_SIZE]));
   memset((void *)_ParentPeerList, 0, sizeof(_ParentPeerList[PARENT_PEER_LIST_SIZE]));
   memset((void *)_PeerIDtoPollIndex, 0, sizeof(_PeerIDtoPollIndex[PEER_ID_POLL_INDEX_SIZE]));
+  _LocalDigest[0] = _LocalDigest[1] = NULL;
 }
 
 ICPProcessor::~ICPProcessor()
@@ -1865,6 +1922,12 @@ ICPProcessor::~ICPProcessor()
     _ICPHandlerEvent->cancel();
     Mutex_unlock(_ICPHandler->mutex, this_ethread());
   }
+
+  if (_ICPDigest) {
+    MUTEX_TAKE_LOCK(_ICPDigest->mutex, this_ethread());
+    _DigestEvent->cancel();
+    Mutex_unlock(_ICPDigest->mutex, this_ethread());
+  }
 }
 
 void
@@ -1930,6 +1993,20 @@ ICPProcessor::start()
   _ICPHandlerEvent = eventProcessor.schedule_every(_ICPHandler,
                                                    HRTIME_MSECONDS(ICPHandlerCont::ICP_HANDLER_INTERVAL), ET_ICP);
   //
+  // Start cache digest publisher
+  //
+  ICP_EstablishStaticConfigInteger(icp_digest_enabled, "proxy.config.icp.digest.enabled");
+  ICP_EstablishStaticConfigInteger(icp_digest_bits, "proxy.config.icp.digest.bits");
+  ICP_EstablishStaticConfigInteger(icp_digest_interval, "proxy.config.icp.digest.interval");
+  ICP_EstablishStaticConfigInteger(icp_digest_rotate, "proxy.config.icp.digest.rotate");
+  if (icp_digest_enabled && _ICPConfig->globalConfig()->ICPconfigured()) {
+    _LocalDigest[0] = NEW(new ICPDigest(icp_digest_bits));
+    _LocalDigest[1] = NEW(new ICPDigest(icp_digest_bits));
+    _ICPDigest = NEW(new ICPDigestCont(this));
+    _DigestEvent = eventProcessor.schedule_every(_ICPDigest,
+                                                 HRTIME_MSECONDS(ICPDigestCont::DIGEST_CHECK_INTERVAL), ET_ICP);
+  }
+  //
   // Stale lookup data initializations
   //
   if (!gclient_request.valid()) {
@@ -75,7 +75,7 @@ typedef enum
   ICP_OP_MISS,                  // 03
   ICP_OP_ERR,                   // 04
   //
-  ICP_OP_UNUSED5,               // 05 unused
+  ICP_OP_DIGEST,                // 05 cache digest chunk (local extension)
   ICP_OP_UNUSED6,               // 06 unused
   ICP_OP_UNUSED7,               // 07 unused
   ICP_OP_UNUSED8,               // 08 unused
@@ -115,6 +115,7 @@ typedef enum
 //--------------------------
 #define ICP_FLAG_HIT_OBJ 	0x80000000ul
 #define ICP_FLAG_SRC_RTT 	0x40000000ul
+#define ICP_FLAG_DIGEST_ZLIB	0x00000001ul    // ICP_OP_DIGEST, filter is compressed
 
 //-----------------
 // ICP Constants
@@ -124,6 +125,8 @@ typedef enum
 #define MAX_ICP_QUERY_PAYLOAD_SIZE (MAX_ICP_MSG_PAYLOAD_SIZE - sizeof(uint32_t))
 #define MAX_DEFINED_PEERS	   64
 #define MSG_IOVECS 16
+#define ICP_DIGEST_HASHES	   4
+#define ICP_DIGEST_CHUNK_SIZE	   (8 * 1024)
 
 //------------
 // ICP Data
@@ -169,6 +172,26 @@ typedef struct ICPHitObj
   char *data;                   // object data
 } ICPHitObj_t;
 
+//--------------------------------------------------------------
+// ICP Digest
+//   One chunk of the sender's cache digest. The chunk header is
+//   followed by up to ICP_DIGEST_CHUNK_SIZE bytes of the encoded
+//   filter; requestno carries the sequence number of the digest.
+//--------------------------------------------------------------
+typedef struct ICPDigestChunk
+{
+  uint32_t nbits;               // bits in the filter
+  uint32_t offset;              // of this chunk in the encoded filter
+  uint32_t length;              // of the encoded filter
+} ICPDigestChunk_t;
+
+typedef struct ICPDigestMsg
+{
+  ICPDigestChunk_t chunk;       // decoded chunk header
+  char *data;                   // chunk data
+  int datalen;
+} ICPDigestMsg_t;
+
 //------------------------
 // ICP message descriptor
 //------------------------
@@ -182,6 +205,7 @@ typedef struct ICPMsg
     ICPHit_t hit;
     ICPMiss_t miss;
     ICPHitObj_t hitobj;
+    ICPDigestMsg_t digest;
   } un;
 } ICPMsg_t;
 
@@ -195,6 +219,28 @@ class ICPPeriodicCont;
 class ICPHandlerCont;
 class ICPPeerReadCont;
 class ICPRequestCont;
+class ICPDigestCont;
+
+//-------------------------------------------------------------------
+// ICPDigest -- Bloom filter over cache keys (URL MD5s).
+//   The filter is kept in wire order, bit n is bit (n & 7) of byte
+//   (n >> 3), and the bit positions are taken from the MD5 bytes so
+//   that peers of either byte order agree.
+//-------------------------------------------------------------------
+class ICPDigest
+{
+public:
+  ICPDigest(int nbits);
+  ~ICPDigest();
+  void clear();
+  void add(INK_MD5 const &);
+  bool may_contain(INK_MD5 const &) const;
+
+  int nbits;
+  int nbytes;
+  uint8_t *bits;
+  ink_hrtime received;          // when a peer's digest was completed
+};
 
 typedef enum
 {
@@ -502,9 +548,7 @@ class Peer:public RefCountObj
 {
 public:
   Peer(PeerType_t, ICPProcessor *, bool dynamic_peer = false);
-  virtual ~ Peer()
-  {
-  }
+  virtual ~ Peer();
   void LogRecvMsg(ICPMsg_t *, int);
 
   // Pure virtual functions
@@ -564,6 +608,8 @@ public:
   {
     return (_state & PEER_UP);
   }
+  bool RecvDigest(ICPMsg_t *);
+  bool DigestMayContain(INK_MD5 const &);
 
   // these shouldn't be public
   // this is for delayed I/O
@@ -598,6 +644,16 @@ protected:
     int total_received;
     int dropped_replies;        // arrived after timeout
   } _stats;
+
+  //----------------------------------
+  // Cache digest sent by this Peer
+  //----------------------------------
+  ICPDigest *volatile _digest;  // last complete digest
+  char *_digest_buf;            // encoded digest being received
+  uint32_t _digest_seqno;
+  uint32_t _digest_flags;
+  ICPDigestChunk_t _digest_chunk;
+  uint32_t _digest_received;    // bytes of _digest_buf filled
 };
 
 //------------------------------------------------
@@ -749,6 +805,7 @@ class ICPProcessor
   friend class ICPHandlerCont;  // Incoming msg periodic handler
   friend class ICPPeerReadCont; // Incoming ICP request handler
   friend class ICPRequestCont;  // Outgoing ICP request handler
+  friend class ICPDigestCont;   // Cache digest publisher
 
 public:
     ICPProcessor();
@@ -757,6 +814,7 @@ public:
   // Exported interfaces for other subsystems
   void start();
   Action *ICPQuery(Continuation *, URL *);
+  void DigestAdd(URL *);
 
   // Exported interfaces to other ICP classes
   typedef enum
@@ -918,6 +976,12 @@ private:
   ICPHandlerCont *_mcastCB_handler;
   Event *_PeriodicEvent;
   Event *_ICPHandlerEvent;
+  ICPDigestCont *_ICPDigest;
+  Event *_DigestEvent;
+
+  // Local cache digest, two generations so that old keys age out
+  ICPDigest *_LocalDigest[2];
+  volatile int _LocalDigestGen;
 
   enum
   {
@@ -1038,6 +1102,32 @@ public:
   static int64_t ICPDataBuf_IOBuffer_sizeindex;
 };
 
+//-----------------------------------------------------------------
+// ICPDigestCont -- Periodically publish the local cache digest
+//                  to the send peers.
+//-----------------------------------------------------------------
+class ICPDigestCont:public PeriodicCont
+{
+public:
+  enum
+  { DIGEST_CHECK_INTERVAL = 1000 };
+    ICPDigestCont(ICPProcessor *);
+   ~ICPDigestCont();
+  virtual int PeriodicEvent(int, Event *);
+
+private:
+  void Publish();
+
+  ink_hrtime _last_publish;
+  ink_hrtime _last_rotate;
+  uint32_t _seqno;
+  char *_encoded;               // filter as sent, possibly compressed
+  char *_chunk;                 // chunk header and data
+  ICPMsg_t _ICPmsg;
+  struct msghdr _mhdr;
+  struct iovec _iov[MSG_IOVECS];
+};
+
 //------------------------------------------------------------------
 // ICPPeerReadCont -- ICP incoming message processing state machine
 //------------------------------------------------------------------
@@ -1279,9 +1369,18 @@ enum
   icp_reload_read_aborts,
   icp_reload_write_aborts,
   icp_reload_successes,
+  icp_digests_sent_stat,
+  icp_digests_received_stat,
+  icp_digest_skipped_queries_stat,
   icp_stat_count
 };
 
+// Cache digest configuration
+extern int icp_digest_enabled;
+extern int icp_digest_bits;
+extern int icp_digest_interval;
+extern int icp_digest_rotate;
+
 #define ICP_EstablishStaticConfigInteger(_ix,_n) \
   	REC_EstablishStaticConfigInt32(_ix,_n)
 
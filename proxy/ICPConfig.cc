@@ -803,13 +803,15 @@ ICPConfiguration::icp_config_change_callback(void *data, void *value, int startu
 // Class Peer member functions (abstract base class)
 //-------------------------------------------------------
 Peer::Peer(PeerType_t t, ICPProcessor * icpPr, bool dynamic_peer):
-buf(NULL), notFirstRead(0), readAction(NULL), writeAction(NULL), _type(t), _next(0), _ICPpr(icpPr), _state(PEER_UP)
+buf(NULL), notFirstRead(0), readAction(NULL), writeAction(NULL), _type(t), _next(0), _ICPpr(icpPr), _state(PEER_UP),
+_digest(NULL), _digest_buf(NULL), _digest_seqno(0), _digest_flags(0), _digest_received(0)
 {
   notFirstRead = 0;
   if (dynamic_peer) {
     _state |= PEER_DYNAMIC;
   }
   memset((void *) &this->_stats, 0, sizeof(this->_stats));
+  ink_zero(_digest_chunk);
   ink_zero(fromaddr);
   fromaddrlen = sizeof(fromaddr);
   _id = 0;
@@ -0,0 +1,336 @@
+/** @file
+
+  ICP cache digests
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+
+/****************************************************************************
+
+  ICPDigest.cc
+
+  Each node keeps a Bloom filter of the URLs it has cached or served
+  from cache and periodically sends it, in chunks, to its send peers.
+  A node holding a recent digest from a peer only queries that peer
+  when the digest says the peer may have the object.
+
+  The cache directory only holds partial keys, so the filter is fed
+  from cache writes and hits as they happen. It is kept in two
+  generations, the older one is cleared every rotate period and the
+  published digest is the union of both, so keys of objects which
+  have not been seen for one to two periods age out.
+
+****************************************************************************/
+
+#include "Main.h"
+#include "P_EventSystem.h"
+#include "P_Cache.h"
+#include "ICP.h"
+#if TS_HAS_LIBZ
+#include <zlib.h>
+#endif
+
+int icp_digest_enabled = 0;
+int icp_digest_bits = 1 << 20;
+int icp_digest_interval = 60;
+int icp_digest_rotate = 3600;
+
+#define ICP_DIGEST_MAX_BITS (1 << 28)
+
+static inline uint32_t
+digest_position(INK_MD5 const &md5, int i, int nbits)
+{
+  const uint8_t *b = &md5.u8[i * 4];
+  return (((uint32_t) b[0] << 24) | ((uint32_t) b[1] << 16) | ((uint32_t) b[2] << 8) | b[3]) % nbits;
+}
+
+static inline uint32_t
+digest_max_encoded(int nbytes)
+{
+#if TS_HAS_LIBZ
+  return compressBound(nbytes);
+#else
+  return nbytes;
+#endif
+}
+
+//---------------------------------------------------------------
+// Class ICPDigest member functions
+//---------------------------------------------------------------
+ICPDigest::ICPDigest(int n)
+{
+  nbytes = (n + 7) >> 3;
+  if (nbytes < 1)
+    nbytes = 1;
+  nbits = nbytes << 3;
+  bits = (uint8_t *) ats_malloc(nbytes);
+  received = 0;
+  clear();
+}
+
+ICPDigest::~ICPDigest()
+{
+  ats_free(bits);
+}
+
+void
+ICPDigest::clear()
+{
+  memset(bits, 0, nbytes);
+}
+
+void
+ICPDigest::add(INK_MD5 const &md5)
+{
+  for (int i = 0; i < ICP_DIGEST_HASHES; i++) {
+    uint32_t n = digest_position(md5, i, nbits);
+    volatile uint8_t *b = &bits[n >> 3];
+    uint8_t mask = 1 << (n & 7), old;
+
+    // several threads add keys, do not lose a neighbouring bit
+    while (!((old = *b) & mask) && !ink_atomic_cas(b, old, (uint8_t) (old | mask)))
+      ;
+  }
+}
+
+bool
+ICPDigest::may_contain(INK_MD5 const &md5) const
+{
+  for (int i = 0; i < ICP_DIGEST_HASHES; i++) {
+    uint32_t n = digest_position(md5, i, nbits);
+    if (!(bits[n >> 3] & (1 << (n & 7))))
+      return false;
+  }
+  return true;
+}
+
+//---------------------------------------------------------------
+// Class Peer cache digest member functions
+//---------------------------------------------------------------
+Peer::~Peer()
+{
+  delete _digest;
+  ats_free(_digest_buf);
+}
+
+bool
+Peer::RecvDigest(ICPMsg_t * m)
+{
+  // Note: ICPMsg_t (m) is in native byte order
+  ICPDigestMsg_t *d = &m->un.digest;
+  ICPDigestChunk_t *c = &d->chunk;
+
+  if (!c->nbits || (c->nbits > ICP_DIGEST_MAX_BITS) || !c->length ||
+      (c->length > digest_max_encoded((c->nbits + 7) >> 3)) ||
+      (d->datalen <= 0) || (c->offset > c->length) || ((uint32_t) d->datalen > c->length - c->offset)) {
+    Debug("icp_warn", "Invalid digest chunk, nbits=%u offset=%u length=%u datalen=%d",
+          c->nbits, c->offset, c->length, d->datalen);
+    return false;
+  }
+  // A chunk of a new digest discards what is left of the previous one
+  if (!_digest_buf || (m->h.requestno != _digest_seqno) || (c->nbits != _digest_chunk.nbits) ||
+      (c->length != _digest_chunk.length)) {
+    _digest_buf = (char *) ats_realloc(_digest_buf, c->length);
+    _digest_seqno = m->h.requestno;
+    _digest_flags = m->h.optionflags;
+    _digest_chunk = *c;
+    _digest_received = 0;
+  }
+  memcpy(_digest_buf + c->offset, d->data, d->datalen);
+  _digest_received += d->datalen;
+  if (_digest_received < _digest_chunk.length)
+    return false;
+  _digest_received = 0;
+
+  ICPDigest *digest = NEW(new ICPDigest(_digest_chunk.nbits));
+  bool valid = false;
+
+  if (_digest_flags & ICP_FLAG_DIGEST_ZLIB) {
+#if TS_HAS_LIBZ
+    uLongf len = digest->nbytes;
+    valid = (uncompress((Bytef *) digest->bits, &len, (Bytef *) _digest_buf, _digest_chunk.length) == Z_OK) &&
+      ((int) len == digest->nbytes);
+#endif
+  } else if ((int) _digest_chunk.length == digest->nbytes) {
+    memcpy(digest->bits, _digest_buf, digest->nbytes);
+    valid = true;
+  }
+  if (!valid) {
+    ip_port_text_buffer ipb;
+    Debug("icp_warn", "Unable to decode digest from [%s]", ats_ip_nptop(GetIP(), ipb, sizeof(ipb)));
+    delete digest;
+    return false;
+  }
+  digest->received = ink_get_hrtime();
+
+  // Queries on other threads may be looking at the old digest
+  ICPDigest *old = _digest;
+  _digest = digest;
+  if (old)
+    new_Deleter(old, HRTIME_SECONDS(60));
+  return true;
+}
+
+bool
+Peer::DigestMayContain(INK_MD5 const &md5)
+{
+  ICPDigest *digest = _digest;
+
+  // Without a recent digest from this peer, query it
+  if (!digest || (ink_get_hrtime() - digest->received > HRTIME_SECONDS(3 * icp_digest_interval)))
+    return true;
+  return digest->may_contain(md5);
+}
+
+//---------------------------------------------------------------
+// Class ICPProcessor cache digest member functions
+//---------------------------------------------------------------
+void
+ICPProcessor::DigestAdd(URL * url)
+{
+  if (!_LocalDigest[0] || !url->valid())
+    return;
+
+  INK_MD5 md5;
+  url->MD5_get(&md5);
+  _LocalDigest[_LocalDigestGen]->add(md5);
+}
+
+//---------------------------------------------------------------
+// Class ICPDigestCont member functions
+//---------------------------------------------------------------
+typedef int (ICPDigestCont::*ICPDigestContHandler) (int, void *);
+
+ICPDigestCont::ICPDigestCont(ICPProcessor * icpP)
+:PeriodicCont(icpP), _last_publish(0), _seqno(0)
+{
+  int nbytes = _ICPpr->_LocalDigest[0]->nbytes;
+
+  _last_rotate = ink_get_hrtime();
+  _encoded = (char *) ats_malloc(digest_max_encoded(nbytes) + nbytes);
+  _chunk = (char *) ats_malloc(sizeof(ICPDigestChunk_t) + ICP_DIGEST_CHUNK_SIZE);
+  SET_HANDLER((ICPDigestContHandler) & ICPDigestCont::PeriodicEvent);
+}
+
+ICPDigestCont::~ICPDigestCont()
+{
+  ats_free(_encoded);
+  ats_free(_chunk);
+}
+
+int
+ICPDigestCont::PeriodicEvent(int event, Event * /* e ATS_UNUSED */)
+{
+  switch (event) {
+  case EVENT_POLL:
+  case EVENT_INTERVAL:
+    {
+      ink_hrtime now = ink_get_hrtime();
+
+      if (now - _last_rotate >= HRTIME_SECONDS(icp_digest_rotate)) {
+        // clear the older generation and start adding to it
+        int old = !_ICPpr->_LocalDigestGen;
+        _ICPpr->_LocalDigest[old]->clear();
+        _ICPpr->_LocalDigestGen = old;
+        _last_rotate = now;
+      }
+      if (now - _last_publish >= HRTIME_SECONDS(icp_digest_interval)) {
+        if (!_ICPpr->Lock())
+          break;                // reconfiguration in progress, retry later
+        bool active = _ICPpr->GetConfig()->globalConfig()->ICPconfigured() && _ICPpr->AllowICPQueries();
+        _ICPpr->Unlock();
+
+        if (active) {
+          Publish();
+          _last_publish = now;
+        }
+      }
+      break;
+    }
+  case NET_EVENT_DATAGRAM_WRITE_COMPLETE:
+  case NET_EVENT_DATAGRAM_WRITE_ERROR:
+    {
+      // sends complete immediately, nothing to do
+      return EVENT_DONE;
+    }
+  default:
+    {
+      ink_release_assert(!"unexpected event");
+      break;
+    }
+  }                             // End of switch
+  return EVENT_CONT;
+}
+
+void
+ICPDigestCont::Publish()
+{
+  ICPDigest *cur = _ICPpr->_LocalDigest[_ICPpr->_LocalDigestGen];
+  ICPDigest *prev = _ICPpr->_LocalDigest[!_ICPpr->_LocalDigestGen];
+  int nbytes = cur->nbytes;
+  uint32_t max_encoded = digest_max_encoded(nbytes);
+  char *raw = _encoded + max_encoded;
+
+  for (int i = 0; i < nbytes; i++)
+    raw[i] = cur->bits[i] | prev->bits[i];
+
+  char *out = raw;
+  uint32_t length = nbytes;
+  int flags = 0;
+#if TS_HAS_LIBZ
+  uLongf zlen = max_encoded;
+  if ((compress2((Bytef *) _encoded, &zlen, (Bytef *) raw, nbytes, Z_BEST_SPEED) == Z_OK) && (zlen < (uLongf) nbytes)) {
+    out = _encoded;
+    length = zlen;
+    flags = ICP_FLAG_DIGEST_ZLIB;
+  }
+#endif
+
+  ++_seqno;
+  int npeers = _ICPpr->GetSendPeers();
+  for (uint32_t offset = 0; offset < length; offset += ICP_DIGEST_CHUNK_SIZE) {
+    uint32_t n = length - offset;
+    if (n > ICP_DIGEST_CHUNK_SIZE)
+      n = ICP_DIGEST_CHUNK_SIZE;
+
+    ICPDigestChunk_t *c = (ICPDigestChunk_t *) _chunk;
+    c->nbits = htonl(cur->nbits);
+    c->offset = htonl(offset);
+    c->length = htonl(length);
+    memcpy(_chunk + sizeof(ICPDigestChunk_t), out + offset, n);
+
+    int status = ICPRequestCont::BuildICPMsg(ICP_OP_DIGEST, _seqno, flags, 0 /* optdata */ , 0 /* shostid */ ,
+                                             (void *) _chunk, sizeof(ICPDigestChunk_t) + n,
+                                             &_mhdr, _iov, &_ICPmsg);
+    ink_assert(status == 0);
+
+    // Digests are not logged as sends, peers which do not reply
+    // to them must not be marked down.
+    for (int i = 0; i < npeers; i++) {
+      Peer *P = _ICPpr->GetNthSendPeer(i, 0);
+      if (P->IsOnline())
+        P->SendMsg_re(this, P, &_mhdr, NULL);
+    }
+  }
+  ICP_INCREMENT_DYN_STAT(icp_digests_sent_stat);
+  Debug("icp", "Published digest %u, %d bits in %u bytes to %d peers", _seqno, cur->nbits, length, npeers);
+}
+
+// End of ICPDigest.cc
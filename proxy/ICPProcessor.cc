@@ -56,4 +56,10 @@ ICPProcessorExt::ICPQuery(Continuation * c, URL * url)
   return _ICPpr->ICPQuery(c, url);
 }
 
+void
+ICPProcessorExt::DigestAdd(URL * url)
+{
+  _ICPpr->DigestAdd(url);
+}
+
 // End of ICPProcessor.cc
@@ -58,6 +58,12 @@ class ICPProcessor;
 //          Invokes continuation handleEvent(ICPreturn_t, struct sockaddr_in *)
 //          where ICPreturn_t is ICP_LOOKUP_FOUND or ICP_LOOKUP_FAILED and
 //          struct sockaddr_in (ip,port) is host containing URL data.
+//
+//      void     icpProcessor.DigestAdd(URL *)
+//        Note that URL is in the local cache, for the cache digest
+//        published to peers.
+//        Returns:
+//          None.
 //***************************************************************************
 class ICPProcessorExt
 {
@@ -68,6 +74,7 @@ public:
   // Exported interfaces
   void start();
   Action *ICPQuery(Continuation *, URL *);
+  void DigestAdd(URL *);
 
 private:
     ICPProcessor * _ICPpr;
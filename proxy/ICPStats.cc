@@ -119,6 +119,15 @@ ICPProcessor::InitICPStatCallbacks()
   RecRegisterRawStat(icp_rsb, RECT_PROCESS,
                      "proxy.process.icp.total_icp_request_time",
                      RECD_FLOAT, RECP_NULL, (int) total_icp_request_time_stat, RecRawStatSyncMHrTimeAvg);
+  RecRegisterRawStat(icp_rsb, RECT_PROCESS,
+                     "proxy.process.icp.digests_sent",
+                     RECD_INT, RECP_NULL, (int) icp_digests_sent_stat, RecRawStatSyncCount);
+  RecRegisterRawStat(icp_rsb, RECT_PROCESS,
+                     "proxy.process.icp.digests_received",
+                     RECD_INT, RECP_NULL, (int) icp_digests_received_stat, RecRawStatSyncCount);
+  RecRegisterRawStat(icp_rsb, RECT_PROCESS,
+                     "proxy.process.icp.digest_skipped_queries",
+                     RECD_INT, RECP_NULL, (int) icp_digest_skipped_queries_stat, RecRawStatSyncCount);
 
 }
 
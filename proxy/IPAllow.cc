@@ -304,6 +304,7 @@ IpAllow::BuildTable()
     ) {
       spot->setData(&_acls[reinterpret_cast<size_t>(spot->data())]);
     }
+    _map.freeze();
   }
 
   if (is_debug_tag_set("ip-allow")) {
@@ -64,6 +64,7 @@
 #include "I_RecDefs.h"
 #include "I_RecCore.h"
 #include "HttpProxyServerMain.h"
+#include "Transform.h"
 
 
 /****************************************************************
@@ -359,6 +360,7 @@ tsapi int TS_HTTP_LEN_TRACE;
 
 tsapi const char * TS_NPN_PROTOCOL_HTTP_1_0 = "http/1.0";
 tsapi const char * TS_NPN_PROTOCOL_HTTP_1_1 = "http/1.1";
+tsapi const char * TS_NPN_PROTOCOL_HTTP_2_0 = "h2";       // RFC 7540
 tsapi const char * TS_NPN_PROTOCOL_SPDY_1   = "spdy/1";   // obsolete
 tsapi const char * TS_NPN_PROTOCOL_SPDY_2   = "spdy/2";   // shipping
 tsapi const char * TS_NPN_PROTOCOL_SPDY_3   = "spdy/3";   // upcoming
@@ -921,13 +923,13 @@ FileImpl::fgets(char *buf, int length)
 
 INKContInternal::INKContInternal()
   : DummyVConnection(NULL), mdata(NULL), m_event_func(NULL), m_event_count(0), m_closed(1), m_deletable(0),
-    m_deleted(0), m_free_magic(INKCONT_INTERN_MAGIC_ALIVE)
+    m_deleted(0), m_free_magic(INKCONT_INTERN_MAGIC_ALIVE), m_plugin(NULL)
 { }
 
 INKContInternal::INKContInternal(TSEventFunc funcp, TSMutex mutexp)
   : DummyVConnection((ProxyMutex *) mutexp),
     mdata(NULL), m_event_func(funcp), m_event_count(0), m_closed(1), m_deletable(0), m_deleted(0),
-    m_free_magic(INKCONT_INTERN_MAGIC_ALIVE)
+    m_free_magic(INKCONT_INTERN_MAGIC_ALIVE), m_plugin(plugin_hook_current)
 {
   SET_HANDLER(&INKContInternal::handle_event);
 }
@@ -939,6 +941,7 @@ INKContInternal::init(TSEventFunc funcp, TSMutex mutexp)
 
   mutex = (ProxyMutex *) mutexp;
   m_event_func = funcp;
+  m_plugin = plugin_hook_current;
 }
 
 void
@@ -990,6 +993,7 @@ INKContInternal::handle_event(int event, void *edata)
       INKContAllocator.free(this);
     }
   } else {
+    PluginHookScope scope(m_plugin);
     return m_event_func((TSCont) this, (TSEvent) event, edata);
   }
   return EVENT_DONE;
@@ -1003,13 +1007,13 @@ INKContInternal::handle_event(int event, void *edata)
 ////////////////////////////////////////////////////////////////////
 
 INKVConnInternal::INKVConnInternal()
-:INKContInternal(), m_read_vio(), m_write_vio(), m_output_vc(NULL)
+:INKContInternal(), m_read_vio(), m_write_vio(), m_output_vc(NULL), m_event_type(ET_NET), m_task_events(0)
 {
   m_closed = 0;
 }
 
 INKVConnInternal::INKVConnInternal(TSEventFunc funcp, TSMutex mutexp)
-:INKContInternal(funcp, mutexp), m_read_vio(), m_write_vio(), m_output_vc(NULL)
+:INKContInternal(funcp, mutexp), m_read_vio(), m_write_vio(), m_output_vc(NULL), m_event_type(ET_NET), m_task_events(0)
 {
   m_closed = 0;
   SET_HANDLER(&INKVConnInternal::handle_event);
@@ -1019,6 +1023,8 @@ void
 INKVConnInternal::init(TSEventFunc funcp, TSMutex mutexp)
 {
   INKContInternal::init(funcp, mutexp);
+  m_event_type = ET_NET;
+  m_task_events = 0;
   SET_HANDLER(&INKVConnInternal::handle_event);
 }
 
@@ -1037,6 +1043,11 @@ INKVConnInternal::destroy()
 int
 INKVConnInternal::handle_event(int event, void *edata)
 {
+  if (m_task_events > 0 && this_ethread()->is_event_type(m_event_type)) {
+    ink_atomic_increment((int *) &m_task_events, -1);
+    transformProcessor.task_slot_release();
+  }
+
   handle_event_count(event);
   if (m_deleted) {
     if (m_deletable) {
@@ -1046,6 +1057,7 @@ INKVConnInternal::handle_event(int event, void *edata)
       INKVConnAllocator.free(this);
     }
   } else {
+    PluginHookScope scope(m_plugin);
     return m_event_func((TSCont) this, (TSEvent) event, edata);
   }
   return EVENT_DONE;
@@ -1064,7 +1076,7 @@ INKVConnInternal::do_io_read(Continuation *c, int64_t nbytes, MIOBuffer *buf)
   if (ink_atomic_increment((int *) &m_event_count, 1) < 0) {
     ink_assert(!"not reached");
   }
-  eventProcessor.schedule_imm(this, ET_NET);
+  schedule_imm_event();
 
   return &m_read_vio;
 }
@@ -1084,7 +1096,7 @@ INKVConnInternal::do_io_write(Continuation *c, int64_t nbytes, IOBufferReader *b
     if (ink_atomic_increment((int *) &m_event_count, 1) < 0) {
       ink_assert(!"not reached");
     }
-    eventProcessor.schedule_imm(this, ET_NET);
+    schedule_imm_event();
   }
 
   return &m_write_vio;
@@ -1122,7 +1134,7 @@ INKVConnInternal::do_io_close(int error)
     m_output_vc->do_io_close(error);
   }
 
-  eventProcessor.schedule_imm(this, ET_NET);
+  schedule_imm_event();
 }
 
 void
@@ -1141,7 +1153,7 @@ INKVConnInternal::do_io_shutdown(ShutdownHowTo_t howto)
   if (ink_atomic_increment((int *) &m_event_count, 1) < 0) {
     ink_assert(!"not reached");
   }
-  eventProcessor.schedule_imm(this, ET_NET);
+  schedule_imm_event();
 }
 
 void
@@ -1150,7 +1162,23 @@ INKVConnInternal::reenable(VIO */* vio ATS_UNUSED */)
   if (ink_atomic_increment((int *) &m_event_count, 1) < 0) {
     ink_assert(!"not reached");
   }
-  eventProcessor.schedule_imm(this, ET_NET);
+  schedule_imm_event();
+}
+
+// Events of a VConnection bound to the task threads are queued there
+// while a transformProcessor task slot is free, and otherwise handled
+// on a net thread. The output side of a transform is reenabled through
+// its TransformTerminus, which always schedules on ET_NET, so the
+// produced blocks go back to the net threads either way.
+void
+INKVConnInternal::schedule_imm_event()
+{
+  if (m_event_type != ET_NET && transformProcessor.task_slot_acquire()) {
+    ink_atomic_increment((int *) &m_task_events, 1);
+    eventProcessor.schedule_imm(this, m_event_type);
+  } else {
+    eventProcessor.schedule_imm(this, ET_NET);
+  }
 }
 
 void
@@ -1212,6 +1240,12 @@ APIHook::invoke(int event, void *edata)
   return m_cont->handleEvent(event, edata);
 }
 
+TSEvent
+APIHook::invoke_fast(TSHttpTxn txnp, TSHttpHookID id)
+{
+  return m_fast_func(txnp, id, m_fast_data);
+}
+
 APIHook *
 APIHook::next() const
 {
@@ -1226,6 +1260,9 @@ APIHooks::prepend(INKContInternal *cont)
 
   api_hook = apiHookAllocator.alloc();
   api_hook->m_cont = cont;
+  api_hook->m_fast_func = NULL;
+  api_hook->m_fast_data = NULL;
+  api_hook->m_plugin = cont->m_plugin;
 
   m_hooks.push(api_hook);
 }
@@ -1237,6 +1274,23 @@ APIHooks::append(INKContInternal *cont)
 
   api_hook = apiHookAllocator.alloc();
   api_hook->m_cont = cont;
+  api_hook->m_fast_func = NULL;
+  api_hook->m_fast_data = NULL;
+  api_hook->m_plugin = cont->m_plugin;
+
+  m_hooks.enqueue(api_hook);
+}
+
+void
+APIHooks::append_fast(TSHttpFastHookFunc func, void *data)
+{
+  APIHook *api_hook;
+
+  api_hook = apiHookAllocator.alloc();
+  api_hook->m_cont = NULL;
+  api_hook->m_fast_func = func;
+  api_hook->m_fast_data = data;
+  api_hook->m_plugin = plugin_hook_current;
 
   m_hooks.enqueue(api_hook);
 }
@@ -2064,6 +2118,36 @@ TSUrlStringGet(TSMBuffer bufp, TSMLoc obj, int *length)
   return url_string_get(url_impl, NULL, length, NULL);
 }
 
+TSReturnCode
+TSUrlViewGet(TSMBuffer bufp, TSMLoc obj, TSUrlView *view)
+{
+  sdk_assert(sdk_sanity_check_mbuffer(bufp) == TS_SUCCESS);
+  sdk_assert(sdk_sanity_check_url_handle(obj) == TS_SUCCESS);
+  sdk_assert(sdk_sanity_check_null_ptr((void*)view) == TS_SUCCESS);
+
+  URLImpl *url_impl = (URLImpl *) obj;
+
+  view->scheme = url_impl->m_ptr_scheme;
+  view->scheme_len = url_impl->m_len_scheme;
+  view->user = url_impl->m_ptr_user;
+  view->user_len = url_impl->m_len_user;
+  view->password = url_impl->m_ptr_password;
+  view->password_len = url_impl->m_len_password;
+  view->host = url_impl->m_ptr_host;
+  view->host_len = url_impl->m_len_host;
+  view->port = url_canonicalize_port(url_impl->m_url_type, url_impl->m_port);
+  view->path = url_impl->m_ptr_path;
+  view->path_len = url_impl->m_len_path;
+  view->params = url_impl->m_ptr_params;
+  view->params_len = url_impl->m_len_params;
+  view->query = url_impl->m_ptr_query;
+  view->query_len = url_impl->m_len_query;
+  view->fragment = url_impl->m_ptr_fragment;
+  view->fragment_len = url_impl->m_len_fragment;
+
+  return TS_SUCCESS;
+}
+
 typedef const char *(URL::*URLPartGetF) (int *length);
 typedef void (URL::*URLPartSetF) (const char *value, int length);
 
@@ -2567,6 +2651,50 @@ TSMimeHdrFieldsCount(TSMBuffer bufp, TSMLoc obj)
   return mime_hdr_fields_count(mh);
 }
 
+int
+TSMimeHdrFieldsViewGet(TSMBuffer bufp, TSMLoc obj, TSMimeFieldView *fields, int max_fields)
+{
+  sdk_assert(sdk_sanity_check_mbuffer(bufp) == TS_SUCCESS);
+  sdk_assert((sdk_sanity_check_mime_hdr_handle(obj) == TS_SUCCESS) ||
+             (sdk_sanity_check_http_hdr_handle(obj) == TS_SUCCESS));
+  sdk_assert((max_fields == 0) || (sdk_sanity_check_null_ptr((void*)fields) == TS_SUCCESS));
+
+  MIMEHdrImpl *mh = _hdr_mloc_to_mime_hdr_impl(obj);
+  int count = 0;
+
+  for (MIMEFieldBlockImpl *fblock = &(mh->m_first_fblock); fblock != NULL; fblock = fblock->m_next) {
+    for (unsigned int index = 0; index < fblock->m_freetop; ++index) {
+      MIMEField *field = &(fblock->m_field_slots[index]);
+
+      if (field->is_live()) {
+        if (count < max_fields) {
+          TSMimeFieldView *view = &fields[count];
+
+          view->name = field->m_ptr_name;
+          view->name_len = field->m_len_name;
+          view->value = field->m_ptr_value;
+          view->value_len = field->m_len_value;
+          view->wks_idx = field->m_wks_idx;
+        }
+        ++count;
+      }
+    }
+  }
+
+  return count;
+}
+
+int
+TSMimeFieldWksIndexGet(const char *name, int length)
+{
+  sdk_assert(sdk_sanity_check_null_ptr((void*)name) == TS_SUCCESS);
+
+  if (length < 0)
+    length = strlen(name);
+
+  return hdrtoken_tokenize(name, length);
+}
+
 // The following three helper functions should not be used in plugins! Since they are not used
 // by plugins, there's no need to validate the input.
 const char *
@@ -4185,6 +4313,58 @@ TSMgmtStringGet(const char *var_name, TSMgmtString *result)
   return TS_ERROR;
 }
 
+TSMgmtRecord
+TSMgmtRecordFind(const char *var_name)
+{
+  sdk_assert(sdk_sanity_check_null_ptr((void*)var_name) == TS_SUCCESS);
+
+  return (TSMgmtRecord) RecGetRecordHandle(var_name);
+}
+
+TSReturnCode
+TSMgmtRecordIntGet(TSMgmtRecord record, TSMgmtInt *result)
+{
+  RecData data;
+
+  if (RecGetRecordByHandle((RecRecord *) record, RECD_INT, &data) != REC_ERR_OKAY)
+    return TS_ERROR;
+  *result = data.rec_int;
+  return TS_SUCCESS;
+}
+
+TSReturnCode
+TSMgmtRecordCounterGet(TSMgmtRecord record, TSMgmtCounter *result)
+{
+  RecData data;
+
+  if (RecGetRecordByHandle((RecRecord *) record, RECD_COUNTER, &data) != REC_ERR_OKAY)
+    return TS_ERROR;
+  *result = data.rec_counter;
+  return TS_SUCCESS;
+}
+
+TSReturnCode
+TSMgmtRecordFloatGet(TSMgmtRecord record, TSMgmtFloat *result)
+{
+  RecData data;
+
+  if (RecGetRecordByHandle((RecRecord *) record, RECD_FLOAT, &data) != REC_ERR_OKAY)
+    return TS_ERROR;
+  *result = data.rec_float;
+  return TS_SUCCESS;
+}
+
+TSReturnCode
+TSMgmtRecordStringGet(TSMgmtRecord record, TSMgmtString *result)
+{
+  RecData data;
+
+  if (RecGetRecordByHandle((RecRecord *) record, RECD_STRING, &data) != REC_ERR_OKAY || data.rec_string == NULL)
+    return TS_ERROR;
+  *result = data.rec_string;
+  return TS_SUCCESS;
+}
+
 ////////////////////////////////////////////////////////////////////
 //
 // Continuations
@@ -4379,6 +4559,42 @@ TSHttpHookAdd(TSHttpHookID id, TSCont contp)
   http_global_hooks->append(id, (INKContInternal *)contp);
 }
 
+// Fast hooks are called inline from HttpSM::state_api_callout(), so they
+// can't be placed on hooks that are dispatched elsewhere or that expect a
+// continuation (transforms and response client agents).
+static TSReturnCode
+sdk_sanity_check_fast_hook_id(TSHttpHookID id)
+{
+  switch (id) {
+  case TS_HTTP_READ_REQUEST_HDR_HOOK:
+  case TS_HTTP_OS_DNS_HOOK:
+  case TS_HTTP_SEND_REQUEST_HDR_HOOK:
+  case TS_HTTP_READ_CACHE_HDR_HOOK:
+  case TS_HTTP_READ_RESPONSE_HDR_HOOK:
+  case TS_HTTP_SEND_RESPONSE_HDR_HOOK:
+  case TS_HTTP_TXN_START_HOOK:
+  case TS_HTTP_TXN_CLOSE_HOOK:
+  case TS_HTTP_CACHE_LOOKUP_COMPLETE_HOOK:
+  case TS_HTTP_PRE_REMAP_HOOK:
+  case TS_HTTP_POST_REMAP_HOOK:
+    return TS_SUCCESS;
+  default:
+    return TS_ERROR;
+  }
+}
+
+TSReturnCode
+TSHttpHookAddFast(TSHttpHookID id, TSHttpFastHookFunc funcp, void *data)
+{
+  sdk_assert(sdk_sanity_check_null_ptr((void *) funcp) == TS_SUCCESS);
+
+  if (sdk_sanity_check_fast_hook_id(id) != TS_SUCCESS)
+    return TS_ERROR;
+
+  http_global_hooks->append_fast(id, funcp, data);
+  return TS_SUCCESS;
+}
+
 void
 TSLifecycleHookAdd(TSLifecycleHookID id, TSCont contp)
 {
@@ -4481,6 +4697,30 @@ TSHttpTxnHookAdd(TSHttpTxn txnp, TSHttpHookID id, TSCont contp)
   sm->txn_hook_append(id, (INKContInternal *) contp);
 }
 
+TSReturnCode
+TSHttpTxnResponseBodyObserve(TSHttpTxn txnp, TSHttpBodyObserverFunc funcp, void *data)
+{
+  sdk_assert(sdk_sanity_check_txn(txnp) == TS_SUCCESS);
+  sdk_assert(sdk_sanity_check_null_ptr((void *) funcp) == TS_SUCCESS);
+
+  HttpSM *sm = (HttpSM *) txnp;
+  return sm->body_observer_add(funcp, data) ? TS_SUCCESS : TS_ERROR;
+}
+
+TSReturnCode
+TSHttpTxnHookAddFast(TSHttpTxn txnp, TSHttpHookID id, TSHttpFastHookFunc funcp, void *data)
+{
+  sdk_assert(sdk_sanity_check_txn(txnp) == TS_SUCCESS);
+  sdk_assert(sdk_sanity_check_null_ptr((void *) funcp) == TS_SUCCESS);
+
+  if (sdk_sanity_check_fast_hook_id(id) != TS_SUCCESS)
+    return TS_ERROR;
+
+  HttpSM *sm = (HttpSM *) txnp;
+  sm->txn_hook_append_fast(id, funcp, data);
+  return TS_SUCCESS;
+}
+
 
 // Private api function for gzip plugin.
 //  This function should only appear in TsapiPrivate.h
@@ -4540,6 +4780,20 @@ TSHttpTxnClientReqGet(TSHttpTxn txnp, TSMBuffer *bufp, TSMLoc *obj)
   return TS_ERROR;
 }
 
+const char *
+TSHttpTxnClientReqCookieGet(TSHttpTxn txnp, const char *name, int name_len, int *value_len)
+{
+  sdk_assert(sdk_sanity_check_txn(txnp) == TS_SUCCESS);
+  sdk_assert(sdk_sanity_check_null_ptr((void*) name) == TS_SUCCESS);
+  sdk_assert(sdk_sanity_check_null_ptr((void*) value_len) == TS_SUCCESS);
+
+  HttpSM *sm = (HttpSM *) txnp;
+
+  if (name_len < 0)
+    name_len = strlen(name);
+  return sm->t_state.hdr_info.client_request_cookies.get(&sm->t_state.hdr_info.client_request, name, name_len, value_len);
+}
+
 // pristine url is the url before remap
 TSReturnCode
 TSHttpTxnPristineUrlGet(TSHttpTxn txnp, TSMBuffer *bufp, TSMLoc *url_loc)
@@ -4572,6 +4826,21 @@ TSHttpTxnEffectiveUrlStringGet(TSHttpTxn txnp, int *length)
   return sm->t_state.hdr_info.client_request.url_string_get(0, length);
 }
 
+TSReturnCode
+TSHttpTxnEffectiveUrlStringPrint(TSHttpTxn txnp, char *buf, int buf_len, int *length)
+{
+  sdk_assert(TS_SUCCESS == sdk_sanity_check_txn(txnp));
+  sdk_assert(sdk_sanity_check_null_ptr((void*)buf) == TS_SUCCESS);
+  sdk_assert(sdk_sanity_check_null_ptr((void*)length) == TS_SUCCESS);
+
+  HttpSM *sm = reinterpret_cast<HttpSM*>(txnp);
+  int offset = 0, skip = 0;
+  int done = sm->t_state.hdr_info.client_request.url_print(buf, buf_len, &offset, &skip);
+
+  *length = offset;
+  return done ? TS_SUCCESS : TS_ERROR;
+}
+
 TSReturnCode
 TSHttpTxnClientRespGet(TSHttpTxn txnp, TSMBuffer *bufp, TSMLoc *obj)
 {
@@ -5606,6 +5875,15 @@ TSHttpTxnArgGet(TSHttpTxn txnp, int arg_idx)
   return sm->t_state.user_args[arg_idx];
 }
 
+void *
+TSHttpTxnArenaAlloc(TSHttpTxn txnp, size_t size)
+{
+  sdk_assert(sdk_sanity_check_txn(txnp) == TS_SUCCESS);
+
+  HttpSM *sm = (HttpSM *) txnp;
+  return sm->t_state.arena.alloc(size);
+}
+
 void
 TSHttpSsnArgSet(TSHttpSsn ssnp, int arg_idx, void *arg)
 {
@@ -5862,68 +6140,11 @@ TSHttpTxnMilestoneGet(TSHttpTxn txnp, TSMilestonesType milestone, ink_hrtime *ti
   HttpSM *sm = (HttpSM *) txnp;
   TSReturnCode ret = TS_SUCCESS;
 
-  switch(milestone) {
-  case TS_MILESTONE_UA_BEGIN:
-    *time = sm->milestones.ua_begin;
-    break;
-  case TS_MILESTONE_UA_READ_HEADER_DONE:
-    *time = sm->milestones.ua_read_header_done;
-    break;
-  case TS_MILESTONE_UA_BEGIN_WRITE:
-    *time = sm->milestones.ua_begin_write;
-    break;
-  case TS_MILESTONE_UA_CLOSE:
-    *time = sm->milestones.ua_close;
-    break;
-  case TS_MILESTONE_SERVER_FIRST_CONNECT:
-    *time = sm->milestones.server_first_connect;
-    break;
-  case TS_MILESTONE_SERVER_CONNECT:
-    *time = sm->milestones.server_connect;
-    break;
-  case TS_MILESTONE_SERVER_CONNECT_END:
-    *time = sm->milestones.server_connect_end;
-    break;
-  case TS_MILESTONE_SERVER_BEGIN_WRITE:
-    *time = sm->milestones.server_begin_write;
-    break;
-  case TS_MILESTONE_SERVER_FIRST_READ:
-    *time = sm->milestones.server_first_read;
-    break;
-  case TS_MILESTONE_SERVER_READ_HEADER_DONE:
-    *time = sm->milestones.server_read_header_done;
-    break;
-  case TS_MILESTONE_SERVER_CLOSE:
-    *time = sm->milestones.server_close;
-    break;
-  case TS_MILESTONE_CACHE_OPEN_READ_BEGIN:
-    *time = sm->milestones.cache_open_read_begin;
-    break;
-  case TS_MILESTONE_CACHE_OPEN_READ_END:
-    *time = sm->milestones.cache_open_read_end;
-    break;
-  case TS_MILESTONE_CACHE_OPEN_WRITE_BEGIN:
-    *time = sm->milestones.cache_open_write_begin;
-    break;
-  case TS_MILESTONE_CACHE_OPEN_WRITE_END:
-    *time = sm->milestones.cache_open_write_end;
-    break;
-  case TS_MILESTONE_DNS_LOOKUP_BEGIN:
-    *time = sm->milestones.dns_lookup_begin;
-    break;
-  case TS_MILESTONE_DNS_LOOKUP_END:
-    *time = sm->milestones.dns_lookup_end;
-    break;
-  case TS_MILESTONE_SM_START:
-    *time = sm->milestones.sm_start;
-    break;
-  case TS_MILESTONE_SM_FINISH:
-    *time = sm->milestones.sm_finish;
-    break;
-  default:
+  if (milestone > TS_MILESTONE_NULL && milestone < TS_MILESTONE_LAST_ENTRY) {
+    *time = sm->milestone_get(milestone);
+  } else {
     *time = -1;
     ret = TS_ERROR;
-    break;
   }
 
   return ret;
@@ -6089,6 +6310,36 @@ TSHttpConnect(sockaddr const* addr)
   return NULL;
 }
 
+TSVConn
+TSHttpConnectDirect(sockaddr const* addr)
+{
+  sdk_assert(addr);
+
+  sdk_assert(ats_is_ip(addr));
+  sdk_assert(ats_ip_port_cast(addr));
+
+  if (plugin_http_accept) {
+    PluginVCCore *new_pvc = PluginVCCore::alloc(true);
+
+    new_pvc->set_active_addr(addr);
+    new_pvc->set_accept_cont(plugin_http_accept);
+
+    PluginVC *return_vc = new_pvc->connect();
+
+    if (return_vc != NULL) {
+      PluginVC* other_side = return_vc->get_other_side();
+
+      if(other_side != NULL) {
+        other_side->set_is_internal_request(true);
+      }
+    }
+
+    return reinterpret_cast<TSVConn>(return_vc);
+  }
+
+  return NULL;
+}
+
 TSVConn
 TSHttpConnectTransparent(sockaddr const* client_addr, sockaddr const* server_addr)
 {
@@ -6324,6 +6575,27 @@ TSTransformCreate(TSEventFunc event_funcp, TSHttpTxn txnp)
   return TSVConnCreate(event_funcp, TSContMutexGet(reinterpret_cast<TSCont>(txnp)));
 }
 
+TSReturnCode
+TSTransformThreadPoolSet(TSVConn connp, TSThreadPool tp)
+{
+  sdk_assert(sdk_sanity_check_iocore_structure(connp) == TS_SUCCESS);
+
+  INKVConnInternal *vc = (INKVConnInternal *) connp;
+
+  switch (tp) {
+  case TS_THREAD_POOL_DEFAULT:
+    vc->set_event_type(ET_NET);
+    break;
+  case TS_THREAD_POOL_TASK:
+    vc->set_event_type(ET_TASK);
+    break;
+  default:
+    return TS_ERROR;
+  }
+
+  return TS_SUCCESS;
+}
+
 TSVConn
 TSTransformOutputVConnGet(TSVConn connp)
 {
@@ -6697,6 +6969,49 @@ TSStatFindName(const char* name, int *idp)
   return TS_ERROR;
 }
 
+TSKeyedStat
+TSKeyedStatCreate(const char *name, int num_counters, int max_keys)
+{
+  sdk_assert(sdk_sanity_check_null_ptr((void*)name) == TS_SUCCESS);
+
+  return (TSKeyedStat)RecAllocateKeyedStatTable(name, num_counters, max_keys);
+}
+
+int
+TSKeyedStatIndexGet(TSKeyedStat stat, const char *key, int key_len, int create)
+{
+  sdk_assert(sdk_sanity_check_null_ptr((void*)stat) == TS_SUCCESS);
+  sdk_assert(sdk_sanity_check_null_ptr((void*)key) == TS_SUCCESS);
+
+  if (key_len < 0)
+    key_len = strlen(key);
+  return RecKeyedStatIndex((RecKeyedStatTable *)stat, key, key_len, create != 0);
+}
+
+void
+TSKeyedStatIncrement(TSKeyedStat stat, int index, int counter, TSMgmtInt amount)
+{
+  RecIncrKeyedStat((RecKeyedStatTable *)stat, index, counter, amount);
+}
+
+TSMgmtInt
+TSKeyedStatGet(TSKeyedStat stat, int index, int counter)
+{
+  return RecGetKeyedStat((RecKeyedStatTable *)stat, index, counter);
+}
+
+int
+TSKeyedStatCount(TSKeyedStat stat)
+{
+  return RecKeyedStatCount((RecKeyedStatTable *)stat);
+}
+
+const char *
+TSKeyedStatKeyGet(TSKeyedStat stat, int index, int *key_len)
+{
+  return RecKeyedStatKey((RecKeyedStatTable *)stat, index, key_len);
+}
+
 
 /**************************    Stats API    ****************************/
 // THESE APIS ARE DEPRECATED, USE THE REC APIs INSTEAD
@@ -6759,12 +7074,14 @@ TSTextLogObjectCreate(const char *filename, int mode, TSTextLogObject *new_objec
   }
 
   TextLogObject *tlog = NEW(new TextLogObject(filename, Log::config->logfile_dir,
-                                              (bool) mode & TS_LOG_MODE_ADD_TIMESTAMP,
+                                              (mode & TS_LOG_MODE_ADD_TIMESTAMP) != 0,
                                               NULL,
                                               Log::config->rolling_enabled,
+                                              Log::config->collation_preproc_threads,
                                               Log::config->rolling_interval_sec,
                                               Log::config->rolling_offset_hr,
-                                              Log::config->rolling_size_mb));
+                                              Log::config->rolling_size_mb,
+                                              (mode & TS_LOG_MODE_BINARY) ? BINARY_LOG : ASCII_LOG));
   if (tlog) {
     int err = (mode & TS_LOG_MODE_DO_NOT_RENAME ?
                Log::config->log_object_manager.manage_api_object(tlog, 0) :
@@ -7092,6 +7409,33 @@ TSCacheHttpInfoSizeSet(TSCacheHttpInfo infop, int64_t size)
   info->object_size_set(size);
 }
 
+TSReturnCode
+TSCacheInvalidatePrefix(const char *host, int host_len, const char *prefix, int prefix_len)
+{
+  sdk_assert(sdk_sanity_check_null_ptr((void*)host) == TS_SUCCESS);
+  sdk_assert(sdk_sanity_check_null_ptr((void*)prefix) == TS_SUCCESS);
+
+  if (host_len < 0)
+    host_len = strlen(host);
+  if (prefix_len < 0)
+    prefix_len = strlen(prefix);
+  HttpTransactCache::invalidate_prefix(host, host_len, prefix, prefix_len, ink_cluster_time());
+  return TS_SUCCESS;
+}
+
+TSReturnCode
+TSCacheInvalidateTag(const char *tag, int tag_len)
+{
+  sdk_assert(sdk_sanity_check_null_ptr((void*)tag) == TS_SUCCESS);
+
+  if (tag_len < 0)
+    tag_len = strlen(tag);
+  if (tag_len == 0)
+    return TS_ERROR;
+  HttpTransactCache::invalidate_tag(tag, tag_len, ink_cluster_time());
+  return TS_SUCCESS;
+}
+
 // this function should be called at TS_EVENT_HTTP_READ_RESPONSE_HDR
 void
 TSRedirectUrlSet(TSHttpTxn txnp, const char* url, const int url_len)
@@ -7276,7 +7620,7 @@ TSAIOWrite(int fd, off_t offset, char* buf, const size_t bufSize, TSCont contp)
 TSReturnCode
 TSAIOThreadNumSet(int thread_num)
 {
-#if AIO_MODE == AIO_MODE_NATIVE
+#if AIO_MODE == AIO_MODE_NATIVE || AIO_MODE == AIO_MODE_IO_URING
   (void)thread_num;
   return TS_SUCCESS;
 #else
@@ -7307,7 +7651,7 @@ TSSkipRemappingSet(TSHttpTxn txnp, int flag)
 
 // Little helper function to find the struct member
 void*
-_conf_to_memberp(TSOverridableConfigKey conf, HttpSM* sm, OverridableDataType *typep)
+_conf_to_memberp(TSOverridableConfigKey conf, OverridableHttpConfigParams *oride, OverridableDataType *typep)
 {
   // The default is "Byte", make sure to override that for those configs which are "Int".
   OverridableDataType typ = OVERRIDABLE_TYPE_BYTE;
@@ -7315,275 +7659,282 @@ _conf_to_memberp(TSOverridableConfigKey conf, HttpSM* sm, OverridableDataType *t
 
   switch (conf) {
   case TS_CONFIG_URL_REMAP_PRISTINE_HOST_HDR:
-    ret = &sm->t_state.txn_conf->maintain_pristine_host_hdr;
+    ret = &oride->maintain_pristine_host_hdr;
     break;
   case TS_CONFIG_HTTP_CHUNKING_ENABLED:
-    ret = &sm->t_state.txn_conf->chunking_enabled;
+    ret = &oride->chunking_enabled;
     break;
   case TS_CONFIG_HTTP_NEGATIVE_CACHING_ENABLED:
-    ret = &sm->t_state.txn_conf->negative_caching_enabled;
+    ret = &oride->negative_caching_enabled;
     break;
   case TS_CONFIG_HTTP_NEGATIVE_CACHING_LIFETIME:
     typ = OVERRIDABLE_TYPE_INT;
-    ret = &sm->t_state.txn_conf->negative_caching_lifetime;
+    ret = &oride->negative_caching_lifetime;
     break;
   case TS_CONFIG_HTTP_CACHE_WHEN_TO_REVALIDATE:
-    ret = &sm->t_state.txn_conf->cache_when_to_revalidate;
+    ret = &oride->cache_when_to_revalidate;
     break;
   case TS_CONFIG_HTTP_KEEP_ALIVE_ENABLED_IN:
-    ret = &sm->t_state.txn_conf->keep_alive_enabled_in;
+    ret = &oride->keep_alive_enabled_in;
     break;
   case TS_CONFIG_HTTP_KEEP_ALIVE_ENABLED_OUT:
-    ret = &sm->t_state.txn_conf->keep_alive_enabled_out;
+    ret = &oride->keep_alive_enabled_out;
     break;
   case TS_CONFIG_HTTP_KEEP_ALIVE_POST_OUT:
-    ret = &sm->t_state.txn_conf->keep_alive_post_out;
+    ret = &oride->keep_alive_post_out;
     break;
   case TS_CONFIG_HTTP_SHARE_SERVER_SESSIONS:
-    ret = &sm->t_state.txn_conf->share_server_sessions;
+    ret = &oride->share_server_sessions;
     break;
   case TS_CONFIG_NET_SOCK_RECV_BUFFER_SIZE_OUT:
     typ = OVERRIDABLE_TYPE_INT;
-    ret = &sm->t_state.txn_conf->sock_recv_buffer_size_out;
+    ret = &oride->sock_recv_buffer_size_out;
     break;
   case TS_CONFIG_NET_SOCK_SEND_BUFFER_SIZE_OUT:
     typ = OVERRIDABLE_TYPE_INT;
-    ret = &sm->t_state.txn_conf->sock_send_buffer_size_out;
+    ret = &oride->sock_send_buffer_size_out;
     break;
   case TS_CONFIG_NET_SOCK_OPTION_FLAG_OUT:
     typ = OVERRIDABLE_TYPE_INT;
-    ret = &sm->t_state.txn_conf->sock_option_flag_out;
+    ret = &oride->sock_option_flag_out;
     break;
   case TS_CONFIG_HTTP_FORWARD_PROXY_AUTH_TO_PARENT:
-    ret = &sm->t_state.txn_conf->fwd_proxy_auth_to_parent;
+    ret = &oride->fwd_proxy_auth_to_parent;
     break;
   case TS_CONFIG_HTTP_ANONYMIZE_REMOVE_FROM:
-    ret = &sm->t_state.txn_conf->anonymize_remove_from;
+    ret = &oride->anonymize_remove_from;
     break;
   case TS_CONFIG_HTTP_ANONYMIZE_REMOVE_REFERER:
-    ret = &sm->t_state.txn_conf->anonymize_remove_referer;
+    ret = &oride->anonymize_remove_referer;
     break;
   case TS_CONFIG_HTTP_ANONYMIZE_REMOVE_USER_AGENT:
-    ret = &sm->t_state.txn_conf->anonymize_remove_user_agent;
+    ret = &oride->anonymize_remove_user_agent;
     break;
   case TS_CONFIG_HTTP_ANONYMIZE_REMOVE_COOKIE:
-    ret = &sm->t_state.txn_conf->anonymize_remove_cookie;
+    ret = &oride->anonymize_remove_cookie;
     break;
   case TS_CONFIG_HTTP_ANONYMIZE_REMOVE_CLIENT_IP:
-    ret = &sm->t_state.txn_conf->anonymize_remove_client_ip;
+    ret = &oride->anonymize_remove_client_ip;
     break;
   case TS_CONFIG_HTTP_ANONYMIZE_INSERT_CLIENT_IP:
-    ret = &sm->t_state.txn_conf->anonymize_insert_client_ip;
+    ret = &oride->anonymize_insert_client_ip;
     break;
   case TS_CONFIG_HTTP_RESPONSE_SERVER_ENABLED:
-    ret = &sm->t_state.txn_conf->proxy_response_server_enabled;
+    ret = &oride->proxy_response_server_enabled;
     break;
   case TS_CONFIG_HTTP_INSERT_SQUID_X_FORWARDED_FOR:
-    ret = &sm->t_state.txn_conf->insert_squid_x_forwarded_for;
+    ret = &oride->insert_squid_x_forwarded_for;
     break;
   case TS_CONFIG_HTTP_SERVER_TCP_INIT_CWND:
     typ = OVERRIDABLE_TYPE_INT;
-    ret = &sm->t_state.txn_conf->server_tcp_init_cwnd;
+    ret = &oride->server_tcp_init_cwnd;
     break;
   case TS_CONFIG_HTTP_SEND_HTTP11_REQUESTS:
-    ret = &sm->t_state.txn_conf->send_http11_requests;
+    ret = &oride->send_http11_requests;
     break;
   case TS_CONFIG_HTTP_CACHE_HTTP:
-    ret = &sm->t_state.txn_conf->cache_http;
+    ret = &oride->cache_http;
     break;
   case TS_CONFIG_HTTP_CACHE_CLUSTER_CACHE_LOCAL:
-    ret = &sm->t_state.txn_conf->cache_cluster_cache_local;
+    ret = &oride->cache_cluster_cache_local;
     break;
   case TS_CONFIG_HTTP_CACHE_IGNORE_CLIENT_NO_CACHE:
-    ret = &sm->t_state.txn_conf->cache_ignore_client_no_cache;
+    ret = &oride->cache_ignore_client_no_cache;
     break;
   case TS_CONFIG_HTTP_CACHE_IGNORE_CLIENT_CC_MAX_AGE:
-    ret = &sm->t_state.txn_conf->cache_ignore_client_cc_max_age;
+    ret = &oride->cache_ignore_client_cc_max_age;
     break;
   case TS_CONFIG_HTTP_CACHE_IMS_ON_CLIENT_NO_CACHE:
-    ret = &sm->t_state.txn_conf->cache_ims_on_client_no_cache;
+    ret = &oride->cache_ims_on_client_no_cache;
     break;
   case TS_CONFIG_HTTP_CACHE_IGNORE_SERVER_NO_CACHE:
-    ret = &sm->t_state.txn_conf->cache_ignore_server_no_cache;
+    ret = &oride->cache_ignore_server_no_cache;
     break;
   case TS_CONFIG_HTTP_CACHE_CACHE_RESPONSES_TO_COOKIES:
-    ret = &sm->t_state.txn_conf->cache_responses_to_cookies;
+    ret = &oride->cache_responses_to_cookies;
     break;
   case TS_CONFIG_HTTP_CACHE_IGNORE_AUTHENTICATION:
-    ret = &sm->t_state.txn_conf->cache_ignore_auth;
+    ret = &oride->cache_ignore_auth;
     break;
   case TS_CONFIG_HTTP_CACHE_CACHE_URLS_THAT_LOOK_DYNAMIC:
-    ret = &sm->t_state.txn_conf->cache_urls_that_look_dynamic;
+    ret = &oride->cache_urls_that_look_dynamic;
     break;
   case TS_CONFIG_HTTP_CACHE_REQUIRED_HEADERS:
-    ret = &sm->t_state.txn_conf->cache_required_headers;
+    ret = &oride->cache_required_headers;
     break;
   case TS_CONFIG_HTTP_INSERT_REQUEST_VIA_STR:
-    ret = &sm->t_state.txn_conf->insert_request_via_string;
+    ret = &oride->insert_request_via_string;
     break;
   case TS_CONFIG_HTTP_INSERT_RESPONSE_VIA_STR:
-    ret = &sm->t_state.txn_conf->insert_response_via_string;
+    ret = &oride->insert_response_via_string;
     break;
   case TS_CONFIG_HTTP_CACHE_HEURISTIC_MIN_LIFETIME:
     typ = OVERRIDABLE_TYPE_INT;
-    ret = &sm->t_state.txn_conf->cache_heuristic_min_lifetime;
+    ret = &oride->cache_heuristic_min_lifetime;
     break;
   case TS_CONFIG_HTTP_CACHE_HEURISTIC_MAX_LIFETIME:
     typ = OVERRIDABLE_TYPE_INT;
-    ret = &sm->t_state.txn_conf->cache_heuristic_max_lifetime;
+    ret = &oride->cache_heuristic_max_lifetime;
     break;
   case TS_CONFIG_HTTP_CACHE_GUARANTEED_MIN_LIFETIME:
     typ = OVERRIDABLE_TYPE_INT;
-    ret = &sm->t_state.txn_conf->cache_guaranteed_min_lifetime;
+    ret = &oride->cache_guaranteed_min_lifetime;
     break;
   case TS_CONFIG_HTTP_CACHE_GUARANTEED_MAX_LIFETIME:
     typ = OVERRIDABLE_TYPE_INT;
-    ret = &sm->t_state.txn_conf->cache_guaranteed_max_lifetime;
+    ret = &oride->cache_guaranteed_max_lifetime;
     break;
   case TS_CONFIG_HTTP_CACHE_MAX_STALE_AGE:
     typ = OVERRIDABLE_TYPE_INT;
-    ret = &sm->t_state.txn_conf->cache_max_stale_age;
+    ret = &oride->cache_max_stale_age;
     break;
   case TS_CONFIG_HTTP_KEEP_ALIVE_NO_ACTIVITY_TIMEOUT_IN:
     typ = OVERRIDABLE_TYPE_INT;
-    ret = &sm->t_state.txn_conf->keep_alive_no_activity_timeout_in;
+    ret = &oride->keep_alive_no_activity_timeout_in;
     break;
   case TS_CONFIG_HTTP_KEEP_ALIVE_NO_ACTIVITY_TIMEOUT_OUT:
     typ = OVERRIDABLE_TYPE_INT;
-    ret = &sm->t_state.txn_conf->keep_alive_no_activity_timeout_out;
+    ret = &oride->keep_alive_no_activity_timeout_out;
     break;
   case TS_CONFIG_HTTP_TRANSACTION_NO_ACTIVITY_TIMEOUT_IN:
     typ = OVERRIDABLE_TYPE_INT;
-    ret = &sm->t_state.txn_conf->transaction_no_activity_timeout_in;
+    ret = &oride->transaction_no_activity_timeout_in;
     break;
   case TS_CONFIG_HTTP_TRANSACTION_NO_ACTIVITY_TIMEOUT_OUT:
     typ = OVERRIDABLE_TYPE_INT;
-    ret = &sm->t_state.txn_conf->transaction_no_activity_timeout_out;
+    ret = &oride->transaction_no_activity_timeout_out;
     break;
   case TS_CONFIG_HTTP_TRANSACTION_ACTIVE_TIMEOUT_OUT:
     typ = OVERRIDABLE_TYPE_INT;
-    ret = &sm->t_state.txn_conf->transaction_active_timeout_out;
+    ret = &oride->transaction_active_timeout_out;
     break;
   case TS_CONFIG_HTTP_ORIGIN_MAX_CONNECTIONS:
     typ = OVERRIDABLE_TYPE_INT;
-    ret = &sm->t_state.txn_conf->origin_max_connections;
+    ret = &oride->origin_max_connections;
     break;
   case TS_CONFIG_HTTP_CONNECT_ATTEMPTS_MAX_RETRIES:
     typ = OVERRIDABLE_TYPE_INT;
-    ret = &sm->t_state.txn_conf->connect_attempts_max_retries;
+    ret = &oride->connect_attempts_max_retries;
     break;
   case TS_CONFIG_HTTP_CONNECT_ATTEMPTS_MAX_RETRIES_DEAD_SERVER:
     typ = OVERRIDABLE_TYPE_INT;
-    ret = &sm->t_state.txn_conf->connect_attempts_max_retries_dead_server;
+    ret = &oride->connect_attempts_max_retries_dead_server;
     break;
   case TS_CONFIG_HTTP_CONNECT_ATTEMPTS_RR_RETRIES:
     typ = OVERRIDABLE_TYPE_INT;
-    ret = &sm->t_state.txn_conf->connect_attempts_rr_retries;
+    ret = &oride->connect_attempts_rr_retries;
     break;
   case TS_CONFIG_HTTP_CONNECT_ATTEMPTS_TIMEOUT:
     typ = OVERRIDABLE_TYPE_INT;
-    ret = &sm->t_state.txn_conf->connect_attempts_timeout;
+    ret = &oride->connect_attempts_timeout;
     break;
   case TS_CONFIG_HTTP_POST_CONNECT_ATTEMPTS_TIMEOUT:
     typ = OVERRIDABLE_TYPE_INT;
-    ret = &sm->t_state.txn_conf->post_connect_attempts_timeout;
+    ret = &oride->post_connect_attempts_timeout;
     break;
   case TS_CONFIG_HTTP_DOWN_SERVER_CACHE_TIME:
     typ = OVERRIDABLE_TYPE_INT;
-    ret = &sm->t_state.txn_conf->down_server_timeout;
+    ret = &oride->down_server_timeout;
     break;
   case TS_CONFIG_HTTP_DOWN_SERVER_ABORT_THRESHOLD:
     typ = OVERRIDABLE_TYPE_INT;
-    ret = &sm->t_state.txn_conf->client_abort_threshold;
+    ret = &oride->client_abort_threshold;
     break;
   case TS_CONFIG_HTTP_CACHE_FUZZ_TIME:
     typ = OVERRIDABLE_TYPE_INT;
-    ret = &sm->t_state.txn_conf->freshness_fuzz_time;
+    ret = &oride->freshness_fuzz_time;
     break;
   case TS_CONFIG_HTTP_CACHE_FUZZ_MIN_TIME:
     typ = OVERRIDABLE_TYPE_INT;
-    ret = &sm->t_state.txn_conf->freshness_fuzz_min_time;
+    ret = &oride->freshness_fuzz_min_time;
     break;
   case TS_CONFIG_HTTP_DOC_IN_CACHE_SKIP_DNS:
-    ret = &sm->t_state.txn_conf->doc_in_cache_skip_dns;
+    ret = &oride->doc_in_cache_skip_dns;
     break;
   case TS_CONFIG_HTTP_BACKGROUND_FILL_ACTIVE_TIMEOUT:
     typ = OVERRIDABLE_TYPE_INT;
-    ret = &sm->t_state.txn_conf->background_fill_active_timeout;
+    ret = &oride->background_fill_active_timeout;
     break;
   case TS_CONFIG_HTTP_RESPONSE_SERVER_STR:
     typ = OVERRIDABLE_TYPE_STRING;
-    ret = &sm->t_state.txn_conf->proxy_response_server_string;
+    ret = &oride->proxy_response_server_string;
     break;
   case TS_CONFIG_HTTP_CACHE_HEURISTIC_LM_FACTOR:
     typ = OVERRIDABLE_TYPE_FLOAT;
-    ret = &sm->t_state.txn_conf->cache_heuristic_lm_factor;
+    ret = &oride->cache_heuristic_lm_factor;
     break;
   case TS_CONFIG_HTTP_CACHE_FUZZ_PROBABILITY:
     typ = OVERRIDABLE_TYPE_FLOAT;
-    ret = &sm->t_state.txn_conf->freshness_fuzz_prob;
+    ret = &oride->freshness_fuzz_prob;
     break;
   case TS_CONFIG_HTTP_BACKGROUND_FILL_COMPLETED_THRESHOLD:
     typ = OVERRIDABLE_TYPE_FLOAT;
-    ret = &sm->t_state.txn_conf->background_fill_threshold;
+    ret = &oride->background_fill_threshold;
     break;
   case TS_CONFIG_NET_SOCK_PACKET_MARK_OUT:
     typ = OVERRIDABLE_TYPE_INT;
-    ret = &sm->t_state.txn_conf->sock_packet_mark_out;
+    ret = &oride->sock_packet_mark_out;
     break;
   case TS_CONFIG_NET_SOCK_PACKET_TOS_OUT:
     typ = OVERRIDABLE_TYPE_INT;
-    ret = &sm->t_state.txn_conf->sock_packet_tos_out;
+    ret = &oride->sock_packet_tos_out;
     break;
   case TS_CONFIG_HTTP_INSERT_AGE_IN_RESPONSE:
-    ret = &sm->t_state.txn_conf->insert_age_in_response;
+    ret = &oride->insert_age_in_response;
     break;
   case TS_CONFIG_HTTP_CHUNKING_SIZE:
     typ = OVERRIDABLE_TYPE_INT;
-    ret = &sm->t_state.txn_conf->http_chunking_size;
+    ret = &oride->http_chunking_size;
     break;
   case TS_CONFIG_HTTP_FLOW_CONTROL_ENABLED:
-    ret = &sm->t_state.txn_conf->flow_control_enabled;
+    ret = &oride->flow_control_enabled;
     break;
   case TS_CONFIG_HTTP_FLOW_CONTROL_LOW_WATER_MARK:
     typ = OVERRIDABLE_TYPE_INT;
-    ret = &sm->t_state.txn_conf->flow_low_water_mark;
+    ret = &oride->flow_low_water_mark;
     break;
   case TS_CONFIG_HTTP_FLOW_CONTROL_HIGH_WATER_MARK:
     typ = OVERRIDABLE_TYPE_INT;
-    ret = &sm->t_state.txn_conf->flow_high_water_mark;
+    ret = &oride->flow_high_water_mark;
     break;
   case TS_CONFIG_HTTP_CACHE_RANGE_LOOKUP:
-    ret = &sm->t_state.txn_conf->cache_range_lookup;
+    ret = &oride->cache_range_lookup;
     break;
   case TS_CONFIG_HTTP_NORMALIZE_AE_GZIP:
-    ret = &sm->t_state.txn_conf->normalize_ae_gzip;
+    ret = &oride->normalize_ae_gzip;
     break;
   case TS_CONFIG_HTTP_DEFAULT_BUFFER_SIZE:
     typ = OVERRIDABLE_TYPE_INT;
-    ret = &sm->t_state.txn_conf->default_buffer_size_index;
+    ret = &oride->default_buffer_size_index;
     break;
   case TS_CONFIG_HTTP_DEFAULT_BUFFER_WATER_MARK:
     typ = OVERRIDABLE_TYPE_INT;
-    ret = &sm->t_state.txn_conf->default_buffer_water_mark;
+    ret = &oride->default_buffer_water_mark;
     break;
   case TS_CONFIG_HTTP_REQUEST_HEADER_MAX_SIZE:
     typ = OVERRIDABLE_TYPE_INT;
-    ret = &sm->t_state.txn_conf->request_hdr_max_size;
+    ret = &oride->request_hdr_max_size;
     break;
   case TS_CONFIG_HTTP_RESPONSE_HEADER_MAX_SIZE:
     typ = OVERRIDABLE_TYPE_INT;
-    ret = &sm->t_state.txn_conf->response_hdr_max_size;
+    ret = &oride->response_hdr_max_size;
     break;
   case TS_CONFIG_HTTP_NEGATIVE_REVALIDATING_ENABLED:
-    ret = &sm->t_state.txn_conf->negative_revalidating_enabled;
+    ret = &oride->negative_revalidating_enabled;
     break;
   case TS_CONFIG_HTTP_NEGATIVE_REVALIDATING_LIFETIME:
     typ = OVERRIDABLE_TYPE_INT;
-    ret = &sm->t_state.txn_conf->negative_revalidating_lifetime;
+    ret = &oride->negative_revalidating_lifetime;
     break;
   case TS_CONFIG_HTTP_ACCEPT_ENCODING_FILTER_ENABLED:
-    ret = &sm->t_state.txn_conf->accept_encoding_filter_enabled;
+    ret = &oride->accept_encoding_filter_enabled;
+    break;
+  case TS_CONFIG_HTTP_SERVER_PIPELINE_DEPTH:
+    typ = OVERRIDABLE_TYPE_INT;
+    ret = &oride->server_pipeline_depth;
+    break;
+  case TS_CONFIG_HTTP_SERVER_HTTP2:
+    ret = &oride->server_http2;
     break;
 
     // This helps avoiding compiler warnings, yet detect unhandled enum members.
@@ -7599,19 +7950,12 @@ _conf_to_memberp(TSOverridableConfigKey conf, HttpSM* sm, OverridableDataType *t
   return ret;
 }
 
-/* APIs to manipulate the overridable configuration options.
-*/
-TSReturnCode
-TSHttpTxnConfigIntSet(TSHttpTxn txnp, TSOverridableConfigKey conf, TSMgmtInt value)
+// Little helpers to set one overridable config in a given set of configs.
+static TSReturnCode
+_conf_int_set(TSOverridableConfigKey conf, OverridableHttpConfigParams *oride, TSMgmtInt value)
 {
-  sdk_assert(sdk_sanity_check_txn(txnp) == TS_SUCCESS);
-
-  HttpSM *s = reinterpret_cast<HttpSM*>(txnp);
   OverridableDataType type;
-
-  s->t_state.setup_per_txn_configs();
-
-  void *dest = _conf_to_memberp(conf, s, &type);
+  void *dest = _conf_to_memberp(conf, oride, &type);
 
   if (!dest)
     return TS_ERROR;
@@ -7630,6 +7974,58 @@ TSHttpTxnConfigIntSet(TSHttpTxn txnp, TSOverridableConfigKey conf, TSMgmtInt val
   return TS_SUCCESS;
 }
 
+static TSReturnCode
+_conf_float_set(TSOverridableConfigKey conf, OverridableHttpConfigParams *oride, TSMgmtFloat value)
+{
+  OverridableDataType type;
+  TSMgmtFloat* dest = static_cast<TSMgmtFloat*>(_conf_to_memberp(conf, oride, &type));
+
+  if (type != OVERRIDABLE_TYPE_FLOAT)
+    return TS_ERROR;
+
+  if (dest)
+    *dest = value;
+
+  return TS_SUCCESS;
+}
+
+static TSReturnCode
+_conf_string_set(TSOverridableConfigKey conf, OverridableHttpConfigParams *oride, const char* value, int length)
+{
+  switch (conf) {
+  case TS_CONFIG_HTTP_RESPONSE_SERVER_STR:
+    oride->proxy_response_server_string = const_cast<char*>(value); // The "core" likes non-const char*
+    oride->proxy_response_server_string_len = length;
+    break;
+  default:
+    return TS_ERROR;
+    break;
+  }
+
+  return TS_SUCCESS;
+}
+
+/* APIs to manipulate the overridable configuration options.
+
+   txn_conf points at shared configs until a transaction changes one, so
+   the setters only take the per transaction copy when the value differs.
+*/
+TSReturnCode
+TSHttpTxnConfigIntSet(TSHttpTxn txnp, TSOverridableConfigKey conf, TSMgmtInt value)
+{
+  sdk_assert(sdk_sanity_check_txn(txnp) == TS_SUCCESS);
+
+  HttpSM *s = reinterpret_cast<HttpSM*>(txnp);
+  TSMgmtInt current;
+
+  if (TSHttpTxnConfigIntGet(txnp, conf, &current) == TS_SUCCESS && current == value)
+    return TS_SUCCESS;
+
+  s->t_state.setup_per_txn_configs();
+
+  return _conf_int_set(conf, s->t_state.txn_conf, value);
+}
+
 TSReturnCode
 TSHttpTxnConfigIntGet(TSHttpTxn txnp, TSOverridableConfigKey conf, TSMgmtInt *value)
 {
@@ -7637,7 +8033,7 @@ TSHttpTxnConfigIntGet(TSHttpTxn txnp, TSOverridableConfigKey conf, TSMgmtInt *va
   sdk_assert(sdk_sanity_check_null_ptr((void*)value) == TS_SUCCESS);
 
   OverridableDataType type;
-  void* src = _conf_to_memberp(conf, (HttpSM*)txnp, &type);
+  void* src = _conf_to_memberp(conf, ((HttpSM*)txnp)->t_state.txn_conf, &type);
 
   if (!src)
     return TS_ERROR;
@@ -7662,21 +8058,14 @@ TSHttpTxnConfigFloatSet(TSHttpTxn txnp, TSOverridableConfigKey conf, TSMgmtFloat
   sdk_assert(sdk_sanity_check_txn(txnp) == TS_SUCCESS);
 
   HttpSM *s = reinterpret_cast<HttpSM*>(txnp);
-  OverridableDataType type;
+  TSMgmtFloat current;
 
-  s->t_state.setup_per_txn_configs();
-
-  TSMgmtFloat* dest = static_cast<TSMgmtFloat*>(_conf_to_memberp(conf, s, &type));
-
-  if (type != OVERRIDABLE_TYPE_FLOAT)
-    return TS_ERROR;
-
-  if (dest) {
-    *dest = value;
+  if (TSHttpTxnConfigFloatGet(txnp, conf, &current) == TS_SUCCESS && current == value)
     return TS_SUCCESS;
-  }
 
-  return TS_SUCCESS;
+  s->t_state.setup_per_txn_configs();
+
+  return _conf_float_set(conf, s->t_state.txn_conf, value);
 }
 
 TSReturnCode
@@ -7686,7 +8075,7 @@ TSHttpTxnConfigFloatGet(TSHttpTxn txnp, TSOverridableConfigKey conf, TSMgmtFloat
   sdk_assert(sdk_sanity_check_null_ptr((void*)value) == TS_SUCCESS);
 
   OverridableDataType type;
-  TSMgmtFloat* dest = static_cast<TSMgmtFloat*>(_conf_to_memberp(conf, (HttpSM*)txnp, &type));
+  TSMgmtFloat* dest = static_cast<TSMgmtFloat*>(_conf_to_memberp(conf, ((HttpSM*)txnp)->t_state.txn_conf, &type));
 
   if (type != OVERRIDABLE_TYPE_FLOAT)
     return TS_ERROR;
@@ -7712,17 +8101,7 @@ TSHttpTxnConfigStringSet(TSHttpTxn txnp, TSOverridableConfigKey conf, const char
 
   s->t_state.setup_per_txn_configs();
 
-  switch (conf) {
-  case TS_CONFIG_HTTP_RESPONSE_SERVER_STR:
-    s->t_state.txn_conf->proxy_response_server_string = const_cast<char*>(value); // The "core" likes non-const char*
-    s->t_state.txn_conf->proxy_response_server_string_len = length;
-    break;
-  default:
-    return TS_ERROR;
-    break;
-  }
-
-  return TS_SUCCESS;
+  return _conf_string_set(conf, s->t_state.txn_conf, value, length);
 }
 
 
@@ -7749,6 +8128,209 @@ TSHttpTxnConfigStringGet(TSHttpTxn txnp, TSOverridableConfigKey conf, const char
 }
 
 
+// A plugin's fixed set of overrides, e.g. conf_remap's for one remap rule.
+// The overridable configs with the overrides applied are built once per
+// HttpConfigParams, and shared by every transaction the overlay is set on.
+struct HttpConfigOverlay
+{
+  struct Item
+  {
+    TSOverridableConfigKey conf;
+    TSRecordDataType type;
+    TSMgmtInt int_value;
+    TSMgmtFloat float_value;
+    char *string_value;
+    int string_len;
+  };
+
+  HttpConfigOverlay()
+  {
+    ink_mutex_init(&lock, "HttpConfigOverlay");
+  }
+
+  ~HttpConfigOverlay()
+  {
+    for (unsigned i = 0; i < items.length(); i++)
+      ats_free(items[i].string_value);
+    ink_mutex_destroy(&lock);
+  }
+
+  TSReturnCode add(Item & item);
+  TSReturnCode apply(OverridableHttpConfigParams *oride, Vec<char *> *strings);
+  Ptr<OverridableHttpConfigSnapshot> get(HttpConfigParams *params);
+
+  Vec<Item> items;
+  ink_mutex lock;
+  Ptr<OverridableHttpConfigSnapshot> snapshot;
+};
+
+TSReturnCode
+HttpConfigOverlay::add(Item & item)
+{
+  OverridableHttpConfigParams scratch;
+  TSReturnCode ret;
+
+  // Reject what a transaction would reject, while it is still the plugin's error.
+  switch (item.type) {
+  case TS_RECORDDATATYPE_INT:
+    ret = _conf_int_set(item.conf, &scratch, item.int_value);
+    break;
+  case TS_RECORDDATATYPE_FLOAT:
+    ret = _conf_float_set(item.conf, &scratch, item.float_value);
+    break;
+  default:
+    ret = _conf_string_set(item.conf, &scratch, item.string_value, item.string_len);
+    break;
+  }
+
+  if (ret == TS_SUCCESS) {
+    ink_mutex_acquire(&lock);
+    items.add(item);
+    snapshot = NULL;
+    ink_mutex_release(&lock);
+  }
+
+  return ret;
+}
+
+// With @a strings, the override strings are copied into it, otherwise
+// @a oride borrows the overlay's own.
+TSReturnCode
+HttpConfigOverlay::apply(OverridableHttpConfigParams *oride, Vec<char *> *strings)
+{
+  for (unsigned i = 0; i < items.length(); i++) {
+    Item & item = items[i];
+
+    switch (item.type) {
+    case TS_RECORDDATATYPE_INT:
+      _conf_int_set(item.conf, oride, item.int_value);
+      break;
+    case TS_RECORDDATATYPE_FLOAT:
+      _conf_float_set(item.conf, oride, item.float_value);
+      break;
+    default:
+      if (strings) {
+        char *s = ats_strndup(item.string_value, item.string_len);
+        strings->add(s);
+        _conf_string_set(item.conf, oride, s, item.string_len);
+      } else {
+        _conf_string_set(item.conf, oride, item.string_value, item.string_len);
+      }
+      break;
+    }
+  }
+
+  return TS_SUCCESS;
+}
+
+Ptr<OverridableHttpConfigSnapshot>
+HttpConfigOverlay::get(HttpConfigParams *params)
+{
+  Ptr<OverridableHttpConfigSnapshot> snap;
+
+  ink_mutex_acquire(&lock);
+  if (!snapshot || snapshot->base != params) {
+    snapshot = NEW(new OverridableHttpConfigSnapshot(params));
+    apply(&snapshot->oride, &snapshot->strings);
+  }
+  snap = snapshot;
+  ink_mutex_release(&lock);
+
+  return snap;
+}
+
+TSHttpConfigOverlay
+TSHttpConfigOverlayCreate()
+{
+  return reinterpret_cast<TSHttpConfigOverlay>(NEW(new HttpConfigOverlay));
+}
+
+void
+TSHttpConfigOverlayDestroy(TSHttpConfigOverlay overlay)
+{
+  sdk_assert(sdk_sanity_check_null_ptr((void*)overlay) == TS_SUCCESS);
+
+  delete reinterpret_cast<HttpConfigOverlay*>(overlay);
+}
+
+TSReturnCode
+TSHttpConfigOverlayIntSet(TSHttpConfigOverlay overlay, TSOverridableConfigKey conf, TSMgmtInt value)
+{
+  sdk_assert(sdk_sanity_check_null_ptr((void*)overlay) == TS_SUCCESS);
+
+  HttpConfigOverlay::Item item;
+
+  memset(&item, 0, sizeof(item));
+  item.conf = conf;
+  item.type = TS_RECORDDATATYPE_INT;
+  item.int_value = value;
+
+  return reinterpret_cast<HttpConfigOverlay*>(overlay)->add(item);
+}
+
+TSReturnCode
+TSHttpConfigOverlayFloatSet(TSHttpConfigOverlay overlay, TSOverridableConfigKey conf, TSMgmtFloat value)
+{
+  sdk_assert(sdk_sanity_check_null_ptr((void*)overlay) == TS_SUCCESS);
+
+  HttpConfigOverlay::Item item;
+
+  memset(&item, 0, sizeof(item));
+  item.conf = conf;
+  item.type = TS_RECORDDATATYPE_FLOAT;
+  item.float_value = value;
+
+  return reinterpret_cast<HttpConfigOverlay*>(overlay)->add(item);
+}
+
+TSReturnCode
+TSHttpConfigOverlayStringSet(TSHttpConfigOverlay overlay, TSOverridableConfigKey conf, const char* value, int length)
+{
+  sdk_assert(sdk_sanity_check_null_ptr((void*)overlay) == TS_SUCCESS);
+  sdk_assert(sdk_sanity_check_null_ptr((void*)value) == TS_SUCCESS);
+
+  HttpConfigOverlay::Item item;
+  TSReturnCode ret;
+
+  if (length == -1)
+    length = strlen(value);
+
+  memset(&item, 0, sizeof(item));
+  item.conf = conf;
+  item.type = TS_RECORDDATATYPE_STRING;
+  item.string_value = ats_strndup(value, length);
+  item.string_len = length;
+
+  if ((ret = reinterpret_cast<HttpConfigOverlay*>(overlay)->add(item)) != TS_SUCCESS)
+    ats_free(item.string_value);
+
+  return ret;
+}
+
+TSReturnCode
+TSHttpTxnConfigOverlaySet(TSHttpTxn txnp, TSHttpConfigOverlay overlay)
+{
+  sdk_assert(sdk_sanity_check_txn(txnp) == TS_SUCCESS);
+  sdk_assert(sdk_sanity_check_null_ptr((void*)overlay) == TS_SUCCESS);
+
+  HttpSM *s = reinterpret_cast<HttpSM*>(txnp);
+  HttpConfigOverlay *o = reinterpret_cast<HttpConfigOverlay*>(overlay);
+
+  if (s->t_state.txn_conf == &s->t_state.http_config_param->oride) {
+    // Nothing is overridden yet, so the transaction can share the overlay's configs.
+    s->t_state.txn_conf_snapshot = o->get(s->t_state.http_config_param);
+    s->t_state.txn_conf = &s->t_state.txn_conf_snapshot->oride;
+    return TS_SUCCESS;
+  }
+
+  s->t_state.setup_per_txn_configs();
+  ink_mutex_acquire(&o->lock);
+  o->apply(s->t_state.txn_conf, NULL);
+  ink_mutex_release(&o->lock);
+
+  return TS_SUCCESS;
+}
+
 // This is pretty suboptimal, and should only be used outside the critical path.
 TSReturnCode
 TSHttpTxnConfigFind(const char* name, int length, TSOverridableConfigKey *conf, TSRecordDataType *type)
@@ -7769,6 +8351,11 @@ TSHttpTxnConfigFind(const char* name, int length, TSOverridableConfigKey *conf,
       cnf = TS_CONFIG_HTTP_CACHE_HTTP;
     break;
 
+  case 30:
+    if (!strncmp(name, "proxy.config.http.server_http2", length))
+      cnf = TS_CONFIG_HTTP_SERVER_HTTP2;
+    break;
+
   case 31:
     if (!strncmp(name, "proxy.config.http.chunking.size", length))
       cnf = TS_CONFIG_HTTP_CHUNKING_SIZE;
@@ -7847,6 +8434,10 @@ TSHttpTxnConfigFind(const char* name, int length, TSOverridableConfigKey *conf,
 
   case 39:
     switch (name[length-1]) {
+    case 'h':
+      if (!strncmp(name, "proxy.config.http.server_pipeline_depth", length))
+        cnf = TS_CONFIG_HTTP_SERVER_PIPELINE_DEPTH;
+      break;
     case 'm':
       if (!strncmp(name, "proxy.config.http.anonymize_remove_from", length))
         cnf = TS_CONFIG_HTTP_ANONYMIZE_REMOVE_FROM;
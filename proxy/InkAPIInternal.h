@@ -36,6 +36,7 @@
 #include "ProxyConfig.h"
 #include "P_Cache.h"
 #include "I_Tasks.h"
+#include "Plugin.h"
 
 
 typedef enum
@@ -128,7 +129,14 @@ class APIHook
 {
 public:
   INKContInternal * m_cont;
+  /// Synchronous callback, set instead of @a m_cont for fast hooks.
+  TSHttpFastHookFunc m_fast_func;
+  void *m_fast_data;
+  /// The plugin which added the hook, NULL for core code.
+  PluginHookStats *m_plugin;
   int invoke(int event, void *edata);
+  TSEvent invoke_fast(TSHttpTxn txnp, TSHttpHookID id);
+  bool is_fast() const { return m_fast_func != NULL; }
   APIHook *next() const;
   LINK(APIHook, m_link);
 };
@@ -138,6 +146,7 @@ class APIHooks
 public:
   void prepend(INKContInternal * cont);
   void append(INKContInternal * cont);
+  void append_fast(TSHttpFastHookFunc func, void *data);
   APIHook *get();
   void clear();
 
@@ -160,6 +169,7 @@ public:
   void clear();
   void prepend(ID id, INKContInternal * cont);
   void append(ID id, INKContInternal * cont);
+  void append_fast(ID id, TSHttpFastHookFunc func, void *data);
   APIHook *get(ID id);
 
   bool has_hooks() const;
@@ -207,6 +217,14 @@ FeatureAPIHooks<ID,MAX_ID>::append(ID id, INKContInternal *cont)
   m_hooks[id].append(cont);
 }
 
+template < typename ID, ID MAX_ID >
+void
+FeatureAPIHooks<ID,MAX_ID>::append_fast(ID id, TSHttpFastHookFunc func, void *data)
+{
+  hooks_p = true;
+  m_hooks[id].append_fast(func, data);
+}
+
 template < typename ID, ID MAX_ID >
 APIHook *
 FeatureAPIHooks<ID,MAX_ID>::get(ID id)
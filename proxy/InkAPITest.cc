@@ -5379,6 +5379,7 @@ REGRESSION_TEST(SDK_API_TSTextLog) (RegressionTest * test, int /* atype ATS_UNUS
 //                     TSMgmtFloatGet
 //                     TSMgmtIntGet
 //                     TSMgmtStringGet
+//                     TSMgmtRecordFind and its getters
 //////////////////////////////////////////////
 
 REGRESSION_TEST(SDK_API_TSMgmtGet) (RegressionTest * test, int /* atype ATS_UNUSED */, int *pstatus)
@@ -5440,6 +5441,42 @@ REGRESSION_TEST(SDK_API_TSMgmtGet) (RegressionTest * test, int /* atype ATS_UNUS
   } else {
     SDK_RPRINT(test, "TSMgmtStringGet", "TestCase1.4", TC_PASS, "ok");
   }
+  TSfree(svalue);
+  svalue = NULL;
+
+  TSMgmtRecord crec = TSMgmtRecordFind(CONFIG_PARAM_COUNTER_NAME);
+  TSMgmtRecord frec = TSMgmtRecordFind(CONFIG_PARAM_FLOAT_NAME);
+  TSMgmtRecord irec = TSMgmtRecordFind(CONFIG_PARAM_INT_NAME);
+  TSMgmtRecord srec = TSMgmtRecordFind(CONFIG_PARAM_STRING_NAME);
+
+  if (!crec || !frec || !irec || !srec || TSMgmtRecordFind("proxy.config.no.such.variable")) {
+    SDK_RPRINT(test, "TSMgmtRecordFind", "TestCase1.5", TC_FAIL, "record lookup failed");
+    err = 1;
+  } else {
+    SDK_RPRINT(test, "TSMgmtRecordFind", "TestCase1.5", TC_PASS, "ok");
+  }
+
+  cvalue = -1;
+  fvalue = 0.0;
+  ivalue = -1;
+  if ((TSMgmtRecordCounterGet(crec, &cvalue) != TS_SUCCESS) || (cvalue != CONFIG_PARAM_COUNTER_VALUE) ||
+      (TSMgmtRecordFloatGet(frec, &fvalue) != TS_SUCCESS) || (fvalue != CONFIG_PARAM_FLOAT_VALUE) ||
+      (TSMgmtRecordIntGet(irec, &ivalue) != TS_SUCCESS) || (ivalue != CONFIG_PARAM_INT_VALUE) ||
+      (TSMgmtRecordStringGet(srec, &svalue) != TS_SUCCESS) || (strcmp(svalue, CONFIG_PARAM_STRING_VALUE) != 0)) {
+    SDK_RPRINT(test, "TSMgmtRecordGet", "TestCase1.6", TC_FAIL, "can not read values through their records");
+    err = 1;
+  } else {
+    SDK_RPRINT(test, "TSMgmtRecordGet", "TestCase1.6", TC_PASS, "ok");
+  }
+  TSfree(svalue);
+
+  // reading with the wrong type fails, as it does by name
+  if (TSMgmtRecordIntGet(srec, &ivalue) != TS_ERROR || TSMgmtRecordIntGet(NULL, &ivalue) != TS_ERROR) {
+    SDK_RPRINT(test, "TSMgmtRecordGet", "TestCase1.7", TC_FAIL, "read a string record as an int");
+    err = 1;
+  } else {
+    SDK_RPRINT(test, "TSMgmtRecordGet", "TestCase1.7", TC_PASS, "ok");
+  }
 
   if (err) {
     *pstatus = REGRESSION_TEST_FAILED;
@@ -7404,7 +7441,9 @@ const char *SDK_Overridable_Configs[TS_CONFIG_LAST_ENTRY] = {
   "proxy.config.http.response_header_max_size",
   "proxy.config.http.negative_revalidating_enabled",
   "proxy.config.http.negative_revalidating_lifetime",
-  "proxy.config.http.accept_encoding_filter_enabled"
+  "proxy.config.http.accept_encoding_filter_enabled",
+  "proxy.config.http.server_pipeline_depth",
+  "proxy.config.http.server_http2"
 };
 
 REGRESSION_TEST(SDK_API_OVERRIDABLE_CONFIGS) (RegressionTest * test, int /* atype ATS_UNUSED */, int *pstatus)
@@ -7497,6 +7536,135 @@ REGRESSION_TEST(SDK_API_OVERRIDABLE_CONFIGS) (RegressionTest * test, int /* atyp
   return;
 }
 
+////////////////////////////////////////////////
+// SDK_API_OVERRIDABLE_CONFIG_OVERLAY
+//
+// Unit Test for API: TSHttpConfigOverlayCreate
+//                    TSHttpConfigOverlayIntSet
+//                    TSHttpConfigOverlayStringSet
+//                    TSHttpTxnConfigOverlaySet
+//                    TSHttpConfigOverlayDestroy
+////////////////////////////////////////////////
+
+REGRESSION_TEST(SDK_API_OVERRIDABLE_CONFIG_OVERLAY) (RegressionTest * test, int /* atype ATS_UNUSED */, int *pstatus)
+{
+  HttpSM* s1 = HttpSM::allocate();
+  HttpSM* s2 = HttpSM::allocate();
+  TSHttpTxn txnp1 = reinterpret_cast<TSHttpTxn>(s1);
+  TSHttpTxn txnp2 = reinterpret_cast<TSHttpTxn>(s2);
+  TSHttpConfigOverlay overlay = TSHttpConfigOverlayCreate();
+  const char *test_string = "The Apache Traffic Server";
+  const char *sval_read;
+  TSMgmtInt ival_read, ival_base;
+  bool success = true;
+  int len;
+
+  s1->init();
+  s2->init();
+  *pstatus = REGRESSION_TEST_INPROGRESS;
+
+  TSHttpTxnConfigIntGet(txnp1, TS_CONFIG_HTTP_CACHE_FUZZ_TIME, &ival_base);
+
+  if (TSHttpConfigOverlayIntSet(overlay, TS_CONFIG_HTTP_CACHE_FUZZ_TIME, ival_base + 1) != TS_SUCCESS ||
+      TSHttpConfigOverlayStringSet(overlay, TS_CONFIG_HTTP_RESPONSE_SERVER_STR, test_string, -1) != TS_SUCCESS) {
+    SDK_RPRINT(test, "TSHttpConfigOverlayIntSet", "TestCase1", TC_FAIL, "could not set the overlay");
+    success = false;
+  }
+  if (TSHttpConfigOverlayStringSet(overlay, TS_CONFIG_HTTP_CHUNKING_ENABLED, test_string, -1) != TS_ERROR) {
+    SDK_RPRINT(test, "TSHttpConfigOverlayStringSet", "TestCase1", TC_FAIL, "accepted a string for an INT config");
+    success = false;
+  }
+
+  // Both transactions share the one copy of the overlay's configs.
+  TSHttpTxnConfigOverlaySet(txnp1, overlay);
+  TSHttpTxnConfigOverlaySet(txnp2, overlay);
+  if (s1->t_state.txn_conf != s2->t_state.txn_conf || s1->t_state.txn_conf == &s1->t_state.http_config_param->oride) {
+    SDK_RPRINT(test, "TSHttpTxnConfigOverlaySet", "TestCase1", TC_FAIL, "the transactions do not share the overlay");
+    success = false;
+  }
+
+  TSHttpTxnConfigIntGet(txnp2, TS_CONFIG_HTTP_CACHE_FUZZ_TIME, &ival_read);
+  TSHttpTxnConfigStringGet(txnp2, TS_CONFIG_HTTP_RESPONSE_SERVER_STR, &sval_read, &len);
+  if (ival_read != ival_base + 1 || len != (int)strlen(test_string) || memcmp(sval_read, test_string, len)) {
+    SDK_RPRINT(test, "TSHttpTxnConfigOverlaySet", "TestCase2", TC_FAIL, "the overlay was not applied");
+    success = false;
+  }
+
+  // Setting the same value needs no copy of its own, a different value does.
+  TSHttpTxnConfigIntSet(txnp1, TS_CONFIG_HTTP_CACHE_FUZZ_TIME, ival_base + 1);
+  if (s1->t_state.txn_conf != s2->t_state.txn_conf) {
+    SDK_RPRINT(test, "TSHttpTxnConfigIntSet", "TestCase2", TC_FAIL, "copied the configs for an unchanged value");
+    success = false;
+  }
+  TSHttpTxnConfigIntSet(txnp1, TS_CONFIG_HTTP_CACHE_FUZZ_TIME, ival_base + 2);
+  TSHttpTxnConfigIntGet(txnp2, TS_CONFIG_HTTP_CACHE_FUZZ_TIME, &ival_read);
+  TSHttpTxnConfigStringGet(txnp1, TS_CONFIG_HTTP_RESPONSE_SERVER_STR, &sval_read, &len);
+  if (s1->t_state.txn_conf == s2->t_state.txn_conf || ival_read != ival_base + 1 ||
+      len != (int)strlen(test_string) || memcmp(sval_read, test_string, len)) {
+    SDK_RPRINT(test, "TSHttpTxnConfigIntSet", "TestCase3", TC_FAIL, "the shared configs were not copied on write");
+    success = false;
+  }
+
+  s1->destroy();
+  s2->destroy();
+  TSHttpConfigOverlayDestroy(overlay);
+
+  if (success) {
+    *pstatus = REGRESSION_TEST_PASSED;
+    SDK_RPRINT(test, "TSHttpConfigOverlayIntSet", "TestCase1", TC_PASS, "ok");
+    SDK_RPRINT(test, "TSHttpConfigOverlayStringSet", "TestCase1", TC_PASS, "ok");
+    SDK_RPRINT(test, "TSHttpTxnConfigOverlaySet", "TestCase1", TC_PASS, "ok");
+  } else {
+    *pstatus = REGRESSION_TEST_FAILED;
+  }
+
+  return;
+}
+
+////////////////////////////////////////////////
+// SDK_API_TXN_ARENA
+//
+// Unit Test for API: TSHttpTxnArenaAlloc
+////////////////////////////////////////////////
+
+REGRESSION_TEST(SDK_API_TXN_ARENA) (RegressionTest * test, int /* atype ATS_UNUSED */, int *pstatus)
+{
+  HttpSM* s = HttpSM::allocate();
+  TSHttpTxn txnp = reinterpret_cast<TSHttpTxn>(s);
+  bool success = true;
+  char *small, *large;
+
+  s->init();
+  *pstatus = REGRESSION_TEST_INPROGRESS;
+
+  small = static_cast<char*>(TSHttpTxnArenaAlloc(txnp, 13));
+  large = static_cast<char*>(TSHttpTxnArenaAlloc(txnp, 64 * 1024));
+
+  if (!small || !large || ((uintptr_t)small % sizeof(double)) || ((uintptr_t)large % sizeof(double))) {
+    SDK_RPRINT(test, "TSHttpTxnArenaAlloc", "TestCase1", TC_FAIL, "bad or misaligned allocation");
+    success = false;
+  } else {
+    memset(small, 'a', 13);
+    memset(large, 'b', 64 * 1024);
+    if (small[12] != 'a' || large[0] != 'b' || (small < large + 64 * 1024 && large < small + 13)) {
+      SDK_RPRINT(test, "TSHttpTxnArenaAlloc", "TestCase1", TC_FAIL, "allocations overlap");
+      success = false;
+    }
+  }
+
+  // Releases everything allocated above.
+  s->destroy();
+
+  if (success) {
+    *pstatus = REGRESSION_TEST_PASSED;
+    SDK_RPRINT(test, "TSHttpTxnArenaAlloc", "TestCase1", TC_PASS, "ok");
+  } else {
+    *pstatus = REGRESSION_TEST_FAILED;
+  }
+
+  return;
+}
+
 ////////////////////////////////////////////////
 // SDK_API_ENCODING
 //
@@ -7592,3 +7760,176 @@ REGRESSION_TEST(SDK_API_ENCODING) (RegressionTest * test, int /* atype ATS_UNUSE
 
   return;
 }
+
+////////////////////////////////////////////////
+// SDK_API_HTTP_FAST_HOOK
+//
+// Unit Test for API: TSHttpTxnHookAddFast
+//
+// Also benchmarks the per-hook cost of dispatching to a continuation
+// (mutex try lock + handleEvent) against a fast hook callback, using
+// the same hook list walk as HttpSM::state_api_callout().
+////////////////////////////////////////////////
+
+#define FAST_HOOK_BENCH_HOOKS 8
+#define FAST_HOOK_BENCH_ITERATIONS 100000
+
+static int
+fast_hook_bench_cont_handler(TSCont contp, TSEvent /* event ATS_UNUSED */, void * /* edata ATS_UNUSED */)
+{
+  ++*static_cast<int *>(TSContDataGet(contp));
+  return 0;
+}
+
+static TSEvent
+fast_hook_bench_func(TSHttpTxn /* txnp ATS_UNUSED */, TSHttpHookID /* id ATS_UNUSED */, void *data)
+{
+  ++*static_cast<int *>(data);
+  return TS_EVENT_HTTP_CONTINUE;
+}
+
+REGRESSION_TEST(SDK_API_HTTP_FAST_HOOK) (RegressionTest * test, int /* atype ATS_UNUSED */, int *pstatus)
+{
+  HttpSM *s = HttpSM::allocate();
+  TSHttpTxn txnp = reinterpret_cast<TSHttpTxn>(s);
+  EThread *thread = this_ethread();
+  TSCont conts[FAST_HOOK_BENCH_HOOKS];
+  APIHooks cont_hooks, fast_hooks;
+  int cont_calls = 0, fast_calls = 0;
+  bool success = true;
+
+  s->init();
+  *pstatus = REGRESSION_TEST_INPROGRESS;
+
+  // Registration
+  if (TSHttpTxnHookAddFast(txnp, TS_HTTP_RESPONSE_TRANSFORM_HOOK, fast_hook_bench_func, &fast_calls) != TS_ERROR) {
+    SDK_RPRINT(test, "TSHttpTxnHookAddFast", "TestCase1", TC_FAIL, "fast hook accepted on a transform hook");
+    success = false;
+  } else if (TSHttpTxnHookAddFast(txnp, TS_HTTP_READ_REQUEST_HDR_HOOK, fast_hook_bench_func, &fast_calls) != TS_SUCCESS ||
+             !s->txn_hook_get(TS_HTTP_READ_REQUEST_HDR_HOOK) ||
+             !s->txn_hook_get(TS_HTTP_READ_REQUEST_HDR_HOOK)->is_fast()) {
+    SDK_RPRINT(test, "TSHttpTxnHookAddFast", "TestCase1", TC_FAIL, "fast hook not registered");
+    success = false;
+  } else {
+    SDK_RPRINT(test, "TSHttpTxnHookAddFast", "TestCase1", TC_PASS, "ok");
+  }
+
+  s->destroy();
+
+  // Dispatch benchmark
+  for (int i = 0; i < FAST_HOOK_BENCH_HOOKS; ++i) {
+    conts[i] = TSContCreate(fast_hook_bench_cont_handler, TSMutexCreate());
+    TSContDataSet(conts[i], &cont_calls);
+    cont_hooks.append(reinterpret_cast<INKContInternal *>(conts[i]));
+    fast_hooks.append_fast(fast_hook_bench_func, &fast_calls);
+  }
+
+  ink_hrtime start = ink_get_hrtime_internal();
+  for (int n = 0; n < FAST_HOOK_BENCH_ITERATIONS; ++n) {
+    for (APIHook *hook = cont_hooks.get(); hook; hook = hook->next()) {
+      Ptr<ProxyMutex> plugin_mutex = hook->m_cont->mutex;
+      if (MUTEX_TAKE_TRY_LOCK(plugin_mutex, thread)) {
+        hook->invoke(TS_EVENT_HTTP_READ_REQUEST_HDR, txnp);
+        Mutex_unlock(plugin_mutex, thread);
+      }
+    }
+  }
+  ink_hrtime cont_time = ink_get_hrtime_internal() - start;
+
+  start = ink_get_hrtime_internal();
+  for (int n = 0; n < FAST_HOOK_BENCH_ITERATIONS; ++n) {
+    for (APIHook *hook = fast_hooks.get(); hook; hook = hook->next()) {
+      if (hook->invoke_fast(txnp, TS_HTTP_READ_REQUEST_HDR_HOOK) != TS_EVENT_HTTP_CONTINUE) {
+        break;
+      }
+    }
+  }
+  ink_hrtime fast_time = ink_get_hrtime_internal() - start;
+
+  int expected = FAST_HOOK_BENCH_HOOKS * FAST_HOOK_BENCH_ITERATIONS;
+  if (cont_calls != expected || fast_calls != expected) {
+    SDK_RPRINT(test, "TSHttpTxnHookAddFast", "TestCase2", TC_FAIL, "expected %d calls, got %d continuation and %d fast",
+               expected, cont_calls, fast_calls);
+    success = false;
+  } else {
+    SDK_RPRINT(test, "TSHttpTxnHookAddFast", "TestCase2", TC_PASS, "continuation hook %.1f ns, fast hook %.1f ns per call",
+               (double) cont_time / expected, (double) fast_time / expected);
+  }
+
+  cont_hooks.clear();
+  fast_hooks.clear();
+  for (int i = 0; i < FAST_HOOK_BENCH_HOOKS; ++i) {
+    TSContDestroy(conts[i]);
+  }
+
+  *pstatus = success ? REGRESSION_TEST_PASSED : REGRESSION_TEST_FAILED;
+
+  return;
+}
+
+////////////////////////////////////////////////
+// SDK_API_VIEWS
+//
+// Unit Test for API: TSMimeHdrFieldsViewGet
+//                    TSMimeFieldWksIndexGet
+//                    TSUrlViewGet
+////////////////////////////////////////////////
+
+REGRESSION_TEST(SDK_API_VIEWS) (RegressionTest * test, int /* atype ATS_UNUSED */, int *pstatus)
+{
+  static const char *names[] = { TS_MIME_FIELD_HOST, "X-View-Test", TS_MIME_FIELD_ACCEPT };
+  static const char *values[] = { "www.example.com", "view", "*/*" };
+  const char *url_str = "http://user@www.example.com/a/b;p?q=1#f";
+  const char *start = url_str;
+  TSMBuffer bufp = TSMBufferCreate();
+  TSMLoc hdr_loc, url_loc, field_loc;
+  TSMimeFieldView fields[2];
+  TSUrlView url;
+  bool success = true;
+  int n;
+
+  *pstatus = REGRESSION_TEST_INPROGRESS;
+
+  TSMimeHdrCreate(bufp, &hdr_loc);
+  for (unsigned i = 0; i < countof(names); ++i) {
+    TSMimeHdrFieldCreateNamed(bufp, hdr_loc, names[i], strlen(names[i]), &field_loc);
+    TSMimeHdrFieldValueStringSet(bufp, hdr_loc, field_loc, -1, values[i], strlen(values[i]));
+    TSMimeHdrFieldAppend(bufp, hdr_loc, field_loc);
+    TSHandleMLocRelease(bufp, hdr_loc, field_loc);
+  }
+
+  // Only two of the three fields fit, but the count is for all of them.
+  n = TSMimeHdrFieldsViewGet(bufp, hdr_loc, fields, countof(fields));
+  if (n != 3 ||
+      fields[0].wks_idx != TSMimeFieldWksIndexGet(TS_MIME_FIELD_HOST, TS_MIME_LEN_HOST) || fields[0].wks_idx < 0 ||
+      fields[0].value_len != (int) strlen(values[0]) || memcmp(fields[0].value, values[0], fields[0].value_len) ||
+      fields[1].wks_idx != -1 || TSMimeFieldWksIndexGet("X-View-Test", -1) != -1 ||
+      fields[1].name_len != (int) strlen(names[1]) || memcmp(fields[1].name, names[1], fields[1].name_len)) {
+    SDK_RPRINT(test, "TSMimeHdrFieldsViewGet", "TestCase1", TC_FAIL, "bad field views");
+    success = false;
+  } else {
+    SDK_RPRINT(test, "TSMimeHdrFieldsViewGet", "TestCase1", TC_PASS, "ok");
+  }
+
+  TSUrlCreate(bufp, &url_loc);
+  if (TSUrlParse(bufp, url_loc, &start, url_str + strlen(url_str)) != TS_PARSE_DONE ||
+      TSUrlViewGet(bufp, url_loc, &url) != TS_SUCCESS) {
+    SDK_RPRINT(test, "TSUrlViewGet", "TestCase1", TC_FAIL, "unable to parse URL");
+    success = false;
+  } else if (url.host_len != 15 || memcmp(url.host, "www.example.com", 15) || url.port != 80 ||
+             url.user_len != 4 || url.password != NULL || url.path_len != 3 || memcmp(url.path, "a/b", 3) ||
+             url.params_len != 1 || url.query_len != 3 || memcmp(url.query, "q=1", 3) || url.fragment_len != 1) {
+    SDK_RPRINT(test, "TSUrlViewGet", "TestCase1", TC_FAIL, "bad URL view");
+    success = false;
+  } else {
+    SDK_RPRINT(test, "TSUrlViewGet", "TestCase1", TC_PASS, "ok");
+  }
+
+  TSHandleMLocRelease(bufp, TS_NULL_MLOC, url_loc);
+  TSHandleMLocRelease(bufp, TS_NULL_MLOC, hdr_loc);
+  TSMBufferDestroy(bufp);
+
+  *pstatus = success ? REGRESSION_TEST_PASSED : REGRESSION_TEST_FAILED;
+
+  return;
+}
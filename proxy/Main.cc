@@ -89,6 +89,9 @@ extern "C" int plock(int);
 #include "XmlUtils.h"
 #include "I_Tasks.h"
 #include "InkAPIInternal.h"
+#include "StartupPhase.h"
+#include "ReverseProxy.h"
+#include "OriginDNSPrefetch.h"
 
 #include <ts/ink_cap.h>
 
@@ -117,6 +120,8 @@ extern "C" int plock(int);
 static const long MAX_LOGIN =  sysconf(_SC_LOGIN_NAME_MAX) <= 0 ? _POSIX_LOGIN_NAME_MAX :  sysconf(_SC_LOGIN_NAME_MAX);
 
 static void * mgmt_restart_shutdown_callback(void *, char *, int data_len);
+static void * mgmt_handoff_callback(void *, char *, int data_len);
+static void * mgmt_drain_callback(void *, char *, int data_len);
 
 static int version_flag = DEFAULT_VERSION_FLAG;
 
@@ -285,6 +290,47 @@ check_lockfile()
   ats_free(lockfile);
 }
 
+// Give each event thread a counter in the heartbeat file, see ink_heartbeat.h.
+// The file is replaced rather than truncated, so that a draining server left
+// over from a hot upgrade keeps its own copy.
+static void
+init_heartbeat()
+{
+  char *path = Layout::relative_to(Layout::get()->runtimedir, SERVER_HEARTBEAT);
+  char tmp_path[PATH_NAME_MAX + 1];
+  HeartbeatSegment *seg;
+  int fd;
+
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+  ::unlink(tmp_path);
+  fd = ::open(tmp_path, O_RDWR | O_CREAT | O_EXCL, 0644);
+  if (fd < 0 || ftruncate(fd, sizeof(HeartbeatSegment)) < 0) {
+    Warning("unable to create heartbeat file '%s': %s", tmp_path, strerror(errno));
+    goto Lerror;
+  }
+  seg = (HeartbeatSegment *) mmap(NULL, sizeof(HeartbeatSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (seg == (HeartbeatSegment *) MAP_FAILED) {
+    Warning("unable to map heartbeat file '%s': %s", tmp_path, strerror(errno));
+    ::unlink(tmp_path);
+    goto Lerror;
+  }
+  seg->pid = getpid();
+  seg->nthreads = MIN(eventProcessor.n_ethreads, HEARTBEAT_MAX_THREADS);
+  for (int i = 0; i < seg->nthreads; i++)
+    eventProcessor.all_ethreads[i]->heartbeat = &seg->beats[i];
+  seg->magic = HEARTBEAT_MAGIC;
+  if (::rename(tmp_path, path) < 0) {
+    Warning("unable to rename heartbeat file to '%s': %s", path, strerror(errno));
+    ::unlink(tmp_path);
+  }
+  Debug("server", "heartbeat for %d event threads in '%s'", seg->nthreads, path);
+
+Lerror:
+  if (fd >= 0)
+    ::close(fd);
+  ats_free(path);
+}
+
 static void
 init_dirs(void)
 {
@@ -1122,6 +1168,25 @@ chdir_root()
 }
 
 
+// Start up steps that can run beside the others, see StartupPhase
+static void
+load_ssl_certificates()
+{
+  SSLCertificateConfig::startup();
+}
+
+static void
+build_remap_table()
+{
+  init_reverse_proxy();
+}
+
+static void
+create_body_factory()
+{
+  body_factory = NEW(new HttpBodyFactory);
+}
+
 static int
 getNumSSLThreads(void)
 {
@@ -1505,22 +1570,28 @@ main(int /* argc ATS_UNUSED */, char **argv)
   ink_hostdb_init(makeModuleVersion(HOSTDB_MODULE_MAJOR_VERSION, HOSTDB_MODULE_MINOR_VERSION , PRIVATE_MODULE_HEADER));
   ink_dns_init(makeModuleVersion(HOSTDB_MODULE_MAJOR_VERSION, HOSTDB_MODULE_MINOR_VERSION , PRIVATE_MODULE_HEADER));
   ink_split_dns_init(makeModuleVersion(1, 0, PRIVATE_MODULE_HEADER));
-  eventProcessor.start(num_of_net_threads, stacksize);
-
-  int num_remap_threads = 0;
-  TS_ReadConfigInteger(num_remap_threads, "proxy.config.remap.num_remap_threads");
-  if (num_remap_threads < 1)
-    num_remap_threads = 0;
+  ConfigReloadTimer::init();
+  {
+    StartupTimer timer("event system");
+    eventProcessor.start(num_of_net_threads, stacksize);
+    init_heartbeat();
+
+    int num_remap_threads = 0;
+    TS_ReadConfigInteger(num_remap_threads, "proxy.config.remap.num_remap_threads");
+    if (num_remap_threads < 1)
+      num_remap_threads = 0;
+
+    if (num_remap_threads > 0) {
+      Note("using the new remap processor system with %d threads", num_remap_threads);
+      remapProcessor.setUseSeparateThread();
+    }
+    remapProcessor.start(num_remap_threads, stacksize);
 
-  if (num_remap_threads > 0) {
-    Note("using the new remap processor system with %d threads", num_remap_threads);
-    remapProcessor.setUseSeparateThread();
+    RecProcessStart(stacksize);
   }
-  remapProcessor.start(num_remap_threads, stacksize);
-
-  RecProcessStart(stacksize);
 
   init_signals2();
+  lock_profile_start();
   // log initialization moved down
 
   if (command_flag) {
@@ -1534,13 +1605,20 @@ main(int /* argc ATS_UNUSED */, char **argv)
         _exit(1);               // in error
     }
   } else {
-    initCacheControl();
-    initCongestionControl();
-    IpAllow::startup();
-    ParentConfig::startup();
+    StartupPhase ssl_certificates("ssl certificates", load_ssl_certificates);
+    StartupPhase remap_table("remap.config", build_remap_table);
+    StartupPhase body_factory_templates("body factory", create_body_factory);
+
+    {
+      StartupTimer timer("control configs");
+      initCacheControl();
+      initCongestionControl();
+      IpAllow::startup();
+      ParentConfig::startup();
 #ifdef SPLIT_DNS
-    SplitDNSConfig::startup();
+      SplitDNSConfig::startup();
 #endif
+    }
 
     // Load HTTP port data. getNumSSLThreads depends on this.
     if (!HttpProxyPort::loadValue(http_accept_port_descriptor))
@@ -1551,24 +1629,47 @@ main(int /* argc ATS_UNUSED */, char **argv)
       TS_ReadConfigInteger(accept_mss, "proxy.config.net.sock_mss_in");
 
     NetProcessor::accept_mss = accept_mss;
-    netProcessor.start(0, stacksize);
+    {
+      StartupTimer timer("net");
+      netProcessor.start(0, stacksize);
 
-    sslNetProcessor.start(getNumSSLThreads(), stacksize);
+      // The server certificates are loaded beside the steps that follow, and waited for before
+      // the ports are opened.
+      ssl_NetProcessor.defer_certificates = true;
+      sslNetProcessor.start(getNumSSLThreads(), stacksize);
+    }
+    if (HttpProxyPort::hasSSL())
+      ssl_certificates.start(stacksize);
 
-    dnsProcessor.start(0, stacksize);
-    if (hostDBProcessor.start() < 0)
-      SignalWarning(MGMT_SIGNAL_SYSTEM_ERROR, "bad hostdb or storage configuration, hostdb disabled");
-    clusterProcessor.init();
+    {
+      StartupTimer timer("hostdb");
+      dnsProcessor.start(0, stacksize);
+      if (hostDBProcessor.start() < 0)
+        SignalWarning(MGMT_SIGNAL_SYSTEM_ERROR, "bad hostdb or storage configuration, hostdb disabled");
+      clusterProcessor.init();
+    }
 
     // initialize logging (after event and net processor)
-    Log::init(remote_management_flag ? 0 : Log::NO_REMOTE_MANAGEMENT);
+    {
+      StartupTimer timer("logging");
+      Log::init(remote_management_flag ? 0 : Log::NO_REMOTE_MANAGEMENT);
+    }
 
     // Init plugins as soon as logging is ready.
-    plugin_init(system_config_directory);        // plugin.config
-    pmgmt->registerPluginCallbacks(global_config_cbs);
+    {
+      StartupTimer timer("plugins");
+      plugin_init(system_config_directory);        // plugin.config
+      pmgmt->registerPluginCallbacks(global_config_cbs);
+    }
 
-    cacheProcessor.set_after_init_callback(&CB_After_Cache_Init);
-    cacheProcessor.start();
+    // Remap plugins are loaded after the global ones, as they always were.
+    remap_table.start(stacksize);
+
+    {
+      StartupTimer timer("cache");
+      cacheProcessor.set_after_init_callback(&CB_After_Cache_Init);
+      cacheProcessor.start();
+    }
 
     // UDP net-threads are turned off by default.
     if (!num_of_udp_threads)
@@ -1585,7 +1686,7 @@ main(int /* argc ATS_UNUSED */, char **argv)
     start_stats_snap();
 
     // Initialize Response Body Factory
-    body_factory = NEW(new HttpBodyFactory);
+    body_factory_templates.start(stacksize);
 
     // Start IP to userName cache processor used
     // by RADIUS and FW1 plug-ins.
@@ -1609,7 +1710,18 @@ main(int /* argc ATS_UNUSED */, char **argv)
 
     transformProcessor.start();
 
-    init_HttpProxyServer(num_accept_threads);
+    {
+      StartupTimer timer("http");
+      init_HttpProxyServer(num_accept_threads);
+    }
+
+    // Everything below may take connections.
+    ssl_certificates.wait();
+    remap_table.wait();
+    body_factory_templates.wait();
+
+    // The origins are known now, keep them resolved.
+    start_origin_dns_prefetch();
 
     int http_enabled = 1;
     TS_ReadConfigInteger(http_enabled, "proxy.config.http.enabled");
@@ -1658,11 +1770,14 @@ main(int /* argc ATS_UNUSED */, char **argv)
 
     pmgmt->registerMgmtCallback(MGMT_EVENT_SHUTDOWN, mgmt_restart_shutdown_callback, NULL);
     pmgmt->registerMgmtCallback(MGMT_EVENT_RESTART, mgmt_restart_shutdown_callback, NULL);
+    pmgmt->registerMgmtCallback(MGMT_EVENT_HANDOFF, mgmt_handoff_callback, NULL);
+    pmgmt->registerMgmtCallback(MGMT_EVENT_DRAIN, mgmt_drain_callback, NULL);
 
     // The main thread also becomes a net thread.
     ink_set_thread_name("[ET_NET 0]");
 
     Note("traffic server running");
+    startup_phase_report();
 
 #if TS_HAS_TESTS
     TransformTest::run();
@@ -1706,3 +1821,32 @@ mgmt_restart_shutdown_callback(void *, char *, int /* data_len ATS_UNUSED */)
   sync_cache_dir_on_shutdown();
   return NULL;
 }
+
+// Hot upgrade, first step: the new traffic_server starts once this returns
+// and opens the cache and host.db, so stop writing them. Requests are then
+// served without the cache, and HostDB is bypassed, until the drain.
+static void *
+mgmt_handoff_callback(void *, char *, int /* data_len ATS_UNUSED */)
+{
+  Note("handing off to a new traffic_server");
+  CacheProcessor::cache_ready = 0;
+  sync_cache_dir_on_shutdown();
+  if (hostdb_enable) {
+    hostdb_enable = 0;
+    hostDBProcessor.cache()->sync_all();
+  }
+  stop_HttpProxyServerBackDoor();
+  pmgmt->signalManager(MGMT_SIGNAL_PROXY_HANDED_OFF, "");
+  return NULL;
+}
+
+// Hot upgrade, second step: the new traffic_server accepts on the proxy ports.
+static void *
+mgmt_drain_callback(void *, char *, int /* data_len ATS_UNUSED */)
+{
+  int timeout = 300;
+
+  TS_ReadConfigInteger(timeout, "proxy.config.process_manager.drain_timeout");
+  drain_HttpProxyServer(timeout);
+  return NULL;
+}
@@ -0,0 +1,207 @@
+/** @file
+
+  Keeps the origin servers named in the configuration resolved in HostDB
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#include "libts.h"
+#include "P_EventSystem.h"
+#include "P_HostDB.h"
+#include "ControlMatcher.h"
+#include "ParentSelection.h"
+#include "ReverseProxy.h"
+#include "OriginDNSPrefetch.h"
+
+// How often to check whether the prefetch got enabled, while it is off.
+#define ORIGIN_PREFETCH_IDLE_INTERVAL HRTIME_SECONDS(60)
+
+static int origin_prefetch_interval = 0;
+
+struct OriginDNSPrefetch;
+typedef int (OriginDNSPrefetch::*OriginDNSPrefetchHandler) (int, void *);
+
+// One round looks the hosts up one after the other, so that the round
+// never adds more than one query at a time to the resolver's load.
+struct OriginDNSPrefetch: public Continuation
+{
+  char **hosts;
+  int num_hosts;
+  int next;
+  bool force;                   // resolving hosts[next] again, its entry is about to expire
+  bool in_lookup;               // an answer given inline must not start the next lookup
+  HostResStyle host_res_style;
+
+  OriginDNSPrefetch()
+    : Continuation(new_ProxyMutex()), hosts(NULL), num_hosts(0), next(0), force(false), in_lookup(false),
+      host_res_style(ats_host_res_from(AF_INET, host_res_default_preference_order))
+  {
+    SET_HANDLER((OriginDNSPrefetchHandler) & OriginDNSPrefetch::mainEvent);
+  }
+
+  int mainEvent(int event, void *data);
+  void collect();
+  void lookup();
+};
+
+static void
+add_host(InkHashTable *ht, const char *host)
+{
+  int len = strlen(host);
+  char host_lower[MAXDNAME + 1];
+  IpEndpoint ip;
+
+  if (len == 0 || len > MAXDNAME)
+    return;
+  for (int i = 0; i < len; i++)
+    host_lower[i] = ParseRules::ink_tolower(host[i]);
+  host_lower[len] = '\0';
+  if (0 == ats_ip_pton(host_lower, &ip))
+    return;
+  if (!ink_hash_table_isbound(ht, host_lower))
+    ink_hash_table_insert(ht, host_lower, NULL);
+}
+
+static void
+add_parents(InkHashTable *ht, ParentRecord *rec)
+{
+  if (rec == NULL)
+    return;
+  for (int i = 0; i < rec->num_parents; i++)
+    add_host(ht, rec->parents[i].hostname);
+}
+
+template<class Matcher> static void
+add_parents(InkHashTable *ht, Matcher *m)
+{
+  if (m == NULL)
+    return;
+  for (int i = 0; i < m->getNumElements(); i++)
+    add_parents(ht, &m->getDataArray()[i]);
+}
+
+void
+OriginDNSPrefetch::collect()
+{
+  InkHashTable *ht = ink_hash_table_create(InkHashTableKeyType_String);
+  InkHashTableIteratorState state;
+  InkHashTableEntry *entry;
+
+  // The table is only freed well after a reload replaced it.
+  UrlRewrite *table = rewrite_table;
+  if (table && table->origin_hosts) {
+    for (entry = ink_hash_table_iterator_first(table->origin_hosts, &state); entry != NULL;
+         entry = ink_hash_table_iterator_next(table->origin_hosts, &state))
+      add_host(ht, (const char *) ink_hash_table_entry_key(table->origin_hosts, entry));
+  }
+
+  ParentConfigParams *params = ParentConfig::acquire();
+  if (params) {
+    P_table *pt = params->ParentTable;
+    if (pt) {
+      add_parents(ht, pt->getHostMatcher());
+      add_parents(ht, pt->getReMatcher());
+      add_parents(ht, pt->getUrlMatcher());
+      add_parents(ht, pt->getIPMatcher());
+      add_parents(ht, pt->getHrMatcher());
+    }
+    add_parents(ht, params->DefaultParent);
+  }
+  ParentConfig::release(params);
+
+  int count = 0;
+  for (entry = ink_hash_table_iterator_first(ht, &state); entry != NULL; entry = ink_hash_table_iterator_next(ht, &state))
+    ++count;
+  num_hosts = 0;
+  hosts = (char **) ats_malloc(sizeof(char *) * (count + 1));
+  for (entry = ink_hash_table_iterator_first(ht, &state); entry != NULL; entry = ink_hash_table_iterator_next(ht, &state))
+    hosts[num_hosts++] = ats_strdup((const char *) ink_hash_table_entry_key(ht, entry));
+  ink_hash_table_destroy(ht);
+  Debug("origin_prefetch", "%d origin hosts", num_hosts);
+}
+
+void
+OriginDNSPrefetch::lookup()
+{
+  while (next < num_hosts) {
+    HostDBProcessor::Options opt;
+
+    opt.flags = force ? HostDBProcessor::HOSTDB_FORCE_DNS_ALWAYS : HostDBProcessor::HOSTDB_DO_NOT_FORCE_DNS;
+    opt.host_res_style = host_res_style;
+    Debug("origin_prefetch", "%s %s", force ? "resolving" : "looking up", hosts[next]);
+    in_lookup = true;
+    Action *action = hostDBProcessor.getbyname_re(this, hosts[next], 0, opt);
+    in_lookup = false;
+    if (action != ACTION_RESULT_DONE)
+      return;                   // the answer comes back as an event
+  }
+
+  for (int i = 0; i < num_hosts; i++)
+    ats_free(hosts[i]);
+  hosts = (char **) ats_free_null(hosts);
+  num_hosts = 0;
+  eventProcessor.schedule_in(this, origin_prefetch_interval > 0 ? HRTIME_SECONDS(origin_prefetch_interval)
+                             : ORIGIN_PREFETCH_IDLE_INTERVAL, ET_TASK);
+}
+
+int
+OriginDNSPrefetch::mainEvent(int event, void *data)
+{
+  switch (event) {
+  case EVENT_IMMEDIATE:
+  case EVENT_INTERVAL:
+    if (origin_prefetch_interval <= 0) {
+      eventProcessor.schedule_in(this, ORIGIN_PREFETCH_IDLE_INTERVAL, ET_TASK);
+      break;
+    }
+    collect();
+    next = 0;
+    force = false;
+    lookup();
+    break;
+
+  case EVENT_HOST_DB_LOOKUP: {
+    HostDBInfo *r = (HostDBInfo *) data;
+
+    // Resolve again what would expire before the next round, the entry
+    // keeps being served until the new answer replaces it.
+    if (!force && r && !r->failed() && r->ip_time_remaining() < 2 * origin_prefetch_interval) {
+      force = true;
+    } else {
+      force = false;
+      ++next;
+    }
+    if (!in_lookup)
+      lookup();
+    break;
+  }
+
+  default:
+    ink_assert(!"unexpected event");
+    break;
+  }
+  return EVENT_DONE;
+}
+
+void
+start_origin_dns_prefetch()
+{
+  REC_EstablishStaticConfigInt32(origin_prefetch_interval, "proxy.config.hostdb.origin_prefetch_interval");
+  eventProcessor.schedule_imm(NEW(new OriginDNSPrefetch), ET_TASK);
+}
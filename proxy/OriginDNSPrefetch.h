@@ -0,0 +1,34 @@
+/** @file
+
+  Keeps the origin servers named in the configuration resolved in HostDB
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#ifndef _ORIGIN_DNS_PREFETCH_H_
+#define _ORIGIN_DNS_PREFETCH_H_
+
+// Every proxy.config.hostdb.origin_prefetch_interval seconds, looks up the
+// target hosts of the remap.config forward rules and the parents of
+// parent.config in HostDB, and resolves again the ones that would expire
+// before the next round. Must be started after the remap and parent tables
+// are loaded.
+void start_origin_dns_prefetch();
+
+#endif
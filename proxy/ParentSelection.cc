@@ -47,6 +47,12 @@ static const char *retry_var = "proxy.config.http.parent_proxy.retry_time";
 static const char *enable_var = "proxy.config.http.parent_proxy_routing_enable";
 static const char *threshold_var = "proxy.config.http.parent_proxy.fail_threshold";
 static const char *dns_parent_only_var = "proxy.config.http.no_dns_just_forward_to_parent";
+static const char *load_bound_var = "proxy.config.http.parent_proxy.consistent_hash_load_bound";
+
+// Points each parent gets on the consistent hash ring, and the number of
+//   selections per parent after which the recorded loads are halved
+#define RING_POINTS_PER_PARENT 160
+#define RING_LOAD_WINDOW       1024
 
 static const char *ParentResultStr[] = {
   "Parent_Undefined",
@@ -58,7 +64,8 @@ static const char *ParentResultStr[] = {
 static const char *ParentRRStr[] = {
   "false",
   "strict",
-  "true"
+  "true",
+  "consistent_hash"
 };
 
 //
@@ -68,7 +75,8 @@ enum ParentCB_t
 {
   PARENT_FILE_CB, PARENT_DEFAULT_CB,
   PARENT_RETRY_CB, PARENT_ENABLE_CB,
-  PARENT_THRESHOLD_CB, PARENT_DNS_ONLY_CB
+  PARENT_THRESHOLD_CB, PARENT_DNS_ONLY_CB,
+  PARENT_LOAD_BOUND_CB
 };
 
 // If the parent was set by the external customer api,
@@ -78,7 +86,8 @@ enum ParentCB_t
 ParentRecord *const extApiRecord = (ParentRecord *) 0xeeeeffff;
 
 ParentConfigParams::ParentConfigParams()
-  : ParentTable(NULL), DefaultParent(NULL), ParentRetryTime(30), ParentEnable(0), FailThreshold(10), DNS_ParentOnly(0)
+  : ParentTable(NULL), DefaultParent(NULL), ParentRetryTime(30), ParentEnable(0), FailThreshold(10), DNS_ParentOnly(0),
+    LoadBound(125)
 { }
 
 ParentConfigParams::~ParentConfigParams()
@@ -120,6 +129,9 @@ ParentConfig::startup()
 
   //   DNS Parent Only
   parentConfigUpdate->attach(dns_parent_only_var);
+
+  //   Consistent hash load bound
+  parentConfigUpdate->attach(load_bound_var);
 }
 
 void
@@ -130,6 +142,7 @@ ParentConfig::reconfigure()
   int enable = 0;
   int fail_threshold;
   int dns_parent_only;
+  int load_bound = 125;
 
   ParentConfigParams *params;
   params = NEW(new ParentConfigParams);
@@ -158,6 +171,10 @@ ParentConfig::reconfigure()
   PARENT_ReadConfigInteger(dns_parent_only, dns_parent_only_var);
   params->DNS_ParentOnly = dns_parent_only;
 
+  // Handle the consistent hash load bound
+  PARENT_ReadConfigInteger(load_bound, load_bound_var);
+  params->LoadBound = load_bound;
+
   m_id = configProcessor.set(m_id, params);
 
   if (is_debug_tag_set("parent_config")) {
@@ -488,6 +505,11 @@ ParentRecord::FindParent(bool first_call, ParentResult * result, RequestData * r
 
   ink_assert(num_parents > 0 || go_direct == true);
 
+  if (round_robin == P_CONSISTENT_HASH && ring != NULL) {
+    FindRingParent(first_call, result, rdata, config);
+    return;
+  }
+
   if (first_call == true) {
     if (parents == NULL) {
       // We should only get into this state if
@@ -597,6 +619,188 @@ NO_PARENTS:
   result->port = 0;
 }
 
+// void ParentRecord::FindRingParent(bool first_call, ParentResult* result,
+//                                   RequestData* rdata, ParentConfigParams* config)
+//
+//    Parent lookup for round_robin=consistent_hash.  The request's
+//      URL hash (the cache key) picks a point on the ring and we walk
+//      clockwise to the first parent that is usable.  A parent that is
+//      down only moves its own share of the URLs to the parents that
+//      follow it on the ring.
+//
+//    With a load bound set, a parent that has taken more than
+//      LoadBound percent of the average number of recent selections is
+//      passed over as well, so a hot URL spills onto the next parents
+//      instead of overloading its owner.  If every usable parent is over
+//      the bound we take the first usable one anyway.
+//
+void
+ParentRecord::FindRingParent(bool first_call, ParentResult * result, RequestData * rdata, ParentConfigParams * config)
+{
+  HttpRequestData *request_info = (HttpRequestData *) rdata;
+  bool bypass_ok = (go_direct == true && config->DNS_ParentOnly == 0);
+  uint32_t pos;
+
+  if (first_call == true) {
+    INK_MD5 md5;
+    URL *url = request_info->hdr ? request_info->hdr->url_get() : NULL;
+
+    if (url != NULL && url->valid()) {
+      url->MD5_get(&md5);
+    } else {
+      const char *host = request_info->get_host();
+      ink_code_md5((unsigned char *) (host ? host : ""), host ? strlen(host) : 0, (unsigned char *) &md5);
+    }
+
+    // Find the first ring point at or after the key
+    uint32_t key = md5.word(1);
+    uint32_t lo = 0, hi = ring_size;
+    while (lo < hi) {
+      uint32_t mid = (lo + hi) / 2;
+      if (ring[mid].hash < key)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    pos = lo % ring_size;
+    result->start_parent = ring[pos].parent;
+    result->tried = 0;
+  } else {
+    result->tried |= (uint64_t) 1 << (result->last_parent % 64);
+    pos = (result->ring_pos + 1) % ring_size;
+  }
+
+  for (;;) {
+    int chosen = -1, fallback = -1;
+    bool chosenRetry = false, fallbackRetry = false;
+    int64_t total = ring_total;
+    int64_t bound = 0;
+
+    if (config->LoadBound > 0)
+      bound = ((total + 1) * config->LoadBound + 100 * num_parents - 1) / (100 * num_parents);
+
+    for (int n = 0; n < ring_size && chosen < 0; n++) {
+      uint32_t p = (pos + n) % ring_size;
+      int idx = ring[p].parent;
+      pRecord *pRec = parents + idx;
+      bool retry = false;
+
+      if (result->tried & ((uint64_t) 1 << (idx % 64)))
+        continue;
+
+      if (pRec->failedAt != 0 && pRec->failCount >= config->FailThreshold) {
+        if (result->wrap_around || (pRec->failedAt + config->ParentRetryTime) < request_info->xact_start) {
+          Debug("parent_select", "Parent marked for retry %s:%d", pRec->hostname, pRec->port);
+          retry = true;
+        } else {
+          continue;
+        }
+      }
+
+      if (bound > 0 && pRec->load + 1 > bound) {
+        if (fallback < 0) {
+          fallback = idx;
+          fallbackRetry = retry;
+          result->ring_pos = p;
+        }
+        continue;
+      }
+
+      chosen = idx;
+      chosenRetry = retry;
+      result->ring_pos = p;
+    }
+
+    if (chosen < 0 && fallback >= 0) {
+      Debug("parent_select", "All parents over the load bound, using %s:%d", parents[fallback].hostname,
+            parents[fallback].port);
+      chosen = fallback;
+      chosenRetry = fallbackRetry;
+    }
+
+    if (chosen >= 0) {
+      int32_t t = ink_atomic_increment(&ring_total, 1) + 1;
+
+      ink_atomic_increment(&parents[chosen].load, 1);
+      if (t == num_parents * RING_LOAD_WINDOW) {
+        // Age the loads so the bound follows the recent traffic mix
+        for (int i = 0; i < num_parents; i++)
+          ink_atomic_swap(&parents[i].load, parents[i].load / 2);
+        ink_atomic_swap(&ring_total, t / 2);
+      }
+
+      result->r = PARENT_SPECIFIED;
+      result->hostname = parents[chosen].hostname;
+      result->port = parents[chosen].port;
+      result->last_parent = chosen;
+      result->retry = chosenRetry;
+      Debug("parent_select", "Chosen parent = %s.%d", result->hostname, result->port);
+      return;
+    }
+
+    // Every parent has been tried or is down
+    if (bypass_ok == true || result->wrap_around == true)
+      break;
+    // Bypass disabled so keep trying, ignoring whether we think
+    //   a parent is down or not
+    result->wrap_around = true;
+    result->tried = 0;
+  }
+
+  if (this->go_direct == true) {
+    result->r = PARENT_DIRECT;
+  } else {
+    result->r = PARENT_FAIL;
+  }
+
+  result->hostname = NULL;
+  result->port = 0;
+}
+
+static int
+ring_point_cmp(const void *a, const void *b)
+{
+  uint32_t ha = ((const pRingPoint *) a)->hash;
+  uint32_t hb = ((const pRingPoint *) b)->hash;
+
+  return (ha < hb) ? -1 : ((ha > hb) ? 1 : 0);
+}
+
+// void ParentRecord::BuildRing()
+//
+//    Builds the consistent hash ring, ketama style: each parent
+//      gets RING_POINTS_PER_PARENT points taken four at a time from
+//      the MD5 of "host:port-n".  Only the parent's own name goes into
+//      its points, so adding or removing a parent leaves the rest of
+//      the ring where it was.
+//
+void
+ParentRecord::BuildRing()
+{
+  char buf[MAXDNAME + 32];
+  INK_MD5 md5;
+  int n = 0;
+
+  ats_free(ring);
+  ring_size = num_parents * RING_POINTS_PER_PARENT;
+  ring = (pRingPoint *)ats_malloc(sizeof(pRingPoint) * ring_size);
+
+  for (int i = 0; i < num_parents; i++) {
+    for (int j = 0; j < RING_POINTS_PER_PARENT / 4; j++) {
+      int len = snprintf(buf, sizeof(buf), "%s:%d-%d", parents[i].hostname, parents[i].port, j);
+
+      ink_code_md5((unsigned char *) buf, len, (unsigned char *) &md5);
+      for (int k = 0; k < 4; k++) {
+        ring[n].hash = md5.word(k);
+        ring[n].parent = i;
+        n++;
+      }
+    }
+  }
+
+  qsort(ring, ring_size, sizeof(pRingPoint), ring_point_cmp);
+}
+
 // const char* ParentRecord::ProcessParents(char* val)
 //
 //   Reads in the value of a "round-robin" or "order"
@@ -669,6 +873,7 @@ ParentRecord::ProcessParents(char *val)
     this->parents[i].hostname[tmp - current] = '\0';
     this->parents[i].port = port;
     this->parents[i].failedAt = 0;
+    this->parents[i].load = 0;
     this->parents[i].scheme = scheme;
   }
 
@@ -755,6 +960,8 @@ ParentRecord::Init(matcher_line * line_info)
         round_robin = P_STRICT_ROUND_ROBIN;
       } else if (strcasecmp(val, "false") == 0) {
         round_robin = P_NO_ROUND_ROBIN;
+      } else if (strcasecmp(val, "consistent_hash") == 0) {
+        round_robin = P_CONSISTENT_HASH;
       } else {
         round_robin = P_NO_ROUND_ROBIN;
         errPtr = "invalid argument to round_robin directive";
@@ -792,6 +999,10 @@ ParentRecord::Init(matcher_line * line_info)
     snprintf(errBuf, errBufLen, "%s No parent specified in parent.config at line %d", modulePrefix, line_num);
     return errBuf;
   }
+
+  if (round_robin == P_CONSISTENT_HASH && this->parents != NULL) {
+    BuildRing();
+  }
   // Process any modifiers to the directive, if they exist
   if (line_info->num_el > 0) {
     tmp = ProcessModifiers(line_info);
@@ -834,6 +1045,7 @@ ParentRecord::UpdateMatch(ParentResult * result, RequestData * rdata)
 ParentRecord::~ParentRecord()
 {
   ats_free(parents);
+  ats_free(ring);
 }
 
 void
@@ -1219,6 +1431,61 @@ EXCLUSIVE_REGRESSION_TEST(PARENTSELECTION) (RegressionTest * /* t ATS_UNUSED */,
       ink_assert(0);
     }
   }
+
+  // Test 173 - 176 consistent hash
+  tbl[0] = '\0';
+  T("dest_domain=hash.net parent=p0:80,p1:80,p2:80,p3:80 round_robin=consistent_hash\n")
+    REBUILD
+  params->LoadBound = 0;
+
+  // Test 173: a URL keeps going to the same parent
+  ST(173) REINIT br(request, "a.hash.net");
+  FP const char *owner = result->hostname;
+  int same = 0;
+  for (c = 0; c < 20; c++) {
+    REINIT br(request, "a.hash.net");
+    FP same += verify(result, PARENT_SPECIFIED, owner, 80);
+  }
+  RE(same == 20, 173)
+
+  // Test 174: marking the owner down moves its URL elsewhere
+  const char *before[32];
+  char host[64];
+  for (c = 0; c < 32; c++) {
+    snprintf(host, sizeof(host), "h%d.hash.net", c);
+    REINIT br(request, host);
+    FP before[c] = result->hostname;
+  }
+  ST(174) REINIT br(request, "a.hash.net");
+  FP params->markParentDown(result);
+  REINIT br(request, "a.hash.net");
+  FP RE(result->r == PARENT_SPECIFIED && strcmp(result->hostname, owner) != 0, 174)
+
+  // Test 175: ... and leaves the other parents' URLs alone
+  ST(175) int moved = 0;
+  for (c = 0; c < 32; c++) {
+    snprintf(host, sizeof(host), "h%d.hash.net", c);
+    REINIT br(request, host);
+    FP if (before[c] != owner && result->hostname != before[c])
+      moved++;
+  }
+  RE(moved == 0, 175)
+
+  // Test 176: with a tight load bound one hot URL is spread evenly
+  tbl[0] = '\0';
+  T("dest_domain=hash.net parent=p0:80,p1:80,p2:80,p3:80 round_robin=consistent_hash\n")
+    REBUILD
+  params->LoadBound = 100;
+  ST(176) int p0 = 0, p1 = 0, p2 = 0, p3 = 0;
+  for (c = 0; c < 40; c++) {
+    REINIT br(request, "a.hash.net");
+    FP p0 += verify(result, PARENT_SPECIFIED, "p0", 80);
+    p1 += verify(result, PARENT_SPECIFIED, "p1", 80);
+    p2 += verify(result, PARENT_SPECIFIED, "p2", 80);
+    p3 += verify(result, PARENT_SPECIFIED, "p3", 80);
+  }
+  RE(p0 == 10 && p1 == 10 && p2 == 10 && p3 == 10, 176)
+
   delete request;
   delete result;
 
@@ -61,7 +61,7 @@ struct ParentResult
 {
   ParentResult()
     : r(PARENT_UNDEFINED), hostname(NULL), port(0), line_number(0), epoch(NULL), rec(NULL),
-      last_parent(0), start_parent(0), wrap_around(false), retry(false)
+      last_parent(0), start_parent(0), wrap_around(false), retry(false), ring_pos(0), tried(0)
   { };
 
   // For outside consumption
@@ -78,6 +78,10 @@ struct ParentResult
   uint32_t start_parent;
   bool wrap_around;
   bool retry;
+  // consistent_hash only: position on the ring of the last parent and
+  //   a bitmask (by parent index modulo 64) of the parents tried so far
+  uint32_t ring_pos;
+  uint64_t tried;
 };
 
 class HttpRequestData;
@@ -130,6 +134,7 @@ struct ParentConfigParams:public ConfigInfo
   int32_t ParentEnable;
   int32_t FailThreshold;
   int32_t DNS_ParentOnly;
+  int32_t LoadBound;
 };
 
 struct ParentConfig
@@ -162,13 +167,25 @@ struct pRecord
   int failCount;
   int32_t upAt;
   const char *scheme;           // for which parent matches (if any)
+  volatile int32_t load;        // recent selections, consistent_hash only
+};
+
+// struct pRingPoint
+//
+//    A point on the consistent hash ring
+//
+struct pRingPoint
+{
+  uint32_t hash;
+  int parent;
 };
 
 enum ParentRR_t
 {
   P_NO_ROUND_ROBIN = 0,
   P_STRICT_ROUND_ROBIN,
-  P_HASH_ROUND_ROBIN
+  P_HASH_ROUND_ROBIN,
+  P_CONSISTENT_HASH
 };
 
 // class ParentRecord : public ControlBase
@@ -180,7 +197,8 @@ class ParentRecord: public ControlBase
 {
 public:
   ParentRecord()
-    : parents(NULL), num_parents(0), round_robin(P_NO_ROUND_ROBIN), rr_next(0), go_direct(true)
+    : parents(NULL), num_parents(0), round_robin(P_NO_ROUND_ROBIN), rr_next(0), go_direct(true),
+      ring(NULL), ring_size(0), ring_total(0)
   { }
 
   ~ParentRecord();
@@ -189,6 +207,7 @@ public:
   bool DefaultInit(char *val);
   void UpdateMatch(ParentResult *result, RequestData *rdata);
   void FindParent(bool firstCall, ParentResult *result, RequestData *rdata, ParentConfigParams *config);
+  void FindRingParent(bool firstCall, ParentResult *result, RequestData *rdata, ParentConfigParams *config);
   void Print();
   pRecord *parents;
   int num_parents;
@@ -198,9 +217,13 @@ public:
   const char *scheme;
   //private:
   const char *ProcessParents(char *val);
+  void BuildRing();
   ParentRR_t round_robin;
   volatile uint32_t rr_next;
   bool go_direct;
+  pRingPoint *ring;
+  int ring_size;
+  volatile int32_t ring_total;
 };
 
 // Helper Functions
@@ -35,6 +35,7 @@
 #include "InkAPIInternal.h"
 #include "Main.h"
 #include "Plugin.h"
+#include "HttpDebugNames.h"
 
 // HPUX:
 //   LD_SHAREDCMD=ld -b
@@ -65,10 +66,116 @@ DLL<PluginRegInfo> plugin_reg_list;
 PluginRegInfo *plugin_reg_current = NULL;
 
 PluginRegInfo::PluginRegInfo()
-  : plugin_registered(false), plugin_path(NULL), sdk_version(PLUGIN_SDK_VERSION_UNKNOWN),
+  : plugin_registered(false), plugin_path(NULL), hook_stats(NULL), sdk_version(PLUGIN_SDK_VERSION_UNKNOWN),
     plugin_name(NULL), vendor_name(NULL), support_email(NULL)
 { }
 
+// Plugin hook timing
+//
+//    plugin_hook_current is set while plugin code runs, by the
+//      hook callouts and the INKContInternal handlers, so that
+//      the continuations a plugin creates are charged to it.
+//
+__thread PluginHookStats *plugin_hook_current = NULL;
+
+static DLL<PluginHookStats> plugin_hook_stats_list;
+static ink_mutex plugin_hook_stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+static RecRawStatBlock *plugin_hook_rsb = NULL;
+static int plugin_hook_next_stat = 0;
+
+PluginHookStats *
+plugin_hook_stats_get(const char *path)
+{
+  char name[256];
+  const char *base = strrchr(path, '/');
+  PluginHookStats *p;
+  int len;
+
+  // the file name without its extension, made safe for a record name
+  base = base ? base + 1 : path;
+  ink_strlcpy(name, base, sizeof(name));
+  if (char *dot = strchr(name, '.'))
+    *dot = '\0';
+  len = strlen(name);
+  for (int i = 0; i < len; i++)
+    if (!ParseRules::is_alnum(name[i]) && name[i] != '_' && name[i] != '-')
+      name[i] = '_';
+
+  ink_mutex_acquire(&plugin_hook_stats_mutex);
+  if (!plugin_hook_rsb)
+    plugin_hook_rsb = RecAllocateRawStatBlock(PLUGIN_HOOK_MAX_STATS);
+  for (p = plugin_hook_stats_list.head; p; p = p->link.next)
+    if (!strcmp(p->name, name))
+      break;
+  if (!p) {
+    p = NEW(new PluginHookStats);
+    p->name = ats_strdup(name);
+    for (int i = 0; i < PLUGIN_HOOK_SLOTS; i++)
+      p->stat_id[i] = -1;
+    plugin_hook_stats_list.push(p);
+  }
+  ink_mutex_release(&plugin_hook_stats_mutex);
+  return p;
+}
+
+static int
+plugin_hook_stats_register(PluginHookStats *plugin, int hook)
+{
+  int id;
+
+  ink_mutex_acquire(&plugin_hook_stats_mutex);
+  if ((id = plugin->stat_id[hook]) == -1) {
+    char hook_name[64], name[512];
+
+    if (hook == PLUGIN_HOOK_REMAP) {
+      ink_strlcpy(hook_name, "remap", sizeof(hook_name));
+    } else {
+      // TS_HTTP_READ_REQUEST_HDR_HOOK becomes read_request_hdr
+      const char *s = HttpDebugNames::get_api_hook_name((TSHttpHookID) hook);
+      int len;
+
+      if (!strncmp(s, "TS_HTTP_", 8))
+        s += 8;
+      ink_strlcpy(hook_name, s, sizeof(hook_name));
+      len = strlen(hook_name);
+      if (len > 5 && !strcmp(hook_name + len - 5, "_HOOK"))
+        hook_name[len - 5] = '\0';
+      for (char *c = hook_name; *c; c++)
+        *c = ParseRules::ink_tolower(*c);
+    }
+
+    if (!plugin_hook_rsb || plugin_hook_next_stat + 2 > PLUGIN_HOOK_MAX_STATS) {
+      Warning("no room for the stats of plugin %s on hook %s", plugin->name, hook_name);
+      id = -2;
+    } else {
+      id = plugin_hook_next_stat;
+      plugin_hook_next_stat += 2;
+      snprintf(name, sizeof(name), "proxy.process.plugin.%s.%s.time", plugin->name, hook_name);
+      RecRegisterRawStat(plugin_hook_rsb, RECT_PROCESS, name, RECD_INT, RECP_NULL, id, RecRawStatSyncSum);
+      snprintf(name, sizeof(name), "proxy.process.plugin.%s.%s.calls", plugin->name, hook_name);
+      RecRegisterRawStat(plugin_hook_rsb, RECT_PROCESS, name, RECD_INT, RECP_NULL, id + 1, RecRawStatSyncSum);
+    }
+    plugin->stat_id[hook] = id;
+  }
+  ink_mutex_release(&plugin_hook_stats_mutex);
+  return id;
+}
+
+void
+plugin_hook_stats_record(PluginHookStats *plugin, int hook, ink_hrtime elapsed)
+{
+  int id = plugin->stat_id[hook];
+
+  if (unlikely(id == -1))
+    id = plugin_hook_stats_register(plugin, hook);
+  if (id < 0)
+    return;
+
+  EThread *t = this_ethread();
+  RecIncrRawStatSum(plugin_hook_rsb, t, id, elapsed / HRTIME_USECOND);
+  RecIncrRawStatSum(plugin_hook_rsb, t, id + 1, 1);
+}
+
 static void *
 dll_open(const char *path)
 {
@@ -128,6 +235,7 @@ plugin_load(int argc, char *argv[])
   ink_assert(plugin_reg_current == NULL);
   plugin_reg_current = new PluginRegInfo;
   plugin_reg_current->plugin_path = ats_strdup(path);
+  plugin_reg_current->hook_stats = plugin_hook_stats_get(path);
 
   init = (init_func_t) dll_findsym(handle, "TSPluginInit");
   if (!init) {
@@ -136,7 +244,10 @@ plugin_load(int argc, char *argv[])
     abort();
   }
 
-  init(argc, argv);
+  {
+    PluginHookScope scope(plugin_reg_current->hook_stats);
+    init(argc, argv);
+  }
 
   plugin_reg_list.push(plugin_reg_current);
   plugin_reg_current = NULL;
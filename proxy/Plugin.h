@@ -25,6 +25,8 @@
 #define __PLUGIN_H__
 
 #include "List.h"
+#include "ink_hrtime.h"
+#include "api/ts/ts.h"
 
 // need to keep syncronized with TSSDKVersion
 //   in ts/ts.h.in
@@ -36,6 +38,50 @@ typedef enum
   PLUGIN_SDK_VERSION_4_0
 } PluginSDKVersion;
 
+/// Slot for the do_remap() calls of a remap plugin, after the hook ids.
+#define PLUGIN_HOOK_REMAP   TS_HTTP_LAST_HOOK
+#define PLUGIN_HOOK_SLOTS   (TS_HTTP_LAST_HOOK + 1)
+/// Stats for (plugin, hook) pairs, two for each.
+#define PLUGIN_HOOK_MAX_STATS 512
+
+/**
+  Time spent in the hooks of one plugin. There is one of these for each
+  plugin name, shared by the global and remap uses of a plugin and kept
+  across remap reloads. The stats for a hook are registered the first
+  time the plugin runs on it.
+
+*/
+struct PluginHookStats
+{
+  char *name;
+  int stat_id[PLUGIN_HOOK_SLOTS];     // microseconds, calls at + 1, -1 until registered
+
+  LINK(PluginHookStats, link);
+};
+
+/// The plugin whose code this thread is running, NULL in core code.
+extern __thread PluginHookStats *plugin_hook_current;
+
+PluginHookStats *plugin_hook_stats_get(const char *path);
+void plugin_hook_stats_record(PluginHookStats *plugin, int hook, ink_hrtime elapsed);
+
+/// Makes @a plugin the one running on this thread while in scope.
+struct PluginHookScope
+{
+  PluginHookStats *saved;
+
+  PluginHookScope(PluginHookStats *plugin)
+    : saved(plugin_hook_current)
+  {
+    plugin_hook_current = plugin;
+  }
+
+  ~PluginHookScope()
+  {
+    plugin_hook_current = saved;
+  }
+};
+
 struct PluginRegInfo
 {
   PluginRegInfo();
@@ -43,6 +89,7 @@ struct PluginRegInfo
 
   bool plugin_registered;
   char *plugin_path;
+  PluginHookStats *hook_stats;
 
   PluginSDKVersion sdk_version;
   char *plugin_name;
@@ -517,6 +517,14 @@ PluginVC::process_write_side(bool other_side_call)
     }
     return;
   }
+
+  if (core_obj->direct_transfer) {
+    // The other side pulls the bytes out of our buffer
+    //   itself, and reports back to our continuation
+    other_side->process_read_side(true);
+    return;
+  }
+
   // Bytes available, try to transfer to the PluginVCCore
   //   intermediate buffer
   //
@@ -614,6 +622,11 @@ PluginVC::process_read_side(bool other_side_call)
     return;
   }
 
+  if (core_obj->direct_transfer) {
+    process_direct_transfer(ntodo);
+    return;
+  }
+
   int64_t bytes_avail = core_reader->read_avail();
   int64_t act_on = MIN(bytes_avail, ntodo);
 
@@ -671,6 +684,92 @@ PluginVC::process_read_side(bool other_side_call)
   }
 }
 
+// void PluginVC::process_direct_transfer(int64_t ntodo)
+//
+//   This function may only be called from process_read_side
+//      once it holds the read side continuation lock
+//
+//   Moves bytes from the other side's write buffer straight
+//      into our read buffer, and calls back the continuations
+//      on both sides
+//
+void
+PluginVC::process_direct_transfer(int64_t ntodo)
+{
+  PluginVCState & source = other_side->write_state;
+
+  if (other_side->closed || source.shutdown) {
+    read_state.vio._cont->handleEvent(VC_EVENT_EOS, &read_state.vio);
+    return;
+  }
+  // Until the other side sets up a write there is nothing
+  //   to take; its do_io_write will wake us up
+  if (source.vio.op != VIO::WRITE) {
+    return;
+  }
+
+  EThread *my_ethread = mutex->thread_holding;
+  MUTEX_TRY_LOCK(lock, source.vio.mutex, my_ethread);
+  if (!lock) {
+    Debug("pvc_event", "[%u] %s: process_direct_transfer lock miss, retrying", PVC_ID, PVC_TYPE);
+
+    need_read_process = true;
+    setup_event_cb(PVC_LOCK_RETRY_TIME, &core_lock_retry_event);
+    return;
+  }
+
+  IOBufferReader *source_reader = source.vio.get_reader();
+  int64_t act_on = MIN(ntodo, source.vio.ntodo());
+  act_on = MIN(act_on, source_reader->read_avail());
+
+  Debug("pvc", "[%u] %s: process_direct_transfer; act_on %" PRId64"", PVC_ID, PVC_TYPE, act_on);
+
+  if (act_on <= 0) {
+    return;
+  }
+
+  MIOBuffer *output_buffer = read_state.vio.get_writer();
+
+  int64_t water_mark = output_buffer->water_mark;
+  water_mark = MAX(water_mark, PVC_DEFAULT_MAX_BYTES);
+  int64_t buf_space = water_mark - output_buffer->max_read_avail();
+  if (buf_space <= 0) {
+    Debug("pvc", "[%u] %s: process_direct_transfer no buffer space", PVC_ID, PVC_TYPE);
+    return;
+  }
+  act_on = MIN(act_on, buf_space);
+
+  int64_t added = transfer_bytes(output_buffer, source_reader, act_on);
+  if (added <= 0) {
+    Debug("pvc", "[%u] %s: process_direct_transfer out of buffer space", PVC_ID, PVC_TYPE);
+    return;
+  }
+
+  read_state.vio.ndone += added;
+  source.vio.ndone += added;
+
+  Debug("pvc", "[%u] %s: process_direct_transfer; added %" PRId64"", PVC_ID, PVC_TYPE, added);
+
+  if (read_state.vio.ntodo() == 0) {
+    read_state.vio._cont->handleEvent(VC_EVENT_READ_COMPLETE, &read_state.vio);
+  } else {
+    read_state.vio._cont->handleEvent(VC_EVENT_READ_READY, &read_state.vio);
+  }
+
+  update_inactive_time();
+
+  // The bytes left the writer's buffer, so it gets the
+  //   write callback it would have had from its own side
+  if (!other_side->closed && source.vio.op == VIO::WRITE) {
+    if (source.vio.ntodo() == 0) {
+      source.vio._cont->handleEvent(VC_EVENT_WRITE_COMPLETE, &source.vio);
+    } else {
+      source.vio._cont->handleEvent(VC_EVENT_WRITE_READY, &source.vio);
+    }
+    other_side->update_inactive_time();
+  }
+}
+
 // void PluginVC::process_read_close()
 //
 //   This function may only be called while holding
@@ -969,17 +1068,21 @@ PluginVCCore::~PluginVCCore()
 }
 
 PluginVCCore *
-PluginVCCore::alloc()
+PluginVCCore::alloc(bool direct, ProxyMutex * shared_mutex)
 {
   PluginVCCore *pvc = NEW(new PluginVCCore);
-  pvc->init();
+  pvc->init(direct, shared_mutex);
   return pvc;
 }
 
 void
-PluginVCCore::init()
+PluginVCCore::init(bool direct, ProxyMutex * shared_mutex)
 {
-  mutex = new_ProxyMutex();
+  if (shared_mutex) {
+    mutex = shared_mutex;
+  } else {
+    mutex = new_ProxyMutex();
+  }
 
   active_vc.vc_type = PLUGIN_VC_ACTIVE;
   active_vc.other_side = &passive_vc;
@@ -993,13 +1096,17 @@ PluginVCCore::init()
   passive_vc.mutex = mutex;
   passive_vc.thread = active_vc.thread;
 
-  p_to_a_buffer = new_MIOBuffer(BUFFER_SIZE_INDEX_32K);
-  p_to_a_reader = p_to_a_buffer->alloc_reader();
+  direct_transfer = direct;
+  if (!direct_transfer) {
+    p_to_a_buffer = new_MIOBuffer(BUFFER_SIZE_INDEX_32K);
+    p_to_a_reader = p_to_a_buffer->alloc_reader();
 
-  a_to_p_buffer = new_MIOBuffer(BUFFER_SIZE_INDEX_32K);
-  a_to_p_reader = a_to_p_buffer->alloc_reader();
+    a_to_p_buffer = new_MIOBuffer(BUFFER_SIZE_INDEX_32K);
+    a_to_p_reader = a_to_p_buffer->alloc_reader();
+  }
 
-  Debug("pvc", "[%u] Created PluginVCCore at %p, active %p, passive %p", id, this, &active_vc, &passive_vc);
+  Debug("pvc", "[%u] Created %s%sPluginVCCore at %p, active %p, passive %p", id, direct_transfer ? "direct " : "",
+        shared_mutex ? "shared lock " : "", this, &active_vc, &passive_vc);
 }
 
 void
@@ -1203,17 +1310,19 @@ public:
   PVCTestDriver();
   ~PVCTestDriver();
 
-  void start_tests(RegressionTest * r_arg, int *pstatus_arg);
+  void start_tests(RegressionTest * r_arg, int *pstatus_arg, bool direct_arg = false, bool shared_arg = false);
   void run_next_test();
   int main_handler(int event, void *data);
 
 private:
   unsigned i;
   unsigned completions_received;
+  bool direct;
+  bool shared;
 };
 
 PVCTestDriver::PVCTestDriver():
-NetTestDriver(), i(0), completions_received(0)
+NetTestDriver(), i(0), completions_received(0), direct(false), shared(false)
 {
 }
 
@@ -1223,13 +1332,15 @@ PVCTestDriver::~PVCTestDriver()
 }
 
 void
-PVCTestDriver::start_tests(RegressionTest * r_arg, int *pstatus_arg)
+PVCTestDriver::start_tests(RegressionTest * r_arg, int *pstatus_arg, bool direct_arg, bool shared_arg)
 {
   mutex = new_ProxyMutex();
   MUTEX_TRY_LOCK(lock, mutex, this_ethread());
 
   r = r_arg;
   pstatus = pstatus_arg;
+  direct = direct_arg;
+  shared = shared_arg;
 
   run_next_test();
 
@@ -1260,7 +1371,10 @@ PVCTestDriver::run_next_test()
 
   NetVCTest *p = NEW(new NetVCTest);
   NetVCTest *a = NEW(new NetVCTest);
-  PluginVCCore *core = PluginVCCore::alloc();
+  // A shared core takes the driver's lock, which the test
+  //   continuations do not hold, so the lock retries still happen
+  //   between them and the core
+  PluginVCCore *core = PluginVCCore::alloc(direct, shared ? (ProxyMutex *) mutex : NULL);
   core->set_accept_cont(p);
 
   p->init_test(NET_VC_TEST_PASSIVE, this, NULL, r, &netvc_tests_def[p_index], "PluginVC", "pvc_test_detail");
@@ -1286,4 +1400,16 @@ EXCLUSIVE_REGRESSION_TEST(PVC) (RegressionTest * t, int /* atype ATS_UNUSED */,
   PVCTestDriver *driver = NEW(new PVCTestDriver);
   driver->start_tests(t, pstatus);
 }
+
+EXCLUSIVE_REGRESSION_TEST(PVC_Direct) (RegressionTest * t, int /* atype ATS_UNUSED */, int *pstatus)
+{
+  PVCTestDriver *driver = NEW(new PVCTestDriver);
+  driver->start_tests(t, pstatus, true);
+}
+
+EXCLUSIVE_REGRESSION_TEST(PVC_DirectShared) (RegressionTest * t, int /* atype ATS_UNUSED */, int *pstatus)
+{
+  PVCTestDriver *driver = NEW(new PVCTestDriver);
+  driver->start_tests(t, pstatus, true, true);
+}
 #endif
@@ -129,6 +129,7 @@ private:
 
   void setup_event_cb(ink_hrtime in, Event ** e_ptr);
 
+  void process_direct_transfer(int64_t ntodo);
   void update_inactive_time();
   int64_t transfer_bytes(MIOBuffer * transfer_to, IOBufferReader * transfer_from, int64_t act_on);
 
@@ -166,8 +167,18 @@ public:
     PluginVCCore();
    ~PluginVCCore();
 
-  static PluginVCCore *alloc();
-  void init();
+  // A direct core has no intermediate buffers: each side reads straight
+  //   out of the other side's write buffer, so bytes are handed over in
+  //   one step instead of two.  As with a network connection, bytes not yet
+  //   reported written are lost if the writer closes.
+  //
+  // Given a shared_mutex, normally that of the continuation that will
+  //   use the active side, the core and both its vcs take that mutex
+  //   instead of a new one.  The passive side's state machine takes its
+  //   vc's mutex as well, so everything runs under one lock and the lock
+  //   retries between the two sides go away.
+  static PluginVCCore *alloc(bool direct = false, ProxyMutex * shared_mutex = NULL);
+  void init(bool direct = false, ProxyMutex * shared_mutex = NULL);
   void set_accept_cont(Continuation * c);
 
   int state_send_accept(int event, void *data);
@@ -214,6 +225,7 @@ private:
   PluginVC passive_vc;
   Continuation *connect_to;
   bool connected;
+  bool direct_transfer;
 
   MIOBuffer *p_to_a_buffer;
   IOBufferReader *p_to_a_reader;
@@ -237,6 +249,7 @@ active_vc(),
 passive_vc(),
 connect_to(NULL),
 connected(false),
+direct_transfer(false),
 p_to_a_buffer(NULL),
 p_to_a_reader(NULL),
 a_to_p_buffer(NULL),
@@ -296,6 +296,81 @@ normalize_url(char *url, int *len)
 static PrefetchConfiguration *prefetch_config;
 ClassAllocator<PrefetchUrlEntry> prefetchUrlEntryAllocator("prefetchUrlEntryAllocator");
 
+#define PREFETCH_RECENT_HASHES 3
+
+/*
+  URLs recently prefetched for each child, in a Bloom filter. Pages of a
+  site share most of their embedded objects, a URL found again within
+  about proxy.config.prefetch.recent_urls others is not sent to the same
+  child again. The filter is kept in two generations, the older one is
+  cleared and becomes the current one when the current one is full.
+*/
+class PrefetchRecentUrls
+{
+public:
+  PrefetchRecentUrls(int n);
+  ~PrefetchRecentUrls();
+  // true if the URL was sent to the child recently, adds it otherwise
+  bool check_and_add(INK_MD5 const &md5, IpEndpoint const &child);
+
+private:
+  int nbits;
+  int limit;
+  uint8_t *bits[2];
+  volatile int cur;
+  volatile int count;
+};
+
+PrefetchRecentUrls::PrefetchRecentUrls(int n)
+  : limit(n), cur(0), count(0)
+{
+  // 8 bits per URL, about 3% of new URLs are taken for recent ones
+  nbits = n * 8;
+  for (int g = 0; g < 2; g++)
+    bits[g] = (uint8_t *) ats_calloc(nbits / 8, 1);
+}
+
+PrefetchRecentUrls::~PrefetchRecentUrls()
+{
+  ats_free(bits[0]);
+  ats_free(bits[1]);
+}
+
+bool
+PrefetchRecentUrls::check_and_add(INK_MD5 const &md5, IpEndpoint const &child)
+{
+  uint32_t h = ats_ip_hash(&child.sa);
+  int g = cur;
+  uint32_t pos[PREFETCH_RECENT_HASHES];
+  bool seen = true;
+
+  for (int i = 0; i < PREFETCH_RECENT_HASHES; i++) {
+    pos[i] = (md5.u32[i] ^ h) % nbits;
+    if (!(bits[g][pos[i] >> 3] & (1 << (pos[i] & 7))) && !(bits[g ^ 1][pos[i] >> 3] & (1 << (pos[i] & 7))))
+      seen = false;
+  }
+  if (seen)
+    return true;
+
+  for (int i = 0; i < PREFETCH_RECENT_HASHES; i++) {
+    volatile uint8_t *b = &bits[g][pos[i] >> 3];
+    uint8_t mask = 1 << (pos[i] & 7), old;
+
+    // transforms on all the threads add URLs
+    while (!((old = *b) & mask) && !ink_atomic_cas(b, old, (uint8_t) (old | mask)))
+      ;
+  }
+  if (ink_atomic_increment(&count, 1) == limit) {
+    // losing a few URLs while the generations turn over only costs prefetches
+    memset(bits[g ^ 1], 0, nbits / 8);
+    cur = g ^ 1;
+    count = 0;
+  }
+  return false;
+}
+
+static PrefetchRecentUrls *prefetch_recent_urls = NULL;
+
 #define IS_STATUS_REDIRECT(status) (prefetch_config->redirection > 0 &&\
 				       (((status) == HTTP_STATUS_MOVED_PERMANENTLY) ||\
                                         ((status) == HTTP_STATUS_MOVED_TEMPORARILY) ||\
@@ -623,6 +698,11 @@ PrefetchTransform::parse_data(IOBufferReader *reader)
     //Debug("PrefetchParserURLs", "Found embedded URL: %s", url_start);
     ats_ip_copy(&entry->req_ip, &m_sm->t_state.client_info.addr);
 
+    if (prefetch_recent_urls && prefetch_recent_urls->check_and_add(entry->md5, entry->req_ip)) {
+      Debug("PrefetchParserURLs", "Recently prefetched URL: %s", url_start);
+      continue;
+    }
+
     PrefetchBlaster *blaster = prefetchBlasterAllocator.alloc();
     blaster->init(entry, &m_sm->t_state.hdr_info.client_request, this);
   }
@@ -833,6 +913,11 @@ PrefetchProcessor::start()
 
     udp_seq_no = this_ethread()->generator.random();
 
+    int recent_urls = 0;
+    REC_ReadConfigInteger(recent_urls, "proxy.config.prefetch.recent_urls");
+    if (recent_urls > 0)
+      prefetch_recent_urls = NEW(new PrefetchRecentUrls(recent_urls));
+
     prefetch_udp_fd = socketManager.socket(PF_INET, SOCK_DGRAM, 0);
 
     TSCont contp = TSContCreate(PrefetchPlugin, NULL);
@@ -176,9 +176,10 @@ void
 reloadUrlRewrite()
 {
   UrlRewrite *newTable;
+  ConfigReloadTimer timer("remap.config");
 
   Debug("url_rewrite", "remap.config updated, reloading...");
-  newTable = new UrlRewrite("proxy.config.url_remap.filename");
+  newTable = new UrlRewrite("proxy.config.url_remap.filename", rewrite_table);
   if (newTable->is_valid()) {
     eventProcessor.schedule_in(new UR_FreerContinuation(rewrite_table), URL_REWRITE_TIMEOUT, ET_TASK);
     Debug("url_rewrite", "remap.config done reloading!");
@@ -0,0 +1,145 @@
+/** @file
+
+  Timed, and possibly concurrent, phases of traffic_server start up.
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#include "StartupPhase.h"
+#include "P_EventSystem.h"
+
+#define STARTUP_PHASES_MAX 32
+
+struct StartupRecord
+{
+  const char *name;
+  ink_hrtime elapsed;
+  ink_hrtime waited;            // by the main thread, for a parallel phase
+  bool parallel;
+};
+
+static ink_hrtime startup_begin = ink_get_hrtime_internal();
+static StartupRecord startup_records[STARTUP_PHASES_MAX];
+static int startup_nrecords = 0;
+static ink_mutex startup_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+StartupTimer::StartupTimer(const char *aname, bool aparallel)
+  : name(aname), parallel(aparallel), start(ink_get_hrtime_internal())
+{
+}
+
+StartupTimer::~StartupTimer()
+{
+  ink_hrtime elapsed = ink_get_hrtime_internal() - start;
+
+  Debug("startup", "%s took %.3f seconds", name, (double) elapsed / HRTIME_SECOND);
+
+  ink_mutex_acquire(&startup_mutex);
+  if (startup_nrecords < STARTUP_PHASES_MAX) {
+    StartupRecord *r = &startup_records[startup_nrecords++];
+    r->name = name;
+    r->elapsed = elapsed;
+    r->waited = 0;
+    r->parallel = parallel;
+  }
+  ink_mutex_release(&startup_mutex);
+}
+
+StartupPhase::StartupPhase(const char *aname, Func afunc)
+  : name(aname), func(afunc), thread(0), started(false)
+{
+}
+
+void *
+StartupPhase::thread_main(void *arg)
+{
+  StartupPhase *phase = (StartupPhase *) arg;
+
+  // Like the main thread, give the phase an EThread for whatever it calls that expects one. It
+  // is not deleted, as mutexes and allocators the phase used may still refer to it.
+  Thread *t = NEW(new EThread);
+  t->set_specific();
+
+  {
+    StartupTimer timer(phase->name, true);
+    phase->func();
+  }
+  return NULL;
+}
+
+void
+StartupPhase::start(size_t stacksize)
+{
+  int parallel = 1;
+
+  ink_assert(!started);
+  started = true;
+
+  REC_ReadConfigInteger(parallel, "proxy.config.startup.parallel_init");
+  if (parallel) {
+    Debug("startup", "starting %s", name);
+    thread = ink_thread_create(thread_main, this, 0, stacksize);
+    if (thread)
+      return;
+    Warning("unable to start a thread for %s, running it in line", name);
+  }
+
+  StartupTimer timer(name);
+  func();
+}
+
+void
+StartupPhase::wait()
+{
+  if (!started || !thread)
+    return;
+
+  ink_hrtime begin = ink_get_hrtime_internal();
+  ink_thread_join(thread);
+  thread = 0;
+  ink_hrtime waited = ink_get_hrtime_internal() - begin;
+
+  ink_mutex_acquire(&startup_mutex);
+  for (int i = 0; i < startup_nrecords; i++) {
+    if (startup_records[i].name == name)
+      startup_records[i].waited = waited;
+  }
+  ink_mutex_release(&startup_mutex);
+}
+
+void
+startup_phase_report()
+{
+  ink_hrtime total = ink_get_hrtime_internal() - startup_begin;
+
+  ink_mutex_acquire(&startup_mutex);
+  for (int i = 0; i < startup_nrecords; i++) {
+    StartupRecord *r = &startup_records[i];
+
+    if (r->parallel) {
+      Note("startup: %s took %.3f seconds in parallel, %.3f seconds waited for", r->name,
+           (double) r->elapsed / HRTIME_SECOND, (double) r->waited / HRTIME_SECOND);
+    } else {
+      Note("startup: %s took %.3f seconds", r->name, (double) r->elapsed / HRTIME_SECOND);
+    }
+  }
+  ink_mutex_release(&startup_mutex);
+
+  Note("startup: ready %.3f seconds after the process started", (double) total / HRTIME_SECOND);
+}
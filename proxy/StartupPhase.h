@@ -0,0 +1,72 @@
+/** @file
+
+  Timed, and possibly concurrent, phases of traffic_server start up.
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#ifndef __STARTUP_PHASE_H__
+#define __STARTUP_PHASE_H__
+
+#include "libts.h"
+
+/**
+  Times a step of start up on the calling thread, from construction to
+  destruction, for the report written by startup_phase_report().
+*/
+struct StartupTimer
+{
+  StartupTimer(const char *name, bool parallel = false);
+  ~StartupTimer();
+
+  const char *name;
+  bool parallel;
+  ink_hrtime start;
+};
+
+/**
+  A step of start up that nothing done before its wait() depends on, so
+  that it can run on a thread of its own while the main thread carries on
+  with other steps. The phase is timed as a StartupTimer.
+*/
+class StartupPhase
+{
+public:
+  typedef void (*Func) ();
+
+  StartupPhase(const char *name, Func func);
+
+  /// Run the phase on a new thread, or on this thread if proxy.config.startup.parallel_init is off.
+  void start(size_t stacksize);
+  /// Return once the phase is done; the time spent waiting is reported with the phase.
+  void wait();
+
+private:
+  static void *thread_main(void *arg);
+
+  const char *name;
+  Func func;
+  ink_thread thread;
+  bool started;
+};
+
+/// Note the time each phase of start up took, and since the process started.
+void startup_phase_report();
+
+#endif /* __STARTUP_PHASE_H__ */
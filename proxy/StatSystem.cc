@@ -35,6 +35,8 @@
 #include "StatPages.h"
 #include "HTTP.h"
 #include "I_Layout.h"
+#include <cxxabi.h>
+#include <dlfcn.h>
 
 // defines
 
@@ -443,6 +445,163 @@ stat_callback(Continuation * cont, HTTPHdr * header)
   return ACTION_RESULT_DONE;
 }
 
+// http://{metrics}/prometheus and http://{metrics}/binary, either of
+// them with ?since=<version> for the stats that changed after it.
+static Action *
+metrics_callback(Continuation * cont, HTTPHdr * header)
+{
+  URL *url = header->url_get();
+  int length, query_len;
+  const char *path = url->path_get(&length);
+  const char *query = url->query_get(&query_len);
+  RecStatExportFormat format;
+  int64_t since = 0;
+
+  if (ptr_len_cmp(path, length, "prometheus", 10) == 0) {
+    format = REC_STAT_EXPORT_PROMETHEUS;
+  } else if (ptr_len_cmp(path, length, "binary", 6) == 0) {
+    format = REC_STAT_EXPORT_BINARY;
+  } else {
+    cont->handleEvent(STAT_PAGE_FAILURE, NULL);
+    return ACTION_RESULT_DONE;
+  }
+
+  if (query && query_len > 6 && query_len < 32 && strncmp(query, "since=", 6) == 0) {
+    char version[32];
+
+    memcpy(version, query + 6, query_len - 6);
+    version[query_len - 6] = '\0';
+    since = ink_atoi64(version);
+  }
+
+  Ptr<RecStatSnapshot> snap = RecStatSnapshotGet();
+
+  if (!snap) {
+    cont->handleEvent(STAT_PAGE_FAILURE, NULL);
+    return ACTION_RESULT_DONE;
+  }
+
+  StatPageData data;
+
+  data.data = RecStatSnapshotExport(snap, format, since, &data.length);
+  if (format == REC_STAT_EXPORT_PROMETHEUS)
+    data.type = ats_strdup("text/plain; version=0.0.4");
+  else
+    data.type = ats_strdup("application/octet-stream");
+  cont->handleEvent(STAT_PAGE_SUCCESS, &data);
+
+  return ACTION_RESULT_DONE;
+}
+
+static int
+event_profile_cmp(const void *a, const void *b)
+{
+  int64_t x = ((const EventProfileEntry *)a)->cycles, y = ((const EventProfileEntry *)b)->cycles;
+  return x < y ? 1 : x > y ? -1 : 0;
+}
+
+static int
+event_profile_escape(char *buf, int size, const char *s)
+{
+  int len = 0;
+
+  for (; *s && len < size - 6; s++) {
+    if (*s == '<')
+      len += snprintf(buf + len, size - len, "&lt;");
+    else if (*s == '>')
+      len += snprintf(buf + len, size - len, "&gt;");
+    else if (*s == '&')
+      len += snprintf(buf + len, size - len, "&amp;");
+    else
+      buf[len++] = *s;
+  }
+  buf[len] = 0;
+  return len;
+}
+
+// http://{events}/?top=<n>, the handlers which took the most time on
+// each event thread, from proxy.config.exec_thread.profile.sample
+static Action *
+event_profile_callback(Continuation * cont, HTTPHdr * header)
+{
+  int query_len;
+  const char *query = header->url_get()->query_get(&query_len);
+  int top = 20;
+
+  if (query && query_len > 4 && query_len < 16 && strncmp(query, "top=", 4) == 0) {
+    char n[16];
+
+    memcpy(n, query + 4, query_len - 4);
+    n[query_len - 4] = '\0';
+    top = atoi(n);
+    if (top <= 0 || top > EVENT_PROFILE_ENTRIES)
+      top = 20;
+  }
+
+  int size = 1024 + eventProcessor.n_ethreads * (512 + top * 1024);
+  char *buffer = (char *)ats_malloc(size);
+  EventProfileEntry *entries = (EventProfileEntry *)ats_malloc(sizeof(EventProfileEntry) * EVENT_PROFILE_ENTRIES);
+  int64_t per_usec = event_profile_cycles_per_usec;
+  int len;
+
+  len = snprintf(buffer, size, "<H3>Event handlers</H3>\n<p>Sampling one in %d calls, slow at %d msec.</p>\n",
+                 event_profile_sample, event_profile_slow_msec);
+  for (int i = 0; i < eventProcessor.n_ethreads; i++) {
+    EThread *t = eventProcessor.all_ethreads[i];
+    EventProfile *p = t->profile;
+    int n = 0;
+
+    if (!p)
+      continue;
+    for (int j = 0; j < EVENT_PROFILE_ENTRIES; j++)
+      if (p->entries[j].type)
+        entries[n++] = p->entries[j];
+    qsort(entries, n, sizeof(EventProfileEntry), event_profile_cmp);
+
+    len += snprintf(buffer + len, size - len, "<H4>Thread %d</H4>\n<p>%" PRId64 " slow, %" PRId64 " samples dropped</p>\n"
+                    "<table border=1><tr><th>Continuation</th><th>Handler</th><th>Calls</th><th>Total msec</th>"
+                    "<th>Average usec</th><th>Max usec</th><th>Slow</th></tr>\n", t->id, p->slow, p->dropped);
+    for (int j = 0; j < n && j < top; j++) {
+      EventProfileEntry *e = &entries[j];
+      char type[256], handler[256], sym[64];
+      int status;
+      char *demangled = abi::__cxa_demangle(e->type->name(), NULL, NULL, &status);
+      const char *hname = e->name;
+      Dl_info info;
+
+      event_profile_escape(type, sizeof(type), demangled ? demangled : e->type->name());
+      ats_free(demangled);
+      demangled = NULL;
+      // a virtual handler is an odd vtable offset rather than a function
+      if (!hname && !((uintptr_t) e->handler & 1) && dladdr(e->handler, &info) && info.dli_sname) {
+        demangled = abi::__cxa_demangle(info.dli_sname, NULL, NULL, &status);
+        hname = demangled ? demangled : info.dli_sname;
+      }
+      if (!hname) {
+        snprintf(sym, sizeof(sym), "%p", e->handler);
+        hname = sym;
+      }
+      event_profile_escape(handler, sizeof(handler), hname);
+      ats_free(demangled);
+
+      len += snprintf(buffer + len, size - len, "<tr><td>%s</td><td>%s</td><td>%" PRId64 "</td><td>%" PRId64 "</td>"
+                      "<td>%" PRId64 "</td><td>%" PRId64 "</td><td>%" PRId64 "</td></tr>\n", type, handler, e->calls,
+                      e->cycles / per_usec / 1000, e->calls ? e->cycles / per_usec / e->calls : 0, e->max_cycles / per_usec,
+                      e->slow);
+    }
+    len += snprintf(buffer + len, size - len, "</table>\n");
+  }
+  ats_free(entries);
+
+  StatPageData data;
+
+  data.data = buffer;
+  data.length = len;
+  cont->handleEvent(STAT_PAGE_SUCCESS, &data);
+
+  return ACTION_RESULT_DONE;
+}
+
 static Action *
 testpage_callback(Continuation * cont, HTTPHdr *)
 {
@@ -496,7 +655,13 @@ initialize_all_global_stats()
 
   statPagesManager.register_http("stat", stat_callback);
 
+  if (REC_ConfigReadInteger("proxy.config.stats.export_enabled")) {
+    RecStatSnapshotEnable();
+    statPagesManager.register_http("metrics", metrics_callback);
+  }
+
   testpage_callback_init();
+  statPagesManager.register_http("events", event_profile_callback);
 
   read_stats_snap();
   rusage_snap_mutex = new_ProxyMutex();
@@ -53,7 +53,7 @@ public:
     : ua_begin(0), ua_read_header_done(0), ua_begin_write(0), ua_close(0), server_first_connect(0), server_connect(0),
       server_connect_end(0), server_begin_write(0), server_first_read(0), server_read_header_done(0), server_close(0),
       cache_open_read_begin(0), cache_open_read_end(0), cache_open_write_begin(0), cache_open_write_end(0),
-      dns_lookup_begin(0), dns_lookup_end(0), sm_start(0), sm_finish(0)
+      dns_lookup_begin(0), dns_lookup_end(0), sm_start(0), sm_finish(0), plugin_total(0)
       { }
 
 
@@ -95,6 +95,11 @@ public:
   ink_hrtime sm_start;
   ink_hrtime sm_finish;
 
+  // Not a time stamp: the time spent in plugin hook callouts, from the
+  // first plugin called at a hook until the transaction is reenabled,
+  // summed over all of the hooks.
+  ink_hrtime plugin_total;
+
   // TODO: Should we instrument these at some point?
   // ink_hrtime  cache_read_begin;
   // ink_hrtime  cache_read_end;
@@ -80,11 +80,31 @@ TransformProcessor transformProcessor;
 void
 TransformProcessor::start()
 {
+  REC_ReadConfigInteger(task_queue_limit, "proxy.config.transform.task_queue_limit");
 #ifdef PREFETCH
   prefetchProcessor.start();
 #endif
 }
 
+/*-------------------------------------------------------------------------
+  -------------------------------------------------------------------------*/
+
+bool
+TransformProcessor::task_slot_acquire()
+{
+  if (ink_atomic_increment(&task_queued, 1) >= task_queue_limit) {
+    ink_atomic_increment(&task_queued, -1);
+    return false;
+  }
+  return true;
+}
+
+void
+TransformProcessor::task_slot_release()
+{
+  ink_atomic_increment(&task_queued, -1);
+}
+
 /*-------------------------------------------------------------------------
   -------------------------------------------------------------------------*/
 
@@ -112,9 +132,9 @@ TransformProcessor::null_transform(ProxyMutex *mutex)
   -------------------------------------------------------------------------*/
 
 INKVConnInternal *
-TransformProcessor::range_transform(ProxyMutex *mut, RangeRecord *ranges, int num_fields, HTTPHdr *transform_resp, const char * content_type, int content_type_len, int64_t content_length)
+TransformProcessor::range_transform(ProxyMutex *mut, RangeRecord *ranges, int num_fields, HTTPHdr *transform_resp, const char * content_type, int content_type_len, int64_t content_length, bool pread)
 {
-  RangeTransform *range_transform = NEW(new RangeTransform(mut, ranges, num_fields, transform_resp, content_type, content_type_len, content_length));
+  RangeTransform *range_transform = NEW(new RangeTransform(mut, ranges, num_fields, transform_resp, content_type, content_type_len, content_length, pread));
   return range_transform;
 }
 
@@ -747,7 +767,7 @@ TransformTest::run()
 /*-------------------------------------------------------------------------
   -------------------------------------------------------------------------*/
 
-RangeTransform::RangeTransform(ProxyMutex *mut, RangeRecord *ranges, int num_fields, HTTPHdr * transform_resp, const char * content_type, int content_type_len, int64_t content_length)
+RangeTransform::RangeTransform(ProxyMutex *mut, RangeRecord *ranges, int num_fields, HTTPHdr * transform_resp, const char * content_type, int content_type_len, int64_t content_length, bool pread)
   : INKVConnInternal(NULL, reinterpret_cast<TSMutex>(mut)),
   m_output_buf(NULL),
   m_output_reader(NULL),
@@ -755,10 +775,17 @@ RangeTransform::RangeTransform(ProxyMutex *mut, RangeRecord *ranges, int num_fie
   m_output_vio(NULL),
   m_range_content_length(0),
   m_num_range_fields(num_fields),
-  m_current_range(0), m_content_type(content_type), m_content_type_len(content_type_len), m_ranges(ranges), m_output_cl(content_length), m_done(0)
+  m_current_range(0), m_content_type(content_type), m_content_type_len(content_type_len), m_ranges(ranges), m_output_cl(content_length), m_done(0), m_pread(pread)
 {
   SET_HANDLER(&RangeTransform::handle_event);
 
+  // The cache already skipped everything outside the ranges, so there
+  // is nothing before the start of any range left to skip.
+  if (m_pread) {
+    for (int i = 0; i < m_num_range_fields; i++)
+      m_ranges[i]._done_byte = m_ranges[i]._start - 1;
+  }
+
   m_num_chars_for_cl = num_chars_for_int(m_range_content_length);
   Debug("http_trans", "RangeTransform creation finishes");
 }
@@ -924,7 +951,8 @@ RangeTransform::transform_to_range()
         // not need to go back to the start of the IOBuffereReader.
         // Otherwise, reset the IOBufferReader.
         //if ( *start > prev_end )
-        *done_byte = prev_end;
+        if (!m_pread)
+          *done_byte = prev_end;
         //else
         //  reader->reset();
 
@@ -44,12 +44,30 @@ typedef struct _RangeRecord
 class TransformProcessor
 {
 public:
+  TransformProcessor() : task_queue_limit(0), task_queued(0) { }
+
   void start();
 
 public:
   VConnection * open(Continuation * cont, APIHook * hooks);
   INKVConnInternal *null_transform(ProxyMutex * mutex);
-  INKVConnInternal *range_transform(ProxyMutex * mutex, RangeRecord * ranges, int, HTTPHdr *, const char * content_type, int content_type_len, int64_t content_length);
+  INKVConnInternal *range_transform(ProxyMutex * mutex, RangeRecord * ranges, int, HTTPHdr *, const char * content_type, int content_type_len, int64_t content_length, bool pread = false);
+
+  /** Bound the number of transform events queued on the task threads.
+      A transform that asked to run on the task threads (see
+      TSTransformThreadPoolSet) reserves a slot for each event it
+      schedules there, and releases it once the event is dispatched.
+      When no slot is available the event is handled on a net thread
+      instead, so a burst of CPU heavy transforms cannot build an
+      unbounded backlog behind the task threads.
+
+      @return @c true if a slot was reserved.
+  */
+  bool task_slot_acquire();
+  void task_slot_release();
+
+  int task_queue_limit;         ///< proxy.config.transform.task_queue_limit, 0 disables offloading.
+  volatile int task_queued;
 };
 
 #ifdef TS_HAS_TESTS
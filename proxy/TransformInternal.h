@@ -120,7 +120,7 @@ public:
 class RangeTransform:public INKVConnInternal
 {
 public:
-  RangeTransform(ProxyMutex * mutex, RangeRecord * ranges, int num_fields, HTTPHdr *transform_resp, const char * content_type, int content_type_len, int64_t content_length);
+  RangeTransform(ProxyMutex * mutex, RangeRecord * ranges, int num_fields, HTTPHdr *transform_resp, const char * content_type, int content_type_len, int64_t content_length, bool pread);
   ~RangeTransform();
 
   // void parse_range_and_compare();
@@ -149,7 +149,7 @@ public:
   RangeRecord *m_ranges;
   int64_t m_output_cl;
   int64_t m_done;
-  
+  bool m_pread;                 // the input is only the bytes of the ranges
 };
 
 #define PREFETCH
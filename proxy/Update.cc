@@ -141,6 +141,12 @@ struct schemes_descriptor supported_proto_schemes[] = {
 
 static int global_id = 1;
 
+// The top level UpdateScheduler and one for each recursive update in
+// progress, they share the concurrent updates between them.
+static volatile int update_active_schedulers = 1;
+// Update SMs running, the stat is only summed up periodically.
+static volatile int update_active_state_machines = 0;
+
 void
 init_proto_schemes()
 {
@@ -226,7 +232,8 @@ UpdateEntry::UpdateEntry():_group_link(0), _hash_link(0), _id(0), _url(0),
 _URLhandle(), _terminal_url(0),
 _request_headers(0), _num_request_headers(0),
 _http_hdr(0),
-_offset_hour(0), _interval(0), _max_depth(0), _start_time(0), _expired(0), _scheme_index(-1), _update_event_status(0)
+_offset_hour(0), _interval(0), _max_depth(0), _start_time(0), _expired(0), _scheme_index(-1), _update_event_status(0),
+_update_started(0), _urls_done(0), _urls_failed(0)
 {
   http_parser_init(&_http_parser);
 }
@@ -1115,7 +1122,10 @@ UpdateScheduler::Init(UpdateScheduler * us, UpdateEntry * ue, Ptr<UpdateConfigPa
   while ((e = _CL->Remove())) {
     _CL->AddPending(e);
   }
+  ink_atomic_increment(&update_active_schedulers, 1);
   _periodic_event = eventProcessor.schedule_every(this, HRTIME_SECONDS(10));
+  // start on the list now rather than at the first periodic event
+  eventProcessor.schedule_in(this, HRTIME_MSECONDS(10));
   return 0;
 }
 
@@ -1180,7 +1190,18 @@ UpdateScheduler::ScheduleEvent(int event, void *e)
     }                           // End of switch
 
     if (update_complete) {
+      UpdateEntry *base = _recursive_update ? _base_EN : ue;
+
+      if (ue->_update_event_status == UPDATE_EVENT_FAILED) {
+        ++base->_urls_failed;
+      } else {
+        ++base->_urls_done;
+      }
       if (!_recursive_update) {
+        Note("update id: %d [%s] complete in %.1f seconds, %d URLs updated, %d failed",
+             ue->_id, ue->_url, (double) (ink_get_hrtime() - ue->_update_started) / HRTIME_SECOND,
+             ue->_urls_done, ue->_urls_failed);
+
         /////////////////////////////////////////////////////////
         // Recompute expire time and place entry back on list
         /////////////////////////////////////////////////////////
@@ -1193,13 +1214,16 @@ UpdateScheduler::ScheduleEvent(int event, void *e)
       }
       --_update_state_machines;
       UPDATE_DECREMENT_DYN_STAT(update_state_machines_stat);
+      ink_atomic_increment(&update_active_state_machines, -1);
     }
     ////////////////////////////////////////////////////////////////
-    // Start another update SM if scheduling is allowed
-    // and an entry exists on the pending list.
+    // Start update SM(s) while scheduling is allowed
+    // and entries exist on the pending list.
     ////////////////////////////////////////////////////////////////
 
-    if (Schedule() < 0) {
+    int scheduled;
+    while ((scheduled = Schedule()) > 0);
+    if (scheduled < 0) {
       // Scheduling allowed, but nothing to schedule
       if (_update_state_machines == 0) {
         //////////////////////////////////////////////////////////////
@@ -1268,7 +1292,7 @@ UpdateScheduler::ScheduleEvent(int event, void *e)
     // additional update SM(s).
     ///////////////////////////////////////////////////////////////////
 
-    Schedule();
+    while (Schedule() > 0);
     return EVENT_CONT;
   }
   ink_release_assert(!_update_state_machines);
@@ -1322,6 +1346,7 @@ UpdateScheduler::ChildExitEventHandler(int event, Event * /* e ATS_UNUSED */)
       MUTEX_TRY_LOCK(lock, _parent_US->mutex, this_ethread());
       if (lock) {
         Debug("update", "Child UpdateScheduler exit id: %d", _base_EN->_id);
+        ink_atomic_increment(&update_active_schedulers, -1);
         _parent_US->handleEvent(EVENT_IMMEDIATE, _base_EN);
         delete this;
 
@@ -1350,22 +1375,34 @@ UpdateScheduler::Schedule(UpdateEntry * e)
   UpdateSM *usm;
   UpdateEntry *ue = e;
   int allow_schedule;
-  RecInt count, sum;
   int max_concurrent_updates;
 
-  UPDATE_READ_DYN_STAT(update_state_machines_stat, count, sum);
   if (_CP->ConcurrentUpdates() < _CP->MaxUpdateSM()) {
     max_concurrent_updates = _CP->ConcurrentUpdates();
   } else {
     max_concurrent_updates = _CP->MaxUpdateSM();
   }
-  allow_schedule = (sum < max_concurrent_updates);
+  // Each scheduler is allowed its share of the concurrent updates, and
+  // more while that still leaves one for each of the others, so that a
+  // large recursive update does not hold up the other entries.
+  int running = update_active_state_machines;
+  int schedulers = update_active_schedulers;
+  int share = max_concurrent_updates / schedulers;
+  if (share < 1)
+    share = 1;
+  allow_schedule = (running < max_concurrent_updates) &&
+    ((_update_state_machines < share) || (running + schedulers - 1 < max_concurrent_updates));
 
   if (allow_schedule) {
     ue = ue ? ue : _CL->RemovePending();
     if (ue) {
+      if (!_recursive_update) {
+        ue->_update_started = ink_get_hrtime();
+        ue->_urls_done = ue->_urls_failed = 0;
+      }
       ++_update_state_machines;
       UPDATE_INCREMENT_DYN_STAT(update_state_machines_stat);
+      ink_atomic_increment(&update_active_state_machines, 1);
       usm = NEW(new UpdateSM(this, _CP, ue));
       usm->Start();
 
@@ -1834,11 +1871,16 @@ HtmlParser::ScanHtmlForURL(IOBufferReader * r, char **url, char **url_end)
       }
     case SCAN_START:
       {
-        while ((n = r->read((char *) &c, 1))) {
-          if (c == '<') {
+        // skip the text up to the next tag a block at a time
+        while ((n = MIN(r->block_read_avail(), r->read_avail()))) {
+          char *start = r->start();
+          char *lt = (char *) memchr(start, '<', n);
+          if (lt) {
+            r->consume(lt - start + 1);
             _scan_state = FIND_TAG_START;
             break;
           }
+          r->consume(n);
         }
         break;
       }
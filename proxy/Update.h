@@ -187,6 +187,14 @@ public:
   int _scheme_index;
   int _update_event_status;
 
+  //////////////////////////////////
+  // Completion of the last update,
+  // with the URLs derived from it
+  //////////////////////////////////
+  ink_hrtime _update_started;
+  int _urls_done;
+  int _urls_failed;
+
     Ptr<UpdateConfigList> _indirect_list;
 };
 
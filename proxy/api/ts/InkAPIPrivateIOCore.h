@@ -40,6 +40,8 @@ enum INKContInternalMagic_t
   INKCONT_INTERN_MAGIC_DEAD = 0xDEAD9631
 };
 
+struct PluginHookStats;
+
 class INKContInternal:public DummyVConnection
 {
 public:
@@ -61,6 +63,8 @@ public:
   int m_deleted;
   //INKqa07670: Nokia memory leak bug fix
   INKContInternalMagic_t m_free_magic;
+  /// The plugin which created this, for the hook timing stats.
+  PluginHookStats *m_plugin;
 };
 
 
@@ -93,10 +97,18 @@ public:
   bool get_data(int id, void *data);
   bool set_data(int id, void *data);
 
+  /// Handle this VConnection's events on threads of type @a etype.
+  void set_event_type(EventType etype) { m_event_type = etype; }
+
+private:
+  void schedule_imm_event();
+
 public:
     VIO m_read_vio;
   VIO m_write_vio;
   VConnection *m_output_vc;
+  EventType m_event_type;
+  volatile int m_task_events;   ///< events holding a transformProcessor task slot.
 };
 
 /****************************************************************
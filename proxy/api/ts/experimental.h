@@ -56,6 +56,14 @@ extern "C"
   tsapi time_t TSCacheHttpInfoRespReceivedTimeGet(TSCacheHttpInfo infop);
   int64_t TSCacheHttpInfoSizeGet(TSCacheHttpInfo infop);
 
+  /* Invalidate every cached object of a host under a URL path prefix, or
+     with a tag in proxy.config.http.cache.invalidate_tag_header.  A prefix
+     ending in '/' covers the objects below it, "/" the whole host, and any
+     other prefix one exact path.  Objects cached up to now are treated as
+     misses from then on. */
+  tsapi TSReturnCode TSCacheInvalidatePrefix(const char *host, int host_len, const char *prefix, int prefix_len);
+  tsapi TSReturnCode TSCacheInvalidateTag(const char *tag, int tag_len);
+
   /* Do not edit these apis, used internally */
   tsapi int TSMimeHdrFieldEqual(TSMBuffer bufp, TSMLoc hdr_obj, TSMLoc field1, TSMLoc field2);
   tsapi TSReturnCode TSHttpTxnHookRegisteredFor(TSHttpTxn txnp, TSHttpHookID id, TSEventFunc funcp);
@@ -1502,6 +1502,77 @@ HTTPHdr::set_url_target_from_host_field(URL* url) {
   }
 }
 
+/*-------------------------------------------------------------------------
+  -------------------------------------------------------------------------*/
+
+const char *
+HTTPCookieMap::get(HTTPHdr *hdr, const char *name, int name_len, int *value_len)
+{
+  MIMEField *field = hdr->valid() ? hdr->field_find(MIME_FIELD_COOKIE, MIME_LEN_COOKIE) : NULL;
+  uintptr_t sig = 0;
+  MIMEField *f;
+
+  // a changed value is a new string in the heap, and moving the strings
+  // of the heap moves them all
+  for (f = field; f; f = f->m_next_dup)
+    sig = sig * 31 + (uintptr_t) f->m_ptr_value + f->m_len_value;
+  if (hdr->m_heap != m_heap || sig != m_fields_sig) {
+    m_heap = hdr->m_heap;
+    m_fields_sig = sig;
+    m_count = 0;
+    for (f = field; f; f = f->m_next_dup)
+      parse(f->m_ptr_value, f->m_len_value);
+  }
+
+  for (int i = 0; i < m_count; i++) {
+    if (m_cookies[i].name_len == name_len && !memcmp(m_cookies[i].name, name, name_len)) {
+      *value_len = m_cookies[i].value_len;
+      return m_cookies[i].value;
+    }
+  }
+  return NULL;
+}
+
+void
+HTTPCookieMap::parse(const char *str, int len)
+{
+  const char *end = str + len;
+
+  while (str < end && m_count < MAX_COOKIES) {
+    const char *pair_end = (const char *) memchr(str, ';', end - str);
+    if (!pair_end)
+      pair_end = end;
+
+    const char *name = str;
+    while (name < pair_end && ParseRules::is_ws(*name))
+      ++name;
+    const char *eq = (const char *) memchr(name, '=', pair_end - name);
+    const char *name_end = eq ? eq : pair_end;
+    while (name_end > name && ParseRules::is_ws(name_end[-1]))
+      --name_end;
+
+    if (name_end > name) {
+      Cookie *c = &m_cookies[m_count++];
+      const char *value = eq ? eq + 1 : pair_end;
+      const char *value_end = pair_end;
+
+      while (value < value_end && ParseRules::is_ws(*value))
+        ++value;
+      while (value_end > value && ParseRules::is_ws(value_end[-1]))
+        --value_end;
+      if (value_end - value >= 2 && *value == '"' && value_end[-1] == '"') {
+        ++value;
+        --value_end;
+      }
+      c->name = name;
+      c->name_len = name_end - name;
+      c->value = value;
+      c->value_len = value_end - value;
+    }
+    str = pair_end + 1;
+  }
+}
+
 // Very ugly, but a proper implementation will require
 // rewriting the URL class and all of its clients so that
 // clients access the URL through the HTTP header instance
@@ -1795,11 +1866,15 @@ HTTPInfo::marshal_length()
 {
   int len = HTTP_ALT_MARSHAL_SIZE;
 
+  // Every marshal is preceded by this, so it's where we tighten the
+  //   heaps, before their size is taken
   if (m_alt->m_request_hdr.valid()) {
+    m_alt->m_request_hdr.m_heap->compact_for_marshal();
     len += m_alt->m_request_hdr.m_heap->marshal_length();
   }
 
   if (m_alt->m_response_hdr.valid()) {
+    m_alt->m_response_hdr.m_heap->compact_for_marshal();
     len += m_alt->m_response_hdr.m_heap->marshal_length();
   }
 
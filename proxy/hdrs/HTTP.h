@@ -535,6 +535,7 @@ public:
   void reset();
   void copy(const HTTPHdr *hdr);
   void copy_shallow(const HTTPHdr *hdr);
+  void move(HTTPHdr *hdr);
 
   int unmarshal(char *buf, int len, RefCountObj *block_ref);
 
@@ -885,6 +886,25 @@ HTTPHdr::copy_shallow(const HTTPHdr *hdr)
     m_url_cached.copy_shallow(&hdr->m_url_cached);
 }
 
+/*-------------------------------------------------------------------------
+  Takes over the heap of hdr instead of copying it, hdr is left
+  invalid and must be created again before it is used.
+  -------------------------------------------------------------------------*/
+
+inline void
+HTTPHdr::move(HTTPHdr *hdr)
+{
+  ink_assert(hdr->valid());
+  ink_assert(!valid());
+
+  m_heap = hdr->m_heap;
+  m_http = hdr->m_http;
+  m_mime = hdr->m_mime;
+  mark_target_dirty();
+
+  hdr->clear();
+}
+
 /*-------------------------------------------------------------------------
   -------------------------------------------------------------------------*/
 
@@ -1276,6 +1296,48 @@ HTTPHdr::scheme_get(int* length)
   return url ? url->scheme_get(length) : 0;
 }
 
+/*-------------------------------------------------------------------------
+  -------------------------------------------------------------------------*/
+
+/** The cookies of the Cookie fields of a request, split on ';' when first
+    asked for. The names and values point into the heap of the header, so
+    each lookup checks that the fields are still the ones parsed, and
+    parses them again if not.
+
+    This is kept next to the header rather than in it, the size of HTTPHdr
+    is part of the cache format.
+ */
+class HTTPCookieMap
+{
+public:
+  HTTPCookieMap()
+    : m_count(0), m_heap(NULL), m_fields_sig(0)
+  { }
+
+  /// The value of the first cookie called @a name in @a hdr, NULL if there
+  /// is none. Cookie names are case sensitive.
+  const char *get(HTTPHdr *hdr, const char *name, int name_len, int *value_len);
+
+  static const int MAX_COOKIES = 32; ///< Cookies after this many are not found.
+
+private:
+  void parse(const char *str, int len);
+
+  struct Cookie
+  {
+    const char *name;
+    const char *value;
+    int name_len;
+    int value_len;
+  };
+
+  Cookie m_cookies[MAX_COOKIES];
+  int m_count;
+  // the Cookie fields parsed
+  HdrHeap *m_heap;
+  uintptr_t m_fields_sig;
+};
+
 /*-------------------------------------------------------------------------
   -------------------------------------------------------------------------*/
 
@@ -513,6 +513,38 @@ HdrHeap::sanity_check_strs()
 }
 
 
+// void HdrHeap::compact_for_marshal()
+//
+//  A marshalled heap is written once and unmarshalled on every
+//   read, with all its string heaps copied along whether their
+//   strings are live or not.  If the heap has dead string space
+//   or strings spread over several heaps, coalesce them first so
+//   that the marshalled form only carries one heap of live strings.
+//   Must be called before marshal_length()
+//
+void
+HdrHeap::compact_for_marshal()
+{
+  int str_heaps = m_read_write_heap ? 1 : 0;
+
+  if (!m_writeable || m_next) {
+    return;
+  }
+
+  for (int i = 0; i < HDR_BUF_RONLY_HEAPS; i++) {
+    if (m_ronly_heap[i].m_heap_start != NULL) {
+      if (m_ronly_heap[i].m_locked) {
+        return;
+      }
+      str_heaps++;
+    }
+  }
+
+  if (str_heaps > 1 || (str_heaps == 1 && m_lost_string_space > 0)) {
+    coalesce_str_heaps();
+  }
+}
+
 // int HdrHeap::marshal_length()
 //
 //  Determines what the length of a buffer needs to
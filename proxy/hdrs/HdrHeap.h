@@ -196,6 +196,7 @@ public:
   void free_string(const char *s, int len);
 
   // Marshalling
+  void compact_for_marshal();
   inkcoreapi int marshal_length();
   inkcoreapi int marshal(char *buf, int length);
   int unmarshal(int buf_length, int obj_type, HdrHeapObjImpl ** found_obj, RefCountObj * block_ref);
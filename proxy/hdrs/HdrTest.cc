@@ -76,6 +76,7 @@ HdrTest::go(RegressionTest * t, int /* atype ATS_UNUSED */)
   status = status & test_regex();
   status = status & test_http_parser_eos_boundary_cases();
   status = status & test_http_mutation();
+  status = status & test_http_compact_marshal();
   status = status & test_mime();
   status = status & test_http();
 
@@ -370,6 +371,8 @@ HdrTest::test_url()
     "http://some.place/path;params?query#fragment",
     "http://some.place/path?query#fragment",
     "http://some.place/path#fragment",
+    "http://some.place/a/longer/path/to/some/resource.html?query=with;semicolon#frag",
+    "http://some.place/a/longer/path/to/some/resource.html;p;q?x?y#frag?with;more#stuff",
 
     "some.place:80",
     "some.place:80/",
@@ -1548,6 +1551,71 @@ HdrTest::test_http_mutation()
   return (failures_to_status("test_http_mutation", (status == 0)));
 }
 
+/*-------------------------------------------------------------------------
+  -------------------------------------------------------------------------*/
+
+int
+HdrTest::test_http_compact_marshal()
+{
+  int failures = 0;
+
+  bri_box("test_http_compact_marshal");
+
+  HTTPHdr resp_hdr, marshal_hdr;
+  HTTPParser parser;
+  RefCountObj ref;
+  const char base_resp[] = "HTTP/1.0 200 OK\r\nServer: test\r\n\r\n";
+  const char *start = base_resp;
+  const char *end = start + strlen(start);
+  char field_name[32], field_value[64];
+  char prt_buf[4096], cpy_buf[4096];
+  int prt_bufindex = 0, prt_dumpoffset = 0, cpy_bufindex = 0, cpy_dumpoffset = 0;
+  int i, len_before, len_after, marshal_len;
+
+  http_parser_init(&parser);
+  resp_hdr.create(HTTP_TYPE_RESPONSE);
+  while (resp_hdr.parse_resp(&parser, &start, end, true) == PARSE_CONT);
+
+  // Leave dead strings behind, like plugins rewriting headers do
+  for (i = 0; i < 40; i++) {
+    snprintf(field_name, sizeof(field_name), "Test%d", i);
+    snprintf(field_value, sizeof(field_value), "%d %d %d %d %d", i, i, i, i, i);
+    resp_hdr.value_set(field_name, (int) strlen(field_name), field_value, (int) strlen(field_value));
+    if (i % 2)
+      resp_hdr.field_delete(field_name, (int) strlen(field_name));
+  }
+  resp_hdr.print(prt_buf, sizeof(prt_buf), &prt_bufindex, &prt_dumpoffset);
+
+  len_before = resp_hdr.m_heap->marshal_length();
+  resp_hdr.m_heap->compact_for_marshal();
+  len_after = resp_hdr.m_heap->marshal_length();
+
+  if (len_after > len_before || resp_hdr.m_heap->m_lost_string_space != 0) {
+    printf("FAILED: compaction grew the heap (%d -> %d) or left %d dead bytes\n", len_before, len_after,
+           resp_hdr.m_heap->m_lost_string_space);
+    ++failures;
+  }
+
+  char *marshal_buf = (char *)ats_malloc(len_after);
+  ref.m_refcount = 100;
+  marshal_len = resp_hdr.m_heap->marshal(marshal_buf, len_after);
+  marshal_hdr.create(HTTP_TYPE_RESPONSE);
+  marshal_hdr.unmarshal(marshal_buf, marshal_len, &ref);
+  marshal_hdr.print(cpy_buf, sizeof(cpy_buf), &cpy_bufindex, &cpy_dumpoffset);
+
+  if (marshal_len < 0 || prt_bufindex != cpy_bufindex || memcmp(prt_buf, cpy_buf, prt_bufindex)) {
+    printf("FAILED: compacted header does not survive marshalling\n");
+    printf("BEFORE:\n[%.*s]\n", prt_bufindex, prt_buf);
+    printf("AFTER :\n[%.*s]\n", cpy_bufindex, cpy_buf);
+    ++failures;
+  }
+
+  ats_free(marshal_buf);
+  resp_hdr.destroy();
+
+  return (failures_to_status("test_http_compact_marshal", failures));
+}
+
 /*-------------------------------------------------------------------------
   -------------------------------------------------------------------------*/
 
@@ -2277,3 +2345,97 @@ HdrTest::failures_to_status(const char *testname, int nfail)
   return ((nfail > 0) ? 0 : 1);
 }
 
+
+/*-------------------------------------------------------------------------
+  -------------------------------------------------------------------------*/
+
+#define BENCH_HDRS_OPS  (1 << 18)
+
+REGRESSION_TEST(Bench_MIME) (RegressionTest * t, int atype, int *pstatus) {
+  if (atype < REGRESSION_TEST_EXTENDED) {
+    *pstatus = REGRESSION_TEST_NOT_RUN;
+    return;
+  }
+
+  static const char mime[] =
+    "Host: www.example.com\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:24.0) Gecko/20100101 Firefox/24.0\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+    "Accept-Language: en-US,en;q=0.5\r\n"
+    "Accept-Encoding: gzip, deflate\r\n"
+    "Cookie: session=0123456789abcdef; prefs=compact\r\n"
+    "Referer: http://www.example.com/index.html\r\n"
+    "If-Modified-Since: Tue, 08 Oct 2013 20:32:17 GMT\r\n"
+    "Cache-Control: max-age=0\r\n"
+    "Connection: keep-alive\r\n" "\r\n";
+  int len = (int) strlen(mime);
+  char buf[1024];
+  ink_hrtime parse_time = 0, print_time = 0;
+
+  hdrtoken_init();
+  url_init();
+  mime_init();
+
+  for (int i = 0; i < BENCH_HDRS_OPS; i++) {
+    MIMEHdr hdr;
+    MIMEParser parser;
+    const char *start = mime;
+    int index = 0, offset = 0;
+
+    ink_hrtime t0 = ink_get_hrtime_internal();
+    mime_parser_init(&parser);
+    hdr.create(NULL);
+    if (hdr.parse(&parser, &start, start + len, false, false) < 0) {
+      rprintf(t, "parse failed\n");
+      *pstatus = REGRESSION_TEST_FAILED;
+      return;
+    }
+    mime_parser_clear(&parser);
+    ink_hrtime t1 = ink_get_hrtime_internal();
+    hdr.print(buf, sizeof(buf), &index, &offset);
+    parse_time += t1 - t0;
+    print_time += ink_get_hrtime_internal() - t1;
+    hdr.destroy();
+  }
+  rbench(t, "parse", 1, BENCH_HDRS_OPS, parse_time);
+  rbench(t, "print", 1, BENCH_HDRS_OPS, print_time);
+  *pstatus = REGRESSION_TEST_PASSED;
+}
+
+REGRESSION_TEST(Bench_url_MD5) (RegressionTest * t, int atype, int *pstatus) {
+  if (atype < REGRESSION_TEST_EXTENDED) {
+    *pstatus = REGRESSION_TEST_NOT_RUN;
+    return;
+  }
+
+  // the first takes the fast path, the others the general one
+  static const char *strs[] = {
+    "http://www.example.com/images/logo.png",
+    "http://www.example.com/search?q=traffic+server&lang=en",
+    "http://user@www.example.com:8080/a%20b/index.html"
+  };
+  static const char *tags[] = { "fast", "query", "general" };
+  INK_MD5 md5;
+  URL url;
+
+  hdrtoken_init();
+  url_init();
+
+  for (unsigned i = 0; i < countof(strs); i++) {
+    const char *start = strs[i];
+
+    url.create(NULL);
+    if (url.parse(&start, start + strlen(start)) < 0) {
+      rprintf(t, "parse of %s failed\n", strs[i]);
+      *pstatus = REGRESSION_TEST_FAILED;
+      return;
+    }
+
+    ink_hrtime start_time = ink_get_hrtime_internal();
+    for (int j = 0; j < BENCH_HDRS_OPS * 4; j++)
+      url.MD5_get(&md5);
+    rbench(t, tags[i], 1, BENCH_HDRS_OPS * 4, ink_get_hrtime_internal() - start_time);
+    url.destroy();
+  }
+  *pstatus = REGRESSION_TEST_PASSED;
+}
@@ -330,8 +330,13 @@ DFA *hdrtoken_strs_dfa = NULL;
  *                                                                     *
  ***********************************************************************/
 
-#define	HDRTOKEN_HASH_TABLE_SIZE	65536
-#define	HDRTOKEN_HASH_TABLE_MASK	HDRTOKEN_HASH_TABLE_SIZE-1
+// hdrtoken_hash_init() builds a perfect hash of the commonly tokenized
+// strings ("hash and displace"): the hash picks one of a small set of
+// displacements, and the hash and displacement together pick the one
+// slot the string can be in.  A lookup is a single probe with no chain
+// to walk, and the table is only a couple of kilobytes.
+#define	HDRTOKEN_HASH_TABLE_MIN_BITS	4
+#define	HDRTOKEN_HASH_TABLE_MAX_BITS	15
 
 struct HdrTokenHashBucket
 {
@@ -339,19 +344,27 @@ struct HdrTokenHashBucket
   uint32_t hash;
 };
 
-HdrTokenHashBucket hdrtoken_hash_table[HDRTOKEN_HASH_TABLE_SIZE];
+static HdrTokenHashBucket *hdrtoken_hash_table = NULL;
+static uint16_t *hdrtoken_hash_disp = NULL;
+static uint32_t hdrtoken_hash_disp_mask = 0;
+static uint32_t hdrtoken_hash_shift = 32;
 
-/**
-  basic FNV hash
-**/
-#define TINY_MASK(x) (((u_int32_t)1<<(x))-1)
+inline uint32_t
+hash_to_slot_with(uint32_t hash, uint32_t disp)
+{
+  uint32_t x = hash ^ (hash >> 16);
+  return (x * (0x9E3779B1U + 2 * disp)) >> hdrtoken_hash_shift;
+}
 
 inline uint32_t
 hash_to_slot(uint32_t hash)
 {
-  return ((hash>>15) ^ hash) & TINY_MASK(15);
+  return hash_to_slot_with(hash, hdrtoken_hash_disp[hash & hdrtoken_hash_disp_mask]);
 }
 
+/**
+  basic FNV hash
+**/
 inline uint32_t
 hdrtoken_hash(const unsigned char *string, unsigned int length)
 {
@@ -361,7 +374,7 @@ hdrtoken_hash(const unsigned char *string, unsigned int length)
   uint32_t hash = InitialFNV;
 
   for (size_t i = 0; i < length; i++)  {
-      hash = hash ^ (toupper(string[i])); 
+      hash = hash ^ (ParseRules::ink_toupper(string[i]));
       hash = hash * FNVMultiple;          
   }
 
@@ -512,37 +525,109 @@ static const char *_hdrtoken_commonly_tokenized_strs[] = {
 /*-------------------------------------------------------------------------
   -------------------------------------------------------------------------*/
 
+// Places the strings of each displacement bucket, fullest first, with
+//   the first displacement that puts all of them in free slots.
+static bool
+hdrtoken_hash_place(const char **wks_strs, const uint32_t *hashes, int n, uint32_t nbuckets)
+{
+  uint32_t *slots = (uint32_t *)ats_malloc(n * sizeof(uint32_t));
+  int *members = (int *)ats_malloc(n * sizeof(int));
+  bool ok = true;
+
+  for (int want = n; ok && want > 0; want--) {
+    for (uint32_t b = 0; ok && b < nbuckets; b++) {
+      int count = 0;
+
+      for (int i = 0; i < n; i++) {
+        if ((hashes[i] & hdrtoken_hash_disp_mask) == b)
+          members[count++] = i;
+      }
+      if (count != want)
+        continue;
+
+      uint32_t d;
+      for (d = 0; d <= UINT16_MAX; d++) {
+        int placed = 0;
+
+        for (; placed < count; placed++) {
+          int k = members[placed];
+          uint32_t slot = hash_to_slot_with(hashes[k], d);
+          int j;
+
+          if (hdrtoken_hash_table[slot].wks)
+            break;
+          // duplicate strings share a slot
+          for (j = 0; j < placed && (slots[j] != slot || wks_strs[members[j]] == wks_strs[k]); j++);
+          if (j < placed)
+            break;
+          slots[placed] = slot;
+        }
+        if (placed == count)
+          break;
+      }
+
+      if (d > UINT16_MAX) {
+        ok = false;
+      } else {
+        hdrtoken_hash_disp[b] = d;
+        for (int j = 0; j < count; j++) {
+          hdrtoken_hash_table[slots[j]].wks = wks_strs[members[j]];
+          hdrtoken_hash_table[slots[j]].hash = hashes[members[j]];
+        }
+      }
+    }
+  }
+
+  ats_free(slots);
+  ats_free(members);
+  return ok;
+}
+
 void
 hdrtoken_hash_init()
 {
-  uint32_t i;
-  int num_collisions;
-
-  memset(hdrtoken_hash_table, 0, sizeof(hdrtoken_hash_table));
-  num_collisions = 0;
+  const int n = (int) SIZEOF(_hdrtoken_commonly_tokenized_strs);
+  const char *wks_strs[SIZEOF(_hdrtoken_commonly_tokenized_strs)];
+  uint32_t hashes[SIZEOF(_hdrtoken_commonly_tokenized_strs)];
 
-  for (i = 0; i < (int) SIZEOF(_hdrtoken_commonly_tokenized_strs); i++) {
+  for (int i = 0; i < n; i++) {
     // convert the common string to the well-known token
-    unsigned const char *wks;
+    const char *wks;
     int wks_idx = hdrtoken_tokenize_dfa(_hdrtoken_commonly_tokenized_strs[i],
                                         (int) strlen(_hdrtoken_commonly_tokenized_strs[i]),
-                                        (const char **) &wks);
+                                        &wks);
     ink_release_assert(wks_idx >= 0);
 
-    uint32_t hash = hdrtoken_hash(wks, hdrtoken_str_lengths[wks_idx]);
-    uint32_t slot = hash_to_slot(hash);
+    wks_strs[i] = wks;
+    hashes[i] = hdrtoken_hash((const unsigned char *) wks, hdrtoken_str_lengths[wks_idx]);
+  }
+
+  // Use the smallest table that the strings can be placed in
+  for (uint32_t bits = HDRTOKEN_HASH_TABLE_MIN_BITS; bits <= HDRTOKEN_HASH_TABLE_MAX_BITS; bits++) {
+    uint32_t size = 1U << bits;
+    uint32_t nbuckets = size / 4;
+
+    if (size < (uint32_t) n)
+      continue;
 
-    if (hdrtoken_hash_table[slot].wks) {
-      printf("ERROR: hdrtoken_hash_table[%u] collision: '%s' replacing '%s'\n",
-             slot, (const char*)wks, hdrtoken_hash_table[slot].wks);
-      ++num_collisions;
+    hdrtoken_hash_table = (HdrTokenHashBucket *)ats_malloc(size * sizeof(HdrTokenHashBucket));
+    memset(hdrtoken_hash_table, 0, size * sizeof(HdrTokenHashBucket));
+    hdrtoken_hash_disp = (uint16_t *)ats_malloc(nbuckets * sizeof(uint16_t));
+    memset(hdrtoken_hash_disp, 0, nbuckets * sizeof(uint16_t));
+    hdrtoken_hash_disp_mask = nbuckets - 1;
+    hdrtoken_hash_shift = 32 - bits;
+
+    if (hdrtoken_hash_place(wks_strs, hashes, n, nbuckets)) {
+      Debug("hdr_token", "%d tokens hashed into %u slots", n, size);
+      return;
     }
-    hdrtoken_hash_table[slot].wks = (const char *)wks;
-    hdrtoken_hash_table[slot].hash = hash;
+
+    ats_free(hdrtoken_hash_table);
+    ats_free(hdrtoken_hash_disp);
   }
 
-  if (num_collisions > 0)
-    abort();
+  printf("ERROR: could not build a perfect hash for hdrtoken_hash_table\n");
+  abort();
 }
 
 
@@ -710,7 +795,8 @@ hdrtoken_tokenize(const char *string, int string_len, const char **wks_string_ou
   bucket = &(hdrtoken_hash_table[slot]);
   if ((bucket->wks != NULL) &&
       (bucket->hash == hash) &&
-      (hdrtoken_wks_to_length(bucket->wks) == string_len)) {
+      (hdrtoken_wks_to_length(bucket->wks) == string_len) &&
+      (strncasecmp(bucket->wks, string, string_len) == 0)) {
     wks_idx = hdrtoken_wks_to_index(bucket->wks);
     if (wks_string_out)
       *wks_string_out = bucket->wks;
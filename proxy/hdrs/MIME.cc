@@ -2169,7 +2169,7 @@ _mime_scanner_init(MIMEScanner *scanner)
   scanner->m_line_size = 0;
   scanner->m_line_length = 0;
   scanner->m_state = MIME_PARSE_BEFORE;
-
+  scanner->m_colon = NULL;
 }
 
 //////////////////////////////////////////////////////
@@ -2232,6 +2232,7 @@ mime_scanner_get(MIMEScanner *S,
                  int raw_input_scan_type)
 {
   const char *raw_input_c, *lf_ptr;
+  const char *colon = NULL;
   MIMEParseResult zret = PARSE_CONT;
   // Need this for handling dangling CR.
   static char const RAW_CR = ParseRules::CHAR_CR;
@@ -2278,7 +2279,18 @@ mime_scanner_get(MIMEScanner *S,
       }
       break;
     case MIME_PARSE_INSIDE:
-      lf_ptr = static_cast<char const*>(memchr(raw_input_c, ParseRules::CHAR_LF, runway));
+      if (MIME_SCANNER_TYPE_FIELD == raw_input_scan_type && NULL == colon) {
+        // Pick up the name / value separator on the way, so the parser
+        // does not have to scan the field a second time for it.
+        lf_ptr = ink_memchr2(raw_input_c, ':', ParseRules::CHAR_LF, runway);
+        if (lf_ptr && ':' == *lf_ptr) {
+          colon = lf_ptr;
+          raw_input_c = lf_ptr + 1;
+          break;
+        }
+      } else {
+        lf_ptr = static_cast<char const*>(memchr(raw_input_c, ParseRules::CHAR_LF, runway));
+      }
       if (lf_ptr) {
         raw_input_c = lf_ptr + 1;
         if (MIME_SCANNER_TYPE_LINE == raw_input_scan_type) {
@@ -2344,6 +2356,7 @@ mime_scanner_get(MIMEScanner *S,
   }
 
   // adjust out arguments.
+  S->m_colon = NULL;
   if (PARSE_CONT != zret) {
     if (0 != S->m_line_length) {
       *output_s = S->m_line;
@@ -2354,6 +2367,7 @@ mime_scanner_get(MIMEScanner *S,
       *output_s = *raw_input_s;
       *output_e = raw_input_c;
       *output_shares_raw_input = true;
+      S->m_colon = colon;
     }
   }
   
@@ -2446,7 +2460,7 @@ mime_parser_parse(MIMEParser *parser, HdrHeap *heap, MIMEHdrImpl *mh, const char
       continue;                 // toss away garbage line
 
     // find name last
-    colon = (char *) memchr(line_c, ':', (line_e - line_c));
+    colon = scanner->m_colon ? scanner->m_colon : (char *) memchr(line_c, ':', (line_e - line_c));
     if (!colon)
       continue;                 // toss away garbage line
     field_name_last = colon - 1;
@@ -2866,8 +2880,8 @@ mime_days_since_epoch_to_mdy(unsigned int days_since_jan_1_1970, int *m_return,
   mime_days_since_epoch_to_mdy_slowcase(days_since_jan_1_1970, m_return, d_return, y_return);
 }
 
-int
-mime_format_date(char *buffer, time_t value)
+static int
+mime_format_date_slowcase(char *buffer, time_t value)
 {
   // must be 3 characters!
   static const char *daystrs[] = {
@@ -2998,6 +3012,33 @@ mime_format_date(char *buffer, time_t value)
   return 29;                    // not counting NUL
 }
 
+// Most dates formatted are the current second, for Date:, and the rest
+// repeat, the Last-Modified: and Expires: of popular objects. Each thread
+// keeps the last few it formatted, indexed by the low bits of the value.
+#define MIME_DATE_CACHE_SIZE 8
+
+struct MIMEDateCacheEntry
+{
+  time_t value;
+  int len;
+  char str[33];
+};
+
+static __thread MIMEDateCacheEntry mime_date_cache[MIME_DATE_CACHE_SIZE];
+
+int
+mime_format_date(char *buffer, time_t value)
+{
+  MIMEDateCacheEntry *e = &mime_date_cache[(uint64_t) value % MIME_DATE_CACHE_SIZE];
+
+  if (e->len == 0 || e->value != value) {
+    e->len = mime_format_date_slowcase(e->str, value);
+    e->value = value;
+  }
+  memcpy(buffer, e->str, e->len + 1);
+  return e->len;
+}
+
 int32_t
 mime_parse_int(const char *buf, const char *end)
 {
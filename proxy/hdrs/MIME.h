@@ -261,6 +261,9 @@ struct MIMEScanner
   int m_line_size;              // total allocated size of buffer
 //  int m_state;                  // state of scanning state machine
   MimeParseState m_state; ///< Parsing machine state.
+  /// First ':' of the field just returned, found while looking for its
+  /// end. Only set when the field is returned in place from the input.
+  const char *m_colon;
 };
 
 
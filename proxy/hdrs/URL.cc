@@ -1042,13 +1042,6 @@ url_unescapify(Arena * arena, const char *str, int length)
  *                                                                     *
  ***********************************************************************/
 
-#define GETNEXT(label) { \
-    cur += 1;            \
-    if (cur >= end) {    \
-        goto label;      \
-    }                    \
-}
-
 MIMEParseResult
 url_parse_scheme(HdrHeap * heap, URLImpl * url, const char **start, const char *end, bool copy_strings_p)
 {
@@ -1258,7 +1251,6 @@ url_parse_http(HdrHeap * heap, URLImpl * url, const char **start, const char *en
   const char *query_end = NULL;
   const char *fragment_start = NULL;
   const char *fragment_end = NULL;
-  char mask;
 
   err = url_parse_internet(heap, url, start, end, copy_strings);
   if (err < 0)
@@ -1268,58 +1260,40 @@ url_parse_http(HdrHeap * heap, URLImpl * url, const char **start, const char *en
   if (*start == end)
     goto done;
 
+  // Each component runs to the first delimiter that can follow it, found
+  // a run at a time rather than a byte at a time.
   path_start = cur;
-  mask = ';' & '?' & '#';
-parse_path2:
-  if ((*cur & mask) == mask) {
-    if (*cur == ';') {
-      path_end = cur;
-      goto parse_params1;
-    }
-    if (*cur == '?') {
-      path_end = cur;
-      goto parse_query1;
-    }
-    if (*cur == '#') {
-      path_end = cur;
-      goto parse_fragment1;
+  cur = ink_memchr3(cur, ';', '?', '#', end - cur);
+  if (!cur) {
+    cur = end;
+    goto done;
+  }
+  path_end = cur;
+
+  if (*cur == ';') {
+    params_start = cur + 1;
+    cur = ink_memchr2(params_start, '?', '#', end - params_start);
+    if (!cur) {
+      cur = end;
+      goto done;
     }
-  } else {
-    ink_assert((*cur != ';') && (*cur != '?') && (*cur != '#'));
+    params_end = cur;
   }
-  GETNEXT(done);
-  goto parse_path2;
 
-parse_params1:
-  params_start = cur + 1;
-  GETNEXT(done);
-parse_params2:
   if (*cur == '?') {
-    params_end = cur;
-    goto parse_query1;
-  }
-  if (*cur == '#') {
-    params_end = cur;
-    goto parse_fragment1;
-  }
-  GETNEXT(done);
-  goto parse_params2;
-
-parse_query1:
-  query_start = cur + 1;
-  GETNEXT(done);
-parse_query2:
-  if (*cur == '#') {
+    query_start = cur + 1;
+    cur = static_cast<const char *>(memchr(query_start, '#', end - query_start));
+    if (!cur) {
+      cur = end;
+      goto done;
+    }
     query_end = cur;
-    goto parse_fragment1;
   }
-  GETNEXT(done);
-  goto parse_query2;
 
-parse_fragment1:
+  // the fragment is the rest, whatever it holds
   fragment_start = cur + 1;
-  GETNEXT(done);
   fragment_end = end;
+  cur = fragment_start;
 
 done:
   if (path_start) {
@@ -1546,11 +1520,11 @@ memcpy_tolower(char *d, const char *s, int n)
 static inline void
 url_MD5_get_fast(URLImpl * url, INK_MD5 * md5)
 {
-  INK_DIGEST_CTX md5_ctx;
+  INK_KEY_CTX md5_ctx;
   char buffer[BUFSIZE];
   char *p;
 
-  ink_code_incr_md5_init(&md5_ctx);
+  ink_code_incr_key_init(&md5_ctx);
 
   p = buffer;
   memcpy_tolower(p, url->m_ptr_scheme, url->m_len_scheme);
@@ -1577,15 +1551,15 @@ url_MD5_get_fast(URLImpl * url, INK_MD5 * md5)
   *p++ = ((char *) &port)[0];
   *p++ = ((char *) &port)[1];
 
-  ink_code_incr_md5_update(&md5_ctx, buffer, p - buffer);
-  ink_code_incr_md5_final((char *) md5, &md5_ctx);
+  ink_code_incr_key_update(&md5_ctx, buffer, p - buffer);
+  ink_code_incr_key_final((char *) md5, &md5_ctx);
 }
 
 
 static inline void
 url_MD5_get_general(URLImpl * url, INK_MD5 * md5)
 {
-  INK_DIGEST_CTX md5_ctx;
+  INK_KEY_CTX md5_ctx;
 
   char buffer[BUFSIZE];
   char *p, *e;
@@ -1626,7 +1600,7 @@ url_MD5_get_general(URLImpl * url, INK_MD5 * md5)
   p = buffer;
   e = buffer + BUFSIZE;
 
-  ink_code_incr_md5_init(&md5_ctx);
+  ink_code_incr_key_init(&md5_ctx);
 
   for (i = 0; i < 13; i++) {
     if (strs[i]) {
@@ -1641,7 +1615,7 @@ url_MD5_get_general(URLImpl * url, INK_MD5 * md5)
         }
 
         if (p == e) {
-	  ink_code_incr_md5_update(&md5_ctx, buffer, BUFSIZE);
+	  ink_code_incr_key_update(&md5_ctx, buffer, BUFSIZE);
           p = buffer;
         }
       }
@@ -1649,13 +1623,13 @@ url_MD5_get_general(URLImpl * url, INK_MD5 * md5)
   }
 
   if (p != buffer) {
-    ink_code_incr_md5_update(&md5_ctx, buffer, p - buffer);
+    ink_code_incr_key_update(&md5_ctx, buffer, p - buffer);
   }
 
   port = url_canonicalize_port(url->m_url_type, url->m_port);
 
-  ink_code_incr_md5_update(&md5_ctx, (char *) &port, sizeof(port));
-  ink_code_incr_md5_final((char *) md5, &md5_ctx);
+  ink_code_incr_key_update(&md5_ctx, (char *) &port, sizeof(port));
+  ink_code_incr_key_final((char *) md5, &md5_ctx);
 }
 
 
@@ -1693,23 +1667,23 @@ url_MD5_get(URLImpl * url, INK_MD5 * md5)
 void
 url_host_MD5_get(URLImpl * url, INK_MD5 * md5)
 {
-  INK_DIGEST_CTX md5_ctx;
+  INK_KEY_CTX md5_ctx;
 
-  ink_code_incr_md5_init(&md5_ctx);
+  ink_code_incr_key_init(&md5_ctx);
 
   if (url->m_ptr_scheme) {
-    ink_code_incr_md5_update(&md5_ctx, url->m_ptr_scheme, url->m_len_scheme);
+    ink_code_incr_key_update(&md5_ctx, url->m_ptr_scheme, url->m_len_scheme);
   }
 
-  ink_code_incr_md5_update(&md5_ctx, "://", 3);
+  ink_code_incr_key_update(&md5_ctx, "://", 3);
 
   if (url->m_ptr_host) {
-    ink_code_incr_md5_update(&md5_ctx, url->m_ptr_host, url->m_len_host);
+    ink_code_incr_key_update(&md5_ctx, url->m_ptr_host, url->m_len_host);
   }
 
-  ink_code_incr_md5_update(&md5_ctx, ":", 1);
+  ink_code_incr_key_update(&md5_ctx, ":", 1);
 
   int port = url_canonicalize_port(url->m_url_type, url->m_port);
-  ink_code_incr_md5_update(&md5_ctx, (char *) &port, sizeof(port));
-  ink_code_incr_md5_final((char *) md5, &md5_ctx);
+  ink_code_incr_key_update(&md5_ctx, (char *) &port, sizeof(port));
+  ink_code_incr_key_final((char *) md5, &md5_ctx);
 }
@@ -38,6 +38,7 @@
 #include <logging/Log.h>
 #include <logging/LogAccess.h>
 #include <logging/LogAccessHttp.h>
+#include <logging/LogFormat.h>
 #include "HttpCompat.h"
 
 //////////////////////////////////////////////////////////////////////
@@ -74,6 +75,7 @@ HttpBodyFactory::fabricate_with_old_api(const char *type, HttpTransact::State *
   lock();
 
   *resulting_buffer_length = 0;
+  context->internal_msg_data = NULL;
 
   ink_strlcpy(content_language_out_buf, "en", content_language_buf_size);
   ink_strlcpy(content_type_out_buf, "text/html", content_type_buf_size);
@@ -154,7 +156,11 @@ HttpBodyFactory::fabricate_with_old_api(const char *type, HttpTransact::State *
                  set, type, *resulting_buffer_length, max_buffer_length);
     }
     *resulting_buffer_length = 0;
-    buffer = (char *)ats_free_null(buffer);
+    if (context->internal_msg_data)
+      context->internal_msg_data = NULL;
+    else
+      ats_free(buffer);
+    buffer = NULL;
   }
   /////////////////////////////////////////////////////////////////////
   // handle return of instantiated template and generate the content //
@@ -447,6 +453,13 @@ HttpBodyFactory::fabricate(StrList * acpt_language_list,
   *content_language_return = body_set->content_language;
   *content_charset_return = body_set->content_charset;
 
+  // nothing to instantiate, hand out the shared body
+  if (t->prerendered_data) {
+    Debug("body_factory", "  returning %" PRId64" byte pre-rendered buffer", t->prerendered_data->block_size());
+    context->internal_msg_data = t->prerendered_data;
+    *buffer_length_return = t->prerendered_data->block_size();
+    return (t->prerendered_data->data());
+  }
   // build the custom error page
   buffer = t->build_instantiated_buffer(context, buffer_length_return);
   return (buffer);
@@ -932,6 +945,8 @@ HttpBodyTemplate::reset()
   template_buffer = NULL;
   byte_count = 0;
   ats_free(template_pathname);
+  // transactions serving the body keep their own references
+  prerendered_data = NULL;
 }
 
 
@@ -998,6 +1013,23 @@ HttpBodyTemplate::load_from_file(char *dir, char *file)
   byte_count = new_byte_count;
   template_pathname = ats_strdup(path);
 
+  ////////////////////////////////////////////////////////////
+  // without log fields the template instantiates to itself //
+  ////////////////////////////////////////////////////////////
+
+  char *printf_str = NULL, *fields_str = NULL;
+  int64_t body_len = strlen(template_buffer);
+
+  if (body_len > 0 && LogFormat::parse_format_string(template_buffer, &printf_str, &fields_str) == 0) {
+    char *body = (char *)ats_malloc(body_len + 1);
+
+    memcpy(body, template_buffer, body_len + 1);
+    prerendered_data = new_xmalloc_IOBufferData(body, body_len);
+    Debug("body_factory", "    pre-rendered %" PRId64" bytes from '%s'", body_len, path);
+  }
+  ats_free(printf_str);
+  ats_free(fields_str);
+
   return (1);
 }
 
@@ -100,6 +100,7 @@ public:
   int64_t byte_count;
   char *template_buffer;
   char *template_pathname;
+  Ptr<IOBufferData> prerendered_data;   // the body, if the template has no log fields
 };
 
 
@@ -145,6 +146,12 @@ public:
 //      data has been loaded, the HttpBodyFactory object allows the
 //      caller to make error message bodies w/fabricate_with_old_api
 //
+//      The body of a template without log fields is the same for every
+//      request, so it is rendered once and shared: fabricate_with_old_api
+//      then returns a pointer into context->internal_msg_data rather
+//      than a buffer of its own.  context->internal_msg_data is NULL
+//      whenever the returned buffer is the caller's.
+//
 ////////////////////////////////////////////////////////////////////////
 
 class HttpBodyFactory
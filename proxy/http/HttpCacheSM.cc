@@ -33,11 +33,14 @@
 #include "HttpCacheSM.h"
 #include "HttpSM.h"
 #include "HttpDebugNames.h"
+#include "ICPProcessor.h"
+#include "HttpTrace.h"
 
 #define STATE_ENTER(state_name, event) { \
         REMEMBER(event, -1); \
         Debug("http_cache", "[%" PRId64 "] [%s, %s]", master_sm->sm_id, \
-        #state_name, HttpDebugNames::get_event_name(event)); }
+        #state_name, HttpDebugNames::get_event_name(event)); \
+        if (unlikely(master_sm->trace_on)) http_trace_record(master_sm->sm_id, #state_name, event); }
 
 #define __REMEMBER(x)  #x
 #define _REMEMBER(x)   __REMEMBER(x)
@@ -115,6 +118,7 @@ HttpCacheSM::state_cache_open_read(int event, void *data)
     ink_assert(cache_read_vc == NULL);
     open_read_cb = true;
     cache_read_vc = (CacheVConnection *) data;
+    icpProcessor.DigestAdd(lookup_url);
     master_sm->handleEvent(event, data);
     break;
 
@@ -168,6 +172,7 @@ HttpCacheSM::state_cache_open_write(int event, void *data)
     HTTP_INCREMENT_DYN_STAT(http_current_cache_connections_stat);
     ink_assert(cache_write_vc == NULL);
     cache_write_vc = (CacheVConnection *) data;
+    icpProcessor.DigestAdd(lookup_url);
     open_write_cb = true;
     master_sm->handleEvent(event, data);
     break;
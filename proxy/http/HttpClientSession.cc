@@ -62,7 +62,7 @@ HttpClientSession::HttpClientSession()
     tcp_init_cwnd_set(false),
     transact_count(0), half_close(false), conn_decrease(false), bound_ss(NULL),
     read_buffer(NULL), current_reader(NULL), read_state(HCS_INIT),
-    ka_vio(NULL), slave_ka_vio(NULL),
+    ka_vio(NULL), slave_ka_vio(NULL), ka_released_bytes(0),
     cur_hook_id(TS_HTTP_LAST_HOOK), cur_hook(NULL),
     cur_hooks(0), proxy_allocated(false), backdoor_connect(false),
     hooks_set(0),
@@ -101,6 +101,10 @@ HttpClientSession::cleanup()
     HTTP_DECREMENT_DYN_STAT(http_current_client_connections_stat);
     conn_decrease = false;
   }
+  if (ka_released_bytes) {
+    HTTP_SUM_DYN_STAT(http_keep_alive_released_bytes_stat, -ka_released_bytes);
+    ka_released_bytes = 0;
+  }
 }
 
 void
@@ -148,6 +152,10 @@ HttpClientSession::new_transaction()
 {
   ink_assert(current_reader == NULL);
 
+  if (ka_released_bytes) {
+    HTTP_SUM_DYN_STAT(http_keep_alive_released_bytes_stat, -ka_released_bytes);
+    ka_released_bytes = 0;
+  }
   read_state = HCS_ACTIVE_READER;
   current_reader = HttpSM::allocate();
   current_reader->init();
@@ -588,6 +596,7 @@ HttpClientSession::release(IOBufferReader * r)
   ink_assert(read_state == HCS_ACTIVE_READER);
   ink_assert(current_reader != NULL);
   MgmtInt ka_in = current_reader->t_state.txn_conf->keep_alive_no_activity_timeout_in;
+  bool release_buffer = current_reader->t_state.http_config_param->keep_alive_release_buffer;
 
   DebugSsn("http_cs", "[%" PRId64 "] session released by sm [%" PRId64 "]", con_id, current_reader->sm_id);
   current_reader = NULL;
@@ -618,6 +627,14 @@ HttpClientSession::release(IOBufferReader * r)
     DebugSsn("http_cs", "[%" PRId64 "] initiating io for next header", con_id);
     read_state = HCS_KEEP_ALIVE;
     SET_HANDLER(&HttpClientSession::state_keep_alive);
+    // hold no blocks while idle, the next request starts on a header sized one
+    if (release_buffer) {
+      int64_t released = read_buffer->shrink(HTTP_HEADER_BUFFER_SIZE_INDEX);
+      if (released > 0) {
+        ka_released_bytes = released;
+        HTTP_SUM_DYN_STAT(http_keep_alive_released_bytes_stat, released);
+      }
+    }
     ka_vio = this->do_io_read(this, INT64_MAX, read_buffer);
     ink_assert(slave_ka_vio != ka_vio);
     client_vc->set_inactivity_timeout(HRTIME_SECONDS(ka_in));
@@ -127,6 +127,8 @@ private:
 
   VIO *ka_vio;
   VIO *slave_ka_vio;
+  // read buffer memory given back while idle on keep-alive
+  int64_t ka_released_bytes;
 
   Link<HttpClientSession> debug_link;
 
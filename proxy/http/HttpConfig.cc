@@ -31,6 +31,7 @@
 #include "ICPProcessor.h"
 #include "P_Net.h"
 #include "P_RecUtils.h"
+#include "I_Layout.h"
 #include <records/I_RecHttp.h>
 
 #ifndef min
@@ -97,6 +98,7 @@ int
 HttpConfigCont::handle_event(int /* event ATS_UNUSED */, void * /* edata ATS_UNUSED */)
 {
   if (ink_atomic_increment((int *) &http_config_changes, -1) == 1) {
+    ConfigReloadTimer timer("HttpConfig::reconfigure");
     HttpConfig::reconfigure();
   }
   return 0;
@@ -111,7 +113,7 @@ http_config_cb(const char * /* name ATS_UNUSED */, RecDataT /* data_type ATS_UNU
 
   INK_MEMORY_BARRIER;
 
-  eventProcessor.schedule_in(http_config_cont, HRTIME_SECONDS(1), ET_CALL);
+  eventProcessor.schedule_in(http_config_cont, HRTIME_SECONDS(1), ET_TASK);
   return 0;
 }
 
@@ -145,6 +147,16 @@ register_stat_callbacks()
                      "proxy.process.http.current_client_transactions",
                      RECD_INT, RECP_NON_PERSISTENT, (int) http_current_client_transactions_stat, RecRawStatSyncSum);
   HTTP_CLEAR_DYN_STAT(http_current_client_transactions_stat);
+  RecRegisterRawStat(http_rsb, RECT_PROCESS,
+                     "proxy.process.http.keep_alive_released_bytes",
+                     RECD_INT, RECP_NON_PERSISTENT, (int) http_keep_alive_released_bytes_stat, RecRawStatSyncSum);
+  HTTP_CLEAR_DYN_STAT(http_keep_alive_released_bytes_stat);
+  RecRegisterRawStat(http_rsb, RECT_PROCESS,
+                     "proxy.process.http.origin_connect_waits",
+                     RECD_COUNTER, RECP_NULL, (int) http_origin_connect_waits_stat, RecRawStatSyncCount);
+  RecRegisterRawStat(http_rsb, RECT_PROCESS,
+                     "proxy.process.http.origin_connect_wait_time",
+                     RECD_INT, RECP_NULL, (int) http_origin_connect_wait_time_stat, RecRawStatSyncSum);
   RecRegisterRawStat(http_rsb, RECT_PROCESS,
                      "proxy.process.http.current_parent_proxy_transactions",
                      RECD_INT, RECP_NON_PERSISTENT,
@@ -640,6 +652,14 @@ register_stat_callbacks()
                      "proxy.process.http.cache_hit_stale_served",
                      RECD_COUNTER, RECP_NULL, (int) http_cache_hit_stale_served_stat, RecRawStatSyncCount);
 
+  RecRegisterRawStat(http_rsb, RECT_PROCESS,
+                     "proxy.process.http.cache_hit_stale_revalidating",
+                     RECD_COUNTER, RECP_NULL, (int) http_cache_hit_stale_revalidating_stat, RecRawStatSyncCount);
+
+  RecRegisterRawStat(http_rsb, RECT_PROCESS,
+                     "proxy.process.http.cache_background_revalidations",
+                     RECD_COUNTER, RECP_NULL, (int) http_cache_background_revalidations_stat, RecRawStatSyncCount);
+
   RecRegisterRawStat(http_rsb, RECT_PROCESS,
                      "proxy.process.http.cache_miss_cold",
                      RECD_COUNTER, RECP_NULL, (int) http_cache_miss_cold_stat, RecRawStatSyncCount);
@@ -1103,6 +1123,74 @@ register_stat_callbacks()
                      RECD_COUNTER, RECP_NULL,
                      (int) http_total_x_redirect_stat, RecRawStatSyncCount);
 
+  RecRegisterRawStat(http_rsb, RECT_PROCESS,
+                     "proxy.process.http.post_buffer.requests",
+                     RECD_COUNTER, RECP_NULL,
+                     (int) http_post_buffered_requests_stat, RecRawStatSyncCount);
+  RecRegisterRawStat(http_rsb, RECT_PROCESS,
+                     "proxy.process.http.post_buffer.spilled_requests",
+                     RECD_COUNTER, RECP_NULL,
+                     (int) http_post_buffer_spilled_requests_stat, RecRawStatSyncCount);
+  RecRegisterRawStat(http_rsb, RECT_PROCESS,
+                     "proxy.process.http.post_buffer.replays",
+                     RECD_COUNTER, RECP_NULL,
+                     (int) http_post_buffer_replays_stat, RecRawStatSyncCount);
+  RecRegisterRawStat(http_rsb, RECT_PROCESS,
+                     "proxy.process.http.prewarm.connections",
+                     RECD_COUNTER, RECP_NULL,
+                     (int) http_prewarm_connections_stat, RecRawStatSyncCount);
+  RecRegisterRawStat(http_rsb, RECT_PROCESS,
+                     "proxy.process.http.health_check.requests",
+                     RECD_COUNTER, RECP_NULL,
+                     (int) http_health_check_requests_stat, RecRawStatSyncCount);
+  RecRegisterRawStat(http_rsb, RECT_PROCESS,
+                     "proxy.process.http.pipeline.requests",
+                     RECD_COUNTER, RECP_NULL,
+                     (int) http_pipelined_requests_stat, RecRawStatSyncCount);
+  RecRegisterRawStat(http_rsb, RECT_PROCESS,
+                     "proxy.process.http.pipeline.failures",
+                     RECD_COUNTER, RECP_NULL,
+                     (int) http_pipeline_failures_stat, RecRawStatSyncCount);
+  RecRegisterRawStat(http_rsb, RECT_PROCESS,
+                     "proxy.process.http.http2_origin.connections",
+                     RECD_COUNTER, RECP_NULL,
+                     (int) http_http2_origin_connections_stat, RecRawStatSyncCount);
+  RecRegisterRawStat(http_rsb, RECT_PROCESS,
+                     "proxy.process.http.http2_origin.streams",
+                     RECD_COUNTER, RECP_NULL,
+                     (int) http_http2_origin_streams_stat, RecRawStatSyncCount);
+  RecRegisterRawStat(http_rsb, RECT_PROCESS,
+                     "proxy.process.http.negative_cache.hits",
+                     RECD_COUNTER, RECP_NULL,
+                     (int) http_negative_cache_hits_stat, RecRawStatSyncCount);
+  RecRegisterRawStat(http_rsb, RECT_PROCESS,
+                     "proxy.process.http.negative_cache.stores",
+                     RECD_COUNTER, RECP_NULL,
+                     (int) http_negative_cache_stores_stat, RecRawStatSyncCount);
+
+  // Latency histograms: each publishes .p50, .p99 and .p999 in microseconds
+  RecRegisterRawHistogramStat(http_rsb, RECT_PROCESS, "proxy.process.http.latency.ttfb",
+                              RECP_NULL, (int) http_ttfb_latency_stat);
+  RecRegisterRawHistogramStat(http_rsb, RECT_PROCESS, "proxy.process.http.latency.origin_connect",
+                              RECP_NULL, (int) http_origin_connect_latency_stat);
+  RecRegisterRawHistogramStat(http_rsb, RECT_PROCESS, "proxy.process.http.latency.cache_open_read",
+                              RECP_NULL, (int) http_cache_open_read_latency_stat);
+  RecRegisterRawHistogramStat(http_rsb, RECT_PROCESS, "proxy.process.http.latency.total",
+                              RECP_NULL, (int) http_total_latency_stat);
+  RecRegisterRawHistogramStat(http_rsb, RECT_PROCESS, "proxy.process.http.latency.ua_read_header",
+                              RECP_NULL, (int) http_ua_read_header_latency_stat);
+  RecRegisterRawHistogramStat(http_rsb, RECT_PROCESS, "proxy.process.http.latency.dns_lookup",
+                              RECP_NULL, (int) http_dns_lookup_latency_stat);
+  RecRegisterRawHistogramStat(http_rsb, RECT_PROCESS, "proxy.process.http.latency.cache_open_write",
+                              RECP_NULL, (int) http_cache_open_write_latency_stat);
+  RecRegisterRawHistogramStat(http_rsb, RECT_PROCESS, "proxy.process.http.latency.origin_ttfb",
+                              RECP_NULL, (int) http_origin_ttfb_latency_stat);
+  RecRegisterRawHistogramStat(http_rsb, RECT_PROCESS, "proxy.process.http.latency.origin_read_header",
+                              RECP_NULL, (int) http_origin_read_header_latency_stat);
+  RecRegisterRawHistogramStat(http_rsb, RECT_PROCESS, "proxy.process.http.latency.transfer",
+                              RECP_NULL, (int) http_transfer_latency_stat);
+  RecRegisterRawHistogramStat(http_rsb, RECT_PROCESS, "proxy.process.http.latency.plugin_total",
+                              RECP_NULL, (int) http_plugin_total_latency_stat);
 }
 
 
@@ -1144,6 +1232,7 @@ HttpConfig::startup()
   HttpEstablishStaticConfigLongLong(c.server_max_connections, "proxy.config.http.server_max_connections");
   HttpEstablishStaticConfigLongLong(c.oride.server_tcp_init_cwnd, "proxy.config.http.server_tcp_init_cwnd");
   HttpEstablishStaticConfigLongLong(c.oride.origin_max_connections, "proxy.config.http.origin_max_connections");
+  HttpEstablishStaticConfigLongLong(c.oride.server_pipeline_depth, "proxy.config.http.server_pipeline_depth");
   HttpEstablishStaticConfigLongLong(c.origin_min_keep_alive_connections, "proxy.config.http.origin_min_keep_alive_connections");
 
   HttpEstablishStaticConfigByte(c.parent_proxy_routing_enable, "proxy.config.http.parent_proxy_routing_enable");
@@ -1181,6 +1270,7 @@ HttpConfig::startup()
   HttpEstablishStaticConfigLongLong(c.user_agent_pipeline, "proxy.config.http.user_agent_pipeline");
   HttpEstablishStaticConfigByte(c.oride.share_server_sessions, "proxy.config.http.share_server_sessions");
   HttpEstablishStaticConfigByte(c.oride.keep_alive_post_out, "proxy.config.http.keep_alive_post_out");
+  HttpEstablishStaticConfigByte(c.oride.server_http2, "proxy.config.http.server_http2");
 
   HttpEstablishStaticConfigLongLong(c.oride.keep_alive_no_activity_timeout_in,
                                     "proxy.config.http.keep_alive_no_activity_timeout_in");
@@ -1196,6 +1286,7 @@ HttpConfig::startup()
     c.transaction_request_active_timeout_in = 0;
   HttpEstablishStaticConfigLongLong(c.oride.transaction_active_timeout_out, "proxy.config.http.transaction_active_timeout_out");
   HttpEstablishStaticConfigLongLong(c.accept_no_activity_timeout, "proxy.config.http.accept_no_activity_timeout");
+  HttpEstablishStaticConfigByte(c.keep_alive_release_buffer, "proxy.config.http.keep_alive_release_buffer");
 
   HttpEstablishStaticConfigLongLong(c.oride.background_fill_active_timeout, "proxy.config.http.background_fill_active_timeout");
   HttpEstablishStaticConfigFloat(c.oride.background_fill_threshold, "proxy.config.http.background_fill_completed_threshold");
@@ -1261,6 +1352,8 @@ HttpConfig::startup()
   HttpEstablishStaticConfigStringAlloc(c.cache_vary_default_text, "proxy.config.http.cache.vary_default_text");
   HttpEstablishStaticConfigStringAlloc(c.cache_vary_default_images, "proxy.config.http.cache.vary_default_images");
   HttpEstablishStaticConfigStringAlloc(c.cache_vary_default_other, "proxy.config.http.cache.vary_default_other");
+  HttpEstablishStaticConfigStringAlloc(c.cache_key_cookies, "proxy.config.http.cache.key_cookies");
+  HttpEstablishStaticConfigStringAlloc(c.cache_invalidate_tag_header, "proxy.config.http.cache.invalidate_tag_header");
 
   // open read failure retries
   HttpEstablishStaticConfigLongLong(c.oride.max_cache_open_read_retries, "proxy.config.http.cache.max_open_read_retries");
@@ -1269,6 +1362,10 @@ HttpConfig::startup()
   // open write failure retries
   HttpEstablishStaticConfigLongLong(c.max_cache_open_write_retries, "proxy.config.http.cache.max_open_write_retries");
 
+  HttpEstablishStaticConfigByte(c.cache_stale_while_revalidate, "proxy.config.http.cache.stale_while_revalidate.enabled");
+  HttpEstablishStaticConfigLongLong(c.cache_stale_while_revalidate_timeout,
+                                    "proxy.config.http.cache.stale_while_revalidate.timeout");
+
   HttpEstablishStaticConfigByte(c.oride.cache_http, "proxy.config.http.cache.http");
   HttpEstablishStaticConfigByte(c.oride.cache_cluster_cache_local, "proxy.config.http.cache.cluster_cache_local");
   HttpEstablishStaticConfigByte(c.oride.cache_ignore_client_no_cache, "proxy.config.http.cache.ignore_client_no_cache");
@@ -1293,6 +1390,8 @@ HttpConfig::startup()
   HttpEstablishStaticConfigByte(c.oride.cache_range_lookup, "proxy.config.http.cache.range.lookup");
 
   HttpEstablishStaticConfigStringAlloc(c.connect_ports_string, "proxy.config.http.connect_ports");
+  HttpEstablishStaticConfigStringAlloc(c.negative_caching_lifetimes_string,
+                                       "proxy.config.http.negative_caching_lifetimes");
 
   HttpEstablishStaticConfigLongLong(c.oride.request_hdr_max_size, "proxy.config.http.request_header_max_size");
   HttpEstablishStaticConfigLongLong(c.oride.response_hdr_max_size, "proxy.config.http.response_header_max_size");
@@ -1349,6 +1448,17 @@ HttpConfig::startup()
   HttpEstablishStaticConfigLongLong(c.number_of_redirections, "proxy.config.http.number_of_redirections");
   HttpEstablishStaticConfigLongLong(c.post_copy_size, "proxy.config.http.post_copy_size");
 
+  HttpEstablishStaticConfigByte(c.post_buffer_enabled, "proxy.config.http.post_buffer.enabled");
+  HttpEstablishStaticConfigLongLong(c.post_buffer_memory_size, "proxy.config.http.post_buffer.memory_size");
+  HttpEstablishStaticConfigLongLong(c.post_buffer_max_size, "proxy.config.http.post_buffer.max_size");
+  HttpEstablishStaticConfigStringAlloc(c.post_buffer_spill_dir, "proxy.config.http.post_buffer.spill_dir");
+
+  HttpEstablishStaticConfigByte(c.prewarm_enabled, "proxy.config.http.prewarm.enabled");
+  HttpEstablishStaticConfigLongLong(c.prewarm_min_connections, "proxy.config.http.prewarm.min_connections");
+  HttpEstablishStaticConfigLongLong(c.prewarm_hot_rate, "proxy.config.http.prewarm.hot_rate");
+
+  HttpEstablishStaticConfigStringAlloc(c.health_check_path, "proxy.config.http.health_check.path");
+
   // Transparency flag.
   char buffer[10];
   if (REC_ERR_OKAY ==  RecGetRecordString("proxy.config.http.transparent",
@@ -1380,6 +1490,35 @@ HttpConfig::startup()
   return;
 }
 
+// Health checks are answered with one of these, written straight to the
+// client. A HEAD request gets the first health_check_header_len bytes.
+static void
+render_health_check_responses(HttpConfigParams *params, const char *path)
+{
+  static const char *status[HEALTH_CHECK_RESPONSES] = { "200 OK", "200 OK", "503 Service Unavailable" };
+  static const char *body[HEALTH_CHECK_RESPONSES] = { "OK\n", "OK\n", "Draining\n" };
+  static const char *connection[HEALTH_CHECK_RESPONSES] = { "keep-alive", "close", "close" };
+  char buf[512];
+
+  if (!path || !*path)
+    return;
+  if (*path == '/')
+    ++path;
+  params->health_check_path = ats_strdup(path);
+  params->health_check_path_len = strlen(path);
+
+  for (int i = 0; i < HEALTH_CHECK_RESPONSES; i++) {
+    int hlen = snprintf(buf, sizeof(buf),
+                        "HTTP/1.1 %s\r\nContent-Type: text/plain\r\nContent-Length: %d\r\n"
+                        "Cache-Control: no-store\r\nConnection: %s\r\n\r\n",
+                        status[i], (int) strlen(body[i]), connection[i]);
+    ink_strlcat(buf, body[i], sizeof(buf));
+    params->health_check_response[i] = ats_strdup(buf);
+    params->health_check_response_len[i] = strlen(buf);
+    params->health_check_header_len[i] = hlen;
+  }
+}
+
 ////////////////////////////////////////////////////////////////
 //
 //  HttpConfig::reconfigure()
@@ -1414,6 +1553,7 @@ HttpConfig::reconfigure()
   params->server_max_connections = m_master.server_max_connections;
   params->oride.server_tcp_init_cwnd = m_master.oride.server_tcp_init_cwnd;
   params->oride.origin_max_connections = m_master.oride.origin_max_connections;
+  params->oride.server_pipeline_depth = m_master.oride.server_pipeline_depth;
   params->origin_min_keep_alive_connections = m_master.origin_min_keep_alive_connections;
 
   if (params->oride.origin_max_connections &&
@@ -1459,6 +1599,7 @@ HttpConfig::reconfigure()
   params->user_agent_pipeline = m_master.user_agent_pipeline;
   params->oride.share_server_sessions = m_master.oride.share_server_sessions;
   params->oride.keep_alive_post_out = INT_TO_BOOL(m_master.oride.keep_alive_post_out);
+  params->oride.server_http2 = INT_TO_BOOL(m_master.oride.server_http2);
 
   params->oride.keep_alive_no_activity_timeout_in = m_master.oride.keep_alive_no_activity_timeout_in;
   params->oride.keep_alive_no_activity_timeout_out = m_master.oride.keep_alive_no_activity_timeout_out;
@@ -1468,6 +1609,7 @@ HttpConfig::reconfigure()
   params->oride.transaction_request_active_timeout_in = m_master.oride.transaction_request_active_timeout_in;
   params->oride.transaction_active_timeout_out = m_master.oride.transaction_active_timeout_out;
   params->accept_no_activity_timeout = m_master.accept_no_activity_timeout;
+  params->keep_alive_release_buffer = INT_TO_BOOL(m_master.keep_alive_release_buffer);
   params->oride.background_fill_active_timeout = m_master.oride.background_fill_active_timeout;
   params->oride.background_fill_threshold = m_master.oride.background_fill_threshold;
 
@@ -1529,6 +1671,8 @@ HttpConfig::reconfigure()
   params->cache_vary_default_text = ats_strdup(m_master.cache_vary_default_text);
   params->cache_vary_default_images = ats_strdup(m_master.cache_vary_default_images);
   params->cache_vary_default_other = ats_strdup(m_master.cache_vary_default_other);
+  params->cache_key_cookies = ats_strdup(m_master.cache_key_cookies);
+  params->cache_invalidate_tag_header = ats_strdup(m_master.cache_invalidate_tag_header);
 
   // open read failure retries
   params->oride.max_cache_open_read_retries = m_master.oride.max_cache_open_read_retries;
@@ -1537,6 +1681,9 @@ HttpConfig::reconfigure()
   // open write failure retries
   params->max_cache_open_write_retries = m_master.max_cache_open_write_retries;
 
+  params->cache_stale_while_revalidate = INT_TO_BOOL(m_master.cache_stale_while_revalidate);
+  params->cache_stale_while_revalidate_timeout = m_master.cache_stale_while_revalidate_timeout;
+
   params->oride.cache_http = INT_TO_BOOL(m_master.oride.cache_http);
   params->oride.cache_cluster_cache_local = INT_TO_BOOL(m_master.oride.cache_cluster_cache_local);
   params->oride.cache_ignore_client_no_cache = INT_TO_BOOL(m_master.oride.cache_ignore_client_no_cache);
@@ -1562,6 +1709,9 @@ HttpConfig::reconfigure()
   params->connect_ports_string = ats_strdup(m_master.connect_ports_string);
   params->connect_ports = parse_ports_list(params->connect_ports_string);
 
+  params->negative_caching_lifetimes_string = ats_strdup(m_master.negative_caching_lifetimes_string);
+  params->negative_caching_lifetimes = parse_negative_caching_lifetimes(params->negative_caching_lifetimes_string);
+
   params->oride.request_hdr_max_size = m_master.oride.request_hdr_max_size;
   params->oride.response_hdr_max_size = m_master.oride.response_hdr_max_size;
   
@@ -1609,6 +1759,20 @@ params->push_method_enabled = INT_TO_BOOL(m_master.push_method_enabled);
   params->number_of_redirections = m_master.number_of_redirections;
   params->post_copy_size = m_master.post_copy_size;
 
+  params->post_buffer_enabled = INT_TO_BOOL(m_master.post_buffer_enabled);
+  params->post_buffer_memory_size = m_master.post_buffer_memory_size;
+  params->post_buffer_max_size = m_master.post_buffer_max_size;
+  if (m_master.post_buffer_spill_dir && *m_master.post_buffer_spill_dir)
+    params->post_buffer_spill_dir = ats_strdup(m_master.post_buffer_spill_dir);
+  else
+    params->post_buffer_spill_dir = ats_strdup(Layout::get()->runtimedir);
+
+  params->prewarm_enabled = INT_TO_BOOL(m_master.prewarm_enabled);
+  params->prewarm_min_connections = m_master.prewarm_min_connections;
+  params->prewarm_hot_rate = m_master.prewarm_hot_rate;
+
+  render_health_check_responses(params, m_master.health_check_path);
+
   m_id = configProcessor.set(m_id, params);
 
 #undef INT_TO_BOOL
@@ -1646,6 +1810,25 @@ HttpConfig::release(HttpConfigParams * params)
   configProcessor.release(m_id, params);
 }
 
+////////////////////////////////////////////////////////////////
+//
+//  OverridableHttpConfigSnapshot
+//
+////////////////////////////////////////////////////////////////
+OverridableHttpConfigSnapshot::OverridableHttpConfigSnapshot(HttpConfigParams * params)
+  : base(params)
+{
+  ink_atomic_increment(&base->m_refcount, 1);
+  memcpy(&oride, &base->oride, sizeof(oride));
+}
+
+OverridableHttpConfigSnapshot::~OverridableHttpConfigSnapshot()
+{
+  for (unsigned i = 0; i < strings.length(); i++)
+    ats_free(strings[i]);
+  HttpConfig::release(base);
+}
+
 ////////////////////////////////////////////////////////////////
 //
 //  HttpConfig::parse_ports_list()
@@ -1723,6 +1906,61 @@ HttpConfig::parse_ports_list(char *ports_string)
   return (ports_list);
 }
 
+////////////////////////////////////////////////////////////////
+//
+//  HttpConfig::parse_negative_caching_lifetimes()
+//
+//  "404:60 410:3600 5xx:10" - a lifetime in seconds for a status
+//  code or for a class of them. An exact code takes precedence over
+//  its class, whatever the order.
+//
+////////////////////////////////////////////////////////////////
+int32_t *
+HttpConfig::parse_negative_caching_lifetimes(char *lifetimes_string)
+{
+  int32_t *lifetimes;
+  bool exact[HTTP_NEGATIVE_CACHING_STATUS_MAX];
+  char *copy, *tok, *last = NULL;
+
+  if (!lifetimes_string || !*lifetimes_string)
+    return NULL;
+
+  lifetimes = (int32_t *) ats_malloc(HTTP_NEGATIVE_CACHING_STATUS_MAX * sizeof(int32_t));
+  memset(lifetimes, 0, HTTP_NEGATIVE_CACHING_STATUS_MAX * sizeof(int32_t));
+  memset(exact, 0, sizeof(exact));
+
+  copy = ats_strdup(lifetimes_string);
+  for (tok = strtok_r(copy, " \t,", &last); tok; tok = strtok_r(NULL, " \t,", &last)) {
+    char *colon = strchr(tok, ':');
+    int lifetime;
+
+    if (colon == NULL || colon - tok != 3 || !ParseRules::is_digit(tok[0]) || tok[0] < '1' || tok[0] > '5' ||
+        (lifetime = atoi(colon + 1)) < 0) {
+      Warning("invalid negative caching lifetime '%s' in proxy.config.http.negative_caching_lifetimes", tok);
+      continue;
+    }
+
+    if (ParseRules::is_digit(tok[1]) && ParseRules::is_digit(tok[2])) {
+      int code = atoi(tok);
+
+      lifetimes[code] = lifetime;
+      exact[code] = true;
+    } else if (ParseRules::ink_tolower(tok[1]) == 'x' && ParseRules::ink_tolower(tok[2]) == 'x') {
+      int base = (tok[0] - '0') * 100;
+
+      for (int code = base; code < base + 100; code++) {
+        if (!exact[code])
+          lifetimes[code] = lifetime;
+      }
+    } else {
+      Warning("invalid negative caching lifetime '%s' in proxy.config.http.negative_caching_lifetimes", tok);
+    }
+  }
+  ats_free(copy);
+
+  return lifetimes;
+}
+
 ////////////////////////////////////////////////////////////////
 //
 //  HttpConfig::parse_url_expansions()
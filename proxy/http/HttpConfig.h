@@ -67,6 +67,9 @@ enum
   http_current_client_connections_stat,
   http_current_active_client_connections_stat,
   http_current_client_transactions_stat,
+  http_keep_alive_released_bytes_stat,
+  http_origin_connect_waits_stat,
+  http_origin_connect_wait_time_stat,
   http_total_incoming_connections_stat,
   http_current_parent_proxy_transactions_stat,
   http_current_icp_transactions_stat,
@@ -216,6 +219,8 @@ enum
   http_cache_hit_reval_stat,
   http_cache_hit_ims_stat,
   http_cache_hit_stale_served_stat,
+  http_cache_hit_stale_revalidating_stat,
+  http_cache_background_revalidations_stat,
   http_cache_miss_cold_stat,
   http_cache_miss_changed_stat,
   http_cache_miss_client_no_cache_stat,
@@ -278,6 +283,19 @@ enum
 
   http_total_x_redirect_stat,
 
+  http_post_buffered_requests_stat,
+  http_post_buffer_spilled_requests_stat,
+  http_post_buffer_replays_stat,
+  http_prewarm_connections_stat,
+  http_health_check_requests_stat,
+  http_pipelined_requests_stat,
+  http_pipeline_failures_stat,
+  http_http2_origin_connections_stat,
+  http_http2_origin_streams_stat,
+
+  http_negative_cache_hits_stat,
+  http_negative_cache_stores_stat,
+
   // Times
   http_total_transactions_time_stat,
   http_total_transactions_think_time_stat,
@@ -344,6 +362,19 @@ enum
   http_response_status_505_count_stat,
   http_response_status_5xx_count_stat,
 
+  // Latency histograms, in microseconds
+  http_ttfb_latency_stat,
+  http_origin_connect_latency_stat,
+  http_cache_open_read_latency_stat,
+  http_total_latency_stat,
+  http_ua_read_header_latency_stat,
+  http_dns_lookup_latency_stat,
+  http_cache_open_write_latency_stat,
+  http_origin_ttfb_latency_stat,
+  http_origin_read_header_latency_stat,
+  http_transfer_latency_stat,
+  http_plugin_total_latency_stat,
+
   http_stat_count
 };
 
@@ -354,6 +385,7 @@ extern RecRawStatBlock *http_rsb;
 #define HTTP_DECREMENT_DYN_STAT(x) RecIncrRawStat(http_rsb, mutex->thread_holding, (int) x, -1)
 #define HTTP_SUM_DYN_STAT(x, y) RecIncrRawStat(http_rsb, mutex->thread_holding, (int) x, (int64_t) y)
 #define HTTP_SUM_GLOBAL_DYN_STAT(x, y) RecIncrGlobalRawStatSum(http_rsb, x, y)
+#define HTTP_HISTOGRAM_DYN_STAT(x, y) RecIncrRawHistogram(http_rsb, mutex->thread_holding, (int) x, (int64_t) y)
 
 #define HTTP_CLEAR_DYN_STAT(x) \
 do { \
@@ -402,7 +434,7 @@ struct OverridableHttpConfigParams {
   OverridableHttpConfigParams()
     : maintain_pristine_host_hdr(1), chunking_enabled(1),
       negative_caching_enabled(0), negative_revalidating_enabled(0), cache_when_to_revalidate(0),
-      keep_alive_enabled_in(1), keep_alive_enabled_out(1), keep_alive_post_out(0),
+      keep_alive_enabled_in(1), keep_alive_enabled_out(1), keep_alive_post_out(0), server_http2(0),
       share_server_sessions(2), fwd_proxy_auth_to_parent(0), insert_age_in_response(1),
       anonymize_remove_from(0), anonymize_remove_referer(0), anonymize_remove_user_agent(0),
       anonymize_remove_cookie(0), anonymize_remove_client_ip(0), anonymize_insert_client_ip(1),
@@ -421,7 +453,7 @@ struct OverridableHttpConfigParams {
       keep_alive_no_activity_timeout_in(115), keep_alive_no_activity_timeout_out(120),
       transaction_no_activity_timeout_in(30), transaction_no_activity_timeout_out(30),
       transaction_header_active_timeout_in(0), transaction_request_active_timeout_in(0),
-      transaction_active_timeout_out(0), origin_max_connections(0),
+      transaction_active_timeout_out(0), origin_max_connections(0), server_pipeline_depth(0),
       connect_attempts_max_retries(0), connect_attempts_max_retries_dead_server(3),
       connect_attempts_rr_retries(3), connect_attempts_timeout(30),
       post_connect_attempts_timeout(1800), down_server_timeout(300), client_abort_threshold(10),
@@ -455,6 +487,7 @@ struct OverridableHttpConfigParams {
   MgmtByte keep_alive_enabled_in;
   MgmtByte keep_alive_enabled_out;
   MgmtByte keep_alive_post_out;  // share server sessions for post
+  MgmtByte server_http2;         // requests to the origin as HTTP/2 streams
 
   MgmtByte share_server_sessions;
   MgmtByte fwd_proxy_auth_to_parent;
@@ -563,6 +596,7 @@ struct OverridableHttpConfigParams {
   MgmtInt transaction_request_active_timeout_in;
   MgmtInt transaction_active_timeout_out;
   MgmtInt origin_max_connections;
+  MgmtInt server_pipeline_depth;
 
   ////////////////////////////////////
   // origin server connect attempts //
@@ -605,6 +639,14 @@ struct OverridableHttpConfigParams {
   MgmtFloat background_fill_threshold;
 };
 
+// The pre-rendered health check responses, see HttpSM::do_health_check().
+enum
+{
+  HEALTH_CHECK_OK_KEEP_ALIVE = 0,
+  HEALTH_CHECK_OK_CLOSE,
+  HEALTH_CHECK_DRAINING,
+  HEALTH_CHECK_RESPONSES
+};
 
 /////////////////////////////////////////////////////////////
 //
@@ -675,6 +717,7 @@ public:
   MgmtInt transaction_header_active_timeout_in;
   MgmtInt transaction_request_active_timeout_in;
   MgmtInt accept_no_activity_timeout;
+  MgmtByte keep_alive_release_buffer;
 
   ////////////////////////////////////
   // origin server connect attempts //
@@ -705,10 +748,19 @@ public:
   char *cache_vary_default_text;
   char *cache_vary_default_images;
   char *cache_vary_default_other;
+  char *cache_key_cookies;
+
+  // response header listing the tags a cached object can be invalidated by
+  char *cache_invalidate_tag_header;
 
   // open write failure retries.
   MgmtInt max_cache_open_write_retries;
 
+  // RFC 5861 stale-while-revalidate, and how long a background
+  // revalidation may take before another one is started.
+  MgmtByte cache_stale_while_revalidate;
+  MgmtInt cache_stale_while_revalidate_timeout;
+
   ///////////////////
   // cache control //
   ///////////////////
@@ -721,6 +773,14 @@ public:
   char *connect_ports_string;
   HttpConfigPortRange *connect_ports;
 
+  ///////////////////////////////////////////////////////////
+  // Negative caching lifetimes by status code, in seconds //
+  // (0 for a status that is not negatively cached)        //
+  ///////////////////////////////////////////////////////////
+#define HTTP_NEGATIVE_CACHING_STATUS_MAX 600
+  char *negative_caching_lifetimes_string;
+  int32_t *negative_caching_lifetimes;
+
   //////////
   // Push //
   //////////
@@ -784,6 +844,33 @@ public:
   MgmtInt number_of_redirections;
   MgmtInt post_copy_size;
 
+  ///////////////////////////////////////////////////////////////////
+  // Buffer request bodies before contacting the server, to retry //
+  // without the client. Past memory_size they go to spill_dir.    //
+  ///////////////////////////////////////////////////////////////////
+  MgmtByte post_buffer_enabled;
+  MgmtInt post_buffer_memory_size;
+  MgmtInt post_buffer_max_size;
+  char *post_buffer_spill_dir;
+
+  ////////////////////////////////////////////////////////////////
+  // Keep prewarm_min_connections idle connections pooled to   //
+  // origins getting prewarm_hot_rate requests a second or more //
+  ////////////////////////////////////////////////////////////////
+  MgmtByte prewarm_enabled;
+  MgmtInt prewarm_min_connections;
+  MgmtInt prewarm_hot_rate;
+
+  ///////////////////////////////////////////////////////////////
+  // GET/HEAD for health_check_path are answered as soon as the //
+  // header is parsed, from responses rendered at reconfigure  //
+  ///////////////////////////////////////////////////////////////
+  char *health_check_path;      // without the leading '/', NULL when disabled
+  int health_check_path_len;
+  char *health_check_response[HEALTH_CHECK_RESPONSES];
+  int health_check_response_len[HEALTH_CHECK_RESPONSES];
+  int health_check_header_len[HEALTH_CHECK_RESPONSES];
+
   //////////////////////////////////////////////////////////////////
   // Allow special handling of Accept* headers to be disabled to  //
   // avoid unnecessary creation of alternates                     //
@@ -803,6 +890,26 @@ private:
     HttpConfigParams & operator =(const HttpConfigParams &);
 };
 
+/////////////////////////////////////////////////////////////
+//
+// struct OverridableHttpConfigSnapshot
+//
+// The overridable configs of one HttpConfigParams with a fixed set of
+// overrides on top. Every transaction applying the same overrides shares
+// one of these, copying it only if it then changes a config of its own.
+/////////////////////////////////////////////////////////////
+struct OverridableHttpConfigSnapshot: public RefCountObj
+{
+  OverridableHttpConfigSnapshot(HttpConfigParams * params);
+  ~OverridableHttpConfigSnapshot();
+
+  // Holds a reference, so it is never freed and reused while we compare
+  // transactions' configs against it.
+  HttpConfigParams *base;
+  OverridableHttpConfigParams oride;
+  Vec<char *> strings;          // the override strings oride points to
+};
+
 /////////////////////////////////////////////////////////////
 //
 // class HttpUserAgent_RegxEntry
@@ -861,6 +968,9 @@ public:
   // parse ssl ports configuration string
   static HttpConfigPortRange *parse_ports_list(char *ports_str);
 
+  // parse negative caching lifetimes string
+  static int32_t *parse_negative_caching_lifetimes(char *lifetimes_str);
+
   // parse DNS URL expansions string
   static char **parse_url_expansions(char *url_expansions_str, int *num_expansions);
 
@@ -909,6 +1019,7 @@ HttpConfigParams::HttpConfigParams()
     transaction_header_active_timeout_in(0),
     transaction_request_active_timeout_in(0),
     accept_no_activity_timeout(120),
+    keep_alive_release_buffer(1),
     parent_connect_attempts(4),
     per_parent_connect_attempts(2),
     parent_connect_timeout(30),
@@ -921,11 +1032,17 @@ HttpConfigParams::HttpConfigParams()
     cache_vary_default_text(NULL),
     cache_vary_default_images(NULL),
     cache_vary_default_other(NULL),
+    cache_key_cookies(NULL),
+    cache_invalidate_tag_header(NULL),
     max_cache_open_write_retries(1),
+    cache_stale_while_revalidate(1),
+    cache_stale_while_revalidate_timeout(60),
     cache_enable_default_vary_headers(0),
     cache_when_to_add_no_cache_to_msie_requests(-1),
     connect_ports_string(NULL),
     connect_ports(NULL),
+    negative_caching_lifetimes_string(NULL),
+    negative_caching_lifetimes(NULL),
     push_method_enabled(0),
     referer_filter_enabled(0),
     referer_format_redirect(0),
@@ -941,11 +1058,25 @@ HttpConfigParams::HttpConfigParams()
     redirection_enabled(1),
     number_of_redirections(1),
     post_copy_size(2048),
+    post_buffer_enabled(0),
+    post_buffer_memory_size(1048576),
+    post_buffer_max_size(104857600),
+    post_buffer_spill_dir(NULL),
+    prewarm_enabled(0),
+    prewarm_min_connections(4),
+    prewarm_hot_rate(10),
+    health_check_path(NULL),
+    health_check_path_len(0),
     ignore_accept_mismatch(0),
     ignore_accept_language_mismatch(0),
     ignore_accept_encoding_mismatch(0),
     ignore_accept_charset_mismatch(0)
 {
+  for (int i = 0; i < HEALTH_CHECK_RESPONSES; i++) {
+    health_check_response[i] = NULL;
+    health_check_response_len[i] = 0;
+    health_check_header_len[i] = 0;
+  }
 }
 
 inline
@@ -961,7 +1092,15 @@ HttpConfigParams::~HttpConfigParams()
   ats_free(cache_vary_default_text);
   ats_free(cache_vary_default_images);
   ats_free(cache_vary_default_other);
+  ats_free(cache_key_cookies);
+  ats_free(post_buffer_spill_dir);
+  ats_free(health_check_path);
+  for (int i = 0; i < HEALTH_CHECK_RESPONSES; i++)
+    ats_free(health_check_response[i]);
+  ats_free(cache_invalidate_tag_header);
   ats_free(connect_ports_string);
+  ats_free(negative_caching_lifetimes_string);
+  ats_free(negative_caching_lifetimes);
   ats_free(reverse_proxy_no_host_redirect);
   ats_free(url_expansions);
 
@@ -25,3 +25,38 @@
 
 
 ConnectionCount ConnectionCount::_connectionCount;
+
+ConnectionCount::Counter *
+ConnectionCount::getCounter(const IpEndpoint& addr)
+{
+  ConnAddr caddr(addr);
+  // the low bits pick the bucket inside the shard's map, so use the high ones
+  uint32_t h = ((uint32_t) ats_ip_hash(&addr.sa) * 0x9E3779B9U) >> 26;
+  Shard *shard = &_shards[h & (CONNECTION_COUNT_SHARDS - 1)];
+
+  ink_mutex_acquire(&shard->mutex);
+  Counter *c = shard->hostCount.get(caddr);
+  if (c == NULL) {
+    c = (Counter *)ats_malloc(sizeof(Counter));
+    memset(c, 0, sizeof(Counter));
+    shard->hostCount.put(caddr, c);
+  }
+  ink_mutex_release(&shard->mutex);
+  return c;
+}
+
+void
+ConnectionCount::forEach(void (*f)(const IpEndpoint& addr, const Counter& c, void *cookie), void *cookie)
+{
+  typedef MapElem<ConnAddr, Counter *> Elem;
+
+  for (int i = 0; i < CONNECTION_COUNT_SHARDS; i++) {
+    Shard *shard = &_shards[i];
+
+    ink_mutex_acquire(&shard->mutex);
+    form_Map(Elem, e, shard->hostCount) {
+      f(e->key._addr, *e->value, cookie);
+    }
+    ink_mutex_release(&shard->mutex);
+  }
+}
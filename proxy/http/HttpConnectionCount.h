@@ -26,13 +26,27 @@
 #include "Map.h"
 
 #ifndef _HTTP_CONNECTION_COUNT_H_
+#define _HTTP_CONNECTION_COUNT_H_
+
+#define CONNECTION_COUNT_SHARDS 64   // a power of 2
 
 /**
  * Singleton class to keep track of the number of connections per host
+ *
+ * The hosts are spread over shards by address hash, each with its own
+ * lock, which is only held to find the counter of a host.  Counters are
+ * never freed, so once found they are updated and read atomically.
  */
 class ConnectionCount
 {
 public:
+  /// Connections and connect wait statistics of one host.
+  struct Counter {
+    volatile int count;
+    volatile int64_t waits;     // connects which had to wait for the limit
+    volatile int64_t wait_usec; // total time they waited
+  };
+
   /**
    * Static method to get the instance of the class
    * @return Returns a pointer to the instance of the class
@@ -41,16 +55,20 @@ public:
     return &_connectionCount;
   }
 
+  /**
+   * Gets the counter for the host, creating it if needed
+   * @param ip IP address of the host
+   * @return The counter, valid for the life of the process
+   */
+  Counter *getCounter(const IpEndpoint& addr);
+
   /**
    * Gets the number of connections for the host
    * @param ip IP address of the host
    * @return Number of connections
    */
   int getCount(const IpEndpoint& addr) {
-    ink_mutex_acquire(&_mutex);
-    int count = _hostCount.get(ConnAddr(addr));
-    ink_mutex_release(&_mutex);
-    return count;
+    return getCounter(addr)->count;
   }
 
   /**
@@ -59,13 +77,24 @@ public:
    * @param delta Default is +1, can be set to negative to decrement
    */
   void incrementCount(const IpEndpoint& addr, const int delta = 1) {
-    ConnAddr caddr(addr);
-    ink_mutex_acquire(&_mutex);
-    int count = _hostCount.get(caddr);
-    _hostCount.put(caddr, count + delta);
-    ink_mutex_release(&_mutex);
+    ink_atomic_increment(&getCounter(addr)->count, delta);
+  }
+
+  /**
+   * Account for a connect which waited for the host to drop below its limit
+   * @param c Counter of the host
+   * @param wait How long it waited
+   */
+  void addWait(Counter *c, ink_hrtime wait) {
+    ink_atomic_increment(&c->waits, 1);
+    ink_atomic_increment(&c->wait_usec, (int64_t)(wait / HRTIME_USECOND));
   }
 
+  /**
+   * Calls @a f for each host with a counter
+   */
+  void forEach(void (*f)(const IpEndpoint& addr, const Counter& c, void *cookie), void *cookie);
+
   struct ConnAddr {
     IpEndpoint _addr;
 
@@ -82,15 +111,21 @@ public:
   };
 
 private:
+  struct Shard {
+    ink_mutex mutex;
+    HashMap<ConnAddr, ConnAddrHashFns, Counter *> hostCount;
+  };
+
   // Hide the constructor and copy constructor
   ConnectionCount() {
-    ink_mutex_init(&_mutex, "ConnectionCountMutex");
+    for (int i = 0; i < CONNECTION_COUNT_SHARDS; i++) {
+      ink_mutex_init(&_shards[i].mutex, "ConnectionCountMutex");
+    }
   }
   ConnectionCount(const ConnectionCount & /* x ATS_UNUSED */) { }
 
   static ConnectionCount _connectionCount;
-  HashMap<ConnAddr, ConnAddrHashFns, int> _hostCount;
-  ink_mutex _mutex;
+  Shard _shards[CONNECTION_COUNT_SHARDS];
 };
 
 #endif
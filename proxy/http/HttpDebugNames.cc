@@ -29,6 +29,7 @@
 #include "ICPevents.h"
 #include "HttpSM.h"
 #include "HttpUpdateSM.h"
+#include "HttpServerSession.h"
 
 //----------------------------------------------------------------------------
 const char *
@@ -211,6 +212,12 @@ HttpDebugNames::get_event_name(int event)
     return ("HTTP_TUNNEL_EVENT_PRECOMPLETE");
   case HTTP_TUNNEL_EVENT_CONSUMER_DETACH:
     return ("HTTP_TUNNEL_EVENT_CONSUMER_DETACH");
+  case HTTP_POST_BUFFER_EVENT_READY:
+    return ("HTTP_POST_BUFFER_EVENT_READY");
+  case HTTP_PIPELINE_EVENT_READY:
+    return ("HTTP_PIPELINE_EVENT_READY");
+  case HTTP_PIPELINE_EVENT_FAILED:
+    return ("HTTP_PIPELINE_EVENT_FAILED");
 
     //////////////////////////
     //  ICP Events
@@ -0,0 +1,231 @@
+/** @file
+
+  Negative responses kept in memory, in front of the disk cache
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+ */
+
+/****************************************************************************
+
+  HttpNegativeCache.cc
+
+  A flood of requests for URLs that do not exist costs a disk cache
+  lookup each, and a write of every new negative response. Small
+  negative responses are instead kept here, by the key the cache looks
+  them up with, as just their status, content type and body, and the
+  state machine consults the table before it opens a cache read.
+
+  The table is set associative: a key has WAYS slots to go in, and a
+  new entry replaces the one closest to expiry. It is advisory, what
+  does not fit is fetched from the origin server again.
+
+****************************************************************************/
+
+#include "HttpNegativeCache.h"
+#include "HttpConfig.h"
+
+#define NEGATIVE_CACHE_WAYS    4
+#define NEGATIVE_CACHE_STRIPES 64
+
+struct NegativeCacheEntry
+{
+  INK_MD5 key;
+  ink_time_t stored;
+  ink_time_t expire;            // zero for a free slot
+  int status;
+  int type_len;
+  int body_len;
+  char *data;                   // the content type, then the body
+};
+
+struct NegativeCacheStripe
+{
+  ink_mutex mutex;
+};
+
+static NegativeCacheEntry *negative_cache = NULL;
+static int negative_cache_buckets = 0;       // a power of 2
+static int64_t negative_cache_max_body = 1024;
+static NegativeCacheStripe negative_cache_stripes[NEGATIVE_CACHE_STRIPES];
+
+static inline NegativeCacheEntry *
+negative_cache_bucket(INK_MD5 const &key, NegativeCacheStripe **stripe)
+{
+  uint64_t h = key.fold();
+  int b = (int) ((h ^ (h >> 32)) & (negative_cache_buckets - 1));
+
+  *stripe = &negative_cache_stripes[b & (NEGATIVE_CACHE_STRIPES - 1)];
+  return &negative_cache[b * NEGATIVE_CACHE_WAYS];
+}
+
+static inline void
+negative_cache_clear(NegativeCacheEntry *e)
+{
+  ats_free(e->data);
+  e->data = NULL;
+  e->expire = 0;
+}
+
+void
+http_negative_cache_init()
+{
+  int64_t entries = 0;
+
+  REC_ReadConfigInteger(entries, "proxy.config.http.negative_cache.size");
+  REC_ReadConfigInteger(negative_cache_max_body, "proxy.config.http.negative_cache.max_body");
+  if (entries <= 0)
+    return;
+
+  negative_cache_buckets = 1;
+  while (negative_cache_buckets * NEGATIVE_CACHE_WAYS < entries)
+    negative_cache_buckets <<= 1;
+  negative_cache = new NegativeCacheEntry[negative_cache_buckets * NEGATIVE_CACHE_WAYS];
+  for (int i = 0; i < negative_cache_buckets * NEGATIVE_CACHE_WAYS; i++) {
+    negative_cache[i].expire = 0;
+    negative_cache[i].data = NULL;
+  }
+  for (int i = 0; i < NEGATIVE_CACHE_STRIPES; i++)
+    ink_mutex_init(&negative_cache_stripes[i].mutex, "NegativeCache");
+}
+
+bool
+http_negative_cache_lookup(HttpTransact::State *s, HTTPStatus *status, int *age)
+{
+  NegativeCacheStripe *stripe;
+  NegativeCacheEntry *b;
+  INK_MD5 key;
+  bool hit = false;
+
+  if (negative_cache == NULL)
+    return false;
+
+  s->cache_info.lookup_url->MD5_get(&key);
+  b = negative_cache_bucket(key, &stripe);
+  ink_time_t now = ink_cluster_time();
+
+  ink_mutex_acquire(&stripe->mutex);
+  for (int i = 0; i < NEGATIVE_CACHE_WAYS; i++) {
+    NegativeCacheEntry *e = &b[i];
+
+    if (!e->expire || !(e->key == key))
+      continue;
+    if (e->expire <= now) {
+      negative_cache_clear(e);
+      break;
+    }
+
+    // The body is handed to the response as a malloced message buffer
+    *status = (HTTPStatus) e->status;
+    *age = (int) (now - e->stored);
+    if (e->type_len)
+      s->internal_msg_buffer_type = ats_strndup(e->data, e->type_len);
+    if (e->body_len) {
+      s->internal_msg_buffer = (char *) ats_malloc(e->body_len);
+      memcpy(s->internal_msg_buffer, e->data + e->type_len, e->body_len);
+      s->internal_msg_buffer_size = e->body_len;
+      s->internal_msg_buffer_fast_allocator_size = -1;
+      s->internal_msg_buffer_index = 0;
+    }
+    hit = true;
+    break;
+  }
+  ink_mutex_release(&stripe->mutex);
+
+  return hit;
+}
+
+bool
+http_negative_cache_admit(HttpTransact::State *s)
+{
+  return negative_cache != NULL && s->method == HTTP_WKSIDX_GET &&
+    s->current.server->transfer_encoding != HttpTransact::CHUNKED_ENCODING &&
+    s->hdr_info.response_content_length >= 0 && s->hdr_info.response_content_length <= negative_cache_max_body;
+}
+
+bool
+http_negative_cache_store(HttpTransact::State *s, IOBufferReader *reader, int64_t len, int ttl)
+{
+  NegativeCacheStripe *stripe;
+  NegativeCacheEntry *b;
+  INK_MD5 key;
+  const char *type;
+  int type_len = 0;
+  char *data;
+
+  if (negative_cache == NULL || ttl <= 0 || len > negative_cache_max_body)
+    return false;
+
+  type = s->hdr_info.server_response.value_get(MIME_FIELD_CONTENT_TYPE, MIME_LEN_CONTENT_TYPE, &type_len);
+  if (type == NULL)
+    type_len = 0;
+
+  // Copy outside the lock
+  data = (char *) ats_malloc(type_len + len + 1);
+  if (type_len)
+    memcpy(data, type, type_len);
+  reader->memcpy(data + type_len, len);
+
+  s->cache_info.lookup_url->MD5_get(&key);
+  b = negative_cache_bucket(key, &stripe);
+  ink_time_t now = ink_cluster_time();
+
+  ink_mutex_acquire(&stripe->mutex);
+  NegativeCacheEntry *victim = &b[0];
+  for (int i = 0; i < NEGATIVE_CACHE_WAYS; i++) {
+    if (b[i].expire && b[i].key == key) {
+      victim = &b[i];
+      break;
+    }
+    if (b[i].expire < victim->expire)
+      victim = &b[i];
+  }
+  negative_cache_clear(victim);
+  victim->key = key;
+  victim->stored = now;
+  victim->expire = now + ttl;
+  victim->status = s->hdr_info.server_response.status_get();
+  victim->type_len = type_len;
+  victim->body_len = (int) len;
+  victim->data = data;
+  ink_mutex_release(&stripe->mutex);
+
+  return true;
+}
+
+void
+http_negative_cache_forget(HttpTransact::State *s)
+{
+  NegativeCacheStripe *stripe;
+  NegativeCacheEntry *b;
+  INK_MD5 key;
+
+  if (negative_cache == NULL)
+    return;
+
+  s->cache_info.lookup_url->MD5_get(&key);
+  b = negative_cache_bucket(key, &stripe);
+
+  ink_mutex_acquire(&stripe->mutex);
+  for (int i = 0; i < NEGATIVE_CACHE_WAYS; i++) {
+    if (b[i].expire && b[i].key == key)
+      negative_cache_clear(&b[i]);
+  }
+  ink_mutex_release(&stripe->mutex);
+}
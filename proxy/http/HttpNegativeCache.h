@@ -0,0 +1,54 @@
+/** @file
+
+  Negative responses kept in memory, in front of the disk cache
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+ */
+
+#if !defined (_HttpNegativeCache_h_)
+#define _HttpNegativeCache_h_
+
+#include "HttpTransact.h"
+
+void http_negative_cache_init();
+
+/**
+  Answer the request in s from the negative cache. On a hit the status
+  and body are set up as an internal response, with the age of the
+  entry in @a age.
+
+  @return @c true on a hit.
+*/
+bool http_negative_cache_lookup(HttpTransact::State *s, HTTPStatus *status, int *age);
+
+/**
+  Whether the negative response in s is kept in memory instead of being
+  written to the disk cache. Its body must be delimited by a content
+  length no larger than proxy.config.http.negative_cache.max_body.
+*/
+bool http_negative_cache_admit(HttpTransact::State *s);
+
+/// Keep the response in s, with the len bytes of body in reader, for ttl seconds.
+bool http_negative_cache_store(HttpTransact::State *s, IOBufferReader *reader, int64_t len, int ttl);
+
+/// Drop the entry for the cache key of the request in s, if any.
+void http_negative_cache_forget(HttpTransact::State *s);
+
+#endif
@@ -33,6 +33,7 @@
 #include "HttpPages.h"
 #include "HttpSM.h"
 #include "HttpDebugNames.h"
+#include "HttpConnectionCount.h"
 
 HttpSMListBucket HttpSMList[HTTP_LIST_BUCKETS];
 
@@ -467,10 +468,60 @@ http_pages_callback(Continuation * cont, HTTPHdr * header)
   return &handler->action;
 }
 
+struct OriginsPage
+{
+  char *buffer;
+  int size;
+  int len;
+};
+
+static void
+origins_page_line(const IpEndpoint& addr, const ConnectionCount::Counter& c, void *cookie)
+{
+  OriginsPage *page = (OriginsPage *)cookie;
+  char addrbuf[INET6_ADDRSTRLEN];
+
+  if (page->size - page->len < 256) {
+    page->size *= 2;
+    page->buffer = (char *)ats_realloc(page->buffer, page->size);
+  }
+  page->len += snprintf(page->buffer + page->len, page->size - page->len,
+                        "<tr><td>%s</td><td>%d</td><td>%" PRId64 "</td><td>%" PRId64 "</td></tr>\n",
+                        ats_ip_ntop(&addr.sa, addrbuf, sizeof(addrbuf)), c.count, c.waits,
+                        c.waits ? c.wait_usec / c.waits / 1000 : 0);
+}
+
+// http://{origins}/, the connection count of each origin server and
+// how long connects waited on proxy.config.http.origin_max_connections
+static Action *
+origins_pages_callback(Continuation * cont, HTTPHdr * /* header ATS_UNUSED */)
+{
+  OriginsPage page;
+  StatPageData data;
+
+  page.size = 4096;
+  page.buffer = (char *)ats_malloc(page.size);
+  page.len = snprintf(page.buffer, page.size, "<H3>Origin servers</H3>\n<table border=1><tr><th>Address</th>"
+                      "<th>Connections</th><th>Waits</th><th>Average wait msec</th></tr>\n");
+  ConnectionCount::getInstance()->forEach(origins_page_line, &page);
+  if (page.size - page.len < 16) {
+    page.size += 16;
+    page.buffer = (char *)ats_realloc(page.buffer, page.size);
+  }
+  page.len += snprintf(page.buffer + page.len, page.size - page.len, "</table>\n");
+
+  data.data = page.buffer;
+  data.length = page.len;
+  cont->handleEvent(STAT_PAGE_SUCCESS, &data);
+
+  return ACTION_RESULT_DONE;
+}
+
 void
 http_pages_init()
 {
   statPagesManager.register_http("http", http_pages_callback);
+  statPagesManager.register_http("origins", origins_pages_callback);
 
   // Create the mutexes for http list protection
   for (int i = 0; i < HTTP_LIST_BUCKETS; i++) {
@@ -0,0 +1,257 @@
+/** @file
+
+  Request bodies buffered in full before they are sent to the origin server
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+ */
+
+/****************************************************************************
+
+  HttpPostBuffer.cc
+
+  A request body is buffered when the state machine may need to send it
+  more than once, to retry a failed connection or to follow a redirect.
+  Only one AIO is ever in flight for a body: while the client sends it,
+  the write of the last staged chunk, and while it is replayed, the read
+  of the next chunk. A client sending faster than the disk takes it is
+  held off by not reenabling its read until the write completes.
+
+****************************************************************************/
+
+#include "HttpPostBuffer.h"
+#include "P_AIO.h"
+
+HttpPostBuffer::HttpPostBuffer(Continuation * sm_arg, int64_t length_arg, int64_t memory_size_arg)
+  : Continuation(sm_arg->mutex), sm(sm_arg), length(length_arg), memory_size(memory_size_arg), received(0),
+    mem(NULL), mem_reader(NULL), mem_bytes(0), fd(-1), stage_cur(0), stage_fill(0), file_bytes(0),
+    io(NULL), io_pending(false), io_write(false), failed(false), dead(false),
+    replay(NULL), replay_vio(NULL), replay_block(), replay_offset(0), replay_gen(0), io_gen(0)
+{
+  SET_HANDLER(&HttpPostBuffer::io_event);
+  stage[0] = stage[1] = NULL;
+  mem = new_empty_MIOBuffer(HTTP_POST_BUFFER_CHUNK_INDEX);
+  mem_reader = mem->alloc_reader();
+}
+
+HttpPostBuffer::~HttpPostBuffer()
+{
+  ink_assert(!io_pending);
+  replay_block = NULL;
+  if (replay)
+    free_MIOBuffer(replay);
+  free_MIOBuffer(mem);
+  for (int i = 0; i < 2; i++) {
+    if (stage[i])
+      ioBufAllocator[HTTP_POST_BUFFER_CHUNK_INDEX].free_void(stage[i]);
+  }
+  if (fd >= 0)
+    close(fd);
+  delete io;
+  mutex.clear();
+}
+
+bool
+HttpPostBuffer::open(const char *spill_dir)
+{
+  char path[PATH_NAME_MAX + 1];
+
+  if (length <= memory_size)
+    return true;
+
+  snprintf(path, sizeof(path), "%s/post_buffer.XXXXXX", spill_dir);
+  if ((fd = mkstemp(path)) < 0) {
+    Warning("unable to create a request body file in %s: %s", spill_dir, strerror(errno));
+    return false;
+  }
+  // Nobody else needs the name, the file goes away with the descriptor
+  unlink(path);
+
+  stage[0] = (char *) ioBufAllocator[HTTP_POST_BUFFER_CHUNK_INDEX].alloc_void();
+  stage[1] = (char *) ioBufAllocator[HTTP_POST_BUFFER_CHUNK_INDEX].alloc_void();
+  io = new_AIOCallback();
+  return true;
+}
+
+int64_t
+HttpPostBuffer::append(IOBufferReader * reader, int64_t len)
+{
+  int64_t done = 0;
+
+  if (failed)
+    return 0;
+  len = MIN(len, length - received);
+
+  if (mem_bytes < memory_size) {
+    // Share the blocks the client read into, no copy
+    done = mem->write(reader, MIN(len, memory_size - mem_bytes));
+    reader->consume(done);
+    mem_bytes += done;
+  }
+
+  while (done < len && fd >= 0 && !is_blocked()) {
+    int64_t n = reader->read(stage[stage_cur] + stage_fill, MIN(len - done, HTTP_POST_BUFFER_CHUNK - stage_fill));
+
+    if (n <= 0)
+      break;
+    stage_fill += n;
+    done += n;
+    if (stage_fill == HTTP_POST_BUFFER_CHUNK)
+      spill();
+  }
+
+  received += done;
+  if (received == length)
+    spill();
+  return done;
+}
+
+// Write the staged chunk to the scratch file, and stage the next one
+// in the other buffer. With a write already in flight, the chunk waits.
+void
+HttpPostBuffer::spill()
+{
+  if (io_pending || !stage_fill)
+    return;
+
+  io->aiocb.aio_fildes = fd;
+  io->aiocb.aio_buf = stage[stage_cur];
+  io->aiocb.aio_nbytes = stage_fill;
+  io->aiocb.aio_offset = file_bytes;
+  io->action = this;
+  io->thread = mutex->thread_holding;
+  io_pending = true;
+  io_write = true;
+
+  stage_cur ^= 1;
+  stage_fill = 0;
+  ink_aio_write(io, 1);
+}
+
+IOBufferReader *
+HttpPostBuffer::replay_open()
+{
+  ink_assert(is_complete());
+  replay_close();
+
+  replay = new_empty_MIOBuffer(HTTP_POST_BUFFER_CHUNK_INDEX);
+  IOBufferReader *reader = replay->alloc_reader();
+
+  replay->write(mem_reader, mem_bytes);
+  replay_offset = 0;
+  return reader;
+}
+
+void
+HttpPostBuffer::replay_start(VIO * vio)
+{
+  replay_vio = vio;
+  replay_read();
+}
+
+// Read the next chunk of the file back, unless the server write is
+// already two chunks behind.
+void
+HttpPostBuffer::replay_read()
+{
+  if (io_pending || dead || failed || !replay_vio || replay_offset >= file_bytes)
+    return;
+  if (mem_bytes + replay_offset - replay_vio->ndone >= 2 * HTTP_POST_BUFFER_CHUNK)
+    return;
+
+  replay_block = new_IOBufferBlock();
+  replay_block->alloc(HTTP_POST_BUFFER_CHUNK_INDEX);
+
+  io->aiocb.aio_fildes = fd;
+  io->aiocb.aio_buf = replay_block->end();
+  io->aiocb.aio_nbytes = MIN(HTTP_POST_BUFFER_CHUNK, file_bytes - replay_offset);
+  io->aiocb.aio_offset = replay_offset;
+  io->action = this;
+  io->thread = mutex->thread_holding;
+  io_pending = true;
+  io_write = false;
+  io_gen = replay_gen;
+  ink_aio_read(io, 1);
+}
+
+void
+HttpPostBuffer::replay_close()
+{
+  // A read still in flight is dropped when it completes
+  replay_gen++;
+  replay_vio = NULL;
+  if (replay) {
+    free_MIOBuffer(replay);
+    replay = NULL;
+  }
+}
+
+void
+HttpPostBuffer::destroy()
+{
+  replay_close();
+  dead = true;
+  if (!io_pending)
+    delete this;
+}
+
+int
+HttpPostBuffer::io_event(int /* event ATS_UNUSED */, void * /* data ATS_UNUSED */)
+{
+  bool ok = io->aio_result == (int64_t) io->aiocb.aio_nbytes;
+
+  io_pending = false;
+  if (dead) {
+    delete this;
+    return EVENT_DONE;
+  }
+
+  if (io_write) {
+    if (ok) {
+      file_bytes += io->aio_result;
+      if (is_blocked() || received == length)
+        spill();
+    } else {
+      Warning("unable to write a request body file, result %" PRId64, io->aio_result);
+      failed = true;
+    }
+    // The state machine may destroy us, nothing after this
+    sm->handleEvent(HTTP_POST_BUFFER_EVENT_READY, this);
+    return EVENT_DONE;
+  }
+
+  if (io_gen != replay_gen) {
+    replay_block = NULL;
+    replay_read();
+  } else if (!ok) {
+    Warning("unable to read a request body file, result %" PRId64, io->aio_result);
+    failed = true;
+    replay_block = NULL;
+    VIO *vio = replay_vio;
+    vio->get_continuation()->handleEvent(VC_EVENT_ERROR, vio);
+  } else {
+    replay_block->fill(io->aio_result);
+    replay->append_block(replay_block);
+    replay_block = NULL;
+    replay_offset += io->aio_result;
+    replay_vio->reenable();
+    replay_read();
+  }
+  return EVENT_DONE;
+}
@@ -0,0 +1,122 @@
+/** @file
+
+  Request bodies buffered in full before they are sent to the origin server
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+ */
+
+#if !defined (_HttpPostBuffer_h_)
+#define _HttpPostBuffer_h_
+
+#include "P_EventSystem.h"
+#include "I_AIO.h"
+
+/// Sent to the state machine when a spill write completes.
+#define HTTP_POST_BUFFER_EVENT_READY       (HTTP_TUNNEL_EVENTS_START + 10)
+
+#define HTTP_POST_BUFFER_CHUNK_INDEX       BUFFER_SIZE_INDEX_128K
+#define HTTP_POST_BUFFER_CHUNK             BUFFER_SIZE_FOR_INDEX(HTTP_POST_BUFFER_CHUNK_INDEX)
+
+/**
+  A request body of known length, held by the proxy until the client
+  has sent all of it, so that it can be sent to the origin server again
+  and again without reading it from the client.
+
+  The first memory_size bytes share the IOBuffer blocks the client
+  read them into. The rest is copied into a staging chunk, and written
+  out to an unlinked scratch file with AIO while the next chunk fills.
+  On replay the memory blocks are handed to the server write as they
+  are, and the file is read back into new blocks a couple of chunks
+  ahead of the write.
+
+  The buffer runs under the mutex of the state machine, which it calls
+  back with HTTP_POST_BUFFER_EVENT_READY when a spill write completes,
+  and with VC_EVENT_ERROR on the replay VIO when the file can not be
+  read back.
+*/
+class HttpPostBuffer:public Continuation
+{
+public:
+  HttpPostBuffer(Continuation * sm, int64_t length, int64_t memory_size);
+
+  /// Create the scratch file if the body does not fit in memory.
+  bool open(const char *spill_dir);
+
+  /// Take up to len bytes from the reader, returns the bytes consumed.
+  int64_t append(IOBufferReader * reader, int64_t len);
+
+  /// No more bytes can be taken until a spill write completes.
+  bool is_blocked() const { return stage_fill == HTTP_POST_BUFFER_CHUNK; }
+  /// The whole body is in memory or on disk.
+  bool is_complete() const
+  {
+    return !failed && received == length && !stage_fill && !io_pending;
+  }
+  bool has_failed() const { return failed; }
+  int64_t get_length() const { return length; }
+
+  /// Start a replay of the body, returns the reader for the server write.
+  IOBufferReader *replay_open();
+  /// Read the spilled part back as the server write VIO consumes it.
+  void replay_start(VIO * vio);
+  /// The server write made progress, keep the read ahead going.
+  void replay_reenable() { replay_read(); }
+  void replay_close();
+
+  /// Free the buffer, or leave it to the pending IO to do.
+  void destroy();
+
+private:
+  ~HttpPostBuffer();
+
+  int io_event(int event, void *data);
+  void spill();
+  void replay_read();
+
+  Continuation *sm;
+  int64_t length;
+  int64_t memory_size;
+  int64_t received;
+
+  MIOBuffer *mem;
+  IOBufferReader *mem_reader;
+  int64_t mem_bytes;
+
+  int fd;
+  char *stage[2];
+  int stage_cur;
+  int64_t stage_fill;
+  int64_t file_bytes;
+
+  AIOCallback *io;
+  bool io_pending;
+  bool io_write;
+  bool failed;
+  bool dead;
+
+  MIOBuffer *replay;
+  VIO *replay_vio;
+  Ptr<IOBufferBlock> replay_block;
+  int64_t replay_offset;
+  int replay_gen;
+  int io_gen;
+};
+
+#endif
@@ -32,16 +32,28 @@
 #include "HttpUpdateSM.h"
 #include "HttpClientSession.h"
 #include "HttpPages.h"
+#include "HttpTrace.h"
+#include "HttpStaleRevalidate.h"
+#include "HttpNegativeCache.h"
 #include "HttpTunnel.h"
 #include "Tokenizer.h"
 #include "P_SSLNextProtocolAccept.h"
+#include "HTTP2.h"
+#include "Http2SessionAccept.h"
+#include "ProcessManager.h"
 
 HttpAccept *plugin_http_accept = NULL;
 HttpAccept *plugin_http_transparent_accept = 0;
 
+volatile bool http_proxy_server_draining = false;
+static Action *backdoor_accept_action = NULL;
+
 static SLL<SSLNextProtocolAccept> ssl_plugin_acceptors;
 static ProcessMutex ssl_plugin_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+// Offer HTTP/2 on SSL ports (proxy.config.http2.enabled).
+static int http2_enabled = 0;
+
 bool
 ssl_register_protocol(const char * protocol, Continuation * contp)
 {
@@ -89,10 +101,12 @@ struct HttpProxyAcceptor {
   Continuation* _accept;
   /// Options for @c NetProcessor.
   NetProcessor::AcceptOptions _net_opt;
+  /// The accept once started, for @c NetProcessor::stop_accept().
+  Action* _action;
 
   /// Default constructor.
   HttpProxyAcceptor()
-    : _accept(0)
+    : _accept(0), _action(0)
     {
     }
 };
@@ -119,6 +133,8 @@ make_net_accept_options(const HttpProxyPort& port, unsigned nthreads)
   net.f_inbound_transparent = port.m_inbound_transparent_p;
   net.ip_family = port.m_family;
   net.local_port = port.m_port;
+  net.f_tcp_fastopen = port.m_tcp_fastopen;
+  net.defer_accept = port.m_defer_accept;
 
   if (port.m_inbound_ip.isValid()) {
     net.local_ip = port.m_inbound_ip;
@@ -165,6 +181,10 @@ MakeHttpProxyAcceptor(HttpProxyAcceptor& acceptor, HttpProxyPort& port, unsigned
     SSLNextProtocolAccept * ssl = NEW(new SSLNextProtocolAccept(accept));
     ssl->registerEndpoint(TS_NPN_PROTOCOL_HTTP_1_0, accept);
     ssl->registerEndpoint(TS_NPN_PROTOCOL_HTTP_1_1, accept);
+    // The most recently registered protocol is advertised first, and so preferred.
+    if (http2_enabled) {
+      ssl->registerEndpoint(TS_NPN_PROTOCOL_HTTP_2_0, NEW(new Http2SessionAccept(accept)));
+    }
 
     ink_scoped_mutex lock(ssl_plugin_mutex);
     ssl_plugin_acceptors.push(ssl);
@@ -182,9 +202,12 @@ init_HttpProxyServer(int n_accept_threads)
 {
   HttpProxyPort::Group& proxy_ports = HttpProxyPort::global();
 
-  init_reverse_proxy();
+  // init_reverse_proxy() is left to the caller, which may build the remap table beside this.
   httpSessionManager.init();
   http_pages_init();
+  http_trace_init();
+  http_stale_revalidate_init();
+  http_negative_cache_init();
   ink_mutex_init(&debug_sm_list_mutex, "HttpSM Debug List");
   ink_mutex_init(&debug_cs_list_mutex, "HttpCS Debug List");
   // DI's request to disable/reenable ICP on the fly
@@ -207,6 +230,10 @@ init_HttpProxyServer(int n_accept_threads)
   }
   ink_mutex_init(&ssl_plugin_mutex, "SSL Acceptor List");
 
+  // Origin servers may be spoken to in HTTP/2 whether or not clients are
+  REC_ReadConfigInteger(http2_enabled, "proxy.config.http2.enabled");
+  Http2::init();
+
   // Do the configuration defined ports.
   for ( int i = 0 , n = proxy_ports.length() ; i < n ; ++i ) {
     MakeHttpProxyAcceptor(HttpProxyAcceptors.add(), proxy_ports[i], n_accept_threads);
@@ -231,10 +258,10 @@ start_HttpProxyServer()
     HttpProxyAcceptor& acceptor = HttpProxyAcceptors[i];
     HttpProxyPort& port = proxy_ports[i];
     if (port.isSSL()) {
-      if (NULL == sslNetProcessor.main_accept(acceptor._accept, port.m_fd, acceptor._net_opt))
+      if (NULL == (acceptor._action = sslNetProcessor.main_accept(acceptor._accept, port.m_fd, acceptor._net_opt)))
         return;
     } else {
-      if (NULL == netProcessor.main_accept(acceptor._accept, port.m_fd, acceptor._net_opt))
+      if (NULL == (acceptor._action = netProcessor.main_accept(acceptor._accept, port.m_fd, acceptor._net_opt)))
         return;
     }
     // XXX although we make a good pretence here, I don't believe that NetProcessor::main_accept() ever actually returns
@@ -254,6 +281,8 @@ start_HttpProxyServer()
     hook = hook->next();
   }
 
+  // In a hot upgrade, the manager now tells the old process to drain.
+  pmgmt->signalManager(MGMT_SIGNAL_PROXY_PORTS_READY, "");
 }
 
 void
@@ -269,5 +298,65 @@ start_HttpProxyServerBackDoor(int port, int accept_threads)
   opt.backdoor = true;
   
   // The backdoor only binds the loopback interface
-  netProcessor.main_accept(NEW(new HttpAccept(ha_opt)), NO_FD, opt);
+  backdoor_accept_action = netProcessor.main_accept(NEW(new HttpAccept(ha_opt)), NO_FD, opt);
+}
+
+void
+stop_HttpProxyServerBackDoor()
+{
+  if (backdoor_accept_action) {
+    netProcessor.stop_accept(backdoor_accept_action);
+    backdoor_accept_action = NULL;
+  }
+}
+
+/** Exits the process once the client connections are gone, or at the
+    drain timeout.
+*/
+struct HttpProxyServerDrain: public Continuation
+{
+  ink_hrtime deadline;
+
+  HttpProxyServerDrain(int timeout)
+    : Continuation(new_ProxyMutex()), deadline(ink_get_hrtime() + HRTIME_SECONDS(timeout))
+  {
+    SET_HANDLER(&HttpProxyServerDrain::check_event);
+  }
+
+  int check_event(int /* event ATS_UNUSED */, void * /* data ATS_UNUSED */)
+  {
+    int64_t open = 0;
+
+    HTTP_READ_DYN_SUM(http_current_client_connections_stat, open);
+    if (open > 0 && ink_get_hrtime() < deadline)
+      return EVENT_CONT;
+
+    if (open > 0)
+      Warning("drain timed out with %" PRId64 " client connections open, exiting", open);
+    else
+      Note("client connections drained, exiting");
+    _exit(0);
+    return EVENT_DONE;
+  }
+};
+
+void
+drain_HttpProxyServer(int timeout)
+{
+  HttpProxyPort::Group& proxy_ports = HttpProxyPort::global();
+
+  Note("draining client connections, for up to %d seconds", timeout);
+  http_proxy_server_draining = true;
+  for (int i = 0, n = proxy_ports.length(); i < n; ++i) {
+    HttpProxyAcceptor& acceptor = HttpProxyAcceptors[i];
+
+    if (acceptor._action) {
+      if (proxy_ports[i].isSSL())
+        sslNetProcessor.stop_accept(acceptor._action);
+      else
+        netProcessor.stop_accept(acceptor._action);
+    }
+  }
+  stop_HttpProxyServerBackDoor();
+  eventProcessor.schedule_every(NEW(new HttpProxyServerDrain(timeout)), HRTIME_SECONDS(1));
 }
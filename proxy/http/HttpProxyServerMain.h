@@ -34,4 +34,17 @@ void start_HttpProxyServer();
 
 void start_HttpProxyServerBackDoor(int port, int accept_threads = 0);
 
+/** Stop accepting on the backdoor port, and release it for a new process.
+ */
+void stop_HttpProxyServerBackDoor();
+
+/** Stop accepting on the proxy ports, which another traffic_server has
+    taken over, and exit once the client connections are done or after
+    @a timeout seconds. Keep-alive is turned off meanwhile.
+*/
+void drain_HttpProxyServer(int timeout);
+
+/// Set by @c drain_HttpProxyServer().
+extern volatile bool http_proxy_server_draining;
+
 NetProcessor::AcceptOptions make_net_accept_options(const HttpProxyPort& port, unsigned nthreads);
@@ -40,6 +40,9 @@
 #include "Transform.h"
 
 #include "HttpPages.h"
+#include "HttpTrace.h"
+#include "HttpNegativeCache.h"
+#include "HttpProxyServerMain.h"
 
 //#include "I_Auth.h"
 //#include "HttpAuthParams.h"
@@ -296,7 +299,8 @@ history[pos].fileline = __FILE__ ":" _REMEMBER (__LINE__);
 #define STATE_ENTER(state_name, event) { \
     /*ink_assert (magic == HTTP_SM_MAGIC_ALIVE); */ REMEMBER (event, reentrancy_count);  \
         DebugSM("http", "[%" PRId64 "] [%s, %s]", sm_id, \
-        #state_name, HttpDebugNames::get_event_name(event)); }
+        #state_name, HttpDebugNames::get_event_name(event)); \
+    if (unlikely(trace_on)) http_trace_record(sm_id, #state_name, event); }
 
 #define HTTP_SM_SET_DEFAULT_HANDLER(_h) \
 { \
@@ -311,13 +315,13 @@ HttpSM::HttpSM()
   : Continuation(NULL), sm_id(-1), magic(HTTP_SM_MAGIC_DEAD),
     //YTS Team, yamsat Plugin
     enable_redirection(false), api_enable_redirection(true), redirect_url(NULL), redirect_url_len(0), redirection_tries(0), transfered_bytes(0),
-    post_failed(false), debug_on(false),
+    post_failed(false), debug_on(false), trace_on(false),
     plugin_tunnel_type(HTTP_NO_PLUGIN_TUNNEL),
     plugin_tunnel(NULL), reentrancy_count(0),
-    history_pos(0), tunnel(), ua_entry(NULL),
+    history_pos(0), tunnel(), post_buffer(NULL), ua_entry(NULL),
     ua_session(NULL), background_fill(BACKGROUND_FILL_NONE),
     ua_raw_buffer_reader(NULL),
-    server_entry(NULL), server_session(NULL), shared_session_retries(0),
+    server_entry(NULL), server_session(NULL), shared_session_retries(0), origin_wait_start(0), server_open_time(0),
     server_buffer_reader(NULL),
     transform_info(), post_transform_info(), has_active_plugin_agents(false),
     second_cache_sm(NULL),
@@ -329,8 +333,12 @@ HttpSM::HttpSM()
     client_response_hdr_bytes(0), client_response_body_bytes(0),
     cache_response_hdr_bytes(0), cache_response_body_bytes(0),
     pushed_response_hdr_bytes(0), pushed_response_body_bytes(0),
-    hooks_set(0), cur_hook_id(TS_HTTP_LAST_HOOK), cur_hook(NULL),
-    cur_hooks(0), callout_state(HTTP_API_NO_CALLOUT), terminate_sm(false), kill_this_async_done(false)
+    plugin_hook_time(0), plugin_slowest(NULL), plugin_slowest_time(0),
+    hooks_set(0), cur_hook_id(TS_HTTP_LAST_HOOK), cur_hook(NULL), prev_hook_start_time(0),
+    plugin_hook_plugin(NULL), plugin_hook_id(0), plugin_hook_start(0),
+    cur_hooks(0), callout_state(HTTP_API_NO_CALLOUT), terminate_sm(false), kill_this_async_done(false),
+    pipeline_session(NULL), pipeline_failed(false), http2_attempted(false), http2_connecting(false),
+    negative_body_reader(NULL), num_body_observers(0)
 {
   static int scatter_init = 0;
 
@@ -592,6 +600,7 @@ HttpSM::attach_client_session(HttpClientSession * client_vc, IOBufferReader * bu
   ua_session = client_vc;
   mutex = client_vc->mutex;
   if (ua_session->debug_on) debug_on = true;
+  trace_on = http_trace_sampled();
 
   start_sub_sm();
 
@@ -759,6 +768,9 @@ HttpSM::state_read_client_request_header(int event, void *data)
     http_parser_clear(&http_parser);
     ua_entry->vc_handler = &HttpSM::state_watch_for_client_abort;
     milestones.ua_read_header_done = ink_get_hrtime();
+    if (http_trace_header && state == PARSE_DONE &&
+        t_state.hdr_info.client_request.field_find(http_trace_header, http_trace_header_len))
+      trace_on = true;
   }
 
   int method;
@@ -840,6 +852,10 @@ HttpSM::state_read_client_request_header(int event, void *data)
     } else {
       ua_session->get_netvc()->cancel_active_timeout();
     }
+    if (is_health_check()) {
+      do_health_check();
+      break;
+    }
     call_transact_and_set_next_state(HttpTransact::ModifyRequest);
 
     break;
@@ -960,6 +976,59 @@ HttpSM::state_watch_for_client_abort(int event, void *data)
   return 0;
 }
 
+// int HttpSM::state_buffer_request_body(int event, void* data)
+//
+//   Reads the request body into the post buffer. The client read is
+//   only reenabled when the buffer can take more, a client faster
+//   than the scratch file waits for the spill write to complete.
+//
+int
+HttpSM::state_buffer_request_body(int event, void *data)
+{
+  STATE_ENTER(&HttpSM::state_buffer_request_body, event);
+
+  switch (event) {
+  case VC_EVENT_READ_READY:
+  case VC_EVENT_READ_COMPLETE:
+    ink_assert(ua_entry->read_vio == (VIO *) data);
+    break;
+  case HTTP_POST_BUFFER_EVENT_READY:
+    ink_assert(post_buffer == (HttpPostBuffer *) data);
+    break;
+  case VC_EVENT_EOS:
+  case VC_EVENT_ERROR:
+  case VC_EVENT_ACTIVE_TIMEOUT:
+  case VC_EVENT_INACTIVITY_TIMEOUT:
+    // The client left before sending the whole body
+    ua_entry->read_vio->nbytes = ua_entry->read_vio->ndone;
+    milestones.ua_close = ink_get_hrtime();
+    set_ua_abort(HttpTransact::ABORTED, event);
+    terminate_sm = true;
+    return 0;
+  default:
+    ink_release_assert(0);
+    break;
+  }
+
+  client_request_body_bytes += post_buffer->append(ua_buffer_reader, ua_buffer_reader->read_avail());
+
+  if (post_buffer->has_failed()) {
+    ua_entry->vc_handler = &HttpSM::state_watch_for_client_abort;
+    ua_entry->read_vio->nbytes = ua_entry->read_vio->ndone;
+    call_transact_and_set_next_state(HttpTransact::PostBufferFailed);
+  } else if (post_buffer->is_complete()) {
+    DebugSM("http", "[%" PRId64 "] request body of %" PRId64 " bytes buffered", sm_id, post_buffer->get_length());
+    ua_entry->vc_handler = &HttpSM::state_watch_for_client_abort;
+    ua_entry->read_vio = ua_entry->vc->do_io_read(this, INT64_MAX, ua_buffer_reader->mbuf);
+    HTTP_SM_SET_DEFAULT_HANDLER(&HttpSM::state_http_server_open);
+    do_http_server_open();
+  } else if (!post_buffer->is_blocked()) {
+    ua_entry->read_vio->reenable();
+  }
+
+  return 0;
+}
+
 void
 HttpSM::setup_push_read_response_header()
 {
@@ -1329,6 +1398,7 @@ HttpSM::state_api_callback(int event, void *data)
 
   STATE_ENTER(&HttpSM::state_api_callback, event);
 
+  plugin_hook_end();
   state_api_callout(event, data);
 
   // The sub-handler signals when it is time for the state
@@ -1379,33 +1449,62 @@ HttpSM::state_api_callout(int event, void *data)
   case EVENT_NONE:
   case HTTP_API_CONTINUE:
     if ((cur_hook_id >= 0) && (cur_hook_id < TS_HTTP_LAST_HOOK)) {
-      if (!cur_hook) {
-        if (cur_hooks == 0) {
-          cur_hook = http_global_hooks->get(cur_hook_id);
-          cur_hooks++;
+      for (;;) {
+        if (!cur_hook) {
+          if (cur_hooks == 0) {
+            cur_hook = http_global_hooks->get(cur_hook_id);
+            cur_hooks++;
+          }
         }
-      }
-      // even if ua_session is NULL, cur_hooks must
-      // be incremented otherwise cur_hooks is not set to 2 and
-      // transaction hooks (stored in api_hooks object) are not called.
-      if (!cur_hook) {
-        if (cur_hooks == 1) {
-          if (ua_session) {
-            cur_hook = ua_session->ssn_hook_get(cur_hook_id);
+        // even if ua_session is NULL, cur_hooks must
+        // be incremented otherwise cur_hooks is not set to 2 and
+        // transaction hooks (stored in api_hooks object) are not called.
+        if (!cur_hook) {
+          if (cur_hooks == 1) {
+            if (ua_session) {
+              cur_hook = ua_session->ssn_hook_get(cur_hook_id);
+            }
+            cur_hooks++;
           }
-          cur_hooks++;
         }
-      }
-      if (!cur_hook) {
-        if (cur_hooks == 2) {
-          cur_hook = api_hooks.get(cur_hook_id);
-          cur_hooks++;
+        if (!cur_hook) {
+          if (cur_hooks == 2) {
+            cur_hook = api_hooks.get(cur_hook_id);
+            cur_hooks++;
+          }
         }
-      }
-      if (cur_hook) {
+        if (!cur_hook) {
+          break;
+        }
+
         if (callout_state == HTTP_API_NO_CALLOUT) {
           callout_state = HTTP_API_IN_CALLOUT;
         }
+        if (!prev_hook_start_time) {
+          prev_hook_start_time = ink_get_hrtime();
+        }
+
+        // Fast hooks are called inline and return their decision, so
+        //   keep walking the hook list until we reach a regular hook.
+        if (cur_hook->is_fast()) {
+          DebugSM("http", "[%" PRId64 "] calling fast plugin hook %s at hook %p",
+                sm_id, HttpDebugNames::get_api_hook_name(cur_hook_id), cur_hook);
+
+          APIHook *hook = cur_hook;
+          cur_hook = cur_hook->next();
+
+          TSEvent result;
+          {
+            PluginHookScope scope(hook->m_plugin);
+            plugin_hook_begin(hook->m_plugin, cur_hook_id);
+            result = hook->invoke_fast(reinterpret_cast<TSHttpTxn>(this), cur_hook_id);
+            plugin_hook_end();
+          }
+          if (result == TS_EVENT_HTTP_CONTINUE) {
+            continue;
+          }
+          return state_api_callout(HTTP_API_ERROR, NULL);
+        }
 
         /* The MUTEX_TRY_LOCK macro was changed so
            that it can't handle NULL mutex'es.  The plugins
@@ -1436,7 +1535,9 @@ HttpSM::state_api_callout(int event, void *data)
         APIHook *hook = cur_hook;
         cur_hook = cur_hook->next();
 
+        plugin_hook_begin(hook->m_plugin, cur_hook_id);
         hook->invoke(TS_EVENT_HTTP_READ_REQUEST_HDR + cur_hook_id, this);
+        plugin_hook_end();
 
         if (plugin_lock) {
           Mutex_unlock(plugin_mutex, mutex->thread_holding);
@@ -1445,6 +1546,11 @@ HttpSM::state_api_callout(int event, void *data)
         return 0;
       }
     }
+    // The plugins at this hook are done
+    if (prev_hook_start_time) {
+      milestones.plugin_total += ink_get_hrtime() - prev_hook_start_time;
+      prev_hook_start_time = 0;
+    }
     // Map the callout state into api_next
     switch (callout_state) {
     case HTTP_API_NO_CALLOUT:
@@ -1467,6 +1573,10 @@ HttpSM::state_api_callout(int event, void *data)
     break;
 
   case HTTP_API_ERROR:
+    if (prev_hook_start_time) {
+      milestones.plugin_total += ink_get_hrtime() - prev_hook_start_time;
+      prev_hook_start_time = 0;
+    }
     if (callout_state == HTTP_API_DEFERED_CLOSE) {
       api_next = API_RETURN_DEFERED_CLOSE;
     } else if (cur_hook_id == TS_HTTP_TXN_CLOSE_HOOK) {
@@ -1671,7 +1781,25 @@ HttpSM::state_http_server_open(int event, void *data)
 
   switch (event) {
   case NET_EVENT_OPEN:
-    session = (2 == t_state.txn_conf->share_server_sessions) ? 
+    server_open_time = milestones.server_connect;
+    if (http2_connecting) {
+      NetVConnection *stream_vc;
+
+      http2_connecting = false;
+      HTTP_INCREMENT_DYN_STAT(http_http2_origin_connections_stat);
+      stream_vc = httpSessionManager.add_http2_session((NetVConnection *) data, &t_state.current.server->addr.sa);
+      if (stream_vc == NULL) {
+        t_state.current.state = HttpTransact::CONNECTION_ERROR;
+        t_state.current.server->set_connect_fail(ECONNABORTED);
+        call_transact_and_set_next_state(HttpTransact::HandleResponse);
+        return 0;
+      }
+      attach_http2_stream(stream_vc);
+      handle_http_server_open();
+      return 0;
+    }
+
+    session = (2 <= t_state.txn_conf->share_server_sessions) ? 
       THREAD_ALLOC_INIT(httpServerSessionAllocator, mutex->thread_holding) :
       httpServerSessionAllocator.alloc();
     session->share_session = t_state.txn_conf->share_server_sessions;
@@ -1957,12 +2085,19 @@ HttpSM::state_send_server_request_header(int event, void *data)
          method != HTTP_WKSIDX_TRACE &&
          (t_state.hdr_info.request_content_length > 0 || t_state.client_info.transfer_encoding == HttpTransact::CHUNKED_ENCODING)) {
 
-      if (post_transform_info.vc) {
+      if (post_buffer) {
+        do_send_buffered_request_body();
+      } else if (post_transform_info.vc) {
         setup_transform_to_server_transfer();
       } else {
         do_setup_post_tunnel(HTTP_SERVER_VC);
       }
     } else {
+      // Requests to the same origin may be pipelined behind ours
+      if (can_pipeline_request()) {
+        server_session->attach_hostname(t_state.current.server->name);
+        httpSessionManager.pipeline_list(server_session, t_state.txn_conf->server_pipeline_depth);
+      }
       // It's time to start reading the response
       setup_server_read_response_header();
     }
@@ -2025,6 +2160,99 @@ HttpSM::state_send_server_request_header(int event, void *data)
   return 0;
 }
 
+// int HttpSM::state_send_buffered_request_body(int event, void* data)
+//
+//   Sends the request body from the post buffer. If the server fails
+//   before reading all of it, the request can be retried, the body is
+//   still in the buffer.
+//
+int
+HttpSM::state_wait_for_pipelined_response(int event, void * /* data ATS_UNUSED */)
+{
+  STATE_ENTER(&HttpSM::state_wait_for_pipelined_response, event);
+  pending_action = NULL;
+
+  HttpServerSession *s = pipeline_session;
+
+  if (event == HTTP_PIPELINE_EVENT_READY && s != NULL) {
+    // The responses ahead of ours have been read, the session is ours
+    pipeline_session = NULL;
+    s->pipeline_attach(this);
+    attach_server_session(s);
+    setup_server_read_response_header();
+  } else {
+    // The session failed before our response, send the request again
+    HTTP_INCREMENT_DYN_STAT(http_pipeline_failures_stat);
+    DebugSM("http_ss", "[%" PRId64 "] pipelined request failed, resending", sm_id);
+    pipeline_session = NULL;
+    pipeline_failed = true;
+    do_http_server_open();
+  }
+
+  return 0;
+}
+
+int
+HttpSM::state_send_buffered_request_body(int event, void *data)
+{
+  STATE_ENTER(&HttpSM::state_send_buffered_request_body, event);
+  ink_assert(server_entry != NULL);
+  ink_assert(server_entry->write_vio == (VIO *) data || server_entry->read_vio == (VIO *) data);
+
+  switch (event) {
+  case VC_EVENT_WRITE_READY:
+    post_buffer->replay_reenable();
+    server_entry->write_vio->reenable();
+    return 0;
+
+  case VC_EVENT_WRITE_COMPLETE:
+    server_request_body_bytes = server_entry->write_vio->ndone;
+    post_buffer->replay_close();
+    setup_server_read_response_header();
+    return 0;
+
+  case VC_EVENT_READ_READY:
+    // An early response, read once the body is sent. See
+    //  state_send_server_request_header()
+    return 0;
+
+  case VC_EVENT_EOS:
+  case VC_EVENT_ERROR:
+  case VC_EVENT_ACTIVE_TIMEOUT:
+  case VC_EVENT_INACTIVITY_TIMEOUT:
+    break;
+
+  default:
+    ink_release_assert(0);
+    break;
+  }
+
+  server_request_body_bytes = server_entry->write_vio->ndone;
+  server_entry->eos = true;
+  post_buffer->replay_close();
+
+  // Don't even think about doing keep-alive after this debacle
+  t_state.client_info.keep_alive = HTTP_NO_KEEPALIVE;
+  t_state.current.server->keep_alive = HTTP_NO_KEEPALIVE;
+
+  if (server_buffer_reader->read_avail() > 0 && !post_buffer->has_failed()) {
+    // The server answered without reading the whole body
+    server_entry->vc->do_io_shutdown(IO_SHUTDOWN_WRITE);
+    setup_server_read_response_header();
+  } else {
+    // A body that can not be read back can not be retried either
+    if (post_buffer->has_failed())
+      t_state.hdr_info.request_body_start = true;
+    vc_table.cleanup_entry(server_entry);
+    server_entry = NULL;
+    server_session = NULL;
+    t_state.current.state = HttpTransact::CONNECTION_CLOSED;
+    call_transact_and_set_next_state(HttpTransact::HandleResponse);
+  }
+
+  return 0;
+}
+
 void
 HttpSM::process_srv_info(HostDBInfo * r)
 {
@@ -2928,9 +3156,20 @@ HttpSM::tunnel_handler_server(int event, HttpTunnelProducer * p)
     break;
   }
 
+  if (negative_body_reader) {
+    int64_t len = t_state.hdr_info.response_content_length;
+
+    if (p->read_success && negative_body_reader->read_avail() >= len &&
+        http_negative_cache_store(&t_state, negative_body_reader, len, t_state.negative_cache_ttl))
+      HTTP_INCREMENT_DYN_STAT(http_negative_cache_stores_stat);
+    negative_body_reader->mbuf->dealloc_reader(negative_body_reader);
+    negative_body_reader = NULL;
+  }
+
   // turn off negative caching in case there are multiple server contacts
   if (t_state.negative_caching)
     t_state.negative_caching = false;
+  t_state.negative_cache_store = false;
 
   // If we had a ground fill, check update our status
   if (background_fill == BACKGROUND_FILL_STARTED) {
@@ -2958,16 +3197,20 @@ HttpSM::tunnel_handler_server(int event, HttpTunnelProducer * p)
     server_session->attach_hostname(t_state.current.server->name);
     server_session->server_trans_stat--;
     HTTP_DECREMENT_DYN_STAT(http_current_server_transactions_stat);
+    if (t_state.hdr_info.server_response.version_get() == HTTPVersion(1, 1))
+      server_session->pipeline_capable = true;
 
     // If the client is still around, attach the server session
     // to so the next ka request can use it.  We bind privately to the
     // client to add some degree of affinity to the system.  However,
     // we turn off private binding when outbound connections are being
     // limit since it makes it too expensive to initiate a purge of idle
-    // server keep-alive sessions
+    // server keep-alive sessions.  A session taking pipelined requests
+    // is shared by definition.
     if (ua_session && t_state.client_info.keep_alive == HTTP_KEEPALIVE &&
         t_state.http_config_param->server_max_connections <= 0 &&
-        t_state.txn_conf->origin_max_connections <= 0) {
+        t_state.txn_conf->origin_max_connections <= 0 &&
+        !server_session->pipeline_listed && !server_session->pipeline_waiting()) {
       ua_session->attach_server_session(server_session);
     } else {
       // Release the session back into the shared session pool
@@ -4017,6 +4260,19 @@ HttpSM::do_hostdb_update_if_necessary()
 
     t_state.updated_server_version = HostDBApplicationInfo::HTTP_VERSION_UNDEFINED;
   }
+  // Fold the time from opening a new connection to the first byte of the
+  //   response into the address's connect_rtt, for rtt_round_robin
+  if (HostDBProcessor::hostdb_rtt_round_robin > 0 && server_open_time != 0 &&
+      milestones.server_first_read > server_open_time && !t_state.current.server->had_connect_fail()) {
+    unsigned int rtt = hostdb_connect_rtt_update(t_state.host_db_info.app.http_data.connect_rtt,
+                                                 milestones.server_first_read - server_open_time);
+
+    server_open_time = 0;
+    if (rtt != t_state.host_db_info.app.http_data.connect_rtt) {
+      t_state.host_db_info.app.http_data.connect_rtt = rtt;
+      issue_update |= 1;
+    }
+  }
   // Check to see if we need to report or clear a connection failure
   if (t_state.current.server->had_connect_fail()) {
     issue_update |= 1;
@@ -4277,7 +4533,11 @@ HttpSM::do_range_setup_if_necessary()
 
     if (t_state.range_setup == HttpTransact::RANGE_REQUESTED && 
         api_hooks.get(TS_HTTP_RESPONSE_TRANSFORM_HOOK) == NULL) {
-      Debug("http_trans", "Unable to accelerate range request, fallback to transform");
+      // with several ranges, read just the ranges from cache and let the
+      // transform only frame them
+      t_state.range_pread = cache_sm.cache_read_vc->is_pread_capable();
+      Debug("http_trans", "Unable to accelerate range request, fallback to transform%s",
+            t_state.range_pread ? ", reading only the ranges" : "");
       content_type = t_state.cache_info.object_read->response_get()->value_get(MIME_FIELD_CONTENT_TYPE, MIME_LEN_CONTENT_TYPE, &field_content_type_len);
       //create a Range: transform processor for requests of type Range: bytes=1-2,4-5,10-100 (eg. multiple ranges)
       range_trans = transformProcessor.range_transform(mutex,
@@ -4286,7 +4546,8 @@ HttpSM::do_range_setup_if_necessary()
           &t_state.hdr_info.transform_response,
           content_type,
           field_content_type_len,
-          t_state.cache_info.object_read->object_size_get()
+          t_state.cache_info.object_read->object_size_get(),
+          t_state.range_pread
           );
       api_hooks.append(TS_HTTP_RESPONSE_TRANSFORM_HOOK, range_trans);
     }
@@ -4315,6 +4576,24 @@ HttpSM::do_cache_lookup_and_read()
   else
     c_url = t_state.cache_info.lookup_url;
 
+  // Negative responses may be answered from memory, without a cache read.
+  // Any other method drops what is kept for the URL.
+  if (t_state.txn_conf->negative_caching_enabled && !t_state.redirect_info.redirect_in_process) {
+    int method = t_state.hdr_info.client_request.method_get_wksidx();
+
+    if (method != HTTP_WKSIDX_GET && method != HTTP_WKSIDX_HEAD) {
+      http_negative_cache_forget(&t_state);
+    } else if (t_state.cache_info.directives.does_client_permit_lookup &&
+               http_negative_cache_lookup(&t_state, &t_state.negative_cache_status, &t_state.negative_cache_ttl)) {
+      DebugSM("http_seq", "[HttpSM::do_cache_lookup_and_read] [%" PRId64 "] Negative cache hit for URL %s",
+              sm_id, c_url->string_get(&t_state.arena));
+      HTTP_INCREMENT_DYN_STAT(http_negative_cache_hits_stat);
+      milestones.cache_open_read_end = ink_get_hrtime();
+      call_transact_and_set_next_state(HttpTransact::HandleNegativeCacheHit);
+      return;
+    }
+  }
+
   DebugSM("http_seq", "[HttpSM::do_cache_lookup_and_read] [%" PRId64 "] Issuing cache lookup for URL %s",  sm_id, c_url->string_get(&t_state.arena));
   Action *cache_action_handle = cache_sm.open_read(c_url,
                                                    &t_state.hdr_info.client_request,
@@ -4477,6 +4756,13 @@ HttpSM::do_http_server_open(bool raw)
 
   ink_assert(pending_action == NULL);
 
+  // A request queued on a session, and now sent again, goes elsewhere
+  if (pipeline_session) {
+    pipeline_session->pipeline_leave(this);
+    pipeline_session = NULL;
+    pipeline_failed = true;
+  }
+
   if (false == t_state.api_server_addr_set) {
     ink_assert(t_state.current.server->port > 0);
     t_state.current.server->addr.port() = htons(t_state.current.server->port);
@@ -4532,7 +4818,19 @@ HttpSM::do_http_server_open(bool raw)
   // to do this but as far I can tell the code that prevented keep-alive if
   // there is a request body has been removed.
 
-  if (raw == false && t_state.txn_conf->share_server_sessions &&
+  // An HTTP/2 request takes a stream on a connection to the origin
+  //  opened by this thread, or opens a new one below
+  http2_connecting = can_use_http2(raw);
+  if (http2_connecting) {
+    NetVConnection *stream_vc = httpSessionManager.acquire_http2_stream(&t_state.current.server->addr.sa);
+
+    if (stream_vc != NULL) {
+      http2_connecting = false;
+      attach_http2_stream(stream_vc);
+      handle_http_server_open();
+      return;
+    }
+  } else if (raw == false && t_state.txn_conf->share_server_sessions &&
       (t_state.txn_conf->keep_alive_post_out == 1 || t_state.hdr_info.request_content_length == 0) &&
        !is_private() && ua_session != NULL) {
     HSMresult_t shared_result;
@@ -4548,6 +4846,11 @@ HttpSM::do_http_server_open(bool raw)
       hsm_release_assert(server_session != NULL);
       handle_http_server_open();
       return;
+    case HSM_PIPELINED:
+      hsm_release_assert(pipeline_session != NULL);
+      HTTP_INCREMENT_DYN_STAT(http_pipelined_requests_stat);
+      setup_server_send_request_api();
+      return;
     case HSM_NOT_FOUND:
       hsm_release_assert(server_session == NULL);
       break;
@@ -4616,14 +4919,28 @@ HttpSM::do_http_server_open(bool raw)
   if (t_state.txn_conf->origin_max_connections > 0) {
     ConnectionCount *connections = ConnectionCount::getInstance();
 
+    ConnectionCount::Counter *counter = connections->getCounter(t_state.current.server->addr);
+
     char addrbuf[INET6_ADDRSTRLEN];
-    if (connections->getCount((t_state.current.server->addr)) >= t_state.txn_conf->origin_max_connections) {
+    if (counter->count >= t_state.txn_conf->origin_max_connections) {
       DebugSM("http", "[%" PRId64 "] over the number of connection for this host: %s", sm_id,
         ats_ip_ntop(&t_state.current.server->addr.sa, addrbuf, sizeof(addrbuf)));
       ink_assert(pending_action == NULL);
+      // Wait in line until a connection to the host closes
+      if (origin_wait_start == 0) {
+        origin_wait_start = ink_get_hrtime();
+        HTTP_INCREMENT_DYN_STAT(http_origin_connect_waits_stat);
+      }
       pending_action = eventProcessor.schedule_in(this, HRTIME_MSECONDS(100));
       return;
     }
+    if (origin_wait_start) {
+      ink_hrtime wait = ink_get_hrtime() - origin_wait_start;
+
+      origin_wait_start = 0;
+      connections->addWait(counter, wait);
+      HTTP_SUM_DYN_STAT(http_origin_connect_wait_time_stat, wait / HRTIME_MSECOND);
+    }
   }
 
   // We did not manage to get an exisiting session
@@ -4940,6 +5257,10 @@ HttpSM::release_server_session(bool serve_from_cache)
       HTTP_DECREMENT_DYN_STAT(http_current_server_transactions_stat);
       server_session->server_trans_stat--;
       server_session->attach_hostname(t_state.current.server->name);
+      // No body, the next response starts right after the header
+      server_session->pipeline_synced = true;
+      if (t_state.hdr_info.server_response.version_get() == HTTPVersion(1, 1))
+        server_session->pipeline_capable = true;
       if (t_state.www_auth_content == HttpTransact::CACHE_AUTH_NONE || serve_from_cache == false)
         server_session->release();
       else {
@@ -5046,7 +5367,7 @@ HttpSM::handle_http_server_open()
   }
 
   int method = t_state.hdr_info.server_request.method_get_wksidx();
-  if (method != HTTP_WKSIDX_TRACE &&
+  if (method != HTTP_WKSIDX_TRACE && !post_buffer &&
       (t_state.hdr_info.request_content_length > 0 || t_state.client_info.transfer_encoding == HttpTransact::CHUNKED_ENCODING) &&
        do_post_transform_open()) {
     do_setup_post_tunnel(HTTP_TRANSFORM_VC);
@@ -5233,6 +5554,63 @@ HttpSM::do_drain_request_body()
 }
 #endif /* PROXY_DRAIN */
 
+// bool HttpSM::do_buffer_request_body()
+//
+//   Starts reading the request body into a post buffer, before the
+//   server connection is opened, so that the body can be sent again
+//   without the client on a retry or a redirect. Returns false if the
+//   body is not buffered and is to be tunneled as it arrives.
+//
+bool
+HttpSM::do_buffer_request_body()
+{
+  HttpConfigParams *params = t_state.http_config_param;
+  int64_t length = t_state.hdr_info.request_content_length;
+
+  if (!params->post_buffer_enabled || post_buffer || !ua_session ||
+      length <= 0 || length > params->post_buffer_max_size ||
+      t_state.client_info.transfer_encoding == HttpTransact::CHUNKED_ENCODING ||
+      t_state.hdr_info.client_request.method_get_wksidx() == HTTP_WKSIDX_TRACE ||
+      t_state.hdr_info.client_request.field_find(MIME_FIELD_EXPECT, MIME_LEN_EXPECT) ||
+      t_state.api_server_request_body_set || plugin_tunnel || api_hooks.get(TS_HTTP_REQUEST_TRANSFORM_HOOK)) {
+    return false;
+  }
+
+  post_buffer = new HttpPostBuffer(this, length, params->post_buffer_memory_size);
+  if (!post_buffer->open(params->post_buffer_spill_dir)) {
+    post_buffer->destroy();
+    post_buffer = NULL;
+    return false;
+  }
+
+  HTTP_INCREMENT_DYN_STAT(http_post_buffered_requests_stat);
+  if (length > params->post_buffer_memory_size)
+    HTTP_INCREMENT_DYN_STAT(http_post_buffer_spilled_requests_stat);
+  DebugSM("http", "[%" PRId64 "] buffering request body of %" PRId64 " bytes", sm_id, length);
+
+  // Part of the body may have come in with the header
+  int64_t avail = MIN(ua_buffer_reader->read_avail(), length);
+
+  HTTP_SM_SET_DEFAULT_HANDLER(&HttpSM::state_buffer_request_body);
+  ua_entry->vc_handler = &HttpSM::state_buffer_request_body;
+  ua_entry->read_vio = ua_entry->vc->do_io_read(this, length - avail, ua_buffer_reader->mbuf);
+  client_request_body_bytes = 0;
+  state_buffer_request_body(VC_EVENT_READ_READY, ua_entry->read_vio);
+  return true;
+}
+
+void
+HttpSM::do_send_buffered_request_body()
+{
+  IOBufferReader *reader = post_buffer->replay_open();
+
+  HTTP_INCREMENT_DYN_STAT(http_post_buffer_replays_stat);
+  DebugSM("http", "[%" PRId64 "] sending buffered request body", sm_id);
+  server_entry->vc_handler = &HttpSM::state_send_buffered_request_body;
+  server_entry->write_vio = server_entry->vc->do_io_write(this, post_buffer->get_length(), reader);
+  post_buffer->replay_start(server_entry->write_vio);
+}
+
 void
 HttpSM::do_setup_post_tunnel(HttpVC_t to_vc_type)
 {
@@ -5494,6 +5872,7 @@ HttpSM::attach_server_session(HttpServerSession * s)
   hsm_release_assert(s->state == HSS_ACTIVE);
   server_session = s;
   server_session->transact_count++;
+  server_session->pipeline_synced = false;
 
   // Set the mutex so that we have soemthing to update
   //   stats with
@@ -5527,8 +5906,10 @@ HttpSM::attach_server_session(HttpServerSession * s)
   // read holds: server_entry->read_vio == INT64_MAX
   // This block of read events gets undone in setup_server_read_response()
 
-  // Transfer control of the write side as well
-  server_session->do_io_write(this, 0, NULL);
+  // Transfer control of the write side as well, unless the session
+  //  is still writing the requests pipelined behind ours
+  if (!server_session->pipeline_writing())
+    server_session->do_io_write(this, 0, NULL);
 
   // Setup the timeouts
   // Set the inactivity timeout to the connect timeout so that we
@@ -5577,6 +5958,17 @@ HttpSM::setup_server_send_request()
   int hdr_length;
   int64_t msg_len = 0;  /* lv: just make gcc happy */
 
+  if (pipeline_session) {
+    setup_server_send_pipelined_request();
+    return;
+  } else if (server_entry == NULL) {
+    // The session our request was queued on failed while the hooks ran
+    ink_assert(pipeline_failed);
+    HTTP_INCREMENT_DYN_STAT(http_pipeline_failures_stat);
+    do_http_server_open();
+    return;
+  }
+
   hsm_release_assert(server_entry != NULL);
   hsm_release_assert(server_session != NULL);
   hsm_release_assert(server_entry->vc == server_session);
@@ -5611,6 +6003,34 @@ HttpSM::setup_server_send_request()
   server_entry->write_vio = server_entry->vc->do_io_write(this, hdr_length, buf_start);
 }
 
+// void HttpSM::setup_server_send_pipelined_request()
+//
+//   Hands the request header to the session it is queued on, which
+//    writes it after the requests ahead of it.  The response is read
+//    once the session is handed to us.
+//
+void
+HttpSM::setup_server_send_pipelined_request()
+{
+  // A plugin may have given the request a body or credentials
+  if (t_state.api_server_request_body_set ||
+      t_state.hdr_info.server_request.presence(MIME_PRESENCE_AUTHORIZATION | MIME_PRESENCE_PROXY_AUTHORIZATION)) {
+    pipeline_session->pipeline_leave(this);
+    pipeline_session = NULL;
+    pipeline_failed = true;
+    do_http_server_open();
+    return;
+  }
+
+  MIOBuffer *buf = new_MIOBuffer(buffer_size_to_index(HTTP_HEADER_BUFFER_SIZE));
+  IOBufferReader *buf_start = buf->alloc_reader();
+
+  server_request_hdr_bytes = write_header_into_buffer(&t_state.hdr_info.server_request, buf);
+  milestones.server_begin_write = ink_get_hrtime();
+  HTTP_SM_SET_DEFAULT_HANDLER(&HttpSM::state_wait_for_pipelined_response);
+  pipeline_session->pipeline_send(this, buf, buf_start);
+}
+
 void
 HttpSM::setup_server_read_response_header()
 {
@@ -5714,10 +6134,19 @@ HttpSM::setup_cache_read_transfer()
   if (doc_size != INT64_MAX)
     doc_size += hdr_size;
 
+  // The body goes untouched to the client socket, so the cache may hand us
+  // fragments which are still on the disk and get sent with sendfile().
+  if (!t_state.client_info.receive_chunked_response && ua_session->get_netvc()->sendfile_capable()) {
+    int sendfile = 1;
+    cache_sm.cache_read_vc->set_data(CACHE_DATA_SENDFILE, &sendfile);
+  }
+
   HttpTunnelProducer *p = tunnel.add_producer(cache_sm.cache_read_vc,
                                               doc_size, buf_start, &HttpSM::tunnel_handler_cache_read, HT_CACHE_READ,
                                               "cache read");
   tunnel.add_consumer(ua_entry->vc, cache_sm.cache_read_vc, &HttpSM::tunnel_handler_ua, HT_HTTP_CLIENT, "user agent");
+  if (num_body_observers > 0)
+    tunnel.set_producer_observed(p, client_response_hdr_bytes);
   // if size of a cached item is not known, we'll do chunking for keep-alive HTTP/1.1 clients
   // this only applies to read-while-write cases where origin server sends a dynamically generated chunked content
   // w/o providing a Content-Length header
@@ -5904,7 +6333,11 @@ HttpSM::setup_internal_transfer(HttpSMHandler handler_arg)
   if (is_msg_buf_present && t_state.method != HTTP_WKSIDX_HEAD) {
     nbytes += t_state.internal_msg_buffer_size;
 
-    if (t_state.internal_msg_buffer_fast_allocator_size < 0)
+    if (t_state.internal_msg_buffer_fast_allocator_size == INTERNAL_MSG_BUFFER_SHARED) {
+      // the block only takes another reference to the shared body
+      buf->append_block(new_IOBufferBlock(t_state.internal_msg_data, t_state.internal_msg_buffer_size, 0));
+      t_state.internal_msg_data = NULL;
+    } else if (t_state.internal_msg_buffer_fast_allocator_size < 0)
       buf->append_xmalloced(t_state.internal_msg_buffer, t_state.internal_msg_buffer_size);
     else
       buf->append_fast_allocated(t_state.internal_msg_buffer,
@@ -5930,6 +6363,62 @@ HttpSM::setup_internal_transfer(HttpSMHandler handler_arg)
   tunnel.tunnel_run();
 }
 
+bool
+HttpSM::is_health_check()
+{
+  HttpConfigParams *params = t_state.http_config_param;
+  HTTPHdr *req = &t_state.hdr_info.client_request;
+  int method = req->method_get_wksidx();
+  const char *path;
+  int path_len;
+
+  if (!params->health_check_path || (method != HTTP_WKSIDX_GET && method != HTTP_WKSIDX_HEAD))
+    return false;
+  path = req->url_get()->path_get(&path_len);
+  return path_len == params->health_check_path_len && !memcmp(path, params->health_check_path, path_len);
+}
+
+// Answer a health check from the response rendered at reconfigure, without
+// remap, cache, origin or any of the transaction hooks past the start, and
+// without logging it.
+void
+HttpSM::do_health_check()
+{
+  HttpConfigParams *params = t_state.http_config_param;
+  HTTPHdr *req = &t_state.hdr_info.client_request;
+  int which = HEALTH_CHECK_OK_CLOSE;
+
+  t_state.method = req->method_get_wksidx();
+  if (http_proxy_server_draining) {
+    which = HEALTH_CHECK_DRAINING;
+  } else if (t_state.txn_conf->keep_alive_enabled_in) {
+    MIMEField *c = req->field_find(MIME_FIELD_CONNECTION, MIME_LEN_CONNECTION);
+    if (is_header_keep_alive(req->version_get(), req->version_get(), c) == HTTP_KEEPALIVE)
+      which = HEALTH_CHECK_OK_KEEP_ALIVE;
+  }
+  t_state.client_info.keep_alive = which == HEALTH_CHECK_OK_KEEP_ALIVE ? HTTP_KEEPALIVE : HTTP_NO_KEEPALIVE;
+  t_state.source = HttpTransact::SOURCE_INTERNAL;
+  t_state.api_info.logging_enabled = false;
+  HTTP_INCREMENT_DYN_STAT(http_health_check_requests_stat);
+  DebugSM("http", "[%" PRId64 "] answering health check", sm_id);
+
+  int64_t nbytes = t_state.method == HTTP_WKSIDX_HEAD ?
+    params->health_check_header_len[which] : params->health_check_response_len[which];
+  MIOBuffer *buf = new_MIOBuffer(buffer_size_to_index(nbytes));
+  IOBufferReader *buf_start = buf->alloc_reader();
+  buf->write(params->health_check_response[which], nbytes);
+  client_response_hdr_bytes = params->health_check_header_len[which];
+
+  HTTP_SM_SET_DEFAULT_HANDLER(&HttpSM::tunnel_handler);
+  tunnel.add_producer(HTTP_TUNNEL_STATIC_PRODUCER,
+                      nbytes, buf_start, (HttpProducerHandler) NULL, HT_STATIC, "health check");
+  tunnel.add_consumer(ua_entry->vc,
+                      HTTP_TUNNEL_STATIC_PRODUCER, &HttpSM::tunnel_handler_ua, HT_HTTP_CLIENT, "user agent");
+
+  ua_entry->in_tunnel = true;
+  tunnel.tunnel_run();
+}
+
 // int HttpSM::find_http_resp_buffer_size(int cl)
 //
 //   Returns the allocation index for the buffer for
@@ -6005,12 +6494,18 @@ HttpSM::server_transfer_init(MIOBuffer * buf, int hdr_size)
   //   of the document out of the header buffer make
   //   sure the server isn't screwing us by having sent too
   //   much.  If it did, we want to close the server connection
-  if (server_response_pre_read_bytes == to_copy && server_buffer_reader->read_avail() > 0) {
+  //  unless it is the start of the response to a pipelined request
+  if (server_response_pre_read_bytes == to_copy && server_buffer_reader->read_avail() > 0 &&
+      !server_session->pipeline_waiting()) {
     t_state.current.server->keep_alive = HTTP_NO_KEEPALIVE;
   }
+  // The tunnel reads no further than the content length
+  if (to_copy != INT64_MAX)
+    server_session->pipeline_synced = true;
 #ifdef LAZY_BUF_ALLOC
-  // reset the server session buffer
-  server_session->reset_read_buffer();
+  // reset the server session buffer, if the next response is not in it
+  if (server_buffer_reader->read_avail() == 0)
+    server_session->reset_read_buffer();
 #endif
   return nbytes;
 }
@@ -6022,7 +6517,7 @@ HttpSM::setup_server_transfer_to_transform()
   int64_t nbytes;
 
   alloc_index = find_server_buffer_size();
-  MIOBuffer *buf = new_MIOBuffer(alloc_index);
+  MIOBuffer *buf = new_server_buffer(alloc_index);
   IOBufferReader *buf_start = buf->alloc_reader();
   nbytes = server_transfer_init(buf, 0);
 
@@ -6085,6 +6580,8 @@ HttpSM::setup_transfer_from_transform()
   tunnel.chain(c, p);
 
   tunnel.add_consumer(ua_entry->vc, transform_info.vc, &HttpSM::tunnel_handler_ua, HT_HTTP_CLIENT, "user agent");
+  if (num_body_observers > 0)
+    tunnel.set_producer_observed(p, client_response_hdr_bytes);
 
   transform_info.entry->in_tunnel = true;
   ua_entry->in_tunnel = true;
@@ -6139,7 +6636,7 @@ HttpSM::setup_server_transfer_to_cache_only()
   int64_t nbytes;
 
   alloc_index = find_server_buffer_size();
-  MIOBuffer *buf = new_MIOBuffer(alloc_index);
+  MIOBuffer *buf = new_server_buffer(alloc_index);
   IOBufferReader *buf_start = buf->alloc_reader();
 
   action = (t_state.current.server && t_state.current.server->transfer_encoding == HttpTransact::CHUNKED_ENCODING) ?
@@ -6172,7 +6669,7 @@ HttpSM::setup_server_transfer()
 
   alloc_index = find_server_buffer_size();
 #ifndef USE_NEW_EMPTY_MIOBUFFER
-  MIOBuffer *buf = new_MIOBuffer(alloc_index);
+  MIOBuffer *buf = new_server_buffer(alloc_index);
 #else
   MIOBuffer *buf = new_empty_MIOBuffer(alloc_index);
   buf->append_block(HTTP_HEADER_BUFFER_SIZE_INDEX);
@@ -6206,6 +6703,11 @@ HttpSM::setup_server_transfer()
 
   nbytes = server_transfer_init(buf, hdr_size);
 
+  if (t_state.negative_cache_store) {
+    negative_body_reader = buf_start->clone();
+    negative_body_reader->consume(hdr_size);
+  }
+
   if (t_state.negative_caching && t_state.hdr_info.server_response.status_get() == HTTP_STATUS_NO_CONTENT) {
     int s = sizeof("No Content") - 1;
     buf->write("No Content", s);
@@ -6222,6 +6724,8 @@ HttpSM::setup_server_transfer()
                                               "http server");
 
   tunnel.add_consumer(ua_entry->vc, server_entry->vc, &HttpSM::tunnel_handler_ua, HT_HTTP_CLIENT, "user agent");
+  if (num_body_observers > 0)
+    tunnel.set_producer_observed(p, client_response_hdr_bytes);
 
   ua_entry->in_tunnel = true;
   server_entry->in_tunnel = true;
@@ -6367,6 +6871,24 @@ HttpSM::setup_plugin_agents(HttpTunnelProducer* p)
   }
 }
 
+bool
+HttpSM::body_observer_add(TSHttpBodyObserverFunc func, void *data)
+{
+  if (num_body_observers >= MAX_BODY_OBSERVERS)
+    return false;
+  body_observers[num_body_observers].func = func;
+  body_observers[num_body_observers].data = data;
+  ++num_body_observers;
+  return true;
+}
+
+void
+HttpSM::body_observers_call(IOBufferReader *reader, bool done)
+{
+  for (int i = 0; i < num_body_observers; i++)
+    body_observers[i].func((TSHttpTxn) this, (TSIOBufferReader) reader, done ? 1 : 0, body_observers[i].data);
+}
+
 inline void
 HttpSM::transform_cleanup(TSHttpHookID hook, HttpTransformInfo * info)
 {
@@ -6433,6 +6955,14 @@ HttpSM::kill_this()
     transform_cache_sm.end_both();
     vc_table.cleanup_all();
     tunnel.deallocate_buffers();
+    if (post_buffer) {
+      post_buffer->destroy();
+      post_buffer = NULL;
+    }
+    if (pipeline_session) {
+      pipeline_session->pipeline_leave(this);
+      pipeline_session = NULL;
+    }
 
     // It possible that a plugin added transform hook
     //   but the hook never executed due to a client abort
@@ -6499,6 +7029,8 @@ HttpSM::kill_this()
 
     if (t_state.http_config_param->enable_http_stats)
       update_stats();
+    if (trace_on)
+      http_trace_write(sm_id);
 
     HTTP_SM_SET_DEFAULT_HANDLER(NULL);
 
@@ -6520,6 +7052,84 @@ HttpSM::kill_this()
   }
 }
 
+// Only the time the plugin holds the thread is counted. A plugin which
+//  reenables the transaction from inside the call ends the timing
+//  there, as the state machine carries on under its call.
+void
+HttpSM::plugin_hook_begin(PluginHookStats *plugin, int hook)
+{
+  plugin_hook_plugin = plugin;
+  plugin_hook_id = hook;
+  plugin_hook_start = ink_get_hrtime();
+}
+
+void
+HttpSM::plugin_hook_end()
+{
+  if (!plugin_hook_start)
+    return;
+
+  ink_hrtime elapsed = ink_get_hrtime() - plugin_hook_start;
+  plugin_hook_start = 0;
+  plugin_hook_time += elapsed;
+  if (plugin_hook_plugin) {
+    plugin_hook_stats_record(plugin_hook_plugin, plugin_hook_id, elapsed);
+    if (elapsed > plugin_slowest_time) {
+      plugin_slowest_time = elapsed;
+      plugin_slowest = plugin_hook_plugin;
+    }
+  }
+}
+
+ink_hrtime
+HttpSM::milestone_get(TSMilestonesType ms) const
+{
+  switch (ms) {
+  case TS_MILESTONE_UA_BEGIN:
+    return milestones.ua_begin;
+  case TS_MILESTONE_UA_READ_HEADER_DONE:
+    return milestones.ua_read_header_done;
+  case TS_MILESTONE_UA_BEGIN_WRITE:
+    return milestones.ua_begin_write;
+  case TS_MILESTONE_UA_CLOSE:
+    return milestones.ua_close;
+  case TS_MILESTONE_SERVER_FIRST_CONNECT:
+    return milestones.server_first_connect;
+  case TS_MILESTONE_SERVER_CONNECT:
+    return milestones.server_connect;
+  case TS_MILESTONE_SERVER_CONNECT_END:
+    return milestones.server_connect_end;
+  case TS_MILESTONE_SERVER_BEGIN_WRITE:
+    return milestones.server_begin_write;
+  case TS_MILESTONE_SERVER_FIRST_READ:
+    return milestones.server_first_read;
+  case TS_MILESTONE_SERVER_READ_HEADER_DONE:
+    return milestones.server_read_header_done;
+  case TS_MILESTONE_SERVER_CLOSE:
+    return milestones.server_close;
+  case TS_MILESTONE_CACHE_OPEN_READ_BEGIN:
+    return milestones.cache_open_read_begin;
+  case TS_MILESTONE_CACHE_OPEN_READ_END:
+    return milestones.cache_open_read_end;
+  case TS_MILESTONE_CACHE_OPEN_WRITE_BEGIN:
+    return milestones.cache_open_write_begin;
+  case TS_MILESTONE_CACHE_OPEN_WRITE_END:
+    return milestones.cache_open_write_end;
+  case TS_MILESTONE_DNS_LOOKUP_BEGIN:
+    return milestones.dns_lookup_begin;
+  case TS_MILESTONE_DNS_LOOKUP_END:
+    return milestones.dns_lookup_end;
+  case TS_MILESTONE_SM_START:
+    return milestones.sm_start;
+  case TS_MILESTONE_SM_FINISH:
+    return milestones.sm_finish;
+  case TS_MILESTONE_PLUGIN_TOTAL:
+    return milestones.plugin_total;
+  default:
+    return 0;
+  }
+}
+
 void
 HttpSM::update_stats()
 {
@@ -6590,6 +7200,34 @@ HttpSM::update_stats()
     os_read_time = -1;
   }
 
+  // Each phase the transaction went through goes into its latency histogram
+  static const struct
+  {
+    int stat;
+    TSMilestonesType begin, end;
+  } phases[] = {
+    { http_ua_read_header_latency_stat, TS_MILESTONE_UA_BEGIN, TS_MILESTONE_UA_READ_HEADER_DONE },
+    { http_dns_lookup_latency_stat, TS_MILESTONE_DNS_LOOKUP_BEGIN, TS_MILESTONE_DNS_LOOKUP_END },
+    { http_cache_open_read_latency_stat, TS_MILESTONE_CACHE_OPEN_READ_BEGIN, TS_MILESTONE_CACHE_OPEN_READ_END },
+    { http_cache_open_write_latency_stat, TS_MILESTONE_CACHE_OPEN_WRITE_BEGIN, TS_MILESTONE_CACHE_OPEN_WRITE_END },
+    { http_origin_connect_latency_stat, TS_MILESTONE_SERVER_CONNECT, TS_MILESTONE_SERVER_CONNECT_END },
+    { http_origin_ttfb_latency_stat, TS_MILESTONE_SERVER_BEGIN_WRITE, TS_MILESTONE_SERVER_FIRST_READ },
+    { http_origin_read_header_latency_stat, TS_MILESTONE_SERVER_FIRST_READ, TS_MILESTONE_SERVER_READ_HEADER_DONE },
+    { http_ttfb_latency_stat, TS_MILESTONE_UA_READ_HEADER_DONE, TS_MILESTONE_UA_BEGIN_WRITE },
+    { http_transfer_latency_stat, TS_MILESTONE_UA_BEGIN_WRITE, TS_MILESTONE_UA_CLOSE }
+  };
+
+  HTTP_HISTOGRAM_DYN_STAT(http_total_latency_stat, ink_hrtime_to_usec(total_time));
+  for (unsigned i = 0; i < sizeof(phases) / sizeof(phases[0]); i++) {
+    ink_hrtime begin = milestone_get(phases[i].begin), end = milestone_get(phases[i].end);
+    if (begin != 0 && end >= begin) {
+      HTTP_HISTOGRAM_DYN_STAT(phases[i].stat, ink_hrtime_to_usec(end - begin));
+    }
+  }
+  if (milestones.plugin_total != 0) {
+    HTTP_HISTOGRAM_DYN_STAT(http_plugin_total_latency_stat, ink_hrtime_to_usec(milestones.plugin_total));
+  }
+
   // TS-2032: This code is never used, but leaving it here in case we want to add these
   // to the metrics code.
 #if 0
@@ -6975,6 +7613,9 @@ HttpSM::set_next_state()
         }
       }
 
+      // A buffered request body is read in full before the server is contacted
+      if (do_buffer_request_body())
+        break;
       do_http_server_open();
       break;
     }
@@ -7495,3 +8136,68 @@ HttpSM::is_private()
     }
     return res;
 }
+
+bool
+HttpSM::can_pipeline_request()
+{
+  int method = t_state.hdr_info.server_request.method_get_wksidx();
+
+  return t_state.txn_conf->server_pipeline_depth > 0 && t_state.txn_conf->share_server_sessions >= 2 &&
+    !pipeline_failed && pipeline_session == NULL && !is_private() &&
+    (method == HTTP_WKSIDX_GET || method == HTTP_WKSIDX_HEAD) &&
+    t_state.hdr_info.request_content_length <= 0 &&
+    t_state.client_info.transfer_encoding != HttpTransact::CHUNKED_ENCODING &&
+    !t_state.api_server_request_body_set && plugin_tunnel_type == HTTP_NO_PLUGIN_TUNNEL &&
+    !t_state.hdr_info.server_request.presence(MIME_PRESENCE_AUTHORIZATION | MIME_PRESENCE_PROXY_AUTHORIZATION |
+                                              MIME_PRESENCE_WWW_AUTHENTICATE);
+}
+
+// The session we are queued on schedules us, so that the event is
+//  delivered under our own mutex.
+void
+HttpSM::pipeline_signal(int event)
+{
+  pending_action = this_ethread()->schedule_imm(this, event);
+}
+
+// The session we are queued on failed, the request goes elsewhere.
+void
+HttpSM::pipeline_dropped()
+{
+  pipeline_session = NULL;
+  pipeline_failed = true;
+}
+
+// The body has to have a known length, the stream is told where it
+//  ends.  Transparent and private connections stay on HTTP/1.1, the
+//  stream would share a connection with other clients' requests.
+bool
+HttpSM::can_use_http2(bool raw)
+{
+  return t_state.txn_conf->server_http2 && Http2::max_concurrent_streams_out > 0 && !raw && !http2_attempted &&
+    t_state.current.request_to == HttpTransact::ORIGIN_SERVER && t_state.scheme == URL_WKSIDX_HTTP &&
+    t_state.method != HTTP_WKSIDX_CONNECT && plugin_tunnel_type == HTTP_NO_PLUGIN_TUNNEL &&
+    t_state.client_info.transfer_encoding != HttpTransact::CHUNKED_ENCODING &&
+    !t_state.api_server_request_body_set && ua_session != NULL && !ua_session->f_outbound_transparent &&
+    !is_private();
+}
+
+// The stream looks like a connection of its own that the origin
+//  closes after the response, so it is never pooled.
+void
+HttpSM::attach_http2_stream(NetVConnection *vc)
+{
+  HttpServerSession *session = httpServerSessionAllocator.alloc();
+
+  session->share_session = 0;
+  session->http2_stream = true;
+  ats_ip_copy(&session->server_ip, &t_state.current.server->addr);
+  session->new_connection(vc);
+  session->state = HSS_ACTIVE;
+  session->to_parent_proxy = false;
+
+  DebugSM("http_ss", "[%" PRId64 "] request goes out on HTTP/2 stream [%" PRId64 "]", sm_id, session->con_id);
+  http2_attempted = true;
+  HTTP_INCREMENT_DYN_STAT(http_http2_origin_streams_stat);
+  attach_server_session(session);
+}
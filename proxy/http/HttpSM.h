@@ -38,6 +38,7 @@
 #include "HttpCacheSM.h"
 #include "HttpTransact.h"
 #include "HttpTunnel.h"
+#include "HttpPostBuffer.h"
 #include "InkAPIInternal.h"
 #include "StatSystem.h"
 #include "HttpClientSession.h"
@@ -245,6 +246,13 @@ public:
   int state_api_callback(int event, void *data);
   int state_api_callout(int event, void *data);
 
+  // The time of a milestone, 0 if the transaction has not reached it
+  ink_hrtime milestone_get(TSMilestonesType ms) const;
+
+  // Time spent inside the calls to a plugin, see state_api_callout()
+  void plugin_hook_begin(PluginHookStats *plugin, int hook);
+  void plugin_hook_end();
+
   // Used for Http Stat Pages
   HttpTunnel *get_tunnel()
   {
@@ -258,6 +266,7 @@ public:
   // Functions for manipulating api hooks
   void txn_hook_append(TSHttpHookID id, INKContInternal * cont);
   void txn_hook_prepend(TSHttpHookID id, INKContInternal * cont);
+  void txn_hook_append_fast(TSHttpHookID id, TSHttpFastHookFunc func, void *data);
   APIHook *txn_hook_get(TSHttpHookID id);
 
   void add_history_entry(const char *fileline, int event, int reentrant);
@@ -277,6 +286,7 @@ public:
   int64_t transfered_bytes;         //Added to calculate POST data
   bool post_failed;             //Added to identify post failure
   bool debug_on;              //Transaction specific debug flag
+  bool trace_on;              //Transaction is sampled for HttpTrace
 
   // Tunneling request to plugin
   HttpPluginTunnel_t plugin_tunnel_type;
@@ -298,6 +308,9 @@ protected:
 
   HttpTunnel tunnel;
 
+  // The request body, when buffered before contacting the server
+  HttpPostBuffer *post_buffer;
+
   HttpVCTable vc_table;
 
   HttpVCTableEntry *ua_entry;
@@ -317,6 +330,8 @@ protected:
   HttpVCTableEntry *server_entry;
   HttpServerSession *server_session;
   int shared_session_retries;
+  ink_hrtime origin_wait_start; // when the connect started waiting for origin_max_connections
+  ink_hrtime server_open_time; // when the current server connection was opened, 0 for a shared one
   IOBufferReader *server_buffer_reader;
   void remove_server_entry();
 
@@ -355,6 +370,7 @@ protected:
 #endif /* PROXY_DRAIN */
   int state_read_client_request_header(int event, void *data);
   int state_watch_for_client_abort(int event, void *data);
+  int state_buffer_request_body(int event, void *data);
   int state_read_push_response_header(int event, void *data);
   int state_srv_lookup(int event, void *data);
   int state_hostdb_lookup(int event, void *data);
@@ -379,6 +395,8 @@ protected:
   int state_http_server_open(int event, void *data);
   int state_raw_http_server_open(int event, void *data);
   int state_send_server_request_header(int event, void *data);
+  int state_send_buffered_request_body(int event, void *data);
+  int state_wait_for_pipelined_response(int event, void *data);
   int state_acquire_server_read(int event, void *data);
   int state_read_server_response_header(int event, void *data);
 
@@ -407,6 +425,8 @@ protected:
   void do_cache_lookup_and_read();
   void do_http_server_open(bool raw = false);
   void do_setup_post_tunnel(HttpVC_t to_vc_type);
+  bool do_buffer_request_body();
+  void do_send_buffered_request_body();
   void do_cache_prepare_write();
   void do_cache_prepare_write_transform();
   void do_cache_prepare_update();
@@ -442,11 +462,14 @@ protected:
   void setup_server_read_response_header();
   void setup_cache_lookup_complete_api();
   void setup_server_send_request();
+  void setup_server_send_pipelined_request();
   void setup_server_send_request_api();
   void setup_server_transfer();
   void setup_server_transfer_to_cache_only();
   void setup_cache_read_transfer();
   void setup_internal_transfer(HttpSMHandler handler);
+  bool is_health_check();
+  void do_health_check();
   void setup_error_transfer();
   void setup_100_continue_transfer();
   void setup_push_transfer_to_cache();
@@ -472,6 +495,7 @@ protected:
   bool is_http_server_eos_truncation(HttpTunnelProducer *);
   bool is_bg_fill_necessary(HttpTunnelConsumer * c);
   int find_server_buffer_size();
+  MIOBuffer *new_server_buffer(int64_t alloc_index);
   int find_http_resp_buffer_size(int64_t cl);
   int64_t server_transfer_init(MIOBuffer * buf, int hdr_size);
 
@@ -490,6 +514,9 @@ public:
   int pushed_response_hdr_bytes;
   int64_t pushed_response_body_bytes;
   TransactionMilestones milestones;
+  ink_hrtime plugin_hook_time;          // inside plugin calls
+  PluginHookStats *plugin_slowest;      // the plugin with the slowest single call
+  ink_hrtime plugin_slowest_time;
 
   // hooks_set records whether there are any hooks relevant
   //  to this transaction.  Used to avoid costly calls
@@ -501,8 +528,13 @@ protected:
   APIHook *cur_hook;
 
   //
-  // Continuation time keeper
-  int64_t prev_hook_start_time;
+  // Start of the current hook's plugin callouts, 0 outside of them
+  ink_hrtime prev_hook_start_time;
+
+  // The plugin call being timed, 0 start when there is none
+  PluginHookStats *plugin_hook_plugin;
+  int plugin_hook_id;
+  ink_hrtime plugin_hook_start;
 
   int cur_hooks;
   HttpApiState_t callout_state;
@@ -529,6 +561,39 @@ public:
 
 public:
   bool set_server_session_private(bool private_session);
+
+  // Request pipelining on origin sessions. The session our request
+  //  is queued on calls us back with HTTP_PIPELINE_EVENT_READY when
+  //  the response is next, or drops us when it can not be answered.
+  bool can_pipeline_request();
+  void pipeline_signal(int event);
+  void pipeline_dropped();
+  HttpServerSession *pipeline_session;
+
+  // HTTP/2 to the origin. The first attempt of a request may go as a
+  //  stream on a shared connection, retries are sent over HTTP/1.1.
+  bool can_use_http2(bool raw);
+  void attach_http2_stream(NetVConnection *vc);
+
+  // Plugins watching the response body, see TSHttpTxnResponseBodyObserve().
+  //  The tunnel calls them inline with the bytes of each read.
+  bool body_observer_add(TSHttpBodyObserverFunc func, void *data);
+  void body_observers_call(IOBufferReader *reader, bool done);
+
+protected:
+  bool pipeline_failed;         // do not pipeline this transaction again
+  bool http2_attempted;         // the request went out as an HTTP/2 stream once
+  bool http2_connecting;        // the connection being opened is for HTTP/2
+  IOBufferReader *negative_body_reader; // the response body, for the negative cache
+
+  struct BodyObserver
+  {
+    TSHttpBodyObserverFunc func;
+    void *data;
+  };
+  static const int MAX_BODY_OBSERVERS = 4;
+  BodyObserver body_observers[MAX_BODY_OBSERVERS];
+  int num_body_observers;
 };
 
 //Function to get the cache_sm object - YTS Team, yamsat
@@ -593,6 +658,21 @@ HttpSM::find_server_buffer_size()
   return find_http_resp_buffer_size(t_state.hdr_info.response_content_length);
 }
 
+// A response of unknown length starts on 4 KB blocks, which grow to the
+// configured size while the response keeps filling them.
+inline MIOBuffer *
+HttpSM::new_server_buffer(int64_t alloc_index)
+{
+  MIOBuffer *buf;
+
+  if (t_state.hdr_info.response_content_length == HTTP_UNDEFINED_CL && alloc_index > BUFFER_SIZE_INDEX_4K) {
+    buf = new_MIOBuffer(BUFFER_SIZE_INDEX_4K);
+    buf->set_grow_size_index(alloc_index);
+  } else
+    buf = new_MIOBuffer(alloc_index);
+  return buf;
+}
+
 inline void
 HttpSM::txn_hook_append(TSHttpHookID id, INKContInternal * cont)
 {
@@ -607,6 +687,13 @@ HttpSM::txn_hook_prepend(TSHttpHookID id, INKContInternal * cont)
   hooks_set = 1;
 }
 
+inline void
+HttpSM::txn_hook_append_fast(TSHttpHookID id, TSHttpFastHookFunc func, void *data)
+{
+  api_hooks.append_fast(id, func, data);
+  hooks_set = 1;
+}
+
 inline APIHook *
 HttpSM::txn_hook_get(TSHttpHookID id)
 {
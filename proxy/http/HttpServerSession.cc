@@ -33,6 +33,7 @@
 #include "HttpServerSession.h"
 #include "HttpSessionManager.h"
 #include "HttpSM.h"
+#include "HttpDebugNames.h"
 
 static int64_t next_ss_id = (int64_t) 0;
 ClassAllocator<HttpServerSession> httpServerSessionAllocator("httpServerSessionAllocator");
@@ -44,14 +45,19 @@ HttpServerSession::destroy()
   ink_release_assert(server_vc == NULL);
   ink_assert(read_buffer);
   ink_assert(server_trans_stat == 0);
+  ink_assert(!pipeline_waiting() && !pipeline_listed);
   magic = HTTP_SS_MAGIC_DEAD;
   if (read_buffer) {
     free_MIOBuffer(read_buffer);
     read_buffer = NULL;
   }
+  if (pipeline_buffer) {
+    free_MIOBuffer(pipeline_buffer);
+    pipeline_buffer = NULL;
+  }
 
   mutex.clear();
-  if (2 == share_session)
+  if (2 <= share_session)
     THREAD_FREE(this, httpServerSessionAllocator, this_ethread());
   else
     httpServerSessionAllocator.free(this);
@@ -70,8 +76,10 @@ HttpServerSession::new_connection(NetVConnection *new_vc)
   con_id = ink_atomic_increment((int64_t *) (&next_ss_id), 1);
 
   magic = HTTP_SS_MAGIC_ALIVE;
-  HTTP_SUM_GLOBAL_DYN_STAT(http_current_server_connections_stat, 1); // Update the true global stat
-  HTTP_INCREMENT_DYN_STAT(http_total_server_connections_stat);
+  if (!http2_stream) {
+    HTTP_SUM_GLOBAL_DYN_STAT(http_current_server_connections_stat, 1); // Update the true global stat
+    HTTP_INCREMENT_DYN_STAT(http_total_server_connections_stat);
+  }
   // Check to see if we are limiting the number of connections
   // per host
   if (enable_origin_connection_limiting == true) {
@@ -114,6 +122,10 @@ HttpServerSession::do_io_shutdown(ShutdownHowTo_t howto)
 void
 HttpServerSession::do_io_close(int alerrno)
 {
+  // The requests queued behind go elsewhere
+  if (pipeline_waiting() || pipeline_listed)
+    pipeline_fail();
+
   if (state == HSS_ACTIVE) {
     HTTP_DECREMENT_DYN_STAT(http_current_server_transactions_stat);
     this->server_trans_stat--;
@@ -123,7 +135,8 @@ HttpServerSession::do_io_close(int alerrno)
   Debug("http_ss", "[%" PRId64 "] session closed", con_id);
   server_vc = NULL;
 
-  HTTP_SUM_GLOBAL_DYN_STAT(http_current_server_connections_stat, -1); // Make sure to work on the global stat
+  if (!http2_stream)
+    HTTP_SUM_GLOBAL_DYN_STAT(http_current_server_connections_stat, -1); // Make sure to work on the global stat
   HTTP_SUM_DYN_STAT(http_transactions_per_server_con, transact_count);
 
   // Check to see if we are limiting the number of connections
@@ -161,6 +174,14 @@ HttpServerSession::reenable(VIO *vio)
 void
 HttpServerSession::release()
 {
+  // The next pipelined request gets the session, not the pool
+  if (pipeline_count > 0) {
+    pipeline_next();
+    return;
+  }
+  if (pipeline_listed)
+    httpSessionManager.pipeline_unlist(this);
+
   // Set our state to KA for stat issues
   state = HSS_KA_SHARED;
 
@@ -185,3 +206,218 @@ HttpServerSession::release()
     ink_assert(r == HSM_DONE);
   }
 }
+
+void
+HttpServerSession::pipeline_join(HttpSM *sm)
+{
+  ink_assert(pipeline_count < pipeline_max);
+  pipeline[pipeline_count].sm = sm;
+  pipeline[pipeline_count].request = NULL;
+  pipeline[pipeline_count].request_reader = NULL;
+  pipeline_count++;
+  sm->pipeline_session = this;
+  Debug("http_ss", "[%" PRId64 "] [pipeline] request queued, %d waiting", con_id, pipeline_count);
+}
+
+void
+HttpServerSession::pipeline_send(HttpSM *sm, MIOBuffer *request, IOBufferReader *request_reader)
+{
+  for (int i = 0; i < pipeline_count; i++) {
+    if (pipeline[i].sm == sm) {
+      pipeline[i].request = request;
+      pipeline[i].request_reader = request_reader;
+      break;
+    }
+  }
+
+  pipeline_write();
+  if (pipeline_reading && pipeline_next_sm == NULL)
+    pipeline_next();
+}
+
+void
+HttpServerSession::pipeline_leave(HttpSM *sm)
+{
+  if (pipeline_next_sm == sm) {
+    // Nobody will read the response it was handed the session for
+    pipeline_next_sm = NULL;
+    pipeline_fail();
+    do_io_close();
+    return;
+  }
+
+  for (int i = 0; i < pipeline_count; i++) {
+    if (pipeline[i].sm != sm)
+      continue;
+
+    if (i < pipeline_written) {
+      // Its request is on the wire, its response will have to be
+      //  read when it comes up
+      pipeline[i].sm = NULL;
+      return;
+    }
+    if (pipeline[i].request)
+      free_MIOBuffer(pipeline[i].request);
+    memmove(pipeline + i, pipeline + i + 1, (pipeline_count - i - 1) * sizeof(HttpPipelineSlot));
+    pipeline_count--;
+    break;
+  }
+
+  // The ones behind it may be ready to go now
+  pipeline_write();
+  if (pipeline_reading && pipeline_next_sm == NULL) {
+    if (pipeline_count > 0)
+      pipeline_next();
+    else
+      release();
+  }
+}
+
+void
+HttpServerSession::pipeline_attach(HttpSM *sm)
+{
+  ink_assert(pipeline_next_sm == sm);
+  pipeline_next_sm = NULL;
+  pipeline_reading = false;
+  state = HSS_ACTIVE;
+}
+
+// Append the requests that are ready, in order, to what we are writing.
+void
+HttpServerSession::pipeline_write()
+{
+  int64_t added = 0;
+
+  while (pipeline_written < pipeline_count && pipeline[pipeline_written].request) {
+    HttpPipelineSlot *slot = pipeline + pipeline_written++;
+
+    if (pipeline_buffer == NULL) {
+      pipeline_buffer = new_empty_MIOBuffer(HTTP_HEADER_BUFFER_SIZE_INDEX);
+      pipeline_reader = pipeline_buffer->alloc_reader();
+    }
+    added += pipeline_buffer->write(slot->request_reader, slot->request_reader->read_avail());
+    free_MIOBuffer(slot->request);
+    slot->request = NULL;
+    slot->request_reader = NULL;
+  }
+
+  if (added == 0 || pipeline_broken)
+    return;
+
+  if (pipeline_writing()) {
+    pipeline_vio->nbytes = pipeline_vio->ndone + pipeline_reader->read_avail();
+    pipeline_vio->reenable();
+  } else {
+    SET_HANDLER(&HttpServerSession::pipeline_event);
+    pipeline_vio = server_vc->do_io_write(this, pipeline_reader->read_avail(), pipeline_reader);
+  }
+}
+
+// The owner is done with its response, hand the session to the
+//  state machine whose response comes next.
+void
+HttpServerSession::pipeline_next()
+{
+  if (!pipeline_reading) {
+    // Take the connection from the owner, it may be gone before
+    //  the next state machine is called back
+    pipeline_reading = true;
+    state = HSS_KA_SHARED;
+    SET_HANDLER(&HttpServerSession::pipeline_event);
+    server_vc->do_io_read(this, INT64_MAX, read_buffer);
+    if (!pipeline_writing()) {
+      server_vc->do_io_write(this, 0, NULL);
+      pipeline_vio = NULL;
+    }
+  }
+
+  // A response we can not find the end of, or one nobody will read,
+  //  leaves the connection out of step with the requests
+  if (pipeline_broken || !pipeline_synced || (pipeline_written > 0 && pipeline[0].sm == NULL)) {
+    Debug("http_ss", "[%" PRId64 "] [pipeline] lost track of the responses", con_id);
+    pipeline_fail();
+    do_io_close();
+    return;
+  }
+
+  // Wait for its request to be written first
+  if (pipeline_written == 0)
+    return;
+
+  pipeline_next_sm = pipeline[0].sm;
+  memmove(pipeline, pipeline + 1, (pipeline_count - 1) * sizeof(HttpPipelineSlot));
+  pipeline_count--;
+  pipeline_written--;
+  Debug("http_ss", "[%" PRId64 "] [pipeline] handing the session on, %d waiting", con_id, pipeline_count);
+  pipeline_next_sm->pipeline_signal(HTTP_PIPELINE_EVENT_READY);
+}
+
+// Send everything queued elsewhere, and stop taking requests.
+void
+HttpServerSession::pipeline_fail()
+{
+  if (pipeline_listed)
+    httpSessionManager.pipeline_unlist(this);
+  pipeline_max = 0;
+
+  // The event it was sent finds it dropped
+  if (pipeline_next_sm) {
+    pipeline_next_sm->pipeline_dropped();
+    pipeline_next_sm = NULL;
+  }
+
+  for (int i = 0; i < pipeline_count; i++) {
+    HttpPipelineSlot *slot = pipeline + i;
+    bool sent = (i < pipeline_written || slot->request != NULL);
+
+    if (slot->request)
+      free_MIOBuffer(slot->request);
+    if (slot->sm) {
+      // Those still running their hooks find out when they send
+      slot->sm->pipeline_dropped();
+      if (sent)
+        slot->sm->pipeline_signal(HTTP_PIPELINE_EVENT_FAILED);
+    }
+  }
+  memset(pipeline, 0, sizeof(pipeline));
+  pipeline_count = 0;
+  pipeline_written = 0;
+}
+
+int
+HttpServerSession::pipeline_event(int event, void *data)
+{
+  VIO *vio = (VIO *) data;
+
+  switch (event) {
+  case VC_EVENT_WRITE_READY:
+    vio->reenable();
+    return 0;
+
+  case VC_EVENT_WRITE_COMPLETE:
+  case VC_EVENT_READ_READY:
+    // The next response is left in the buffer for its state machine
+    return 0;
+
+  case VC_EVENT_EOS:
+  case VC_EVENT_ERROR:
+  case VC_EVENT_INACTIVITY_TIMEOUT:
+  case VC_EVENT_ACTIVE_TIMEOUT:
+    break;
+
+  default:
+    ink_release_assert(0);
+    return 0;
+  }
+
+  Debug("http_ss", "[%" PRId64 "] [pipeline] session received io notice [%s]", con_id, HttpDebugNames::get_event_name(event));
+  if (vio->op == VIO::WRITE && !pipeline_reading) {
+    // The owner reading its response hears of it too
+    pipeline_broken = true;
+    return 0;
+  }
+
+  pipeline_fail();
+  do_io_close();
+  return 0;
+}
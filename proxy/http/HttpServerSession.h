@@ -64,6 +64,21 @@ enum {
   HTTP_SS_MAGIC_DEAD = 0xDEADFEED
 };
 
+// The most requests queued behind the one in progress on a session
+#define HTTP_SS_PIPELINE_MAX           8
+
+/// Sent to a state machine when the response to its pipelined request is next.
+#define HTTP_PIPELINE_EVENT_READY      (HTTP_TUNNEL_EVENTS_START + 11)
+/// Sent to a state machine when its pipelined request will not be answered.
+#define HTTP_PIPELINE_EVENT_FAILED     (HTTP_TUNNEL_EVENTS_START + 12)
+
+struct HttpPipelineSlot
+{
+  HttpSM *sm;                   // NULL once the state machine has gone
+  MIOBuffer *request;           // the request header, until it is written
+  IOBufferReader *request_reader;
+};
+
 class HttpServerSession : public VConnection
 {
 public:
@@ -72,12 +87,17 @@ public:
       hostname_hash(),
       host_hash_computed(false), con_id(0), transact_count(0),
       state(HSS_INIT), to_parent_proxy(false), server_trans_stat(0),
-      private_session(false), share_session(0),
+      private_session(false), share_session(0), http2_stream(false),
       enable_origin_connection_limiting(false),
       connection_count(NULL), read_buffer(NULL),
+      pipeline_count(0), pipeline_written(0), pipeline_max(0),
+      pipeline_capable(false), pipeline_synced(false), pipeline_listed(false),
+      pipeline_broken(false), pipeline_reading(false), pipeline_next_sm(NULL),
+      pipeline_buffer(NULL), pipeline_reader(NULL), pipeline_vio(NULL),
       server_vc(NULL), magic(HTTP_SS_MAGIC_DEAD), buf_reader(NULL)
     { 
       ink_zero(server_ip);
+      memset(pipeline, 0, sizeof(pipeline));
     }
 
   void destroy();
@@ -108,6 +128,22 @@ public:
 
   void release();
   void attach_hostname(const char *hostname);
+
+  /// Queue a request behind the ones already on the session.
+  void pipeline_join(HttpSM *sm);
+  /// The request header of a queued state machine, the session takes the buffer.
+  void pipeline_send(HttpSM *sm, MIOBuffer *request, IOBufferReader *request_reader);
+  /// A queued state machine is going away, or was handed the session and will not use it.
+  void pipeline_leave(HttpSM *sm);
+  /// The state machine handed the session takes the read side.
+  void pipeline_attach(HttpSM *sm);
+  /// Requests are queued on the session, or waiting to be handed it.
+  bool pipeline_waiting() const { return pipeline_count > 0 || pipeline_next_sm != NULL; }
+  /// The session's own request writes are in progress.
+  bool pipeline_writing() const
+  {
+    return pipeline_vio != NULL && pipeline_vio->get_continuation() == this && pipeline_vio->ntodo() > 0;
+  }
   NetVConnection *get_netvc()
   {
     return server_vc;
@@ -140,8 +176,12 @@ public:
   // Copy of the owning SM's share_server_session setting
   int share_session;
 
+  // A stream on an HTTP/2 connection, not a connection of its own
+  bool http2_stream;
+
   LINK(HttpServerSession, lru_link);
   LINK(HttpServerSession, hash_link);
+  LINK(HttpServerSession, pipeline_link);
 
   // Keep track of connection limiting and a pointer to the
   // singleton that keeps track of the connection counts.
@@ -157,9 +197,34 @@ public:
   //   an asyncronous cancel on NT
   MIOBuffer *read_buffer;
 
+  // Pipelining. The session writes the queued requests itself, in
+  //  the order they joined, and hands the read side to each state
+  //  machine in turn as the one before it releases the session.
+  //  Everything here is only touched on the thread the connection
+  //  lives on, which is why pipelining needs the per-thread pools.
+  HttpPipelineSlot pipeline[HTTP_SS_PIPELINE_MAX];
+  int pipeline_count;           // queued requests
+  int pipeline_written;         // leading queued requests already in pipeline_buffer
+  int pipeline_max;             // most requests queued, 0 when not taking any
+  bool pipeline_capable;        // has kept an HTTP/1.1 response alive
+  bool pipeline_synced;         // the owner's reads stopped at the end of its response
+  bool pipeline_listed;         // in the session manager's list of sessions taking requests
+  bool pipeline_broken;         // our write failed, nothing more is handed on
+
 private:
   HttpServerSession(HttpServerSession &);
 
+  int pipeline_event(int event, void *data);
+  void pipeline_write();
+  void pipeline_next();
+  void pipeline_fail();
+
+  bool pipeline_reading;        // we hold the read side between two owners
+  HttpSM *pipeline_next_sm;     // handed the session, its event is pending
+  MIOBuffer *pipeline_buffer;
+  IOBufferReader *pipeline_reader;
+  VIO *pipeline_vio;
+
   NetVConnection *server_vc;
   int magic;
 
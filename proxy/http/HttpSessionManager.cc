@@ -143,6 +143,290 @@ SessionBucket::session_handler(int event, void *data)
 }
 
 
+//////////////////////////////////////////////////////////////////////////
+//
+//  Connection pre-warming
+//
+//  The origins sessions are acquired for are counted in a small table.
+//  Once a second the request rate of each is updated, and for those at
+//  proxy.config.http.prewarm.hot_rate or more, connections are opened
+//  and released to the shared pool until it holds
+//  proxy.config.http.prewarm.min_connections idle ones. A pooled
+//  connection the origin closes is replaced on the next pass, so the
+//  first request after a keep-alive timeout does not wait for a connect.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#define HSM_PREWARM_ORIGINS    1024
+#define HSM_PREWARM_PER_PASS   16       // connects started per origin each pass
+
+struct PrewarmOrigin
+{
+  IpEndpoint addr;
+  INK_MD5 hostname_hash;
+  bool ssl;
+  int share;
+  volatile int requests;        // since the last pass
+  int rate;                     // requests per second, smoothed
+  int connecting;
+  int gen;
+};
+
+static PrewarmOrigin prewarm_origins[HSM_PREWARM_ORIGINS];
+static ink_mutex prewarm_mutex;
+
+static inline int
+prewarm_slot(sockaddr const* ip, INK_MD5 &hostname_hash)
+{
+  return (ats_ip_hash(ip) ^ (uint32_t) hostname_hash.fold()) % HSM_PREWARM_ORIGINS;
+}
+
+static inline bool
+prewarm_match(PrewarmOrigin *o, sockaddr const* ip, INK_MD5 &hostname_hash)
+{
+  return ats_ip_addr_eq(&o->addr.sa, ip) && ats_ip_port_cast(&o->addr.sa) == ats_ip_port_cast(ip) &&
+    o->hostname_hash == hostname_hash;
+}
+
+// One connection opened ahead of a request and released to the pool.
+struct HttpPrewarmConnect: public Continuation
+{
+  IpEndpoint addr;
+  INK_MD5 hostname_hash;
+  bool ssl;
+  int share;
+  int slot;
+  int gen;
+
+  HttpPrewarmConnect(PrewarmOrigin *o, int slot_arg)
+    : Continuation(new_ProxyMutex()), hostname_hash(o->hostname_hash), ssl(o->ssl), share(o->share),
+      slot(slot_arg), gen(o->gen)
+  {
+    ats_ip_copy(&addr, &o->addr);
+    SET_HANDLER(&HttpPrewarmConnect::connect_event);
+  }
+
+  void done()
+  {
+    ink_mutex_acquire(&prewarm_mutex);
+    if (prewarm_origins[slot].gen == gen && prewarm_origins[slot].connecting > 0)
+      prewarm_origins[slot].connecting--;
+    ink_mutex_release(&prewarm_mutex);
+    mutex.clear();
+    delete this;
+  }
+
+  int connect_event(int event, void *data);
+};
+
+int
+HttpPrewarmConnect::connect_event(int event, void *data)
+{
+  HttpConfigParams *params;
+
+  switch (event) {
+  case EVENT_IMMEDIATE:
+    {
+      NetVCOptions opt;
+
+      params = HttpConfig::acquire();
+      opt.f_blocking_connect = false;
+      opt.set_sock_param(params->oride.sock_recv_buffer_size_out,
+                         params->oride.sock_send_buffer_size_out,
+                         params->oride.sock_option_flag_out,
+                         params->oride.sock_packet_mark_out,
+                         params->oride.sock_packet_tos_out);
+      opt.ip_family = addr.sa.sa_family;
+      HttpConfig::release(params);
+
+      // We may be called back, and gone, before connect_re() returns
+      if (ssl)
+        sslNetProcessor.connect_re(this, &addr.sa, &opt);
+      else
+        netProcessor.connect_re(this, &addr.sa, &opt);
+      return EVENT_DONE;
+    }
+
+  case NET_EVENT_OPEN:
+    {
+      NetVConnection *vc = (NetVConnection *) data;
+      HttpServerSession *session = (2 <= share) ?
+        THREAD_ALLOC_INIT(httpServerSessionAllocator, this_ethread()) :
+        httpServerSessionAllocator.alloc();
+
+      params = HttpConfig::acquire();
+      session->share_session = share;
+      if (params->oride.origin_max_connections > 0 || params->origin_min_keep_alive_connections > 0)
+        session->enable_origin_connection_limiting = true;
+      ats_ip_copy(&session->server_ip, &addr);
+      session->new_connection(vc);
+      session->hostname_hash = hostname_hash;
+      session->host_hash_computed = true;
+      vc->set_inactivity_timeout(HRTIME_SECONDS(params->oride.keep_alive_no_activity_timeout_out));
+      HttpConfig::release(params);
+
+      HTTP_INCREMENT_DYN_STAT(http_prewarm_connections_stat);
+      Debug("http_ss", "[%" PRId64 "] [prewarm] session opened", session->con_id);
+      session->release();
+      break;
+    }
+
+  case NET_EVENT_OPEN_FAILED:
+    Debug("http_ss", "[prewarm] connect failed");
+    break;
+
+  default:
+    ink_release_assert(0);
+    break;
+  }
+
+  done();
+  return EVENT_DONE;
+}
+
+// The pass, once a second on a net thread.
+struct HttpPrewarm: public Continuation
+{
+  HttpPrewarm()
+    : Continuation(new_ProxyMutex())
+  {
+    SET_HANDLER(&HttpPrewarm::pass_event);
+  }
+
+  int pass_event(int event, void *data);
+};
+
+int
+HttpPrewarm::pass_event(int /* event ATS_UNUSED */, void * /* data ATS_UNUSED */)
+{
+  HttpConfigParams *params = HttpConfig::acquire();
+  int64_t server_connections;
+
+  if (!params->prewarm_enabled) {
+    HttpConfig::release(params);
+    return EVENT_CONT;
+  }
+
+  HTTP_READ_GLOBAL_DYN_SUM(http_current_server_connections_stat, server_connections);
+
+  for (int i = 0; i < HSM_PREWARM_ORIGINS; i++) {
+    PrewarmOrigin *o = &prewarm_origins[i];
+    PrewarmOrigin hot;
+
+    if (!o->requests && !o->rate)
+      continue;
+
+    ink_mutex_acquire(&prewarm_mutex);
+    o->rate = (o->rate * 3 + o->requests) / 4;
+    o->requests = 0;
+    hot = *o;
+    ink_mutex_release(&prewarm_mutex);
+
+    if (hot.rate < params->prewarm_hot_rate)
+      continue;
+
+    int idle = httpSessionManager.count_idle_sessions(&hot.addr.sa, hot.hostname_hash, hot.share);
+    if (idle < 0)
+      continue;
+
+    int wanted = params->prewarm_min_connections - idle - hot.connecting;
+    wanted = MIN(wanted, HSM_PREWARM_PER_PASS);
+    if (params->server_max_connections > 0)
+      wanted = MIN(wanted, params->server_max_connections - server_connections);
+    if (params->oride.origin_max_connections > 0)
+      wanted = MIN(wanted, params->oride.origin_max_connections -
+                   (int64_t) ConnectionCount::getInstance()->getCount(hot.addr));
+    if (wanted <= 0)
+      continue;
+
+    Debug("http_ss", "[prewarm] origin rate %d/s, %d idle, opening %d", hot.rate, idle, wanted);
+    ink_mutex_acquire(&prewarm_mutex);
+    if (o->gen == hot.gen)
+      o->connecting += wanted;
+    ink_mutex_release(&prewarm_mutex);
+
+    // Spread the connections over the net threads, and their pools
+    for (int j = 0; j < wanted; j++)
+      eventProcessor.schedule_imm(NEW(new HttpPrewarmConnect(&hot, i)), ET_NET);
+    server_connections += wanted;
+  }
+
+  HttpConfig::release(params);
+  return EVENT_CONT;
+}
+
+void
+HttpSessionManager::note_origin(sockaddr const* ip, INK_MD5 &hostname_hash, HttpClientSession *ua_session, HttpSM *sm)
+{
+  // Connections bound to the client, or to an outbound address, are
+  //  not the ones a pass would open
+  if (ua_session->f_outbound_transparent || ua_session->outbound_ip4.isValid() || ua_session->outbound_ip6.isValid())
+    return;
+
+  int slot = prewarm_slot(ip, hostname_hash);
+  PrewarmOrigin *o = &prewarm_origins[slot];
+
+  // The unlocked match may race with a replacement, which only miscounts
+  //  a request
+  if (prewarm_match(o, ip, hostname_hash)) {
+    ink_atomic_increment(&o->requests, 1);
+    return;
+  }
+
+  // A colder origin gives its slot up to this one
+  ink_mutex_acquire(&prewarm_mutex);
+  if (o->rate < sm->t_state.http_config_param->prewarm_hot_rate && !o->connecting) {
+    ats_ip_copy(&o->addr, ip);
+    o->hostname_hash = hostname_hash;
+    o->ssl = (sm->t_state.scheme == URL_WKSIDX_HTTPS);
+    o->share = sm->t_state.txn_conf->share_server_sessions;
+    o->requests = 1;
+    o->rate = 0;
+    o->gen++;
+  }
+  ink_mutex_release(&prewarm_mutex);
+}
+
+static int
+_count_idle_sessions(SessionBucket *bucket, sockaddr const* ip, INK_MD5 &hostname_hash)
+{
+  int n = 0;
+
+  for (HttpServerSession *b = bucket->l2_hash[SECOND_LEVEL_HASH(ip)].head; b != NULL; b = b->hash_link.next) {
+    if (ats_ip_addr_eq(&b->server_ip.sa, ip) && ats_ip_port_cast(ip) == ats_ip_port_cast(&b->server_ip) &&
+        hostname_hash == b->hostname_hash)
+      n++;
+  }
+  return n;
+}
+
+int
+HttpSessionManager::count_idle_sessions(sockaddr const* ip, INK_MD5 &hostname_hash, int share)
+{
+  EThread *ethread = this_ethread();
+  int l1_index = FIRST_LEVEL_HASH(ip);
+  int n = 0;
+
+  if (2 <= share) {
+    for (int i = 0; i < eventProcessor.n_threads_for_type[ET_NET]; ++i) {
+      EThread *t = eventProcessor.eventthread[ET_NET][i];
+
+      if (t->l1_hash == NULL)
+        continue;
+      MUTEX_TRY_LOCK(lock, t->l1_hash[l1_index].mutex, ethread);
+      if (!lock)
+        return -1;
+      n += _count_idle_sessions(t->l1_hash + l1_index, ip, hostname_hash);
+    }
+  } else {
+    MUTEX_TRY_LOCK(lock, g_l1_hash[l1_index].mutex, ethread);
+    if (!lock)
+      return -1;
+    n = _count_idle_sessions(g_l1_hash + l1_index, ip, hostname_hash);
+  }
+  return n;
+}
+
 void
 HttpSessionManager::init()
 {
@@ -150,6 +434,9 @@ HttpSessionManager::init()
   for (int i = 0; i < HSM_LEVEL1_BUCKETS; i++) {
     g_l1_hash[i].mutex = new_ProxyMutex();
   }
+
+  ink_mutex_init(&prewarm_mutex, "HttpSessionManager prewarm");
+  eventProcessor.schedule_every(NEW(new HttpPrewarm), HRTIME_SECONDS(1), ET_NET);
 }
 
 // TODO: Should this really purge all keep-alive sessions?
@@ -208,6 +495,132 @@ _acquire_session(SessionBucket *bucket, sockaddr const* ip, INK_MD5 &hostname_ha
   return HSM_NOT_FOUND;
 }
 
+// Look for a matching session in the per-thread pools of the other
+//  net threads.  Only used once the local pool came up empty; buckets
+//  that are busy are skipped rather than waited for.
+static HSMresult_t
+_steal_session(EThread *ethread, int l1_index, sockaddr const* ip, INK_MD5 &hostname_hash, HttpSM *sm)
+{
+  int n = eventProcessor.n_threads_for_type[ET_NET];
+
+  for (int i = 0; i < n; ++i) {
+    EThread *t = eventProcessor.eventthread[ET_NET][i];
+
+    if (t == ethread || t->l1_hash == NULL)
+      continue;
+    SessionBucket *bucket = t->l1_hash + l1_index;
+    if (bucket->lru_list.head == NULL)
+      continue;
+
+    MUTEX_TRY_LOCK(lock, bucket->mutex, ethread);
+    if (lock && _acquire_session(bucket, ip, hostname_hash, sm) == HSM_DONE) {
+      Debug("http_ss", "[acquire session] stole session from thread %p", t);
+      return HSM_DONE;
+    }
+  }
+
+  return HSM_NOT_FOUND;
+}
+
+// Queue the request on the matching active session with the fewest
+//  requests waiting.  The list is only touched by this thread.
+static HSMresult_t
+_pipeline_session(SessionBucket *bucket, sockaddr const* ip, INK_MD5 &hostname_hash, HttpSM *sm)
+{
+  HttpServerSession *best = NULL;
+
+  for (HttpServerSession *b = bucket->pipeline_list.head; b != NULL; b = b->pipeline_link.next) {
+    if (ats_ip_addr_eq(&b->server_ip.sa, ip) && ats_ip_port_cast(ip) == ats_ip_port_cast(&b->server_ip) &&
+        hostname_hash == b->hostname_hash && b->pipeline_count < b->pipeline_max &&
+        (best == NULL || b->pipeline_count < best->pipeline_count))
+      best = b;
+  }
+
+  if (best == NULL)
+    return HSM_NOT_FOUND;
+  best->pipeline_join(sm);
+  return HSM_PIPELINED;
+}
+
+void
+HttpSessionManager::pipeline_list(HttpServerSession *s, int max)
+{
+  EThread *ethread = this_ethread();
+
+  // The session is only ever touched on the thread of its connection,
+  //  which only the per-thread pools guarantee
+  if (s->share_session < 2 || s->private_session || !s->pipeline_capable || s->pipeline_broken ||
+      s->get_netvc()->thread != ethread || ethread->l1_hash == NULL)
+    return;
+
+  s->pipeline_max = MIN(max, HTTP_SS_PIPELINE_MAX);
+  if (!s->pipeline_listed) {
+    ethread->l1_hash[FIRST_LEVEL_HASH(&s->server_ip.sa)].pipeline_list.push(s);
+    s->pipeline_listed = true;
+    Debug("http_ss", "[%" PRId64 "] [pipeline] taking up to %d requests", s->con_id, s->pipeline_max);
+  }
+}
+
+void
+HttpSessionManager::pipeline_unlist(HttpServerSession *s)
+{
+  EThread *ethread = s->get_netvc()->thread;
+
+  ink_assert(ethread == this_ethread());
+  ethread->l1_hash[FIRST_LEVEL_HASH(&s->server_ip.sa)].pipeline_list.remove(s);
+  s->pipeline_listed = false;
+  s->pipeline_max = 0;
+}
+
+// Origins are matched by address alone, the request carries its own
+//  :authority.  Sessions are only shared on the thread of their
+//  connection, so the list needs no lock.
+NetVConnection *
+HttpSessionManager::acquire_http2_stream(sockaddr const* ip)
+{
+  EThread *ethread = this_ethread();
+
+  if (ethread->l1_hash == NULL)
+    return NULL;
+
+  SessionBucket *bucket = ethread->l1_hash + FIRST_LEVEL_HASH(ip);
+
+  for (Http2ServerSession *s = bucket->http2_list.head; s != NULL; s = s->link.next) {
+    if (!ats_ip_addr_eq(&s->server_ip.sa, ip) || ats_ip_port_cast(ip) != ats_ip_port_cast(&s->server_ip))
+      continue;
+    MUTEX_TRY_LOCK(lock, s->mutex, ethread);
+    if (!lock || !s->can_open_stream())
+      continue;
+    return s->open_stream();
+  }
+
+  return NULL;
+}
+
+NetVConnection *
+HttpSessionManager::add_http2_session(NetVConnection *netvc, sockaddr const* ip)
+{
+  EThread *ethread = this_ethread();
+  Http2ServerSession *s = http2ServerSessionAllocator.alloc();
+
+  s->new_connection(netvc, ip);
+
+  MUTEX_LOCK(lock, s->mutex, ethread);
+  if (netvc->thread == ethread && ethread->l1_hash != NULL) {
+    ethread->l1_hash[FIRST_LEVEL_HASH(ip)].http2_list.push(s);
+    s->listed = true;
+  }
+  return s->open_stream();
+}
+
+void
+HttpSessionManager::remove_http2_session(Http2ServerSession *s)
+{
+  ink_assert(s->thread == this_ethread());
+  s->thread->l1_hash[FIRST_LEVEL_HASH(&s->server_ip.sa)].http2_list.remove(s);
+  s->listed = false;
+}
+
 HSMresult_t
 HttpSessionManager::acquire_session(Continuation * /* cont ATS_UNUSED */, sockaddr const* ip,
                                     const char *hostname, HttpClientSession *ua_session, HttpSM *sm)
@@ -228,6 +641,9 @@ HttpSessionManager::acquire_session(Continuation * /* cont ATS_UNUSED */, sockad
 
   ink_code_md5((unsigned char *) hostname, strlen(hostname), (unsigned char *) &hostname_hash);
 
+  if (sm->t_state.http_config_param->prewarm_enabled)
+    note_origin(ip, hostname_hash, ua_session, sm);
+
   // First check to see if there is a server session bound
   //   to the user agent session
   to_return = ua_session->get_server_session();
@@ -257,9 +673,29 @@ HttpSessionManager::acquire_session(Continuation * /* cont ATS_UNUSED */, sockad
 
   ink_assert(l1_index < HSM_LEVEL1_BUCKETS);
 
-  if (2 == sm->t_state.txn_conf->share_server_sessions) {
+  if (2 <= sm->t_state.txn_conf->share_server_sessions) {
     ink_assert(ethread->l1_hash);
-    return _acquire_session(ethread->l1_hash + l1_index, ip, hostname_hash, sm);
+    SessionBucket *bucket = ethread->l1_hash + l1_index;
+    HSMresult_t r = HSM_NOT_FOUND;
+
+    if (2 == sm->t_state.txn_conf->share_server_sessions) {
+      r = _acquire_session(bucket, ip, hostname_hash, sm);
+    } else {
+      // Our own pool first.  Its bucket locks are only ever contended by
+      //  another thread stealing from us, so this is effectively free.
+      {
+        MUTEX_TRY_LOCK(lock, bucket->mutex, ethread);
+        if (lock)
+          r = _acquire_session(bucket, ip, hostname_hash, sm);
+      }
+      if (r != HSM_DONE)
+        r = _steal_session(ethread, l1_index, ip, hostname_hash, sm);
+    }
+
+    // Nothing idle, queue the request behind one in progress
+    if (r == HSM_NOT_FOUND && sm->can_pipeline_request())
+      r = _pipeline_session(bucket, ip, hostname_hash, sm);
+    return r;
   } else {
     SessionBucket *bucket = g_l1_hash + l1_index;
 
@@ -285,6 +721,13 @@ HttpSessionManager::release_session(HttpServerSession *to_release)
 
   if (2 == to_release->share_session) {
     bucket = ethread->l1_hash + l1_index;
+  } else if (3 == to_release->share_session) {
+    // A stolen session goes back to the pool of the thread its
+    //  connection lives on, not the one that borrowed it
+    EThread *home = to_release->get_netvc()->thread;
+    if (home == NULL || home->l1_hash == NULL)
+      home = ethread;
+    bucket = home->l1_hash + l1_index;
   } else {
     bucket = g_l1_hash + l1_index;
   }
@@ -304,6 +747,7 @@ HttpSessionManager::release_session(HttpServerSession *to_release)
     //  if it closes on us.  We will get called back in the
     //  continuation for this bucket, ensuring we have the lock
     //  to remove the connection from our lists
+    to_release->read_buffer->shrink(HTTP_SERVER_RESP_HDR_BUFFER_INDEX);
     to_release->do_io_read(bucket, INT64_MAX, to_release->read_buffer);
 
     // Transfer control of the write side as well
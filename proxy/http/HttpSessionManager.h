@@ -36,6 +36,7 @@
 
 #include "P_EventSystem.h"
 #include "HttpServerSession.h"
+#include "Http2ServerSession.h"
 
 class HttpClientSession;
 class HttpSM;
@@ -53,13 +54,20 @@ public:
   int session_handler(int event, void *data);
   Que(HttpServerSession, lru_link) lru_list;
   DList(HttpServerSession, hash_link) l2_hash[HSM_LEVEL2_BUCKETS];
+  // Active sessions taking pipelined requests, only touched by the
+  //  thread that owns the bucket
+  DList(HttpServerSession, pipeline_link) pipeline_list;
+  // HTTP/2 connections taking new streams, also only touched by the
+  //  thread that owns the bucket
+  DList(Http2ServerSession, link) http2_list;
 };
 
 enum HSMresult_t
 {
   HSM_DONE,
   HSM_RETRY,
-  HSM_NOT_FOUND
+  HSM_NOT_FOUND,
+  HSM_PIPELINED
 };
 
 class HttpSessionManager
@@ -78,7 +86,22 @@ public:
   void init();
   int main_handler(int event, void *data);
 
+  /// The idle sessions to an origin in the shared pools, -1 if a pool is busy.
+  int count_idle_sessions(sockaddr const* ip, INK_MD5 &hostname_hash, int share);
+
+  /// Let requests to the same origin be pipelined behind the one on an active session.
+  void pipeline_list(HttpServerSession *s, int max);
+  void pipeline_unlist(HttpServerSession *s);
+
+  /// Open a stream on an HTTP/2 connection to the origin, NULL if there is none with room.
+  NetVConnection *acquire_http2_stream(sockaddr const* addr);
+  /// Start HTTP/2 on a new origin connection and open its first stream.
+  NetVConnection *add_http2_session(NetVConnection *netvc, sockaddr const* addr);
+  void remove_http2_session(Http2ServerSession *s);
+
 private:
+  void note_origin(sockaddr const* ip, INK_MD5 &hostname_hash, HttpClientSession *ua_session, HttpSM *sm);
+
   //    Global l1 hash, used when there is no per-thread buckets
   SessionBucket g_l1_hash[HSM_LEVEL1_BUCKETS];
 };
@@ -0,0 +1,247 @@
+/** @file
+
+  Background revalidation of stale cached objects
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+ */
+
+/****************************************************************************
+
+  HttpStaleRevalidate.cc
+
+  Objects cached with the RFC 5861 stale-while-revalidate directive are
+  served stale for a while after they expire, and a background request
+  through the proxy revalidates them. However many clients hit the
+  object meanwhile, only one background request runs for a cache key,
+  the first stale hit starts it and the others find it in flight.
+
+  The background request is an internal request, which is never served
+  stale, so it revalidates the object like any stale hit does and its
+  cache update replaces the stale copy. The cache only knows of it once
+  its write is open, so the requests in flight are tracked here, by the
+  key the cache looks them up with, from the first stale hit until the
+  background request ends or times out.
+
+****************************************************************************/
+
+#include "HttpStaleRevalidate.h"
+#include "HttpSM.h"
+#include "PluginVC.h"
+#include "HttpAccept.h"
+
+#define STALE_REVALIDATE_STRIPES 64
+
+extern HttpAccept *plugin_http_accept;
+
+struct HttpStaleRevalidate:public Continuation
+{
+  INK_MD5 key;
+  VConnection *vc;
+  VIO *read_vio;
+  VIO *write_vio;
+  MIOBuffer *req_buffer;
+  MIOBuffer *resp_buffer;
+  IOBufferReader *resp_reader;
+  Event *timeout;
+  LINK(HttpStaleRevalidate, link);
+
+  HttpStaleRevalidate(INK_MD5 const &k);
+  void start(HttpTransact::State *s);
+  void done();
+  int main_handler(int event, void *data);
+};
+
+struct StaleRevalidateStripe
+{
+  ink_mutex mutex;
+  DLL<HttpStaleRevalidate> inflight;
+};
+
+static StaleRevalidateStripe stale_revalidate_stripes[STALE_REVALIDATE_STRIPES];
+
+static inline StaleRevalidateStripe *
+stale_revalidate_stripe(INK_MD5 const &key)
+{
+  return &stale_revalidate_stripes[key.fold() % STALE_REVALIDATE_STRIPES];
+}
+
+HttpStaleRevalidate::HttpStaleRevalidate(INK_MD5 const &k)
+  : Continuation(new_ProxyMutex()), key(k), vc(NULL), read_vio(NULL), write_vio(NULL),
+    req_buffer(NULL), resp_buffer(NULL), resp_reader(NULL), timeout(NULL)
+{
+  SET_HANDLER(&HttpStaleRevalidate::main_handler);
+}
+
+void
+HttpStaleRevalidate::start(HttpTransact::State *s)
+{
+  HTTPHdr req;
+  URL *url;
+  const char *host;
+  int host_len, len, index = 0, offset = 0;
+
+  req.create(HTTP_TYPE_REQUEST);
+  req.copy(&s->hdr_info.client_request);
+  // the request as the client sent it, it goes through remap again
+  if (s->pristine_url.valid())
+    req.url_set(&s->pristine_url);
+  req.method_set(HTTP_METHOD_GET, HTTP_LEN_GET);
+
+  // The background request must not be conditional or partial, nor
+  // let the proxy answer it with the stale object.
+  req.field_delete(MIME_FIELD_IF_MODIFIED_SINCE, MIME_LEN_IF_MODIFIED_SINCE);
+  req.field_delete(MIME_FIELD_IF_UNMODIFIED_SINCE, MIME_LEN_IF_UNMODIFIED_SINCE);
+  req.field_delete(MIME_FIELD_IF_NONE_MATCH, MIME_LEN_IF_NONE_MATCH);
+  req.field_delete(MIME_FIELD_IF_MATCH, MIME_LEN_IF_MATCH);
+  req.field_delete(MIME_FIELD_IF_RANGE, MIME_LEN_IF_RANGE);
+  req.field_delete(MIME_FIELD_RANGE, MIME_LEN_RANGE);
+  req.field_delete(MIME_FIELD_CACHE_CONTROL, MIME_LEN_CACHE_CONTROL);
+  req.field_delete(MIME_FIELD_PRAGMA, MIME_LEN_PRAGMA);
+  req.field_delete(MIME_FIELD_PROXY_CONNECTION, MIME_LEN_PROXY_CONNECTION);
+  req.field_delete(MIME_FIELD_CONTENT_LENGTH, MIME_LEN_CONTENT_LENGTH);
+  req.field_delete(MIME_FIELD_TRANSFER_ENCODING, MIME_LEN_TRANSFER_ENCODING);
+  req.field_delete(MIME_FIELD_EXPECT, MIME_LEN_EXPECT);
+  req.value_set(MIME_FIELD_CONNECTION, MIME_LEN_CONNECTION, "close", 5);
+
+  url = req.url_get();
+  host = url->host_get(&host_len);
+  if (host && host_len > 0) {
+    char buf[1024];
+    int port = url->port_get_raw();
+
+    if (port)
+      host_len = snprintf(buf, sizeof(buf), "%.*s:%d", host_len, host, port);
+    else
+      host_len = snprintf(buf, sizeof(buf), "%.*s", host_len, host);
+    if (host_len < (int) sizeof(buf))
+      req.value_set(MIME_FIELD_HOST, MIME_LEN_HOST, buf, host_len);
+  }
+
+  len = req.length_get();
+  char *text = (char *)ats_malloc(len + 1);
+  req.print(text, len + 1, &index, &offset);
+  req.destroy();
+
+  MUTEX_LOCK(lock, mutex, this_ethread());
+
+  req_buffer = new_MIOBuffer(BUFFER_SIZE_INDEX_4K);
+  IOBufferReader *req_reader = req_buffer->alloc_reader();
+  req_buffer->write(text, index);
+  ats_free(text);
+  resp_buffer = new_MIOBuffer(BUFFER_SIZE_INDEX_32K);
+  resp_reader = resp_buffer->alloc_reader();
+
+  PluginVCCore *pvc = PluginVCCore::alloc(true, mutex);
+  pvc->set_active_addr(&s->client_info.addr.sa);
+  pvc->set_accept_cont(plugin_http_accept);
+
+  PluginVC *pvc_vc = pvc->connect();
+  pvc_vc->get_other_side()->set_is_internal_request(true);
+  vc = pvc_vc;
+
+  timeout = eventProcessor.schedule_in(this, HRTIME_SECONDS(s->http_config_param->cache_stale_while_revalidate_timeout));
+  read_vio = vc->do_io_read(this, INT64_MAX, resp_buffer);
+  write_vio = vc->do_io_write(this, index, req_reader);
+  HTTP_INCREMENT_DYN_STAT(http_cache_background_revalidations_stat);
+}
+
+void
+HttpStaleRevalidate::done()
+{
+  StaleRevalidateStripe *stripe = stale_revalidate_stripe(key);
+
+  ink_mutex_acquire(&stripe->mutex);
+  stripe->inflight.remove(this);
+  ink_mutex_release(&stripe->mutex);
+
+  if (timeout)
+    timeout->cancel();
+  if (vc)
+    vc->do_io_close();
+  if (req_buffer)
+    free_MIOBuffer(req_buffer);
+  if (resp_buffer)
+    free_MIOBuffer(resp_buffer);
+  mutex.clear();
+  delete this;
+}
+
+int
+HttpStaleRevalidate::main_handler(int event, void * /* data ATS_UNUSED */)
+{
+  switch (event) {
+  case VC_EVENT_WRITE_READY:
+    write_vio->reenable();
+    break;
+  case VC_EVENT_WRITE_COMPLETE:
+    break;
+  case VC_EVENT_READ_READY:
+    // the response went to the cache, nobody wants it here
+    resp_reader->consume(resp_reader->read_avail());
+    read_vio->reenable();
+    break;
+  case EVENT_INTERVAL:
+    Debug("http_revalidate", "background revalidation timed out");
+    timeout = NULL;
+    done();
+    break;
+  default:
+    // the response is complete or the request failed
+    Debug("http_revalidate", "background revalidation done, event %d", event);
+    done();
+    break;
+  }
+  return EVENT_DONE;
+}
+
+bool
+http_stale_revalidate_start(HttpTransact::State *s)
+{
+  StaleRevalidateStripe *stripe;
+  HttpStaleRevalidate *r;
+  INK_MD5 key;
+
+  if (!plugin_http_accept)
+    return false;
+
+  s->cache_info.lookup_url->MD5_get(&key);
+  stripe = stale_revalidate_stripe(key);
+
+  ink_mutex_acquire(&stripe->mutex);
+  for (r = stripe->inflight.head; r; r = r->link.next) {
+    if (r->key == key) {
+      ink_mutex_release(&stripe->mutex);
+      return false;
+    }
+  }
+  r = NEW(new HttpStaleRevalidate(key));
+  stripe->inflight.push(r);
+  ink_mutex_release(&stripe->mutex);
+
+  r->start(s);
+  return true;
+}
+
+void
+http_stale_revalidate_init()
+{
+  for (int i = 0; i < STALE_REVALIDATE_STRIPES; i++)
+    ink_mutex_init(&stale_revalidate_stripes[i].mutex, "StaleRevalidate");
+}
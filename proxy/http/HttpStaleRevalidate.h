@@ -0,0 +1,40 @@
+/** @file
+
+  Background revalidation of stale cached objects
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+ */
+
+#if !defined (_HttpStaleRevalidate_h_)
+#define _HttpStaleRevalidate_h_
+
+#include "HttpTransact.h"
+
+void http_stale_revalidate_init();
+
+/**
+  Start a background revalidation of the stale object s hit in cache,
+  unless one is already running for its cache key.
+
+  @return @c true if this call started the revalidation.
+*/
+bool http_stale_revalidate_start(HttpTransact::State *s);
+
+#endif
@@ -0,0 +1,266 @@
+/** @file
+
+  Sampled tracing of HTTP transactions
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+ */
+
+/****************************************************************************
+
+  HttpTrace.cc
+
+  A traced transaction records each state machine handler it enters,
+  and the event, with a high resolution time stamp. The entries go in a
+  ring on the thread running the handler, so tracing takes no locks and
+  keeps the latest entries of all the traced transactions on a thread.
+
+  http://{trace}/ lists the traced transactions still in the rings and
+  http://{trace}/?id=<sm_id> shows the entries of one. When the trace
+  log is on, each traced transaction also writes its entries to
+  http_trace.log as it ends, in the Chrome trace event format, one
+  complete event for each handler up to the next one.
+
+****************************************************************************/
+
+#include "HttpTrace.h"
+#include "P_EventSystem.h"
+#include "StatPages.h"
+#include "HttpDebugNames.h"
+#include "Log.h"
+#include "LogObject.h"
+#include "LogConfig.h"
+
+#define HTTP_TRACE_PAGE_TXNS 200
+
+int http_trace_sample = 0;
+char *http_trace_header = NULL;
+int http_trace_header_len = 0;
+int http_trace_log_enabled = 0;
+
+__thread HttpTraceRing *http_trace_ring = NULL;
+__thread int http_trace_countdown = 0;
+
+static DLL<HttpTraceRing> http_trace_rings;
+static int http_trace_nrings = 0;
+static ink_mutex http_trace_mutex;
+static TextLogObject *http_trace_log = NULL;
+
+HttpTraceRing *
+http_trace_ring_create()
+{
+  HttpTraceRing *r = (HttpTraceRing *)ats_calloc(1, sizeof(HttpTraceRing));
+
+  ink_mutex_acquire(&http_trace_mutex);
+  r->id = http_trace_nrings++;
+  http_trace_rings.push(r);
+  ink_mutex_release(&http_trace_mutex);
+  return r;
+}
+
+// The entries of a transaction in this thread's ring, oldest first.
+static int
+http_trace_collect(HttpTraceRing *r, int64_t sm_id, HttpTraceEntry *out, int max)
+{
+  uint64_t pos = r->pos;
+  uint64_t first = pos > HTTP_TRACE_ENTRIES ? pos - HTTP_TRACE_ENTRIES : 0;
+  int n = 0;
+
+  for (uint64_t i = first; i < pos && n < max; i++) {
+    HttpTraceEntry *e = &r->entries[i & (HTTP_TRACE_ENTRIES - 1)];
+    if (e->sm_id == sm_id)
+      out[n++] = *e;
+  }
+  return n;
+}
+
+static const char *
+http_trace_state_name(const char *state)
+{
+  // the handlers are recorded as &Class::method
+  return (state && *state == '&') ? state + 1 : (state ? state : "");
+}
+
+void
+http_trace_write(int64_t sm_id)
+{
+  HttpTraceRing *r = http_trace_ring;
+
+  if (!http_trace_log_enabled || !r || !Log::config)
+    return;
+
+  if (!http_trace_log) {
+    ink_mutex_acquire(&http_trace_mutex);
+    if (!http_trace_log) {
+      // the header opens the JSON array, the trace viewer does not need it closed
+      TextLogObject *tlog = NEW(new TextLogObject("http_trace.log", Log::config->logfile_dir, false, "[",
+                                                  Log::config->rolling_enabled,
+                                                  Log::config->rolling_interval_sec,
+                                                  Log::config->rolling_offset_hr,
+                                                  Log::config->rolling_size_mb));
+      if (Log::config->log_object_manager.manage_api_object(tlog) != LogObjectManager::NO_FILENAME_CONFLICTS) {
+        Warning("unable to create http_trace.log, turning the trace log off");
+        delete tlog;
+        http_trace_log_enabled = 0;
+      } else {
+        http_trace_log = tlog;
+      }
+    }
+    ink_mutex_release(&http_trace_mutex);
+    if (!http_trace_log)
+      return;
+  }
+
+  HttpTraceEntry *entries = (HttpTraceEntry *)ats_malloc(sizeof(HttpTraceEntry) * HTTP_TRACE_ENTRIES);
+  int n = http_trace_collect(r, sm_id, entries, HTTP_TRACE_ENTRIES);
+
+  for (int i = 0; i < n; i++) {
+    ink_hrtime dur = (i + 1 < n) ? entries[i + 1].time - entries[i].time : 0;
+
+    http_trace_log->write("{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%" PRId64
+                          ",\"args\":{\"event\":\"%s\"}},",
+                          http_trace_state_name(entries[i].state), (double) entries[i].time / HRTIME_USECOND,
+                          (double) dur / HRTIME_USECOND, sm_id, HttpDebugNames::get_event_name(entries[i].event));
+  }
+  ats_free(entries);
+}
+
+struct HttpTraceTxn
+{
+  int64_t sm_id;
+  int ring;
+  int count;
+  ink_hrtime first;
+  ink_hrtime last;
+};
+
+static int
+http_trace_entry_cmp(const void *a, const void *b)
+{
+  ink_hrtime ta = ((const HttpTraceEntry *) a)->time, tb = ((const HttpTraceEntry *) b)->time;
+  return ta < tb ? -1 : (ta > tb ? 1 : 0);
+}
+
+static int
+http_trace_page_txns(char *buffer, int size)
+{
+  HttpTraceTxn *txns = (HttpTraceTxn *)ats_malloc(sizeof(HttpTraceTxn) * HTTP_TRACE_PAGE_TXNS);
+  int ntxns = 0, len;
+
+  len = snprintf(buffer, size, "<H3>Traced transactions</H3>\n<p>Tracing one in %d transactions%s%s.</p>\n"
+                 "<table border=1><tr><th>Id</th><th>Thread</th><th>Entries</th><th>Elapsed usec</th></tr>\n",
+                 http_trace_sample, http_trace_header ? " and those with " : "", http_trace_header ? http_trace_header : "");
+  ink_mutex_acquire(&http_trace_mutex);
+  for (HttpTraceRing *r = http_trace_rings.head; r; r = r->link.next) {
+    uint64_t pos = r->pos;
+    uint64_t first = pos > HTTP_TRACE_ENTRIES ? pos - HTTP_TRACE_ENTRIES : 0;
+
+    // newest first, the rings are still being written
+    for (uint64_t i = pos; i > first && ntxns < HTTP_TRACE_PAGE_TXNS; i--) {
+      HttpTraceEntry e = r->entries[(i - 1) & (HTTP_TRACE_ENTRIES - 1)];
+      int j;
+
+      for (j = 0; j < ntxns; j++)
+        if (txns[j].sm_id == e.sm_id && txns[j].ring == r->id)
+          break;
+      if (j == ntxns) {
+        txns[j].sm_id = e.sm_id;
+        txns[j].ring = r->id;
+        txns[j].count = 0;
+        txns[j].last = e.time;
+        ntxns++;
+      }
+      txns[j].count++;
+      txns[j].first = e.time;
+    }
+  }
+  ink_mutex_release(&http_trace_mutex);
+
+  for (int j = 0; j < ntxns && size - len > 256; j++)
+    len += snprintf(buffer + len, size - len, "<tr><td><a href=\"./?id=%" PRId64 "\">%" PRId64 "</a></td><td>%d</td>"
+                    "<td>%d</td><td>%" PRId64 "</td></tr>\n", txns[j].sm_id, txns[j].sm_id, txns[j].ring, txns[j].count,
+                    (int64_t) ((txns[j].last - txns[j].first) / HRTIME_USECOND));
+  len += snprintf(buffer + len, size - len, "</table>\n");
+  ats_free(txns);
+  return len;
+}
+
+static int
+http_trace_page_txn(char *buffer, int size, int64_t sm_id)
+{
+  HttpTraceEntry *entries = (HttpTraceEntry *)ats_malloc(sizeof(HttpTraceEntry) * HTTP_TRACE_ENTRIES);
+  int n = 0, len;
+
+  ink_mutex_acquire(&http_trace_mutex);
+  for (HttpTraceRing *r = http_trace_rings.head; r && n < HTTP_TRACE_ENTRIES; r = r->link.next)
+    n += http_trace_collect(r, sm_id, entries + n, HTTP_TRACE_ENTRIES - n);
+  ink_mutex_release(&http_trace_mutex);
+  qsort(entries, n, sizeof(HttpTraceEntry), http_trace_entry_cmp);
+
+  len = snprintf(buffer, size, "<H3>Transaction %" PRId64 "</H3>\n<table border=1><tr><th>usec</th>"
+                 "<th>+usec</th><th>Handler</th><th>Event</th></tr>\n", sm_id);
+  for (int i = 0; i < n && size - len > 256; i++)
+    len += snprintf(buffer + len, size - len, "<tr><td>%.1f</td><td>%.1f</td><td>%s</td><td>%s</td></tr>\n",
+                    (double) (entries[i].time - entries[0].time) / HRTIME_USECOND,
+                    i ? (double) (entries[i].time - entries[i - 1].time) / HRTIME_USECOND : 0.0,
+                    http_trace_state_name(entries[i].state), HttpDebugNames::get_event_name(entries[i].event));
+  len += snprintf(buffer + len, size - len, "</table>\n");
+  ats_free(entries);
+  return len;
+}
+
+static Action *
+http_trace_callback(Continuation * cont, HTTPHdr * header)
+{
+  int query_len;
+  const char *query = header->url_get()->query_get(&query_len);
+  int size = 64 * 1024 + HTTP_TRACE_ENTRIES * 256;
+  char *buffer = (char *)ats_malloc(size);
+  StatPageData data;
+
+  if (query && query_len > 3 && query_len < 32 && strncmp(query, "id=", 3) == 0) {
+    char id[32];
+
+    memcpy(id, query + 3, query_len - 3);
+    id[query_len - 3] = '\0';
+    data.length = http_trace_page_txn(buffer, size, ink_atoi64(id));
+  } else {
+    data.length = http_trace_page_txns(buffer, size);
+  }
+  data.data = buffer;
+  cont->handleEvent(STAT_PAGE_SUCCESS, &data);
+
+  return ACTION_RESULT_DONE;
+}
+
+void
+http_trace_init()
+{
+  ink_mutex_init(&http_trace_mutex, "HttpTrace");
+  REC_EstablishStaticConfigInt32(http_trace_sample, "proxy.config.http.trace.sample_rate");
+  REC_EstablishStaticConfigInt32(http_trace_log_enabled, "proxy.config.http.trace.log_enabled");
+  REC_ReadConfigStringAlloc(http_trace_header, "proxy.config.http.trace.header");
+  if (http_trace_header && !*http_trace_header) {
+    ats_free(http_trace_header);
+    http_trace_header = NULL;
+  }
+  http_trace_header_len = http_trace_header ? strlen(http_trace_header) : 0;
+
+  statPagesManager.register_http("trace", http_trace_callback);
+}
@@ -0,0 +1,91 @@
+/** @file
+
+  Sampled tracing of HTTP transactions
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+ */
+
+#if !defined (_HttpTrace_h_)
+#define _HttpTrace_h_
+
+#include "libts.h"
+
+#define HTTP_TRACE_ENTRIES 4096       // kept per thread, a power of 2
+
+/// A handler of a traced transaction was entered.
+struct HttpTraceEntry
+{
+  int64_t sm_id;
+  ink_hrtime time;
+  const char *state;            // the handler, a string literal
+  int event;
+};
+
+/// The latest trace entries of the transactions run on one thread.
+struct HttpTraceRing
+{
+  HttpTraceEntry entries[HTTP_TRACE_ENTRIES];
+  uint64_t pos;                 // entries ever written
+  int id;
+  LINK(HttpTraceRing, link);
+};
+
+/// Trace one in this many transactions, 0 for none.
+extern int http_trace_sample;
+/// Also trace requests carrying this header, NULL for none.
+extern char *http_trace_header;
+extern int http_trace_header_len;
+/// Write the trace of each traced transaction to http_trace.log.
+extern int http_trace_log_enabled;
+
+extern __thread HttpTraceRing *http_trace_ring;
+extern __thread int http_trace_countdown;
+
+void http_trace_init();
+HttpTraceRing *http_trace_ring_create();
+void http_trace_write(int64_t sm_id);
+
+/// Whether to trace a new transaction, for one in http_trace_sample.
+static inline bool
+http_trace_sampled()
+{
+  if (likely(!http_trace_sample) || --http_trace_countdown > 0)
+    return false;
+  http_trace_countdown = http_trace_sample;
+  return true;
+}
+
+static inline void
+http_trace_record(int64_t sm_id, const char *state, int event)
+{
+  HttpTraceRing *r = http_trace_ring;
+
+  if (unlikely(!r))
+    r = http_trace_ring = http_trace_ring_create();
+
+  HttpTraceEntry *e = &r->entries[r->pos & (HTTP_TRACE_ENTRIES - 1)];
+  e->sm_id = sm_id;
+  e->time = ink_get_hrtime_internal();
+  e->state = state;
+  e->event = event;
+  r->pos++;
+}
+
+#endif
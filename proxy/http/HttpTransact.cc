@@ -31,6 +31,8 @@
 #include "HttpSM.h"
 #include "HttpCacheSM.h"        //Added to get the scope of HttpCacheSM object - YTS Team, yamsat
 #include "HttpDebugNames.h"
+#include "HttpStaleRevalidate.h"
+#include "HttpNegativeCache.h"
 #include "time.h"
 #include "ParseRules.h"
 #include "HTTP.h"
@@ -45,6 +47,7 @@
 #include "HttpBodyFactory.h"
 #include "StatPages.h"
 #include "HttpClientSession.h"
+#include "HttpProxyServerMain.h"
 #include "I_Machine.h"
 #include "IPAllow.h"
 
@@ -75,7 +78,7 @@ static const char local_host_ip_str[] = "127.0.0.1";
 
 // someday, reduce the amount of duplicate code between this
 // function and _process_xxx_connection_field_in_outgoing_header
-inline static HTTPKeepAlive
+HTTPKeepAlive
 is_header_keep_alive(const HTTPVersion & http_version, const HTTPVersion & request_http_version, MIMEField* con_hdr    /*, bool* unknown_tokens */)
 {
   enum
@@ -260,6 +263,14 @@ is_negative_caching_appropriate(HttpTransact::State* s)
   if (!s->txn_conf->negative_caching_enabled || !s->hdr_info.server_response.valid())
     return false;
 
+  // Configured lifetimes say which status codes are negatively cached
+  int32_t *lifetimes = s->http_config_param->negative_caching_lifetimes;
+  if (lifetimes) {
+    int status = s->hdr_info.server_response.status_get();
+
+    return status > 0 && status < HTTP_NEGATIVE_CACHING_STATUS_MAX && lifetimes[status] > 0;
+  }
+
   switch (s->hdr_info.server_response.status_get()) {
   case HTTP_STATUS_NO_CONTENT:
   case HTTP_STATUS_USE_PROXY:
@@ -281,6 +292,16 @@ is_negative_caching_appropriate(HttpTransact::State* s)
   return false;
 }
 
+inline static MgmtInt
+negative_caching_lifetime(HttpTransact::State* s)
+{
+  int32_t *lifetimes = s->http_config_param->negative_caching_lifetimes;
+
+  if (lifetimes)
+    return lifetimes[s->hdr_info.server_response.status_get()];
+  return s->txn_conf->negative_caching_lifetime;
+}
+
 inline static HttpTransact::LookingUp_t
 find_server_and_update_current_info(HttpTransact::State* s)
 {
@@ -590,6 +611,16 @@ HttpTransact::BadRequest(State* s)
   TRANSACT_RETURN(PROXY_SEND_ERROR_CACHE_NOOP, NULL);
 }
 
+void
+HttpTransact::PostBufferFailed(State* s)
+{
+  DebugTxn("http_trans", "[PostBufferFailed]" "unable to buffer the request body");
+  s->client_info.keep_alive = HTTP_NO_KEEPALIVE;
+  build_error_response(s, HTTP_STATUS_INTERNAL_SERVER_ERROR, "Request Body Error", "default",
+                       "Unable to buffer the request body", "");
+  TRANSACT_RETURN(PROXY_SEND_ERROR_CACHE_NOOP, NULL);
+}
+
 void
 HttpTransact::HandleBlindTunnel(State* s)
 {
@@ -844,7 +875,6 @@ HttpTransact::EndRemapRequest(State* s)
                            "\"<em>%s</em>\".<p>", s->remap_redirect);
     }
     s->hdr_info.client_response.value_set(MIME_FIELD_LOCATION, MIME_LEN_LOCATION, s->remap_redirect, strlen(s->remap_redirect));
-    ats_free(s->remap_redirect);
     s->reverse_proxy = false;
     goto done;
   }
@@ -1782,6 +1812,57 @@ HttpTransact::HandleFiltering(State* s)
   DecideCacheLookup(s);
 }
 
+// Appends the client request cookies named in
+// proxy.config.http.cache.key_cookies to the query of the cache lookup
+// URL, so that each of their values gets its own object. The client URL is
+// never changed, the lookup URL becomes a copy if it is not one yet.
+static void
+add_cookies_to_lookup_url(HttpTransact::State* s)
+{
+  const char *names = s->http_config_param->cache_key_cookies;
+  HTTPHdr *incoming_request = &s->hdr_info.client_request;
+  char buf[2048];
+  int len = 0;
+
+  while (*names) {
+    const char *end = names;
+    int name_len, value_len;
+    const char *value;
+
+    while (*end && *end != ',' && !ParseRules::is_ws(*end))
+      ++end;
+    name_len = end - names;
+    if (name_len > 0) {
+      value = s->hdr_info.client_request_cookies.get(incoming_request, names, name_len, &value_len);
+      // the prefix keeps the key apart from a query the client sent
+      if (value && len + 6 + name_len + 1 + value_len < (int) sizeof(buf))
+        len += snprintf(buf + len, sizeof(buf) - len, "%sck.%.*s=%.*s", len ? "&" : "",
+                        name_len, names, value_len, value);
+    }
+    names = *end ? end + 1 : end;
+  }
+  if (len == 0)
+    return;
+
+  if (s->cache_info.lookup_url != &s->cache_info.lookup_url_storage) {
+    s->cache_info.lookup_url_storage.create(NULL);
+    s->cache_info.lookup_url_storage.copy(s->cache_info.lookup_url);
+    s->cache_info.lookup_url = &s->cache_info.lookup_url_storage;
+  }
+
+  int query_len;
+  const char *query = s->cache_info.lookup_url->query_get(&query_len);
+  char key[4096];
+  int key_len = 0;
+
+  if (query && query_len > 0 && query_len + 1 + len < (int) sizeof(key))
+    key_len = snprintf(key, sizeof(key), "%.*s&%.*s", query_len, query, len, buf);
+  else
+    key_len = snprintf(key, sizeof(key), "%.*s", len, buf);
+  DebugTxn("http_trans", "[add_cookies_to_lookup_url] cache key query %.*s", key_len, key);
+  s->cache_info.lookup_url->query_set(key, key_len);
+}
+
 void
 HttpTransact::DecideCacheLookup(State* s)
 {
@@ -1853,6 +1934,8 @@ HttpTransact::DecideCacheLookup(State* s)
           s->cache_info.lookup_url->port_set(port);
         }
       }
+      if (s->http_config_param->cache_key_cookies)
+        add_cookies_to_lookup_url(s);
       ink_assert(s->cache_info.lookup_url->valid() == true);
     }
 
@@ -2287,6 +2370,18 @@ HttpTransact::HandleCacheOpenReadHitFreshness(State* s)
            (int64_t)s->request_sent_time);
   DebugTxn("http_trans", "[HandleCacheOpenReadHitFreshness] response_received_time : %" PRId64,
            (int64_t)s->response_received_time);
+
+  // an object cached before it was invalidated is a miss
+  if (s->cache_lookup_result == HttpTransact::CACHE_LOOKUP_NONE &&
+      HttpTransactCache::is_invalidated(obj->request_get(), obj->response_get(), obj->response_received_time_get(),
+                                        s->http_config_param->cache_invalidate_tag_header)) {
+    DebugTxn("http_seq", "[HttpTransact::HandleCacheOpenReadHitFreshness] " "Invalidated in cache");
+    s->cache_lookup_result = HttpTransact::CACHE_LOOKUP_MISS;
+    s->api_cleanup_cache_read = true;
+    SET_VIA_STRING(VIA_DETAIL_CACHE_LOOKUP, VIA_DETAIL_MISS_EXPIRED);
+    TRANSACT_RETURN(HTTP_API_CACHE_LOOKUP_COMPLETE, HttpTransact::HandleCacheOpenRead);
+  }
+
   // if the plugin has already decided the freshness, we don't need to
   // do it again
   if (s->cache_lookup_result == HttpTransact::CACHE_LOOKUP_NONE) {
@@ -2449,6 +2544,7 @@ HttpTransact::HandleCacheOpenReadHit(State* s)
   bool needs_revalidate, needs_authenticate = false;
   bool needs_cache_auth = false;
   bool server_up = true;
+  bool serve_stale = false;
   CacheHTTPInfo *obj;
 
   if (s->api_update_cached_object == HttpTransact::UPDATE_CACHED_OBJECT_CONTINUE) {
@@ -2523,6 +2619,25 @@ HttpTransact::HandleCacheOpenReadHit(State* s)
     send_revalidate = true;
   }
 
+  // RFC 5861: within its stale-while-revalidate window, serve the stale
+  // document and leave revalidating it to a single background request.
+  // The background request itself is internal and revalidates.
+  if (send_revalidate && needs_revalidate && !needs_authenticate && !needs_cache_auth && response_returnable &&
+      s->cache_info.stale_while_revalidate && s->http_config_param->cache_stale_while_revalidate &&
+      (s->method == HTTP_WKSIDX_GET || s->method == HTTP_WKSIDX_HEAD) &&
+      s->state_machine->ua_session && !s->state_machine->ua_session->get_netvc()->get_is_internal_request() &&
+      is_stale_cache_response_returnable(s)) {
+    if (http_stale_revalidate_start(s)) {
+      DebugTxn("http_trans", "CacheOpenRead --- stale-while-revalidate, started background revalidation");
+    } else {
+      DebugTxn("http_trans", "CacheOpenRead --- stale-while-revalidate, revalidation already in flight");
+    }
+    HTTP_INCREMENT_TRANS_STAT(http_cache_hit_stale_revalidating_stat);
+    SET_VIA_STRING(VIA_DETAIL_CACHE_TYPE, VIA_DETAIL_CACHE);
+    send_revalidate = false;
+    serve_stale = true;
+  }
+
   DebugTxn("http_trans", "CacheOpenRead --- needs_auth          = %d", needs_authenticate);
   DebugTxn("http_trans", "CacheOpenRead --- needs_revalidate    = %d", needs_revalidate);
   DebugTxn("http_trans", "CacheOpenRead --- response_returnable = %d", response_returnable);
@@ -2650,8 +2765,8 @@ HttpTransact::HandleCacheOpenReadHit(State* s)
   if (s->cache_lookup_result == CACHE_LOOKUP_HIT_WARNING) {
     build_response_from_cache(s, HTTP_WARNING_CODE_HERUISTIC_EXPIRATION);
   } else if (s->cache_lookup_result == CACHE_LOOKUP_HIT_STALE) {
-    ink_assert(server_up == false);
-    build_response_from_cache(s, HTTP_WARNING_CODE_REVALIDATION_FAILED);
+    ink_assert(server_up == false || serve_stale);
+    build_response_from_cache(s, serve_stale ? HTTP_WARNING_CODE_RESPONSE_STALE : HTTP_WARNING_CODE_REVALIDATION_FAILED);
   } else {
     build_response_from_cache(s, HTTP_WARNING_CODE_NONE);
   }
@@ -2982,6 +3097,41 @@ HttpTransact::HandleCacheOpenReadMiss(State* s)
   return;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Name       : HandleNegativeCacheHit
+// Description: the in memory negative cache answered the request
+//
+// Details    :
+//
+// The state machine has set up negative_cache_status, the age of the entry
+// in negative_cache_ttl, and the body and its content type as the internal
+// message buffer. No cache read or origin server connection is needed.
+//
+// Possible Next States From Here:
+// - HttpTransact::PROXY_INTERNAL_CACHE_NOOP;
+//
+///////////////////////////////////////////////////////////////////////////////
+void
+HttpTransact::HandleNegativeCacheHit(State* s)
+{
+  HTTPStatus status = s->negative_cache_status;
+  const char *reason = http_hdr_reason_lookup(status);
+
+  DebugTxn("http_trans", "[HandleNegativeCacheHit] serving %d from the negative cache", status);
+
+  s->source = SOURCE_INTERNAL;
+  s->cache_lookup_result = CACHE_LOOKUP_HIT_FRESH;
+  s->cache_info.action = CACHE_DO_NO_ACTION;
+  s->hdr_info.trust_response_cl = true;
+  SET_VIA_STRING(VIA_CACHE_RESULT, VIA_IN_RAM_CACHE_FRESH);
+  SET_VIA_STRING(VIA_DETAIL_CACHE_LOOKUP, VIA_DETAIL_HIT_SERVED);
+
+  build_response(s, &s->hdr_info.client_response, s->client_info.http_version, status, reason ? reason : "Negative Response");
+  s->hdr_info.client_response.value_set_int(MIME_FIELD_AGE, MIME_LEN_AGE, s->negative_cache_ttl);
+
+  TRANSACT_RETURN(PROXY_INTERNAL_CACHE_NOOP, NULL);
+}
+
 
 ///////////////////////////////////////////////////////////////////////////////
 // Name       : HandleICPLookup
@@ -3856,7 +4006,9 @@ HttpTransact::handle_100_continue_response(State* s)
   if (forward_100) {
     // We just want to copy the server's response.  All
     //   the other build response functions insist on
-    //   adding stuff
+    //   adding stuff.  The 100 is not logged and the server
+    //   response is created again to read the final one, so
+    //   hand its header over instead of copying it
     build_response_copy(s, &s->hdr_info.server_response, &s->hdr_info.client_response, s->client_info.http_version);
     TRANSACT_RETURN(PROXY_INTERNAL_100_RESPONSE, HandleResponse);
   } else {
@@ -3866,13 +4018,14 @@ HttpTransact::handle_100_continue_response(State* s)
 
 // void HttpTransact::build_response_copy
 //
-//   Build a response with minimal changes from the base response
+//   Build a response with minimal changes from the base response,
+//     which is moved into the outgoing response and left invalid
 //
 void
 HttpTransact::build_response_copy(State* s, HTTPHdr* base_response,HTTPHdr* outgoing_response, HTTPVersion outgoing_version)
 {
   HttpTransactHeaders::copy_header_fields(base_response, outgoing_response, s->txn_conf->fwd_proxy_auth_to_parent,
-                                          s->current.now);
+                                          s->current.now, true);
   HttpTransactHeaders::convert_response(outgoing_version, outgoing_response);   // http version conversion
   HttpTransactHeaders::add_server_header_to_response(s->txn_conf, outgoing_response);
 
@@ -4217,14 +4370,23 @@ HttpTransact::handle_cache_operation_on_forward_server_response(State* s)
     //   before issuing a 304
     if (s->cache_info.action == CACHE_DO_WRITE ||
         s->cache_info.action == CACHE_DO_NO_ACTION || s->cache_info.action == CACHE_DO_REPLACE) {
-      if (s->negative_caching) {
+      if (s->negative_caching && s->cache_info.action == CACHE_DO_WRITE && http_negative_cache_admit(s)) {
+        // Small enough to keep in memory, instead of a disk cache write
+        HTTPHdr *resp = &s->hdr_info.server_response;
+        time_t expires = resp->presence(MIME_PRESENCE_EXPIRES) ? resp->get_expires() : 0;
+
+        s->negative_cache_ttl = expires ? (int) (expires - ink_cluster_time()) : (int) negative_caching_lifetime(s);
+        s->negative_cache_store = s->negative_cache_ttl > 0;
+        s->negative_caching = false;
+        s->cache_info.action = CACHE_DO_NO_ACTION;
+      } else if (s->negative_caching) {
         HTTPHdr *resp;
         s->cache_info.object_store.create();
         s->cache_info.object_store.request_set(&s->hdr_info.client_request);
         s->cache_info.object_store.response_set(&s->hdr_info.server_response);
         resp = s->cache_info.object_store.response_get();
         if (!resp->presence(MIME_PRESENCE_EXPIRES)) {
-          time_t exp_time = s->txn_conf->negative_caching_lifetime + ink_cluster_time();
+          time_t exp_time = negative_caching_lifetime(s) + ink_cluster_time();
 
           resp->set_expires(exp_time);
         }
@@ -5361,7 +5523,7 @@ HttpTransact::handle_trace_and_options_requests(State* s, HTTPHdr* incoming_hdr)
     } else {
       // For OPTIONS request insert supported methods in ALLOW field
       DebugTxn("http_trans", "[handle_options] inserting methods in Allow.");
-      HttpTransactHeaders::insert_supported_methods_in_response(&s->hdr_info.client_response, s->scheme);
+      HttpTransactHeaders::insert_supported_methods_in_response(&s->hdr_info.client_response, s->scheme, &s->arena);
 
     }
     return true;
@@ -5445,7 +5607,8 @@ HttpTransact::initialize_state_variables_from_request(State* s, HTTPHdr* obsolet
   //
   MIMEField *pc = incoming_request->field_find(MIME_FIELD_PROXY_CONNECTION, MIME_LEN_PROXY_CONNECTION);
 
-  if (!s->txn_conf->keep_alive_enabled_in || (s->http_config_param->server_transparency_enabled && pc != NULL)) {
+  if (!s->txn_conf->keep_alive_enabled_in || http_proxy_server_draining ||
+      (s->http_config_param->server_transparency_enabled && pc != NULL)) {
     s->client_info.keep_alive = HTTP_NO_KEEPALIVE;
 
     // If we need to send a close header later,
@@ -5526,7 +5689,7 @@ HttpTransact::initialize_state_variables_from_request(State* s, HTTPHdr* obsolet
   if (s->client_info.transfer_encoding == CHUNKED_ENCODING) {
     s->hdr_info.request_content_length = HTTP_UNDEFINED_CL;
   }
-  s->request_data.hdr = &s->hdr_info.client_request;
+  s->request_data.set_hdr(&s->hdr_info.client_request, &s->arena);
   s->request_data.hostname_str = s->arena.str_store(host_name, host_len);
   ats_ip_copy(&s->request_data.src_ip, &s->client_info.addr);
   memset(&s->request_data.dest_ip, 0, sizeof(s->request_data.dest_ip));
@@ -7105,6 +7268,22 @@ HttpTransact::calculate_freshness_fuzz(State* s, int fresh_limit)
   return result;
 }
 
+// The stale-while-revalidate window of a cached response, 0 if it has none.
+static int
+stale_while_revalidate_window(HTTPHdr *response)
+{
+  MIMEField *field = response->field_find(MIME_FIELD_CACHE_CONTROL, MIME_LEN_CACHE_CONTROL);
+  HdrCsvIter csv;
+  const char *val;
+  int len;
+
+  for (val = field ? csv.get_first(field, &len) : NULL; val; val = csv.get_next(&len)) {
+    if (len > 23 && strncasecmp(val, "stale-while-revalidate=", 23) == 0)
+      return max(0, ink_atoi(val + 23, len - 23));
+  }
+  return 0;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //
 //
@@ -7131,6 +7310,8 @@ HttpTransact::what_is_document_freshness(State *s, HTTPHdr* client_request, HTTP
   uint32_t cc_mask, cooked_cc_mask;
   uint32_t os_specifies_revalidate;
 
+  s->cache_info.stale_while_revalidate = false;
+
   //////////////////////////////////////////////////////
   // If config file has a ttl-in-cache field set,     //
   // it has priority over any other http headers and  //
@@ -7294,6 +7475,14 @@ HttpTransact::what_is_document_freshness(State *s, HTTPHdr* client_request, HTTP
   ///////////////////////////////////////////
 
   if (do_revalidate || current_age > age_limit) { // client-modified limit
+    // nobody but the server asked for it to be fresh, it may be
+    // served stale while it is revalidated (RFC 5861)
+    if (!do_revalidate && !os_specifies_revalidate && age_limit == fresh_limit &&
+        s->http_config_param->cache_stale_while_revalidate &&
+        current_age <= (ink_time_t) fresh_limit + stale_while_revalidate_window(cached_obj_response)) {
+      DebugTxn("http_match", "[..._document_freshness] document is within its stale-while-revalidate window");
+      s->cache_info.stale_while_revalidate = true;
+    }
     DebugTxn("http_match", "[..._document_freshness] document needs revalidate/too old; "
             "returning FRESHNESS_STALE");
     return (FRESHNESS_STALE);
@@ -7970,6 +8159,8 @@ HttpTransact::build_error_response(State *s, HTTPStatus status_code, const char
                                                                 body_language, sizeof(body_language), 
                                                                 body_type, sizeof(body_type), 
                                                                 format, ap);
+  if (s->internal_msg_data)
+    s->internal_msg_buffer_fast_allocator_size = INTERNAL_MSG_BUFFER_SHARED;
 
   s->hdr_info.client_response.value_set(MIME_FIELD_CONTENT_TYPE, MIME_LEN_CONTENT_TYPE, body_type, strlen(body_type));
   s->hdr_info.client_response.value_set(MIME_FIELD_CONTENT_LANGUAGE, MIME_LEN_CONTENT_LANGUAGE, body_language,
@@ -8064,6 +8255,8 @@ HttpTransact::build_redirect_response(State* s)
                                                                          "The document you requested is now",
                                                                          new_url, new_url,
                                                                          "Please update your documents and bookmarks accordingly", NULL);
+  if (s->internal_msg_data)
+    s->internal_msg_buffer_fast_allocator_size = INTERNAL_MSG_BUFFER_SHARED;
 
 
   h->set_content_length(s->internal_msg_buffer_size);
@@ -8593,25 +8786,6 @@ HttpTransact::update_size_and_time_stats(State* s, ink_hrtime total_time, ink_hr
 }
 
 
-// void HttpTransact::add_new_stat_block(State* s)
-//
-//   Adds a new stat block
-//
-void
-HttpTransact::add_new_stat_block(State* s)
-{
-  // We keep the block around till the end of transaction
-  //    We don't need explicitly deallocate it later since
-  //    when the transaction is over, the arena will be destroyed
-  ink_assert(s->current_stats->next_insert == StatBlockEntries);
-  StatBlock *new_block = (StatBlock *) s->arena.alloc(sizeof(StatBlock));
-  new_block->init();
-  s->current_stats->next = new_block;
-  s->current_stats = new_block;
-  DebugTxn("http_trans", "Adding new large stat block");
-}
-
-
 void
 HttpTransact::delete_warning_value(HTTPHdr* to_warn, HTTPWarningCode warning_code)
 {
@@ -47,6 +47,8 @@
 
 #define MAX_DNS_LOOKUPS 2
 #define NUM_SECONDS_IN_ONE_YEAR (31536000)      // (365L * 24L * 3600L)
+// internal_msg_buffer_fast_allocator_size of a body shared between transactions
+#define INTERNAL_MSG_BUFFER_SHARED (-2)
 
 #define HTTP_RELEASE_ASSERT(X) ink_release_assert(X)
 // #define ink_cluster_time(X) time(X)
@@ -524,12 +526,6 @@ public:
     VARIABILITY_ALL
   };
 
-  struct StatRecord_t
-  {
-    uint16_t index;
-    int64_t increment;
-  };
-
   enum CacheLookupResult_t
   {
     CACHE_LOOKUP_NONE,
@@ -578,27 +574,6 @@ public:
     CACHE_AUTH_SERVE
   };
 
-#define StatBlockEntries 28
-
-  struct StatBlock
-  {
-    StatBlock()
-    {
-      init();
-      memset(&stats, 0, sizeof(stats));
-    };
-
-    void init()
-    {
-      next = NULL;
-      next_insert = 0;
-    };
-
-    StatRecord_t stats[StatBlockEntries];
-    StatBlock *next;
-    uint16_t next_insert;
-  };
-
   struct State;
   typedef void (*TransactFunc_t) (HttpTransact::State *);
 
@@ -643,6 +618,7 @@ public:
     CacheWriteLock_t write_lock_state;
     int lookup_count;
     bool is_ram_cache_hit;
+    bool stale_while_revalidate;  // stale, but within its stale-while-revalidate window
 
     _CacheLookupInfo()
       : action(CACHE_DO_UNDEFINED),
@@ -662,7 +638,8 @@ public:
         open_write_retries(0),
       write_lock_state(CACHE_WL_INIT),
       lookup_count(0),
-      is_ram_cache_hit(false)
+      is_ram_cache_hit(false),
+      stale_while_revalidate(false)
     { }
   } CacheLookupInfo;
 
@@ -800,6 +777,7 @@ public:
     HTTPHdr server_response;
     HTTPHdr transform_response;
     HTTPHdr cache_response;
+    HTTPCookieMap client_request_cookies;
    int64_t request_content_length;
     int64_t response_content_length;
     int64_t transform_request_cl;
@@ -899,6 +877,7 @@ public:
     int64_t internal_msg_buffer_size;       // out
     int64_t internal_msg_buffer_fast_allocator_size;
     int64_t internal_msg_buffer_index;      // out
+    Ptr<IOBufferData> internal_msg_data;        // holds internal_msg_buffer when it is shared
 
     bool icp_lookup_success;    // in
     struct sockaddr_in icp_ip_result;   // in
@@ -921,11 +900,14 @@ public:
 
     //HttpAuthParams auth_params;
 
-    StatBlock first_stats;
-    StatBlock *current_stats;
-
     // for negative caching
     bool negative_caching;
+    // the negative response goes to the in memory negative cache, for
+    // negative_cache_ttl seconds. On a negative cache hit, the status
+    // served and the age of the entry in negative_cache_ttl.
+    bool negative_cache_store;
+    int negative_cache_ttl;
+    HTTPStatus negative_cache_status;
     // for srv_lookup
     bool srv_lookup;
     // for authenticated content caching
@@ -998,9 +980,11 @@ public:
     int64_t num_range_fields;
     int64_t range_output_cl;
     RangeRecord *ranges;
+    bool range_pread;           // the cache read returns only the bytes of the ranges
     
     OverridableHttpConfigParams *txn_conf;
     OverridableHttpConfigParams my_txn_conf; // Storage for plugins, to avoid malloc
+    Ptr<OverridableHttpConfigSnapshot> txn_conf_snapshot; // Shared overrides txn_conf may point into
 
     bool transparent_passthrough;
     
@@ -1009,7 +993,6 @@ public:
     init()
     {
       parent_params = ParentConfig::acquire();
-      current_stats = &first_stats;
     }
 
     // Constructor
@@ -1048,9 +1031,10 @@ public:
         response_received_time(UNDEFINED_TIME),
         plugin_set_expire_time(UNDEFINED_TIME),
         state_machine_id(0),
-        first_stats(),
-        current_stats(NULL),
         negative_caching(false),
+        negative_cache_store(false),
+        negative_cache_ttl(0),
+        negative_cache_status(HTTP_STATUS_NONE),
         srv_lookup(false),
         www_auth_content(CACHE_AUTH_NONE),
         client_connection_enabled(true),
@@ -1095,6 +1079,7 @@ public:
         num_range_fields(0),
         range_output_cl(0),
         ranges(NULL),
+        range_pread(false),
         txn_conf(NULL),
         transparent_passthrough(false)
     {
@@ -1125,30 +1110,9 @@ public:
       memset(&host_db_info, 0, sizeof(host_db_info));
     }
 
-    void
-    record_transaction_stats()
-    {
-      if (http_config_param->enable_http_stats) {
-        // Loop over our transaction stat blocks and record the stats
-        //  in the global arrays
-        STAT_LOCK_ACQUIRE(&(global_http_trans_stat_lock));
-        StatBlock *b = &first_stats;
-
-        while (b != NULL) {
-          for (int i = 0; i < b->next_insert && i < StatBlockEntries; i++) {
-            RecIncrRawStat(http_rsb, this_ethread(), b->stats[i].index, b->stats[i].increment);
-
-          }
-          b = b->next;
-        }
-        STAT_LOCK_RELEASE(&(global_http_trans_stat_lock));
-      }
-    }
-
     void
     destroy()
     {
-      record_transaction_stats();
       m_magic = HTTP_TRANSACT_MAGIC_DEAD;
 
       if (internal_msg_buffer) {
@@ -1156,9 +1120,11 @@ public:
       }
       if (internal_msg_buffer_type)
         ats_free(internal_msg_buffer_type);
+      internal_msg_data = NULL;
 
       ParentConfig::release(parent_params);
       parent_params = NULL;
+      txn_conf_snapshot = NULL;
 
       hdr_info.client_request.destroy();
       hdr_info.client_response.destroy();
@@ -1188,6 +1154,7 @@ public:
       delete[] ranges;
       ranges = NULL;
       range_setup = RANGE_NONE;
+      range_pread = false;
       return;
     }
 
@@ -1196,8 +1163,8 @@ public:
     setup_per_txn_configs()
     {
       if (txn_conf != &my_txn_conf) {
-        // Make sure we copy it first.
-        memcpy(&my_txn_conf, &http_config_param->oride, sizeof(my_txn_conf));
+        // Make sure we copy it first, including any shared overrides.
+        memcpy(&my_txn_conf, txn_conf, sizeof(my_txn_conf));
         txn_conf = &my_txn_conf;
       }
     }
@@ -1220,6 +1187,7 @@ public:
   static void StartAuth(State* s);
   static void HandleRequestAuthorized(State* s);
   static void BadRequest(State* s);
+  static void PostBufferFailed(State* s);
   static void HandleFiltering(State* s);
   static void DecideCacheLookup(State* s);
   static void LookupSkipOpenServer(State* s);
@@ -1235,6 +1203,7 @@ public:
   static void HandleCacheOpenReadHitFreshness(State* s);
   static void HandleCacheOpenReadHit(State* s);
   static void HandleCacheOpenReadMiss(State* s);
+  static void HandleNegativeCacheHit(State* s);
   static void build_response_from_cache(State* s, HTTPWarningCode warning_code);
   static void handle_cache_write_lock(State* s);
   static void HandleICPLookup(State* s);
@@ -1350,7 +1319,6 @@ public:
   static void user_agent_connection_speed(State* s, ink_hrtime transfer_time, int64_t nbytes);
   static void origin_server_connection_speed(State* s, ink_hrtime transfer_time, int64_t nbytes);
   static void client_result_stat(State* s, ink_hrtime total_time, ink_hrtime request_process_time);
-  static void add_new_stat_block(State* s);
   static void delete_warning_value(HTTPHdr* to_warn, HTTPWarningCode warning_code);
   static bool is_connection_collapse_checks_success(State* s); //YTS Team, yamsat
 };
@@ -1361,7 +1329,10 @@ inline void
 HttpTransact::free_internal_msg_buffer(char *buffer, int64_t size)
 {
   ink_assert(buffer);
-  if (size >= 0) {
+  if (size == INTERNAL_MSG_BUFFER_SHARED) {
+    // owned by State::internal_msg_data
+    return;
+  } else if (size >= 0) {
     ioBufAllocator[size].free_void(buffer);
   } else {
     ats_free(buffer);
@@ -1421,22 +1392,18 @@ is_response_body_precluded(HTTPStatus status_code, int method)
   }
 }
 
+HTTPKeepAlive is_header_keep_alive(const HTTPVersion & http_version, const HTTPVersion & request_http_version,
+                                   MIMEField * con_hdr);
+
 inkcoreapi extern ink_time_t ink_cluster_time(void);
 
 inline void
 HttpTransact::update_stat(State* s, int stat, ink_statval_t increment)
 {
-  if (s->current_stats->next_insert >= StatBlockEntries) {
-    // This a rare operation and we want to avoid the
-    //   code bloat of inlining it everywhere so
-    //   it's a function call
-    add_new_stat_block(s);
-  }
-
-  uint16_t *next_insert = &s->current_stats->next_insert;
-  s->current_stats->stats[*next_insert].index = stat;
-  s->current_stats->stats[*next_insert].increment = increment;
-  (*next_insert)++;
+  // Raw stats are per thread, so there is nothing to gain from saving them up
+  // for the end of the transaction.
+  if (s->http_config_param->enable_http_stats)
+    RecIncrRawStat(http_rsb, this_ethread(), stat, increment);
 }
 
 #endif
@@ -29,6 +29,7 @@
 #include "time.h"
 #include "HTTP.h"
 #include "HttpCompat.h"
+#include "HdrUtils.h"
 #include "Error.h"
 #include "InkErrno.h"
 
@@ -36,6 +37,14 @@ ClassAllocator<CacheLookupHttpConfig> CacheLookupHttpConfigAllocator("CacheLooku
 
 CacheLookupHttpConfig global_cache_lookup_config;
 
+HttpNegotiationFields::HttpNegotiationFields(HTTPHdr * client_request)
+  : accept(client_request->field_find(MIME_FIELD_ACCEPT, MIME_LEN_ACCEPT)),
+    accept_charset(client_request->field_find(MIME_FIELD_ACCEPT_CHARSET, MIME_LEN_ACCEPT_CHARSET)),
+    accept_encoding(client_request->field_find(MIME_FIELD_ACCEPT_ENCODING, MIME_LEN_ACCEPT_ENCODING)),
+    accept_language(client_request->field_find(MIME_FIELD_ACCEPT_LANGUAGE, MIME_LEN_ACCEPT_LANGUAGE))
+{
+}
+
 /**
   Find the pointer and length of an etag, after stripping off any leading
   "W/" prefix, and surrounding double quotes.
@@ -200,17 +209,39 @@ HttpTransactCache::SelectFromAlternates(CacheHTTPInfoVector * cache_vector,
     return 0;
   }
 
+  // Look up the request's Accept* fields once, and match them once per
+  //  distinct signature of the alternates rather than once per alternate
+  HttpNegotiationFields negotiation(client_request);
+  uint64_t *sigs = (uint64_t *) alloca(alt_count * sizeof(uint64_t));
+  float *sig_Q = (float *) alloca(alt_count * sizeof(float));
+
   for (int i = 0; i < alt_count; i++) {
     float Q;
     CacheHTTPInfo *obj = cache_vector->get(i);
     HTTPHdr *cached_request = obj->request_get();
     HTTPHdr *cached_response = obj->response_get();
 
+    sig_Q[i] = NEGOTIATION_Q_UNKNOWN;
     if (!(obj->object_key_get() == zero_key)) {
       ink_assert(cached_request->valid());
       ink_assert(cached_response->valid());
 
-      Q = calculate_quality_of_match(http_config_params, client_request, cached_request, cached_response);
+      if (is_exempt_from_negotiation(client_request, cached_response)) {
+        Q = 1.0;
+      } else {
+        sigs[i] = calculate_negotiation_signature(cached_request, cached_response);
+        for (int j = 0; j < i; j++) {
+          if (sig_Q[j] != NEGOTIATION_Q_UNKNOWN && sigs[j] == sigs[i]) {
+            Debug("http_match", "[SelectFromAlternates] alternate #%d negotiates like #%d", i + 1, j + 1);
+            sig_Q[i] = sig_Q[j];
+            break;
+          }
+        }
+        if (sig_Q[i] == NEGOTIATION_Q_UNKNOWN) {
+          sig_Q[i] = calculate_quality_of_negotiation(http_config_params, &negotiation, cached_request, cached_response);
+        }
+        Q = finish_quality_of_match(http_config_params, client_request, cached_request, cached_response, sig_Q[i]);
+      }
 
       if (alt_count > 1) {
         if (t_now == 0)
@@ -302,26 +333,94 @@ HttpTransactCache::calculate_quality_of_match(CacheLookupHttpConfig * http_confi
                                               HTTPHdr * obj_origin_server_response      // in
   )
 {
-  float q[4], Q;
-  MIMEField *accept_field;
-  MIMEField *cached_accept_field;
-  MIMEField *content_field;
+  if (is_exempt_from_negotiation(client_request, obj_origin_server_response))
+    return (float)1.0;
+
+  HttpNegotiationFields negotiation(client_request);
+  float Q = calculate_quality_of_negotiation(http_config_param, &negotiation, obj_client_request, obj_origin_server_response);
+
+  return finish_quality_of_match(http_config_param, client_request, obj_client_request, obj_origin_server_response, Q);
+}
 
+bool
+HttpTransactCache::is_exempt_from_negotiation(HTTPHdr * client_request, HTTPHdr * obj_origin_server_response)
+{
   // For PURGE requests, any alternate is good really.
   if (client_request->method_get_wksidx() == HTTP_WKSIDX_PURGE)
-    return (float)1.0;
+    return true;
 
   // BZ49848 - for cached negative respones, we don't check for the
   // Accept* headers. This should also be good for the 301 response.
   if (obj_origin_server_response->status_get() != HTTP_STATUS_OK)
-    return (float)1.0;
+    return true;
+
+  return false;
+}
+
+// Fold one field's value, or its absence, into a FNV-1a signature.
+static inline uint64_t
+negotiation_signature_add(uint64_t sig, HTTPHdr * hdr, const char *name, int name_len)
+{
+  MIMEField *field = hdr->field_find(name, name_len);
+  const char *value = NULL;
+  int value_len = -1;           // tells an absent field from an empty one
+
+  if (field)
+    value = field->value_get(&value_len);
+
+  for (int i = 0; i < (int) sizeof(value_len); i++)
+    sig = (sig ^ ((value_len >> (8 * i)) & 0xff)) * 0x100000001b3ULL;
+  for (int i = 0; i < value_len; i++)
+    sig = (sig ^ (unsigned char) value[i]) * 0x100000001b3ULL;
+
+  return sig;
+}
+
+/**
+  Combine the values of the alternate's fields that content negotiation
+  looks at into one signature. Alternates with equal signatures match
+  any given request equally well, so the Accept* headers only need to be
+  matched once for all of them.
+
+*/
+uint64_t
+HttpTransactCache::calculate_negotiation_signature(HTTPHdr * obj_client_request, HTTPHdr * obj_origin_server_response)
+{
+  uint64_t sig = 0xcbf29ce484222325ULL;
+
+  sig = negotiation_signature_add(sig, obj_origin_server_response, MIME_FIELD_CONTENT_TYPE, MIME_LEN_CONTENT_TYPE);
+  sig = negotiation_signature_add(sig, obj_origin_server_response, MIME_FIELD_CONTENT_ENCODING, MIME_LEN_CONTENT_ENCODING);
+  sig = negotiation_signature_add(sig, obj_origin_server_response, MIME_FIELD_CONTENT_LANGUAGE, MIME_LEN_CONTENT_LANGUAGE);
+  sig = negotiation_signature_add(sig, obj_client_request, MIME_FIELD_ACCEPT_CHARSET, MIME_LEN_ACCEPT_CHARSET);
+  sig = negotiation_signature_add(sig, obj_client_request, MIME_FIELD_ACCEPT_ENCODING, MIME_LEN_ACCEPT_ENCODING);
+  sig = negotiation_signature_add(sig, obj_client_request, MIME_FIELD_ACCEPT_LANGUAGE, MIME_LEN_ACCEPT_LANGUAGE);
+
+  return sig;
+}
+
+/**
+  Quality of the Accept* match of the client request against one
+  alternate, -1 if some match failed.
+
+*/
+float
+HttpTransactCache::calculate_quality_of_negotiation(CacheLookupHttpConfig * http_config_param,  // in
+                                                    HttpNegotiationFields * negotiation,        // in
+                                                    HTTPHdr * obj_client_request,       // in
+                                                    HTTPHdr * obj_origin_server_response        // in
+  )
+{
+  float q[4], Q;
+  MIMEField *accept_field;
+  MIMEField *cached_accept_field;
+  MIMEField *content_field;
 
   q[1] = (q[2] = (q[3] = -2.0));        /* just to make debug output happy :) */
 
   // Accept //
   // A NULL Accept or a NULL Content-Type field are perfect matches.
   content_field = obj_origin_server_response->field_find(MIME_FIELD_CONTENT_TYPE, MIME_LEN_CONTENT_TYPE);
-  accept_field = client_request->field_find(MIME_FIELD_ACCEPT, MIME_LEN_ACCEPT);
+  accept_field = negotiation->accept;
   q[0] = (content_field != 0 && accept_field != 0 && !http_config_param->ignore_accept_mismatch) ?
     calculate_quality_of_accept_match(accept_field, content_field) : 1.0;
 
@@ -330,7 +429,7 @@ HttpTransactCache::calculate_quality_of_match(CacheLookupHttpConfig * http_confi
     if (http_config_param->ignore_accept_charset_mismatch) {    //Bug 2393700 /ebalsa
       q[1] = 1.0;
     } else {
-      accept_field = client_request->field_find(MIME_FIELD_ACCEPT_CHARSET, MIME_LEN_ACCEPT_CHARSET);
+      accept_field = negotiation->accept_charset;
       cached_accept_field = obj_client_request->field_find(MIME_FIELD_ACCEPT_CHARSET, MIME_LEN_ACCEPT_CHARSET);
       // content_field lookup is same as above
       // content_field = obj_origin_server_response->field_find(MIME_FIELD_CONTENT_TYPE, MIME_LEN_CONTENT_TYPE);
@@ -349,7 +448,7 @@ HttpTransactCache::calculate_quality_of_match(CacheLookupHttpConfig * http_confi
       if (http_config_param->ignore_accept_encoding_mismatch) { //Bug 2393700 /ebalsa
         q[2] = 1.0;
       } else {
-        accept_field = client_request->field_find(MIME_FIELD_ACCEPT_ENCODING, MIME_LEN_ACCEPT_ENCODING);
+        accept_field = negotiation->accept_encoding;
         content_field = obj_origin_server_response->field_find(MIME_FIELD_CONTENT_ENCODING, MIME_LEN_CONTENT_ENCODING);
         cached_accept_field = obj_client_request->field_find(MIME_FIELD_ACCEPT_ENCODING, MIME_LEN_ACCEPT_ENCODING);
 
@@ -367,7 +466,7 @@ HttpTransactCache::calculate_quality_of_match(CacheLookupHttpConfig * http_confi
         if (http_config_param->ignore_accept_language_mismatch) {       //Bug 2393700 /ebalsa
           q[3] = 1.0;
         } else {
-          accept_field = client_request->field_find(MIME_FIELD_ACCEPT_LANGUAGE, MIME_LEN_ACCEPT_LANGUAGE);
+          accept_field = negotiation->accept_language;
           content_field =
             obj_origin_server_response->field_find(MIME_FIELD_CONTENT_LANGUAGE, MIME_LEN_CONTENT_LANGUAGE);
           cached_accept_field = obj_client_request->field_find(MIME_FIELD_ACCEPT_LANGUAGE, MIME_LEN_ACCEPT_LANGUAGE);
@@ -406,6 +505,21 @@ HttpTransactCache::calculate_quality_of_match(CacheLookupHttpConfig * http_confi
   Debug("http_alternate", "Mult's Quality Factor: %f", Q);
   Debug("http_alternate", "----------End of Alternate----------");
 
+  return (Q);
+}
+
+/**
+  Apply the SELECT_ALT hooks and the Vary headers to the quality of the
+  Accept* match of an alternate.
+
+*/
+float
+HttpTransactCache::finish_quality_of_match(CacheLookupHttpConfig * http_config_param,   // in
+                                           HTTPHdr * client_request,    // in
+                                           HTTPHdr * obj_client_request,        // in
+                                           HTTPHdr * obj_origin_server_response,        // in
+                                           float Q)
+{
   int force_alt = 0;
 
   if (Q > 0.0) {
@@ -1558,3 +1672,153 @@ CacheLookupHttpConfig::unmarshal(Arena * arena, const char *buf, int buflen)
 
   return (p - buf);
 }
+
+/*---------------------------------------------------------------
+  Invalidation index.  Invalidating a URL prefix or a tag only records
+  the time against it; a cached object received no later than that
+  is treated as a miss when it is looked up, however many there are.
+  Keys are "u:<host>/<path prefix>" and "t:<tag>".
+  --------------------------------------------------------------*/
+
+#define INVALIDATE_KEY_MAX 2048
+
+struct HttpCacheInvalidateIndex
+{
+  InkHashTable *table;
+  ink_mutex mutex;
+  volatile int count;
+
+  HttpCacheInvalidateIndex() : table(ink_hash_table_create(InkHashTableKeyType_String)), count(0)
+  {
+    ink_mutex_init(&mutex, "HttpCacheInvalidateIndex");
+  }
+
+  void add(const char *key, time_t when)
+  {
+    InkHashTableValue v;
+    ink_mutex_acquire(&mutex);
+    if (!ink_hash_table_lookup(table, key, &v)) {
+      ink_hash_table_insert(table, key, (InkHashTableValue) (intptr_t) when);
+      ink_atomic_increment(&count, 1);
+    } else if ((time_t) (intptr_t) v < when)
+      ink_hash_table_insert(table, key, (InkHashTableValue) (intptr_t) when);
+    ink_mutex_release(&mutex);
+  }
+
+  // call with the mutex held
+  time_t lookup(const char *key)
+  {
+    InkHashTableValue v;
+    return ink_hash_table_lookup(table, key, &v) ? (time_t) (intptr_t) v : 0;
+  }
+};
+
+static HttpCacheInvalidateIndex invalidate_index;
+
+static int
+invalidate_url_key(char *key, const char *host, int host_len)
+{
+  if (host_len + 3 >= INVALIDATE_KEY_MAX)
+    return -1;
+  key[0] = 'u';
+  key[1] = ':';
+  for (int i = 0; i < host_len; i++)
+    key[i + 2] = ParseRules::ink_tolower(host[i]);
+  key[host_len + 2] = '/';
+  return host_len + 3;
+}
+
+void
+HttpTransactCache::invalidate_prefix(const char *host, int host_len, const char *prefix, int prefix_len, time_t when)
+{
+  char key[INVALIDATE_KEY_MAX];
+  int n = invalidate_url_key(key, host, host_len);
+
+  // URL paths are stored without the leading '/'
+  if (prefix_len > 0 && prefix[0] == '/') {
+    prefix++;
+    prefix_len--;
+  }
+  if (n < 0 || n + prefix_len >= INVALIDATE_KEY_MAX)
+    return;
+  memcpy(key + n, prefix, prefix_len);
+  key[n + prefix_len] = 0;
+  Debug("http_match", "[invalidate_prefix] %s at %" PRId64, key, (int64_t) when);
+  invalidate_index.add(key, when);
+}
+
+void
+HttpTransactCache::invalidate_tag(const char *tag, int tag_len, time_t when)
+{
+  char key[INVALIDATE_KEY_MAX];
+
+  if (tag_len + 2 >= INVALIDATE_KEY_MAX)
+    return;
+  key[0] = 't';
+  key[1] = ':';
+  memcpy(key + 2, tag, tag_len);
+  key[tag_len + 2] = 0;
+  Debug("http_match", "[invalidate_tag] %s at %" PRId64, key, (int64_t) when);
+  invalidate_index.add(key, when);
+}
+
+/*---------------------------------------------------------------
+  is_invalidated
+
+  True if the object was received no later than an invalidation of
+  its host, of a directory above it, of its exact path or of one of
+  the tags in its tag_header.
+  --------------------------------------------------------------*/
+
+bool
+HttpTransactCache::is_invalidated(HTTPHdr * obj_client_request, HTTPHdr * obj_origin_server_response,
+                                  time_t response_received_time, const char *tag_header)
+{
+  if (!invalidate_index.count)
+    return false;
+
+  char key[INVALIDATE_KEY_MAX];
+  int host_len = 0, path_len = 0;
+  const char *host = obj_client_request->host_get(&host_len);
+  const char *path = obj_client_request->url_get()->path_get(&path_len);
+  MIMEField *tags = NULL;
+  time_t when = 0;
+
+  if (tag_header && *tag_header)
+    tags = obj_origin_server_response->field_find(tag_header, strlen(tag_header));
+
+  ink_mutex_acquire(&invalidate_index.mutex);
+  int n = host ? invalidate_url_key(key, host, host_len) : -1;
+  if (n >= 0) {
+    for (int i = 0; i <= path_len && n + i < INVALIDATE_KEY_MAX; i++) {
+      if (i == 0 || i == path_len || path[i - 1] == '/') {
+        key[n + i] = 0;
+        when = max(when, invalidate_index.lookup(key));
+      }
+      if (i < path_len)
+        key[n + i] = path[i];
+    }
+  }
+  if (tags) {
+    HdrCsvIter iter;
+    int tag_len;
+    const char *tag = iter.get_first(tags, &tag_len);
+    for (; tag; tag = iter.get_next(&tag_len)) {
+      if (tag_len + 2 >= INVALIDATE_KEY_MAX)
+        continue;
+      key[0] = 't';
+      key[1] = ':';
+      memcpy(key + 2, tag, tag_len);
+      key[tag_len + 2] = 0;
+      when = max(when, invalidate_index.lookup(key));
+    }
+  }
+  ink_mutex_release(&invalidate_index.mutex);
+
+  if (when && response_received_time <= when) {
+    Debug("http_match", "[is_invalidated] received %" PRId64 ", invalidated %" PRId64,
+          (int64_t) response_received_time, (int64_t) when);
+    return true;
+  }
+  return false;
+}
@@ -97,6 +97,21 @@ enum ContentEncoding
 };
 
 
+// The client request's content negotiation fields, looked up once
+//  for all the alternates they are matched against
+struct HttpNegotiationFields
+{
+  HttpNegotiationFields(HTTPHdr * client_request);
+
+  MIMEField *accept;
+  MIMEField *accept_charset;
+  MIMEField *accept_encoding;
+  MIMEField *accept_language;
+};
+
+#define NEGOTIATION_Q_UNKNOWN -2.0f
+
+
 class HttpTransactCache
 {
 public:
@@ -112,6 +127,20 @@ public:
                                           HTTPHdr * obj_client_request, // in
                                           HTTPHdr * obj_origin_server_response);        // in
 
+  static bool is_exempt_from_negotiation(HTTPHdr * client_request, HTTPHdr * obj_origin_server_response);
+
+  static uint64_t calculate_negotiation_signature(HTTPHdr * obj_client_request, HTTPHdr * obj_origin_server_response);
+
+  static float calculate_quality_of_negotiation(CacheLookupHttpConfig * http_config_params,
+                                                HttpNegotiationFields * negotiation,    // in
+                                                HTTPHdr * obj_client_request,   // in
+                                                HTTPHdr * obj_origin_server_response);  // in
+
+  static float finish_quality_of_match(CacheLookupHttpConfig * http_config_params, HTTPHdr * client_request,    // in
+                                       HTTPHdr * obj_client_request,    // in
+                                       HTTPHdr * obj_origin_server_response,    // in
+                                       float Q);
+
   static float calculate_quality_of_accept_match(MIMEField * accept_field, MIMEField * content_field);
 
   static float calculate_quality_of_accept_charset_match(MIMEField * accept_field,
@@ -138,6 +167,15 @@ public:
 
   static HTTPStatus match_response_to_request_conditionals(HTTPHdr * ua_request, HTTPHdr * c_response);
 
+  //////////////////////////
+  // invalidation index   //
+  //////////////////////////
+
+  static void invalidate_prefix(const char *host, int host_len, const char *prefix, int prefix_len, time_t when);
+  static void invalidate_tag(const char *tag, int tag_len, time_t when);
+  static bool is_invalidated(HTTPHdr * obj_client_request, HTTPHdr * obj_origin_server_response,
+                             time_t response_received_time, const char *tag_header);
+
 };
 
 #endif
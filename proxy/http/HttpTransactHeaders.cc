@@ -76,7 +76,7 @@ HttpTransactHeaders::is_this_method_supported(int the_scheme, int the_method)
 
 
 void
-HttpTransactHeaders::insert_supported_methods_in_response(HTTPHdr *response, int scheme)
+HttpTransactHeaders::insert_supported_methods_in_response(HTTPHdr *response, int scheme, Arena *arena)
 {
   int method_output_lengths[32];
   const char *methods[] = {
@@ -93,7 +93,7 @@ HttpTransactHeaders::insert_supported_methods_in_response(HTTPHdr *response, int
     HTTP_METHOD_TRACE,
   };
   char inline_buffer[64];
-  char *alloced_buffer, *value_buffer;
+  char *value_buffer;
 
   int nmethods = sizeof(methods) / sizeof(methods[0]);
   ink_assert(nmethods <= 32);
@@ -128,13 +128,11 @@ HttpTransactHeaders::insert_supported_methods_in_response(HTTPHdr *response, int
     field = response->field_create(MIME_FIELD_ALLOW, MIME_LEN_ALLOW);
     response->field_attach(field);
   }
-  // step 3: get a big enough buffer
+  // step 3: get a big enough buffer, from the transaction's arena if need be
   if (bytes <= sizeof(inline_buffer)) {
-    alloced_buffer = NULL;
     value_buffer = inline_buffer;
   } else {
-    alloced_buffer = (char *)ats_malloc(bytes);
-    value_buffer = alloced_buffer;
+    value_buffer = (char *) arena->alloc(bytes, 1);
   }
 
   // step 4: build the value
@@ -155,9 +153,6 @@ HttpTransactHeaders::insert_supported_methods_in_response(HTTPHdr *response, int
 
   // step 5: attach new allow list to end of previous list
   field->value_append(response->m_heap, response->m_mime, value_buffer, bytes);
-
-  // step 6: free up temp storage
-  ats_free(alloced_buffer);
 }
 
 
@@ -183,9 +178,11 @@ HttpTransactHeaders::build_base_response(HTTPHdr *outgoing_response,
 // Copy all non hop-by-hop header fields from src_hdr to new_hdr.
 // If header Date: is not present or invalid in src_hdr,
 // then the given date will be used.
+// If move_src is set, src_hdr is not needed anymore: new_hdr takes
+// over its heap instead of copying it and src_hdr is left invalid.
 void
 HttpTransactHeaders::copy_header_fields(HTTPHdr *src_hdr,
-                                        HTTPHdr *new_hdr, bool retain_proxy_auth_hdrs, ink_time_t date)
+                                        HTTPHdr *new_hdr, bool retain_proxy_auth_hdrs, ink_time_t date, bool move_src)
 {
   ink_assert(src_hdr->valid());
   ink_assert(!new_hdr->valid());
@@ -195,7 +192,10 @@ HttpTransactHeaders::copy_header_fields(HTTPHdr *src_hdr,
   bool date_hdr = false;
 
   // Start with an exact duplicate
-  new_hdr->copy(src_hdr);
+  if (move_src)
+    new_hdr->move(src_hdr);
+  else
+    new_hdr->copy(src_hdr);
 
   // Nuke hop-by-hop headers
   //
@@ -37,13 +37,13 @@ public:
   static bool is_this_a_hop_by_hop_header(const char *field_name_wks);
   static bool is_this_method_supported(int the_scheme, int the_method);
 
-  static void insert_supported_methods_in_response(HTTPHdr * response, int the_scheme);
+  static void insert_supported_methods_in_response(HTTPHdr * response, int the_scheme, Arena * arena);
 
   static void build_base_response(HTTPHdr * outgoing_response, HTTPStatus status,
                                   const char *reason_phrase, int reason_phrase_len, ink_time_t date);
 
   static void copy_header_fields(HTTPHdr * src_hdr, HTTPHdr * new_hdr,
-                                 bool retain_proxy_auth_hdrs, ink_time_t date = 0);
+                                 bool retain_proxy_auth_hdrs, ink_time_t date = 0, bool move_src = false);
 
   static void convert_request(HTTPVersion outgoing_ver, HTTPHdr * outgoing_request);
   static void convert_response(HTTPVersion outgoing_ver, HTTPHdr * outgoing_response);
@@ -100,62 +100,64 @@ ChunkedHandler::set_max_chunk_size(int64_t size)
   max_chunk_header_len = snprintf(max_chunk_header, sizeof(max_chunk_header), CHUNK_HEADER_FMT, max_chunk_size);
 }
 
+// The size line is scanned a run at a time rather than a byte at a time:
+// the hex digits through the ParseRules table, and the rest of the line
+// (chunk extensions and the CRLF) with memchr() for the LF.
 void
 ChunkedHandler::read_size()
 {
-  int64_t bytes_used;
   bool done = false;
 
   while (chunked_reader->read_avail() > 0 && !done) {
-    const char *tmp = chunked_reader->start();
-    int64_t data_size = chunked_reader->block_read_avail();
+    const char *start = chunked_reader->start();
+    const char *tmp = start;
+    const char *end = start + chunked_reader->block_read_avail();
 
-    ink_assert(data_size > 0);
-    bytes_used = 0;
+    ink_assert(end > start);
 
-    while (data_size > 0) {
-      bytes_used++;
+    while (tmp < end) {
       if (state == CHUNK_READ_SIZE) {
         // The http spec says the chunked size is always in hex
-        if (ParseRules::is_hex(*tmp)) {
+        while (tmp < end && ParseRules::is_hex(*tmp)) {
           num_digits++;
-          running_sum *= 16;
+          running_sum = running_sum * 16 + ink_get_hex(*tmp);
+          tmp++;
+        }
+        if (tmp == end)
+          break;
 
-          if (ParseRules::is_digit(*tmp)) {
-            running_sum += *tmp - '0';
-          } else {
-            running_sum += ParseRules::ink_tolower(*tmp) - 'a' + 10;
-          }
-        } else {
-          // We are done parsing size
-          if (num_digits == 0 || running_sum < 0) {
-            // Bogus chunk size
-            state = CHUNK_READ_ERROR;
-            done = true;
-            break;
-          } else {
-            state = CHUNK_READ_SIZE_CRLF;       // now look for CRLF
-          }
+        // We are done parsing size
+        tmp++;
+        if (num_digits == 0 || running_sum < 0) {
+          // Bogus chunk size
+          state = CHUNK_READ_ERROR;
+          done = true;
+          break;
+        }
+        state = CHUNK_READ_SIZE_CRLF;   // now look for CRLF
+      } else {
+        // CHUNK_READ_SIZE_CRLF or CHUNK_READ_SIZE_START, scan for a linefeed
+        const char *lf = static_cast<const char *>(memchr(tmp, '\n', end - tmp));
+
+        if (lf == NULL) {
+          tmp = end;
+          break;
         }
-      } else if (state == CHUNK_READ_SIZE_CRLF) {       // Scan for a linefeed
-        if (ParseRules::is_lf(*tmp)) {
+        tmp = lf + 1;
+
+        if (state == CHUNK_READ_SIZE_CRLF) {
           Debug("http_chunk", "read chunk size of %d bytes", running_sum);
           bytes_left = (cur_chunk_size = running_sum);
           state = (running_sum == 0) ? CHUNK_READ_TRAILER_BLANK : CHUNK_READ_CHUNK;
           done = true;
           break;
         }
-      } else if (state == CHUNK_READ_SIZE_START) {
-        if (ParseRules::is_lf(*tmp)) {
-          running_sum = 0;
-          num_digits = 0;
-          state = CHUNK_READ_SIZE;
-        }
+        running_sum = 0;
+        num_digits = 0;
+        state = CHUNK_READ_SIZE;
       }
-      tmp++;
-      data_size--;
     }
-    chunked_reader->consume(bytes_used);
+    chunked_reader->consume(tmp - start);
   }
 }
 
@@ -225,16 +227,25 @@ ChunkedHandler::read_chunk()
 void
 ChunkedHandler::read_trailer()
 {
-  int64_t bytes_used;
   bool done = false;
 
   while (chunked_reader->is_read_avail_more_than(0) && !done) {
-    const char *tmp = chunked_reader->start();
-    int64_t data_size = chunked_reader->block_read_avail();
-
-    ink_assert(data_size > 0);
-    for (bytes_used = 0; data_size > 0; data_size--) {
-      bytes_used++;
+    const char *start = chunked_reader->start();
+    const char *tmp = start;
+    const char *end = start + chunked_reader->block_read_avail();
+
+    ink_assert(end > start);
+    while (tmp < end) {
+      if (state == CHUNK_READ_TRAILER_LINE) {
+        // Nothing but a CR or LF changes the state, skip to the next one
+        const char *eol = ink_memchr2(tmp, '\r', '\n', end - tmp);
+
+        if (eol == NULL) {
+          tmp = end;
+          break;
+        }
+        tmp = eol;
+      }
 
       if (ParseRules::is_cr(*tmp)) {
         // For a CR to signal we are almost done, the preceding
@@ -249,6 +260,7 @@ ChunkedHandler::read_trailer()
           state = CHUNK_READ_DONE;
           Debug("http_chunk", "completed read of trailers");
           done = true;
+          tmp++;
           break;
         } else {
           // A LF that does not terminate the trailer
@@ -262,7 +274,7 @@ ChunkedHandler::read_trailer()
       }
       tmp++;
     }
-    chunked_reader->consume(bytes_used);
+    chunked_reader->consume(tmp - start);
   }
 }
 
@@ -295,8 +307,10 @@ bool ChunkedHandler::process_chunked_content()
 
 bool ChunkedHandler::generate_chunked_content()
 {
-  char tmp[16];
+  // The CRLF that ends a chunk, the header of the next one
+  char tmp[2 + 16];
   bool server_done = false;
+  bool crlf_pending = false;
   int64_t r_avail;
 
   ink_assert(max_chunk_header_len);
@@ -311,21 +325,28 @@ bool ChunkedHandler::generate_chunked_content()
 
   while ((r_avail = dechunked_reader->read_avail()) > 0 && state != CHUNK_WRITE_DONE) {
     int64_t write_val = MIN(max_chunk_size, r_avail);
+    int len = 0;
 
     state = CHUNK_WRITE_CHUNK;
     Debug("http_chunk", "creating a chunk of size %" PRId64 " bytes", write_val);
 
-    // Output the chunk size.
+    // Output the chunk size, after the CRLF of the chunk before it, so
+    // that each chunk costs one small write rather than two.
+    if (crlf_pending) {
+      tmp[len++] = '\r';
+      tmp[len++] = '\n';
+    }
     if (write_val != max_chunk_size) {
-      int len = snprintf(tmp, sizeof(tmp), CHUNK_HEADER_FMT, write_val);
-      chunked_buffer->write(tmp, len);
-      chunked_size += len;
+      len += snprintf(tmp + len, sizeof(tmp) - len, CHUNK_HEADER_FMT, write_val);
     } else {
-      chunked_buffer->write(max_chunk_header, max_chunk_header_len);
-      chunked_size += max_chunk_header_len;
+      memcpy(tmp + len, max_chunk_header, max_chunk_header_len);
+      len += max_chunk_header_len;
     }
+    chunked_buffer->write(tmp, len);
+    chunked_size += len;
 
-    // Output the chunk itself.
+    // Output the chunk itself, by reference to the blocks it is in
+    // however many there are, the payload is never copied.
     //
     // BZ# 54395 Note - we really should only do a
     //   block transfer if there is sizable amount of
@@ -339,17 +360,27 @@ bool ChunkedHandler::generate_chunked_content()
     chunked_size += write_val;
     dechunked_reader->consume(write_val);
 
-    // Output the trailing CRLF.
-    chunked_buffer->write("\r\n", 2);
-    chunked_size += 2;
+    // Output the trailing CRLF, now unless another chunk follows at once,
+    // so that a chunk never waits on data that has not arrived.
+    crlf_pending = true;
+    if (r_avail == write_val && !server_done) {
+      chunked_buffer->write("\r\n", 2);
+      chunked_size += 2;
+      crlf_pending = false;
+    }
   }
 
   if (server_done) {
     state = CHUNK_WRITE_DONE;
 
     // Add the chunked transfer coding trailer.
-    chunked_buffer->write("0\r\n\r\n", 5);
-    chunked_size += 5;
+    if (crlf_pending) {
+      chunked_buffer->write("\r\n0\r\n\r\n", 7);
+      chunked_size += 7;
+    } else {
+      chunked_buffer->write("0\r\n\r\n", 5);
+      chunked_size += 5;
+    }
     return true;
   }
   return false;
@@ -361,7 +392,8 @@ HttpTunnelProducer::HttpTunnelProducer()
     buffer_start(NULL), vc_type(HT_HTTP_SERVER), chunking_action(TCA_PASSTHRU_DECHUNKED_CONTENT),
     do_chunking(false), do_dechunking(false), do_chunked_passthru(false),
     init_bytes_done(0), nbytes(0), ntodo(0), bytes_read(0),
-    handler_state(0), num_consumers(0), alive(false),
+    handler_state(0), range_index(0), range_bytes_read(0), observed(false), observer_skip_bytes(0),
+    observer_reader(NULL), num_consumers(0), alive(false),
     read_success(false), flow_control_source(0), name(NULL)
 {
 }
@@ -569,6 +601,13 @@ HttpTunnel::set_producer_chunking_size(HttpTunnelProducer* p, int64_t size)
   p->chunked_handler.set_max_chunk_size(size);
 }
 
+void
+HttpTunnel::set_producer_observed(HttpTunnelProducer* p, int64_t skip_bytes)
+{
+  p->observed = true;
+  p->observer_skip_bytes = skip_bytes;
+}
+
 // HttpTunnelProducer* HttpTunnel::add_producer
 //
 //   Adds a new producer to the tunnel
@@ -747,8 +786,9 @@ HttpTunnel::producer_run(HttpTunnelProducer * p)
     else if (action == TCA_PASSTHRU_CHUNKED_CONTENT) {
       p->do_chunked_passthru = true;
 
-      // Dechunk the chunked content into the cache.
-      if (cache_write_consumer != NULL)
+      // Dechunk the chunked content into the cache, and for the
+      // observers of the body.
+      if (cache_write_consumer != NULL || p->observed)
         p->do_dechunking = true;
     }
   }
@@ -794,6 +834,17 @@ HttpTunnel::producer_run(HttpTunnelProducer * p)
     read_start_pos = sm->t_state.ranges[0]._start;
     producer_n = (sm->t_state.ranges[0]._end - sm->t_state.ranges[0]._start)+1;
     consumer_n = (producer_n + sm->client_response_hdr_bytes);
+  } else if (p->vc_type == HT_CACHE_READ && sm->t_state.range_pread) {
+    // One pread per range, see producer_pread_next_range(). The range
+    // transform gets only the bytes of the ranges.
+    RangeRecord *ranges = sm->t_state.ranges;
+    p->range_index = 0;
+    p->range_bytes_read = 0;
+    read_start_pos = ranges[0]._start;
+    producer_n = (ranges[0]._end - ranges[0]._start) + 1;
+    consumer_n = 0;
+    for (int i = 0; i < sm->t_state.num_range_fields; i++)
+      consumer_n += (ranges[i]._end - ranges[i]._start) + 1;
   } else if (p->nbytes >= 0) {
     consumer_n = p->nbytes;
     producer_n = p->ntodo;
@@ -865,6 +916,22 @@ HttpTunnel::producer_run(HttpTunnelProducer * p)
     c = c->link.next;
   }
 
+  // The observers read the same bytes as a cache write would, through a
+  // reader of their own.
+  if (p->observed) {
+    int64_t skip = p->observer_skip_bytes;
+
+    if (p->do_dechunking) {
+      p->observer_reader = p->chunked_handler.dechunked_buffer->clone_reader(dechunked_buffer_start);
+      if (transform_consumer)
+        skip = 0;
+    } else {
+      p->observer_reader = p->read_buffer->clone_reader(p->buffer_start);
+    }
+    p->observer_reader->consume(MIN(skip, p->observer_reader->read_avail()));
+    producer_observe(p, false);
+  }
+
   //YTS Team, yamsat Plugin
   // Allocate and copy partial POST data to buffers. Check for the various parameters
   // including the maximum configured post data size
@@ -1032,6 +1099,65 @@ HttpTunnel::producer_handler_chunked(int event, HttpTunnelProducer * p)
   return event;
 }
 
+//
+// void HttpTunnel::producer_observe(HttpTunnelProducer* p, bool done)
+//
+//   Shows the body observers of the transaction the bytes the producer
+//    added since the last call, then consumes them.  The observers get
+//    the blocks of the producer's buffer, nothing is copied.  When the
+//    producer is done, they are told if it read the whole body, and the
+//    reader is released.
+//
+void
+HttpTunnel::producer_observe(HttpTunnelProducer * p, bool done)
+{
+  IOBufferReader *reader = p->observer_reader;
+  int64_t avail = reader->read_avail();
+
+  if (avail > 0) {
+    sm->body_observers_call(reader, false);
+    reader->consume(reader->read_avail());
+  }
+  if (done) {
+    if (p->read_success && !p->chunked_handler.truncation)
+      sm->body_observers_call(NULL, true);
+    reader->mbuf->dealloc_reader(reader);
+    p->observer_reader = NULL;
+  }
+}
+
+//
+// bool HttpTunnel::producer_pread_next_range(HttpTunnelProducer* p)
+//
+//   Several ranges served from cache are read one pread per range,
+//    so the bytes between the ranges are never read from disk.  Called
+//    when the read of a range completes, starts the read of the next
+//    one.  Returns false if there is none.
+//
+bool
+HttpTunnel::producer_pread_next_range(HttpTunnelProducer * p)
+{
+  if (p->vc_type != HT_CACHE_READ || !sm->t_state.range_pread ||
+      p->range_index + 1 >= sm->t_state.num_range_fields)
+    return false;
+
+  RangeRecord *r = &sm->t_state.ranges[++p->range_index];
+
+  Debug("http_range", "[%" PRId64 "] pread of range %d, %" PRId64 "-%" PRId64,
+        sm->sm_id, p->range_index, r->_start, r->_end);
+  p->range_bytes_read += p->read_vio->ndone;
+  p->read_vio = ((CacheVC*)p->vc)->do_io_pread(this, (r->_end - r->_start) + 1, p->read_buffer, r->_start);
+  // called back from the cache VC, which does not schedule itself then
+  p->read_vio->reenable();
+
+  for (HttpTunnelConsumer *c = p->consumer_list.head; c; c = c->link.next) {
+    if (c->alive) {
+      c->write_vio->reenable();
+    }
+  }
+  return true;
+}
+
 //
 // bool HttpTunnel::producer_handler(int event, HttpTunnelProducer* p)
 //
@@ -1068,6 +1194,9 @@ bool HttpTunnel::producer_handler(int event, HttpTunnelProducer * p)
     p->last_event = event;
   }
 
+  if (p->observer_reader)
+    producer_observe(p, false);
+
   //YTS Team, yamsat Plugin
   //Copy partial POST data to buffers. Check for the various parameters including
   //the maximum configured post data size
@@ -1115,14 +1244,18 @@ bool HttpTunnel::producer_handler(int event, HttpTunnelProducer * p)
     jump_point = p->vc_handler;
     (sm->*jump_point) (event, p);
     sm_callback = true;
+    if (p->observer_reader)
+      producer_observe(p, true);
     break;
 
   case VC_EVENT_READ_COMPLETE:
   case VC_EVENT_EOS:
+    if (event == VC_EVENT_READ_COMPLETE && producer_pread_next_range(p))
+      break;
     // The producer completed
     p->alive = false;
     if (p->read_vio) {
-      p->bytes_read = p->read_vio->ndone;
+      p->bytes_read = p->read_vio->ndone + p->range_bytes_read;
     } else {
       // If we are chunked, we can receive the whole document
       //   along with the header without knowing it (due to
@@ -1142,6 +1275,8 @@ bool HttpTunnel::producer_handler(int event, HttpTunnelProducer * p)
     jump_point = p->vc_handler;
     (sm->*jump_point) (event, p);
     sm_callback = true;
+    if (p->observer_reader)
+      producer_observe(p, true);
 
     // Data read from producer, reenable consumers
     for (c = p->consumer_list.head; c; c = c->link.next) {
@@ -1161,6 +1296,8 @@ bool HttpTunnel::producer_handler(int event, HttpTunnelProducer * p)
     jump_point = p->vc_handler;
     (sm->*jump_point) (event, p);
     sm_callback = true;
+    if (p->observer_reader)
+      producer_observe(p, true);
     break;
 
   case VC_EVENT_WRITE_READY:
@@ -213,6 +213,11 @@ struct HttpTunnelProducer
   int64_t bytes_read;               // total bytes read from the vc
   int handler_state;              // state used the handlers
   int last_event;                   ///< Tracking for flow control restarts.
+  int range_index;                  ///< Range being read, for a read of several ranges from cache.
+  int64_t range_bytes_read;         ///< Bytes read for the ranges before @c range_index.
+  bool observed;                    ///< The body observers of the transaction see the data.
+  int64_t observer_skip_bytes;      ///< Header bytes at the start of the data, not shown to them.
+  IOBufferReader *observer_reader;  ///< The data they have not seen yet.
 
   int num_consumers;
 
@@ -315,6 +320,11 @@ public:
   void set_producer_chunking_action(HttpTunnelProducer * p, int64_t skip_bytes, TunnelChunkingAction_t action);
   /// Set the maximum (preferred) chunk @a size of chunked output for @a producer.
   void set_producer_chunking_size(HttpTunnelProducer* producer, int64_t size);
+  /** Show the body read by @a producer to the body observers of the
+      transaction, in place in the producer's buffer, dechunked, and
+      without the first @a skip_bytes (the header written for the client).
+  */
+  void set_producer_observed(HttpTunnelProducer* producer, int64_t skip_bytes);
 
   HttpTunnelConsumer *add_consumer(VConnection * vc,
                                    VConnection * producer,
@@ -333,6 +343,8 @@ public:
   bool producer_handler(int event, HttpTunnelProducer * p);
   int producer_handler_dechunked(int event, HttpTunnelProducer * p);
   int producer_handler_chunked(int event, HttpTunnelProducer * p);
+  bool producer_pread_next_range(HttpTunnelProducer * p);
+  void producer_observe(HttpTunnelProducer * p, bool done);
   void local_finish_all(HttpTunnelProducer * p);
   void chain_finish_all(HttpTunnelProducer * p);
   void chain_abort_cache_write(HttpTunnelProducer * p);
@@ -26,6 +26,7 @@
 #include "libts.h"
 #include "api/ts/ts.h"
 #include "api/ts/remap.h"
+#include "Plugin.h"
 
 // Remap inline options
 #define REMAP_OPTFLG_MAP_WITH_REFERER 0x01      /* "map_with_referer" option */
@@ -34,6 +35,7 @@
 #define REMAP_OPTFLG_METHOD           0x08      /* "method=" option (used for ACL filtering) */
 #define REMAP_OPTFLG_SRC_IP           0x10      /* "src_ip=" option (used for ACL filtering) */
 #define REMAP_OPTFLG_ACTION           0x20      /* "action=" option (used for ACL filtering) */
+#define REMAP_OPTFLG_CONFIG           0x40      /* "config=" option (overridable configs for the rule) */
 #define REMAP_OPTFLG_MAP_ID          0x800      /* associate a map ID with this rule */
 #define REMAP_OPTFLG_INVERT           0x80000000        /* "invert" the rule (for src_ip at least) */
 #define REMAP_OPTFLG_ALL_FILTERS (REMAP_OPTFLG_METHOD|REMAP_OPTFLG_SRC_IP|REMAP_OPTFLG_ACTION)
@@ -70,6 +72,7 @@ public:
   _tsremap_delete_instance *fp_tsremap_delete_instance;
   _tsremap_do_remap *fp_tsremap_do_remap;
   _tsremap_os_response *fp_tsremap_os_response;
+  PluginHookStats *hook_stats;
 
   remap_plugin_info(char *_path);
   ~remap_plugin_info();
@@ -22,6 +22,7 @@
  */
 
 #include "RemapPlugins.h"
+#include "HttpSM.h"
 
 ClassAllocator<RemapPlugins> pluginAllocator("RemapPluginsAlloc");
 
@@ -72,14 +73,21 @@ RemapPlugins::run_plugin(remap_plugin_info* plugin)
     _s->remap_plugin_instance = ih;
   }
 
-  plugin_retcode = plugin->fp_tsremap_do_remap(ih, _s ? reinterpret_cast<TSHttpTxn>(_s->state_machine) : NULL, &rri);
+  {
+    PluginHookScope scope(plugin->hook_stats);
+    if (_s)
+      _s->state_machine->plugin_hook_begin(plugin->hook_stats, PLUGIN_HOOK_REMAP);
+    plugin_retcode = plugin->fp_tsremap_do_remap(ih, _s ? reinterpret_cast<TSHttpTxn>(_s->state_machine) : NULL, &rri);
+    if (_s)
+      _s->state_machine->plugin_hook_end();
+  }
   // TODO: Deal with negative return codes here
   if (plugin_retcode < 0)
     plugin_retcode = TSREMAP_NO_REMAP;
 
   // First step after plugin remap must be "redirect url" check
   if ((TSREMAP_DID_REMAP == plugin_retcode || TSREMAP_DID_REMAP_STOP == plugin_retcode) && rri.redirect)
-    _s->remap_redirect = _request_url->string_get(NULL);
+    _s->remap_redirect = _request_url->string_get(&_s->arena);
 
   return plugin_retcode;
 }
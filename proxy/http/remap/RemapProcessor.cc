@@ -133,6 +133,12 @@ RemapProcessor::setup_for_remap(HttpTransact::State *s)
 
   if (mapping_found) {
     request_header->mark_target_dirty();
+
+    // Adopt the rule's overridable configs before any remap plugin runs, so that plugins override on top.
+    url_mapping *map = s->url_map.getMapping();
+
+    if (map->overlay)
+      TSHttpTxnConfigOverlaySet(reinterpret_cast<TSHttpTxn>(s->state_machine), map->overlay);
   } else {
     Debug("url_rewrite", "RemapProcessor::setup_for_remap did not find a mapping");
   }
@@ -186,6 +192,8 @@ RemapProcessor::finish_remap(HttpTransact::State *s)
     }
 
     if (!enabled_flag) {
+      const char *redirect = NULL;
+
       if (!map->default_redirect_url) {
         if ((s->filter_mask & URL_REMAP_FILTER_REDIRECT_FMT) != 0 && map->redir_chunk_list) {
           redirect_tag_str *rc;
@@ -218,15 +226,18 @@ RemapProcessor::finish_remap(HttpTransact::State *s)
             }
           }
           tmp_redirect_buf[sizeof(tmp_redirect_buf) - 1] = 0;
-          *redirect_url = ats_strdup(tmp_redirect_buf);
+          redirect = tmp_redirect_buf;
         }
       } else {
-        *redirect_url = ats_strdup(rewrite_table->http_default_redirect_url);
+        redirect = rewrite_table->http_default_redirect_url;
       }
 
-      if (*redirect_url == NULL) {
-        *redirect_url = ats_strdup(map->filter_redirect_url ? map->filter_redirect_url :
-                                   rewrite_table->http_default_redirect_url);
+      if (redirect == NULL) {
+        redirect = map->filter_redirect_url ? map->filter_redirect_url : rewrite_table->http_default_redirect_url;
+      }
+      // Transient, so it lives in the transaction's arena rather than the heap.
+      if (redirect) {
+        *redirect_url = s->arena.str_store(redirect, strlen(redirect));
       }
 
       return false;
@@ -241,19 +252,7 @@ RemapProcessor::finish_remap(HttpTransact::State *s)
   const char *host_hdr = request_header->value_get(MIME_FIELD_HOST, MIME_LEN_HOST, &host_len);
 
   if (request_url && host_hdr != NULL && s->txn_conf->maintain_pristine_host_hdr == 0) {
-    // Debug code to print out old host header.  This was easier before
-    //  the header conversion.  Now we have to copy to gain null
-    //  termination for the Debug() call
-    if (is_debug_tag_set("url_rewrite")) {
-      int old_host_hdr_len;
-      char *old_host_hdr = (char *) request_header->value_get(MIME_FIELD_HOST, MIME_LEN_HOST, &old_host_hdr_len);
-
-      if (old_host_hdr) {
-        old_host_hdr = ats_strndup(old_host_hdr, old_host_hdr_len);
-        Debug("url_rewrite", "Host: Header before rewrite %.*s", old_host_hdr_len, old_host_hdr);
-        ats_free(old_host_hdr);
-      }
-    }
+    Debug("url_rewrite", "Host: Header before rewrite %.*s", host_len, host_hdr);
     //
     // Create the new host header field being careful that our
     //   temporary buffer has adequate length
@@ -31,10 +31,10 @@ url_mapping::url_mapping(int rank /* = 0 */)
   : from_path_len(0), fromURL(), toUrl(), homePageRedirect(false), unique(false), default_redirect_url(false),
     optional_referer(false), negative_referer(false), wildcard_from_scheme(false),
     tag(NULL), filter_redirect_url(NULL), referer_list(0),
-    redir_chunk_list(0), filter(NULL), _plugin_count(0), _rank(rank)
+    redir_chunk_list(0), filter(NULL), overlay(NULL), _plugin_count(0), _rank(rank)
 {
   memset(_plugin_list, 0, sizeof(_plugin_list));
-  memset(_instance_data, 0, sizeof(_instance_data));
+  memset(_instances, 0, sizeof(_instances));
 }
 
 
@@ -42,13 +42,13 @@ url_mapping::url_mapping(int rank /* = 0 */)
  *
 **/
 bool
-url_mapping::add_plugin(remap_plugin_info* i, void* ih)
+url_mapping::add_plugin(remap_plugin_instance* inst)
 {
   if (_plugin_count >= MAX_REMAP_PLUGIN_CHAIN)
     return false;
 
-  _plugin_list[_plugin_count] = i;
-  _instance_data[_plugin_count] = ih;
+  _plugin_list[_plugin_count] = inst->pi;
+  _instances[_plugin_count] = inst;
   ++_plugin_count;
 
   return true;
@@ -69,16 +69,19 @@ url_mapping::get_plugin(unsigned int index) const
 }
 
 /**
- *
+ * Drop our reference to the instance, deleting it if it was the last one.
 **/
 void
 url_mapping::delete_instance(unsigned int index)
 {
-  void *ih = get_instance(index);
-  remap_plugin_info* p = get_plugin(index);
+  remap_plugin_instance *inst = _instances[index];
 
-  if (ih && p && p->fp_tsremap_delete_instance)
-    p->fp_tsremap_delete_instance(ih);
+  _instances[index] = NULL;
+  if (inst && ink_atomic_increment(&inst->refcount, -1) == 1) {
+    if (inst->ih && inst->pi && inst->pi->fp_tsremap_delete_instance)
+      inst->pi->fp_tsremap_delete_instance(inst->ih);
+    delete inst;
+  }
 }
 
 
@@ -114,6 +117,9 @@ url_mapping::~url_mapping()
     delete afr;
   }
 
+  if (overlay)
+    TSHttpConfigOverlayDestroy(overlay);
+
   // Destroy the URLs
   fromURL.destroy();
   toUrl.destroy();
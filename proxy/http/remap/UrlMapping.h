@@ -81,6 +81,18 @@ public:
   static redirect_tag_str *parse_format_redirect_url(char *url);
 };
 
+/**
+ * A remap plugin instance. A rule that did not change across a reload of
+ * remap.config shares the instance with the rule of the table it replaces,
+ * so the instance goes with its last reference.
+**/
+struct remap_plugin_instance
+{
+  remap_plugin_info *pi;
+  void *ih;
+  int refcount;
+};
+
 /**
  * Used to store the mapping for class UrlRewrite
 **/
@@ -90,10 +102,10 @@ public:
   url_mapping(int rank = 0);
   ~url_mapping();
 
-  bool add_plugin(remap_plugin_info *i, void* ih);
+  bool add_plugin(remap_plugin_instance *inst);
   remap_plugin_info *get_plugin(unsigned int) const;
 
-  void* get_instance(unsigned int index) const { return _instance_data[index]; };
+  void* get_instance(unsigned int index) const { return _instances[index] ? _instances[index]->ih : NULL; };
   void delete_instance(unsigned int index);
   void Print();
 
@@ -112,6 +124,7 @@ public:
   referer_info *referer_list;
   redirect_tag_str *redir_chunk_list;
   acl_filter_rule *filter;      // acl filtering (list of rules)
+  TSHttpConfigOverlay overlay;  // "@config=" overrides, shared by the rule's transactions
   unsigned int _plugin_count;
   LINK(url_mapping, link); // For use with the main Queue linked list holding all the mapping
 
@@ -119,7 +132,7 @@ public:
 
 private:
   remap_plugin_info* _plugin_list[MAX_REMAP_PLUGIN_CHAIN];
-  void* _instance_data[MAX_REMAP_PLUGIN_CHAIN];
+  remap_plugin_instance* _instances[MAX_REMAP_PLUGIN_CHAIN];
   int _rank;
 };
 
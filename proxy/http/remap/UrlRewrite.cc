@@ -36,6 +36,22 @@
 #include "ink_string.h"
 
 
+#ifdef PCRE_STUDY_JIT_COMPILE
+#define REGEX_STUDY_FLAGS PCRE_STUDY_JIT_COMPILE
+#else
+#define REGEX_STUDY_FLAGS 0
+#endif
+
+static inline void
+regex_free_study(pcre_extra *extra)
+{
+#ifdef PCRE_STUDY_JIT_COMPILE
+  pcre_free_study(extra);
+#else
+  pcre_free(extra);
+#endif
+}
+
 unsigned long
 check_remap_option(char *argv[], int argc, unsigned long findmode = 0, int *_ret_idx = NULL, char **argptr = NULL)
 {
@@ -92,6 +108,12 @@ check_remap_option(char *argv[], int argc, unsigned long findmode = 0, int *_ret
         if (argptr)
           *argptr = &argv[i][6];
         ret_flags |= REMAP_OPTFLG_MAP_ID;
+      } else if (!strncasecmp(argv[i], "config=", 7)) {
+        if ((findmode & REMAP_OPTFLG_CONFIG) != 0)
+          idx = i;
+        if (argptr)
+          *argptr = &argv[i][7];
+        ret_flags |= REMAP_OPTFLG_CONFIG;
       }
 
 
@@ -468,20 +490,84 @@ process_filter_opt(url_mapping *mp, BUILD_TABLE_INFO *bti, char *errStrBuf, int
   return errStr;
 }
 
+// Compile the rule's "@config=<name>=<value>" options into one overlay, so
+// that every transaction through the rule shares the resulting configs.
+static const char *
+process_config_opt(url_mapping *mp, BUILD_TABLE_INFO *bti, char *errStrBuf, int errStrBufSize)
+{
+  if (unlikely(!mp || !bti || !errStrBuf || errStrBufSize <= 0)) {
+    Debug("url_rewrite", "[process_config_opt] Invalid argument(s)");
+    return (const char *) "[process_config_opt] Invalid argument(s)";
+  }
+  if ((bti->remap_optflg & REMAP_OPTFLG_CONFIG) == 0)
+    return NULL;
+
+  for (int i = 0; i < bti->argc; i++) {
+    TSOverridableConfigKey conf;
+    TSRecordDataType type;
+    TSReturnCode ret = TS_ERROR;
+    char *name, *value;
+
+    if (strncasecmp(bti->argv[i], "config=", 7))
+      continue;
+    name = &bti->argv[i][7];
+    if ((value = strchr(name, '=')) == NULL || TSHttpTxnConfigFind(name, value - name, &conf, &type) != TS_SUCCESS) {
+      snprintf(errStrBuf, errStrBufSize, "Invalid or non-overridable configuration in \"%s\"", bti->argv[i]);
+      Debug("url_rewrite", "[process_config_opt] %s", errStrBuf);
+      return (const char *) errStrBuf;
+    }
+    ++value;
+
+    if (!mp->overlay)
+      mp->overlay = TSHttpConfigOverlayCreate();
+
+    switch (type) {
+    case TS_RECORDDATATYPE_INT:
+      ret = TSHttpConfigOverlayIntSet(mp->overlay, conf, strtoll(value, NULL, 10));
+      break;
+    case TS_RECORDDATATYPE_FLOAT:
+      ret = TSHttpConfigOverlayFloatSet(mp->overlay, conf, strtof(value, NULL));
+      break;
+    case TS_RECORDDATATYPE_STRING:
+      ret = TSHttpConfigOverlayStringSet(mp->overlay, conf, value, -1);
+      break;
+    default:
+      break;
+    }
+    if (ret != TS_SUCCESS) {
+      snprintf(errStrBuf, errStrBufSize, "Unable to set configuration \"%s\"", bti->argv[i]);
+      Debug("url_rewrite", "[process_config_opt] %s", errStrBuf);
+      return (const char *) errStrBuf;
+    }
+    Debug("url_rewrite", "[process_config_opt] Overriding %.*s with %s", (int) (value - name - 1), name, value);
+  }
+
+  return NULL;
+}
+
 //
 // CTOR / DTOR for the UrlRewrite class.
 //
-UrlRewrite::UrlRewrite(const char *file_var_in)
+UrlRewrite::UrlRewrite(const char *file_var_in, UrlRewrite *prev)
  : nohost_rules(0), reverse_proxy(0), backdoor_enabled(0),
    mgmt_autoconf_port(0), default_to_pac(0), default_to_pac_port(0), file_var(NULL), ts_name(NULL),
    http_default_redirect_url(NULL), num_rules_forward(0), num_rules_reverse(0), num_rules_redirect_permanent(0),
-   num_rules_redirect_temporary(0), num_rules_forward_with_recv_port(0), _valid(false)
+   num_rules_redirect_temporary(0), num_rules_forward_with_recv_port(0), plugin_instances(NULL),
+   share_plugin_instances(0), num_plugin_instances(0), num_plugin_instances_reused(0), num_plugin_instances_shared(0),
+   origin_hosts(NULL), _valid(false), _prev(NULL)
 {
 
   forward_mappings.hash_lookup = reverse_mappings.hash_lookup =
     permanent_redirects.hash_lookup = temporary_redirects.hash_lookup = 
     forward_mappings_with_recv_port.hash_lookup = NULL;
 
+  forward_mappings.regex_filter = reverse_mappings.regex_filter =
+    permanent_redirects.regex_filter = temporary_redirects.regex_filter =
+    forward_mappings_with_recv_port.regex_filter = NULL;
+  forward_mappings.regex_filter_extra = reverse_mappings.regex_filter_extra =
+    permanent_redirects.regex_filter_extra = temporary_redirects.regex_filter_extra =
+    forward_mappings_with_recv_port.regex_filter_extra = NULL;
+
   char *config_file = NULL;
 
   ink_assert(file_var_in != NULL);
@@ -519,12 +605,30 @@ UrlRewrite::UrlRewrite(const char *file_var_in)
   REC_ReadConfigInteger(url_remap_mode, "proxy.config.url_remap.url_remap_mode");
   REC_ReadConfigInteger(backdoor_enabled, "proxy.config.url_remap.handle_backdoor_urls");
 
+  // Plugin instances of unchanged rules are taken over from the previous table instead of being created
+  // again, unless plugins are expected to pick up changes to their own configuration files on a reload.
+  int reuse_plugin_instances = 0;
+  REC_ReadConfigInteger(reuse_plugin_instances, "proxy.config.url_remap.reuse_plugin_instances");
+  REC_ReadConfigInteger(share_plugin_instances, "proxy.config.url_remap.share_plugin_instances");
+  if (reuse_plugin_instances || share_plugin_instances)
+    plugin_instances = ink_hash_table_create(InkHashTableKeyType_String);
+  // The keys of the two tables only compare if they were made the same way
+  if (reuse_plugin_instances && prev && prev->plugin_instances && prev->share_plugin_instances == share_plugin_instances)
+    _prev = prev;
+
   ink_strlcpy(config_file_path, system_config_directory, sizeof(config_file_path));
   ink_strlcat(config_file_path, "/", sizeof(config_file_path));
   ink_strlcat(config_file_path, config_file, sizeof(config_file_path));
   ats_free(config_file);
 
-  if (0 == this->BuildTable()) {
+  origin_hosts = ink_hash_table_create(InkHashTableKeyType_String);
+  int rc = this->BuildTable();
+  if (plugin_instances)
+    Debug("url_rewrite", "%d plugin instances: %d taken over from the previous table, %d shared between rules",
+          num_plugin_instances, num_plugin_instances_reused, num_plugin_instances_shared);
+  _prev = NULL;
+
+  if (0 == rc) {
     _valid = true;
     pcre_malloc = &ats_malloc;
     pcre_free = &ats_free;
@@ -548,6 +652,10 @@ UrlRewrite::~UrlRewrite()
   DestroyStore(permanent_redirects);
   DestroyStore(temporary_redirects);
   DestroyStore(forward_mappings_with_recv_port);
+  if (plugin_instances)
+    ink_hash_table_destroy(plugin_instances);
+  if (origin_hosts)
+    ink_hash_table_destroy(origin_hosts);
   _valid = false;
 }
 
@@ -1039,6 +1147,26 @@ UrlRewrite::_addToStore(MappingsStore &store, url_mapping *new_mapping, RegexMap
   return retval;
 }
 
+void
+UrlRewrite::_addOriginHost(url_mapping *new_mapping, RegexMapping *reg_map)
+{
+  int host_len;
+  const char *host = new_mapping->toUrl.host_get(&host_len);
+  char host_lower[MAXDNAME + 1];
+  IpEndpoint ip;
+
+  // a target host with substitutions is only known per request
+  if (host == NULL || host_len <= 0 || host_len > MAXDNAME || (reg_map && reg_map->n_substitutions > 0))
+    return;
+  for (int i = 0; i < host_len; i++)
+    host_lower[i] = ParseRules::ink_tolower(host[i]);
+  host_lower[host_len] = '\0';
+  if (0 == ats_ip_pton(host_lower, &ip))
+    return;
+  if (!ink_hash_table_isbound(origin_hosts, host_lower))
+    ink_hash_table_insert(origin_hosts, host_lower, NULL);
+}
+
 /**
   Reads the configuration file and creates a new hash table.
 
@@ -1212,6 +1340,11 @@ UrlRewrite::BuildTable()
       goto MAP_ERROR;
     }
 
+    // compile the overridable configs, if any
+    if ((errStr = process_config_opt(new_mapping, &bti, errStrBuf, sizeof(errStrBuf))) != NULL) {
+      goto MAP_ERROR;
+    }
+
     new_mapping->map_id = 0;
     if ((bti.remap_optflg & REMAP_OPTFLG_MAP_ID) != 0) {
       int idx = 0;
@@ -1452,6 +1585,7 @@ UrlRewrite::BuildTable()
                                     is_cur_mapping_regex, num_rules_forward)) == true) {
         // @todo: is this applicable to regex mapping too?
         SetHomePageRedirectFlag(new_mapping, new_mapping->toUrl);
+        _addOriginHost(new_mapping, reg_map);
       }
       break;
     case REVERSE_MAP:
@@ -1468,8 +1602,9 @@ UrlRewrite::BuildTable()
                                is_cur_mapping_regex, num_rules_redirect_temporary);
       break;
     case FORWARD_MAP_WITH_RECV_PORT:
-      add_result = _addToStore(forward_mappings_with_recv_port, new_mapping, reg_map, fromHost_lower,
-                               is_cur_mapping_regex, num_rules_forward_with_recv_port);
+      if ((add_result = _addToStore(forward_mappings_with_recv_port, new_mapping, reg_map, fromHost_lower,
+                                    is_cur_mapping_regex, num_rules_forward_with_recv_port)) == true)
+        _addOriginHost(new_mapping, reg_map);
       break;
     default:
       // 'default' required to avoid compiler warning; unsupported map
@@ -1549,6 +1684,12 @@ UrlRewrite::BuildTable()
     forward_mappings_with_recv_port.hash_lookup = ink_hash_table_destroy(
       forward_mappings_with_recv_port.hash_lookup);
   }
+
+  _buildRegexFilter(forward_mappings);
+  _buildRegexFilter(reverse_mappings);
+  _buildRegexFilter(permanent_redirects);
+  _buildRegexFilter(temporary_redirects);
+  _buildRegexFilter(forward_mappings_with_recv_port);
   ats_free(file_buf);
 
   return 0;
@@ -1588,6 +1729,29 @@ UrlRewrite::TableInsert(InkHashTable *h_table, url_mapping *mapping, const char
   return true;
 }
 
+/**
+  The key a plugin instance is known by across reloads: the plugin, and the
+  parameters it was created with, which start with the rule's URLs.
+*/
+static char *
+remap_plugin_instance_key(const char *path, int parc, char *parv[])
+{
+  size_t len = strlen(path) + 1;
+
+  for (int i = 0; i < parc; i++)
+    len += strlen(parv[i]) + 1;
+
+  char *key = (char *)ats_malloc(len);
+  char *p = key;
+
+  p += ink_strlcpy(p, path, len);
+  for (int i = 0; i < parc; i++) {
+    *p++ = '\n';
+    p += ink_strlcpy(p, parv[i], len - (p - key));
+  }
+  return key;
+}
+
 int
 UrlRewrite::load_remap_plugin(char *argv[], int argc, url_mapping *mp, char *errbuf, int errbufsize, int jump_to_argc,
                               int *plugin_found_at)
@@ -1660,6 +1824,7 @@ UrlRewrite::load_remap_plugin(char *argv[], int argc, url_mapping *mp, char *err
       remap_pi_list->add_to_list(pi);
     }
     Debug("remap_plugin", "New remap plugin info created for \"%s\"", c);
+    pi->hook_stats = plugin_hook_stats_get(c);
 
     if ((pi->dlh = dlopen(c, RTLD_NOW)) == NULL) {
 #if defined(freebsd) || defined(openbsd)
@@ -1699,6 +1864,7 @@ UrlRewrite::load_remap_plugin(char *argv[], int argc, url_mapping *mp, char *err
     ri.size = sizeof(ri);
     ri.tsremap_version = TSREMAP_VERSION;
 
+    PluginHookScope scope(pi->hook_stats);
     if (pi->fp_tsremap_init(&ri, tmpbuf, sizeof(tmpbuf) - 1) != TS_SUCCESS) {
       Warning("Failed to initialize plugin %s (non-zero retval) ... bailing out", pi->path);
       return -5;
@@ -1753,24 +1919,70 @@ UrlRewrite::load_remap_plugin(char *argv[], int argc, url_mapping *mp, char *err
     Debug("url_rewrite", "Argument %d: %s", k, parv[k]);
   }
 
-  void* ih;
+  // The first rule of this table with the same plugin and parameters as a rule of the table being
+  // replaced shares its instance. When instances are shared between rules, the URLs are left out of
+  // the key, and later rules with the same plugin and parameters share the instance of the first;
+  // it was created with the URLs of that rule. Any other rule gets a new instance.
+  remap_plugin_instance *inst = NULL;
+  char *key = NULL;
+  bool unique_key = false;
+
+  if (plugin_instances) {
+    key = share_plugin_instances ? remap_plugin_instance_key(pi->path, parc - 2, parv + 2)
+                                 : remap_plugin_instance_key(pi->path, parc, parv);
+    unique_key = !ink_hash_table_lookup(plugin_instances, key, (InkHashTableValue *) &inst);
+    if (!unique_key) {
+      if (share_plugin_instances) {
+        ink_atomic_increment(&inst->refcount, 1);
+        ++num_plugin_instances_shared;
+        Debug("remap_plugin", "sharing plugin instance %p with an earlier rule", inst->ih);
+      } else {
+        inst = NULL;
+      }
+    } else if (_prev && ink_hash_table_lookup(_prev->plugin_instances, key, (InkHashTableValue *) &inst)) {
+      ink_atomic_increment(&inst->refcount, 1);
+      ++num_plugin_instances_reused;
+      Debug("remap_plugin", "reusing plugin instance %p of the previous table", inst->ih);
+    }
+  }
+
+  if (inst == NULL) {
+    void* ih;
+
+    Debug("remap_plugin", "creating new plugin instance");
+    TSReturnCode res;
+    {
+      PluginHookScope scope(pi->hook_stats);
+      res = pi->fp_tsremap_new_instance(parc, parv, &ih, tmpbuf, sizeof(tmpbuf) - 1);
+    }
+
+    Debug("remap_plugin", "done creating new plugin instance");
 
-  Debug("remap_plugin", "creating new plugin instance");
-  TSReturnCode res = pi->fp_tsremap_new_instance(parc, parv, &ih, tmpbuf, sizeof(tmpbuf) - 1);
+    if (res != TS_SUCCESS) {
+      ats_free(parv[0]);           // fromURL
+      ats_free(parv[1]);           // toURL
+      ats_free(key);
+      snprintf(errbuf, errbufsize, "Can't create new remap instance for plugin \"%s\" - %s", c,
+                   tmpbuf[0] ? tmpbuf : "Unknown plugin error");
+      Warning("Failed to create new instance for plugin %s (not a TS_SUCCESS return)", pi->path);
+      return -8;
+    }
 
-  Debug("remap_plugin", "done creating new plugin instance");
+    inst = new remap_plugin_instance;
+    inst->pi = pi;
+    inst->ih = ih;
+    inst->refcount = 1;
+  }
 
   ats_free(parv[0]);               // fromURL
   ats_free(parv[1]);               // toURL
 
-  if (res != TS_SUCCESS) {
-    snprintf(errbuf, errbufsize, "Can't create new remap instance for plugin \"%s\" - %s", c,
-                 tmpbuf[0] ? tmpbuf : "Unknown plugin error");
-    Warning("Failed to create new instance for plugin %s (not a TS_SUCCESS return)", pi->path);
-    return -8;
-  }
+  if (unique_key)
+    ink_hash_table_insert(plugin_instances, key, inst);
+  ats_free(key);
+  ++num_plugin_instances;
 
-  mp->add_plugin(pi, ih);
+  mp->add_plugin(inst);
 
   return 0;
 }
@@ -1810,6 +2022,12 @@ UrlRewrite::_mappingLookup(MappingsStore &mappings, URL *request_url,
     mapping_container.set(mapping);
     retval = true;
   }
+  if (mappings.regex_filter &&
+      pcre_exec(mappings.regex_filter, mappings.regex_filter_extra, request_host_lower, request_host_len,
+                0, 0, NULL, 0) == PCRE_ERROR_NOMATCH) {
+    Debug("url_rewrite_regex", "Request URL host [%.*s] matches no regex mapping", request_host_len, request_host_lower);
+    return retval;
+  }
   if (_regexMappingLookup(mappings.regex_list, request_url, request_port, request_host_lower, request_host_len,
                           rank_ceiling, mapping_container)) {
     Debug("url_rewrite", "Using regex mapping with rank %d", (mapping_container.getMapping())->getRank());
@@ -1962,7 +2180,7 @@ UrlRewrite::_destroyList(RegexMappingList &mappings)
       pcre_free(list_iter->re);
     }
     if (list_iter->re_extra) {
-      pcre_free(list_iter->re_extra);
+      regex_free_study(list_iter->re_extra);
     }
     if (list_iter->to_url_host_template) {
       ats_free(list_iter->to_url_host_template);
@@ -1972,6 +2190,86 @@ UrlRewrite::_destroyList(RegexMappingList &mappings)
   mappings.clear();
 }
 
+/** Compiles the host patterns of all the regex mappings in store into
+    a single "(?:re1)|(?:re2)|..." pattern. Most requests match none of
+    the regex mappings, and this rejects them with one pcre_exec()
+    instead of one per mapping. Patterns that refer to their own groups
+    by number would see the wrong groups once concatenated, so no filter
+    is built when any mapping uses one.
+*/
+void
+UrlRewrite::_buildRegexFilter(MappingsStore &store)
+{
+  const char *str;
+  int str_index;
+  int len = 0;
+  int n = 0;
+
+  _destroyRegexFilter(store);
+
+  forl_LL(RegexMapping, list_iter, store.regex_list) {
+    int host_len;
+    const char *host = list_iter->url_map->fromURL.host_get(&host_len);
+
+    for (int i = 0; i + 1 < host_len; ++i) {
+      if ((host[i] == '\\' && (ParseRules::is_digit(host[i + 1]) || host[i + 1] == 'g' || host[i + 1] == 'k')) ||
+          (host[i] == '(' && host[i + 1] == '?' && i + 2 < host_len &&
+           (ParseRules::is_digit(host[i + 2]) || host[i + 2] == 'R' || host[i + 2] == 'P' ||
+            host[i + 2] == '+' || host[i + 2] == '-' || host[i + 2] == '&'))) {
+        Debug("url_rewrite_regex", "Not building a regex filter, [%.*s] refers to its own groups", host_len, host);
+        return;
+      }
+    }
+    len += host_len + 6;
+    ++n;
+  }
+
+  if (n < 2) {
+    return;
+  }
+
+  char *pattern = (char *)ats_malloc(len + 1);
+  char *p = pattern;
+
+  forl_LL(RegexMapping, list_iter, store.regex_list) {
+    int host_len;
+    const char *host = list_iter->url_map->fromURL.host_get(&host_len);
+
+    if (p != pattern) {
+      *p++ = '|';
+    }
+    memcpy(p, "(?:", 3);
+    p += 3;
+    // fromURL holds the lower cased host, exactly as it was compiled
+    memcpy(p, host, host_len);
+    p += host_len;
+    *p++ = ')';
+  }
+  *p = '\0';
+
+  store.regex_filter = pcre_compile(pattern, 0, &str, &str_index, NULL);
+  if (store.regex_filter == NULL) {
+    Debug("url_rewrite_regex", "Could not compile the regex filter: %s", str);
+  } else {
+    store.regex_filter_extra = pcre_study(store.regex_filter, REGEX_STUDY_FLAGS, &str);
+    Debug("url_rewrite_regex", "Built a regex filter over %d mappings", n);
+  }
+  ats_free(pattern);
+}
+
+void
+UrlRewrite::_destroyRegexFilter(MappingsStore &store)
+{
+  if (store.regex_filter) {
+    pcre_free(store.regex_filter);
+    store.regex_filter = NULL;
+  }
+  if (store.regex_filter_extra) {
+    regex_free_study(store.regex_filter_extra);
+    store.regex_filter_extra = NULL;
+  }
+}
+
 /** will process the regex mapping configuration and create objects in
     output argument reg_map. It assumes existing data in reg_map is
     inconsequential and will be perfunctorily null-ed;
@@ -2003,7 +2301,7 @@ UrlRewrite::_processRegexMappingConfig(const char *from_host_lower, url_mapping
     goto lFail;
   }
 
-  reg_map->re_extra = pcre_study(reg_map->re, 0, &str);
+  reg_map->re_extra = pcre_study(reg_map->re, REGEX_STUDY_FLAGS, &str);
   if ((reg_map->re_extra == NULL) && (str != NULL)) {
     Warning("pcre_study failed with message [%s]", str);
     goto lFail;
@@ -2056,7 +2354,7 @@ UrlRewrite::_processRegexMappingConfig(const char *from_host_lower, url_mapping
     reg_map->re = NULL;
   }
   if (reg_map->re_extra) {
-    pcre_free(reg_map->re_extra);
+    regex_free_study(reg_map->re_extra);
     reg_map->re_extra = NULL;
   }
   if (reg_map->to_url_host_template) {
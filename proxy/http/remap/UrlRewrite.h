@@ -66,7 +66,7 @@ enum mapping_type
 class UrlRewrite
 {
 public:
-  UrlRewrite(const char *file_var_in);
+  UrlRewrite(const char *file_var_in, UrlRewrite *prev = NULL);
   ~UrlRewrite();
   int BuildTable();
   mapping_type Remap_redirect(HTTPHdr * request_header, URL *redirect_url);
@@ -108,6 +108,10 @@ public:
   {
     InkHashTable *hash_lookup;
     RegexMappingList regex_list;
+    // all of regex_list's host patterns as one alternation; a request
+    // host it does not match cannot match any single regex mapping
+    pcre *regex_filter;
+    pcre_extra *regex_filter_extra;
     bool empty() { return ((hash_lookup == NULL) && regex_list.empty()); }
   };
 
@@ -120,6 +124,7 @@ public:
   {
     _destroyTable(store.hash_lookup);
     _destroyList(store.regex_list);
+    _destroyRegexFilter(store);
   }
 
   bool TableInsert(InkHashTable *h_table, url_mapping *mapping, const char *src_host);
@@ -186,8 +191,20 @@ public:
   int num_rules_redirect_temporary;
   int num_rules_forward_with_recv_port;
 
+  // Plugin instances of this table by plugin path and parameters, for other rules with the same
+  // plugin and parameters and for the next reload to take over.
+  InkHashTable *plugin_instances;
+  int share_plugin_instances;   // rules with different URLs but the same parameters share an instance
+  int num_plugin_instances;
+  int num_plugin_instances_reused;
+  int num_plugin_instances_shared;
+
+  // Distinct host names of the forward rules' target URLs, kept resolved by the origin DNS prefetch.
+  InkHashTable *origin_hosts;
+
 private:
   bool _valid;
+  UrlRewrite *_prev;            // the table being replaced, while this one is built
   bool _mappingLookup(MappingsStore &mappings, URL *request_url, int request_port, const char *request_host,
                       int request_host_len, UrlMappingContainer &mapping_container);
   url_mapping *_tableLookup(InkHashTable * h_table, URL * request_url, int request_port, char *request_host,
@@ -200,8 +217,11 @@ private:
   bool _processRegexMappingConfig(const char *from_host_lower, url_mapping *new_mapping, RegexMapping *reg_map);
   void _destroyTable(InkHashTable *h_table);
   void _destroyList(RegexMappingList &regexes);
+  void _buildRegexFilter(MappingsStore &store);
+  void _destroyRegexFilter(MappingsStore &store);
   inline bool _addToStore(MappingsStore &store, url_mapping *new_mapping, RegexMapping *reg_map, char *src_host,
                           bool is_cur_mapping_regex, int &count);
+  void _addOriginHost(url_mapping *new_mapping, RegexMapping *reg_map);
 };
 
 void url_rewrite_remap_request(const UrlMappingContainer& mapping_container, URL * request_url);
@@ -0,0 +1,918 @@
+/** @file
+
+  HPACK header compression for HTTP/2 (RFC 7541).
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#include "HPACK.h"
+
+#define HPACK_HUFFMAN_SYMBOLS 257
+#define HPACK_HUFFMAN_EOS     256
+#define HPACK_HUFFMAN_MAX_LEN 30
+
+struct HpackStaticEntry
+{
+  const char * name;
+  uint32_t     name_len;
+  const char * value;
+  uint32_t     value_len;
+};
+
+#define HPACK_STATIC_ENTRY(n, v) { n, sizeof(n) - 1, v, sizeof(v) - 1 }
+
+// RFC 7541 Appendix A.
+static const HpackStaticEntry static_table[HPACK_STATIC_TABLE_SIZE] = {
+  HPACK_STATIC_ENTRY(":authority", ""),
+  HPACK_STATIC_ENTRY(":method", "GET"),
+  HPACK_STATIC_ENTRY(":method", "POST"),
+  HPACK_STATIC_ENTRY(":path", "/"),
+  HPACK_STATIC_ENTRY(":path", "/index.html"),
+  HPACK_STATIC_ENTRY(":scheme", "http"),
+  HPACK_STATIC_ENTRY(":scheme", "https"),
+  HPACK_STATIC_ENTRY(":status", "200"),
+  HPACK_STATIC_ENTRY(":status", "204"),
+  HPACK_STATIC_ENTRY(":status", "206"),
+  HPACK_STATIC_ENTRY(":status", "304"),
+  HPACK_STATIC_ENTRY(":status", "400"),
+  HPACK_STATIC_ENTRY(":status", "404"),
+  HPACK_STATIC_ENTRY(":status", "500"),
+  HPACK_STATIC_ENTRY("accept-charset", ""),
+  HPACK_STATIC_ENTRY("accept-encoding", "gzip, deflate"),
+  HPACK_STATIC_ENTRY("accept-language", ""),
+  HPACK_STATIC_ENTRY("accept-ranges", ""),
+  HPACK_STATIC_ENTRY("accept", ""),
+  HPACK_STATIC_ENTRY("access-control-allow-origin", ""),
+  HPACK_STATIC_ENTRY("age", ""),
+  HPACK_STATIC_ENTRY("allow", ""),
+  HPACK_STATIC_ENTRY("authorization", ""),
+  HPACK_STATIC_ENTRY("cache-control", ""),
+  HPACK_STATIC_ENTRY("content-disposition", ""),
+  HPACK_STATIC_ENTRY("content-encoding", ""),
+  HPACK_STATIC_ENTRY("content-language", ""),
+  HPACK_STATIC_ENTRY("content-length", ""),
+  HPACK_STATIC_ENTRY("content-location", ""),
+  HPACK_STATIC_ENTRY("content-range", ""),
+  HPACK_STATIC_ENTRY("content-type", ""),
+  HPACK_STATIC_ENTRY("cookie", ""),
+  HPACK_STATIC_ENTRY("date", ""),
+  HPACK_STATIC_ENTRY("etag", ""),
+  HPACK_STATIC_ENTRY("expect", ""),
+  HPACK_STATIC_ENTRY("expires", ""),
+  HPACK_STATIC_ENTRY("from", ""),
+  HPACK_STATIC_ENTRY("host", ""),
+  HPACK_STATIC_ENTRY("if-match", ""),
+  HPACK_STATIC_ENTRY("if-modified-since", ""),
+  HPACK_STATIC_ENTRY("if-none-match", ""),
+  HPACK_STATIC_ENTRY("if-range", ""),
+  HPACK_STATIC_ENTRY("if-unmodified-since", ""),
+  HPACK_STATIC_ENTRY("last-modified", ""),
+  HPACK_STATIC_ENTRY("link", ""),
+  HPACK_STATIC_ENTRY("location", ""),
+  HPACK_STATIC_ENTRY("max-forwards", ""),
+  HPACK_STATIC_ENTRY("proxy-authenticate", ""),
+  HPACK_STATIC_ENTRY("proxy-authorization", ""),
+  HPACK_STATIC_ENTRY("range", ""),
+  HPACK_STATIC_ENTRY("referer", ""),
+  HPACK_STATIC_ENTRY("refresh", ""),
+  HPACK_STATIC_ENTRY("retry-after", ""),
+  HPACK_STATIC_ENTRY("server", ""),
+  HPACK_STATIC_ENTRY("set-cookie", ""),
+  HPACK_STATIC_ENTRY("strict-transport-security", ""),
+  HPACK_STATIC_ENTRY("transfer-encoding", ""),
+  HPACK_STATIC_ENTRY("user-agent", ""),
+  HPACK_STATIC_ENTRY("vary", ""),
+  HPACK_STATIC_ENTRY("via", ""),
+  HPACK_STATIC_ENTRY("www-authenticate", ""),
+};
+
+// Huffman code for each symbol, indexed by octet value; the last entry is EOS (RFC 7541 Appendix B).
+static const struct {
+  uint32_t code;
+  uint8_t  len;
+} huffman_codes[HPACK_HUFFMAN_SYMBOLS] = {
+  { 0x1ff8, 13 }, { 0x7fffd8, 23 }, { 0xfffffe2, 28 }, { 0xfffffe3, 28 },
+  { 0xfffffe4, 28 }, { 0xfffffe5, 28 }, { 0xfffffe6, 28 }, { 0xfffffe7, 28 },
+  { 0xfffffe8, 28 }, { 0xffffea, 24 }, { 0x3ffffffc, 30 }, { 0xfffffe9, 28 },
+  { 0xfffffea, 28 }, { 0x3ffffffd, 30 }, { 0xfffffeb, 28 }, { 0xfffffec, 28 },
+  { 0xfffffed, 28 }, { 0xfffffee, 28 }, { 0xfffffef, 28 }, { 0xffffff0, 28 },
+  { 0xffffff1, 28 }, { 0xffffff2, 28 }, { 0x3ffffffe, 30 }, { 0xffffff3, 28 },
+  { 0xffffff4, 28 }, { 0xffffff5, 28 }, { 0xffffff6, 28 }, { 0xffffff7, 28 },
+  { 0xffffff8, 28 }, { 0xffffff9, 28 }, { 0xffffffa, 28 }, { 0xffffffb, 28 },
+  { 0x14, 6 }, { 0x3f8, 10 }, { 0x3f9, 10 }, { 0xffa, 12 },
+  { 0x1ff9, 13 }, { 0x15, 6 }, { 0xf8, 8 }, { 0x7fa, 11 },
+  { 0x3fa, 10 }, { 0x3fb, 10 }, { 0xf9, 8 }, { 0x7fb, 11 },
+  { 0xfa, 8 }, { 0x16, 6 }, { 0x17, 6 }, { 0x18, 6 },
+  { 0x0, 5 }, { 0x1, 5 }, { 0x2, 5 }, { 0x19, 6 },
+  { 0x1a, 6 }, { 0x1b, 6 }, { 0x1c, 6 }, { 0x1d, 6 },
+  { 0x1e, 6 }, { 0x1f, 6 }, { 0x5c, 7 }, { 0xfb, 8 },
+  { 0x7ffc, 15 }, { 0x20, 6 }, { 0xffb, 12 }, { 0x3fc, 10 },
+  { 0x1ffa, 13 }, { 0x21, 6 }, { 0x5d, 7 }, { 0x5e, 7 },
+  { 0x5f, 7 }, { 0x60, 7 }, { 0x61, 7 }, { 0x62, 7 },
+  { 0x63, 7 }, { 0x64, 7 }, { 0x65, 7 }, { 0x66, 7 },
+  { 0x67, 7 }, { 0x68, 7 }, { 0x69, 7 }, { 0x6a, 7 },
+  { 0x6b, 7 }, { 0x6c, 7 }, { 0x6d, 7 }, { 0x6e, 7 },
+  { 0x6f, 7 }, { 0x70, 7 }, { 0x71, 7 }, { 0x72, 7 },
+  { 0xfc, 8 }, { 0x73, 7 }, { 0xfd, 8 }, { 0x1ffb, 13 },
+  { 0x7fff0, 19 }, { 0x1ffc, 13 }, { 0x3ffc, 14 }, { 0x22, 6 },
+  { 0x7ffd, 15 }, { 0x3, 5 }, { 0x23, 6 }, { 0x4, 5 },
+  { 0x24, 6 }, { 0x5, 5 }, { 0x25, 6 }, { 0x26, 6 },
+  { 0x27, 6 }, { 0x6, 5 }, { 0x74, 7 }, { 0x75, 7 },
+  { 0x28, 6 }, { 0x29, 6 }, { 0x2a, 6 }, { 0x7, 5 },
+  { 0x2b, 6 }, { 0x76, 7 }, { 0x2c, 6 }, { 0x8, 5 },
+  { 0x9, 5 }, { 0x2d, 6 }, { 0x77, 7 }, { 0x78, 7 },
+  { 0x79, 7 }, { 0x7a, 7 }, { 0x7b, 7 }, { 0x7ffe, 15 },
+  { 0x7fc, 11 }, { 0x3ffd, 14 }, { 0x1ffd, 13 }, { 0xffffffc, 28 },
+  { 0xfffe6, 20 }, { 0x3fffd2, 22 }, { 0xfffe7, 20 }, { 0xfffe8, 20 },
+  { 0x3fffd3, 22 }, { 0x3fffd4, 22 }, { 0x3fffd5, 22 }, { 0x7fffd9, 23 },
+  { 0x3fffd6, 22 }, { 0x7fffda, 23 }, { 0x7fffdb, 23 }, { 0x7fffdc, 23 },
+  { 0x7fffdd, 23 }, { 0x7fffde, 23 }, { 0xffffeb, 24 }, { 0x7fffdf, 23 },
+  { 0xffffec, 24 }, { 0xffffed, 24 }, { 0x3fffd7, 22 }, { 0x7fffe0, 23 },
+  { 0xffffee, 24 }, { 0x7fffe1, 23 }, { 0x7fffe2, 23 }, { 0x7fffe3, 23 },
+  { 0x7fffe4, 23 }, { 0x1fffdc, 21 }, { 0x3fffd8, 22 }, { 0x7fffe5, 23 },
+  { 0x3fffd9, 22 }, { 0x7fffe6, 23 }, { 0x7fffe7, 23 }, { 0xffffef, 24 },
+  { 0x3fffda, 22 }, { 0x1fffdd, 21 }, { 0xfffe9, 20 }, { 0x3fffdb, 22 },
+  { 0x3fffdc, 22 }, { 0x7fffe8, 23 }, { 0x7fffe9, 23 }, { 0x1fffde, 21 },
+  { 0x7fffea, 23 }, { 0x3fffdd, 22 }, { 0x3fffde, 22 }, { 0xfffff0, 24 },
+  { 0x1fffdf, 21 }, { 0x3fffdf, 22 }, { 0x7fffeb, 23 }, { 0x7fffec, 23 },
+  { 0x1fffe0, 21 }, { 0x1fffe1, 21 }, { 0x3fffe0, 22 }, { 0x1fffe2, 21 },
+  { 0x7fffed, 23 }, { 0x3fffe1, 22 }, { 0x7fffee, 23 }, { 0x7fffef, 23 },
+  { 0xfffea, 20 }, { 0x3fffe2, 22 }, { 0x3fffe3, 22 }, { 0x3fffe4, 22 },
+  { 0x7ffff0, 23 }, { 0x3fffe5, 22 }, { 0x3fffe6, 22 }, { 0x7ffff1, 23 },
+  { 0x3ffffe0, 26 }, { 0x3ffffe1, 26 }, { 0xfffeb, 20 }, { 0x7fff1, 19 },
+  { 0x3fffe7, 22 }, { 0x7ffff2, 23 }, { 0x3fffe8, 22 }, { 0x1ffffec, 25 },
+  { 0x3ffffe2, 26 }, { 0x3ffffe3, 26 }, { 0x3ffffe4, 26 }, { 0x7ffffde, 27 },
+  { 0x7ffffdf, 27 }, { 0x3ffffe5, 26 }, { 0xfffff1, 24 }, { 0x1ffffed, 25 },
+  { 0x7fff2, 19 }, { 0x1fffe3, 21 }, { 0x3ffffe6, 26 }, { 0x7ffffe0, 27 },
+  { 0x7ffffe1, 27 }, { 0x3ffffe7, 26 }, { 0x7ffffe2, 27 }, { 0xfffff2, 24 },
+  { 0x1fffe4, 21 }, { 0x1fffe5, 21 }, { 0x3ffffe8, 26 }, { 0x3ffffe9, 26 },
+  { 0xffffffd, 28 }, { 0x7ffffe3, 27 }, { 0x7ffffe4, 27 }, { 0x7ffffe5, 27 },
+  { 0xfffec, 20 }, { 0xfffff3, 24 }, { 0xfffed, 20 }, { 0x1fffe6, 21 },
+  { 0x3fffe9, 22 }, { 0x1fffe7, 21 }, { 0x1fffe8, 21 }, { 0x7ffff3, 23 },
+  { 0x3fffea, 22 }, { 0x3fffeb, 22 }, { 0x1ffffee, 25 }, { 0x1ffffef, 25 },
+  { 0xfffff4, 24 }, { 0xfffff5, 24 }, { 0x3ffffea, 26 }, { 0x7ffff4, 23 },
+  { 0x3ffffeb, 26 }, { 0x7ffffe6, 27 }, { 0x3ffffec, 26 }, { 0x3ffffed, 26 },
+  { 0x7ffffe7, 27 }, { 0x7ffffe8, 27 }, { 0x7ffffe9, 27 }, { 0x7ffffea, 27 },
+  { 0x7ffffeb, 27 }, { 0xffffffe, 28 }, { 0x7ffffec, 27 }, { 0x7ffffed, 27 },
+  { 0x7ffffee, 27 }, { 0x7ffffef, 27 }, { 0x7fffff0, 27 }, { 0x3ffffee, 26 },
+  { 0x3fffffff, 30 },
+};
+
+// The code is canonical, so decoding needs only the number of codes of each length and the
+// symbols ordered by (length, symbol).
+static const uint16_t huffman_count[HPACK_HUFFMAN_MAX_LEN + 1] = {
+  0, 0, 0, 0, 0, 10, 26, 32, 6, 0, 5, 3, 2, 6, 2, 3,
+  0, 0, 0, 3, 8, 13, 26, 29, 12, 4, 15, 19, 29, 0, 4,
+};
+
+static const uint16_t huffman_symbols[HPACK_HUFFMAN_SYMBOLS] = {
+  48, 49, 50, 97, 99, 101, 105, 111, 115, 116, 32, 37, 45, 46, 47, 51,
+  52, 53, 54, 55, 56, 57, 61, 65, 95, 98, 100, 102, 103, 104, 108, 109,
+  110, 112, 114, 117, 58, 66, 67, 68, 69, 70, 71, 72, 73, 74, 75, 76,
+  77, 78, 79, 80, 81, 82, 83, 84, 85, 86, 87, 89, 106, 107, 113, 118,
+  119, 120, 121, 122, 38, 42, 44, 59, 88, 90, 33, 34, 40, 41, 63, 39,
+  43, 124, 35, 62, 0, 36, 64, 91, 93, 126, 94, 125, 60, 96, 123, 92,
+  195, 208, 128, 130, 131, 162, 184, 194, 224, 226, 153, 161, 167, 172, 176, 177,
+  179, 209, 216, 217, 227, 229, 230, 129, 132, 133, 134, 136, 146, 154, 156, 160,
+  163, 164, 169, 170, 173, 178, 181, 185, 186, 187, 189, 190, 196, 198, 228, 232,
+  233, 1, 135, 137, 138, 139, 140, 141, 143, 147, 149, 150, 151, 152, 155, 157,
+  158, 165, 166, 168, 174, 175, 180, 182, 183, 188, 191, 197, 231, 239, 9, 142,
+  144, 145, 148, 159, 171, 206, 215, 225, 236, 237, 199, 207, 234, 235, 192, 193,
+  200, 201, 202, 205, 210, 213, 218, 219, 238, 240, 242, 243, 255, 203, 204, 211,
+  212, 214, 221, 222, 223, 241, 244, 245, 246, 247, 248, 250, 251, 252, 253, 254,
+  2, 3, 4, 5, 6, 7, 8, 11, 12, 14, 15, 16, 17, 18, 19, 20,
+  21, 23, 24, 25, 26, 27, 28, 29, 30, 31, 127, 220, 249, 10, 13, 22,
+  256,
+};
+
+int64_t
+hpack_encode_integer(uint8_t * buf_start, const uint8_t * buf_end, uint32_t value, uint8_t n)
+{
+  const uint32_t prefix = (1u << n) - 1;
+  uint8_t * p = buf_start;
+
+  if (p >= buf_end) {
+    return -1;
+  }
+
+  // The caller ORs the representation bits into the first octet.
+  if (value < prefix) {
+    *p++ = value;
+    return 1;
+  }
+
+  *p++ = prefix;
+  value -= prefix;
+  while (value >= 128) {
+    if (p >= buf_end) {
+      return -1;
+    }
+    *p++ = (value & 0x7f) | 0x80;
+    value >>= 7;
+  }
+
+  if (p >= buf_end) {
+    return -1;
+  }
+  *p++ = value;
+
+  return p - buf_start;
+}
+
+int64_t
+hpack_decode_integer(uint32_t & dst, const uint8_t * buf_start, const uint8_t * buf_end, uint8_t n)
+{
+  const uint32_t prefix = (1u << n) - 1;
+  const uint8_t * p = buf_start;
+  uint64_t value;
+  unsigned shift = 0;
+
+  if (p >= buf_end) {
+    return -1;
+  }
+
+  value = *p++ & prefix;
+  if (value == prefix) {
+    do {
+      // Five continuation octets are enough for any 32 bit value.
+      if (p >= buf_end || shift > 28) {
+        return -1;
+      }
+      value += (uint64_t)(*p & 0x7f) << shift;
+      shift += 7;
+    } while (*p++ & 0x80);
+
+    if (value > UINT32_MAX) {
+      return -1;
+    }
+  }
+
+  dst = (uint32_t)value;
+  return p - buf_start;
+}
+
+uint32_t
+hpack_huffman_encoded_length(const char * src, uint32_t len)
+{
+  uint64_t nbits = 0;
+
+  for (uint32_t i = 0; i < len; ++i) {
+    nbits += huffman_codes[(uint8_t)src[i]].len;
+  }
+
+  return (uint32_t)((nbits + 7) / 8);
+}
+
+int64_t
+hpack_huffman_encode(uint8_t * dst_start, const uint8_t * dst_end, const char * src, uint32_t len)
+{
+  uint8_t * p = dst_start;
+  uint64_t bits = 0;
+  unsigned nbits = 0;
+
+  for (uint32_t i = 0; i < len; ++i) {
+    const uint8_t c = src[i];
+
+    bits = (bits << huffman_codes[c].len) | huffman_codes[c].code;
+    nbits += huffman_codes[c].len;
+    while (nbits >= 8) {
+      if (p >= dst_end) {
+        return -1;
+      }
+      nbits -= 8;
+      *p++ = (uint8_t)(bits >> nbits);
+    }
+  }
+
+  // Pad the last octet with the most significant bits of EOS, which are all ones.
+  if (nbits) {
+    if (p >= dst_end) {
+      return -1;
+    }
+    *p++ = (uint8_t)((bits << (8 - nbits)) | (0xff >> nbits));
+  }
+
+  return p - dst_start;
+}
+
+int64_t
+hpack_huffman_decode(char * dst_start, const char * dst_end, const uint8_t * src, uint32_t len)
+{
+  char * dst = dst_start;
+  uint32_t code = 0;   // bits of the current symbol read so far
+  uint32_t first = 0;  // first code of length nbits
+  uint32_t index = 0;  // position of that code in huffman_symbols
+  unsigned nbits = 0;
+
+  for (uint32_t i = 0; i < len; ++i) {
+    for (int bit = 7; bit >= 0; --bit) {
+      code = (code << 1) | ((src[i] >> bit) & 1);
+      ++nbits;
+
+      if (code - first < huffman_count[nbits]) {
+        uint16_t sym = huffman_symbols[index + code - first];
+
+        if (sym == HPACK_HUFFMAN_EOS || dst >= dst_end) {
+          return -1;
+        }
+        *dst++ = (char)sym;
+        code = first = index = nbits = 0;
+      } else {
+        if (nbits == HPACK_HUFFMAN_MAX_LEN) {
+          return -1;
+        }
+        index += huffman_count[nbits];
+        first = (first + huffman_count[nbits]) << 1;
+      }
+    }
+  }
+
+  // Anything left over must be padding, i.e. fewer than 8 bits of EOS.
+  if (nbits > 7 || code != (1u << nbits) - 1) {
+    return -1;
+  }
+
+  return dst - dst_start;
+}
+
+int64_t
+hpack_encode_string(uint8_t * buf_start, const uint8_t * buf_end, const char * value, uint32_t len)
+{
+  uint32_t encoded_len = hpack_huffman_encoded_length(value, len);
+  bool huffman = encoded_len < len;
+  uint8_t * p = buf_start;
+  int64_t n;
+
+  n = hpack_encode_integer(p, buf_end, huffman ? encoded_len : len, 7);
+  if (n < 0) {
+    return -1;
+  }
+  if (huffman) {
+    *p |= 0x80;
+  }
+  p += n;
+
+  if (huffman) {
+    n = hpack_huffman_encode(p, buf_end, value, len);
+    if (n < 0) {
+      return -1;
+    }
+    p += n;
+  } else {
+    if (buf_end - p < (int64_t)len) {
+      return -1;
+    }
+    memcpy(p, value, len);
+    p += len;
+  }
+
+  return p - buf_start;
+}
+
+bool
+HpackIndexingTable::get(uint32_t index, const char *& name, uint32_t & name_len, const char *& value,
+                        uint32_t & value_len) const
+{
+  if (index == 0) {
+    return false;
+  }
+
+  if (index <= HPACK_STATIC_TABLE_SIZE) {
+    const HpackStaticEntry & e = static_table[index - 1];
+
+    name = e.name;
+    name_len = e.name_len;
+    value = e.value;
+    value_len = e.value_len;
+    return true;
+  }
+
+  index -= HPACK_STATIC_TABLE_SIZE;
+  if (index > nentries) {
+    return false;
+  }
+
+  for (HpackTableEntry * e = entries.head; e; e = e->link.next) {
+    if (--index == 0) {
+      name = e->name();
+      name_len = e->name_len;
+      value = e->value();
+      value_len = e->value_len;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+uint32_t
+HpackIndexingTable::find(const char * name, uint32_t name_len, const char * value, uint32_t value_len,
+                         uint32_t & name_index) const
+{
+  uint32_t index;
+
+  name_index = 0;
+
+  for (index = 1; index <= HPACK_STATIC_TABLE_SIZE; ++index) {
+    const HpackStaticEntry & e = static_table[index - 1];
+
+    if (e.name_len == name_len && memcmp(e.name, name, name_len) == 0) {
+      if (e.value_len == value_len && memcmp(e.value, value, value_len) == 0) {
+        return index;
+      }
+      if (name_index == 0) {
+        name_index = index;
+      }
+    }
+  }
+
+  for (HpackTableEntry * e = entries.head; e; e = e->link.next, ++index) {
+    if (e->name_len == name_len && memcmp(e->name(), name, name_len) == 0) {
+      if (e->value_len == value_len && memcmp(e->value(), value, value_len) == 0) {
+        return index;
+      }
+      if (name_index == 0) {
+        name_index = index;
+      }
+    }
+  }
+
+  return 0;
+}
+
+void
+HpackIndexingTable::add(const char * name, uint32_t name_len, const char * value, uint32_t value_len)
+{
+  uint32_t size = name_len + value_len + HPACK_ENTRY_OVERHEAD;
+  HpackTableEntry * e;
+
+  if (size > max_size) {
+    clear();
+    return;
+  }
+
+  evict(size);
+
+  e = (HpackTableEntry *)ats_malloc(sizeof(HpackTableEntry) + name_len + value_len);
+  e->name_len = name_len;
+  e->value_len = value_len;
+  e->link.next = e->link.prev = NULL;
+  memcpy(reinterpret_cast<char *>(e + 1), name, name_len);
+  memcpy(reinterpret_cast<char *>(e + 1) + name_len, value, value_len);
+
+  entries.push(e);
+  nentries++;
+  used += size;
+}
+
+void
+HpackIndexingTable::evict(uint32_t needed)
+{
+  while (used + needed > max_size && entries.tail) {
+    HpackTableEntry * e = entries.tail;
+
+    entries.remove(e);
+    nentries--;
+    used -= e->size();
+    ats_free(e);
+  }
+}
+
+void
+HpackIndexingTable::set_max_size(uint32_t size)
+{
+  max_size = size;
+  evict(0);
+}
+
+void
+HpackIndexingTable::clear()
+{
+  HpackTableEntry * e;
+
+  while ((e = entries.pop())) {
+    ats_free(e);
+  }
+
+  nentries = 0;
+  used = 0;
+}
+
+char *
+HpackDecoder::reserve(uint32_t size)
+{
+  if (size >= scratch_size) {
+    scratch_size = size + 256;
+    scratch = (char *)ats_realloc(scratch, scratch_size);
+  }
+
+  return scratch;
+}
+
+int64_t
+HpackDecoder::decode_string(const uint8_t * buf_start, const uint8_t * buf_end, uint32_t offset, uint32_t & len)
+{
+  uint32_t encoded_len;
+  int64_t n;
+  bool huffman;
+
+  if (buf_start >= buf_end) {
+    return -1;
+  }
+
+  huffman = *buf_start & 0x80;
+  n = hpack_decode_integer(encoded_len, buf_start, buf_end, 7);
+  if (n < 0 || encoded_len > buf_end - buf_start - n) {
+    return -1;
+  }
+
+  if (huffman) {
+    // The shortest code is 5 bits.
+    uint32_t bound = (uint32_t)(((uint64_t)encoded_len * 8) / 5);
+    char * dst = reserve(offset + bound) + offset;
+    int64_t r = hpack_huffman_decode(dst, dst + bound, buf_start + n, encoded_len);
+
+    if (r < 0) {
+      return -1;
+    }
+    len = (uint32_t)r;
+  } else {
+    memcpy(reserve(offset + encoded_len) + offset, buf_start + n, encoded_len);
+    len = encoded_len;
+  }
+
+  return n + encoded_len;
+}
+
+int64_t
+HpackDecoder::decode(const uint8_t * buf_start, const uint8_t * buf_end, HpackField & field)
+{
+  const uint8_t * p = buf_start;
+  uint32_t index;
+  uint32_t name_len;
+  uint32_t value_len;
+  bool indexing;
+  int64_t n;
+
+  field = HpackField();
+
+  // Dynamic table size update: 001xxxxx.
+  while (p < buf_end && (*p & 0xe0) == 0x20) {
+    uint32_t size;
+
+    n = hpack_decode_integer(size, p, buf_end, 5);
+    if (n < 0 || size > table_limit) {
+      return -1;
+    }
+    table.set_max_size(size);
+    p += n;
+  }
+
+  if (p >= buf_end) {
+    return p - buf_start;
+  }
+
+  // Indexed header field: 1xxxxxxx.
+  if (*p & 0x80) {
+    n = hpack_decode_integer(index, p, buf_end, 7);
+    if (n < 0 || !table.get(index, field.name, field.name_len, field.value, field.value_len)) {
+      return -1;
+    }
+    return p + n - buf_start;
+  }
+
+  // Literal with incremental indexing is 01xxxxxx; without indexing 0000xxxx and never indexed
+  // 0001xxxx only differ in what an intermediary may do with them.
+  indexing = *p & 0x40;
+  n = hpack_decode_integer(index, p, buf_end, indexing ? 6 : 4);
+  if (n < 0) {
+    return -1;
+  }
+  p += n;
+
+  // Copy the name out of the table as well, since the insert below may evict the entry it came from.
+  if (index) {
+    const char * name;
+    const char * value;
+
+    if (!table.get(index, name, name_len, value, value_len)) {
+      return -1;
+    }
+    memcpy(reserve(name_len), name, name_len);
+  } else {
+    n = decode_string(p, buf_end, 0, name_len);
+    if (n < 0) {
+      return -1;
+    }
+    p += n;
+  }
+
+  n = decode_string(p, buf_end, name_len, value_len);
+  if (n < 0) {
+    return -1;
+  }
+  p += n;
+
+  if (indexing) {
+    table.add(scratch, name_len, scratch + name_len, value_len);
+  }
+
+  field.name = scratch;
+  field.name_len = name_len;
+  field.value = scratch + name_len;
+  field.value_len = value_len;
+
+  return p - buf_start;
+}
+
+void
+HpackDecoder::clear()
+{
+  table.clear();
+  ats_free(scratch);
+  scratch = NULL;
+  scratch_size = 0;
+}
+
+void
+HpackEncoder::set_max_size(uint32_t size)
+{
+  if (size != table.get_max_size()) {
+    table.set_max_size(size);
+    size_update = true;
+  }
+}
+
+int64_t
+HpackEncoder::begin_block(uint8_t * buf_start, const uint8_t * buf_end)
+{
+  int64_t n = 0;
+
+  if (size_update) {
+    n = hpack_encode_integer(buf_start, buf_end, table.get_max_size(), 5);
+    if (n < 0) {
+      return -1;
+    }
+    *buf_start |= 0x20;
+    size_update = false;
+  }
+
+  return n;
+}
+
+int64_t
+HpackEncoder::encode(uint8_t * buf_start, const uint8_t * buf_end, const char * name, uint32_t name_len,
+                     const char * value, uint32_t value_len)
+{
+  uint8_t * p = buf_start;
+  uint32_t name_index;
+  uint32_t index;
+  bool indexing;
+  int64_t n;
+
+  index = table.find(name, name_len, value, value_len, name_index);
+  if (index) {
+    n = hpack_encode_integer(p, buf_end, index, 7);
+    if (n < 0) {
+      return -1;
+    }
+    *p |= 0x80;
+    return n;
+  }
+
+  // A field that takes up more than a quarter of the table would mostly push out entries that
+  // are more likely to be reused, so send it without indexing.
+  indexing = (name_len + value_len + HPACK_ENTRY_OVERHEAD) <= table.get_max_size() / 4;
+
+  n = hpack_encode_integer(p, buf_end, name_index, indexing ? 6 : 4);
+  if (n < 0) {
+    return -1;
+  }
+  if (indexing) {
+    *p |= 0x40;
+  }
+  p += n;
+
+  if (name_index == 0) {
+    n = hpack_encode_string(p, buf_end, name, name_len);
+    if (n < 0) {
+      return -1;
+    }
+    p += n;
+  }
+
+  n = hpack_encode_string(p, buf_end, value, value_len);
+  if (n < 0) {
+    return -1;
+  }
+  p += n;
+
+  if (indexing) {
+    table.add(name, name_len, value, value_len);
+  }
+
+  return p - buf_start;
+}
+
+#if TS_HAS_TESTS
+#include "ts/TestBox.h"
+
+struct HpackTestField
+{
+  const char * name;
+  const char * value;
+};
+
+// RFC 7541 Appendix C.1.
+REGRESSION_TEST(HPACK_Integer)(RegressionTest * t, int /* atype ATS_UNUSED */, int * pstatus)
+{
+  static const struct {
+    uint32_t value;
+    uint8_t  prefix;
+    uint8_t  encoded[4];
+    int64_t  len;
+  } tests[] = {
+    { 10, 5, { 0x0a }, 1 },
+    { 1337, 5, { 0x1f, 0x9a, 0x0a }, 3 },
+    { 42, 8, { 0x2a }, 1 },
+  };
+
+  TestBox box(t, pstatus);
+  box = REGRESSION_TEST_PASSED;
+
+  for (unsigned i = 0; i < countof(tests); ++i) {
+    uint8_t buf[8];
+    uint32_t value = 0;
+    int64_t n = hpack_encode_integer(buf, buf + sizeof(buf), tests[i].value, tests[i].prefix);
+
+    box.check(n == tests[i].len && memcmp(buf, tests[i].encoded, n) == 0, "encoding %u with a %u bit prefix",
+              tests[i].value, tests[i].prefix);
+
+    n = hpack_decode_integer(value, tests[i].encoded, tests[i].encoded + tests[i].len, tests[i].prefix);
+    box.check(n == tests[i].len && value == tests[i].value, "decoding %u with a %u bit prefix", tests[i].value,
+              tests[i].prefix);
+
+    n = hpack_decode_integer(value, tests[i].encoded, tests[i].encoded + tests[i].len - 1, tests[i].prefix);
+    box.check(n == -1 || tests[i].len == 1, "decoded a truncated %u", tests[i].value);
+  }
+}
+
+// RFC 7541 Appendix C.4.
+REGRESSION_TEST(HPACK_Huffman)(RegressionTest * t, int /* atype ATS_UNUSED */, int * pstatus)
+{
+  static const struct {
+    const char * text;
+    uint8_t      encoded[16];
+    int64_t      len;
+  } tests[] = {
+    { "www.example.com", { 0xf1, 0xe3, 0xc2, 0xe5, 0xf2, 0x3a, 0x6b, 0xa0, 0xab, 0x90, 0xf4, 0xff }, 12 },
+    { "no-cache", { 0xa8, 0xeb, 0x10, 0x64, 0x9c, 0xbf }, 6 },
+    { "custom-key", { 0x25, 0xa8, 0x49, 0xe9, 0x5b, 0xa9, 0x7d, 0x7f }, 8 },
+    { "custom-value", { 0x25, 0xa8, 0x49, 0xe9, 0x5b, 0xb8, 0xe8, 0xb4, 0xbf }, 9 },
+  };
+
+  TestBox box(t, pstatus);
+  box = REGRESSION_TEST_PASSED;
+
+  for (unsigned i = 0; i < countof(tests); ++i) {
+    uint32_t len = strlen(tests[i].text);
+    uint8_t encoded[32];
+    char decoded[32];
+    int64_t n;
+
+    box.check(hpack_huffman_encoded_length(tests[i].text, len) == tests[i].len, "length of '%s'", tests[i].text);
+
+    n = hpack_huffman_encode(encoded, encoded + sizeof(encoded), tests[i].text, len);
+    box.check(n == tests[i].len && memcmp(encoded, tests[i].encoded, n) == 0, "encoding '%s'", tests[i].text);
+
+    n = hpack_huffman_decode(decoded, decoded + sizeof(decoded), tests[i].encoded, tests[i].len);
+    box.check(n == len && memcmp(decoded, tests[i].text, len) == 0, "decoding '%s'", tests[i].text);
+  }
+
+  // Padding longer than 7 bits, or padding that is not a prefix of EOS, is an error.
+  static const uint8_t overpadded[] = { 0x1f, 0xff };
+  static const uint8_t badpad[] = { 0x1e };
+  char decoded[8];
+
+  box.check(hpack_huffman_decode(decoded, decoded + sizeof(decoded), overpadded, sizeof(overpadded)) == -1,
+            "decoded 8 bits of padding");
+  box.check(hpack_huffman_decode(decoded, decoded + sizeof(decoded), badpad, sizeof(badpad)) == -1,
+            "decoded padding that is not EOS");
+}
+
+// The three requests of RFC 7541 Appendix C.4 share one dynamic table, so check the exact
+// octets in both directions.
+REGRESSION_TEST(HPACK_HeaderBlock)(RegressionTest * t, int /* atype ATS_UNUSED */, int * pstatus)
+{
+  static const HpackTestField req1[] = {
+    { ":method", "GET" }, { ":scheme", "http" }, { ":path", "/" }, { ":authority", "www.example.com" },
+  };
+  static const HpackTestField req2[] = {
+    { ":method", "GET" }, { ":scheme", "http" }, { ":path", "/" }, { ":authority", "www.example.com" },
+    { "cache-control", "no-cache" },
+  };
+  static const HpackTestField req3[] = {
+    { ":method", "GET" }, { ":scheme", "https" }, { ":path", "/index.html" }, { ":authority", "www.example.com" },
+    { "custom-key", "custom-value" },
+  };
+  static const uint8_t block1[] = {
+    0x82, 0x86, 0x84, 0x41, 0x8c, 0xf1, 0xe3, 0xc2, 0xe5, 0xf2, 0x3a, 0x6b, 0xa0, 0xab, 0x90, 0xf4, 0xff,
+  };
+  static const uint8_t block2[] = {
+    0x82, 0x86, 0x84, 0xbe, 0x58, 0x86, 0xa8, 0xeb, 0x10, 0x64, 0x9c, 0xbf,
+  };
+  static const uint8_t block3[] = {
+    0x82, 0x87, 0x85, 0xbf, 0x40, 0x88, 0x25, 0xa8, 0x49, 0xe9, 0x5b, 0xa9, 0x7d, 0x7f, 0x89, 0x25, 0xa8, 0x49,
+    0xe9, 0x5b, 0xb8, 0xe8, 0xb4, 0xbf,
+  };
+  static const struct {
+    const HpackTestField * fields;
+    unsigned               nfields;
+    const uint8_t *        block;
+    unsigned               len;
+    uint32_t               table_size;
+  } tests[] = {
+    { req1, countof(req1), block1, sizeof(block1), 57 },
+    { req2, countof(req2), block2, sizeof(block2), 110 },
+    { req3, countof(req3), block3, sizeof(block3), 164 },
+  };
+
+  TestBox box(t, pstatus);
+  HpackEncoder encoder;
+  HpackDecoder decoder;
+
+  box = REGRESSION_TEST_PASSED;
+
+  for (unsigned i = 0; i < countof(tests); ++i) {
+    uint8_t block[64];
+    uint8_t * p = block;
+    const uint8_t * q = tests[i].block;
+    const uint8_t * end = tests[i].block + tests[i].len;
+
+    p += encoder.begin_block(p, block + sizeof(block));
+    for (unsigned j = 0; j < tests[i].nfields; ++j) {
+      const HpackTestField & f = tests[i].fields[j];
+      int64_t n = encoder.encode(p, block + sizeof(block), f.name, strlen(f.name), f.value, strlen(f.value));
+
+      box.check(n > 0, "request %u: failed to encode %s", i + 1, f.name);
+      p += n > 0 ? n : 0;
+    }
+    box.check(p - block == tests[i].len && memcmp(block, tests[i].block, tests[i].len) == 0,
+              "request %u: encoded the wrong header block", i + 1);
+    box.check(encoder.table.get_size() == tests[i].table_size, "request %u: encoder table size %u", i + 1,
+              encoder.table.get_size());
+
+    for (unsigned j = 0; j < tests[i].nfields; ++j) {
+      const HpackTestField & f = tests[i].fields[j];
+      HpackField field;
+      int64_t n = decoder.decode(q, end, field);
+
+      if (!box.check(n > 0 && field.name, "request %u: failed to decode %s", i + 1, f.name)) {
+        break;
+      }
+      box.check(field.name_len == strlen(f.name) && memcmp(field.name, f.name, field.name_len) == 0 &&
+                field.value_len == strlen(f.value) && memcmp(field.value, f.value, field.value_len) == 0,
+                "request %u: decoded %.*s: %.*s instead of %s: %s", i + 1, field.name_len, field.name,
+                field.value_len, field.value, f.name, f.value);
+      q += n;
+    }
+    box.check(q == end, "request %u: header block not consumed", i + 1);
+    box.check(decoder.table.get_size() == tests[i].table_size, "request %u: decoder table size %u", i + 1,
+              decoder.table.get_size());
+  }
+
+  // Shrinking the table evicts the oldest entries first and is announced in the next block.
+  uint8_t update[8];
+  HpackField field;
+
+  encoder.set_max_size(110);
+  box.check(encoder.table.length() == 2, "shrinking the table kept %u entries", encoder.table.length());
+  box.check(encoder.begin_block(update, update + sizeof(update)) == 2 && update[0] == 0x3f && update[1] == 0x4f,
+            "table size update was not encoded");
+  box.check(decoder.decode(update, update + 2, field) == 2 && field.name == NULL, "table size update was not decoded");
+  box.check(decoder.table.length() == 2 && decoder.table.get_size() == 107, "decoder table was not shrunk");
+
+  // A decoder must refuse to grow the table beyond what we advertised.
+  update[0] = 0x3f;
+  update[1] = 0xe2; // 4097
+  update[2] = 0x1f;
+  box.check(decoder.decode(update, update + 3, field) == -1, "decoder accepted a table larger than its limit");
+}
+
+#endif /* TS_HAS_TESTS */
@@ -0,0 +1,173 @@
+/** @file
+
+  HPACK header compression for HTTP/2 (RFC 7541).
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#ifndef __HPACK_H__
+#define __HPACK_H__
+
+#include "libts.h"
+
+// SETTINGS_HEADER_TABLE_SIZE until the peer says otherwise.
+#define HPACK_DEFAULT_TABLE_SIZE  4096
+
+// Every dynamic table entry is charged this much on top of its name and value.
+#define HPACK_ENTRY_OVERHEAD      32
+
+#define HPACK_STATIC_TABLE_SIZE   61
+
+// Integer and string primitives (RFC 7541 section 5). The encoders return the number of bytes
+// written, the decoders the number of bytes consumed; all of them return -1 if the buffer is
+// too short or the input is malformed.
+int64_t hpack_encode_integer(uint8_t * buf_start, const uint8_t * buf_end, uint32_t value, uint8_t n);
+int64_t hpack_decode_integer(uint32_t & dst, const uint8_t * buf_start, const uint8_t * buf_end, uint8_t n);
+
+int64_t hpack_encode_string(uint8_t * buf_start, const uint8_t * buf_end, const char * value, uint32_t len);
+
+// Huffman coding of string literals (RFC 7541 section 5.2).
+uint32_t hpack_huffman_encoded_length(const char * src, uint32_t len);
+int64_t hpack_huffman_encode(uint8_t * dst_start, const uint8_t * dst_end, const char * src, uint32_t len);
+int64_t hpack_huffman_decode(char * dst_start, const char * dst_end, const uint8_t * src, uint32_t len);
+
+// A decoded header field. The strings are not NUL terminated and only stay valid until the next
+// call into the decoder that produced them.
+struct HpackField
+{
+  const char * name;
+  uint32_t     name_len;
+  const char * value;
+  uint32_t     value_len;
+
+  HpackField() : name(NULL), name_len(0), value(NULL), value_len(0) { }
+};
+
+struct HpackTableEntry
+{
+  uint32_t name_len;
+  uint32_t value_len;
+  LINK(HpackTableEntry, link);
+
+  // The name and value are stored right after the entry.
+  const char * name() const { return reinterpret_cast<const char *>(this + 1); }
+  const char * value() const { return name() + name_len; }
+  uint32_t size() const { return name_len + value_len + HPACK_ENTRY_OVERHEAD; }
+};
+
+// The static table followed by the dynamic table, addressed by the 1-based index of RFC 7541
+// section 2.3.3. The dynamic table holds at most a few hundred entries, so it is a plain list
+// with the newest entry at the head.
+class HpackIndexingTable
+{
+public:
+  HpackIndexingTable() : nentries(0), used(0), max_size(HPACK_DEFAULT_TABLE_SIZE) { }
+  ~HpackIndexingTable() { clear(); }
+
+  // Return false if index does not address an entry.
+  bool get(uint32_t index, const char *& name, uint32_t & name_len, const char *& value, uint32_t & value_len) const;
+
+  // Return the index of an entry matching both name and value, or failing that the index of an
+  // entry with the same name in name_index. Either is 0 when there is no such entry.
+  uint32_t find(const char * name, uint32_t name_len, const char * value, uint32_t value_len,
+                uint32_t & name_index) const;
+
+  // Insert a new entry, evicting old ones to make room. An entry larger than the whole table
+  // just empties it.
+  void add(const char * name, uint32_t name_len, const char * value, uint32_t value_len);
+
+  void set_max_size(uint32_t size);
+  uint32_t get_max_size() const { return max_size; }
+  uint32_t get_size() const { return used; }
+  uint32_t length() const { return nentries; }
+
+  void clear();
+
+private:
+  void evict(uint32_t needed);
+
+  Queue<HpackTableEntry> entries;
+  uint32_t nentries;
+  uint32_t used;
+  uint32_t max_size;
+
+  HpackIndexingTable(const HpackIndexingTable &);
+  HpackIndexingTable & operator=(const HpackIndexingTable &);
+};
+
+class HpackDecoder
+{
+public:
+  // limit is the table size we advertised in SETTINGS_HEADER_TABLE_SIZE; the encoder may shrink
+  // the table below it but never grow it past.
+  explicit HpackDecoder(uint32_t limit = HPACK_DEFAULT_TABLE_SIZE)
+    : table_limit(limit), scratch(NULL), scratch_size(0) { }
+  ~HpackDecoder() { clear(); }
+
+  // Decode the next field of a header block. Returns the number of bytes consumed, or -1 on a
+  // compression error, after which the connection has to go. Dynamic table size updates are
+  // applied as they are read; if the buffer holds nothing else field.name is NULL.
+  int64_t decode(const uint8_t * buf_start, const uint8_t * buf_end, HpackField & field);
+
+  void clear();
+
+  HpackIndexingTable table;
+
+private:
+  char * reserve(uint32_t size);
+  // Decode a string literal into the scratch buffer at offset.
+  int64_t decode_string(const uint8_t * buf_start, const uint8_t * buf_end, uint32_t offset, uint32_t & len);
+
+  uint32_t table_limit;
+  char * scratch;
+  uint32_t scratch_size;
+
+  HpackDecoder(const HpackDecoder &);
+  HpackDecoder & operator=(const HpackDecoder &);
+};
+
+class HpackEncoder
+{
+public:
+  HpackEncoder() : size_update(false) { }
+
+  // Follow a new SETTINGS_HEADER_TABLE_SIZE from the peer. The change is announced at the start
+  // of the next header block.
+  void set_max_size(uint32_t size);
+
+  // Start a header block; this has to come before the first field of every block. Returns the
+  // number of bytes written or -1 if the buffer is too short.
+  int64_t begin_block(uint8_t * buf_start, const uint8_t * buf_end);
+
+  // Append one field. The name must already be lower case.
+  int64_t encode(uint8_t * buf_start, const uint8_t * buf_end, const char * name, uint32_t name_len,
+                 const char * value, uint32_t value_len);
+
+  void clear() { table.clear(); }
+
+  HpackIndexingTable table;
+
+private:
+  bool size_update;
+
+  HpackEncoder(const HpackEncoder &);
+  HpackEncoder & operator=(const HpackEncoder &);
+};
+
+#endif /* __HPACK_H__ */
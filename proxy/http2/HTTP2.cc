@@ -0,0 +1,721 @@
+/** @file
+
+  HTTP/2 protocol constants, framing and header conversion (RFC 7540).
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#include "HTTP2.h"
+#include "P_RecCore.h"
+
+uint32_t Http2::max_concurrent_streams = 100;
+uint32_t Http2::initial_window_size = HTTP2_INITIAL_WINDOW_SIZE;
+uint32_t Http2::no_activity_timeout_in = 115;
+uint32_t Http2::max_concurrent_streams_out = 100;
+uint32_t Http2::initial_window_size_out = HTTP2_INITIAL_WINDOW_SIZE;
+uint32_t Http2::no_activity_timeout_out = 30;
+
+void
+Http2::init()
+{
+  REC_ReadConfigInteger(max_concurrent_streams, "proxy.config.http2.max_concurrent_streams_in");
+  REC_ReadConfigInteger(initial_window_size, "proxy.config.http2.initial_window_size_in");
+  REC_ReadConfigInteger(no_activity_timeout_in, "proxy.config.http2.no_activity_timeout_in");
+  REC_ReadConfigInteger(max_concurrent_streams_out, "proxy.config.http2.max_concurrent_streams_out");
+  REC_ReadConfigInteger(initial_window_size_out, "proxy.config.http2.initial_window_size_out");
+  REC_ReadConfigInteger(no_activity_timeout_out, "proxy.config.http2.no_activity_timeout_out");
+
+  if (initial_window_size > HTTP2_MAX_WINDOW_SIZE) {
+    Warning("proxy.config.http2.initial_window_size_in is larger than %u, using %u", HTTP2_MAX_WINDOW_SIZE,
+            HTTP2_MAX_WINDOW_SIZE);
+    initial_window_size = HTTP2_MAX_WINDOW_SIZE;
+  }
+  if (initial_window_size_out > HTTP2_MAX_WINDOW_SIZE) {
+    Warning("proxy.config.http2.initial_window_size_out is larger than %u, using %u", HTTP2_MAX_WINDOW_SIZE,
+            HTTP2_MAX_WINDOW_SIZE);
+    initial_window_size_out = HTTP2_MAX_WINDOW_SIZE;
+  }
+}
+
+void
+http2_parse_frame_header(const uint8_t * buf, Http2FrameHeader & hdr)
+{
+  hdr.length = ((uint32_t)buf[0] << 16) | ((uint32_t)buf[1] << 8) | (uint32_t)buf[2];
+  hdr.type = buf[3];
+  hdr.flags = buf[4];
+  hdr.streamid = http2_read_u32(buf + 5) & 0x7fffffff;
+}
+
+void
+http2_write_frame_header(const Http2FrameHeader & hdr, uint8_t * buf)
+{
+  buf[0] = (uint8_t)(hdr.length >> 16);
+  buf[1] = (uint8_t)(hdr.length >> 8);
+  buf[2] = (uint8_t)hdr.length;
+  buf[3] = hdr.type;
+  buf[4] = hdr.flags;
+  http2_write_u32(hdr.streamid & 0x7fffffff, buf + 5);
+}
+
+static bool
+http2_field_equals(const char * name, uint32_t len, const char * str, uint32_t str_len)
+{
+  return len == str_len && memcmp(name, str, len) == 0;
+}
+
+#define HTTP2_FIELD_EQUALS(_name, _len, _str) http2_field_equals(_name, _len, _str, sizeof(_str) - 1)
+
+// These only make sense on a single HTTP/1 connection and must not appear in HTTP/2 (RFC 7540
+// section 8.1.2.2).
+static bool
+http2_is_connection_field(const char * name, uint32_t len)
+{
+  return HTTP2_FIELD_EQUALS(name, len, "connection") || HTTP2_FIELD_EQUALS(name, len, "keep-alive") ||
+    HTTP2_FIELD_EQUALS(name, len, "proxy-connection") || HTTP2_FIELD_EQUALS(name, len, "transfer-encoding") ||
+    HTTP2_FIELD_EQUALS(name, len, "upgrade");
+}
+
+// We hand the request to the state machine as HTTP/1 text, so anything that could end a line
+// early or split the request line has to be refused here.
+static bool
+http2_valid_field_name(const char * name, uint32_t len)
+{
+  if (len == 0) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < len; ++i) {
+    if (!ParseRules::is_token(name[i]) || ParseRules::is_upalpha(name[i])) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static bool
+http2_valid_field_value(const char * value, uint32_t len)
+{
+  for (uint32_t i = 0; i < len; ++i) {
+    if (value[i] == '\r' || value[i] == '\n' || value[i] == '\0') {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static bool
+http2_valid_request_token(const char * value, uint32_t len)
+{
+  if (len == 0) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < len; ++i) {
+    if (ParseRules::is_ws(value[i]) || ParseRules::is_cr(value[i]) || ParseRules::is_lf(value[i]) ||
+        value[i] == '\0') {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+enum
+{
+  HTTP2_PSEUDO_METHOD,
+  HTTP2_PSEUDO_SCHEME,
+  HTTP2_PSEUDO_AUTHORITY,
+  HTTP2_PSEUDO_PATH,
+  HTTP2_PSEUDO_MAX
+};
+
+static const struct {
+  const char * name;
+  uint32_t     len;
+} http2_pseudo_fields[HTTP2_PSEUDO_MAX] = {
+  { ":method", 7 }, { ":scheme", 7 }, { ":authority", 10 }, { ":path", 5 },
+};
+
+struct Http2PseudoFields
+{
+  char *   value[HTTP2_PSEUDO_MAX];
+  uint32_t len[HTTP2_PSEUDO_MAX];
+
+  Http2PseudoFields() {
+    memset(value, 0, sizeof(value));
+    memset(len, 0, sizeof(len));
+  }
+
+  ~Http2PseudoFields() {
+    for (unsigned i = 0; i < HTTP2_PSEUDO_MAX; ++i) {
+      ats_free(value[i]);
+    }
+  }
+};
+
+static bool
+http2_write_request_line(const Http2PseudoFields & pseudo, MIOBuffer * request)
+{
+  const char * method = pseudo.value[HTTP2_PSEUDO_METHOD];
+  const char * path = pseudo.value[HTTP2_PSEUDO_PATH];
+
+  // CONNECT would need a tunnel rather than a transaction, and is not supported.
+  if (!method || !path || !pseudo.value[HTTP2_PSEUDO_SCHEME] ||
+      HTTP2_FIELD_EQUALS(method, pseudo.len[HTTP2_PSEUDO_METHOD], "CONNECT")) {
+    return false;
+  }
+
+  if (!http2_valid_request_token(method, pseudo.len[HTTP2_PSEUDO_METHOD]) ||
+      !http2_valid_request_token(path, pseudo.len[HTTP2_PSEUDO_PATH])) {
+    return false;
+  }
+
+  // HTTP/1.0 keeps the state machine from chunking the response and makes it close the stream
+  // once the response is complete, which is exactly when we send END_STREAM.
+  request->write(method, pseudo.len[HTTP2_PSEUDO_METHOD]);
+  request->write(" ", 1);
+  request->write(path, pseudo.len[HTTP2_PSEUDO_PATH]);
+  request->write(" HTTP/1.0\r\n", 11);
+
+  if (pseudo.value[HTTP2_PSEUDO_AUTHORITY]) {
+    if (!http2_valid_request_token(pseudo.value[HTTP2_PSEUDO_AUTHORITY], pseudo.len[HTTP2_PSEUDO_AUTHORITY])) {
+      return false;
+    }
+    request->write("Host: ", 6);
+    request->write(pseudo.value[HTTP2_PSEUDO_AUTHORITY], pseudo.len[HTTP2_PSEUDO_AUTHORITY]);
+    request->write("\r\n", 2);
+  }
+
+  return true;
+}
+
+Http2HeaderResult
+http2_convert_request_header(HpackDecoder & decoder, const uint8_t * block, uint32_t len, MIOBuffer * request)
+{
+  const uint8_t * p = block;
+  const uint8_t * end = block + len;
+  Http2PseudoFields pseudo;
+  bool malformed = false;
+  bool started = false;
+
+  // Keep decoding a malformed block to the end so that the dynamic table stays in step with the
+  // client's.
+  while (p < end) {
+    HpackField field;
+    int64_t n = decoder.decode(p, end, field);
+
+    if (n < 0) {
+      return HTTP2_HEADER_CONNECTION_ERROR;
+    }
+    p += n;
+
+    if (!field.name || malformed) {
+      continue;
+    }
+
+    if (field.name_len && field.name[0] == ':') {
+      unsigned i;
+
+      for (i = 0; i < HTTP2_PSEUDO_MAX; ++i) {
+        if (http2_field_equals(field.name, field.name_len, http2_pseudo_fields[i].name, http2_pseudo_fields[i].len)) {
+          break;
+        }
+      }
+
+      // Pseudo header fields come first and only once (RFC 7540 section 8.1.2.1).
+      if (i == HTTP2_PSEUDO_MAX || started || pseudo.value[i]) {
+        malformed = true;
+      } else {
+        pseudo.value[i] = ats_strndup(field.value, field.value_len);
+        pseudo.len[i] = field.value_len;
+      }
+      continue;
+    }
+
+    if (!started) {
+      malformed = !http2_write_request_line(pseudo, request);
+      started = true;
+      if (malformed) {
+        continue;
+      }
+    }
+
+    if (!http2_valid_field_name(field.name, field.name_len) ||
+        !http2_valid_field_value(field.value, field.value_len) ||
+        http2_is_connection_field(field.name, field.name_len)) {
+      malformed = true;
+      continue;
+    }
+
+    // TE may only ask for trailers, which mean nothing to an HTTP/1.0 request. :authority
+    // already went out as the Host header.
+    if (HTTP2_FIELD_EQUALS(field.name, field.name_len, "te")) {
+      if (!HTTP2_FIELD_EQUALS(field.value, field.value_len, "trailers")) {
+        malformed = true;
+      }
+      continue;
+    }
+    if (pseudo.value[HTTP2_PSEUDO_AUTHORITY] && HTTP2_FIELD_EQUALS(field.name, field.name_len, "host")) {
+      continue;
+    }
+
+    request->write(field.name, field.name_len);
+    request->write(": ", 2);
+    request->write(field.value, field.value_len);
+    request->write("\r\n", 2);
+  }
+
+  if (!malformed && !started) {
+    malformed = !http2_write_request_line(pseudo, request);
+  }
+
+  if (malformed) {
+    return HTTP2_HEADER_STREAM_ERROR;
+  }
+
+  request->write("\r\n", 2);
+  return HTTP2_HEADER_OK;
+}
+
+// Room for a table size update and the :status field, which are not in the header.
+#define HTTP2_RESPONSE_HEADER_SLOP 32
+
+int64_t
+http2_response_header_bound(HTTPHdr * resp)
+{
+  MIMEFieldIter iter;
+  int64_t bound = HTTP2_RESPONSE_HEADER_SLOP;
+
+  // Each field may go out as a literal with two length prefixes of up to 5 octets.
+  for (MIMEField * field = resp->iter_get_first(&iter); field; field = resp->iter_get_next(&iter)) {
+    int name_len, value_len;
+
+    field->name_get(&name_len);
+    field->value_get(&value_len);
+    bound += name_len + value_len + 11;
+  }
+
+  return bound;
+}
+
+// Encode the regular fields of hdr, which follow the pseudo header fields. A request's Host went
+// out as :authority, and TE may only ask for trailers, which we never want.
+static int64_t
+http2_encode_fields(HpackEncoder & encoder, HTTPHdr * hdr, bool request, uint8_t * buf_start, const uint8_t * buf_end)
+{
+  uint8_t * p = buf_start;
+  MIMEFieldIter iter;
+  int64_t n;
+
+  for (MIMEField * field = hdr->iter_get_first(&iter); field; field = hdr->iter_get_next(&iter)) {
+    char lower[128];
+    char * name_buf = lower;
+    int name_len, value_len;
+    const char * name = field->name_get(&name_len);
+    const char * value = field->value_get(&value_len);
+
+    if (name_len <= 0) {
+      continue;
+    }
+
+    // HTTP/2 field names are lower case.
+    if (name_len > (int)sizeof(lower)) {
+      name_buf = (char *)ats_malloc(name_len);
+    }
+    for (int i = 0; i < name_len; ++i) {
+      name_buf[i] = ParseRules::ink_tolower(name[i]);
+    }
+
+    n = 0;
+    if (!http2_is_connection_field(name_buf, name_len) &&
+        !(request && (HTTP2_FIELD_EQUALS(name_buf, name_len, "host") || HTTP2_FIELD_EQUALS(name_buf, name_len, "te")))) {
+      n = encoder.encode(p, buf_end, name_buf, name_len, value, value_len);
+    }
+
+    if (name_buf != lower) {
+      ats_free(name_buf);
+    }
+
+    if (n < 0) {
+      return -1;
+    }
+    p += n;
+  }
+
+  return p - buf_start;
+}
+
+int64_t
+http2_encode_response_header(HpackEncoder & encoder, HTTPHdr * resp, uint8_t * buf_start, const uint8_t * buf_end)
+{
+  uint8_t * p = buf_start;
+  char status[8];
+  int64_t n;
+
+  n = encoder.begin_block(p, buf_end);
+  if (n < 0) {
+    return -1;
+  }
+  p += n;
+
+  snprintf(status, sizeof(status), "%03d", (int)resp->status_get());
+  n = encoder.encode(p, buf_end, ":status", 7, status, 3);
+  if (n < 0) {
+    return -1;
+  }
+  p += n;
+
+  n = http2_encode_fields(encoder, resp, false, p, buf_end);
+  if (n < 0) {
+    return -1;
+  }
+
+  return p + n - buf_start;
+}
+
+// Room for a table size update and the :method and :scheme fields, plus the framing of :path
+// and :authority.
+#define HTTP2_REQUEST_HEADER_SLOP 96
+
+int64_t
+http2_request_header_bound(HTTPHdr * req)
+{
+  URL * url = req->url_get();
+  int64_t bound = HTTP2_REQUEST_HEADER_SLOP + http2_response_header_bound(req);
+  int len;
+
+  req->method_get(&len);
+  bound += len;
+  url->path_get(&len);
+  bound += len;
+  url->params_get(&len);
+  bound += len;
+  url->query_get(&len);
+  bound += len;
+  url->host_get(&len);
+  bound += len;
+
+  return bound;
+}
+
+int64_t
+http2_encode_request_header(HpackEncoder & encoder, HTTPHdr * req, uint8_t * buf_start, const uint8_t * buf_end)
+{
+  uint8_t * p = buf_start;
+  URL * url = req->url_get();
+  const char * method, * path, * params, * query, * authority;
+  int method_len, path_len, params_len, query_len, authority_len;
+  char * target;
+  int target_len = 0;
+  int64_t n;
+
+  n = encoder.begin_block(p, buf_end);
+  if (n < 0) {
+    return -1;
+  }
+  p += n;
+
+  method = req->method_get(&method_len);
+  n = encoder.encode(p, buf_end, ":method", 7, method, method_len);
+  if (n < 0) {
+    return -1;
+  }
+  p += n;
+
+  n = encoder.encode(p, buf_end, ":scheme", 7, "http", 4);
+  if (n < 0) {
+    return -1;
+  }
+  p += n;
+
+  // The target in origin form, as it would have been on an HTTP/1 request line.
+  path = url->path_get(&path_len);
+  params = url->params_get(&params_len);
+  query = url->query_get(&query_len);
+  target = (char *)ats_malloc(path_len + params_len + query_len + 3);
+  target[target_len++] = '/';
+  memcpy(target + target_len, path, path_len);
+  target_len += path_len;
+  if (params_len) {
+    target[target_len++] = ';';
+    memcpy(target + target_len, params, params_len);
+    target_len += params_len;
+  }
+  if (query_len) {
+    target[target_len++] = '?';
+    memcpy(target + target_len, query, query_len);
+    target_len += query_len;
+  }
+
+  n = encoder.encode(p, buf_end, ":path", 5, target, target_len);
+  ats_free(target);
+  if (n < 0) {
+    return -1;
+  }
+  p += n;
+
+  authority = req->value_get(MIME_FIELD_HOST, MIME_LEN_HOST, &authority_len);
+  if (authority == NULL) {
+    authority = url->host_get(&authority_len);
+  }
+  if (authority && authority_len) {
+    n = encoder.encode(p, buf_end, ":authority", 10, authority, authority_len);
+    if (n < 0) {
+      return -1;
+    }
+    p += n;
+  }
+
+  n = http2_encode_fields(encoder, req, true, p, buf_end);
+  if (n < 0) {
+    return -1;
+  }
+
+  return p + n - buf_start;
+}
+
+static bool
+http2_parse_status(const char * value, uint32_t len, int & status)
+{
+  if (len != 3 || !ParseRules::is_digit(value[0]) || !ParseRules::is_digit(value[1]) ||
+      !ParseRules::is_digit(value[2])) {
+    return false;
+  }
+
+  status = (value[0] - '0') * 100 + (value[1] - '0') * 10 + (value[2] - '0');
+  return status >= 100 && status < 600;
+}
+
+static void
+http2_write_status_line(int status, MIOBuffer * response)
+{
+  char line[128];
+  const char * reason = http_hdr_reason_lookup(status);
+  int len = snprintf(line, sizeof(line), "HTTP/1.1 %03d %s\r\n", status, reason ? reason : "");
+
+  response->write(line, len);
+}
+
+Http2HeaderResult
+http2_convert_response_header(HpackDecoder & decoder, const uint8_t * block, uint32_t len, MIOBuffer * response,
+                              int & status)
+{
+  const uint8_t * p = block;
+  const uint8_t * end = block + len;
+  bool malformed = false;
+  bool started = false;
+
+  status = 0;
+
+  // As for requests, a malformed block is decoded to the end to keep the dynamic table in step.
+  while (p < end) {
+    HpackField field;
+    int64_t n = decoder.decode(p, end, field);
+
+    if (n < 0) {
+      return HTTP2_HEADER_CONNECTION_ERROR;
+    }
+    p += n;
+
+    if (!field.name || malformed) {
+      continue;
+    }
+
+    // :status is the only response pseudo header field, and it comes first.
+    if (field.name_len && field.name[0] == ':') {
+      if (started || status || !HTTP2_FIELD_EQUALS(field.name, field.name_len, ":status") ||
+          !http2_parse_status(field.value, field.value_len, status)) {
+        malformed = true;
+      }
+      continue;
+    }
+
+    if (!started) {
+      if (!status) {
+        malformed = true;
+        continue;
+      }
+      http2_write_status_line(status, response);
+      started = true;
+    }
+
+    if (!http2_valid_field_name(field.name, field.name_len) ||
+        !http2_valid_field_value(field.value, field.value_len) ||
+        http2_is_connection_field(field.name, field.name_len)) {
+      malformed = true;
+      continue;
+    }
+
+    response->write(field.name, field.name_len);
+    response->write(": ", 2);
+    response->write(field.value, field.value_len);
+    response->write("\r\n", 2);
+  }
+
+  if (!malformed && !started) {
+    if (status) {
+      http2_write_status_line(status, response);
+    } else {
+      malformed = true;
+    }
+  }
+
+  if (malformed) {
+    return HTTP2_HEADER_STREAM_ERROR;
+  }
+
+  // The stream ends with the response; without a Content-Length the state machine reads to the
+  // end of it.
+  if (status >= 200) {
+    response->write("Connection: close\r\n", 19);
+  }
+  response->write("\r\n", 2);
+  return HTTP2_HEADER_OK;
+}
+
+#if TS_HAS_TESTS
+#include "ts/TestBox.h"
+
+static void
+http2_test_request(TestBox & box, const char * desc, const uint8_t * block, uint32_t len, Http2HeaderResult expected,
+                   const char * text)
+{
+  HpackDecoder decoder;
+  MIOBuffer * request = new_MIOBuffer(BUFFER_SIZE_INDEX_4K);
+  IOBufferReader * reader = request->alloc_reader();
+  Http2HeaderResult result = http2_convert_request_header(decoder, block, len, request);
+
+  box.check(result == expected, "%s: returned %d instead of %d", desc, result, expected);
+  if (result == HTTP2_HEADER_OK && text) {
+    char buf[256];
+    int64_t avail = reader->read_avail();
+
+    reader->memcpy(buf, avail < (int64_t)sizeof(buf) ? avail : sizeof(buf));
+    box.check(avail == (int64_t)strlen(text) && memcmp(buf, text, avail) == 0, "%s: wrote '%.*s'", desc, (int)avail, buf);
+  }
+
+  free_MIOBuffer(request);
+}
+
+REGRESSION_TEST(HTTP2_RequestHeader)(RegressionTest * t, int /* atype ATS_UNUSED */, int * pstatus)
+{
+  // RFC 7541 C.3.3 plus a regular field.
+  static const uint8_t request[] = {
+    0x82, 0x87, 0x85, 0x41, 0x0f, 'w', 'w', 'w', '.', 'e', 'x', 'a', 'm', 'p', 'l', 'e', '.', 'c', 'o', 'm',
+    0x40, 0x02, 'x', '-', 0x01, 'y',
+  };
+  // :method GET, :scheme https, :path /index.html, then connection: close.
+  static const uint8_t connection[] = {
+    0x82, 0x87, 0x85, 0x00, 0x0a, 'c', 'o', 'n', 'n', 'e', 'c', 't', 'i', 'o', 'n', 0x05, 'c', 'l', 'o', 's', 'e',
+  };
+  // :path before :method after a regular field.
+  static const uint8_t late_pseudo[] = {
+    0x87, 0x85, 0x40, 0x02, 'x', '-', 0x01, 'y', 0x82,
+  };
+  // A value carrying a line break.
+  static const uint8_t crlf[] = {
+    0x82, 0x87, 0x85, 0x40, 0x02, 'x', '-', 0x03, 'a', '\r', '\n',
+  };
+  // Upper case field name.
+  static const uint8_t upper[] = {
+    0x82, 0x87, 0x85, 0x40, 0x02, 'X', '-', 0x01, 'y',
+  };
+  // A reference past the end of the tables.
+  static const uint8_t bad_index[] = {
+    0x82, 0xff, 0x10,
+  };
+
+  TestBox box(t, pstatus);
+  box = REGRESSION_TEST_PASSED;
+
+  http2_test_request(box, "request", request, sizeof(request), HTTP2_HEADER_OK,
+                     "GET /index.html HTTP/1.0\r\nHost: www.example.com\r\nx-: y\r\n\r\n");
+  http2_test_request(box, "connection field", connection, sizeof(connection), HTTP2_HEADER_STREAM_ERROR, NULL);
+  http2_test_request(box, "late pseudo field", late_pseudo, sizeof(late_pseudo), HTTP2_HEADER_STREAM_ERROR, NULL);
+  http2_test_request(box, "line break", crlf, sizeof(crlf), HTTP2_HEADER_STREAM_ERROR, NULL);
+  http2_test_request(box, "upper case name", upper, sizeof(upper), HTTP2_HEADER_STREAM_ERROR, NULL);
+  http2_test_request(box, "bad index", bad_index, sizeof(bad_index), HTTP2_HEADER_CONNECTION_ERROR, NULL);
+}
+
+static void
+http2_test_response(TestBox & box, const char * desc, const uint8_t * block, uint32_t len, Http2HeaderResult expected,
+                    const char * text)
+{
+  HpackDecoder decoder;
+  MIOBuffer * response = new_MIOBuffer(BUFFER_SIZE_INDEX_4K);
+  IOBufferReader * reader = response->alloc_reader();
+  int status;
+  Http2HeaderResult result = http2_convert_response_header(decoder, block, len, response, status);
+
+  box.check(result == expected, "%s: returned %d instead of %d", desc, result, expected);
+  if (result == HTTP2_HEADER_OK && text) {
+    char buf[256];
+    int64_t avail = reader->read_avail();
+
+    reader->memcpy(buf, avail < (int64_t)sizeof(buf) ? avail : sizeof(buf));
+    box.check(avail == (int64_t)strlen(text) && memcmp(buf, text, avail) == 0, "%s: wrote '%.*s'", desc, (int)avail, buf);
+  }
+
+  free_MIOBuffer(response);
+}
+
+REGRESSION_TEST(HTTP2_ResponseHeader)(RegressionTest * t, int /* atype ATS_UNUSED */, int * pstatus)
+{
+  // :status 200, then content-length: 42.
+  static const uint8_t response[] = {
+    0x88, 0x00, 0x0e, 'c', 'o', 'n', 't', 'e', 'n', 't', '-', 'l', 'e', 'n', 'g', 't', 'h', 0x02, '4', '2',
+  };
+  // :status 100, a literal value with an indexed name.
+  static const uint8_t interim[] = {
+    0x08, 0x03, '1', '0', '0',
+  };
+  // A regular field and no :status.
+  static const uint8_t no_status[] = {
+    0x00, 0x01, 'x', 0x01, 'y',
+  };
+  // :status 200, then connection: close.
+  static const uint8_t connection[] = {
+    0x88, 0x00, 0x0a, 'c', 'o', 'n', 'n', 'e', 'c', 't', 'i', 'o', 'n', 0x05, 'c', 'l', 'o', 's', 'e',
+  };
+  // :status 200, then :path.
+  static const uint8_t request_pseudo[] = {
+    0x88, 0x84,
+  };
+  // A reference past the end of the tables.
+  static const uint8_t bad_index[] = {
+    0x88, 0xff, 0x10,
+  };
+
+  TestBox box(t, pstatus);
+  box = REGRESSION_TEST_PASSED;
+
+  http2_test_response(box, "response", response, sizeof(response), HTTP2_HEADER_OK,
+                      "HTTP/1.1 200 OK\r\ncontent-length: 42\r\nConnection: close\r\n\r\n");
+  http2_test_response(box, "interim response", interim, sizeof(interim), HTTP2_HEADER_OK,
+                      "HTTP/1.1 100 Continue\r\n\r\n");
+  http2_test_response(box, "no status", no_status, sizeof(no_status), HTTP2_HEADER_STREAM_ERROR, NULL);
+  http2_test_response(box, "connection field", connection, sizeof(connection), HTTP2_HEADER_STREAM_ERROR, NULL);
+  http2_test_response(box, "request pseudo field", request_pseudo, sizeof(request_pseudo), HTTP2_HEADER_STREAM_ERROR,
+                      NULL);
+  http2_test_response(box, "bad index", bad_index, sizeof(bad_index), HTTP2_HEADER_CONNECTION_ERROR, NULL);
+}
+
+#endif /* TS_HAS_TESTS */
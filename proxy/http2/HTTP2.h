@@ -0,0 +1,179 @@
+/** @file
+
+  HTTP/2 protocol constants, framing and header conversion (RFC 7540).
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#ifndef __HTTP2_H__
+#define __HTTP2_H__
+
+#include "libts.h"
+#include "P_EventSystem.h"
+#include "HTTP.h"
+#include "HPACK.h"
+
+#define HTTP2_CONNECTION_PREFACE      "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"
+#define HTTP2_CONNECTION_PREFACE_LEN  24
+
+#define HTTP2_FRAME_HEADER_LEN        9
+#define HTTP2_SETTINGS_PARAMETER_LEN  6
+#define HTTP2_PING_LEN                8
+#define HTTP2_WINDOW_UPDATE_LEN       4
+#define HTTP2_RST_STREAM_LEN          4
+#define HTTP2_PRIORITY_LEN            5
+#define HTTP2_GOAWAY_LEN              8
+
+// Protocol defaults and limits (RFC 7540 section 6.5.2).
+#define HTTP2_INITIAL_WINDOW_SIZE     65535
+#define HTTP2_MAX_WINDOW_SIZE         0x7fffffff
+#define HTTP2_MAX_FRAME_SIZE          16384
+#define HTTP2_MAX_FRAME_SIZE_LIMIT    16777215
+
+// We never raise SETTINGS_MAX_FRAME_SIZE, so no peer frame can be larger than this.
+#define HTTP2_MAX_PAYLOAD_LEN         HTTP2_MAX_FRAME_SIZE
+
+// Largest request header block we are prepared to assemble from HEADERS and CONTINUATION frames.
+#define HTTP2_MAX_HEADER_BLOCK_LEN    65536
+
+enum Http2FrameType
+{
+  HTTP2_FRAME_TYPE_DATA          = 0,
+  HTTP2_FRAME_TYPE_HEADERS       = 1,
+  HTTP2_FRAME_TYPE_PRIORITY      = 2,
+  HTTP2_FRAME_TYPE_RST_STREAM    = 3,
+  HTTP2_FRAME_TYPE_SETTINGS      = 4,
+  HTTP2_FRAME_TYPE_PUSH_PROMISE  = 5,
+  HTTP2_FRAME_TYPE_PING          = 6,
+  HTTP2_FRAME_TYPE_GOAWAY        = 7,
+  HTTP2_FRAME_TYPE_WINDOW_UPDATE = 8,
+  HTTP2_FRAME_TYPE_CONTINUATION  = 9,
+  HTTP2_FRAME_TYPE_MAX
+};
+
+enum Http2FrameFlags
+{
+  HTTP2_FLAGS_END_STREAM  = 0x01,
+  HTTP2_FLAGS_ACK         = 0x01,
+  HTTP2_FLAGS_END_HEADERS = 0x04,
+  HTTP2_FLAGS_PADDED      = 0x08,
+  HTTP2_FLAGS_PRIORITY    = 0x20
+};
+
+enum Http2ErrorCode
+{
+  HTTP2_ERROR_NO_ERROR            = 0,
+  HTTP2_ERROR_PROTOCOL_ERROR      = 1,
+  HTTP2_ERROR_INTERNAL_ERROR      = 2,
+  HTTP2_ERROR_FLOW_CONTROL_ERROR  = 3,
+  HTTP2_ERROR_SETTINGS_TIMEOUT    = 4,
+  HTTP2_ERROR_STREAM_CLOSED       = 5,
+  HTTP2_ERROR_FRAME_SIZE_ERROR    = 6,
+  HTTP2_ERROR_REFUSED_STREAM      = 7,
+  HTTP2_ERROR_CANCEL              = 8,
+  HTTP2_ERROR_COMPRESSION_ERROR   = 9,
+  HTTP2_ERROR_CONNECT_ERROR       = 10,
+  HTTP2_ERROR_ENHANCE_YOUR_CALM   = 11,
+  HTTP2_ERROR_INADEQUATE_SECURITY = 12,
+  HTTP2_ERROR_HTTP_1_1_REQUIRED   = 13
+};
+
+enum Http2SettingsIdentifier
+{
+  HTTP2_SETTINGS_HEADER_TABLE_SIZE      = 1,
+  HTTP2_SETTINGS_ENABLE_PUSH            = 2,
+  HTTP2_SETTINGS_MAX_CONCURRENT_STREAMS = 3,
+  HTTP2_SETTINGS_INITIAL_WINDOW_SIZE    = 4,
+  HTTP2_SETTINGS_MAX_FRAME_SIZE         = 5,
+  HTTP2_SETTINGS_MAX_HEADER_LIST_SIZE   = 6
+};
+
+struct Http2FrameHeader
+{
+  uint32_t length;
+  uint8_t  type;
+  uint8_t  flags;
+  uint32_t streamid;
+};
+
+void http2_parse_frame_header(const uint8_t * buf, Http2FrameHeader & hdr);
+void http2_write_frame_header(const Http2FrameHeader & hdr, uint8_t * buf);
+
+static inline uint32_t
+http2_read_u32(const uint8_t * buf)
+{
+  return ((uint32_t)buf[0] << 24) | ((uint32_t)buf[1] << 16) | ((uint32_t)buf[2] << 8) | (uint32_t)buf[3];
+}
+
+static inline void
+http2_write_u32(uint32_t value, uint8_t * buf)
+{
+  buf[0] = (uint8_t)(value >> 24);
+  buf[1] = (uint8_t)(value >> 16);
+  buf[2] = (uint8_t)(value >> 8);
+  buf[3] = (uint8_t)value;
+}
+
+// Decode a complete request header block and write the equivalent HTTP/1.0 request header to
+// request. A connection error means the HPACK state is lost; after a stream error the block was
+// still decoded in full, so the connection can carry on without this stream.
+enum Http2HeaderResult
+{
+  HTTP2_HEADER_OK,
+  HTTP2_HEADER_STREAM_ERROR,
+  HTTP2_HEADER_CONNECTION_ERROR
+};
+
+Http2HeaderResult http2_convert_request_header(HpackDecoder & decoder, const uint8_t * block, uint32_t len,
+                                               MIOBuffer * request);
+
+// Encode resp as a header block. Returns the number of bytes written or -1 if buf is too short;
+// http2_response_header_bound() is always large enough.
+int64_t http2_encode_response_header(HpackEncoder & encoder, HTTPHdr * resp, uint8_t * buf_start,
+                                     const uint8_t * buf_end);
+int64_t http2_response_header_bound(HTTPHdr * resp);
+
+// Encode req, an HTTP/1 request to an origin server, as a request header block for an http URL.
+// Returns the number of bytes written or -1 if buf is too short; http2_request_header_bound() is
+// always large enough.
+int64_t http2_encode_request_header(HpackEncoder & encoder, HTTPHdr * req, uint8_t * buf_start,
+                                    const uint8_t * buf_end);
+int64_t http2_request_header_bound(HTTPHdr * req);
+
+// Decode a complete response header block from an origin server and write the equivalent
+// HTTP/1.1 response header to response, returning the status in status. A final response is
+// marked Connection: close, since the state machine's connection is the stream.
+Http2HeaderResult http2_convert_response_header(HpackDecoder & decoder, const uint8_t * block, uint32_t len,
+                                                MIOBuffer * response, int & status);
+
+// Process wide HTTP/2 settings, read from records.config once at startup.
+class Http2
+{
+public:
+  static uint32_t max_concurrent_streams;
+  static uint32_t initial_window_size;
+  static uint32_t no_activity_timeout_in;
+  static uint32_t max_concurrent_streams_out;
+  static uint32_t initial_window_size_out;
+  static uint32_t no_activity_timeout_out;
+
+  static void init();
+};
+
+#endif /* __HTTP2_H__ */
@@ -0,0 +1,1035 @@
+/** @file
+
+  An HTTP/2 client connection and its streams.
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#include "Http2ClientSession.h"
+
+#define DebugHttp2(fmt, ...) Debug("http2_cs", "[%" PRId64 "] " fmt, con_id, ##__VA_ARGS__)
+
+// Stop moving response data once this much is queued for the client; the net thread tells us
+// when it has drained.
+#define HTTP2_WRITE_HIGH_WATER (64 * 1024)
+
+// Frame headers and control frames are small; DATA payloads are cloned blocks.
+#define HTTP2_WRITE_BUFFER_SIZE_INDEX BUFFER_SIZE_INDEX_1K
+#define HTTP2_READ_BUFFER_SIZE_INDEX  BUFFER_SIZE_INDEX_16K
+
+ClassAllocator<Http2ClientSession> http2ClientSessionAllocator("http2ClientSessionAllocator");
+ClassAllocator<Http2Stream> http2StreamAllocator("http2StreamAllocator");
+
+static int64_t next_http2_con_id = 0;
+
+Http2Stream::Http2Stream()
+  : Continuation(NULL), session(NULL), id(0), vc(NULL),
+    request_buffer(NULL), request_reader(NULL), request_vio(NULL),
+    response_buffer(NULL), response_reader(NULL), response_vio(NULL),
+    send_window(0), recv_window(0),
+    request_done(false), response_done(false), headers_sent(false), end_stream_sent(false)
+{
+  memset(&parser, 0, sizeof(parser));
+}
+
+void
+Http2Stream::init(Http2ClientSession * s, uint32_t streamid)
+{
+  session = s;
+  id = streamid;
+  mutex = s->mutex;
+  http_parser_init(&parser);
+  response.create(HTTP_TYPE_RESPONSE);
+  SET_HANDLER(&Http2Stream::main_event_handler);
+}
+
+int
+Http2Stream::main_event_handler(int event, void * edata)
+{
+  return session->stream_event(this, event, static_cast<VIO *>(edata));
+}
+
+Http2ClientSession::Http2ClientSession()
+  : Continuation(NULL), con_id(0), client_vc(NULL), http_accept(NULL),
+    read_buffer(NULL), read_reader(NULL), read_vio(NULL),
+    write_buffer(NULL), write_reader(NULL), write_vio(NULL),
+    nstreams(0), last_stream_id(0),
+    send_window(HTTP2_INITIAL_WINDOW_SIZE), recv_window(HTTP2_INITIAL_WINDOW_SIZE),
+    peer_initial_window(HTTP2_INITIAL_WINDOW_SIZE), peer_max_frame_size(HTTP2_MAX_FRAME_SIZE),
+    header_block(NULL), header_block_len(0), header_block_stream(0), header_block_end_stream(false),
+    preface_received(false), goaway_received(false), closing(false), dead(false)
+{
+}
+
+void
+Http2ClientSession::new_connection(NetVConnection * new_vc, Continuation * accept)
+{
+  ink_assert(new_vc != NULL);
+  ink_assert(client_vc == NULL);
+
+  client_vc = new_vc;
+  http_accept = accept;
+  mutex = new_vc->mutex;
+  con_id = ink_atomic_increment(&next_http2_con_id, 1);
+
+  DebugHttp2("session born, netvc %p", new_vc);
+
+  read_buffer = new_MIOBuffer(HTTP2_READ_BUFFER_SIZE_INDEX);
+  read_reader = read_buffer->alloc_reader();
+  write_buffer = new_MIOBuffer(HTTP2_WRITE_BUFFER_SIZE_INDEX);
+  write_reader = write_buffer->alloc_reader();
+
+  SET_HANDLER(&Http2ClientSession::main_event_handler);
+
+  client_vc->set_inactivity_timeout(HRTIME_SECONDS(Http2::no_activity_timeout_in));
+  write_vio = client_vc->do_io_write(this, INT64_MAX, write_reader);
+  read_vio = client_vc->do_io_read(this, INT64_MAX, read_buffer);
+
+  // The server preface is a SETTINGS frame, and we need not wait for the client's to send it.
+  write_settings();
+}
+
+int
+Http2ClientSession::main_event_handler(int event, void * edata)
+{
+  switch (event) {
+  case NET_EVENT_ACCEPT:
+    // A stream's PluginVC connecting; we hold its mutex already, which the shared port acceptor
+    // does not have, so hand the connection on from here.
+    return http_accept->handleEvent(NET_EVENT_ACCEPT, edata);
+
+  case VC_EVENT_READ_READY:
+  case VC_EVENT_READ_COMPLETE:
+    if (!closing) {
+      process_input();
+    }
+    break;
+
+  case VC_EVENT_WRITE_READY:
+    if (!closing) {
+      resume_streams();
+    }
+    break;
+
+  case VC_EVENT_WRITE_COMPLETE:
+    // Only a closing session limits its write, and it has now sent everything.
+    dead = true;
+    break;
+
+  case VC_EVENT_EOS:
+  case VC_EVENT_ERROR:
+  case VC_EVENT_ACTIVE_TIMEOUT:
+  case VC_EVENT_INACTIVITY_TIMEOUT:
+  default:
+    DebugHttp2("closing on event %d", event);
+    dead = true;
+    break;
+  }
+
+  if (dead) {
+    destroy();
+  }
+
+  return EVENT_CONT;
+}
+
+int
+Http2ClientSession::stream_event(Http2Stream * stream, int event, VIO * vio)
+{
+  switch (event) {
+  case VC_EVENT_READ_READY:
+  case VC_EVENT_READ_COMPLETE:
+    send_response(stream);
+    break;
+
+  case VC_EVENT_EOS:
+    stream->response_done = true;
+    send_response(stream);
+    break;
+
+  case VC_EVENT_WRITE_READY:
+  case VC_EVENT_WRITE_COMPLETE:
+    ink_assert(vio == stream->request_vio);
+    update_request_window(stream);
+    break;
+
+  case VC_EVENT_ERROR:
+  case VC_EVENT_ACTIVE_TIMEOUT:
+  case VC_EVENT_INACTIVITY_TIMEOUT:
+  default:
+    DebugHttp2("stream %u failed on event %d", stream->id, event);
+    reset_stream(stream, HTTP2_ERROR_INTERNAL_ERROR);
+    break;
+  }
+
+  // A client that sent GOAWAY gets the connection closed once its last stream is done.
+  if (goaway_received && nstreams == 0 && !closing) {
+    connection_error(HTTP2_ERROR_NO_ERROR);
+  }
+
+  if (dead) {
+    destroy();
+  }
+
+  return EVENT_CONT;
+}
+
+void
+Http2ClientSession::process_input()
+{
+  while (!closing) {
+    int64_t avail = read_reader->read_avail();
+    uint8_t buf[HTTP2_FRAME_HEADER_LEN];
+    Http2FrameHeader hdr;
+    Http2ErrorCode err;
+
+    if (!preface_received) {
+      char preface[HTTP2_CONNECTION_PREFACE_LEN];
+
+      if (avail < HTTP2_CONNECTION_PREFACE_LEN) {
+        break;
+      }
+
+      read_reader->memcpy(preface, sizeof(preface));
+      if (memcmp(preface, HTTP2_CONNECTION_PREFACE, HTTP2_CONNECTION_PREFACE_LEN) != 0) {
+        DebugHttp2("bad connection preface");
+        connection_error(HTTP2_ERROR_PROTOCOL_ERROR);
+        break;
+      }
+
+      read_reader->consume(HTTP2_CONNECTION_PREFACE_LEN);
+      preface_received = true;
+      continue;
+    }
+
+    if (avail < HTTP2_FRAME_HEADER_LEN) {
+      break;
+    }
+
+    read_reader->memcpy(buf, sizeof(buf));
+    http2_parse_frame_header(buf, hdr);
+
+    if (hdr.length > HTTP2_MAX_PAYLOAD_LEN) {
+      connection_error(HTTP2_ERROR_FRAME_SIZE_ERROR);
+      break;
+    }
+
+    if (avail < HTTP2_FRAME_HEADER_LEN + hdr.length) {
+      break;
+    }
+
+    read_reader->consume(HTTP2_FRAME_HEADER_LEN);
+
+    err = process_frame(hdr);
+    if (err != HTTP2_ERROR_NO_ERROR) {
+      DebugHttp2("frame type %u on stream %u failed with error %d", hdr.type, hdr.streamid, err);
+      connection_error(err);
+      break;
+    }
+  }
+
+  if (!closing) {
+    read_vio->reenable();
+  }
+}
+
+// The payload is still in the read buffer; every path here consumes exactly hdr.length bytes.
+Http2ErrorCode
+Http2ClientSession::process_frame(const Http2FrameHeader & hdr)
+{
+  uint8_t payload[HTTP2_MAX_PAYLOAD_LEN];
+
+  // Nothing may come between the frames of a header block (RFC 7540 section 6.10).
+  if (header_block_stream && hdr.type != HTTP2_FRAME_TYPE_CONTINUATION) {
+    return HTTP2_ERROR_PROTOCOL_ERROR;
+  }
+
+  if (hdr.type == HTTP2_FRAME_TYPE_DATA) {
+    return process_data(hdr);
+  }
+
+  read_reader->memcpy(payload, hdr.length);
+  read_reader->consume(hdr.length);
+
+  switch (hdr.type) {
+  case HTTP2_FRAME_TYPE_HEADERS:
+    return process_headers(hdr, payload);
+
+  case HTTP2_FRAME_TYPE_CONTINUATION:
+    return process_continuation(hdr, payload);
+
+  case HTTP2_FRAME_TYPE_SETTINGS:
+    return process_settings(hdr, payload);
+
+  case HTTP2_FRAME_TYPE_WINDOW_UPDATE:
+    return process_window_update(hdr, payload);
+
+  case HTTP2_FRAME_TYPE_PING:
+    if (hdr.streamid != 0) {
+      return HTTP2_ERROR_PROTOCOL_ERROR;
+    }
+    if (hdr.length != HTTP2_PING_LEN) {
+      return HTTP2_ERROR_FRAME_SIZE_ERROR;
+    }
+    if (!(hdr.flags & HTTP2_FLAGS_ACK)) {
+      write_frame(HTTP2_FRAME_TYPE_PING, HTTP2_FLAGS_ACK, 0, payload, HTTP2_PING_LEN);
+    }
+    return HTTP2_ERROR_NO_ERROR;
+
+  case HTTP2_FRAME_TYPE_RST_STREAM:
+    if (hdr.streamid == 0) {
+      return HTTP2_ERROR_PROTOCOL_ERROR;
+    }
+    if (hdr.length != HTTP2_RST_STREAM_LEN) {
+      return HTTP2_ERROR_FRAME_SIZE_ERROR;
+    }
+    if (Http2Stream * stream = find_stream(hdr.streamid)) {
+      DebugHttp2("stream %u reset by the client with error %u", hdr.streamid, http2_read_u32(payload));
+      close_stream(stream);
+    }
+    return HTTP2_ERROR_NO_ERROR;
+
+  case HTTP2_FRAME_TYPE_PRIORITY:
+    // Streams are served in the order their data arrives; priorities are not used.
+    if (hdr.streamid == 0) {
+      return HTTP2_ERROR_PROTOCOL_ERROR;
+    }
+    if (hdr.length != HTTP2_PRIORITY_LEN) {
+      return HTTP2_ERROR_FRAME_SIZE_ERROR;
+    }
+    return HTTP2_ERROR_NO_ERROR;
+
+  case HTTP2_FRAME_TYPE_GOAWAY:
+    if (hdr.streamid != 0) {
+      return HTTP2_ERROR_PROTOCOL_ERROR;
+    }
+    if (hdr.length < HTTP2_GOAWAY_LEN) {
+      return HTTP2_ERROR_FRAME_SIZE_ERROR;
+    }
+    DebugHttp2("client sent GOAWAY with error %u", http2_read_u32(payload + 4));
+    goaway_received = true;
+    if (nstreams == 0) {
+      connection_error(HTTP2_ERROR_NO_ERROR);
+    }
+    return HTTP2_ERROR_NO_ERROR;
+
+  case HTTP2_FRAME_TYPE_PUSH_PROMISE:
+    // Clients cannot push.
+    return HTTP2_ERROR_PROTOCOL_ERROR;
+
+  default:
+    // Unknown frame types are ignored (RFC 7540 section 4.1).
+    return HTTP2_ERROR_NO_ERROR;
+  }
+}
+
+Http2ErrorCode
+Http2ClientSession::process_data(const Http2FrameHeader & hdr)
+{
+  Http2Stream * stream;
+  uint32_t pad = 0;
+  uint32_t len = hdr.length;
+
+  if (hdr.streamid == 0) {
+    return HTTP2_ERROR_PROTOCOL_ERROR;
+  }
+
+  if (hdr.flags & HTTP2_FLAGS_PADDED) {
+    uint8_t padlen;
+
+    if (hdr.length < 1) {
+      return HTTP2_ERROR_FRAME_SIZE_ERROR;
+    }
+    read_reader->memcpy(&padlen, 1);
+    read_reader->consume(1);
+    pad = padlen;
+    len -= 1;
+    if (pad > len) {
+      read_reader->consume(len);
+      return HTTP2_ERROR_PROTOCOL_ERROR;
+    }
+    len -= pad;
+  }
+
+  // The whole frame counts against the connection window. The streams' own windows bound what
+  // we buffer, so the connection window is simply topped up as it drains.
+  recv_window -= hdr.length;
+  if (recv_window < 0) {
+    read_reader->consume(len + pad);
+    return HTTP2_ERROR_FLOW_CONTROL_ERROR;
+  }
+  if (recv_window <= HTTP2_INITIAL_WINDOW_SIZE / 2) {
+    write_window_update(0, HTTP2_INITIAL_WINDOW_SIZE - recv_window);
+    recv_window = HTTP2_INITIAL_WINDOW_SIZE;
+  }
+
+  stream = find_stream(hdr.streamid);
+  if (stream == NULL || stream->request_done) {
+    read_reader->consume(len + pad);
+    // DATA on a stream that was never opened is a connection error; on one we already finished
+    // it is just late.
+    if (stream == NULL && hdr.streamid > last_stream_id) {
+      return HTTP2_ERROR_PROTOCOL_ERROR;
+    }
+    if (stream) {
+      reset_stream(stream, HTTP2_ERROR_STREAM_CLOSED);
+    }
+    return HTTP2_ERROR_NO_ERROR;
+  }
+
+  stream->recv_window -= hdr.length;
+  if (stream->recv_window < 0) {
+    read_reader->consume(len + pad);
+    reset_stream(stream, HTTP2_ERROR_FLOW_CONTROL_ERROR);
+    return HTTP2_ERROR_NO_ERROR;
+  }
+
+  stream->request_buffer->write(read_reader, len);
+  read_reader->consume(len + pad);
+
+  if (hdr.flags & HTTP2_FLAGS_END_STREAM) {
+    stream->request_done = true;
+    stream->request_vio->nbytes = stream->request_vio->ndone + stream->request_reader->read_avail();
+  }
+
+  stream->request_vio->reenable();
+  return HTTP2_ERROR_NO_ERROR;
+}
+
+Http2ErrorCode
+Http2ClientSession::process_headers(const Http2FrameHeader & hdr, const uint8_t * payload)
+{
+  uint32_t offset = 0;
+  uint32_t pad = 0;
+  uint32_t len;
+
+  if (hdr.streamid == 0 || (hdr.streamid & 1) == 0) {
+    return HTTP2_ERROR_PROTOCOL_ERROR;
+  }
+
+  if (hdr.flags & HTTP2_FLAGS_PADDED) {
+    if (hdr.length < 1) {
+      return HTTP2_ERROR_FRAME_SIZE_ERROR;
+    }
+    pad = payload[0];
+    offset += 1;
+  }
+
+  // Stream dependency and weight.
+  if (hdr.flags & HTTP2_FLAGS_PRIORITY) {
+    offset += HTTP2_PRIORITY_LEN;
+  }
+
+  if (offset + pad > hdr.length) {
+    return HTTP2_ERROR_PROTOCOL_ERROR;
+  }
+  len = hdr.length - offset - pad;
+
+  if (len > HTTP2_MAX_HEADER_BLOCK_LEN) {
+    return HTTP2_ERROR_ENHANCE_YOUR_CALM;
+  }
+
+  header_block = (uint8_t *)ats_realloc(header_block, len ? len : 1);
+  memcpy(header_block, payload + offset, len);
+  header_block_len = len;
+  header_block_stream = hdr.streamid;
+  header_block_end_stream = hdr.flags & HTTP2_FLAGS_END_STREAM;
+
+  if (hdr.flags & HTTP2_FLAGS_END_HEADERS) {
+    return process_header_block();
+  }
+
+  return HTTP2_ERROR_NO_ERROR;
+}
+
+Http2ErrorCode
+Http2ClientSession::process_continuation(const Http2FrameHeader & hdr, const uint8_t * payload)
+{
+  if (header_block_stream == 0 || hdr.streamid != header_block_stream) {
+    return HTTP2_ERROR_PROTOCOL_ERROR;
+  }
+
+  if (header_block_len + hdr.length > HTTP2_MAX_HEADER_BLOCK_LEN) {
+    return HTTP2_ERROR_ENHANCE_YOUR_CALM;
+  }
+
+  header_block = (uint8_t *)ats_realloc(header_block, header_block_len + hdr.length + 1);
+  memcpy(header_block + header_block_len, payload, hdr.length);
+  header_block_len += hdr.length;
+
+  if (hdr.flags & HTTP2_FLAGS_END_HEADERS) {
+    return process_header_block();
+  }
+
+  return HTTP2_ERROR_NO_ERROR;
+}
+
+Http2ErrorCode
+Http2ClientSession::process_header_block()
+{
+  uint32_t id = header_block_stream;
+  bool end_stream = header_block_end_stream;
+  Http2Stream * stream = find_stream(id);
+  MIOBuffer * request;
+  IOBufferReader * reader;
+  Http2HeaderResult result;
+
+  header_block_stream = 0;
+
+  // Trailers, or headers for a stream that is already gone. The block still has to go through
+  // the decoder to keep the dynamic table in step.
+  if (stream || id <= last_stream_id) {
+    const uint8_t * p = header_block;
+    const uint8_t * end = header_block + header_block_len;
+
+    while (p < end) {
+      HpackField field;
+      int64_t n = decoder.decode(p, end, field);
+
+      if (n < 0) {
+        return HTTP2_ERROR_COMPRESSION_ERROR;
+      }
+      p += n;
+    }
+
+    if (stream) {
+      // Trailers have to end the stream; their fields have no place in an HTTP/1.0 request.
+      if (!end_stream || stream->request_done) {
+        reset_stream(stream, HTTP2_ERROR_PROTOCOL_ERROR);
+      } else {
+        stream->request_done = true;
+        stream->request_vio->nbytes = stream->request_vio->ndone + stream->request_reader->read_avail();
+        stream->request_vio->reenable();
+      }
+    } else {
+      write_rst_stream(id, HTTP2_ERROR_STREAM_CLOSED);
+    }
+    return HTTP2_ERROR_NO_ERROR;
+  }
+
+  last_stream_id = id;
+
+  request = new_MIOBuffer(BUFFER_SIZE_INDEX_4K);
+  reader = request->alloc_reader();
+  result = http2_convert_request_header(decoder, header_block, header_block_len, request);
+
+  if (result == HTTP2_HEADER_CONNECTION_ERROR) {
+    free_MIOBuffer(request);
+    return HTTP2_ERROR_COMPRESSION_ERROR;
+  }
+
+  if (result == HTTP2_HEADER_STREAM_ERROR) {
+    DebugHttp2("stream %u has a malformed request header", id);
+    free_MIOBuffer(request);
+    write_rst_stream(id, HTTP2_ERROR_PROTOCOL_ERROR);
+    return HTTP2_ERROR_NO_ERROR;
+  }
+
+  if (nstreams >= Http2::max_concurrent_streams || goaway_received) {
+    free_MIOBuffer(request);
+    write_rst_stream(id, HTTP2_ERROR_REFUSED_STREAM);
+    return HTTP2_ERROR_NO_ERROR;
+  }
+
+  if (open_stream(id, request, reader, end_stream) == NULL) {
+    write_rst_stream(id, HTTP2_ERROR_REFUSED_STREAM);
+  }
+
+  return HTTP2_ERROR_NO_ERROR;
+}
+
+Http2ErrorCode
+Http2ClientSession::process_settings(const Http2FrameHeader & hdr, const uint8_t * payload)
+{
+  int64_t window_delta = 0;
+
+  if (hdr.streamid != 0) {
+    return HTTP2_ERROR_PROTOCOL_ERROR;
+  }
+
+  if (hdr.flags & HTTP2_FLAGS_ACK) {
+    return hdr.length == 0 ? HTTP2_ERROR_NO_ERROR : HTTP2_ERROR_FRAME_SIZE_ERROR;
+  }
+
+  if (hdr.length % HTTP2_SETTINGS_PARAMETER_LEN) {
+    return HTTP2_ERROR_FRAME_SIZE_ERROR;
+  }
+
+  for (uint32_t i = 0; i < hdr.length; i += HTTP2_SETTINGS_PARAMETER_LEN) {
+    uint16_t id = ((uint16_t)payload[i] << 8) | payload[i + 1];
+    uint32_t value = http2_read_u32(payload + i + 2);
+
+    switch (id) {
+    case HTTP2_SETTINGS_HEADER_TABLE_SIZE:
+      // We never need more room than the default to compress responses.
+      encoder.set_max_size(value < HPACK_DEFAULT_TABLE_SIZE ? value : HPACK_DEFAULT_TABLE_SIZE);
+      break;
+
+    case HTTP2_SETTINGS_ENABLE_PUSH:
+      if (value > 1) {
+        return HTTP2_ERROR_PROTOCOL_ERROR;
+      }
+      break;
+
+    case HTTP2_SETTINGS_INITIAL_WINDOW_SIZE:
+      if (value > HTTP2_MAX_WINDOW_SIZE) {
+        return HTTP2_ERROR_FLOW_CONTROL_ERROR;
+      }
+      window_delta += (int64_t)value - peer_initial_window;
+      peer_initial_window = value;
+      break;
+
+    case HTTP2_SETTINGS_MAX_FRAME_SIZE:
+      if (value < HTTP2_MAX_FRAME_SIZE || value > HTTP2_MAX_FRAME_SIZE_LIMIT) {
+        return HTTP2_ERROR_PROTOCOL_ERROR;
+      }
+      peer_max_frame_size = value;
+      break;
+
+    default:
+      break;
+    }
+  }
+
+  write_frame(HTTP2_FRAME_TYPE_SETTINGS, HTTP2_FLAGS_ACK, 0, NULL, 0);
+
+  // A new initial window applies to every open stream (RFC 7540 section 6.9.2).
+  if (window_delta) {
+    for (Http2Stream * stream = streams.head; stream; stream = stream->link.next) {
+      stream->send_window += window_delta;
+      if (stream->send_window > HTTP2_MAX_WINDOW_SIZE) {
+        return HTTP2_ERROR_FLOW_CONTROL_ERROR;
+      }
+    }
+    if (window_delta > 0) {
+      resume_streams();
+    }
+  }
+
+  return HTTP2_ERROR_NO_ERROR;
+}
+
+Http2ErrorCode
+Http2ClientSession::process_window_update(const Http2FrameHeader & hdr, const uint8_t * payload)
+{
+  uint32_t increment;
+
+  if (hdr.length != HTTP2_WINDOW_UPDATE_LEN) {
+    return HTTP2_ERROR_FRAME_SIZE_ERROR;
+  }
+
+  increment = http2_read_u32(payload) & 0x7fffffff;
+
+  if (hdr.streamid == 0) {
+    if (increment == 0) {
+      return HTTP2_ERROR_PROTOCOL_ERROR;
+    }
+    send_window += increment;
+    if (send_window > HTTP2_MAX_WINDOW_SIZE) {
+      return HTTP2_ERROR_FLOW_CONTROL_ERROR;
+    }
+    resume_streams();
+    return HTTP2_ERROR_NO_ERROR;
+  }
+
+  Http2Stream * stream = find_stream(hdr.streamid);
+  if (stream == NULL) {
+    return HTTP2_ERROR_NO_ERROR;
+  }
+
+  if (increment == 0) {
+    reset_stream(stream, HTTP2_ERROR_PROTOCOL_ERROR);
+    return HTTP2_ERROR_NO_ERROR;
+  }
+
+  stream->send_window += increment;
+  if (stream->send_window > HTTP2_MAX_WINDOW_SIZE) {
+    reset_stream(stream, HTTP2_ERROR_FLOW_CONTROL_ERROR);
+    return HTTP2_ERROR_NO_ERROR;
+  }
+
+  send_response(stream);
+  return HTTP2_ERROR_NO_ERROR;
+}
+
+Http2Stream *
+Http2ClientSession::find_stream(uint32_t id) const
+{
+  for (Http2Stream * stream = streams.head; stream; stream = stream->link.next) {
+    if (stream->id == id) {
+      return stream;
+    }
+  }
+
+  return NULL;
+}
+
+Http2Stream *
+Http2ClientSession::open_stream(uint32_t id, MIOBuffer * request, IOBufferReader * reader, bool end_stream)
+{
+  PluginVCCore * core = PluginVCCore::alloc(true);
+  Http2Stream * stream;
+  PluginVC * vc;
+
+  core->set_active_addr(client_vc->get_remote_addr());
+  core->set_passive_addr(client_vc->get_local_addr());
+  core->set_accept_cont(this);
+
+  vc = core->connect();
+  if (vc == NULL) {
+    core->kill_no_connect();
+    free_MIOBuffer(request);
+    return NULL;
+  }
+
+  stream = http2StreamAllocator.alloc();
+  stream->init(this, id);
+  stream->vc = vc;
+  stream->request_buffer = request;
+  stream->request_reader = reader;
+  stream->request_done = end_stream;
+  stream->response_buffer = new_MIOBuffer(BUFFER_SIZE_INDEX_32K);
+  stream->response_reader = stream->response_buffer->alloc_reader();
+  stream->send_window = peer_initial_window;
+  stream->recv_window = Http2::initial_window_size;
+
+  stream->request_vio = vc->do_io_write(stream, end_stream ? reader->read_avail() : INT64_MAX, reader);
+  stream->response_vio = vc->do_io_read(stream, INT64_MAX, stream->response_buffer);
+
+  streams.push(stream);
+  if (nstreams++ == 0) {
+    // Idle waiting on the origin is the state machine's business, not ours.
+    client_vc->cancel_inactivity_timeout();
+  }
+
+  DebugHttp2("stream %u opened, %u active", id, nstreams);
+  return stream;
+}
+
+void
+Http2ClientSession::close_stream(Http2Stream * stream)
+{
+  DebugHttp2("stream %u closed", stream->id);
+
+  streams.remove(stream);
+  if (--nstreams == 0 && !closing) {
+    client_vc->set_inactivity_timeout(HRTIME_SECONDS(Http2::no_activity_timeout_in));
+  }
+
+  stream->vc->do_io_close();
+  stream->response.destroy();
+  http_parser_clear(&stream->parser);
+  free_MIOBuffer(stream->request_buffer);
+  free_MIOBuffer(stream->response_buffer);
+  stream->mutex.clear();
+  http2StreamAllocator.free(stream);
+}
+
+void
+Http2ClientSession::reset_stream(Http2Stream * stream, Http2ErrorCode code)
+{
+  write_rst_stream(stream->id, code);
+  close_stream(stream);
+}
+
+void
+Http2ClientSession::send_response(Http2Stream * stream)
+{
+  if (!stream->headers_sent) {
+    int bytes_used;
+    MIMEParseResult result =
+      stream->response.parse_resp(&stream->parser, stream->response_reader, &bytes_used, stream->response_done);
+
+    if (result == PARSE_CONT && !stream->response_done) {
+      stream->response_vio->reenable();
+      return;
+    }
+
+    if (result != PARSE_DONE) {
+      DebugHttp2("stream %u has no valid response header", stream->id);
+      reset_stream(stream, HTTP2_ERROR_INTERNAL_ERROR);
+      return;
+    }
+
+    if (!send_headers(stream)) {
+      return;
+    }
+  }
+
+  send_data(stream);
+
+  if (stream->end_stream_sent) {
+    if (stream->request_done) {
+      close_stream(stream);
+    } else {
+      // The response is complete before the request body; tell the client to stop sending it
+      // (RFC 7540 section 8.1).
+      reset_stream(stream, HTTP2_ERROR_NO_ERROR);
+    }
+  }
+}
+
+bool
+Http2ClientSession::send_headers(Http2Stream * stream)
+{
+  int64_t bound = http2_response_header_bound(&stream->response);
+  uint8_t * block = (uint8_t *)ats_malloc(bound);
+  int64_t len = http2_encode_response_header(encoder, &stream->response, block, block + bound);
+  uint8_t type = HTTP2_FRAME_TYPE_HEADERS;
+  uint8_t flags = 0;
+  int64_t sent = 0;
+
+  if (len < 0) {
+    // The encoder state no longer matches what the client saw.
+    ats_free(block);
+    connection_error(HTTP2_ERROR_INTERNAL_ERROR);
+    return false;
+  }
+
+  if (stream->response_done && stream->response_reader->read_avail() == 0) {
+    flags |= HTTP2_FLAGS_END_STREAM;
+    stream->end_stream_sent = true;
+  }
+
+  // Anything past the peer's frame size goes out in CONTINUATION frames.
+  do {
+    uint32_t n = (uint32_t)((len - sent) < peer_max_frame_size ? (len - sent) : peer_max_frame_size);
+
+    if (sent + n == len) {
+      flags |= HTTP2_FLAGS_END_HEADERS;
+    }
+    write_frame(type, flags, stream->id, block + sent, n);
+    sent += n;
+    type = HTTP2_FRAME_TYPE_CONTINUATION;
+    flags = 0;
+  } while (sent < len);
+
+  ats_free(block);
+  stream->headers_sent = true;
+
+  DebugHttp2("stream %u sent %d response header in %" PRId64 " bytes", stream->id, (int)stream->response.status_get(),
+             len);
+  return true;
+}
+
+void
+Http2ClientSession::send_data(Http2Stream * stream)
+{
+  bool consumed = false;
+
+  while (!stream->end_stream_sent) {
+    int64_t avail = stream->response_reader->read_avail();
+    int64_t len = avail;
+    uint8_t flags = 0;
+    uint8_t buf[HTTP2_FRAME_HEADER_LEN];
+    Http2FrameHeader hdr;
+
+    if (avail == 0 && !stream->response_done) {
+      break;
+    }
+
+    if (write_reader->read_avail() >= HTTP2_WRITE_HIGH_WATER) {
+      break;
+    }
+
+    if (len > peer_max_frame_size) {
+      len = peer_max_frame_size;
+    }
+    if (len > send_window) {
+      len = send_window;
+    }
+    if (len > stream->send_window) {
+      len = stream->send_window;
+    }
+
+    // Blocked on flow control until a WINDOW_UPDATE.
+    if (avail > 0 && len <= 0) {
+      break;
+    }
+
+    if (stream->response_done && len == avail) {
+      flags |= HTTP2_FLAGS_END_STREAM;
+      stream->end_stream_sent = true;
+    }
+
+    hdr.length = len;
+    hdr.type = HTTP2_FRAME_TYPE_DATA;
+    hdr.flags = flags;
+    hdr.streamid = stream->id;
+    http2_write_frame_header(hdr, buf);
+    write_buffer->write(buf, sizeof(buf));
+
+    if (len) {
+      write_buffer->write(stream->response_reader, len);
+      stream->response_reader->consume(len);
+      send_window -= len;
+      stream->send_window -= len;
+      consumed = true;
+    }
+  }
+
+  write_vio->reenable();
+  if (consumed && !stream->end_stream_sent) {
+    stream->response_vio->reenable();
+  }
+}
+
+void
+Http2ClientSession::resume_streams()
+{
+  Http2Stream * next;
+
+  for (Http2Stream * stream = streams.head; stream && !closing; stream = next) {
+    next = stream->link.next;
+    if (stream->headers_sent) {
+      send_response(stream);
+    }
+  }
+
+  // Whoever went first this time goes last next time.
+  if (!closing && nstreams > 1) {
+    Http2Stream * first = streams.pop();
+    streams.enqueue(first);
+  }
+}
+
+// Give the client back the window for request body the state machine has taken off our hands.
+void
+Http2ClientSession::update_request_window(Http2Stream * stream)
+{
+  int64_t drained;
+
+  if (stream->request_done) {
+    return;
+  }
+
+  drained = (int64_t)Http2::initial_window_size - stream->recv_window - stream->request_reader->read_avail();
+  if (drained >= (int64_t)Http2::initial_window_size / 2) {
+    write_window_update(stream->id, (uint32_t)drained);
+    stream->recv_window += drained;
+  }
+}
+
+void
+Http2ClientSession::write_frame(uint8_t type, uint8_t flags, uint32_t streamid, const uint8_t * payload, uint32_t len)
+{
+  uint8_t buf[HTTP2_FRAME_HEADER_LEN];
+  Http2FrameHeader hdr;
+
+  hdr.length = len;
+  hdr.type = type;
+  hdr.flags = flags;
+  hdr.streamid = streamid;
+  http2_write_frame_header(hdr, buf);
+
+  write_buffer->write(buf, sizeof(buf));
+  if (len) {
+    write_buffer->write(payload, len);
+  }
+
+  write_vio->reenable();
+}
+
+void
+Http2ClientSession::write_settings()
+{
+  uint8_t payload[2 * HTTP2_SETTINGS_PARAMETER_LEN];
+
+  payload[0] = 0;
+  payload[1] = HTTP2_SETTINGS_MAX_CONCURRENT_STREAMS;
+  http2_write_u32(Http2::max_concurrent_streams, payload + 2);
+  payload[6] = 0;
+  payload[7] = HTTP2_SETTINGS_INITIAL_WINDOW_SIZE;
+  http2_write_u32(Http2::initial_window_size, payload + 8);
+
+  write_frame(HTTP2_FRAME_TYPE_SETTINGS, 0, 0, payload, sizeof(payload));
+}
+
+void
+Http2ClientSession::write_rst_stream(uint32_t streamid, Http2ErrorCode code)
+{
+  uint8_t payload[HTTP2_RST_STREAM_LEN];
+
+  http2_write_u32(code, payload);
+  write_frame(HTTP2_FRAME_TYPE_RST_STREAM, 0, streamid, payload, sizeof(payload));
+}
+
+void
+Http2ClientSession::write_window_update(uint32_t streamid, uint32_t increment)
+{
+  uint8_t payload[HTTP2_WINDOW_UPDATE_LEN];
+
+  http2_write_u32(increment, payload);
+  write_frame(HTTP2_FRAME_TYPE_WINDOW_UPDATE, 0, streamid, payload, sizeof(payload));
+}
+
+void
+Http2ClientSession::write_goaway(Http2ErrorCode code)
+{
+  uint8_t payload[HTTP2_GOAWAY_LEN];
+
+  http2_write_u32(last_stream_id, payload);
+  http2_write_u32(code, payload + 4);
+  write_frame(HTTP2_FRAME_TYPE_GOAWAY, 0, 0, payload, sizeof(payload));
+}
+
+// Tell the client why we are going away, drop every stream, and close once that is written.
+void
+Http2ClientSession::connection_error(Http2ErrorCode code)
+{
+  if (closing) {
+    return;
+  }
+
+  DebugHttp2("closing the connection with error %d", code);
+
+  write_goaway(code);
+  closing = true;
+
+  while (streams.head) {
+    close_stream(streams.head);
+  }
+
+  client_vc->do_io_read(this, 0, NULL);
+  write_vio->nbytes = write_vio->ndone + write_reader->read_avail();
+  write_vio->reenable();
+}
+
+void
+Http2ClientSession::destroy()
+{
+  DebugHttp2("session destroy");
+
+  closing = true;
+  while (streams.head) {
+    close_stream(streams.head);
+  }
+
+  client_vc->do_io_close();
+  client_vc = NULL;
+
+  free_MIOBuffer(read_buffer);
+  free_MIOBuffer(write_buffer);
+  ats_free(header_block);
+  encoder.clear();
+  decoder.clear();
+
+  mutex.clear();
+  http2ClientSessionAllocator.free(this);
+}
@@ -0,0 +1,152 @@
+/** @file
+
+  An HTTP/2 client connection and its streams.
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#ifndef __HTTP2_CLIENT_SESSION_H__
+#define __HTTP2_CLIENT_SESSION_H__
+
+#include "HTTP2.h"
+#include "PluginVC.h"
+
+class Http2ClientSession;
+
+// One request and its response. Each stream gets its own HttpSM, reached through a direct
+// PluginVC that carries the request as HTTP/1 text; the state machine reads from and writes to
+// the stream's own buffers, so a stream costs a state machine rather than a socket, a FetchSM
+// or an intermediate buffer pair. Response bodies are handed to the client connection block by
+// block without copying.
+class Http2Stream : public Continuation
+{
+public:
+  Http2Stream();
+
+  void init(Http2ClientSession * session, uint32_t id);
+  int main_event_handler(int event, void * edata);
+
+  Http2ClientSession * session;
+  uint32_t id;
+
+  PluginVC * vc;
+  MIOBuffer * request_buffer;
+  IOBufferReader * request_reader;
+  VIO * request_vio;
+  MIOBuffer * response_buffer;
+  IOBufferReader * response_reader;
+  VIO * response_vio;
+
+  HTTPParser parser;
+  HTTPHdr response;
+
+  int64_t send_window;
+  int64_t recv_window;
+
+  bool request_done;     // END_STREAM received
+  bool response_done;    // the state machine closed its end
+  bool headers_sent;
+  bool end_stream_sent;
+
+  LINK(Http2Stream, link);
+};
+
+class Http2ClientSession : public Continuation
+{
+public:
+  Http2ClientSession();
+
+  // Take over a connection that negotiated HTTP/2. Streams are handed to http_accept as if they
+  // were HTTP/1 connections to the same port.
+  void new_connection(NetVConnection * new_vc, Continuation * http_accept);
+
+  int stream_event(Http2Stream * stream, int event, VIO * vio);
+
+private:
+  int main_event_handler(int event, void * edata);
+
+  void process_input();
+  Http2ErrorCode process_frame(const Http2FrameHeader & hdr);
+  Http2ErrorCode process_data(const Http2FrameHeader & hdr);
+  Http2ErrorCode process_headers(const Http2FrameHeader & hdr, const uint8_t * payload);
+  Http2ErrorCode process_continuation(const Http2FrameHeader & hdr, const uint8_t * payload);
+  Http2ErrorCode process_settings(const Http2FrameHeader & hdr, const uint8_t * payload);
+  Http2ErrorCode process_window_update(const Http2FrameHeader & hdr, const uint8_t * payload);
+  Http2ErrorCode process_header_block();
+
+  Http2Stream * find_stream(uint32_t id) const;
+  Http2Stream * open_stream(uint32_t id, MIOBuffer * request, IOBufferReader * reader, bool end_stream);
+  void close_stream(Http2Stream * stream);
+  void reset_stream(Http2Stream * stream, Http2ErrorCode code);
+
+  void send_response(Http2Stream * stream);
+  bool send_headers(Http2Stream * stream);
+  void send_data(Http2Stream * stream);
+  void resume_streams();
+  void update_request_window(Http2Stream * stream);
+
+  void write_frame(uint8_t type, uint8_t flags, uint32_t streamid, const uint8_t * payload, uint32_t len);
+  void write_settings();
+  void write_rst_stream(uint32_t streamid, Http2ErrorCode code);
+  void write_window_update(uint32_t streamid, uint32_t increment);
+  void write_goaway(Http2ErrorCode code);
+
+  void connection_error(Http2ErrorCode code);
+  void destroy();
+
+  int64_t con_id;
+  NetVConnection * client_vc;
+  Continuation * http_accept;
+
+  MIOBuffer * read_buffer;
+  IOBufferReader * read_reader;
+  VIO * read_vio;
+  MIOBuffer * write_buffer;
+  IOBufferReader * write_reader;
+  VIO * write_vio;
+
+  HpackEncoder encoder;
+  HpackDecoder decoder;
+
+  Queue<Http2Stream> streams;
+  uint32_t nstreams;
+  uint32_t last_stream_id;
+
+  // Flow control windows for the whole connection, and what the peer asked for.
+  int64_t send_window;
+  int64_t recv_window;
+  uint32_t peer_initial_window;
+  uint32_t peer_max_frame_size;
+
+  // A header block spread over HEADERS and CONTINUATION frames.
+  uint8_t * header_block;
+  uint32_t header_block_len;
+  uint32_t header_block_stream;
+  bool header_block_end_stream;
+
+  bool preface_received;
+  bool goaway_received;
+  bool closing;          // GOAWAY is on its way out, the connection goes once it is written
+  bool dead;             // destroy at the end of the current event
+};
+
+extern ClassAllocator<Http2ClientSession> http2ClientSessionAllocator;
+extern ClassAllocator<Http2Stream> http2StreamAllocator;
+
+#endif /* __HTTP2_CLIENT_SESSION_H__ */
@@ -0,0 +1,1105 @@
+/** @file
+
+  An HTTP/2 connection to an origin server and its streams.
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#include "Http2ServerSession.h"
+#include "HttpSessionManager.h"
+
+#define DebugHttp2(fmt, ...) Debug("http2_ss", "[%" PRId64 "] " fmt, con_id, ##__VA_ARGS__)
+
+// Stop moving request bodies once this much is queued for the origin; the net thread tells us
+// when it has drained.
+#define HTTP2_WRITE_HIGH_WATER (64 * 1024)
+
+#define HTTP2_WRITE_BUFFER_SIZE_INDEX BUFFER_SIZE_INDEX_1K
+#define HTTP2_READ_BUFFER_SIZE_INDEX  BUFFER_SIZE_INDEX_16K
+
+// Stream identifiers we open are odd and may not go past 2^31 - 1.
+#define HTTP2_MAX_STREAM_ID 0x7fffffff
+
+ClassAllocator<Http2ServerSession> http2ServerSessionAllocator("http2ServerSessionAllocator");
+ClassAllocator<Http2ServerStream> http2ServerStreamAllocator("http2ServerStreamAllocator");
+
+static int64_t next_http2_ss_id = 0;
+
+Http2ServerStream::Http2ServerStream()
+  : Continuation(NULL), session(NULL), id(0), vc(NULL),
+    request_buffer(NULL), request_reader(NULL), request_vio(NULL),
+    response_buffer(NULL), response_reader(NULL), response_vio(NULL),
+    body_left(0), send_window(0), recv_window(0),
+    headers_sent(false), end_stream_sent(false), response_started(false), response_done(false)
+{
+  memset(&parser, 0, sizeof(parser));
+}
+
+void
+Http2ServerStream::init(Http2ServerSession * s)
+{
+  session = s;
+  mutex = s->mutex;
+  http_parser_init(&parser);
+  request.create(HTTP_TYPE_REQUEST);
+  SET_HANDLER(&Http2ServerStream::main_event_handler);
+}
+
+int
+Http2ServerStream::main_event_handler(int event, void * edata)
+{
+  return session->stream_event(this, event, edata);
+}
+
+Http2ServerSession::Http2ServerSession()
+  : Continuation(NULL), thread(NULL), listed(false), con_id(0), server_vc(NULL),
+    read_buffer(NULL), read_reader(NULL), read_vio(NULL),
+    write_buffer(NULL), write_reader(NULL), write_vio(NULL),
+    nstreams(0), next_stream_id(1),
+    send_window(HTTP2_INITIAL_WINDOW_SIZE), recv_window(HTTP2_INITIAL_WINDOW_SIZE),
+    peer_initial_window(HTTP2_INITIAL_WINDOW_SIZE), peer_max_frame_size(HTTP2_MAX_FRAME_SIZE),
+    peer_max_streams(UINT32_MAX),
+    header_block(NULL), header_block_len(0), header_block_stream(0), header_block_end_stream(false),
+    settings_received(false), goaway_received(false), closing(false), dead(false)
+{
+}
+
+void
+Http2ServerSession::new_connection(NetVConnection * new_vc, sockaddr const * addr)
+{
+  ink_assert(new_vc != NULL);
+  ink_assert(server_vc == NULL);
+
+  server_vc = new_vc;
+  thread = new_vc->thread;
+  ats_ip_copy(&server_ip, addr);
+  mutex = new_ProxyMutex();
+  con_id = ink_atomic_increment(&next_http2_ss_id, 1);
+
+  DebugHttp2("session born, netvc %p", new_vc);
+
+  read_buffer = new_MIOBuffer(HTTP2_READ_BUFFER_SIZE_INDEX);
+  read_reader = read_buffer->alloc_reader();
+  write_buffer = new_MIOBuffer(HTTP2_WRITE_BUFFER_SIZE_INDEX);
+  write_reader = write_buffer->alloc_reader();
+
+  SET_HANDLER(&Http2ServerSession::main_event_handler);
+
+  server_vc->set_inactivity_timeout(HRTIME_SECONDS(Http2::no_activity_timeout_out));
+  write_vio = server_vc->do_io_write(this, INT64_MAX, write_reader);
+  read_vio = server_vc->do_io_read(this, INT64_MAX, read_buffer);
+
+  // We know the origin speaks HTTP/2, so the request frames can follow the preface right away
+  // (RFC 7540 section 3.4).
+  write_buffer->write(HTTP2_CONNECTION_PREFACE, HTTP2_CONNECTION_PREFACE_LEN);
+  write_settings();
+}
+
+bool
+Http2ServerSession::can_open_stream() const
+{
+  return !closing && !goaway_received && next_stream_id < HTTP2_MAX_STREAM_ID &&
+    nstreams < Http2::max_concurrent_streams_out && nstreams < peer_max_streams;
+}
+
+NetVConnection *
+Http2ServerSession::open_stream()
+{
+  PluginVCCore * core;
+  Http2ServerStream * stream;
+  PluginVC * vc;
+
+  ink_assert(mutex->thread_holding == this_ethread());
+  if (!can_open_stream()) {
+    return NULL;
+  }
+
+  // The state machine's end looks like a connection from us to the origin.
+  core = PluginVCCore::alloc(true);
+  core->set_active_addr(server_vc->get_local_addr());
+  core->set_passive_addr(server_vc->get_remote_addr());
+
+  stream = http2ServerStreamAllocator.alloc();
+  stream->init(this);
+  stream->response_buffer = new_MIOBuffer(BUFFER_SIZE_INDEX_32K);
+  stream->response_reader = stream->response_buffer->alloc_reader();
+  stream->send_window = peer_initial_window;
+  stream->recv_window = Http2::initial_window_size_out;
+  core->set_accept_cont(stream);
+
+  // We hold the stream's mutex, so our end arrives before connect() returns.
+  vc = core->connect();
+  if (vc == NULL) {
+    core->kill_no_connect();
+    stream->request.destroy();
+    free_MIOBuffer(stream->response_buffer);
+    stream->mutex.clear();
+    http2ServerStreamAllocator.free(stream);
+    return NULL;
+  }
+
+  streams.push(stream);
+  if (nstreams++ == 0) {
+    // Idle waiting on the origin is the state machines' business, not ours.
+    server_vc->cancel_inactivity_timeout();
+  }
+
+  DebugHttp2("stream opened, %u active", nstreams);
+  return vc;
+}
+
+void
+Http2ServerSession::accept_stream(Http2ServerStream * stream, PluginVC * vc)
+{
+  stream->vc = vc;
+  stream->request_buffer = new_MIOBuffer(BUFFER_SIZE_INDEX_4K);
+  stream->request_reader = stream->request_buffer->alloc_reader();
+  stream->request_vio = vc->do_io_read(stream, INT64_MAX, stream->request_buffer);
+  stream->response_vio = vc->do_io_write(stream, INT64_MAX, stream->response_reader);
+}
+
+int
+Http2ServerSession::main_event_handler(int event, void * /* edata ATS_UNUSED */)
+{
+  switch (event) {
+  case VC_EVENT_READ_READY:
+  case VC_EVENT_READ_COMPLETE:
+    if (!closing) {
+      process_input();
+    }
+    break;
+
+  case VC_EVENT_WRITE_READY:
+    if (!closing) {
+      resume_streams();
+    }
+    break;
+
+  case VC_EVENT_WRITE_COMPLETE:
+    // Only a closing session limits its write, and it has now sent everything.
+    dead = true;
+    break;
+
+  case VC_EVENT_EOS:
+  case VC_EVENT_ERROR:
+  case VC_EVENT_ACTIVE_TIMEOUT:
+  case VC_EVENT_INACTIVITY_TIMEOUT:
+  default:
+    DebugHttp2("closing on event %d", event);
+    dead = true;
+    break;
+  }
+
+  if (dead) {
+    destroy();
+  }
+
+  return EVENT_CONT;
+}
+
+int
+Http2ServerSession::stream_event(Http2ServerStream * stream, int event, void * edata)
+{
+  switch (event) {
+  case NET_EVENT_ACCEPT:
+    accept_stream(stream, static_cast<PluginVC *>(edata));
+    break;
+
+  case VC_EVENT_READ_READY:
+  case VC_EVENT_READ_COMPLETE:
+    send_request(stream);
+    break;
+
+  case VC_EVENT_WRITE_READY:
+    update_response_window(stream);
+    break;
+
+  case VC_EVENT_WRITE_COMPLETE:
+    // The state machine has taken the whole response.
+    if (stream->end_stream_sent) {
+      close_stream(stream);
+    } else {
+      reset_stream(stream, HTTP2_ERROR_NO_ERROR);
+    }
+    break;
+
+  case VC_EVENT_EOS:
+  case VC_EVENT_ERROR:
+  case VC_EVENT_ACTIVE_TIMEOUT:
+  case VC_EVENT_INACTIVITY_TIMEOUT:
+  default:
+    // The state machine is done with the stream, whether or not the origin is.
+    DebugHttp2("stream %u closed by the state machine on event %d", stream->id, event);
+    reset_stream(stream, HTTP2_ERROR_CANCEL);
+    break;
+  }
+
+  // An origin that sent GOAWAY gets the connection closed once our last stream is done.
+  if (goaway_received && nstreams == 0 && !closing) {
+    connection_error(HTTP2_ERROR_NO_ERROR);
+  }
+
+  if (dead) {
+    destroy();
+  }
+
+  return EVENT_CONT;
+}
+
+void
+Http2ServerSession::process_input()
+{
+  while (!closing) {
+    int64_t avail = read_reader->read_avail();
+    uint8_t buf[HTTP2_FRAME_HEADER_LEN];
+    Http2FrameHeader hdr;
+    Http2ErrorCode err;
+
+    if (avail < HTTP2_FRAME_HEADER_LEN) {
+      break;
+    }
+
+    read_reader->memcpy(buf, sizeof(buf));
+    http2_parse_frame_header(buf, hdr);
+
+    // The server preface is a SETTINGS frame. An origin that answers in HTTP/1 fails here.
+    if (!settings_received && hdr.type != HTTP2_FRAME_TYPE_SETTINGS) {
+      DebugHttp2("bad server preface");
+      connection_error(HTTP2_ERROR_PROTOCOL_ERROR);
+      break;
+    }
+
+    if (hdr.length > HTTP2_MAX_PAYLOAD_LEN) {
+      connection_error(HTTP2_ERROR_FRAME_SIZE_ERROR);
+      break;
+    }
+
+    if (avail < HTTP2_FRAME_HEADER_LEN + hdr.length) {
+      break;
+    }
+
+    read_reader->consume(HTTP2_FRAME_HEADER_LEN);
+
+    err = process_frame(hdr);
+    if (err != HTTP2_ERROR_NO_ERROR) {
+      DebugHttp2("frame type %u on stream %u failed with error %d", hdr.type, hdr.streamid, err);
+      connection_error(err);
+      break;
+    }
+  }
+
+  if (!closing) {
+    read_vio->reenable();
+  }
+}
+
+// The payload is still in the read buffer; every path here consumes exactly hdr.length bytes.
+Http2ErrorCode
+Http2ServerSession::process_frame(const Http2FrameHeader & hdr)
+{
+  uint8_t payload[HTTP2_MAX_PAYLOAD_LEN];
+
+  // Nothing may come between the frames of a header block (RFC 7540 section 6.10).
+  if (header_block_stream && hdr.type != HTTP2_FRAME_TYPE_CONTINUATION) {
+    return HTTP2_ERROR_PROTOCOL_ERROR;
+  }
+
+  if (hdr.type == HTTP2_FRAME_TYPE_DATA) {
+    return process_data(hdr);
+  }
+
+  read_reader->memcpy(payload, hdr.length);
+  read_reader->consume(hdr.length);
+
+  switch (hdr.type) {
+  case HTTP2_FRAME_TYPE_HEADERS:
+    return process_headers(hdr, payload);
+
+  case HTTP2_FRAME_TYPE_CONTINUATION:
+    return process_continuation(hdr, payload);
+
+  case HTTP2_FRAME_TYPE_SETTINGS:
+    return process_settings(hdr, payload);
+
+  case HTTP2_FRAME_TYPE_WINDOW_UPDATE:
+    return process_window_update(hdr, payload);
+
+  case HTTP2_FRAME_TYPE_GOAWAY:
+    return process_goaway(hdr, payload);
+
+  case HTTP2_FRAME_TYPE_PING:
+    if (hdr.streamid != 0) {
+      return HTTP2_ERROR_PROTOCOL_ERROR;
+    }
+    if (hdr.length != HTTP2_PING_LEN) {
+      return HTTP2_ERROR_FRAME_SIZE_ERROR;
+    }
+    if (!(hdr.flags & HTTP2_FLAGS_ACK)) {
+      write_frame(HTTP2_FRAME_TYPE_PING, HTTP2_FLAGS_ACK, 0, payload, HTTP2_PING_LEN);
+    }
+    return HTTP2_ERROR_NO_ERROR;
+
+  case HTTP2_FRAME_TYPE_RST_STREAM:
+    if (hdr.streamid == 0) {
+      return HTTP2_ERROR_PROTOCOL_ERROR;
+    }
+    if (hdr.length != HTTP2_RST_STREAM_LEN) {
+      return HTTP2_ERROR_FRAME_SIZE_ERROR;
+    }
+    if (Http2ServerStream * stream = find_stream(hdr.streamid)) {
+      DebugHttp2("stream %u reset by the origin with error %u", hdr.streamid, http2_read_u32(payload));
+      if (stream->response_done) {
+        // A complete response, and the origin wants no more of the request body (RFC 7540
+        // section 8.1). The state machine still gets the rest of the response.
+        stream->end_stream_sent = true;
+      } else {
+        close_stream(stream);
+      }
+    }
+    return HTTP2_ERROR_NO_ERROR;
+
+  case HTTP2_FRAME_TYPE_PRIORITY:
+    if (hdr.streamid == 0) {
+      return HTTP2_ERROR_PROTOCOL_ERROR;
+    }
+    if (hdr.length != HTTP2_PRIORITY_LEN) {
+      return HTTP2_ERROR_FRAME_SIZE_ERROR;
+    }
+    return HTTP2_ERROR_NO_ERROR;
+
+  case HTTP2_FRAME_TYPE_PUSH_PROMISE:
+    // We disabled push in our SETTINGS.
+    return HTTP2_ERROR_PROTOCOL_ERROR;
+
+  default:
+    // Unknown frame types are ignored (RFC 7540 section 4.1).
+    return HTTP2_ERROR_NO_ERROR;
+  }
+}
+
+Http2ErrorCode
+Http2ServerSession::process_data(const Http2FrameHeader & hdr)
+{
+  Http2ServerStream * stream;
+  uint32_t pad = 0;
+  uint32_t len = hdr.length;
+
+  if (hdr.streamid == 0) {
+    return HTTP2_ERROR_PROTOCOL_ERROR;
+  }
+
+  if (hdr.flags & HTTP2_FLAGS_PADDED) {
+    uint8_t padlen;
+
+    if (hdr.length < 1) {
+      return HTTP2_ERROR_FRAME_SIZE_ERROR;
+    }
+    read_reader->memcpy(&padlen, 1);
+    read_reader->consume(1);
+    pad = padlen;
+    len -= 1;
+    if (pad > len) {
+      read_reader->consume(len);
+      return HTTP2_ERROR_PROTOCOL_ERROR;
+    }
+    len -= pad;
+  }
+
+  // As for clients, the streams' own windows bound what we buffer, so the connection window is
+  // simply topped up as it drains.
+  recv_window -= hdr.length;
+  if (recv_window < 0) {
+    read_reader->consume(len + pad);
+    return HTTP2_ERROR_FLOW_CONTROL_ERROR;
+  }
+  if (recv_window <= HTTP2_INITIAL_WINDOW_SIZE / 2) {
+    write_window_update(0, HTTP2_INITIAL_WINDOW_SIZE - recv_window);
+    recv_window = HTTP2_INITIAL_WINDOW_SIZE;
+  }
+
+  stream = find_stream(hdr.streamid);
+  if (stream == NULL || !stream->response_started || stream->response_done) {
+    read_reader->consume(len + pad);
+    // DATA on a stream we never opened is a connection error; on one we already reset it is
+    // just late.
+    if (stream == NULL && hdr.streamid >= next_stream_id) {
+      return HTTP2_ERROR_PROTOCOL_ERROR;
+    }
+    if (stream) {
+      reset_stream(stream, HTTP2_ERROR_PROTOCOL_ERROR);
+    }
+    return HTTP2_ERROR_NO_ERROR;
+  }
+
+  stream->recv_window -= hdr.length;
+  if (stream->recv_window < 0) {
+    read_reader->consume(len + pad);
+    reset_stream(stream, HTTP2_ERROR_FLOW_CONTROL_ERROR);
+    return HTTP2_ERROR_NO_ERROR;
+  }
+
+  stream->response_buffer->write(read_reader, len);
+  read_reader->consume(len + pad);
+
+  if (hdr.flags & HTTP2_FLAGS_END_STREAM) {
+    finish_response(stream);
+  } else {
+    stream->response_vio->reenable();
+  }
+
+  return HTTP2_ERROR_NO_ERROR;
+}
+
+Http2ErrorCode
+Http2ServerSession::process_headers(const Http2FrameHeader & hdr, const uint8_t * payload)
+{
+  uint32_t offset = 0;
+  uint32_t pad = 0;
+  uint32_t len;
+
+  if (hdr.streamid == 0 || (hdr.streamid & 1) == 0 || hdr.streamid >= next_stream_id) {
+    return HTTP2_ERROR_PROTOCOL_ERROR;
+  }
+
+  if (hdr.flags & HTTP2_FLAGS_PADDED) {
+    if (hdr.length < 1) {
+      return HTTP2_ERROR_FRAME_SIZE_ERROR;
+    }
+    pad = payload[0];
+    offset += 1;
+  }
+
+  if (hdr.flags & HTTP2_FLAGS_PRIORITY) {
+    offset += HTTP2_PRIORITY_LEN;
+  }
+
+  if (offset + pad > hdr.length) {
+    return HTTP2_ERROR_PROTOCOL_ERROR;
+  }
+  len = hdr.length - offset - pad;
+
+  if (len > HTTP2_MAX_HEADER_BLOCK_LEN) {
+    return HTTP2_ERROR_ENHANCE_YOUR_CALM;
+  }
+
+  header_block = (uint8_t *)ats_realloc(header_block, len ? len : 1);
+  memcpy(header_block, payload + offset, len);
+  header_block_len = len;
+  header_block_stream = hdr.streamid;
+  header_block_end_stream = hdr.flags & HTTP2_FLAGS_END_STREAM;
+
+  if (hdr.flags & HTTP2_FLAGS_END_HEADERS) {
+    return process_header_block();
+  }
+
+  return HTTP2_ERROR_NO_ERROR;
+}
+
+Http2ErrorCode
+Http2ServerSession::process_continuation(const Http2FrameHeader & hdr, const uint8_t * payload)
+{
+  if (header_block_stream == 0 || hdr.streamid != header_block_stream) {
+    return HTTP2_ERROR_PROTOCOL_ERROR;
+  }
+
+  if (header_block_len + hdr.length > HTTP2_MAX_HEADER_BLOCK_LEN) {
+    return HTTP2_ERROR_ENHANCE_YOUR_CALM;
+  }
+
+  header_block = (uint8_t *)ats_realloc(header_block, header_block_len + hdr.length + 1);
+  memcpy(header_block + header_block_len, payload, hdr.length);
+  header_block_len += hdr.length;
+
+  if (hdr.flags & HTTP2_FLAGS_END_HEADERS) {
+    return process_header_block();
+  }
+
+  return HTTP2_ERROR_NO_ERROR;
+}
+
+Http2ErrorCode
+Http2ServerSession::process_header_block()
+{
+  uint32_t id = header_block_stream;
+  bool end_stream = header_block_end_stream;
+  Http2ServerStream * stream = find_stream(id);
+  Http2HeaderResult result;
+  int status;
+
+  header_block_stream = 0;
+
+  // Trailers, or headers for a stream we already reset. The block still has to go through the
+  // decoder to keep the dynamic table in step; trailers have no place in the HTTP/1.1 response.
+  if (stream == NULL || stream->response_started) {
+    const uint8_t * p = header_block;
+    const uint8_t * end = header_block + header_block_len;
+
+    while (p < end) {
+      HpackField field;
+      int64_t n = decoder.decode(p, end, field);
+
+      if (n < 0) {
+        return HTTP2_ERROR_COMPRESSION_ERROR;
+      }
+      p += n;
+    }
+
+    if (stream) {
+      if (!end_stream || stream->response_done) {
+        reset_stream(stream, HTTP2_ERROR_PROTOCOL_ERROR);
+      } else {
+        finish_response(stream);
+      }
+    }
+    return HTTP2_ERROR_NO_ERROR;
+  }
+
+  result = http2_convert_response_header(decoder, header_block, header_block_len, stream->response_buffer, status);
+
+  if (result == HTTP2_HEADER_CONNECTION_ERROR) {
+    return HTTP2_ERROR_COMPRESSION_ERROR;
+  }
+
+  // An interim response may not end the stream.
+  if (result == HTTP2_HEADER_STREAM_ERROR || (status < 200 && end_stream)) {
+    DebugHttp2("stream %u has a malformed response header", id);
+    reset_stream(stream, HTTP2_ERROR_PROTOCOL_ERROR);
+    return HTTP2_ERROR_NO_ERROR;
+  }
+
+  DebugHttp2("stream %u received %d response header", id, status);
+  if (status >= 200) {
+    stream->response_started = true;
+  }
+
+  if (end_stream) {
+    finish_response(stream);
+  } else {
+    stream->response_vio->reenable();
+  }
+
+  return HTTP2_ERROR_NO_ERROR;
+}
+
+Http2ErrorCode
+Http2ServerSession::process_settings(const Http2FrameHeader & hdr, const uint8_t * payload)
+{
+  int64_t window_delta = 0;
+
+  if (hdr.streamid != 0) {
+    return HTTP2_ERROR_PROTOCOL_ERROR;
+  }
+
+  if (hdr.flags & HTTP2_FLAGS_ACK) {
+    return hdr.length == 0 ? HTTP2_ERROR_NO_ERROR : HTTP2_ERROR_FRAME_SIZE_ERROR;
+  }
+
+  if (hdr.length % HTTP2_SETTINGS_PARAMETER_LEN) {
+    return HTTP2_ERROR_FRAME_SIZE_ERROR;
+  }
+
+  settings_received = true;
+
+  for (uint32_t i = 0; i < hdr.length; i += HTTP2_SETTINGS_PARAMETER_LEN) {
+    uint16_t id = ((uint16_t)payload[i] << 8) | payload[i + 1];
+    uint32_t value = http2_read_u32(payload + i + 2);
+
+    switch (id) {
+    case HTTP2_SETTINGS_HEADER_TABLE_SIZE:
+      encoder.set_max_size(value < HPACK_DEFAULT_TABLE_SIZE ? value : HPACK_DEFAULT_TABLE_SIZE);
+      break;
+
+    case HTTP2_SETTINGS_MAX_CONCURRENT_STREAMS:
+      peer_max_streams = value;
+      break;
+
+    case HTTP2_SETTINGS_INITIAL_WINDOW_SIZE:
+      if (value > HTTP2_MAX_WINDOW_SIZE) {
+        return HTTP2_ERROR_FLOW_CONTROL_ERROR;
+      }
+      window_delta += (int64_t)value - peer_initial_window;
+      peer_initial_window = value;
+      break;
+
+    case HTTP2_SETTINGS_MAX_FRAME_SIZE:
+      if (value < HTTP2_MAX_FRAME_SIZE || value > HTTP2_MAX_FRAME_SIZE_LIMIT) {
+        return HTTP2_ERROR_PROTOCOL_ERROR;
+      }
+      peer_max_frame_size = value;
+      break;
+
+    default:
+      break;
+    }
+  }
+
+  write_frame(HTTP2_FRAME_TYPE_SETTINGS, HTTP2_FLAGS_ACK, 0, NULL, 0);
+
+  // A new initial window applies to every open stream (RFC 7540 section 6.9.2).
+  if (window_delta) {
+    for (Http2ServerStream * stream = streams.head; stream; stream = stream->link.next) {
+      stream->send_window += window_delta;
+      if (stream->send_window > HTTP2_MAX_WINDOW_SIZE) {
+        return HTTP2_ERROR_FLOW_CONTROL_ERROR;
+      }
+    }
+    if (window_delta > 0) {
+      resume_streams();
+    }
+  }
+
+  return HTTP2_ERROR_NO_ERROR;
+}
+
+Http2ErrorCode
+Http2ServerSession::process_window_update(const Http2FrameHeader & hdr, const uint8_t * payload)
+{
+  uint32_t increment;
+
+  if (hdr.length != HTTP2_WINDOW_UPDATE_LEN) {
+    return HTTP2_ERROR_FRAME_SIZE_ERROR;
+  }
+
+  increment = http2_read_u32(payload) & 0x7fffffff;
+
+  if (hdr.streamid == 0) {
+    if (increment == 0) {
+      return HTTP2_ERROR_PROTOCOL_ERROR;
+    }
+    send_window += increment;
+    if (send_window > HTTP2_MAX_WINDOW_SIZE) {
+      return HTTP2_ERROR_FLOW_CONTROL_ERROR;
+    }
+    resume_streams();
+    return HTTP2_ERROR_NO_ERROR;
+  }
+
+  Http2ServerStream * stream = find_stream(hdr.streamid);
+  if (stream == NULL) {
+    return HTTP2_ERROR_NO_ERROR;
+  }
+
+  if (increment == 0) {
+    reset_stream(stream, HTTP2_ERROR_PROTOCOL_ERROR);
+    return HTTP2_ERROR_NO_ERROR;
+  }
+
+  stream->send_window += increment;
+  if (stream->send_window > HTTP2_MAX_WINDOW_SIZE) {
+    reset_stream(stream, HTTP2_ERROR_FLOW_CONTROL_ERROR);
+    return HTTP2_ERROR_NO_ERROR;
+  }
+
+  send_data(stream);
+  return HTTP2_ERROR_NO_ERROR;
+}
+
+// The origin is going away. Streams it never saw are closed before any response, so their state
+// machines try again, on another connection.
+Http2ErrorCode
+Http2ServerSession::process_goaway(const Http2FrameHeader & hdr, const uint8_t * payload)
+{
+  uint32_t last_stream_id;
+  Http2ServerStream * next;
+
+  if (hdr.streamid != 0) {
+    return HTTP2_ERROR_PROTOCOL_ERROR;
+  }
+  if (hdr.length < HTTP2_GOAWAY_LEN) {
+    return HTTP2_ERROR_FRAME_SIZE_ERROR;
+  }
+
+  last_stream_id = http2_read_u32(payload) & 0x7fffffff;
+  DebugHttp2("origin sent GOAWAY with last stream %u and error %u", last_stream_id, http2_read_u32(payload + 4));
+
+  goaway_received = true;
+  unlist();
+
+  for (Http2ServerStream * stream = streams.head; stream; stream = next) {
+    next = stream->link.next;
+    if (stream->id == 0 || stream->id > last_stream_id) {
+      close_stream(stream);
+    }
+  }
+
+  if (nstreams == 0) {
+    connection_error(HTTP2_ERROR_NO_ERROR);
+  }
+
+  return HTTP2_ERROR_NO_ERROR;
+}
+
+Http2ServerStream *
+Http2ServerSession::find_stream(uint32_t id) const
+{
+  for (Http2ServerStream * stream = streams.head; stream; stream = stream->link.next) {
+    if (stream->id == id) {
+      return stream;
+    }
+  }
+
+  return NULL;
+}
+
+void
+Http2ServerSession::close_stream(Http2ServerStream * stream)
+{
+  DebugHttp2("stream %u closed", stream->id);
+
+  streams.remove(stream);
+  if (--nstreams == 0 && !closing) {
+    server_vc->set_inactivity_timeout(HRTIME_SECONDS(Http2::no_activity_timeout_out));
+  }
+
+  if (stream->vc) {
+    stream->vc->do_io_close();
+  }
+  stream->request.destroy();
+  http_parser_clear(&stream->parser);
+  if (stream->request_buffer) {
+    free_MIOBuffer(stream->request_buffer);
+  }
+  free_MIOBuffer(stream->response_buffer);
+  stream->mutex.clear();
+  http2ServerStreamAllocator.free(stream);
+}
+
+void
+Http2ServerSession::reset_stream(Http2ServerStream * stream, Http2ErrorCode code)
+{
+  // Only a stream the origin knows of, and that is not already closed at both ends.
+  if (stream->id && !(stream->end_stream_sent && stream->response_done) && !closing) {
+    write_rst_stream(stream->id, code);
+  }
+  close_stream(stream);
+}
+
+// The whole response is in the buffer. The stream is closed once the state machine has it, or
+// now if it already does: closing our end any earlier would lose what it has not read.
+void
+Http2ServerSession::finish_response(Http2ServerStream * stream)
+{
+  stream->response_done = true;
+
+  if (stream->response_reader->read_avail() == 0) {
+    if (stream->end_stream_sent) {
+      close_stream(stream);
+    } else {
+      reset_stream(stream, HTTP2_ERROR_NO_ERROR);
+    }
+    return;
+  }
+
+  stream->response_vio->nbytes = stream->response_vio->ndone + stream->response_reader->read_avail();
+  stream->response_vio->reenable();
+}
+
+void
+Http2ServerSession::send_request(Http2ServerStream * stream)
+{
+  if (!stream->headers_sent) {
+    int bytes_used;
+    MIMEParseResult result = stream->request.parse_req(&stream->parser, stream->request_reader, &bytes_used, false);
+
+    if (result == PARSE_CONT) {
+      stream->request_vio->reenable();
+      return;
+    }
+
+    if (result != PARSE_DONE) {
+      DebugHttp2("stream has no valid request header");
+      reset_stream(stream, HTTP2_ERROR_INTERNAL_ERROR);
+      return;
+    }
+
+    // The state machine only sends us requests whose body has a known length.
+    stream->body_left = stream->request.get_content_length();
+    if (stream->body_left < 0) {
+      stream->body_left = 0;
+    }
+
+    if (!send_headers(stream)) {
+      return;
+    }
+  }
+
+  send_data(stream);
+}
+
+bool
+Http2ServerSession::send_headers(Http2ServerStream * stream)
+{
+  int64_t bound = http2_request_header_bound(&stream->request);
+  uint8_t * block = (uint8_t *)ats_malloc(bound);
+  int64_t len = http2_encode_request_header(encoder, &stream->request, block, block + bound);
+  uint8_t type = HTTP2_FRAME_TYPE_HEADERS;
+  uint8_t flags = 0;
+  int64_t sent = 0;
+
+  if (len < 0) {
+    // The encoder state no longer matches what the origin saw.
+    ats_free(block);
+    connection_error(HTTP2_ERROR_INTERNAL_ERROR);
+    return false;
+  }
+
+  // Identifiers go out in increasing order, so they are only taken when the header is sent.
+  stream->id = next_stream_id;
+  next_stream_id += 2;
+
+  if (stream->body_left == 0) {
+    flags |= HTTP2_FLAGS_END_STREAM;
+    stream->end_stream_sent = true;
+  }
+
+  do {
+    uint32_t n = (uint32_t)((len - sent) < peer_max_frame_size ? (len - sent) : peer_max_frame_size);
+
+    if (sent + n == len) {
+      flags |= HTTP2_FLAGS_END_HEADERS;
+    }
+    write_frame(type, flags, stream->id, block + sent, n);
+    sent += n;
+    type = HTTP2_FRAME_TYPE_CONTINUATION;
+    flags = 0;
+  } while (sent < len);
+
+  ats_free(block);
+  stream->headers_sent = true;
+
+  DebugHttp2("stream %u sent request header in %" PRId64 " bytes", stream->id, len);
+  return true;
+}
+
+void
+Http2ServerSession::send_data(Http2ServerStream * stream)
+{
+  bool consumed = false;
+
+  while (!stream->end_stream_sent) {
+    int64_t avail = stream->request_reader->read_avail();
+    int64_t len;
+    uint8_t flags = 0;
+    uint8_t buf[HTTP2_FRAME_HEADER_LEN];
+    Http2FrameHeader hdr;
+
+    if (avail > stream->body_left) {
+      avail = stream->body_left;
+    }
+    len = avail;
+
+    if (avail == 0 || write_reader->read_avail() >= HTTP2_WRITE_HIGH_WATER) {
+      break;
+    }
+
+    if (len > peer_max_frame_size) {
+      len = peer_max_frame_size;
+    }
+    if (len > send_window) {
+      len = send_window;
+    }
+    if (len > stream->send_window) {
+      len = stream->send_window;
+    }
+
+    // Blocked on flow control until a WINDOW_UPDATE.
+    if (len <= 0) {
+      break;
+    }
+
+    if (len == stream->body_left) {
+      flags |= HTTP2_FLAGS_END_STREAM;
+      stream->end_stream_sent = true;
+    }
+
+    hdr.length = len;
+    hdr.type = HTTP2_FRAME_TYPE_DATA;
+    hdr.flags = flags;
+    hdr.streamid = stream->id;
+    http2_write_frame_header(hdr, buf);
+    write_buffer->write(buf, sizeof(buf));
+    write_buffer->write(stream->request_reader, len);
+    stream->request_reader->consume(len);
+
+    stream->body_left -= len;
+    send_window -= len;
+    stream->send_window -= len;
+    consumed = true;
+  }
+
+  write_vio->reenable();
+  if (consumed && !stream->end_stream_sent) {
+    stream->request_vio->reenable();
+  }
+}
+
+void
+Http2ServerSession::resume_streams()
+{
+  Http2ServerStream * next;
+
+  for (Http2ServerStream * stream = streams.head; stream && !closing; stream = next) {
+    next = stream->link.next;
+    if (stream->headers_sent && !stream->end_stream_sent) {
+      send_data(stream);
+    }
+  }
+
+  // Whoever went first this time goes last next time.
+  if (!closing && nstreams > 1) {
+    Http2ServerStream * first = streams.pop();
+    streams.enqueue(first);
+  }
+}
+
+// Give the origin back the window for response body the state machine has taken off our hands.
+void
+Http2ServerSession::update_response_window(Http2ServerStream * stream)
+{
+  int64_t drained;
+
+  if (stream->response_done || !stream->response_started) {
+    return;
+  }
+
+  drained = (int64_t)Http2::initial_window_size_out - stream->recv_window - stream->response_reader->read_avail();
+  if (drained >= (int64_t)Http2::initial_window_size_out / 2) {
+    write_window_update(stream->id, (uint32_t)drained);
+    stream->recv_window += drained;
+  }
+}
+
+void
+Http2ServerSession::write_frame(uint8_t type, uint8_t flags, uint32_t streamid, const uint8_t * payload, uint32_t len)
+{
+  uint8_t buf[HTTP2_FRAME_HEADER_LEN];
+  Http2FrameHeader hdr;
+
+  hdr.length = len;
+  hdr.type = type;
+  hdr.flags = flags;
+  hdr.streamid = streamid;
+  http2_write_frame_header(hdr, buf);
+
+  write_buffer->write(buf, sizeof(buf));
+  if (len) {
+    write_buffer->write(payload, len);
+  }
+
+  write_vio->reenable();
+}
+
+void
+Http2ServerSession::write_settings()
+{
+  uint8_t payload[2 * HTTP2_SETTINGS_PARAMETER_LEN];
+
+  payload[0] = 0;
+  payload[1] = HTTP2_SETTINGS_ENABLE_PUSH;
+  http2_write_u32(0, payload + 2);
+  payload[6] = 0;
+  payload[7] = HTTP2_SETTINGS_INITIAL_WINDOW_SIZE;
+  http2_write_u32(Http2::initial_window_size_out, payload + 8);
+
+  write_frame(HTTP2_FRAME_TYPE_SETTINGS, 0, 0, payload, sizeof(payload));
+}
+
+void
+Http2ServerSession::write_rst_stream(uint32_t streamid, Http2ErrorCode code)
+{
+  uint8_t payload[HTTP2_RST_STREAM_LEN];
+
+  http2_write_u32(code, payload);
+  write_frame(HTTP2_FRAME_TYPE_RST_STREAM, 0, streamid, payload, sizeof(payload));
+}
+
+void
+Http2ServerSession::write_window_update(uint32_t streamid, uint32_t increment)
+{
+  uint8_t payload[HTTP2_WINDOW_UPDATE_LEN];
+
+  http2_write_u32(increment, payload);
+  write_frame(HTTP2_FRAME_TYPE_WINDOW_UPDATE, 0, streamid, payload, sizeof(payload));
+}
+
+void
+Http2ServerSession::write_goaway(Http2ErrorCode code)
+{
+  uint8_t payload[HTTP2_GOAWAY_LEN];
+
+  // The origin cannot open streams to us, so there is none it could retry.
+  http2_write_u32(0, payload);
+  http2_write_u32(code, payload + 4);
+  write_frame(HTTP2_FRAME_TYPE_GOAWAY, 0, 0, payload, sizeof(payload));
+}
+
+void
+Http2ServerSession::unlist()
+{
+  if (listed) {
+    httpSessionManager.remove_http2_session(this);
+  }
+}
+
+// Tell the origin why we are going away, drop every stream, and close once that is written.
+void
+Http2ServerSession::connection_error(Http2ErrorCode code)
+{
+  if (closing) {
+    return;
+  }
+
+  DebugHttp2("closing the connection with error %d", code);
+
+  unlist();
+  write_goaway(code);
+  closing = true;
+
+  while (streams.head) {
+    close_stream(streams.head);
+  }
+
+  server_vc->do_io_read(this, 0, NULL);
+  write_vio->nbytes = write_vio->ndone + write_reader->read_avail();
+  write_vio->reenable();
+}
+
+void
+Http2ServerSession::destroy()
+{
+  DebugHttp2("session destroy");
+
+  unlist();
+  closing = true;
+  while (streams.head) {
+    close_stream(streams.head);
+  }
+
+  server_vc->do_io_close();
+  server_vc = NULL;
+
+  free_MIOBuffer(read_buffer);
+  free_MIOBuffer(write_buffer);
+  ats_free(header_block);
+  encoder.clear();
+  decoder.clear();
+
+  mutex.clear();
+  http2ServerSessionAllocator.free(this);
+}
@@ -0,0 +1,166 @@
+/** @file
+
+  An HTTP/2 connection to an origin server and its streams.
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#ifndef __HTTP2_SERVER_SESSION_H__
+#define __HTTP2_SERVER_SESSION_H__
+
+#include "HTTP2.h"
+#include "PluginVC.h"
+
+class Http2ServerSession;
+
+// One transaction to the origin. The state machine is handed the active end of a direct PluginVC
+// in place of a connection, writes an HTTP/1.1 request to it and reads an HTTP/1.1 response from
+// it. We hold the passive end: the request goes out as HEADERS and DATA frames, and the response
+// frames come back as text, marked Connection: close so that the state machine never tries to
+// reuse the stream.
+class Http2ServerStream : public Continuation
+{
+public:
+  Http2ServerStream();
+
+  void init(Http2ServerSession * session);
+  int main_event_handler(int event, void * edata);
+
+  Http2ServerSession * session;
+  uint32_t id;           // 0 until the request header is sent
+
+  PluginVC * vc;
+  MIOBuffer * request_buffer;
+  IOBufferReader * request_reader;
+  VIO * request_vio;
+  MIOBuffer * response_buffer;
+  IOBufferReader * response_reader;
+  VIO * response_vio;
+
+  HTTPParser parser;
+  HTTPHdr request;
+  int64_t body_left;     // request body still to send
+
+  int64_t send_window;
+  int64_t recv_window;
+
+  bool headers_sent;
+  bool end_stream_sent;
+  bool response_started; // the final response header was written
+  bool response_done;    // END_STREAM received
+
+  LINK(Http2ServerStream, link);
+};
+
+class Http2ServerSession : public Continuation
+{
+public:
+  Http2ServerSession();
+
+  // Take over a new connection to an origin server that speaks HTTP/2, and send the preface.
+  void new_connection(NetVConnection * new_vc, sockaddr const * addr);
+
+  // Open a stream for a state machine and return the connection it should use, or NULL if the
+  // session takes no more streams. The caller holds our mutex.
+  NetVConnection * open_stream();
+  bool can_open_stream() const;
+
+  int stream_event(Http2ServerStream * stream, int event, void * edata);
+
+  IpEndpoint server_ip;
+  EThread * thread;      // the session is only shared on the thread of its connection
+  bool listed;           // in the session manager's list for that thread
+
+  LINK(Http2ServerSession, link);
+
+private:
+  int main_event_handler(int event, void * edata);
+
+  void process_input();
+  Http2ErrorCode process_frame(const Http2FrameHeader & hdr);
+  Http2ErrorCode process_data(const Http2FrameHeader & hdr);
+  Http2ErrorCode process_headers(const Http2FrameHeader & hdr, const uint8_t * payload);
+  Http2ErrorCode process_continuation(const Http2FrameHeader & hdr, const uint8_t * payload);
+  Http2ErrorCode process_settings(const Http2FrameHeader & hdr, const uint8_t * payload);
+  Http2ErrorCode process_window_update(const Http2FrameHeader & hdr, const uint8_t * payload);
+  Http2ErrorCode process_goaway(const Http2FrameHeader & hdr, const uint8_t * payload);
+  Http2ErrorCode process_header_block();
+
+  Http2ServerStream * find_stream(uint32_t id) const;
+  void accept_stream(Http2ServerStream * stream, PluginVC * vc);
+  void close_stream(Http2ServerStream * stream);
+  void reset_stream(Http2ServerStream * stream, Http2ErrorCode code);
+  void finish_response(Http2ServerStream * stream);
+
+  void send_request(Http2ServerStream * stream);
+  bool send_headers(Http2ServerStream * stream);
+  void send_data(Http2ServerStream * stream);
+  void resume_streams();
+  void update_response_window(Http2ServerStream * stream);
+
+  void write_frame(uint8_t type, uint8_t flags, uint32_t streamid, const uint8_t * payload, uint32_t len);
+  void write_settings();
+  void write_rst_stream(uint32_t streamid, Http2ErrorCode code);
+  void write_window_update(uint32_t streamid, uint32_t increment);
+  void write_goaway(Http2ErrorCode code);
+
+  void unlist();
+  void connection_error(Http2ErrorCode code);
+  void destroy();
+
+  int64_t con_id;
+  NetVConnection * server_vc;
+
+  MIOBuffer * read_buffer;
+  IOBufferReader * read_reader;
+  VIO * read_vio;
+  MIOBuffer * write_buffer;
+  IOBufferReader * write_reader;
+  VIO * write_vio;
+
+  HpackEncoder encoder;
+  HpackDecoder decoder;
+
+  Queue<Http2ServerStream> streams;
+  uint32_t nstreams;
+  uint32_t next_stream_id;
+
+  // Flow control windows for the whole connection, and what the origin asked for.
+  int64_t send_window;
+  int64_t recv_window;
+  uint32_t peer_initial_window;
+  uint32_t peer_max_frame_size;
+  uint32_t peer_max_streams;
+
+  // A header block spread over HEADERS and CONTINUATION frames.
+  uint8_t * header_block;
+  uint32_t header_block_len;
+  uint32_t header_block_stream;
+  bool header_block_end_stream;
+
+  bool settings_received;
+  bool goaway_received;
+  bool closing;          // GOAWAY is on its way out, the connection goes once it is written
+  bool dead;             // destroy at the end of the current event
+};
+
+extern ClassAllocator<Http2ServerSession> http2ServerSessionAllocator;
+extern ClassAllocator<Http2ServerStream> http2ServerStreamAllocator;
+
+#endif /* __HTTP2_SERVER_SESSION_H__ */
@@ -0,0 +1,52 @@
+/** @file
+
+  Accept connections that negotiated HTTP/2.
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#include "Http2SessionAccept.h"
+#include "Http2ClientSession.h"
+#include "I_Net.h"
+#include "Error.h"
+
+Http2SessionAccept::Http2SessionAccept(Continuation * accept)
+  : Continuation(NULL), http_accept(accept)
+{
+  SET_HANDLER(&Http2SessionAccept::mainEvent);
+}
+
+Http2SessionAccept::~Http2SessionAccept()
+{
+}
+
+int
+Http2SessionAccept::mainEvent(int event, void * edata)
+{
+  if (event == NET_EVENT_ACCEPT) {
+    NetVConnection * netvc = static_cast<NetVConnection *>(edata);
+    Http2ClientSession * session = http2ClientSessionAllocator.alloc();
+
+    session->new_connection(netvc, http_accept);
+    return EVENT_CONT;
+  }
+
+  MachineFatal("HTTP/2 accept received fatal error: errno = %d", -((int)(intptr_t)edata));
+  return EVENT_CONT;
+}
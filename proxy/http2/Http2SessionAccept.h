@@ -0,0 +1,49 @@
+/** @file
+
+  Accept connections that negotiated HTTP/2.
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#ifndef __HTTP2_SESSION_ACCEPT_H__
+#define __HTTP2_SESSION_ACCEPT_H__
+
+#include "libts.h"
+#include "P_EventSystem.h"
+
+// The SSLNextProtocolAccept endpoint for "h2". Like the acceptor it is registered with, it is
+// created once per port and never freed.
+class Http2SessionAccept : public Continuation
+{
+public:
+  // Every stream of an accepted session is handed to http_accept, normally the HttpAccept of
+  // the same port, so that streams get that port's transport and outbound options.
+  explicit Http2SessionAccept(Continuation * http_accept);
+  ~Http2SessionAccept();
+
+private:
+  int mainEvent(int event, void * netvc);
+
+  Continuation * http_accept;
+
+  Http2SessionAccept(const Http2SessionAccept &); // disabled
+  Http2SessionAccept & operator =(const Http2SessionAccept &); // disabled
+};
+
+#endif /* __HTTP2_SESSION_ACCEPT_H__ */
@@ -86,11 +86,114 @@ static const char *USAGE_LINE = "Usage: " PROGRAM_NAME " [-o output-file | -a] [
 
 
 
+// Read exactly len bytes, allowing for "partial" reads
+static int
+read_fully(int in_fd, char *buf, int len)
+{
+  int nread = 0;
+
+  while (nread < len) {
+    int rc = read(in_fd, buf + nread, len - nread);
+
+    if ((rc == EOF) && (!follow_flag)) {
+      fprintf(stderr, "Bad LogBuffer read!\n");
+      return 1;
+    }
+
+    if (rc > 0)
+      nread += rc;
+  }
+  return 0;
+}
+
+// Read the rest of a compressed frame whose first two words are already
+// in buffer, and inflate it over buffer.  Returns the inflated size, 0 at
+// the end of a followed file, or -1 on a bad frame.
+static int
+read_compressed_frame(int in_fd, char *buffer, int buffer_len, unsigned first_read_size)
+{
+  char zbuffer[MAX_LOGBUFFER_SIZE + MAX_LOGBUFFER_SIZE / 8 + 64];
+  LogBufferFrameHeader frame;
+  int nread;
+
+  memcpy(&frame, buffer, first_read_size);
+  nread = read(in_fd, (char *)&frame + first_read_size, sizeof(frame) - first_read_size);
+  if (!nread || nread == EOF) {
+    if (follow_flag)
+      return 0;
+
+    fprintf(stderr, "Bad LogBuffer frame read!\n");
+    return -1;
+  }
+
+  if (frame.byte_count > sizeof(zbuffer)) {
+    fprintf(stderr, "Compressed buffer too large!\n");
+    return -1;
+  }
+
+  if (read_fully(in_fd, zbuffer, frame.byte_count))
+    return -1;
+
+  nread = LogBuffer::uncompress(&frame, zbuffer, buffer, buffer_len);
+  if (nread < 0)
+    fprintf(stderr, "Bad compressed LogBuffer!\n");
+  return nread;
+}
+
+// Read the rest of an uncompressed buffer whose first two words are
+// already in buffer.  Same return convention as read_compressed_frame().
+static int
+read_buffer(int in_fd, char *buffer, int buffer_len, unsigned first_read_size)
+{
+  unsigned header_size = sizeof(LogBufferHeader);
+  LogBufferHeader *header = (LogBufferHeader *) & buffer[0];
+  int nread, buffer_bytes;
+
+  // ensure that this is a valid logbuffer header
+  //
+  if (header->cookie != LOG_SEGMENT_COOKIE) {
+    fprintf(stderr, "Bad LogBuffer!\n");
+    return -1;
+  }
+  // read the rest of the header
+  //
+  unsigned second_read_size = header_size - first_read_size;
+
+  nread = read(in_fd, &buffer[first_read_size], second_read_size);
+  if (!nread || nread == EOF) {
+    if (follow_flag)
+      return 0;
+
+    fprintf(stderr, "Bad LogBufferHeader read!\n");
+    return -1;
+  }
+  // read the rest of the buffer
+  //
+  uint32_t byte_count = header->byte_count;
+
+  if (byte_count > (uint32_t)buffer_len) {
+    fprintf(stderr, "Buffer too large!\n");
+    return -1;
+  }
+  buffer_bytes = byte_count - header_size;
+  if (buffer_bytes == 0)
+    return 0;
+  if (buffer_bytes < 0) {
+    fprintf(stderr, "No buffer body!\n");
+    return -1;
+  }
+  // Read the next full buffer (allowing for "partial" reads)
+  if (read_fully(in_fd, &buffer[header_size], buffer_bytes))
+    return -1;
+
+  return byte_count;
+}
+
 static int
 process_file(int in_fd, int out_fd)
 {
   char buffer[MAX_LOGBUFFER_SIZE];
-  int nread, buffer_bytes;
+  int nread;
   unsigned bytes = 0;
 
   while (true) {
@@ -103,64 +206,22 @@ process_file(int in_fd, int out_fd)
     // cookie and the version number.
     //
     unsigned first_read_size = sizeof(uint32_t) + sizeof(uint32_t);
-    unsigned header_size = sizeof(LogBufferHeader);
     LogBufferHeader *header = (LogBufferHeader *) & buffer[0];
 
     nread = read(in_fd, buffer, first_read_size);
     if (!nread || nread == EOF)
       return 0;
 
-    // ensure that this is a valid logbuffer header
+    // a compressed frame holds the whole buffer, header included
     //
-    if (header->cookie != LOG_SEGMENT_COOKIE) {
-      fprintf(stderr, "Bad LogBuffer!\n");
-      return 1;
-    }
-    // read the rest of the header
-    //
-    unsigned second_read_size = header_size - first_read_size;
-
-    nread = read(in_fd, &buffer[first_read_size], second_read_size);
-    if (!nread || nread == EOF) {
-      if (follow_flag)
-        return 0;
-
-      fprintf(stderr, "Bad LogBufferHeader read!\n");
-      return 1;
-    }
-    // read the rest of the buffer
-    //
-    uint32_t byte_count = header->byte_count;
-
-    if (byte_count > sizeof(buffer)) {
-      fprintf(stderr, "Buffer too large!\n");
-      return 1;
-    }
-    buffer_bytes = byte_count - header_size;
-    if (buffer_bytes == 0)
-      return 0;
-    if (buffer_bytes < 0) {
-      fprintf(stderr, "No buffer body!\n");
-      return 1;
-    }
-    // Read the next full buffer (allowing for "partial" reads)
-    nread = 0;
-    while (nread < buffer_bytes) {
-      int rc = read(in_fd, &buffer[header_size] + nread, buffer_bytes - nread);
-
-      if ((rc == EOF) && (!follow_flag)) {
-        fprintf(stderr, "Bad LogBuffer read!\n");
-        return 1;
-      }
-
-      if (rc > 0)
-        nread += rc;
+    if (header->cookie == LOG_SEGMENT_COMPRESSED_COOKIE) {
+      nread = read_compressed_frame(in_fd, buffer, sizeof(buffer), first_read_size);
+    } else {
+      nread = read_buffer(in_fd, buffer, sizeof(buffer), first_read_size);
     }
+    if (nread <= 0)
+      return nread < 0 ? 1 : 0;
 
-    if (nread > buffer_bytes) {
-      fprintf(stderr, "Read too many bytes!\n");
-      return 1;
-    }
     // see if there is an alternate format request from the command
     // line
     //
@@ -78,6 +78,7 @@ size_t Log::maxInactiveObjects;
 
 // Flush thread stuff
 EventNotify *Log::preproc_notify;
+int Log::n_flush_threads = 1;
 EventNotify *Log::flush_notify;
 InkAtomicList *Log::flush_data_list;
 
@@ -895,6 +896,20 @@ Log::init_fields()
   global_field_list.add(field, false);
   ink_hash_table_insert(field_symbol_hash, "tts", field);
 
+  field = NEW(new LogField("plugin_hook_time", "phtu",
+                           LogField::sINT,
+                           &LogAccess::marshal_plugin_hook_time,
+                           &LogAccess::unmarshal_int_to_str));
+  global_field_list.add(field, false);
+  ink_hash_table_insert(field_symbol_hash, "phtu", field);
+
+  field = NEW(new LogField("plugin_slowest_name", "phsn",
+                           LogField::STRING,
+                           &LogAccess::marshal_plugin_slowest_name,
+                           &LogAccess::unmarshal_str));
+  global_field_list.add(field, false);
+  ink_hash_table_insert(field_symbol_hash, "phsn", field);
+
   field = NEW(new LogField("file_size", "fsiz",
                            LogField::sINT,
                            &LogAccess::marshal_file_size,
@@ -962,6 +977,7 @@ Log::init(int flags)
     config->read_configuration_variables();
     collation_port = config->collation_port;
     collation_preproc_threads = config->collation_preproc_threads;
+    n_flush_threads = config->flush_threads;
 
     if (config_flags & STANDALONE_COLLATOR) {
       logging_mode = LOG_TRANSACTIONS_ONLY;
@@ -994,7 +1010,7 @@ Log::init(int flags)
     create_threads();
 
 #ifndef INK_SINGLE_THREADED
-    eventProcessor.schedule_every(NEW (new PeriodicWakeup(collation_preproc_threads, 1)),
+    eventProcessor.schedule_every(NEW (new PeriodicWakeup(collation_preproc_threads, n_flush_threads)),
                                   HRTIME_SECOND, ET_CALL);
 #endif
     init_status |= PERIODIC_WAKEUP_SCHEDULED;
@@ -1087,18 +1103,19 @@ Log::create_threads()
       eventProcessor.spawn_thread(preproc_cont, desc, stacksize);
     }
 
-    // Now, only one flush thread is supported.
-    // TODO: Enable multiple flush threads, such as
-    //       one flush thread per file.
+    // start the flush threads; each log file is written by only one
+    // of them (see LogFile::m_flush_idx)
     //
-    flush_notify = new EventNotify;
-    flush_data_list = new InkAtomicList;
-
-    sprintf(desc, "Logging flush buffer list");
-    ink_atomiclist_init(flush_data_list, desc, 0);
-    Continuation *flush_cont = NEW(new LoggingFlushContinuation(0));
-    sprintf(desc, "[LOG_FLUSH]");
-    eventProcessor.spawn_thread(flush_cont, desc, stacksize);
+    flush_notify = new EventNotify[n_flush_threads];
+    flush_data_list = new InkAtomicList[n_flush_threads];
+
+    for (int i = 0; i < n_flush_threads; i++) {
+      sprintf(desc, "Logging flush buffer list %d", i);
+      ink_atomiclist_init(&flush_data_list[i], ats_strdup(desc), 0);
+      Continuation *flush_cont = NEW(new LoggingFlushContinuation(i));
+      sprintf(desc, "[LOG_FLUSH %d]", i);
+      eventProcessor.spawn_thread(flush_cont, desc, stacksize);
+    }
 
 #if !defined(IOCORE_LOG_COLLATION)
     // start the collation thread if we are not using iocore log collation
@@ -1316,10 +1333,29 @@ Log::preproc_thread_main(void *args)
   return NULL;
 }
 
+/*-------------------------------------------------------------------------
+  Log::add_to_flush_queue
+
+  Hand a buffer that is ready to be written to the flush thread of its
+  log file.
+  -------------------------------------------------------------------------*/
+
+void
+Log::add_to_flush_queue(LogFlushData * fdata)
+{
+  int idx = fdata->m_logfile->m_flush_idx;
+
+  fdata->m_enqueue_time = ink_get_hrtime();
+  RecIncrRawStatSum(log_rsb, this_thread()->mutex->thread_holding, log_stat_flush_queue_depth_stat, 1);
+  ink_atomiclist_push(&flush_data_list[idx], fdata);
+  flush_notify[idx].signal();
+}
+
 void *
-Log::flush_thread_main(void * /* args ATS_UNUSED */)
+Log::flush_thread_main(void *args)
 {
-  char *buf;
+  int idx = *(int *)args;
+  char *buf, *frame;
   LogFile *logfile;
   LogBuffer *logbuffer;
   LogFlushData *fdata;
@@ -1328,10 +1364,12 @@ Log::flush_thread_main(void * /* args ATS_UNUSED */)
   SLL<LogFlushData, LogFlushData::Link_link> link, invert_link;
   ProxyMutex *mutex = this_thread()->mutex;
 
-  Log::flush_notify->lock();
+  Debug("log-flush", "log flush thread %d is alive ...", idx);
+
+  Log::flush_notify[idx].lock();
 
   while (true) {
-    fdata = (LogFlushData *) ink_atomiclist_popall(flush_data_list);
+    fdata = (LogFlushData *) ink_atomiclist_popall(&flush_data_list[idx]);
 
     // invert the list
     //
@@ -1343,10 +1381,13 @@ Log::flush_thread_main(void * /* args ATS_UNUSED */)
     //
     while ((fdata = invert_link.pop())) {
       buf = NULL;
+      frame = NULL;
       total_bytes = 0;
       bytes_written = 0;
       logfile = fdata->m_logfile;
 
+      RecIncrRawStatSum(log_rsb, mutex->thread_holding, log_stat_flush_queue_depth_stat, -1);
+
       if (logfile->m_file_format == BINARY_LOG) {
 
         logbuffer = (LogBuffer *)fdata->m_data;
@@ -1355,6 +1396,14 @@ Log::flush_thread_main(void * /* args ATS_UNUSED */)
         buf = (char *)buffer_header;
         total_bytes = buffer_header->byte_count;
 
+        // compress here rather than in the preproc threads so that the
+        // CPU cost stays off the paths that hand buffers out to writers
+        if (Log::config->binary_compression_level > 0) {
+          frame = LogBuffer::compress(buffer_header, Log::config->binary_compression_level, &total_bytes);
+          if (frame)
+            buf = frame;
+        }
+
       } else if (logfile->m_file_format == ASCII_LOG
                  || logfile->m_file_format == ASCII_PIPE){
 
@@ -1366,14 +1415,17 @@ Log::flush_thread_main(void * /* args ATS_UNUSED */)
       }
 
       // make sure we're open & ready to write
+      ink_mutex_acquire(&logfile->m_fd_mutex);
       logfile->check_fd();
       if (!logfile->is_open()) {
+        ink_mutex_release(&logfile->m_fd_mutex);
         Warning("File:%s was closed, have dropped (%d) bytes.",
                 logfile->m_name, total_bytes);
 
         RecIncrRawStat(log_rsb, mutex->thread_holding,
                        log_stat_bytes_lost_before_written_to_disk_stat,
                        total_bytes);
+        ats_free(frame);
         delete fdata;
         continue;
       }
@@ -1405,19 +1457,24 @@ Log::flush_thread_main(void * /* args ATS_UNUSED */)
         }
         bytes_written += len;
       }
+      ink_mutex_release(&logfile->m_fd_mutex);
 
       RecIncrRawStat(log_rsb, mutex->thread_holding,
                      log_stat_bytes_written_to_disk_stat, bytes_written);
+      RecIncrRawStat(log_rsb, mutex->thread_holding,
+                     log_stat_flush_latency_stat, ink_get_hrtime() - fdata->m_enqueue_time);
 
       ink_atomic_increment(&logfile->m_bytes_written, bytes_written);
 
+      ats_free(frame);
       delete fdata;
     }
 
-    // Time to work on periodic events??
+    // Time to work on periodic events??  Only the first flush thread
+    // runs them.
     //
     now = ink_get_hrtime() / HRTIME_SECOND;
-    if (now > last_time) {
+    if (idx == 0 && now > last_time) {
       if ((now % (PERIODIC_TASKS_INTERVAL)) == 0) {
         Debug("log-preproc", "periodic tasks for %" PRId64, (int64_t)now);
         periodic_tasks(now);
@@ -1429,11 +1486,11 @@ Log::flush_thread_main(void * /* args ATS_UNUSED */)
     // check the queue and find there is nothing to do, then wait
     // again.
     //
-    Log::flush_notify->wait();
+    Log::flush_notify[idx].wait();
   }
 
   /* NOTREACHED */
-  Log::flush_notify->unlock();
+  Log::flush_notify[idx].unlock();
   return NULL;
 }
 
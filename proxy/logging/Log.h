@@ -320,9 +320,10 @@ public:
   LogBuffer *logbuffer;
   void *m_data;
   int m_len;
+  ink_hrtime m_enqueue_time;
 
   LogFlushData(LogFile *logfile, void *data, int len = -1):
-    m_logfile(logfile), m_data(data), m_len(len)
+    m_logfile(logfile), m_data(data), m_len(len), m_enqueue_time(0)
   {
   }
 
@@ -423,8 +424,10 @@ public:
   // logging thread stuff
   static EventNotify *preproc_notify;
   static void *preproc_thread_main(void *args);
+  static int n_flush_threads;
   static EventNotify *flush_notify;
   static InkAtomicList *flush_data_list;
+  static void add_to_flush_queue(LogFlushData * fdata);
   static void *flush_thread_main(void *args);
 
   // collation thread stuff
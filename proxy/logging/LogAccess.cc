@@ -532,6 +532,30 @@ LogAccess::marshal_transfer_time_s(char *buf)
   DEFAULT_INT_FIELD;
 }
 
+int
+LogAccess::marshal_milestone_diff(int /* ms1 ATS_UNUSED */, int /* ms2 ATS_UNUSED */, char *buf)
+{
+  DEFAULT_INT_FIELD;
+}
+
+/*-------------------------------------------------------------------------
+  -------------------------------------------------------------------------*/
+
+int
+LogAccess::marshal_plugin_hook_time(char *buf)
+{
+  DEFAULT_INT_FIELD;
+}
+
+/*-------------------------------------------------------------------------
+  -------------------------------------------------------------------------*/
+
+int
+LogAccess::marshal_plugin_slowest_name(char *buf)
+{
+  DEFAULT_STR_FIELD;
+}
+
 /*-------------------------------------------------------------------------
   -------------------------------------------------------------------------*/
 
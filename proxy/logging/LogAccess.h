@@ -248,6 +248,13 @@ public:
   inkcoreapi virtual int marshal_file_size(char *);     // INT
   int marshal_entry_type(char *);       // INT
 
+  // milliseconds between two transaction milestones
+  inkcoreapi virtual int marshal_milestone_diff(int ms1, int ms2, char *buf);   // INT
+
+  // time spent inside plugin calls
+  inkcoreapi virtual int marshal_plugin_hook_time(char *);      // INT
+  inkcoreapi virtual int marshal_plugin_slowest_name(char *);   // STR
+
 
   // named fields from within a http header
   //
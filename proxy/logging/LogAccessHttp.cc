@@ -975,6 +975,60 @@ LogAccessHttp::marshal_transfer_time_s(char *buf)
   return INK_MIN_ALIGN;
 }
 
+/*-------------------------------------------------------------------------
+  The first milestone less the second, or less the start of the
+  transaction when there is no second. -1 when the transaction did not
+  reach one of them.
+  -------------------------------------------------------------------------*/
+
+int
+LogAccessHttp::marshal_milestone_diff(int ms1, int ms2, char *buf)
+{
+  if (buf) {
+    int64_t val = -1;
+
+    if (ms1 >= 0) {
+      ink_hrtime t1 = m_http_sm->milestone_get((TSMilestonesType) ms1);
+      ink_hrtime t2 = (ms2 >= 0) ? m_http_sm->milestone_get((TSMilestonesType) ms2) : m_http_sm->milestones.sm_start;
+
+      if (ms1 == TS_MILESTONE_PLUGIN_TOTAL && ms2 < 0) {
+        val = t1 / HRTIME_MSECOND;      // already a duration
+      } else if (t1 && t2) {
+        val = (t1 - t2) / HRTIME_MSECOND;
+      }
+    }
+    marshal_int(buf, val);
+  }
+  return INK_MIN_ALIGN;
+}
+
+/*-------------------------------------------------------------------------
+  Microseconds the transaction spent inside plugin hook and remap calls.
+  -------------------------------------------------------------------------*/
+
+int
+LogAccessHttp::marshal_plugin_hook_time(char *buf)
+{
+  if (buf) {
+    int64_t val = m_http_sm->plugin_hook_time / HRTIME_USECOND;
+    marshal_int(buf, val);
+  }
+  return INK_MIN_ALIGN;
+}
+
+int
+LogAccessHttp::marshal_plugin_slowest_name(char *buf)
+{
+  char const *str = m_http_sm->plugin_slowest ? m_http_sm->plugin_slowest->name : NULL;
+  int actual_len = str ? strlen(str) : 0;
+  int padded_len = str ? round_strlen(actual_len + 1) : INK_MIN_ALIGN;
+
+  if (buf) {
+    marshal_mem(buf, str, actual_len, padded_len);
+  }
+  return padded_len;
+}
+
 /*-------------------------------------------------------------------------
   -------------------------------------------------------------------------*/
 
@@ -126,6 +126,9 @@ public:
   //
   virtual int marshal_transfer_time_ms(char *); // INT
   virtual int marshal_transfer_time_s(char *);  // INT
+  virtual int marshal_milestone_diff(int ms1, int ms2, char *buf);      // INT
+  virtual int marshal_plugin_hook_time(char *); // INT
+  virtual int marshal_plugin_slowest_name(char *);      // STR
 
   //
   // named fields from within a http header
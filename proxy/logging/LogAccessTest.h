@@ -45,6 +45,11 @@ public:
   {
   }
 
+  LogEntryType entry_type()
+  {
+    return LOG_ENTRY_HTTP;
+  }
+
   //
   // client -> proxy fields
   //
@@ -46,6 +46,10 @@
 #include "LogFormatType.h"
 #include "Log.h"
 
+#if TS_HAS_LIBZ
+#include <zlib.h>
+#endif
+
 
 struct FieldListCacheElement
 {
@@ -137,6 +141,8 @@ LogBuffer::LogBuffer(LogObject * owner, size_t size, size_t buf_align, size_t wr
   //
   m_unaligned_buffer = NEW (new char [size + buf_align]);
   m_buffer = (char *)align_pointer_forward(m_unaligned_buffer, buf_align);
+  if (log_rsb)
+    RecIncrGlobalRawStatSum(log_rsb, log_stat_buffer_bytes_stat, size + buf_align);
 
   // add the header
   hdr_size = _add_buffer_header();
@@ -178,6 +184,8 @@ LogBuffer::~LogBuffer()
 {
   if (m_unaligned_buffer) {
     delete [] m_unaligned_buffer;
+    if (log_rsb)
+      RecIncrGlobalRawStatSum(log_rsb, log_stat_buffer_bytes_stat, -(int64_t)(m_size + m_buf_align));
   } else {
     delete [] m_buffer;
   }
@@ -438,6 +446,71 @@ size_t LogBuffer::max_entry_bytes()
   return (Log::config->log_buffer_size - sizeof(LogBufferHeader));
 }
 
+/*-------------------------------------------------------------------------
+  LogBuffer::compress
+
+  Deflate the buffer behind the given header into a newly allocated frame
+  (LogBufferFrameHeader plus payload) and return it, or NULL if the data
+  could not be compressed, in which case the caller should write the
+  buffer as is.  The frame must be released with ats_free().
+  -------------------------------------------------------------------------*/
+char *
+LogBuffer::compress(LogBufferHeader * header, int level, int *frame_bytes)
+{
+#if TS_HAS_LIBZ
+  uLongf len = compressBound(header->byte_count);
+  char *frame = (char *)ats_malloc(sizeof(LogBufferFrameHeader) + len);
+
+  if (compress2((Bytef *)(frame + sizeof(LogBufferFrameHeader)), &len,
+                (const Bytef *)header, header->byte_count, level) != Z_OK) {
+    ats_free(frame);
+    return NULL;
+  }
+
+  LogBufferFrameHeader *fh = (LogBufferFrameHeader *)frame;
+  fh->cookie = LOG_SEGMENT_COMPRESSED_COOKIE;
+  fh->version = header->version;
+  fh->byte_count = (uint32_t)len;
+  fh->raw_byte_count = header->byte_count;
+
+  *frame_bytes = (int)(sizeof(LogBufferFrameHeader) + len);
+  return frame;
+#else
+  (void) header;
+  (void) level;
+  (void) frame_bytes;
+  return NULL;
+#endif
+}
+
+/*-------------------------------------------------------------------------
+  LogBuffer::uncompress
+
+  Inflate the payload of a compressed frame into buf, which then holds an
+  ordinary LogBuffer starting with its LogBufferHeader.  Returns the number
+  of bytes produced, or -1 if the frame is corrupt or does not fit.
+  -------------------------------------------------------------------------*/
+int
+LogBuffer::uncompress(LogBufferFrameHeader * frame, char *payload, char *buf, int buf_len)
+{
+#if TS_HAS_LIBZ
+  uLongf len = buf_len;
+
+  if (frame->raw_byte_count > (uint32_t)buf_len ||
+      ::uncompress((Bytef *)buf, &len, (const Bytef *)payload, frame->byte_count) != Z_OK ||
+      len != frame->raw_byte_count || len < sizeof(LogBufferHeader)) {
+    return -1;
+  }
+  return (int)len;
+#else
+  (void) frame;
+  (void) payload;
+  (void) buf;
+  (void) buf_len;
+  return -1;
+#endif
+}
+
 /*-------------------------------------------------------------------------
   LogBuffer::resolve_custom_entry
   -------------------------------------------------------------------------*/
@@ -35,6 +35,7 @@ class LogBufferIterator;
 
 #define LOG_SEGMENT_COOKIE 0xaceface
 #define LOG_SEGMENT_VERSION 2
+#define LOG_SEGMENT_COMPRESSED_COOKIE 0xacefade
 
 #if defined(linux)
 #define LB_DEFAULT_ALIGN 512
@@ -97,6 +98,24 @@ struct LogBufferHeader
   char *log_filename();
 };
 
+/*-------------------------------------------------------------------------
+  LogBufferFrameHeader
+
+  When binary log compression is enabled, each LogBuffer is deflated on
+  its own and written behind one of these instead of its LogBufferHeader.
+  The first two words line up with LogBufferHeader so readers can tell
+  the two apart from the cookie, and since every frame decodes without
+  its neighbours a reader can seek to any frame boundary.
+  -------------------------------------------------------------------------*/
+
+struct LogBufferFrameHeader
+{
+  uint32_t cookie;              // LOG_SEGMENT_COMPRESSED_COOKIE
+  uint32_t version;             // version of the framed LogBuffer
+  uint32_t byte_count;          // compressed bytes following this header
+  uint32_t raw_byte_count;      // byte_count of the framed LogBuffer
+};
+
 
 union LB_State
 {
@@ -188,6 +207,8 @@ public:
                                   int write_to_len, long timestamp, long timestamp_us,
                                   unsigned buffer_version, LogFieldList * alt_fieldlist = NULL,
                                   char *alt_printf_str = NULL);
+  static char *compress(LogBufferHeader * header, int level, int *frame_bytes);
+  static int uncompress(LogBufferFrameHeader * frame, char *payload, char *buf, int buf_len);
   static void destroy(LogBuffer *lb)
   {
     int result, old_ref, new_ref;
@@ -259,6 +280,11 @@ public:
   {
     return m_size;
   }
+  // for walking a list only its owner adds to and gets from
+  LogBuffer *first(void)
+  {
+    return m_buffer_list.head;
+  }
 };
 
 /*-------------------------------------------------------------------------
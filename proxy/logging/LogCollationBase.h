@@ -37,6 +37,16 @@ protected:
     int msg_bytes;              // length of the following message
   };
 
+  // What a client may ask for behind the secret (and a NUL) in its auth
+  // message. The host replies with a message holding the flags it grants;
+  // a client that asks for nothing gets no reply and sends one plain
+  // LogBuffer per message, as older hosts expect.
+  enum LogCollFlags
+  {
+    LOG_COLL_FLAG_BATCH = 1,    // several buffers per message
+    LOG_COLL_FLAG_COMPRESS = 2  // buffers may be sent as compressed frames
+  };
+
   enum LogCollEvent
   {
     LOG_COLL_EVENT_NULL = LOG_COLLATION_EVENT_EVENTS_START,
@@ -55,6 +55,11 @@
 
 int LogCollationClientSM::ID = 0;
 
+// How long to wait for the host to reply to the flags asked for; a host
+// that predates them never does, and gets plain buffers instead.
+#define LOG_COLL_REPLY_TIMEOUT_SEC 5
+#define LOG_COLL_REPLY_BYTES (int64_t)(sizeof(NetMsgHeader) + sizeof(uint32_t))
+
 //-------------------------------------------------------------------------
 // LogCollationClientSM::LogCollationClientSM
 //-------------------------------------------------------------------------
@@ -71,11 +76,15 @@ LogCollationClientSM::LogCollationClientSM(LogHost * log_host)
     m_pending_event(NULL),
     m_abort_vio(NULL),
     m_abort_buffer(NULL),
+    m_abort_reader(NULL),
+    m_requested_flags(0),
+    m_flags(0),
+    m_host_replied(false),
     m_buffer_send_list(NULL),
-    m_buffer_in_iocore(NULL),
+    m_buffers_in_iocore(NULL),
     m_flow(LOG_COLL_FLOW_ALLOW),
     m_log_host(log_host),
-    m_id(ID++)
+    m_id(ink_atomic_increment(&ID, 1))
 {
   Debug("log-coll", "[%d]client::constructor", m_id);
 
@@ -85,6 +94,7 @@ LogCollationClientSM::LogCollationClientSM(LogHost * log_host)
   // we can accept logs to send before we're fully initialized
   m_buffer_send_list = NEW(new LogBufferList());
   ink_assert(m_buffer_send_list != NULL);
+  m_buffers_in_iocore = NEW(new LogBufferList());
 
   SET_HANDLER((LogCollationClientSMHandler) & LogCollationClientSM::client_handler);
   client_init(LOG_COLL_EVENT_SWITCH, NULL);
@@ -237,13 +247,24 @@ LogCollationClientSM::client_auth(int event, VIO * /* vio ATS_UNUSED */)
       m_client_state = LOG_COLL_CLIENT_AUTH;
 
       NetMsgHeader nmh;
-      int bytes_to_send = (int) strlen(Log::config->collation_secret);
+      int secret_bytes = (int) strlen(Log::config->collation_secret);
+      int bytes_to_send = secret_bytes;
+
+      if (m_requested_flags) {
+        bytes_to_send += 1 + sizeof(uint32_t);
+      }
       nmh.msg_bytes = bytes_to_send;
 
       // memory copies, I know...  but it happens rarely!!!  ^_^
       ink_assert(m_auth_buffer != NULL);
       m_auth_buffer->write((char *) &nmh, sizeof(NetMsgHeader));
-      m_auth_buffer->write(Log::config->collation_secret, bytes_to_send);
+      m_auth_buffer->write(Log::config->collation_secret, secret_bytes);
+      if (m_requested_flags) {
+        uint32_t flags = m_requested_flags;
+
+        m_auth_buffer->write("", 1);
+        m_auth_buffer->write((char *) &flags, sizeof(flags));
+      }
       bytes_to_send += sizeof(NetMsgHeader);
 
       Debug("log-coll", "[%d]client::client_auth - do_io_write(%d)", m_id, bytes_to_send);
@@ -263,6 +284,50 @@ LogCollationClientSM::client_auth(int event, VIO * /* vio ATS_UNUSED */)
 
     Note("[log-coll] host up [%s:%u]", m_log_host->ip_addr().toString(ipb, sizeof(ipb)), m_log_host->port());
 
+    // wait for the host to grant the flags asked for
+    if (m_requested_flags && !m_host_replied) {
+      ink_assert(m_pending_event == NULL);
+      m_pending_event = eventProcessor.schedule_in(this, HRTIME_SECONDS(LOG_COLL_REPLY_TIMEOUT_SEC));
+      return EVENT_CONT;
+    }
+    return client_send(LOG_COLL_EVENT_SWITCH, NULL);
+
+  case VC_EVENT_READ_READY:
+  case VC_EVENT_READ_COMPLETE:
+    Debug("log-coll", "[%d]client::client_auth - READ_READY|READ_COMPLETE", m_id);
+    if (m_host_replied || m_abort_reader->read_avail() < LOG_COLL_REPLY_BYTES) {
+      return EVENT_CONT;
+    }
+    {
+      NetMsgHeader nmh;
+      uint32_t flags = 0;
+
+      m_abort_reader->read((char *) &nmh, sizeof(nmh));
+      m_abort_reader->read((char *) &flags, sizeof(flags));
+      m_flags = (nmh.msg_bytes == sizeof(flags)) ? (flags & m_requested_flags) : 0;
+      m_host_replied = true;
+      Debug("log-coll", "[%d]client::client_auth - host granted flags %d of %d", m_id, m_flags, m_requested_flags);
+    }
+    // from now on only watch for the host going away
+    m_abort_vio = m_host_vc->do_io_read(this, 1, m_abort_buffer);
+
+    // still writing the auth message
+    if (m_host_vio->ntodo() > 0) {
+      return EVENT_CONT;
+    }
+    if (m_pending_event) {
+      m_pending_event->cancel();
+      m_pending_event = NULL;
+    }
+    return client_send(LOG_COLL_EVENT_SWITCH, NULL);
+
+  case EVENT_INTERVAL:
+    Debug("log-coll", "[%d]client::client_auth - INTERVAL", m_id);
+    m_pending_event = NULL;
+    Note("[log-coll] host did not reply to batching/compression request, sending plain buffers [%s:%u]",
+         m_log_host->ip_addr().toString(ipb, sizeof(ipb)), m_log_host->port());
+    m_flags = 0;
+    m_abort_vio = m_host_vc->do_io_read(this, 1, m_abort_buffer);
     return client_send(LOG_COLL_EVENT_SWITCH, NULL);
 
   case VC_EVENT_EOS:
@@ -275,6 +340,10 @@ LogCollationClientSM::client_auth(int event, VIO * /* vio ATS_UNUSED */)
         Debug("log-coll", "[%d]client::client_auth - consuming unsent data", m_id);
         m_auth_reader->consume(read_avail);
       }
+      if (m_pending_event) {
+        m_pending_event->cancel();
+        m_pending_event = NULL;
+      }
 
       return client_fail(LOG_COLL_EVENT_SWITCH, NULL);
     }
@@ -370,11 +439,17 @@ LogCollationClientSM::client_done(int event, void * /* data ATS_UNUSED */)
       free_MIOBuffer(m_send_buffer);
     }
     if (m_abort_buffer) {
+      if (m_abort_reader) {
+        m_abort_buffer->dealloc_reader(m_abort_reader);
+      }
       free_MIOBuffer(m_abort_buffer);
     }
     if (m_buffer_send_list) {
       delete m_buffer_send_list;
     }
+    if (m_buffers_in_iocore) {
+      delete m_buffers_in_iocore;
+    }
 
     return EVENT_DONE;
 
@@ -499,6 +574,7 @@ LogCollationClientSM::client_init(int event, void * /* data ATS_UNUSED */)
     ink_assert(m_send_reader != NULL);
     m_abort_buffer = new_MIOBuffer();
     ink_assert(m_abort_buffer != NULL);
+    m_abort_reader = m_abort_buffer->alloc_reader();
 
     // if we don't have an ip already, switch to client_dns
     if (! m_log_host->ip_addr().isValid()) {
@@ -555,9 +631,23 @@ LogCollationClientSM::client_open(int event, NetVConnection * net_vc)
     ink_assert(net_vc != NULL);
     m_host_vc = net_vc;
 
+    // ask for batching and compression if they are configured, anew on
+    // each connection since the host may have changed
+    m_requested_flags = 0;
+    if (Log::config->collation_batch_buffers > 1) {
+      m_requested_flags |= LOG_COLL_FLAG_BATCH;
+    }
+    if (Log::config->collation_compression_level > 0) {
+      m_requested_flags |= LOG_COLL_FLAG_COMPRESS;
+    }
+    m_flags = 0;
+    m_host_replied = false;
+    m_abort_reader->consume(m_abort_reader->read_avail());
+
     // setup a client reader just for detecting a host disconnnect
-    // (iocore should call back this function with and EOS/ERROR)
-    m_abort_vio = m_host_vc->do_io_read(this, 1, m_abort_buffer);
+    // (iocore should call back this function with and EOS/ERROR),
+    // which first reads the host's reply if flags are asked for
+    m_abort_vio = m_host_vc->do_io_read(this, m_requested_flags ? LOG_COLL_REPLY_BYTES : 1, m_abort_buffer);
 
     // change states
     return client_auth(LOG_COLL_EVENT_SWITCH, NULL);
@@ -600,13 +690,22 @@ LogCollationClientSM::client_send(int event, VIO * /* vio ATS_UNUSED */)
       Debug("log-coll", "[%d]client::client_send - SWITCH", m_id);
       m_client_state = LOG_COLL_CLIENT_SEND;
 
-      // get a buffer off our queue
+      // get buffers off our queue, as many as the host takes in one message
+      int max_buffers = (m_flags & LOG_COLL_FLAG_BATCH) ? Log::config->collation_batch_buffers : 1;
+      int level = (m_flags & LOG_COLL_FLAG_COMPRESS) ? Log::config->collation_compression_level : 0;
+      int num_buffers = 0;
+      LogBuffer *log_buffer;
+
       ink_assert(m_buffer_send_list != NULL);
-      ink_assert(m_buffer_in_iocore == NULL);
-      if ((m_buffer_in_iocore = m_buffer_send_list->get()) == NULL) {
+      ink_assert(m_buffers_in_iocore->get_size() == 0);
+      while (num_buffers < max_buffers && (log_buffer = m_buffer_send_list->get()) != NULL) {
+        m_buffers_in_iocore->add(log_buffer);
+        num_buffers++;
+      }
+      if (num_buffers == 0) {
         return client_idle(LOG_COLL_EVENT_SWITCH, NULL);
       }
-      Debug("log-coll", "[%d]client::client_send - send_list to m_buffer_in_iocore", m_id);
+      Debug("log-coll", "[%d]client::client_send - %d from send_list to m_buffers_in_iocore", m_id, num_buffers);
       Debug("log-coll", "[%d]client::client_send - send_list_size(%d)", m_id, m_buffer_send_list->get_size());
 
       // enable m_flow if we're out of work to do
@@ -621,31 +720,56 @@ LogCollationClientSM::client_send(int event, VIO * /* vio ATS_UNUSED */)
       // do_io_write to save a memory copy.  But for now, just
       // write the lame way.
 
-#if defined(LOG_BUFFER_TRACKING)
-      Debug("log-buftrak", "[%d]client::client_send - network write begin", m_buffer_in_iocore->header()->id);
-#endif // defined(LOG_BUFFER_TRACKING)
-
-      // prepare to send data
-      ink_assert(m_buffer_in_iocore != NULL);
-      LogBufferHeader *log_buffer_header = m_buffer_in_iocore->header();
-      ink_assert(log_buffer_header != NULL);
+      // prepare to send data, compressing first since the message
+      // header goes in front of it
+      char **data = (char **)ats_malloc(num_buffers * sizeof(char *));
+      int *data_bytes = (int *)ats_malloc(num_buffers * sizeof(int));
       NetMsgHeader nmh;
-      int bytes_to_send = log_buffer_header->byte_count;
-      nmh.msg_bytes = bytes_to_send;
-      // TODO: We currently don't try to make the log buffers handle little vs big endian. TS-1156.
-      //m_buffer_in_iocore->convert_to_network_order();
+      int bytes_to_send = 0;
+      int i = 0;
+
+      nmh.msg_bytes = 0;
+      for (log_buffer = m_buffers_in_iocore->first(); log_buffer; log_buffer = log_buffer->link.next, i++) {
+        LogBufferHeader *log_buffer_header = log_buffer->header();
+        ink_assert(log_buffer_header != NULL);
 
-      RecIncrRawStat(log_rsb, mutex->thread_holding, log_stat_num_sent_to_network_stat,
-                     log_buffer_header->entry_count);
+#if defined(LOG_BUFFER_TRACKING)
+        Debug("log-buftrak", "[%d]client::client_send - network write begin", log_buffer_header->id);
+#endif // defined(LOG_BUFFER_TRACKING)
 
-      RecIncrRawStat(log_rsb, mutex->thread_holding, log_stat_bytes_sent_to_network_stat,
-                     log_buffer_header->byte_count);
+        // TODO: We currently don't try to make the log buffers handle little vs big endian. TS-1156.
+        //log_buffer->convert_to_network_order();
+        data[i] = NULL;
+        if (level > 0) {
+          data[i] = LogBuffer::compress(log_buffer_header, level, &data_bytes[i]);
+        }
+        if (data[i] == NULL) {
+          data_bytes[i] = log_buffer_header->byte_count;
+        }
+        nmh.msg_bytes += data_bytes[i];
+
+        RecIncrRawStat(log_rsb, mutex->thread_holding, log_stat_num_sent_to_network_stat,
+                       log_buffer_header->entry_count);
+
+        RecIncrRawStat(log_rsb, mutex->thread_holding, log_stat_bytes_sent_to_network_stat,
+                       log_buffer_header->byte_count);
+      }
 
       // copy into m_send_buffer
       ink_assert(m_send_buffer != NULL);
       m_send_buffer->write((char *) &nmh, sizeof(NetMsgHeader));
-      m_send_buffer->write((char *) log_buffer_header, bytes_to_send);
-      bytes_to_send += sizeof(NetMsgHeader);
+      i = 0;
+      for (log_buffer = m_buffers_in_iocore->first(); log_buffer; log_buffer = log_buffer->link.next, i++) {
+        if (data[i]) {
+          m_send_buffer->write(data[i], data_bytes[i]);
+          ats_free(data[i]);
+        } else {
+          m_send_buffer->write((char *) log_buffer->header(), data_bytes[i]);
+        }
+      }
+      ats_free(data);
+      ats_free(data_bytes);
+      bytes_to_send = nmh.msg_bytes + sizeof(NetMsgHeader);
 
       // send m_send_buffer to iocore
       Debug("log-coll", "[%d]client::client_send - do_io_write(%d)", m_id, bytes_to_send);
@@ -662,15 +786,19 @@ LogCollationClientSM::client_send(int event, VIO * /* vio ATS_UNUSED */)
   case VC_EVENT_WRITE_COMPLETE:
     Debug("log-coll", "[%d]client::client_send - WRITE_COMPLETE", m_id);
 
-    ink_assert(m_buffer_in_iocore != NULL);
+    ink_assert(m_buffers_in_iocore->get_size() > 0);
+    {
+      LogBuffer *log_buffer;
+
+      // done with the buffers, delete them
+      while ((log_buffer = m_buffers_in_iocore->get()) != NULL) {
 #if defined(LOG_BUFFER_TRACKING)
-    Debug("log-buftrak", "[%d]client::client_send - network write complete", m_buffer_in_iocore->header()->id);
+        Debug("log-buftrak", "[%d]client::client_send - network write complete", log_buffer->header()->id);
 #endif // defined(LOG_BUFFER_TRACKING)
-
-    // done with the buffer, delete it
-    Debug("log-coll", "[%d]client::client_send - m_buffer_in_iocore[%p] to delete_list", m_id, m_buffer_in_iocore);
-    LogBuffer::destroy(m_buffer_in_iocore);
-    m_buffer_in_iocore = NULL;
+        Debug("log-coll", "[%d]client::client_send - m_buffers_in_iocore[%p] to delete_list", m_id, log_buffer);
+        LogBuffer::destroy(log_buffer);
+      }
+    }
 
     // switch back to client_send
     return client_send(LOG_COLL_EVENT_SWITCH, NULL);
@@ -712,16 +840,16 @@ LogCollationClientSM::flush_to_orphan()
 {
   Debug("log-coll", "[%d]client::flush_to_orphan", m_id);
 
-  // if in middle of a write, flush buffer_in_iocore to orphan
-  if (m_buffer_in_iocore != NULL) {
-    Debug("log-coll", "[%d]client::flush_to_orphan - m_buffer_in_iocore to oprhan", m_id);
+  // if in middle of a write, flush buffers_in_iocore to orphan
+  LogBuffer *log_buffer;
+  ink_assert(m_buffers_in_iocore != NULL);
+  while ((log_buffer = m_buffers_in_iocore->get()) != NULL) {
+    Debug("log-coll", "[%d]client::flush_to_orphan - m_buffers_in_iocore to oprhan", m_id);
     // TODO: We currently don't try to make the log buffers handle little vs big endian. TS-1156.
-    // m_buffer_in_iocore->convert_to_host_order();
-    m_log_host->orphan_write_and_try_delete(m_buffer_in_iocore);
-    m_buffer_in_iocore = NULL;
+    // log_buffer->convert_to_host_order();
+    m_log_host->orphan_write_and_try_delete(log_buffer);
   }
   // flush buffers in send_list to orphan
-  LogBuffer *log_buffer;
   ink_assert(m_buffer_send_list != NULL);
   while ((log_buffer = m_buffer_send_list->get()) != NULL) {
     Debug("log-coll", "[%d]client::flush_to_orphan - send_list to orphan", m_id);
@@ -102,12 +102,19 @@ private:
   Event *m_pending_event;
 
   // to detect server closes (there's got to be a better way to do this)
+  // and to read the host's reply to the flags asked for
   VIO *m_abort_vio;
   MIOBuffer *m_abort_buffer;
+  IOBufferReader *m_abort_reader;
+
+  // LOG_COLL_FLAG_* asked for and granted on this connection
+  int m_requested_flags;
+  int m_flags;
+  bool m_host_replied;
 
   // send stuff
   LogBufferList *m_buffer_send_list;
-  LogBuffer *m_buffer_in_iocore;
+  LogBufferList *m_buffers_in_iocore;
   ClientFlowControl m_flow;
 
   // back pointer to LogHost container
@@ -66,8 +66,10 @@ m_client_vc(client_vc),
 m_client_vio(NULL),
 m_client_buffer(NULL),
 m_client_reader(NULL),
+m_reply_buffer(NULL),
 m_pending_event(NULL),
-m_read_buffer(NULL), m_read_bytes_wanted(0), m_read_bytes_received(0), m_client_ip(0), m_client_port(0), m_id(ID++)
+m_read_buffer(NULL), m_read_bytes_wanted(0), m_read_bytes_received(0), m_client_ip(0), m_client_port(0),
+m_id(ink_atomic_increment(&ID, 1))
 {
 
   Debug("log-coll", "[%d]host::constructor", m_id);
@@ -171,10 +173,20 @@ LogCollationHostSM::host_auth(int event, void * /* data ATS_UNUSED */)
       ink_assert(m_read_buffer != NULL);
       int diff = strncmp(m_read_buffer, Log::config->collation_secret,
                          m_read_bytes_received);
+
+      // newer clients follow the secret with a NUL and the flags they want
+      int64_t secret_bytes = strlen(Log::config->collation_secret);
+      uint32_t requested_flags = 0;
+      if (m_read_bytes_received >= secret_bytes + 1 + (int64_t)sizeof(uint32_t) && m_read_buffer[secret_bytes] == '\0') {
+        memcpy(&requested_flags, &m_read_buffer[secret_bytes + 1], sizeof(uint32_t));
+      }
       delete[]m_read_buffer;
       m_read_buffer = 0;
       if (!diff) {
         Debug("log-coll", "[%d]host::host_auth - authenticated!", m_id);
+        if (requested_flags) {
+          return host_reply(requested_flags);
+        }
         return host_recv(LOG_COLL_EVENT_SWITCH, NULL);
       } else {
         Debug("log-coll", "[%d]host::host_auth - authenticated failed!", m_id);
@@ -187,6 +199,16 @@ LogCollationHostSM::host_auth(int event, void * /* data ATS_UNUSED */)
 
     }
 
+  case VC_EVENT_WRITE_READY:
+    Debug("log-coll", "[%d]host::host_auth - WRITE_READY", m_id);
+    return EVENT_CONT;
+
+  case VC_EVENT_WRITE_COMPLETE:
+    Debug("log-coll", "[%d]host::host_auth - WRITE_COMPLETE", m_id);
+    return host_recv(LOG_COLL_EVENT_SWITCH, NULL);
+
+  case VC_EVENT_EOS:
+  case VC_EVENT_ERROR:
   case LOG_COLL_EVENT_ERROR:
     Debug("log-coll", "[%d]host::host_auth - ERROR", m_id);
     return host_done(LOG_COLL_EVENT_SWITCH, NULL);
@@ -226,6 +248,9 @@ LogCollationHostSM::host_done(int /* event ATS_UNUSED */, void * /* data ATS_UNU
     }
     free_MIOBuffer(m_client_buffer);
   }
+  if (m_reply_buffer) {
+    free_MIOBuffer(m_reply_buffer);
+  }
   // delete this state machine and return
   delete this;
   return EVENT_DONE;
@@ -246,7 +271,9 @@ LogCollationHostSM::host_init(int event, void * /* data ATS_UNUSED */)
 
   case LOG_COLL_EVENT_SWITCH:
     m_host_state = LOG_COLL_HOST_INIT;
-    m_pending_event = eventProcessor.schedule_imm(this);
+    // stay on the thread the client was accepted on, so that the clients
+    // (and the inflating of what they send) spread over the net threads
+    m_pending_event = m_client_vc->thread->schedule_imm(this);
     return EVENT_CONT;
 
   case EVENT_IMMEDIATE:
@@ -285,57 +312,61 @@ LogCollationHostSM::host_recv(int event, void * /* data ATS_UNUSED */)
   case LOG_COLL_EVENT_READ_COMPLETE:
     Debug("log-coll", "[%d]host::host_recv - READ_COMPLETE", m_id);
     {
-      // grab the log_buffer
-      LogBufferHeader *log_buffer_header;
-      LogBuffer *log_buffer;
-      LogFormat *log_format;
-      LogObject *log_object;
-      unsigned version;
+      // the message holds one or more LogBuffers, each either as is or
+      // in a compressed frame
+      char *p = m_read_buffer;
+      int64_t bytes_left = m_read_bytes_received;
+      bool reused = false;
 
       ink_assert(m_read_buffer != NULL);
-      ink_assert(m_read_bytes_received >= (int64_t)sizeof(LogBufferHeader));
-      log_buffer_header = (LogBufferHeader *) m_read_buffer;
-
-      // convert the buffer we just received to host order
-      // TODO: We currently don't try to make the log buffers handle little vs big endian. TS-1156.
-      // LogBuffer::convert_to_host_order(log_buffer_header);
-
-      version = log_buffer_header->version;
-      if (version != LOG_SEGMENT_VERSION) {
-        Note("[log-coll] invalid LogBuffer received; invalid version - "
-             "buffer = %u, current = %u", version, LOG_SEGMENT_VERSION);
-        delete[]m_read_buffer;
-
-      } else {
-        log_object = Log::match_logobject(log_buffer_header);
-        if (!log_object) {
-          Note("[log-coll] LogObject not found with fieldlist id; " "writing LogBuffer to scrap file");
-          log_object = Log::global_scrap_object;
+      while (bytes_left >= (int64_t)sizeof(LogBufferHeader)) {
+        LogBufferHeader header;
+        char *buf;
+        int64_t segment_bytes;
+
+        memcpy(&header, p, sizeof(header));
+        if (header.cookie == LOG_SEGMENT_COMPRESSED_COOKIE) {
+          LogBufferFrameHeader frame;
+
+          memcpy(&frame, p, sizeof(frame));
+          segment_bytes = sizeof(frame) + (int64_t)frame.byte_count;
+          if (segment_bytes > bytes_left || frame.raw_byte_count < sizeof(LogBufferHeader)) {
+            Note("[log-coll] invalid compressed LogBuffer received; discarding rest of message");
+            break;
+          }
+          buf = new char[frame.raw_byte_count];
+          if (LogBuffer::uncompress(&frame, p + sizeof(frame), buf, frame.raw_byte_count) < 0) {
+            Note("[log-coll] could not uncompress LogBuffer received; discarding it");
+            delete[]buf;
+            buf = NULL;
+          }
+        } else {
+          segment_bytes = header.byte_count;
+          if (segment_bytes > bytes_left || segment_bytes < (int64_t)sizeof(LogBufferHeader)) {
+            Note("[log-coll] invalid LogBuffer received; invalid size - "
+                 "buffer = %u, left in message = %" PRId64, header.byte_count, bytes_left);
+            break;
+          }
+          if (segment_bytes == m_read_bytes_received) {
+            // the whole message, as older clients always send
+            buf = m_read_buffer;
+            reused = true;
+          } else {
+            buf = new char[segment_bytes];
+            memcpy(buf, p, segment_bytes);
+          }
         }
-        log_format = log_object->m_format;
-        Debug("log-coll", "[%d]host::host_recv - using format '%s'", m_id, log_format->name());
-
-        // make a new LogBuffer (log_buffer_header plus subsequent
-        // buffer already converted to host order) and add it to the
-        // object's flush queue
-        //
-        log_buffer = NEW(new LogBuffer(log_object, log_buffer_header));
-
-	RecIncrRawStat(log_rsb, mutex->thread_holding, log_stat_num_received_from_network_stat,
-                       log_buffer_header->entry_count);
-
-	RecIncrRawStat(log_rsb, mutex->thread_holding, log_stat_bytes_received_from_network_stat,
-                       log_buffer_header->byte_count);
-
-        int idx = log_object->add_to_flush_queue(log_buffer);
-        Log::preproc_notify[idx].signal();
+        if (buf) {
+          host_recv_buffer((LogBufferHeader *) buf);
+        }
+        p += segment_bytes;
+        bytes_left -= segment_bytes;
       }
 
-#if defined(LOG_BUFFER_TRACKING)
-      Debug("log-buftrak", "[%d]host::host_recv - network read complete", log_buffer_header->id);
-#endif // defined(LOG_BUFFER_TRACKING)
-
       // get ready for next read (memory may not be freed!!!)
+      if (!reused) {
+        delete[]m_read_buffer;
+      }
       m_read_buffer = 0;
 
       return host_recv(LOG_COLL_EVENT_SWITCH, NULL);
@@ -354,6 +385,88 @@ LogCollationHostSM::host_recv(int event, void * /* data ATS_UNUSED */)
 
 }
 
+//-------------------------------------------------------------------------
+// LogCollationHostSM::host_reply
+// next: host_done || host_recv (through host_auth)
+//-------------------------------------------------------------------------
+
+int
+LogCollationHostSM::host_reply(uint32_t requested_flags)
+{
+  NetMsgHeader nmh;
+  uint32_t supported_flags = LOG_COLL_FLAG_BATCH;
+  uint32_t granted_flags;
+
+#if TS_HAS_LIBZ
+  supported_flags |= LOG_COLL_FLAG_COMPRESS;
+#endif
+  granted_flags = requested_flags & supported_flags;
+  Debug("log-coll", "[%d]host::host_reply - granting flags %u of %u", m_id, granted_flags, requested_flags);
+
+  nmh.msg_bytes = sizeof(granted_flags);
+  m_reply_buffer = new_MIOBuffer();
+  IOBufferReader *reader = m_reply_buffer->alloc_reader();
+  m_reply_buffer->write((char *) &nmh, sizeof(nmh));
+  m_reply_buffer->write((char *) &granted_flags, sizeof(granted_flags));
+
+  // host_auth sees the write through
+  ink_assert(m_client_vc != NULL);
+  m_client_vc->do_io_write(this, sizeof(nmh) + sizeof(granted_flags), reader);
+  return EVENT_CONT;
+}
+
+//-------------------------------------------------------------------------
+// LogCollationHostSM::host_recv_buffer
+//-------------------------------------------------------------------------
+
+void
+LogCollationHostSM::host_recv_buffer(LogBufferHeader * log_buffer_header)
+{
+  LogBuffer *log_buffer;
+  LogFormat *log_format;
+  LogObject *log_object;
+  unsigned version;
+
+  // convert the buffer we just received to host order
+  // TODO: We currently don't try to make the log buffers handle little vs big endian. TS-1156.
+  // LogBuffer::convert_to_host_order(log_buffer_header);
+
+  version = log_buffer_header->version;
+  if (version != LOG_SEGMENT_VERSION) {
+    Note("[log-coll] invalid LogBuffer received; invalid version - "
+         "buffer = %u, current = %u", version, LOG_SEGMENT_VERSION);
+    delete[](char *) log_buffer_header;
+    return;
+  }
+
+  log_object = Log::match_logobject(log_buffer_header);
+  if (!log_object) {
+    Note("[log-coll] LogObject not found with fieldlist id; " "writing LogBuffer to scrap file");
+    log_object = Log::global_scrap_object;
+  }
+  log_format = log_object->m_format;
+  Debug("log-coll", "[%d]host::host_recv - using format '%s'", m_id, log_format->name());
+
+#if defined(LOG_BUFFER_TRACKING)
+  Debug("log-buftrak", "[%d]host::host_recv - network read complete", log_buffer_header->id);
+#endif // defined(LOG_BUFFER_TRACKING)
+
+  // make a new LogBuffer (log_buffer_header plus subsequent
+  // buffer already converted to host order) and add it to the
+  // object's flush queue
+  //
+  log_buffer = NEW(new LogBuffer(log_object, log_buffer_header));
+
+  RecIncrRawStat(log_rsb, mutex->thread_holding, log_stat_num_received_from_network_stat,
+                 log_buffer_header->entry_count);
+
+  RecIncrRawStat(log_rsb, mutex->thread_holding, log_stat_bytes_received_from_network_stat,
+                 log_buffer_header->byte_count);
+
+  int idx = log_object->add_to_flush_queue(log_buffer);
+  Log::preproc_notify[idx].signal();
+}
+
 //-------------------------------------------------------------------------
 //-------------------------------------------------------------------------
 //
@@ -79,6 +79,10 @@ private:
   int host_done(int event, void *data);
   HostState m_host_state;
 
+  // helpers for host states
+  int host_reply(uint32_t requested_flags);
+  void host_recv_buffer(LogBufferHeader * log_buffer_header);
+
   // read states
   int read_hdr(int event, VIO * vio);
   int read_body(int event, VIO * vio);
@@ -94,6 +98,7 @@ private:
   VIO *m_client_vio;
   MIOBuffer *m_client_buffer;
   IOBufferReader *m_client_reader;
+  MIOBuffer *m_reply_buffer;
   Event *m_pending_event;
 
   // read_state stuff
@@ -103,6 +103,8 @@ LogConfig::setup_default_values()
   hostname = ats_strdup(name);
 
   log_buffer_size = (int) (10 * LOG_KILOBYTE);
+  per_thread_buffers = 1;
+  binary_compression_level = 0;
   max_secs_per_buffer = 5;
   max_space_mb_for_logs = 100;
   max_space_mb_for_orphan_logs = 25;
@@ -139,9 +141,12 @@ LogConfig::setup_default_values()
   collation_port = 0;
   collation_host_tagged = false;
   collation_preproc_threads = 1;
+  flush_threads = 1;
   collation_secret = ats_strdup("foobar");
   collation_retry_sec = 0;
   collation_max_send_buffers = 0;
+  collation_batch_buffers = 1;
+  collation_compression_level = 0;
 
   rolling_enabled = NO_ROLLING;
   rolling_interval_sec = 86400; // 24 hours
@@ -206,6 +211,19 @@ LogConfig::read_configuration_variables()
     log_buffer_size = val;
   }
 
+  per_thread_buffers = (int) REC_ConfigReadInteger("proxy.config.log.per_thread_buffers");
+
+  val = (int) REC_ConfigReadInteger("proxy.config.log.binary_compression_level");
+  if (val >= 0 && val <= 9) {
+    binary_compression_level = val;
+  }
+#if ! TS_HAS_LIBZ
+  if (binary_compression_level) {
+    Warning("libz not available for binary log compression");
+    binary_compression_level = 0;
+  }
+#endif
+
   val = (int) REC_ConfigReadInteger("proxy.config.log.max_secs_per_buffer");
   if (val > 0) {
     max_secs_per_buffer = val;
@@ -420,6 +438,11 @@ LogConfig::read_configuration_variables()
     collation_preproc_threads = val;
   }
 
+  val = (int) REC_ConfigReadInteger("proxy.config.log.flush_threads");
+  if (val > 0 && val <= 128) {
+    flush_threads = val;
+  }
+
   ptr = REC_ConfigReadString("proxy.config.log.collation_secret");
   if (ptr != NULL) {
     ats_free(collation_secret);
@@ -436,6 +459,22 @@ LogConfig::read_configuration_variables()
     collation_max_send_buffers = val;
   }
 
+  val = (int) REC_ConfigReadInteger("proxy.config.log.collation_batch_buffers");
+  if (val >= 1 && val <= 64) {
+    collation_batch_buffers = val;
+  }
+
+  val = (int) REC_ConfigReadInteger("proxy.config.log.collation_compression_level");
+  if (val >= 0 && val <= 9) {
+    collation_compression_level = val;
+  }
+#if ! TS_HAS_LIBZ
+  if (collation_compression_level) {
+    Warning("libz not available for log collation compression");
+    collation_compression_level = 0;
+  }
+#endif
+
 
   // ROLLING
 
@@ -766,6 +805,8 @@ LogConfig::display(FILE * fd)
   fprintf(fd, "-----------------------------\n");
   fprintf(fd, "Config variables:\n");
   fprintf(fd, "   log_buffer_size = %d\n", log_buffer_size);
+  fprintf(fd, "   per_thread_buffers = %d\n", per_thread_buffers);
+  fprintf(fd, "   binary_compression_level = %d\n", binary_compression_level);
   fprintf(fd, "   max_secs_per_buffer = %d\n", max_secs_per_buffer);
   fprintf(fd, "   max_space_mb_for_logs = %d\n", max_space_mb_for_logs);
   fprintf(fd, "   max_space_mb_for_orphan_logs = %d\n", max_space_mb_for_orphan_logs);
@@ -800,7 +841,10 @@ LogConfig::display(FILE * fd)
   fprintf(fd, "   collation_port = %d\n", collation_port);
   fprintf(fd, "   collation_host_tagged = %d\n", collation_host_tagged);
   fprintf(fd, "   collation_preproc_threads = %d\n", collation_preproc_threads);
+  fprintf(fd, "   flush_threads = %d\n", flush_threads);
   fprintf(fd, "   collation_secret = %s\n", collation_secret);
+  fprintf(fd, "   collation_batch_buffers = %d\n", collation_batch_buffers);
+  fprintf(fd, "   collation_compression_level = %d\n", collation_compression_level);
   fprintf(fd, "   rolling_enabled = %d\n", rolling_enabled);
   fprintf(fd, "   rolling_interval_sec = %d\n", rolling_interval_sec);
   fprintf(fd, "   rolling_offset_hr = %d\n", rolling_offset_hr);
@@ -1220,6 +1264,8 @@ LogConfig::register_config_callbacks()
   // Note: variables that are not exposed in the UI are commented out
   //
   REC_RegisterConfigUpdateFunc("proxy.config.log.log_buffer_size", &LogConfig::reconfigure, NULL);
+  REC_RegisterConfigUpdateFunc("proxy.config.log.per_thread_buffers", &LogConfig::reconfigure, NULL);
+  REC_RegisterConfigUpdateFunc("proxy.config.log.binary_compression_level", &LogConfig::reconfigure, NULL);
 //    REC_RegisterConfigUpdateFunc ("proxy.config.log.max_secs_per_buffer",
 //                            &LogConfig::reconfigure, NULL);
   REC_RegisterConfigUpdateFunc("proxy.config.log.max_space_mb_for_logs", &LogConfig::reconfigure, NULL);
@@ -1266,6 +1312,8 @@ LogConfig::register_config_callbacks()
   REC_RegisterConfigUpdateFunc("proxy.config.log.collation_port", &LogConfig::reconfigure, NULL);
   REC_RegisterConfigUpdateFunc("proxy.config.log.collation_host_tagged", &LogConfig::reconfigure, NULL);
   REC_RegisterConfigUpdateFunc("proxy.config.log.collation_secret", &LogConfig::reconfigure, NULL);
+  REC_RegisterConfigUpdateFunc("proxy.config.log.collation_batch_buffers", &LogConfig::reconfigure, NULL);
+  REC_RegisterConfigUpdateFunc("proxy.config.log.collation_compression_level", &LogConfig::reconfigure, NULL);
 //    REC_RegisterConfigUpdateFunc ("proxy.config.log.collation_retry_sec",
 //                                  &LogConfig::reconfigure, NULL);
 //    REC_RegisterConfigUpdateFunc ("proxy.config.log.collation_max_send_buffers",
@@ -1395,6 +1443,24 @@ LogConfig::register_stat_callbacks()
   RecRegisterRawStat(log_rsb, RECT_PROCESS,
                      "proxy.process.log.log_files_space_used",
                      RECD_INT, RECP_NON_PERSISTENT, (int) log_stat_log_files_space_used_stat, RecRawStatSyncSum);
+  //
+  // Queues
+  //
+  RecRegisterRawStat(log_rsb, RECT_PROCESS,
+                     "proxy.process.log.preproc_queue_depth",
+                     RECD_INT, RECP_NON_PERSISTENT, (int) log_stat_preproc_queue_depth_stat, RecRawStatSyncSum);
+  RecRegisterRawStat(log_rsb, RECT_PROCESS,
+                     "proxy.process.log.flush_queue_depth",
+                     RECD_INT, RECP_NON_PERSISTENT, (int) log_stat_flush_queue_depth_stat, RecRawStatSyncSum);
+  RecRegisterRawStat(log_rsb, RECT_PROCESS,
+                     "proxy.process.log.flush_latency",
+                     RECD_FLOAT, RECP_NON_PERSISTENT, (int) log_stat_flush_latency_stat, RecRawStatSyncHrTimeAvg);
+  //
+  // Memory
+  //
+  RecRegisterRawStat(log_rsb, RECT_PROCESS,
+                     "proxy.process.memory.log_buffer.allocated_bytes",
+                     RECD_INT, RECP_NON_PERSISTENT, (int) log_stat_buffer_bytes_stat, RecRawStatSyncSum);
 }
 
 /*-------------------------------------------------------------------------
@@ -1694,6 +1760,28 @@ LogConfig::update_space_used()
   This is a new routine for reading the XML-based log config file.
   -------------------------------------------------------------------------*/
 
+// Look up an integer field for a LogObject aggregate attribute. Returns
+// NULL, with *valid set, if the attribute turns the value off ("-").
+//
+static LogField *
+aggregate_int_field(const char *attr, char *symbol, const char *default_symbol, bool * valid)
+{
+  *valid = true;
+  if (!symbol) {
+    symbol = (char *) default_symbol;
+  }
+  if (strcmp(symbol, "-") == 0) {
+    return NULL;
+  }
+  LogField *field = Log::global_field_list.find_by_symbol(symbol);
+  if (!field || field->type() != LogField::sINT) {
+    Warning("%s is not a valid integer field for the '%s' attribute", symbol, attr);
+    *valid = false;
+    return NULL;
+  }
+  return field;
+}
+
 static char xml_config_buffer[] = "<LogFilter> \
                                   <Name = \"reject_gif\"/> \
                                   <Action = \"REJECT\"/> \
@@ -1986,8 +2074,13 @@ LogConfig::read_xml_log_config(int from_memory)
         Debug("xml", "... now field symbol is %s", field_str);
       }
 
-      LogField *logfield = Log::global_field_list.find_by_symbol(field_str);
-      if (!logfield) {
+      // SAMPLE takes the place of an operator; "*" samples at random
+      //
+      bool sample = (strcasecmp(oper_str, LogFilterSample::OPERATOR_NAME) == 0);
+      bool random_sample = sample && strcmp(field_str, LogFilterSample::RANDOM_FIELD) == 0;
+
+      LogField *logfield = random_sample ? NULL : Log::global_field_list.find_by_symbol(field_str);
+      if (!logfield && !random_sample) {
         // check for container fields
         if (*field_str == '{') {
           Note("%s appears to be a container field", field_str);
@@ -2012,54 +2105,58 @@ LogConfig::read_xml_log_config(int from_memory)
         }
       }
 
-      if (!logfield) {
+      if (!logfield && !random_sample) {
         Warning("%s is not a valid field; " "cannot create filter %s.", field_str, filter_name);
         continue;
       }
       // convert the operator string to an enum value and validate it
       //
       LogFilter::Operator oper = LogFilter::MATCH;
-      for (i = 0; i < LogFilter::N_OPERATORS; ++i) {
+      for (i = 0; !sample && i < LogFilter::N_OPERATORS; ++i) {
         if (strcasecmp(oper_str, LogFilter::OPERATOR_NAME[i]) == 0) {
           oper = (LogFilter::Operator) i;
           break;
         }
       }
 
-      if (i == LogFilter::N_OPERATORS) {
+      if (!sample && i == LogFilter::N_OPERATORS) {
         Warning("%s is not a valid operator; " "cannot create filter %s.", oper_str, filter_name);
         continue;
       }
       // now create the correct LogFilter
       //
       LogFilter *filter = NULL;
-      LogField::Type field_type = logfield->type();
+      if (sample) {
+        filter = NEW(new LogFilterSample(filter_name, logfield, act, ink_atoi64(val_str)));
+      } else {
+        LogField::Type field_type = logfield->type();
 
-      switch (field_type) {
+        switch (field_type) {
 
-      case LogField::sINT:
+        case LogField::sINT:
 
-        filter = NEW(new LogFilterInt(filter_name, logfield, act, oper, val_str));
-        break;
+          filter = NEW(new LogFilterInt(filter_name, logfield, act, oper, val_str));
+          break;
 
-      case LogField::dINT:
+        case LogField::dINT:
 
-        Warning("Internal error: invalid field type (double int); " "cannot create filter %s.", filter_name);
-        continue;
+          Warning("Internal error: invalid field type (double int); " "cannot create filter %s.", filter_name);
+          continue;
 
-      case LogField::STRING:
+        case LogField::STRING:
 
-        filter = NEW(new LogFilterString(filter_name, logfield, act, oper, val_str));
-        break;
+          filter = NEW(new LogFilterString(filter_name, logfield, act, oper, val_str));
+          break;
 
-      case LogField::IP:
-        Warning("Internal error: IP filters not yet supported " "cannot create filter %s.", filter_name);
-        continue;
+        case LogField::IP:
+          Warning("Internal error: IP filters not yet supported " "cannot create filter %s.", filter_name);
+          continue;
 
-      default:
+        default:
 
-        Warning("Internal error: unknown field type %d; " "cannot create filter %s.", field_type, filter_name);
-        continue;
+          Warning("Internal error: unknown field type %d; " "cannot create filter %s.", field_type, filter_name);
+          continue;
+        }
       }
 
       ink_assert(filter);
@@ -2096,6 +2193,11 @@ LogConfig::read_xml_log_config(int from_memory)
       NameList rollingIntervalSec;
       NameList rollingOffsetHr;
       NameList rollingSizeMb;
+      NameList aggregateKey;
+      NameList aggregateBytes;
+      NameList aggregateLatency;
+      NameList aggregateIntervalSec;
+      NameList aggregateMaxKeys;
 
       for (xattr = xobj->first(); xattr; xattr = xobj->next(xattr)) {
         Debug("xml", "XmlAttr  : <%s,%s>", xattr->tag(), xattr->value());
@@ -2123,6 +2225,16 @@ LogConfig::read_xml_log_config(int from_memory)
           rollingOffsetHr.enqueue(xattr->value());
         } else if (strcasecmp(xattr->tag(), "RollingSizeMb") == 0) {
           rollingSizeMb.enqueue(xattr->value());
+        } else if (strcasecmp(xattr->tag(), "AggregateKey") == 0) {
+          aggregateKey.enqueue(xattr->value());
+        } else if (strcasecmp(xattr->tag(), "AggregateBytes") == 0) {
+          aggregateBytes.enqueue(xattr->value());
+        } else if (strcasecmp(xattr->tag(), "AggregateLatency") == 0) {
+          aggregateLatency.enqueue(xattr->value());
+        } else if (strcasecmp(xattr->tag(), "AggregateIntervalSec") == 0) {
+          aggregateIntervalSec.enqueue(xattr->value());
+        } else if (strcasecmp(xattr->tag(), "AggregateMaxKeys") == 0) {
+          aggregateMaxKeys.enqueue(xattr->value());
         } else {
           Note("Unknown attribute %s for %s; ignoring", xattr->tag(), xobj->object_name());
         }
@@ -2130,7 +2242,7 @@ LogConfig::read_xml_log_config(int from_memory)
 
       // check integrity constraints
       //
-      if (format.count() == 0) {
+      if (format.count() == 0 && aggregateKey.count() == 0) {
         Note("'Format' attribute missing for LogObject object");
         continue;
       }
@@ -2178,11 +2290,46 @@ LogConfig::read_xml_log_config(int from_memory)
       // create new LogObject and start adding to it
       //
 
-      char *fmt_name = format.dequeue();
-      LogFormat *fmt = global_format_list.find_by_name(fmt_name);
-      if (!fmt) {
-        Warning("Format %s not in the global format list; " "cannot create LogObject", fmt_name);
-        continue;
+      // an aggregate object writes its own summary lines, so it takes
+      // fields to roll up instead of a format
+      //
+      LogField *agg_key_field = NULL;
+      LogField *agg_bytes_field = NULL;
+      LogField *agg_latency_field = NULL;
+      char *aggregateKey_str = aggregateKey.dequeue();
+      if (aggregateKey_str) {
+        bool bytes_valid, latency_valid;
+        agg_key_field = Log::global_field_list.find_by_symbol(aggregateKey_str);
+        if (!agg_key_field) {
+          Warning("%s is not a valid field; " "cannot create aggregate LogObject", aggregateKey_str);
+          continue;
+        }
+        agg_bytes_field = aggregate_int_field("AggregateBytes", aggregateBytes.dequeue(), "psql", &bytes_valid);
+        agg_latency_field = aggregate_int_field("AggregateLatency", aggregateLatency.dequeue(), "ttms", &latency_valid);
+        if (!bytes_valid || !latency_valid) {
+          Warning("cannot create aggregate LogObject for key %s", aggregateKey_str);
+          continue;
+        }
+        if (format.count()) {
+          Note("'Format' attribute is ignored for aggregate LogObject");
+        }
+        if (mode.count()) {
+          Note("'Mode' attribute is ignored for aggregate LogObject; it is always ascii");
+        }
+        if (collationHosts.count()) {
+          Note("'CollationHosts' attribute is ignored for aggregate LogObject");
+          collationHosts.clear();
+        }
+      }
+
+      LogFormat *fmt = NULL;
+      if (!agg_key_field) {
+        char *fmt_name = format.dequeue();
+        fmt = global_format_list.find_by_name(fmt_name);
+        if (!fmt) {
+          Warning("Format %s not in the global format list; " "cannot create LogObject", fmt_name);
+          continue;
+        }
       }
       // file format
       //
@@ -2209,15 +2356,31 @@ LogConfig::read_xml_log_config(int from_memory)
 
       // create the new object
       //
-      LogObject *obj = NEW(new LogObject(fmt, logfile_dir,
-                                         filename.dequeue(),
-                                         file_type,
+      LogObject *obj;
+      if (agg_key_field) {
+        char *aggregateIntervalSec_str = aggregateIntervalSec.dequeue();
+        char *aggregateMaxKeys_str = aggregateMaxKeys.dequeue();
+        obj = NEW(new LogAggregateObject(filename.dequeue(), logfile_dir,
+                                         agg_key_field, agg_bytes_field, agg_latency_field,
+                                         aggregateIntervalSec_str ? ink_atoui(aggregateIntervalSec_str) : 60,
+                                         aggregateMaxKeys_str ? ink_atoui(aggregateMaxKeys_str) : 10000,
                                          header.dequeue(),
                                          obj_rolling_enabled,
                                          collation_preproc_threads,
                                          obj_rolling_interval_sec,
                                          obj_rolling_offset_hr,
                                          obj_rolling_size_mb));
+      } else {
+        obj = NEW(new LogObject(fmt, logfile_dir,
+                                filename.dequeue(),
+                                file_type,
+                                header.dequeue(),
+                                obj_rolling_enabled,
+                                collation_preproc_threads,
+                                obj_rolling_interval_sec,
+                                obj_rolling_offset_hr,
+                                obj_rolling_size_mb));
+      }
 
       // filters
       //
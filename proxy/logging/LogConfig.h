@@ -69,6 +69,14 @@ enum
   log_stat_log_files_open_stat,
   log_stat_log_files_space_used_stat,
 
+  // Logging queues
+  log_stat_preproc_queue_depth_stat,
+  log_stat_flush_queue_depth_stat,
+  log_stat_flush_latency_stat,
+
+  // Memory
+  log_stat_buffer_bytes_stat,
+
   log_stat_count
 };
 
@@ -190,6 +198,8 @@ public:
   LogFormatList global_format_list;
 
   int log_buffer_size;
+  int per_thread_buffers;
+  int binary_compression_level;
   int max_secs_per_buffer;
   int max_space_mb_for_logs;
   int max_space_mb_for_orphan_logs;
@@ -210,8 +220,11 @@ public:
   int collation_port;
   bool collation_host_tagged;
   int collation_preproc_threads;
+  int flush_threads;
   int collation_retry_sec;
   int collation_max_send_buffers;
+  int collation_batch_buffers;
+  int collation_compression_level;
   int rolling_enabled;
   int rolling_interval_sec;
   int rolling_offset_hr;
@@ -37,6 +37,12 @@
 #include "LogAccess.h"
 #include "Log.h"
 
+#if TS_HAS_TESTS
+#include "LogFormat.h"
+#include "LogAccessTest.h"
+#include "ts/TestBox.h"
+#endif
+
 const char *container_names[] = {
   "not-a-container",
   "cqh",
@@ -52,9 +58,45 @@ const char *container_names[] = {
   "icfg",
   "scfg",
   "record",
+  "msdms",
   ""
 };
 
+// In the order of TSMilestonesType
+static const char *milestone_names[] = {
+  "ua_begin",
+  "ua_read_header_done",
+  "ua_begin_write",
+  "ua_close",
+  "server_first_connect",
+  "server_connect",
+  "server_connect_end",
+  "server_begin_write",
+  "server_first_read",
+  "server_read_header_done",
+  "server_close",
+  "cache_open_read_begin",
+  "cache_open_read_end",
+  "cache_open_write_begin",
+  "cache_open_write_end",
+  "dns_lookup_begin",
+  "dns_lookup_end",
+  "sm_start",
+  "sm_finish",
+  "plugin_total"
+};
+
+static int
+milestone_lookup(const char *name, int len)
+{
+  for (unsigned i = 0; i < countof(milestone_names); i++) {
+    if ((int) strlen(milestone_names[i]) == len && strncasecmp(name, milestone_names[i], len) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
 const char *aggregate_names[] = {
   "not-an-agg-op",
   "COUNT",
@@ -73,7 +115,7 @@ const char *aggregate_names[] = {
 LogField::LogField(const char *name, const char *symbol, Type type, MarshalFunc marshal, UnmarshalFunc unmarshal)
   : m_name(ats_strdup(name)), m_symbol(ats_strdup(symbol)), m_type(type), m_container(NO_CONTAINER), m_marshal_func(marshal),
     m_unmarshal_func(unmarshal), m_unmarshal_func_map(NULL), m_agg_op(NO_AGGREGATE), m_agg_cnt(0), m_agg_val(0),
-    m_time_field(false), m_alias_map(0)
+    m_time_field(false), m_alias_map(0), m_milestone1(-1), m_milestone2(-1)
 {
   ink_assert(m_name != NULL);
   ink_assert(m_symbol != NULL);
@@ -90,7 +132,7 @@ LogField::LogField(const char *name, const char *symbol, Type type,
                    MarshalFunc marshal, UnmarshalFuncWithMap unmarshal, Ptr<LogFieldAliasMap> map)
   : m_name(ats_strdup(name)), m_symbol(ats_strdup(symbol)), m_type(type), m_container(NO_CONTAINER), m_marshal_func(marshal),
     m_unmarshal_func(NULL), m_unmarshal_func_map(unmarshal), m_agg_op(NO_AGGREGATE), m_agg_cnt(0), m_agg_val(0),
-    m_time_field(false), m_alias_map(map)
+    m_time_field(false), m_alias_map(map), m_milestone1(-1), m_milestone2(-1)
 {
   ink_assert(m_name != NULL);
   ink_assert(m_symbol != NULL);
@@ -108,7 +150,8 @@ LogField::LogField(const char *name, const char *symbol, Type type,
 LogField::LogField(const char *field, Container container)
   : m_name(ats_strdup(field)), m_symbol(ats_strdup(container_names[container])), m_type(LogField::STRING),
     m_container(container), m_marshal_func(NULL), m_unmarshal_func(NULL), m_unmarshal_func_map(NULL),
-    m_agg_op(NO_AGGREGATE), m_agg_cnt(0), m_agg_val(0), m_time_field(false), m_alias_map(0)
+    m_agg_op(NO_AGGREGATE), m_agg_cnt(0), m_agg_val(0), m_time_field(false), m_alias_map(0), m_milestone1(-1),
+    m_milestone2(-1)
 {
   ink_assert(m_name != NULL);
   ink_assert(m_symbol != NULL);
@@ -142,6 +185,25 @@ LogField::LogField(const char *field, Container container)
     m_unmarshal_func = &(LogAccess::unmarshal_record);
     break;
 
+  case MSDMS:
+    {
+      // "name1-name2" is the time between two milestones, a single name
+      // is the time since the transaction started
+      const char *dash = strchr(m_name, '-');
+      int len = dash ? (int) (dash - m_name) : (int) strlen(m_name);
+
+      m_type = LogField::sINT;
+      m_milestone1 = milestone_lookup(m_name, len);
+      if (dash) {
+        m_milestone2 = milestone_lookup(dash + 1, strlen(dash + 1));
+      }
+      if (m_milestone1 < 0 || (dash && m_milestone2 < 0)) {
+        Note("Invalid milestone in log field {%s}msdms", m_name);
+      }
+      m_unmarshal_func = &(LogAccess::unmarshal_int_to_str);
+      break;
+    }
+
   default:
     Note("Invalid container type in LogField ctor: %d", container);
   }
@@ -151,7 +213,8 @@ LogField::LogField(const char *field, Container container)
 LogField::LogField(const LogField &rhs)
   : m_name(ats_strdup(rhs.m_name)), m_symbol(ats_strdup(rhs.m_symbol)), m_type(rhs.m_type), m_container(rhs.m_container),
     m_marshal_func(rhs.m_marshal_func), m_unmarshal_func(rhs.m_unmarshal_func), m_unmarshal_func_map(rhs.m_unmarshal_func_map),
-    m_agg_op(rhs.m_agg_op), m_agg_cnt(0), m_agg_val(0), m_time_field(rhs.m_time_field), m_alias_map(rhs.m_alias_map)
+    m_agg_op(rhs.m_agg_op), m_agg_cnt(0), m_agg_val(0), m_time_field(rhs.m_time_field), m_alias_map(rhs.m_alias_map),
+    m_milestone1(rhs.m_milestone1), m_milestone2(rhs.m_milestone2)
 {
   ink_assert(m_name != NULL);
   ink_assert(m_symbol != NULL);
@@ -205,6 +268,9 @@ LogField::marshal_len(LogAccess *lad)
   case RECORD:
     return lad->marshal_record(m_name, NULL);
 
+  case MSDMS:
+    return lad->marshal_milestone_diff(m_milestone1, m_milestone2, NULL);
+
   default:
     return 0;
   }
@@ -246,6 +312,9 @@ LogField::marshal(LogAccess *lad, char *buf)
   case RECORD:
     return lad->marshal_record(m_name, buf);
 
+  case MSDMS:
+    return lad->marshal_milestone_diff(m_milestone1, m_milestone2, buf);
+
   default:
     return 0;
   }
@@ -428,7 +497,7 @@ bool LogField::fieldlist_contains_aggregates(char *fieldlist)
   this, items are copied by default, using the copy ctor.
   -------------------------------------------------------------------------*/
 LogFieldList::LogFieldList()
-  : m_marshal_len(0)
+  : m_marshal_len(0), m_steps(NULL), m_n_steps(0), m_var_steps(NULL), m_n_var_steps(0)
 { }
 
 LogFieldList::~LogFieldList()
@@ -444,6 +513,10 @@ LogFieldList::clear()
     delete f;                   // safe given the semantics stated above
   }
   m_marshal_len = 0;
+  ats_free(m_steps);
+  ats_free(m_var_steps);
+  m_steps = m_var_steps = NULL;
+  m_n_steps = m_n_var_steps = 0;
 }
 
 void
@@ -460,6 +533,29 @@ LogFieldList::add(LogField *field, bool copy)
   if (field->type() == LogField::sINT) {
     m_marshal_len += INK_MIN_ALIGN;
   }
+  compile();
+}
+
+void
+LogFieldList::compile()
+{
+  unsigned n = count();
+
+  ats_free(m_steps);
+  ats_free(m_var_steps);
+  m_steps = (MarshalStep *)ats_malloc(n * sizeof(MarshalStep));
+  m_var_steps = (MarshalStep *)ats_malloc(n * sizeof(MarshalStep));
+  m_n_steps = m_n_var_steps = 0;
+
+  for (LogField *f = first(); f; f = next(f)) {
+    MarshalStep step;
+    step.field = f;
+    step.func = f->direct_marshal_func();
+    m_steps[m_n_steps++] = step;
+    if (f->type() != LogField::sINT) {
+      m_var_steps[m_n_var_steps++] = step;
+    }
+  }
 }
 
 LogField *
@@ -499,10 +595,11 @@ unsigned
 LogFieldList::marshal_len(LogAccess *lad)
 {
   int bytes = 0;
-  for (LogField *f = first(); f; f = next(f)) {
-    if (f->type() != LogField::sINT) {
-      bytes += f->marshal_len(lad);
-    }
+  const MarshalStep *step = m_var_steps;
+  const MarshalStep *end = m_var_steps + m_n_var_steps;
+
+  for (; step < end; ++step) {
+    bytes += step->func ? (lad->*(step->func)) (NULL) : step->field->marshal_len(lad);
   }
   return m_marshal_len + bytes;
 }
@@ -510,14 +607,15 @@ LogFieldList::marshal_len(LogAccess *lad)
 unsigned
 LogFieldList::marshal(LogAccess *lad, char *buf)
 {
-  char *ptr;
-  int bytes = 0;
-  for (LogField *f = first(); f; f = next(f)) {
-    ptr = &buf[bytes];
-    bytes += f->marshal(lad, ptr);
-    ink_assert(bytes % INK_MIN_ALIGN == 0);
+  char *ptr = buf;
+  const MarshalStep *step = m_steps;
+  const MarshalStep *end = m_steps + m_n_steps;
+
+  for (; step < end; ++step) {
+    ptr += step->func ? (lad->*(step->func)) (ptr) : step->field->marshal(lad, ptr);
+    ink_assert((ptr - buf) % INK_MIN_ALIGN == 0);
   }
-  return bytes;
+  return ptr - buf;
 }
 
 unsigned
@@ -549,3 +647,114 @@ LogFieldList::display(FILE *fd)
     f->display(fd);
   }
 }
+
+#if TS_HAS_TESTS
+// Size and marshal an entry the way LogFieldList did before it kept a plan,
+// one field at a time over the linked list, to check and time the plan against.
+static unsigned
+marshal_len_by_field(LogFieldList *fl, LogAccess *lad)
+{
+  unsigned bytes = 0;
+  for (LogField *f = fl->first(); f; f = fl->next(f)) {
+    bytes += f->type() == LogField::sINT ? INK_MIN_ALIGN : f->marshal_len(lad);
+  }
+  return bytes;
+}
+
+static unsigned
+marshal_by_field(LogFieldList *fl, LogAccess *lad, char *buf)
+{
+  unsigned bytes = 0;
+  for (LogField *f = fl->first(); f; f = fl->next(f)) {
+    bytes += f->marshal(lad, &buf[bytes]);
+  }
+  return bytes;
+}
+
+// Compare two marshalled entries slot by slot. Strings and addresses are
+// compared by value since their padding bytes are not always initialised.
+static bool
+same_entry(LogFieldList *fl, LogAccess *lad, char *a, char *b)
+{
+  char a_str[256], b_str[256];
+  for (LogField *f = fl->first(); f; f = fl->next(f)) {
+    unsigned slot = f->type() == LogField::sINT ? INK_MIN_ALIGN : f->marshal_len(lad);
+    bool same;
+
+    switch (f->type()) {
+    case LogField::STRING:
+      same = strncmp(a, b, slot) == 0;
+      break;
+    case LogField::IP: {
+      char *ap = a, *bp = b;
+      int a_len = LogAccess::unmarshal_ip_to_str(&ap, a_str, sizeof(a_str));
+      int b_len = LogAccess::unmarshal_ip_to_str(&bp, b_str, sizeof(b_str));
+      same = a_len == b_len && memcmp(a_str, b_str, a_len) == 0;
+      break;
+    }
+    default:
+      same = memcmp(a, b, slot) == 0;
+      break;
+    }
+    if (!same) {
+      return false;
+    }
+    a += slot;
+    b += slot;
+  }
+  return true;
+}
+
+static void
+check_marshal_plan(RegressionTest *t, TestBox &box, const char *name, LogFieldList *fl, LogAccess *lad)
+{
+  const int iterations = 200000;
+  unsigned len = fl->marshal_len(lad);
+  char *plan_buf = (char *)ats_malloc(len);
+  char *field_buf = (char *)ats_malloc(len);
+  ink_hrtime start, plan_time, field_time;
+  unsigned plan_bytes = 0, field_bytes = 0;
+  char tag[64];
+
+  box.check(fl->marshal(lad, plan_buf) == len, "%s: marshal() did not fill marshal_len() bytes", name);
+  box.check(marshal_len_by_field(fl, lad) == len, "%s: per field marshal_len mismatch", name);
+  box.check(marshal_by_field(fl, lad, field_buf) == len, "%s: per field marshal length mismatch", name);
+  box.check(same_entry(fl, lad, plan_buf, field_buf), "%s: marshal plan changed the entry layout", name);
+
+  start = ink_get_hrtime_internal();
+  for (int i = 0; i < iterations; ++i) {
+    field_bytes += marshal_len_by_field(fl, lad);
+    field_bytes += marshal_by_field(fl, lad, field_buf);
+  }
+  field_time = ink_get_hrtime_internal() - start;
+
+  start = ink_get_hrtime_internal();
+  for (int i = 0; i < iterations; ++i) {
+    plan_bytes += fl->marshal_len(lad);
+    plan_bytes += fl->marshal(lad, plan_buf);
+  }
+  plan_time = ink_get_hrtime_internal() - start;
+
+  box.check(plan_bytes == field_bytes, "%s: marshal output size drifted", name);
+  rprintf(t, "%s: %d fields, %d bytes per entry\n", name, (int)fl->count(), (int)len);
+  snprintf(tag, sizeof(tag), "%s.per_field_ns", name);
+  rperf(t, tag, (double)field_time / iterations);
+  snprintf(tag, sizeof(tag), "%s.plan_ns", name);
+  rperf(t, tag, (double)plan_time / iterations);
+
+  ats_free(plan_buf);
+  ats_free(field_buf);
+}
+
+REGRESSION_TEST(LogFieldList_marshal)(RegressionTest * t, int /* atype ATS_UNUSED */, int * pstatus)
+{
+  TestBox box(t, pstatus);
+  LogAccessTest lad;
+  LogFormat extended2(EXTENDED2_LOG);
+  LogFormat custom("marshal_test", "%<chi> %<cqu> %<{Host}cqh> %<pssc> %<psct> %<ttms> %<{sm_finish-sm_start}msdms>");
+
+  box = REGRESSION_TEST_PASSED;
+  check_marshal_plan(t, box, "extended2", &extended2.m_field_list, &lad);
+  check_marshal_plan(t, box, "custom", &custom.m_field_list, &lad);
+}
+#endif
@@ -75,6 +75,7 @@ public:
     ICFG,
     SCFG,
     RECORD,
+    MSDMS,
     N_CONTAINERS
   };
 
@@ -128,6 +129,12 @@ public:
   {
     return m_time_field;
   }
+  // The LogAccess accessor for plain fields, or NULL if marshalling
+  // needs to go through the container dispatch in marshal().
+  MarshalFunc direct_marshal_func() const
+  {
+    return m_container == NO_CONTAINER ? m_marshal_func : NULL;
+  }
 
   void set_aggregate_op(Aggregate agg_op);
   void update_aggregate(int64_t val);
@@ -149,6 +156,8 @@ private:
   int64_t m_agg_val;
   bool m_time_field;
   Ptr<LogFieldAliasMap> m_alias_map; // map sINT <--> string
+  int m_milestone1;             // for MSDMS, the milestones of "name1-name2"
+  int m_milestone2;             // -1 when there is no second name
 
 public:
   LINK(LogField, link);
@@ -197,8 +206,24 @@ public:
   void display(FILE * fd = stdout);
 
 private:
-  unsigned m_marshal_len;
+  // The marshalling plan is rebuilt whenever a field is added so that the
+  // per-entry path walks a flat array instead of the field list and calls
+  // plain accessors directly. Entry layout is unchanged; fields are still
+  // marshalled in list order so that existing readers can decode them.
+  struct MarshalStep
+  {
+    LogField *field;
+    LogField::MarshalFunc func;  // NULL means use field->marshal()
+  };
+
+  void compile();
+
+  unsigned m_marshal_len;       // bytes taken by the fixed size (sINT) fields
   Queue<LogField> m_field_list;
+  MarshalStep *m_steps;         // every field, in list order
+  unsigned m_n_steps;
+  MarshalStep *m_var_steps;     // the variable length fields only
+  unsigned m_n_var_steps;
 
   // -- member functions that are not allowed --
   LogFieldList(const LogFieldList & rhs);
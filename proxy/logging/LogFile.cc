@@ -78,6 +78,19 @@
 //
 static const int FILESIZE_SAFE_THRESHOLD_FACTOR = 10;
 
+// All buffers of a file go to the same flush thread so they are written
+// in order, and since the choice only depends on the name, a file keeps
+// its flush thread across reconfigurations.
+static int
+flush_index(const char *name)
+{
+  uint32_t h = 0;
+
+  for (const char *p = name; p && *p; p++)
+    h = h * 31 + (unsigned char)*p;
+  return (int)(h % Log::n_flush_threads);
+}
+
 /*-------------------------------------------------------------------------
   LogFile::LogFile
 
@@ -102,6 +115,8 @@ LogFile::LogFile(const char *name, const char *header, LogFileFormat format,
   m_bytes_written = 0;
   m_size_bytes = 0;
   m_ascii_buffer_size = (ascii_buffer_size < max_line_size ? max_line_size : ascii_buffer_size);
+  m_flush_idx = flush_index(m_name);
+  ink_mutex_init(&m_fd_mutex, "LogFile fd");
 
   Debug("log-file", "exiting LogFile constructor, m_name=%s, this=%p", m_name, this);
 }
@@ -123,9 +138,11 @@ LogFile::LogFile (const LogFile& copy)
     m_fd (-1),
     m_start_time (0L),
     m_end_time (0L),
-    m_bytes_written (0)
+    m_bytes_written (0),
+    m_flush_idx (copy.m_flush_idx)
 {
     ink_release_assert(m_ascii_buffer_size >= m_max_line_size);
+    ink_mutex_init(&m_fd_mutex, "LogFile fd");
 
     Debug("log-file", "exiting LogFile copy constructor, m_name=%s, this=%p",
           m_name, this);
@@ -142,6 +159,7 @@ LogFile::~LogFile()
   ats_free(m_name);
   ats_free(m_header);
   delete m_meta_info;
+  ink_mutex_destroy(&m_fd_mutex);
   Debug("log-file", "exiting LogFile destructor, this=%p", this);
 }
 
@@ -353,6 +371,9 @@ bool LogFile::rolled_logfile(char *path)
 int
 LogFile::roll(long interval_start, long interval_end)
 {
+  // the flush thread of this file may be writing to it
+  ink_scoped_mutex lock(m_fd_mutex);
+
   //
   // First, let's see if a roll is even needed.
   //
@@ -526,9 +547,7 @@ LogFile::preproc_and_try_delete(LogBuffer * lb)
     RecIncrRawStat(log_rsb, mutex->thread_holding, log_stat_bytes_flush_to_disk_stat,
                    lb->header()->byte_count);
 
-    ink_atomiclist_push(Log::flush_data_list, flush_data);
-
-    Log::flush_notify->signal();
+    Log::add_to_flush_queue(flush_data);
 
     //
     // LogBuffer will be deleted in flush thread
@@ -715,9 +734,7 @@ LogFile::write_ascii_logbuffer3(LogBufferHeader * buffer_header, char *alt_forma
     RecIncrRawStat(log_rsb, mutex->thread_holding, log_stat_bytes_flush_to_disk_stat,
                    fmt_buf_bytes);
 
-    ink_atomiclist_push(Log::flush_data_list, flush_data);
-
-    Log::flush_notify->signal();
+    Log::add_to_flush_queue(flush_data);
 
     total_bytes += fmt_buf_bytes;
   }
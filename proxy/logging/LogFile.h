@@ -190,6 +190,9 @@ public:
   volatile uint64_t m_bytes_written;
   off_t m_size_bytes;           // current size of file in bytes
 
+  int m_flush_idx;              // flush thread that writes this file
+  ink_mutex m_fd_mutex;         // keeps roll() from closing m_fd under a write
+
 public:
   Link<LogFile> link;
 
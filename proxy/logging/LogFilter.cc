@@ -30,6 +30,7 @@
 
 #include "Resource.h"
 #include "Error.h"
+#include "P_EventSystem.h"
 #include "LogUtils.h"
 #include "LogFilter.h"
 #include "LogField.h"
@@ -56,8 +57,10 @@ const char *LogFilter::ACTION_NAME[] = { "REJECT", "ACCEPT" };
 LogFilter::LogFilter(const char *name, LogField * field, LogFilter::Action action, LogFilter::Operator oper)
   : m_name(ats_strdup(name)), m_field(NULL) , m_action(action), m_operator(oper), m_type(INT_FILTER), m_num_values(0)
 {
-  m_field = NEW(new LogField(*field));
-  ink_assert(m_field);
+  if (field) {
+    m_field = NEW(new LogField(*field));
+    ink_assert(m_field);
+  }
 }
 
 /*-------------------------------------------------------------------------
@@ -517,6 +520,150 @@ LogFilterInt::display_as_XML(FILE * fd)
   fprintf(fd, "</LogFilter>\n");
 }
 
+/*-------------------------------------------------------------------------
+  LogFilterSample::LogFilterSample
+  -------------------------------------------------------------------------*/
+
+const char *LogFilterSample::OPERATOR_NAME = "SAMPLE";
+const char *LogFilterSample::RANDOM_FIELD = "*";
+
+LogFilterSample::LogFilterSample(const char *name, LogField * field, LogFilter::Action action, int64_t rate)
+  : LogFilter(name, field, action, MATCH), m_rate(rate)
+{
+  m_type = SAMPLE_FILTER;
+  m_num_values = (rate > 0 ? 1 : 0);
+}
+
+LogFilterSample::LogFilterSample(const LogFilterSample & rhs)
+  : LogFilter(rhs.m_name, rhs.m_field, rhs.m_action, rhs.m_operator), m_rate(rhs.m_rate)
+{
+  m_type = SAMPLE_FILTER;
+  m_num_values = rhs.m_num_values;
+}
+
+LogFilterSample::~LogFilterSample()
+{
+}
+
+bool LogFilterSample::operator==(LogFilterSample & rhs)
+{
+  if (m_type != rhs.m_type || m_action != rhs.m_action || m_rate != rhs.m_rate) {
+    return false;
+  }
+  if (m_field == NULL || rhs.m_field == NULL) {
+    return m_field == rhs.m_field;
+  }
+  return *m_field == *rhs.m_field;
+}
+
+/*-------------------------------------------------------------------------
+  LogFilterSample::_hash_field
+
+  Hash only the meaningful bytes of the marshalled value; string padding
+  and the unused parts of an address are not always initialized.
+  -------------------------------------------------------------------------*/
+
+uint32_t
+LogFilterSample::_hash_field(LogAccess * lad)
+{
+  static const unsigned BUFSIZE = 1024;
+  char small_buf[BUFSIZE];
+  char *big_buf = NULL;
+  char *buf = small_buf;
+  size_t marsh_len = m_field->marshal_len(lad);
+
+  if (marsh_len > BUFSIZE) {
+    big_buf = (char *)ats_malloc(marsh_len);
+    buf = big_buf;
+  }
+  m_field->marshal(lad, buf);
+
+  const unsigned char *p = (const unsigned char *) buf;
+  size_t n = marsh_len;
+
+  switch (m_field->type()) {
+  case LogField::STRING:
+    n = strnlen(buf, marsh_len);
+    break;
+  case LogField::IP: {
+    LogFieldIp *ip = reinterpret_cast<LogFieldIp *>(buf);
+    if (ip->_family == AF_INET) {
+      p = (const unsigned char *) &static_cast<LogFieldIp4 *>(ip)->_addr;
+      n = sizeof(in_addr_t);
+    } else if (ip->_family == AF_INET6) {
+      p = (const unsigned char *) &static_cast<LogFieldIp6 *>(ip)->_addr;
+      n = sizeof(in6_addr);
+    } else {
+      n = 0;
+    }
+    break;
+  }
+  default:
+    break;
+  }
+
+  // FNV-1a
+  uint32_t h = 2166136261U;
+  for (size_t i = 0; i < n; ++i) {
+    h = (h ^ p[i]) * 16777619U;
+  }
+
+  ats_free(big_buf);
+  return h;
+}
+
+/*-------------------------------------------------------------------------
+  LogFilterSample::toss_this_entry
+  -------------------------------------------------------------------------*/
+
+bool LogFilterSample::toss_this_entry(LogAccess * lad)
+{
+  if (m_num_values == 0 || lad == NULL) {
+    return false;
+  }
+
+  uint64_t r;
+  if (m_field) {
+    r = _hash_field(lad);
+  } else {
+    EThread *t = this_ethread();
+    r = t ? t->generator.random() : (uint64_t) random();
+  }
+
+  bool selected = (r % (uint64_t) m_rate) == 0;
+
+  return (m_action == REJECT && selected) || (m_action == ACCEPT && !selected);
+}
+
+/*-------------------------------------------------------------------------
+  LogFilterSample::display
+  -------------------------------------------------------------------------*/
+
+void
+LogFilterSample::display(FILE * fd)
+{
+  ink_assert(fd != NULL);
+  if (m_num_values == 0) {
+    fprintf(fd, "Filter \"%s\" is inactive, no sampling rate specified\n", m_name);
+  } else {
+    fprintf(fd, "Filter \"%s\" %sS 1 in %" PRId64 " records by %s\n", m_name,
+            ACTION_NAME[m_action], m_rate, m_field ? m_field->symbol() : "random choice");
+  }
+}
+
+void
+LogFilterSample::display_as_XML(FILE * fd)
+{
+  ink_assert(fd != NULL);
+  fprintf(fd,
+          "<LogFilter>\n"
+          "  <Name      = \"%s\"/>\n"
+          "  <Action    = \"%s\"/>\n"
+          "  <Condition = \"%s %s %" PRId64 "\"/>\n"
+          "</LogFilter>\n", m_name, ACTION_NAME[m_action],
+          m_field ? m_field->symbol() : RANDOM_FIELD, OPERATOR_NAME, m_rate);
+}
+
 bool
 filters_are_equal(LogFilter * filt1, LogFilter * filt2)
 {
@@ -529,6 +676,8 @@ filters_are_equal(LogFilter * filt1, LogFilter * filt2)
       ret = (*((LogFilterInt *) filt1) == *((LogFilterInt *) filt2));
     } else if (filt1->type() == LogFilter::STRING_FILTER) {
       ret = (*((LogFilterString *) filt1) == *((LogFilterString *) filt2));
+    } else if (filt1->type() == LogFilter::SAMPLE_FILTER) {
+      ret = (*((LogFilterSample *) filt1) == *((LogFilterSample *) filt2));
     } else {
       ink_assert(!"invalid filter type");
     }
@@ -609,6 +758,9 @@ LogFilterList::add(LogFilter * filter, bool copy)
     if (filter->type() == LogFilter::INT_FILTER) {
       LogFilterInt *f = NEW(new LogFilterInt(*((LogFilterInt *) filter)));
       m_filter_list.enqueue(f);
+    } else if (filter->type() == LogFilter::SAMPLE_FILTER) {
+      LogFilterSample *f = NEW(new LogFilterSample(*((LogFilterSample *) filter)));
+      m_filter_list.enqueue(f);
     } else {
       LogFilterString *f = NEW(new LogFilterString(*((LogFilterString *) filter)));
       m_filter_list.enqueue(f);
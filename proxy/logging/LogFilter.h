@@ -45,6 +45,7 @@ public:
   {
     INT_FILTER = 0,
     STRING_FILTER,
+    SAMPLE_FILTER,
     N_TYPES
   };
 
@@ -185,6 +186,40 @@ private:
   LogFilterInt & operator=(LogFilterInt & rhs);
 };
 
+/*-------------------------------------------------------------------------
+  LogFilterSample
+
+  Filter that selects one in every N entries. With a field, the choice is
+  made from a hash of the field value, so that every entry sharing that
+  value (e.g., all requests from one client) is either selected or not;
+  without a field, entries are selected at random. The selected entries
+  are those the action applies to, so ACCEPT keeps only the sample.
+  -------------------------------------------------------------------------*/
+class LogFilterSample:public LogFilter
+{
+public:
+  LogFilterSample(const char *name, LogField * field, Action a, int64_t rate);
+  LogFilterSample(const LogFilterSample & rhs);
+  ~LogFilterSample();
+  bool operator==(LogFilterSample & rhs);
+
+  bool toss_this_entry(LogAccess * lad);
+  void display(FILE * fd = stdout);
+  void display_as_XML(FILE * fd = stdout);
+
+  static const char *OPERATOR_NAME;     // "SAMPLE", used in place of an Operator
+  static const char *RANDOM_FIELD;      // "*", sample without a field
+
+private:
+  int64_t m_rate;               // select one in m_rate entries
+
+  uint32_t _hash_field(LogAccess * lad);
+
+  // -- member functions that are not allowed --
+  LogFilterSample();
+  LogFilterSample & operator=(LogFilterSample & rhs);
+};
+
 bool filters_are_equal(LogFilter * filt1, LogFilter * filt2);
 
 
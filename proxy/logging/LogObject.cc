@@ -39,6 +39,14 @@
 #include "Log.h"
 #include "LogObject.h"
 
+void
+LogBufferManager::add_to_flush_queue(LogBuffer *buffer) {
+  write_list.push(buffer);
+  ink_atomic_increment(&_num_flush_buffers, 1);
+  RecIncrRawStatSum(log_rsb, this_thread()->mutex->thread_holding,
+                    log_stat_preproc_queue_depth_stat, 1);
+}
+
 size_t
 LogBufferManager::preproc_buffers(LogBufferSink *sink) {
   SList(LogBuffer, write_link) q(write_list.popall()), new_q;
@@ -48,12 +56,14 @@ LogBufferManager::preproc_buffers(LogBufferSink *sink) {
       // Still has outstanding references.
       write_list.push(b);
     } else if (_num_flush_buffers > FLUSH_ARRAY_SIZE) {
-      delete b;
       ink_atomic_increment(&_num_flush_buffers, -1);
       Warning("Dropping log buffer, can't keep up.");
       RecIncrRawStat(log_rsb, this_thread()->mutex->thread_holding,
                      log_stat_bytes_lost_before_preproc_stat,
                      b->header()->byte_count);
+      RecIncrRawStatSum(log_rsb, this_thread()->mutex->thread_holding,
+                        log_stat_preproc_queue_depth_stat, -1);
+      delete b;
     } else {
       new_q.push(b);
     }
@@ -66,6 +76,10 @@ LogBufferManager::preproc_buffers(LogBufferSink *sink) {
     ink_atomic_increment(&_num_flush_buffers, -1);
     prepared++;
   }
+  if (prepared) {
+    RecIncrRawStatSum(log_rsb, this_thread()->mutex->thread_holding,
+                      log_stat_preproc_queue_depth_stat, -prepared);
+  }
 
   Debug("log-logbuffer", "prepared %d buffers", prepared);
   return prepared;
@@ -91,6 +105,8 @@ LogObject::LogObject(LogFormat *format, const char *log_dir,
       m_rolling_size_mb (rolling_size_mb),
       m_last_roll_time(0),
       m_ref_count (0),
+      m_thread_buffers(NULL),
+      m_n_thread_buffers(0),
       m_buffer_manager_idx(0)
 {
     ink_assert (format != NULL);
@@ -126,6 +142,7 @@ LogObject::LogObject(LogFormat *format, const char *log_dir,
     LogBuffer *b = NEW (new LogBuffer (this, Log::config->log_buffer_size));
     ink_assert(b);
     SET_FREELIST_POINTER_VERSION(m_log_buffer, b, 0);
+    _setup_thread_buffers();
 
     _setup_rolling(rolling_enabled, rolling_interval_sec, rolling_offset_hr, rolling_size_mb);
 
@@ -142,7 +159,10 @@ LogObject::LogObject(LogObject& rhs)
     m_flush_threads(rhs.m_flush_threads),
     m_rolling_interval_sec(rhs.m_rolling_interval_sec),
     m_last_roll_time(rhs.m_last_roll_time),
-    m_ref_count(0)
+    m_ref_count(0),
+    m_thread_buffers(NULL),
+    m_n_thread_buffers(0),
+    m_buffer_manager_idx(0)
 {
     m_format = new LogFormat(*(rhs.m_format));
     m_buffer_manager = new LogBufferManager[m_flush_threads];
@@ -170,6 +190,7 @@ LogObject::LogObject(LogObject& rhs)
     LogBuffer *b = NEW (new LogBuffer (this, Log::config->log_buffer_size));
     ink_assert(b);
     SET_FREELIST_POINTER_VERSION(m_log_buffer, b, 0);
+    _setup_thread_buffers();
 
     Debug("log-config", "exiting LogObject copy constructor, "
           "filename=%s this=%p", m_filename, this);
@@ -179,9 +200,14 @@ LogObject::~LogObject()
 {
   Debug("log-config", "entering LogObject destructor, this=%p", this);
 
-  while (m_ref_count > 0) {
-    Debug("log-config", "LogObject refcount = %d, waiting for zero", m_ref_count);
-  }
+  int refs;
+  do {
+    refs = m_ref_count;
+    for (int i = 0; i < m_n_thread_buffers; i++)
+      refs += m_thread_buffers[i].ref_count;
+    if (refs > 0)
+      Debug("log-config", "LogObject refcount = %d, waiting for zero", refs);
+  } while (refs > 0);
 
   preproc_buffers();
 
@@ -198,6 +224,9 @@ LogObject::~LogObject()
   delete m_format;
   delete[] m_buffer_manager;
   delete (LogBuffer*)FREELIST_POINTER(m_log_buffer);
+  for (int i = 0; i < m_n_thread_buffers; i++)
+    delete (LogBuffer*)FREELIST_POINTER(m_thread_buffers[i].buffer);
+  ats_memalign_free(m_thread_buffers);
 }
 
 //-----------------------------------------------------------------------------
@@ -358,10 +387,15 @@ uint64_t LogObject::compute_signature(LogFormat * format, char *filename, unsign
 void
 LogObject::display(FILE * fd)
 {
+  int pending = 0;
+  for (int i = 0; i < m_flush_threads; i++) {
+    pending += m_buffer_manager[i].get_num_flush_buffers();
+  }
+
   fprintf(fd, "++++++++++++++++++++++++++++++++++++++++++++++++++++++++\n");
   fprintf(fd, "LogObject [%p]: format = %s (%p)\nbasename = %s\n" "flags = %u\n"
-          "signature = %" PRIu64 "\n",
-          this, m_format->name(), m_format, m_basename, m_flags, m_signature);
+          "signature = %" PRIu64 "\n" "buffers waiting for preproc = %d\n",
+          this, m_format->name(), m_format, m_basename, m_flags, m_signature, pending);
   if (is_collation_client()) {
     m_host_list.display(fd);
   } else {
@@ -401,8 +435,41 @@ LogObject::displayAsXML(FILE * fd, bool extended)
 }
 
 
+void
+LogObject::_setup_thread_buffers()
+{
+  if (!Log::config->per_thread_buffers || eventProcessor.n_threads_for_type[ET_CALL] <= 0)
+    return;
+  m_n_thread_buffers = eventProcessor.n_threads_for_type[ET_CALL];
+  m_thread_buffers = (LogThreadBuffer *)ats_memalign(sizeof(LogThreadBuffer), m_n_thread_buffers * sizeof(LogThreadBuffer));
+  memset(m_thread_buffers, 0, m_n_thread_buffers * sizeof(LogThreadBuffer));
+}
+
+
+// The calling net thread's own buffer, or NULL for threads which share
+// m_log_buffer.
+LogThreadBuffer *
+LogObject::_thread_buffer()
+{
+  EThread *t = this_ethread();
+  if (m_thread_buffers && t && t->tt == REGULAR && t->id < m_n_thread_buffers)
+    return &m_thread_buffers[t->id];
+  return NULL;
+}
+
+
+void
+LogObject::force_new_buffer()
+{
+  _checkout_write(&m_log_buffer, NULL, 0);
+  for (int i = 0; i < m_n_thread_buffers; i++)
+    if (FREELIST_POINTER(m_thread_buffers[i].buffer))
+      _checkout_write(&m_thread_buffers[i].buffer, NULL, 0);
+}
+
+
 LogBuffer *
-LogObject::_checkout_write(size_t * write_offset, size_t bytes_needed) {
+LogObject::_checkout_write(volatile head_p * slot, size_t * write_offset, size_t bytes_needed) {
   LogBuffer::LB_ResultCode result_code;
   LogBuffer *buffer;
   LogBuffer *new_buffer;
@@ -414,13 +481,13 @@ LogObject::_checkout_write(size_t * write_offset, size_t bytes_needed) {
     head_p h;
     int result = 0;
     do {
-      INK_QUEUE_LD(h, m_log_buffer);
+      INK_QUEUE_LD(h, *slot);
       head_p new_h;
       SET_FREELIST_POINTER_VERSION(new_h, FREELIST_POINTER(h), FREELIST_VERSION(h) + 1);
 #if TS_HAS_128BIT_CAS
-       result = ink_atomic_cas((__int128_t*) &m_log_buffer.data, h.data, new_h.data);
+       result = ink_atomic_cas((__int128_t*) &slot->data, h.data, new_h.data);
 #else
-       result = ink_atomic_cas((int64_t *) &m_log_buffer.data, h.data, new_h.data);
+       result = ink_atomic_cas((int64_t *) &slot->data, h.data, new_h.data);
 #endif
     } while (!result);
     buffer = (LogBuffer*)FREELIST_POINTER(h);
@@ -443,7 +510,7 @@ LogObject::_checkout_write(size_t * write_offset, size_t bytes_needed) {
       INK_WRITE_MEMORY_BARRIER;
       head_p old_h;
       do {
-        INK_QUEUE_LD(old_h, m_log_buffer);
+        INK_QUEUE_LD(old_h, *slot);
         if (FREELIST_POINTER(old_h) != FREELIST_POINTER(h)) {
           ink_atomic_increment(&buffer->m_references, -1);
 
@@ -455,9 +522,9 @@ LogObject::_checkout_write(size_t * write_offset, size_t bytes_needed) {
         head_p tmp_h;
         SET_FREELIST_POINTER_VERSION(tmp_h, new_buffer, 0);
 #if TS_HAS_128BIT_CAS
-       result = ink_atomic_cas((__int128_t*) &m_log_buffer.data, old_h.data, tmp_h.data);
+       result = ink_atomic_cas((__int128_t*) &slot->data, old_h.data, tmp_h.data);
 #else
-       result = ink_atomic_cas((int64_t *) &m_log_buffer.data, old_h.data, tmp_h.data);
+       result = ink_atomic_cas((int64_t *) &slot->data, old_h.data, tmp_h.data);
 #endif
       } while (!result);
       if (FREELIST_POINTER(old_h) == FREELIST_POINTER(h)) {
@@ -493,15 +560,15 @@ LogObject::_checkout_write(size_t * write_offset, size_t bytes_needed) {
     if (!decremented) {
       head_p old_h;
       do {
-        INK_QUEUE_LD(old_h, m_log_buffer);
+        INK_QUEUE_LD(old_h, *slot);
         if (FREELIST_POINTER(old_h) != FREELIST_POINTER(h))
           break;
         head_p tmp_h;
         SET_FREELIST_POINTER_VERSION(tmp_h, FREELIST_POINTER(h), FREELIST_VERSION(old_h) - 1);
 #if TS_HAS_128BIT_CAS
-       result = ink_atomic_cas((__int128_t*) &m_log_buffer.data, old_h.data, tmp_h.data);
+       result = ink_atomic_cas((__int128_t*) &slot->data, old_h.data, tmp_h.data);
 #else
-       result = ink_atomic_cas((int64_t *) &m_log_buffer.data, old_h.data, tmp_h.data);
+       result = ink_atomic_cas((int64_t *) &slot->data, old_h.data, tmp_h.data);
 #endif
       } while (!result);
       if (FREELIST_POINTER(old_h) != FREELIST_POINTER(h))
@@ -537,7 +604,8 @@ LogObject::log(LogAccess * lad, char *text_entry)
     return Log::FAIL;
   }
 
-  RefCounter counter(&m_ref_count);     // scope exit will decrement
+  LogThreadBuffer *tb = _thread_buffer();
+  RefCounter counter(tb ? &tb->ref_count : &m_ref_count);     // scope exit will decrement
 
   if (lad && m_filter_list.toss_this_entry(lad)) {
     Debug("log", "entry filtered, skipping ...");
@@ -589,7 +657,17 @@ LogObject::log(LogAccess * lad, char *text_entry)
   }
 
   // Now try to place this entry in the current LogBuffer.
-  buffer = _checkout_write(&offset, bytes_needed);
+  volatile head_p *slot = &m_log_buffer;
+  if (tb) {
+    if (!FREELIST_POINTER(tb->buffer)) {
+      // only this thread installs the first buffer of its slot
+      head_p h;
+      SET_FREELIST_POINTER_VERSION(h, NEW(new LogBuffer(this, Log::config->log_buffer_size)), 0);
+      tb->buffer.data = h.data;
+    }
+    slot = &tb->buffer;
+  }
+  buffer = _checkout_write(slot, &offset, bytes_needed);
 
   if (!buffer) {
     Note("Skipping the current log entry for %s because its size (%zu) exceeds "
@@ -781,7 +859,12 @@ LogObject::check_buffer_expiration(long time_now)
 {
   LogBuffer *b = (LogBuffer*)FREELIST_POINTER(m_log_buffer);
   if (b && time_now > b->expiration_time()) {
-    force_new_buffer();
+    _checkout_write(&m_log_buffer, NULL, 0);
+  }
+  for (int i = 0; i < m_n_thread_buffers; i++) {
+    b = (LogBuffer*)FREELIST_POINTER(m_thread_buffers[i].buffer);
+    if (b && time_now > b->expiration_time())
+      _checkout_write(&m_thread_buffers[i].buffer, NULL, 0);
   }
 }
 
@@ -806,8 +889,8 @@ TextLogObject::TextLogObject(const char *name, const char *log_dir,
                              bool timestamps, const char *header,
                              int rolling_enabled, int flush_threads,
                              int rolling_interval_sec, int rolling_offset_hr,
-                             int rolling_size_mb)
-  : LogObject(NEW(new LogFormat(TEXT_LOG)), log_dir, name, ASCII_LOG, header,
+                             int rolling_size_mb, LogFileFormat file_format)
+  : LogObject(NEW(new LogFormat(TEXT_LOG)), log_dir, name, file_format, header,
               rolling_enabled, flush_threads, rolling_interval_sec,
               rolling_offset_hr, rolling_size_mb), m_timestamps(timestamps)
 {
@@ -883,6 +966,207 @@ TextLogObject::va_write(const char *format, va_list ap)
 }
 
 
+/*-------------------------------------------------------------------------
+  LogAggregateObject::LogAggregateObject
+  -------------------------------------------------------------------------*/
+LogAggregateObject::LogAggregateObject(const char *name, const char *log_dir, LogField * key_field,
+                                       LogField * bytes_field, LogField * latency_field,
+                                       int interval_sec, int max_keys, const char *header,
+                                       int rolling_enabled, int flush_threads,
+                                       int rolling_interval_sec, int rolling_offset_hr,
+                                       int rolling_size_mb)
+  : LogObject(NEW(new LogFormat(TEXT_LOG)), log_dir, name, ASCII_LOG, header,
+              rolling_enabled, flush_threads, rolling_interval_sec,
+              rolling_offset_hr, rolling_size_mb),
+    m_bytes_field(NULL), m_latency_field(NULL),
+    m_interval_sec(interval_sec > 0 ? interval_sec : 60), m_max_keys(max_keys),
+    m_ref_count(0), m_n_keys(0)
+{
+  ink_assert(key_field != NULL);
+  m_key_field = NEW(new LogField(*key_field));
+  if (bytes_field) {
+    ink_assert(bytes_field->type() == LogField::sINT);
+    m_bytes_field = NEW(new LogField(*bytes_field));
+  }
+  if (latency_field) {
+    ink_assert(latency_field->type() == LogField::sINT);
+    m_latency_field = NEW(new LogField(*latency_field));
+  }
+
+  long time_now = LogUtils::timestamp();
+  m_interval_next = time_now - time_now % m_interval_sec + m_interval_sec;
+
+  ink_mutex_init(&m_mutex, "LogAggregateObject");
+  m_table = ink_hash_table_create(InkHashTableKeyType_String);
+  memset(&m_overflow, 0, sizeof(m_overflow));
+}
+
+LogAggregateObject::~LogAggregateObject()
+{
+  while (m_ref_count > 0) {
+    Debug("log-config", "LogAggregateObject refcount = %d, waiting for zero", m_ref_count);
+  }
+
+  // write out the partial interval so that it makes it into the file
+  _emit(LogUtils::timestamp(), true);
+  force_new_buffer();
+
+  ink_hash_table_destroy_and_free_values(m_table);
+  ink_mutex_destroy(&m_mutex);
+  delete m_key_field;
+  delete m_bytes_field;
+  delete m_latency_field;
+}
+
+/*-------------------------------------------------------------------------
+  LogAggregateObject::log
+
+  Text entries (our own summary lines) go straight to the file; access
+  entries are only added to the totals for their key.
+  -------------------------------------------------------------------------*/
+int
+LogAggregateObject::log(LogAccess * lad, char *text_entry)
+{
+  if (!lad) {
+    return LogObject::log(NULL, text_entry);
+  }
+
+  RefCounter counter(&m_ref_count);     // scope exit will decrement
+
+  if (m_filter_list.toss_this_entry(lad)) {
+    Debug("log", "entry filtered, skipping ...");
+    return Log::SKIP;
+  }
+
+  // build the key from the printable form of the key field
+  static const unsigned BUFSIZE = 1024;
+  char small_buf[BUFSIZE];
+  char *big_buf = NULL;
+  char *buf = small_buf;
+  char key[256];
+  size_t marsh_len = m_key_field->marshal_len(lad);
+
+  if (marsh_len > BUFSIZE) {
+    big_buf = (char *)ats_malloc(marsh_len);
+    buf = big_buf;
+  }
+  m_key_field->marshal(lad, buf);
+  char *ptr = buf;
+  int key_len = m_key_field->unmarshal(&ptr, key, sizeof(key) - 1);
+  if (key_len <= 0) {
+    key_len = 1;
+    key[0] = '-';
+  }
+  key[key_len] = 0;
+  ats_free(big_buf);
+
+  int64_t bytes = 0, latency_ms = 0;
+  if (m_bytes_field) {
+    m_bytes_field->marshal(lad, (char *) &bytes);
+  }
+  if (m_latency_field) {
+    m_latency_field->marshal(lad, (char *) &latency_ms);
+  }
+
+  int bucket = 0;
+  while (bucket < LOG_AGGREGATE_LATENCY_BUCKETS - 1 && latency_ms >= ((int64_t) 1 << bucket)) {
+    ++bucket;
+  }
+
+  ink_mutex_acquire(&m_mutex);
+  InkHashTableValue value;
+  Counts *c;
+  if (ink_hash_table_lookup(m_table, key, &value)) {
+    c = (Counts *) value;
+  } else if (m_n_keys < m_max_keys) {
+    c = (Counts *) ats_calloc(1, sizeof(Counts));
+    ink_hash_table_insert(m_table, key, c);
+    ++m_n_keys;
+  } else {
+    c = &m_overflow;
+  }
+  c->count++;
+  c->bytes += bytes;
+  c->latency_ms += latency_ms;
+  c->latency_hist[bucket]++;
+  ink_mutex_release(&m_mutex);
+
+  long time_now = LogUtils::timestamp();
+  if (time_now >= m_interval_next) {
+    _emit(time_now, false);
+  }
+
+  return Log::AGGR;
+}
+
+void
+LogAggregateObject::check_buffer_expiration(long time_now)
+{
+  if (time_now >= m_interval_next) {
+    _emit(time_now, false);
+  }
+  LogObject::check_buffer_expiration(time_now);
+}
+
+/*-------------------------------------------------------------------------
+  LogAggregateObject::_emit
+
+  Swap in an empty table and write a line for each key of the old one.
+  The lines are written outside of the lock so that logging threads only
+  wait for the swap.
+  -------------------------------------------------------------------------*/
+void
+LogAggregateObject::_emit(long time_now, bool force)
+{
+  InkHashTable *table;
+  Counts overflow;
+
+  ink_mutex_acquire(&m_mutex);
+  if (!force && time_now < m_interval_next) {
+    ink_mutex_release(&m_mutex);
+    return;
+  }
+  table = m_table;
+  m_table = ink_hash_table_create(InkHashTableKeyType_String);
+  m_n_keys = 0;
+  overflow = m_overflow;
+  memset(&m_overflow, 0, sizeof(m_overflow));
+  m_interval_next = time_now - time_now % m_interval_sec + m_interval_sec;
+  ink_mutex_release(&m_mutex);
+
+  InkHashTableIteratorState state;
+  for (InkHashTableEntry *e = ink_hash_table_iterator_first(table, &state); e;
+       e = ink_hash_table_iterator_next(table, &state)) {
+    _write_line((const char *) ink_hash_table_entry_key(table, e), (Counts *) ink_hash_table_entry_value(table, e));
+  }
+  if (overflow.count) {
+    _write_line(LOG_AGGREGATE_OVERFLOW_KEY, &overflow);
+  }
+
+  ink_hash_table_destroy_and_free_values(table);
+}
+
+void
+LogAggregateObject::_write_line(const char *key, const Counts * c)
+{
+  static const int MAX_ENTRY = 16 * LOG_KILOBYTE;
+  char entry[MAX_ENTRY];
+  int len;
+
+  len = LogUtils::timestamp_to_str(LogUtils::timestamp(), entry, MAX_ENTRY);
+  if (len <= 0) {
+    return;
+  }
+  len += snprintf(&entry[len], MAX_ENTRY - len, " %s count=%" PRId64 " bytes=%" PRId64 " latency_avg_ms=%" PRId64
+                  " latency_hist_ms=", key, c->count, c->bytes, c->count ? c->latency_ms / c->count : 0);
+  for (int i = 0; i < LOG_AGGREGATE_LATENCY_BUCKETS && len < MAX_ENTRY; i++) {
+    len += snprintf(&entry[len], MAX_ENTRY - len, i ? ",%" PRId64 : "%" PRId64, c->latency_hist[i]);
+  }
+
+  LogObject::log(NULL, entry);
+}
+
+
 /*-------------------------------------------------------------------------
   LogObjectManager
   -------------------------------------------------------------------------*/
@@ -74,14 +74,22 @@ class LogBufferManager
   public:
     LogBufferManager() : _num_flush_buffers(0) { }
 
-    void add_to_flush_queue(LogBuffer *buffer) {
-      write_list.push(buffer);
-      ink_atomic_increment(&_num_flush_buffers, 1);
-    }
-
+    void add_to_flush_queue(LogBuffer *buffer);
     size_t preproc_buffers(LogBufferSink *sink);
+    int get_num_flush_buffers() const { return _num_flush_buffers; }
 };
 
+// A net thread's own work buffer (and reference count) for a LogObject,
+// so that threads logging to the same object do not all update the
+// same words.  Only the owning thread writes entries through it; the
+// expiration check may retire its buffer from another thread.
+//
+struct LogThreadBuffer
+{
+  volatile head_p buffer;
+  int ref_count;
+} __attribute__ ((aligned(64)));
+
 class LogObject
 {
 public:
@@ -111,7 +119,7 @@ public:
 
   void set_remote_flag() { m_flags |= REMOTE_DATA; };
 
-  int log(LogAccess * lad, char *text_entry = NULL);
+  virtual int log(LogAccess * lad, char *text_entry = NULL);
 
   int roll_files(long time_now = 0);
 
@@ -139,7 +147,7 @@ public:
     return nfb;
   }
 
-  void check_buffer_expiration(long time_now);
+  virtual void check_buffer_expiration(long time_now);
 
   void display(FILE * fd = stdout);
   void displayAsXML(FILE * fd = stdout, bool extended = false);
@@ -190,9 +198,7 @@ public:
 
   const char *get_format_string() { return (m_format ? m_format->format_string() : "<none>"); }
 
-  void force_new_buffer() {
-    _checkout_write(NULL, 0);
-  }
+  void force_new_buffer();
 
   bool operator==(LogObject & rhs);
   int do_filesystem_checks();
@@ -230,6 +236,8 @@ private:
   int m_ref_count;
 
   volatile head_p m_log_buffer;     // current work buffer
+  LogThreadBuffer *m_thread_buffers; // indexed by ET_CALL thread id
+  int m_n_thread_buffers;
   unsigned m_buffer_manager_idx;
   LogBufferManager *m_buffer_manager;
 
@@ -237,7 +245,9 @@ private:
   void _setup_rolling(int rolling_enabled, int rolling_interval_sec, int rolling_offset_hr, int rolling_size_mb);
   int _roll_files(long interval_start, long interval_end);
 
-  LogBuffer *_checkout_write(size_t * write_offset, size_t write_size);
+  void _setup_thread_buffers();
+  LogThreadBuffer *_thread_buffer();
+  LogBuffer *_checkout_write(volatile head_p * slot, size_t * write_offset, size_t write_size);
 
 private:
   // -- member functions not allowed --
@@ -257,7 +267,8 @@ public:
                            int rolling_enabled, int flush_threads,
                            int rolling_interval_sec = 0,
                            int rolling_offset_hr = 0,
-                           int rolling_size_mb = 0);
+                           int rolling_size_mb = 0,
+                           LogFileFormat file_format = ASCII_LOG);
 
   inkcoreapi int write(const char *format, ...);
   inkcoreapi int va_write(const char *format, va_list ap);
@@ -266,6 +277,65 @@ private:
     bool m_timestamps;
 };
 
+/*-------------------------------------------------------------------------
+  LogAggregateObject
+
+  Instead of writing every entry, this object rolls entries up in memory
+  by the value of a key field and, at the end of each interval, writes one
+  text line per key with the entry count, the bytes sent, the average
+  latency and a latency histogram. Histogram bucket i counts latencies
+  below 2^i ms; the last bucket counts the rest.
+  -------------------------------------------------------------------------*/
+
+#define LOG_AGGREGATE_LATENCY_BUCKETS 16
+#define LOG_AGGREGATE_OVERFLOW_KEY "-other-"
+
+class LogAggregateObject:public LogObject
+{
+public:
+  LogAggregateObject(const char *name, const char *log_dir, LogField * key_field,
+                     LogField * bytes_field, LogField * latency_field,
+                     int interval_sec, int max_keys, const char *header,
+                     int rolling_enabled, int flush_threads,
+                     int rolling_interval_sec = 0,
+                     int rolling_offset_hr = 0,
+                     int rolling_size_mb = 0);
+  ~LogAggregateObject();
+
+  int log(LogAccess * lad, char *text_entry = NULL);
+  void check_buffer_expiration(long time_now);
+
+private:
+  struct Counts
+  {
+    int64_t count;
+    int64_t bytes;
+    int64_t latency_ms;
+    int64_t latency_hist[LOG_AGGREGATE_LATENCY_BUCKETS];
+  };
+
+  LogField *m_key_field;
+  LogField *m_bytes_field;      // NULL if bytes are not summed
+  LogField *m_latency_field;    // NULL if latency is not tracked
+  int m_interval_sec;
+  int m_max_keys;
+  volatile long m_interval_next;
+  int m_ref_count;
+
+  ink_mutex m_mutex;            // protects the members below
+  InkHashTable *m_table;        // key string -> Counts
+  int m_n_keys;
+  Counts m_overflow;            // keys seen once m_max_keys is reached
+
+  void _emit(long time_now, bool force);
+  void _write_line(const char *key, const Counts * c);
+
+  // -- member functions not allowed --
+  LogAggregateObject();
+  LogAggregateObject(const LogAggregateObject &);
+  LogAggregateObject & operator=(const LogAggregateObject &);
+};
+
 /*-------------------------------------------------------------------------
   RefCounter
   -------------------------------------------------------------------------*/
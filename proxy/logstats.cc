@@ -637,12 +637,13 @@ struct CommandLineArgs
   int urls;			// Produce JSON output of URL stats, arg is LRU size
   int show_urls;		// Max URLs to show
   int as_object;		// Show the URL stats as a single JSON object (not array)
+  int threads;                  // Log buffer parsing threads
   int version;
   int help;
 
   CommandLineArgs()
     : max_origins(0), min_hits(0), max_age(0), line_len(DEFAULT_LINE_LEN), incremental(0),
-      tail(0), summary(0), json(0), cgi(0), urls(0), show_urls(0), as_object(0), version(0), help(0)
+      tail(0), summary(0), json(0), cgi(0), urls(0), show_urls(0), as_object(0), threads(0), version(0), help(0)
   {
     log_file[0] = '\0';
     origin_file[0] = '\0';
@@ -673,6 +674,7 @@ static ArgumentDescription argument_descriptions[] = {
   {"min_hits", 'm', "Minimum total hits for an Origin", "L", &cl.min_hits, NULL, NULL},
   {"max_age", 'a', "Max age for log entries to be considered", "I", &cl.max_age, NULL, NULL},
   {"line_len", 'l', "Output line length", "I", &cl.line_len, NULL, NULL},
+  {"threads", 'p', "Number of log parsing threads (default one per CPU)", "I", &cl.threads, NULL, NULL},
   {"debug_tags", 'T', "Colon-Separated Debug Tags", "S1023", &error_tags, NULL, NULL},
   {"version", 'V', "Print Version Id", "T", &cl.version, NULL, NULL},
 };
@@ -892,6 +894,62 @@ update_elapsed(ElapsedStats &stat, const int elapsed, const StatsCounter &counte
 
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Merge the stats collected by another parsing thread. The elapsed stats
+// are weighted by the counts they were calculated from, so they have to be
+// merged before the counters.
+inline void
+merge_elapsed(ElapsedStats &stat, const StatsCounter &counter, const ElapsedStats &other, const StatsCounter &other_counter)
+{
+  int64_t count = counter.count + other_counter.count;
+  float avg, sum_of_squares;
+
+  if (-1 == other.min)
+    return;
+  if ((-1 == stat.min) || (stat.min > other.min))
+    stat.min = other.min;
+  if (stat.max < other.max)
+    stat.max = other.max;
+
+  avg = (stat.avg * counter.count + other.avg * other_counter.count) / count;
+  sum_of_squares = counter.count * (stat.stddev * stat.stddev + (stat.avg - avg) * (stat.avg - avg))
+    + other_counter.count * (other.stddev * other.stddev + (other.avg - avg) * (other.avg - avg));
+
+  stat.stddev = sqrt(sum_of_squares / count);
+  stat.avg = avg;
+}
+
+inline void
+merge_stats(OriginStats * stat, const OriginStats * other)
+{
+  merge_elapsed(stat->elapsed.hits.hit, stat->results.hits.hit, other->elapsed.hits.hit, other->results.hits.hit);
+  merge_elapsed(stat->elapsed.hits.ims, stat->results.hits.ims, other->elapsed.hits.ims, other->results.hits.ims);
+  merge_elapsed(stat->elapsed.hits.refresh, stat->results.hits.refresh,
+                other->elapsed.hits.refresh, other->results.hits.refresh);
+  merge_elapsed(stat->elapsed.hits.other, stat->results.hits.other, other->elapsed.hits.other, other->results.hits.other);
+  merge_elapsed(stat->elapsed.hits.total, stat->results.hits.total, other->elapsed.hits.total, other->results.hits.total);
+  merge_elapsed(stat->elapsed.misses.miss, stat->results.misses.miss,
+                other->elapsed.misses.miss, other->results.misses.miss);
+  merge_elapsed(stat->elapsed.misses.ims, stat->results.misses.ims, other->elapsed.misses.ims, other->results.misses.ims);
+  merge_elapsed(stat->elapsed.misses.refresh, stat->results.misses.refresh,
+                other->elapsed.misses.refresh, other->results.misses.refresh);
+  merge_elapsed(stat->elapsed.misses.other, stat->results.misses.other,
+                other->elapsed.misses.other, other->results.misses.other);
+  merge_elapsed(stat->elapsed.misses.total, stat->results.misses.total,
+                other->elapsed.misses.total, other->results.misses.total);
+
+  // Everything from the results on is a StatsCounter.
+  StatsCounter *counter = (StatsCounter *) &stat->results;
+  const StatsCounter *other_counter = (const StatsCounter *) &other->results;
+
+  for (size_t i = 0; i < (sizeof(OriginStats) - offsetof(OriginStats, results)) / sizeof(StatsCounter); i++) {
+    counter[i].count += other_counter[i].count;
+    counter[i].bytes += other_counter[i].bytes;
+  }
+  stat->total.count += other->total.count;
+  stat->total.bytes += other->total.bytes;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Update the "result" and "elapsed" stats for a particular record
 inline void
@@ -1199,12 +1257,28 @@ update_schemes(OriginStats * stat, int scheme, int size)
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Parse a log buffer
-int
-parse_log_buff(LogBufferHeader * buf_header, bool summary = false)
+// The fields of the first log buffer are assumed for all of them. They are
+// parsed before any parsing threads start, which then only read them.
+static LogFieldList *fieldlist = NULL;
+
+static void
+init_fieldlist(LogBufferHeader * buf_header)
 {
-  static LogFieldList *fieldlist = NULL;
+  if (!fieldlist) {
+    fieldlist = NEW(new LogFieldList);
+    ink_assert(fieldlist != NULL);
+    bool agg = false;
+    LogFormat::parse_symbol_string(buf_header->fmt_fieldlist(), fieldlist, &agg);
+  }
+}
 
+///////////////////////////////////////////////////////////////////////////////
+// Parse a log buffer, into the given totals and origins (the globals, unless
+// this is one of several parsing threads).
+int
+parse_log_buff(LogBufferHeader * buf_header, OriginStats &totals, OriginStorage &origins, int &parse_errors,
+               bool summary = false)
+{
   LogEntryHeader *entry;
   LogBufferIterator buf_iter(buf_header);
   LogField *field;
@@ -1224,12 +1298,7 @@ parse_log_buff(LogBufferHeader * buf_header, bool summary = false)
   HTTPMethod method;
   URLScheme scheme;
 
-  if (!fieldlist) {
-    fieldlist = NEW(new LogFieldList);
-    ink_assert(fieldlist != NULL);
-    bool agg = false;
-    LogFormat::parse_symbol_string(buf_header->fmt_fieldlist(), fieldlist, &agg);
-  }
+  init_fieldlist(buf_header);
   // Loop over all entries
   while ((entry = buf_iter.next())) {
     read_from = (char *) entry + sizeof(LogEntryHeader);
@@ -1667,6 +1736,297 @@ parse_log_buff(LogBufferHeader * buf_header, bool summary = false)
 
 
 
+///////////////////////////////////////////////////////////////////////////////
+// Read and inflate a compressed frame, whose first two words are already
+// in buffer, over buffer.
+static int
+read_compressed_buffer(int in_fd, char *buffer, int buffer_len, unsigned first_read_size)
+{
+  char zbuffer[MAX_LOGBUFFER_SIZE + MAX_LOGBUFFER_SIZE / 8 + 64];
+  LogBufferFrameHeader frame;
+  unsigned second_read_size = sizeof(frame) - first_read_size;
+  int nread;
+
+  memcpy(&frame, buffer, first_read_size);
+  nread = read(in_fd, (char *)&frame + first_read_size, second_read_size);
+  if (nread != (int)second_read_size) {
+    Debug("logstats", "Read of compressed frame header failed.");
+    return 1;
+  }
+
+  if (frame.byte_count > sizeof(zbuffer)) {
+    Debug("logstats", "Compressed byte count [%u] > expected [%zu]", frame.byte_count, sizeof(zbuffer));
+    return 1;
+  }
+
+  nread = read(in_fd, zbuffer, frame.byte_count);
+  if (nread != (int)frame.byte_count) {
+    Debug("logstats", "Failed to read compressed payload [%u bytes]", frame.byte_count);
+    return 1;
+  }
+
+  if (LogBuffer::uncompress(&frame, zbuffer, buffer, buffer_len) < 0) {
+    Debug("logstats", "Failed to uncompress buffer [%u bytes]", frame.byte_count);
+    return 1;
+  }
+
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// A log buffer, or compressed frame, in a mapped log file. The buffers are
+// independent of each other, so they are handed out to several threads.
+struct LogSegment
+{
+  char *data;
+  bool compressed;
+};
+
+struct SegmentQueue
+{
+  std::vector<LogSegment> segments;
+  volatile int next;
+  unsigned max_age;
+};
+
+// One parsing thread, counting into its own totals and origins that are
+// merged into the globals once all the threads are done. A single thread
+// counts into the globals directly.
+struct ParseThread
+{
+  SegmentQueue *queue;
+  OriginStats *totals;
+  OriginStorage *origins;
+  int parse_errors;
+  bool failed;
+  OriginStats my_totals;
+  OriginStorage my_origins;
+  ink_thread tid;
+};
+
+// The uncompressed buffer of a segment, in buffer if it has to be inflated.
+static LogBufferHeader *
+segment_header(const LogSegment &segment, char *buffer)
+{
+  LogBufferFrameHeader frame;
+
+  if (!segment.compressed)
+    return (LogBufferHeader *)segment.data;
+
+  memcpy(&frame, segment.data, sizeof(frame));
+  if (LogBuffer::uncompress(&frame, segment.data + sizeof(frame), buffer, MAX_LOGBUFFER_SIZE) < 0) {
+    Debug("logstats", "Failed to uncompress buffer [%u bytes]", frame.byte_count);
+    return NULL;
+  }
+  return (LogBufferHeader *)buffer;
+}
+
+static void *
+parse_segments(void *arg)
+{
+  ParseThread *pt = (ParseThread *)arg;
+  SegmentQueue *queue = pt->queue;
+  char *buffer = (char *)ats_malloc(MAX_LOGBUFFER_SIZE);
+  int i;
+
+  while ((i = ink_atomic_increment(&queue->next, 1)) < (int)queue->segments.size()) {
+    LogBufferHeader *header = segment_header(queue->segments[i], buffer);
+
+    if (NULL == header) {
+      pt->failed = true;
+    } else if (header->high_timestamp >= queue->max_age) {
+      // Possibly skip too old entries (the entire buffer is skipped)
+      if (parse_log_buff(header, *pt->totals, *pt->origins, pt->parse_errors, cl.summary != 0) != 0) {
+        Debug("logstats", "Failed to parse log buffer.");
+        pt->failed = true;
+      }
+    } else {
+      Debug("logstats", "Skipping old buffer (age=%d, max=%d)", header->high_timestamp, queue->max_age);
+    }
+  }
+  ats_free(buffer);
+
+  return NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Process a file (FD) through a private mapping of it, parsing the log
+// buffers in parallel (the parser writes into the buffers). The FD is left
+// positioned behind the last complete buffer. Returns -1 if the file can't
+// be mapped, so it has to be read instead.
+static int
+process_mapped_file(int in_fd, off_t offset, unsigned max_age)
+{
+  struct stat stat_buf;
+  off_t start, map_offset;
+  size_t map_len;
+  char *map, *ptr, *end;
+  SegmentQueue queue;
+  int nthreads, res = 0;
+
+  if (fstat(in_fd, &stat_buf) < 0 || !S_ISREG(stat_buf.st_mode))
+    return -1;
+
+  start = (offset > 0) ? offset : lseek(in_fd, 0, SEEK_CUR);
+  if (start < 0)
+    return -1;
+  if (start >= stat_buf.st_size)
+    return (lseek(in_fd, start, SEEK_SET) < 0) ? 1 : 0;
+
+  map_offset = start & ~((off_t)getpagesize() - 1);
+  map_len = stat_buf.st_size - map_offset;
+  map = (char *)mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE, in_fd, map_offset);
+  if (MAP_FAILED == map) {
+    Debug("logstats", "Failed to map %zu bytes of the log file, reading it instead.", map_len);
+    return -1;
+  }
+  madvise(map, map_len, MADV_SEQUENTIAL);
+
+  Debug("logstats", "Processing mapped file [offset=%" PRId64 ", size=%" PRId64 "].", (int64_t)start,
+        (int64_t)stat_buf.st_size);
+  ptr = map + (start - map_offset);
+  end = map + map_len;
+
+  // Find the next log header, aligning us properly.
+  if (offset > 0) {
+    Debug("logstats", "Re-aligning file read.");
+    while (ptr + sizeof(uint32_t) <= end) {
+      uint32_t cookie;
+
+      memcpy(&cookie, ptr, sizeof(cookie));
+      if (LOG_SEGMENT_COOKIE == cookie || LOG_SEGMENT_COMPRESSED_COOKIE == cookie)
+        break;
+      ptr++;
+    }
+  }
+
+  // Collect the buffers, stopping at one still being written.
+  while (ptr + sizeof(LogBufferFrameHeader) <= end) {
+    LogBufferFrameHeader frame;        // The first two words line up with LogBufferHeader
+    LogSegment segment;
+    int64_t len;
+
+    memcpy(&frame, ptr, sizeof(frame));
+    if (!frame.cookie)
+      break;
+    if (frame.cookie != LOG_SEGMENT_COOKIE && frame.cookie != LOG_SEGMENT_COMPRESSED_COOKIE) {
+      Debug("logstats", "Invalid segment cookie (expected %d, got %d)", LOG_SEGMENT_COOKIE, frame.cookie);
+      res = 1;
+      break;
+    }
+    Debug("logstats", "LogBuffer version %d, current = %d", frame.version, LOG_SEGMENT_VERSION);
+    if (frame.version != LOG_SEGMENT_VERSION) {
+      res = 1;
+      break;
+    }
+
+    if (LOG_SEGMENT_COMPRESSED_COOKIE == frame.cookie) {
+      if (frame.raw_byte_count > MAX_LOGBUFFER_SIZE) {
+        Debug("logstats", "Uncompressed byte count [%u] > expected [%d]", frame.raw_byte_count, MAX_LOGBUFFER_SIZE);
+        res = 1;
+        break;
+      }
+      len = sizeof(frame) + frame.byte_count;
+    } else {
+      LogBufferHeader header;
+
+      if (ptr + sizeof(header) > end)
+        break;
+      memcpy(&header, ptr, sizeof(header));
+      if (header.byte_count > MAX_LOGBUFFER_SIZE || header.byte_count <= sizeof(LogBufferHeader)) {
+        Debug("logstats", "Header byte count [%d] is wrong.", header.byte_count);
+        res = 1;
+        break;
+      }
+      len = header.byte_count;
+    }
+
+    if (ptr + len > end) {
+      Debug("logstats", "Incomplete buffer at offset %" PRId64 ".", (int64_t)(ptr - map + map_offset));
+      break;
+    }
+    segment.data = ptr;
+    segment.compressed = (LOG_SEGMENT_COMPRESSED_COOKIE == frame.cookie);
+    queue.segments.push_back(segment);
+    ptr += len;
+  }
+
+  // The URL LRU depends on the order of the entries, so it takes one thread.
+  nthreads = cl.threads > 0 ? cl.threads : ink_number_of_processors();
+  if (urls || nthreads < 1)
+    nthreads = 1;
+  if (nthreads > (int)queue.segments.size())
+    nthreads = queue.segments.size();
+  Debug("logstats", "Parsing %zu buffers with %d threads.", queue.segments.size(), nthreads);
+
+  if (nthreads > 0) {
+    ParseThread *threads = NEW(new ParseThread[nthreads]);
+    char *buffer = (char *)ats_malloc(MAX_LOGBUFFER_SIZE);
+    LogBufferHeader *header = segment_header(queue.segments[0], buffer);
+
+    if (header)
+      init_fieldlist(header);
+    ats_free(buffer);
+
+    queue.next = 0;
+    queue.max_age = max_age;
+    for (int i = 0; i < nthreads; i++) {
+      ParseThread *pt = &threads[i];
+
+      pt->queue = &queue;
+      pt->parse_errors = 0;
+      pt->failed = false;
+      if (1 == nthreads) {
+        pt->totals = &totals;
+        pt->origins = &origins;
+      } else {
+        memset(&pt->my_totals, 0, sizeof(pt->my_totals));
+        init_elapsed(&pt->my_totals);
+        pt->totals = &pt->my_totals;
+        pt->origins = &pt->my_origins;
+      }
+    }
+
+    if (1 == nthreads) {
+      parse_segments(&threads[0]);
+    } else {
+      for (int i = 0; i < nthreads; i++)
+        threads[i].tid = ink_thread_create(parse_segments, &threads[i]);
+      for (int i = 0; i < nthreads; i++)
+        ink_thread_join(threads[i].tid);
+    }
+
+    for (int i = 0; i < nthreads; i++) {
+      ParseThread *pt = &threads[i];
+
+      if (pt->totals != &totals) {
+        merge_stats(&totals, &pt->my_totals);
+        for (OriginStorage::iterator o = pt->my_origins.begin(); o != pt->my_origins.end(); ++o) {
+          OriginStorage::iterator o_iter = origins.find(o->first);
+
+          if (origins.end() == o_iter) {
+            origins[o->first] = o->second;
+          } else {
+            merge_stats(o_iter->second, o->second);
+            ats_free(const_cast<char *>(o->second->server));
+            ats_free(o->second);
+          }
+        }
+      }
+      parse_errors += pt->parse_errors;
+      if (pt->failed)
+        res = 1;
+    }
+    delete[] threads;
+  }
+
+  if (lseek(in_fd, ptr - map + map_offset, SEEK_SET) < 0)
+    res = 1;
+  munmap(map, map_len);
+
+  return res;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Process a file (FD)
 int
@@ -1674,6 +2034,10 @@ process_file(int in_fd, off_t offset, unsigned max_age)
 {
   char buffer[MAX_LOGBUFFER_SIZE];
   int nread, buffer_bytes;
+  int res = process_mapped_file(in_fd, offset, max_age);
+
+  if (res >= 0)
+    return res;
 
   Debug("logstats", "Processing file [offset=%" PRId64 "].", (int64_t)offset);
   while (true) {
@@ -1701,7 +2065,7 @@ process_file(int in_fd, off_t offset, unsigned max_age)
           return 0;
         }
         // ensure that this is a valid logbuffer header
-        if (header->cookie && (LOG_SEGMENT_COOKIE == header->cookie)) {
+        if (header->cookie && (LOG_SEGMENT_COOKIE == header->cookie || LOG_SEGMENT_COMPRESSED_COOKIE == header->cookie)) {
           offset = 0;
           break;
         }
@@ -1716,7 +2080,7 @@ process_file(int in_fd, off_t offset, unsigned max_age)
         return 0;
 
       // ensure that this is a valid logbuffer header
-      if (header->cookie != LOG_SEGMENT_COOKIE) {
+      if (header->cookie != LOG_SEGMENT_COOKIE && header->cookie != LOG_SEGMENT_COMPRESSED_COOKIE) {
         Debug("logstats", "Invalid segment cookie (expected %d, got %d)", LOG_SEGMENT_COOKIE, header->cookie);
         return 1;
       }
@@ -1726,35 +2090,40 @@ process_file(int in_fd, off_t offset, unsigned max_age)
     if (header->version != LOG_SEGMENT_VERSION)
       return 1;
 
-    // read the rest of the header
-    unsigned second_read_size = sizeof(LogBufferHeader) - first_read_size;
-    nread = read(in_fd, &buffer[first_read_size], second_read_size);
-    if (!nread || EOF == nread) {
-      Debug("logstats", "Second read of header failed (attemped %d bytes at offset %d, got nothing).", second_read_size, first_read_size);
-      return 1;
-    }
+    if (LOG_SEGMENT_COMPRESSED_COOKIE == header->cookie) {
+      if (read_compressed_buffer(in_fd, buffer, sizeof(buffer), first_read_size) != 0)
+        return 1;
+    } else {
+      // read the rest of the header
+      unsigned second_read_size = sizeof(LogBufferHeader) - first_read_size;
+      nread = read(in_fd, &buffer[first_read_size], second_read_size);
+      if (!nread || EOF == nread) {
+        Debug("logstats", "Second read of header failed (attemped %d bytes at offset %d, got nothing).", second_read_size, first_read_size);
+        return 1;
+      }
 
-    // read the rest of the buffer
-    if (header->byte_count > sizeof(buffer)) {
-      Debug("logstats", "Header byte count [%d] > expected [%zu]", header->byte_count, sizeof(buffer));
-      return 1;
-    }
+      // read the rest of the buffer
+      if (header->byte_count > sizeof(buffer)) {
+        Debug("logstats", "Header byte count [%d] > expected [%zu]", header->byte_count, sizeof(buffer));
+        return 1;
+      }
 
-    buffer_bytes = header->byte_count - sizeof(LogBufferHeader);
-    if (buffer_bytes <= 0 || (unsigned int) buffer_bytes > (sizeof(buffer) - sizeof(LogBufferHeader))) {
-      Debug("logstats", "Buffer payload [%d] is wrong.", buffer_bytes);
-      return 1;
-    }
+      buffer_bytes = header->byte_count - sizeof(LogBufferHeader);
+      if (buffer_bytes <= 0 || (unsigned int) buffer_bytes > (sizeof(buffer) - sizeof(LogBufferHeader))) {
+        Debug("logstats", "Buffer payload [%d] is wrong.", buffer_bytes);
+        return 1;
+      }
 
-    nread = read(in_fd, &buffer[sizeof(LogBufferHeader)], buffer_bytes);
-    if (!nread || EOF == nread) {
-      Debug("logstats", "Failed to read buffer payload [%d bytes]", buffer_bytes);
-      return 1;
+      nread = read(in_fd, &buffer[sizeof(LogBufferHeader)], buffer_bytes);
+      if (!nread || EOF == nread) {
+        Debug("logstats", "Failed to read buffer payload [%d bytes]", buffer_bytes);
+        return 1;
+      }
     }
 
     // Possibly skip too old entries (the entire buffer is skipped)
     if (header->high_timestamp >= max_age) {
-      if (parse_log_buff(header, cl.summary != 0) != 0) {
+      if (parse_log_buff(header, totals, origins, parse_errors, cl.summary != 0) != 0) {
         Debug("logstats", "Failed to parse log buffer.");
         return 1;
       }
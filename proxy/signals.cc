@@ -134,6 +134,22 @@ public:
   }
 };
 
+class ReclaimContinuation:public Continuation
+{
+public:
+  ReclaimContinuation()
+    : Continuation(new_ProxyMutex())
+  {
+    SET_HANDLER(&ReclaimContinuation::periodic);
+  }
+
+  int periodic(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
+  {
+    ink_freelists_reclaim();
+    return EVENT_CONT;
+  }
+};
+
 
 static void
 interrupt_handler(int sig)
@@ -389,6 +405,27 @@ init_tracker(const char *config_var, RecDataT /* type ATS_UNUSED */, RecData dat
   return 1;
 }
 
+static int
+init_reclaim(const char *config_var, RecDataT /* type ATS_UNUSED */, RecData data, void * /* cookie ATS_UNUSED */)
+{
+  static Event *reclaim_event = NULL;
+  int reclaim_interval = 0;
+
+  if (config_var)
+    reclaim_interval = data.rec_int;
+  else
+    reclaim_interval = REC_ConfigReadInteger("proxy.config.allocator.reclaim_interval");
+  Debug("tracker", "init_reclaim called [%d]\n", reclaim_interval);
+  if (reclaim_event)
+    reclaim_event->cancel();
+  reclaim_event = NULL;
+  if (reclaim_interval > 0) {
+    reclaim_event = eventProcessor.schedule_every(new ReclaimContinuation,
+                                                  HRTIME_SECONDS(reclaim_interval), ET_CALL);
+  }
+  return 1;
+}
+
 void
 init_signals2()
 {
@@ -397,6 +434,8 @@ init_signals2()
   RecData data;
   data.rec_int = 0; // Shouldn't be used now anyways
   init_tracker(NULL, RECD_INT, data, NULL);
+  REC_RegisterConfigUpdateFunc("proxy.config.allocator.reclaim_interval", init_reclaim, NULL);
+  init_reclaim(NULL, RECD_INT, data, NULL);
 }
 
 
@@ -44,6 +44,7 @@
 #include <math.h>
 #include <limits.h>
 #include <sys/mman.h>
+#include <sys/wait.h>
 
 #ifndef __STDC_FORMAT_MACROS
 #define __STDC_FORMAT_MACROS 1
@@ -246,6 +247,66 @@ static int no_cache = 0;
 static double evo_rate = 0.0;
 static double zipf = 0.0;
 static int zipf_bucket_size = 1;
+static int workers = 1;
+static char report_to[81] = "";
+static int collect_port = 0;
+static int collect_only = 0;
+static int report_fd = -1;
+static int collect_fd = -1;
+static pid_t report_parent = 0;
+static int finishing = 0;
+static int worker_index = 0, worker_count = 1;
+static char replay_file[256] = "";
+static double replay_speed = 1.0;
+static int replay_done = 0;
+static int64_t replay_late = 0;
+
+// Response latency in msec, exact below 32 and in 16 steps for each
+// power of 2 above that, so percentiles are within about 6%.
+#define LAT_LINEAR   32
+#define LAT_BUCKETS  (LAT_LINEAR + 16 * 16)     // up to 2^21 msec
+
+struct LatencyHistogram {
+  uint64_t count[LAT_BUCKETS];
+
+  static int bucket(int ms) {
+    if (ms < LAT_LINEAR)
+      return ms < 0 ? 0 : ms;
+    int e = 31 - __builtin_clz(ms);
+    if (e > 20)
+      return LAT_BUCKETS - 1;
+    return LAT_LINEAR + (e - 5) * 16 + ((ms >> (e - 4)) & 15);
+  }
+  static int value(int b) {
+    if (b < LAT_LINEAR)
+      return b;
+    b -= LAT_LINEAR;
+    return (16 + (b & 15)) << (b / 16 + 1);
+  }
+  void add(int ms) { count[bucket(ms)]++; }
+  void add(LatencyHistogram & h) {
+    for (int i = 0; i < LAT_BUCKETS; i++)
+      count[i] += h.count[i];
+  }
+  void clear() { memset(count, 0, sizeof(count)); }
+  uint64_t total() {
+    uint64_t n = 0;
+    for (int i = 0; i < LAT_BUCKETS; i++)
+      n += count[i];
+    return n;
+  }
+  int percentile(double q) {
+    uint64_t n = total(), want = (uint64_t)ceil(q * n), seen = 0;
+    if (!n)
+      return 0;
+    for (int i = 0; i < LAT_BUCKETS; i++)
+      if ((seen += count[i]) >= want)
+        return value(i);
+    return value(LAT_BUCKETS - 1);
+  }
+};
+
+static LatencyHistogram interval_lat, total_lat;
 
 static const ArgumentDescription argument_descriptions[] = {
   {"proxy_port",'p',"Proxy Port","I",&proxy_port,"JTEST_PROXY_PORT",NULL},
@@ -358,6 +419,18 @@ static const ArgumentDescription argument_descriptions[] = {
    &zipf,"JTEST_ZIPF",NULL},
   {"evo_rate",'9',"Evolving Hotset Rate (evolutions/hour)","D",
    &evo_rate,"JTEST_EVOLVING_HOTSET_RATE",NULL},
+  {"replay",' ',"Replay Squid Format Access Log","S256",replay_file,
+   "JTEST_REPLAY",NULL},
+  {"replay_speed",' ',"Replay Speed (2.0:twice as fast)","D",&replay_speed,
+   "JTEST_REPLAY_SPEED",NULL},
+  {"workers",' ',"Worker Processes (0:one per CPU)","I",&workers,
+   "JTEST_WORKERS",NULL},
+  {"report_to",' ',"Send Reports to Collector (host:port)","S80",
+   &report_to,"JTEST_REPORT_TO",NULL},
+  {"collect_port",' ',"Collect Reports from Other Hosts on Port","I",
+   &collect_port,"JTEST_COLLECT_PORT",NULL},
+  {"collect_only",' ',"Only Collect Reports","F",&collect_only,
+   "JTEST_COLLECT_ONLY",NULL},
   {"debug",'d',"Debug Flag","F",&debug,"JTEST_DEBUG",NULL},
   {"help",'h',"Help",NULL,NULL,NULL,jtest_usage}
 };
@@ -393,6 +466,7 @@ struct FD {
   unsigned int drop_after_CL:1;
   unsigned int client_abort:1;
   unsigned int jg_compressed:1;
+  unsigned int no_cache:1;
   int * count;
   int bytes;
   int ftp_data_fd;
@@ -424,6 +498,7 @@ struct FD {
     drop_after_CL = ::drop_after_CL;
     client_abort = 0;
     jg_compressed = 0;
+    no_cache = 0;
     ftp_mode = FTP_NULL;
     ftp_peer_addr = 0;
     ftp_peer_port = 0;
@@ -710,7 +785,7 @@ static int send_response (int sock)
           content_type,
           fd[sock].keepalive>0?"Connection: Keep-Alive\r\n":"",
           fd[sock].response_length,
-          no_cache?"Pragma: no-cache\r\nCache-Control: no-cache\r\n":"",
+          (no_cache || fd[sock].no_cache)?"Pragma: no-cache\r\nCache-Control: no-cache\r\n":"",
           url_start ? url_start : "");
     } else
       url_len = print_len =
@@ -945,6 +1020,12 @@ static int read_request(int sock) {
             }
             if (verbose)
               printf("read_request %d got request %d\n", sock, length);
+            {
+              // replayed requests for objects which were not cached
+              char * eol = strchr(buffer, '\n');
+              char * nc = strstr(buffer, "?nc");
+              fd[sock].no_cache = nc && nc < eol;
+            }
             char * ims = strncasestr(buffer,"If-Modified-Since:", i);
             if (drand48() > ims_rate) ims = NULL;
             fd[sock].ims = ims?1:0;
@@ -1345,6 +1426,8 @@ static int accept_sock(int sock) {
 
 static int accept_compd (int sock) {
   int new_fd = accept_sock(sock);
+  if (!new_fd)                  // another worker took it
+    return 0;
   servers++;
   new_servers++;
   poll_init_set(new_fd, NULL, read_compd_request);
@@ -1358,6 +1441,8 @@ static int accept_compd (int sock) {
 
 static int accept_read (int sock) {
   int new_fd = accept_sock(sock);
+  if (!new_fd)                  // another worker took it
+    return 0;
   servers++;
   new_servers++;
   if (ftp) {
@@ -1620,14 +1705,22 @@ static int throttling_connections() {
   return client_rate && keepalive_cons && current_clients >= keepalive_cons;
 }
 
+static void send_report(int final);
+
 static void done() {
-  interval_report();
+  if (report_fd >= 0)
+    send_report(1);
+  else {
+    finishing = 1;
+    interval_report();
+  }
   exit(0);
 }
 
 static int is_done() {
   return
     (urls_mode && !current_clients && !n_defered_urls) ||
+    (*replay_file && replay_done && !current_clients) ||
     (bandwidth_test && bandwidth_test_to_go <= 0 && !current_clients);
 }
 
@@ -2062,7 +2155,9 @@ static int read_response(int sock) {
       fd[sock].close();
       return 0;
     }
-    if (fd[sock].req_header[9] != '2') {
+    // a replayed If-Modified-Since may be answered without a body
+    int not_modified = fd[sock].ims && !strncmp(fd[sock].req_header + 9, "304", 3);
+    if (fd[sock].req_header[9] != '2' && !not_modified) {
       if (verbose_errors) {
         char * e = (char*)memchr(fd[sock].req_header, '\r', hlen);
         if (e) *e = 0;
@@ -2090,10 +2185,12 @@ static int read_response(int sock) {
       }
     } else
       fd[sock].response = 0;
-    if (!cl || !ka)
-      fd[sock].keepalive = -1;
-    if (!cl)
+    if (not_modified)
+      fd[sock].length = 0;
+    else if (!cl)
       fd[sock].length = INT_MAX;
+    if ((!cl && !not_modified) || !ka)
+      fd[sock].keepalive = -1;
   }
 
   if (fd[sock].length <= 0 &&
@@ -2188,6 +2285,7 @@ Ldone:
   double thislatency =((ink_get_hrtime_internal() - fd[sock].start) / HRTIME_MSECOND);
   latency += (int)thislatency;
   lat_ops++;
+  interval_lat.add((int)thislatency);
   if (fd[sock].keepalive > 0) {
     fd[sock].reset();
     put_ka(sock);
@@ -2346,8 +2444,12 @@ static int make_client (unsigned int addr, int port) {
   return sock;
 }
 
+static void bfc_request(int sock, double dr, const char * query, int ims);
+
 static void make_bfc_client (unsigned int addr, int port) {
   int sock = -1;
+  if (*replay_file)             // requests come from the log
+    return;
   if (bandwidth_test && bandwidth_test_to_go-- <= 0)
     return;
   if (keepalive)
@@ -2381,6 +2483,11 @@ static void make_bfc_client (unsigned int addr, int port) {
     dr = doc;
   }
   if (verbose) printf("gen_bfc_dist %d\n", fd[sock].response_length);
+  bfc_request(sock, dr, "", 0);
+}
+
+// Build the request for document dr of fd[sock].response_length bytes
+static void bfc_request(int sock, double dr, const char * query, int ims) {
   char eheaders[16384];
   *eheaders = 0;
   int nheaders = extra_headers;
@@ -2396,6 +2503,8 @@ static void make_bfc_client (unsigned int addr, int port) {
       eh += sprintf(eh, "Extra-Header%d: a lot of junk for header %d\r\n",
                     nheaders, nheaders);
   }
+  if (ims)
+    strcat(eheaders, "If-Modified-Since: Mon, 05 Oct 2010 01:00:00 GMT\r\n");
   char cookie[256];
   *cookie = 0;
   fd[sock].nalternate = (int)(alternates * drand48());
@@ -2423,14 +2532,14 @@ static void make_bfc_client (unsigned int addr, int port) {
   if (0 == hostrequest) {
     sprintf(fd[sock].req_header,
             ftp ?
-            "GET ftp://%s:%d/%12.10f/%d%s%s HTTP/1.0\r\n"
+            "GET ftp://%s:%d/%12.10f/%d%s%s%s HTTP/1.0\r\n"
             "%s"
             "%s"
             "%s"
             "%s"
             "\r\n"
             :
-            "GET http://%s:%d/%12.10f/%d%s%s HTTP/1.0\r\n"
+            "GET http://%s:%d/%12.10f/%d%s%s%s HTTP/1.0\r\n"
             "%s"
             "%s"
             "%s"
@@ -2438,21 +2547,21 @@ static void make_bfc_client (unsigned int addr, int port) {
             "\r\n"
             ,
             local_host, server_port, dr,
-            fd[sock].response_length, evo_str, extension,
+            fd[sock].response_length, evo_str, extension, query,
             fd[sock].keepalive?"Proxy-Connection: Keep-Alive\r\n":"",
             reload_rate > drand48() ? "Pragma: no-cache\r\n":"",
             eheaders, cookie
       );
   } else if (1 == hostrequest) {
     sprintf(fd[sock].req_header,
-            "GET /%12.10f/%d%s%s HTTP/1.0\r\n"
+            "GET /%12.10f/%d%s%s%s HTTP/1.0\r\n"
             "Host: %s:%d\r\n"
             "%s"
             "%s"
             "%s"
             "%s"
             "\r\n",
-            dr, fd[sock].response_length, evo_str, extension,
+            dr, fd[sock].response_length, evo_str, extension, query,
             local_host, server_port,
             fd[sock].keepalive?"Connection: Keep-Alive\r\n":"",
             reload_rate > drand48() ? "Pragma: no-cache\r\n":"",
@@ -2460,18 +2569,19 @@ static void make_bfc_client (unsigned int addr, int port) {
   } else if (2 == hostrequest) {
     /* Send a non-proxy client request i.e. for Transparency testing */
     sprintf(fd[sock].req_header,
-            "GET /%12.10f/%d%s%s HTTP/1.0\r\n"
+            "GET /%12.10f/%d%s%s%s HTTP/1.0\r\n"
             "%s"
             "%s"
             "%s"
             "%s"
             "\r\n",
-            dr, fd[sock].response_length, evo_str, extension,
+            dr, fd[sock].response_length, evo_str, extension, query,
             fd[sock].keepalive?"Connection: Keep-Alive\r\n":"",
             reload_rate > drand48() ? "Pragma: no-cache\r\n":"",
             eheaders,
             cookie);
   }
+  fd[sock].ims = ims;
   if (verbose) printf("request %d [%s]\n", sock, fd[sock].req_header);
   fd[sock].length = strlen(fd[sock].req_header);
   {
@@ -2485,6 +2595,186 @@ static void make_bfc_client (unsigned int addr, int port) {
   if (show_headers) printf("Request to Proxy: {\n%s}\n", fd[sock].req_header);
 }
 
+/*
+  Access log replay.
+
+  --replay reads a squid format access log, as written by the proxy or
+  by "traffic_logcat -S" from a binary log, and sends each GET when it
+  was made relative to the first, scaled by --replay_speed. The origin
+  serves each URL as a document of its logged size, so the proxy sees
+  the same URLs, sizes, timing and hence concurrency. A URL requested
+  more than once and never a hit was not cacheable, so the origin marks
+  its responses no-cache. If the proxy did an IMS for a request, the
+  replayed one is an IMS too. With workers each one replays every
+  worker_count'th request.
+*/
+struct ReplayRecord {
+  double time;
+  int length;
+  int cacheable;
+  int ims;
+  uint64_t key;
+};
+
+struct ReplayUrl {
+  uint64_t key;
+  uint8_t seen;
+  uint8_t hit;
+};
+
+#define REPLAY_LATE (100 * HRTIME_MSECOND)
+
+static FILE * replay_fp = NULL;
+static int replay_line = 0;
+static double replay_t0 = -1;
+static ink_hrtime replay_start = 0;
+static ReplayRecord replay_next;
+static int replay_have_next = 0;
+static ReplayUrl * replay_urls = NULL;
+static uint64_t replay_urls_size = 0, replay_urls_used = 0;
+static LatencyHistogram recorded_lat;
+
+static uint64_t replay_hash(const char * url) {
+  uint64_t h = 0xcbf29ce484222325ULL;      // FNV-1a
+  for (const char * p = url; *p; p++)
+    h = (h ^ (unsigned char)*p) * 0x100000001b3ULL;
+  return h ? h : 1;
+}
+
+static ReplayUrl * replay_url(uint64_t key) {
+  if (replay_urls_used * 2 >= replay_urls_size) {
+    ReplayUrl * old = replay_urls;
+    uint64_t old_size = replay_urls_size;
+    replay_urls_size = old_size ? old_size * 2 : 65536;
+    replay_urls = (ReplayUrl*)calloc(replay_urls_size, sizeof(ReplayUrl));
+    if (!replay_urls)
+      panic("unable to allocate replay URL table\n");
+    replay_urls_used = 0;
+    for (uint64_t i = 0; i < old_size; i++)
+      if (old[i].key)
+        *replay_url(old[i].key) = old[i];
+    free(old);
+  }
+  uint64_t i = key & (replay_urls_size - 1);
+  while (replay_urls[i].key && replay_urls[i].key != key)
+    i = (i + 1) & (replay_urls_size - 1);
+  if (!replay_urls[i].key) {
+    replay_urls[i].key = key;
+    replay_urls_used++;
+  }
+  return &replay_urls[i];
+}
+
+// parse one log line, returns 0 for lines which are not replayed
+static int replay_parse(char * line, ReplayRecord & r, char ** code, int * elapsed) {
+  static char result[64], method[16], url[MAX_URL_LEN];
+  int status;
+  int64_t bytes;
+
+  if (sscanf(line, "%lf %d %*s %63[^/]/%d %" SCNd64" %15s %1023s",
+             &r.time, elapsed, result, &status, &bytes, method, url) != 7)
+    return 0;
+  if (strcmp(method, "GET"))
+    return 0;
+  r.key = replay_hash(url);
+  r.length = bytes < 0 ? 0 : (bytes > INT_MAX ? INT_MAX : (int)bytes);
+  r.ims = strstr(result, "IMS") != NULL;
+  r.cacheable = status == 200 || status == 203 || status == 300 || status == 301 ||
+    status == 304 || status == 410;
+  *code = result;
+  return 1;
+}
+
+// first pass: which URLs were hits and how often each was requested
+static void replay_scan() {
+  FILE * fp = fopen(replay_file, "r");
+  if (!fp)
+    panic_perror("fopen replay file");
+  char line[MAX_URL_LEN + 512];
+  int n = 0;
+  while (fgets(line, sizeof(line), fp)) {
+    ReplayRecord r;
+    char * code;
+    int elapsed;
+    if (!replay_parse(line, r, &code, &elapsed))
+      continue;
+    ReplayUrl * u = replay_url(r.key);
+    if (u->seen < 2)
+      u->seen++;
+    if (strstr(code, "HIT"))
+      u->hit = 1;
+    if (replay_t0 < 0)
+      replay_t0 = r.time;
+    recorded_lat.add(elapsed);
+    n++;
+  }
+  fclose(fp);
+  if (!n)
+    panic("no requests to replay\n");
+  printf("replaying %d requests for %" PRIu64" URLs\n", n, replay_urls_used);
+}
+
+static int replay_read(ReplayRecord & r) {
+  char line[MAX_URL_LEN + 512];
+  while (fgets(line, sizeof(line), replay_fp)) {
+    char * code;
+    int elapsed;
+    if (!replay_parse(line, r, &code, &elapsed))
+      continue;
+    if (replay_line++ % worker_count != worker_index)
+      continue;
+    ReplayUrl * u = replay_url(r.key);
+    r.cacheable = r.cacheable && (u->hit || u->seen < 2);
+    return 1;
+  }
+  return 0;
+}
+
+static void replay_open() {
+  replay_fp = fopen(replay_file, "r");
+  if (!replay_fp)
+    panic_perror("fopen replay file");
+  replay_start = ink_get_hrtime_internal();
+}
+
+static void make_replay_client(ReplayRecord & r) {
+  int sock = -1;
+  if (keepalive)
+    sock = get_ka(proxy_addr);
+  if (sock < 0) {
+    if ((sock = make_client(proxy_addr, proxy_port)) < 0)
+      return;
+    fd[sock].keepalive = keepalive;
+  } else {
+    init_client(sock);
+    current_clients++;
+    fd[sock].keepalive--;
+  }
+  fd[sock].response_length = r.length;
+  // the same document number for every request for a URL
+  bfc_request(sock, (double)(r.key >> 11) / (double)(1ULL << 53), r.cacheable ? "" : "?nc", r.ims);
+}
+
+// send the requests which are due
+static void replay_pump() {
+  while (!replay_done) {
+    if (!replay_have_next && !(replay_have_next = replay_read(replay_next))) {
+      replay_done = 1;
+      fclose(replay_fp);
+      replay_fp = NULL;
+      break;
+    }
+    ink_hrtime due = replay_start +
+      (ink_hrtime)((replay_next.time - replay_t0) / replay_speed * HRTIME_SECOND);
+    if (due > now)
+      break;
+    if (now - due > REPLAY_LATE)
+      replay_late++;            // the client is not keeping up
+    make_replay_client(replay_next);
+    replay_have_next = 0;
+  }
+}
+
 #define RUNNING(_n) \
   total_##_n = (((total_##_n * (average_over-1))/average_over) + new_##_n); \
   running_##_n =  total_##_n / average_over; \
@@ -2499,7 +2789,7 @@ void interval_report() {
   now = ink_get_hrtime_internal();
   if (!(here++ % 20))
     printf(
- " con  new     ops   1B  lat      bytes/per     svrs  new  ops      total   time  err\n");
+ " con  new     ops   1B  p50  p90  p99      bytes/per     svrs  new  ops      total   time  err\n");
   RUNNING(clients);
   RUNNING_AVG(running_latency,latency,lat_ops); lat_ops = 0;
   RUNNING_AVG(running_b1latency,b1latency,b1_ops); b1_ops = 0;
@@ -2510,17 +2800,29 @@ void interval_report() {
   RUNNING(tbytes);
   float t = (float)(now - start_time);
   uint64_t per = current_clients ? running_cbytes / current_clients : 0;
-  printf("%4d %4d %7.1f %4d %4d %10" PRIu64"/%-6" PRIu64"  %4d %4d %4d  %9" PRIu64" %6.1f %4d\n",
+  printf("%4d %4d %7.1f %4d %4d %4d %4d %10" PRIu64"/%-6" PRIu64"  %4d %4d %4d  %9" PRIu64" %6.1f %4d\n",
          current_clients, // clients, n_ka_cache,
          running_clients,
-         running_ops, running_b1latency, running_latency,
+         running_ops, running_b1latency,
+         interval_lat.percentile(0.5), interval_lat.percentile(0.9), interval_lat.percentile(0.99),
          running_cbytes, per,
          running_servers,
          running_servers,
          running_sops, running_tbytes,
          t/((float)HRTIME_SECOND),
          errors);
-  if (is_done()) {
+  total_lat.add(interval_lat);
+  interval_lat.clear();
+  if (finishing) {
+    printf("Latency (msec) over %" PRIu64" ops:\tp50 %d p90 %d p99 %d p99.9 %d\n", total_lat.total(),
+           total_lat.percentile(0.5), total_lat.percentile(0.9), total_lat.percentile(0.99),
+           total_lat.percentile(0.999));
+    if (*replay_file) {
+      printf("Recorded latency (msec):\t\tp50 %d p90 %d p99 %d p99.9 %d\n",
+             recorded_lat.percentile(0.5), recorded_lat.percentile(0.9), recorded_lat.percentile(0.99),
+             recorded_lat.percentile(0.999));
+      printf("Requests sent over 100 msec late:\t%" PRId64"\n", replay_late);
+    }
     printf("Total Client Request Bytes:\t\t%" PRIu64"\n", total_client_request_bytes);
     printf("Total Server Response Header Bytes:\t%" PRIu64"\n",
            total_server_response_header_bytes);
@@ -2534,6 +2836,285 @@ void interval_report() {
   }
 }
 
+/*
+  Workers and report collection.
+
+  With --workers each worker is a separate process running its own poll
+  loop over its own FD table, with a share of the clients. The origin
+  server socket is opened before they start so they all accept on it.
+  Instead of printing, workers send what they did in each interval to a
+  collector which merges the reports and prints them. The collector is
+  the parent process, or with --report_to the jtest on another host
+  started with --collect_port, so one report covers a whole test rig.
+*/
+#define JTEST_REPORT_MAGIC 0x4A545231   // "JTR1", also catches byte order
+#define MAX_REPORTERS      1024
+
+struct JTestReport {
+  uint32_t magic;
+  int32_t pid;
+  int32_t final;
+  int32_t current_clients;
+  int32_t errors;
+  int64_t new_clients, new_ops, new_servers, new_sops;
+  int64_t new_cbytes, new_tbytes;
+  int64_t latency, lat_ops, b1latency, b1_ops;
+  int64_t replay_late;
+  uint64_t totals[6];
+  uint64_t lat[LAT_BUCKETS];
+};
+
+struct Reporter {
+  unsigned int addr;
+  int pid;
+  int final;
+  int current_clients;
+  int errors;
+  int64_t replay_late;
+  uint64_t totals[6];
+};
+
+static Reporter reporters[MAX_REPORTERS];
+static int n_reporters = 0;
+
+static uint64_t * const report_totals[6] = {
+  &total_client_request_bytes, &total_server_response_header_bytes,
+  &total_server_response_body_bytes, &total_proxy_request_bytes,
+  &total_proxy_response_header_bytes, &total_proxy_response_body_bytes
+};
+
+static void send_report(int final) {
+  JTestReport r;
+  memset(&r, 0, sizeof(r));
+  r.magic = JTEST_REPORT_MAGIC;
+  r.pid = getpid();
+  r.final = final;
+  r.current_clients = current_clients;
+  r.errors = errors;
+  r.new_clients = new_clients; new_clients = 0;
+  r.new_ops = new_ops; new_ops = 0;
+  r.new_servers = new_servers; new_servers = 0;
+  r.new_sops = new_sops; new_sops = 0;
+  r.new_cbytes = new_cbytes; new_cbytes = 0;
+  r.new_tbytes = new_tbytes; new_tbytes = 0;
+  r.latency = latency; latency = 0;
+  r.lat_ops = lat_ops; lat_ops = 0;
+  r.b1latency = b1latency; b1latency = 0;
+  r.b1_ops = b1_ops; b1_ops = 0;
+  r.replay_late = replay_late;
+  for (int i = 0; i < 6; i++)
+    r.totals[i] = *report_totals[i];
+  memcpy(r.lat, interval_lat.count, sizeof(r.lat));
+  interval_lat.clear();
+  // a lost report only makes one interval look slow
+  if (send(report_fd, &r, sizeof(r), 0) < 0 && verbose_errors)
+    perror("send report");
+  if (report_parent && getppid() != report_parent)
+    exit(1);                    // the collector is gone
+}
+
+static void report() {
+  if (report_fd >= 0)
+    send_report(0);
+  else
+    interval_report();
+}
+
+static Reporter * get_reporter(unsigned int addr, int pid) {
+  for (int i = 0; i < n_reporters; i++)
+    if (reporters[i].addr == addr && reporters[i].pid == pid)
+      return &reporters[i];
+  if (n_reporters >= MAX_REPORTERS)
+    return NULL;
+  Reporter * r = &reporters[n_reporters++];
+  memset(r, 0, sizeof(*r));
+  r->addr = addr;
+  r->pid = pid;
+  return r;
+}
+
+// the gauges and totals are the sum of the latest from each reporter
+static void sum_reporters() {
+  current_clients = 0;
+  errors = 0;
+  replay_late = 0;
+  for (int j = 0; j < 6; j++)
+    *report_totals[j] = 0;
+  for (int i = 0; i < n_reporters; i++) {
+    current_clients += reporters[i].current_clients;
+    errors += reporters[i].errors;
+    replay_late += reporters[i].replay_late;
+    for (int j = 0; j < 6; j++)
+      *report_totals[j] += reporters[i].totals[j];
+  }
+}
+
+static void collect_report(JTestReport & r, struct sockaddr_in & from) {
+  Reporter * rp = get_reporter(from.sin_addr.s_addr, r.pid);
+  if (!rp) {
+    if (verbose_errors)
+      fprintf(stderr, "too many reporters, dropping report from %s\n", inet_ntoa(from.sin_addr));
+    return;
+  }
+  rp->final = r.final;
+  rp->current_clients = r.final ? 0 : r.current_clients;
+  rp->errors = r.errors;
+  rp->replay_late = r.replay_late;
+  memcpy(rp->totals, r.totals, sizeof(rp->totals));
+  new_clients += r.new_clients;
+  new_ops += r.new_ops;
+  new_servers += r.new_servers;
+  new_sops += r.new_sops;
+  new_cbytes += r.new_cbytes;
+  new_tbytes += r.new_tbytes;
+  latency += r.latency;
+  lat_ops += r.lat_ops;
+  b1latency += r.b1latency;
+  b1_ops += r.b1_ops;
+  for (int i = 0; i < LAT_BUCKETS; i++)
+    interval_lat.count[i] += r.lat[i];
+  sum_reporters();
+}
+
+static int reporters_finished() {
+  for (int i = 0; i < n_reporters; i++)
+    if (!reporters[i].final)
+      return 0;
+  return n_reporters || !collect_only;
+}
+
+// run by the parent once the workers are started, does not return
+static void collect(int children) {
+  unsigned int loopback = htonl(INADDR_LOOPBACK);
+  int t = now / HRTIME_SECOND;
+  int start = t;
+
+  while (1) {
+    if (collect_fd >= 0) {
+      struct pollfd p;
+      p.fd = collect_fd;
+      p.events = POLLIN;
+      p.revents = 0;
+      poll(&p, 1, 100);
+      JTestReport r;
+      struct sockaddr_in from;
+      socklen_t fromlen = sizeof(from);
+      int n;
+      while ((n = recvfrom(collect_fd, &r, sizeof(r), MSG_DONTWAIT, (struct sockaddr *)&from, &fromlen)) >= 0) {
+        if (n == (int)sizeof(r) && r.magic == JTEST_REPORT_MAGIC)
+          collect_report(r, from);
+        else if (verbose_errors)
+          fprintf(stderr, "bad report from %s\n", inet_ntoa(from.sin_addr));
+        fromlen = sizeof(from);
+      }
+    } else
+      poll(NULL, 0, 100);
+
+    pid_t pid;
+    while ((pid = waitpid(-1, NULL, WNOHANG)) > 0) {
+      children--;
+      // a worker which died without a final report is done too
+      Reporter * rp = get_reporter(loopback, pid);
+      if (rp && !rp->final) {
+        rp->final = 1;
+        rp->current_clients = 0;
+        sum_reporters();
+      }
+    }
+
+    now = ink_get_hrtime_internal();
+    int t2 = now / HRTIME_SECOND;
+    if (collect_fd >= 0 && interval && t + interval <= t2) {
+      t = t2;
+      interval_report();
+    }
+    // allow the workers' final reports to arrive
+    if ((children <= 0 && reporters_finished()) || (test_time && t2 - start > test_time + 5)) {
+      if (collect_fd < 0)
+        exit(0);
+      done();
+    }
+  }
+}
+
+static int share(int v, int i, int n) {
+  return v / n + (i < v % n);
+}
+
+static void start_workers() {
+  if (workers <= 0)
+    workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (workers <= 0)
+    workers = 1;
+  if (urls_mode && workers > 1) {
+    fprintf(stderr, "URLs are fetched by a single worker\n");
+    workers = 1;
+  }
+  if (workers == 1 && !*report_to && !collect_port && !collect_only)
+    return;
+
+  struct sockaddr_in to;
+  memset(&to, 0, sizeof(to));
+  to.sin_family = AF_INET;
+  if (*report_to) {
+    char host[81];
+    char * colon = strrchr(report_to, ':');
+    if (!colon)
+      panic("report_to must be host:port\n");
+    int len = colon - report_to;
+    memcpy(host, report_to, len);
+    host[len] = 0;
+    to.sin_addr.s_addr = get_addr(host);
+    to.sin_port = htons(atoi(colon + 1));
+  } else {
+    collect_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (collect_fd < 0)
+      panic_perror("socket");
+    int bufsize = 4 * 1024 * 1024;
+    setsockopt(collect_fd, SOL_SOCKET, SO_RCVBUF, (const char *)&bufsize, sizeof(bufsize));
+    struct sockaddr_in name;
+    memset(&name, 0, sizeof(name));
+    name.sin_family = AF_INET;
+    name.sin_port = htons(collect_port);
+    name.sin_addr.s_addr = htonl(collect_port ? INADDR_ANY : INADDR_LOOPBACK);
+    socklen_t namelen = sizeof(name);
+    if (bind(collect_fd, (struct sockaddr *)&name, sizeof(name)) < 0 ||
+        getsockname(collect_fd, (struct sockaddr *)&name, &namelen) < 0)
+      panic_perror("bind collector");
+    to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    to.sin_port = name.sin_port;
+  }
+
+  int n = collect_only ? 0 : workers;
+  int forked = n > 1 || collect_fd >= 0;
+  for (int i = 0; i < n; i++) {
+    pid_t pid = 0;
+    fflush(stdout);
+    if (forked && (pid = fork()) < 0)
+      panic_perror("fork");
+    if (pid)
+      continue;
+    // this is worker i
+    if (collect_fd >= 0)
+      ::close(collect_fd);
+    collect_fd = -1;
+    report_parent = forked ? getppid() : 0;
+    worker_index = i;
+    worker_count = n;
+    nclients = share(nclients, i, n);
+    client_rate = share(client_rate, i, n);
+    bandwidth_test = share(bandwidth_test, i, n);
+    if (keepalive_cons)
+      keepalive_cons = share(keepalive_cons, i, n) ? share(keepalive_cons, i, n) : 1;
+    srand48(drand_seed ? (long)drand_seed + i : (long)time(NULL) ^ getpid());
+    report_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (report_fd < 0 || connect(report_fd, (struct sockaddr *)&to, sizeof(to)) < 0)
+      panic_perror("report socket");
+    return;
+  }
+  collect(n);
+}
+
 #define URL_HASH_ENTRIES     url_hash_entries
 #define BYTES_PER_ENTRY      3
 #define ENTRIES_PER_BUCKET   16
@@ -2883,6 +3464,14 @@ int main(int argc __attribute__((unused)), char *argv[]) {
   start_time = now = ink_get_hrtime_internal();
 
   urls_mode = n_file_arguments || *urls_file;
+  if (*replay_file) {
+    if (urls_mode)
+      panic("replay and URLs are exclusive\n");
+    if (replay_speed <= 0)
+      panic("replay_speed must be positive\n");
+    client_rate = 0;
+    nclients = 0;
+  }
   nclients = client_rate? 0 : nclients;
 
   if (!local_host[0])
@@ -2894,10 +3483,14 @@ int main(int argc __attribute__((unused)), char *argv[]) {
     proxy_addr = get_addr(proxy_host);
   }
 
+  if (collect_only)
+    start_workers();
+
   if (!urls_mode) {
     if (compd_port) {
       build_response();
       open_server(compd_port, accept_compd);
+      start_workers();
     } else {
       if (!server_port)
         server_port = proxy_port + 1000;
@@ -2914,6 +3507,11 @@ int main(int argc __attribute__((unused)), char *argv[]) {
           break;
         }
       }
+      if (*replay_file)
+        replay_scan();
+      start_workers();
+      if (*replay_file && !only_server && proxy_port)
+        replay_open();
       bandwidth_test_to_go = bandwidth_test;
       if (!only_server) {
         if (proxy_port) {
@@ -2955,6 +3553,7 @@ int main(int argc __attribute__((unused)), char *argv[]) {
         strcpy(current_host,host);
       }
     }
+    start_workers();
     for (unsigned i = 0; i < n_file_arguments ; i++) {
       make_url_client(file_arguments[i]);
     }
@@ -2965,6 +3564,8 @@ int main(int argc __attribute__((unused)), char *argv[]) {
   int start = now / HRTIME_SECOND;
   while (1) {
     if (poll_loop()) break;
+    if (replay_fp)
+      replay_pump();
     int t2 = now / HRTIME_SECOND;
     if (urls_fp && n_defered_urls < MAX_DEFERED_URLS - DEFERED_URLS_BLOCK - 2){
       if (get_defered_urls(urls_fp)) {
@@ -2974,7 +3575,7 @@ int main(int argc __attribute__((unused)), char *argv[]) {
     }
     if ((!urls_mode || client_rate) && interval && t + interval <= t2) {
       t = t2;
-      interval_report();
+      report();
     }
     if (t2 != tclient) {
       for (int i = 0; i < client_rate * (t2 - tclient) ; i++)
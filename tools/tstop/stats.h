@@ -25,12 +25,16 @@
 
 #include <curl/curl.h>
 #include <map>
+#include <set>
 #include <string>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 #include <inttypes.h>
 #include "mgmtapi.h"
+#include "I_Layout.h"
+#include "P_RecShm.h"
 
 using namespace std;
 
@@ -62,6 +66,17 @@ public:
     _stats = NULL;
     _old_stats = NULL;
     _absolute = false;
+    _now = 0;
+    _time_diff = 0;
+    _shm = NULL;
+    _shm_size = 0;
+    if (_host == "") {
+      // traffic_server's stats segment, read without asking either process
+      char path[PATH_NAME_MAX];
+      Layout::create();
+      Layout::relative_to(path, sizeof(path), Layout::get()->runtimedir, REC_SHM_FILE);
+      _shm_path = path;
+    }
     lookup_table.insert(make_pair("version", LookupItem("Version", "proxy.process.version.server.short", 1)));
     lookup_table.insert(make_pair("disk_used", LookupItem("Disk Used", "proxy.process.cache.bytes_used", 1)));
     lookup_table.insert(make_pair("disk_total", LookupItem("Disk Total", "proxy.process.cache.bytes_total", 1)));
@@ -189,11 +204,11 @@ public:
           if (strcmp(item.pretty, "Version") == 0) {
             // special case for Version informaion
             TSString strValue = NULL;
-            assert(TSRecordGetString(item.name, &strValue) == TS_ERR_OKAY);
+            ink_release_assert(TSRecordGetString(item.name, &strValue) == TS_ERR_OKAY);
             string key = item.name;
             (*_stats)[key] = strValue;
           } else {
-            assert(TSRecordGetInt(item.name, &value) == TS_ERR_OKAY);
+            ink_release_assert(TSRecordGetInt(item.name, &value) == TS_ERR_OKAY);
             string key = item.name;
             char buffer[32];
             sprintf(buffer, "%" PRId64, value);
@@ -202,6 +217,7 @@ public:
           }
         }
       } 
+      readShm();
       _old_time = _now;
       _now = now;
       _time_diff = _now - _old_time;
@@ -246,9 +262,58 @@ public:
     }
   }
 
+  // Refresh only the stats in traffic_server's shared memory, which costs
+  // no round trip to either process. Returns false without the segment.
+  bool getShmStats() {
+    if (!mapShm() || _stats == NULL)
+      return false;
+
+    delete _old_stats;
+    _old_stats = _stats;
+    _stats = new map<string, string>(*_old_stats);
+
+    gettimeofday(&_time, NULL);
+    double now = _time.tv_sec + (double)_time.tv_usec / 1000000;
+    readShm();
+    _old_time = _now;
+    _now = now;
+    _time_diff = _now - _old_time;
+    return true;
+  }
+
+  // A stat by its record name, as a rate per second for rate set unless
+  // the display is absolute. Returns false if the stat is not there.
+  bool getRawStat(const string &name, double &value, bool rate = false) const {
+    map<string, string>::const_iterator stats_it = _stats->find(name);
+    if (stats_it == _stats->end())
+      return false;
+    value = atof(stats_it->second.c_str());
+    if (rate && _absolute == false) {
+      map<string, string>::const_iterator old_it;
+      if (_old_stats == NULL || _time_diff <= 0 || (old_it = _old_stats->find(name)) == _old_stats->end())
+        value = 0;
+      else
+        value = (value - atof(old_it->second.c_str())) / _time_diff;
+    }
+    return true;
+  }
+
+  // The numbers n of the stats named prefix<n>.something, such as the
+  // event threads or the cache volumes.
+  void getStatIndices(const string &prefix, set<int> &indices) const {
+    for (map<string, string>::const_iterator stats_it = _stats->lower_bound(prefix);
+         stats_it != _stats->end() && stats_it->first.compare(0, prefix.size(), prefix) == 0; ++stats_it) {
+      const char *p = stats_it->first.c_str() + prefix.size();
+      char *end;
+      long n = strtol(p, &end, 10);
+      if (end != p && *end == '.')
+        indices.insert(n);
+    }
+  }
+
   int64_t getValue(const string &key, const map<string, string> *stats) const {
     map<string, string>::const_iterator stats_it = stats->find(key);
-    assert(stats_it != stats->end());
+    ink_release_assert(stats_it != stats->end());
     int64_t value = atoll(stats_it->second.c_str());
     return value;
   }
@@ -262,17 +327,17 @@ public:
 
   void getStat(const string &key, string &value) {
     map<string, LookupItem>::const_iterator lookup_it = lookup_table.find(key);
-    assert(lookup_it != lookup_table.end());
+    ink_release_assert(lookup_it != lookup_table.end());
     const LookupItem &item = lookup_it->second;
     
     map<string, string>::const_iterator stats_it = _stats->find(item.name);
-    assert(stats_it != _stats->end());
+    ink_release_assert(stats_it != _stats->end());
     value = stats_it->second.c_str();
   }
 
   void getStat(const string &key, double &value, string &prettyName, int &type, int overrideType = 0) {
     map<string, LookupItem>::const_iterator lookup_it = lookup_table.find(key);
-    assert(lookup_it != lookup_table.end());
+    ink_release_assert(lookup_it != lookup_table.end());
     const LookupItem &item = lookup_it->second;
     prettyName = item.pretty;
     if (overrideType != 0)
@@ -378,9 +443,89 @@ public:
     if (_old_stats != NULL) {
       delete _old_stats;
     }
+    if (_shm != NULL) {
+      munmap(_shm, _shm_size);
+    }
   }
 
 private:
+  // Map records.shm read only, again if traffic_server restarted and
+  // created a new one.
+  bool mapShm() {
+    struct stat st;
+
+    if (_shm_path == "" || stat(_shm_path.c_str(), &st) < 0)
+      return _shm != NULL;
+    if (_shm != NULL && st.st_dev == _shm_dev && st.st_ino == _shm_ino)
+      return true;
+    if (_shm != NULL) {
+      munmap(_shm, _shm_size);
+      _shm = NULL;
+    }
+
+    int fd = open(_shm_path.c_str(), O_RDONLY);
+    if (fd < 0)
+      return false;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(RecShmHeader)) {
+      close(fd);
+      return false;
+    }
+    void *p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+      return false;
+
+    RecShmHeader *h = (RecShmHeader *)p;
+    if (h->magic != REC_SHM_MAGIC || h->entry_size != sizeof(RecShmEntry) || h->max_entries < 0 ||
+        (size_t)st.st_size < sizeof(RecShmHeader) + h->max_entries * sizeof(RecShmEntry)) {
+      munmap(p, st.st_size);
+      return false;
+    }
+    _shm = h;
+    _shm_size = st.st_size;
+    _shm_dev = st.st_dev;
+    _shm_ino = st.st_ino;
+    return true;
+  }
+
+  // Copy every stat in the segment into the current stats, reading each
+  // entry under its sequence count as traffic_manager does.
+  void readShm() {
+    if (!mapShm())
+      return;
+
+    const RecShmEntry *entries = (const RecShmEntry *)(_shm + 1);
+    int num_entries = _shm->num_entries;
+
+    for (int i = 0; i < num_entries && i < _shm->max_entries; ++i) {
+      const RecShmEntry *e = &entries[i];
+      RecDataT data_type = e->data_type;
+      RecData data;
+      char name[REC_SHM_NAME_LEN];
+      char buffer[32];
+      uint32_t seq;
+
+      if (data_type == RECD_NULL)
+        continue;
+      __sync_synchronize();
+      memcpy(name, e->name, sizeof(name));
+      name[sizeof(name) - 1] = '\0';
+
+      do {
+        seq = e->seq;
+        __sync_synchronize();
+        data = e->data;
+        __sync_synchronize();
+      } while ((seq & 1) || seq != e->seq);
+
+      if (data_type == RECD_FLOAT)
+        snprintf(buffer, sizeof(buffer), "%f", (double)data.rec_float);
+      else
+        snprintf(buffer, sizeof(buffer), "%" PRId64, (int64_t)data.rec_int);
+      (*_stats)[name] = buffer;
+    }
+  }
+
   map<string, string> *_stats;
   map<string, string> *_old_stats;
   map<string, LookupItem> lookup_table;
@@ -390,4 +535,9 @@ private:
   double _time_diff;
   struct timeval _time;
   bool _absolute;
+  string _shm_path;
+  RecShmHeader *_shm;
+  size_t _shm_size;
+  dev_t _shm_dev;
+  ino_t _shm_ino;
 };
@@ -27,7 +27,6 @@
 #include <string>
 #include <string.h>
 #include <iostream>
-#include <assert.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <getopt.h>
@@ -166,6 +165,12 @@ static void help(const string &host, const string &version) {
     mvprintw(12, 0, "Changed    => Requests that can't be cached for some reason");
     mvprintw(12, 0, "No Cache   => Requests that the client sent Cache-Control: no-cache header");
 
+    attron(A_BOLD); mvprintw(14, 0, "Views:"); attroff(A_BOLD);
+    mvprintw(15, 0, "(t)hreads  => Busy share and events per second of each event thread");
+    mvprintw(16, 0, "(d)isks    => RAM cache hit rate and activity per cache volume, AIO queues");
+    mvprintw(17, 0, "              Run on the server host, these read traffic_server's stats");
+    mvprintw(18, 0, "              segment directly and suit refreshes below a second (-s 0.5)");
+
     attron(COLOR_PAIR(colorPair::border));
     attron(A_BOLD);
     mvprintw(23, 0, "%s - %.12s - %.12s      (b)ack                            ", timeBuf, version.c_str(), host.c_str());
@@ -178,8 +183,155 @@ static void help(const string &host, const string &version) {
   }
 }
 
+//----------------------------------------------------------------------------
+// Sub-second views read traffic_server's stats segment when it is local,
+// and fall back to a full refresh otherwise.
+static void refreshStats(Stats &stats) {
+  if (!stats.getShmStats())
+    stats.getStats();
+}
+
+static void viewBorder(const char *title, const string &host, const string &version) {
+  time_t now = time(NULL);
+  struct tm *nowtm = localtime(&now);
+  char timeBuf[32];
+  strftime(timeBuf, sizeof(timeBuf), "%H:%M:%S", nowtm);
+
+  attron(COLOR_PAIR(colorPair::border));
+  attron(A_BOLD);
+  mvprintw(0, 0, "%-80.80s", title);
+  mvprintw(23, 0, "%8.8s - %-10.10s - %-24.24s      (b)ack                    ", timeBuf, version.c_str(), host.c_str());
+  attroff(COLOR_PAIR(colorPair::border));
+  attroff(A_BOLD);
+}
+
+//----------------------------------------------------------------------------
+static void threadView(Stats &stats, const string &host, const string &version, int sleep_time) {
+  const string prefix = "proxy.process.exec_thread.";
+
+  while(1) {
+    clear();
+    viewBorder("  THREAD      LOAD  EVENTS/S            THREAD      LOAD  EVENTS/S", host, version);
+
+    set<int> threads;
+    stats.getStatIndices(prefix, threads);
+    double total_load = 0;
+    int row = 0;
+    for (set<int>::const_iterator it = threads.begin(); it != threads.end() && row < 42; ++it, ++row) {
+      char name[64];
+      double load = 0, events = 0;
+      int x = row < 21 ? 0 : 40;
+      int y = 1 + row % 21;
+
+      snprintf(name, sizeof(name), "%s%d.load", prefix.c_str(), *it);
+      stats.getRawStat(name, load);
+      snprintf(name, sizeof(name), "%s%d.events", prefix.c_str(), *it);
+      stats.getRawStat(name, events, true);
+      load /= 10; // per mille
+      total_load += load;
+
+      mvprintw(y, x, "ET_NET %d", *it);
+      prettyPrint(x + 10, y, load, 4);
+      prettyPrint(x + 20, y, events, 2);
+    }
+
+    double rebalanced = 0;
+    stats.getRawStat(prefix + "rebalanced", rebalanced, true);
+    mvprintw(22, 0, "Avg Load");
+    prettyPrint(10, 22, threads.empty() ? 0 : total_load / threads.size(), 4);
+    mvprintw(22, 40, "Rebalance");
+    prettyPrint(50, 22, rebalanced, 2);
+    if (threads.empty())
+      mvprintw(2, 0, "No event thread stats, traffic_server may be older than tstop.");
+
+    refresh();
+    timeout(sleep_time);
+    int x = getch();
+    if (x == 'b')
+      break;
+    if (x == -1)
+      refreshStats(stats);
+  }
+}
+
+//----------------------------------------------------------------------------
+static void diskView(Stats &stats, const string &host, const string &version, int sleep_time) {
+  const string prefix = "proxy.process.cache.volume_";
+  static const char *aio_classes[] = { "user_read", "agg_write", "evacuate", "dir_sync", "scan" };
+
+  while(1) {
+    clear();
+    viewBorder("  VOLUME   RAM HIT  RAM USED   LOOKUPS     READS    WRITES  READ ACT     %FULL", host, version);
+
+    set<int> volumes;
+    stats.getStatIndices(prefix, volumes);
+    int row = 1;
+    for (set<int>::const_iterator it = volumes.begin(); it != volumes.end() && row < 15; ++it, ++row) {
+      char vol[64];
+      double hits = 0, misses = 0, value = 0;
+
+      snprintf(vol, sizeof(vol), "%s%d.", prefix.c_str(), *it);
+      mvprintw(row, 0, "volume %d", *it);
+      stats.getRawStat(string(vol) + "ram_cache.hits", hits, true);
+      stats.getRawStat(string(vol) + "ram_cache.misses", misses, true);
+      prettyPrint(10, row, hits + misses == 0 ? 0 : hits / (hits + misses) * 100, 4);
+      stats.getRawStat(string(vol) + "ram_cache.bytes_used", value);
+      prettyPrint(20, row, value, 1);
+      stats.getRawStat(string(vol) + "lookup.success", value, true);
+      prettyPrint(30, row, value, 2);
+      stats.getRawStat(string(vol) + "read.success", value, true);
+      prettyPrint(40, row, value, 2);
+      stats.getRawStat(string(vol) + "write.success", value, true);
+      prettyPrint(50, row, value, 2);
+      stats.getRawStat(string(vol) + "read.active", value);
+      prettyPrint(60, row, value, 1);
+      stats.getRawStat(string(vol) + "percent_full", value);
+      prettyPrint(70, row, value, 4);
+    }
+    if (volumes.empty())
+      mvprintw(2, 0, "No cache volume stats.");
+
+    attron(COLOR_PAIR(colorPair::border));
+    attron(A_BOLD);
+    mvprintw(16, 0, "  AIO CLASS  QUEUED  WAIT (ms)            DISK I/O (ms)                        ");
+    attroff(COLOR_PAIR(colorPair::border));
+    attroff(A_BOLD);
+    for (int c = 0; c < (int)(sizeof(aio_classes) / sizeof(aio_classes[0])); ++c) {
+      string name = string("proxy.process.cache.aio.") + aio_classes[c];
+      double value = 0;
+
+      mvprintw(17 + c, 0, "%s", aio_classes[c]);
+      stats.getRawStat(name + ".queued", value);
+      prettyPrint(10, 17 + c, value, 1);
+      stats.getRawStat(name + ".wait_time", value);
+      prettyPrint(20, 17 + c, value * 1000, 1);
+    }
+    static const char *io_times[][2] = {
+      { "Direct Rd", "proxy.process.cache.aio.direct.read_time" },
+      { "Direct Wr", "proxy.process.cache.aio.direct.write_time" },
+      { "Buffer Rd", "proxy.process.cache.aio.buffered.read_time" },
+      { "Buffer Wr", "proxy.process.cache.aio.buffered.write_time" },
+    };
+    for (int i = 0; i < 4; ++i) {
+      double value = 0;
+      mvprintw(17 + i, 40, "%s", io_times[i][0]);
+      stats.getRawStat(io_times[i][1], value);
+      prettyPrint(50, 17 + i, value * 1000, 1);
+    }
+
+    refresh();
+    timeout(sleep_time);
+    int x = getch();
+    if (x == 'b')
+      break;
+    if (x == -1)
+      refreshStats(stats);
+  }
+}
+
 static void usage(char **argv) {
   fprintf(stderr, "Usage: %s [-s seconds] hostname|hostname:port\n", argv[0]);
+  fprintf(stderr, "       seconds may be a fraction, such as 0.5\n");
   exit(1);
 }
 
@@ -193,7 +345,9 @@ int main(int argc, char **argv)
   while ((opt = getopt(argc, argv, "s:")) != -1) {
     switch(opt) {
     case 's':
-      sleep_time = atoi(optarg) * 1000;
+      sleep_time = (int)(atof(optarg) * 1000);
+      if (sleep_time < 100)
+        sleep_time = 100;
       break;
     default:
       usage(argv);
@@ -250,7 +404,7 @@ int main(int argc, char **argv)
     mvprintw(0, 40, "       CLIENT REQUEST & RESPONSE        ");
     mvprintw(16, 0, "             CLIENT                    ");
     mvprintw(16, 40, "           ORIGIN SERVER                ");
-    mvprintw(23, 0, "%8.8s - %-10.10s - %-24.24s      (q)uit (h)elp (%c)bsolute  ", timeBuf, version.c_str(), host.c_str(), absolute ? 'A' : 'a');
+    mvprintw(23, 0, "%8.8s - %-10.10s - %-15.15s (q)uit (h)elp (t)hreads (d)isks (%c)bs   ", timeBuf, version.c_str(), host.c_str(), absolute ? 'A' : 'a');
     attroff(COLOR_PAIR(colorPair::border));
     attroff(A_BOLD);
 
@@ -368,6 +522,14 @@ int main(int argc, char **argv)
     if (x == 'a') {
       absolute = stats.toggleAbsolute();
     }
+    if (x == 't') {
+      threadView(stats, host, version, sleep_time);
+      stats.getStats();
+    }
+    if (x == 'd') {
+      diskView(stats, host, version, sleep_time);
+      stats.getStats();
+    }
     if (x == -1)
       stats.getStats();
     clear();